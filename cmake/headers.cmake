@@ -1,5 +1,6 @@
 # DO NOT EDIT, GENERATED BY SCRIPT
 set(llfio_HEADERS
+  "include/kvstore/detail/impl/kvstore.ipp"
   "include/kvstore/kvstore.hpp"
   "include/llfio.hpp"
   "include/llfio/llfio.hpp"
@@ -8,12 +9,28 @@ set(llfio_HEADERS
   "include/llfio/ntkernel-error-category/include/ntkernel-error-category/detail/ntkernel_category_impl.ipp"
   "include/llfio/ntkernel-error-category/include/ntkernel-error-category/ntkernel_category.hpp"
   "include/llfio/revision.hpp"
+  "include/llfio/v2.0/algorithm/append_only_vector.hpp"
+  "include/llfio/v2.0/algorithm/atomic_replace.hpp"
   "include/llfio/v2.0/algorithm/clone.hpp"
   "include/llfio/v2.0/algorithm/contents.hpp"
+  "include/llfio/v2.0/algorithm/deduplicate.hpp"
   "include/llfio/v2.0/algorithm/difference.hpp"
+  "include/llfio/v2.0/algorithm/file_handle_cache.hpp"
+  "include/llfio/v2.0/algorithm/find_in_files.hpp"
   "include/llfio/v2.0/algorithm/handle_adapter/cached_parent.hpp"
   "include/llfio/v2.0/algorithm/handle_adapter/combining.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/compressed.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/direct_io.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/erasure_coded.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/striped.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/tiered.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/transform.hpp"
+  "include/llfio/v2.0/algorithm/handle_adapter/write_back.hpp"
   "include/llfio/v2.0/algorithm/handle_adapter/xor.hpp"
+  "include/llfio/v2.0/algorithm/manifest.hpp"
+  "include/llfio/v2.0/algorithm/mapped_arena.hpp"
+  "include/llfio/v2.0/algorithm/path_table.hpp"
+  "include/llfio/v2.0/algorithm/read_whole_file.hpp"
   "include/llfio/v2.0/algorithm/reduce.hpp"
   "include/llfio/v2.0/algorithm/shared_fs_mutex/atomic_append.hpp"
   "include/llfio/v2.0/algorithm/shared_fs_mutex/base.hpp"
@@ -22,26 +39,45 @@ set(llfio_HEADERS
   "include/llfio/v2.0/algorithm/shared_fs_mutex/memory_map.hpp"
   "include/llfio/v2.0/algorithm/shared_fs_mutex/safe_byte_ranges.hpp"
   "include/llfio/v2.0/algorithm/summarize.hpp"
+  "include/llfio/v2.0/algorithm/transactional_directory.hpp"
   "include/llfio/v2.0/algorithm/traverse.hpp"
   "include/llfio/v2.0/algorithm/trivial_vector.hpp"
+  "include/llfio/v2.0/algorithm/write_ahead_log.hpp"
+  "include/llfio/v2.0/block_device_handle.hpp"
+  "include/llfio/v2.0/byte_socket_handle.hpp"
   "include/llfio/v2.0/config.hpp"
   "include/llfio/v2.0/deadline.h"
+  "include/llfio/v2.0/demand_paged_map.hpp"
   "include/llfio/v2.0/detail/impl/cached_parent_handle_adapter.ipp"
   "include/llfio/v2.0/detail/impl/clone.ipp"
   "include/llfio/v2.0/detail/impl/config.ipp"
+  "include/llfio/v2.0/detail/impl/difference.ipp"
+  "include/llfio/v2.0/detail/impl/direct_io_handle_adapter.ipp"
   "include/llfio/v2.0/detail/impl/fast_random_file_handle.ipp"
   "include/llfio/v2.0/detail/impl/io_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/io_statistics.ipp"
+  "include/llfio/v2.0/detail/impl/io_trace.ipp"
+  "include/llfio/v2.0/detail/impl/large_page_pool.ipp"
+  "include/llfio/v2.0/detail/impl/memory_pressure_reclaimer.ipp"
   "include/llfio/v2.0/detail/impl/path_discovery.ipp"
   "include/llfio/v2.0/detail/impl/path_view.ipp"
+  "include/llfio/v2.0/detail/impl/posix/block_device_handle.ipp"
+  "include/llfio/v2.0/detail/impl/posix/byte_socket_handle.ipp"
+  "include/llfio/v2.0/detail/impl/posix/demand_paged_map.ipp"
   "include/llfio/v2.0/detail/impl/posix/directory_handle.ipp"
+  "include/llfio/v2.0/detail/impl/posix/epoll_multiplexer.ipp"
   "include/llfio/v2.0/detail/impl/posix/file_handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/fs_handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/import.hpp"
   "include/llfio/v2.0/detail/impl/posix/io_handle.ipp"
+  "include/llfio/v2.0/detail/impl/posix/ipc_channel.ipp"
+  "include/llfio/v2.0/detail/impl/posix/io_uring_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/posix/kqueue_multiplexer.ipp"
   "include/llfio/v2.0/detail/impl/posix/lockable_io_handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/map_handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/mapped_file_handle.ipp"
+  "include/llfio/v2.0/detail/impl/posix/mapped_ring_buffer.ipp"
   "include/llfio/v2.0/detail/impl/posix/path_discovery.ipp"
   "include/llfio/v2.0/detail/impl/posix/path_handle.ipp"
   "include/llfio/v2.0/detail/impl/posix/pipe_handle.ipp"
@@ -50,22 +86,35 @@ set(llfio_HEADERS
   "include/llfio/v2.0/detail/impl/posix/statfs.ipp"
   "include/llfio/v2.0/detail/impl/posix/storage_profile.ipp"
   "include/llfio/v2.0/detail/impl/posix/symlink_handle.ipp"
-  "include/llfio/v2.0/detail/impl/posix/test/io_uring_multiplexer.ipp"
   "include/llfio/v2.0/detail/impl/posix/utils.ipp"
+  "include/llfio/v2.0/detail/impl/prioritised_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/process_memory_usage_sampler.ipp"
+  "include/llfio/v2.0/detail/impl/random_fill.ipp"
+  "include/llfio/v2.0/detail/impl/read_whole_file.ipp"
   "include/llfio/v2.0/detail/impl/reduce.ipp"
   "include/llfio/v2.0/detail/impl/safe_byte_ranges.ipp"
   "include/llfio/v2.0/detail/impl/storage_profile.ipp"
+  "include/llfio/v2.0/detail/impl/temp_inode_pool.ipp"
   "include/llfio/v2.0/detail/impl/test/null_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/thread_affine_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/thread_pool_multiplexer.ipp"
   "include/llfio/v2.0/detail/impl/traverse.ipp"
+  "include/llfio/v2.0/detail/impl/windows/block_device_handle.ipp"
+  "include/llfio/v2.0/detail/impl/windows/byte_socket_handle.ipp"
+  "include/llfio/v2.0/detail/impl/windows/demand_paged_map.ipp"
   "include/llfio/v2.0/detail/impl/windows/directory_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/file_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/fs_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/import.hpp"
   "include/llfio/v2.0/detail/impl/windows/io_handle.ipp"
+  "include/llfio/v2.0/detail/impl/windows/iocp_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/windows/ioring_multiplexer.ipp"
+  "include/llfio/v2.0/detail/impl/windows/ipc_channel.ipp"
   "include/llfio/v2.0/detail/impl/windows/lockable_io_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/map_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/mapped_file_handle.ipp"
+  "include/llfio/v2.0/detail/impl/windows/mapped_ring_buffer.ipp"
   "include/llfio/v2.0/detail/impl/windows/path_discovery.ipp"
   "include/llfio/v2.0/detail/impl/windows/path_handle.ipp"
   "include/llfio/v2.0/detail/impl/windows/pipe_handle.ipp"
@@ -74,7 +123,6 @@ set(llfio_HEADERS
   "include/llfio/v2.0/detail/impl/windows/statfs.ipp"
   "include/llfio/v2.0/detail/impl/windows/storage_profile.ipp"
   "include/llfio/v2.0/detail/impl/windows/symlink_handle.ipp"
-  "include/llfio/v2.0/detail/impl/windows/test/iocp_multiplexer.ipp"
   "include/llfio/v2.0/detail/impl/windows/utils.ipp"
   "include/llfio/v2.0/directory_handle.hpp"
   "include/llfio/v2.0/fast_random_file_handle.hpp"
@@ -83,12 +131,16 @@ set(llfio_HEADERS
   "include/llfio/v2.0/handle.hpp"
   "include/llfio/v2.0/io_handle.hpp"
   "include/llfio/v2.0/io_multiplexer.hpp"
+  "include/llfio/v2.0/io_statistics.hpp"
+  "include/llfio/v2.0/io_trace.hpp"
+  "include/llfio/v2.0/ipc_channel.hpp"
   "include/llfio/v2.0/llfio.hpp"
   "include/llfio/v2.0/lockable_io_handle.hpp"
   "include/llfio/v2.0/logging.hpp"
   "include/llfio/v2.0/map_handle.hpp"
   "include/llfio/v2.0/mapped.hpp"
   "include/llfio/v2.0/mapped_file_handle.hpp"
+  "include/llfio/v2.0/mapped_ring_buffer.hpp"
   "include/llfio/v2.0/multiplex.hpp"
   "include/llfio/v2.0/native_handle_type.hpp"
   "include/llfio/v2.0/path_discovery.hpp"
@@ -102,5 +154,6 @@ set(llfio_HEADERS
   "include/llfio/v2.0/storage_profile.hpp"
   "include/llfio/v2.0/symlink_handle.hpp"
   "include/llfio/v2.0/utils.hpp"
+  "include/llfio/v2.0/windowed_map_view.hpp"
   "include/llfio/version.hpp"
 )
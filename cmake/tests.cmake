@@ -1,37 +1,93 @@
 # DO NOT EDIT, GENERATED BY SCRIPT
 set(llfio_TESTS
   "test/test_kernel_decl.hpp"
+  "test/tests/append_only_vector.cpp"
+  "test/tests/atomic_replace.cpp"
+  "test/tests/block_device_handle.cpp"
+  "test/tests/byte_socket_handle.cpp"
   "test/tests/clone_extents.cpp"
   "test/tests/current_path.cpp"
+  "test/tests/deduplicate.cpp"
+  "test/tests/demand_paged_map.cpp"
+  "test/tests/difference.cpp"
   "test/tests/directory_handle_create_close/kernel_directory_handle.cpp.hpp"
   "test/tests/directory_handle_create_close/runner.cpp"
+  "test/tests/directory_handle_create_entries.cpp"
   "test/tests/directory_handle_enumerate/kernel_directory_handle_enumerate.cpp.hpp"
   "test/tests/directory_handle_enumerate/runner.cpp"
+  "test/tests/directory_handle_enumerate_large.cpp"
+  "test/tests/directory_handle_relink_entries.cpp"
+  "test/tests/directory_handle_stamp_entries.cpp"
+  "test/tests/directory_handle_stat_entries.cpp"
+  "test/tests/directory_stream.cpp"
   "test/tests/fast_random_file_handle.cpp"
+  "test/tests/file_handle_advise.cpp"
+  "test/tests/file_handle_cache.cpp"
   "test/tests/file_handle_create_close/kernel_file_handle.cpp.hpp"
   "test/tests/file_handle_create_close/runner.cpp"
   "test/tests/file_handle_lock_unlock.cpp"
+  "test/tests/file_handle_preallocate.cpp"
+  "test/tests/file_handle_temp_inode_pool.cpp"
+  "test/tests/file_handle_zero_extents.cpp"
+  "test/tests/find_in_files.cpp"
+  "test/tests/handle_adapter_compressed.cpp"
+  "test/tests/handle_adapter_direct_io.cpp"
+  "test/tests/handle_adapter_erasure_coded.cpp"
+  "test/tests/handle_adapter_striped.cpp"
+  "test/tests/handle_adapter_tiered.cpp"
+  "test/tests/handle_adapter_transform.cpp"
+  "test/tests/handle_adapter_write_back.cpp"
   "test/tests/handle_adapter_xor.cpp"
+  "test/tests/io_request_flags.cpp"
+  "test/tests/io_statistics.cpp"
+  "test/tests/io_trace.cpp"
+  "test/tests/io_uring_multiplexer.cpp"
+  "test/tests/ipc_channel.cpp"
   "test/tests/issue0009.cpp"
   "test/tests/issue0027.cpp"
   "test/tests/issue0028.cpp"
+  "test/tests/kvstore.cpp"
+  "test/tests/large_io_requests.cpp"
   "test/tests/large_pages.cpp"
+  "test/tests/manifest.cpp"
+  "test/tests/map_handle_batched.cpp"
+  "test/tests/map_handle_cache.cpp"
   "test/tests/map_handle_create_close/kernel_map_handle.cpp.hpp"
   "test/tests/map_handle_create_close/runner.cpp"
+  "test/tests/map_handle_dirty.cpp"
+  "test/tests/map_handle_numa.cpp"
+  "test/tests/map_handle_populate.cpp"
   "test/tests/mapped.cpp"
+  "test/tests/mapped_arena.cpp"
+  "test/tests/mapped_file_handle_append.cpp"
+  "test/tests/mapped_file_handle_snapshot.cpp"
+  "test/tests/mapped_file_handle_view.cpp"
+  "test/tests/mapped_ring_buffer.cpp"
+  "test/tests/null_multiplexer.cpp"
   "test/tests/path_discovery.cpp"
+  "test/tests/path_table.cpp"
   "test/tests/path_view.cpp"
   "test/tests/pipe_handle.cpp"
+  "test/tests/prioritised_multiplexer.cpp"
   "test/tests/process_handle.cpp"
+  "test/tests/read_whole_file.cpp"
   "test/tests/reduce.cpp"
+  "test/tests/summarize_incremental.cpp"
+  "test/tests/section_handle_anonymous.cpp"
   "test/tests/section_handle_create_close/kernel_section_handle.cpp.hpp"
   "test/tests/section_handle_create_close/runner.cpp"
   "test/tests/shared_fs_mutex.cpp"
+  "test/tests/storage_profile.cpp"
   "test/tests/symlink_handle_create_close/kernel_symlink_handle.cpp.hpp"
   "test/tests/symlink_handle_create_close/runner.cpp"
+  "test/tests/thread_affine_multiplexer.cpp"
+  "test/tests/thread_pool_multiplexer.cpp"
+  "test/tests/transactional_directory.cpp"
   "test/tests/traverse.cpp"
   "test/tests/trivial_vector.cpp"
   "test/tests/utils.cpp"
+  "test/tests/windowed_map_view.cpp"
+  "test/tests/write_ahead_log.cpp"
 )
 # DO NOT EDIT, GENERATED BY SCRIPT
 set(llfio_COMPILE_TESTS
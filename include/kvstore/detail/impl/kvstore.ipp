@@ -0,0 +1,1056 @@
+/* Standard key-value store for C++
+(C) 2018 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2018
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../kvstore.hpp"
+
+#include "../../../llfio/v2.0/directory_handle.hpp"
+#include "../../../llfio/v2.0/mapped_file_handle.hpp"
+
+#include "quickcpplib/algorithm/hash.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+KVSTORE_V1_NAMESPACE_BEGIN
+
+namespace detail
+{
+  /* The mapped_index store. Its directory contains:
+
+  - `index`, a header followed by an open addressed hash table of slots, each slot
+  being the location of the key's current value followed by the key. The index is
+  sized when created, and kept mapped by every user.
+  - `values`, to which every value written is appended, padded to 64 bytes. This is
+  mapped with a large address space reservation so values can be returned by pointer
+  without them ever moving.
+
+  Writers serialise upon an exclusive byte range lock on the index, so there is only
+  ever one writer. Readers take no locks, each slot is a sequence lock which its value
+  location is read within.
+  */
+  namespace mapped_index
+  {
+    using extent_type = basic_key_value_store::extent_type;
+    using size_type = basic_key_value_store::size_type;
+    using key_type = basic_key_value_store::key_type;
+    using features = basic_key_value_store::features;
+    using buffer_type = basic_key_value_store::buffer_type;
+    using buffers_type = basic_key_value_store::buffers_type;
+    using const_buffer_type = basic_key_value_store::const_buffer_type;
+    using const_buffers_type = basic_key_value_store::const_buffers_type;
+    template <class T> using io_request = basic_key_value_store::io_request<T>;
+    template <class T> using io_result = basic_key_value_store::io_result<T>;
+
+    static constexpr uint64_t magic = 0x31584449564b4c4cULL;  // "LLKVIDX1"
+    static constexpr size_type max_key_size = 256;
+    static constexpr uint64_t default_entries = 65536;
+    static constexpr size_type header_size = 4096;
+    static constexpr extent_type writer_lock_offset = INT64_MAX;
+    static constexpr extent_type values_growth = 1024 * 1024;
+    static constexpr extent_type max_value_size = (sizeof(void *) >= 8) ? (1ULL << 32) : (16ULL << 20);
+    static constexpr uint64_t values_reservation = (sizeof(void *) >= 8) ? (1ULL << 40) : (256ULL << 20);
+    static constexpr const char *uri_scheme = "file://";
+
+    inline features provided_features() noexcept { return features::stable_values | features::atomic_snapshots | features::atomic_transactions; }
+
+    struct header
+    {
+      uint64_t magic;                             // Written last when the store is created
+      uint32_t key_size;                          // Bytes in every key
+      uint32_t slot_size;                         // Bytes in every slot
+      uint64_t entries;                           // Slots in the index, always a power of two
+      std::atomic<uint64_t> transaction_counter;  // Incremented by every write and commit
+      std::atomic<uint64_t> items;                // Keys in the store
+      std::atomic<uint64_t> bytes_stored;         // Sum of the lengths of the current values
+      std::atomic<uint64_t> values_tail;          // Where the next value will be appended
+      std::atomic<uint64_t> items_quota;          // Zero means no quota
+      std::atomic<uint64_t> bytes_quota;          // Zero means no quota
+    };
+    static_assert(sizeof(header) <= header_size, "header does not fit into its page");
+
+    struct slot
+    {
+      std::atomic<uint64_t> sequence;  // Zero if unused, odd whilst the value location is being replaced
+      std::atomic<uint64_t> offset;    // Of the current value in the values file
+      std::atomic<uint64_t> length;    // Of the current value
+      uint64_t hash;                   // Of the key, which follows padded to eight bytes
+
+      byte *key() noexcept { return reinterpret_cast<byte *>(this + 1); }
+    };
+    static_assert(sizeof(slot) == 32, "slot is not thirty-two bytes");
+
+    // Where a key's value was at some moment. A zero sequence means no value.
+    struct location
+    {
+      uint64_t sequence{0}, offset{0}, length{0};
+    };
+
+    inline bool matches(const byte *key, size_type key_size, key_type mask, key_type bits) noexcept
+    {
+      auto *k = reinterpret_cast<const unsigned char *>(key);
+      auto *m = reinterpret_cast<const unsigned char *>(mask.data());
+      auto *b = reinterpret_cast<const unsigned char *>(bits.data());
+      for(size_t n = 0; n < key_size && n < mask.size(); n++)
+      {
+        const unsigned char bit = (n < bits.size()) ? b[n] : 0;
+        if((k[n] & m[n]) != (bit & m[n]))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Returns the buffers pointing into `length` bytes at `data`, as per `mapped_file_handle::read()`
+    inline io_result<buffers_type> fill_buffers(io_request<buffers_type> reqs, byte *data, uint64_t length) noexcept
+    {
+      uint64_t offset = reqs.offset;
+      size_t n = 0;
+      for(auto &b : reqs.buffers)
+      {
+        if(offset >= length)
+        {
+          break;
+        }
+        const auto bytes = (size_type) std::min<uint64_t>(b.size(), length - offset);
+        b = buffer_type(data + offset, bytes);
+        offset += bytes;
+        n++;
+      }
+      return reqs.buffers.subspan(0, n);
+    }
+
+    struct state
+    {
+      basic_key_value_store::uri_type uri;
+      basic_key_value_store::mode mode{basic_key_value_store::mode::read};
+      llfio::directory_handle dir;
+      llfio::mapped_file_handle index, values;
+      std::mutex writerlock;                   // Serialises writers within this process
+      std::mutex maplock;                      // Serialises changing the map of the values
+      std::atomic<uint64_t> values_mapped{0};  // How much of the values is currently mapped
+      header *h{nullptr};
+      byte *slots{nullptr};
+
+      struct writer_guard
+      {
+        std::unique_lock<std::mutex> local;
+        llfio::file_handle::extent_guard global;
+      };
+
+      slot &at(uint64_t idx) noexcept { return *reinterpret_cast<slot *>(slots + idx * h->slot_size); }
+      size_type key_size() const noexcept { return h->key_size; }
+
+      static uint64_t hash(key_type key) noexcept
+      {
+        auto ret = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(reinterpret_cast<const char *>(key.data()), key.size());
+        return ret.as_longlongs[0] ^ ret.as_longlongs[1];
+      }
+
+      // Returns the slot with the key, or the unused slot where it would be inserted, or null if the index is full
+      slot *find(key_type key, uint64_t keyhash) noexcept
+      {
+        const uint64_t mask = h->entries - 1;
+        uint64_t idx = keyhash & mask;
+        for(uint64_t n = 0; n < h->entries; n++, idx = (idx + 1) & mask)
+        {
+          slot &s = at(idx);
+          if(s.sequence.load(std::memory_order_acquire) == 0)
+          {
+            return &s;
+          }
+          if(s.hash == keyhash && 0 == memcmp(s.key(), key.data(), key.size()))
+          {
+            return &s;
+          }
+        }
+        return nullptr;
+      }
+
+      static location load(slot &s) noexcept
+      {
+        for(;;)
+        {
+          location ret;
+          ret.sequence = s.sequence.load(std::memory_order_acquire);
+          if((ret.sequence & 1) != 0)
+          {
+            std::this_thread::yield();
+            continue;
+          }
+          ret.offset = s.offset.load(std::memory_order_relaxed);
+          ret.length = s.length.load(std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if(s.sequence.load(std::memory_order_relaxed) == ret.sequence)
+          {
+            return ret;
+          }
+        }
+      }
+
+      result<location> lookup(key_type key) noexcept
+      {
+        if(key.size() != key_size())
+        {
+          return llfio::errc::invalid_argument;
+        }
+        slot *s = find(key, hash(key));
+        if(s == nullptr)
+        {
+          return location();
+        }
+        return load(*s);
+      }
+
+      result<writer_guard> lock(llfio::deadline d = llfio::deadline()) noexcept
+      {
+        writer_guard ret;
+        ret.local = std::unique_lock<std::mutex>(writerlock);
+        OUTCOME_TRY(auto &&g, index.lock_file_range(writer_lock_offset, 1, llfio::lock_kind::exclusive, d));
+        ret.global = std::move(g);
+        return {std::move(ret)};
+      }
+
+      // Ensures the values are mapped up to `end`
+      result<void> map_values(uint64_t end) noexcept
+      {
+        if(end <= values_mapped.load(std::memory_order_acquire))
+        {
+          return llfio::success();
+        }
+        std::lock_guard<std::mutex> g(maplock);
+        OUTCOME_TRY(auto &&length, values.update_map());
+        values_mapped.store(length, std::memory_order_release);
+        if(end > length)
+        {
+          // The value has been cleared
+          return llfio::errc::no_such_file_or_directory;
+        }
+        return llfio::success();
+      }
+
+      result<byte *> value_address(const location &l) noexcept
+      {
+        if(l.sequence == 0)
+        {
+          return llfio::errc::no_such_file_or_directory;
+        }
+        OUTCOME_TRY(map_values(l.offset + l.length));
+        return values.address() + l.offset;
+      }
+
+      // Must hold the writer lock
+      result<uint64_t> append(span<const const_buffer_type> buffers, uint64_t bytes) noexcept
+      {
+        const uint64_t offset = h->values_tail.load(std::memory_order_relaxed);
+        const uint64_t end = offset + ((bytes + 63) & ~63ULL);
+        if(end > values.capacity())
+        {
+          return llfio::errc::file_too_large;
+        }
+        if(end > values_mapped.load(std::memory_order_relaxed))
+        {
+          std::lock_guard<std::mutex> g(maplock);
+          OUTCOME_TRY(auto &&mapped, values.update_map());
+          uint64_t length = mapped;
+          if(end > length)
+          {
+            OUTCOME_TRY(auto &&truncated, values.truncate(std::min<uint64_t>((end + values_growth - 1) / values_growth * values_growth, values.capacity())));
+            length = truncated;
+          }
+          values_mapped.store(length, std::memory_order_release);
+        }
+        byte *p = values.address() + offset;
+        for(auto &b : buffers)
+        {
+          memcpy(p, b.data(), b.size());
+          p += b.size();
+        }
+        h->values_tail.store(end, std::memory_order_release);
+        return offset;
+      }
+
+      // Must hold the writer lock
+      void publish(slot &s, key_type key, uint64_t keyhash, uint64_t offset, uint64_t length) noexcept
+      {
+        const uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+        if(sequence == 0)
+        {
+          memcpy(s.key(), key.data(), key.size());
+          s.hash = keyhash;
+          s.offset.store(offset, std::memory_order_relaxed);
+          s.length.store(length, std::memory_order_relaxed);
+          // Basing new sequences on the transaction counter means a key cleared and written again never repeats a sequence
+          s.sequence.store(2 * (h->transaction_counter.load(std::memory_order_relaxed) + 1), std::memory_order_release);
+          h->items.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+          h->bytes_stored.fetch_sub(s.length.load(std::memory_order_relaxed), std::memory_order_relaxed);
+          s.sequence.store(sequence + 1, std::memory_order_relaxed);
+          std::atomic_thread_fence(std::memory_order_release);
+          s.offset.store(offset, std::memory_order_relaxed);
+          s.length.store(length, std::memory_order_relaxed);
+          s.sequence.store(sequence + 2, std::memory_order_release);
+        }
+        h->bytes_stored.fetch_add(length, std::memory_order_relaxed);
+      }
+
+      struct update
+      {
+        key_type key;
+        span<const const_buffer_type> buffers;
+        uint64_t length;
+      };
+      // Must hold the writer lock. Appends all the values, and only then makes them current.
+      result<void> apply(span<const update> updates) noexcept
+      {
+        std::vector<slot *> targets(updates.size());
+        std::vector<uint64_t> hashes(updates.size()), offsets(updates.size());
+        uint64_t items = h->items.load(std::memory_order_relaxed), bytes = h->bytes_stored.load(std::memory_order_relaxed);
+        for(size_t n = 0; n < updates.size(); n++)
+        {
+          hashes[n] = hash(updates[n].key);
+          targets[n] = find(updates[n].key, hashes[n]);
+          if(targets[n] == nullptr)
+          {
+            return llfio::errc::no_space_on_device;
+          }
+          if(targets[n]->sequence.load(std::memory_order_relaxed) == 0)
+          {
+            items++;
+          }
+          else
+          {
+            bytes -= targets[n]->length.load(std::memory_order_relaxed);
+          }
+          bytes += updates[n].length;
+        }
+        const uint64_t items_quota = h->items_quota.load(std::memory_order_relaxed), bytes_quota = h->bytes_quota.load(std::memory_order_relaxed);
+        // Open addressing degrades badly beyond seven eighths full
+        if(items > h->entries / 8 * 7 || (items_quota != 0 && items > items_quota) || (bytes_quota != 0 && bytes > bytes_quota))
+        {
+          return llfio::errc::no_space_on_device;
+        }
+        for(size_t n = 0; n < updates.size(); n++)
+        {
+          OUTCOME_TRY(offsets[n], append(updates[n].buffers, updates[n].length));
+        }
+        if(values.are_safety_barriers_issued())
+        {
+          OUTCOME_TRY(values.barrier({}, llfio::mapped_file_handle::barrier_kind::wait_data_only));
+        }
+        h->transaction_counter.fetch_add(1, std::memory_order_relaxed);
+        for(size_t n = 0; n < updates.size(); n++)
+        {
+          // An earlier insertion in this batch may have taken the unused slot found for this key
+          if(targets[n]->sequence.load(std::memory_order_relaxed) != 0 && 0 != memcmp(targets[n]->key(), updates[n].key.data(), updates[n].key.size()))
+          {
+            targets[n] = find(updates[n].key, hashes[n]);
+          }
+          publish(*targets[n], updates[n].key, hashes[n], offsets[n], updates[n].length);
+        }
+        if(index.are_safety_barriers_issued())
+        {
+          OUTCOME_TRY(index.barrier({}, llfio::mapped_file_handle::barrier_kind::wait_data_only));
+        }
+        return llfio::success();
+      }
+    };
+
+    // The keys and value locations of a store at a single moment
+    struct contents
+    {
+      struct item
+      {
+        std::string key;
+        location loc;
+      };
+      std::vector<item> items;
+      std::unordered_map<std::string, size_t> lookup;
+      uint64_t bytes{0};
+
+      static key_type to_key(const std::string &v) noexcept { return {reinterpret_cast<const byte *>(v.data()), v.size()}; }
+      static std::string from_key(key_type v) { return std::string(reinterpret_cast<const char *>(v.data()), v.size()); }
+
+      // Must hold the writer lock
+      static result<contents> capture(state &s) noexcept
+      {
+        try
+        {
+          contents ret;
+          ret.items.reserve((size_t) s.h->items.load(std::memory_order_relaxed));
+          for(uint64_t idx = 0; idx < s.h->entries; idx++)
+          {
+            slot &sl = s.at(idx);
+            const location l = state::load(sl);
+            if(l.sequence != 0)
+            {
+              ret.lookup.emplace(std::string(reinterpret_cast<const char *>(sl.key()), s.key_size()), ret.items.size());
+              ret.items.push_back(item{std::string(reinterpret_cast<const char *>(sl.key()), s.key_size()), l});
+              ret.bytes += l.length;
+            }
+          }
+          return {std::move(ret)};
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+
+      const location *find(key_type key) const
+      {
+        auto it = lookup.find(from_key(key));
+        return (it == lookup.end()) ? nullptr : &items[it->second].loc;
+      }
+
+      result<key_type> match(basic_key_value_store::filter_state_type &st, key_type mask, key_type bits) const noexcept
+      {
+        for(; st < items.size(); st++)
+        {
+          const auto &i = items[(size_t) st];
+          if(matches(reinterpret_cast<const byte *>(i.key.data()), i.key.size(), mask, bits))
+          {
+            st++;
+            return to_key(i.key);
+          }
+        }
+        return llfio::errc::no_such_file_or_directory;
+      }
+    };
+
+    inline basic_key_value_store::capacity_type to_capacity(uint64_t v) noexcept
+    {
+      basic_key_value_store::capacity_type ret;
+      ret.as_longlongs[0] = v;
+      ret.as_longlongs[1] = 0;
+      return ret;
+    }
+    inline result<uint64_t> from_capacity(basic_key_value_store::capacity_type v) noexcept
+    {
+      if(v.as_longlongs[1] != 0)
+      {
+        return llfio::errc::value_too_large;
+      }
+      return v.as_longlongs[0];
+    }
+
+    class store final : public basic_key_value_store
+    {
+      std::shared_ptr<state> _state;
+
+    public:
+      explicit store(std::shared_ptr<state> s)
+          : _state(std::move(s))
+      {
+        _uri = _state->uri;
+        _key_size = _state->key_size();
+      }
+
+      virtual result<uri_type> uri() noexcept override { return _state->uri; }
+      virtual bool empty() const noexcept override { return _state->h->items.load(std::memory_order_relaxed) == 0; }
+      virtual result<capacity_type> max_size() const noexcept override
+      {
+        const uint64_t quota = _state->h->items_quota.load(std::memory_order_relaxed);
+        return to_capacity((quota != 0) ? quota : _state->h->entries / 8 * 7);
+      }
+      virtual result<void> max_size(capacity_type quota) noexcept override
+      {
+        OUTCOME_TRY(auto &&v, from_capacity(quota));
+        if(v > _state->h->entries / 8 * 7)
+        {
+          return llfio::errc::value_too_large;
+        }
+        _state->h->items_quota.store(v, std::memory_order_relaxed);
+        return llfio::success();
+      }
+      virtual result<capacity_type> size() const noexcept override { return to_capacity(_state->h->items.load(std::memory_order_relaxed)); }
+      virtual result<capacity_type> max_bytes_stored() const noexcept override
+      {
+        const uint64_t quota = _state->h->bytes_quota.load(std::memory_order_relaxed);
+        return to_capacity((quota != 0) ? quota : _state->values.capacity());
+      }
+      virtual result<void> max_bytes_stored(capacity_type quota) noexcept override
+      {
+        OUTCOME_TRY(auto &&v, from_capacity(quota));
+        _state->h->bytes_quota.store(v, std::memory_order_relaxed);
+        return llfio::success();
+      }
+      virtual result<capacity_type> bytes_stored() const noexcept override { return to_capacity(_state->h->bytes_stored.load(std::memory_order_relaxed)); }
+      virtual result<extent_type> max_value_size() const noexcept override { return mapped_index::max_value_size; }
+      virtual result<void> key_index_size(size_type bytes) noexcept override
+      {
+        if(bytes != 0)
+        {
+          return llfio::errc::operation_not_supported;
+        }
+        return llfio::success();
+      }
+      virtual result<void> clear() noexcept override
+      {
+        if(_state->mode != mode::write)
+        {
+          return llfio::errc::operation_not_permitted;
+        }
+        OUTCOME_TRY(auto &&g, _state->lock());
+        (void) g;
+        OUTCOME_TRY(_state->index.zero({header_size, _state->h->entries * _state->h->slot_size}));
+        _state->h->items.store(0, std::memory_order_relaxed);
+        _state->h->bytes_stored.store(0, std::memory_order_relaxed);
+        _state->h->transaction_counter.fetch_add(1, std::memory_order_relaxed);
+        // Values are deallocated rather than truncated, as readers elsewhere may still have them mapped
+        const uint64_t tail = _state->h->values_tail.load(std::memory_order_relaxed);
+        if(tail > 0)
+        {
+          OUTCOME_TRY(_state->map_values(tail));
+          OUTCOME_TRY(_state->values.zero({0, tail}));
+        }
+        return llfio::success();
+      }
+      virtual result<key_type> match(filter_state_type &st, key_type mask = {}, key_type bits = {}) noexcept override
+      {
+        for(; st < _state->h->entries; st++)
+        {
+          slot &s = _state->at(st);
+          if(s.sequence.load(std::memory_order_acquire) != 0 && matches(s.key(), _key_size, mask, bits))
+          {
+            st++;
+            return key_type(s.key(), _key_size);
+          }
+        }
+        return llfio::errc::no_such_file_or_directory;
+      }
+      virtual result<handle_type> open(key_type /*unused*/, mode /*unused*/ = mode::read) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual io_result<buffers_type> read(io_request<buffers_type> reqs, key_type key, llfio::deadline /*unused*/ = llfio::deadline()) noexcept override
+      {
+        OUTCOME_TRY(auto &&l, _state->lookup(key));
+        OUTCOME_TRY(auto &&addr, _state->value_address(l));
+        return fill_buffers(reqs, addr, l.length);
+      }
+      virtual io_result<const_buffers_type> write(key_type key, io_request<const_buffers_type> reqs, llfio::deadline d = llfio::deadline()) noexcept override
+      {
+        if(_state->mode != mode::write)
+        {
+          return llfio::errc::operation_not_permitted;
+        }
+        // Values are stable, so only whole values can be written
+        if(key.size() != _key_size || reqs.offset != 0)
+        {
+          return llfio::errc::invalid_argument;
+        }
+        uint64_t bytes = 0;
+        for(auto &b : reqs.buffers)
+        {
+          bytes += b.size();
+        }
+        if(bytes > mapped_index::max_value_size)
+        {
+          return llfio::errc::value_too_large;
+        }
+        OUTCOME_TRY(auto &&g, _state->lock(d));
+        (void) g;
+        const state::update u{key, reqs.buffers, bytes};
+        OUTCOME_TRY(_state->apply({&u, 1}));
+        return reqs.buffers;
+      }
+      inline virtual result<std::unique_ptr<basic_key_value_store>> snapshot() noexcept override;
+      inline virtual result<std::unique_ptr<basic_key_value_store::transaction>> begin_transaction() noexcept override;
+    };
+
+    class snapshot_store final : public basic_key_value_store
+    {
+      std::shared_ptr<state> _state;
+      contents _contents;
+
+    public:
+      snapshot_store(std::shared_ptr<state> s, contents c)
+          : _state(std::move(s))
+          , _contents(std::move(c))
+      {
+        _uri = _state->uri;
+        _key_size = _state->key_size();
+      }
+
+      virtual result<uri_type> uri() noexcept override { return _state->uri; }
+      virtual bool empty() const noexcept override { return _contents.items.empty(); }
+      virtual result<capacity_type> max_size() const noexcept override { return to_capacity(_contents.items.size()); }
+      virtual result<void> max_size(capacity_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<capacity_type> size() const noexcept override { return to_capacity(_contents.items.size()); }
+      virtual result<capacity_type> max_bytes_stored() const noexcept override { return to_capacity(_contents.bytes); }
+      virtual result<void> max_bytes_stored(capacity_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<capacity_type> bytes_stored() const noexcept override { return to_capacity(_contents.bytes); }
+      virtual result<extent_type> max_value_size() const noexcept override { return mapped_index::max_value_size; }
+      virtual result<void> key_index_size(size_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<void> clear() noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<key_type> match(filter_state_type &st, key_type mask = {}, key_type bits = {}) noexcept override { return _contents.match(st, mask, bits); }
+      virtual result<handle_type> open(key_type /*unused*/, mode /*unused*/ = mode::read) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual io_result<buffers_type> read(io_request<buffers_type> reqs, key_type key, llfio::deadline /*unused*/ = llfio::deadline()) noexcept override
+      {
+        try
+        {
+          const location *l = _contents.find(key);
+          if(l == nullptr)
+          {
+            return llfio::errc::no_such_file_or_directory;
+          }
+          OUTCOME_TRY(auto &&addr, _state->value_address(*l));
+          return fill_buffers(reqs, addr, l->length);
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+      virtual io_result<const_buffers_type> write(key_type /*unused*/, io_request<const_buffers_type> /*unused*/, llfio::deadline /*unused*/ = llfio::deadline()) noexcept override
+      {
+        return llfio::errc::operation_not_supported;
+      }
+      virtual result<std::unique_ptr<basic_key_value_store>> snapshot() noexcept override
+      {
+        try
+        {
+          return std::unique_ptr<basic_key_value_store>(std::make_unique<snapshot_store>(_state, _contents));
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+      virtual result<std::unique_ptr<basic_key_value_store::transaction>> begin_transaction() noexcept override { return llfio::errc::operation_not_supported; }
+    };
+
+    class transaction_store final : public basic_key_value_store::transaction
+    {
+      std::shared_ptr<state> _state;
+      contents _contents;
+      std::unordered_map<std::string, std::vector<byte>> _writes;
+      std::unordered_map<std::string, uint64_t> _dependencies;  // key to sequence when snapshotted
+
+      void _depend(key_type key)
+      {
+        const location *l = _contents.find(key);
+        _dependencies.emplace(contents::from_key(key), (l == nullptr) ? 0 : l->sequence);
+      }
+
+    public:
+      transaction_store(std::shared_ptr<state> s, contents c)
+          : _state(std::move(s))
+          , _contents(std::move(c))
+      {
+        _uri = _state->uri;
+        _key_size = _state->key_size();
+      }
+
+      virtual result<uri_type> uri() noexcept override { return _state->uri; }
+      virtual bool empty() const noexcept override { return _contents.items.empty(); }
+      virtual result<capacity_type> max_size() const noexcept override
+      {
+        const uint64_t quota = _state->h->items_quota.load(std::memory_order_relaxed);
+        return to_capacity((quota != 0) ? quota : _state->h->entries / 8 * 7);
+      }
+      virtual result<void> max_size(capacity_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<capacity_type> size() const noexcept override { return to_capacity(_contents.items.size()); }
+      virtual result<capacity_type> max_bytes_stored() const noexcept override
+      {
+        const uint64_t quota = _state->h->bytes_quota.load(std::memory_order_relaxed);
+        return to_capacity((quota != 0) ? quota : _state->values.capacity());
+      }
+      virtual result<void> max_bytes_stored(capacity_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<capacity_type> bytes_stored() const noexcept override { return to_capacity(_contents.bytes); }
+      virtual result<extent_type> max_value_size() const noexcept override { return mapped_index::max_value_size; }
+      virtual result<void> key_index_size(size_type /*unused*/) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<void> clear() noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<key_type> match(filter_state_type &st, key_type mask = {}, key_type bits = {}) noexcept override { return _contents.match(st, mask, bits); }
+      virtual result<handle_type> open(key_type /*unused*/, mode /*unused*/ = mode::read) noexcept override { return llfio::errc::operation_not_supported; }
+      virtual io_result<buffers_type> read(io_request<buffers_type> reqs, key_type key, llfio::deadline /*unused*/ = llfio::deadline()) noexcept override
+      {
+        try
+        {
+          auto it = _writes.find(contents::from_key(key));
+          if(it != _writes.end())
+          {
+            return fill_buffers(reqs, it->second.data(), it->second.size());
+          }
+          _depend(key);
+          const location *l = _contents.find(key);
+          if(l == nullptr)
+          {
+            return llfio::errc::no_such_file_or_directory;
+          }
+          OUTCOME_TRY(auto &&addr, _state->value_address(*l));
+          return fill_buffers(reqs, addr, l->length);
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+      virtual io_result<const_buffers_type> write(key_type key, io_request<const_buffers_type> reqs, llfio::deadline /*unused*/ = llfio::deadline()) noexcept override
+      {
+        if(_state->mode != mode::write)
+        {
+          return llfio::errc::operation_not_permitted;
+        }
+        if(key.size() != _key_size || reqs.offset != 0)
+        {
+          return llfio::errc::invalid_argument;
+        }
+        try
+        {
+          std::vector<byte> value;
+          for(auto &b : reqs.buffers)
+          {
+            value.insert(value.end(), b.data(), b.data() + b.size());
+          }
+          if(value.size() > mapped_index::max_value_size)
+          {
+            return llfio::errc::value_too_large;
+          }
+          _writes[contents::from_key(key)] = std::move(value);
+          return reqs.buffers;
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+      virtual result<std::unique_ptr<basic_key_value_store>> snapshot() noexcept override { return llfio::errc::operation_not_supported; }
+      virtual result<std::unique_ptr<basic_key_value_store::transaction>> begin_transaction() noexcept override { return llfio::errc::operation_not_supported; }
+
+      virtual result<void> dependencies(span<key_type> keys) noexcept override
+      {
+        try
+        {
+          for(auto &key : keys)
+          {
+            if(key.size() != _key_size)
+            {
+              return llfio::errc::invalid_argument;
+            }
+            _depend(key);
+          }
+          return llfio::success();
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+      virtual result<void> commit() noexcept override
+      {
+        try
+        {
+          OUTCOME_TRY(auto &&g, _state->lock());
+          (void) g;
+          for(auto &dep : _dependencies)
+          {
+            OUTCOME_TRY(auto &&l, _state->lookup(contents::to_key(dep.first)));
+            if(l.sequence != dep.second)
+            {
+              return llfio::errc::resource_unavailable_try_again;  // kvstore_errc::transaction_aborted_collision
+            }
+          }
+          std::vector<const_buffer_type> buffers;
+          std::vector<state::update> updates;
+          buffers.reserve(_writes.size());
+          updates.reserve(_writes.size());
+          for(auto &w : _writes)
+          {
+            buffers.push_back(const_buffer_type(w.second.data(), w.second.size()));
+            updates.push_back(state::update{contents::to_key(w.first), {&buffers.back(), 1}, w.second.size()});
+          }
+          OUTCOME_TRY(_state->apply(updates));
+          _writes.clear();
+          _dependencies.clear();
+          return llfio::success();
+        }
+        catch(...)
+        {
+          return llfio::error_from_exception();
+        }
+      }
+    };
+
+    inline result<std::unique_ptr<basic_key_value_store>> store::snapshot() noexcept
+    {
+      try
+      {
+        // Taking the writer lock excludes commits, so the snapshot is atomic
+        OUTCOME_TRY(auto &&g, _state->lock());
+        (void) g;
+        OUTCOME_TRY(auto &&c, contents::capture(*_state));
+        return std::unique_ptr<basic_key_value_store>(std::make_unique<snapshot_store>(_state, std::move(c)));
+      }
+      catch(...)
+      {
+        return llfio::error_from_exception();
+      }
+    }
+
+    inline result<std::unique_ptr<basic_key_value_store::transaction>> store::begin_transaction() noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&g, _state->lock());
+        (void) g;
+        OUTCOME_TRY(auto &&c, contents::capture(*_state));
+        return std::unique_ptr<basic_key_value_store::transaction>(std::make_unique<transaction_store>(_state, std::move(c)));
+      }
+      catch(...)
+      {
+        return llfio::error_from_exception();
+      }
+    }
+
+    inline result<llfio::path_view> path_from_uri(const basic_key_value_store::uri_type &uri) noexcept
+    {
+      const size_t schemelen = strlen(uri_scheme);
+      if(uri.size() <= schemelen || 0 != uri.compare(0, schemelen, uri_scheme))
+      {
+        return llfio::errc::invalid_argument;  // kvstore_errc::invalid_uri
+      }
+      return llfio::path_view(uri.c_str() + schemelen, uri.size() - schemelen, llfio::path_view::zero_terminated);
+    }
+
+    inline int score(const basic_key_value_store_info::uri_type &uri, basic_key_value_store::mode /*unused*/, basic_key_value_store::creation _creation)
+    {
+      auto path = path_from_uri(uri);
+      if(!path)
+      {
+        return -1;
+      }
+      const bool may_create = (_creation != basic_key_value_store::creation::open_existing);
+      auto dirh = llfio::directory_handle::directory({}, path.value());
+      if(!dirh)
+      {
+        return may_create ? 1 : -1;
+      }
+      auto fh = llfio::file_handle::file(dirh.value(), "index");
+      if(!fh)
+      {
+        return may_create ? 1 : -1;
+      }
+      uint64_t v = 0;
+      auto read = fh.value().read(0, {{reinterpret_cast<byte *>(&v), sizeof(v)}});
+      if(!read || read.value().empty() || read.value()[0].size() != sizeof(v))
+      {
+        return may_create ? 1 : 0;
+      }
+      return (v == magic) ? 1 : 0;
+    }
+
+    // Must hold the writer lock, and the index must be zero length
+    inline result<void> initialise(state &s, size_type key_size) noexcept
+    {
+      const uint32_t slot_size = (uint32_t) (sizeof(slot) + ((key_size + 7) & ~size_type(7)));
+      OUTCOME_TRY(s.values.truncate(0));
+      OUTCOME_TRY(s.index.truncate(header_size + default_entries * slot_size));
+      auto *h = reinterpret_cast<header *>(s.index.address());
+      h->key_size = (uint32_t) key_size;
+      h->slot_size = slot_size;
+      h->entries = default_entries;
+      h->transaction_counter.store(0, std::memory_order_relaxed);
+      h->items.store(0, std::memory_order_relaxed);
+      h->bytes_stored.store(0, std::memory_order_relaxed);
+      h->values_tail.store(0, std::memory_order_relaxed);
+      h->items_quota.store(0, std::memory_order_relaxed);
+      h->bytes_quota.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      h->magic = magic;
+      if(s.index.are_safety_barriers_issued())
+      {
+        OUTCOME_TRY(s.index.barrier({}, llfio::mapped_file_handle::barrier_kind::wait_data_only));
+      }
+      return llfio::success();
+    }
+
+    inline result<std::unique_ptr<basic_key_value_store>> create(const basic_key_value_store_info::uri_type &uri, size_type key_size, features _features, basic_key_value_store::mode _mode,
+                                                                 basic_key_value_store::creation _creation, basic_key_value_store::caching _caching)
+    {
+      using mode = basic_key_value_store::mode;
+      using creation = basic_key_value_store::creation;
+      try
+      {
+        if(!!(_features & ~(provided_features() | features::none)))
+        {
+          return llfio::errc::operation_not_supported;
+        }
+        if(key_size > max_key_size || (key_size == 0 && _creation != creation::open_existing))
+        {
+          return llfio::errc::invalid_argument;
+        }
+        if(_mode != mode::write && _creation != creation::open_existing)
+        {
+          return llfio::errc::invalid_argument;
+        }
+        OUTCOME_TRY(auto &&path, path_from_uri(uri));
+        auto s = std::make_shared<state>();
+        s->uri = uri;
+        s->mode = (_mode == mode::write) ? mode::write : mode::read;
+        OUTCOME_TRY(s->dir, llfio::directory_handle::directory({}, path, (_creation == creation::open_existing) ? llfio::directory_handle::mode::read : llfio::directory_handle::mode::write,
+                                                                (_creation == creation::open_existing) ? llfio::directory_handle::creation::open_existing : llfio::directory_handle::creation::if_needed));
+        bool initialising = false;
+        if(_creation != creation::open_existing)
+        {
+          auto r = llfio::mapped_file_handle::mapped_file(0, s->dir, "index", mode::write, creation::only_if_not_exist, _caching);
+          if(r)
+          {
+            s->index = std::move(r).value();
+            initialising = true;
+          }
+          else if(r.error() != llfio::errc::file_exists || _creation == creation::only_if_not_exist)
+          {
+            return std::move(r).error();
+          }
+          else
+          {
+            initialising = (_creation == creation::truncate_existing || _creation == creation::always_new);
+          }
+        }
+        if(!s->index.is_valid())
+        {
+          OUTCOME_TRY(s->index, llfio::mapped_file_handle::mapped_file(0, s->dir, "index", s->mode, creation::open_existing, _caching));
+        }
+        OUTCOME_TRY(s->values, llfio::mapped_file_handle::mapped_file((size_type) values_reservation, s->dir, "values", s->mode,
+                                                                       initialising ? creation::if_needed : creation::open_existing, _caching));
+        if(initialising)
+        {
+          OUTCOME_TRY(auto &&g, s->lock());
+          (void) g;
+          OUTCOME_TRY(s->index.truncate(0));
+          OUTCOME_TRY(initialise(*s, key_size));
+        }
+        else
+        {
+          // The creator holds the writer lock until the header is complete, but may not have taken it yet
+          const auto begin = std::chrono::steady_clock::now();
+          for(;;)
+          {
+            {
+              OUTCOME_TRY(auto &&g, s->index.lock_file_range(writer_lock_offset, 1, llfio::lock_kind::shared));
+              (void) g;
+              OUTCOME_TRY(auto &&length, s->index.update_map());
+              if(length >= header_size && reinterpret_cast<header *>(s->index.address())->magic == magic)
+              {
+                break;
+              }
+              if(length >= header_size)
+              {
+                return llfio::errc::invalid_argument;  // not this kind of store
+              }
+            }
+            if(std::chrono::steady_clock::now() - begin > std::chrono::seconds(5))
+            {
+              return llfio::errc::timed_out;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          }
+        }
+        s->h = reinterpret_cast<header *>(s->index.address());
+        s->slots = s->index.address() + header_size;
+        if(key_size != 0 && key_size != s->h->key_size)
+        {
+          return llfio::errc::invalid_argument;
+        }
+        OUTCOME_TRY(auto &&mapped, s->values.update_map());
+        s->values_mapped.store(mapped, std::memory_order_relaxed);
+        return std::unique_ptr<basic_key_value_store>(std::make_unique<store>(std::move(s)));
+      }
+      catch(...)
+      {
+        return llfio::error_from_exception();
+      }
+    }
+
+    inline basic_key_value_store_info info() noexcept
+    {
+      basic_key_value_store_info ret{};
+      ret.name = "mapped_index";
+      ret.min_key_size = 1;
+      ret.max_key_size = max_key_size;
+      ret.min_value_size = 0;
+      ret.max_value_size = mapped_index::max_value_size;
+      ret.features = provided_features();
+      ret.score = score;
+      ret.create = create;
+      return ret;
+    }
+  }  // namespace mapped_index
+}  // namespace detail
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::unique_ptr<basic_key_value_store>> create_kvstore(const basic_key_value_store::uri_type &uri, basic_key_value_store::size_type key_size,
+                                                                                           basic_key_value_store::features _features, basic_key_value_store::mode _mode,
+                                                                                           basic_key_value_store::creation _creation, basic_key_value_store::caching _caching)
+{
+  basic_key_value_store_info stores[1];
+  OUTCOME_TRY(auto &&available, enumerate_kvstores(stores));
+  const basic_key_value_store_info *best = nullptr;
+  int bestscore = -1;
+  bool incompatible = false;
+  for(auto &i : available)
+  {
+    if(!!(_features & ~(i.features | basic_key_value_store::features::none)) || key_size > i.max_key_size)
+    {
+      continue;
+    }
+    const int score = i.score(uri, _mode, _creation);
+    incompatible = incompatible || (score == 0);
+    if(score > bestscore && score > 0)
+    {
+      best = &i;
+      bestscore = score;
+    }
+  }
+  if(best == nullptr)
+  {
+    // kvstore_errc::unsupported_uri
+    return incompatible ? llfio::errc::invalid_argument : llfio::errc::operation_not_supported;
+  }
+  return best->create(uri, key_size, _features, _mode, _creation, _caching);
+}
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::unique_ptr<basic_key_value_store>> open_kvstore(const basic_key_value_store::uri_type &uri, basic_key_value_store::mode _mode,
+                                                                                         basic_key_value_store::caching _caching)
+{
+  return create_kvstore(uri, 0, basic_key_value_store::features::none, _mode, basic_key_value_store::creation::open_existing, _caching);
+}
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<span<basic_key_value_store_info>> enumerate_kvstores(span<basic_key_value_store_info> lst)
+{
+  if(lst.empty())
+  {
+    return lst;
+  }
+  lst[0] = detail::mapped_index::info();
+  return lst.subspan(0, 1);
+}
+
+KVSTORE_V1_NAMESPACE_END
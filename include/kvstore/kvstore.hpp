@@ -28,6 +28,9 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../llfio/v2.0/file_handle.hpp"
 
 #include "quickcpplib/memory_resource.hpp"
+#include "quickcpplib/uint128.hpp"
+
+#include <memory>
 
 //! \file kvstore.hpp Provides the abstract interface for a key-value store.
 
@@ -127,6 +130,8 @@ namespace traits
       };
     };
     template <template <class...> class T, class... Ts> using test_apply = impl::test_apply<T, impl::types<Ts...>>;
+    using llfio::in_place_attach;
+    using llfio::in_place_detach;
     template <class T, class... Args> span<byte> _do_attach_object_instance(T &, span<byte> b) { return in_place_attach<T>(b); }
     template <class T, class... Args> span<byte> _do_detach_object_instance(T &, span<byte> b) { return in_place_detach<T>(b); }
 
@@ -187,7 +192,10 @@ namespace traits
 }
 
 /*! The error codes specific to `basic_key_value_store`. Note the `std::errc` equivalent
-codes may also be returned e.g. `std::errc::insufficient_disk_space`.
+codes may also be returned e.g. `std::errc::no_space_on_device`. The built-in stores
+currently only return the `std::errc` equivalents, which are `errc::invalid_argument` for
+`invalid_uri`, `errc::operation_not_supported` for `unsupported_uri` and `unsupported_integrity`,
+and `errc::resource_unavailable_try_again` for `transaction_aborted_collision`.
 */
 enum class kvstore_errc
 {
@@ -198,6 +206,8 @@ enum class kvstore_errc
   transaction_aborted_collision,  //!< The transaction could not be committed due to dependent key update.
 };
 
+class basic_key_value_store;
+
 /*! \brief Information about an available key value store implementation.
 */
 struct basic_key_value_store_info
@@ -245,13 +255,15 @@ struct basic_key_value_store_info
   int (*score)(const uri_type &uri, handle_type::mode, handle_type::creation creation);
   /*! Construct a store implementation.
   */
-  result<basic_key_value_store> (*create)(const basic_key_value_store::uri_type &uri, size_type key_size, features _features, mode _mode, creation _creation, caching _caching);
+  result<std::unique_ptr<basic_key_value_store>> (*create)(const uri_type &uri, size_type key_size, features _features, mode _mode, creation _creation, caching _caching);
 };
 
 /*! \class basic_key_value_store
 \brief A possibly hardware-implemented basic key-value store.
 
-\warning This class has not been implemented nor will be any time soon. It is here for various folk to study the API design.
+Stores are opened using `create_kvstore()` or `open_kvstore()`, which return a pointer
+to an implementation of this abstract interface. Snapshots and transactions are also
+returned by pointer, and they must not outlive the store they came from.
 
 Reference document https://www.snia.org/sites/default/files/technical_work/PublicReview/KV%20Storage%20API%200.16.pdf
 */
@@ -305,6 +317,8 @@ protected:
   capacity_type _items_quota{0}, _bytes_quota{0};
   allocator_type _allocator{};
 
+  //! Default constructor
+  basic_key_value_store() = default;
   // Cannot be copied
   basic_key_value_store(const basic_key_value_store &) = delete;
   basic_key_value_store &operator=(const basic_key_value_store &) = delete;
@@ -361,7 +375,8 @@ public:
   virtual result<void> clear() noexcept = 0;
   //! The state type for performing a filtered match
   using filter_state_type = uint64_t;
-  /*! Returns the first or next key in the store matching the given filter. This call is racy, and
+  /*! Returns the first or next key in the store matching the given filter. The key returned
+  remains valid until the store, snapshot or transaction it came from is destroyed or cleared. This call is racy, and
   filter processing may take as much time as iterating the entire contents of the store unless
   the mask **exactly** matches any key index, in which case it shall be constant time. Note
   that some hardware devices perform filter matching on-device, which does not change the
@@ -371,7 +386,7 @@ public:
   `errc::no_such_file_or_directory` will be returned if no more keys match. The default
   initialised mask and bits causes matching of all keys in the store.
   */
-  virtual result<void> match(filter_state_type &state, key_type mask = {}, key_type bits = {}) noexcept = 0;
+  virtual result<key_type> match(filter_state_type &state, key_type mask = {}, key_type bits = {}) noexcept = 0;
 
   /*! Returns a handle type which gives access to a key's value. The lifetime of the
   returned handle *may* pin the key's value at the time of retrieval if this store
@@ -445,7 +460,7 @@ public:
   If a store implementation does not implement `features::atomic_snapshot`, this function returns
   an error code comparing equal to `errc::operation_not_supported`.
   */
-  virtual result<basic_key_value_store> snapshot() noexcept = 0;
+  virtual result<std::unique_ptr<basic_key_value_store>> snapshot() noexcept = 0;
 
   class transaction;
   /*! Begin a transaction on this key value store.
@@ -459,11 +474,14 @@ public:
   If a store implementation does not implement `features::atomic_transactions`, this function returns
   an error code comparing equal to `errc::operation_not_supported`.
   */
-  virtual result<transaction> begin_transaction() noexcept = 0;
+  virtual result<std::unique_ptr<transaction>> begin_transaction() noexcept = 0;
 };
 
 class basic_key_value_store::transaction : public basic_key_value_store
 {
+protected:
+  transaction() = default;
+
 public:
   //! Indicate that there is a dependency on the snapshotted values of these keys without fetching any values.
   virtual result<void> dependencies(span<key_type> keys) noexcept = 0;
@@ -474,10 +492,21 @@ public:
 /*! \brief Create a new key value store, or open or truncate an existing key value store, using the given URI.
 
 Query the system and/or process registry of key value store providers for an implementation capable of using
-a store at `uri` with the specified key size and features. Guaranteed built-in providers are:
+a store at `uri` with the specified key size and features. A `key_size` of zero when opening an existing store
+means use whatever key size the store was created with. Guaranteed built-in providers are:
 
 - `file://` based providers:
 
+    - `mapped_index`: A directory containing an `index` file, which is a memory mapped open addressed hash
+    table of keys, and a `values` file, to which values are only ever appended. Values are read directly from
+    a memory map of `values` without copying, and as a value's bytes are never overwritten, any value read
+    stays stable even if it is replaced. This store implements `features::stable_values`, `features::atomic_snapshots`
+    and `features::atomic_transactions`. Keys are up to 256 bytes, and any number of threads and processes
+    may read and write the store concurrently. `open()` is not supported, use `read()` instead, which
+    never copies.
+
+    The following `file://` providers are planned, but not implemented yet:
+
     - `directory_simple_legacy`: A very simple FAT-compatible file based store based on turning the key into
     hexadecimal, chopping it into chunks of four (`0x0000 - 0xffff`) such that a hex key `0x01234567890abcdef`'s
     value would be stored in the path `store/01234/5678/90ab/cdef`. Key updates are first written into
@@ -506,17 +535,17 @@ URIs may of course specify other sources of key value store than on the file sys
 registered system-wide implementations available to all programs. The local process may have registered
 additional implementations as well.
 */
-LLFIO_HEADERS_ONLY_FUNC_SPEC result<basic_key_value_store> create_kvstore(const basic_key_value_store::uri_type &uri,                                              //
-                                                                          basic_key_value_store::size_type key_size,                                               //
-                                                                          basic_key_value_store::features _features,                                               //
-                                                                          basic_key_value_store::mode _mode = basic_key_value_store::mode::write,                  //
-                                                                          basic_key_value_store::creation _creation = basic_key_value_store::creation::if_needed,  //
-                                                                          basic_key_value_store::caching _caching = basic_key_value_store::caching::all);
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::unique_ptr<basic_key_value_store>> create_kvstore(const basic_key_value_store::uri_type &uri,                                              //
+                                                                                           basic_key_value_store::size_type key_size,                                               //
+                                                                                           basic_key_value_store::features _features,                                               //
+                                                                                           basic_key_value_store::mode _mode = basic_key_value_store::mode::write,                  //
+                                                                                           basic_key_value_store::creation _creation = basic_key_value_store::creation::if_needed,  //
+                                                                                           basic_key_value_store::caching _caching = basic_key_value_store::caching::all);
 /*! \brief Open an existing key value store. A convenience overload for `create_kvstore()`.
 */
-LLFIO_HEADERS_ONLY_FUNC_SPEC result<basic_key_value_store> open_kvstore(const basic_key_value_store::uri_type &uri,                              //
-                                                                        basic_key_value_store::mode _mode = basic_key_value_store::mode::write,  //
-                                                                        basic_key_value_store::caching _caching = basic_key_value_store::caching::all);
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::unique_ptr<basic_key_value_store>> open_kvstore(const basic_key_value_store::uri_type &uri,                              //
+                                                                                         basic_key_value_store::mode _mode = basic_key_value_store::mode::write,  //
+                                                                                         basic_key_value_store::caching _caching = basic_key_value_store::caching::all);
 
 /*! \brief Fill an array with information about all the key value stores available to this process.
 */
@@ -587,4 +616,10 @@ LLFIO_HEADERS_ONLY_FUNC_SPEC const key_value_store<void *, llfio::section_handle
 
 KVSTORE_V1_NAMESPACE_END
 
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "detail/impl/kvstore.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
 #endif
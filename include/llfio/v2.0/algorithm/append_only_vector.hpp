@@ -0,0 +1,255 @@
+/* A concurrently appendable STL vector using reserved address space for storage
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_APPEND_ONLY_VECTOR_HPP
+#define LLFIO_ALGORITHM_APPEND_ONLY_VECTOR_HPP
+
+#include "../map_handle.hpp"
+#include "../utils.hpp"
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+//! \file append_only_vector.hpp Provides a lock free concurrently appendable STL vector.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \class append_only_vector
+  \brief Provides a lock free append only vector whose items never move, for building large
+  arrays from many threads at once. Requires `T` to be trivially copyable.
+
+  Upon construction the address space for `max_size()` items is reserved using `map_handle::reserve()`,
+  which costs no memory. Appending threads claim slots with a single atomic increment, and
+  memory is committed behind them in chunks of `commit_granularity()` bytes. Each chunk is committed by
+  exactly one thread; appending threads only ever wait for the chunk their own slots lie in. As the
+  storage never moves, pointers and references to items are never invalidated, so readers may
+  use items concurrently with appends.
+
+  An item being appended is only safe for other threads to read once its appending thread
+  has synchronised with them, for example by a release store which they acquire, or by
+  being joined. `size()` counts slots claimed, some of which may still be being written.
+
+  Unlike `trivial_vector`, this vector cannot shrink or be erased from other than by `clear()`, and
+  it is neither copyable nor movable, as appending threads may hold pointers into it.
+  */
+  template <class T> class append_only_vector
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "append_only_vector: Type T is not trivially copyable!");
+
+  public:
+    //! Value type
+    using value_type = T;
+    //! Pointer type
+    using pointer = value_type *;
+    //! Const pointer type
+    using const_pointer = const value_type *;
+    //! Difference type
+    using difference_type = ptrdiff_t;
+    //! Size type
+    using size_type = size_t;
+    //! Reference type
+    using reference = value_type &;
+    //! Const reference type
+    using const_reference = const value_type &;
+    //! Iterator type
+    using iterator = pointer;
+    //! Const iterator type
+    using const_iterator = const_pointer;
+
+  private:
+    map_handle _mh;
+    pointer _begin{nullptr};
+    size_type _max_size{0}, _chunk_bytes{0};
+    std::atomic<size_type> _size{0};
+    // Chunks are claimed, then marked committed, strictly in order
+    std::atomic<size_type> _chunks_claimed{0}, _chunks_committed{0}, _failed_chunk{(std::numeric_limits<size_type>::max)()};
+
+    // Claims and commits the next chunk if nobody else is, returns false if somebody else is
+    bool _commit_next_chunk()
+    {
+      size_type claimed = _chunks_claimed.load(std::memory_order_relaxed);
+      if(claimed * _chunk_bytes >= _mh.length() || !_chunks_claimed.compare_exchange_strong(claimed, claimed + 1, std::memory_order_relaxed))
+      {
+        return false;
+      }
+      const size_type offset = claimed * _chunk_bytes;
+      const size_type bytes = (std::min)(_chunk_bytes, _mh.length() - offset);
+      if(!_mh.commit({_mh.address() + offset, bytes}))
+      {
+        size_type failed = _failed_chunk.load(std::memory_order_relaxed);
+        while(claimed < failed && !_failed_chunk.compare_exchange_weak(failed, claimed, std::memory_order_relaxed))
+        {
+        }
+      }
+      // Earlier chunks may still be being committed by other threads
+      while(_chunks_committed.load(std::memory_order_acquire) != claimed)
+      {
+        std::this_thread::yield();
+      }
+      _chunks_committed.store(claimed + 1, std::memory_order_release);
+      return true;
+    }
+    // Ensures the items before `items` are committed
+    void _ensure_committed(size_type items)
+    {
+      const size_type bytes = items * sizeof(value_type);
+      size_type committed = _chunks_committed.load(std::memory_order_acquire);
+      if(bytes <= committed * _chunk_bytes)
+      {
+        return;
+      }
+      const size_type needed = (bytes + _chunk_bytes - 1) / _chunk_bytes;
+      while(committed < needed)
+      {
+        if(!_commit_next_chunk())
+        {
+          std::this_thread::yield();
+        }
+        committed = _chunks_committed.load(std::memory_order_acquire);
+      }
+      if(needed > _failed_chunk.load(std::memory_order_relaxed))
+      {
+        throw std::bad_alloc();  // NOLINT
+      }
+    }
+    // Claims `count` slots, committing their memory
+    size_type _claim(size_type count)
+    {
+      const size_type idx = _size.fetch_add(count, std::memory_order_relaxed);
+      if(idx + count > _max_size)
+      {
+        throw std::length_error("Max size exceeded");  // NOLINT
+      }
+      _ensure_committed(idx + count);
+      return idx;
+    }
+
+  public:
+    /*! \brief Reserves address space for `max_items` items, which will be committed in chunks of
+    `commit_bytes` (rounded up to the page size) as items are appended.
+    \throws Any of the errors `map_handle::reserve()` can return, as a `std::system_error`.
+    */
+    explicit append_only_vector(size_type max_items, size_type commit_bytes = 2 * 1024 * 1024)
+        : _mh(map_handle::reserve(utils::round_up_to_page_size(max_items * sizeof(value_type), utils::page_size())).value())
+        , _begin(reinterpret_cast<pointer>(_mh.address()))
+        , _max_size(max_items)
+        , _chunk_bytes(utils::round_up_to_page_size((std::max)(commit_bytes, (size_type) 1), utils::page_size()))
+    {
+    }
+    //! Not copyable
+    append_only_vector(const append_only_vector &) = delete;
+    //! Not movable, as appending threads may hold pointers into it
+    append_only_vector(append_only_vector &&) = delete;
+    //! Not copyable
+    append_only_vector &operator=(const append_only_vector &) = delete;
+    //! Not movable, as appending threads may hold pointers into it
+    append_only_vector &operator=(append_only_vector &&) = delete;
+    ~append_only_vector() = default;
+
+    //! Item index, bounds checked
+    reference at(size_type i)
+    {
+      if(i >= size())
+      {
+        throw std::out_of_range("bounds exceeded");  // NOLINT
+      }
+      return _begin[i];
+    }
+    //! Item index, bounds checked
+    const_reference at(size_type i) const
+    {
+      if(i >= size())
+      {
+        throw std::out_of_range("bounds exceeded");  // NOLINT
+      }
+      return _begin[i];
+    }
+    //! Item index, unchecked
+    reference operator[](size_type i) noexcept { return _begin[i]; }
+    //! Item index, unchecked
+    const_reference operator[](size_type i) const noexcept { return _begin[i]; }
+    //! Underlying array, which never moves
+    pointer data() noexcept { return _begin; }
+    //! Underlying array, which never moves
+    const_pointer data() const noexcept { return _begin; }
+
+    //! Iterator to first item
+    iterator begin() noexcept { return _begin; }
+    //! Iterator to first item
+    const_iterator begin() const noexcept { return _begin; }
+    //! Iterator to first item
+    const_iterator cbegin() const noexcept { return _begin; }
+    //! Iterator to after the last slot claimed
+    iterator end() noexcept { return _begin + size(); }
+    //! Iterator to after the last slot claimed
+    const_iterator end() const noexcept { return _begin + size(); }
+    //! Iterator to after the last slot claimed
+    const_iterator cend() const noexcept { return _begin + size(); }
+
+    //! If no slots are claimed
+    bool empty() const noexcept { return size() == 0; }
+    //! Slots claimed, which may include some still being written
+    size_type size() const noexcept { return (std::min)(_size.load(std::memory_order_relaxed), _max_size); }
+    //! Maximum items in container, which is also its capacity
+    size_type max_size() const noexcept { return _max_size; }
+    //! Items in container, which is the same as `max_size()`
+    size_type capacity() const noexcept { return _max_size; }
+    //! The bytes committed at a time
+    size_type commit_granularity() const noexcept { return _chunk_bytes; }
+    //! The bytes currently committed
+    size_type committed_bytes() const noexcept { return (std::min)(_chunks_committed.load(std::memory_order_acquire) * _chunk_bytes, _mh.length()); }
+    /*! \brief Forgets all items, leaving memory committed. Must not be called concurrently with appends.
+    */
+    void clear() noexcept { _size.store(0, std::memory_order_relaxed); }
+
+    //! Appends item, returning its index. Thread safe.
+    size_type push_back(const value_type &v)
+    {
+      const size_type idx = _claim(1);
+      new(_begin + idx) value_type(v);
+      return idx;
+    }
+    //! Appends item, returning a reference to it which is never invalidated. Thread safe.
+    template <class... Args> reference emplace_back(Args &&... args)
+    {
+      const size_type idx = _claim(1);
+      return *new(_begin + idx) value_type(std::forward<Args>(args)...);
+    }
+    /*! \brief Claims `count` contiguous slots, returning a pointer to the first, which the caller is to
+    fill e.g. with `memcpy()`. Thread safe, and cheaper per item than appending items individually.
+    */
+    pointer grow_by(size_type count)
+    {
+      const size_type idx = _claim(count);
+      return _begin + idx;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,207 @@
+/* Atomic durable replacement of whole files, coalescing the directory syncs of concurrent replaces
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_ATOMIC_REPLACE_HPP
+#define LLFIO_ALGORITHM_ATOMIC_REPLACE_HPP
+
+#include "../directory_handle.hpp"
+#include "../file_handle.hpp"
+#include "../utils.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+//! \file atomic_replace.hpp Provides atomic durable replacement of whole files.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief Atomically and durably replaces whole files within a directory, coalescing the syncs of
+  the directory which many concurrent replaces need into as few as possible.
+
+  A replace writes the new contents into a new inode, issues a `barrier()` waiting for it to reach
+  storage, renames it over the file being replaced, and then syncs the directory so the rename
+  reaches storage too. After a power loss, the file therefore has either its old or its new
+  contents, never a mixture. Readers never see a partially written file, and handles open on the
+  old contents keep seeing them.
+
+  The directory sync is the expensive part, and any sync begun after a rename completes makes it
+  durable. So rather than each replace syncing the directory itself, whilst one thread is syncing
+  it the others queue up behind, and the next sync makes all of their renames durable at once.
+  Under concurrency, the rate of replaces is thus bounded by the rate of file barriers, not of
+  directory syncs.
+
+  On Linux, new inodes are created with `file_handle::temp_inode()`, so nothing is left behind by a
+  crash before the rename except for the instant between linking it into the directory under a
+  random name and renaming it over the target. Elsewhere, new inodes are created with
+  `file_handle::uniquely_named_file()`, so a crash before the rename leaves that file behind.
+  */
+  class atomic_replacer
+  {
+  public:
+    //! Statistics about the use of the replacer
+    struct statistics
+    {
+      uint64_t replaces{0};         //!< Replaces committed
+      uint64_t directory_syncs{0};  //!< Syncs of the directory which made them durable
+    };
+
+  private:
+    directory_handle _dirh;
+    mutable std::mutex _lock;
+    std::condition_variable _changed;
+    uint64_t _renamed{0}, _synced{0};  // the number of renames, and how many of those are durable
+    bool _syncing{false};
+    statistics _stats;
+
+    // Returns after a sync of the directory begun after this call
+    result<void> _sync_directory()
+    {
+      std::unique_lock<std::mutex> g(_lock);
+      const uint64_t ticket = ++_renamed;
+      _stats.replaces++;
+      while(_synced < ticket)
+      {
+        if(_syncing)
+        {
+          _changed.wait(g);
+          continue;
+        }
+        _syncing = true;
+        const uint64_t upto = _renamed;
+        g.unlock();
+        auto r = utils::flush_directory(_dirh.native_handle());
+        g.lock();
+        _syncing = false;
+        _changed.notify_all();
+        if(!r)
+        {
+          // Any waiters will try again themselves
+          return std::move(r).error();
+        }
+        _synced = upto;
+        _stats.directory_syncs++;
+      }
+      return success();
+    }
+
+  public:
+    //! Constructs a replacer of files within the directory `dirh`.
+    explicit atomic_replacer(directory_handle &&dirh) noexcept
+        : _dirh(std::move(dirh))
+    {
+    }
+    atomic_replacer(const atomic_replacer &) = delete;
+    atomic_replacer(atomic_replacer &&) = delete;
+    atomic_replacer &operator=(const atomic_replacer &) = delete;
+    atomic_replacer &operator=(atomic_replacer &&) = delete;
+    ~atomic_replacer() = default;
+
+    //! The directory within which files are replaced.
+    const directory_handle &directory() const noexcept { return _dirh; }
+
+    /*! \brief Returns a new inode within the directory, into which to write the new contents of a
+    file before passing it to `commit()`.
+
+    \errors Any of the values `file_handle::temp_inode()` or `file_handle::uniquely_named_file()`
+    can return.
+    */
+    result<file_handle> begin() noexcept
+    {
+#ifdef __linux__
+      auto ret = file_handle::temp_inode(_dirh);
+      if(ret && (ret.value().flags() & file_handle::flag::anonymous_inode))
+      {
+        return ret;
+      }
+      // This filing system can't do O_TMPFILE, so the inode would have to be named anyway
+#endif
+      return file_handle::uniquely_named_file(_dirh, file_handle::mode::write, file_handle::caching::all);
+    }
+
+    /*! \brief Atomically replaces the file `leafname` within the directory with `fh`, which must
+    have come from `begin()`, returning once the replacement is durable. If there was no file
+    `leafname`, one is created.
+
+    \errors Any of the values `barrier()`, `link()`, `relink()`, `directory_handle::relink_entries()`
+    or `utils::flush_directory()` can return. If the directory sync fails, the replacement has
+    happened but may not survive a power loss.
+    */
+    result<void> commit(file_handle &fh, path_view leafname) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(fh.barrier(file_handle::barrier_kind::wait_all));
+        if(fh.flags() & file_handle::flag::anonymous_inode)
+        {
+          // An anonymous inode can't replace anything, so link it under a random name, and rename that
+          auto randomname = utils::random_string(32);
+          randomname.append(".tmp");
+          OUTCOME_TRY(fh.link(_dirh, randomname));
+          const directory_handle::relink_request req{randomname, &_dirh, leafname, directory_handle::relink_kind::replace};
+          OUTCOME_TRY(auto &&relinked, _dirh.relink_entries({&req, 1}));
+          if(!relinked.front())
+          {
+            const path_view name(randomname);
+            (void) _dirh.unlink_entries({&name, 1});
+            return std::move(relinked.front()).error();
+          }
+        }
+        else
+        {
+          OUTCOME_TRY(fh.relink(_dirh, leafname, true));
+        }
+        return _sync_directory();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Atomically replaces the file `leafname` within the directory with one containing
+    `contents`, returning once the replacement is durable.
+
+    \errors Any of the values `begin()`, `write()` or `commit()` can return.
+    */
+    result<void> replace(path_view leafname, file_handle::const_buffers_type contents) noexcept
+    {
+      OUTCOME_TRY(auto &&fh, begin());
+      OUTCOME_TRY(fh.write({contents, 0}));
+      return commit(fh, leafname);
+    }
+
+    //! Statistics about the use of the replacer.
+    statistics stats() const noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      return _stats;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
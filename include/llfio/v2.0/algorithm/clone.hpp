@@ -49,7 +49,9 @@ namespace algorithm
   is NOT `always_new`, if the destination has identical maximum extent and last
   modified timestamp (and permissions on POSIX) to the source, it is NOT copied, and
   zero is returned.
-  \param d Deadline by which to complete the operation.
+  \param d Deadline by which to complete each copy of a region of the file.
+  \param threads The maximum number of kernel threads which copy regions of the file
+  concurrently, with zero meaning the hardware concurrency.
 
   Firstly, a `file_handle` is constructed at the destination using `creation`,
   which defaults to always creating a new inode. The caching used for the
@@ -67,9 +69,14 @@ namespace algorithm
   destination file is unlinked and an error code comparing equal to
   `errc::no_space_on_device` is returned.
 
-  Next, `file_handle::clone_extents()` with `emulate_if_unsupported = true` is
-  called on the whole file content. This copies only the allocated extents in
-  blocks sized whatever is the large page size on this platform (2Mb on x64).
+  Next, the destination is truncated to the maximum extent of the source, and
+  the valid extents of the source are enumerated using `file_handle::extents()`.
+  Only these are copied, so holes in the source remain holes in the destination,
+  and a mostly sparse file consumes little space in its copy. If there are many
+  bytes to copy, the valid extents are divided into regions which are copied by
+  up to `threads` kernel threads concurrently, each using `file_handle::clone_extents()`
+  with `emulate_if_unsupported = true`, as a single kernel thread rarely saturates
+  modern storage.
 
   Finally, if `preserve_timestamps` is true, the destination file handle is
   restamped with the metadata from the source file handle just before the
@@ -78,21 +85,110 @@ namespace algorithm
   LLFIO_HEADERS_ONLY_FUNC_SPEC result<file_handle::extent_type> clone_or_copy(file_handle &src, const path_handle &destdir, path_view destleaf = {},
                                                                               bool preserve_timestamps = true, bool force_copy_now = false,
                                                                               file_handle::creation creation = file_handle::creation::always_new,
-                                                                              deadline d = {}) noexcept;
+                                                                              deadline d = {}, size_t threads = 0) noexcept;
+
+  /*! \brief A pipelined, cancellable copy of a region of one file into another, which is
+  advanced a step at a time by its caller rather than occupying a kernel thread.
+
+  `file_handle::clone_extents_to()` is a single blocking call, which for copies of hundreds
+  of gigabytes which cannot be extents cloned occupies the calling thread for a very long time,
+  with no means of reporting progress nor of cancelling partway. This instead issues reads
+  of `blocksize` chunks of the valid extents of the source into `blocks_in_flight` buffers
+  through the i/o multiplexer set on the handles, and as each read completes, issues the write
+  of that buffer into the destination, then reuses the buffer to read ahead the next chunk.
+  Each call to `step()` initiates as much i/o as there are free buffers, and reaps whatever
+  i/o has completed, waiting no longer than its deadline for some to complete.
+
+  If neither handle has an i/o multiplexer set, each `step()` synchronously copies one chunk.
+  Both handles must have the same i/o multiplexer, or no i/o multiplexer, else `start()` fails
+  with an error comparing equal to `errc::invalid_argument`.
+
+  As with `clone_extents_to()`, if the region does not exist in the source it is truncated to
+  what is available, and the destination is extended to receive it if needed. Regions of the
+  destination which correspond to holes in the source are deallocated with `file_handle::zero()`
+  when the copy is started. Content is always copied, never extents cloned, so if extents cloning
+  is possible you should prefer `clone_extents_to()`, which is then nearly instant.
+
+  `cancel()` may be called from any thread, and causes the next `step()` to cancel all i/o in flight
+  and fail with an error comparing equal to `errc::operation_canceled`. Destroying an instance with
+  i/o in flight cancels it and waits for the cancellation to complete. Everything else must be
+  externally synchronised, and both handles must outlive the instance.
+  */
+  class LLFIO_DECL async_clone_extents
+  {
+  public:
+    using extent_type = file_handle::extent_type;
+    using extent_pair = file_handle::extent_pair;
+
+    //! The progress of a copy
+    struct progress_type
+    {
+      extent_type bytes_done{0};   //!< The bytes copied so far
+      extent_type bytes_total{0};  //!< The bytes of valid extents in the source region to be copied
+      size_t reads_in_flight{0};   //!< The number of chunks currently being read from the source
+      size_t writes_in_flight{0};  //!< The number of chunks currently being written to the destination
+    };
+
+  private:
+    struct _state_type;
+    std::unique_ptr<_state_type> _state;
+
+    explicit async_clone_extents(std::unique_ptr<_state_type> state) noexcept
+        : _state(std::move(state))
+    {
+    }
+
+  public:
+    //! Default constructor, which is immediately done
+    async_clone_extents() noexcept;
+    //! Move construction
+    async_clone_extents(async_clone_extents &&o) noexcept;
+    //! Move assignment, which cancels and waits for any i/o in flight of this instance
+    async_clone_extents &operator=(async_clone_extents &&o) noexcept;
+    //! Cancels and waits for any i/o in flight
+    ~async_clone_extents();
+
+    /*! \brief Begins a copy of the region `extent` of `src` to `destoffset` in `dest`. No i/o
+    is initiated until the first `step()`.
+
+    \param src The file to copy from.
+    \param extent The region of the source to copy. `{-1, -1}` means the whole file.
+    \param dest The file to copy into.
+    \param destoffset The offset in the destination to copy to.
+    \param blocks_in_flight The number of chunks being read or written at any one time.
+    \param blocksize The size of each chunk, with zero meaning `utils::file_buffer_default_size()`.
+    \errors Any of the values `file_handle::extents()`, `file_handle::zero()` and `file_handle::truncate()` can return.
+    \mallocs Allocates `blocks_in_flight` buffers of `blocksize`.
+    */
+    static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<async_clone_extents> start(file_handle &src, extent_pair extent, file_handle &dest, extent_type destoffset,
+                                                                             size_t blocks_in_flight = 4, size_t blocksize = 0) noexcept;
+
+    /*! \brief Initiates as much i/o as possible, and reaps whatever has completed, waiting until
+    `d` for at least one i/o to complete if none have. Returns true when the copy is done.
+    */
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<bool> step(deadline d = {}) noexcept;
+    //! Steps until the copy is done or `d` expires, returning the region of the source copied.
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_pair> run(deadline d = {}) noexcept;
+    //! Requests the copy be cancelled by the next `step()`. Can be called from any thread.
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void cancel() noexcept;
+    //! The progress of the copy as of the last `step()`.
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC progress_type progress() const noexcept;
+    //! True if the copy is done.
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC bool done() const noexcept;
+  };
 
-#if 0
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable : 4275)  // dll interface
 #endif
   /*! \brief A visitor for the filesystem traversal and cloning algorithm.
 
-  Note that at any time, returning a failure causes `copy_directory_hierarchy()`
-  or `clone_or_copy()` to exit as soon as possible with the same failure.
+  Note that at any time, returning a failure causes `clone_or_copy()` to exit as soon
+  as possible with the same failure.
 
   You can override the members here inherited from `traverse_visitor`, however note
-  that `copy_directory_hierarchy()` or `clone_or_copy()` is entirely implemented
-  using `traverse()`, so not calling the implementations here will affect operation.
+  that `clone_or_copy()` is entirely implemented using `traverse()`, so not calling
+  the implementations here will affect operation.
   */
   struct LLFIO_DECL clone_copy_link_symlink_visitor : public traverse_visitor
   {
@@ -108,11 +204,18 @@ namespace algorithm
     bool follow_symlinks{false};
     std::chrono::steady_clock::duration timeout{std::chrono::seconds(10)};
     std::chrono::steady_clock::time_point begin;
+    //! The maximum number of files whose content is being cloned, copied or linked at once.
+    size_t max_in_flight{32};
 
     //! Default constructor
     clone_copy_link_symlink_visitor() = default;
     //! Constructs an instance with the default timeout of ten seconds.
-    constexpr clone_copy_link_symlink_visitor(op_t _op, bool _always_create_new_files = false, bool _follow_symlinks = false) : op(_op), always_create_new_files(_always_create_new_files), follow_symlinks(_follow_symlinks) {}
+    constexpr clone_copy_link_symlink_visitor(op_t _op, bool _always_create_new_files = false, bool _follow_symlinks = false)
+        : op(_op)
+        , always_create_new_files(_always_create_new_files)
+        , follow_symlinks(_follow_symlinks)
+    {
+    }
     //! Constructs an instance with the specified timeout.
     constexpr explicit clone_copy_link_symlink_visitor(op_t _op, std::chrono::steady_clock::duration _timeout, bool _always_create_new_files = false,
                                                        bool _follow_symlinks = false)
@@ -124,10 +227,26 @@ namespace algorithm
     }
 
     /*! \brief This override creates directories in the destination for
-    every directory in the source, and optionally clones/copies/links/symlinks
-    any file content, optionally dereferencing or not dereferencing symlinks.
+    every directory in the source, and queues the cloning/copying/linking/symlinking
+    of any file content, optionally dereferencing or not dereferencing symlinks.
+    If `max_in_flight` files are already queued, waits until one completes.
     */
     virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override;
+
+    /*! \brief Called after the content of each file has been cloned, copied or linked,
+    with the total number of items and bytes done so far, and the number of files
+    still queued or in progress. The default does nothing.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<void> progress(void *data, size_t items_done, file_handle::extent_type bytes_done, size_t in_flight) noexcept
+    {
+      (void) data;
+      (void) items_done;
+      (void) bytes_done;
+      (void) in_flight;
+      return success();
+    }
   };
 #ifdef _MSC_VER
 #pragma warning(pop)
@@ -146,24 +265,25 @@ namespace algorithm
   \param force_slow_path The parameter to pass to `traverse()`.
 
   - `srcleaf` empty and `destleaf` empty: Clone contents of `srcdir` into `destdir`.
+  - `srcleaf` empty and `destleaf` non-empty: Clone contents of `srcdir` into `destdir`/`destleaf`.
   - `srcleaf` non-empty and `destleaf` empty: Clone `srcdir`/`srcleaf` into `destdir`/`srcleaf`.
   - `srcleaf` non-empty and `destleaf` non-empty: Clone `srcdir`/`srcleaf` into `destdir`/`destleaf`.
 
-  This algorithm firstly traverses the source directory tree to calculate the filesystem
-  blocks which could be used by a copy of the entity. If insufficient disc space
-  remains on the destination volume for a copy of just the directories, the operation
-  exits with an error code comparing equal to `errc::no_space_on_device`.
-
-  A single large file is then chosen from the source, and an attempt is made to `file_handle::clone_extents()`
-  with `emulate_if_unsupported = false` it into the destination. If extents cloning is
-  not successful, and if the allocated blocks for both the files and the directories
-  would exceed the free disc space on the destination volume, the destination is removed
-  and an error code is returned comparing equal to `errc::no_space_on_device`.
-
-  Otherwise, for every file in the source, its contents are cloned with `clone_or_copy()`
-  into an equivalent file in the destination. This means that the contents are either
-  cloned or copied to the best extent of your filesystems and kernel. If failure occurs
-  during this stage, the destination is left as-is in a partially copied state.
+  As the source directory tree is traversed, an equivalent directory is created in the
+  destination for every directory in the source, and for every file in the source,
+  its contents are cloned with `clone_or_copy()` into an equivalent file in the destination.
+  This means that the contents are either cloned or copied to the best extent of your
+  filesystems and kernel, and if a file's contents would need copying and would exceed the free
+  disc space on the destination volume, the operation exits with an error code comparing equal
+  to `errc::no_space_on_device`. If failure occurs, the destination is left as-is in a partially
+  copied state.
+
+  As cloning each file is dominated by the latency of the several syscalls it needs rather than
+  by bandwidth, files are cloned by a pool of `visitor->max_in_flight` kernel threads concurrently
+  with the traversal, with traversal pausing whenever that many files are queued. The visitor's
+  `progress()` is called as each file completes. The timestamps of the directories in the
+  destination are restamped from the source in a single pass at the end, as otherwise creating
+  their contents would update them.
 
   Note the default visitor parameters: Extent cloning is preferred, we do nothing
   if destination file maximum extent and timestamps are identical to source, we don't
@@ -175,8 +295,9 @@ namespace algorithm
   You should review the documentation for `algorithm::traverse()`, as this algorithm is
   entirely implemented using that algorithm.
   */
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> clone_or_copy(const path_handle &srcdir, path_view srcleaf, const path_handle &destdir, path_view destleaf = {}, clone_copy_link_visitor *visitor = nullptr, size_t threads = 0, bool force_slow_path = false) noexcept;
-#endif
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> clone_or_copy(const path_handle &srcdir, path_view srcleaf, const path_handle &destdir, path_view destleaf = {},
+                                                             clone_copy_link_symlink_visitor *visitor = nullptr, size_t threads = 0,
+                                                             bool force_slow_path = false) noexcept;
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
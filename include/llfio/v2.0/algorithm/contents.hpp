@@ -25,10 +25,13 @@ Distributed under the Boost Software License, Version 1.0.
 #ifndef LLFIO_ALGORITHM_CONTENTS_HPP
 #define LLFIO_ALGORITHM_CONTENTS_HPP
 
+#include "path_table.hpp"
 #include "traverse.hpp"
 
+#include <algorithm>  // for partition
 #include <memory>
 #include <mutex>
+#include <thread>
 
 //! \file contents.hpp Provides a directory tree contents algorithm.
 
@@ -56,6 +59,212 @@ namespace algorithm
       //! The metadata valid within all the `stat_t` in the contents traversed.
       stat_t::want metadata{stat_t::want::none};
     };
+    /*! \brief Enumerated contents as a table of columns, storing only the metadata requested.
+
+    Each item is a row, identified by its index. The paths of all the items are stored zero terminated
+    one after another in a single buffer, and each member of `stat_t` which is requested and tabulated
+    is stored as its own column, so a pass over one member touches only the memory of that member. The
+    columns of members not in `metadata` are empty. Only the members named in `tabulated()` have columns,
+    as those remaining are rarely useful in bulk.
+    */
+    struct contents_table
+    {
+      //! The members of `stat_t` which are tabulated if requested
+      static constexpr stat_t::want tabulated()
+      {
+        return stat_t::want::dev | stat_t::want::ino | stat_t::want::type |
+#ifndef _WIN32
+               stat_t::want::perms |
+#endif
+               stat_t::want::nlink | stat_t::want::atim | stat_t::want::mtim | stat_t::want::ctim | stat_t::want::size | stat_t::want::allocated |
+               stat_t::want::birthtim;
+      }
+
+      //! The metadata whose columns are valid in the contents traversed.
+      stat_t::want metadata{stat_t::want::none};
+      //! The zero terminated paths relative to the root traversed, one after another.
+      std::vector<filesystem::path::value_type> path_chars;
+      //! The offset into `path_chars` of each path, with one more than there are items.
+      std::vector<size_t> path_offsets{0};
+      //! The columns, named after the members of `stat_t`, each empty unless in `metadata`.
+      std::vector<uint64_t> st_dev, st_ino;
+      std::vector<filesystem::file_type> st_type;
+#ifndef _WIN32
+      std::vector<uint16_t> st_perms;
+#endif
+      std::vector<int16_t> st_nlink;
+      std::vector<std::chrono::system_clock::time_point> st_atim, st_mtim, st_ctim, st_birthtim;
+      std::vector<handle::extent_type> st_size, st_allocated;
+
+      //! The number of items
+      size_t size() const noexcept { return path_offsets.size() - 1; }
+      //! True if there are no items
+      bool empty() const noexcept { return path_offsets.size() == 1; }
+      //! The path of item `n` relative to the root traversed
+      path_view path(size_t n) const noexcept
+      {
+        return path_view(path_chars.data() + path_offsets[n], path_offsets[n + 1] - path_offsets[n] - 1, path_view::zero_terminated);
+      }
+
+      //! Appends a row for `stat`, with path `dirpath` joined with `leafname`. `dirpath` may be empty.
+      void push_back(path_view dirpath, path_view leafname, const stat_t &stat)
+      {
+        path_view::c_str<> zdirpath(dirpath, path_view::not_zero_terminated), zleafname(leafname, path_view::not_zero_terminated);
+        path_chars.insert(path_chars.end(), zdirpath.buffer, zdirpath.buffer + zdirpath.length);
+        if(zdirpath.length > 0)
+        {
+          path_chars.push_back(filesystem::path::preferred_separator);
+        }
+        path_chars.insert(path_chars.end(), zleafname.buffer, zleafname.buffer + zleafname.length);
+        path_chars.push_back(0);
+        path_offsets.push_back(path_chars.size());
+        // clang-format off
+        if(metadata & stat_t::want::dev) st_dev.push_back(stat.st_dev);
+        if(metadata & stat_t::want::ino) st_ino.push_back(stat.st_ino);
+        if(metadata & stat_t::want::type) st_type.push_back(stat.st_type);
+#ifndef _WIN32
+        if(metadata & stat_t::want::perms) st_perms.push_back(stat.st_perms);
+#endif
+        if(metadata & stat_t::want::nlink) st_nlink.push_back(stat.st_nlink);
+        if(metadata & stat_t::want::atim) st_atim.push_back(stat.st_atim);
+        if(metadata & stat_t::want::mtim) st_mtim.push_back(stat.st_mtim);
+        if(metadata & stat_t::want::ctim) st_ctim.push_back(stat.st_ctim);
+        if(metadata & stat_t::want::birthtim) st_birthtim.push_back(stat.st_birthtim);
+        if(metadata & stat_t::want::size) st_size.push_back(stat.st_size);
+        if(metadata & stat_t::want::allocated) st_allocated.push_back(stat.st_allocated);
+        // clang-format on
+      }
+      //! Appends all the rows of `o`, which must have the same `metadata`.
+      void append(const contents_table &o)
+      {
+        const size_t base = path_chars.size();
+        path_chars.insert(path_chars.end(), o.path_chars.begin(), o.path_chars.end());
+        path_offsets.reserve(path_offsets.size() + o.size());
+        for(size_t n = 1; n < o.path_offsets.size(); n++)
+        {
+          path_offsets.push_back(base + o.path_offsets[n]);
+        }
+        _for_each_column(o, [](auto &mine, const auto &theirs) { mine.insert(mine.end(), theirs.begin(), theirs.end()); });
+      }
+      /*! \brief Sorts the rows by path, into the same order as comparing them as `filesystem::path`,
+      using up to `threads` kernel threads, with zero meaning the hardware concurrency.
+      */
+      void sort(size_t threads = 0)
+      {
+        const size_t count = size();
+        std::vector<size_t> order(count);
+        for(size_t n = 0; n < count; n++)
+        {
+          order[n] = n;
+        }
+        // Separators order before every other character, which orders paths by component
+        auto less = [this](size_t a, size_t b) {
+          auto key = [](filesystem::path::value_type c) {
+#ifdef _WIN32
+            return (c == '\\' || c == '/') ? 1 : (c == 0) ? 0 : c + 1;
+#else
+            return (c == '/') ? 1 : (c == 0) ? 0 : (int) (unsigned char) c + 1;
+#endif
+          };
+          const filesystem::path::value_type *x = path_chars.data() + path_offsets[a], *y = path_chars.data() + path_offsets[b];
+          for(; *x != 0 && *x == *y; ++x, ++y)
+          {
+          }
+          return key(*x) < key(*y);
+        };
+        if(threads == 0)
+        {
+          threads = std::max(std::thread::hardware_concurrency(), 1U);
+        }
+        threads = std::max((size_t) 1, std::min(threads, count / 65536));
+        // Sort a run per thread, then merge pairs of runs in parallel until one run remains
+        std::vector<size_t> runs;
+        for(size_t n = 0; n <= threads; n++)
+        {
+          runs.push_back(count * n / threads);
+        }
+        auto parallel = [](size_t jobs, const auto &f) {
+          std::vector<std::thread> workers;
+          for(size_t n = 1; n < jobs; n++)
+          {
+            workers.emplace_back(f, n);
+          }
+          f(0);
+          for(auto &i : workers)
+          {
+            i.join();
+          }
+        };
+        parallel(threads, [&](size_t n) { std::sort(order.begin() + runs[n], order.begin() + runs[n + 1], less); });
+        while(runs.size() > 2)
+        {
+          std::vector<size_t> merged;
+          for(size_t n = 0; n < runs.size(); n += 2)
+          {
+            merged.push_back(runs[n]);
+          }
+          if(merged.back() != count)
+          {
+            merged.push_back(count);
+          }
+          parallel(runs.size() / 2, [&](size_t n) {
+            if(2 * n + 2 < runs.size())
+            {
+              std::inplace_merge(order.begin() + runs[2 * n], order.begin() + runs[2 * n + 1], order.begin() + runs[2 * n + 2], less);
+            }
+          });
+          runs = std::move(merged);
+        }
+        // Gather each column into the sorted order
+        contents_table sorted;
+        sorted.metadata = metadata;
+        sorted.path_chars.reserve(path_chars.size());
+        sorted.path_offsets.reserve(path_offsets.size());
+        for(size_t n : order)
+        {
+          sorted.path_chars.insert(sorted.path_chars.end(), path_chars.begin() + path_offsets[n], path_chars.begin() + path_offsets[n + 1]);
+          sorted.path_offsets.push_back(sorted.path_chars.size());
+        }
+        sorted._for_each_column(*this, [&](auto &mine, const auto &theirs) {
+          if(!theirs.empty())
+          {
+            mine.reserve(count);
+            for(size_t n : order)
+            {
+              mine.push_back(theirs[n]);
+            }
+          }
+        });
+        *this = std::move(sorted);
+      }
+
+    private:
+      template <class F> void _for_each_column(const contents_table &o, F &&f)
+      {
+        f(st_dev, o.st_dev);
+        f(st_ino, o.st_ino);
+        f(st_type, o.st_type);
+#ifndef _WIN32
+        f(st_perms, o.st_perms);
+#endif
+        f(st_nlink, o.st_nlink);
+        f(st_atim, o.st_atim);
+        f(st_mtim, o.st_mtim);
+        f(st_ctim, o.st_ctim);
+        f(st_birthtim, o.st_birthtim);
+        f(st_size, o.st_size);
+        f(st_allocated, o.st_allocated);
+      }
+    };
+    /*! \brief Enumerated contents with interned paths, and what parts of their `stat_t` is valid.
+     */
+    struct interned_contents_type : public std::vector<std::pair<path_table::id_type, stat_t>>
+    {
+      //! The metadata valid within all the `stat_t` in the contents traversed.
+      stat_t::want metadata{stat_t::want::none};
+      //! The paths of the contents traversed, and of all the directories above them.
+      path_table paths;
+    };
 
     //! Default construtor
     contents_visitor() = default;
@@ -69,17 +278,27 @@ namespace algorithm
     }
 
     friend inline result<contents_type> contents(const path_handle &dirh, contents_visitor *visitor, size_t threads, bool force_slow_path) noexcept;
+    friend inline result<interned_contents_type> interned_contents(const path_handle &dirh, contents_visitor *visitor, size_t threads,
+                                                                   bool force_slow_path) noexcept;
+    friend inline result<contents_table> tabulated_contents(const path_handle &dirh, contents_visitor *visitor, size_t threads, bool sorted,
+                                                            bool force_slow_path) noexcept;
 
   protected:
+    using _interned_items_type = std::vector<std::pair<path_table::id_type, stat_t>>;
     struct _state_type
     {
       const path_handle &rootdirh;
       std::atomic<size_t> rootdirpathlen{0};
       std::atomic<stat_t::want> metadata{stat_t::want::all};
       contents_type contents;
+      path_table *paths{nullptr};  // if set, paths are interned into here instead
+      _interned_items_type interned;
+      contents_table *table{nullptr};  // if set, contents are tabulated into here instead
 
       std::mutex lock;
       std::vector<std::shared_ptr<contents_type>> all_thread_contents;
+      std::vector<std::shared_ptr<_interned_items_type>> all_thread_interned;
+      std::vector<std::shared_ptr<contents_table>> all_thread_tables;
 
       explicit _state_type(const path_handle &_rootdirh)
           : rootdirh(_rootdirh)
@@ -87,20 +306,20 @@ namespace algorithm
       }
     };
 
-    static std::shared_ptr<contents_type> _thread_contents(_state_type *state) noexcept
+    template <class T> static std::shared_ptr<T> _thread_storage(_state_type *state, std::vector<std::shared_ptr<T>> &all) noexcept
     {
       try
       {
-        static thread_local std::weak_ptr<contents_type> mycontents;
+        static thread_local std::weak_ptr<T> mycontents;
         auto ret = mycontents.lock();
         if(ret)
         {
           return ret;
         }
-        ret = std::make_unique<contents_type>();
+        ret = std::make_unique<T>();
         mycontents = ret;
         std::lock_guard<std::mutex> g(state->lock);
-        state->all_thread_contents.push_back(ret);
+        all.push_back(ret);
         return ret;
       }
       catch(...)
@@ -108,6 +327,7 @@ namespace algorithm
         return {};
       }
     }
+    static std::shared_ptr<contents_type> _thread_contents(_state_type *state) noexcept { return _thread_storage(state, state->all_thread_contents); }
 
   public:
     /*! \brief The default implementation accumulates the contents into thread
@@ -122,49 +342,77 @@ namespace algorithm
         (void) depth;
         if(!contents.empty())
         {
-          contents_type toadd;
-          toadd.reserve(contents.size());
-          filesystem::path dirhpath;
-          for(;;)
+          OUTCOME_TRY(auto &&dirhpath, relative_directory_path(state->rootdirh, state->rootdirpathlen, dirh));
+          auto _metadata_ = state->metadata.load(std::memory_order_relaxed);
+          if((_metadata_ & (contents_include_metadata | contents.metadata())) != _metadata_)
+          {
+            state->metadata.store(_metadata_ & (contents_include_metadata | contents.metadata()), std::memory_order_relaxed);
+          }
+          auto need_stat = contents_include_metadata & ~contents.metadata();
+          auto included = [&](const directory_entry &entry) {
+            return (contents_include_files && entry.stat.st_type == filesystem::file_type::regular) ||
+                   (contents_include_directories && entry.stat.st_type == filesystem::file_type::directory) ||
+                   (contents_include_symlinks && entry.stat.st_type == filesystem::file_type::symlink);
+          };
+          if(state->paths != nullptr || state->table != nullptr)
           {
-            OUTCOME_TRY(dirhpath, dirh.current_path());
-            auto rootdirpathlen = state->rootdirpathlen.load(std::memory_order_relaxed);
-            if(dirhpath.native().size() <= rootdirpathlen)
+            // Move the included entries to the front, fetching any missing metadata, and
+            // skipping those which vanished
+            auto count = static_cast<size_t>(std::partition(contents.begin(), contents.end(), included) - contents.begin());
+            if(need_stat)
             {
-              break;
+              OUTCOME_TRY(auto &&filled, dirh.stat_entries(contents.subspan(0, count), need_stat));
+              size_t kept = 0;
+              for(size_t n = 0; n < count; n++)
+              {
+                if(filled[n])
+                {
+                  std::swap(contents[kept++], contents[n]);
+                }
+              }
+              count = kept;
             }
-            dirhpath = dirhpath.native().substr(rootdirpathlen);
-            auto r = directory_handle::directory(state->rootdirh, dirhpath);
-            if(r && r.value().unique_id() == dirh.unique_id())
+            if(state->table != nullptr)
             {
-              break;
+              auto into = _thread_storage(state, state->all_thread_tables);
+              into->metadata = state->table->metadata;
+              for(size_t n = 0; n < count; n++)
+              {
+                into->push_back(dirhpath, contents[n].leafname, contents[n].stat);
+              }
+              return success();
             }
-            OUTCOME_TRY(dirhpath, state->rootdirh.current_path());
-            state->rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
-          }
-          auto _metadata_ = state->metadata.load(std::memory_order_relaxed);
-          if((_metadata_ & (contents_include_metadata | contents.metadata())) != _metadata_)
-          {
-            state->metadata.store(_metadata_ & (contents_include_metadata | contents.metadata()), std::memory_order_relaxed);
+            OUTCOME_TRY(auto &&parent, state->paths->intern(dirhpath));
+            std::vector<path_table::id_type> ids(count);
+            OUTCOME_TRY(state->paths->intern(parent, contents.subspan(0, count), ids));
+            auto into = _thread_storage(state, state->all_thread_interned);
+            for(size_t n = 0; n < count; n++)
+            {
+              into->emplace_back(ids[n], contents[n].stat);
+            }
+            return success();
           }
           auto into = _thread_contents(state);
-          for(auto &entry : contents)
+          if(!need_stat)
           {
-            auto need_stat = contents_include_metadata & ~contents.metadata();
-            if((contents_include_files && entry.stat.st_type == filesystem::file_type::regular) ||
-               (contents_include_directories && entry.stat.st_type == filesystem::file_type::directory) ||
-               (contents_include_symlinks && entry.stat.st_type == filesystem::file_type::symlink))
+            for(auto &entry : contents)
             {
-              if(!need_stat)
+              if(included(entry))
               {
                 into->emplace_back(dirhpath / entry.leafname, entry.stat);
-                continue;
               }
-              auto r = file_handle::file(dirh, entry.leafname, file_handle::mode::attr_read);
-              if(r)
+            }
+          }
+          else
+          {
+            // Fetch the missing metadata of all the included entries at once, skipping those which vanished
+            const auto count = static_cast<size_t>(std::partition(contents.begin(), contents.end(), included) - contents.begin());
+            OUTCOME_TRY(auto &&filled, dirh.stat_entries(contents.subspan(0, count), need_stat));
+            for(size_t n = 0; n < count; n++)
+            {
+              if(filled[n])
               {
-                OUTCOME_TRY(entry.stat.fill(r.value(), need_stat));
-                into->emplace_back(dirhpath / entry.leafname, entry.stat);
+                into->emplace_back(dirhpath / contents[n].leafname, contents[n].stat);
               }
             }
           }
@@ -199,6 +447,26 @@ namespace algorithm
           state->contents.insert(state->contents.end(), std::make_move_iterator(i->begin()), std::make_move_iterator(i->end()));
         }
         state->all_thread_contents.clear();
+        state->interned.clear();
+        count = 0;
+        for(auto &i : state->all_thread_interned)
+        {
+          count += i->size();
+        }
+        state->interned.reserve(count);
+        for(auto &i : state->all_thread_interned)
+        {
+          state->interned.insert(state->interned.end(), i->begin(), i->end());
+        }
+        state->all_thread_interned.clear();
+        if(state->table != nullptr)
+        {
+          for(auto &i : state->all_thread_tables)
+          {
+            state->table->append(*i);
+          }
+          state->all_thread_tables.clear();
+        }
         return result;
       }
       catch(...)
@@ -235,6 +503,81 @@ namespace algorithm
     return {std::move(state.contents)};
   }
 
+  /*! \brief Calculate the contents of everything within and under `dirh`, interning their paths
+  into a `path_table`. What is returned is unordered.
+
+  This is identical to `contents()`, except that each item is identified by its id within the
+  returned `paths` instead of by its own `filesystem::path`, which uses several times less memory
+  for large trees. The ids of the directories above an item are always in `paths`, even if
+  directories are not included in the contents.
+  */
+  inline result<contents_visitor::interned_contents_type> interned_contents(const path_handle &dirh, contents_visitor *visitor = nullptr, size_t threads = 0,
+                                                                           bool force_slow_path = false) noexcept
+  {
+    try
+    {
+      contents_visitor default_visitor;
+      if(visitor == nullptr)
+      {
+        visitor = &default_visitor;
+      }
+      contents_visitor::interned_contents_type ret;
+      contents_visitor::_state_type state(dirh);
+      state.paths = &ret.paths;
+      OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+      state.rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+      OUTCOME_TRY(traverse(dirh, visitor, threads, &state, force_slow_path));
+      ret.metadata = state.contents.metadata;
+      static_cast<contents_visitor::_interned_items_type &>(ret) = std::move(state.interned);
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  /*! \brief Calculate the contents of everything within and under `dirh` as a table of
+  columns, optionally sorted by path.
+
+  This is identical to `contents()`, except that the contents are returned as a `contents_table`,
+  which stores all the paths in a single buffer and only the columns of the metadata requested by
+  `contents_visitor::contents_include_metadata` which are in `contents_table::tabulated()`, plus
+  the type, which is always known. This
+  uses a fraction of the memory of `contents()` for large trees, and is much more cache friendly
+  to process. Each thread tabulates the directories it enumerates into its own table, and these
+  are appended together at the end. If `sorted` is true, the table is then sorted by path using
+  up to `threads` kernel threads.
+  */
+  inline result<contents_visitor::contents_table> tabulated_contents(const path_handle &dirh, contents_visitor *visitor = nullptr, size_t threads = 0,
+                                                                     bool sorted = false, bool force_slow_path = false) noexcept
+  {
+    try
+    {
+      contents_visitor default_visitor;
+      if(visitor == nullptr)
+      {
+        visitor = &default_visitor;
+      }
+      contents_visitor::contents_table ret;
+      ret.metadata = (visitor->contents_include_metadata | stat_t::want::type) & contents_visitor::contents_table::tabulated();
+      contents_visitor::_state_type state(dirh);
+      state.table = &ret;
+      OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+      state.rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+      OUTCOME_TRY(traverse(dirh, visitor, threads, &state, force_slow_path));
+      if(sorted)
+      {
+        ret.sort(threads);
+      }
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
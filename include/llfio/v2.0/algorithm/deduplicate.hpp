@@ -0,0 +1,462 @@
+/* A filesystem algorithm which shares the storage of duplicate extents within a directory tree
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_DEDUPLICATE_HPP
+#define LLFIO_ALGORITHM_DEDUPLICATE_HPP
+
+#include "file_handle_cache.hpp"
+#include "path_table.hpp"
+#include "traverse.hpp"
+
+#include "quickcpplib/algorithm/hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+//! \file deduplicate.hpp Provides a parallel deduplicator of the extents of the files in a directory tree.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief The counts returned by `deduplicate()`.
+   */
+  struct deduplicate_summary
+  {
+    size_t files_scanned{0};                       //!< The number of files whose contents were hashed.
+    size_t files_failed{0};                        //!< The number of files which could not be opened or read.
+    size_t operations{0};                          //!< The number of `deduplicate_extents_to()` performed.
+    size_t operations_failed{0};                   //!< The number of `deduplicate_extents_to()` which failed, or found the contents had changed.
+    handle::extent_type bytes_scanned{0};          //!< The bytes of contents hashed.
+    handle::extent_type bytes_already_shared{0};   //!< The bytes of duplicate blocks which already shared storage.
+    handle::extent_type bytes_duplicated{0};       //!< The bytes of duplicate blocks found not sharing storage.
+    handle::extent_type bytes_deduplicated{0};     //!< The bytes of duplicate blocks which now share storage.
+  };
+
+  /*! \brief The state of a `deduplicate()`, which is the `data` passed to the visitor's callbacks.
+   */
+  struct deduplicate_state
+  {
+    //! A file scanned
+    struct file_type
+    {
+      filesystem::path path;  //!< Relative to the root of the traversal
+      uint64_t dev{0}, ino{0};
+    };
+    //! A block of a file scanned
+    struct block_type
+    {
+      QUICKCPPLIB_NAMESPACE::integers128::uint128 hash;
+      uint64_t dev{0};
+      size_t file{0};                                   //!< The index into `files`
+      handle::extent_type offset{0}, length{0};
+      handle::extent_type physical{(handle::extent_type) -1};  //!< The location of the block upon the device, if known
+    };
+
+    const path_handle &rootdirh;
+    std::atomic<size_t> rootdirpathlen{0};
+    size_t block_size{0};  //!< The size of the blocks hashed
+    std::mutex lock;
+    std::set<std::pair<uint64_t, uint64_t>> inodes;  //!< The device and inode of every file scanned, so hard links are scanned once
+    std::vector<file_type> files;
+    std::vector<block_type> blocks;
+    deduplicate_summary summary;
+
+    explicit deduplicate_state(const path_handle &_rootdirh)
+        : rootdirh(_rootdirh)
+    {
+    }
+  };
+
+  /*! \brief A visitor for the parallel deduplication algorithm.
+
+  Note that at any time, returning a failure causes `deduplicate()` to exit as soon
+  as possible with the same failure.
+
+  You can override the members here inherited from `traverse_visitor`, however note
+  that `deduplicate()` is entirely implemented using `traverse()`, so not calling the
+  implementations here will affect operation.
+  */
+  struct deduplicate_visitor : public traverse_visitor
+  {
+    /*! \brief Called when a file could not be opened or read. The default ignores the failure,
+    counting it in `deduplicate_summary::files_failed`.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<void> file_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leafname) noexcept
+    {
+      (void) error;
+      (void) dirh;
+      (void) leafname;
+      auto *state = (deduplicate_state *) data;
+      std::lock_guard<std::mutex> g(state->lock);
+      state->summary.files_failed++;
+      return success();
+    }
+
+    //! This override ignores failures to traverse into the directory.
+    virtual result<directory_handle> directory_open_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leaf,
+                                                           size_t depth) noexcept override
+    {
+      (void) data;
+      (void) error;
+      (void) dirh;
+      (void) leaf;
+      (void) depth;
+      return success();  // ignore failure to enter
+    }
+
+    /*! \brief Hashes each block of the open file `fh`, whose index in `deduplicate_state::files` will
+    be `file`, appending them to `blocks` and returning the bytes hashed. Blocks without storage are skipped.
+    */
+    result<handle::extent_type> scan_file(deduplicate_state *state, file_handle &fh, size_t file, std::vector<deduplicate_state::block_type> &blocks,
+                                          std::vector<byte, utils::pooled_page_allocator<byte>> &buffer) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&length, fh.maximum_extent());
+        // The physical locations of the extents reveal which blocks already share storage
+        std::vector<file_handle::extent_info> extents;
+        auto map = fh.extent_map();
+        if(map)
+        {
+          extents = std::move(map).value();
+        }
+        handle::extent_type ret = 0;
+        size_t idx = 0;
+        for(handle::extent_type offset = 0; offset < length; offset += state->block_size)
+        {
+          deduplicate_state::block_type block;
+          block.dev = fh.st_dev();
+          block.file = file;
+          block.offset = offset;
+          block.length = std::min((handle::extent_type) state->block_size, length - offset);
+          if(map)
+          {
+            while(idx < extents.size() && extents[idx].offset + extents[idx].length <= offset)
+            {
+              idx++;
+            }
+            if(idx == extents.size() || extents[idx].offset >= offset + block.length)
+            {
+              continue;  // a hole
+            }
+            if(extents[idx].offset <= offset && !(extents[idx].flags & file_handle::extent_flag::unknown_location))
+            {
+              block.physical = extents[idx].physical + (offset - extents[idx].offset);
+            }
+          }
+          OUTCOME_TRY(auto &&read, fh.read(offset, {{buffer.data(), (size_t) block.length}}));
+          if(read != block.length)
+          {
+            break;  // the file was truncated meanwhile
+          }
+          block.hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(reinterpret_cast<const char *>(buffer.data()), read);
+          blocks.push_back(block);
+          ret += read;
+        }
+        return ret;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! This override hashes the blocks of every regular file just enumerated
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      (void) depth;
+      try
+      {
+        auto *state = (deduplicate_state *) data;
+        OUTCOME_TRY(auto &&dirhpath, relative_directory_path(state->rootdirh, state->rootdirpathlen, dirh));
+        std::vector<deduplicate_state::file_type> files;
+        std::vector<deduplicate_state::block_type> blocks;
+        std::vector<byte, utils::pooled_page_allocator<byte>> buffer;
+        size_t scanned = 0;
+        handle::extent_type bytes_scanned = 0;
+        for(auto &entry : contents)
+        {
+          if(entry.stat.st_type != filesystem::file_type::regular)
+          {
+            continue;
+          }
+          auto fh = file_handle::file(dirh, entry.leafname, file_handle::mode::read);
+          if(!fh)
+          {
+            OUTCOME_TRY(file_failed(data, std::move(fh).error(), dirh, entry.leafname));
+            continue;
+          }
+          {
+            std::lock_guard<std::mutex> g(state->lock);
+            if(!state->inodes.emplace(fh.value().st_dev(), fh.value().st_ino()).second)
+            {
+              continue;  // a hard link to a file already scanned
+            }
+          }
+          if(buffer.empty())
+          {
+            buffer.resize(state->block_size);
+          }
+          const size_t before = blocks.size();
+          auto r = scan_file(state, fh.value(), files.size(), blocks, buffer);
+          if(!r)
+          {
+            blocks.resize(before);
+            OUTCOME_TRY(file_failed(data, std::move(r).error(), dirh, entry.leafname));
+            continue;
+          }
+          files.push_back({dirhpath / entry.leafname.path(), fh.value().st_dev(), fh.value().st_ino()});
+          scanned++;
+          bytes_scanned += r.value();
+        }
+        std::lock_guard<std::mutex> g(state->lock);
+        const size_t base = state->files.size();
+        state->files.insert(state->files.end(), std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+        for(auto &block : blocks)
+        {
+          block.file += base;
+          state->blocks.push_back(block);
+        }
+        state->summary.files_scanned += scanned;
+        state->summary.bytes_scanned += bytes_scanned;
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief Finds the blocks of `block_size` bytes of the regular files within and under `dirh` which
+  have identical contents, and makes each share the storage of one of them using
+  `file_handle::deduplicate_extents_to()`.
+
+  The tree is traversed in parallel by `algorithm::traverse()` using up to `threads` threads, and
+  each thread hashes the blocks of the files of each directory it enumerates, skipping holes and
+  noting the physical location of each block where `file_handle::extent_map()` can supply it. Hard
+  links to the same inode are scanned once. Blocks with identical hashes on the same device then
+  have their storage shared with the first of them, except those already at the same physical
+  location, with runs of consecutive blocks shared by a single call. These calls are made by
+  `threads` threads, each handling all the calls of one file at a time, with the sources opened
+  through a `file_handle_cache`. As the kernel compares the contents of the blocks before sharing
+  them on Linux, files modified after being hashed are never corrupted.
+
+  The last block of a file may be shorter than `block_size`, and can only share storage with the
+  last block of another file of the same length. `block_size` must be a multiple of 4Kb, and of the
+  block size of the filing system, or few blocks will be shared.
+
+  If `dry_run` is true, the duplicate blocks are found and counted but not deduplicated. Files
+  which cannot be opened or read are counted but otherwise ignored, as are directories which cannot
+  be entered, unless the visitor overrides that. Symbolic links are not followed.
+
+  \errors `errc::invalid_argument` if `block_size` is not a multiple of 4Kb,
+  `errc::operation_not_supported` if the filing system cannot share extents, any of the values
+  `traverse()` can return.
+  */
+  inline result<deduplicate_summary> deduplicate(const path_handle &dirh, deduplicate_visitor *visitor = nullptr, size_t threads = 0, size_t block_size = 256 * 1024,
+                                                 bool dry_run = false) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    if(block_size == 0 || (block_size & 4095) != 0)
+    {
+      return errc::invalid_argument;
+    }
+    try
+    {
+      deduplicate_visitor default_visitor;
+      if(visitor == nullptr)
+      {
+        visitor = &default_visitor;
+      }
+      deduplicate_state state(dirh);
+      state.block_size = block_size;
+      OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+      state.rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+      OUTCOME_TRY(traverse(dirh, visitor, threads, &state));
+      auto &summary = state.summary;
+
+      // Group identical blocks, with those already sharing storage adjacent
+      using block_type = deduplicate_state::block_type;
+      auto key = [](const block_type &b) { return std::make_tuple(b.dev, b.length, b.hash.as_longlongs[0], b.hash.as_longlongs[1]); };
+      std::sort(state.blocks.begin(), state.blocks.end(), [&](const block_type &a, const block_type &b) {
+        const auto ka = key(a), kb = key(b);
+        return (ka < kb) || (ka == kb && std::make_tuple(a.physical, a.file, a.offset) < std::make_tuple(b.physical, b.file, b.offset));
+      });
+      struct operation
+      {
+        size_t src, dest;
+        handle::extent_type srcoffset, destoffset, length;
+      };
+      std::vector<operation> ops;
+      for(size_t n = 0; n < state.blocks.size();)
+      {
+        const auto &src = state.blocks[n];
+        size_t m = n + 1;
+        for(; m < state.blocks.size() && key(state.blocks[m]) == key(src); m++)
+        {
+          const auto &dest = state.blocks[m];
+          if(dest.physical != (handle::extent_type) -1 && dest.physical == src.physical)
+          {
+            summary.bytes_already_shared += dest.length;
+            continue;
+          }
+          summary.bytes_duplicated += dest.length;
+          ops.push_back({src.file, dest.file, src.offset, dest.offset, dest.length});
+        }
+        n = m;
+      }
+      state.blocks.clear();
+      state.blocks.shrink_to_fit();
+      if(dry_run || ops.empty())
+      {
+        return summary;
+      }
+
+      // Coalesce runs of consecutive blocks into single operations
+      std::sort(ops.begin(), ops.end(), [](const operation &a, const operation &b) { return std::tie(a.dest, a.destoffset) < std::tie(b.dest, b.destoffset); });
+      size_t kept = 0;
+      for(size_t n = 1; n < ops.size(); n++)
+      {
+        auto &prev = ops[kept];
+        const auto &op = ops[n];
+        const bool consecutive = prev.dest == op.dest && prev.src == op.src && prev.destoffset + prev.length == op.destoffset && prev.srcoffset + prev.length == op.srcoffset;
+        // Regions within the same file must never overlap
+        const bool overlaps = op.src == op.dest && prev.srcoffset < op.destoffset + op.length && prev.destoffset < op.srcoffset + op.length;
+        if(consecutive && !overlaps)
+        {
+          prev.length += op.length;
+        }
+        else
+        {
+          ops[++kept] = op;
+        }
+      }
+      ops.resize(kept + 1);
+      summary.operations = ops.size();
+
+      // Each thread does all the operations with the same destination file
+      std::vector<size_t> runs;
+      for(size_t n = 0; n < ops.size(); n++)
+      {
+        if(n == 0 || ops[n].dest != ops[n - 1].dest)
+        {
+          runs.push_back(n);
+        }
+      }
+      runs.push_back(ops.size());
+      file_handle_cache sources(64);
+      std::atomic<size_t> next_run(0), failed(0);
+      std::atomic<handle::extent_type> deduplicated(0);
+      std::atomic<bool> unsupported(false);
+      auto worker = [&] {
+        for(;;)
+        {
+          const size_t run = next_run.fetch_add(1, std::memory_order_relaxed);
+          if(run + 1 >= runs.size() || unsupported.load(std::memory_order_relaxed))
+          {
+            return;
+          }
+          const auto &destfile = state.files[ops[runs[run]].dest];
+          auto dest = file_handle::file(dirh, destfile.path, file_handle::mode::write);
+          if(!dest)
+          {
+            // A file only its owner can write may still be deduplicated by its owner
+            dest = file_handle::file(dirh, destfile.path, file_handle::mode::read);
+          }
+          if(!dest || dest.value().st_ino() != destfile.ino)
+          {
+            failed.fetch_add(runs[run + 1] - runs[run], std::memory_order_relaxed);
+            continue;
+          }
+          for(size_t n = runs[run]; n < runs[run + 1]; n++)
+          {
+            const auto &op = ops[n];
+            auto src = sources.open(dirh, state.files[op.src].path);
+            if(!src || src.value()->st_ino() != state.files[op.src].ino)
+            {
+              failed.fetch_add(1, std::memory_order_relaxed);
+              continue;
+            }
+            auto r = src.value()->deduplicate_extents_to({op.srcoffset, op.length}, dest.value(), op.destoffset);
+            if(!r)
+            {
+              if(r.error() == errc::operation_not_supported)
+              {
+                unsupported.store(true, std::memory_order_relaxed);
+                return;
+              }
+              failed.fetch_add(1, std::memory_order_relaxed);
+              continue;
+            }
+            if(r.value() < op.length)
+            {
+              failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            deduplicated.fetch_add(r.value(), std::memory_order_relaxed);
+          }
+        }
+      };
+      if(threads == 0)
+      {
+        threads = std::max(std::thread::hardware_concurrency(), 1U);
+      }
+      threads = std::min(threads, runs.size() - 1);
+      std::vector<std::thread> workers;
+      for(size_t n = 1; n < threads; n++)
+      {
+        workers.emplace_back(worker);
+      }
+      worker();
+      for(auto &t : workers)
+      {
+        t.join();
+      }
+      if(unsupported.load(std::memory_order_relaxed))
+      {
+        return errc::operation_not_supported;
+      }
+      summary.operations_failed = failed.load(std::memory_order_relaxed);
+      summary.bytes_deduplicated = deduplicated.load(std::memory_order_relaxed);
+      return summary;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
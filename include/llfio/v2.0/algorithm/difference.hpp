@@ -25,15 +25,21 @@ Distributed under the Boost Software License, Version 1.0.
 #ifndef LLFIO_ALGORITHM_DIFFERENCE_HPP
 #define LLFIO_ALGORITHM_DIFFERENCE_HPP
 
-#include "traverse.hpp"
+#include "contents.hpp"
 
-//! \file compare.hpp Provides a directory tree difference algorithm.
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+//! \file difference.hpp Provides a directory tree difference algorithm.
 
 LLFIO_V2_NAMESPACE_BEGIN
 
 namespace algorithm
 {
-  /*!
+  /*! \brief A difference between two snapshots of a directory tree.
    */
   struct difference_item
   {
@@ -53,85 +59,427 @@ namespace algorithm
       symlink_removed               //!< A symlink was removed
     } changed{change_t::unknown};
     int8_t content_comparison{0};  //!< `memcmp()` of content, if requested
+    filesystem::path path;           //!< The path of the item relative to the root of the tree
+    filesystem::path previous_path;  //!< For renames, the previous path. For links, the path of the item linked to.
+  };
+
+  /*! \brief The metadata of every item within a directory tree, keyed by path relative
+  to the root of the tree.
+  */
+  struct tree_snapshot : public std::map<filesystem::path, stat_t>
+  {
+    //! The metadata captured for each item
+    static constexpr stat_t::want metadata()
+    {
+      return stat_t::want::dev | stat_t::want::ino | stat_t::want::type | stat_t::want::size | stat_t::want::mtim | stat_t::want::ctim;
+    }
   };
-  /*! \brief A visitor for the filesystem traversal and comparison algorithm.
 
-  Note that at any time, returning a failure causes `compare()` to exit as soon
-  as possible with the same failure.
+  /*! \brief Snapshot the directory identified `dirh`, and everything therein.
 
-  You can override the members here inherited from `traverse_visitor`, however note
-  that `compare()` is entirely implemented using `traverse()`, so not calling the
-  implementations here will affect operation.
+  This is a thin veneer over `contents()`, and thus `traverse()`.
   */
-  struct compare_visitor : public traverse_visitor
+  inline result<tree_snapshot> snapshot(const path_handle &dirh, size_t threads = 0, bool force_slow_path = false) noexcept
   {
-    //! This override ignores failures to traverse into the directory.
-    virtual result<directory_handle> directory_open_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leaf,
-                                                           size_t depth) noexcept override
+    try
     {
-      (void) error;
-      (void) dirh;
-      (void) leaf;
-      (void) depth;
-      auto *state = (traversal_summary *) data;
-      lock_guard<spinlock> g(state->_lock);
-      state->directory_opens_failed++;
-      return success();  // ignore failure to enter
+      contents_visitor visitor(tree_snapshot::metadata());
+      OUTCOME_TRY(auto &&items, contents(dirh, &visitor, threads, force_slow_path));
+      tree_snapshot ret;
+      for(auto &i : items)
+      {
+        ret.emplace(std::move(i.first), i.second);
+      }
+      return {std::move(ret)};
     }
-    //! This override implements the summary
-    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    catch(...)
     {
-      try
+      return error_from_exception();
+    }
+  }
+
+  /*! \brief Calculate the differences between two snapshots of the same directory tree.
+
+  Items are matched by path, and then by device and inode, so an item at a new path
+  with the inode of an item which is no longer at its old path is a rename, and an item
+  at a new path with the inode of an item which is still at its old path is a hard link.
+  Renaming a directory reports only the rename of that directory, not of everything
+  within it. Removals are reported last.
+  */
+  inline result<std::vector<difference_item>> difference(const tree_snapshot &before, const tree_snapshot &after) noexcept
+  {
+    try
+    {
+      struct key_type
+      {
+        uint64_t dev, ino;
+        bool operator==(const key_type &o) const noexcept { return dev == o.dev && ino == o.ino; }
+      };
+      struct key_hasher
+      {
+        size_t operator()(const key_type &k) const noexcept { return static_cast<size_t>(k.ino ^ (k.dev * 0x9E3779B97F4A7C15ULL)); }
+      };
+      auto same_item = [](const stat_t &a, const stat_t &b) { return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_type == b.st_type; };
+      // Everything no longer at its old path is either renamed or removed
+      std::unordered_map<key_type, tree_snapshot::const_iterator, key_hasher> departed;
+      std::unordered_map<key_type, const filesystem::path *, key_hasher> remaining;
+      for(auto it = before.begin(); it != before.end(); ++it)
+      {
+        auto found = after.find(it->first);
+        if(found == after.end() || !same_item(found->second, it->second))
+        {
+          departed.emplace(key_type{it->second.st_dev, it->second.st_ino}, it);
+        }
+        else
+        {
+          remaining.emplace(key_type{it->second.st_dev, it->second.st_ino}, &it->first);
+        }
+      }
+      std::vector<difference_item> ret;
+      std::map<filesystem::path, filesystem::path> renamed_directories;  // old path to new path
+      auto push = [&](difference_item::change_t changed, const filesystem::path &path, const filesystem::path *previous_path) {
+        ret.emplace_back();
+        ret.back().changed = changed;
+        ret.back().path = path;
+        if(previous_path != nullptr)
+        {
+          ret.back().previous_path = *previous_path;
+        }
+      };
+      for(auto &i : after)
       {
-        auto *state = (traversal_summary *) data;
-        traversal_summary acc;
-        acc.max_depth = depth;
-        for(auto &entry : contents)
+        const stat_t &st = i.second;
+        auto found = before.find(i.first);
+        if(found != before.end() && same_item(found->second, st))
         {
-          OUTCOME_TRY(accumulate(acc, state, &dirh, entry, contents.metadata()));
+          if(st.st_type != filesystem::file_type::directory && (found->second.st_size != st.st_size || found->second.st_mtim != st.st_mtim))
+          {
+            push(difference_item::content_metadata_changed, i.first, nullptr);
+          }
+          else if(found->second.st_ctim != st.st_ctim)
+          {
+            push(difference_item::noncontent_metadata_changed, i.first, nullptr);
+          }
+          continue;
+        }
+        const key_type key{st.st_dev, st.st_ino};
+        auto departed_it = departed.find(key);
+        if(departed_it != departed.end() && departed_it->second->second.st_type == st.st_type)
+        {
+          const filesystem::path &previous_path = departed_it->second->first;
+          if(st.st_type == filesystem::file_type::directory)
+          {
+            renamed_directories[previous_path] = i.first;
+          }
+          // Items within a renamed directory are implied by the rename of the directory
+          auto parent = renamed_directories.find(previous_path.parent_path());
+          if(parent == renamed_directories.end() || parent->second != i.first.parent_path() || previous_path.filename() != i.first.filename())
+          {
+            push((st.st_type == filesystem::file_type::directory) ? difference_item::directory_renamed : difference_item::file_renamed, i.first, &previous_path);
+          }
+          departed.erase(departed_it);
+          continue;
+        }
+        auto remaining_it = remaining.find(key);
+        if(remaining_it != remaining.end() && st.st_type != filesystem::file_type::directory)
+        {
+          push(difference_item::file_linked, i.first, remaining_it->second);
+          continue;
+        }
+        switch(st.st_type)
+        {
+        case filesystem::file_type::directory:
+          push(difference_item::directory_added, i.first, nullptr);
+          break;
+        case filesystem::file_type::symlink:
+          push(difference_item::symlink_added, i.first, nullptr);
+          break;
+        default:
+          push(difference_item::file_added, i.first, nullptr);
+          break;
         }
-        state->operator+=(acc);
-        return success();
       }
-      catch(...)
+      // Report removals in path order
+      std::vector<tree_snapshot::const_iterator> removed;
+      removed.reserve(departed.size());
+      for(auto &i : departed)
       {
-        return error_from_exception();
+        removed.push_back(i.second);
       }
+      std::sort(removed.begin(), removed.end(), [](tree_snapshot::const_iterator a, tree_snapshot::const_iterator b) { return a->first < b->first; });
+      for(auto &i : removed)
+      {
+        switch(i->second.st_type)
+        {
+        case filesystem::file_type::directory:
+          push(difference_item::directory_removed, i->first, nullptr);
+          break;
+        case filesystem::file_type::symlink:
+          push(difference_item::symlink_removed, i->first, nullptr);
+          break;
+        default:
+          push(difference_item::file_removed, i->first, nullptr);
+          break;
+        }
+      }
+      return {std::move(ret)};
     }
-  };
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  /*! \brief Calculate the differences between two directory trees, such as two snapshots of
+  the same tree taken by the filing system, without capturing the metadata of either tree.
 
-  /*! \brief Summarise the directory identified `dirh`, and everything therein.
+  `after` is traversed in parallel by `traverse()` using up to `threads` threads. As each of its
+  directories is enumerated, the directory at the same path relative to `before` is enumerated,
+  the entries of both are sorted by leafname, and then merge joined. An entry only in `before`
+  is removed, an entry only in `after` is added, and an entry in both with a different type is
+  both. For a regular file or symlink in both, a differing maximum extent or modified timestamp
+  is a change of content metadata, otherwise a differing changed timestamp is a change of
+  non-content metadata. Only directories in both trees are descended into, so the addition or
+  removal of a directory is reported without anything within it. Memory consumed is therefore
+  proportional to the largest directory, not to the size of the trees.
 
-  It can be useful to summarise a directory hierarchy, especially to determine how
-  much storage it occupies, but also how many mounted filesystems it straddles etc.
-  You should specify what metadata you wish to summarise, if this is a subset of
-  what metadata `directory_handle::read()` returns, performance will be considerably
-  better. The default summarises all possible metadata.
+  As items are matched by path alone, unlike with `difference(const tree_snapshot &, const tree_snapshot &)`
+  renames are reported as a removal and an addition, and hard links as additions. Differences
+  are sorted by path, with removals reported last.
 
-  This is a trivial implementation on top of `algorithm::traverse()`, indeed it is
-  implemented entirely as header code. You should review the documentation for
-  `algorithm::traverse()`, as this algorithm is entirely implemented using that algorithm.
+  \errors Any of the values `traverse()` and `directory_handle::read()` can return.
   */
-  inline result<traversal_summary> summarize(const path_handle &dirh, stat_t::want want = traversal_summary::default_metadata(),
-                                             summarize_visitor *visitor = nullptr, size_t threads = 0, bool force_slow_path = false) noexcept
+  inline result<std::vector<difference_item>> difference(const path_handle &before, const path_handle &after, size_t threads = 0,
+                                                         bool force_slow_path = false) noexcept
   {
-    LLFIO_LOG_FUNCTION_CALL(&dirh);
-    summarize_visitor default_visitor;
-    if(visitor == nullptr)
+    LLFIO_LOG_FUNCTION_CALL(&after);
+    try
+    {
+      static constexpr stat_t::want metadata = stat_t::want::type | stat_t::want::size | stat_t::want::mtim | stat_t::want::ctim;
+      struct visitor_type final : public traverse_visitor
+      {
+        const path_handle &before, &after;
+        std::atomic<size_t> afterpathlen{0};
+        std::mutex lock;
+        std::vector<difference_item> items;
+
+        visitor_type(const path_handle &_before, const path_handle &_after)
+            : before(_before)
+            , after(_after)
+        {
+        }
+
+        static difference_item::change_t added(filesystem::file_type type) noexcept
+        {
+          return (type == filesystem::file_type::directory) ? difference_item::directory_added :
+                 (type == filesystem::file_type::symlink)   ? difference_item::symlink_added :
+                                                              difference_item::file_added;
+        }
+        static difference_item::change_t removed(filesystem::file_type type) noexcept
+        {
+          return (type == filesystem::file_type::directory) ? difference_item::directory_removed :
+                 (type == filesystem::file_type::symlink)   ? difference_item::symlink_removed :
+                                                              difference_item::file_removed;
+        }
+        // Entries whose metadata could not be fetched, most likely as they were removed meanwhile, are absent
+        static result<std::vector<directory_handle::buffer_type *>> sorted(const directory_handle &dirh, span<directory_handle::buffer_type> entries,
+                                                                           stat_t::want have)
+        {
+          std::vector<result<size_t>> filled;
+          if(metadata & ~have)
+          {
+            OUTCOME_TRY(filled, dirh.stat_entries(entries, metadata));
+          }
+          std::vector<directory_handle::buffer_type *> ret;
+          ret.reserve(entries.size());
+          for(size_t n = 0; n < entries.size(); n++)
+          {
+            if(filled.empty() || filled[n])
+            {
+              ret.push_back(&entries[n]);
+            }
+          }
+          std::sort(ret.begin(), ret.end(),
+                    [](const directory_handle::buffer_type *a, const directory_handle::buffer_type *b) { return a->leafname.compare(b->leafname) < 0; });
+          return {std::move(ret)};
+        }
+
+        virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+        {
+          (void) data;
+          (void) depth;
+          try
+          {
+            OUTCOME_TRY(auto &&relpath, relative_directory_path(after, afterpathlen, dirh));
+            OUTCOME_TRY(auto &&beforedirh, directory_handle::directory(before, relpath));
+            std::vector<directory_handle::buffer_type> entries(std::max(contents.size(), (size_t) 64));
+            directory_handle::buffers_type buffers;
+            for(;;)
+            {
+              buffers = {entries, std::move(buffers)};
+              OUTCOME_TRY(buffers, beforedirh.read({std::move(buffers), {}, directory_handle::filter::fastdeleted}));
+              if(buffers.done())
+              {
+                break;
+              }
+              entries.resize(entries.size() << 1);
+            }
+            OUTCOME_TRY(auto &&olds, sorted(beforedirh, buffers, buffers.metadata()));
+            OUTCOME_TRY(auto &&news, sorted(dirh, contents, contents.metadata()));
+            std::vector<difference_item> found;
+            auto push = [&](difference_item::change_t changed, path_view leafname) {
+              found.emplace_back();
+              found.back().changed = changed;
+              found.back().path = relpath / leafname.path();
+            };
+            size_t o = 0, n = 0;
+            while(o < olds.size() || n < news.size())
+            {
+              const int comparison = (o == olds.size()) ? 1 : (n == news.size()) ? -1 : olds[o]->leafname.compare(news[n]->leafname);
+              if(comparison < 0)
+              {
+                push(removed(olds[o]->stat.st_type), olds[o]->leafname);
+                o++;
+                continue;
+              }
+              auto &entry = *news[n++];
+              if(comparison > 0)
+              {
+                push(added(entry.stat.st_type), entry.leafname);
+                entry.stat.st_type = filesystem::file_type::none;  // do not descend
+                continue;
+              }
+              const auto &old = olds[o++]->stat;
+              if(old.st_type != entry.stat.st_type)
+              {
+                push(removed(old.st_type), entry.leafname);
+                push(added(entry.stat.st_type), entry.leafname);
+                entry.stat.st_type = filesystem::file_type::none;
+              }
+              else if(entry.stat.st_type != filesystem::file_type::directory && (old.st_size != entry.stat.st_size || old.st_mtim != entry.stat.st_mtim))
+              {
+                push(difference_item::content_metadata_changed, entry.leafname);
+              }
+              else if(old.st_ctim != entry.stat.st_ctim)
+              {
+                push(difference_item::noncontent_metadata_changed, entry.leafname);
+              }
+            }
+            if(!found.empty())
+            {
+              std::lock_guard<std::mutex> g(lock);
+              items.insert(items.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+            }
+            return success();
+          }
+          catch(...)
+          {
+            return error_from_exception();
+          }
+        }
+      } visitor(before, after);
+      OUTCOME_TRY(auto &&afterpath, after.current_path());
+      visitor.afterpathlen.store(afterpath.native().size() + 1, std::memory_order_relaxed);
+      OUTCOME_TRY(traverse(after, &visitor, threads, nullptr, force_slow_path));
+      auto is_removal = [](const difference_item &i) {
+        return i.changed == difference_item::file_removed || i.changed == difference_item::directory_removed || i.changed == difference_item::symlink_removed;
+      };
+      std::sort(visitor.items.begin(), visitor.items.end(), [&](const difference_item &a, const difference_item &b) {
+        const bool ra = is_removal(a), rb = is_removal(b);
+        return (ra != rb) ? rb : (a.path < b.path);
+      });
+      return {std::move(visitor.items)};
+    }
+    catch(...)
     {
-      visitor = &default_visitor;
+      return error_from_exception();
     }
-    result<traversal_summary> state(in_place_type<traversal_summary>);
-    state.assume_value().want = want;
-    directory_entry entry{{}, stat_t(nullptr)};
-    OUTCOME_TRY(entry.stat.fill(dirh, want));
-    OUTCOME_TRY(summarize_visitor::accumulate(state.assume_value(), &state.assume_value(), nullptr, entry, want));
-    OUTCOME_TRY(traverse(dirh, visitor, threads, &state.assume_value(), force_slow_path));
-    return state;
   }
 
+  /*! \brief Tracks the differences within a directory tree since the last time they were
+  fetched, using the change journal of the platform where possible.
+
+  On Linux, an inotify watch is placed on every directory within the tree, and only the
+  directories for which changes were recorded are enumerated again. If the kernel's queue of
+  changes overflows, or the per user limit on inotify watches is reached, or on platforms where
+  there is not yet a change journal implementation, the whole tree is traversed again and
+  compared with the previous snapshot instead. `full_traversals()` reports how often that
+  occurred.
+
+  Note that inotify does not report changes made through other hard links to a file outside the
+  tree, nor changes made on other machines to networked filesystems. Changes made whilst
+  `track()` is executing may not be reported until some later change to the same directory.
+  */
+  class LLFIO_DECL difference_tracker
+  {
+    path_handle _root;
+    filesystem::path _root_path;
+    tree_snapshot _snapshot;
+    size_t _threads{0};
+    size_t _full_traversals{0};
+    int _journal{-1};
+    std::unordered_map<int, filesystem::path> _watches;  // watch descriptor to path relative to root
+
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> _watch(const filesystem::path &relpath) noexcept;
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> _close_journal() noexcept;
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<difference_item>> _full_traversal() noexcept;
+
+  public:
+    //! Default constructor
+    difference_tracker() = default;
+    //! Move constructor
+    difference_tracker(difference_tracker &&o) noexcept
+        : _root(std::move(o._root))
+        , _root_path(std::move(o._root_path))
+        , _snapshot(std::move(o._snapshot))
+        , _threads(o._threads)
+        , _full_traversals(o._full_traversals)
+        , _journal(o._journal)
+        , _watches(std::move(o._watches))
+    {
+      o._journal = -1;
+    }
+    //! Move assignment
+    difference_tracker &operator=(difference_tracker &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~difference_tracker();
+      new(this) difference_tracker(std::move(o));
+      return *this;
+    }
+    difference_tracker(const difference_tracker &) = delete;
+    difference_tracker &operator=(const difference_tracker &) = delete;
+    ~difference_tracker() { (void) _close_journal(); }
+
+    /*! \brief Begin tracking the directory tree identified by `dirh`, taking an initial
+    snapshot using `threads` threads.
+    */
+    static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<difference_tracker> track(const path_handle &dirh, size_t threads = 0) noexcept;
+
+    //! The snapshot of the tree as of the last call to `track()` or `changes()`
+    const tree_snapshot &snapshot() const noexcept { return _snapshot; }
+    //! True if changes are being fetched from the platform's change journal
+    bool uses_change_journal() const noexcept { return _journal != -1; }
+    //! The number of times the whole tree had to be traversed again to find the changes
+    size_t full_traversals() const noexcept { return _full_traversals; }
+
+    /*! \brief Returns the differences within the tree since the previous call, or since
+    `track()` if there was no previous call, and updates `snapshot()`.
+    */
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<difference_item>> changes() noexcept;
+  };
+
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
 
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "../detail/impl/difference.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
 #endif
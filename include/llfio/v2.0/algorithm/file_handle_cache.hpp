@@ -0,0 +1,324 @@
+/* A cache of open file handles bounded in the file descriptors it consumes
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_FILE_HANDLE_CACHE_HPP
+#define LLFIO_ALGORITHM_FILE_HANDLE_CACHE_HPP
+
+#include "../file_handle.hpp"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//! \file file_handle_cache.hpp Provides a cache of open file handles bounded in the file descriptors it consumes.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief A cache of open file handles keyed by base directory and path, keeping at most a
+  fixed number open.
+
+  Opening a file which is open in the cache returns the open handle without any syscall. When
+  more than `max_open()` files would be open, the least recently used is closed, but the cache
+  remembers the inode which was opened, up to `max_remembered()` of them. Reopening such a file
+  verifies that the path still refers to the same inode, so use of the cache never silently
+  substitutes one file for another. If it does not, `errc::no_such_file_or_directory` is
+  returned and the cache forgets the path, so the next open opens whatever is there now.
+
+  Handles are returned as `std::shared_ptr<file_handle>`, so a handle in use is never closed
+  beneath its user. A handle evicted whilst in use is closed when its last user releases it,
+  so the number of open file descriptors may temporarily exceed `max_open()`.
+
+  The cache is divided into independently locked shards by the hash of the path, and opens and
+  closes happen without any lock held, so the cache scales with concurrent use. Paths are
+  distinguished by the native handle of the base directory, so base directories must remain open
+  whilst their files are in the cache, and `invalidate()` should be called for a path whose file
+  is known to have been replaced.
+  */
+  class file_handle_cache
+  {
+  public:
+    using mode = file_handle::mode;
+    using caching = file_handle::caching;
+    using flag = file_handle::flag;
+    using handle_ptr = std::shared_ptr<file_handle>;
+
+    //! Statistics about the use of the cache
+    struct statistics
+    {
+      uint64_t hits{0};       //!< Opens which returned an open handle
+      uint64_t misses{0};     //!< Opens of paths unknown to the cache
+      uint64_t reopens{0};    //!< Opens reopening an evicted handle whose inode was verified
+      uint64_t replaced{0};   //!< Reopens which found a different inode at the path
+      uint64_t evictions{0};  //!< Handles closed to stay within `max_open()`
+    };
+
+  private:
+    struct _key_type
+    {
+      intptr_t base;
+      filesystem::path::string_type path;
+      bool operator==(const _key_type &o) const noexcept { return base == o.base && path == o.path; }
+    };
+    struct _key_hasher
+    {
+      size_t operator()(const _key_type &k) const noexcept { return std::hash<filesystem::path::string_type>()(k.path) ^ (size_t) k.base; }
+    };
+    struct _entry_type
+    {
+      _key_type key;
+      handle_ptr h;  // null if evicted
+      fs_handle::unique_id_type unique_id;
+    };
+    using _list_type = std::list<_entry_type>;
+    struct _shard_type
+    {
+      std::mutex lock;
+      _list_type open, closed;  // most recently used at the front
+      std::unordered_map<_key_type, _list_type::iterator, _key_hasher> map;
+      statistics stats;
+    };
+
+    mode _mode;
+    caching _caching;
+    flag _flags;
+    size_t _max_open, _max_remembered;
+    std::vector<std::unique_ptr<_shard_type>> _shards;
+
+    static intptr_t _base_key(const path_handle &base) noexcept
+    {
+#ifdef _WIN32
+      return (intptr_t) base.native_handle().h;
+#else
+      return base.native_handle().fd;
+#endif
+    }
+    // Uses different bits of the hash to those the shard's hash table uses
+    _shard_type &_shard_for(const _key_type &key) noexcept { return *_shards[(size_t)(((uint64_t) _key_hasher()(key) * 0x9E3779B97F4A7C15ULL) >> 40U) % _shards.size()]; }
+    size_t _shard_max_open() const noexcept { return (std::max)((size_t) 1, _max_open / _shards.size()); }
+    size_t _shard_max_remembered() const noexcept { return _max_remembered / _shards.size(); }
+    // Moves least recently used entries from open to closed, returning their handles for closing without the lock held. May throw.
+    void _trim(_shard_type &s, std::vector<handle_ptr> &toclose)
+    {
+      while(s.open.size() > _shard_max_open())
+      {
+        auto it = std::prev(s.open.end());
+        toclose.push_back(std::move(it->h));
+        s.closed.splice(s.closed.begin(), s.open, it);
+        s.stats.evictions++;
+      }
+      while(s.closed.size() > _shard_max_remembered())
+      {
+        s.map.erase(s.closed.back().key);
+        s.closed.pop_back();
+      }
+    }
+
+  public:
+    /*! Constructs a cache keeping at most `max_open` files open, remembering the inodes of at most
+    `max_remembered` evicted files, or four times `max_open` if zero, divided into `shards` shards.
+    Files are opened with `mode_`, `caching_` and `flags`.
+    */
+    explicit file_handle_cache(size_t max_open, size_t max_remembered = 0, size_t shards = 16, mode mode_ = mode::read, caching caching_ = caching::all,
+                               flag flags = flag::none)
+        : _mode(mode_)
+        , _caching(caching_)
+        , _flags(flags)
+        , _max_open(max_open)
+        , _max_remembered((max_remembered == 0) ? max_open * 4 : max_remembered)
+    {
+      if(shards == 0)
+      {
+        shards = 1;
+      }
+      _shards.reserve(shards);
+      for(size_t n = 0; n < shards; n++)
+      {
+        _shards.push_back(std::unique_ptr<_shard_type>(new _shard_type));
+      }
+    }
+    file_handle_cache(const file_handle_cache &) = delete;
+    file_handle_cache(file_handle_cache &&) = delete;
+    file_handle_cache &operator=(const file_handle_cache &) = delete;
+    file_handle_cache &operator=(file_handle_cache &&) = delete;
+    ~file_handle_cache() = default;
+
+    //! The maximum number of files the cache keeps open.
+    size_t max_open() const noexcept { return _max_open; }
+    //! The maximum number of evicted files whose inodes the cache remembers.
+    size_t max_remembered() const noexcept { return _max_remembered; }
+
+    /*! \brief Returns a handle to the existing file at `path` relative to `base`, opening it only
+    if it is not open in the cache.
+
+    \errors Any of the values `file_handle::file()` can return, `errc::no_such_file_or_directory` if
+    the path no longer refers to the inode previously opened there.
+    */
+    result<handle_ptr> open(const path_handle &base, path_view path) noexcept
+    {
+      try
+      {
+        _key_type key{_base_key(base), path.path().native()};
+        auto &s = _shard_for(key);
+        bool known = false;
+        fs_handle::unique_id_type unique_id;
+        {
+          std::lock_guard<std::mutex> g(s.lock);
+          auto it = s.map.find(key);
+          if(it != s.map.end())
+          {
+            if(it->second->h)
+            {
+              s.open.splice(s.open.begin(), s.open, it->second);
+              s.stats.hits++;
+              return it->second->h;
+            }
+            known = true;
+            unique_id = it->second->unique_id;
+          }
+        }
+        OUTCOME_TRY(auto &&fh, file_handle::file(base, path, _mode, file_handle::creation::open_existing, _caching, _flags));
+        handle_ptr h = std::make_shared<file_handle>(std::move(fh));
+        std::vector<handle_ptr> toclose;
+        {
+          std::lock_guard<std::mutex> g(s.lock);
+          auto it = s.map.find(key);
+          if(it != s.map.end() && it->second->h)
+          {
+            // Another thread opened it meanwhile, so use theirs
+            s.open.splice(s.open.begin(), s.open, it->second);
+            s.stats.hits++;
+            toclose.push_back(std::move(h));
+            return it->second->h;
+          }
+          if(known)
+          {
+            if(!(h->unique_id() == unique_id))
+            {
+              if(it != s.map.end())
+              {
+                s.closed.erase(it->second);
+                s.map.erase(it);
+              }
+              s.stats.replaced++;
+              return errc::no_such_file_or_directory;
+            }
+            s.stats.reopens++;
+          }
+          else
+          {
+            s.stats.misses++;
+          }
+          if(it != s.map.end())
+          {
+            it->second->h = h;
+            s.open.splice(s.open.begin(), s.closed, it->second);
+          }
+          else
+          {
+            s.open.push_front(_entry_type{key, h, h->unique_id()});
+            s.map.emplace(std::move(key), s.open.begin());
+          }
+          _trim(s, toclose);
+        }
+        return h;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Forgets the file at `path` relative to `base`, closing it if no longer in use.
+    void invalidate(const path_handle &base, path_view path) noexcept
+    {
+      try
+      {
+        _key_type key{_base_key(base), path.path().native()};
+        auto &s = _shard_for(key);
+        handle_ptr toclose;
+        std::lock_guard<std::mutex> g(s.lock);
+        auto it = s.map.find(key);
+        if(it != s.map.end())
+        {
+          toclose = std::move(it->second->h);
+          (toclose ? s.open : s.closed).erase(it->second);
+          s.map.erase(it);
+        }
+      }
+      catch(...)
+      {
+      }
+    }
+
+    //! Closes all open files and forgets all paths.
+    void clear() noexcept
+    {
+      for(auto &s : _shards)
+      {
+        _list_type open, closed;
+        std::lock_guard<std::mutex> g(s->lock);
+        s->map.clear();
+        open.swap(s->open);
+        closed.swap(s->closed);
+      }
+    }
+
+    //! The number of files currently open in the cache.
+    size_t open_count() const noexcept
+    {
+      size_t ret = 0;
+      for(auto &s : _shards)
+      {
+        std::lock_guard<std::mutex> g(s->lock);
+        ret += s->open.size();
+      }
+      return ret;
+    }
+
+    //! Statistics about the use of the cache summed over all shards.
+    statistics stats() const noexcept
+    {
+      statistics ret;
+      for(auto &s : _shards)
+      {
+        std::lock_guard<std::mutex> g(s->lock);
+        ret.hits += s->stats.hits;
+        ret.misses += s->stats.misses;
+        ret.reopens += s->stats.reopens;
+        ret.replaced += s->stats.replaced;
+        ret.evictions += s->stats.evictions;
+      }
+      return ret;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
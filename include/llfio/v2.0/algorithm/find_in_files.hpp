@@ -0,0 +1,361 @@
+/* A parallel search of the contents of the files in a directory tree
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_FIND_IN_FILES_HPP
+#define LLFIO_ALGORITHM_FIND_IN_FILES_HPP
+
+#include "traverse.hpp"
+
+#include "../file_handle.hpp"
+#include "../map_handle.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>  // for SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>  // for _BitScanForward64
+#endif
+
+//! \file find_in_files.hpp Provides a parallel search of the contents of the files in a directory tree.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    inline unsigned find_in_files_lowest_bit(uint64_t v) noexcept
+    {
+#ifdef _MSC_VER
+      unsigned long ret;
+      _BitScanForward64(&ret, v);
+      return (unsigned) ret;
+#else
+      return (unsigned) __builtin_ctzll(v);
+#endif
+    }
+  }  // namespace detail
+
+  /*! \brief Returns the offset of the first occurrence of `needle` within `haystack`, or `(size_t) -1`
+  if there is none.
+
+  Sixteen candidate offsets at a time are compared for both the first and the last byte of the
+  needle using SSE2 on x64 and NEON on AArch64, and only offsets matching both are compared in
+  full. This does very much less work than comparing at every offset whose first byte matches,
+  as `memchr()` based searches do, for all but pathological data.
+  */
+  inline size_t find_substring(span<const byte> haystack, span<const byte> needle) noexcept
+  {
+    if(needle.empty())
+    {
+      return 0;
+    }
+    if(needle.size() > haystack.size())
+    {
+      return (size_t) -1;
+    }
+    const byte *h = haystack.data(), *s = needle.data();
+    const size_t len = needle.size(), candidates = haystack.size() - len + 1;
+    size_t n = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    const __m128i first = _mm_set1_epi8((char) s[0]), last = _mm_set1_epi8((char) s[len - 1]);
+    for(; n + 16 <= candidates; n += 16)
+    {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + n));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(h + n + len - 1));
+      uint64_t mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+      while(mask != 0)
+      {
+        const size_t offset = n + detail::find_in_files_lowest_bit(mask);
+        if(memcmp(h + offset, s, len) == 0)
+        {
+          return offset;
+        }
+        mask &= mask - 1;
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t first = vdupq_n_u8((uint8_t) s[0]), last = vdupq_n_u8((uint8_t) s[len - 1]);
+    for(; n + 16 <= candidates; n += 16)
+    {
+      const uint8x16_t a = vld1q_u8(reinterpret_cast<const uint8_t *>(h + n));
+      const uint8x16_t b = vld1q_u8(reinterpret_cast<const uint8_t *>(h + n + len - 1));
+      const uint8x16_t eq = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+      // Narrowing leaves four bits per byte compared, as NEON has no movemask
+      uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+      while(mask != 0)
+      {
+        const unsigned bit = detail::find_in_files_lowest_bit(mask);
+        const size_t offset = n + (bit >> 2U);
+        if(memcmp(h + offset, s, len) == 0)
+        {
+          return offset;
+        }
+        mask &= ~(uint64_t(0xf) << (bit & ~3U));
+      }
+    }
+#endif
+    for(; n < candidates; n++)
+    {
+      if(h[n] == s[0] && memcmp(h + n, s, len) == 0)
+      {
+        return n;
+      }
+    }
+    return (size_t) -1;
+  }
+
+  /*! \brief The counts returned by `find_in_files()`.
+   */
+  struct find_in_files_summary
+  {
+    size_t files_searched{0};             //!< The number of files whose contents were searched.
+    size_t files_matched{0};              //!< The number of files containing at least one match.
+    size_t files_failed{0};               //!< The number of files which could not be opened or read.
+    size_t matches{0};                    //!< The number of matches found.
+    handle::extent_type bytes_searched{0};  //!< The number of bytes searched.
+  };
+
+  /*! \brief The state of a `find_in_files()`, which is the `data` passed to the visitor's callbacks.
+   */
+  struct find_in_files_state
+  {
+    span<const byte> needle;                //!< What is being sought
+    handle::extent_type mapping_threshold;  //!< Files larger than this are mapped rather than read
+    std::atomic<size_t> files_searched{0}, files_matched{0}, files_failed{0}, matches{0};
+    std::atomic<handle::extent_type> bytes_searched{0};
+  };
+
+  /*! \brief A visitor for the parallel find in files algorithm.
+
+  Note that at any time, returning a failure causes `find_in_files()` to exit as soon
+  as possible with the same failure.
+
+  You can override the members here inherited from `traverse_visitor`, however note
+  that `find_in_files()` is entirely implemented using `traverse()`, so not calling the
+  implementations here will affect operation.
+  */
+  struct find_in_files_visitor : public traverse_visitor
+  {
+    /*! \brief Called for each occurrence of the needle within the file `leafname` in `dirh`, in
+    order of `offset`. `contents` is the whole of the file, so surrounding context such as the line
+    containing the match can be examined, or matched against a regular expression for which the
+    needle was a required substring. Returning false stops the search of this file. The default
+    returns true.
+
+    `contents` are only valid for the duration of the call.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<bool> match_found(void *data, const directory_handle &dirh, path_view leafname, span<const byte> contents, size_t offset) noexcept
+    {
+      (void) data;
+      (void) dirh;
+      (void) leafname;
+      (void) contents;
+      (void) offset;
+      return true;
+    }
+
+    /*! \brief Called when a file could not be opened or read. The default ignores the failure,
+    counting it in `find_in_files_summary::files_failed`.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<void> file_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leafname) noexcept
+    {
+      (void) error;
+      (void) dirh;
+      (void) leafname;
+      auto *state = (find_in_files_state *) data;
+      state->files_failed.fetch_add(1, std::memory_order_relaxed);
+      return success();
+    }
+
+    //! This override ignores failures to traverse into the directory.
+    virtual result<directory_handle> directory_open_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leaf,
+                                                           size_t depth) noexcept override
+    {
+      (void) data;
+      (void) error;
+      (void) dirh;
+      (void) leaf;
+      (void) depth;
+      return success();  // ignore failure to enter
+    }
+
+    //! Reports every match of the needle within `contents`, returning the number of matches.
+    result<size_t> search(void *data, const directory_handle &dirh, path_view leafname, span<const byte> contents) noexcept
+    {
+      auto *state = (find_in_files_state *) data;
+      size_t ret = 0;
+      for(size_t offset = 0; offset < contents.size();)
+      {
+        const size_t found = find_substring({contents.data() + offset, contents.size() - offset}, state->needle);
+        if(found == (size_t) -1)
+        {
+          break;
+        }
+        offset += found;
+        ret++;
+        OUTCOME_TRY(auto &&more, match_found(data, dirh, leafname, contents, offset));
+        if(!more)
+        {
+          break;
+        }
+        offset++;
+      }
+      return ret;
+    }
+
+    /*! \brief Searches the file `leafname` in `dirh`, reading it into `buffer` if it is no larger
+    than the mapping threshold, otherwise mapping it into memory.
+    */
+    result<void> search_file(void *data, const directory_handle &dirh, path_view leafname, std::vector<byte> &buffer) noexcept
+    {
+      auto *state = (find_in_files_state *) data;
+      auto r = [&]() -> result<size_t> {
+        try
+        {
+          OUTCOME_TRY(auto &&fh, file_handle::file(dirh, leafname, file_handle::mode::read));
+          OUTCOME_TRY(auto &&length, fh.maximum_extent());
+          if(length < state->needle.size())
+          {
+            state->files_searched.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+          }
+          span<const byte> contents;
+          map_handle mh;
+          if(length <= state->mapping_threshold)
+          {
+            // One read() costs less than setting up and tearing down a map
+            buffer.resize((size_t) length);
+            OUTCOME_TRY(auto &&read, fh.read(0, {{buffer.data(), buffer.size()}}));
+            contents = {buffer.data(), read};
+          }
+          else
+          {
+            OUTCOME_TRY(auto &&sh, section_handle::section(fh, 0, section_handle::flag::read));
+            OUTCOME_TRY(mh, map_handle::map(sh, (size_t) length, 0, section_handle::flag::read));
+            // The search proceeds sequentially, so have the kernel read ahead
+            (void) map_handle::prefetch(map_handle::buffer_type{mh.address(), (size_t) length});
+            contents = {mh.address(), (size_t) length};
+          }
+          state->files_searched.fetch_add(1, std::memory_order_relaxed);
+          state->bytes_searched.fetch_add(contents.size(), std::memory_order_relaxed);
+          return search(data, dirh, leafname, contents);
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }();
+      if(!r)
+      {
+        return file_failed(data, std::move(r).error(), dirh, leafname);
+      }
+      if(r.value() > 0)
+      {
+        state->files_matched.fetch_add(1, std::memory_order_relaxed);
+        state->matches.fetch_add(r.value(), std::memory_order_relaxed);
+      }
+      return success();
+    }
+
+    //! This override searches every regular file just enumerated
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      (void) depth;
+      try
+      {
+        std::vector<byte> buffer;
+        for(auto &entry : contents)
+        {
+          if(entry.stat.st_type == filesystem::file_type::regular)
+          {
+            OUTCOME_TRY(search_file(data, dirh, entry.leafname, buffer));
+          }
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief Searches the contents of every regular file within and under `dirh` for `needle`,
+  reporting each match to `visitor`.
+
+  The directory tree is traversed in parallel by `algorithm::traverse()` using up to `threads`
+  threads, and each thread searches the files of each directory it enumerates. Files no larger
+  than `mapping_threshold` are read into a buffer reused by the thread with a single `read()`,
+  larger files are mapped into memory and have read ahead requested with `map_handle::prefetch()`.
+  Files are searched with `find_substring()`, which uses SIMD where available. Every occurrence
+  is reported, including those overlapping earlier ones.
+
+  Files which cannot be opened or read are counted but otherwise ignored, as are directories
+  which cannot be entered, unless the visitor overrides that. Symbolic links are not followed.
+
+  You should review the documentation for `algorithm::traverse()`, as this algorithm is entirely
+  implemented using that algorithm.
+  */
+  inline result<find_in_files_summary> find_in_files(const path_handle &dirh, span<const byte> needle, find_in_files_visitor *visitor = nullptr, size_t threads = 0,
+                                                     handle::extent_type mapping_threshold = 256 * 1024) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    if(needle.empty())
+    {
+      return errc::invalid_argument;
+    }
+    find_in_files_visitor default_visitor;
+    if(visitor == nullptr)
+    {
+      visitor = &default_visitor;
+    }
+    find_in_files_state state;
+    state.needle = needle;
+    state.mapping_threshold = mapping_threshold;
+    OUTCOME_TRY(traverse(dirh, visitor, threads, &state));
+    find_in_files_summary ret;
+    ret.files_searched = state.files_searched.load(std::memory_order_relaxed);
+    ret.files_matched = state.files_matched.load(std::memory_order_relaxed);
+    ret.files_failed = state.files_failed.load(std::memory_order_relaxed);
+    ret.matches = state.matches.load(std::memory_order_relaxed);
+    ret.bytes_searched = state.bytes_searched.load(std::memory_order_relaxed);
+    return ret;
+  }
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -33,6 +33,12 @@ Distributed under the Boost Software License, Version 1.0.
 #endif
 
 //! \file handle_adapter/cached_parent.hpp Adapts any `fs_handle` to cache its parent directory handle
+
+#ifndef LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN
+//! The number of most recently used parent directories kept open in each shard of the process wide cache
+#define LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN 4
+#endif
+
 LLFIO_V2_NAMESPACE_BEGIN
 
 namespace algorithm
@@ -42,6 +48,7 @@ namespace algorithm
     struct LLFIO_DECL cached_path_handle : public std::enable_shared_from_this<cached_path_handle>
     {
       directory_handle h;
+      spinlock _lock;  // protects _lastpath
       filesystem::path _lastpath;
       explicit cached_path_handle(directory_handle &&_h)
           : h(std::move(_h))
@@ -60,7 +67,11 @@ namespace algorithm
   e.g. calling `relink()` or `unlink()` a lot on many files with the same parent directory, having to constantly
   fetch the current path, open the parent directory and verify inodes becomes unhelpfully inefficient. This
   adapter keeps a process-wide hash table of directory handles shared between all instances of this adapter,
-  thus making calling `parent_path_handle()` almost zero cost.
+  thus making calling `parent_path_handle()` almost zero cost. The table is sharded by the hash of the directory
+path, so threads working in different directories rarely contend, and finding an already open directory whose path
+was supplied without a base allocates no memory. The most recently used directories in each shard are kept open
+even with no adapters using them, to a total of `LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN` times the number of
+shards, so repeatedly opening and closing files in the same directories does not repeatedly open those directories.
 
   This adapter is of especial use on platforms which do not reliably implement per-fd path tracking for regular
   files (Apple MacOS, FreeBSD) as `current_path()` is reimplemented to use the current path of the shared parent
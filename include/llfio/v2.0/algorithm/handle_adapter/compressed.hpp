@@ -0,0 +1,650 @@
+/* A handle which compresses the data of another handle in seekable blocks
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_COMPRESSED_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_COMPRESSED_H
+
+#include "combining.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef LLFIO_ENABLE_LZ4
+#include <lz4.h>
+#endif
+#ifdef LLFIO_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+//! \file handle_adapter/compressed.hpp Provides `compressed_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+#if defined(LLFIO_ENABLE_LZ4) || defined(DOXYGEN_IS_IN_THE_HOUSE)
+  /*! \brief A codec for `compressed_handle_adapter` using LZ4. Requires `LLFIO_ENABLE_LZ4` to be
+  defined, and the program to be linked to lz4.
+  */
+  struct lz4_codec
+  {
+    //! The maximum bytes compressing `bytes` can produce
+    size_t compress_bound(size_t bytes) const noexcept { return (size_t) LZ4_compressBound((int) bytes); }
+    //! Compresses `in` into `out`, returning the bytes of `out` used
+    result<size_t> compress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      const int ret = LZ4_compress_default(reinterpret_cast<const char *>(in), reinterpret_cast<char *>(out), (int) inbytes, (int) outbytes);
+      if(ret <= 0)
+      {
+        return errc::no_buffer_space;
+      }
+      return (size_t) ret;
+    }
+    //! Decompresses `in` into exactly `outbytes` of `out`
+    result<void> decompress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      const int ret = LZ4_decompress_safe(reinterpret_cast<const char *>(in), reinterpret_cast<char *>(out), (int) inbytes, (int) outbytes);
+      if(ret != (int) outbytes)
+      {
+        return errc::illegal_byte_sequence;
+      }
+      return success();
+    }
+  };
+#endif
+#if defined(LLFIO_ENABLE_ZSTD) || defined(DOXYGEN_IS_IN_THE_HOUSE)
+  /*! \brief A codec for `compressed_handle_adapter` using Zstandard. Requires `LLFIO_ENABLE_ZSTD`
+  to be defined, and the program to be linked to zstd.
+  */
+  struct zstd_codec
+  {
+    //! The compression level
+    int level{3};
+
+    //! The maximum bytes compressing `bytes` can produce
+    size_t compress_bound(size_t bytes) const noexcept { return ZSTD_compressBound(bytes); }
+    //! Compresses `in` into `out`, returning the bytes of `out` used
+    result<size_t> compress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      const size_t ret = ZSTD_compress(out, outbytes, in, inbytes, level);
+      if(ZSTD_isError(ret))
+      {
+        return errc::no_buffer_space;
+      }
+      return ret;
+    }
+    //! Decompresses `in` into exactly `outbytes` of `out`
+    result<void> decompress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      const size_t ret = ZSTD_decompress(out, outbytes, in, inbytes);
+      if(ZSTD_isError(ret) || ret != outbytes)
+      {
+        return errc::illegal_byte_sequence;
+      }
+      return success();
+    }
+  };
+#endif
+
+  /*! \class compressed_handle_adapter
+  \brief A file handle compressing its data into independently decodable fixed size blocks
+  within another file handle, with a block index in a third.
+  \tparam Codec The compression codec, which must provide `compress_bound()`, `compress()` and
+  `decompress()` as `lz4_codec` does, callable concurrently.
+  \tparam Target The type of the handles backing the adapter, which must be a `file_handle`.
+
+  \warning This class is still in development, do not use.
+
+  The logical file is divided into blocks of `block_size()` bytes, each compressed
+  separately. Compressed blocks are appended to the data handle, and the index handle holds a
+  header recording the block size and logical size, followed by an entry per block recording
+  where its compressed bytes are. Blocks not compressing to less than `block_size()` are stored
+  uncompressed, and blocks never written are not stored at all, reading as zeros. The index is
+  in host byte order.
+
+  Reads decompress only the blocks they touch, reading and decompressing up to `batch_blocks`
+  blocks at a time. Writes recompress the blocks they touch, reading any partially covered
+  block first, and append all the blocks of each batch with a single gather write before the
+  index entries are updated with a single write. As rewritten blocks are appended, the space their
+  previous versions used in the data handle is not reclaimed. Copying the adapter to a new
+  adapter compacts it.
+
+  Reads may be issued concurrently with one another and with writes, but writes are serialised
+  by a mutex. A barrier issues a barrier to the data handle before the index handle, so the
+  index never refers to data which is not durable.
+
+  \note If OpenMP is available, `LLFIO_DISABLE_OPENMP` is not defined, and
+  `flag::disable_parallelism` is not set, the blocks of each batch will be compressed and
+  decompressed concurrently.
+
+  Destroying the adapter does not destroy the attached handles. Closing the adapter
+  does close the attached handles.
+  */
+  template <class Codec, class Target> class compressed_handle_adapter : public detail::file_handle_wrapper
+  {
+    static_assert(std::is_base_of<file_handle, Target>::value, "compressed_handle_adapter requires the backing handles to be file handles");
+
+  public:
+    using path_type = io_handle::path_type;
+    using extent_type = io_handle::extent_type;
+    using size_type = io_handle::size_type;
+    using mode = io_handle::mode;
+    using creation = io_handle::creation;
+    using caching = io_handle::caching;
+    using flag = io_handle::flag;
+    using buffer_type = io_handle::buffer_type;
+    using const_buffer_type = io_handle::const_buffer_type;
+    using buffers_type = io_handle::buffers_type;
+    using const_buffers_type = io_handle::const_buffers_type;
+    template <class T> using io_request = io_handle::io_request<T>;
+    template <class T> using io_result = io_handle::io_result<T>;
+
+    using codec_type = Codec;
+    using target_handle_type = Target;
+
+    //! The maximum number of blocks read, compressed or decompressed at a time
+    static constexpr size_t batch_blocks = 64;
+
+  protected:
+    static constexpr uint64_t _magic = 0x31504d4f434f464cULL;  // "LFOCOMP1"
+    struct _header
+    {
+      uint64_t magic, block_size, size, reserved;
+    };
+    struct _entry
+    {
+      uint64_t offset;
+      uint32_t bytes;  // zero if never written
+      uint32_t stored;
+    };
+    static_assert(sizeof(_header) == 32 && sizeof(_entry) == 16, "index structures are not packed");
+    struct _state
+    {
+      std::mutex lock;
+      std::vector<_entry> index;
+      extent_type size{0}, data_end{0};
+    };
+    target_handle_type *_data{nullptr}, *_index{nullptr};
+    codec_type _codec;
+    size_t _block_size{0};
+    std::unique_ptr<_state> _s;
+
+  private:
+    static constexpr native_handle_type _native_handle(mode _mode)
+    {
+      native_handle_type nativeh;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable;
+      if(_mode == mode::write)
+      {
+        nativeh.behaviour |= native_handle_type::disposition::writable;
+      }
+      return nativeh;
+    }
+    static caching _combine_caching(target_handle_type *a, target_handle_type *b) { return (a->kernel_caching() < b->kernel_caching()) ? a->kernel_caching() : b->kernel_caching(); }
+
+    static result<void> _read_exactly(target_handle_type *h, extent_type offset, byte *out, size_t bytes, deadline d) noexcept
+    {
+      buffer_type b(out, bytes);
+      io_request<buffers_type> req({&b, 1}, offset);
+      OUTCOME_TRY(auto &&read, h->read(req, d));
+      size_t done = 0;
+      // Some handles e.g. mapped ones return buffers other than those supplied
+      for(const auto &r : read)
+      {
+        if(r.data() != out + done)
+        {
+          memcpy(out + done, r.data(), r.size());
+        }
+        done += r.size();
+      }
+      if(done != bytes)
+      {
+        return errc::io_error;
+      }
+      return success();
+    }
+    static result<void> _write_exactly(target_handle_type *h, extent_type offset, span<const_buffer_type> buffers, deadline d) noexcept
+    {
+      size_t bytes = 0;
+      for(const auto &b : buffers)
+      {
+        bytes += b.size();
+      }
+      io_request<const_buffers_type> req(buffers, offset);
+      OUTCOME_TRY(auto &&written, h->write(req, d));
+      for(const auto &b : written)
+      {
+        bytes -= b.size();
+      }
+      if(bytes != 0)
+      {
+        return errc::io_error;
+      }
+      return success();
+    }
+    result<void> _write_header(deadline d) noexcept
+    {
+      const _header h{_magic, _block_size, _s->size, 0};
+      const_buffer_type b(reinterpret_cast<const byte *>(&h), sizeof(h));
+      return _write_exactly(_index, 0, {&b, 1}, d);
+    }
+    _entry _entry_for(extent_type block) const noexcept { return (block < _s->index.size()) ? _s->index[(size_t) block] : _entry{0, 0, 0}; }
+    size_t _scratch_bound() const noexcept { return (std::max)(_codec.compress_bound(_block_size), _block_size); }
+
+    // Decodes the block described by e into out, using in as scratch for its compressed bytes
+    result<void> _decode(byte *out, byte *in, const _entry &e, deadline d) const noexcept
+    {
+      if(e.bytes == 0)
+      {
+        memset(out, 0, _block_size);
+        return success();
+      }
+      if(e.stored != 0)
+      {
+        return _read_exactly(_data, e.offset, out, _block_size, d);
+      }
+      OUTCOME_TRY(_read_exactly(_data, e.offset, in, e.bytes, d));
+      return _codec.decompress(out, _block_size, in, e.bytes);
+    }
+
+    // Writes the request, with the lock held
+    result<void> _write_locked(io_request<const_buffers_type> reqs, deadline d) noexcept
+    {
+      try
+      {
+        const size_t bs = _block_size, bound = _scratch_bound();
+        size_t total = 0;
+        for(const auto &b : reqs.buffers)
+        {
+          total += b.size();
+        }
+        if(total == 0)
+        {
+          return success();
+        }
+        const extent_type end = reqs.offset + total, first = reqs.offset / bs, last = (end + bs - 1) / bs;
+        const size_t maxcount = (size_t)(std::min)((extent_type) batch_blocks, last - first);
+        OUTCOME_TRY(auto &&scratch, map_handle::map(maxcount * (bs + bound)));
+        byte *plain = scratch.address(), *packed = plain + maxcount * bs;
+        size_t bufidx = 0, bufpos = 0;
+        for(extent_type b = first; b < last; b += maxcount)
+        {
+          const size_t count = (size_t)(std::min)((extent_type) maxcount, last - b);
+          // Assemble the plain blocks, reading in any partially covered
+          for(size_t n = 0; n < count; n++)
+          {
+            byte *p = plain + n * bs;
+            const extent_type bstart = (b + n) * bs, lo = (std::max)(bstart, reqs.offset), hi = (std::min)(bstart + bs, end);
+            if(lo > bstart || hi < bstart + bs)
+            {
+              OUTCOME_TRY(_decode(p, packed + n * bound, _entry_for(b + n), d));
+            }
+            for(size_t done = (size_t)(lo - bstart); done < (size_t)(hi - bstart);)
+            {
+              const auto &buffer = reqs.buffers[bufidx];
+              const size_t bytes = (std::min)(buffer.size() - bufpos, (size_t)(hi - bstart) - done);
+              memcpy(p + done, buffer.data() + bufpos, bytes);
+              done += bytes;
+              bufpos += bytes;
+              if(bufpos == buffer.size())
+              {
+                bufidx++;
+                bufpos = 0;
+              }
+            }
+          }
+          // Compress them concurrently
+          optional<result<size_t>> packedbytes[batch_blocks];
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if((this->_flags & flag::disable_parallelism) == 0)
+#endif
+          for(size_t n = 0; n < count; n++)
+          {
+            packedbytes[n] = _codec.compress(packed + n * bound, bound, plain + n * bs, bs);
+          }
+          // Append them with a single gather write, then update their index entries
+          const_buffer_type buffers[batch_blocks];
+          _entry entries[batch_blocks];
+          extent_type offset = _s->data_end;
+          for(size_t n = 0; n < count; n++)
+          {
+            if(!*packedbytes[n])
+            {
+              return std::move(*packedbytes[n]).error();
+            }
+            const size_t bytes = packedbytes[n]->value();
+            if(bytes < bs)
+            {
+              buffers[n] = {packed + n * bound, bytes};
+              entries[n] = {offset, (uint32_t) bytes, 0};
+            }
+            else
+            {
+              buffers[n] = {plain + n * bs, bs};
+              entries[n] = {offset, (uint32_t) bs, 1};
+            }
+            offset += buffers[n].size();
+          }
+          OUTCOME_TRY(_write_exactly(_data, _s->data_end, {buffers, count}, d));
+          _s->data_end = offset;
+          const_buffer_type entriesb(reinterpret_cast<const byte *>(entries), count * sizeof(_entry));
+          OUTCOME_TRY(_write_exactly(_index, sizeof(_header) + b * sizeof(_entry), {&entriesb, 1}, d));
+          if(_s->index.size() < b + count)
+          {
+            _s->index.resize((size_t)(b + count), _entry{0, 0, 0});
+          }
+          memcpy(_s->index.data() + b, entries, count * sizeof(_entry));
+        }
+        if(end > _s->size)
+        {
+          _s->size = end;
+          OUTCOME_TRY(_write_header(d));
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+  protected:
+    compressed_handle_adapter(target_handle_type *data, target_handle_type *index, codec_type &&codec, size_t block_size, std::unique_ptr<_state> s, mode _mode,
+                              flag flags, io_multiplexer *ctx)
+        : detail::file_handle_wrapper(_native_handle(_mode), _combine_caching(data, index), flags, ctx)
+        , _data(data)
+        , _index(index)
+        , _codec(std::move(codec))
+        , _block_size(block_size)
+        , _s(std::move(s))
+    {
+    }
+
+  public:
+    //! Default constructor
+    compressed_handle_adapter() = default;
+    //! Implicit move construction of compressed_handle_adapter permitted
+    compressed_handle_adapter(compressed_handle_adapter &&o) noexcept
+        : detail::file_handle_wrapper(std::move(o))
+        , _data(o._data)
+        , _index(o._index)
+        , _codec(std::move(o._codec))
+        , _block_size(o._block_size)
+        , _s(std::move(o._s))
+    {
+      o._data = o._index = nullptr;
+    }
+    //! No copy construction
+    compressed_handle_adapter(const compressed_handle_adapter &) = delete;
+    //! Move assignment of compressed_handle_adapter permitted
+    compressed_handle_adapter &operator=(compressed_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~compressed_handle_adapter();
+      new(this) compressed_handle_adapter(std::move(o));
+      return *this;
+    }
+    //! No copy assignment
+    compressed_handle_adapter &operator=(const compressed_handle_adapter &) = delete;
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~compressed_handle_adapter() override
+    {
+      // ignore
+    }
+
+    /*! \brief Create an adapter compressing into `data`, with its block index in `index`.
+    \param data The handle into which compressed blocks are appended.
+    \param index The handle holding the block index. If empty, a new index is written.
+    \param codec The compression codec to use.
+    \param block_size The bytes of each block before compression.
+    \param _mode Whether the adapter is writable.
+    \param flags Any additional flags.
+    \param ctx The multiplexer to use, if any.
+
+    \errors `errc::invalid_argument` if `block_size` is zero or does not fit into 32 bits, or
+    `index` is not empty and does not contain an index of blocks of `block_size`. Any of the
+    values `read()` and `write()` can return.
+    */
+    static result<compressed_handle_adapter> compressed(target_handle_type *data, target_handle_type *index, codec_type codec = {}, size_t block_size = 65536,
+                                                        mode _mode = mode::write, flag flags = flag::none, io_multiplexer *ctx = nullptr) noexcept
+    {
+      try
+      {
+        if(block_size == 0 || (uint64_t) block_size > (uint32_t) -1)
+        {
+          return errc::invalid_argument;
+        }
+        auto s = std::make_unique<_state>();
+        OUTCOME_TRY(auto &&indexbytes, index->maximum_extent());
+        OUTCOME_TRY(auto &&databytes, data->maximum_extent());
+        s->data_end = databytes;
+        if(indexbytes > 0)
+        {
+          _header h;
+          if(indexbytes < sizeof(h))
+          {
+            return errc::invalid_argument;
+          }
+          OUTCOME_TRY(_read_exactly(index, 0, reinterpret_cast<byte *>(&h), sizeof(h), {}));
+          if(h.magic != _magic || h.block_size != block_size)
+          {
+            return errc::invalid_argument;
+          }
+          s->size = h.size;
+          s->index.resize((size_t)((indexbytes - sizeof(h)) / sizeof(_entry)));
+          if(!s->index.empty())
+          {
+            OUTCOME_TRY(_read_exactly(index, sizeof(h), reinterpret_cast<byte *>(s->index.data()), s->index.size() * sizeof(_entry), {}));
+          }
+        }
+        compressed_handle_adapter ret(data, index, std::move(codec), block_size, std::move(s), _mode, flags, ctx);
+        if(indexbytes == 0)
+        {
+          OUTCOME_TRY(ret._write_header({}));
+        }
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The handle into which compressed blocks are appended
+    target_handle_type *data() const noexcept { return _data; }
+    //! The handle holding the block index
+    target_handle_type *index() const noexcept { return _index; }
+    //! The compression codec
+    const codec_type &codec() const noexcept { return _codec; }
+    //! The bytes of each block before compression
+    size_t block_size() const noexcept { return _block_size; }
+
+    //! \brief Close the attached handles.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
+    {
+      if(_data != nullptr)
+      {
+        OUTCOME_TRY(_data->close());
+      }
+      if(_index != nullptr)
+      {
+        OUTCOME_TRY(_index->close());
+      }
+      return success();
+    }
+
+    //! \brief Return the logical size of the adapter
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> maximum_extent() const noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->size;
+    }
+    //! \brief Set the logical size of the adapter, zeroing any partial block past the new size.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> truncate(extent_type newsize) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        if(newsize < _s->size)
+        {
+          const size_t tail = (size_t)(newsize % _block_size);
+          const extent_type blocks = (newsize + _block_size - 1) / _block_size;
+          if(tail != 0 && _entry_for(newsize / _block_size).bytes != 0)
+          {
+            std::vector<byte> zeros(_block_size - tail);
+            const_buffer_type b(zeros.data(), zeros.size());
+            OUTCOME_TRY(_write_locked(io_request<const_buffers_type>({&b, 1}, newsize), {}));
+          }
+          if(_s->index.size() > blocks)
+          {
+            _s->index.resize((size_t) blocks);
+            OUTCOME_TRY(_index->truncate(sizeof(_header) + blocks * sizeof(_entry)));
+          }
+        }
+        _s->size = newsize;
+        OUTCOME_TRY(_write_header({}));
+        return newsize;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<file_handle::extent_pair>> extents() const noexcept override { return errc::operation_not_supported; }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero(file_handle::extent_pair /*unused*/, deadline /*unused*/ = deadline()) noexcept override
+    {
+      return errc::operation_not_supported;
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+
+  protected:
+    //! \brief As data is always copied, any number of buffers may be supplied
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return 0; }
+
+    //! Decompress the blocks touched by the request, and copy out the parts requested.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      const size_t bs = _block_size, bound = _scratch_bound();
+      extent_type size;
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        size = _s->size;
+      }
+      size_t total = 0;
+      for(const auto &b : reqs.buffers)
+      {
+        total += b.size();
+      }
+      total = (reqs.offset >= size) ? 0 : (size_t)(std::min)((extent_type) total, size - reqs.offset);
+      if(total > 0)
+      {
+        const extent_type end = reqs.offset + total, first = reqs.offset / bs, last = (end + bs - 1) / bs;
+        const size_t maxcount = (size_t)(std::min)((extent_type) batch_blocks, last - first);
+        OUTCOME_TRY(auto &&scratch, map_handle::map(maxcount * (bs + bound)));
+        byte *plain = scratch.address(), *packed = plain + maxcount * bs;
+        size_t bufidx = 0, bufpos = 0;
+        for(extent_type b = first; b < last; b += maxcount)
+        {
+          const size_t count = (size_t)(std::min)((extent_type) maxcount, last - b);
+          _entry entries[batch_blocks];
+          {
+            std::lock_guard<std::mutex> g(_s->lock);
+            for(size_t n = 0; n < count; n++)
+            {
+              entries[n] = _entry_for(b + n);
+            }
+          }
+          optional<result<void>> decoded[batch_blocks];
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if((this->_flags & flag::disable_parallelism) == 0)
+#endif
+          for(size_t n = 0; n < count; n++)
+          {
+            decoded[n] = _decode(plain + n * bs, packed + n * bound, entries[n], d);
+          }
+          for(size_t n = 0; n < count; n++)
+          {
+            OUTCOME_TRY(std::move(*decoded[n]));
+            const extent_type bstart = (b + n) * bs, lo = (std::max)(bstart, reqs.offset), hi = (std::min)(bstart + bs, end);
+            for(size_t done = (size_t)(lo - bstart); done < (size_t)(hi - bstart);)
+            {
+              auto &buffer = reqs.buffers[bufidx];
+              const size_t bytes = (std::min)(buffer.size() - bufpos, (size_t)(hi - bstart) - done);
+              memcpy(buffer.data() + bufpos, plain + n * bs + done, bytes);
+              done += bytes;
+              bufpos += bytes;
+              if(bufpos == buffer.size())
+              {
+                bufidx++;
+                bufpos = 0;
+              }
+            }
+          }
+        }
+      }
+      // Trim the buffers to the bytes read
+      for(auto &b : reqs.buffers)
+      {
+        const size_t bytes = (std::min)(b.size(), total);
+        b = buffer_type(b.data(), bytes);
+        total -= bytes;
+      }
+      return std::move(reqs.buffers);
+    }
+
+    //! Recompress the blocks touched by the request, appending them to the data handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      OUTCOME_TRY(_write_locked(reqs, d));
+      return std::move(reqs.buffers);
+    }
+
+    //! Issue the barrier to the data handle, then to the index handle
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept override
+    {
+      OUTCOME_TRY(_data->barrier({}, kind, d));
+      OUTCOME_TRY(_index->barrier({}, kind, d));
+      return std::move(reqs.buffers);
+    }
+  };
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
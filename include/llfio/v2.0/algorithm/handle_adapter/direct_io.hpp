@@ -0,0 +1,425 @@
+/* Adapts a file handle to perform unaligned i/o on a direct i/o handle
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_DIRECT_IO_HANDLE_ADAPTER_HPP
+#define LLFIO_DIRECT_IO_HANDLE_ADAPTER_HPP
+
+#include "../../file_handle.hpp"
+
+#include <memory>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4251)  // dll interface
+#endif
+
+//! \file handle_adapter/direct_io.hpp Adapts any `file_handle` to accept unaligned i/o when opened with direct i/o
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    struct direct_io_bounce_pool
+    {
+      spinlock lock;
+      std::vector<io_handle::registered_buffer_type> free;
+    };
+    /* Returns the memory and file offset alignments which direct i/o on this handle requires. If the platform
+    cannot tell us, page size alignment for both is returned.
+    */
+    LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::pair<size_t, size_t>> direct_io_alignment(const file_handle &h) noexcept;
+  }  // namespace detail
+
+  /*! \brief Adapts any `construct()`-able `file_handle` implementation to accept i/o of any alignment when
+  opened with direct i/o i.e. `caching::none` or `caching::only_metadata`.
+
+  Direct i/o bypasses the kernel page cache, but requires that buffer addresses, buffer lengths and
+  file offsets all be multiples of some alignment determined by the storage. Getting this wrong usually
+  results in `EINVAL`, which makes direct i/o unpleasant to use. This adapter queries the required memory
+  and offset alignments once upon construction (`STATX_DIOALIGN` on Linux 6.1 onwards, the sector and
+  alignment information on Windows, `utils::tuning().direct_io_alignment` if set, else page size otherwise),
+  and thereafter:
+
+  - i/o which is already fully aligned is passed through unmodified, so there is no overhead for code
+  which gets alignment right.
+  - i/o which is not aligned is performed through a small pool of aligned bounce buffers. Unaligned
+  writes perform a read-modify-write of the aligned blocks at their head and tail, and any padding
+  written past the end of the file is truncated away afterwards.
+
+  `allocate_aligned_buffer()` allocates registered buffers suitable for passing straight through.
+
+  If the adapted handle does not require aligned i/o, all i/o is passed through unmodified.
+
+  \warning The read-modify-write of unaligned heads and tails is not atomic with respect to other
+  writers of the same aligned blocks. Use byte range locks if that matters to you.
+
+  \warning i/o performed via an i/o multiplexer set on the handle bypasses this adapter.
+  */
+  template <class T> LLFIO_REQUIRES(sizeof(construct<T>) > 0) class LLFIO_DECL direct_io_handle_adapter : public T
+  {
+    static_assert(sizeof(construct<T>) > 0, "Type T must be registered with the construct<T> framework so direct_io_handle_adapter<T> knows how to construct it");  // NOLINT
+
+  public:
+    //! The handle type being adapted
+    using adapted_handle_type = T;
+    using extent_type = typename T::extent_type;
+    using size_type = typename T::size_type;
+    using buffer_type = typename T::buffer_type;
+    using const_buffer_type = typename T::const_buffer_type;
+    using buffers_type = typename T::buffers_type;
+    using const_buffers_type = typename T::const_buffers_type;
+    using registered_buffer_type = typename T::registered_buffer_type;
+    template <class R> using io_request = typename T::template io_request<R>;
+    template <class R> using io_result = typename T::template io_result<R>;
+
+    //! The size of each bounce buffer used to perform unaligned i/o
+    static constexpr size_t bounce_buffer_size = 65536;
+    //! The maximum number of bounce buffers kept for reuse
+    static constexpr size_t bounce_buffer_pool_size = 4;
+
+  protected:
+    size_t _memory_alignment{0}, _offset_alignment{0}, _bounce_size{0};
+    std::unique_ptr<detail::direct_io_bounce_pool> _bounce_pool;
+
+    bool _is_aligned(extent_type offset, const buffer_type *begin, const buffer_type *end) const noexcept
+    {
+      if((offset & (_offset_alignment - 1)) != 0)
+      {
+        return false;
+      }
+      for(auto *b = begin; b != end; ++b)
+      {
+        if((((uintptr_t) b->data()) & (_memory_alignment - 1)) != 0 || (b->size() & (_offset_alignment - 1)) != 0)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    bool _is_aligned(extent_type offset, const const_buffer_type *begin, const const_buffer_type *end) const noexcept
+    {
+      if((offset & (_offset_alignment - 1)) != 0)
+      {
+        return false;
+      }
+      for(auto *b = begin; b != end; ++b)
+      {
+        if((((uintptr_t) b->data()) & (_memory_alignment - 1)) != 0 || (b->size() & (_offset_alignment - 1)) != 0)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    result<registered_buffer_type> _acquire_bounce() noexcept
+    {
+      {
+        lock_guard<spinlock> g(_bounce_pool->lock);
+        if(!_bounce_pool->free.empty())
+        {
+          auto ret = std::move(_bounce_pool->free.back());
+          _bounce_pool->free.pop_back();
+          return {std::move(ret)};
+        }
+      }
+      size_t bytes = _bounce_size;
+      return this->allocate_registered_buffer(bytes);
+    }
+    void _release_bounce(registered_buffer_type &&b) noexcept
+    {
+      lock_guard<spinlock> g(_bounce_pool->lock);
+      if(_bounce_pool->free.size() < bounce_buffer_pool_size)
+      {
+        try
+        {
+          _bounce_pool->free.push_back(std::move(b));
+        }
+        catch(...)
+        {
+        }
+      }
+    }
+
+  public:
+    direct_io_handle_adapter() = default;
+    direct_io_handle_adapter(direct_io_handle_adapter &&) = default;  // NOLINT
+    direct_io_handle_adapter &operator=(direct_io_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~direct_io_handle_adapter();
+      new(this) direct_io_handle_adapter(std::move(o));
+      return *this;
+    }
+    explicit direct_io_handle_adapter(adapted_handle_type &&o)
+        : adapted_handle_type(std::move(o))
+        , _bounce_pool(std::make_unique<detail::direct_io_bounce_pool>())
+    {
+      auto r = detail::direct_io_alignment(*this);
+      if(r)
+      {
+        _memory_alignment = r.value().first;
+        _offset_alignment = r.value().second;
+      }
+      else
+      {
+        const auto hint = utils::tuning().direct_io_alignment;
+        _memory_alignment = _offset_alignment = (hint != 0) ? hint : utils::page_size();
+      }
+      _bounce_size = bounce_buffer_size;
+      if(_bounce_size < _offset_alignment)
+      {
+        _bounce_size = _offset_alignment;
+      }
+    }
+
+    //! The alignment of memory which direct i/o on this handle requires.
+    size_t memory_alignment() const noexcept { return _memory_alignment; }
+    //! The alignment of file offsets and i/o lengths which direct i/o on this handle requires.
+    size_t offset_alignment() const noexcept { return _offset_alignment; }
+
+    /*! \brief Allocates a registered buffer suitable for passing straight through to direct i/o.
+
+    \param bytes The size of buffer wanted. This is rounded up to the offset alignment, and then
+    possibly further rounded up by the buffer allocation.
+    */
+    result<registered_buffer_type> allocate_aligned_buffer(size_t &bytes) noexcept
+    {
+      bytes = (bytes + _offset_alignment - 1) & ~(_offset_alignment - 1);
+      return this->allocate_registered_buffer(bytes);
+    }
+
+  protected:
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      if(!this->requires_aligned_io() || _bounce_pool == nullptr || _is_aligned(reqs.offset, reqs.buffers.data(), reqs.buffers.data() + reqs.buffers.size()))
+      {
+        return adapted_handle_type::_do_read(reqs, d);
+      }
+      LLFIO_LOG_FUNCTION_CALL(this);
+      LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+      size_t total = 0;
+      for(auto &b : reqs.buffers)
+      {
+        total += b.size();
+      }
+      OUTCOME_TRY(auto &&bounce, _acquire_bounce());
+      auto unbounce = make_scope_exit([&]() noexcept { _release_bounce(std::move(bounce)); });
+      extent_type offset = reqs.offset;
+      size_t done = 0, bufidx = 0, bufoffset = 0;
+      while(done < total)
+      {
+        const extent_type alignedoffset = offset & ~static_cast<extent_type>(_offset_alignment - 1);
+        const size_t skip = static_cast<size_t>(offset - alignedoffset);
+        size_t toread = skip + (total - done);
+        toread = (toread + _offset_alignment - 1) & ~(_offset_alignment - 1);
+        if(toread > bounce->size())
+        {
+          toread = bounce->size();
+        }
+        buffer_type b(bounce->data(), toread);
+        deadline nd;
+        LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+        OUTCOME_TRY(auto &&bytesread, adapted_handle_type::_do_read({{&b, 1}, alignedoffset}, nd));
+        const size_t got = bytesread.empty() ? 0 : bytesread.front().size();
+        if(got <= skip)
+        {
+          break;
+        }
+        const size_t avail = std::min(got - skip, total - done);
+        // Scatter into the caller's buffers
+        const byte *src = bounce->data() + skip;
+        for(size_t remaining = avail; remaining > 0;)
+        {
+          auto &dest = reqs.buffers[bufidx];
+          const size_t tocopy = std::min(dest.size() - bufoffset, remaining);
+          memcpy(dest.data() + bufoffset, src, tocopy);
+          src += tocopy;
+          remaining -= tocopy;
+          bufoffset += tocopy;
+          if(bufoffset == dest.size())
+          {
+            ++bufidx;
+            bufoffset = 0;
+          }
+        }
+        done += avail;
+        offset += avail;
+        if(got < toread)
+        {
+          break;
+        }
+      }
+      // Adjust the buffers returned to the bytes read
+      size_t remaining = done;
+      for(auto &b : reqs.buffers)
+      {
+        const size_t n = std::min(b.size(), remaining);
+        b = {b.data(), n};
+        remaining -= n;
+      }
+      return reqs.buffers;
+    }
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      if(!this->requires_aligned_io() || _bounce_pool == nullptr || _is_aligned(reqs.offset, reqs.buffers.data(), reqs.buffers.data() + reqs.buffers.size()))
+      {
+        return adapted_handle_type::_do_write(reqs, d);
+      }
+      LLFIO_LOG_FUNCTION_CALL(this);
+      LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+      size_t total = 0;
+      for(auto &b : reqs.buffers)
+      {
+        total += b.size();
+      }
+      if(total == 0)
+      {
+        return reqs.buffers;
+      }
+      OUTCOME_TRY(auto &&length, this->maximum_extent());
+      OUTCOME_TRY(auto &&bounce, _acquire_bounce());
+      auto unbounce = make_scope_exit([&]() noexcept { _release_bounce(std::move(bounce)); });
+      const extent_type end = reqs.offset + total;
+      extent_type offset = reqs.offset, alignedend = 0;
+      size_t bufidx = 0, bufoffset = 0;
+      while(offset < end)
+      {
+        const extent_type alignedoffset = offset & ~static_cast<extent_type>(_offset_alignment - 1);
+        const size_t skip = static_cast<size_t>(offset - alignedoffset);
+        size_t chunk = skip + static_cast<size_t>(std::min<extent_type>(end - offset, bounce->size()));
+        chunk = (chunk + _offset_alignment - 1) & ~(_offset_alignment - 1);
+        if(chunk > bounce->size())
+        {
+          chunk = bounce->size();
+        }
+        const size_t take = static_cast<size_t>(std::min<extent_type>(chunk - skip, end - offset));
+        if(skip > 0 || skip + take < chunk)
+        {
+          // Only part of this block is being written, so fetch what is there already
+          size_t got = 0;
+          if(alignedoffset < length)
+          {
+            buffer_type b(bounce->data(), chunk);
+            deadline nd;
+            LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+            OUTCOME_TRY(auto &&bytesread, adapted_handle_type::_do_read({{&b, 1}, alignedoffset}, nd));
+            got = bytesread.empty() ? 0 : bytesread.front().size();
+          }
+          memset(bounce->data() + got, 0, chunk - got);
+        }
+        // Gather from the caller's buffers
+        byte *dest = bounce->data() + skip;
+        for(size_t remaining = take; remaining > 0;)
+        {
+          auto &src = reqs.buffers[bufidx];
+          const size_t tocopy = std::min(src.size() - bufoffset, remaining);
+          memcpy(dest, src.data() + bufoffset, tocopy);
+          dest += tocopy;
+          remaining -= tocopy;
+          bufoffset += tocopy;
+          if(bufoffset == src.size())
+          {
+            ++bufidx;
+            bufoffset = 0;
+          }
+        }
+        const_buffer_type b(bounce->data(), chunk);
+        deadline nd;
+        LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+        OUTCOME_TRY(auto &&byteswritten, adapted_handle_type::_do_write({{&b, 1}, alignedoffset}, nd));
+        if(byteswritten.empty() || byteswritten.front().size() != chunk)
+        {
+          return errc::resource_unavailable_try_again;
+        }
+        offset += take;
+        alignedend = alignedoffset + chunk;
+      }
+      // If padding was written past the end of the file, remove it
+      const extent_type newlength = std::max(end, length);
+      if(alignedend > newlength)
+      {
+        OUTCOME_TRY(this->truncate(newlength));
+      }
+      return reqs.buffers;
+    }
+    using adapted_handle_type::_do_read;
+    using adapted_handle_type::_do_write;
+  };
+  /*! \brief Constructs a `T` adapted into a direct i/o helper implementation.
+
+  This function works via the `construct<T>()` free function framework for which your `handle`
+  implementation must have registered its construction details.
+  */
+  template <class T, class... Args> inline result<direct_io_handle_adapter<T>> direct_io(Args &&... args) noexcept
+  {
+    construct<T> constructor{std::forward<Args>(args)...};
+    OUTCOME_TRY(auto &&h, constructor());
+    try
+    {
+      return direct_io_handle_adapter<T>(std::move(h));
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+}  // namespace algorithm
+
+//! \brief Constructor for `algorithm::direct_io_handle_adapter<T>`
+template <class T> struct construct<algorithm::direct_io_handle_adapter<T>>
+{
+  construct<T> args;
+  result<algorithm::direct_io_handle_adapter<T>> operator()() const noexcept
+  {
+    OUTCOME_TRY(auto &&h, args());
+    try
+    {
+      return algorithm::direct_io_handle_adapter<T>(std::move(h));
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+};
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "../../detail/impl/direct_io_handle_adapter.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
@@ -0,0 +1,618 @@
+/* A handle which erasure codes its data across other handles
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_ERASURE_CODED_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_ERASURE_CODED_H
+
+#include "xor.hpp"
+
+#if !defined(__AVX2__) && defined(__SSSE3__)
+#include <tmmintrin.h>  // for SSSE3
+#endif
+
+//! \file handle_adapter/erasure_coded.hpp Provides `erasure_coded_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    // Arithmetic in GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1 used by most Reed-Solomon codes
+    struct gf256
+    {
+      uint8_t exp[512], log[256];
+
+      gf256() noexcept
+      {
+        unsigned x = 1;
+        log[0] = 0;
+        for(unsigned i = 0; i < 255; i++)
+        {
+          exp[i] = exp[i + 255] = (uint8_t) x;
+          log[x] = (uint8_t) i;
+          x <<= 1;
+          if(x & 0x100)
+          {
+            x ^= 0x11d;
+          }
+        }
+        exp[510] = exp[511] = 0;
+      }
+      static const gf256 &get() noexcept
+      {
+        static const gf256 v;
+        return v;
+      }
+      uint8_t mul(uint8_t a, uint8_t b) const noexcept { return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]]; }
+      uint8_t inv(uint8_t a) const noexcept { return exp[255 - log[a]]; }
+    };
+
+    /* Adds `c` times each of `bytes` of `in` to `out` in GF(2^8).
+
+    Each byte is split into nibbles which index two sixteen entry tables of products, so where the
+    CPU has a byte shuffle (SSSE3, AVX2, NEON) sixteen or thirty-two products are looked up per
+    instruction.
+    */
+    inline void gf256_mul_add(byte *out, const byte *in, uint8_t c, size_t bytes) noexcept
+    {
+      if(c == 0)
+      {
+        return;
+      }
+      if(c == 1)
+      {
+        xor_buffers(out, out, in, bytes);
+        return;
+      }
+      const gf256 &gf = gf256::get();
+      alignas(16) uint8_t lo[16], hi[16];
+      for(uint8_t x = 0; x < 16; x++)
+      {
+        lo[x] = gf.mul(c, x);
+        hi[x] = gf.mul(c, (uint8_t)(x << 4));
+      }
+      size_t idx = 0;
+#if defined(__AVX2__)
+      const __m256i tlo = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(lo)));
+      const __m256i thi = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(hi)));
+      const __m256i mask = _mm256_set1_epi8(0x0f);
+      for(; bytes - idx >= 32; idx += 32)
+      {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + idx));
+        const __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tlo, _mm256_and_si256(v, mask)), _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(v, 4), mask)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + idx), _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(out + idx)), p));
+      }
+#elif defined(__SSSE3__)
+      const __m128i tlo = _mm_load_si128(reinterpret_cast<const __m128i *>(lo));
+      const __m128i thi = _mm_load_si128(reinterpret_cast<const __m128i *>(hi));
+      const __m128i mask = _mm_set1_epi8(0x0f);
+      for(; bytes - idx >= 16; idx += 16)
+      {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + idx));
+        const __m128i p = _mm_xor_si128(_mm_shuffle_epi8(tlo, _mm_and_si128(v, mask)), _mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + idx), _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(out + idx)), p));
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      const uint8x16_t tlo = vld1q_u8(lo), thi = vld1q_u8(hi), mask = vdupq_n_u8(0x0f);
+      for(; bytes - idx >= 16; idx += 16)
+      {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(in + idx));
+        const uint8x16_t p = veorq_u8(vqtbl1q_u8(tlo, vandq_u8(v, mask)), vqtbl1q_u8(thi, vshrq_n_u8(v, 4)));
+        vst1q_u8(reinterpret_cast<uint8_t *>(out + idx), veorq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(out + idx)), p));
+      }
+#endif
+      for(; idx < bytes; idx++)
+      {
+        const auto v = (uint8_t) in[idx];
+        out[idx] ^= (byte)(lo[v & 15] ^ hi[v >> 4]);
+      }
+    }
+  }  // namespace detail
+
+  /*! \class erasure_coded_handle_adapter
+  \brief A handle striping its data across N data handles and K parity handles, such that
+  the data can be read back from any N of them.
+  \tparam Target The type of the backing handles.
+
+  \warning This class is still in development, do not use.
+
+  Data is striped in units of `stripe_unit()` bytes, so byte `offset` lives in data handle
+  `(offset / stripe_unit()) % N` at offset `(offset / (N * stripe_unit())) * stripe_unit() + offset % stripe_unit()`.
+  Each parity handle holds at the same offset a Reed-Solomon code over GF(2^8) of the stripe
+  units of the data handles, using a Cauchy matrix scaled such that the first parity handle is
+  the XOR of the data handles i.e. one parity handle is RAID-5, two parity handles is RAID-6,
+  and so on up to `max_handles` handles in total. Parity is not rotated across the handles.
+
+  Reads and writes are performed in whole stripes into temporary buffers obtained from
+  `map_handle::map()`. Reads read only the data handles
+  unless one fails, in which case the parity handles are read and the stripes reconstructed,
+  which fails only if more than K handles failed. Writes not covering whole stripes read the
+  partially covered stripes first, and fail if any backing handle fails. Regions of the backing
+  handles never written read as zeros, so the adapter behaves like a block device whose size
+  is managed by the application.
+
+  \note If OpenMP is available, `LLFIO_DISABLE_OPENMP` is not defined, and
+  `flag::disable_parallelism` is not set, i/o to the backing handles will be done concurrently.
+
+  Destroying the adapter does not destroy the attached handles. Closing the adapter
+  does close the attached handles.
+  */
+  template <class Target> class erasure_coded_handle_adapter : public io_handle
+  {
+  public:
+    using path_type = io_handle::path_type;
+    using extent_type = io_handle::extent_type;
+    using size_type = io_handle::size_type;
+    using mode = io_handle::mode;
+    using creation = io_handle::creation;
+    using caching = io_handle::caching;
+    using flag = io_handle::flag;
+    using buffer_type = io_handle::buffer_type;
+    using const_buffer_type = io_handle::const_buffer_type;
+    using buffers_type = io_handle::buffers_type;
+    using const_buffers_type = io_handle::const_buffers_type;
+    template <class T> using io_request = io_handle::io_request<T>;
+    template <class T> using io_result = io_handle::io_result<T>;
+
+    using target_handle_type = Target;
+
+    //! The maximum number of data and parity handles in total
+    static constexpr size_t max_handles = 64;
+
+  protected:
+    target_handle_type *_handles[max_handles]{};
+    size_t _data{0}, _parity{0}, _unit{0};
+
+  private:
+    static constexpr native_handle_type _native_handle(mode _mode)
+    {
+      native_handle_type nativeh;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable;
+      if(_mode == mode::write)
+      {
+        nativeh.behaviour |= native_handle_type::disposition::writable;
+      }
+      return nativeh;
+    }
+    static caching _combine_caching(span<target_handle_type *const> handles)
+    {
+      caching least = caching::temporary;
+      for(auto *h : handles)
+      {
+        if(h->kernel_caching() < least)
+        {
+          least = h->kernel_caching();
+        }
+      }
+      return least;
+    }
+
+    // The coefficient of data handle i in parity handle k
+    uint8_t _coefficient(size_t k, size_t i) const noexcept
+    {
+      const auto &gf = detail::gf256::get();
+      const auto x0 = (uint8_t) _data, xk = (uint8_t)(_data + k), y = (uint8_t) i;
+      return gf.mul(x0 ^ y, gf.inv(xk ^ y));
+    }
+    // Performs i/o to the handles selected by mask concurrently, reporting failures in failed
+    template <class F> void _for_each_handle(uint64_t mask, uint64_t &failed, F &&f) noexcept
+    {
+      const size_t total = _data + _parity;
+      bool _failed[max_handles]{};
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if((this->_flags & flag::disable_parallelism) == 0)
+#endif
+      for(size_t n = 0; n < total; n++)
+      {
+        if(mask & (1ULL << n))
+        {
+          _failed[n] = !f(n);
+        }
+      }
+      for(size_t n = 0; n < total; n++)
+      {
+        if(_failed[n])
+        {
+          failed |= 1ULL << n;
+        }
+      }
+    }
+
+    /* Reads stripes [s, s + count) into column i at temp + i * stride + (s - s0) * unit,
+    reconstructing the data columns of any failed handles from the parity handles.
+    */
+    result<void> _read_stripes(byte *temp, size_t stride, extent_type s0, extent_type s, size_t count, deadline d) noexcept
+    {
+      const size_t total = _data + _parity, bytes = count * _unit;
+      const uint64_t datamask = (_data == 64) ? ~0ULL : ((1ULL << _data) - 1), allmask = (total == 64) ? ~0ULL : ((1ULL << total) - 1);
+      uint64_t failed = 0;
+      optional<result<void>> errors[max_handles];
+      auto read = [&](size_t n) {
+        buffer_type b(temp + n * stride + (s - s0) * _unit, bytes);
+        io_request<buffers_type> req({&b, 1}, s * _unit);
+        auto r = _handles[n]->read(req, d);
+        if(!r)
+        {
+          errors[n].emplace(r.error());
+          return false;
+        }
+        // Some handles e.g. mapped ones return buffers other than those supplied
+        size_t filled = 0;
+        for(const auto &i : r.value())
+        {
+          if(i.data() != b.data() + filled)
+          {
+            memcpy(b.data() + filled, i.data(), i.size());
+          }
+          filled += i.size();
+        }
+        // Never written regions read as zeros
+        memset(b.data() + filled, 0, bytes - filled);
+        return true;
+      };
+      _for_each_handle(datamask, failed, read);
+      if(failed == 0)
+      {
+        return success();
+      }
+      _for_each_handle(allmask & ~datamask, failed, read);
+      // Choose the first N surviving handles
+      size_t survivors[max_handles], nsurvivors = 0, firstfailed = total;
+      for(size_t n = 0; n < total; n++)
+      {
+        if(failed & (1ULL << n))
+        {
+          if(firstfailed == total)
+          {
+            firstfailed = n;
+          }
+        }
+        else if(nsurvivors < _data)
+        {
+          survivors[nsurvivors++] = n;
+        }
+      }
+      if(nsurvivors < _data)
+      {
+        return std::move(*errors[firstfailed]);
+      }
+      // Invert the rows of the generator matrix of the survivors
+      const auto &gf = detail::gf256::get();
+      uint8_t a[max_handles][max_handles], inv[max_handles][max_handles];
+      for(size_t r = 0; r < _data; r++)
+      {
+        for(size_t c = 0; c < _data; c++)
+        {
+          a[r][c] = (survivors[r] < _data) ? (uint8_t)(survivors[r] == c) : _coefficient(survivors[r] - _data, c);
+          inv[r][c] = (uint8_t)(r == c);
+        }
+      }
+      for(size_t c = 0; c < _data; c++)
+      {
+        size_t pivot = c;
+        while(a[pivot][c] == 0)
+        {
+          pivot++;
+        }
+        if(pivot != c)
+        {
+          std::swap(a[pivot], a[c]);
+          std::swap(inv[pivot], inv[c]);
+        }
+        const uint8_t scale = gf.inv(a[c][c]);
+        for(size_t i = 0; i < _data; i++)
+        {
+          a[c][i] = gf.mul(a[c][i], scale);
+          inv[c][i] = gf.mul(inv[c][i], scale);
+        }
+        for(size_t r = 0; r < _data; r++)
+        {
+          const uint8_t factor = a[r][c];
+          if(r != c && factor != 0)
+          {
+            for(size_t i = 0; i < _data; i++)
+            {
+              a[r][i] ^= gf.mul(factor, a[c][i]);
+              inv[r][i] ^= gf.mul(factor, inv[c][i]);
+            }
+          }
+        }
+      }
+      // Rebuild the failed data columns from the survivors
+      for(size_t i = 0; i < _data; i++)
+      {
+        if(failed & (1ULL << i))
+        {
+          byte *out = temp + i * stride + (s - s0) * _unit;
+          memset(out, 0, bytes);
+          for(size_t j = 0; j < _data; j++)
+          {
+            detail::gf256_mul_add(out, temp + survivors[j] * stride + (s - s0) * _unit, inv[i][j], bytes);
+          }
+        }
+      }
+      return success();
+    }
+
+    // Calls f(temp address, bytes) for each run of the extent [offset, offset + bytes) stored contiguously in temp
+    template <class F> void _for_each_run(byte *temp, size_t stride, extent_type s0, extent_type offset, size_type bytes, F &&f) const noexcept
+    {
+      const extent_type stripe_bytes = _data * _unit;
+      while(bytes > 0)
+      {
+        const extent_type s = offset / stripe_bytes;
+        const size_t r = (size_t)(offset % stripe_bytes), c = r / _unit, u = r % _unit;
+        const size_t run = (size_t)(std::min)((size_type)(_unit - u), bytes);
+        f(temp + c * stride + (size_t)(s - s0) * _unit + u, run);
+        offset += run;
+        bytes -= run;
+      }
+    }
+
+    // Allocates temporary buffers of stride bytes for each of the handles
+    result<byte *> _temp_buffers(map_handle &temph, size_t stride) noexcept
+    {
+      OUTCOME_TRY(auto &&_, map_handle::map(stride * (_data + _parity)));
+      temph = std::move(_);
+      return temph.address();
+    }
+
+  protected:
+    erasure_coded_handle_adapter(span<target_handle_type *const> data, span<target_handle_type *const> parity, size_t stripe_unit, mode _mode, flag flags, io_multiplexer *ctx)
+        : io_handle(_native_handle(_mode), _combine_caching(data), flags, ctx)
+        , _data(data.size())
+        , _parity(parity.size())
+        , _unit(stripe_unit)
+    {
+      for(size_t n = 0; n < _data; n++)
+      {
+        _handles[n] = data[n];
+      }
+      for(size_t n = 0; n < _parity; n++)
+      {
+        _handles[_data + n] = parity[n];
+      }
+    }
+
+  public:
+    //! Default constructor
+    erasure_coded_handle_adapter() = default;
+    //! Implicit move construction of erasure_coded_handle_adapter permitted
+    erasure_coded_handle_adapter(erasure_coded_handle_adapter &&o) noexcept
+        : io_handle(std::move(o))
+        , _data(o._data)
+        , _parity(o._parity)
+        , _unit(o._unit)
+    {
+      memcpy(_handles, o._handles, sizeof(_handles));
+      o._data = o._parity = 0;
+    }
+    //! No copy construction
+    erasure_coded_handle_adapter(const erasure_coded_handle_adapter &) = delete;
+    //! Move assignment of erasure_coded_handle_adapter permitted
+    erasure_coded_handle_adapter &operator=(erasure_coded_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~erasure_coded_handle_adapter();
+      new(this) erasure_coded_handle_adapter(std::move(o));
+      return *this;
+    }
+    //! No copy assignment
+    erasure_coded_handle_adapter &operator=(const erasure_coded_handle_adapter &) = delete;
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~erasure_coded_handle_adapter() override
+    {
+      // ignore
+    }
+
+    /*! \brief Create an adapter striping over `data` handles, with `parity` handles of parity.
+    \param data The handles into which data is striped. At least one is required.
+    \param parity The handles into which parity is written. May be empty, in which case the adapter is RAID-0.
+    \param stripe_unit The bytes of each stripe stored in each handle.
+    \param _mode Whether the adapter is writable.
+    \param flags Any additional flags, such as `flag::disable_parallelism`.
+    \param ctx The multiplexer to use, if any.
+
+    \errors `errc::invalid_argument` if there are no data handles, more than `max_handles` handles,
+    or `stripe_unit` is zero.
+    */
+    static result<erasure_coded_handle_adapter> erasure_coded(span<target_handle_type *const> data, span<target_handle_type *const> parity, size_t stripe_unit = 4096,
+                                                              mode _mode = mode::write, flag flags = flag::none, io_multiplexer *ctx = nullptr) noexcept
+    {
+      if(data.empty() || data.size() + parity.size() > max_handles || stripe_unit == 0)
+      {
+        return errc::invalid_argument;
+      }
+      return erasure_coded_handle_adapter(data, parity, stripe_unit, _mode, flags, ctx);
+    }
+
+    //! The number of data handles
+    size_t data_handles() const noexcept { return _data; }
+    //! The number of parity handles, which is the number which can fail without losing data
+    size_t parity_handles() const noexcept { return _parity; }
+    //! The bytes of each stripe stored in each handle
+    size_t stripe_unit() const noexcept { return _unit; }
+    //! The backing handle at index `n`, with the data handles first followed by the parity handles
+    target_handle_type *backing_handle(size_t n) const noexcept { return _handles[n]; }
+
+    //! \brief Close all the backing handles.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
+    {
+      for(size_t n = 0; n < _data + _parity; n++)
+      {
+        OUTCOME_TRY(_handles[n]->close());
+      }
+      return success();
+    }
+
+  protected:
+    //! \brief As buffers are always copied, any number may be supplied
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return 0; }
+
+    /*! Read the stripes covered by the request from the data handles into temporary buffers,
+    reconstructing any which failed from the parity handles, and copy out the data requested.
+    */
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      size_type bytes = 0;
+      for(const auto &b : reqs.buffers)
+      {
+        bytes += b.size();
+      }
+      if(bytes == 0)
+      {
+        return std::move(reqs.buffers);
+      }
+      const extent_type stripe_bytes = _data * _unit;
+      const extent_type s0 = reqs.offset / stripe_bytes, s1 = (reqs.offset + bytes + stripe_bytes - 1) / stripe_bytes;
+      const size_t stride = (size_t)(s1 - s0) * _unit;
+      map_handle temph;
+      OUTCOME_TRY(auto *temp, _temp_buffers(temph, stride));
+      OUTCOME_TRY(_read_stripes(temp, stride, s0, s0, (size_t)(s1 - s0), d));
+      size_t idx = 0, offset = 0;
+      _for_each_run(temp, stride, s0, reqs.offset, bytes, [&](const byte *p, size_t run) {
+        while(run > 0)
+        {
+          while(offset == reqs.buffers[idx].size())
+          {
+            idx++;
+            offset = 0;
+          }
+          const size_t n = (std::min)(run, reqs.buffers[idx].size() - offset);
+          memcpy(reqs.buffers[idx].data() + offset, p, n);
+          p += n;
+          run -= n;
+          offset += n;
+        }
+      });
+      return std::move(reqs.buffers);
+    }
+
+    /*! Read any partially covered stripes, overlay the supplied buffers, encode the parity
+    of the stripes and write all the handles.
+    */
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      size_type bytes = 0;
+      for(const auto &b : reqs.buffers)
+      {
+        bytes += b.size();
+      }
+      if(bytes == 0)
+      {
+        return std::move(reqs.buffers);
+      }
+      const extent_type stripe_bytes = _data * _unit;
+      const extent_type s0 = reqs.offset / stripe_bytes, s1 = (reqs.offset + bytes + stripe_bytes - 1) / stripe_bytes;
+      const size_t stride = (size_t)(s1 - s0) * _unit;
+      map_handle temph;
+      OUTCOME_TRY(auto *temp, _temp_buffers(temph, stride));
+      if(reqs.offset % stripe_bytes != 0)
+      {
+        OUTCOME_TRY(_read_stripes(temp, stride, s0, s0, 1, d));
+      }
+      if((reqs.offset + bytes) % stripe_bytes != 0 && (s1 - 1 != s0 || reqs.offset % stripe_bytes == 0))
+      {
+        OUTCOME_TRY(_read_stripes(temp, stride, s0, s1 - 1, 1, d));
+      }
+      size_t idx = 0, offset = 0;
+      _for_each_run(temp, stride, s0, reqs.offset, bytes, [&](byte *p, size_t run) {
+        while(run > 0)
+        {
+          while(offset == reqs.buffers[idx].size())
+          {
+            idx++;
+            offset = 0;
+          }
+          const size_t n = (std::min)(run, reqs.buffers[idx].size() - offset);
+          memcpy(p, reqs.buffers[idx].data() + offset, n);
+          p += n;
+          run -= n;
+          offset += n;
+        }
+      });
+      for(size_t k = 0; k < _parity; k++)
+      {
+        byte *out = temp + (_data + k) * stride;
+        memset(out, 0, stride);
+        for(size_t i = 0; i < _data; i++)
+        {
+          detail::gf256_mul_add(out, temp + i * stride, _coefficient(k, i), stride);
+        }
+      }
+      const size_t total = _data + _parity;
+      const uint64_t allmask = (total == 64) ? ~0ULL : ((1ULL << total) - 1);
+      uint64_t failed = 0;
+      optional<io_result<const_buffers_type>> results[max_handles];
+      _for_each_handle(allmask, failed, [&](size_t n) {
+        const_buffer_type b(temp + n * stride, stride);
+        io_request<const_buffers_type> req({&b, 1}, s0 * _unit);
+        results[n] = _handles[n]->write(req, d);
+        return results[n]->has_value();
+      });
+      for(size_t n = 0; n < total; n++)
+      {
+        if(failed & (1ULL << n))
+        {
+          return std::move(*results[n]).error();
+        }
+      }
+      return std::move(reqs.buffers);
+    }
+
+    //! Issue the barrier to all the backing handles
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept override
+    {
+      const size_t total = _data + _parity;
+      const uint64_t allmask = (total == 64) ? ~0ULL : ((1ULL << total) - 1);
+      uint64_t failed = 0;
+      optional<io_result<const_buffers_type>> results[max_handles];
+      _for_each_handle(allmask, failed, [&](size_t n) {
+        results[n] = _handles[n]->barrier({}, kind, d);
+        return results[n]->has_value();
+      });
+      for(size_t n = 0; n < total; n++)
+      {
+        if(failed & (1ULL << n))
+        {
+          return std::move(*results[n]).error();
+        }
+      }
+      return std::move(reqs.buffers);
+    }
+  };
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
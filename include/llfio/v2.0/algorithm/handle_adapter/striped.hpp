@@ -0,0 +1,464 @@
+/* A handle which stripes its data across other handles
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_STRIPED_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_STRIPED_H
+
+#include "combining.hpp"
+
+//! \file handle_adapter/striped.hpp Provides `striped_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+  /*! \class striped_handle_adapter
+  \brief A file handle striping its data across other file handles (RAID-0), so as to
+  aggregate the bandwidth of the devices they are on.
+  \tparam Target The type of the backing handles, which must be a `file_handle`.
+
+  \warning This class is still in development, do not use.
+
+  Data is striped in units of `stripe_unit()` bytes, so byte `offset` lives in backing handle
+  `(offset / stripe_unit()) % N` at offset `(offset / (N * stripe_unit())) * stripe_unit() + offset % stripe_unit()`.
+  As the part of any extent stored in each backing handle is contiguous, each `read()` or `write()`
+  is split into one request per backing handle whose scatter-gather list points straight into the
+  buffers supplied, so no data is copied. If the supplied buffers and the stripe unit are suitably
+  aligned, the adapter thus works with backing handles opened with `caching::none`.
+
+  Backing handles must fill the buffers supplied to reads, as `file_handle` does, rather than
+  return buffers of their own, as `mapped_file_handle` does.
+
+  Requests are split into sub-requests in stack buffers if small, else in `map_handle::map()`
+  pages. If a backing handle transfers less than requested, the bytes returned are those up to the
+  first not transferred. `maximum_extent()`, `truncate()`, `zero()`, `preallocate()` and `advise()`
+  act on the corresponding extent of each backing handle. `collapse()`, `insert()` and `extents()`
+  are not supported, and nor are byte range locks unless `Target` implements them.
+
+  \note If OpenMP is available, `LLFIO_DISABLE_OPENMP` is not defined, and
+  `flag::disable_parallelism` is not set, the sub-requests to the backing handles will be
+  issued concurrently.
+
+  Destroying the adapter does not destroy the attached handles. Closing the adapter
+  does close the attached handles.
+  */
+  template <class Target> class striped_handle_adapter : public detail::file_handle_wrapper
+  {
+    static_assert(std::is_base_of<file_handle, Target>::value, "striped_handle_adapter requires backing handles to be file handles");
+
+  public:
+    using path_type = io_handle::path_type;
+    using extent_type = io_handle::extent_type;
+    using size_type = io_handle::size_type;
+    using mode = io_handle::mode;
+    using creation = io_handle::creation;
+    using caching = io_handle::caching;
+    using flag = io_handle::flag;
+    using buffer_type = io_handle::buffer_type;
+    using const_buffer_type = io_handle::const_buffer_type;
+    using buffers_type = io_handle::buffers_type;
+    using const_buffers_type = io_handle::const_buffers_type;
+    template <class T> using io_request = io_handle::io_request<T>;
+    template <class T> using io_result = io_handle::io_result<T>;
+
+    using target_handle_type = Target;
+
+    //! The maximum number of backing handles
+    static constexpr size_t max_handles = 64;
+
+  protected:
+    target_handle_type *_handles[max_handles]{};
+    size_t _count{0}, _unit{0};
+
+  private:
+    static constexpr native_handle_type _native_handle(mode _mode)
+    {
+      native_handle_type nativeh;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable;
+      if(_mode == mode::write)
+      {
+        nativeh.behaviour |= native_handle_type::disposition::writable;
+      }
+      return nativeh;
+    }
+    static caching _combine_caching(span<target_handle_type *const> handles)
+    {
+      caching least = caching::temporary;
+      for(auto *h : handles)
+      {
+        if(h->kernel_caching() < least)
+        {
+          least = h->kernel_caching();
+        }
+      }
+      return least;
+    }
+
+    // The offset in backing handle c of the first byte at or after offset stored in it
+    extent_type _backing_offset(size_t c, extent_type offset) const noexcept
+    {
+      const extent_type stripe_bytes = (extent_type) _count * _unit, r = offset % stripe_bytes, begin = (extent_type) c * _unit;
+      return (offset / stripe_bytes) * _unit + ((r <= begin) ? 0 : (std::min)(r - begin, (extent_type) _unit));
+    }
+    // The extent of backing handle c storing the given extent
+    file_handle::extent_pair _backing_extent(size_t c, file_handle::extent_pair extent) const noexcept
+    {
+      const extent_type begin = _backing_offset(c, extent.offset), end = _backing_offset(c, extent.offset + extent.length);
+      return {begin, end - begin};
+    }
+    // The offset of the byte after the byte before `offset` in backing handle c
+    extent_type _offset_from_backing(size_t c, extent_type offset) const noexcept
+    {
+      if(offset == 0)
+      {
+        return 0;
+      }
+      offset--;
+      return (offset / _unit) * _count * _unit + (extent_type) c * _unit + offset % _unit + 1;
+    }
+
+    // Runs f(n) for each backing handle concurrently, returning the first failure
+    template <class R, class F> result<void> _for_each_handle(optional<R> (&results)[max_handles], F &&f) noexcept
+    {
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if((this->_flags & flag::disable_parallelism) == 0)
+#endif
+      for(size_t n = 0; n < _count; n++)
+      {
+        results[n] = f(n);
+      }
+      for(size_t n = 0; n < _count; n++)
+      {
+        if(results[n] && !*results[n])
+        {
+          return std::move(*results[n]).error();
+        }
+      }
+      return success();
+    }
+
+    // Sub-requests to each backing handle, pointing into the supplied buffers
+    template <class BufferType> struct _sub_requests
+    {
+      BufferType small[64];
+      map_handle mh;
+      BufferType *pieces{nullptr};
+      size_t first[max_handles]{}, count[max_handles]{};
+    };
+    template <class BufferType> result<void> _split(_sub_requests<BufferType> &out, span<BufferType> buffers, extent_type offset) const noexcept
+    {
+      const extent_type stripe_bytes = (extent_type) _count * _unit;
+      auto for_each_piece = [&](auto &&f) {
+        extent_type _offset = offset;
+        for(const auto &b : buffers)
+        {
+          auto *p = b.data();
+          size_t remaining = b.size();
+          while(remaining > 0)
+          {
+            const size_t c = (size_t)((_offset % stripe_bytes) / _unit), u = (size_t)(_offset % _unit);
+            const size_t run = (std::min)(_unit - u, remaining);
+            f(c, BufferType(p, run));
+            p += run;
+            remaining -= run;
+            _offset += run;
+          }
+        }
+      };
+      // Count the pieces for each backing handle
+      size_t total = 0;
+      for_each_piece([&](size_t c, BufferType /*unused*/) {
+        out.count[c]++;
+        total++;
+      });
+      if(total <= 64)
+      {
+        out.pieces = out.small;
+      }
+      else
+      {
+        OUTCOME_TRY(auto &&_, map_handle::map(total * sizeof(BufferType)));
+        out.mh = std::move(_);
+        out.pieces = reinterpret_cast<BufferType *>(out.mh.address());
+      }
+      for(size_t c = 0, first = 0; c < _count; c++)
+      {
+        out.first[c] = first;
+        first += out.count[c];
+        out.count[c] = 0;
+      }
+      // Fill in the pieces, merging those adjacent in memory
+      for_each_piece([&](size_t c, BufferType piece) {
+        BufferType *pieces = out.pieces + out.first[c];
+        size_t &count = out.count[c];
+        if(count > 0 && pieces[count - 1].data() + pieces[count - 1].size() == piece.data())
+        {
+          pieces[count - 1] = BufferType(pieces[count - 1].data(), pieces[count - 1].size() + piece.size());
+        }
+        else
+        {
+          pieces[count++] = piece;
+        }
+      });
+      return success();
+    }
+    // The bytes of the request transferred up to the first byte not transferred
+    template <class BufferType, class R> size_type _transferred(const _sub_requests<BufferType> &sub, const optional<R> (&results)[max_handles], extent_type offset, size_type bytes) const noexcept
+    {
+      extent_type end = offset + bytes;
+      for(size_t c = 0; c < _count; c++)
+      {
+        size_type requested = 0, transferred = 0;
+        for(size_t n = 0; n < sub.count[c]; n++)
+        {
+          requested += sub.pieces[sub.first[c] + n].size();
+        }
+        if(results[c])
+        {
+          for(const auto &b : results[c]->value())
+          {
+            transferred += b.size();
+          }
+        }
+        if(transferred < requested)
+        {
+          const extent_type missing = _offset_from_backing(c, _backing_offset(c, offset) + transferred + 1) - 1;
+          if(missing < end)
+          {
+            end = missing;
+          }
+        }
+      }
+      return (size_type)(end - offset);
+    }
+    // Shortens scatter-gather buffers to the bytes transferred
+    template <class BufferType> static void _trim(span<BufferType> buffers, size_type bytes) noexcept
+    {
+      for(auto &b : buffers)
+      {
+        const size_t _bytes = (bytes < b.size()) ? (size_t) bytes : b.size();
+        b = BufferType(b.data(), _bytes);
+        bytes -= _bytes;
+      }
+    }
+
+  protected:
+    striped_handle_adapter(span<target_handle_type *const> handles, size_t stripe_unit, mode _mode, flag flags, io_multiplexer *ctx)
+        : detail::file_handle_wrapper(_native_handle(_mode), _combine_caching(handles), flags, ctx)
+        , _count(handles.size())
+        , _unit(stripe_unit)
+    {
+      for(size_t n = 0; n < _count; n++)
+      {
+        _handles[n] = handles[n];
+      }
+    }
+
+  public:
+    //! Default constructor
+    striped_handle_adapter() = default;
+    //! Implicit move construction of striped_handle_adapter permitted
+    striped_handle_adapter(striped_handle_adapter &&o) noexcept
+        : detail::file_handle_wrapper(std::move(o))
+        , _count(o._count)
+        , _unit(o._unit)
+    {
+      memcpy(_handles, o._handles, sizeof(_handles));
+      o._count = 0;
+    }
+    //! No copy construction
+    striped_handle_adapter(const striped_handle_adapter &) = delete;
+    //! Move assignment of striped_handle_adapter permitted
+    striped_handle_adapter &operator=(striped_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~striped_handle_adapter();
+      new(this) striped_handle_adapter(std::move(o));
+      return *this;
+    }
+    //! No copy assignment
+    striped_handle_adapter &operator=(const striped_handle_adapter &) = delete;
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~striped_handle_adapter() override
+    {
+      // ignore
+    }
+
+    /*! \brief Create an adapter striping over `handles`.
+    \param handles The handles into which data is striped, usually each on a different device.
+    \param stripe_unit The bytes of each stripe stored in each handle.
+    \param _mode Whether the adapter is writable.
+    \param flags Any additional flags, such as `flag::disable_parallelism`.
+    \param ctx The multiplexer to use, if any.
+
+    \errors `errc::invalid_argument` if there are no handles, more than `max_handles` handles,
+    or `stripe_unit` is zero.
+    */
+    static result<striped_handle_adapter> striped(span<target_handle_type *const> handles, size_t stripe_unit = 524288, mode _mode = mode::write, flag flags = flag::none,
+                                                  io_multiplexer *ctx = nullptr) noexcept
+    {
+      if(handles.empty() || handles.size() > max_handles || stripe_unit == 0)
+      {
+        return errc::invalid_argument;
+      }
+      return striped_handle_adapter(handles, stripe_unit, _mode, flags, ctx);
+    }
+
+    //! The number of backing handles
+    size_t backing_handles() const noexcept { return _count; }
+    //! The bytes of each stripe stored in each handle
+    size_t stripe_unit() const noexcept { return _unit; }
+    //! The backing handle at index `n`
+    target_handle_type *backing_handle(size_t n) const noexcept { return _handles[n]; }
+
+    //! \brief Close all the backing handles.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
+    {
+      for(size_t n = 0; n < _count; n++)
+      {
+        OUTCOME_TRY(_handles[n]->close());
+      }
+      return success();
+    }
+
+    //! \brief Return the extent for which all bytes are stored in the backing handles
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> maximum_extent() const noexcept override
+    {
+      extent_type ret = 0;
+      for(size_t n = 0; n < _count; n++)
+      {
+        OUTCOME_TRY(auto &&_, _handles[n]->maximum_extent());
+        const extent_type end = _offset_from_backing(n, _);
+        if(end > ret)
+        {
+          ret = end;
+        }
+      }
+      return ret;
+    }
+    //! \brief Truncate each backing handle to the part of `newsize` it stores
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> truncate(extent_type newsize) noexcept override
+    {
+      optional<result<extent_type>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) { return _handles[n]->truncate(_backing_offset(n, newsize)); }));
+      return newsize;
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<file_handle::extent_pair>> extents() const noexcept override { return errc::operation_not_supported; }
+    //! \brief Punches a hole in the corresponding extent of each backing handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero(file_handle::extent_pair extent, deadline d = deadline()) noexcept override
+    {
+      optional<result<extent_type>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) { return _handles[n]->zero(_backing_extent(n, extent), d); }));
+      return extent.length;
+    }
+    //! \brief Preallocates the corresponding extent of each backing handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<file_handle::extent_pair> preallocate(file_handle::extent_pair extent, bool keep_size = true) noexcept override
+    {
+      optional<result<file_handle::extent_pair>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) { return _handles[n]->preallocate(_backing_extent(n, extent), keep_size); }));
+      return extent;
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+    //! \brief Advises each backing handle about the corresponding extent.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> advise(file_handle::extent_pair region, access_hint hint) noexcept override
+    {
+      optional<result<void>> results[max_handles];
+      return _for_each_handle(results, [&](size_t n) { return _handles[n]->advise(_backing_extent(n, region), hint); });
+    }
+
+  protected:
+    //! \brief As requests are split, any number of buffers may be supplied
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return 0; }
+
+    //! Split the request into one per backing handle, and issue them.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      size_type bytes = 0;
+      for(const auto &b : reqs.buffers)
+      {
+        bytes += b.size();
+      }
+      _sub_requests<buffer_type> sub;
+      OUTCOME_TRY(_split(sub, reqs.buffers, reqs.offset));
+      optional<io_result<buffers_type>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) -> io_result<buffers_type> {
+        if(sub.count[n] == 0)
+        {
+          return buffers_type();
+        }
+        io_request<buffers_type> req({sub.pieces + sub.first[n], sub.count[n]}, _backing_offset(n, reqs.offset));
+        return _handles[n]->read(req, d);
+      }));
+      _trim(reqs.buffers, _transferred(sub, results, reqs.offset, bytes));
+      return std::move(reqs.buffers);
+    }
+
+    //! Split the request into one per backing handle, and issue them.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      size_type bytes = 0;
+      for(const auto &b : reqs.buffers)
+      {
+        bytes += b.size();
+      }
+      _sub_requests<const_buffer_type> sub;
+      OUTCOME_TRY(_split(sub, reqs.buffers, reqs.offset));
+      optional<io_result<const_buffers_type>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) -> io_result<const_buffers_type> {
+        if(sub.count[n] == 0)
+        {
+          return const_buffers_type();
+        }
+        io_request<const_buffers_type> req({sub.pieces + sub.first[n], sub.count[n]}, _backing_offset(n, reqs.offset));
+        return _handles[n]->write(req, d);
+      }));
+      _trim(reqs.buffers, _transferred(sub, results, reqs.offset, bytes));
+      return std::move(reqs.buffers);
+    }
+
+    //! Issue the barrier to all the backing handles
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept override
+    {
+      optional<io_result<const_buffers_type>> results[max_handles];
+      OUTCOME_TRY(_for_each_handle(results, [&](size_t n) -> io_result<const_buffers_type> { return _handles[n]->barrier({}, kind, d); }));
+      return std::move(reqs.buffers);
+    }
+  };
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,634 @@
+/* A handle which keeps the hot extents of a slow handle in a fast handle
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_TIERED_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_TIERED_H
+
+#include "combining.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//! \file handle_adapter/tiered.hpp Provides `tiered_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+  /*! \class tiered_handle_adapter
+  \brief A file handle storing a file on a slow tier, with its most accessed extents also
+  stored on a fast tier from which they are served.
+  \tparam FastTarget The type of the handle on the fast tier e.g. NVMe, which must be a `file_handle`.
+  \tparam SlowTarget The type of the handle on the slow tier e.g. a hard drive, which must be a `file_handle`.
+
+  \warning This class is still in development, do not use.
+
+  The slow handle always holds the whole file. The file is divided into extents of
+  `extent_size()` bytes, each of which has a heat incremented by each read or write of it, with
+  the heat of every extent halved after every sixteen times `fast_extents()` accesses, so the heat
+  measures recent accesses. An extent whose heat reaches `promote_heat()` is queued for
+  promotion. The fast handle is sparse, holding at the same offset as in the slow handle only
+  the extents promoted, of which there are at most `fast_extents()`.
+
+  Migrations are never done by `read()` nor `write()`, but by `migrate()`, which may be called by
+  any thread concurrently with i/o, typically one dedicated to doing so. Each queued extent is
+  promoted with `file_handle::clone_extents_to()` from the slow handle to the fast handle, first
+  demoting the coldest extent promoted if the fast tier is full, unless that is as hot as the
+  extent queued. `migrate()` holds the adapter's lock whilst copying each extent, so i/o waits for
+  at most one extent to be copied.
+
+  Reads and writes of extents promoted are served by the fast handle, and all other i/o by the
+  slow handle. Extents written on the fast tier are written back to the slow handle with
+  `file_handle::clone_extents_to()` when demoted, and by `flush()`, which is called by barriers,
+  `close()` and destruction. Demoted extents are deallocated from the fast handle with `zero()`.
+
+  Which extents were promoted is not persisted, so the fast handle is truncated to zero when the
+  adapter is created. Third party changes to either handle are not seen by the adapter.
+  `collapse()`, `insert()` and `extents()` are not supported.
+
+  Destroying the adapter flushes it but does not destroy the attached handles, and any flush
+  failure is ignored. Closing the adapter flushes it and closes the attached handles.
+  */
+  template <class FastTarget, class SlowTarget = FastTarget> class tiered_handle_adapter : public detail::file_handle_wrapper
+  {
+    static_assert(std::is_base_of<file_handle, FastTarget>::value, "tiered_handle_adapter requires the fast handle to be a file handle");
+    static_assert(std::is_base_of<file_handle, SlowTarget>::value, "tiered_handle_adapter requires the slow handle to be a file handle");
+
+  public:
+    using path_type = io_handle::path_type;
+    using extent_type = io_handle::extent_type;
+    using size_type = io_handle::size_type;
+    using mode = io_handle::mode;
+    using creation = io_handle::creation;
+    using caching = io_handle::caching;
+    using flag = io_handle::flag;
+    using buffer_type = io_handle::buffer_type;
+    using const_buffer_type = io_handle::const_buffer_type;
+    using buffers_type = io_handle::buffers_type;
+    using const_buffers_type = io_handle::const_buffers_type;
+    template <class T> using io_request = io_handle::io_request<T>;
+    template <class T> using io_result = io_handle::io_result<T>;
+
+    using fast_handle_type = FastTarget;
+    using slow_handle_type = SlowTarget;
+
+  protected:
+    struct _extent
+    {
+      uint32_t heat{0};
+      bool promoted{false}, dirty{false}, queued{false};
+    };
+    struct _state
+    {
+      std::mutex lock;
+      size_t extent_size{0}, fast_extents{0}, promoted{0};
+      uint32_t promote_heat{0};
+      std::unordered_map<extent_type, _extent> extents;
+      std::vector<extent_type> queue;
+      size_t accesses{0};
+      extent_type extent{0};
+    };
+    fast_handle_type *_fast{nullptr};
+    slow_handle_type *_slow{nullptr};
+    std::unique_ptr<_state> _s;
+
+  private:
+    static constexpr native_handle_type _native_handle(mode _mode)
+    {
+      native_handle_type nativeh;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable;
+      if(_mode == mode::write)
+      {
+        nativeh.behaviour |= native_handle_type::disposition::writable;
+      }
+      return nativeh;
+    }
+
+    // The bytes of the extent at index which exist. Lock must be held.
+    size_type _extent_bytes(extent_type idx) const noexcept
+    {
+      const extent_type offset = idx * _s->extent_size;
+      return (offset >= _s->extent) ? 0 : (size_type)(std::min)((extent_type) _s->extent_size, _s->extent - offset);
+    }
+
+    // Records an access of the extent at index, queuing it for promotion if hot enough. Lock must be held.
+    _extent &_access(extent_type idx)
+    {
+      auto &e = _s->extents[idx];
+      if(e.heat < UINT32_MAX)
+      {
+        e.heat++;
+      }
+      if(!e.promoted && !e.queued && e.heat >= _s->promote_heat)
+      {
+        e.queued = true;
+        _s->queue.push_back(idx);
+      }
+      if(++_s->accesses >= _s->fast_extents * 16)
+      {
+        // Halve every heat, forgetting extents gone cold on the slow tier
+        _s->accesses = 0;
+        for(auto it = _s->extents.begin(); it != _s->extents.end();)
+        {
+          it->second.heat /= 2;
+          if(it->second.heat == 0 && !it->second.promoted && !it->second.queued && &it->second != &e)
+          {
+            it = _s->extents.erase(it);
+          }
+          else
+          {
+            ++it;
+          }
+        }
+      }
+      return e;
+    }
+
+    // Writes a promoted extent back to the slow handle if written. Lock must be held.
+    result<void> _write_back(extent_type idx, _extent &e, deadline d) noexcept
+    {
+      if(!e.dirty)
+      {
+        return success();
+      }
+      const size_type bytes = _extent_bytes(idx);
+      if(bytes > 0)
+      {
+        OUTCOME_TRY(_fast->clone_extents_to({idx * _s->extent_size, bytes}, *_slow, idx * _s->extent_size, d, true));
+      }
+      e.dirty = false;
+      return success();
+    }
+
+    // Writes back and deallocates a promoted extent from the fast handle. Lock must be held.
+    result<void> _demote(extent_type idx, _extent &e, deadline d) noexcept
+    {
+      OUTCOME_TRY(_write_back(idx, e, d));
+      OUTCOME_TRY(_fast->zero({idx * _s->extent_size, _s->extent_size}, d));
+      e.promoted = false;
+      _s->promoted--;
+      return success();
+    }
+
+    // Reads or writes the part of a buffer within one extent from the tier containing it. Lock must be held.
+    template <class BufferType> result<size_type> _do_extent_io(BufferType b, extent_type offset, deadline d)
+    {
+      const extent_type idx = offset / _s->extent_size;
+      auto &e = _access(idx);
+      io_handle *h = e.promoted ? static_cast<io_handle *>(_fast) : static_cast<io_handle *>(_slow);
+      size_type bytes = 0;
+      io_request<span<BufferType>> req({&b, 1}, offset);
+      OUTCOME_TRY(auto &&done, _io(h, req, d));
+      for(const auto &r : done)
+      {
+        // Some handles e.g. mapped ones return buffers other than those supplied
+        if(r.data() != b.data() + bytes)
+        {
+          _copy_out(b.data() + bytes, r.data(), r.size());
+        }
+        bytes += r.size();
+      }
+      if(e.promoted && std::is_same<BufferType, const_buffer_type>::value)
+      {
+        e.dirty = true;
+      }
+      return bytes;
+    }
+    static io_result<buffers_type> _io(io_handle *h, io_request<buffers_type> req, deadline d) noexcept { return h->read(req, d); }
+    static io_result<const_buffers_type> _io(io_handle *h, io_request<const_buffers_type> req, deadline d) noexcept { return h->write(req, d); }
+    static void _copy_out(byte *dest, const byte *src, size_t bytes) noexcept { memcpy(dest, src, bytes); }
+    static void _copy_out(const byte * /*unused*/, const byte * /*unused*/, size_t /*unused*/) noexcept {}
+
+  protected:
+    tiered_handle_adapter(fast_handle_type *fast, slow_handle_type *slow, std::unique_ptr<_state> s, mode _mode, flag flags, io_multiplexer *ctx)
+        : detail::file_handle_wrapper(_native_handle(_mode), slow->kernel_caching(), flags, ctx)
+        , _fast(fast)
+        , _slow(slow)
+        , _s(std::move(s))
+    {
+    }
+
+  public:
+    //! Default constructor
+    tiered_handle_adapter() = default;
+    //! Implicit move construction of tiered_handle_adapter permitted
+    tiered_handle_adapter(tiered_handle_adapter &&o) noexcept
+        : detail::file_handle_wrapper(std::move(o))
+        , _fast(o._fast)
+        , _slow(o._slow)
+        , _s(std::move(o._s))
+    {
+      o._fast = nullptr;
+      o._slow = nullptr;
+    }
+    //! No copy construction
+    tiered_handle_adapter(const tiered_handle_adapter &) = delete;
+    //! Move assignment of tiered_handle_adapter permitted
+    tiered_handle_adapter &operator=(tiered_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~tiered_handle_adapter();
+      new(this) tiered_handle_adapter(std::move(o));
+      return *this;
+    }
+    //! No copy assignment
+    tiered_handle_adapter &operator=(const tiered_handle_adapter &) = delete;
+    //! Flushes any extents written on the fast tier, ignoring failure
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~tiered_handle_adapter() override
+    {
+      if(_s)
+      {
+        auto r = flush();
+        if(!r)
+        {
+          LLFIO_LOG_WARN(nullptr, "tiered_handle_adapter::~tiered_handle_adapter() failed to flush extents written on the fast tier");
+        }
+      }
+    }
+
+    /*! \brief Create an adapter storing `slow`, with its hot extents also stored in `fast`.
+    \param fast The handle on the fast tier, which is truncated to zero.
+    \param slow The handle on the slow tier, which holds the whole file.
+    \param fast_bytes The most bytes of the fast tier to use. Rounded up to a whole extent.
+    \param extent_size The bytes of each extent, which must be a multiple of the page size, or
+    zero for one megabyte.
+    \param promote_heat The heat at which an extent is queued for promotion.
+    \param _mode Whether the adapter is writable.
+    \param flags Any additional flags.
+    \param ctx The multiplexer to use, if any.
+
+    \errors `errc::invalid_argument` if `extent_size` is not a multiple of the page size or
+    `promote_heat` is zero, any of the values `maximum_extent()` and `truncate()` can return.
+    */
+    static result<tiered_handle_adapter> tiered(fast_handle_type *fast, slow_handle_type *slow, size_t fast_bytes = 1024 * 1024 * 1024, size_t extent_size = 0,
+                                                uint32_t promote_heat = 4, mode _mode = mode::write, flag flags = flag::none, io_multiplexer *ctx = nullptr) noexcept
+    {
+      try
+      {
+        if(extent_size == 0)
+        {
+          extent_size = 1024 * 1024;
+        }
+        if((extent_size % utils::page_size()) != 0 || promote_heat == 0)
+        {
+          return errc::invalid_argument;
+        }
+        auto s = std::make_unique<_state>();
+        OUTCOME_TRY(auto &&extent, slow->maximum_extent());
+        OUTCOME_TRY(fast->truncate(0));
+        s->extent = extent;
+        s->extent_size = extent_size;
+        s->fast_extents = (std::max)((fast_bytes + extent_size - 1) / extent_size, (size_t) 1);
+        s->promote_heat = promote_heat;
+        s->extents.reserve(s->fast_extents * 2);
+        return tiered_handle_adapter(fast, slow, std::move(s), _mode, flags, ctx);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The handle on the fast tier
+    fast_handle_type *fast() const noexcept { return _fast; }
+    //! The handle on the slow tier
+    slow_handle_type *slow() const noexcept { return _slow; }
+    //! The bytes of each extent
+    size_t extent_size() const noexcept { return _s ? _s->extent_size : 0; }
+    //! The most extents stored on the fast tier
+    size_t fast_extents() const noexcept { return _s ? _s->fast_extents : 0; }
+    //! The heat at which an extent is queued for promotion
+    uint32_t promote_heat() const noexcept { return _s ? _s->promote_heat : 0; }
+    //! The number of extents currently stored on the fast tier
+    size_t promoted_extents() const noexcept
+    {
+      if(!_s)
+      {
+        return 0;
+      }
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->promoted;
+    }
+    //! The number of extents queued for promotion by `migrate()`
+    size_t queued_extents() const noexcept
+    {
+      if(!_s)
+      {
+        return 0;
+      }
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->queue.size();
+    }
+    //! True if the extent containing `offset` is stored on the fast tier
+    bool is_promoted(extent_type offset) const noexcept
+    {
+      if(!_s)
+      {
+        return false;
+      }
+      std::lock_guard<std::mutex> g(_s->lock);
+      auto it = _s->extents.find(offset / _s->extent_size);
+      return it != _s->extents.end() && it->second.promoted;
+    }
+
+    /*! \brief Promotes up to `max_extents` of the extents queued for promotion, hottest first,
+    returning how many were promoted.
+
+    Extents queued which have since cooled below `promote_heat()`, or which are no hotter than
+    the coldest extent already promoted when the fast tier is full, are not promoted and are
+    removed from the queue. If a migration fails, the extent stays where it was and the failure
+    is returned.
+    */
+    result<size_t> migrate(size_t max_extents = (size_t) -1, deadline d = deadline()) noexcept
+    {
+      try
+      {
+        size_t count = 0;
+        while(count < max_extents)
+        {
+          // The lock is retaken for each extent, so i/o waits for at most one extent to be copied
+          std::lock_guard<std::mutex> g(_s->lock);
+          if(_s->queue.empty())
+          {
+            break;
+          }
+          auto hottest = std::max_element(_s->queue.begin(), _s->queue.end(),
+                                          [this](extent_type a, extent_type b) { return _s->extents[a].heat < _s->extents[b].heat; });
+          const extent_type idx = *hottest;
+          *hottest = _s->queue.back();
+          _s->queue.pop_back();
+          auto &e = _s->extents[idx];
+          e.queued = false;
+          if(e.promoted || e.heat < _s->promote_heat)
+          {
+            continue;
+          }
+          if(_s->promoted >= _s->fast_extents)
+          {
+            auto coldest = _s->extents.end();
+            for(auto it = _s->extents.begin(); it != _s->extents.end(); ++it)
+            {
+              if(it->second.promoted && (coldest == _s->extents.end() || it->second.heat < coldest->second.heat))
+              {
+                coldest = it;
+              }
+            }
+            if(coldest == _s->extents.end() || coldest->second.heat >= e.heat)
+            {
+              continue;
+            }
+            OUTCOME_TRY(_demote(coldest->first, coldest->second, d));
+          }
+          const size_type bytes = _extent_bytes(idx);
+          if(bytes > 0)
+          {
+            OUTCOME_TRY(_slow->clone_extents_to({idx * _s->extent_size, bytes}, *_fast, idx * _s->extent_size, d, true));
+          }
+          e.promoted = true;
+          e.dirty = false;
+          _s->promoted++;
+          count++;
+        }
+        return count;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! \brief Writes every extent written on the fast tier back to the slow handle.
+    result<void> flush(deadline d = deadline()) noexcept
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      for(auto &i : _s->extents)
+      {
+        if(i.second.promoted)
+        {
+          OUTCOME_TRY(_write_back(i.first, i.second, d));
+        }
+      }
+      return success();
+    }
+
+    //! \brief Flush and close the attached handles.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
+    {
+      if(_s)
+      {
+        OUTCOME_TRY(flush());
+        _s.reset();
+      }
+      if(_fast != nullptr)
+      {
+        OUTCOME_TRY(_fast->close());
+      }
+      if(_slow != nullptr)
+      {
+        OUTCOME_TRY(_slow->close());
+      }
+      return success();
+    }
+
+    //! \brief Return the maximum extent
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> maximum_extent() const noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->extent;
+    }
+    /*! \brief Forget any extents promoted past `newsize` without writing them back, and truncate
+    both handles. Any promoted extent containing the old or new maximum extent is demoted first, so
+    no extent on the fast tier is ever past the end of the fast handle.
+    */
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> truncate(extent_type newsize) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        for(const extent_type idx : {_s->extent / _s->extent_size, newsize / _s->extent_size})
+        {
+          auto it = _s->extents.find(idx);
+          if(it != _s->extents.end() && it->second.promoted)
+          {
+            OUTCOME_TRY(_demote(idx, it->second, {}));
+          }
+        }
+        for(auto it = _s->extents.begin(); it != _s->extents.end();)
+        {
+          if(it->first * _s->extent_size >= newsize)
+          {
+            if(it->second.promoted)
+            {
+              _s->promoted--;
+            }
+            it = _s->extents.erase(it);
+          }
+          else
+          {
+            ++it;
+          }
+        }
+        _s->queue.erase(std::remove_if(_s->queue.begin(), _s->queue.end(), [&](extent_type idx) { return _s->extents.count(idx) == 0; }), _s->queue.end());
+        OUTCOME_TRY(_slow->truncate(newsize));
+        OUTCOME_TRY(auto &&fast_extent, _fast->maximum_extent());
+        if(newsize < fast_extent)
+        {
+          OUTCOME_TRY(_fast->truncate(newsize));
+        }
+        _s->extent = newsize;
+        return newsize;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<file_handle::extent_pair>> extents() const noexcept override { return errc::operation_not_supported; }
+    //! \brief Zero the extent on both handles.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero(file_handle::extent_pair extent, deadline d = deadline()) noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      // Regions of the fast handle not promoted are already holes
+      OUTCOME_TRY(_fast->zero(extent, d));
+      return _slow->zero(extent, d);
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+
+  protected:
+    //! \brief As each buffer is split at extent boundaries, any number of buffers may be supplied
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return 0; }
+
+    //! Read each part of the request from the tier storing its extent.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        const size_t es = _s->extent_size;
+        extent_type offset = reqs.offset;
+        for(auto &b : reqs.buffers)
+        {
+          const size_t bytes = (offset >= _s->extent) ? 0 : (size_t)(std::min)((extent_type) b.size(), _s->extent - offset);
+          size_t done = 0;
+          while(done < bytes)
+          {
+            const size_t n = (std::min)(es - (size_t)(offset % es), bytes - done);
+            OUTCOME_TRY(auto &&read, _do_extent_io(buffer_type(b.data() + done, n), offset, d));
+            done += read;
+            offset += read;
+            if(read < n)
+            {
+              break;
+            }
+          }
+          b = buffer_type(b.data(), done);
+          if(done < bytes)
+          {
+            break;
+          }
+        }
+        return std::move(reqs.buffers);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Write each part of the request to the tier storing its extent.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        const size_t es = _s->extent_size;
+        extent_type offset = reqs.offset;
+        for(auto &b : reqs.buffers)
+        {
+          if(offset + b.size() > _s->extent)
+          {
+            // The slow handle always holds the whole file, so extend it before writing the fast tier
+            OUTCOME_TRY(_slow->truncate(offset + b.size()));
+            // And if the extent containing the old end is promoted, extend its copy on the fast tier
+            auto it = _s->extents.find(_s->extent / es);
+            if(it != _s->extents.end() && it->second.promoted)
+            {
+              const extent_type newend = (std::min)((extent_type) offset + b.size(), (it->first + 1) * es);
+              OUTCOME_TRY(auto &&fast_extent, _fast->maximum_extent());
+              if(fast_extent < newend)
+              {
+                OUTCOME_TRY(_fast->truncate(newend));
+              }
+            }
+            _s->extent = offset + b.size();
+          }
+          for(size_t done = 0; done < b.size();)
+          {
+            const size_t n = (std::min)(es - (size_t)(offset % es), b.size() - done);
+            OUTCOME_TRY(auto &&written, _do_extent_io(const_buffer_type(b.data() + done, n), offset, d));
+            if(written != n)
+            {
+              return errc::io_error;
+            }
+            done += n;
+            offset += n;
+          }
+        }
+        return std::move(reqs.buffers);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Flush, then issue the barrier to the slow handle
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept override
+    {
+      OUTCOME_TRY(flush(d));
+      OUTCOME_TRY(_slow->barrier({}, kind, d));
+      return std::move(reqs.buffers);
+    }
+  };
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,305 @@
+/* A handle which transforms the data of another handle
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_TRANSFORM_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_TRANSFORM_H
+
+#include "combining.hpp"
+
+//! \file handle_adapter/transform.hpp Provides `transform_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    template <class Transform> struct transform_handle_adapter_op_bind
+    {
+      template <class Target, class Source> struct op
+      {
+        static_assert(std::is_void<Source>::value, "Second input is not possible with transform_handle_adapter");
+
+        using buffer_type = typename Target::buffer_type;
+        using const_buffer_type = typename Target::const_buffer_type;
+        using const_buffers_type = typename Target::const_buffers_type;
+
+        // Never called, as override_ replaces the default implementations of read() and write()
+        static result<buffer_type> do_read(buffer_type /*unused*/, buffer_type /*unused*/, buffer_type /*unused*/) noexcept { return errc::operation_not_supported; }
+        static result<const_buffer_type> do_write(buffer_type /*unused*/, buffer_type /*unused*/, const_buffer_type /*unused*/) noexcept
+        {
+          return errc::operation_not_supported;
+        }
+        static result<const_buffers_type> adjust_written_buffers(const_buffers_type out, const_buffer_type /*unused*/, const_buffer_type /*unused*/) noexcept
+        {
+          return out;
+        }
+
+        template <class Base> struct override_ : public Base
+        {
+          using extent_type = typename Base::extent_type;
+          using size_type = typename Base::size_type;
+          using mode = typename Base::mode;
+          using flag = typename Base::flag;
+          using buffer_type = typename Base::buffer_type;
+          using const_buffer_type = typename Base::const_buffer_type;
+          using buffers_type = typename Base::buffers_type;
+          using const_buffers_type = typename Base::const_buffers_type;
+          template <class T> using io_request = typename Base::template io_request<T>;
+          template <class T> using io_result = typename Base::template io_result<T>;
+
+          //! The transform type
+          using transform_type = Transform;
+          //! The bytes transformed at a time, while the next chunk is being read or the previous chunk written
+          static constexpr size_t pipeline_bytes = 65536;
+
+        protected:
+          transform_type _transform;
+
+        private:
+          // Walks scatter-gather buffers in chunks of at most pipeline_bytes
+          template <class BufferType> struct _chunker
+          {
+            span<BufferType> buffers;
+            size_t idx{0}, offset{0};
+
+            BufferType next() noexcept
+            {
+              while(idx < buffers.size() && offset == buffers[idx].size())
+              {
+                idx++;
+                offset = 0;
+              }
+              if(idx == buffers.size())
+              {
+                return {};
+              }
+              const auto &b = buffers[idx];
+              const size_t bytes = (std::min)(pipeline_bytes, b.size() - offset);
+              BufferType ret(b.data() + offset, bytes);
+              offset += bytes;
+              return ret;
+            }
+          };
+          // Shortens scatter-gather buffers to the bytes transferred
+          template <class BufferType> static void _trim(span<BufferType> buffers, size_type bytes) noexcept
+          {
+            for(auto &b : buffers)
+            {
+              const size_t _bytes = (bytes < b.size()) ? (size_t) bytes : b.size();
+              b = BufferType(b.data(), _bytes);
+              bytes -= _bytes;
+            }
+          }
+
+        public:
+          override_() = default;
+          template <class... Args>
+          override_(Target *a, void *b, mode _mode, flag flags, io_multiplexer *ctx, Args &&... args)
+              : Base(a, b, _mode, flags, ctx)
+              , _transform(std::forward<Args>(args)...)
+          {
+          }
+
+          //! The transform
+          transform_type &transform() noexcept { return _transform; }
+          //! The transform
+          const transform_type &transform() const noexcept { return _transform; }
+
+        protected:
+          /*! Read chunks from the attached handle directly into the supplied buffers, decoding each
+          in place while the next is being read.
+          */
+          LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+          {
+            _chunker<buffer_type> chunks{reqs.buffers};
+            buffer_type chunk[2] = {chunks.next(), {}};
+            extent_type offset = reqs.offset;
+            size_type done = 0;
+            optional<io_result<buffers_type>> _filled;
+            if(chunk[0].size() > 0)
+            {
+              io_request<buffers_type> req({&chunk[0], 1}, offset);
+              _filled = this->_target->read(req, d);
+            }
+            for(size_t k = 0; chunk[k & 1].size() > 0; k++)
+            {
+              buffer_type &cur = chunk[k & 1], &next = chunk[(k + 1) & 1];
+              size_t bytes = 0;
+              {
+                OUTCOME_TRY(auto &&filled, std::move(*_filled));
+                bytes = filled.empty() ? 0 : filled[0].size();
+              }
+              // A short read ends the request
+              next = (bytes == cur.size()) ? chunks.next() : buffer_type{};
+              optional<result<void>> decoded;
+              _filled.reset();
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if(next.size() > 0 && (this->_flags & flag::disable_parallelism) == 0)
+#endif
+              for(size_t n = 0; n < 2; n++)
+              {
+                if(n == 0)
+                {
+                  decoded = _transform.decode(cur.data(), cur.data(), bytes, offset);
+                }
+                else if(next.size() > 0)
+                {
+                  io_request<buffers_type> req({&next, 1}, offset + bytes);
+                  _filled = this->_target->read(req, d);
+                }
+              }
+              OUTCOME_TRY(std::move(*decoded));
+              done += bytes;
+              offset += bytes;
+            }
+            _trim(reqs.buffers, done);
+            return std::move(reqs.buffers);
+          }
+
+          /*! Encode chunks of the supplied buffers into temporary buffers (stack allocated if below
+          a page size), writing each to the attached handle while the next is being encoded.
+          */
+          LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+          {
+            size_type bytes = 0;
+            for(const auto &b : reqs.buffers)
+            {
+              bytes += b.size();
+            }
+            const size_t _bytes = ((size_t)(std::min)(bytes, (size_type) pipeline_bytes) + 63) & ~63;
+            // If less than page size, use stack, else use free pages
+            byte *temp = (byte *) ((_bytes * 2 <= utils::page_size()) ? alloca(_bytes * 2 + 64) : nullptr);
+            map_handle temph;
+            if(temp != nullptr)
+            {
+              // Adjust to 64 byte multiple
+              temp = (byte *) (((uintptr_t) temp + 63) & ~63);
+            }
+            else
+            {
+              OUTCOME_TRY(auto &&_, map_handle::map(_bytes * 2));
+              temph = std::move(_);
+              temp = temph.address();
+            }
+
+            _chunker<const_buffer_type> chunks{reqs.buffers};
+            const_buffer_type chunk[2] = {chunks.next(), {}};
+            extent_type offset = reqs.offset;
+            size_type done = 0;
+            if(chunk[0].size() > 0)
+            {
+              OUTCOME_TRY(_transform.encode(temp, chunk[0].data(), chunk[0].size(), offset));
+            }
+            for(size_t k = 0; chunk[k & 1].size() > 0; k++)
+            {
+              const_buffer_type &cur = chunk[k & 1], &next = chunk[(k + 1) & 1];
+              // cur is now the encoded copy
+              cur = const_buffer_type(temp + (k & 1) * _bytes, cur.size());
+              next = chunks.next();
+              optional<io_result<const_buffers_type>> _written;
+              optional<result<void>> encoded;
+#if !defined(LLFIO_DISABLE_OPENMP) && defined(_OPENMP)
+#pragma omp parallel for if(next.size() > 0 && (this->_flags & flag::disable_parallelism) == 0)
+#endif
+              for(size_t n = 0; n < 2; n++)
+              {
+                if(n == 0)
+                {
+                  io_request<const_buffers_type> req({&cur, 1}, offset);
+                  _written = this->_target->write(req, d);
+                }
+                else if(next.size() > 0)
+                {
+                  encoded = _transform.encode(temp + ((k + 1) & 1) * _bytes, next.data(), next.size(), offset + cur.size());
+                }
+              }
+              size_t written = 0;
+              {
+                OUTCOME_TRY(auto &&_, std::move(*_written));
+                written = _.empty() ? 0 : _[0].size();
+              }
+              done += written;
+              offset += written;
+              // A short write ends the request
+              if(written < cur.size())
+              {
+                break;
+              }
+              if(next.size() > 0)
+              {
+                OUTCOME_TRY(std::move(*encoded));
+              }
+            }
+            _trim(reqs.buffers, done);
+            return std::move(reqs.buffers);
+          }
+        };
+      };
+    };
+  }  // namespace detail
+
+  /*! \brief A handle transforming the data of another handle as it is read and written,
+  for example to checksum, compress or encrypt it.
+  \tparam Transform The type of the transform, an instance of which the adapter owns.
+  \tparam Target The type of the handle whose data is transformed.
+
+  \warning This class is still in development, do not use.
+
+  `Transform` must match the form of:
+
+  ~~~cpp
+  struct Transform
+  {
+    // Called after `bytes` at `offset` have been read from the target handle. `out` may equal `in`.
+    result<void> decode(byte *out, const byte *in, size_t bytes, extent_type offset) noexcept;
+    // Called before `bytes` are written at `offset` to the target handle.
+    result<void> encode(byte *out, const byte *in, size_t bytes, extent_type offset) noexcept;
+  };
+  ~~~
+
+  Any additional arguments to the constructor are used to construct the transform, which
+  is available from `transform()`. Transforms must preserve length, so compressors must work
+  in fixed size blocks which they pad.
+
+  Unlike the default implementation of the combining handle adapter, requests are processed
+  in chunks of `pipeline_bytes`. Reads are made directly into the supplied buffers and decoded
+  in place, so no temporary buffers are needed. Writes are encoded into one of two temporary
+  buffers while the other is being written. If OpenMP is available, `LLFIO_DISABLE_OPENMP` is
+  not defined, and `flag::disable_parallelism` is not set, the transform of each chunk runs
+  concurrently with the i/o of its neighbouring chunk, else chunking still keeps the data being
+  transformed in cache. Either way, only one call into the transform is ever made at a time, and
+  calls are always made in order of ascending offset within a request.
+  */
+  template <class Transform, class Target> using transform_handle_adapter = combining_handle_adapter<detail::transform_handle_adapter_op_bind<Transform>::template op, Target, void>;
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,565 @@
+/* A handle which caches writes to another handle in memory
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_HANDLE_ADAPTER_WRITE_BACK_H
+#define LLFIO_ALGORITHM_HANDLE_ADAPTER_WRITE_BACK_H
+
+#include "combining.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//! \file handle_adapter/write_back.hpp Provides `write_back_handle_adapter`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace algorithm
+{
+  /*! \class write_back_handle_adapter
+  \brief A file handle caching the blocks of another file handle in memory, so many small
+  writes are combined into few large ones.
+  \tparam Target The type of the handle cached, which must be a `file_handle`.
+
+  \warning This class is still in development, do not use.
+
+  Reads and writes are served from blocks of `block_size()` bytes held in an arena of
+  `cache_bytes()` bytes allocated with `map_handle::map()`. Blocks not cached are read in
+  whole, so the handle cached may be opened with `caching::none` and the adapter will only ever
+  issue block aligned i/o to it, even for writes of single bytes. Writes covering whole blocks
+  are not read first.
+
+  Written blocks are not written to the handle cached until `flush()` is called, a barrier
+  is issued, the adapter is closed or destroyed, or the arena is full of written blocks and
+  another block is needed. Flushes write all the written blocks in order of offset, with each
+  run of consecutive blocks written by a single gather write, and then reduce the handle cached
+  to `maximum_extent()` if the final block was past it. When the arena needs space, the least
+  recently used block not awaiting a flush is reused.
+
+  A mutex serialises the i/o of each adapter. Third party changes to the handle cached
+  are not seen by the adapter for blocks already cached.
+
+  Destroying the adapter flushes it but does not destroy the attached handle, and any flush
+  failure is ignored. Closing the adapter flushes it and closes the attached handle.
+  */
+  template <class Target> class write_back_handle_adapter : public detail::file_handle_wrapper
+  {
+    static_assert(std::is_base_of<file_handle, Target>::value, "write_back_handle_adapter requires the handle cached to be a file handle");
+
+  public:
+    using path_type = io_handle::path_type;
+    using extent_type = io_handle::extent_type;
+    using size_type = io_handle::size_type;
+    using mode = io_handle::mode;
+    using creation = io_handle::creation;
+    using caching = io_handle::caching;
+    using flag = io_handle::flag;
+    using buffer_type = io_handle::buffer_type;
+    using const_buffer_type = io_handle::const_buffer_type;
+    using buffers_type = io_handle::buffers_type;
+    using const_buffers_type = io_handle::const_buffers_type;
+    template <class T> using io_request = io_handle::io_request<T>;
+    template <class T> using io_result = io_handle::io_result<T>;
+
+    using target_handle_type = Target;
+
+  protected:
+    static constexpr size_t _npos = (size_t) -1;
+    struct _slot
+    {
+      extent_type block{(extent_type) -1};
+      size_t prev{_npos}, next{_npos};
+      bool dirty{false};
+    };
+    struct _state
+    {
+      std::mutex lock;
+      map_handle arena;
+      size_t block_size{0};
+      std::vector<_slot> slots;
+      std::unordered_map<extent_type, size_t> by_block;
+      std::vector<size_t> free;
+      size_t mru{_npos}, lru{_npos}, dirty{0};
+      extent_type extent{0};
+    };
+    target_handle_type *_target{nullptr};
+    std::unique_ptr<_state> _s;
+
+  private:
+    static constexpr native_handle_type _native_handle(mode _mode)
+    {
+      native_handle_type nativeh;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable;
+      if(_mode == mode::write)
+      {
+        nativeh.behaviour |= native_handle_type::disposition::writable;
+      }
+      return nativeh;
+    }
+
+    byte *_block_address(size_t i) const noexcept { return _s->arena.address() + i * _s->block_size; }
+    void _unlink(size_t i) noexcept
+    {
+      auto &slot = _s->slots[i];
+      ((slot.prev != _npos) ? _s->slots[slot.prev].next : _s->mru) = slot.next;
+      ((slot.next != _npos) ? _s->slots[slot.next].prev : _s->lru) = slot.prev;
+      slot.prev = slot.next = _npos;
+    }
+    void _push_front(size_t i) noexcept
+    {
+      auto &slot = _s->slots[i];
+      slot.prev = _npos;
+      slot.next = _s->mru;
+      ((_s->mru != _npos) ? _s->slots[_s->mru].prev : _s->lru) = i;
+      _s->mru = i;
+    }
+
+    // Writes all dirty blocks in order of offset, coalescing consecutive blocks. Lock must be held.
+    result<void> _flush(deadline d)
+    {
+      if(_s->dirty == 0)
+      {
+        return success();
+      }
+      std::vector<size_t> dirty;
+      dirty.reserve(_s->dirty);
+      for(size_t i = 0; i < _s->slots.size(); i++)
+      {
+        if(_s->slots[i].dirty)
+        {
+          dirty.push_back(i);
+        }
+      }
+      std::sort(dirty.begin(), dirty.end(), [this](size_t a, size_t b) { return _s->slots[a].block < _s->slots[b].block; });
+      const size_t bs = _s->block_size;
+      std::vector<const_buffer_type> buffers;
+      buffers.reserve(dirty.size());
+      bool past_extent = false;
+      for(size_t idx = 0; idx < dirty.size();)
+      {
+        const extent_type first = _s->slots[dirty[idx]].block;
+        size_t count = 0;
+        buffers.clear();
+        while(idx + count < dirty.size() && _s->slots[dirty[idx + count]].block == first + count)
+        {
+          buffers.emplace_back(_block_address(dirty[idx + count]), bs);
+          count++;
+        }
+        io_request<const_buffers_type> req(buffers, first * bs);
+        OUTCOME_TRY(auto &&written, _target->write(req, d));
+        size_type bytes = 0;
+        for(const auto &b : written)
+        {
+          bytes += b.size();
+        }
+        if(bytes != count * bs)
+        {
+          return errc::io_error;
+        }
+        for(size_t n = 0; n < count; n++)
+        {
+          _s->slots[dirty[idx + n]].dirty = false;
+        }
+        _s->dirty -= count;
+        if((first + count) * bs > _s->extent)
+        {
+          past_extent = true;
+        }
+        idx += count;
+      }
+      if(past_extent)
+      {
+        OUTCOME_TRY(_target->truncate(_s->extent));
+      }
+      return success();
+    }
+
+    // Returns the slot caching the block, reading it in if fill is true. Lock must be held.
+    result<size_t> _slot_for(extent_type block, bool fill, deadline d)
+    {
+      auto it = _s->by_block.find(block);
+      if(it != _s->by_block.end())
+      {
+        _unlink(it->second);
+        _push_front(it->second);
+        return it->second;
+      }
+      if(_s->free.empty())
+      {
+        size_t victim = _s->lru;
+        while(victim != _npos && _s->slots[victim].dirty)
+        {
+          victim = _s->slots[victim].prev;
+        }
+        if(victim == _npos)
+        {
+          OUTCOME_TRY(_flush(d));
+          victim = _s->lru;
+        }
+        _unlink(victim);
+        _s->by_block.erase(_s->slots[victim].block);
+        _s->slots[victim].block = (extent_type) -1;
+        _s->free.push_back(victim);
+      }
+      const size_t i = _s->free.back();
+      const size_t bs = _s->block_size;
+      byte *p = _block_address(i);
+      size_t filled = 0;
+      if(fill && block * bs < _s->extent)
+      {
+        buffer_type b(p, bs);
+        io_request<buffers_type> req({&b, 1}, block * bs);
+        OUTCOME_TRY(auto &&read, _target->read(req, d));
+        // Some handles e.g. mapped ones return buffers other than those supplied
+        for(const auto &r : read)
+        {
+          if(r.data() != p + filled)
+          {
+            memcpy(p + filled, r.data(), r.size());
+          }
+          filled += r.size();
+        }
+      }
+      if(fill)
+      {
+        memset(p + filled, 0, bs - filled);
+      }
+      _s->by_block.emplace(block, i);
+      _s->free.pop_back();
+      _s->slots[i].block = block;
+      _push_front(i);
+      return i;
+    }
+
+    // Forgets cached blocks at or after newsize, zeroing the tail of any block straddling it. Lock must be held.
+    void _discard_from(extent_type newsize) noexcept
+    {
+      const size_t bs = _s->block_size;
+      for(size_t i = 0; i < _s->slots.size(); i++)
+      {
+        auto &slot = _s->slots[i];
+        if(slot.block == (extent_type) -1 || (slot.block + 1) * bs <= newsize)
+        {
+          continue;
+        }
+        if(slot.block * bs < newsize)
+        {
+          const size_t keep = (size_t)(newsize - slot.block * bs);
+          memset(_block_address(i) + keep, 0, bs - keep);
+          continue;
+        }
+        if(slot.dirty)
+        {
+          slot.dirty = false;
+          _s->dirty--;
+        }
+        _unlink(i);
+        _s->by_block.erase(slot.block);
+        slot.block = (extent_type) -1;
+        _s->free.push_back(i);
+      }
+    }
+
+  protected:
+    write_back_handle_adapter(target_handle_type *h, std::unique_ptr<_state> s, mode _mode, flag flags, io_multiplexer *ctx)
+        : detail::file_handle_wrapper(_native_handle(_mode), h->kernel_caching(), flags, ctx)
+        , _target(h)
+        , _s(std::move(s))
+    {
+    }
+
+  public:
+    //! Default constructor
+    write_back_handle_adapter() = default;
+    //! Implicit move construction of write_back_handle_adapter permitted
+    write_back_handle_adapter(write_back_handle_adapter &&o) noexcept
+        : detail::file_handle_wrapper(std::move(o))
+        , _target(o._target)
+        , _s(std::move(o._s))
+    {
+      o._target = nullptr;
+    }
+    //! No copy construction
+    write_back_handle_adapter(const write_back_handle_adapter &) = delete;
+    //! Move assignment of write_back_handle_adapter permitted
+    write_back_handle_adapter &operator=(write_back_handle_adapter &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~write_back_handle_adapter();
+      new(this) write_back_handle_adapter(std::move(o));
+      return *this;
+    }
+    //! No copy assignment
+    write_back_handle_adapter &operator=(const write_back_handle_adapter &) = delete;
+    //! Flushes any written blocks, ignoring failure
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~write_back_handle_adapter() override
+    {
+      if(_s)
+      {
+        auto r = flush();
+        if(!r)
+        {
+          LLFIO_LOG_WARN(nullptr, "write_back_handle_adapter::~write_back_handle_adapter() failed to flush written blocks");
+        }
+      }
+    }
+
+    /*! \brief Create an adapter caching the blocks of `h`.
+    \param h The handle to cache.
+    \param cache_bytes The bytes of memory in which to cache blocks. Rounded up to a whole block.
+    \param block_size The bytes of each block, which must be a multiple of the page size, or zero
+    for the page size.
+    \param _mode Whether the adapter is writable.
+    \param flags Any additional flags.
+    \param ctx The multiplexer to use, if any.
+
+    \errors `errc::invalid_argument` if `block_size` is not a multiple of the page size, any of
+    the values `maximum_extent()` and `map_handle::map()` can return.
+    */
+    static result<write_back_handle_adapter> write_back(target_handle_type *h, size_t cache_bytes = 64 * 1024 * 1024, size_t block_size = 0, mode _mode = mode::write,
+                                                        flag flags = flag::none, io_multiplexer *ctx = nullptr) noexcept
+    {
+      try
+      {
+        if(block_size == 0)
+        {
+          block_size = utils::page_size();
+        }
+        if((block_size % utils::page_size()) != 0)
+        {
+          return errc::invalid_argument;
+        }
+        const size_t blocks = (std::max)((cache_bytes + block_size - 1) / block_size, (size_t) 1);
+        auto s = std::make_unique<_state>();
+        OUTCOME_TRY(auto &&extent, h->maximum_extent());
+        OUTCOME_TRY(auto &&arena, map_handle::map(blocks * block_size));
+        s->extent = extent;
+        s->arena = std::move(arena);
+        s->block_size = block_size;
+        s->slots.resize(blocks);
+        s->by_block.reserve(blocks);
+        s->free.reserve(blocks);
+        for(size_t n = blocks; n > 0; n--)
+        {
+          s->free.push_back(n - 1);
+        }
+        return write_back_handle_adapter(h, std::move(s), _mode, flags, ctx);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The handle cached
+    target_handle_type *target() const noexcept { return _target; }
+    //! The bytes of each block
+    size_t block_size() const noexcept { return _s ? _s->block_size : 0; }
+    //! The bytes of memory in which blocks are cached
+    size_t cache_bytes() const noexcept { return _s ? _s->slots.size() * _s->block_size : 0; }
+    //! The number of blocks written but not yet flushed
+    size_t dirty_blocks() const noexcept
+    {
+      if(!_s)
+      {
+        return 0;
+      }
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->dirty;
+    }
+
+    /*! \brief Writes all written blocks to the handle cached, in order of offset, with each run of
+    consecutive blocks written by a single gather write.
+    */
+    result<void> flush(deadline d = deadline()) noexcept
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        return _flush(d);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! \brief Flush and close the attached handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
+    {
+      if(_s)
+      {
+        OUTCOME_TRY(flush());
+        _s.reset();
+      }
+      if(_target != nullptr)
+      {
+        OUTCOME_TRY(_target->close());
+      }
+      return success();
+    }
+
+    //! \brief Return the maximum extent including any written blocks not yet flushed
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> maximum_extent() const noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      return _s->extent;
+    }
+    //! \brief Forget any cached blocks past `newsize`, and truncate the attached handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> truncate(extent_type newsize) noexcept override
+    {
+      std::lock_guard<std::mutex> g(_s->lock);
+      _discard_from(newsize);
+      OUTCOME_TRY(_target->truncate(newsize));
+      _s->extent = newsize;
+      return newsize;
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<file_handle::extent_pair>> extents() const noexcept override { return errc::operation_not_supported; }
+    //! \brief Flush the cache, forget any cached blocks, and punch a hole in the attached handle.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero(file_handle::extent_pair extent, deadline d = deadline()) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        OUTCOME_TRY(_flush(d));
+        const size_t bs = _s->block_size;
+        for(size_t i = 0; i < _s->slots.size(); i++)
+        {
+          auto &slot = _s->slots[i];
+          if(slot.block != (extent_type) -1 && (slot.block + 1) * bs > extent.offset && slot.block * bs < extent.offset + extent.length)
+          {
+            _unlink(i);
+            _s->by_block.erase(slot.block);
+            slot.block = (extent_type) -1;
+            _s->free.push_back(i);
+          }
+        }
+        return _target->zero(extent, d);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+    //! \brief Always returns a failed matching `errc::operation_not_supported`.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(file_handle::extent_pair /*unused*/) noexcept override { return errc::operation_not_supported; }
+
+  protected:
+    //! \brief As data is always copied, any number of buffers may be supplied
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return 0; }
+
+    //! Copy the request out of the cached blocks, reading in any not cached.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        const size_t bs = _s->block_size;
+        extent_type offset = reqs.offset;
+        for(auto &b : reqs.buffers)
+        {
+          const size_t bytes = (offset >= _s->extent) ? 0 : (size_t)(std::min)((extent_type) b.size(), _s->extent - offset);
+          for(size_t done = 0; done < bytes;)
+          {
+            const extent_type block = offset / bs;
+            const size_t u = (size_t)(offset % bs), n = (std::min)(bs - u, bytes - done);
+            OUTCOME_TRY(auto &&i, _slot_for(block, true, d));
+            memcpy(b.data() + done, _block_address(i) + u, n);
+            done += n;
+            offset += n;
+          }
+          b = buffer_type(b.data(), bytes);
+        }
+        return std::move(reqs.buffers);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Copy the request into cached blocks, reading in any partially written and not cached.
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_s->lock);
+        const size_t bs = _s->block_size;
+        extent_type offset = reqs.offset;
+        for(auto &b : reqs.buffers)
+        {
+          for(size_t done = 0; done < b.size();)
+          {
+            const extent_type block = offset / bs;
+            const size_t u = (size_t)(offset % bs), n = (std::min)(bs - u, b.size() - done);
+            OUTCOME_TRY(auto &&i, _slot_for(block, n != bs, d));
+            memcpy(_block_address(i) + u, b.data() + done, n);
+            if(!_s->slots[i].dirty)
+            {
+              _s->slots[i].dirty = true;
+              _s->dirty++;
+            }
+            done += n;
+            offset += n;
+            if(offset > _s->extent)
+            {
+              _s->extent = offset;
+            }
+          }
+        }
+        return std::move(reqs.buffers);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Flush, then issue the barrier to the attached handle
+    LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept override
+    {
+      OUTCOME_TRY(flush(d));
+      OUTCOME_TRY(_target->barrier({}, kind, d));
+      return std::move(reqs.buffers);
+    }
+  };
+
+  // BEGIN make_free_functions.py
+
+  // END make_free_functions.py
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -27,6 +27,14 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "combining.hpp"
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>  // for AVX2 and AVX-512
+#elif defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>  // for SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 //! \file handle_adapter/xor.hpp Provides `xor_handle_adapter`.
 
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
@@ -36,6 +44,104 @@ namespace algorithm
 
   namespace detail
   {
+    /* XORs `bytes` of `a` and `b` into `out`, which may be either of `a` or `b`.
+
+    Bytes are XORed individually until `out` is aligned to the widest vector the
+    compiler has been told it may use, after which whole vectors are stored aligned while loads
+    from `a` and `b` are unaligned, which costs nothing on any recent CPU. The tail less than a
+    vector is XORed in register sized then byte sized pieces.
+    */
+    inline void xor_buffers(byte *out, const byte *a, const byte *b, size_t bytes) noexcept
+    {
+#if defined(__AVX512F__)
+      static constexpr size_t vector_size = 64;
+#elif defined(__AVX2__)
+      static constexpr size_t vector_size = 32;
+#elif defined(__x86_64__) || defined(_M_X64) || (defined(__ARM_NEON) && defined(__aarch64__))
+      static constexpr size_t vector_size = 16;
+#else
+      static constexpr size_t vector_size = sizeof(uintptr_t);
+#endif
+      size_t idx = 0;
+      // Unaligned head
+      for(; idx < bytes && (((uintptr_t) out + idx) & (vector_size - 1)) != 0; idx++)
+      {
+        out[idx] = a[idx] ^ b[idx];
+      }
+      // Aligned body, four vectors at a time
+#if defined(__AVX512F__)
+      for(; bytes - idx >= 256; idx += 256)
+      {
+        for(size_t n = 0; n < 256; n += 64)
+        {
+          _mm512_store_si512(reinterpret_cast<void *>(out + idx + n),
+                             _mm512_xor_si512(_mm512_loadu_si512(reinterpret_cast<const void *>(a + idx + n)), _mm512_loadu_si512(reinterpret_cast<const void *>(b + idx + n))));
+        }
+      }
+      for(; bytes - idx >= 64; idx += 64)
+      {
+        _mm512_store_si512(reinterpret_cast<void *>(out + idx),
+                           _mm512_xor_si512(_mm512_loadu_si512(reinterpret_cast<const void *>(a + idx)), _mm512_loadu_si512(reinterpret_cast<const void *>(b + idx))));
+      }
+#elif defined(__AVX2__)
+      for(; bytes - idx >= 128; idx += 128)
+      {
+        for(size_t n = 0; n < 128; n += 32)
+        {
+          _mm256_store_si256(reinterpret_cast<__m256i *>(out + idx + n), _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + idx + n)),
+                                                                                          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + idx + n))));
+        }
+      }
+      for(; bytes - idx >= 32; idx += 32)
+      {
+        _mm256_store_si256(reinterpret_cast<__m256i *>(out + idx),
+                           _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + idx)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + idx))));
+      }
+#elif defined(__x86_64__) || defined(_M_X64)
+      for(; bytes - idx >= 64; idx += 64)
+      {
+        for(size_t n = 0; n < 64; n += 16)
+        {
+          _mm_store_si128(reinterpret_cast<__m128i *>(out + idx + n),
+                          _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + idx + n)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + idx + n))));
+        }
+      }
+      for(; bytes - idx >= 16; idx += 16)
+      {
+        _mm_store_si128(reinterpret_cast<__m128i *>(out + idx),
+                        _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + idx)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + idx))));
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      for(; bytes - idx >= 64; idx += 64)
+      {
+        const uint8x16x4_t x = vld1q_u8_x4(reinterpret_cast<const uint8_t *>(a + idx)), y = vld1q_u8_x4(reinterpret_cast<const uint8_t *>(b + idx));
+        uint8x16x4_t z;
+        z.val[0] = veorq_u8(x.val[0], y.val[0]);
+        z.val[1] = veorq_u8(x.val[1], y.val[1]);
+        z.val[2] = veorq_u8(x.val[2], y.val[2]);
+        z.val[3] = veorq_u8(x.val[3], y.val[3]);
+        vst1q_u8_x4(reinterpret_cast<uint8_t *>(out + idx), z);
+      }
+      for(; bytes - idx >= 16; idx += 16)
+      {
+        vst1q_u8(reinterpret_cast<uint8_t *>(out + idx), veorq_u8(vld1q_u8(reinterpret_cast<const uint8_t *>(a + idx)), vld1q_u8(reinterpret_cast<const uint8_t *>(b + idx))));
+      }
+#endif
+      // Tail, using memcpy() to load and store registers as a, b and out may be misaligned
+      for(; bytes - idx >= sizeof(uintptr_t); idx += sizeof(uintptr_t))
+      {
+        uintptr_t x, y;
+        memcpy(&x, a + idx, sizeof(x));
+        memcpy(&y, b + idx, sizeof(y));
+        x ^= y;
+        memcpy(out + idx, &x, sizeof(x));
+      }
+      for(; idx < bytes; idx++)
+      {
+        out[idx] = a[idx] ^ b[idx];
+      }
+    }
+
     template <class Target, class Source> struct xor_handle_adapter_op
     {
       static_assert(!std::is_void<Source>::value, "Optional second input is not possible with xor_handle_adapter");
@@ -55,118 +161,14 @@ namespace algorithm
         {
           out = buffer_type(out.data(), s.size());
         }
-        for(size_t idx = 0; idx < out.size();)
-        {
-          {
-            // If addresses happen to align to SIMD, hint very strongly to use SIMD
-            uintptr_t remain1 = ((uintptr_t) out.data() + idx) & 63;
-            uintptr_t remain2 = ((uintptr_t) t.data() + idx) & 63;
-            uintptr_t remain3 = ((uintptr_t) s.data() + idx) & 63;
-            if(remain1 == 0 && remain2 == 0 && remain3 == 0)
-            {
-              while(out.size() - idx >= 64)
-              {
-                uint64_t *a = (uint64_t *) (out.data() + idx);
-                const uint64_t *b = (const uint64_t *) (t.data() + idx);
-                const uint64_t *c = (const uint64_t *) (s.data() + idx);
-                a[0] = b[0] ^ c[0];
-                a[1] = b[1] ^ c[1];
-                a[2] = b[2] ^ c[2];
-                a[3] = b[3] ^ c[3];
-                a[4] = b[4] ^ c[4];
-                a[5] = b[5] ^ c[5];
-                a[6] = b[6] ^ c[6];
-                a[7] = b[7] ^ c[7];
-                idx += 64;
-              }
-            }
-          }
-          {
-            // If addresses happen to align to registers, use that
-            uintptr_t remain1 = ((uintptr_t) out.data() + idx) & (sizeof(uintptr_t) - 1);
-            uintptr_t remain2 = ((uintptr_t) t.data() + idx) & (sizeof(uintptr_t) - 1);
-            uintptr_t remain3 = ((uintptr_t) s.data() + idx) & (sizeof(uintptr_t) - 1);
-            if(remain1 == 0 && remain2 == 0 && remain3 == 0)
-            {
-              while(out.size() - idx >= sizeof(uintptr_t))
-              {
-                uintptr_t *a = (uintptr_t *) (out.data() + idx);
-                const uintptr_t *b = (const uintptr_t *) (t.data() + idx);
-                const uintptr_t *c = (const uintptr_t *) (s.data() + idx);
-                a[0] = b[0] ^ c[0];
-                idx += sizeof(uintptr_t);
-              }
-            }
-          }
-          // Otherwise byte work
-          while(out.size() - idx > 0)
-          {
-            uint8_t *a = (uint8_t *) (out.data() + idx);
-            const uint8_t *b = (const uint8_t *) (t.data() + idx);
-            const uint8_t *c = (const uint8_t *) (s.data() + idx);
-            a[0] = b[0] ^ c[0];
-            idx += 1;
-          }
-        }
+        xor_buffers(out.data(), t.data(), s.data(), out.size());
         return out;
       }
 
       static result<const_buffer_type> do_write(buffer_type t, buffer_type s, const_buffer_type in) noexcept
       {
         // in is the constraint here
-        for(size_t idx = 0; idx < in.size();)
-        {
-          {
-            // If addresses happen to align to SIMD, hint very strongly to use SIMD
-            uintptr_t remain1 = ((uintptr_t) t.data() + idx) & 63;
-            uintptr_t remain2 = ((uintptr_t) s.data() + idx) & 63;
-            uintptr_t remain3 = ((uintptr_t) in.data() + idx) & 63;
-            if(remain1 == 0 && remain2 == 0 && remain3 == 0)
-            {
-              while(in.size() - idx >= 64)
-              {
-                uint64_t *a = (uint64_t *) (t.data() + idx);
-                const uint64_t *b = (const uint64_t *) (s.data() + idx);
-                const uint64_t *c = (const uint64_t *) (in.data() + idx);
-                a[0] = b[0] ^ c[0];
-                a[1] = b[1] ^ c[1];
-                a[2] = b[2] ^ c[2];
-                a[3] = b[3] ^ c[3];
-                a[4] = b[4] ^ c[4];
-                a[5] = b[5] ^ c[5];
-                a[6] = b[6] ^ c[6];
-                a[7] = b[7] ^ c[7];
-                idx += 64;
-              }
-            }
-          }
-          {
-            // If addresses happen to align to registers, use that
-            uintptr_t remain1 = ((uintptr_t) t.data() + idx) & (sizeof(uintptr_t) - 1);
-            uintptr_t remain2 = ((uintptr_t) s.data() + idx) & (sizeof(uintptr_t) - 1);
-            uintptr_t remain3 = ((uintptr_t) in.data() + idx) & (sizeof(uintptr_t) - 1);
-            if(remain1 == 0 && remain2 == 0 && remain3 == 0)
-            {
-              while(in.size() - idx >= sizeof(uintptr_t))
-              {
-                uintptr_t *a = (uintptr_t *) (t.data() + idx);
-                const uintptr_t *b = (const uintptr_t *) (s.data() + idx);
-                const uintptr_t *c = (const uintptr_t *) (in.data() + idx);
-                a[0] = b[0] ^ c[0];
-                idx += sizeof(uintptr_t);
-              }
-            }
-          }
-          // Otherwise byte work
-          while(in.size() - idx > 0)
-          {
-            uint8_t *a = (uint8_t *) (t.data() + idx);
-            const uint8_t *b = (const uint8_t *) (s.data() + idx);
-            const uint8_t *c = (const uint8_t *) (in.data() + idx);
-            a[0] = b[0] ^ c[0];
-            idx += 1;
-          }
-        }
+        xor_buffers(t.data(), s.data(), in.data(), in.size());
         // Adjust buffers returned to bytes read from in!
         t = {t.data(), in.size()};
         return t;
@@ -0,0 +1,526 @@
+/* A filesystem algorithm which builds a manifest of the hashes of the contents of a directory tree
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_MANIFEST_HPP
+#define LLFIO_ALGORITHM_MANIFEST_HPP
+
+#include "atomic_replace.hpp"
+#include "difference.hpp"
+#include "path_table.hpp"
+
+#include "../map_handle.hpp"
+
+#include "quickcpplib/algorithm/hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! \file manifest.hpp Provides a parallel builder of manifests of the hashes of the contents of a directory tree.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  //! The type of the hash of the contents of a file in a `manifest`
+  using manifest_hash_type = QUICKCPPLIB_NAMESPACE::integers128::uint128;
+
+  /*! \brief The hash of the contents of a file, and the metadata it had when hashed.
+   */
+  struct manifest_entry
+  {
+    stat_t stat{nullptr};     //!< Only `st_dev`, `st_ino`, `st_type`, `st_size` and `st_mtim` are valid
+    manifest_hash_type hash;  //!< The hash of the contents
+  };
+
+  /*! \brief The hash of the contents of every regular file within a directory tree, keyed by
+  path relative to the root of the tree.
+  */
+  struct manifest : public std::map<filesystem::path, manifest_entry>
+  {
+    //! Statistics about the building of a manifest
+    struct statistics
+    {
+      size_t files_hashed{0};              //!< Files whose contents were read and hashed
+      size_t files_reused{0};              //!< Files whose hash was reused from the previous manifest, as they were unchanged
+      size_t files_failed{0};              //!< Files which could not be opened or read, and so are not in the manifest
+      handle::extent_type bytes_hashed{0};  //!< The bytes of contents hashed
+    } stats;
+
+    //! The metadata captured for each file
+    static constexpr stat_t::want metadata() { return stat_t::want::dev | stat_t::want::ino | stat_t::want::type | stat_t::want::size | stat_t::want::mtim; }
+
+    //! True if the file with metadata `st` is presumed to still have the contents of `entry`
+    static bool unchanged(const manifest_entry &entry, const stat_t &st) noexcept
+    {
+      return entry.stat.st_dev == st.st_dev && entry.stat.st_ino == st.st_ino && entry.stat.st_size == st.st_size && entry.stat.st_mtim == st.st_mtim;
+    }
+
+    //! Returns the metadata of the files of the manifest, for use with `difference()`.
+    tree_snapshot snapshot() const
+    {
+      tree_snapshot ret;
+      for(auto &i : *this)
+      {
+        ret.emplace_hint(ret.end(), i.first, i.second.stat);
+      }
+      return ret;
+    }
+
+    /*! \brief Returns the manifest as text, with a line per file in path order of its hash in hex,
+    its device, inode, size and modified timestamp in nanoseconds since the epoch, and its path
+    with any backslashes and newlines escaped.
+    */
+    std::string to_string() const
+    {
+      std::string ret("llfio manifest v1\n");
+      char buffer[128];
+      for(auto &i : *this)
+      {
+        char hex[33];
+        utils::detail::to_hex_string(hex, reinterpret_cast<const char *>(i.second.hash.as_bytes), 16);
+        hex[32] = 0;
+        const auto mtim = std::chrono::duration_cast<std::chrono::nanoseconds>(i.second.stat.st_mtim.time_since_epoch()).count();
+        snprintf(buffer, sizeof(buffer), "%s %llu %llu %llu %lld ", hex, (unsigned long long) i.second.stat.st_dev, (unsigned long long) i.second.stat.st_ino,
+                 (unsigned long long) i.second.stat.st_size, (long long) mtim);
+        ret.append(buffer);
+        for(auto c : i.first.generic_string())
+        {
+          if(c == '\\')
+          {
+            ret.append("\\\\");
+          }
+          else if(c == '\n')
+          {
+            ret.append("\\n");
+          }
+          else
+          {
+            ret.push_back(c);
+          }
+        }
+        ret.push_back('\n');
+      }
+      return ret;
+    }
+
+    /*! \brief Parses a manifest previously returned by `to_string()`.
+
+    \errors `errc::illegal_byte_sequence` if `text` is not a manifest.
+    */
+    static result<manifest> from_string(string_view text) noexcept
+    {
+      try
+      {
+        static constexpr char header[] = "llfio manifest v1\n";
+        if(text.size() < sizeof(header) - 1 || memcmp(text.data(), header, sizeof(header) - 1) != 0)
+        {
+          return errc::illegal_byte_sequence;
+        }
+        text.remove_prefix(sizeof(header) - 1);
+        auto hexdigit = [](char c) -> int {
+          if(c >= '0' && c <= '9')
+          {
+            return c - '0';
+          }
+          if(c >= 'a' && c <= 'f')
+          {
+            return c - 'a' + 10;
+          }
+          return -1;
+        };
+        manifest ret;
+        while(!text.empty())
+        {
+          const auto eol = text.find('\n');
+          if(eol == string_view::npos || eol < 33)
+          {
+            return errc::illegal_byte_sequence;
+          }
+          const std::string line(text.data(), eol);
+          text.remove_prefix(eol + 1);
+          manifest_entry entry;
+          for(size_t n = 0; n < 16; n++)
+          {
+            const int hi = hexdigit(line[n * 2]), lo = hexdigit(line[n * 2 + 1]);
+            if(hi < 0 || lo < 0)
+            {
+              return errc::illegal_byte_sequence;
+            }
+            entry.hash.as_bytes[n] = (uint8_t)((hi << 4) | lo);
+          }
+          const char *p = line.c_str() + 32;
+          char *end = nullptr;
+          uint64_t fields[3];
+          for(auto &field : fields)
+          {
+            if(*p != ' ')
+            {
+              return errc::illegal_byte_sequence;
+            }
+            field = strtoull(p + 1, &end, 10);
+            p = end;
+          }
+          if(*p != ' ')
+          {
+            return errc::illegal_byte_sequence;
+          }
+          const long long mtim = strtoll(p + 1, &end, 10);
+          p = end;
+          if(*p != ' ')
+          {
+            return errc::illegal_byte_sequence;
+          }
+          p++;
+          entry.stat.st_dev = fields[0];
+          entry.stat.st_ino = fields[1];
+          entry.stat.st_size = fields[2];
+          entry.stat.st_type = filesystem::file_type::regular;
+          entry.stat.st_mtim = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(mtim)));
+          std::string path;
+          for(; *p != 0; p++)
+          {
+            if(*p == '\\')
+            {
+              p++;
+              if(*p == 'n')
+              {
+                path.push_back('\n');
+                continue;
+              }
+              if(*p != '\\')
+              {
+                return errc::illegal_byte_sequence;
+              }
+            }
+            path.push_back(*p);
+          }
+          ret.emplace_hint(ret.end(), filesystem::path(path), entry);
+        }
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Atomically replaces the file `leafname` in `dirh` with `to_string()`.
+
+    \errors Any of the values `atomic_replacer::replace()` can return.
+    */
+    result<void> write(const directory_handle &dirh, path_view leafname) const noexcept
+    {
+      try
+      {
+        const auto text = to_string();
+        OUTCOME_TRY(auto &&clonedh, dirh.clone());
+        atomic_replacer replacer(std::move(clonedh));
+        file_handle::const_buffer_type buffer{reinterpret_cast<const byte *>(text.data()), text.size()};
+        return replacer.replace(leafname, {&buffer, 1});
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Reads a manifest previously written by `write()` from the file at `path` relative
+    to `base`.
+
+    \errors Any of the values `file_handle::file()`, `file_handle::read()` or `from_string()` can return.
+    */
+    static result<manifest> read(const path_handle &base, path_view path) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&fh, file_handle::file(base, path, file_handle::mode::read));
+        OUTCOME_TRY(auto &&length, fh.maximum_extent());
+        std::string text((size_t) length, 0);
+        OUTCOME_TRY(auto &&read, fh.read(0, {{reinterpret_cast<byte *>(&text[0]), text.size()}}));
+        text.resize(read);
+        return from_string(text);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief The state of a `build_manifest()`, which is the `data` passed to the visitor's callbacks.
+   */
+  struct manifest_state
+  {
+    const path_handle &rootdirh;
+    std::atomic<size_t> rootdirpathlen{0};
+    const manifest *previous{nullptr};      //!< If not null, the manifest whose hashes are reused for unchanged files
+    size_t read_size{0};                    //!< The size of each read of a file being hashed
+    handle::extent_type mapping_threshold;  //!< Files larger than this are mapped rather than read
+    std::mutex lock;
+    manifest built;  //!< The manifest being built
+
+    explicit manifest_state(const path_handle &_rootdirh)
+        : rootdirh(_rootdirh)
+    {
+    }
+  };
+
+  /*! \brief A visitor for the parallel manifest building algorithm.
+
+  Note that at any time, returning a failure causes `build_manifest()` to exit as soon
+  as possible with the same failure.
+
+  You can override the members here inherited from `traverse_visitor`, however note
+  that `build_manifest()` is entirely implemented using `traverse()`, so not calling the
+  implementations here will affect operation.
+  */
+  struct manifest_visitor : public traverse_visitor
+  {
+    //! The type of buffer into which files are read
+    using buffer_type = std::vector<byte, utils::pooled_page_allocator<byte>>;
+
+    /*! \brief Hashes the `length` bytes of the contents of `fh` with `Hasher`, reading them
+    sequentially into `buffer` in reads of its size, or mapping them into memory if longer than the
+    mapping threshold. `Hasher` must be default constructible, and have member functions
+    `add(const char *, size_t)` and `finalise()` returning a `manifest_hash_type`, as QuickCppLib's
+    `fast_hash` does.
+    */
+    template <class Hasher> static result<manifest_hash_type> hash_contents(manifest_state *state, file_handle &fh, handle::extent_type length, buffer_type &buffer) noexcept
+    {
+      Hasher hasher;
+      if(length > state->mapping_threshold)
+      {
+        OUTCOME_TRY(auto &&sh, section_handle::section(fh, 0, section_handle::flag::read));
+        OUTCOME_TRY(auto &&mh, map_handle::map(sh, (size_t) length, 0, section_handle::flag::read));
+        // The hash proceeds sequentially, so have the kernel read ahead
+        (void) map_handle::prefetch(map_handle::buffer_type{mh.address(), (size_t) length});
+        hasher.add(reinterpret_cast<const char *>(mh.address()), (size_t) length);
+        return hasher.finalise();
+      }
+      for(handle::extent_type offset = 0;;)
+      {
+        OUTCOME_TRY(auto &&read, fh.read(offset, {{buffer.data(), buffer.size()}}));
+        if(read == 0)
+        {
+          break;
+        }
+        hasher.add(reinterpret_cast<const char *>(buffer.data()), read);
+        offset += read;
+      }
+      return hasher.finalise();
+    }
+
+    /*! \brief Called to hash the contents of the file `leafname` in `dirh`, open as `fh`, of
+    `length` bytes. The default hashes with QuickCppLib's `fast_hash`, which is SpookyHash. To use
+    some other hash, such as a SIMD CRC, override this to call `hash_contents()` with it.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<manifest_hash_type> hash_file(void *data, const directory_handle &dirh, path_view leafname, file_handle &fh, handle::extent_type length,
+                                                 buffer_type &buffer) noexcept
+    {
+      (void) dirh;
+      (void) leafname;
+      return hash_contents<QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash>((manifest_state *) data, fh, length, buffer);
+    }
+
+    /*! \brief Called when a file could not be opened or read, or vanished before its metadata
+    could be fetched. The default omits the file from the manifest, counting it in
+    `manifest::statistics::files_failed`.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<void> file_failed(void *data, result<void>::error_type &&error, const directory_handle &dirh, path_view leafname) noexcept
+    {
+      (void) error;
+      (void) dirh;
+      (void) leafname;
+      auto *state = (manifest_state *) data;
+      std::lock_guard<std::mutex> g(state->lock);
+      state->built.stats.files_failed++;
+      return success();
+    }
+
+    //! This override hashes every regular file just enumerated whose hash cannot be reused
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      (void) depth;
+      try
+      {
+        auto *state = (manifest_state *) data;
+        const auto count = static_cast<size_t>(std::partition(contents.begin(), contents.end(),
+                                                              [](const directory_entry &entry) { return entry.stat.st_type == filesystem::file_type::regular; }) -
+                                               contents.begin());
+        if(count == 0)
+        {
+          return success();
+        }
+        OUTCOME_TRY(auto &&dirhpath, relative_directory_path(state->rootdirh, state->rootdirpathlen, dirh));
+        // Fetch the metadata of all the files at once, which on Linux is one statx() per file
+        const auto need_stat = manifest::metadata() & ~contents.metadata();
+        std::vector<result<size_t>> filled;
+        if(need_stat)
+        {
+          OUTCOME_TRY(filled, dirh.stat_entries(contents.subspan(0, count), need_stat));
+        }
+        std::vector<std::pair<filesystem::path, manifest_entry>> entries;
+        entries.reserve(count);
+        manifest::statistics stats;
+        buffer_type buffer;
+        for(size_t n = 0; n < count; n++)
+        {
+          auto &entry = contents[n];
+          if(!filled.empty() && !filled[n])
+          {
+            OUTCOME_TRY(file_failed(data, std::move(filled[n]).error(), dirh, entry.leafname));
+            continue;
+          }
+          auto path = dirhpath / entry.leafname.path();
+          if(state->previous != nullptr)
+          {
+            auto it = state->previous->find(path);
+            if(it != state->previous->end() && manifest::unchanged(it->second, entry.stat))
+            {
+              entries.emplace_back(std::move(path), it->second);
+              stats.files_reused++;
+              continue;
+            }
+          }
+          auto r = [&]() -> result<manifest_entry> {
+            OUTCOME_TRY(auto &&fh, file_handle::file(dirh, entry.leafname, file_handle::mode::read));
+            // Hash from the open file, so the metadata recorded is of the contents hashed
+            stat_t st(nullptr);
+            OUTCOME_TRY(st.fill(fh, manifest::metadata()));
+            if(buffer.empty() && st.st_size > 0 && st.st_size <= state->mapping_threshold)
+            {
+              buffer.resize(state->read_size);
+            }
+            OUTCOME_TRY(auto &&hash, hash_file(data, dirh, entry.leafname, fh, st.st_size, buffer));
+            return manifest_entry{st, hash};
+          }();
+          if(!r)
+          {
+            OUTCOME_TRY(file_failed(data, std::move(r).error(), dirh, entry.leafname));
+            continue;
+          }
+          stats.files_hashed++;
+          stats.bytes_hashed += r.value().stat.st_size;
+          entries.emplace_back(std::move(path), r.value());
+        }
+        std::lock_guard<std::mutex> g(state->lock);
+        for(auto &i : entries)
+        {
+          state->built.emplace(std::move(i.first), i.second);
+        }
+        state->built.stats.files_hashed += stats.files_hashed;
+        state->built.stats.files_reused += stats.files_reused;
+        state->built.stats.bytes_hashed += stats.bytes_hashed;
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief Builds a manifest of the hash of the contents of every regular file within and under
+  `dirh`.
+
+  The directory tree is traversed in parallel by `algorithm::traverse()` using up to `threads`
+  threads, and each thread hashes the files of each directory it enumerates. If `previous` is not
+  null, the hash of each file whose device, inode, size and modified timestamp are unchanged from
+  `previous` is reused without opening the file. Otherwise files are read from start to end in
+  reads of `read_size` bytes into a page aligned buffer reused by the thread, unless larger than
+  `mapping_threshold` in which case they are mapped into memory and have read ahead requested with
+  `map_handle::prefetch()`. The hash used can be replaced by overriding
+  `manifest_visitor::hash_file()`.
+
+  Files which cannot be opened or read are counted but otherwise omitted. Symbolic links are not
+  followed. `difference()` compares two manifests.
+
+  You should review the documentation for `algorithm::traverse()`, as this algorithm is entirely
+  implemented using that algorithm.
+  */
+  inline result<manifest> build_manifest(const path_handle &dirh, const manifest *previous = nullptr, manifest_visitor *visitor = nullptr, size_t threads = 0,
+                                         size_t read_size = 1024 * 1024, handle::extent_type mapping_threshold = 64 * 1024 * 1024) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    if(read_size == 0)
+    {
+      return errc::invalid_argument;
+    }
+    manifest_visitor default_visitor;
+    if(visitor == nullptr)
+    {
+      visitor = &default_visitor;
+    }
+    manifest_state state(dirh);
+    state.previous = previous;
+    state.read_size = read_size;
+    state.mapping_threshold = mapping_threshold;
+    OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+    state.rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+    OUTCOME_TRY(traverse(dirh, visitor, threads, &state));
+    return {std::move(state.built)};
+  }
+
+  /*! \brief Calculate the differences between two manifests of the same directory tree.
+
+  This is `difference()` of the snapshots of the two manifests, with the `content_comparison` of
+  each `difference_item::content_metadata_changed` item set to zero if the contents hash
+  identically, and to one otherwise. As manifests contain only files, renaming a directory reports
+  the rename of each file within it.
+  */
+  inline result<std::vector<difference_item>> difference(const manifest &before, const manifest &after) noexcept
+  {
+    try
+    {
+      OUTCOME_TRY(auto &&ret, difference(before.snapshot(), after.snapshot()));
+      for(auto &i : ret)
+      {
+        if(i.changed == difference_item::content_metadata_changed)
+        {
+          i.content_comparison = (before.at(i.path).hash == after.at(i.path).hash) ? 0 : 1;
+        }
+      }
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,727 @@
+/* Relocatable object graphs of offset pointers within a mapped file
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_MAPPED_ARENA_HPP
+#define LLFIO_ALGORITHM_MAPPED_ARENA_HPP
+
+#include "../mapped_file_handle.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+//! \file mapped_arena.hpp Provides containers of offset pointers which remain valid wherever their mapped file is mapped.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \class offset_ptr
+  \brief A pointer which stores the distance from itself to its target, so a graph of objects which
+  point at one another using these remains valid wherever the memory containing it is mapped.
+
+  Copying an `offset_ptr` adjusts the distance, so the copy points at the same target. A graph of
+  objects can therefore be relocated as a whole, for example by mapping its file at a different
+  address, but not by `memcpy()` of the bytes of individual objects.
+  */
+  template <class T> class offset_ptr
+  {
+    // As in Boost.Interprocess, a distance of one is null, as nothing can point into its own pointer
+    static constexpr intptr_t _null = 1;
+    intptr_t _distance{_null};
+
+    void _set(const T *p) noexcept { _distance = (p == nullptr) ? _null : (intptr_t)((uintptr_t) p - (uintptr_t) this); }
+
+  public:
+    //! The type pointed to
+    using element_type = T;
+
+    //! Constructs a null pointer
+    constexpr offset_ptr() {}  // NOLINT
+    //! Constructs a null pointer
+    constexpr offset_ptr(std::nullptr_t) {}  // NOLINT
+    //! Constructs a pointer to `p`
+    offset_ptr(T *p) noexcept { _set(p); }  // NOLINT
+    //! Constructs a pointer to what `o` points to
+    offset_ptr(const offset_ptr &o) noexcept { _set(o.get()); }
+    //! Points at what `o` points to
+    offset_ptr &operator=(const offset_ptr &o) noexcept
+    {
+      _set(o.get());
+      return *this;
+    }
+    //! Points at `p`
+    offset_ptr &operator=(T *p) noexcept
+    {
+      _set(p);
+      return *this;
+    }
+    ~offset_ptr() = default;
+
+    //! The target of the pointer
+    T *get() const noexcept { return (_distance == _null) ? nullptr : reinterpret_cast<T *>((uintptr_t) this + _distance); }
+    //! The target of the pointer
+    T &operator*() const noexcept { return *get(); }
+    //! The target of the pointer
+    T *operator->() const noexcept { return get(); }
+    //! The `n`th item from the target of the pointer
+    T &operator[](size_t n) const noexcept { return get()[n]; }
+    //! True if not null
+    explicit operator bool() const noexcept { return _distance != _null; }
+
+    //! True if both point at the same target
+    bool operator==(const offset_ptr &o) const noexcept { return get() == o.get(); }
+    //! True if they point at different targets
+    bool operator!=(const offset_ptr &o) const noexcept { return get() != o.get(); }
+  };
+
+  /*! \class mapped_arena
+  \brief An allocator of memory within a `mapped_file_handle`, within which graphs of objects
+  linked by `offset_ptr<T>` can be built, and reopened later, in this or any other process, without
+  any deserialisation.
+
+  The file begins with a small header recording the bytes allocated, and the offset of a root object
+  from which the rest of the graph can be found. Allocation bumps the bytes allocated, extending the
+  file geometrically when more space is needed. Memory is never freed, so storage abandoned by a
+  container which grew is not reused. To reclaim it, copy the graph into a new arena.
+
+  When the file is extended beyond the address space reserved by the `mapped_file_handle`, it is
+  remapped, usually at a different address. Graphs linked by `offset_ptr<T>` remain valid, however
+  every raw pointer and reference into the arena, including those held by the caller of the function
+  which allocated, is invalidated, as are objects outside the arena which refer into it. The
+  containers `offset_vector<T>`, `offset_string` and `offset_hash_map<K, V>` therefore take the
+  arena in each function which may allocate, and return a reference to themselves or to the item
+  affected at their locations after any remap. Reserving enough address space using `reserve()`
+  avoids remaps entirely.
+
+  Neither the arena nor its containers are thread safe. Objects allocated in the arena are never
+  destructed, so their types must be trivially destructible. The contents of the arena are only
+  meaningful to programs with the same layout of the types within it.
+  */
+  class mapped_arena
+  {
+  public:
+    //! The extent type
+    using extent_type = mapped_file_handle::extent_type;
+    //! The size type
+    using size_type = mapped_file_handle::size_type;
+
+    //! The bytes a newly created arena begins with
+    static constexpr size_type initial_bytes = 64 * 1024;
+
+  private:
+    struct _header_t
+    {
+      uint64_t magic;
+      uint64_t used;  // bytes allocated, including this header
+      uint64_t root;  // offset of the root object, or zero
+      uint64_t _reserved;
+    };
+    static constexpr uint64_t _magic = 0x3152414f49464c4cULL;  // LLFIOAR1
+
+    mapped_file_handle *_mfh{nullptr};
+
+    _header_t *_header() const noexcept { return reinterpret_cast<_header_t *>(_mfh->address()); }
+
+  public:
+    /*! \brief Constructs an arena within `mfh`, which must be open for write and must outlive the arena.
+    If `mfh` is empty, a new arena is created, otherwise the arena previously created there is reopened.
+    \throws `std::invalid_argument` if `mfh` was not written by a `mapped_arena`. Any error extending the file.
+    */
+    explicit mapped_arena(mapped_file_handle &mfh)
+        : _mfh(&mfh)
+    {
+      const auto length = mfh.maximum_extent().value();
+      if(length == 0)
+      {
+        mfh.truncate(initial_bytes).value();
+        auto *h = _header();
+        h->magic = _magic;
+        h->used = sizeof(_header_t);
+        h->root = 0;
+        return;
+      }
+      if(length < sizeof(_header_t) || _header()->magic != _magic || _header()->used > length || _header()->root >= length)
+      {
+        throw std::invalid_argument("mapped_arena: file was not written by a mapped_arena");  // NOLINT
+      }
+    }
+
+    //! The mapped file handle containing the arena
+    mapped_file_handle &file() const noexcept { return *_mfh; }
+    //! The address at which the arena is currently mapped. Invalidated by allocation.
+    byte *base() const noexcept { return _mfh->address(); }
+    //! The bytes allocated, including those of the header.
+    extent_type used() const noexcept { return _header()->used; }
+    //! The bytes which can be allocated before the file is extended.
+    extent_type capacity() const noexcept { return _mfh->map().length(); }
+
+    //! True if `p` points into the arena.
+    bool contains(const void *p) const noexcept
+    {
+      auto *b = static_cast<const byte *>(p);
+      return b >= base() && b < base() + _header()->used;
+    }
+    //! The offset from the start of the arena of `p`, which must point into the arena.
+    extent_type offset_of(const void *p) const noexcept
+    {
+      assert(contains(p));
+      return (extent_type)(static_cast<const byte *>(p) - base());
+    }
+    //! The object at `offset` from the start of the arena. Invalidated by allocation.
+    template <class T> T *pointer_to(extent_type offset) const noexcept { return reinterpret_cast<T *>(base() + offset); }
+
+    /*! \brief Reserves address space for the arena to grow into to at least `bytes`, so growing within
+    it does not remap the arena. Invalidates all pointers into the arena.
+    */
+    void reserve(size_type bytes) { _mfh->reserve(bytes).value(); }
+
+    /*! \brief Allocates `bytes` aligned to `align` within the arena, returning where they are. The
+    memory is all bits zero. Invalidates all pointers into the arena if the file had to be remapped.
+    */
+    void *allocate(size_type bytes, size_type align = alignof(std::max_align_t))
+    {
+      assert(align != 0 && (align & (align - 1)) == 0);
+      const uint64_t offset = (_header()->used + align - 1) & ~(uint64_t)(align - 1);
+      const uint64_t used = offset + bytes;
+      const auto length = _mfh->map().length();
+      if(used > length)
+      {
+        // Grow geometrically, so the number of remaps is logarithmic in the final size
+        _mfh->truncate(utils::round_up_to_page_size((std::max)((uint64_t) length * 2, used), utils::page_size())).value();
+      }
+      _header()->used = used;
+      return base() + offset;
+    }
+    //! Allocates and constructs a `T` from `args` within the arena, which must not refer into the arena.
+    template <class T, class... Args> T *construct(Args &&... args)
+    {
+      static_assert(std::is_trivially_destructible<T>::value, "mapped_arena: objects within the arena are never destructed!");
+      return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    //! The root object of the arena, or null if none has been set.
+    template <class T> T *root() const noexcept { return (_header()->root == 0) ? nullptr : pointer_to<T>(_header()->root); }
+    //! Sets the root object of the arena to `p`, which must point into the arena.
+    void set_root(const void *p) noexcept { _header()->root = offset_of(p); }
+  };
+
+  class offset_string;
+
+  /*! \brief Customisation point constructing a `T` at uninitialised memory `where` within `arena`
+  from `v`, returning where the constructed object is after any remap.
+
+  By default, it copy constructs. `offset_string` is specialised to construct from anything
+  convertible to a `string_view`.
+  */
+  template <class T> struct arena_constructor
+  {
+    template <class U> static T *construct(mapped_arena & /*unused*/, T *where, const U &v) { return new(where) T(v); }
+  };
+
+  /*! \class offset_vector
+  \brief A vector of `T` within a `mapped_arena`, which remains valid wherever the arena is mapped.
+
+  Functions which can allocate take the arena, and return references at their locations after any
+  remap of the arena, as this vector may itself have moved. Values passed to them may be in the
+  arena, but must not otherwise refer into it. Growing copy constructs the items into new storage,
+  which adjusts any `offset_ptr<T>` within them. Copying the vector copies a reference to its items,
+  not the items.
+  */
+  template <class T> class offset_vector
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "offset_vector: objects within the arena are never destructed!");
+    friend class offset_string;
+
+  public:
+    //! Value type
+    using value_type = T;
+    //! Size type
+    using size_type = size_t;
+    //! Reference type
+    using reference = value_type &;
+    //! Const reference type
+    using const_reference = const value_type &;
+    //! Iterator type
+    using iterator = value_type *;
+    //! Const iterator type
+    using const_iterator = const value_type *;
+
+  private:
+    offset_ptr<value_type> _begin;
+    uint64_t _size{0}, _capacity{0};
+
+    // Grows the storage to at least `mincapacity` items, returning this vector wherever it now is
+    offset_vector *_grow(mapped_arena &arena, size_type mincapacity)
+    {
+      const auto self = arena.offset_of(this);
+      const size_type newcapacity = (std::max)({(size_type) _capacity * 2, mincapacity, (size_type) 4});
+      auto *mem = static_cast<value_type *>(arena.allocate(newcapacity * sizeof(value_type), alignof(value_type)));
+      auto *me = arena.pointer_to<offset_vector>(self);
+      value_type *old = me->_begin.get();
+      if(std::is_trivially_copyable<value_type>::value)
+      {
+        if(me->_size > 0)
+        {
+          memcpy(static_cast<void *>(mem), old, (size_t) me->_size * sizeof(value_type));
+        }
+      }
+      else
+      {
+        for(size_type n = 0; n < me->_size; n++)
+        {
+          new(mem + n) value_type(old[n]);
+        }
+      }
+      me->_begin = mem;
+      me->_capacity = newcapacity;
+      return me;
+    }
+
+  public:
+    //! Constructs an empty vector. Its storage is allocated within the arena containing it.
+    constexpr offset_vector() {}  // NOLINT
+    offset_vector(const offset_vector &) = default;
+    offset_vector &operator=(const offset_vector &) = default;
+    ~offset_vector() = default;
+
+    //! Items
+    size_type size() const noexcept { return (size_type) _size; }
+    //! Items which can be stored without allocating
+    size_type capacity() const noexcept { return (size_type) _capacity; }
+    //! True if empty
+    bool empty() const noexcept { return _size == 0; }
+    //! The items
+    value_type *data() noexcept { return _begin.get(); }
+    //! \overload
+    const value_type *data() const noexcept { return _begin.get(); }
+    //! The first item
+    iterator begin() noexcept { return data(); }
+    //! \overload
+    const_iterator begin() const noexcept { return data(); }
+    //! After the last item
+    iterator end() noexcept { return data() + _size; }
+    //! \overload
+    const_iterator end() const noexcept { return data() + _size; }
+    //! The `n`th item
+    reference operator[](size_type n) noexcept { return data()[n]; }
+    //! \overload
+    const_reference operator[](size_type n) const noexcept { return data()[n]; }
+    //! The first item
+    reference front() noexcept { return data()[0]; }
+    //! \overload
+    const_reference front() const noexcept { return data()[0]; }
+    //! The last item
+    reference back() noexcept { return data()[_size - 1]; }
+    //! \overload
+    const_reference back() const noexcept { return data()[_size - 1]; }
+
+    //! Ensures storage for at least `n` items, returning this vector at its location after any remap.
+    offset_vector &reserve(mapped_arena &arena, size_type n) { return (n > _capacity) ? *_grow(arena, n) : *this; }
+    /*! \brief Appends an item constructed by `arena_constructor<T>` from `v`, returning the item at its
+    location after any remap.
+    */
+    template <class U> reference push_back(mapped_arena &arena, const U &v)
+    {
+      offset_vector *me = this;
+      const U *pv = &v;
+      if(_size == _capacity)
+      {
+        // v may be within this vector's storage, or anywhere else in the arena
+        const bool inarena = arena.contains(pv);
+        const auto vo = inarena ? arena.offset_of(pv) : 0;
+        me = _grow(arena, (size_type) _size + 1);
+        if(inarena)
+        {
+          pv = arena.pointer_to<const U>(vo);
+        }
+      }
+      const auto idx = me->_size++;
+      return *arena_constructor<value_type>::construct(arena, me->data() + idx, *pv);
+    }
+    //! Resizes to `n` items, value initialising any new items, returning this vector at its location after any remap.
+    offset_vector &resize(mapped_arena &arena, size_type n)
+    {
+      offset_vector *me = (n > _capacity) ? _grow(arena, n) : this;
+      for(size_type i = (size_type) me->_size; i < n; i++)
+      {
+        new(me->data() + i) value_type();
+      }
+      me->_size = n;
+      return *me;
+    }
+    //! Removes the last item. Its storage is not released.
+    void pop_back() noexcept
+    {
+      assert(_size > 0);
+      --_size;
+    }
+    //! Removes all items. Their storage is not released.
+    void clear() noexcept { _size = 0; }
+  };
+
+  /*! \class offset_string
+  \brief A string within a `mapped_arena`, which remains valid wherever the arena is mapped.
+
+  The characters are always zero terminated. See `offset_vector<T>` for the rules of functions
+  which allocate. Copying the string copies a reference to its characters, not the characters.
+  */
+  class offset_string
+  {
+    offset_vector<char> _chars;  // including the zero terminator if not empty
+
+  public:
+    //! Constructs an empty string. Its storage is allocated within the arena containing it.
+    constexpr offset_string() {}  // NOLINT
+
+    //! Characters, excluding the terminator
+    size_t size() const noexcept { return _chars.empty() ? 0 : _chars.size() - 1; }
+    //! True if empty
+    bool empty() const noexcept { return _chars.size() <= 1; }
+    //! The zero terminated characters
+    const char *c_str() const noexcept { return _chars.empty() ? "" : _chars.data(); }
+    //! \overload
+    const char *data() const noexcept { return c_str(); }
+    //! The characters as a view
+    string_view view() const noexcept { return {c_str(), size()}; }
+    //! The characters as a view
+    operator string_view() const noexcept { return view(); }  // NOLINT
+
+    /*! \brief Replaces the characters with those of `v`, which may be in the arena, returning this string
+    at its location after any remap.
+    */
+    offset_string &assign(mapped_arena &arena, string_view v)
+    {
+      offset_string *me = this;
+      const char *s = v.data();
+      if(v.size() + 1 > _chars.capacity())
+      {
+        const bool inarena = !v.empty() && arena.contains(s);
+        const auto so = inarena ? arena.offset_of(s) : 0;
+        const auto self = arena.offset_of(this);
+        // Discard the existing characters, so growing does not copy them
+        _chars.clear();
+        _chars.reserve(arena, v.size() + 1);
+        me = arena.pointer_to<offset_string>(self);
+        if(inarena)
+        {
+          s = arena.pointer_to<const char>(so);
+        }
+      }
+      char *d = me->_chars.data();
+      if(!v.empty())
+      {
+        memmove(d, s, v.size());
+      }
+      d[v.size()] = 0;
+      me->_chars._size = v.size() + 1;
+      return *me;
+    }
+    //! \overload
+    offset_string &assign(mapped_arena &arena, const offset_string &v) { return assign(arena, v.view()); }
+
+    //! True if the characters are equal
+    friend bool operator==(const offset_string &a, string_view b) noexcept { return a.view() == b; }
+    //! \overload
+    friend bool operator==(string_view a, const offset_string &b) noexcept { return a == b.view(); }
+    //! \overload
+    friend bool operator==(const offset_string &a, const offset_string &b) noexcept { return a.view() == b.view(); }
+    //! True if the characters differ
+    friend bool operator!=(const offset_string &a, string_view b) noexcept { return a.view() != b; }
+    //! \overload
+    friend bool operator!=(string_view a, const offset_string &b) noexcept { return a != b.view(); }
+    //! \overload
+    friend bool operator!=(const offset_string &a, const offset_string &b) noexcept { return a.view() != b.view(); }
+  };
+
+  template <> struct arena_constructor<offset_string>
+  {
+    template <class U> static offset_string *construct(mapped_arena &arena, offset_string *where, const U &v)
+    {
+      new(where) offset_string;
+      return &where->assign(arena, string_view(v));
+    }
+  };
+
+  //! A transparent hasher of `offset_string` and of anything convertible to `string_view`.
+  struct offset_string_hash
+  {
+    using is_transparent = void;
+    size_t operator()(string_view v) const noexcept { return std::hash<string_view>()(v); }
+  };
+
+  /*! \class offset_hash_map
+  \brief An open addressed hash map from `K` to `V` within a `mapped_arena`, which remains valid wherever
+  the arena is mapped.
+
+  Lookups need not construct a `K`, as they hash and compare anything `Hash` and `KeyEqual` accept.
+  For `offset_string` keys, use `offset_string_hash` as `Hash` to look up by `string_view`. Keys
+  and values are constructed by `arena_constructor<T>`. See `offset_vector<T>` for the rules of
+  functions which allocate. Note that `Hash` must hash identically in every program opening the
+  arena, so `std::hash` of types other than integers is best avoided for arenas shared between builds.
+  */
+  template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<>> class offset_hash_map
+  {
+    static_assert(std::is_trivially_destructible<K>::value && std::is_trivially_destructible<V>::value, "offset_hash_map: objects within the arena are never destructed!");
+
+  public:
+    //! Key type
+    using key_type = K;
+    //! Mapped type
+    using mapped_type = V;
+    //! Size type
+    using size_type = size_t;
+    //! The type of an item, with the key as `first` and the value as `second`
+    struct value_type
+    {
+      uint8_t _state;  // zero for empty, one for live, two for erased
+      K first;
+      V second;
+    };
+
+    //! Iterates the items, in no particular order
+    template <class S> class iterator_impl
+    {
+      friend class offset_hash_map;
+      S *_p{nullptr}, *_end{nullptr};
+      iterator_impl(S *p, S *end) noexcept
+          : _p(p)
+          , _end(end)
+      {
+        _skip();
+      }
+      void _skip() noexcept
+      {
+        while(_p != _end && _p->_state != 1)
+        {
+          ++_p;
+        }
+      }
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = S;
+      using difference_type = std::ptrdiff_t;
+      using pointer = S *;
+      using reference = S &;
+
+      constexpr iterator_impl() {}  // NOLINT
+      S &operator*() const noexcept { return *_p; }
+      S *operator->() const noexcept { return _p; }
+      iterator_impl &operator++() noexcept
+      {
+        ++_p;
+        _skip();
+        return *this;
+      }
+      iterator_impl operator++(int) noexcept
+      {
+        iterator_impl ret(*this);
+        ++*this;
+        return ret;
+      }
+      bool operator==(const iterator_impl &o) const noexcept { return _p == o._p; }
+      bool operator!=(const iterator_impl &o) const noexcept { return _p != o._p; }
+    };
+    //! Iterator type
+    using iterator = iterator_impl<value_type>;
+    //! Const iterator type
+    using const_iterator = iterator_impl<const value_type>;
+
+  private:
+    offset_ptr<value_type> _slots;
+    uint64_t _size{0}, _erased{0}, _capacity{0};  // capacity is zero or a power of two
+
+    template <class Q> value_type *_find(const Q &key, size_t h) const noexcept
+    {
+      if(_capacity == 0)
+      {
+        return nullptr;
+      }
+      const size_t mask = (size_t) _capacity - 1;
+      value_type *slots = _slots.get();
+      for(size_t i = h & mask;; i = (i + 1) & mask)
+      {
+        value_type &s = slots[i];
+        if(s._state == 0)
+        {
+          return nullptr;
+        }
+        if(s._state == 1 && KeyEqual()(s.first, key))
+        {
+          return &s;
+        }
+      }
+    }
+    // Rehashes into storage for `newcapacity` slots, returning this map wherever it now is
+    offset_hash_map *_rehash(mapped_arena &arena, size_type newcapacity)
+    {
+      const auto self = arena.offset_of(this);
+      auto *mem = static_cast<value_type *>(arena.allocate(newcapacity * sizeof(value_type), alignof(value_type)));
+      auto *me = arena.pointer_to<offset_hash_map>(self);
+      for(size_type n = 0; n < newcapacity; n++)
+      {
+        mem[n]._state = 0;
+      }
+      const size_t mask = newcapacity - 1;
+      value_type *old = me->_slots.get();
+      for(size_type n = 0; n < me->_capacity; n++)
+      {
+        if(old[n]._state == 1)
+        {
+          size_t i = Hash()(old[n].first) & mask;
+          while(mem[i]._state != 0)
+          {
+            i = (i + 1) & mask;
+          }
+          mem[i]._state = 1;
+          // Copy construction adjusts any offset pointers within
+          new(&mem[i].first) K(old[n].first);
+          new(&mem[i].second) V(old[n].second);
+        }
+      }
+      me->_slots = mem;
+      me->_capacity = newcapacity;
+      me->_erased = 0;
+      return me;
+    }
+
+  public:
+    //! Constructs an empty map. Its storage is allocated within the arena containing it.
+    constexpr offset_hash_map() {}  // NOLINT
+
+    //! Items
+    size_type size() const noexcept { return (size_type) _size; }
+    //! True if empty
+    bool empty() const noexcept { return _size == 0; }
+    //! The first item
+    iterator begin() noexcept { return iterator(_slots.get(), _slots.get() + _capacity); }
+    //! \overload
+    const_iterator begin() const noexcept { return const_iterator(_slots.get(), _slots.get() + _capacity); }
+    //! After the last item
+    iterator end() noexcept { return iterator(_slots.get() + _capacity, _slots.get() + _capacity); }
+    //! \overload
+    const_iterator end() const noexcept { return const_iterator(_slots.get() + _capacity, _slots.get() + _capacity); }
+
+    //! The value for `key`, or null if none.
+    template <class Q> V *find(const Q &key) noexcept
+    {
+      auto *s = _find(key, Hash()(key));
+      return (s != nullptr) ? &s->second : nullptr;
+    }
+    //! \overload
+    template <class Q> const V *find(const Q &key) const noexcept
+    {
+      auto *s = _find(key, Hash()(key));
+      return (s != nullptr) ? &s->second : nullptr;
+    }
+    //! True if there is a value for `key`.
+    template <class Q> bool contains(const Q &key) const noexcept { return find(key) != nullptr; }
+
+    /*! \brief Inserts `value` for `key` if there is no value for `key`, returning the value for `key`
+    at its location after any remap, and whether it was inserted.
+    */
+    template <class Q, class U> std::pair<V *, bool> insert(mapped_arena &arena, const Q &key, const U &value)
+    {
+      const size_t h = Hash()(key);
+      if(auto *s = _find(key, h))
+      {
+        return {&s->second, false};
+      }
+      offset_hash_map *me = this;
+      const Q *pk = &key;
+      const U *pv = &value;
+      // Keep at most three quarters of slots non-empty
+      if((_size + _erased + 1) * 4 > _capacity * 3)
+      {
+        const bool kinarena = arena.contains(pk), vinarena = arena.contains(pv);
+        const auto ko = kinarena ? arena.offset_of(pk) : 0, vo = vinarena ? arena.offset_of(pv) : 0;
+        me = _rehash(arena, (_capacity == 0) ? 16 : ((_size + 1) * 2 > _capacity) ? (size_type) _capacity * 2 : (size_type) _capacity);
+        if(kinarena)
+        {
+          pk = arena.pointer_to<const Q>(ko);
+        }
+        if(vinarena)
+        {
+          pv = arena.pointer_to<const U>(vo);
+        }
+      }
+      const size_t mask = (size_t) me->_capacity - 1;
+      size_t i = h & mask;
+      while(me->_slots[i]._state == 1)
+      {
+        i = (i + 1) & mask;
+      }
+      if(me->_slots[i]._state == 2)
+      {
+        me->_erased--;
+      }
+      me->_size++;
+      // Constructing the key and value may allocate, so track the slot and the value by offset
+      const auto slot = arena.offset_of(&me->_slots[i]);
+      const bool vinarena = arena.contains(pv);
+      const auto vo = vinarena ? arena.offset_of(pv) : 0;
+      me->_slots[i]._state = 1;
+      arena_constructor<K>::construct(arena, &me->_slots[i].first, *pk);
+      auto *s = arena.pointer_to<value_type>(slot);
+      if(vinarena)
+      {
+        pv = arena.pointer_to<const U>(vo);
+      }
+      arena_constructor<V>::construct(arena, &s->second, *pv);
+      s = arena.pointer_to<value_type>(slot);
+      return {&s->second, true};
+    }
+    //! Removes the value for `key`, returning true if there was one. Its storage is not released.
+    template <class Q> bool erase(const Q &key) noexcept
+    {
+      auto *s = _find(key, Hash()(key));
+      if(s == nullptr)
+      {
+        return false;
+      }
+      s->_state = 2;
+      _size--;
+      _erased++;
+      return true;
+    }
+    //! Removes all items. Their storage is not released.
+    void clear() noexcept
+    {
+      for(size_type n = 0; n < _capacity; n++)
+      {
+        _slots[n]._state = 0;
+      }
+      _size = _erased = 0;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -0,0 +1,416 @@
+/* A compact table of interned paths within a directory tree
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_ALGORITHM_PATH_TABLE_HPP
+#define LLFIO_ALGORITHM_PATH_TABLE_HPP
+
+#include "../directory_handle.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+//! \file path_table.hpp Provides a compact table of interned paths within a directory tree.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief Returns the path of `dirh` relative to `rootdirh`, race free to concurrent relocations
+  of `rootdirh`.
+
+  `rootdirpathlen` must initially be the length of the current path of `rootdirh` plus one. If
+  `rootdirh` is found to have been relocated, it is updated. This is how `contents()` determines
+  the relative path of each directory it enumerates, and the path returned is empty for `rootdirh`
+  itself.
+  */
+  inline result<filesystem::path> relative_directory_path(const path_handle &rootdirh, std::atomic<size_t> &rootdirpathlen, const directory_handle &dirh) noexcept
+  {
+    try
+    {
+      filesystem::path dirhpath;
+      for(;;)
+      {
+        OUTCOME_TRY(dirhpath, dirh.current_path());
+        auto _rootdirpathlen = rootdirpathlen.load(std::memory_order_relaxed);
+        if(dirhpath.native().size() <= _rootdirpathlen)
+        {
+          // This is the root directory, whose contents have paths relative to itself
+          dirhpath.clear();
+          return {std::move(dirhpath)};
+        }
+        dirhpath = dirhpath.native().substr(_rootdirpathlen);
+        auto r = directory_handle::directory(rootdirh, dirhpath);
+        if(r && r.value().unique_id() == dirh.unique_id())
+        {
+          return {std::move(dirhpath)};
+        }
+        OUTCOME_TRY(dirhpath, rootdirh.current_path());
+        rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+      }
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  /*! \brief A compact table of interned paths within a directory tree, each stored as the id of
+  its parent plus its leafname.
+
+  Storing the full path of every item in a large directory tree as its own `filesystem::path`
+  is very expensive, as every path repeats all of its ancestors. Here each leafname is stored
+  once, zero terminated and in the native encoding, in large chunks allocated as needed, and an
+  item costs twenty four bytes plus its leafname plus a slot in the open addressed hash table
+  deduplicating items. The hash of every path is computed during interning, so comparing and
+  hashing paths, for example when diffing trees, is very cheap. Ids are dense, starting from
+  `root`, which is the empty path, and are never invalidated until `clear()`.
+
+  Interning is thread safe. The other member functions may be used concurrently with one another,
+  but not with interning.
+  */
+  class path_table
+  {
+  public:
+    //! The type of the id of an interned path
+    using id_type = uint32_t;
+    //! The type of the characters stored
+    using value_type = filesystem::path::value_type;
+    //! The id of the empty path, which is the root of the tree
+    static constexpr id_type root = 0;
+
+  private:
+    struct _entry_type
+    {
+      id_type parent;
+      uint32_t length;
+      const value_type *leaf;
+      uint64_t hash;
+    };
+    static constexpr size_t _chunk_size = 65536;  // in characters
+
+    mutable spinlock _lock;
+    std::vector<_entry_type> _entries;
+    std::vector<id_type> _buckets;  // root marks an empty slot, as it is never interned
+    std::vector<std::unique_ptr<value_type[]>> _chunks;
+    value_type *_next{nullptr};
+    size_t _remaining{0}, _chunk_bytes{0};
+
+    static uint64_t _combine(uint64_t parent, uint64_t leaf) noexcept { return (((parent << 5) | (parent >> 59)) ^ leaf) * 0x9E3779B97F4A7C15ULL; }
+    size_t _slot(uint64_t hash) const noexcept { return static_cast<size_t>((hash >> 32) ^ hash) & (_buckets.size() - 1); }
+    void _rehash()
+    {
+      std::vector<id_type> buckets(_buckets.size() * 2, root);
+      _buckets.swap(buckets);
+      for(id_type id = 1; id < _entries.size(); id++)
+      {
+        size_t i = _slot(_entries[id].hash);
+        while(_buckets[i] != root)
+        {
+          i = (i + 1) & (_buckets.size() - 1);
+        }
+        _buckets[i] = id;
+      }
+    }
+    // Returns the id of the leaf, and the slot where it would be inserted if it was not found
+    std::pair<id_type, size_t> _find(id_type parent, const value_type *leaf, size_t length, uint64_t hash) const noexcept
+    {
+      for(size_t i = _slot(hash);; i = (i + 1) & (_buckets.size() - 1))
+      {
+        const id_type id = _buckets[i];
+        if(id == root)
+        {
+          return {root, i};
+        }
+        const auto &e = _entries[id];
+        if(e.hash == hash && e.parent == parent && e.length == length && 0 == memcmp(e.leaf, leaf, length * sizeof(value_type)))
+        {
+          return {id, i};
+        }
+      }
+    }
+    // The caller must hold the lock. May throw.
+    result<id_type> _intern(id_type parent, path_view_component leaf)
+    {
+      if(parent >= _entries.size())
+      {
+        return errc::invalid_argument;
+      }
+      path_view_component::c_str<value_type> zleaf(leaf, path_view_component::not_zero_terminated);
+      const auto length = zleaf.length;
+      const auto hash = _combine(_entries[parent].hash, path_view_component(zleaf.buffer, length, path_view_component::not_zero_terminated).hash());
+      auto found = _find(parent, zleaf.buffer, length, hash);
+      if(found.first != root)
+      {
+        return found.first;
+      }
+      if(_entries.size() > (std::numeric_limits<id_type>::max)() || length > (std::numeric_limits<uint32_t>::max)())
+      {
+        return errc::value_too_large;
+      }
+      if(_remaining < length + 1)
+      {
+        const size_t chunk = (std::max)(_chunk_size, length + 1);
+        _chunks.push_back(std::unique_ptr<value_type[]>(new value_type[chunk]));
+        _next = _chunks.back().get();
+        _remaining = chunk;
+        _chunk_bytes += chunk * sizeof(value_type);
+      }
+      memcpy(_next, zleaf.buffer, length * sizeof(value_type));
+      _next[length] = 0;
+      const auto id = static_cast<id_type>(_entries.size());
+      _entries.push_back(_entry_type{parent, static_cast<uint32_t>(length), _next, hash});
+      _next += length + 1;
+      _remaining -= length + 1;
+      _buckets[found.second] = id;
+      // Keep the hash table no more than three quarters full
+      if(_entries.size() * 4 > _buckets.size() * 3)
+      {
+        _rehash();
+      }
+      return id;
+    }
+
+  public:
+    //! Default constructor, containing only `root`
+    path_table()
+        : _entries{_entry_type{root, 0, nullptr, 0}}
+        , _buckets(1024, root)
+    {
+    }
+    //! Move constructor
+    path_table(path_table &&o) noexcept
+        : _entries(std::move(o._entries))
+        , _buckets(std::move(o._buckets))
+        , _chunks(std::move(o._chunks))
+        , _next(o._next)
+        , _remaining(o._remaining)
+        , _chunk_bytes(o._chunk_bytes)
+    {
+      o._next = nullptr;
+      o._remaining = o._chunk_bytes = 0;
+    }
+    //! Move assignment
+    path_table &operator=(path_table &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~path_table();
+      new(this) path_table(std::move(o));
+      return *this;
+    }
+    path_table(const path_table &) = delete;
+    path_table &operator=(const path_table &) = delete;
+    ~path_table() = default;
+
+    //! The number of paths in the table, including `root`
+    size_t size() const noexcept { return _entries.size(); }
+    //! The bytes of memory used by the table
+    size_t memory_usage() const noexcept { return _entries.capacity() * sizeof(_entry_type) + _buckets.capacity() * sizeof(id_type) + _chunk_bytes; }
+    //! Discards all paths except `root`, invalidating all ids
+    void clear() noexcept
+    {
+      lock_guard<spinlock> g(_lock);
+      _entries.resize(1);
+      std::fill(_buckets.begin(), _buckets.end(), root);
+      _chunks.clear();
+      _next = nullptr;
+      _remaining = _chunk_bytes = 0;
+    }
+
+    //! The id of the parent of the path `id`. The parent of `root` is `root`.
+    id_type parent(id_type id) const noexcept { return _entries[id].parent; }
+    //! The leafname of the path `id`, empty for `root`. This is always zero terminated.
+    path_view_component leaf(id_type id) const noexcept
+    {
+      const auto &e = _entries[id];
+      return (e.leaf == nullptr) ? path_view_component() : path_view_component(e.leaf, e.length, path_view_component::zero_terminated);
+    }
+    //! The hash of the whole path `id`, which is a combination of the hashes of its leafname and its parent
+    uint64_t hash(id_type id) const noexcept { return _entries[id].hash; }
+    //! The number of components in the path `id`, zero for `root`.
+    size_t depth(id_type id) const noexcept
+    {
+      size_t ret = 0;
+      for(; id != root; id = _entries[id].parent)
+      {
+        ret++;
+      }
+      return ret;
+    }
+
+    //! Returns the path `id`, relative to the root of the tree.
+    result<filesystem::path> path(id_type id) const noexcept
+    {
+      try
+      {
+        id_type ids[64];
+        std::vector<id_type> deep;
+        size_t count = 0;
+        for(; id != root; id = _entries[id].parent)
+        {
+          if(count < 64)
+          {
+            ids[count] = id;
+          }
+          else
+          {
+            deep.push_back(id);
+          }
+          count++;
+        }
+        filesystem::path::string_type ret;
+        for(size_t n = count; n > 0; n--)
+        {
+          const auto &e = _entries[(n > 64) ? deep[n - 65] : ids[n - 1]];
+          if(!ret.empty())
+          {
+            ret.push_back(filesystem::path::preferred_separator);
+          }
+          ret.append(e.leaf, e.length);
+        }
+        return filesystem::path(std::move(ret));
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Returns the id of the leafname `leaf` within the directory `parent`.
+    \errors `errc::no_such_file_or_directory` if it has not been interned.
+    */
+    result<id_type> find(id_type parent, path_view_component leaf) const noexcept
+    {
+      try
+      {
+        if(parent >= _entries.size())
+        {
+          return errc::invalid_argument;
+        }
+        path_view_component::c_str<value_type> zleaf(leaf, path_view_component::not_zero_terminated);
+        const auto hash = _combine(_entries[parent].hash, path_view_component(zleaf.buffer, zleaf.length, path_view_component::not_zero_terminated).hash());
+        lock_guard<spinlock> g(_lock);
+        const auto id = _find(parent, zleaf.buffer, zleaf.length, hash).first;
+        if(id == root)
+        {
+          return errc::no_such_file_or_directory;
+        }
+        return id;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    /*! \brief Returns the id of the path `relpath`, relative to the root of the tree.
+    \errors `errc::no_such_file_or_directory` if it has not been interned.
+    */
+    result<id_type> find(path_view relpath) const noexcept
+    {
+      id_type id = root;
+      for(auto i : relpath)
+      {
+        if(!i.empty())
+        {
+          OUTCOME_TRY(id, find(id, i));
+        }
+      }
+      return id;
+    }
+
+    /*! \brief Interns the leafname `leaf` within the directory `parent`, returning its id.
+    Interning something already interned returns the id it was given the first time.
+    \errors `errc::invalid_argument` if `parent` is not an id in this table. `errc::value_too_large` if
+    the table is full. Any failure to reencode `leaf` to the native encoding.
+    */
+    result<id_type> intern(id_type parent, path_view_component leaf) noexcept
+    {
+      try
+      {
+        lock_guard<spinlock> g(_lock);
+        return _intern(parent, leaf);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    //! \overload Interns every component of `relpath`, relative to the root of the tree, returning the id of the last.
+    result<id_type> intern(path_view relpath) noexcept
+    {
+      try
+      {
+        lock_guard<spinlock> g(_lock);
+        id_type id = root;
+        for(auto i : relpath)
+        {
+          if(!i.empty())
+          {
+            OUTCOME_TRY(id, _intern(id, i));
+          }
+        }
+        return id;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    /*! \overload Interns the leafnames of all of `entries` within the directory `parent`, writing
+    their ids into `ids`, which must be at least as long. The lock is taken once for all of them.
+    */
+    result<void> intern(id_type parent, span<const directory_entry> entries, span<id_type> ids) noexcept
+    {
+      try
+      {
+        if(ids.size() < entries.size())
+        {
+          return errc::invalid_argument;
+        }
+        lock_guard<spinlock> g(_lock);
+        for(size_t n = 0; n < entries.size(); n++)
+        {
+          OUTCOME_TRY(auto &&id, _intern(parent, entries[n].leafname));
+          ids[n] = id;
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
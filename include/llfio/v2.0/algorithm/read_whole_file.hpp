@@ -0,0 +1,185 @@
+/* An adaptive reader of the whole contents of a file
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_READ_WHOLE_FILE_HPP
+#define LLFIO_ALGORITHM_READ_WHOLE_FILE_HPP
+
+#include "../mapped_file_handle.hpp"
+
+//! \file read_whole_file.hpp Provides an adaptive reader of the whole contents of a file.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  //! How the contents of a file are read by `read_whole_file()`
+  enum class read_whole_file_method
+  {
+    automatic,  //!< Choose one of the below based on the size of the file and the storage it is upon
+    read,       //!< A single `read()` into a buffer from `utils::pooled_page_allocator`
+    map,        //!< A read only map of the file
+    chunked     //!< Many concurrent reads of chunks into a buffer, via an i/o multiplexer
+  };
+
+  //! Options for `read_whole_file()`
+  struct read_whole_file_options
+  {
+    //! How to read the file
+    read_whole_file_method method{read_whole_file_method::automatic};
+    //! Files at least this large are mapped on low latency storage, zero means four times `utils::file_buffer_default_size()`
+    file_handle::extent_type map_threshold{0};
+    //! The size of each chunk read concurrently, zero means `utils::file_buffer_default_size()`
+    size_t chunk_size{0};
+    //! The maximum number of chunks being read at any one time
+    size_t chunks_in_flight{8};
+    //! The i/o multiplexer with which to read chunks, without which chunked reads are not possible
+    io_multiplexer *multiplexer{nullptr};
+    //! The mean nanoseconds for a read at queue depth one at or above which storage is considered high latency, zero if unknown
+    unsigned long long read_latency{0};
+
+    /*! \brief Fills `chunk_size` and `read_latency` from a `storage_profile::storage_profile` previously
+    profiled or loaded for the storage upon which the files to be read reside.
+    */
+    template <class StorageProfile> read_whole_file_options &use_profile(const StorageProfile &sp) noexcept
+    {
+      if(sp.controller_max_transfer.value != 0 && sp.controller_max_transfer.value != (unsigned) -1)
+      {
+        chunk_size = sp.controller_max_transfer.value;
+      }
+      read_latency = sp.read_qd1_mean.value;
+      return *this;
+    }
+  };
+
+  class whole_file_contents;
+  /*! \brief Reads the whole contents of the existing file at `path` relative to `base`,
+  choosing the fastest method of doing so for that file.
+
+  \return The contents of the file, which owns the memory they occupy.
+  \param base The base to lookup `path` within.
+  \param path The path of the file to read.
+  \param options How to read the file.
+  \param d A deadline by which reads of the file must complete.
+
+  With `read_whole_file_method::automatic`, the method is chosen as follows:
+
+  1. Files no larger than `chunk_size` are read with a single `read()` into a buffer from
+  `utils::pooled_page_allocator`, which for the small files which are the majority of files
+  costs no more than the open, the `read()` and the close.
+  2. Otherwise, if the file is upon high latency storage, and `multiplexer` is set, `chunks_in_flight`
+  reads of `chunk_size` are kept in flight at any one time into a buffer of the whole file.
+  High latency storage is a network filing system as determined from `statfs_t::f_fstypename`,
+  or storage whose `read_latency` is at least a quarter of a millisecond. As a read on such
+  storage is mostly latency, many reads in flight complete in a fraction of the time that
+  a single read would, or than faulting in a map of the file would. If `multiplexer` is not
+  set, a single `read()` is used instead.
+  3. Otherwise, files at least `map_threshold` in size are mapped, so their contents are the
+  kernel's page cache without any copying.
+  4. Otherwise, a single `read()` is used.
+
+  If mapping the file fails, perhaps due to address space exhaustion, it is read instead. The
+  contents are those of the file as of when it was opened. If the file shrinks whilst being read,
+  the contents are truncated to what could be read, and growth after opening is ignored.
+
+  \errors Any of the values `file_handle::file()`, `file_handle::read()` and `mapped_file_handle::reserve()`
+  can return, `errc::invalid_argument` if `chunked` is requested without a multiplexer, `errc::timed_out`
+  if `d` expires.
+  \mallocs One, of the size of the file, unless it is mapped. Chunked reads also allocate their i/o states
+  from the multiplexer's pool.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<whole_file_contents> read_whole_file(const path_handle &base, path_view path, const read_whole_file_options &options = {},
+                                                                           deadline d = {}) noexcept;
+
+  /*! \brief The contents of a file read by `read_whole_file()`, which owns the memory they
+  occupy. Move only.
+  */
+  class LLFIO_DECL whole_file_contents
+  {
+    friend result<whole_file_contents> read_whole_file(const path_handle &base, path_view path, const read_whole_file_options &options, deadline d) noexcept;
+
+    read_whole_file_method _method{read_whole_file_method::read};
+    byte *_buffer{nullptr};
+    size_t _buffer_size{0};
+    mapped_file_handle _mh;
+    span<const byte> _bytes;
+
+  public:
+    //! Default constructor, which is empty
+    whole_file_contents() = default;
+    //! Move constructor
+    whole_file_contents(whole_file_contents &&o) noexcept
+        : _method(o._method)
+        , _buffer(o._buffer)
+        , _buffer_size(o._buffer_size)
+        , _mh(std::move(o._mh))
+        , _bytes(o._bytes)
+    {
+      o._buffer = nullptr;
+      o._buffer_size = 0;
+      o._bytes = {};
+    }
+    whole_file_contents(const whole_file_contents &) = delete;
+    //! Move assignment
+    whole_file_contents &operator=(whole_file_contents &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      this->~whole_file_contents();
+      new(this) whole_file_contents(std::move(o));
+      return *this;
+    }
+    whole_file_contents &operator=(const whole_file_contents &) = delete;
+    ~whole_file_contents()
+    {
+      if(_buffer != nullptr)
+      {
+        utils::pooled_page_allocator<byte>().deallocate(_buffer, _buffer_size);
+      }
+    }
+
+    //! How the contents were read
+    read_whole_file_method method() const noexcept { return _method; }
+    //! The contents
+    span<const byte> bytes() const noexcept { return _bytes; }
+    //! The first byte of the contents
+    const byte *data() const noexcept { return _bytes.data(); }
+    //! The number of bytes of the contents
+    size_t size() const noexcept { return _bytes.size(); }
+    //! True if there are no contents
+    bool empty() const noexcept { return _bytes.empty(); }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "../detail/impl/read_whole_file.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
@@ -27,6 +27,8 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "traverse.hpp"
 
+#include <future>
+
 //! \file reduce.hpp Provides a directory tree reduction algorithm.
 
 LLFIO_V2_NAMESPACE_BEGIN
@@ -158,10 +160,36 @@ namespace algorithm
   to the (likely renamed) directory you passed in. You might do something like try to rename
   it into `storage_backed_temporary_files_directory()`, or some other hail mary action.
 
+  If `multiplexer` is not null, on POSIX the items within each directory enumerated are
+  unlinked as a single batch using `io_multiplexer::do_posix_fs_syscalls()`, which for the
+  Linux io_uring multiplexer means at high queue depth using `IORING_OP_UNLINKAT` on Linux 5.11
+  and later. It is also passed to `traverse()` for batching the opening of directories.
+  If `threads` is not one, it must be a multiplexer usable by many kernel threads. Batched
+  unlinking is considerably faster for very wide directory trees on storage with high latency,
+  such as networked filesystems or fast NVMe which needs high queue depth to perform.
+
   You should review the documentation for `algorithm::traverse()`, as this algorithm is
   entirely implemented using that algorithm.
   */
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reduce(directory_handle &&dirh, reduce_visitor *visitor = nullptr, size_t threads = 0, bool force_slow_path = false) noexcept;
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reduce(directory_handle &&dirh, reduce_visitor *visitor = nullptr, size_t threads = 0, bool force_slow_path = false,
+                                                     io_multiplexer *multiplexer = nullptr) noexcept;
+
+  /*! \brief Reduce the directory identified `dirh`, and everything therein, to the null set
+  asynchronously.
+
+  The directory is renamed to a uniquely named directory before this function returns, so
+  as far as concurrent users are concerned the directory tree is gone immediately, and then
+  `reduce()` is executed by a newly launched kernel thread, whose result is returned by the
+  future. `dirh` is always moved into the function, and `visitor` and `multiplexer` must
+  remain valid until the future becomes ready. If the reduction fails,
+  the uniquely named directory is left behind.
+
+  This is useful for purging very large directory trees without delaying whatever needs the
+  name of the directory tree next, with the actual removal occurring in the background.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::future<result<size_t>>> reduce_deferred(directory_handle &&dirh, reduce_visitor *visitor = nullptr,
+                                                                                   size_t threads = 0, bool force_slow_path = false,
+                                                                                   io_multiplexer *multiplexer = nullptr) noexcept;
 
 }  // namespace algorithm
 
@@ -66,6 +66,8 @@ namespace algorithm
       static_assert(sizeof(header) == 128, "header structure is not 128 bytes long!");
       static_assert(std::is_trivially_copyable<header>::value, "header structure is not trivially copyable");
 
+      // Lock requests of more than twelve entities are written as consecutive records
+      // sharing the same unique_id and us_count
       struct alignas(16) lock_request
       {
         uint128 hash;                               // Hash of remaining 112 bytes
@@ -100,19 +102,25 @@ namespace algorithm
 
     Caveats:
     - Much slower than byte_ranges for few waiters or small number of entities.
-    - Sudden process exit with locks held will deadlock all other users.
-    - Maximum of twelve entities may be locked concurrently.
-    - Wasteful of disk space if used on a non-extents based filing system (e.g. FAT32, ext3).
-    It is best used in `/tmp` if possible (`file_handle::temp_file()`). If you really must use a non-extents based filing
-    system, destroy and recreate the object instance periodically to force resetting the lock
-    file's length to zero.
+    - Lock requests abandoned by sudden process exit are detected by the byte range lock which every
+    lock request's owner holds upon it going away, and are completed on its behalf by the next locker
+    to be blocked by them. Filing systems without working byte range locks therefore cannot recover.
+    - Maximum of `max_entities` entities may be locked concurrently. Every twelve entities locked
+    adds another 128 byte record to the lock request, and each record is checked separately by
+    other lockers, so locking many entities costs proportionately more.
+    - The lock file's maximum extent grows forever, though every megabyte of completed lock requests
+    at its front is deallocated using `file_handle::zero()`, so its storage consumption stays constant
+    and the scan of preceding lock requests only ever starts from the first incomplete one.
+    - Wasteful of disk space if used on a non-extents based filing system (e.g. FAT32, ext3), as these
+    cannot deallocate regions of a file. It is best used in `/tmp` if possible (`file_handle::temp_file()`).
+    If you really must use a non-extents based filing system, destroy and recreate the object instance
+    periodically to force resetting the lock file's length to zero.
     - Similarly older operating systems (e.g. Linux < 3.0) do not implement extent hole punching
     and therefore will also see excessive disk space consumption. Note at the time of writing
     OS X doesn't implement hole punching at all.
     - If your OS doesn't have sane byte range locks (OS X, BSD, older Linuxes) and multiple
     objects in your process use the same lock file, misoperation will occur. Use lock_files instead.
 
-    \todo Implement hole punching once I port that code from LLFIO v1.
     \todo Decide on some resolution mechanism for sudden process exit.
     \todo There is a 1 out of 2^64-2 chance of unique id collision. It would be nice if we
     actually formally checked that our chosen unique id is actually unique.
@@ -173,6 +181,10 @@ namespace algorithm
       using entity_type = shared_fs_mutex::entity_type;
       //! The type of a sequence of entities
       using entities_type = shared_fs_mutex::entities_type;
+      //! The maximum number of entities which can be locked at once
+      static constexpr size_t max_entities = 32 * 12;
+      //! How old a lock request whose owner does not hold a lock on it must be to be considered abandoned
+      static constexpr std::chrono::milliseconds stale_lock_request_age{10};
 
       //! No copy construction
       atomic_append(const atomic_append &) = delete;
@@ -252,11 +264,14 @@ namespace algorithm
       LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> _lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept final
       {
         LLFIO_LOG_FUNCTION_CALL(this);
-        atomic_append_detail::lock_request lock_request;
-        if(out.entities.size() > sizeof(lock_request.entities) / sizeof(lock_request.entities[0]))
+        static constexpr size_t entities_per_record = sizeof(atomic_append_detail::lock_request::entities) / sizeof(atomic_append_detail::lock_request::entities[0]);
+        if(out.entities.size() > max_entities)
         {
           return errc::argument_list_too_long;
         }
+        const size_t records = (out.entities.size() > entities_per_record) ? (out.entities.size() + entities_per_record - 1) / entities_per_record : 1;
+        alignas(64) atomic_append_detail::lock_request lock_requests[max_entities / entities_per_record];
+        atomic_append_detail::lock_request &lock_request = lock_requests[0];
 
         std::chrono::steady_clock::time_point began_steady;
         std::chrono::system_clock::time_point end_utc;
@@ -264,7 +279,7 @@ namespace algorithm
         {
           if((d).steady)
           {
-            began_steady = std::chrono::steady_clock::now();
+            began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
           }
           else
           {
@@ -274,16 +289,21 @@ namespace algorithm
         // Fire this if an error occurs
         auto disableunlock = make_scope_exit([&]() noexcept { out.release(); });
 
+      rewrite:
         // Write my lock request immediately
-        memset(&lock_request, 0, sizeof(lock_request));
-        lock_request.unique_id = _unique_id;
+        memset(lock_requests, 0, sizeof(lock_request) * records);
         auto count = std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(_header.time_offset);
-        lock_request.us_count = std::chrono::duration_cast<std::chrono::microseconds>(count).count();
-        lock_request.items = out.entities.size();
-        memcpy(lock_request.entities, out.entities.data(), sizeof(lock_request.entities[0]) * out.entities.size());
-        if(!_skip_hashing)
+        for(size_t n = 0; n < records; n++)
         {
-          lock_request.hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash((reinterpret_cast<char *>(&lock_request)) + 16, sizeof(lock_request) - 16);
+          const size_t first = n * entities_per_record, items = std::min(out.entities.size() - first, entities_per_record);
+          lock_requests[n].unique_id = _unique_id;
+          lock_requests[n].us_count = std::chrono::duration_cast<std::chrono::microseconds>(count).count();
+          lock_requests[n].items = items;
+          memcpy(lock_requests[n].entities, out.entities.data() + first, sizeof(lock_request.entities[0]) * items);
+          if(!_skip_hashing)
+          {
+            lock_requests[n].hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash((reinterpret_cast<char *>(&lock_requests[n])) + 16, sizeof(lock_request) - 16);
+          }
         }
         // My lock request will be the file's current length or higher
         OUTCOME_TRY(auto &&my_lock_request_offset, _h.maximum_extent());
@@ -299,7 +319,8 @@ namespace algorithm
             OUTCOME_TRY(auto &&append_guard_, _h.lock_file_range(my_lock_request_offset, lastbyte, lock_kind::exclusive));
             append_guard = std::move(append_guard_);
           }
-          OUTCOME_TRYV(_h.write(0, {{reinterpret_cast<byte *>(&lock_request), sizeof(lock_request)}}));
+          // All the records of my lock request are appended by a single write, so they are contiguous
+          OUTCOME_TRYV(_h.write(0, {{reinterpret_cast<byte *>(lock_requests), sizeof(lock_request) * records}}));
         }
 
         // Find the record I just wrote
@@ -319,13 +340,14 @@ namespace algorithm
             LLFIO_LOG_FATAL(this, "atomic_append::lock() saw an error when searching for just written data");
             std::terminate();
           }
+          auto is_mine = [&](const atomic_append_detail::lock_request *record) { return record->hash == lock_request.hash && record->unique_id == lock_request.unique_id && record->us_count == lock_request.us_count; };
           const atomic_append_detail::lock_request *record, *lastrecord;
-          for(record = reinterpret_cast<const atomic_append_detail::lock_request *>(readoutcome.value()[0].data()), lastrecord = reinterpret_cast<const atomic_append_detail::lock_request *>(readoutcome.value()[0].data() + readoutcome.value()[0].size()); record < lastrecord && record->hash != lock_request.hash;
+          for(record = reinterpret_cast<const atomic_append_detail::lock_request *>(readoutcome.value()[0].data()), lastrecord = reinterpret_cast<const atomic_append_detail::lock_request *>(readoutcome.value()[0].data() + readoutcome.value()[0].size()); record < lastrecord && !is_mine(record);
               ++record)
           {
             my_lock_request_offset += sizeof(atomic_append_detail::lock_request);
           }
-          if(record->hash == lock_request.hash)
+          if(record < lastrecord)
           {
             break;
           }
@@ -335,16 +357,29 @@ namespace algorithm
         out.hint = my_lock_request_offset;
         disableunlock.release();
 
-        // Lock my request for writing so others can sleep on me
+        // Lock my request for writing so others can sleep on me, and so they know I am
+        // alive. I hold this lock until unlock().
         file_handle::extent_guard my_request_guard;
-        if(!spin_not_sleep)
         {
           auto lock_offset = my_lock_request_offset;
           // Set the top bit to use the shadow lock space on Windows
           lock_offset |= (1ULL << 63U);
-          OUTCOME_TRY(auto &&my_request_guard_, _h.lock_file_range(lock_offset, sizeof(lock_request), lock_kind::exclusive));
+          OUTCOME_TRY(auto &&my_request_guard_, _h.lock_file_range(lock_offset, sizeof(lock_request) * records, lock_kind::exclusive));
           my_request_guard = std::move(my_request_guard_);
         }
+        // If I was slow to lock my request, somebody may have thought me dead and completed it
+        {
+          file_handle::buffer_type req{_buffer, sizeof(lock_request) * records};
+          OUTCOME_TRY(auto &&verify, _h.read({{&req, 1}, my_lock_request_offset}));
+          if(verify[0].size() != sizeof(lock_request) * records || 0 != memcmp(verify[0].data(), lock_requests, sizeof(lock_request) * records))
+          {
+            memset(_buffer, 0, sizeof(lock_request) * records);
+            OUTCOME_TRYV(_h.write(my_lock_request_offset, {{_buffer, sizeof(lock_request) * records}}));
+            my_request_guard.unlock();
+            _record_retry(out);
+            goto rewrite;
+          }
+        }
 
         // Read every record preceding mine until header.first_known_good inclusive
         auto record_offset = my_lock_request_offset - sizeof(atomic_append_detail::lock_request);
@@ -418,12 +453,40 @@ namespace algorithm
           continue;
 
         beginwait:
+          // If I can lock the record in our way, either its owner has just unlocked it, or
+          // has not yet locked it, or has exited without unlocking it. Once a record is older
+          // than any owner would take to lock it, it is assumed to be the latter and completed
+          // on the owner's behalf while holding the lock. Should the owner in fact be alive,
+          // it will notice once it locks its record, and write a new lock request.
+          {
+            auto lock_offset = record_offset;
+            // Set the top bit to use the shadow lock space on Windows
+            lock_offset |= (1ULL << 63U);
+            auto probe = _h.lock_file_range(lock_offset, sizeof(*record), lock_kind::shared, std::chrono::seconds(0));
+            if(probe)
+            {
+              auto now = std::chrono::system_clock::now() - std::chrono::system_clock::from_time_t(_header.time_offset);
+              auto age = std::chrono::duration_cast<std::chrono::microseconds>(now).count() - static_cast<int64_t>(record->us_count);
+              if(age > std::chrono::duration_cast<std::chrono::microseconds>(stale_lock_request_age).count())
+              {
+                atomic_append_detail::lock_request completed;
+                memset(&completed, 0, sizeof(completed));
+                OUTCOME_TRYV(_h.write(record_offset, {{reinterpret_cast<byte *>(&completed), sizeof(completed)}}));
+                goto reload;
+              }
+            }
+            else if(probe.error() != errc::timed_out)
+            {
+              return std::move(probe).error();
+            }
+          }
           // Sleep until this record is freed using a shared lock
           // on the record in our way. Note there is a race here
           // between when the lock requester writes the lock
           // request and when he takes an exclusive lock on it,
           // so if our shared lock succeeds we need to immediately
           // unlock and retry based on the data.
+          _record_sleep(out);
           std::this_thread::yield();
           if(!spin_not_sleep)
           {
@@ -432,7 +495,7 @@ namespace algorithm
             {
               if((d).steady)
               {
-                std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());
+                std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs));
                 if(ns.count() < 0)
                 {
                   (nd).nsecs = 0;
@@ -457,7 +520,7 @@ namespace algorithm
           {
             if((d).steady)
             {
-              if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
+              if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
               {
                 return errc::timed_out;
               }
@@ -471,13 +534,14 @@ namespace algorithm
             }
           }
         } while(record_offset >= _header.first_known_good);
+        // unlock() will release this
+        my_request_guard.release();
         return success();
       }
 
     public:
       LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock(entities_type entities, unsigned long long hint) noexcept final
       {
-        (void) entities;
         LLFIO_LOG_FUNCTION_CALL(this);
         if(hint == 0u)
         {
@@ -485,8 +549,12 @@ namespace algorithm
           return;
         }
         auto my_lock_request_offset = static_cast<file_handle::extent_type>(hint);
+        static constexpr size_t entities_per_record = sizeof(atomic_append_detail::lock_request::entities) / sizeof(atomic_append_detail::lock_request::entities[0]);
+        const size_t records = (entities.size() > entities_per_record) ? (entities.size() + entities_per_record - 1) / entities_per_record : 1;
+        const size_t my_lock_request_bytes = sizeof(atomic_append_detail::lock_request) * records;
         {
-          atomic_append_detail::lock_request record;
+          alignas(64) atomic_append_detail::lock_request lock_requests[max_entities / entities_per_record];
+          atomic_append_detail::lock_request &record = lock_requests[0];
 #ifdef _DEBUG
           (void) _h.read(my_lock_request_offset, {{(byte *) &record, sizeof(record)}});
           if(!record.unique_id)
@@ -501,12 +569,14 @@ namespace algorithm
             std::terminate();
           }
 #endif
-          memset(&record, 0, sizeof(record));
-          (void) _h.write(my_lock_request_offset, {{reinterpret_cast<byte *>(&record), sizeof(record)}});
+          memset(lock_requests, 0, my_lock_request_bytes);
+          (void) _h.write(my_lock_request_offset, {{reinterpret_cast<byte *>(lock_requests), my_lock_request_bytes}});
+          // Release the lock on my request taken by _lock(), waking anybody sleeping on it
+          _h.unlock_file_range(my_lock_request_offset | (1ULL << 63U), my_lock_request_bytes);
         }
 
         // Every 32 records or so, bump _header.first_known_good
-        if((my_lock_request_offset & 4095U) == 0U)
+        if(((my_lock_request_offset + 4095U) & ~static_cast<file_handle::extent_type>(4095U)) < my_lock_request_offset + my_lock_request_bytes)
         {
           //_read_header();
 
@@ -548,10 +618,12 @@ namespace algorithm
           if(_header.first_known_good - _header.first_after_hole_punch >= 1024U * 1024U)
           {
             handle::extent_type holepunchend = _header.first_known_good & ~(1024U * 1024U - 1);
-#ifdef _DEBUG
-            fprintf(stderr, "hole_punch(%llx, %llx)\n", _header.first_after_hole_punch, holepunchend - _header.first_after_hole_punch);
-#endif
-            _header.first_after_hole_punch = holepunchend;
+            // Only the completed lock requests before first_known_good are deallocated, so if this
+            // fails or cannot deallocate it merely writes zeros over zeros
+            if(_h.zero({_header.first_after_hole_punch, holepunchend - _header.first_after_hole_punch}))
+            {
+              _header.first_after_hole_punch = holepunchend;
+            }
           }
           ++_header.generation;
           if(!_skip_hashing)
@@ -29,6 +29,9 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "quickcpplib/algorithm/hash.hpp"
 
+#include <atomic>
+#include <chrono>
+
 
 //! \file base.hpp Provides algorithm::shared_fs_mutex::shared_fs_mutex
 
@@ -101,6 +104,59 @@ namespace algorithm
       //! The type of a sequence of entities
       using entities_type = span<entity_type>;
 
+      //! Lock contention statistics, see `statistics()`
+      struct statistics_type
+      {
+        //! The number of buckets into which entities are hashed for `max_hold_time`
+        static constexpr size_t hold_time_buckets = 64;
+
+        uint64 acquisitions{0};                    //!< Successful `lock()`s.
+        uint64 failures{0};                        //!< Failed `lock()`s, e.g. those which timed out.
+        uint64 retries{0};                         //!< Times the algorithm backed out and tried again after finding an entity contended.
+        uint64 randomisations{0};                  //!< Times the algorithm randomised the order of entities after contention.
+        uint64 sleeps{0};                          //!< Times the algorithm slept or yielded waiting for contention to clear.
+        std::chrono::nanoseconds time_waiting{0};  //!< Total time spent within `lock()`.
+        //! The longest time any entity whose value modulo `hold_time_buckets` is the index was held, for locks unlocked by their guard.
+        std::chrono::nanoseconds max_hold_time[hold_time_buckets]{};
+      };
+
+    private:
+      struct _statistics_state
+      {
+        std::atomic<bool> enabled{true};
+        std::atomic<uint64> acquisitions{0}, failures{0}, retries{0}, randomisations{0}, sleeps{0}, nanoseconds_waiting{0};
+        std::atomic<uint64> max_hold_nanoseconds[statistics_type::hold_time_buckets]{};
+      };
+      // Allocated on first enable, and never freed until destruction so lockers need not synchronise with disabling
+      struct _statistics_ptr
+      {
+        std::atomic<_statistics_state *> p{nullptr};
+
+        constexpr _statistics_ptr() {}  // NOLINT
+        // Copies do not share statistics
+        _statistics_ptr(const _statistics_ptr & /*unused*/) noexcept {}
+        _statistics_ptr(_statistics_ptr &&o) noexcept
+            : p(o.p.exchange(nullptr, std::memory_order_acq_rel))
+        {
+        }
+        _statistics_ptr &operator=(const _statistics_ptr & /*unused*/) noexcept { return *this; }
+        _statistics_ptr &operator=(_statistics_ptr &&o) noexcept
+        {
+          if(this != &o)
+          {
+            delete p.exchange(o.p.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_acq_rel);
+          }
+          return *this;
+        }
+        ~_statistics_ptr() { delete p.load(std::memory_order_acquire); }
+      } _statistics;
+
+      _statistics_state *_statistics_if_enabled() const noexcept
+      {
+        auto *s = _statistics.p.load(std::memory_order_acquire);
+        return (s != nullptr && s->enabled.load(std::memory_order_relaxed)) ? s : nullptr;
+      }
+
     protected:
       constexpr shared_fs_mutex() {}  // NOLINT
       shared_fs_mutex(const shared_fs_mutex &) = default;
@@ -143,7 +199,9 @@ namespace algorithm
       //! RAII holder for a lock on a sequence of entities
       class entities_guard
       {
+        friend class shared_fs_mutex;
         entity_type _entity;
+        std::chrono::steady_clock::time_point _locked_at;  // only set if statistics are enabled
 
       public:
         shared_fs_mutex *parent{nullptr};
@@ -167,6 +225,7 @@ namespace algorithm
         entities_guard &operator=(const entities_guard &) = delete;
         entities_guard(entities_guard &&o) noexcept
             : _entity(o._entity)
+            , _locked_at(o._locked_at)
             , parent(o.parent)
             , entities(o.entities)
             , hint(o.hint)
@@ -203,6 +262,7 @@ namespace algorithm
         {
           if(parent != nullptr)
           {
+            parent->_record_hold(*this);
             parent->unlock(entities, hint);
             release();
           }
@@ -212,23 +272,92 @@ namespace algorithm
         {
           parent = nullptr;
           entities = entities_type();
+          _locked_at = {};
         }
       };
 
       virtual result<void> _lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept = 0;
 
+    protected:
+      //! Implementations call this when they back out and try again after finding an entity contended
+      static void _record_retry(const entities_guard &out) noexcept
+      {
+        if(auto *s = (out.parent != nullptr) ? out.parent->_statistics_if_enabled() : nullptr)
+        {
+          s->retries.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      //! Implementations call this when they randomise the order of entities after contention
+      static void _record_randomisation(const entities_guard &out) noexcept
+      {
+        if(auto *s = (out.parent != nullptr) ? out.parent->_statistics_if_enabled() : nullptr)
+        {
+          s->randomisations.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      //! Implementations call this when they sleep or yield waiting for contention to clear
+      static void _record_sleep(const entities_guard &out) noexcept
+      {
+        if(auto *s = (out.parent != nullptr) ? out.parent->_statistics_if_enabled() : nullptr)
+        {
+          s->sleeps.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+    private:
+      result<void> _instrumented_lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept
+      {
+        auto *s = _statistics_if_enabled();
+        if(s == nullptr)
+        {
+          return _lock(out, d, spin_not_sleep);
+        }
+        const auto began = std::chrono::steady_clock::now();
+        auto ret = _lock(out, d, spin_not_sleep);
+        const auto ended = std::chrono::steady_clock::now();
+        s->nanoseconds_waiting.fetch_add(static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(ended - began).count()), std::memory_order_relaxed);
+        if(ret)
+        {
+          s->acquisitions.fetch_add(1, std::memory_order_relaxed);
+          out._locked_at = ended;
+        }
+        else
+        {
+          s->failures.fetch_add(1, std::memory_order_relaxed);
+        }
+        return ret;
+      }
+      void _record_hold(const entities_guard &out) noexcept
+      {
+        auto *s = _statistics_if_enabled();
+        if(s == nullptr || out._locked_at == std::chrono::steady_clock::time_point())
+        {
+          return;
+        }
+        const auto held = static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - out._locked_at).count());
+        for(const auto &entity : out.entities)
+        {
+          auto &max = s->max_hold_nanoseconds[entity.value % statistics_type::hold_time_buckets];
+          uint64 current = max.load(std::memory_order_relaxed);
+          while(held > current && !max.compare_exchange_weak(current, held, std::memory_order_relaxed))
+          {
+          }
+        }
+      }
+
+    public:
       //! Lock all of a sequence of entities for exclusive or shared access
       result<entities_guard> lock(entities_type entities, deadline d = deadline(), bool spin_not_sleep = false) noexcept
       {
         entities_guard ret(this, entities);
-        OUTCOME_TRYV(_lock(ret, d, spin_not_sleep));
+        OUTCOME_TRYV(_instrumented_lock(ret, d, spin_not_sleep));
         return {std::move(ret)};
       }
       //! Lock a single entity for exclusive or shared access
       result<entities_guard> lock(entity_type entity, deadline d = deadline(), bool spin_not_sleep = false) noexcept
       {
         entities_guard ret(this, entity);
-        OUTCOME_TRYV(_lock(ret, d, spin_not_sleep));
+        OUTCOME_TRYV(_instrumented_lock(ret, d, spin_not_sleep));
         return {std::move(ret)};
       }
       //! Try to lock all of a sequence of entities for exclusive or shared access
@@ -237,6 +366,73 @@ namespace algorithm
       result<entities_guard> try_lock(entity_type entity) noexcept { return lock(entity, deadline(std::chrono::seconds(0))); }
       //! Unlock a previously locked sequence of entities
       virtual void unlock(entities_type entities, unsigned long long hint = 0) noexcept = 0;
+
+      /*! \brief Enables or disables the collection of lock contention statistics, which is initially
+      disabled. Enabling resets the statistics.
+
+      \errors `errc::not_enough_memory` if the statistics could not be allocated on first enable.
+      */
+      result<void> set_statistics_enabled(bool enable) noexcept
+      {
+        auto *s = _statistics.p.load(std::memory_order_acquire);
+        if(!enable)
+        {
+          if(s != nullptr)
+          {
+            s->enabled.store(false, std::memory_order_relaxed);
+          }
+          return success();
+        }
+        if(s == nullptr)
+        {
+          auto *news = new(std::nothrow) _statistics_state;
+          if(news == nullptr)
+          {
+            return errc::not_enough_memory;
+          }
+          if(_statistics.p.compare_exchange_strong(s, news, std::memory_order_acq_rel))
+          {
+            return success();
+          }
+          // Another thread enabled them first
+          delete news;
+        }
+        s->enabled.store(false, std::memory_order_relaxed);
+        s->acquisitions.store(0, std::memory_order_relaxed);
+        s->failures.store(0, std::memory_order_relaxed);
+        s->retries.store(0, std::memory_order_relaxed);
+        s->randomisations.store(0, std::memory_order_relaxed);
+        s->sleeps.store(0, std::memory_order_relaxed);
+        s->nanoseconds_waiting.store(0, std::memory_order_relaxed);
+        for(auto &i : s->max_hold_nanoseconds)
+        {
+          i.store(0, std::memory_order_relaxed);
+        }
+        s->enabled.store(true, std::memory_order_release);
+        return success();
+      }
+      //! True if lock contention statistics are being collected
+      bool statistics_enabled() const noexcept { return _statistics_if_enabled() != nullptr; }
+      //! A snapshot of the lock contention statistics collected, all zero if they have never been enabled.
+      statistics_type statistics() const noexcept
+      {
+        statistics_type ret;
+        auto *s = _statistics.p.load(std::memory_order_acquire);
+        if(s != nullptr)
+        {
+          ret.acquisitions = s->acquisitions.load(std::memory_order_relaxed);
+          ret.failures = s->failures.load(std::memory_order_relaxed);
+          ret.retries = s->retries.load(std::memory_order_relaxed);
+          ret.randomisations = s->randomisations.load(std::memory_order_relaxed);
+          ret.sleeps = s->sleeps.load(std::memory_order_relaxed);
+          ret.time_waiting = std::chrono::nanoseconds(s->nanoseconds_waiting.load(std::memory_order_relaxed));
+          for(size_t n = 0; n < statistics_type::hold_time_buckets; n++)
+          {
+            ret.max_hold_time[n] = std::chrono::nanoseconds(s->max_hold_nanoseconds[n].load(std::memory_order_relaxed));
+          }
+        }
+        return ret;
+      }
     };
 
   }  // namespace shared_fs_mutex
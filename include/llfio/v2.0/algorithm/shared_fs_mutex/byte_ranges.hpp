@@ -53,6 +53,8 @@ namespace algorithm
     - Exponential complexity to number of entities being concurrently locked, though some OSs
     provide linear complexity so long as total concurrent waiting processes is CPU core count or less.
     - Does a reasonable job of trying to sleep the thread if any of the entities are locked.
+    - Uncontended locks of many entities are taken in a single sorted pass by `lock_file_ranges()`,
+    which coalesces adjacent entities into single lock and unlock syscalls.
     - Sudden process exit with lock held is recovered from.
     - Sudden power loss during use is recovered from.
     - Safe for multithreaded usage of the same instance.
@@ -115,6 +117,28 @@ namespace algorithm
       //! Return the handle to file being used for this lock
       const file_handle &handle() const noexcept { return _h; }
 
+    private:
+      // Set as the guard's hint when all entities were locked in one go by lock_file_ranges()
+      static constexpr unsigned long long _hint_coalesced = 1;
+
+      static result<std::vector<file_handle::extent_lock_request>> _lock_requests(entities_type entities) noexcept
+      {
+        try
+        {
+          std::vector<file_handle::extent_lock_request> ret;
+          ret.reserve(entities.size());
+          for(const auto &i : entities)
+          {
+            ret.push_back({i.value, 1, (i.exclusive != 0u) ? lock_kind::exclusive : lock_kind::shared});
+          }
+          return {std::move(ret)};
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }
+
     protected:
       LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> _lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept final
       {
@@ -125,7 +149,7 @@ namespace algorithm
         {
           if((d).steady)
           {
-            began_steady = std::chrono::steady_clock::now();
+            began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
           }
           else
           {
@@ -134,6 +158,23 @@ namespace algorithm
         }
         // Fire this if an error occurs
         auto disableunlock = make_scope_exit([&]() noexcept { out.release(); });
+        if(out.entities.size() > 1)
+        {
+          // In the uncontended case, try locking everything at once in sorted order, which coalesces
+          // adjacent entities into single lock syscalls
+          auto reqs = _lock_requests(out.entities);
+          if(reqs)
+          {
+            auto guards = _h.lock_file_ranges(reqs.value(), deadline(std::chrono::seconds(0)));
+            if(guards)
+            {
+              guards.value().release();
+              out.hint = _hint_coalesced;
+              disableunlock.release();
+              return success();
+            }
+          }
+        }
         size_t n;
         for(;;)
         {
@@ -167,7 +208,7 @@ namespace algorithm
                 {
                   if((d).steady)
                   {
-                    std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());
+                    std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs));
                     if(ns.count() < 0)
                     {
                       (nd).nsecs = 0;
@@ -201,7 +242,7 @@ namespace algorithm
           {
             if((d).steady)
             {
-              if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
+              if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
               {
                 return errc::timed_out;
               }
@@ -214,6 +255,8 @@ namespace algorithm
               }
             }
           }
+          _record_retry(out);
+          _record_randomisation(out);
           // Move was_contended to front and randomise rest of out.entities
           std::swap(out.entities[was_contended], out.entities[0]);
           auto front = out.entities.begin();
@@ -221,6 +264,7 @@ namespace algorithm
           QUICKCPPLIB_NAMESPACE::algorithm::small_prng::random_shuffle(front, out.entities.end());
           if(!spin_not_sleep)
           {
+            _record_sleep(out);
             std::this_thread::yield();
           }
         }
@@ -228,9 +272,19 @@ namespace algorithm
       }
 
     public:
-      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock(entities_type entities, unsigned long long /*hint*/) noexcept final
+      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock(entities_type entities, unsigned long long hint) noexcept final
       {
         LLFIO_LOG_FUNCTION_CALL(this);
+        if(hint == _hint_coalesced)
+        {
+          // Windows requires unlocks to exactly match the ranges locked
+          auto reqs = _lock_requests(entities);
+          if(reqs)
+          {
+            _h.unlock_file_ranges(reqs.value());
+            return;
+          }
+        }
         for(const auto &i : entities)
         {
           _h.unlock_file_range(i.value, 1);
@@ -48,6 +48,10 @@ namespace algorithm
     and tries locking them again until success. The only real reason to use this implementation
     is its excellent compatibility with almost everything, most users will want byte_ranges instead.
 
+    Each lock file is whole file locked by its creator for as long as it holds the entity. If a
+    lock file already exists but its whole file lock can be taken, its owner exited suddenly without
+    unlocking, and the lock file is taken over as if it had just been created.
+
     - Compatible with all networked file systems.
     - Linear complexity to number of concurrent users.
     - Exponential complexity to number of contended entities being concurrently locked.
@@ -55,21 +59,15 @@ namespace algorithm
 
     Caveats:
     - No ability to sleep until a lock becomes free, so CPUs are spun at 100%.
-    - On POSIX only sudden process exit with locks held will deadlock all other users by leaving stale
-    files around.
+    - Stale lock files left by sudden process exit are only recovered if the filing system
+    implements whole file locks, which some networked filing systems do not.
     - Costs a file descriptor per entity locked.
-    - Sudden power loss during use will deadlock first user after reboot, again due to stale files.
     - Currently this implementation does not permit more than one lock() per instance as the lock
     information is stored as member data. Creating multiple instances referring to the same path
     works fine. This could be fixed easily, but it would require a memory allocation per lock and
     user demand that this is actually a problem in practice.
     - Leaves many 16 character long hexadecimal named files in the supplied directory which may
     confuse users. Tip: create a hidden lockfile directory.
-
-    Fixing the stale lock file problem could be quite trivial - simply byte range lock the first byte
-    in the lock file to detect when a lock file is stale. However in this situation using the
-    byte_ranges algorithm would be far superior, so implementing stale lock file clean up is left up
-    to the user.
     */
     class lock_files : public shared_fs_mutex
     {
@@ -81,6 +79,37 @@ namespace algorithm
       {
       }
 
+      // Deletes a lock file before releasing its whole file lock, so nobody can think it stale
+      static void _release(file_handle &h) noexcept
+      {
+        if(h.is_valid())
+        {
+          (void) h.unlink();
+          (void) h.close();
+        }
+      }
+      // Takes whole file lock ownership of a newly created lock file, or of an existing one whose owner exited suddenly
+      bool _acquire(file_handle &out, const std::string &entity_path, bool created) noexcept
+      {
+        auto h = std::move(out);
+        if(!h.try_lock_file())
+        {
+          // Somebody else owns it
+          return false;
+        }
+        if(!created)
+        {
+          // The lock file may have been deleted by its owner just before it released the lock
+          auto h2 = file_handle::file(_path, entity_path, file_handle::mode::attr_read, file_handle::creation::open_existing, file_handle::caching::temporary);
+          if(!h2 || h2.value().unique_id() != h.unique_id())
+          {
+            return false;
+          }
+        }
+        out = std::move(h);
+        return true;
+      }
+
     public:
       //! The type of an entity id
       using entity_type = shared_fs_mutex::entity_type;
@@ -127,7 +156,7 @@ namespace algorithm
         {
           if((d).steady)
           {
-            began_steady = std::chrono::steady_clock::now();
+            began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
           }
           else
           {
@@ -155,14 +184,15 @@ namespace algorithm
                 // Now 0 to n needs to be closed
                 for(; n > 0; n--)
                 {
-                  (void) _hs[n].close();  // delete on close semantics deletes the file
+                  _release(_hs[n]);
                 }
-                (void) _hs[0].close();
+                _release(_hs[0]);
               }
             });
             for(n = 0; n < out.entities.size(); n++)
             {
-              auto ret = file_handle::file(_path, entity_paths[n], file_handle::mode::write, file_handle::creation::only_if_not_exist, file_handle::caching::temporary, file_handle::flag::unlink_on_first_close);
+              bool created = true;
+              auto ret = file_handle::file(_path, entity_paths[n], file_handle::mode::write, file_handle::creation::only_if_not_exist, file_handle::caching::temporary);
               if(ret.has_error())
               {
                 const auto &ec = ret.error();
@@ -170,11 +200,17 @@ namespace algorithm
                 {
                   return std::move(ret).error();
                 }
-                // Collided with another locker
-                was_contended = n;
-                break;
+                // Collided with another locker, who may have exited without unlocking
+                created = false;
+                ret = file_handle::file(_path, entity_paths[n], file_handle::mode::write, file_handle::creation::open_existing, file_handle::caching::temporary);
+              }
+              if(ret && _acquire(ret.value(), entity_paths[n], created))
+              {
+                _hs[n] = std::move(ret.value());
+                continue;
               }
-              _hs[n] = std::move(ret.value());
+              was_contended = n;
+              break;
             }
             if(n == out.entities.size())
             {
@@ -187,7 +223,7 @@ namespace algorithm
             {
               if((d).steady)
               {
-                if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
+                if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
                 {
                   return errc::timed_out;
                 }
@@ -200,6 +236,8 @@ namespace algorithm
                 }
               }
             }
+            _record_retry(out);
+            _record_randomisation(out);
             // Move was_contended to front and randomise rest of out.entities
             std::swap(out.entities[was_contended], out.entities[0]);
             auto front = out.entities.begin();
@@ -208,6 +246,7 @@ namespace algorithm
             // Sleep for a very short time
             if(!spin_not_sleep)
             {
+              _record_sleep(out);
               std::this_thread::yield();
             }
           }
@@ -221,7 +260,7 @@ namespace algorithm
         LLFIO_LOG_FUNCTION_CALL(this);
         for(auto &i : _hs)
         {
-          (void) i.close();  // delete on close semantics deletes the file
+          _release(i);
         }
       }
     };
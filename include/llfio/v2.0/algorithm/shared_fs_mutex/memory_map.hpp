@@ -25,12 +25,17 @@ Distributed under the Boost Software License, Version 1.0.
 #ifndef LLFIO_SHARED_FS_MUTEX_MEMORY_MAP_HPP
 #define LLFIO_SHARED_FS_MUTEX_MEMORY_MAP_HPP
 
+#include "../../ipc_channel.hpp"
 #include "../../map_handle.hpp"
 #include "base.hpp"
 
 #include "quickcpplib/algorithm/hash.hpp"
 #include "quickcpplib/algorithm/small_prng.hpp"
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 //! \file memory_map.hpp Provides algorithm::shared_fs_mutex::memory_map
 
 LLFIO_V2_NAMESPACE_BEGIN
@@ -42,8 +47,10 @@ namespace algorithm
     /*! \class memory_map
     \brief Many entity memory mapped shared/exclusive file system based lock
     \tparam Hasher A STL compatible hash algorithm to use (defaults to `fnv1a_hash`)
-    \tparam HashIndexSize The size in bytes of the hash index to use (defaults to 4Kb)
+    \tparam HashIndexSize The default size in bytes of the hash index to use (defaults to 4Kb), see `fs_mutex_map()` and `resize_index()`
     \tparam SpinlockType The type of spinlock to use (defaults to a `SharedMutex` concept spinlock)
+    \tparam OneSpinlockPerCacheLine Whether to pad each spinlock in the hash index out to its own cache line
+    (defaults to false)
 
     This is the highest performing filing system mutex in LLFIO, but it comes with a long list of potential
     gotchas. It works by creating a random temporary file somewhere on the system and placing its path
@@ -55,6 +62,12 @@ namespace algorithm
     implementation is entirely implemented in userspace using shared memory without any kernel syscalls,
     performance is probably as fast as any many-arbitrary-entity shared locking system could be.
 
+    If a lock is not obtained after `spins_before_sleep` attempts, and spinning was not requested, the
+    caller sleeps until an entity hashing to the same wait slot as the contended entity is unlocked. On Linux
+    this uses shared futexes in the mapped hash index, so sleepers consume no CPU and unlockers only enter
+    the kernel if there is a sleeper. Elsewhere sleepers poll with exponential backoff, as no portable cross
+    process wait-on-address exists.
+
     As it uses shared memory, this implementation of `shared_fs_mutex` cannot work over a networked
     drive. If you attempt to open this lock on a network drive and the first user of the lock is not
     on this local machine, `errc::no_lock_available` will be returned from the constructor.
@@ -66,15 +79,27 @@ namespace algorithm
     - In the lightly contended case, an order of magnitude faster than any other `shared_fs_mutex` algorithm.
 
     Caveats:
-    - No ability to sleep until a lock becomes free, so CPUs are spun at 100%.
-    - Sudden process exit with locks held will deadlock all other users.
+    - Sleepers on platforms other than Linux poll, so they wake up to a millisecond late.
+    - Sudden process exit with locks held is recovered from by the first waiter to notice, which
+    happens within `reap_interval` for sleeping waiters. Each instance records which spinlocks
+    it holds in one of `max_users` user slots in the mapped hash index file, and holds a byte range
+    lock on its slot for its lifetime. Waiters check whether the users holding the spinlock they
+    are waiting on still hold their slot's lock, and if not, release their spinlocks on their behalf.
+    This is not possible if there are more than `max_users` concurrent instances, or if the OS lacks
+    sane byte range locks (see below), in which case such instances will deadlock all other users on
+    sudden process exit with locks held. Sudden process exit in the few instructions between
+    acquiring or releasing a spinlock and recording that fact also deadlocks other users.
     - Exponential complexity to number of entities being concurrently locked.
     - Exponential complexity to concurrency if entities hash to the same cache line. Most SMP and especially
     NUMA systems have a finite bandwidth for atomic compare and swap operations, and every attempt to
     lock or unlock an entity under this implementation is several of those operations. Under heavy contention,
     whole system performance very noticeably nose dives from excessive atomic operations, things like audio and the
-    mouse pointer will stutter.
+    mouse pointer will stutter. Setting `OneSpinlockPerCacheLine` eliminates false sharing between entities at the cost
+    of a hash index with one eighth of the entries for the same `HashIndexSize`, so you probably want to increase that too.
     - Sometimes different entities hash to the same offset and collide with one another, causing very poor performance.
+    `hash_collisions()` counts how often this has happened in lock requests made through this instance. The hash
+    index can be sized when the lock is first used, or resized whilst in use by `resize_index()`, so deployments
+    locking millions of entities can keep collisions rare.
     - Memory mapped files need to be cache unified with normal i/o in your OS kernel. Known OSs which
     don't use a unified cache for memory mapped and normal i/o are QNX, OpenBSD. Furthermore, doing
     normal i/o and memory mapped i/o to the same file needs to not corrupt the file. In the past,
@@ -82,10 +107,8 @@ namespace algorithm
     - If your OS doesn't have sane byte range locks (OS X, BSD, older Linuxes) and multiple
     objects in your process use the same lock file, misoperation will occur.
     - Requires `handle::current_path()` to be working.
-
-    \todo memory_map::_hash_entities needs to hash x16, x8 and x4 at a time to encourage auto vectorisation
     */
-    template <template <class> class Hasher = QUICKCPPLIB_NAMESPACE::algorithm::hash::fnv1a_hash, size_t HashIndexSize = 4096, class SpinlockType = QUICKCPPLIB_NAMESPACE::configurable_spinlock::shared_spinlock<>> class memory_map : public shared_fs_mutex
+    template <template <class> class Hasher = QUICKCPPLIB_NAMESPACE::algorithm::hash::fnv1a_hash, size_t HashIndexSize = 4096, class SpinlockType = QUICKCPPLIB_NAMESPACE::configurable_spinlock::shared_spinlock<>, bool OneSpinlockPerCacheLine = false> class memory_map : public shared_fs_mutex
     {
     public:
       //! The type of an entity id
@@ -96,22 +119,151 @@ namespace algorithm
       using hasher_type = Hasher<entity_type::value_type>;
       //! The type of the spinlock being used
       using spinlock_type = SpinlockType;
+      //! The number of failed attempts to lock all the entities before sleeping
+      static constexpr size_t spins_before_sleep = 64;
+      //! The maximum number of concurrent instances whose sudden exit can be recovered from
+      static constexpr size_t max_users = 256;
+      //! The maximum time a sleeping waiter sleeps before checking whether the lock holders are still alive
+      static constexpr std::chrono::milliseconds reap_interval{10};
 
     private:
-      static constexpr size_t _container_entries = HashIndexSize / sizeof(spinlock_type);
-      using _hash_index_type = std::array<spinlock_type, _container_entries>;
+      static constexpr size_t _cache_line = 64;
+      static_assert(!OneSpinlockPerCacheLine || sizeof(spinlock_type) <= _cache_line, "spinlock type is larger than a cache line");
+      struct alignas(OneSpinlockPerCacheLine ? _cache_line : alignof(spinlock_type)) _index_entry : spinlock_type
+      {
+      };
+      static_assert(HashIndexSize >= sizeof(_index_entry), "HashIndexSize is too small to hold a single spinlock");
+      static constexpr size_t _max_entries = static_cast<size_t>(1) << 30;
+      // Where each hash index lives in the hash index file. The index of generation g is _indices[(g >> 1) & 1].
+      struct _index_descriptor
+      {
+        uint64_t number;  // generation >> 1
+        uint64_t offset;
+        uint64_t entries;
+      };
+      // The start of the hash index file
+      struct _header
+      {
+        std::atomic<uint32_t> generation;  // twice the number of resizes, plus one whilst the previous hash index drains
+        uint32_t _padding;
+        uint64_t file_end;  // where the next hash index is placed
+        _index_descriptor indices[2];
+      };
+      // Sleepers wait on the wait slot of the entity they are contending on, kept after the header
+      struct _wait_slot
+      {
+        std::atomic<uint32_t> seq;
+        std::atomic<uint32_t> waiting;
+      };
+      static constexpr size_t _wait_slots = 64;
+      using _wait_index_type = std::array<_wait_slot, _wait_slots>;
+      using _user_index_type = std::array<std::atomic<uint32_t>, max_users>;
+      // The header, wait slots and user slots, after which the hash indices are placed suitably aligned for mapping on Windows
+      static constexpr size_t _header_size = 65536;
+      static_assert(sizeof(_header) + sizeof(_wait_index_type) + sizeof(_user_index_type) <= _header_size, "header is too large");
+      /* Each hash index is followed by the spinlocks held in it by each user, -1 for exclusive or
+      the count of shared holds. The file is sparse, so only the parts of it touched consume memory.
+      */
+      static size_t _held_offset(size_t entries) noexcept { return (entries * sizeof(_index_entry) + _cache_line - 1) & ~(_cache_line - 1); }
+      static size_t _index_bytes(size_t entries) noexcept { return (_held_offset(entries) + max_users * entries * sizeof(int16_t) + _header_size - 1) & ~(_header_size - 1); }
+      // A hash index mapped into this process
+      struct _index_map
+      {
+        uint32_t number{0};
+        size_t entries{0};
+        map_handle map;
+
+        _index_entry *index() const noexcept { return reinterpret_cast<_index_entry *>(map.address()); }
+        std::atomic<int16_t> *held(size_t user) const noexcept { return reinterpret_cast<std::atomic<int16_t> *>(map.address() + _held_offset(entries)) + user * entries; }
+      };
       static constexpr file_handle::extent_type _initialisingoffset = static_cast<file_handle::extent_type>(1024) * 1024;
       static constexpr file_handle::extent_type _lockinuseoffset = static_cast<file_handle::extent_type>(1024) * 1024 + 1;
+      static constexpr file_handle::extent_type _useroffset = static_cast<file_handle::extent_type>(1024) * 1024 + 2;  // exclusive lock of each user slot held by its user
+      static constexpr file_handle::extent_type _resizeoffset = _useroffset + max_users;  // exclusive lock held by whoever is resizing the hash index
+      static constexpr size_t _no_user = static_cast<size_t>(-1);
 
       file_handle _h, _temph;
       file_handle::extent_guard _hlockinuse;  // shared lock of last byte of _h marking if lock is in use
+      file_handle::extent_guard _hlockuser;   // exclusive lock of my user slot
       map_handle _hmap, _temphmap;
+      std::atomic<size_t> _collisions{0};
+      size_t _user{_no_user};
+      // Every hash index this instance has used, which stay mapped until destruction as unlocks may refer to them
+      mutable std::mutex _indiceslock;
+      mutable std::vector<std::unique_ptr<_index_map>> _indices;
+      mutable std::atomic<_index_map *> _current{nullptr};
 
-      _hash_index_type &_index() const
+      _header &_head() const
       {
-        auto *ret = reinterpret_cast<_hash_index_type *>(_temphmap.address());
+        auto *ret = reinterpret_cast<_header *>(_temphmap.address());
         return *ret;
       }
+      _wait_index_type &_waits() const
+      {
+        auto *ret = reinterpret_cast<_wait_index_type *>(_temphmap.address() + sizeof(_header));
+        return *ret;
+      }
+      _user_index_type &_users() const
+      {
+        auto *ret = reinterpret_cast<_user_index_type *>(_temphmap.address() + sizeof(_header) + sizeof(_wait_index_type));
+        return *ret;
+      }
+      // Returns the hash index numbered `number`, mapping it if this instance has not yet, or null if it has since been replaced
+      result<_index_map *> _index_for(uint32_t number) const noexcept
+      {
+        auto *current = _current.load(std::memory_order_acquire);
+        if(current != nullptr && current->number == number)
+        {
+          return current;
+        }
+        try
+        {
+          std::lock_guard<std::mutex> g(_indiceslock);
+          for(auto &i : _indices)
+          {
+            if(i->number == number)
+            {
+              return i.get();
+            }
+          }
+          const _index_descriptor desc = _head().indices[number & 1];
+          if(desc.number != number)
+          {
+            return static_cast<_index_map *>(nullptr);
+          }
+          auto i = std::make_unique<_index_map>();
+          i->number = number;
+          i->entries = static_cast<size_t>(desc.entries);
+          OUTCOME_TRY(auto &&section, section_handle::section(const_cast<file_handle &>(_temph), desc.offset + _index_bytes(i->entries)));
+          OUTCOME_TRY(i->map, map_handle::map(section, _index_bytes(i->entries), desc.offset));
+          _indices.push_back(std::move(i));
+          auto *ret = _indices.back().get();
+          if(current == nullptr || current->number < number)
+          {
+            _current.store(ret, std::memory_order_release);
+          }
+          return ret;
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }
+      // Returns the current hash index, and the previous one if it is still draining
+      result<std::pair<_index_map *, _index_map *>> _indices_for(uint32_t generation) const noexcept
+      {
+        OUTCOME_TRY(auto *cur, _index_for(generation >> 1));
+        _index_map *prev = nullptr;
+        if(cur != nullptr && (generation & 1) != 0)
+        {
+          OUTCOME_TRY(prev, _index_for((generation >> 1) - 1));
+          if(prev == nullptr)
+          {
+            cur = nullptr;
+          }
+        }
+        return std::pair<_index_map *, _index_map *>(cur, prev);
+      }
 
       memory_map(file_handle &&h, file_handle &&temph, file_handle::extent_guard &&hlockinuse, map_handle &&hmap, map_handle &&temphmap)
           : _h(std::move(h))
@@ -129,7 +281,26 @@ namespace algorithm
       //! No copy assignment
       memory_map &operator=(const memory_map &) = delete;
       //! Move constructor
-      memory_map(memory_map &&o) noexcept : _h(std::move(o._h)), _temph(std::move(o._temph)), _hlockinuse(std::move(o._hlockinuse)), _hmap(std::move(o._hmap)), _temphmap(std::move(o._temphmap)) { _hlockinuse.set_handle(&_h); }
+      memory_map(memory_map &&o) noexcept
+          : _h(std::move(o._h))
+          , _temph(std::move(o._temph))
+          , _hlockinuse(std::move(o._hlockinuse))
+          , _hlockuser(std::move(o._hlockuser))
+          , _hmap(std::move(o._hmap))
+          , _temphmap(std::move(o._temphmap))
+          , _collisions(o._collisions.load(std::memory_order_relaxed))
+          , _user(o._user)
+          , _indices(std::move(o._indices))
+          , _current(o._current.load(std::memory_order_relaxed))
+      {
+        _hlockinuse.set_handle(&_h);
+        if(_hlockuser)
+        {
+          _hlockuser.set_handle(&_h);
+        }
+        o._user = _no_user;
+        o._current.store(nullptr, std::memory_order_relaxed);
+      }
       //! Move assign
       memory_map &operator=(memory_map &&o) noexcept
       {
@@ -141,7 +312,15 @@ namespace algorithm
       {
         if(_h.is_valid())
         {
+          // Release my user slot
+          if(_user != _no_user)
+          {
+            _users()[_user].store(0, std::memory_order_release);
+            _hlockuser.unlock();
+          }
           // Release the maps
+          _current.store(nullptr, std::memory_order_relaxed);
+          _indices.clear();
           _hmap = {};
           _temphmap = {};
           // Release my shared locks and try locking inuse exclusively
@@ -187,14 +366,22 @@ namespace algorithm
       }
 
       /*! Initialises a shared filing system mutex using the file at \em lockfile.
+      \param base The base for `lockfile`.
+      \param lockfile The path of the lock file.
+      \param hash_index_size The size in bytes of the hash index, if this is the first user of the lock.
+      Otherwise the size chosen by the first user, or by the last `resize_index()`, is used.
       \errors Awaiting the clang result<> AST parser which auto generates all the error codes which could occur,
       but a particularly important one is `errc::no_lock_available` which will be returned if the lock
       is in use by another computer on a network.
       */
       LLFIO_MAKE_FREE_FUNCTION
-      static result<memory_map> fs_mutex_map(const path_handle &base, path_view lockfile) noexcept
+      static result<memory_map> fs_mutex_map(const path_handle &base, path_view lockfile, size_t hash_index_size = HashIndexSize) noexcept
       {
         LLFIO_LOG_FUNCTION_CALL(0);
+        if(hash_index_size < sizeof(_index_entry) || hash_index_size / sizeof(_index_entry) > _max_entries)
+        {
+          return errc::invalid_argument;
+        }
         try
         {
           OUTCOME_TRY(auto &&ret, file_handle::file(base, lockfile, file_handle::mode::write, file_handle::creation::if_needed, file_handle::caching::reads));
@@ -226,23 +413,31 @@ namespace algorithm
               return errc::no_lock_available;
             }
             temph = std::move(_temph.value());
-            // Map the hash index file into memory for read/write access
-            OUTCOME_TRY(auto &&temphsection, section_handle::section(temph, HashIndexSize));
-            OUTCOME_TRY(auto &&temphmap, map_handle::map(temphsection, HashIndexSize));
+            // Map the header of the hash index file into memory for read/write access, the hash indices are mapped on first use
+            OUTCOME_TRY(auto &&temphsection, section_handle::section(temph, _header_size));
+            OUTCOME_TRY(auto &&temphmap, map_handle::map(temphsection, _header_size));
             // Map the path file into memory with its maximum possible size, read only
             OUTCOME_TRY(auto &&hsection, section_handle::section(ret, 65536, section_handle::flag::read));
             OUTCOME_TRY(auto &&hmap, map_handle::map(hsection, 0, 0, section_handle::flag::read));
-            return memory_map(std::move(ret), std::move(temph), std::move(lockinuse.value()), std::move(hmap), std::move(temphmap));
+            memory_map mm(std::move(ret), std::move(temph), std::move(lockinuse.value()), std::move(hmap), std::move(temphmap));
+            OUTCOME_TRY(mm._claim_user());
+            return {std::move(mm)};
           }
 
           // I am the first person to be using this (stale?) file, so create a new hash index file in /tmp
           auto &tempdirh = path_discovery::memory_backed_temporary_files_directory().is_valid() ? path_discovery::memory_backed_temporary_files_directory() : path_discovery::storage_backed_temporary_files_directory();
           OUTCOME_TRY(auto &&_temph, file_handle::uniquely_named_file(tempdirh));
           temph = std::move(_temph);
-          // Truncate it out to the hash index size, and map it into memory for read/write access
-          OUTCOME_TRYV(temph.truncate(HashIndexSize));
-          OUTCOME_TRY(auto &&temphsection, section_handle::section(temph, HashIndexSize));
-          OUTCOME_TRY(auto &&temphmap, map_handle::map(temphsection, HashIndexSize));
+          // Truncate it out to the header plus the first hash index, and map the header into memory for read/write access
+          const size_t entries = hash_index_size / sizeof(_index_entry);
+          OUTCOME_TRYV(temph.truncate(_header_size + _index_bytes(entries)));
+          OUTCOME_TRY(auto &&temphsection, section_handle::section(temph, _header_size));
+          OUTCOME_TRY(auto &&temphmap, map_handle::map(temphsection, _header_size));
+          {
+            auto *head = reinterpret_cast<_header *>(temphmap.address());
+            head->indices[0] = _index_descriptor{0, _header_size, entries};
+            head->file_end = _header_size + _index_bytes(entries);
+          }
           // Write the path of my new hash index file, padding zeros to the nearest page size
           // multiple to work around a race condition in the Linux kernel
           OUTCOME_TRY(auto &&temppath, temph.current_path());
@@ -261,7 +456,9 @@ namespace algorithm
           */
           OUTCOME_TRY(auto &&lockinuse2, ret.lock_file_range(_lockinuseoffset, 1, lock_kind::shared));
           lockinuse = std::move(lockinuse2);  // releases exclusive lock on all three offsets
-          return memory_map(std::move(ret), std::move(temph), std::move(lockinuse.value()), std::move(hmap), std::move(temphmap));
+          memory_map mm(std::move(ret), std::move(temph), std::move(lockinuse.value()), std::move(hmap), std::move(temphmap));
+          OUTCOME_TRY(mm._claim_user());
+          return {std::move(mm)};
         }
         catch(...)
         {
@@ -271,62 +468,336 @@ namespace algorithm
 
       //! Return the handle to file being used for this lock
       const file_handle &handle() const noexcept { return _h; }
+      //! The number of times distinct entities in a lock request made through this instance have hashed to the same spinlock
+      size_t hash_collisions() const noexcept { return _collisions.load(std::memory_order_relaxed); }
+      //! The number of spinlocks in the current hash index, which is shared by all users of the lock
+      size_t hash_index_entries() const noexcept
+      {
+        const uint32_t generation = _head().generation.load(std::memory_order_acquire);
+        return static_cast<size_t>(_head().indices[(generation >> 1) & 1].entries);
+      }
+
+      /*! \brief Replaces the hash index shared by all users of the lock with one of `hash_index_size`
+      bytes, without interrupting any of them.
+
+      The new hash index is placed at the end of the hash index file, and a generation counter in
+      the file bumped to tell all users. Until all locks taken in the old hash index before the bump
+      are released, lockers lock their entities in both the old and new hash indices, so exclusion is
+      never broken, but locking is slower. This call waits for the old hash index to drain, and if
+      `d` expires first, returns `errc::timed_out` with the resize published but not yet complete.
+      Calling it again completes it. Only one user can resize at once, others wait.
+
+      As each hash index is followed by the spinlocks each of `max_users` users holds in it, the
+      hash index file grows by `max_users * 2` bytes per spinlock for every resize. The file is
+      sparse, so only those parts of it touched by users consume memory or storage.
+
+      \errors `errc::invalid_argument` if `hash_index_size` is too small to hold a single spinlock, or
+      would hold more than 2^30 spinlocks,
+      `errc::timed_out` if `d` expired, otherwise any of the values `truncate()` or `map_handle::map()`
+      can return.
+      */
+      result<void> resize_index(size_t hash_index_size, deadline d = deadline()) noexcept
+      {
+        LLFIO_LOG_FUNCTION_CALL(this);
+        const size_t entries = hash_index_size / sizeof(_index_entry);
+        if(entries == 0 || entries > _max_entries)
+        {
+          return errc::invalid_argument;
+        }
+        OUTCOME_TRY(auto &&resizelock, _h.lock_file_range(_resizeoffset, 1, lock_kind::exclusive, d));
+        (void) resizelock;
+        auto &head = _head();
+        uint32_t generation = head.generation.load(std::memory_order_acquire);
+        if((generation & 1) != 0)
+        {
+          // A previous resize did not complete, so complete it first
+          OUTCOME_TRY(_drain(generation, d));
+          ++generation;
+        }
+        if(head.indices[(generation >> 1) & 1].entries == entries)
+        {
+          return success();
+        }
+        // Place the new hash index at the end of the file, and map it before telling anyone about it
+        const uint32_t number = (generation >> 1) + 1;
+        const _index_descriptor desc{number, head.file_end, entries};
+        OUTCOME_TRYV(_temph.truncate(desc.offset + _index_bytes(entries)));
+        head.indices[number & 1] = desc;
+        head.file_end = desc.offset + _index_bytes(entries);
+        OUTCOME_TRY(auto *newindex, _index_for(number));
+        if(newindex == nullptr)
+        {
+          return errc::state_not_recoverable;  // nobody else can resize, so this should never happen
+        }
+        head.generation.store(generation + 1, std::memory_order_release);
+        return _drain(generation + 1, d);
+      }
 
     protected:
       struct _entity_idx
       {
-        unsigned value : 31;
+        unsigned value : 30;
         unsigned exclusive : 1;
+        unsigned previous : 1;  // in the previous hash index, which is draining
       };
-      // Create a cache of entities to their indices, eliding collisions where necessary
-      static span<_entity_idx> _hash_entities(_entity_idx *entity_to_idx, entities_type &entities)
+      // Hashes a batch of entities at a time, the fixed size encourages auto vectorisation
+      template <size_t N> static void _hash_batch(_entity_idx *out, const entity_type *in, size_t entries) noexcept
       {
+        size_t hashes[N];
+        for(size_t n = 0; n < N; n++)
+        {
+          hashes[n] = hasher_type()(in[n].value) % entries;
+        }
+        for(size_t n = 0; n < N; n++)
+        {
+          out[n].value = static_cast<unsigned>(hashes[n]);
+          out[n].exclusive = in[n].exclusive;
+          out[n].previous = false;
+        }
+      }
+      // Create a cache of entities to their indices in a hash index of `entries`, eliding collisions where necessary
+      static span<_entity_idx> _hash_entities(_entity_idx *entity_to_idx, entities_type &entities, size_t entries, size_t *collisions = nullptr)
+      {
+        size_t n = 0;
+        for(; entities.size() - n >= 16; n += 16)
+        {
+          _hash_batch<16>(entity_to_idx + n, entities.data() + n, entries);
+        }
+        for(; entities.size() - n >= 8; n += 8)
+        {
+          _hash_batch<8>(entity_to_idx + n, entities.data() + n, entries);
+        }
+        for(; entities.size() - n >= 4; n += 4)
+        {
+          _hash_batch<4>(entity_to_idx + n, entities.data() + n, entries);
+        }
+        for(; n < entities.size(); n++)
+        {
+          _hash_batch<1>(entity_to_idx + n, entities.data() + n, entries);
+        }
+        // Compact out duplicate indices, upgrading to exclusive if any duplicate is exclusive
         _entity_idx *ep = entity_to_idx;
-        for(size_t n = 0; n < entities.size(); n++)
+        for(n = 0; n < entities.size(); n++)
         {
-          ep->value = hasher_type()(entities[n].value) % _container_entries;
-          ep->exclusive = entities[n].exclusive;
+          const _entity_idx i = entity_to_idx[n];
           bool skip = false;
-          for(size_t m = 0; m < n; m++)
+          for(_entity_idx *m = entity_to_idx; m < ep; ++m)
           {
-            if(entity_to_idx[m].value == ep->value)
+            if(m->value == i.value)
             {
-              if(ep->exclusive && !entity_to_idx[m].exclusive)
+              if(i.exclusive && !m->exclusive)
               {
-                entity_to_idx[m].exclusive = true;
+                m->exclusive = true;
               }
               skip = true;
+              if(collisions != nullptr)
+              {
+                // Only a collision if no earlier entity is the very same entity
+                bool same = false;
+                for(size_t o = 0; o < n && !same; o++)
+                {
+                  same = (entities[o].value == entities[n].value);
+                }
+                if(!same)
+                {
+                  ++*collisions;
+                }
+              }
+              break;
             }
           }
           if(!skip)
           {
-            ++ep;
+            *ep++ = i;
           }
         }
         return span<_entity_idx>(entity_to_idx, ep - entity_to_idx);
       }
-      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> _lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept final
+      // Claims a free user slot, recovering the spinlocks of any previous user who exited suddenly
+      result<void> _claim_user() noexcept
       {
-        LLFIO_LOG_FUNCTION_CALL(this);
-        std::chrono::steady_clock::time_point began_steady;
-        std::chrono::system_clock::time_point end_utc;
-        if(d)
+        if(_h.flags() & file_handle::flag::byte_lock_insanity)
         {
-          if((d).steady)
+          // Other instances in this process would appear to be dead
+          return success();
+        }
+        auto &users = _users();
+        for(size_t n = 0; n < max_users; n++)
+        {
+          auto lockresult = _h.lock_file_range(_useroffset + n, 1, lock_kind::exclusive, std::chrono::seconds(0));
+          if(!lockresult)
           {
-            began_steady = std::chrono::steady_clock::now();
+            if(lockresult.error() != errc::timed_out)
+            {
+              return std::move(lockresult).error();
+            }
+            continue;
           }
-          else
+          if(users[n].load(std::memory_order_acquire) != 0)
           {
-            end_utc = (d).to_time_point();
+            OUTCOME_TRY(_reap_user(n));
           }
+          users[n].store(1, std::memory_order_release);
+          _hlockuser = std::move(lockresult).value();
+          _user = n;
+          return success();
         }
-        // alloca() always returns 16 byte aligned addresses
-        span<_entity_idx> entity_to_idx(_hash_entities(reinterpret_cast<_entity_idx *>(alloca(sizeof(_entity_idx) * out.entities.size())), out.entities));
-        _hash_index_type &index = _index();
-        // Fire this if an error occurs
-        auto disableunlock = make_scope_exit([&]() noexcept { out.release(); });
-        size_t n;
+        // No free user slots, so my sudden exit cannot be recovered from
+        return success();
+      }
+      // Releases the spinlocks held in a hash index by a user slot whose user exited suddenly
+      void _reap_user(const _index_map &map, size_t user) const noexcept
+      {
+        auto *index = map.index();
+        auto *held = map.held(user);
+        for(size_t n = 0; n < map.entries; n++)
+        {
+          auto h = held[n].exchange(0, std::memory_order_relaxed);
+          if(h != 0)
+          {
+            LLFIO_LOG_WARN(this, "memory_map releasing spinlock held by user which exited without unlocking");
+            if(h < 0)
+            {
+              index[n].unlock();
+            }
+            else
+            {
+              for(; h > 0; h--)
+              {
+                index[n].unlock_shared();
+              }
+            }
+            _wake(static_cast<unsigned>(n));
+          }
+        }
+      }
+      // Releases the spinlocks held by a user slot whose user exited suddenly. Must hold its lock.
+      result<void> _reap_user(size_t user) const noexcept
+      {
+        // Locks can only be held in the current hash index, and the previous one if it is still draining
+        for(;;)
+        {
+          const uint32_t generation = _head().generation.load(std::memory_order_acquire);
+          OUTCOME_TRY(auto &&maps, _indices_for(generation));
+          if(maps.first == nullptr)
+          {
+            continue;  // resized whilst mapping, so retry
+          }
+          if(maps.second != nullptr)
+          {
+            _reap_user(*maps.second, user);
+          }
+          _reap_user(*maps.first, user);
+          break;
+        }
+        _users()[user].store(0, std::memory_order_release);
+        return success();
+      }
+      // Reaps any user holding the spinlock at idx in map which no longer holds its user slot lock
+      void _reap_dead_holders(const _index_map &map, unsigned idx) noexcept
+      {
+        if(_user == _no_user)
+        {
+          return;
+        }
+        auto &users = _users();
+        for(size_t n = 0; n < max_users; n++)
+        {
+          if(n == _user || users[n].load(std::memory_order_acquire) == 0 || map.held(n)[idx].load(std::memory_order_relaxed) == 0)
+          {
+            continue;
+          }
+          auto lockresult = _h.lock_file_range(_useroffset + n, 1, lock_kind::exclusive, std::chrono::seconds(0));
+          if(lockresult)
+          {
+            // Its user no longer holds its lock, so it has gone away
+            if(users[n].load(std::memory_order_acquire) != 0)
+            {
+              (void) _reap_user(n);
+            }
+          }
+        }
+      }
+      // Records in my user slot the acquisition or release of an entity
+      void _record(const _index_map &map, _entity_idx i, bool acquired) const noexcept
+      {
+        if(_user == _no_user)
+        {
+          return;
+        }
+        auto &held = map.held(_user)[i.value];
+        if(i.exclusive)
+        {
+          held.store(static_cast<int16_t>(acquired ? -1 : 0), std::memory_order_relaxed);
+        }
+        else
+        {
+          held.fetch_add(static_cast<int16_t>(acquired ? 1 : -1), std::memory_order_relaxed);
+        }
+      }
+      // Wakes any sleepers on the wait slot of the entity at idx
+      void _wake(unsigned idx) const noexcept
+      {
+        _wait_slot &slot = _waits()[idx % _wait_slots];
+        // Pairs with the fence in _lock_all(), so either we see the sleeper or it sees the unlock
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(slot.waiting.load(std::memory_order_relaxed) != 0)
+        {
+          slot.seq.fetch_add(1, std::memory_order_release);
+          LLFIO_V2_NAMESPACE::detail::ipc_channel_wake(&slot.seq);
+        }
+      }
+      // Unlocks an entity, waking any sleepers on its wait slot
+      void _unlock(const _index_map &map, _entity_idx i) const noexcept
+      {
+        // Sudden exit after unrecording but before unlocking leaks the spinlock, the other
+        // way round would have the spinlock released twice
+        _record(map, i, false);
+        i.exclusive ? map.index()[i.value].unlock() : map.index()[i.value].unlock_shared();
+        _wake(i.value);
+      }
+      // Waits until every spinlock in the hash index previous to that of the odd `generation` is released, then ends the resize
+      result<void> _drain(uint32_t generation, deadline d) noexcept
+      {
+        OUTCOME_TRY(auto &&maps, _indices_for(generation));
+        if(maps.first == nullptr)
+        {
+          return errc::state_not_recoverable;  // we hold the resize lock, so this should never happen
+        }
+        auto &prev = *maps.second;
+        LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+        for(size_t n = 0; n < prev.entries; n++)
+        {
+          // Lockers only pass through the previous hash index now, so once free it stays drained
+          while(!prev.index()[n].try_lock())
+          {
+            _reap_dead_holders(prev, static_cast<unsigned>(n));
+            LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+            std::this_thread::yield();
+          }
+          prev.index()[n].unlock();
+          _wake(static_cast<unsigned>(n));
+        }
+        _head().generation.store(generation + 1, std::memory_order_release);
+        return success();
+      }
+      /* Locks all of entity_to_idx, those marked previous in prev and the rest in cur, spinning,
+      sleeping and reaping dead holders until deadline d. Nothing is held whilst waiting, so
+      lockers waiting on both hash indices cannot deadlock those waiting on one.
+      */
+      result<void> _lock_all(const _index_map &cur, const _index_map *prev, span<_entity_idx> entity_to_idx, entities_guard &out, deadline d, bool spin_not_sleep,
+                             std::chrono::steady_clock::time_point began_steady, std::chrono::system_clock::time_point end_utc) noexcept
+      {
+        auto mapof = [&](_entity_idx i) -> const _index_map & { return i.previous ? *prev : cur; };
+        size_t n, spins = 0, failures = 0;
+        _wait_slot *sleeping = nullptr;
+        uint32_t sleepingseq = 0;
+        auto unsleep = make_scope_exit([&]() noexcept {
+          if(sleeping != nullptr)
+          {
+            sleeping->waiting.fetch_sub(1, std::memory_order_relaxed);
+          }
+        });
         for(;;)
         {
           auto was_contended = static_cast<size_t>(-1);
@@ -339,30 +810,62 @@ namespace algorithm
                 // Now 0 to n needs to be closed
                 for(; n > 0; n--)
                 {
-                  entity_to_idx[n].exclusive ? index[entity_to_idx[n].value].unlock() : index[entity_to_idx[n].value].unlock_shared();
+                  _unlock(mapof(entity_to_idx[n]), entity_to_idx[n]);
                 }
-                entity_to_idx[0].exclusive ? index[entity_to_idx[0].value].unlock() : index[entity_to_idx[0].value].unlock_shared();
+                _unlock(mapof(entity_to_idx[0]), entity_to_idx[0]);
               }
             });
             for(n = 0; n < entity_to_idx.size(); n++)
             {
-              if(!(entity_to_idx[n].exclusive ? index[entity_to_idx[n].value].try_lock() : index[entity_to_idx[n].value].try_lock_shared()))
+              auto &map = mapof(entity_to_idx[n]);
+              if(!(entity_to_idx[n].exclusive ? map.index()[entity_to_idx[n].value].try_lock() : map.index()[entity_to_idx[n].value].try_lock_shared()))
               {
                 was_contended = n;
                 goto failed;
               }
+              _record(map, entity_to_idx[n], true);
             }
             // Everything is locked, exit
             undo.release();
-            disableunlock.release();
             return success();
           }
         failed:
+          if(sleeping != nullptr)
+          {
+            // Having announced myself as a sleeper, and failed again, sleep until an unlock
+            // bumps the slot sequence, or until it is time to check if the holder is still
+            // alive. Failing to sleep simply means spinning.
+            deadline nd(reap_interval);
+            if(d)
+            {
+              if((d).steady)
+              {
+                auto remaining = std::chrono::nanoseconds((d).nsecs) - std::chrono::duration_cast<std::chrono::nanoseconds>(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) - began_steady);
+                if(remaining < reap_interval)
+                {
+                  nd = deadline((remaining.count() < 0) ? std::chrono::nanoseconds(0) : remaining);
+                }
+              }
+              else if(end_utc - std::chrono::system_clock::now() < reap_interval)
+              {
+                nd = d;
+              }
+            }
+            _record_sleep(out);
+            (void) LLFIO_V2_NAMESPACE::detail::ipc_channel_wait(&sleeping->seq, sleepingseq, nd);
+            sleeping->waiting.fetch_sub(1, std::memory_order_relaxed);
+            sleeping = nullptr;
+            _reap_dead_holders(mapof(entity_to_idx[was_contended]), entity_to_idx[was_contended].value);
+          }
+          else if((++failures % spins_before_sleep) == 0)
+          {
+            _reap_dead_holders(mapof(entity_to_idx[was_contended]), entity_to_idx[was_contended].value);
+          }
           if(d)
           {
             if((d).steady)
             {
-              if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
+              if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
               {
                 return errc::timed_out;
               }
@@ -375,6 +878,8 @@ namespace algorithm
               }
             }
           }
+          _record_retry(out);
+          _record_randomisation(out);
           // Move was_contended to front and randomise rest of out.entities
           std::swap(entity_to_idx[was_contended], entity_to_idx[0]);
           auto front = entity_to_idx.begin();
@@ -382,21 +887,126 @@ namespace algorithm
           QUICKCPPLIB_NAMESPACE::algorithm::small_prng::random_shuffle(front, entity_to_idx.end());
           if(!spin_not_sleep)
           {
-            std::this_thread::yield();
+            if(++spins >= spins_before_sleep)
+            {
+              // Announce myself as a sleeper on the contended entity's wait slot, then try once
+              // more before sleeping in case the unlock raced the announcement
+              sleeping = &_waits()[entity_to_idx[0].value % _wait_slots];
+              sleeping->waiting.fetch_add(1, std::memory_order_relaxed);
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+              sleepingseq = sleeping->seq.load(std::memory_order_acquire);
+            }
+            else
+            {
+              _record_sleep(out);
+              std::this_thread::yield();
+            }
           }
         }
         // return success();
       }
+      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> _lock(entities_guard &out, deadline d, bool spin_not_sleep) noexcept final
+      {
+        LLFIO_LOG_FUNCTION_CALL(this);
+        std::chrono::steady_clock::time_point began_steady;
+        std::chrono::system_clock::time_point end_utc;
+        if(d)
+        {
+          if((d).steady)
+          {
+            began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
+          }
+          else
+          {
+            end_utc = (d).to_time_point();
+          }
+        }
+        // Fire this if an error occurs
+        auto disableunlock = make_scope_exit([&]() noexcept { out.release(); });
+        // alloca() always returns 16 byte aligned addresses
+        auto *idxs = reinterpret_cast<_entity_idx *>(alloca(sizeof(_entity_idx) * out.entities.size() * 2));
+        auto &head = _head();
+        for(;;)
+        {
+          const uint32_t generation = head.generation.load(std::memory_order_acquire);
+          OUTCOME_TRY(auto &&maps, _indices_for(generation));
+          if(maps.first == nullptr)
+          {
+            continue;  // resized whilst mapping, so retry
+          }
+          /* If the previous hash index is still draining of locks taken before the resize, wait
+          for the entities there too. Once also locked in the current hash index, nobody else can
+          lock them in either, so the locks in the previous hash index can then be released.
+          */
+          size_t previous = 0;
+          if(maps.second != nullptr)
+          {
+            for(auto &i : _hash_entities(idxs, out.entities, maps.second->entries))
+            {
+              i.previous = true;
+              ++previous;
+            }
+          }
+          size_t collisions = 0;
+          const auto current = _hash_entities(idxs + previous, out.entities, maps.first->entries, &collisions).size();
+          if(collisions > 0)
+          {
+            _collisions.fetch_add(collisions, std::memory_order_relaxed);
+          }
+          span<_entity_idx> entity_to_idx(idxs, previous + current);
+          OUTCOME_TRY(_lock_all(*maps.first, maps.second, entity_to_idx, out, d, spin_not_sleep, began_steady, end_utc));
+          if(previous > 0)
+          {
+            for(const auto &i : entity_to_idx)
+            {
+              if(i.previous)
+              {
+                _unlock(*maps.second, i);
+              }
+            }
+          }
+          // If a resize began whilst locking, those locking after it may not have seen my locks, so retry
+          if((head.generation.load(std::memory_order_acquire) >> 1) != (generation >> 1))
+          {
+            for(const auto &i : entity_to_idx)
+            {
+              if(!i.previous)
+              {
+                _unlock(*maps.first, i);
+              }
+            }
+            continue;
+          }
+          out.hint = maps.first->number + 1;
+          disableunlock.release();
+          return success();
+        }
+      }
 
     public:
-      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock(entities_type entities, unsigned long long /*unused*/) noexcept final
+      LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock(entities_type entities, unsigned long long hint) noexcept final
       {
         LLFIO_LOG_FUNCTION_CALL(this);
-        span<_entity_idx> entity_to_idx(_hash_entities(reinterpret_cast<_entity_idx *>(alloca(sizeof(_entity_idx) * entities.size())), entities));
-        _hash_index_type &index = _index();
+        // The hint is one more than the number of the hash index locked in, zero meaning the current one
+        _index_map *map = nullptr;
+        if(hint != 0)
+        {
+          auto r = _index_for(static_cast<uint32_t>(hint - 1));
+          map = r ? r.value() : nullptr;
+        }
+        else
+        {
+          map = _current.load(std::memory_order_acquire);
+        }
+        if(map == nullptr)
+        {
+          LLFIO_LOG_FATAL(this, "memory_map::unlock() could not find the hash index locked in");
+          abort();
+        }
+        span<_entity_idx> entity_to_idx(_hash_entities(reinterpret_cast<_entity_idx *>(alloca(sizeof(_entity_idx) * entities.size())), entities, map->entries));
         for(const auto &i : entity_to_idx)
         {
-          i.exclusive ? index[i.value].unlock() : index[i.value].unlock_shared();
+          _unlock(*map, i);
         }
       }
     };
@@ -110,6 +110,9 @@ namespace algorithm
     - Sudden process exit with lock held is recovered from.
     - Sudden power loss during use is recovered from.
     - Safe for multithreaded usage.
+    - In-process shared locks of entities already held shared are reader biased: they publish
+    themselves in a table of visible readers without taking any mutex, so they scale with threads.
+    Exclusive lockers revoke the bias and wait for the visible readers to leave.
 
     Caveats:
     - When entities being locked is more than one, the algorithm places the contending lock at the
@@ -25,11 +25,18 @@ Distributed under the Boost Software License, Version 1.0.
 #ifndef LLFIO_ALGORITHM_SUMMARIZE_HPP
 #define LLFIO_ALGORITHM_SUMMARIZE_HPP
 
+#include "path_table.hpp"
 #include "traverse.hpp"
 
+#include "../file_handle.hpp"
 #include "../stat.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 //! \file summarize.hpp Provides a directory tree summary algorithm.
 
@@ -47,6 +54,8 @@ namespace algorithm
       return stat_t::want::dev | stat_t::want::type | stat_t::want::size | stat_t::want::allocated | stat_t::want::blocks;
     }
     template <class T> using map_type = std::unordered_map<T, size_t>;
+    //! The number of buckets in `sizes`
+    static constexpr size_t size_buckets = 65;
     spinlock _lock;
     size_t directory_opens_failed{0};  //!< The number of directories which could not be opened.
 
@@ -58,6 +67,64 @@ namespace algorithm
     handle::extent_type file_blocks{0};       //!< The sum of file allocated blocks.
     handle::extent_type directory_blocks{0};  //!< The sum of directory allocated blocks.
     size_t max_depth{0};                      //!< The maximum depth of the hierarchy
+    /*! The number of items which are not directories with maximum extent of each number of
+    significant bits, so bucket zero counts the empty, bucket one those of one byte, bucket two
+    those of two to three bytes, and so on.
+    */
+    std::array<size_t, size_buckets> sizes{};
+
+    /* Counts not yet folded into `devs` and `types`, so the accumulation of each item neither
+    hashes nor allocates. As almost every item of a directory is upon the same device as its
+    neighbour, a run of items upon one device is counted before being added to `devs`.
+    */
+    std::array<size_t, 16> _type_counts{};  // indexed by type plus one
+    uint64_t _run_dev{0};
+    size_t _run_dev_count{0};
+    // The accumulators of each thread of a summary in progress
+    std::vector<std::shared_ptr<traversal_summary>> _thread_summaries;
+
+    static size_t _type_index(filesystem::file_type type) noexcept { return static_cast<size_t>(static_cast<int>(type) + 1); }
+    //! Counts an item upon device `dev`
+    void _add_dev(uint64_t dev, size_t count = 1)
+    {
+      if(_run_dev_count != 0 && _run_dev != dev)
+      {
+        devs[_run_dev] += _run_dev_count;
+        _run_dev_count = 0;
+      }
+      _run_dev = dev;
+      _run_dev_count += count;
+    }
+    //! Counts an item of type `type`
+    void _add_type(filesystem::file_type type, size_t count = 1)
+    {
+      const size_t idx = _type_index(type);
+      if(idx < _type_counts.size())
+      {
+        _type_counts[idx] += count;
+      }
+      else
+      {
+        types[type] += count;
+      }
+    }
+    //! Folds the pending counts into `devs` and `types`
+    void _fold()
+    {
+      if(_run_dev_count != 0)
+      {
+        devs[_run_dev] += _run_dev_count;
+        _run_dev_count = 0;
+      }
+      for(size_t n = 0; n < _type_counts.size(); n++)
+      {
+        if(_type_counts[n] != 0)
+        {
+          types[static_cast<filesystem::file_type>(static_cast<int>(n) - 1)] += _type_counts[n];
+          _type_counts[n] = 0;
+        }
+      }
+    }
 
     //! Adds another summary to this
     traversal_summary &operator+=(const traversal_summary &o)
@@ -68,10 +135,22 @@ namespace algorithm
       {
         devs[i.first] += i.second;
       }
+      if(o._run_dev_count != 0)
+      {
+        _add_dev(o._run_dev, o._run_dev_count);
+      }
       for(auto &i : o.types)
       {
         types[i.first] += i.second;
       }
+      for(size_t n = 0; n < _type_counts.size(); n++)
+      {
+        _type_counts[n] += o._type_counts[n];
+      }
+      for(size_t n = 0; n < size_buckets; n++)
+      {
+        sizes[n] += o.sizes[n];
+      }
       size += o.size;
       allocated += o.allocated;
       file_blocks += o.file_blocks;
@@ -92,6 +171,30 @@ namespace algorithm
   */
   struct summarize_visitor : public traverse_visitor
   {
+    /*! \brief Returns the accumulator of the calling thread for the summary `state`, which
+    `finished()` adds to `state`. Only the calling thread may use it, so it needs no lock.
+    */
+    static traversal_summary &thread_summary(traversal_summary *state)
+    {
+      static thread_local std::pair<traversal_summary *, std::weak_ptr<traversal_summary>> mine;
+      if(mine.first == state)
+      {
+        auto ret = mine.second.lock();
+        if(ret)
+        {
+          return *ret;
+        }
+      }
+      auto ret = std::make_shared<traversal_summary>();
+      ret->want = state->want;
+      {
+        lock_guard<spinlock> g(state->_lock);
+        state->_thread_summaries.push_back(ret);
+      }
+      mine = {state, ret};
+      return *ret;
+    }
+
     static result<void> accumulate(traversal_summary &acc, traversal_summary *state, const directory_handle *dirh, directory_entry &entry,
                                    stat_t::want already_have_metadata)
     {
@@ -111,15 +214,24 @@ namespace algorithm
       }
       if(state->want & stat_t::want::dev)
       {
-        acc.devs[entry.stat.st_dev]++;
+        acc._add_dev(entry.stat.st_dev);
       }
       if(state->want & stat_t::want::type)
       {
-        acc.types[entry.stat.st_type]++;
+        acc._add_type(entry.stat.st_type);
       }
       if(state->want & stat_t::want::size)
       {
         acc.size += entry.stat.st_size;
+        if(entry.stat.st_type != filesystem::file_type::directory)
+        {
+          size_t bits = 0;
+          for(auto v = entry.stat.st_size; v != 0; v >>= 1U)
+          {
+            bits++;
+          }
+          acc.sizes[bits]++;
+        }
       }
       if(state->want & stat_t::want::allocated)
       {
@@ -152,19 +264,38 @@ namespace algorithm
       state->directory_opens_failed++;
       return success();  // ignore failure to enter
     }
-    //! This override implements the summary
-    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    //! Accumulates all of the entries of a directory just enumerated into `acc`
+    static result<void> accumulate_contents(traversal_summary &acc, traversal_summary *state, const directory_handle &dirh, directory_handle::buffers_type &contents)
     {
-      try
+      if((state->want & contents.metadata()) != state->want)
+      {
+        // Fetch all the missing metadata at once, which on Linux is one statx() per entry
+        OUTCOME_TRY(auto &&filled, dirh.stat_entries(contents, state->want & ~contents.metadata()));
+        for(size_t n = 0; n < contents.size(); n++)
+        {
+          // Entries which could not be filled are retried by accumulate(), which reports the failure
+          OUTCOME_TRY(accumulate(acc, state, &dirh, contents[n], filled[n] ? (contents.metadata() | state->want) : contents.metadata()));
+        }
+      }
+      else
       {
-        auto *state = (traversal_summary *) data;
-        traversal_summary acc;
-        acc.max_depth = depth;
         for(auto &entry : contents)
         {
           OUTCOME_TRY(accumulate(acc, state, &dirh, entry, contents.metadata()));
         }
-        state->operator+=(acc);
+      }
+      return success();
+    }
+
+    //! This override implements the summary into the accumulator of the calling thread
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      try
+      {
+        auto *state = (traversal_summary *) data;
+        auto &acc = thread_summary(state);
+        acc.max_depth = std::max(acc.max_depth, depth);
+        OUTCOME_TRY(accumulate_contents(acc, state, dirh, contents));
         return success();
       }
       catch(...)
@@ -172,6 +303,30 @@ namespace algorithm
         return error_from_exception();
       }
     }
+
+    //! This override adds the accumulators of every thread to the summary
+    virtual result<size_t> finished(void *data, result<size_t> result) noexcept override
+    {
+      try
+      {
+        auto *state = (traversal_summary *) data;
+        std::vector<std::shared_ptr<traversal_summary>> summaries;
+        {
+          lock_guard<spinlock> g(state->_lock);
+          summaries.swap(state->_thread_summaries);
+        }
+        for(auto &i : summaries)
+        {
+          state->operator+=(*i);
+        }
+        state->_fold();
+        return result;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
   };
 
   /*! \brief Summarise the directory identified `dirh`, and everything therein.
@@ -183,7 +338,9 @@ namespace algorithm
   better. The default summarises all possible metadata.
 
   This is a trivial implementation on top of `algorithm::traverse()`, indeed it is
-  implemented entirely as header code. You should review the documentation for
+  implemented entirely as header code. Each thread accumulates into its own summary
+  without locking or hashing per item, and these are added together when the traversal
+  finishes. You should review the documentation for
   `algorithm::traverse()`, as this algorithm is entirely implemented using that algorithm.
   */
   inline result<traversal_summary> summarize(const path_handle &dirh, stat_t::want want = traversal_summary::default_metadata(),
@@ -204,6 +361,413 @@ namespace algorithm
     return state;
   }
 
+  /*! \brief The visitor used by `summarize()` into a `path_table`, which additionally interns
+  the path of every item summarised.
+  */
+  struct interning_summarize_visitor : public summarize_visitor
+  {
+    path_table *paths{nullptr};
+    const path_handle *rootdirh{nullptr};
+    std::atomic<size_t> rootdirpathlen{0};
+
+    interning_summarize_visitor(path_table *_paths, const path_handle *_rootdirh)
+        : paths(_paths)
+        , rootdirh(_rootdirh)
+    {
+    }
+
+    //! This override implements the summary, and then interns the paths of the contents
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      try
+      {
+        OUTCOME_TRY(summarize_visitor::post_enumeration(data, dirh, contents, depth));
+        if(!contents.empty())
+        {
+          OUTCOME_TRY(auto &&dirhpath, relative_directory_path(*rootdirh, rootdirpathlen, dirh));
+          OUTCOME_TRY(auto &&parent, paths->intern(dirhpath));
+          std::vector<path_table::id_type> ids(contents.size());
+          OUTCOME_TRY(paths->intern(parent, contents, ids));
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief Summarise the directory identified `dirh`, and everything therein, interning the
+  path of every item summarised into `paths`.
+
+  This is identical to `summarize()`, and additionally records the tree summarised into the compact
+  `paths`, relative to `dirh`. `paths` may already contain paths, for example from a previous
+  summary of the same tree.
+  */
+  inline result<traversal_summary> summarize(const path_handle &dirh, path_table &paths, stat_t::want want = traversal_summary::default_metadata(),
+                                             size_t threads = 0, bool force_slow_path = false) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    interning_summarize_visitor visitor(&paths, &dirh);
+    OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+    visitor.rootdirpathlen.store(dirhpath.native().size() + 1, std::memory_order_relaxed);
+    return summarize(dirh, want, &visitor, threads, force_slow_path);
+  }
+
+  /*! \brief A persistable cache of the summary of the entries within each directory, keyed by
+  the device and inode of the directory, for incremental `summarize()`.
+
+  A record is reused whilst the modification and status change timestamps of its directory
+  are unchanged, which is the case until an entry is added to, removed from or renamed within
+  that directory. Note that the timestamps of a directory do not change when the contents or
+  metadata of the files within it change, so an incremental summary does not notice files
+  being extended or truncated in place until something else changes their directory. If you
+  need that, only use the cache for some of your summaries.
+
+  Records not visited by the most recent incremental `summarize()` are discarded, so you
+  should use a separate cache for each directory hierarchy summarised.
+  */
+  class traversal_summary_cache
+  {
+    friend struct incremental_summarize_visitor;
+    friend inline result<traversal_summary> summarize(const path_handle &dirh, traversal_summary_cache &cache, stat_t::want want, size_t threads,
+                                                      bool force_slow_path) noexcept;
+
+    struct _key_type
+    {
+      uint64_t dev{0}, ino{0};
+      bool operator==(const _key_type &o) const noexcept { return dev == o.dev && ino == o.ino; }
+    };
+    struct _key_hasher
+    {
+      size_t operator()(const _key_type &k) const noexcept { return static_cast<size_t>(k.ino ^ (k.dev * 0x9E3779B97F4A7C15ULL)); }
+    };
+    struct _record_type
+    {
+      std::chrono::system_clock::time_point mtim, ctim;
+      traversal_summary summary;
+      size_t generation{0};
+    };
+    mutable spinlock _lock;
+    std::unordered_map<_key_type, _record_type, _key_hasher> _records;
+    size_t _generation{0};
+    std::atomic<size_t> _hits{0}, _misses{0};
+
+    static constexpr uint64_t _magic = 0x3243535446494c4cULL;  // "LLFITSC2"
+
+    void _begin() noexcept
+    {
+      lock_guard<spinlock> g(_lock);
+      ++_generation;
+      _hits = 0;
+      _misses = 0;
+    }
+    void _prune() noexcept
+    {
+      lock_guard<spinlock> g(_lock);
+      for(auto it = _records.begin(); it != _records.end();)
+      {
+        if(it->second.generation != _generation)
+        {
+          it = _records.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+  public:
+    //! Default constructor
+    traversal_summary_cache() = default;
+    //! Move constructor
+    traversal_summary_cache(traversal_summary_cache &&o) noexcept
+        : _records(std::move(o._records))
+        , _generation(o._generation)
+    {
+    }
+    traversal_summary_cache &operator=(traversal_summary_cache &&) = delete;
+    ~traversal_summary_cache() = default;
+
+    //! The number of directories whose summary is cached
+    size_t size() const noexcept
+    {
+      lock_guard<spinlock> g(_lock);
+      return _records.size();
+    }
+    //! Discards all cached summaries
+    void clear() noexcept
+    {
+      lock_guard<spinlock> g(_lock);
+      _records.clear();
+    }
+    //! The number of directories whose cached summary was reused by the most recent `summarize()`
+    size_t hits() const noexcept { return _hits.load(std::memory_order_relaxed); }
+    //! The number of directories which had to be summarised by the most recent `summarize()`
+    size_t misses() const noexcept { return _misses.load(std::memory_order_relaxed); }
+
+    /*! \brief Writes the cache to the file `path` relative to `base`, replacing any existing contents.
+
+    The format is native endian and is intended to be loaded on the same machine.
+    \errors Any of the values `file_handle::file()`, `file_handle::truncate()` and `file_handle::write()` can return.
+    */
+    result<void> save(const path_handle &base, path_view path) const noexcept
+    {
+      try
+      {
+        std::vector<byte> buffer;
+        auto append = [&](uint64_t v) {
+          const auto *p = reinterpret_cast<const byte *>(&v);
+          buffer.insert(buffer.end(), p, p + sizeof(v));
+        };
+        auto to_ns = [](std::chrono::system_clock::time_point tp) {
+          return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count());
+        };
+        {
+          lock_guard<spinlock> g(_lock);
+          append(_magic);
+          append(_records.size());
+          for(const auto &i : _records)
+          {
+            const auto &summary = i.second.summary;
+            append(i.first.dev);
+            append(i.first.ino);
+            append(to_ns(i.second.mtim));
+            append(to_ns(i.second.ctim));
+            append(static_cast<uint64_t>(static_cast<unsigned>(summary.want)));
+            append(summary.size);
+            append(summary.allocated);
+            append(summary.file_blocks);
+            append(summary.directory_blocks);
+            append(summary.max_depth);
+            append(summary.devs.size());
+            for(const auto &d : summary.devs)
+            {
+              append(d.first);
+              append(d.second);
+            }
+            append(summary.types.size());
+            for(const auto &t : summary.types)
+            {
+              append(static_cast<uint64_t>(t.first));
+              append(t.second);
+            }
+            // Only the buckets in use
+            append(static_cast<uint64_t>(std::count_if(summary.sizes.begin(), summary.sizes.end(), [](size_t c) { return c != 0; })));
+            for(size_t b = 0; b < traversal_summary::size_buckets; b++)
+            {
+              if(summary.sizes[b] != 0)
+              {
+                append(b);
+                append(summary.sizes[b]);
+              }
+            }
+          }
+        }
+        OUTCOME_TRY(auto &&fh, file_handle::file(base, path, file_handle::mode::write, file_handle::creation::if_needed));
+        OUTCOME_TRY(fh.truncate(0));
+        OUTCOME_TRY(auto &&written, fh.write(0, {{buffer.data(), buffer.size()}}));
+        if(written != buffer.size())
+        {
+          return errc::no_space_on_device;
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Reads a cache previously written by `save()` from the file `path` relative to `base`.
+
+    \errors Any of the values `file_handle::file()` and `file_handle::read()` can return.
+    `errc::illegal_byte_sequence` if the file is not a cache written by `save()`.
+    */
+    static result<traversal_summary_cache> load(const path_handle &base, path_view path) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&fh, file_handle::file(base, path));
+        OUTCOME_TRY(auto &&length, fh.maximum_extent());
+        std::vector<byte> buffer(static_cast<size_t>(length));
+        OUTCOME_TRY(auto &&read, fh.read(0, {{buffer.data(), buffer.size()}}));
+        if(read != buffer.size())
+        {
+          return errc::illegal_byte_sequence;
+        }
+        size_t offset = 0;
+        bool ok = true;
+        auto take = [&]() -> uint64_t {
+          uint64_t v = 0;
+          if(offset + sizeof(v) > buffer.size())
+          {
+            ok = false;
+            return v;
+          }
+          memcpy(&v, buffer.data() + offset, sizeof(v));
+          offset += sizeof(v);
+          return v;
+        };
+        auto from_ns = [](uint64_t ns) {
+          return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(static_cast<int64_t>(ns))));
+        };
+        if(take() != _magic)
+        {
+          return errc::illegal_byte_sequence;
+        }
+        traversal_summary_cache ret;
+        const uint64_t count = take();
+        for(uint64_t n = 0; ok && n < count; n++)
+        {
+          _key_type key;
+          key.dev = take();
+          key.ino = take();
+          _record_type record;
+          record.mtim = from_ns(take());
+          record.ctim = from_ns(take());
+          auto &summary = record.summary;
+          summary.want = static_cast<stat_t::want>(static_cast<unsigned>(take()));
+          summary.size = take();
+          summary.allocated = take();
+          summary.file_blocks = take();
+          summary.directory_blocks = take();
+          summary.max_depth = static_cast<size_t>(take());
+          for(uint64_t devs = take(); ok && devs > 0; devs--)
+          {
+            const uint64_t dev = take();
+            summary.devs[dev] = static_cast<size_t>(take());
+          }
+          for(uint64_t types = take(); ok && types > 0; types--)
+          {
+            const auto type = static_cast<filesystem::file_type>(take());
+            summary.types[type] = static_cast<size_t>(take());
+          }
+          for(uint64_t buckets = take(); ok && buckets > 0; buckets--)
+          {
+            const uint64_t bucket = take();
+            if(bucket >= traversal_summary::size_buckets)
+            {
+              return errc::illegal_byte_sequence;
+            }
+            summary.sizes[bucket] = static_cast<size_t>(take());
+          }
+          ret._records.emplace(key, std::move(record));
+        }
+        if(!ok)
+        {
+          return errc::illegal_byte_sequence;
+        }
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief The visitor used by incremental `summarize()`, which reuses the cached summary of
+  the entries of each directory whose timestamps are unchanged instead of fetching their metadata.
+
+  Directories are still opened and enumerated, as changes deeper in the hierarchy do not change
+  the timestamps of the directories above, but the cost of fetching the metadata of every entry,
+  usually by far the largest cost of a summary, is only paid for changed directories.
+  */
+  struct incremental_summarize_visitor : public summarize_visitor
+  {
+    traversal_summary_cache *cache{nullptr};
+
+    explicit incremental_summarize_visitor(traversal_summary_cache *_cache)
+        : cache(_cache)
+    {
+    }
+
+    // The timestamps of the directory about to be enumerated by this thread
+    static stat_t &_directory_stat() noexcept
+    {
+      static thread_local stat_t v(nullptr);
+      return v;
+    }
+
+    /*! This override fetches the timestamps of the directory before it is enumerated,
+    so changes made during enumeration are not missed by the next incremental summary.
+    */
+    virtual result<bool> pre_enumeration(void *data, const directory_handle &dirh, size_t depth) noexcept override
+    {
+      (void) data;
+      (void) depth;
+      auto &st = _directory_stat();
+      st = stat_t(nullptr);
+      OUTCOME_TRY(st.fill(dirh, stat_t::want::dev | stat_t::want::ino | stat_t::want::mtim | stat_t::want::ctim));
+      return true;
+    }
+    //! This override reuses the cached summary of the directory if it is unchanged
+    virtual result<void> post_enumeration(void *data, const directory_handle &dirh, directory_handle::buffers_type &contents, size_t depth) noexcept override
+    {
+      try
+      {
+        auto *state = (traversal_summary *) data;
+        const stat_t st = _directory_stat();
+        const traversal_summary_cache::_key_type key{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino)};
+        {
+          lock_guard<spinlock> g(cache->_lock);
+          auto it = cache->_records.find(key);
+          if(it != cache->_records.end() && it->second.mtim == st.st_mtim && it->second.ctim == st.st_ctim && it->second.summary.want == state->want)
+          {
+            it->second.generation = cache->_generation;
+            it->second.summary.max_depth = depth;
+            thread_summary(state) += it->second.summary;
+            cache->_hits.fetch_add(1, std::memory_order_relaxed);
+            return success();
+          }
+        }
+        traversal_summary acc;
+        acc.want = state->want;
+        acc.max_depth = depth;
+        OUTCOME_TRY(accumulate_contents(acc, state, dirh, contents));
+        acc._fold();
+        thread_summary(state) += acc;
+        cache->_misses.fetch_add(1, std::memory_order_relaxed);
+        // traversal_summary is not assignable, so replace any stale record
+        lock_guard<spinlock> g(cache->_lock);
+        cache->_records.erase(key);
+        cache->_records.emplace(key, traversal_summary_cache::_record_type{st.st_mtim, st.st_ctim, std::move(acc), cache->_generation});
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+  };
+
+  /*! \brief Incrementally summarise the directory identified `dirh`, and everything therein,
+  reusing the summaries in `cache` of the entries of directories which have not changed since
+  the last summary, and updating `cache` with the summaries of those which have.
+
+  The results are the same as `summarize()` except that files modified in place within directories
+  whose timestamps have not changed are summarised as they were, see `traversal_summary_cache`.
+  Persist `cache` between runs using `traversal_summary_cache::save()` and `load()`.
+  */
+  inline result<traversal_summary> summarize(const path_handle &dirh, traversal_summary_cache &cache, stat_t::want want = traversal_summary::default_metadata(),
+                                             size_t threads = 0, bool force_slow_path = false) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    incremental_summarize_visitor visitor(&cache);
+    cache._begin();
+    result<traversal_summary> state(in_place_type<traversal_summary>);
+    state.assume_value().want = want;
+    directory_entry entry{{}, stat_t(nullptr)};
+    OUTCOME_TRY(entry.stat.fill(dirh, want));
+    OUTCOME_TRY(summarize_visitor::accumulate(state.assume_value(), &state.assume_value(), nullptr, entry, want));
+    OUTCOME_TRY(traverse(dirh, &visitor, threads, &state.assume_value(), force_slow_path));
+    cache._prune();
+    return state;
+  }
+
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
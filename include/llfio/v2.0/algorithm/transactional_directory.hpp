@@ -0,0 +1,744 @@
+/* Atomic durable updates of many files within a directory at once
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_TRANSACTIONAL_DIRECTORY_HPP
+#define LLFIO_ALGORITHM_TRANSACTIONAL_DIRECTORY_HPP
+
+#include "../directory_handle.hpp"
+#include "../file_handle.hpp"
+#include "../utils.hpp"
+#include "shared_fs_mutex/safe_byte_ranges.hpp"
+
+#include "quickcpplib/algorithm/hash.hpp"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+//! \file transactional_directory.hpp Provides atomic durable updates of many files within a directory at once.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief A directory of files, many of which can be replaced or removed in a single atomic and
+  durable transaction, by many threads and processes concurrently.
+
+  This is the design of the atomic updates workshop for AFIO v1, generalised to many files. The new
+  contents of each file are written into a new inode, from `file_handle::temp_inode()` where the
+  filing system supports it, which `commit()` makes durable with a `barrier()`, and then renames
+  over the file being replaced. Readers never see a partially written file, and handles open on the
+  old contents keep seeing them.
+
+  Renaming many files is not atomic, so before any renames `commit()` writes a small journal listing
+  them, and the identities of the new inodes, and syncs the directory. That sync is the commit
+  point: if the process or the system dies after it, `open()` completes the renames left undone,
+  and if before it, `open()` discards the new inodes. `commit()` returns after a second sync of the
+  directory makes the renames durable. So a transaction costs a barrier per file written, two
+  directory syncs and one batch of renames using `directory_handle::relink_entries()`.
+
+  The files in a transaction are locked for exclusive access with a `shared_fs_mutex::safe_byte_ranges`
+  on a lock file within the directory, so transactions on the same files are serialised, and
+  `lock_shared()` lets readers see the files of a transaction either all before it or all after.
+  Transactions on different files proceed concurrently. Recovery only happens when no other process
+  has the directory open.
+
+  Files are named by leafnames which may not begin with a period, as names beginning with a period
+  are used by the implementation.
+  */
+  class transactional_directory
+  {
+  public:
+    using mutex_type = shared_fs_mutex::safe_byte_ranges;
+    using entity_type = shared_fs_mutex::shared_fs_mutex::entity_type;
+
+    //! Statistics about the use of the directory
+    struct statistics
+    {
+      uint64_t commits{0};                   //!< Transactions committed
+      uint64_t files_written{0};             //!< Files replaced by committed transactions
+      uint64_t files_removed{0};             //!< Files removed by committed transactions
+      uint64_t transactions_recovered{0};    //!< Transactions interrupted after their commit point, and completed by `open()`
+      uint64_t transactions_rolled_back{0};  //!< Transactions interrupted before their commit point, and discarded by `open()`
+    };
+
+    /*! \brief A set of replacements and removals of files, to be committed atomically.
+     */
+    class transaction
+    {
+      friend class transactional_directory;
+      struct _update
+      {
+        filesystem::path leafname;
+        filesystem::path tempname;  // empty if anonymous or removing
+        file_handle fh;             // closed if removing
+        bool remove{false};
+      };
+      transactional_directory *_parent{nullptr};
+      std::vector<std::unique_ptr<_update>> _updates;  // pointers to the handles returned by write() must stay valid
+
+      result<_update *> _update_for(path_view leafname)
+      {
+        auto path = leafname.path();
+        if(!_valid_leafname(path))
+        {
+          return errc::invalid_argument;
+        }
+        for(auto &u : _updates)
+        {
+          if(u->leafname == path)
+          {
+            // A later update of the same file replaces the earlier one
+            OUTCOME_TRY(_discard(*u));
+            u->remove = false;
+            return u.get();
+          }
+        }
+        _updates.push_back(std::unique_ptr<_update>(new _update{std::move(path), {}, {}, false}));
+        return _updates.back().get();
+      }
+      result<void> _discard(_update &u) noexcept
+      {
+        if(!u.tempname.empty())
+        {
+          const path_view name(u.tempname);
+          OUTCOME_TRY(auto &&unlinked, _parent->_dirh.unlink_entries({&name, 1}));
+          (void) unlinked;
+          u.tempname.clear();
+        }
+        if(u.fh.is_valid())
+        {
+          OUTCOME_TRY(u.fh.close());
+        }
+        return success();
+      }
+
+    public:
+      //! Constructs an empty transaction, which cannot be committed
+      transaction() = default;
+      //! Constructs an empty transaction on `parent`
+      explicit transaction(transactional_directory &parent) noexcept
+          : _parent(&parent)
+      {
+      }
+      transaction(const transaction &) = delete;
+      transaction(transaction &&o) noexcept
+          : _parent(o._parent)
+          , _updates(std::move(o._updates))
+      {
+        o._updates.clear();
+      }
+      transaction &operator=(const transaction &) = delete;
+      transaction &operator=(transaction &&o) noexcept
+      {
+        if(this != &o)
+        {
+          this->~transaction();
+          new(this) transaction(std::move(o));
+        }
+        return *this;
+      }
+      //! Discards any updates not committed
+      ~transaction() { discard(); }
+
+      //! The number of files replaced or removed by this transaction.
+      size_t size() const noexcept { return _updates.size(); }
+      //! True if this transaction does nothing.
+      bool empty() const noexcept { return _updates.empty(); }
+
+      /*! \brief Returns a new inode which will replace the file `leafname` when this transaction is
+      committed, into which its new contents should be written. The handle remains valid until the
+      transaction is committed or discarded.
+
+      \errors `errc::invalid_argument` if `leafname` is not a valid name within the directory, any of
+      the values `file_handle::temp_inode()` or `file_handle::file()` can return.
+      */
+      result<file_handle *> write(path_view leafname) noexcept
+      {
+        try
+        {
+          if(_parent == nullptr)
+          {
+            return errc::invalid_argument;
+          }
+          OUTCOME_TRY(auto &&u, _update_for(leafname));
+#ifdef __linux__
+          auto fh = file_handle::temp_inode(_parent->_dirh);
+          if(fh && (fh.value().flags() & file_handle::flag::anonymous_inode))
+          {
+            u->fh = std::move(fh).value();
+            return &u->fh;
+          }
+          // This filing system can't do O_TMPFILE, so the inode must be named
+#endif
+          auto tempname = _temp_leafname(".tmp");
+          OUTCOME_TRY(auto &&named, file_handle::file(_parent->_dirh, tempname, file_handle::mode::write, file_handle::creation::only_if_not_exist));
+          u->fh = std::move(named);
+          u->tempname = std::move(tempname);
+          return &u->fh;
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }
+      /*! \brief Replaces the file `leafname` with one containing `contents` when this transaction is
+      committed.
+
+      \errors Any of the values the other overload of `write()` or `file_handle::write()` can return.
+      */
+      result<void> write(path_view leafname, file_handle::const_buffers_type contents) noexcept
+      {
+        OUTCOME_TRY(auto &&fh, write(leafname));
+        OUTCOME_TRY(fh->write({contents, 0}));
+        return success();
+      }
+      /*! \brief Removes the file `leafname`, if it exists, when this transaction is committed.
+
+      \errors `errc::invalid_argument` if `leafname` is not a valid name within the directory.
+      */
+      result<void> remove(path_view leafname) noexcept
+      {
+        try
+        {
+          if(_parent == nullptr)
+          {
+            return errc::invalid_argument;
+          }
+          OUTCOME_TRY(auto &&u, _update_for(leafname));
+          u->remove = true;
+          return success();
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }
+      //! Discards all the updates of this transaction, deleting any new inodes.
+      void discard() noexcept
+      {
+        for(auto &u : _updates)
+        {
+          (void) _discard(*u);
+        }
+        _updates.clear();
+      }
+    };
+
+    //! A shared lock of some files, during which no transaction on them can commit
+    class read_lock
+    {
+      friend class transactional_directory;
+      std::vector<entity_type> _entities;
+      shared_fs_mutex::shared_fs_mutex::entities_guard _guard;
+
+    public:
+      read_lock() = default;
+      //! Unlocks the files early.
+      void unlock() noexcept { _guard.unlock(); }
+    };
+
+  private:
+    struct _journal_header
+    {
+      uint64_t hash[2];  // of everything after it
+      uint64_t count;    // of entries
+      uint64_t reserved;
+    };
+    struct _journal_entry
+    {
+      uint64_t unique_id[2];  // of the new inode
+      uint32_t tempname_bytes;  // zero if removing
+      uint32_t leafname_bytes;
+    };
+
+    directory_handle _dirh;
+    mutex_type _mutex;
+    shared_fs_mutex::shared_fs_mutex::entities_guard _in_use;  // shared lock of entity zero whilst open
+    mutable std::mutex _lock;
+    statistics _stats;
+
+    transactional_directory(directory_handle &&dirh, mutex_type &&mutex) noexcept
+        : _dirh(std::move(dirh))
+        , _mutex(std::move(mutex))
+    {
+    }
+
+    static bool _valid_leafname(const filesystem::path &leafname) noexcept
+    {
+      const auto &s = leafname.native();
+      if(s.empty() || s[0] == '.')
+      {
+        return false;
+      }
+      for(auto c : s)
+      {
+        if(c == '/' || c == '\\' || c == 0)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    static filesystem::path _temp_leafname(const char *extension)
+    {
+      std::string ret(".");
+      ret.append(utils::random_string(32));
+      ret.append(extension);
+      return ret;
+    }
+    static bool _is_temp_leafname(const filesystem::path::string_type &s, const char *extension) noexcept
+    {
+      const size_t len = strlen(extension);
+      if(s.size() != 1 + 64 + len || s[0] != '.')
+      {
+        return false;
+      }
+      for(size_t n = 0; n < len; n++)
+      {
+        if(s[1 + 64 + n] != (filesystem::path::value_type) extension[n])
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+    entity_type _entity_for(const filesystem::path &leafname, bool exclusive) noexcept
+    {
+      const auto &s = leafname.native();
+      auto ret = _mutex.entity_from_buffer(reinterpret_cast<const char *>(s.data()), s.size() * sizeof(s[0]), exclusive);
+      if(ret.value == 0)
+      {
+        // Entity zero is held shared by everyone with the directory open
+        ret.value = 1;
+      }
+      return ret;
+    }
+    static void _append(std::string &out, const void *data, size_t bytes) { out.append(reinterpret_cast<const char *>(data), bytes); }
+    static fs_handle::unique_id_type _to_unique_id(const uint64_t (&v)[2]) noexcept
+    {
+      fs_handle::unique_id_type ret;
+      ret.as_longlongs[0] = v[0];
+      ret.as_longlongs[1] = v[1];
+      return ret;
+    }
+
+    struct _journal
+    {
+      struct entry
+      {
+        fs_handle::unique_id_type unique_id;
+        filesystem::path tempname, leafname;
+      };
+      std::vector<entry> entries;
+    };
+    // Returns an empty journal if it is torn
+    result<_journal> _read_journal(const filesystem::path &name)
+    {
+      OUTCOME_TRY(auto &&fh, file_handle::file(_dirh, name, file_handle::mode::read));
+      OUTCOME_TRY(auto &&length, fh.maximum_extent());
+      std::string buffer((size_t) length, 0);
+      OUTCOME_TRY(auto &&read, fh.read(0, {{reinterpret_cast<byte *>(&buffer[0]), buffer.size()}}));
+      _journal ret;
+      _journal_header header;
+      if(read < sizeof(header))
+      {
+        return ret;
+      }
+      memcpy(&header, buffer.data(), sizeof(header));
+      const auto hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(buffer.data() + 16, read - 16);
+      if(hash.as_longlongs[0] != header.hash[0] || hash.as_longlongs[1] != header.hash[1])
+      {
+        return ret;
+      }
+      using char_type = filesystem::path::value_type;
+      size_t offset = sizeof(header);
+      for(uint64_t n = 0; n < header.count; n++)
+      {
+        _journal_entry e;
+        if(offset + sizeof(e) > read)
+        {
+          return _journal();
+        }
+        memcpy(&e, buffer.data() + offset, sizeof(e));
+        offset += sizeof(e);
+        if(offset + e.tempname_bytes + e.leafname_bytes > read)
+        {
+          return _journal();
+        }
+        const auto *names = reinterpret_cast<const char_type *>(buffer.data() + offset);
+        filesystem::path::string_type tempname(names, e.tempname_bytes / sizeof(char_type));
+        filesystem::path::string_type leafname(names + tempname.size(), e.leafname_bytes / sizeof(char_type));
+        offset += e.tempname_bytes + e.leafname_bytes;
+        ret.entries.push_back({_to_unique_id(e.unique_id), std::move(tempname), std::move(leafname)});
+      }
+      return ret;
+    }
+    result<void> _recover()
+    {
+      std::vector<directory_handle::buffer_type> entries(64);
+      directory_handle::buffers_type buffers;
+      for(;;)
+      {
+        buffers = {entries, std::move(buffers)};
+        OUTCOME_TRY(buffers, _dirh.read({std::move(buffers), {}, directory_handle::filter::none}));
+        if(buffers.done())
+        {
+          break;
+        }
+        entries.resize(entries.size() << 1);
+      }
+      std::vector<filesystem::path> journals;
+      std::set<filesystem::path> temps;
+      for(auto &entry : buffers)
+      {
+        auto leafname = entry.leafname.path();
+        if(_is_temp_leafname(leafname.native(), ".txn"))
+        {
+          journals.push_back(std::move(leafname));
+        }
+        else if(_is_temp_leafname(leafname.native(), ".tmp"))
+        {
+          temps.insert(std::move(leafname));
+        }
+      }
+      if(journals.empty() && temps.empty())
+      {
+        return success();
+      }
+      for(auto &name : journals)
+      {
+        OUTCOME_TRY(auto &&journal, _read_journal(name));
+        // Nothing was renamed unless every new inode was durable, so if any is missing, none were renamed
+        bool complete = !journal.entries.empty();
+        std::vector<directory_handle::relink_request> relinks;
+        std::vector<path_view> unlinks;
+        for(auto &e : journal.entries)
+        {
+          if(e.tempname.empty())
+          {
+            unlinks.push_back(e.leafname);
+          }
+          else if(temps.count(e.tempname) > 0)
+          {
+            relinks.push_back({e.tempname, &_dirh, e.leafname, directory_handle::relink_kind::replace});
+          }
+          else
+          {
+            auto fh = file_handle::file(_dirh, e.leafname, file_handle::mode::attr_read);
+            if(!fh || !(fh.value().unique_id() == e.unique_id))
+            {
+              complete = false;
+              break;
+            }
+          }
+        }
+        if(complete)
+        {
+          OUTCOME_TRY(auto &&relinked, _dirh.relink_entries(relinks));
+          for(auto &r : relinked)
+          {
+            if(!r)
+            {
+              return std::move(r).error();
+            }
+          }
+          for(auto &r : relinks)
+          {
+            temps.erase(r.leafname.path());
+          }
+          OUTCOME_TRY(auto &&unlinked, _dirh.unlink_entries(unlinks));
+          (void) unlinked;
+          OUTCOME_TRY(utils::flush_directory(_dirh.native_handle()));
+          _stats.transactions_recovered++;
+        }
+        else
+        {
+          _stats.transactions_rolled_back++;
+        }
+        const path_view journalname(name);
+        OUTCOME_TRY(auto &&unlinked, _dirh.unlink_entries({&journalname, 1}));
+        (void) unlinked;
+      }
+      // Anything left is a new inode of a transaction which never reached its commit point
+      std::vector<path_view> unlinks(temps.begin(), temps.end());
+      OUTCOME_TRY(auto &&unlinked, _dirh.unlink_entries(unlinks));
+      (void) unlinked;
+      return utils::flush_directory(_dirh.native_handle());
+    }
+
+  public:
+    transactional_directory(const transactional_directory &) = delete;
+    transactional_directory(transactional_directory &&) = delete;
+    transactional_directory &operator=(const transactional_directory &) = delete;
+    transactional_directory &operator=(transactional_directory &&) = delete;
+    ~transactional_directory() = default;
+
+    /*! \brief Opens the directory at `path` relative to `base`, creating it if needed. If no other
+    process has it open, any transactions interrupted by a crash are completed or discarded.
+
+    \errors Any of the values `directory_handle::directory()`, `shared_fs_mutex::safe_byte_ranges::fs_mutex_safe_byte_ranges()`,
+    `directory_handle::relink_entries()` or `utils::flush_directory()` can return.
+    */
+    static result<std::unique_ptr<transactional_directory>> open(const path_handle &base, path_view path) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&dirh, directory_handle::directory(base, path, directory_handle::mode::write, directory_handle::creation::if_needed));
+        OUTCOME_TRY(auto &&mutex, mutex_type::fs_mutex_safe_byte_ranges(dirh, ".lock"));
+        std::unique_ptr<transactional_directory> ret(new transactional_directory(std::move(dirh), std::move(mutex)));
+        auto recovering = ret->_mutex.try_lock(entity_type(0, true));
+        if(recovering)
+        {
+          OUTCOME_TRY(ret->_recover());
+          recovering.value().unlock();
+        }
+        else if(recovering.error() != errc::timed_out)
+        {
+          return std::move(recovering).error();
+        }
+        OUTCOME_TRY(auto &&in_use, ret->_mutex.lock(entity_type(0, false)));
+        ret->_in_use = std::move(in_use);
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The directory containing the files.
+    const directory_handle &directory() const noexcept { return _dirh; }
+
+    //! Returns a new empty transaction on this directory.
+    transaction begin() noexcept { return transaction(*this); }
+
+    /*! \brief Atomically replaces and removes the files of `tx`, returning once that is durable. The
+    transaction is left empty.
+
+    \errors `errc::invalid_argument` if `tx` is not of this directory, any of the values `barrier()`,
+    `link()`, `directory_handle::relink_entries()`, `directory_handle::unlink_entries()` or
+    `utils::flush_directory()` can return. A failure after the commit point leaves the transaction
+    to be completed by the next `open()` of the directory when no other process has it open.
+    */
+    result<void> commit(transaction &tx) noexcept
+    {
+      try
+      {
+        if(tx._parent != this)
+        {
+          return errc::invalid_argument;
+        }
+        if(tx._updates.empty())
+        {
+          return success();
+        }
+        std::vector<entity_type> entities;
+        entities.reserve(tx._updates.size());
+        for(auto &u : tx._updates)
+        {
+          entities.push_back(_entity_for(u->leafname, true));
+        }
+        OUTCOME_TRY(auto &&guard, _mutex.lock(entities));
+        // Make the new inodes durable, and name them so a crash after the commit point can rename them
+        std::string journal(sizeof(_journal_header), 0);
+        size_t written = 0, removed = 0;
+        for(auto &up : tx._updates)
+        {
+          auto &u = *up;
+          _journal_entry e{};
+          if(!u.remove)
+          {
+            OUTCOME_TRY(u.fh.barrier(file_handle::barrier_kind::wait_all));
+            if(u.tempname.empty())
+            {
+              auto tempname = _temp_leafname(".tmp");
+              OUTCOME_TRY(u.fh.link(_dirh, tempname));
+              u.tempname = std::move(tempname);
+            }
+            const auto unique_id = u.fh.unique_id();
+            e.unique_id[0] = unique_id.as_longlongs[0];
+            e.unique_id[1] = unique_id.as_longlongs[1];
+            e.tempname_bytes = (uint32_t)(u.tempname.native().size() * sizeof(filesystem::path::value_type));
+            written++;
+          }
+          else
+          {
+            removed++;
+          }
+          e.leafname_bytes = (uint32_t)(u.leafname.native().size() * sizeof(filesystem::path::value_type));
+          _append(journal, &e, sizeof(e));
+          _append(journal, u.tempname.native().data(), e.tempname_bytes);
+          _append(journal, u.leafname.native().data(), e.leafname_bytes);
+        }
+        _journal_header header{};
+        header.count = tx._updates.size();
+        memcpy(&journal[0], &header, sizeof(header));
+        const auto hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(journal.data() + 16, journal.size() - 16);
+        header.hash[0] = hash.as_longlongs[0];
+        header.hash[1] = hash.as_longlongs[1];
+        memcpy(&journal[0], &header, sizeof(header));
+        const auto journalname = _temp_leafname(".txn");
+        const path_view journalleaf(journalname);
+        auto committed = [&]() -> result<void> {
+          OUTCOME_TRY(auto &&jh, file_handle::file(_dirh, journalname, file_handle::mode::write, file_handle::creation::only_if_not_exist));
+          OUTCOME_TRY(jh.write(0, {{reinterpret_cast<const byte *>(journal.data()), journal.size()}}));
+          OUTCOME_TRY(jh.barrier(file_handle::barrier_kind::wait_all));
+          // The commit point
+          return utils::flush_directory(_dirh.native_handle());
+        }();
+        if(!committed)
+        {
+          (void) _dirh.unlink_entries({&journalleaf, 1});
+          tx.discard();
+          return committed;
+        }
+        std::vector<directory_handle::relink_request> relinks;
+        std::vector<path_view> unlinks;
+        for(auto &up : tx._updates)
+        {
+          auto &u = *up;
+          if(u.remove)
+          {
+            unlinks.push_back(u.leafname);
+          }
+          else
+          {
+            relinks.push_back({u.tempname, &_dirh, u.leafname, directory_handle::relink_kind::replace});
+          }
+        }
+        auto applied = [&]() -> result<void> {
+          OUTCOME_TRY(auto &&relinked, _dirh.relink_entries(relinks));
+          for(auto &r : relinked)
+          {
+            if(!r)
+            {
+              return std::move(r).error();
+            }
+          }
+          OUTCOME_TRY(auto &&unlinked, _dirh.unlink_entries(unlinks));
+          for(auto &r : unlinked)
+          {
+            if(!r && r.error() != errc::no_such_file_or_directory)
+            {
+              return std::move(r).error();
+            }
+          }
+          OUTCOME_TRY(utils::flush_directory(_dirh.native_handle()));
+          // This unlink is made durable by the commit point of any later transaction on these files
+          OUTCOME_TRY(auto &&unlinked_journal, _dirh.unlink_entries({&journalleaf, 1}));
+          (void) unlinked_journal;
+          return success();
+        }();
+        // The new inodes now belong to the journal, not the transaction
+        for(auto &up : tx._updates)
+        {
+          auto &u = *up;
+          u.tempname.clear();
+        }
+        tx.discard();
+        guard.unlock();
+        if(applied)
+        {
+          std::lock_guard<std::mutex> g(_lock);
+          _stats.commits++;
+          _stats.files_written += written;
+          _stats.files_removed += removed;
+        }
+        return applied;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Opens the file `leafname` within the directory.
+
+    \errors `errc::invalid_argument` if `leafname` is not a valid name within the directory, any of
+    the values `file_handle::file()` can return.
+    */
+    result<file_handle> open_file(path_view leafname, file_handle::mode _mode = file_handle::mode::read) const noexcept
+    {
+      try
+      {
+        if(!_valid_leafname(leafname.path()))
+        {
+          return errc::invalid_argument;
+        }
+        return file_handle::file(_dirh, leafname, _mode);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Locks the files `leafnames` for shared access, so that files read whilst the lock is
+    held are either all from before or all from after any transaction on them.
+
+    \errors `errc::invalid_argument` if any of `leafnames` is not a valid name within the directory,
+    any of the values `shared_fs_mutex::safe_byte_ranges::lock()` can return.
+    */
+    result<read_lock> lock_shared(span<const path_view> leafnames, deadline d = deadline()) noexcept
+    {
+      try
+      {
+        read_lock ret;
+        ret._entities.reserve(leafnames.size());
+        for(auto &leafname : leafnames)
+        {
+          auto path = leafname.path();
+          if(!_valid_leafname(path))
+          {
+            return errc::invalid_argument;
+          }
+          ret._entities.push_back(_entity_for(path, false));
+        }
+        OUTCOME_TRY(auto &&guard, _mutex.lock(ret._entities, d));
+        ret._guard = std::move(guard);
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! Statistics about the use of the directory.
+    statistics stats() const noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      return _stats;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -97,6 +97,37 @@ namespace algorithm
       return success();
     }
 
+    /*! \brief Called once when a traversal begins to decide whether to read the contents of
+    symbolic links for `symlinks_enumerated()`. The default returns `false`.
+    */
+    virtual bool want_symlinks(void *data) noexcept
+    {
+      (void) data;
+      return false;
+    }
+
+    /*! \brief Called just after `post_enumeration()` if `want_symlinks()` returned true, with the
+    entries in `contents` which are symbolic links, and the contents of each. These have all been
+    read in one batch using `symlink_handle::read_links()`, without opening a handle to each link.
+    The contents of a link failing to be read is not a failure of the traversal.
+
+    Each thread caches the contents of the links it reads by inode for the duration of the
+    traversal, so a link reachable through many hard links, as package stores which deduplicate
+    with hard links have, is only read once per thread. The default does nothing.
+
+    \note May be called from multiple kernel threads concurrently.
+    */
+    virtual result<void> symlinks_enumerated(void *data, const directory_handle &dirh, span<const directory_handle::buffer_type> links,
+                                             span<const result<path_view>> targets, size_t depth) noexcept
+    {
+      (void) data;
+      (void) dirh;
+      (void) links;
+      (void) targets;
+      (void) depth;
+      return success();
+    }
+
     /*! \brief Called whenever the traversed stack of directory hierarchy is updated.
     This can act as an estimated progress indicator, or to give an
     accurate progress indicator by matching it against a previous
@@ -105,8 +136,7 @@ namespace algorithm
     \param dirs_processed The total number of directories traversed so far.
     \param known_dirs_remaining The currently known number of directories
     awaiting traversal.
-    \param depth_processed How many levels deep we have already completely
-    traversed.
+    \param depth_processed The deepest level whose traversal has begun.
     \param known_depth_remaining The currently known number of levels we
     shall traverse.
 
@@ -141,19 +171,45 @@ namespace algorithm
 
   2. Enumerate the contents of the directory.
 
-  3. Call `post_enumeration()` of the visitor on the contents just enumerated.
+  3. Call `post_enumeration()` of the visitor on the contents just enumerated, then if the
+  visitor wants them, `symlinks_enumerated()` on the contents of any symbolic links within.
 
   4. For each directory in the contents, append the directory handle and each directory
-  leafname to its hierarchy depth level in a stack of lists.
+  leafname to the back of the current worker's queue of work.
 
-  5. Loop, using the least deep available item in the stack, until the stack is empty.
+  5. Loop, using the front of the worker's queue (or the back if `depth_first` is true), until
+  there is no work remaining in any queue.
 
   If `known_dirs_remaining` exceeds four, a threadpool of not more than `threads` threads
-  is spun up in order to traverse the hierarchy more quickly.
-
-  This algorithm is therefore primarily a breadth-first algorithm, in that we proceed from
-  root, level by level, to the tips. The number returned is the total number of directories
-  traversed.
+  is spun up in order to traverse the hierarchy more quickly. Each thread owns a queue of
+  work, and threads whose queues are empty steal work from the front of other threads'
+  queues, so there is no lock shared by all threads. If `threads` is zero, `utils::tuning().traverse_threads`
+  is used if set, otherwise half the hardware concurrency, but not fewer than four.
+
+  By default this algorithm is therefore primarily a breadth-first algorithm, in that we
+  proceed from root, roughly level by level, to the tips. Setting `depth_first` instead has
+  each thread proceed from its most recently discovered directory, which consumes much less
+  memory on very large hierarchies, and tends to have better locality, whilst stealing still
+  spreads the shallowest and thus largest subtrees across threads. The number returned is
+  the total number of directories traversed.
+
+  Either way, on very wide hierarchies the queues can hold millions of directories, each
+  possibly keeping its parent directory open. If `max_queued` is not zero, once the queues of
+  all the threads hold `max_queued` directories, each thread instead enumerates the directories
+  it discovers itself, depth first, without queuing them. Whenever the queues fall below half
+  of `max_queued`, each thread returns the shallowest of the directories it kept back to its
+  queue for other threads to steal, so the traversal remains parallel across subtrees. Memory
+  consumed, and directory handles open, are then proportional to `max_queued` plus the depth of
+  the hierarchy multiplied by the width of its directories, rather than to the total number of
+  directories.
+
+  If `multiplexer` is not null, each thread takes batches of work from its queue, and
+  opens each batch of directories sharing a parent using `directory_handle::directories()`,
+  and on Linux fetches the types of entries not returned by the directory enumeration using
+  one batch of `statx` per directory, both via `io_multiplexer::do_posix_fs_syscalls()`. With
+  the Linux io_uring multiplexer these execute at high queue depth, which on network filing
+  systems such as NFS or Lustre hides the per operation round trip latency far better than
+  more threads would. The multiplexer must be usable from `threads` kernel threads concurrently.
 
   ## Notes
 
@@ -182,7 +238,46 @@ namespace algorithm
 
   - Fast path, 16 threads, traversed 131,915 directories and 8,254,162 entries in 0.525 seconds (+46%).
   */
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> traverse(const path_handle &dirh, traverse_visitor *visitor, size_t threads = 0, void *data = nullptr, bool force_slow_path = false) noexcept;
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> traverse(const path_handle &dirh, traverse_visitor *visitor, size_t threads = 0, void *data = nullptr, bool force_slow_path = false,
+                                                       bool depth_first = false, io_multiplexer *multiplexer = nullptr, size_t max_queued = 0) noexcept;
+
+  //! \brief An entry of a volume enumerated by `enumerate_volume()`.
+  struct volume_entry
+  {
+    uint64_t id[2];               //!< The 128 bit file id, which folded by xor of its halves is `stat_t::st_ino`.
+    uint64_t parent_id[2];        //!< The 128 bit file id of the directory containing this link to the file.
+    filesystem::file_type type;   //!< `directory`, `symlink` for reparse points, otherwise `regular`.
+    path_view leafname;           //!< The leafname of this link to the file, a view of the kernel buffer.
+  };
+  //! \brief The callback type for `enumerate_volume()`, which returns false to stop the enumeration.
+  using enumerate_volume_callback = function_ptr<result<bool>(span<const volume_entry> entries)>;
+
+  /*! \brief Enumerates every file and directory upon the volume containing `onvolume` by reading
+  the filing system's own table of files, rather than walking its directories.
+
+  \param onvolume Any handle upon the volume to enumerate.
+  \param callback Called with each batch of entries enumerated, which are only valid for the
+  duration of the call, in no particular order. Returning false ends the enumeration.
+  \param kernel_buffer_size The size of the kernel buffer, each fill of which is one syscall.
+
+  On Windows this issues `FSCTL_ENUM_USN_DATA` to the volume, which returns the records of the
+  NTFS master file table, or of the ReFS equivalent, in their on-disk order. For whole volume
+  scans this is commonly ten to fifty times faster than `traverse()`. Only the leafname and
+  parent of each link is returned, so you must reassemble paths from `parent_id` yourself, and
+  the root directory of the volume is not itself reported as an entry. Opening the volume
+  requires administrative privileges.
+
+  There is no equivalent on POSIX, and other filing systems, which fail with
+  `errc::operation_not_supported`. Use `traverse()` instead.
+
+  \return The number of entries enumerated.
+  \errors `errc::operation_not_supported` if the platform or filing system cannot do this. Any of
+  the values `file_handle::file()` can return when opening the volume, such as
+  `errc::permission_denied`, or `DeviceIoControl()` can return.
+  \mallocs The kernel buffer.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> enumerate_volume(const path_handle &onvolume, enumerate_volume_callback callback,
+                                                               size_t kernel_buffer_size = 1024 * 1024) noexcept;
 
 }  // namespace algorithm
 
@@ -35,6 +35,21 @@ LLFIO_V2_NAMESPACE_BEGIN
 
 namespace algorithm
 {
+  /*! \brief How the section backing a `trivial_vector` is mapped, see `trivial_vector::set_storage_policy()`.
+
+  Large pages need a `page_sizes_N` flag, and the section is then placed in
+  `path_discovery::memory_backed_temporary_files_directory()`. Combine with
+  `section_handle::flag::page_sizes_fallback` to fall back to normal pages, with transparent
+  huge pages requested on Linux, when no large pages are reserved instead of throwing.
+  */
+  struct trivial_vector_storage_policy
+  {
+    //! `section_handle::flag::page_sizes_N`, optionally with `section_handle::flag::page_sizes_fallback`.
+    section_handle::flag page_sizes{section_handle::flag::none};
+    //! The NUMA placement of the pages of the section.
+    map_handle::numa_policy numa;
+  };
+
 #ifndef DOXYGEN_IS_IN_THE_HOUSE
   namespace detail
 #else
@@ -42,10 +57,10 @@ namespace algorithm
   namespace impl
 #endif
   {
-    template <bool has_default_construction, class T> struct trivial_vector_impl;
+    template <bool has_default_construction, class T, size_t section_threshold> struct trivial_vector_impl;
     template <class T> class trivial_vector_iterator
     {
-      template <bool has_default_construction, class _T> friend struct trivial_vector_impl;
+      template <bool has_default_construction, class _T, size_t section_threshold> friend struct trivial_vector_impl;
       T *_v;
       explicit trivial_vector_iterator(T *v)
           : _v(v)
@@ -154,7 +169,7 @@ namespace algorithm
       a -= n;
       return a;
     }
-    template <bool has_default_construction, class T> struct trivial_vector_impl
+    template <bool has_default_construction, class T, size_t section_threshold> struct trivial_vector_impl
     {
       static_assert(std::is_trivially_copyable<T>::value, "trivial_vector: Type T is not trivially copyable!");
 
@@ -182,18 +197,76 @@ namespace algorithm
       using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
     private:
+      // Capacities below this many bytes live on the heap, over-aligned types can't use realloc()
+      static constexpr size_t _heap_threshold = (alignof(value_type) <= alignof(std::max_align_t)) ? section_threshold : 0;
+
       section_handle _sh;
       map_handle _mh;
       pointer _begin{nullptr}, _end{nullptr}, _capacity{nullptr};
+      trivial_vector_storage_policy _policy;
+      bool _persistent{false};
+
+      // The first page of the backing file of a persistent vector
+      struct _persistent_header
+      {
+        uint64_t magic;
+        uint64_t item_size;
+        uint64_t size;
+      };
+      static constexpr uint64_t _persistent_magic = 0x3156544f49464c4cULL;  // LLFIOTV1
+      size_type _header_bytes() const noexcept { return _persistent ? utils::page_size() : 0; }
+      _persistent_header *_header() const noexcept { return reinterpret_cast<_persistent_header *>(_mh.address()); }
+      // Resizes the section, and for a persistent vector its backing file, to the bytes of the items plus any header
+      void _truncate_section(size_type bytes)
+      {
+        if(_persistent)
+        {
+          _sh.backing()->truncate(_header_bytes() + bytes).value();
+        }
+        _sh.truncate(_header_bytes() + bytes).value();
+      }
 
-      static size_type _scale_capacity(size_type cap)
+      bool _wants_large_pages() const noexcept { return LLFIO_V2_NAMESPACE::detail::pagesize_index_from_flags(_policy.page_sizes) != 0; }
+      bool _wants_numa_placement() const noexcept { return _policy.numa.policy != map_handle::numa_policy::kind::local || _policy.numa.nodes != 0; }
+      // Section sizes must be multiples of any large page size which might be obtained
+      size_type _section_page_size() const
+      {
+        const auto &pagesizes = utils::page_sizes();
+        const size_t idx = LLFIO_V2_NAMESPACE::detail::pagesize_index_from_flags(_policy.page_sizes);
+        return (idx < pagesizes.size()) ? pagesizes[idx] : pagesizes[0];
+      }
+      void _map_section(size_type bytes)
       {
-        if(cap == 0)
+        auto mh = map_handle::map(_sh, bytes, 0, section_handle::flag::readwrite | _policy.page_sizes);
+        if(!mh && (_policy.page_sizes & section_handle::flag::page_sizes_fallback))
         {
-          cap = utils::page_size() / sizeof(value_type);
-          return cap;
+          mh = map_handle::map(_sh, bytes);
+        }
+        _mh = std::move(mh).value();
+        if(_wants_numa_placement())
+        {
+          _mh.set_numa_policy(_policy.numa, {}, true).value();
+        }
+      }
+      void _create_section(size_type bytes)
+      {
+        if(_wants_large_pages())
+        {
+          const path_handle &dirh = path_discovery::memory_backed_temporary_files_directory();
+          if(dirh.is_valid())
+          {
+            auto sh = section_handle::section(bytes, dirh, section_handle::flag::readwrite | _policy.page_sizes);
+            if(!sh && (_policy.page_sizes & section_handle::flag::page_sizes_fallback))
+            {
+              sh = section_handle::section(bytes, dirh);
+            }
+            _sh = std::move(sh).value();
+            _map_section(bytes);
+            return;
+          }
         }
-        return cap * 2;
+        _sh = section_handle::section(bytes).value();
+        _map_section(bytes);
       }
 
     public:
@@ -207,11 +280,54 @@ namespace algorithm
       trivial_vector_impl(const trivial_vector_impl &) = delete;
       //! Copy assigned disabled, use range constructor if you really want this
       trivial_vector_impl &operator=(const trivial_vector_impl &) = delete;
+      /*! \brief Persistent constructor, storing the items in `backing` which must be open for write and
+      must outlive the vector. The first page of the file records the size of the vector, and the items follow.
+      If `backing` is empty, the vector is empty,
+      otherwise the items stored there by a previous persistent vector of the same `value_type` are reopened
+      without reading or copying them.
+
+      The size recorded in the file is updated by `persist()` and by destruction, so after a crash
+      the vector reopens with the size of the last of those.
+      \throws `std::invalid_argument` if `backing` was not written by a persistent vector of the same `value_type`.
+      */
+      explicit trivial_vector_impl(file_handle &backing)
+          : _persistent(true)
+      {
+        const size_type header = _header_bytes();
+        auto length = backing.maximum_extent().value();
+        const bool fresh = (length == 0);
+        if(fresh)
+        {
+          length = backing.truncate(header).value();
+        }
+        else if(length < header)
+        {
+          throw std::invalid_argument("trivial_vector: backing file was not written by a persistent trivial_vector");  // NOLINT
+        }
+        _sh = section_handle::section(backing, 0, section_handle::flag::readwrite).value();
+        _mh = map_handle::map(_sh, static_cast<size_type>(length)).value();
+        auto *h = _header();
+        if(fresh)
+        {
+          h->magic = _persistent_magic;
+          h->item_size = sizeof(value_type);
+          h->size = 0;
+        }
+        const size_type cap = static_cast<size_type>((length - header) / sizeof(value_type));
+        if(h->magic != _persistent_magic || h->item_size != sizeof(value_type) || h->size > cap)
+        {
+          throw std::invalid_argument("trivial_vector: backing file was not written by a persistent trivial_vector of this type");  // NOLINT
+        }
+        _begin = reinterpret_cast<pointer>(_mh.address() + header);
+        _capacity = _begin + cap;
+        _end = _begin + h->size;
+      }
       //! Move constructor
-      trivial_vector_impl(trivial_vector_impl &&o) noexcept : _sh(std::move(o._sh)), _mh(std::move(o._mh)), _begin(o._begin), _end(o._end), _capacity(o._capacity)
+      trivial_vector_impl(trivial_vector_impl &&o) noexcept : _sh(std::move(o._sh)), _mh(std::move(o._mh)), _begin(o._begin), _end(o._end), _capacity(o._capacity), _policy(o._policy), _persistent(o._persistent)
       {
         _mh.set_section(&_sh);
         o._begin = o._end = o._capacity = nullptr;
+        o._persistent = false;
       }
       //! Move assignment
       trivial_vector_impl &operator=(trivial_vector_impl &&o) noexcept
@@ -226,7 +342,18 @@ namespace algorithm
       }
       //! Initialiser list constructor
       trivial_vector_impl(std::initializer_list<value_type> il);
-      ~trivial_vector_impl() { clear(); }
+      ~trivial_vector_impl()
+      {
+        if(_persistent && _mh.address() != nullptr)
+        {
+          _header()->size = size();
+        }
+        clear();
+        if(!_sh.is_valid())
+        {
+          free(_begin);
+        }
+      }
 
       //! Assigns
       void assign(size_type count, const value_type &v)
@@ -319,54 +446,154 @@ namespace algorithm
         size_type current_size = size();
         size_type bytes = n * sizeof(value_type);
         bytes = utils::round_up_to_page_size(bytes, utils::page_size());
+        if(bytes >= _heap_threshold && _wants_large_pages())
+        {
+          bytes = utils::round_up_to_page_size(bytes, _section_page_size());
+        }
+        if(!_sh.is_valid() && n <= capacity())
+        {
+          return;
+        }
+        if(!_sh.is_valid() && bytes < _heap_threshold)
+        {
+          _heap_reallocate(bytes);
+          return;
+        }
         if(!_sh.is_valid())
         {
-          _sh = section_handle::section(bytes).value();
-          _mh = map_handle::map(_sh, bytes).value();
+          // Migrate from the heap (if anything was there) into a section
+          _create_section(bytes);
+          if(_begin != nullptr)
+          {
+            memcpy(_mh.address(), _begin, current_size * sizeof(value_type));
+            free(_begin);
+          }
         }
         else if(n > capacity())
         {
           // We can always grow a section even with maps open on it
-          _sh.truncate(bytes).value();
+          _truncate_section(bytes);
           // Attempt to resize the map in place
-          if(!_mh.truncate(bytes, true))
+          if(!_mh.truncate(_header_bytes() + bytes, true))
           {
             // std::cerr << "truncate fail" << std::endl;
             // If can't resize, close the map and reopen it into a new address
             _mh.close().value();
-            _mh = map_handle::map(_sh, bytes).value();
+            _map_section(_header_bytes() + bytes);
+          }
+          else if(_wants_numa_placement())
+          {
+            // Pages of the section beyond the old map don't have the policy yet
+            _mh.set_numa_policy(_policy.numa).value();
           }
         }
         else
         {
           return;
         }
-        _begin = reinterpret_cast<pointer>(_mh.address());
-        _capacity = reinterpret_cast<pointer>(_mh.address() + bytes);
+        _begin = reinterpret_cast<pointer>(_mh.address() + _header_bytes());
+        _capacity = reinterpret_cast<pointer>(_mh.address() + _header_bytes() + bytes);
         _end = _begin + current_size;
       }
       //! Items can be stored until storage expanded
       size_type capacity() const noexcept { return _capacity - _begin; }
+      //! True if the storage is currently a `section_handle` rather than the heap
+      bool is_section_backed() const noexcept { return _sh.is_valid(); }
+      //! True if the items are stored in a file supplied to the persistent constructor
+      bool is_persistent() const noexcept { return _persistent; }
+      /*! \brief For a persistent vector, records the size into the backing file and issues a barrier
+      of kind `kind` on the items. Does nothing for a vector which is not persistent.
+      */
+      void persist(map_handle::barrier_kind kind = map_handle::barrier_kind::wait_all)
+      {
+        if(!_persistent)
+        {
+          return;
+        }
+        _header()->size = size();
+        _mh.barrier(kind).value();
+      }
+      //! The page size of the section backed storage, zero if the storage is on the heap
+      size_type storage_page_size() const noexcept { return _sh.is_valid() ? _mh.page_size() : 0; }
+      //! True if the section backed storage fell back to normal pages with transparent huge pages requested
+      bool is_storage_transparent_huge_pages() const noexcept { return _sh.is_valid() && _mh.is_transparent_huge_pages(); }
+      //! How section backed storage is mapped
+      const trivial_vector_storage_policy &storage_policy() const noexcept { return _policy; }
+      /*! \brief Sets how section backed storage is mapped. Large pages are used from when the storage is next
+      placed into a new section, a NUMA policy is applied immediately to any existing section, moving its pages.
+      */
+      void set_storage_policy(const trivial_vector_storage_policy &policy)
+      {
+        _policy = policy;
+        if(_sh.is_valid() && _wants_numa_placement())
+        {
+          _mh.set_numa_policy(_policy.numa, {}, true).value();
+        }
+      }
       //! Removes unused capacity
       void shrink_to_fit()
       {
         size_type current_size = size();
         size_type bytes = current_size * sizeof(value_type);
-        bytes = utils::round_up_to_page_size(bytes, _mh.page_size());
+        bytes = utils::round_up_to_page_size(bytes, utils::page_size());
+        if(bytes >= _heap_threshold && _sh.is_valid())
+        {
+          bytes = utils::round_up_to_page_size(bytes, _wants_large_pages() ? _section_page_size() : _mh.page_size());
+        }
         if(bytes / sizeof(value_type) == capacity())
         {
           return;
         }
+        if(_persistent)
+        {
+          // The header in the file must be current before the file is truncated
+          _header()->size = current_size;
+          _mh.close().value();
+          _truncate_section(bytes);
+          _map_section(_header_bytes() + bytes);
+          _begin = reinterpret_cast<pointer>(_mh.address() + _header_bytes());
+          _capacity = reinterpret_cast<pointer>(_mh.address() + _header_bytes() + bytes);
+          _end = _begin + current_size;
+          return;
+        }
         if(bytes == 0)
         {
+          if(_sh.is_valid())
+          {
+            _mh.close().value();
+            _sh.close().value();
+          }
+          else
+          {
+            free(_begin);
+          }
+          _begin = _end = _capacity = nullptr;
+          return;
+        }
+        if(!_sh.is_valid())
+        {
+          _heap_reallocate(bytes);
+          return;
+        }
+        if(bytes < _heap_threshold)
+        {
+          // Migrate back out of the section onto the heap
+          auto *p = static_cast<pointer>(malloc(bytes));
+          if(p == nullptr)
+          {
+            throw std::bad_alloc();  // NOLINT
+          }
+          memcpy(p, _begin, current_size * sizeof(value_type));
           _mh.close().value();
           _sh.close().value();
-          _begin = _end = _capacity = nullptr;
+          _begin = p;
+          _capacity = reinterpret_cast<pointer>(reinterpret_cast<byte *>(p) + bytes);
+          _end = _begin + current_size;
           return;
         }
         _mh.close().value();
         _sh.truncate(bytes).value();
-        _mh = map_handle::map(_sh, bytes).value();
+        _map_section(bytes);
         _begin = reinterpret_cast<pointer>(_mh.address());
         _capacity = reinterpret_cast<pointer>(_mh.address() + bytes);
         _end = _begin + current_size;
@@ -542,10 +769,12 @@ namespace algorithm
         swap(_begin, o._begin);
         swap(_end, o._end);
         swap(_capacity, o._capacity);
+        swap(_policy, o._policy);
+        swap(_persistent, o._persistent);
       }
     };
 
-    template <class T> struct trivial_vector_impl<true, T> : trivial_vector_impl<false, T>
+    template <class T, size_t section_threshold> struct trivial_vector_impl<true, T, section_threshold> : trivial_vector_impl<false, T, section_threshold>
     {
       //! Value type
       using value_type = T;
@@ -572,13 +801,13 @@ namespace algorithm
 
     public:
       constexpr trivial_vector_impl() {}  // NOLINT
-      using trivial_vector_impl<false, T>::trivial_vector_impl;
+      using trivial_vector_impl<false, T, section_threshold>::trivial_vector_impl;
       //! Filling constructor of default constructed `value_type`
       explicit trivial_vector_impl(size_type count)
           : trivial_vector_impl(count, value_type{})
       {
       }
-      using trivial_vector_impl<false, T>::resize;
+      using trivial_vector_impl<false, T, section_threshold>::resize;
       //! Resizes container, filling any new items with default constructed `value_type`
       void resize(size_type count) { return resize(count, value_type{}); }
     };
@@ -588,11 +817,25 @@ namespace algorithm
 \brief Provides a constant time capacity expanding move-only STL vector. Requires `T` to be
 trivially copyable.
 
-As a hand waving estimate for whether this vector implementation may be useful to you,
+As a hand waving estimate for whether a `section_handle` backed vector may be useful to you,
 it usually roughly breaks even with `std::vector` on recent Intel CPUs at around the L2 cache
-boundary. So if your vector fits into the L2 cache, this implementation will be no
-better, but no worse. If your vector fits into the L1 cache, this implementation will be
-worse, often considerably so.
+boundary. So if your vector fits into the L2 cache, a section backed implementation will be no
+better, but no worse. If your vector fits into the L1 cache, it will be worse, often considerably so.
+This vector therefore keeps capacities of less than `SectionThreshold` bytes (by default 256Kb, the
+L2 cache size of the benchmarked CPU below) on the heap using `realloc()`, and transparently migrates
+its contents into a `section_handle` once capacity reaches `SectionThreshold`, and back onto the
+heap if `shrink_to_fit()` brings it below. A `SectionThreshold` of zero always uses a section,
+as do types whose alignment exceeds that of `std::max_align_t`. `is_section_backed()` reports
+which storage is in use.
+
+Section backed storage can be mapped with large pages and a NUMA placement using
+`set_storage_policy()`, which reduces TLB misses for large arrays. Capacities are then rounded
+up to the large page size requested. Heap storage is unaffected by the storage policy.
+
+A vector constructed from a `file_handle` is persistent: its items are stored in that file
+after a header page recording the size, and a later vector constructed from the same file
+remaps them instantly, without reading them. Persistent vectors never use the heap. Call
+`persist()` to record the size and make the items durable at a point of your choosing.
 
 Note that no STL allocator support is provided as `T` must be trivially copyable
 (for which most STL's simply use `memcpy()` anyway instead of the allocator's
@@ -683,32 +926,34 @@ L3 4Mb:
     536870912,405524,294685
   */
 #ifndef DOXYGEN_IS_IN_THE_HOUSE
-  template <class T> LLFIO_REQUIRES(std::is_trivially_copyable<T>::value) class trivial_vector : public detail::trivial_vector_impl<std::is_default_constructible<T>::value, T>
+  template <class T, size_t SectionThreshold = 262144>
+  LLFIO_REQUIRES(std::is_trivially_copyable<T>::value)
+  class trivial_vector : public detail::trivial_vector_impl<std::is_default_constructible<T>::value, T, SectionThreshold>
 #else
-  template <class T> class trivial_vector : public impl::trivial_vector_impl<true, T>
+  template <class T, size_t SectionThreshold = 262144> class trivial_vector : public impl::trivial_vector_impl<true, T, SectionThreshold>
 #endif
   {
     static_assert(std::is_trivially_copyable<T>::value, "trivial_vector: Type T is not trivially copyable!");
 
   public:
     constexpr trivial_vector() {}  // NOLINT
-    using detail::trivial_vector_impl<std::is_default_constructible<T>::value, T>::trivial_vector_impl;
+    using detail::trivial_vector_impl<std::is_default_constructible<T>::value, T, SectionThreshold>::trivial_vector_impl;
   };
 
   //! Compare
-  template <class T> inline bool operator==(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator==(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Compare
-  template <class T> inline bool operator!=(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator!=(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Compare
-  template <class T> inline bool operator<(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator<(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Compare
-  template <class T> inline bool operator<=(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator<=(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Compare
-  template <class T> inline bool operator>(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator>(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Compare
-  template <class T> inline bool operator>=(const trivial_vector<T> &a, const trivial_vector<T> &b);
+  template <class T, size_t SectionThreshold> inline bool operator>=(const trivial_vector<T, SectionThreshold> &a, const trivial_vector<T, SectionThreshold> &b);
   //! Swap
-  template <class T> inline void swap(trivial_vector<T> &a, trivial_vector<T> &b) noexcept { a.swap(b); }
+  template <class T, size_t SectionThreshold> inline void swap(trivial_vector<T, SectionThreshold> &a, trivial_vector<T, SectionThreshold> &b) noexcept { a.swap(b); }
 
 }  // namespace algorithm
 
@@ -0,0 +1,823 @@
+/* A write ahead log of preallocated segment files
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_ALGORITHM_WRITE_AHEAD_LOG_HPP
+#define LLFIO_ALGORITHM_WRITE_AHEAD_LOG_HPP
+
+#include "../directory_handle.hpp"
+#include "../file_handle.hpp"
+#include "../utils.hpp"
+#include "handle_adapter/direct_io.hpp"
+
+#include "quickcpplib/algorithm/hash.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! \file write_ahead_log.hpp Provides a write ahead log of preallocated segment files.
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  /*! \brief A durable append only log of records, stored in a directory of preallocated segment
+  files, to which many threads may append concurrently.
+
+  Each record is identified by its log sequence number (LSN), which is its byte offset within the
+  log as a whole. Appending a record reserves space for it by atomically incrementing the end of
+  the log, so appenders never wait for one another, and writes it with a single `write()` at its
+  position within the segment file containing that space. A record which would straddle the end
+  of a segment is replaced by padding, and reserved again at the start of the next segment.
+
+  `commit()` waits until every record up to and including the one given has been written, and
+  has reached storage. As with `atomic_replacer`, whilst one thread issues the `barrier()` the
+  others queue up behind, and the next barrier makes all of their records durable at once. Under
+  concurrency, the rate of commits is thus far higher than the rate of barriers.
+
+  Records are framed by a header holding their length, their LSN and a hash of both and of their
+  contents, and are padded to a multiple of the record alignment. By default segments are opened
+  with `caching::none`, and the record alignment is the offset alignment which direct i/o requires,
+  so records are written straight from an aligned buffer without passing through the kernel page
+  cache. Segment files are preallocated to their full size upon creation, so writes never change
+  the metadata of a file and a barrier need only flush the data written.
+
+  Opening an existing log scans it for the first record which is missing, torn or not hashing
+  correctly, and that becomes the end of the log. Anything after it in its segment is zeroed, and
+  any later segments are deleted, so nothing written before the crash can reappear after records
+  written since. `replay()` scans the records of the log in order.
+
+  `release()` discards segments wholly before some LSN. Up to `config::recycled_segments` of them
+  are kept, renamed, to be reused as later segments without needing to allocate their storage
+  again. Stale records in a reused segment have LSNs belonging to its previous position in the
+  log, so they are never mistaken for the records of its new position.
+
+  \note Reservations are lock free, but the completion of writes and commits is tracked under
+  a mutex held only briefly.
+  */
+  class write_ahead_log
+  {
+  public:
+    //! The type of a log sequence number, the offset of a record within the log as a whole
+    using lsn_type = uint64_t;
+    using caching = file_handle::caching;
+
+    //! The configuration of a log
+    struct config
+    {
+      uint64_t segment_size{64 * 1024 * 1024};  //!< The size of each segment file. Ignored if the log already has segments.
+      caching segment_caching{caching::none};   //!< The caching with which to open segment files
+      //! The alignment of records, zero for the direct i/o offset alignment if `segment_caching` is `none` or `only_metadata`, else 64. Ignored if the log already has records.
+      size_t record_alignment{0};
+      size_t recycled_segments{4};  //!< The number of released segments to keep for reuse
+    };
+    //! Statistics about the use of the log
+    struct statistics
+    {
+      uint64_t appends{0};            //!< Records appended
+      uint64_t commits{0};            //!< Calls to `commit()`
+      uint64_t barriers{0};           //!< Barriers issued by `commit()`, each shared by all the commits waiting
+      uint64_t segments_created{0};   //!< Segment files created and preallocated
+      uint64_t segments_recycled{0};  //!< Released segment files reused rather than created
+    };
+
+  private:
+    struct _record_header
+    {
+      QUICKCPPLIB_NAMESPACE::integers128::uint128 hash;  // of the remainder of the header, and the contents
+      uint64_t lsn;                                      // where the record belongs in the log
+      uint32_t length;                                   // bytes of contents, or of padding after the header
+      uint8_t flags;
+      uint8_t alignment_shift;  // log2 of the record alignment
+      uint16_t reserved;
+    };
+    static_assert(sizeof(_record_header) == 32, "_record_header is not 32 bytes long!");
+    static constexpr uint8_t _padding_flag = 1;
+    struct _segment
+    {
+      uint64_t index;
+      file_handle fh;
+    };
+    using _segment_ptr = std::shared_ptr<_segment>;
+    using _buffer_type = std::vector<byte, utils::pooled_page_allocator<byte>>;
+
+    directory_handle _dirh;
+    config _config;
+    size_t _alignment{64};
+    unsigned _alignment_shift{6};
+    std::atomic<lsn_type> _tail{0};
+    std::atomic<bool> _failed{false};
+    spinlock _current_lock;
+    _segment_ptr _current;  // the segment most recently written to
+    mutable std::mutex _lock;
+    std::condition_variable _changed;
+    std::map<uint64_t, _segment_ptr> _segments;  // open segments by index
+    std::vector<std::string> _free;              // leafnames of released segments kept for reuse
+    std::map<lsn_type, lsn_type> _written_ahead;  // extents written beyond _written
+    lsn_type _head{0}, _written{0}, _durable{0};
+    bool _syncing{false};
+    statistics _stats;
+
+    explicit write_ahead_log(directory_handle &&dirh, const config &cfg) noexcept
+        : _dirh(std::move(dirh))
+        , _config(cfg)
+    {
+    }
+
+    static std::string _segment_name(uint64_t index, const char *extension)
+    {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%016llx%s", (unsigned long long) index, extension);
+      return buffer;
+    }
+    static bool _parse_segment_name(const filesystem::path &leafname, uint64_t &index, const char *extension)
+    {
+      if(leafname.extension() != extension)
+      {
+        return false;
+      }
+      const auto stem = leafname.stem().string();
+      if(stem.size() != 16 || stem.find_first_not_of("0123456789abcdef") != std::string::npos)
+      {
+        return false;
+      }
+      index = std::stoull(stem, nullptr, 16);
+      return true;
+    }
+    void _set_alignment(size_t alignment) noexcept
+    {
+      _alignment = alignment;
+      _alignment_shift = 0;
+      while((size_t(1) << _alignment_shift) < alignment)
+      {
+        _alignment_shift++;
+      }
+    }
+    static bool _is_direct(caching c) noexcept { return c == caching::none || c == caching::only_metadata; }
+    size_t _round(size_t bytes) const noexcept { return (bytes + _alignment - 1) & ~(_alignment - 1); }
+    uint64_t _index_of(lsn_type lsn) const noexcept { return lsn / _config.segment_size; }
+    uint64_t _offset_of(lsn_type lsn) const noexcept { return lsn % _config.segment_size; }
+    static QUICKCPPLIB_NAMESPACE::integers128::uint128 _hash(const byte *record, size_t bytes) noexcept
+    {
+      return QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(reinterpret_cast<const char *>(record) + 16, bytes - 16);
+    }
+
+    // Must be called with _lock held. Returns null if there is no such segment.
+    result<_segment_ptr> _open_segment(uint64_t index)
+    {
+      auto it = _segments.find(index);
+      if(it != _segments.end())
+      {
+        return it->second;
+      }
+      auto fh = file_handle::file(_dirh, _segment_name(index, ".wal"), file_handle::mode::write, file_handle::creation::open_existing, _config.segment_caching);
+      if(!fh)
+      {
+        if(fh.error() == errc::no_such_file_or_directory)
+        {
+          return _segment_ptr();
+        }
+        return std::move(fh).error();
+      }
+      auto ret = std::make_shared<_segment>(_segment{index, std::move(fh).value()});
+      _segments[index] = ret;
+      return ret;
+    }
+    // Must be called with _lock held
+    result<_segment_ptr> _create_segment(uint64_t index)
+    {
+      const auto name = _segment_name(index, ".wal");
+      file_handle fh;
+      if(!_free.empty())
+      {
+        OUTCOME_TRY(auto &&recycled, file_handle::file(_dirh, _free.back(), file_handle::mode::write, file_handle::creation::open_existing, _config.segment_caching));
+        OUTCOME_TRY(recycled.relink(_dirh, name));
+        _free.pop_back();
+        fh = std::move(recycled);
+        _stats.segments_recycled++;
+      }
+      else
+      {
+        OUTCOME_TRY(auto &&created, file_handle::file(_dirh, name, file_handle::mode::write, file_handle::creation::if_needed, _config.segment_caching));
+        fh = std::move(created);
+        _stats.segments_created++;
+      }
+      // Not every filing system can preallocate, and they will allocate as written instead
+      (void) fh.preallocate({0, _config.segment_size}, false);
+      OUTCOME_TRY(fh.truncate(_config.segment_size));
+      // The segment must still be named after a power loss before any records in it are committed
+      OUTCOME_TRY(utils::flush_directory(_dirh.native_handle()));
+      auto ret = std::make_shared<_segment>(_segment{index, std::move(fh)});
+      _segments[index] = ret;
+      return ret;
+    }
+    result<_segment_ptr> _segment_for_write(uint64_t index)
+    {
+      {
+        std::lock_guard<spinlock> g(_current_lock);
+        if(_current && _current->index == index)
+        {
+          return _current;
+        }
+      }
+      std::lock_guard<std::mutex> g(_lock);
+      OUTCOME_TRY(auto &&ret, _open_segment(index));
+      if(!ret)
+      {
+        OUTCOME_TRY(auto &&created, _create_segment(index));
+        ret = std::move(created);
+      }
+      {
+        std::lock_guard<spinlock> g2(_current_lock);
+        if(!_current || _current->index < index)
+        {
+          _current = ret;
+        }
+      }
+      // Create the next segment ahead of need, so appenders rarely wait for a segment to be created
+      if(_segments.find(index + 1) == _segments.end())
+      {
+        (void) _create_segment(index + 1);
+      }
+      return ret;
+    }
+    // Records the extent [lsn, lsn + bytes) as written
+    void _complete(lsn_type lsn, lsn_type bytes, bool ok, bool record) noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      if(!ok)
+      {
+        _failed.store(true, std::memory_order_relaxed);
+      }
+      if(record)
+      {
+        _stats.appends++;
+      }
+      if(lsn != _written)
+      {
+        try
+        {
+          _written_ahead.emplace(lsn, lsn + bytes);
+        }
+        catch(...)
+        {
+          // Commits can no longer learn of what is written
+          _failed.store(true, std::memory_order_relaxed);
+          _changed.notify_all();
+        }
+        return;
+      }
+      _written += bytes;
+      for(auto it = _written_ahead.begin(); it != _written_ahead.end() && it->first == _written; it = _written_ahead.erase(it))
+      {
+        _written = it->second;
+      }
+      _changed.notify_all();
+    }
+    // Writes a record or padding to the reserved extent [lsn, lsn + bytes)
+    result<void> _write(lsn_type lsn, size_t bytes, span<const byte> contents, uint8_t flags) noexcept
+    {
+      auto r = [&]() -> result<void> {
+        try
+        {
+          OUTCOME_TRY(auto &&seg, _segment_for_write(_index_of(lsn)));
+          // Padding is skipped using its length, so only its header need be written
+          const bool padding = (flags & _padding_flag) != 0;
+          _buffer_type buffer(padding ? _alignment : bytes);
+          auto *header = reinterpret_cast<_record_header *>(buffer.data());
+          header->lsn = lsn;
+          header->length = (uint32_t)(padding ? bytes - sizeof(_record_header) : contents.size());
+          header->flags = flags;
+          header->alignment_shift = (uint8_t) _alignment_shift;
+          if(!contents.empty())
+          {
+            memcpy(buffer.data() + sizeof(_record_header), contents.data(), contents.size());
+          }
+          header->hash = _hash(buffer.data(), sizeof(_record_header) + (padding ? 0 : contents.size()));
+          OUTCOME_TRY(seg->fh.write(_offset_of(lsn), {{buffer.data(), buffer.size()}}));
+          return success();
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+      }();
+      _complete(lsn, bytes, r.has_value(), (flags & _padding_flag) == 0);
+      return r;
+    }
+    // Reads the record at lsn, returning its length including any padding, or zero if there is no valid record there
+    result<size_t> _read(const _segment_ptr &seg, lsn_type lsn, _buffer_type &buffer) const
+    {
+      const uint64_t offset = _offset_of(lsn);
+      buffer.resize(_alignment);
+      OUTCOME_TRY(auto &&read, seg->fh.read(offset, {{buffer.data(), buffer.size()}}));
+      if(read < sizeof(_record_header))
+      {
+        return 0;
+      }
+      _record_header header;
+      memcpy(&header, buffer.data(), sizeof(header));
+      if(header.lsn != lsn || header.alignment_shift != _alignment_shift || header.length > _config.segment_size - offset - sizeof(_record_header))
+      {
+        return 0;
+      }
+      const bool padding = (header.flags & _padding_flag) != 0;
+      const size_t bytes = padding ? sizeof(_record_header) + header.length : _round(sizeof(_record_header) + header.length);
+      const size_t hashed = sizeof(_record_header) + (padding ? 0 : header.length);
+      if(hashed > read)
+      {
+        buffer.resize(bytes);
+        OUTCOME_TRY(auto &&reread, seg->fh.read(offset, {{buffer.data(), buffer.size()}}));
+        if(reread < hashed)
+        {
+          return 0;
+        }
+      }
+      if(header.hash != _hash(buffer.data(), hashed))
+      {
+        return 0;
+      }
+      return bytes;
+    }
+    // Calls f for each record from `from` until the first invalid record, or `to`, returning where it stopped
+    template <class F> result<lsn_type> _scan(lsn_type from, lsn_type to, F &&f)
+    {
+      _buffer_type buffer;
+      _segment_ptr seg;
+      lsn_type lsn = from;
+      while(lsn < to)
+      {
+        if(!seg || seg->index != _index_of(lsn))
+        {
+          std::lock_guard<std::mutex> g(_lock);
+          OUTCOME_TRY(seg, _open_segment(_index_of(lsn)));
+          if(!seg)
+          {
+            break;
+          }
+        }
+        OUTCOME_TRY(auto &&bytes, _read(seg, lsn, buffer));
+        if(bytes == 0)
+        {
+          break;
+        }
+        const auto *header = reinterpret_cast<const _record_header *>(buffer.data());
+        if((header->flags & _padding_flag) == 0)
+        {
+          f(lsn, span<const byte>(buffer.data() + sizeof(_record_header), header->length));
+        }
+        lsn += bytes;
+      }
+      return lsn;
+    }
+    result<void> _unlink(const std::vector<std::string> &leafnames)
+    {
+      if(leafnames.empty())
+      {
+        return success();
+      }
+      std::vector<path_view> names(leafnames.begin(), leafnames.end());
+      OUTCOME_TRY(auto &&unlinked, _dirh.unlink_entries(names));
+      for(auto &r : unlinked)
+      {
+        if(!r && r.error() != errc::no_such_file_or_directory)
+        {
+          return std::move(r).error();
+        }
+      }
+      return success();
+    }
+    result<void> _recover()
+    {
+      std::vector<directory_handle::buffer_type> entries(64);
+      directory_handle::buffers_type buffers;
+      for(;;)
+      {
+        buffers = {entries, std::move(buffers)};
+        OUTCOME_TRY(buffers, _dirh.read({std::move(buffers), {}, directory_handle::filter::none}));
+        if(buffers.done())
+        {
+          break;
+        }
+        entries.resize(entries.size() << 1);
+      }
+      std::vector<uint64_t> indices;
+      uint64_t next_index = 0;
+      for(auto &entry : buffers)
+      {
+        const auto leafname = entry.leafname.path();
+        uint64_t index;
+        if(_parse_segment_name(leafname, index, ".wal"))
+        {
+          indices.push_back(index);
+        }
+        else if(_parse_segment_name(leafname, index, ".free"))
+        {
+          _free.push_back(_segment_name(index, ".free"));
+        }
+        else
+        {
+          continue;
+        }
+        // A reused segment must never return to its previous index, where its stale records would be valid
+        next_index = (std::max)(next_index, index + 1);
+      }
+      std::sort(indices.begin(), indices.end());
+      // Only the run of consecutive segments ending with the newest is live, any before a gap were being released
+      size_t first = indices.empty() ? 0 : indices.size() - 1;
+      while(first > 0 && indices[first - 1] + 1 == indices[first])
+      {
+        first--;
+      }
+      for(size_t n = 0; n < first; n++)
+      {
+        _free.push_back(_segment_name(indices[n], ".wal"));
+      }
+      lsn_type tail;
+      std::vector<std::string> stale;
+      if(first < indices.size())
+      {
+        const uint64_t lowest = indices[first], highest = indices.back();
+        _segment_ptr seg;
+        {
+          std::lock_guard<std::mutex> g(_lock);
+          OUTCOME_TRY(seg, _open_segment(lowest));
+        }
+        if(!seg)
+        {
+          return errc::no_such_file_or_directory;
+        }
+        OUTCOME_TRY(auto &&segment_size, seg->fh.maximum_extent());
+        if(segment_size == 0 || segment_size % _alignment != 0)
+        {
+          return errc::illegal_byte_sequence;
+        }
+        _config.segment_size = segment_size;
+        // Use the record alignment which the log was written with
+        _buffer_type buffer(_alignment);
+        OUTCOME_TRY(auto &&read, seg->fh.read(0, {{buffer.data(), buffer.size()}}));
+        if(read >= sizeof(_record_header))
+        {
+          _record_header header;
+          memcpy(&header, buffer.data(), sizeof(header));
+          if(header.lsn == lowest * segment_size && header.alignment_shift >= 6 && header.alignment_shift < 32)
+          {
+            const size_t alignment = size_t(1) << header.alignment_shift;
+            if(alignment < _alignment && _is_direct(_config.segment_caching))
+            {
+              // This log can't be read using direct i/o
+              return errc::invalid_argument;
+            }
+            if(segment_size % alignment != 0)
+            {
+              return errc::illegal_byte_sequence;
+            }
+            _set_alignment(alignment);
+          }
+        }
+        _head = lowest * segment_size;
+        OUTCOME_TRY(tail, _scan(_head, (highest + 1) * segment_size, [](lsn_type, span<const byte>) {}));
+        // Anything after the tail was written ahead of a record lost in a crash, so must never be scanned again
+        for(size_t n = first; n < indices.size(); n++)
+        {
+          if(indices[n] > _index_of(tail))
+          {
+            _segments.erase(indices[n]);
+            stale.push_back(_segment_name(indices[n], ".wal"));
+          }
+        }
+        {
+          std::lock_guard<std::mutex> g(_lock);
+          OUTCOME_TRY(seg, _open_segment(_index_of(tail)));
+        }
+        if(seg)
+        {
+          // Zeroing deallocates where the filing system can, else writes zeros
+          const uint64_t offset = _offset_of(tail);
+          OUTCOME_TRY(seg->fh.zero({offset, segment_size - offset}));
+          (void) seg->fh.preallocate({offset, segment_size - offset}, true);
+          OUTCOME_TRY(seg->fh.barrier(file_handle::barrier_kind::wait_all));
+        }
+      }
+      else
+      {
+        _head = tail = next_index * _config.segment_size;
+      }
+      while(_free.size() > _config.recycled_segments)
+      {
+        stale.push_back(std::move(_free.back()));
+        _free.pop_back();
+      }
+      if(!stale.empty())
+      {
+        OUTCOME_TRY(_unlink(stale));
+        OUTCOME_TRY(utils::flush_directory(_dirh.native_handle()));
+      }
+      _tail.store(tail, std::memory_order_relaxed);
+      _written = _durable = tail;
+      OUTCOME_TRY(_segment_for_write(_index_of(tail)));
+      return success();
+    }
+
+  public:
+    write_ahead_log(const write_ahead_log &) = delete;
+    write_ahead_log(write_ahead_log &&) = delete;
+    write_ahead_log &operator=(const write_ahead_log &) = delete;
+    write_ahead_log &operator=(write_ahead_log &&) = delete;
+    ~write_ahead_log() = default;
+
+    /*! \brief Opens the log in the directory at `path` relative to `base`, creating it if needed,
+    and recovering the end of the log if it already exists.
+
+    \errors Any of the values `directory_handle::directory()`, `file_handle::file()`, `read()`,
+    `write()` or `utils::flush_directory()` can return. `errc::invalid_argument` if the
+    configuration is invalid, or if the existing log was written with a record alignment too small
+    for direct i/o. `errc::illegal_byte_sequence` if the existing segments are of unusable size.
+    */
+    static result<std::unique_ptr<write_ahead_log>> open(const path_handle &base, path_view path, const config &cfg = {}) noexcept
+    {
+      try
+      {
+        OUTCOME_TRY(auto &&dirh, directory_handle::directory(base, path, directory_handle::mode::write, directory_handle::creation::if_needed));
+        std::unique_ptr<write_ahead_log> ret(new write_ahead_log(std::move(dirh), cfg));
+        size_t alignment = cfg.record_alignment;
+        if(alignment == 0)
+        {
+          alignment = 64;
+          if(_is_direct(cfg.segment_caching))
+          {
+            // Ask a handle opened the same way what direct i/o on this filing system requires
+            OUTCOME_TRY(auto &&probe, file_handle::uniquely_named_file(ret->_dirh, file_handle::mode::write, cfg.segment_caching, file_handle::flag::unlink_on_first_close));
+            OUTCOME_TRY(auto &&dio, detail::direct_io_alignment(probe));
+            alignment = (std::max)(alignment, dio.second);
+          }
+        }
+        if(alignment < 64 || (alignment & (alignment - 1)) != 0 || cfg.segment_size < alignment * 2)
+        {
+          return errc::invalid_argument;
+        }
+        ret->_set_alignment(alignment);
+        ret->_config.segment_size = (cfg.segment_size + alignment - 1) & ~(uint64_t)(alignment - 1);
+        OUTCOME_TRY(ret->_recover());
+        return {std::move(ret)};
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The directory containing the segment files.
+    const directory_handle &directory() const noexcept { return _dirh; }
+    //! The size of each segment file.
+    uint64_t segment_size() const noexcept { return _config.segment_size; }
+    //! The alignment of records.
+    size_t record_alignment() const noexcept { return _alignment; }
+
+    /*! \brief Appends a record containing `contents`, returning its LSN once it has been written.
+    Call `commit()` to wait for it to be durable.
+
+    \errors `errc::value_too_large` if the record would not fit in a segment, `errc::io_error` if an
+    earlier write failed, and any of the values `write()` or the creation of segments can return.
+    */
+    result<lsn_type> append(span<const byte> contents) noexcept
+    {
+      const size_t bytes = _round(sizeof(_record_header) + contents.size());
+      if(contents.size() > UINT32_MAX || bytes > _config.segment_size)
+      {
+        return errc::value_too_large;
+      }
+      for(;;)
+      {
+        if(_failed.load(std::memory_order_relaxed))
+        {
+          return errc::io_error;
+        }
+        const lsn_type lsn = _tail.fetch_add(bytes, std::memory_order_relaxed);
+        const lsn_type segment_end = (_index_of(lsn) + 1) * _config.segment_size;
+        if(lsn + bytes <= segment_end)
+        {
+          OUTCOME_TRY(_write(lsn, bytes, contents, 0));
+          return lsn;
+        }
+        // This reservation straddles the end of a segment, so pad out both parts and reserve again
+        OUTCOME_TRY(_write(lsn, (size_t)(segment_end - lsn), {}, _padding_flag));
+        OUTCOME_TRY(_write(segment_end, (size_t)(lsn + bytes - segment_end), {}, _padding_flag));
+      }
+    }
+
+    /*! \brief Returns once the record at `lsn`, and all records before it, are durable.
+
+    \errors `errc::invalid_argument` if `lsn` is not before the end of the log, `errc::io_error` if
+    a write failed, and any of the values `barrier()` can return.
+    */
+    result<void> commit(lsn_type lsn) noexcept
+    {
+      try
+      {
+        std::unique_lock<std::mutex> g(_lock);
+        _stats.commits++;
+        if(lsn >= _tail.load(std::memory_order_relaxed))
+        {
+          return errc::invalid_argument;
+        }
+        while(_durable <= lsn)
+        {
+          if(_failed.load(std::memory_order_relaxed))
+          {
+            return errc::io_error;
+          }
+          if(_syncing || _written <= lsn)
+          {
+            _changed.wait(g);
+            continue;
+          }
+          _syncing = true;
+          const lsn_type upto = _written;
+          std::vector<_segment_ptr> tosync;
+          for(auto it = _segments.lower_bound(_index_of(_durable)); it != _segments.end() && it->first <= _index_of(upto - 1); ++it)
+          {
+            tosync.push_back(it->second);
+          }
+          g.unlock();
+          result<void> r = success();
+          for(auto &seg : tosync)
+          {
+            // Data only barriers on Linux use sync_file_range(), which does not wait for the storage device
+            auto b = seg->fh.barrier(file_handle::barrier_kind::wait_all);
+            if(!b)
+            {
+              r = std::move(b).error();
+              break;
+            }
+          }
+          g.lock();
+          _syncing = false;
+          _changed.notify_all();
+          if(!r)
+          {
+            // Any waiters will try again themselves
+            return r;
+          }
+          _durable = (std::max)(_durable, upto);
+          _stats.barriers++;
+        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Calls `f(lsn, contents)` for each record written to the log, starting with the record at
+    `from`, which must be the LSN of a record or is clamped to the first record retained. Returns the
+    LSN after the last record scanned.
+
+    \errors Any of the values `read()` can return.
+    */
+    template <class F> result<lsn_type> replay(lsn_type from, F &&f) noexcept
+    {
+      try
+      {
+        lsn_type to;
+        {
+          std::lock_guard<std::mutex> g(_lock);
+          from = (std::max)(from, _head);
+          to = _written;
+        }
+        return _scan(from, to, f);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    /*! \brief Discards the segments wholly before `before`, which is clamped to the durable end of
+    the log, keeping up to `config::recycled_segments` of them for reuse.
+
+    \errors Any of the values `directory_handle::relink_entries()`, `directory_handle::unlink_entries()`
+    or `utils::flush_directory()` can return.
+    */
+    result<void> release(lsn_type before) noexcept
+    {
+      try
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        before = (std::min)(before, _durable);
+        const uint64_t first = _index_of(_head), last = _index_of(before);
+        if(last <= first)
+        {
+          return success();
+        }
+        std::vector<std::string> names, freenames, unlinks;
+        for(uint64_t index = first; index < last; index++)
+        {
+          _segments.erase(index);
+          names.push_back(_segment_name(index, ".wal"));
+        }
+        _head = last * _config.segment_size;
+        const size_t recycle = (std::min)(names.size(), _config.recycled_segments - (std::min)(_free.size(), _config.recycled_segments));
+        std::vector<directory_handle::relink_request> relinks;
+        for(size_t n = 0; n < names.size(); n++)
+        {
+          if(n < recycle)
+          {
+            freenames.push_back(_segment_name(first + n, ".free"));
+          }
+          else
+          {
+            unlinks.push_back(names[n]);
+          }
+        }
+        for(size_t n = 0; n < recycle; n++)
+        {
+          relinks.push_back({names[n], &_dirh, freenames[n], directory_handle::relink_kind::replace});
+        }
+        result<void> ret = success();
+        if(!relinks.empty())
+        {
+          OUTCOME_TRY(auto &&relinked, _dirh.relink_entries(relinks));
+          for(size_t n = 0; n < relinked.size(); n++)
+          {
+            if(relinked[n])
+            {
+              _free.push_back(std::move(freenames[n]));
+            }
+            else if(ret)
+            {
+              ret = std::move(relinked[n]).error();
+            }
+          }
+        }
+        auto unlinked = _unlink(unlinks);
+        if(!unlinked && ret)
+        {
+          ret = std::move(unlinked).error();
+        }
+        OUTCOME_TRY(utils::flush_directory(_dirh.native_handle()));
+        return ret;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+
+    //! The LSN of the first record retained in the log.
+    lsn_type head() const noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      return _head;
+    }
+    //! The LSN after the last record reserved in the log.
+    lsn_type end() const noexcept { return _tail.load(std::memory_order_relaxed); }
+    //! The LSN before which all records are durable.
+    lsn_type durable() const noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      return _durable;
+    }
+
+    //! Statistics about the use of the log.
+    statistics stats() const noexcept
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      return _stats;
+    }
+  };
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
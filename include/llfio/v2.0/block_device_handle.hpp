@@ -0,0 +1,273 @@
+/* A handle to a block device
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#ifndef LLFIO_BLOCK_DEVICE_HANDLE_H
+#define LLFIO_BLOCK_DEVICE_HANDLE_H
+
+#include "file_handle.hpp"
+
+#include <memory>
+#include <mutex>
+
+//! \file block_device_handle.hpp Provides `block_device_handle`.
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4251)  // subclass needs to have dll interface
+#endif
+
+/*! \class block_device_handle
+\brief A handle to a block device, exposing its geometry and, for zoned devices such as ZNS SSDs
+and SMR hard drives, its zones.
+
+Opening a path which is not a block device fails with `errc::no_such_device`. The geometry of the
+device is read once when it is opened. For i/o bypassing the kernel page cache, open with
+`caching::none`, and align offsets and buffers to `geometry().logical_block_size`.
+
+Zoned devices divide their storage into zones, which on host managed devices must be written
+sequentially from the start of the zone, at the zone's write pointer, and can only be rewritten
+after being reset. `zones()` reports the zones with their write pointers, `manage_zones()` opens,
+closes, finishes and resets zones, and `zone_append()` writes at the write pointer of a zone.
+The kernel returns an error for writes not at the write pointer of a sequential write required zone.
+
+Zoned devices are only supported on Linux. On Windows, `geometry().zoned` is always
+`zone_model::none`, and the zone functions return `errc::operation_not_supported`.
+*/
+class LLFIO_DECL block_device_handle : public file_handle
+{
+public:
+  //! How a device is zoned
+  enum class zone_model : uint8_t
+  {
+    none,          //!< The device is not zoned
+    host_aware,    //!< The device is zoned, but accepts random writes to sequential write preferred zones
+    host_managed  //!< The device is zoned, and sequential write required zones must be written sequentially
+  };
+  //! The geometry of a block device
+  struct geometry_type
+  {
+    uint32_t logical_block_size{0};   //!< The smallest unit the device can address
+    uint32_t physical_block_size{0};  //!< The smallest unit the device can write without read-modify-write
+    uint64_t max_transfer{0};         //!< The largest i/o the device performs in one request, or zero if not known
+    extent_type size{0};              //!< The size of the device in bytes
+    zone_model zoned{zone_model::none};
+    extent_type zone_size{0};         //!< The size of each zone in bytes, if zoned
+    uint32_t zone_count{0};           //!< The number of zones, if zoned
+    uint32_t max_open_zones{0};       //!< The maximum number of open zones, or zero if no limit
+    uint32_t max_active_zones{0};     //!< The maximum number of open and closed zones, or zero if no limit
+  };
+  //! The type of a zone. The values are those of Linux.
+  enum class zone_type : uint8_t
+  {
+    conventional = 1,               //!< May be written randomly
+    sequential_write_required = 2,  //!< Must be written sequentially at the write pointer
+    sequential_write_preferred = 3  //!< Should be written sequentially at the write pointer
+  };
+  //! The condition of a zone. The values are those of Linux.
+  enum class zone_condition : uint8_t
+  {
+    not_write_pointer = 0,  //!< A conventional zone
+    empty = 1,
+    implicitly_open = 2,
+    explicitly_open = 3,
+    closed = 4,
+    read_only = 0xd,
+    full = 0xe,
+    offline = 0xf
+  };
+  //! A zone of a zoned device
+  struct zone
+  {
+    extent_type start{0};          //!< The byte offset of the start of the zone
+    extent_type length{0};         //!< The length of the zone in bytes
+    extent_type capacity{0};       //!< The bytes of the zone which can be written, which may be less than its length
+    extent_type write_pointer{0};  //!< The byte offset at which the zone must next be written
+    zone_type type{zone_type::conventional};
+    zone_condition condition{zone_condition::not_write_pointer};
+  };
+  //! An operation upon zones
+  enum class zone_operation : uint8_t
+  {
+    open,    //!< Explicitly open the zones, so they count against `max_open_zones` until closed
+    close,   //!< Close the zones, releasing their open resources
+    finish,  //!< Move the write pointers of the zones to their ends, making them full
+    reset    //!< Move the write pointers of the zones to their starts, discarding their contents
+  };
+
+protected:
+  geometry_type _geometry;
+  // Serialises appends through this handle
+  std::unique_ptr<std::mutex> _append_lock;
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> _fetch_geometry() noexcept;
+
+public:
+  //! Default constructor
+  block_device_handle() = default;
+  //! Implicit move construction of block_device_handle permitted
+  block_device_handle(block_device_handle &&o) noexcept
+      : file_handle(std::move(o))
+      , _geometry(o._geometry)
+      , _append_lock(std::move(o._append_lock))
+  {
+  }
+  //! No copy construction (use `clone()`)
+  block_device_handle(const block_device_handle &) = delete;
+  //! Explicit conversion from file_handle permitted. Does not read the geometry.
+  explicit block_device_handle(file_handle &&o) noexcept
+      : file_handle(std::move(o))
+  {
+  }
+  //! Move assignment of block_device_handle permitted
+  block_device_handle &operator=(block_device_handle &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~block_device_handle();
+    new(this) block_device_handle(std::move(o));
+    return *this;
+  }
+  //! No copy assignment
+  block_device_handle &operator=(const block_device_handle &) = delete;
+  //! Swap with another instance
+  LLFIO_MAKE_FREE_FUNCTION
+  void swap(block_device_handle &o) noexcept
+  {
+    block_device_handle temp(std::move(*this));
+    *this = std::move(o);
+    o = std::move(temp);
+  }
+
+  /*! Create a block device handle opening access to a block device on path, reading its geometry.
+  \param base Handle to a base location on the filing system. Pass `{}` to indicate that path will be absolute.
+  \param path The path relative to base to open, e.g. `/dev/nvme0n2` or `\\.\PhysicalDrive1`.
+  \param _mode How to open the device.
+  \param _caching How to ask the kernel to cache the device. `caching::none` bypasses the kernel page cache.
+  \param flags Any additional custom behaviours.
+
+  \errors Any of the values POSIX open() or CreateFile() can return, `errc::no_such_device` if
+  the path is not a block device.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static inline result<block_device_handle> block_device(const path_handle &base, path_view_type path, mode _mode = mode::read, caching _caching = caching::all,
+                                                         flag flags = flag::none) noexcept
+  {
+    if(_mode == mode::append)
+    {
+      return errc::invalid_argument;
+    }
+    OUTCOME_TRY(auto &&fh, file_handle::file(base, path, _mode, creation::open_existing, _caching, flags));
+    block_device_handle ret(std::move(fh));
+    OUTCOME_TRY(ret._fetch_geometry());
+    return {std::move(ret)};
+  }
+
+  //! The geometry of the device, as read when it was opened.
+  const geometry_type &geometry() const noexcept { return _geometry; }
+  //! True if the device is zoned.
+  bool is_zoned() const noexcept { return _geometry.zoned != zone_model::none; }
+
+  /*! \brief Reports the zones of the device, starting with the zone containing `offset`.
+
+  \return The zones filled into `out`, which are fewer than its size if the end of the device was reached.
+  \errors Any of the values POSIX ioctl() can return, `errc::operation_not_supported` if the device is not zoned.
+  \mallocs One, the size of `out`.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<zone>> zones(span<zone> out, extent_type offset = 0) const noexcept;
+  //! \brief Reports the zone containing `offset`.
+  result<zone> zone_at(extent_type offset) const noexcept
+  {
+    zone ret;
+    OUTCOME_TRY(auto &&filled, zones({&ret, 1}, offset));
+    if(filled.empty())
+    {
+      return errc::invalid_argument;
+    }
+    return ret;
+  }
+
+  /*! \brief Opens, closes, finishes or resets all the zones within the region, which must begin
+  and end on zone boundaries.
+
+  \errors Any of the values POSIX ioctl() can return, `errc::operation_not_supported` if the device
+  is not zoned or the kernel is older than Linux 5.5 (Linux 4.10 for resetting).
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> manage_zones(zone_operation op, extent_pair extent) noexcept;
+
+  /*! \brief Writes the buffers at the write pointer of the zone containing `zone_offset`, returning
+  the offset at which they were written.
+
+  The kernel does not expose zone append to userspace for block devices, so this reads the write
+  pointer of the zone and writes there, with appends through this handle serialised. Appends by
+  other handles or processes to the same zone may race, in which case the kernel fails whichever
+  write was not at the write pointer. The bytes written must be a multiple of `geometry().logical_block_size`.
+  If a multiplexer is set upon this handle, the write is performed using it, which on Linux may be io_uring.
+
+  \errors Any of the values `zones()` and `write()` can return, `errc::no_space_on_device` if the
+  zone does not have the capacity remaining, `errc::operation_not_supported` if the device is not zoned.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> zone_append(extent_type zone_offset, const_buffers_type buffers, deadline d = deadline()) noexcept;
+};
+
+//! \brief Constructor for `block_device_handle`
+template <> struct construct<block_device_handle>
+{
+  const path_handle &base;
+  block_device_handle::path_view_type _path;
+  block_device_handle::mode _mode = block_device_handle::mode::read;
+  block_device_handle::caching _caching = block_device_handle::caching::all;
+  block_device_handle::flag flags = block_device_handle::flag::none;
+  result<block_device_handle> operator()() const noexcept { return block_device_handle::block_device(base, _path, _mode, _caching, flags); }
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+// BEGIN make_free_functions.py
+//! Swap with another instance
+inline void swap(block_device_handle &self, block_device_handle &o) noexcept
+{
+  return self.swap(std::forward<decltype(o)>(o));
+}
+// END make_free_functions.py
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#ifdef _WIN32
+#include "detail/impl/windows/block_device_handle.ipp"
+#else
+#include "detail/impl/posix/block_device_handle.ipp"
+#endif
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
@@ -0,0 +1,384 @@
+/* A handle to a byte-orientated socket
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_BYTE_SOCKET_HANDLE_H
+#define LLFIO_BYTE_SOCKET_HANDLE_H
+
+#include "io_handle.hpp"
+
+//! \file byte_socket_handle.hpp Provides `byte_socket_handle` and `listening_byte_socket_handle`
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+class byte_socket_handle;
+class listening_byte_socket_handle;
+
+/*! \class socket_address
+\brief The address of a socket endpoint, which is an IPv4 or IPv6 address and port, or
+the path of a local (Unix domain) socket.
+
+The address is stored as the platform's `sockaddr_storage`, but without needing the
+platform's socket headers to be included.
+*/
+class LLFIO_DECL socket_address
+{
+  friend class byte_socket_handle;
+  friend class listening_byte_socket_handle;
+
+  uint32_t _len{0};
+  alignas(8) byte _storage[128];
+
+public:
+  //! The family of the address
+  enum class family_type
+  {
+    unknown,
+    v4,    //!< IPv4
+    v6,    //!< IPv6
+    local  //!< Local (Unix domain) sockets, which on Windows requires Windows 10 or later
+  };
+
+  //! Default constructs an invalid address
+  constexpr socket_address() {}  // NOLINT
+
+  //! True if this address is valid
+  bool is_valid() const noexcept { return _len != 0; }
+  //! The bytes of the `sockaddr`
+  const byte *data() const noexcept { return _storage; }
+  //! The size of the `sockaddr`
+  size_t size() const noexcept { return _len; }
+
+  //! The family of this address
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC family_type family() const noexcept;
+  //! The port of this address, or zero if a local socket
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC uint16_t port() const noexcept;
+  //! True if this address is the loopback address
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC bool is_loopback() const noexcept;
+
+  /*! \brief Returns an address from a numeric IPv4 (e.g. `127.0.0.1`) or IPv6 (e.g. `::1`) address,
+  and a port. No name resolution is performed.
+
+  \errors `errc::invalid_argument` if `address` is not a numeric IP address.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> ip(string_view address, uint16_t port) noexcept;
+  //! Returns the loopback address of `family`, which must be `v4` or `v6`, and `port`
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> loopback(family_type family, uint16_t port) noexcept;
+  //! Returns the address of `family` which binds to all interfaces, which must be `v4` or `v6`, and `port`
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> any(family_type family, uint16_t port) noexcept;
+  /*! \brief Returns the address of a local (Unix domain) socket at `path`.
+
+  \errors `errc::filename_too_long` if `path` does not fit into a `sockaddr_un`.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> local(path_view path) noexcept;
+};
+
+/*! \class byte_socket_handle
+\brief A handle to a connected, stream orientated, socket, being TCP over IPv4 or IPv6, or a
+local (Unix domain) stream socket.
+
+Sockets are i/o handles like `pipe_handle`, so if created with `flag::multiplexable` they can
+be registered with the same i/o multiplexer as file and pipe handles, and a single event loop
+can drive both network and storage i/o. Reads and writes are not seekable, the offset in the
+i/o request is ignored, and `barrier()` completes immediately as there is nothing to flush.
+A read returning zero bytes means that the other end has shut down its writing.
+
+Writes to sockets whose other end has closed fail with `errc::broken_pipe`. On BSD and Mac OS
+the socket is created with `SO_NOSIGPIPE`, and the io_uring multiplexer sends with `MSG_NOSIGNAL`,
+but otherwise on Linux the process receives `SIGPIPE` as it would for pipes, unless ignored.
+
+# io_uring
+
+The io_uring multiplexer issues `IORING_OP_RECV` for reads of a single buffer, or selects a
+buffer from its provided buffer ring. Writes of a single buffer are issued as `IORING_OP_SEND`
+or, if at least 16Kb long and the kernel is Linux 6.0 or later, as `IORING_OP_SEND_ZC` which
+transmits the pages of the buffer without copying them into the kernel. The write does not
+complete until the kernel has finished with those pages, so the buffer may be reused as usual
+upon completion. If the buffer is a registered buffer, its pre-pinned pages are used.
+*/
+class LLFIO_DECL byte_socket_handle : public io_handle
+{
+  friend class listening_byte_socket_handle;
+
+public:
+  using path_type = io_handle::path_type;
+  using extent_type = io_handle::extent_type;
+  using size_type = io_handle::size_type;
+  using mode = io_handle::mode;
+  using creation = io_handle::creation;
+  using caching = io_handle::caching;
+  using flag = io_handle::flag;
+  using buffer_type = io_handle::buffer_type;
+  using const_buffer_type = io_handle::const_buffer_type;
+  using buffers_type = io_handle::buffers_type;
+  using const_buffers_type = io_handle::const_buffers_type;
+  template <class T> using io_request = io_handle::io_request<T>;
+  template <class T> using io_result = io_handle::io_result<T>;
+  using family_type = socket_address::family_type;
+
+  //! Which directions of a connection to shut down
+  enum class shutdown_kind
+  {
+    read,   //!< No further reads
+    write,  //!< No further writes, the other end reads zero bytes once all data sent is received
+    both    //!< No further reads nor writes
+  };
+
+public:
+  //! Default constructor
+  constexpr byte_socket_handle() {}  // NOLINT
+  //! Construct a handle from a supplied native handle
+  constexpr byte_socket_handle(native_handle_type h, caching caching, flag flags, io_multiplexer *ctx)
+      : io_handle(std::move(h), caching, flags, ctx)
+  {
+  }
+  //! No copy construction (use clone())
+  byte_socket_handle(const byte_socket_handle &) = delete;
+  //! No copy assignment
+  byte_socket_handle &operator=(const byte_socket_handle &) = delete;
+  //! Implicit move construction of `byte_socket_handle` permitted
+  constexpr byte_socket_handle(byte_socket_handle &&o) noexcept
+      : io_handle(std::move(o))
+  {
+  }
+  //! Explicit conversion from handle permitted
+  explicit constexpr byte_socket_handle(handle &&o, io_multiplexer *ctx) noexcept
+      : io_handle(std::move(o), ctx)
+  {
+  }
+  //! Explicit conversion from io_handle permitted
+  explicit constexpr byte_socket_handle(io_handle &&o) noexcept
+      : io_handle(std::move(o))
+  {
+  }
+  //! Move assignment of `byte_socket_handle` permitted
+  byte_socket_handle &operator=(byte_socket_handle &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~byte_socket_handle();
+    new(this) byte_socket_handle(std::move(o));
+    return *this;
+  }
+  //! Swap with another instance
+  LLFIO_MAKE_FREE_FUNCTION
+  void swap(byte_socket_handle &o) noexcept
+  {
+    byte_socket_handle temp(std::move(*this));
+    *this = std::move(o);
+    o = std::move(temp);
+  }
+
+  /*! Create an unconnected socket handle.
+  \param family The family of address the socket will connect to.
+  \param _mode How to open the socket, usually `mode::write` so it can be both read and written.
+  \param _caching Ignored, except for what `kernel_caching()` reports.
+  \param flags Any additional custom behaviours, usually `flag::multiplexable`.
+
+  TCP sockets are created with Nagle's algorithm disabled (`TCP_NODELAY`), as callers on the hot
+  path are expected to gather each message into a single write.
+
+  \errors Any of the values POSIX `socket()` or `WSASocketW()` can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<byte_socket_handle> byte_socket(family_type family, mode _mode = mode::write, caching _caching = caching::all, flag flags = flag::none) noexcept;
+
+  /*! Convenience overload creating a socket connected to `addr`, blocking until connected or `d` expires.
+
+  \errors Any of the values `byte_socket()` or `connect()` can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static inline result<byte_socket_handle> connect_to(const socket_address &addr, mode _mode = mode::write, caching _caching = caching::all, flag flags = flag::none, deadline d = {}) noexcept
+  {
+    OUTCOME_TRY(auto &&ret, byte_socket(addr.family(), _mode, _caching, flags));
+    OUTCOME_TRY(ret.connect(addr, d));
+    return {std::move(ret)};
+  }
+
+  /*! \em Securely create two ends of an anonymous, connected, local stream socket. Unlike a pair
+  of pipes, each end can be both read and written.
+
+  \errors Any of the values POSIX `socketpair()` can return. On Windows, which lacks `socketpair()`,
+  any of the values which creating a listening socket on the IPv4 loopback and connecting to it can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::pair<byte_socket_handle, byte_socket_handle>> anonymous_socket_pair(caching _caching = caching::all, flag flags = flag::none) noexcept;
+
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~byte_socket_handle() override
+  {
+    if(_v)
+    {
+      (void) byte_socket_handle::close();
+    }
+  }
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override;
+
+  /*! \brief Connects this socket to `addr`, blocking until connected or `d` expires. A deadline
+  requires this socket to be nonblocking.
+
+  \errors Any of the values POSIX `connect()` or `WSAConnect()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> connect(const socket_address &addr, deadline d = {}) noexcept;
+
+  //! \brief Returns the address of the local end of this connection.
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> local_endpoint() const noexcept;
+  //! \brief Returns the address of the remote end of this connection.
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> remote_endpoint() const noexcept;
+
+  /*! \brief Shuts down one or both directions of this connection, without closing the handle.
+
+  \errors Any of the values POSIX `shutdown()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> shutdown(shutdown_kind kind = shutdown_kind::write) noexcept;
+};
+
+/*! \class listening_byte_socket_handle
+\brief A handle to a socket listening for incoming stream connections, which are accepted as
+`byte_socket_handle`.
+
+If created with `flag::multiplexable`, the accepted sockets are too, and `accept()` can take
+a deadline.
+*/
+class LLFIO_DECL listening_byte_socket_handle : public handle
+{
+public:
+  using path_type = handle::path_type;
+  using mode = handle::mode;
+  using creation = handle::creation;
+  using caching = handle::caching;
+  using flag = handle::flag;
+  using family_type = socket_address::family_type;
+
+public:
+  //! Default constructor
+  constexpr listening_byte_socket_handle() {}  // NOLINT
+  //! Construct a handle from a supplied native handle
+  constexpr listening_byte_socket_handle(native_handle_type h, caching caching, flag flags)
+      : handle(std::move(h), caching, flags)
+  {
+  }
+  //! No copy construction (use clone())
+  listening_byte_socket_handle(const listening_byte_socket_handle &) = delete;
+  //! No copy assignment
+  listening_byte_socket_handle &operator=(const listening_byte_socket_handle &) = delete;
+  //! Implicit move construction of `listening_byte_socket_handle` permitted
+  constexpr listening_byte_socket_handle(listening_byte_socket_handle &&o) noexcept
+      : handle(std::move(o))
+  {
+  }
+  //! Move assignment of `listening_byte_socket_handle` permitted
+  listening_byte_socket_handle &operator=(listening_byte_socket_handle &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~listening_byte_socket_handle();
+    new(this) listening_byte_socket_handle(std::move(o));
+    return *this;
+  }
+  //! Swap with another instance
+  LLFIO_MAKE_FREE_FUNCTION
+  void swap(listening_byte_socket_handle &o) noexcept
+  {
+    listening_byte_socket_handle temp(std::move(*this));
+    *this = std::move(o);
+    o = std::move(temp);
+  }
+
+  /*! Create a socket listening on `addr`.
+  \param addr The address to listen on. A port of zero chooses an unused port, which can be
+  retrieved using `local_endpoint()`.
+  \param _mode The mode with which accepted sockets are opened.
+  \param _caching The caching with which accepted sockets are opened, see `byte_socket_handle::byte_socket()`.
+  \param flags Any additional custom behaviours, which accepted sockets inherit.
+  \param backlog The maximum pending connections, or -1 for the system default.
+
+  For local sockets, any existing socket at the path is not removed, and the bind fails with
+  `errc::address_in_use` if there is one. Nor is the socket removed from the filesystem on close.
+
+  \errors Any of the values POSIX `socket()`, `bind()` or `listen()` can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<listening_byte_socket_handle> listening_byte_socket(const socket_address &addr, mode _mode = mode::write, caching _caching = caching::all, flag flags = flag::none, int backlog = -1) noexcept;
+
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~listening_byte_socket_handle() override
+  {
+    if(_v)
+    {
+      (void) listening_byte_socket_handle::close();
+    }
+  }
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override;
+
+  //! \brief Returns the address on which this socket listens.
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<socket_address> local_endpoint() const noexcept;
+
+  /*! \brief Accepts a pending connection, blocking until one arrives or `d` expires. A deadline requires
+  this socket to be nonblocking.
+
+  \errors Any of the values POSIX `accept()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<byte_socket_handle> accept(deadline d = {}) noexcept;
+};
+
+//! \brief Constructor for `byte_socket_handle`
+template <> struct construct<byte_socket_handle>
+{
+  socket_address addr;
+  byte_socket_handle::mode _mode = byte_socket_handle::mode::write;
+  byte_socket_handle::caching _caching = byte_socket_handle::caching::all;
+  byte_socket_handle::flag flags = byte_socket_handle::flag::none;
+  deadline d;
+  result<byte_socket_handle> operator()() const noexcept { return byte_socket_handle::connect_to(addr, _mode, _caching, flags, d); }
+};
+
+//! \brief Constructor for `listening_byte_socket_handle`
+template <> struct construct<listening_byte_socket_handle>
+{
+  socket_address addr;
+  listening_byte_socket_handle::mode _mode = listening_byte_socket_handle::mode::write;
+  listening_byte_socket_handle::caching _caching = listening_byte_socket_handle::caching::all;
+  listening_byte_socket_handle::flag flags = listening_byte_socket_handle::flag::none;
+  int backlog = -1;
+  result<listening_byte_socket_handle> operator()() const noexcept { return listening_byte_socket_handle::listening_byte_socket(addr, _mode, _caching, flags, backlog); }
+};
+
+// BEGIN make_free_functions.py
+// END make_free_functions.py
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#ifdef _WIN32
+#include "detail/impl/windows/byte_socket_handle.ipp"
+#else
+#include "detail/impl/posix/byte_socket_handle.ipp"
+#endif
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
@@ -45,6 +45,14 @@ Distributed under the Boost Software License, Version 1.0.
 #define LLFIO_DISABLE_PATHS_IN_FAILURE_INFO not defined
 #endif
 
+//! \def LLFIO_DISABLE_HOT_PATH_LOGGING
+//! \brief Define to not log, nor record the current handle's path in any failure info, on
+//! entry to `read()`, `write()` and `barrier()` of `io_handle`, `map_handle` and `pipe_handle`.
+//! Other logging, including of errors, is unaffected.
+#if DOXYGEN_IS_IN_THE_HOUSE
+#define LLFIO_DISABLE_HOT_PATH_LOGGING not defined
+#endif
+
 #if !defined(LLFIO_LOGGING_LEVEL)
 //! \brief How much detail to log. 0=disabled, 1=fatal, 2=error, 3=warn, 4=info, 5=debug, 6=all.
 //! Defaults to error level. \ingroup config
@@ -85,6 +93,19 @@ Distributed under the Boost Software License, Version 1.0.
 #define LLFIO_EXPERIMENTAL_STATUS_CODE 0
 #endif
 
+#if !defined(LLFIO_ENABLE_IO_STATISTICS)
+//! \brief Whether to time and count all i/o into `io_statistics`. Defaults to off. \ingroup config
+#define LLFIO_ENABLE_IO_STATISTICS 0
+#endif
+#if !defined(LLFIO_ENABLE_IO_TRACING)
+//! \brief Whether to record all i/o into `io_trace`. Defaults to off. \ingroup config
+#define LLFIO_ENABLE_IO_TRACING 0
+#endif
+#if !defined(LLFIO_IO_TRACE_EVENTS)
+//! \brief The events retained per thread by `io_trace`, which must be a power of two. Defaults to 16384. \ingroup config
+#define LLFIO_IO_TRACE_EVENTS 16384
+#endif
+
 
 #if defined(_WIN32)
 #if !defined(_WIN32_WINNT)
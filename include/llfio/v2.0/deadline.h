@@ -105,6 +105,76 @@ struct LLFIO_DEADLINE_NAME
 #endif
 };
 
+#if defined(__cplusplus) || DOXYGEN_IS_IN_THE_HOUSE
+/*! \struct coarse_steady_clock
+\brief A steady clock which is cheaper to read than `std::chrono::steady_clock`, at the cost of
+resolution, whose time points are those of `std::chrono::steady_clock`.
+
+On Linux this is `CLOCK_MONOTONIC_COARSE`, and on FreeBSD `CLOCK_MONOTONIC_FAST`, both of which
+are read from memory the kernel updates every tick without a syscall, even in virtual machines
+whose precise clock needs one. Elsewhere it is `std::chrono::steady_clock`, which is already cheap.
+*/
+struct coarse_steady_clock
+{
+  using duration = std::chrono::steady_clock::duration;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::steady_clock::time_point;
+  static constexpr bool is_steady = true;
+
+  //! The current time, which may lag `std::chrono::steady_clock::now()` by up to `resolution()`.
+  static time_point now() noexcept
+  {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    struct timespec ts;
+    if(-1 != clock_gettime(CLOCK_MONOTONIC_COARSE, &ts))
+    {
+      return time_point(std::chrono::duration_cast<duration>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+    }
+#elif defined(__FreeBSD__) && defined(CLOCK_MONOTONIC_FAST)
+    struct timespec ts;
+    if(-1 != clock_gettime(CLOCK_MONOTONIC_FAST, &ts))
+    {
+      return time_point(std::chrono::duration_cast<duration>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+    }
+#endif
+    return std::chrono::steady_clock::now();
+  }
+  //! The resolution of `now()`, which is zero if it is `std::chrono::steady_clock`.
+  static std::chrono::nanoseconds resolution() noexcept
+  {
+    static const std::chrono::nanoseconds v = [] {
+#if(defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)) || (defined(__FreeBSD__) && defined(CLOCK_MONOTONIC_FAST))
+      struct timespec ts;
+#ifdef __linux__
+      if(-1 != clock_getres(CLOCK_MONOTONIC_COARSE, &ts))
+#else
+      if(-1 != clock_getres(CLOCK_MONOTONIC_FAST, &ts))
+#endif
+      {
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+      }
+#endif
+      return std::chrono::nanoseconds(0);
+    }();
+    return v;
+  }
+};
+
+namespace detail
+{
+  /* The clock used to measure steady deadlines, which is coarse if the deadline is long
+  enough that being up to a tick late does not matter. Both the beginning and the checks of
+  a deadline must use the same clock, which they do as the choice depends only on the deadline.
+  */
+  inline std::chrono::steady_clock::time_point deadline_steady_now(unsigned long long nsecs) noexcept
+  {
+    const auto resolution = coarse_steady_clock::resolution().count();
+    return (resolution > 0 && nsecs >= 16 * (unsigned long long) resolution) ? coarse_steady_clock::now() : std::chrono::steady_clock::now();
+  }
+}  // namespace detail
+#endif
+
 /*! Defines a number of variables into its scope:
 
 - began_steady: Set to the steady clock at the beginning of a sleep
@@ -114,7 +184,7 @@ struct LLFIO_DEADLINE_NAME
   if(d)                                                                                                                                                        \
   {                                                                                                                                                            \
     if((d).steady && (d).nsecs != 0)                                                                                                                           \
-      began_steady = std::chrono::steady_clock::now();                                                                                                         \
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs);                                                                               \
   }
 
 //! Run inside a series of steps to create a sub-deadline from a master deadline
@@ -126,7 +196,7 @@ struct LLFIO_DEADLINE_NAME
       (nd).steady = true;                                                                                                                                      \
       std::chrono::nanoseconds ns =                                                                                                                            \
       ((d).nsecs != 0) ?                                                                                                                                       \
-      std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now()) :          \
+      std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs)) :          \
       std::chrono::nanoseconds(0);                                                                                                                             \
       if(ns.count() < 0)                                                                                                                                       \
         (nd).nsecs = 0;                                                                                                                                        \
@@ -147,7 +217,7 @@ struct LLFIO_DEADLINE_NAME
       if((d).steady)                                                                                                                                           \
       {                                                                                                                                                        \
         timeout = ((d).nsecs != 0) ?                                                                                                                           \
-                  std::chrono::duration_cast<timeout_type>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now()) :          \
+                  std::chrono::duration_cast<timeout_type>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs)) :          \
                   timeout_type(0);                                                                                                                             \
       }                                                                                                                                                        \
       else                                                                                                                                                     \
@@ -163,7 +233,7 @@ struct LLFIO_DEADLINE_NAME
   {                                                                                                                                                            \
     if((d).steady)                                                                                                                                             \
     {                                                                                                                                                          \
-      if((d).nsecs == 0 || std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))                                           \
+      if((d).nsecs == 0 || LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))                                           \
         return LLFIO_V2_NAMESPACE::failure(LLFIO_V2_NAMESPACE::errc::timed_out);                                                                               \
     }                                                                                                                                                          \
     else                                                                                                                                                       \
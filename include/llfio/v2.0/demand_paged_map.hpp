@@ -0,0 +1,156 @@
+/* Memory whose pages are materialised on first touch by a user callback
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_DEMAND_PAGED_MAP_H
+#define LLFIO_DEMAND_PAGED_MAP_H
+
+#include "map_handle.hpp"
+
+#include <memory>
+#include <thread>
+
+//! \file demand_paged_map.hpp Provides `demand_paged_map`
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+/*! \class demand_paged_map
+\brief A region of memory whose pages are filled on first touch by a user supplied callback,
+so data in a compressed or remote store can be made to appear as plain memory, materialised
+lazily page by page.
+
+On Linux, this is implemented using `userfaultfd()`. A handler thread owned by this object
+waits for page faults, invokes the fill callback with a page sized buffer and the offset
+of the faulting page, and then atomically installs the filled page at the faulting address.
+The faulting thread is resumed as if the page had always been there. If the kernel refuses
+unprivileged use of `userfaultfd()` (see `/proc/sys/vm/unprivileged_userfaultfd`), `map()`
+fails with `errc::operation_not_permitted`.
+
+On other platforms, `map()` fails with `errc::operation_not_supported`.
+
+Note that:
+
+- The fill callback is invoked from the handler thread, concurrently with your own threads.
+It must not touch the unmaterialised pages of this region, or it will deadlock.
+- If the fill callback fails, the faulting page is installed zero filled, and `failures()` is
+incremented. There is no way of reporting a failure to a plain memory access.
+- `discard()` throws away materialised pages, so they will be refilled on next touch. This
+lets you bound the memory consumed by a sparse walk over a huge dataset.
+*/
+class LLFIO_DECL demand_paged_map
+{
+public:
+  using extent_type = map_handle::extent_type;
+  using size_type = map_handle::size_type;
+  using buffer_type = map_handle::buffer_type;
+  //! The type of the fill callback, which receives the offset of the page, and the page to fill
+  using fill_function = function_ptr<result<void>(extent_type offset, buffer_type page)>;
+
+protected:
+  struct _state_t
+  {
+    byte *addr{nullptr};
+    size_type length{0}, pagesize{0};
+    int uffd{-1}, wakefd{-1};
+    fill_function fill;
+    std::thread handler;
+    std::atomic<size_t> materialised{0}, failures{0};
+  };
+  std::unique_ptr<_state_t> _state;
+
+public:
+  //! Default constructor
+  demand_paged_map() = default;
+  //! Implicit move construction permitted
+  demand_paged_map(demand_paged_map &&) = default;
+  //! No copy construction
+  demand_paged_map(const demand_paged_map &) = delete;
+  //! Move assignment permitted
+  demand_paged_map &operator=(demand_paged_map &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~demand_paged_map();
+    new(this) demand_paged_map(std::move(o));
+    return *this;
+  }
+  //! No copy assignment
+  demand_paged_map &operator=(const demand_paged_map &) = delete;
+  ~demand_paged_map()
+  {
+    if(_state)
+    {
+      auto ret = close();
+      if(ret.has_error())
+      {
+        LLFIO_LOG_FATAL(nullptr, "demand_paged_map::~demand_paged_map() close failed");
+        abort();
+      }
+    }
+  }
+
+  /*! \brief Reserves `bytes` of address space rounded up to the page size, whose pages are
+  filled on first touch by `fill`.
+
+  \errors `errc::operation_not_supported` if this platform has no means of handling page faults
+  in user space, `errc::operation_not_permitted` if the kernel refuses them to this process, else
+  any of the values `userfaultfd()`, `mmap()` or `ioctl()` can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<demand_paged_map> map(size_type bytes, fill_function fill) noexcept;
+  //! Stops the handler thread, and releases the memory
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> close() noexcept;
+
+  //! True if this is a valid region
+  bool is_valid() const noexcept { return _state != nullptr; }
+  //! The address of the region
+  byte *address() const noexcept { return _state ? _state->addr : nullptr; }
+  //! The length of the region, which is a multiple of `page_size()`
+  size_type length() const noexcept { return _state ? _state->length : 0; }
+  //! The granularity with which pages are filled
+  size_type page_size() const noexcept { return _state ? _state->pagesize : 0; }
+  //! The number of pages filled so far
+  size_t pages_materialised() const noexcept { return _state ? _state->materialised.load(std::memory_order_relaxed) : 0; }
+  //! The number of times the fill callback failed
+  size_t failures() const noexcept { return _state ? _state->failures.load(std::memory_order_relaxed) : 0; }
+
+  /*! \brief Throws away the materialised pages within `region`, so they will be refilled upon next
+  touch. Returns the page aligned region actually discarded.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> discard(buffer_type region) noexcept;
+};
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#ifdef _WIN32
+#include "detail/impl/windows/demand_paged_map.ipp"
+#else
+#include "detail/impl/posix/demand_paged_map.ipp"
+#endif
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
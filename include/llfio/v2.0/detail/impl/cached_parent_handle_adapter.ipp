@@ -33,37 +33,187 @@ namespace algorithm
 {
   namespace detail
   {
+    static_assert(LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN > 0, "LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN must be at least one");
     struct cached_path_handle_map_
     {
-      std::mutex lock;
-      size_t gc_count{0};
-      std::unordered_map<filesystem::path, std::weak_ptr<cached_path_handle>, path_hasher> by_path;
+      static constexpr size_t shard_count = 64;
+      struct entry
+      {
+        filesystem::path path;
+        std::weak_ptr<cached_path_handle> handle;
+      };
+      // Each shard is on its own cache line so threads using different shards do not contend
+      struct alignas(64) shard
+      {
+        std::mutex lock;
+        size_t gc_count{0};
+        std::unordered_multimap<uint64_t, entry> by_hash;
+        // Most recently used first
+        cached_path_handle_ptr retained[LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN];
+
+        // Returns a live handle for the path, if there is one
+        cached_path_handle_ptr find(uint64_t hash, path_view path) const
+        {
+          auto range = by_hash.equal_range(hash);
+          for(auto it = range.first; it != range.second; ++it)
+          {
+            if(path_view(it->second.path) == path)
+            {
+              auto ret = it->second.handle.lock();
+              if(ret)
+              {
+                return ret;
+              }
+            }
+          }
+          return {};
+        }
+        // Sets the handle for the path
+        void insert(uint64_t hash, path_view path, const cached_path_handle_ptr &h)
+        {
+          auto range = by_hash.equal_range(hash);
+          for(auto it = range.first; it != range.second; ++it)
+          {
+            if(path_view(it->second.path) == path)
+            {
+              it->second.handle = h;
+              return;
+            }
+          }
+          by_hash.emplace(hash, entry{path.path(), h});
+        }
+        // Removes the path if it refers to the handle, or to nothing
+        void erase(uint64_t hash, path_view path, const cached_path_handle *h)
+        {
+          auto range = by_hash.equal_range(hash);
+          for(auto it = range.first; it != range.second; ++it)
+          {
+            if(path_view(it->second.path) == path)
+            {
+              auto p = it->second.handle.lock();
+              if(p == nullptr || p.get() == h)
+              {
+                by_hash.erase(it);
+              }
+              return;
+            }
+          }
+        }
+        // Makes the handle the most recently used, returning any handle no longer retained for releasing outside the lock
+        cached_path_handle_ptr retain(cached_path_handle_ptr h)
+        {
+          size_t n = 0;
+          while(n < LLFIO_CACHED_PARENT_HANDLE_ADAPTER_RETAIN - 1 && retained[n] != h)
+          {
+            n++;
+          }
+          cached_path_handle_ptr evicted;
+          if(retained[n] != h)
+          {
+            evicted = std::move(retained[n]);
+          }
+          for(; n > 0; n--)
+          {
+            retained[n] = std::move(retained[n - 1]);
+          }
+          retained[0] = std::move(h);
+          return evicted;
+        }
+        void gc()
+        {
+          if(gc_count++ >= 1024)
+          {
+            for(auto it = by_hash.begin(); it != by_hash.end();)
+            {
+              if(it->second.handle.expired())
+              {
+                it = by_hash.erase(it);
+              }
+              else
+              {
+                ++it;
+              }
+            }
+            gc_count = 0;
+          }
+        }
+      };
+      shard shards[shard_count];
+
+      shard &shard_for(uint64_t hash) noexcept { return shards[(hash ^ (hash >> 32)) % shard_count]; }
     };
     inline cached_path_handle_map_ &cached_path_handle_map()
     {
       static cached_path_handle_map_ map;
       return map;
     }
+    // Views a directory path without any trailing separators, so "/a/b/" and "/a/b" are the same key
+    inline path_view cached_path_handle_key(path_view v) noexcept
+    {
+      return LLFIO_V2_NAMESPACE::visit(v, [&v](auto sv) {
+        auto length = sv.size();
+        while(length > 1)
+        {
+          const auto c = LLFIO_V2_NAMESPACE::detail::code_unit_value(sv[length - 1]);
+#ifdef _WIN32
+          if(c != '/' && c != '\\')
+#else
+          if(c != '/')
+#endif
+          {
+            break;
+          }
+          length--;
+        }
+        return path_view(sv.data(), length, path_view::not_zero_terminated, v.formatting());
+      });
+    }
     LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<filesystem::path> cached_path_handle::current_path(const filesystem::path &append) noexcept
     {
       try
       {
         auto ret = h.current_path();
-        auto &map = cached_path_handle_map();
-        std::lock_guard<std::mutex> g(map.lock);
         if(!ret)
         {
           std::string msg("cached_path_handle::current_path() failed to retrieve current path of cached handle due to ");
           msg.append(ret.error().message().c_str());
           LLFIO_LOG_WARN(nullptr, msg.c_str());
         }
-        else if(!ret.value().empty() && ret.value() != _lastpath)
+        filesystem::path oldpath, newpath;
+        bool changed = false;
+        {
+          lock_guard<spinlock> g(_lock);
+          if(ret && !ret.value().empty() && ret.value() != _lastpath)
+          {
+            oldpath = std::move(_lastpath);
+            _lastpath = std::move(ret).value();
+            newpath = _lastpath;
+            changed = true;
+          }
+          else
+          {
+            newpath = _lastpath;
+          }
+        }
+        if(changed)
         {
-          map.by_path.erase(_lastpath);
-          _lastpath = std::move(ret).value();
-          map.by_path.emplace(_lastpath, shared_from_this());
+          auto &map = cached_path_handle_map();
+          {
+            const path_view key = cached_path_handle_key(oldpath);
+            const uint64_t hash = key.hash();
+            auto &shard = map.shard_for(hash);
+            std::lock_guard<std::mutex> g(shard.lock);
+            shard.erase(hash, key, this);
+          }
+          {
+            const path_view key = cached_path_handle_key(newpath);
+            const uint64_t hash = key.hash();
+            auto &shard = map.shard_for(hash);
+            std::lock_guard<std::mutex> g(shard.lock);
+            shard.insert(hash, key, shared_from_this());
+          }
         }
-        return _lastpath / append;
+        return newpath / append;
       }
       catch(...)
       {
@@ -74,6 +224,7 @@ namespace algorithm
     {
       path_view leaf(path.filename());
       path = path.remove_filename();
+      // Only build a path if the one supplied cannot be used as the key as is
       filesystem::path dirpath;
       if(base.is_valid())
       {
@@ -81,12 +232,15 @@ namespace algorithm
       }
       else
       {
-        dirpath = path.path();
         if(path.empty())
         {
           dirpath = filesystem::current_path();
         }
 #ifdef _WIN32
+        else
+        {
+          dirpath = path.path();
+        }
         // On Windows, only use the kernel path form
         dirpath = path_handle::path(dirpath).value().current_path().value();
 #endif
@@ -95,55 +249,63 @@ namespace algorithm
           path = dirpath;
         }
       }
+      const path_view key = cached_path_handle_key(dirpath.empty() ? path : path_view(dirpath));
+      const uint64_t hash = key.hash();
       auto &map = cached_path_handle_map();
-      std::lock_guard<std::mutex> g(map.lock);
-      auto rungc = make_scope_exit([&map]() noexcept {
-        if(map.gc_count++ >= 1024)
-        {
-          for(auto it = map.by_path.begin(); it != map.by_path.end();)
-          {
-            if(it->second.expired())
-            {
-              it = map.by_path.erase(it);
-            }
-            else
-            {
-              ++it;
-            }
-          }
-          map.gc_count = 0;
-        }
-      });
-      (void) rungc;
-      auto it = map.by_path.find(dirpath);
-      if(it != map.by_path.end())
+      auto &shard = map.shard_for(hash);
+      auto leafpath = leaf.path();
+      // Declared before the locks so they are released after them
+      cached_path_handle_ptr evicted, discarded;
       {
-        cached_path_handle_ptr ret = it->second.lock();
+        std::lock_guard<std::mutex> g(shard.lock);
+        shard.gc();
+        cached_path_handle_ptr ret = shard.find(hash, key);
         if(ret)
         {
-          return {ret, leaf.path()};
+          evicted = shard.retain(ret);
+          return {std::move(ret), std::move(leafpath)};
         }
       }
+      // Open the directory outside the lock
       cached_path_handle_ptr ret = std::make_shared<cached_path_handle>(directory_handle::directory(base, path).value());
       auto _currentpath = ret->h.current_path();
-      if(_currentpath)
+      if(_currentpath && !_currentpath.value().empty())
       {
         ret->_lastpath = std::move(_currentpath).value();
       }
       else
       {
-        ret->_lastpath = std::move(dirpath);
+        ret->_lastpath = key.path();
       }
-      it = map.by_path.find(ret->_lastpath);
-      if(it != map.by_path.end())
+      // Once published, _lastpath may be changed by other threads
+      const filesystem::path lastpath = ret->_lastpath;
       {
-        it->second = ret;
+        std::lock_guard<std::mutex> g(shard.lock);
+        // Somebody else may have opened it meanwhile
+        cached_path_handle_ptr existing = shard.find(hash, key);
+        if(existing)
+        {
+          discarded = std::move(ret);
+          ret = std::move(existing);
+        }
+        else
+        {
+          shard.insert(hash, key, ret);
+        }
+        evicted = shard.retain(ret);
       }
-      else
+      if(discarded == nullptr)
       {
-        map.by_path.emplace(ret->_lastpath, ret);
+        const path_view lastkey = cached_path_handle_key(lastpath);
+        const uint64_t lasthash = lastkey.hash();
+        if(lasthash != hash || !(lastkey == key))
+        {
+          auto &lastshard = map.shard_for(lasthash);
+          std::lock_guard<std::mutex> g(lastshard.lock);
+          lastshard.insert(lasthash, lastkey, ret);
+        }
       }
-      return {ret, leaf.path()};
+      return {std::move(ret), std::move(leafpath)};
     }
   }  // namespace detail
 }  // namespace algorithm
@@ -23,6 +23,15 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../../algorithm/clone.hpp"
+#include "../../symlink_handle.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
 
 LLFIO_V2_NAMESPACE_BEGIN
 
@@ -30,7 +39,7 @@ namespace algorithm
 {
   LLFIO_HEADERS_ONLY_FUNC_SPEC result<file_handle::extent_type> clone_or_copy(file_handle &src, const path_handle &destdir, path_view destleaf,
                                                                               bool preserve_timestamps, bool force_copy_now, file_handle::creation creation,
-                                                                              deadline d) noexcept
+                                                                              deadline d, size_t threads) noexcept
   {
     LLFIO_LOG_FUNCTION_CALL(&src);
     filesystem::path destleaf_;
@@ -87,16 +96,784 @@ namespace algorithm
       }
     }
     statfs_t statfs;
-    OUTCOME_TRY(statfs.fill(src, statfs_t::want::bavail));
-    if(stat.st_blocks > statfs.f_bavail)
+    OUTCOME_TRY(statfs.fill(src, statfs_t::want::bsize | statfs_t::want::bavail));
+    if(stat.st_allocated > statfs.f_bavail * statfs.f_bsize)
     {
       return errc::no_space_on_device;
     }
-    OUTCOME_TRY(auto &&copied, src.clone_extents_to(dest, d, force_copy_now, true));
+    // Copy only the valid extents, so holes in the source remain holes in the destination
+    OUTCOME_TRY(dest.truncate(stat.st_size));
+    OUTCOME_TRY(auto &&extents, src.extents());
+    file_handle::extent_type total = 0;
+    for(auto &extent : extents)
+    {
+      if(extent.offset + extent.length > (file_handle::extent_type) stat.st_size)
+      {
+        extent.length = ((file_handle::extent_type) stat.st_size > extent.offset) ? (stat.st_size - extent.offset) : 0;
+      }
+      total += extent.length;
+    }
+    if(threads == 0)
+    {
+      threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    /* Each region copied enumerates the extents of the source from its beginning, so
+    regions are few and large. Below this, a single kernel thread copies everything.
+    */
+    static constexpr file_handle::extent_type min_region = (file_handle::extent_type) 64 * 1024 * 1024;
+    const file_handle::extent_type region = std::max(min_region, (total / (threads * 4) + 65535) & ~(file_handle::extent_type) 65535);
+    std::vector<file_handle::extent_pair> regions;
+    for(auto &extent : extents)
+    {
+      for(file_handle::extent_type offset = 0; offset < extent.length; offset += region)
+      {
+        regions.emplace_back(extent.offset + offset, std::min(region, extent.length - offset));
+      }
+    }
+    std::atomic<size_t> next(0);
+    std::atomic<file_handle::extent_type> copied(0);
+    std::mutex lock;
+    result<void> first_failure = success();
+    auto worker = [&]() noexcept {
+      for(size_t n; (n = next.fetch_add(1, std::memory_order_relaxed)) < regions.size();)
+      {
+        auto r = src.clone_extents_to(regions[n], dest, regions[n].offset, d, force_copy_now, true);
+        if(!r)
+        {
+          std::lock_guard<std::mutex> g(lock);
+          if(first_failure)
+          {
+            first_failure = std::move(r).error();
+          }
+          next.store(regions.size(), std::memory_order_relaxed);
+          return;
+        }
+        copied.fetch_add(r.assume_value().length, std::memory_order_relaxed);
+      }
+    };
+    {
+      std::vector<std::thread> workers;
+      auto unworkers = make_scope_exit([&]() noexcept {
+        for(auto &i : workers)
+        {
+          i.join();
+        }
+      });
+      for(size_t n = 1; n < std::min(threads, regions.size()); n++)
+      {
+        workers.emplace_back(worker);
+      }
+      worker();
+    }
+    OUTCOME_TRY(std::move(first_failure));
     failed = false;
-    return copied.length;
+    return copied.load(std::memory_order_relaxed);
+  }
+
+  namespace detail
+  {
+    struct clone_state
+    {
+      struct job_type
+      {
+        std::shared_ptr<directory_handle> srcdir, destdir;
+        filesystem::path leaf;
+      };
+
+      clone_copy_link_symlink_visitor *visitor{nullptr};
+      filesystem::path srcrootpath;
+      directory_handle destroot;
+
+      std::mutex lock;
+      std::condition_variable jobs_available, space_available;
+      std::deque<job_type> jobs;
+      size_t in_flight{0};  // queued or executing
+      bool finished{false};
+      result<void> first_failure{success()};
+      std::vector<filesystem::path> directories;  // relative to the roots, for restamping
+
+      std::atomic<size_t> items_done{0};
+      std::atomic<file_handle::extent_type> bytes_done{0};
+
+      void fail(result<void>::error_type &&error) noexcept
+      {
+        std::lock_guard<std::mutex> g(lock);
+        if(first_failure)
+        {
+          first_failure = std::move(error);
+        }
+      }
+
+      result<void> enqueue(job_type &&job)
+      {
+        {
+          std::unique_lock<std::mutex> g(lock);
+          space_available.wait(g, [&] { return in_flight < visitor->max_in_flight || !first_failure; });
+          if(!first_failure)
+          {
+            return first_failure;
+          }
+          jobs.push_back(std::move(job));
+          ++in_flight;
+        }
+        jobs_available.notify_one();
+        return success();
+      }
+
+      result<file_handle::extent_type> execute(const job_type &job) noexcept
+      {
+        const deadline d(visitor->timeout);
+        switch(visitor->op)
+        {
+        case clone_copy_link_symlink_visitor::none:
+          return 0;
+        case clone_copy_link_symlink_visitor::clone:
+        case clone_copy_link_symlink_visitor::copy:
+        {
+          OUTCOME_TRY(auto &&src, file_handle::file(*job.srcdir, job.leaf));
+          return clone_or_copy(src, *job.destdir, job.leaf, true, visitor->op == clone_copy_link_symlink_visitor::copy,
+                               visitor->always_create_new_files ? file_handle::creation::always_new : file_handle::creation::if_needed, d);
+        }
+        case clone_copy_link_symlink_visitor::link:
+        {
+          OUTCOME_TRY(auto &&src, file_handle::file(*job.srcdir, job.leaf, file_handle::mode::attr_read));
+          OUTCOME_TRY(src.link(*job.destdir, job.leaf, d));
+          return 0;
+        }
+        case clone_copy_link_symlink_visitor::symlink:
+        {
+          OUTCOME_TRY(auto &&srcdirpath, job.srcdir->current_path());
+          const filesystem::path target = srcdirpath / job.leaf;
+          OUTCOME_TRY(auto &&dest, symlink_handle::symlink(*job.destdir, job.leaf, symlink_handle::mode::write,
+                                                           visitor->always_create_new_files ? symlink_handle::creation::only_if_not_exist :
+                                                                                              symlink_handle::creation::if_needed));
+          OUTCOME_TRY(dest.write(symlink_handle::const_buffers_type(target)));
+          return 0;
+        }
+        }
+        return errc::invalid_argument;
+      }
+
+      void worker() noexcept
+      {
+        for(;;)
+        {
+          job_type job;
+          bool failed;
+          size_t queued;
+          {
+            std::unique_lock<std::mutex> g(lock);
+            jobs_available.wait(g, [&] { return !jobs.empty() || finished; });
+            if(jobs.empty())
+            {
+              return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            failed = !first_failure;
+            queued = in_flight - 1;
+          }
+          if(!failed)
+          {
+            auto r = execute(job);
+            if(r)
+            {
+              const auto items = items_done.fetch_add(1, std::memory_order_relaxed) + 1;
+              const auto bytes = bytes_done.fetch_add(r.value(), std::memory_order_relaxed) + r.value();
+              auto p = visitor->progress(this, items, bytes, queued);
+              if(!p)
+              {
+                fail(std::move(p).error());
+              }
+            }
+            else
+            {
+              fail(std::move(r).error());
+            }
+          }
+          job = {};  // close our handles to the directories before admitting more work
+          {
+            std::lock_guard<std::mutex> g(lock);
+            --in_flight;
+          }
+          space_available.notify_all();
+        }
+      }
+    };
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> clone_copy_link_symlink_visitor::post_enumeration(void *data, const directory_handle &dirh,
+                                                                                                 directory_handle::buffers_type &contents, size_t depth) noexcept
+  {
+    (void) depth;
+    auto *state = (detail::clone_state *) data;
+    try
+    {
+      // Find the directory in the destination corresponding to this one
+      OUTCOME_TRY(auto &&dirhpath, dirh.current_path());
+      filesystem::path relpath;
+      if(dirhpath.native().size() > state->srcrootpath.native().size())
+      {
+        relpath = dirhpath.native().substr(state->srcrootpath.native().size() + 1);
+      }
+      OUTCOME_TRY(auto &&destdirh, directory_handle::directory(state->destroot, relpath, directory_handle::mode::write, directory_handle::creation::if_needed));
+      std::shared_ptr<directory_handle> srcdir, destdir = std::make_shared<directory_handle>(std::move(destdirh));
+      for(auto &entry : contents)
+      {
+        if(entry.stat.st_type == filesystem::file_type::directory)
+        {
+          // Create it now so it exists before traverse() enumerates it
+          OUTCOME_TRY(directory_handle::directory(*destdir, entry.leafname, directory_handle::mode::write, directory_handle::creation::if_needed));
+          std::lock_guard<std::mutex> g(state->lock);
+          state->directories.push_back(relpath / entry.leafname);
+          state->items_done.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if(entry.stat.st_type == filesystem::file_type::symlink && !follow_symlinks)
+        {
+          if(op == op_t::none)
+          {
+            continue;
+          }
+          // Clone the symlink itself, which is quick, so do it now
+          OUTCOME_TRY(auto &&srclink, symlink_handle::symlink(dirh, entry.leafname));
+          OUTCOME_TRY(auto &&target, srclink.read());
+          OUTCOME_TRY(auto &&destlink, symlink_handle::symlink(*destdir, entry.leafname, symlink_handle::mode::write,
+                                                               always_create_new_files ? symlink_handle::creation::only_if_not_exist :
+                                                                                         symlink_handle::creation::if_needed));
+          OUTCOME_TRY(destlink.write(symlink_handle::const_buffers_type(target.path(), target.type())));
+          state->items_done.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if(entry.stat.st_type == filesystem::file_type::regular || entry.stat.st_type == filesystem::file_type::symlink)
+        {
+          if(op == op_t::none)
+          {
+            continue;
+          }
+          if(!srcdir)
+          {
+            OUTCOME_TRY(auto &&srcdirh, dirh.reopen());
+            srcdir = std::make_shared<directory_handle>(std::move(srcdirh));
+          }
+          detail::clone_state::job_type job{srcdir, destdir, entry.leafname.path()};
+          OUTCOME_TRY(state->enqueue(std::move(job)));
+        }
+      }
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> clone_or_copy(const path_handle &srcdir, path_view srcleaf, const path_handle &destdir, path_view destleaf,
+                                                             clone_copy_link_symlink_visitor *visitor, size_t threads, bool force_slow_path) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&srcdir);
+    try
+    {
+      clone_copy_link_symlink_visitor default_visitor;
+      if(visitor == nullptr)
+      {
+        visitor = &default_visitor;
+      }
+      visitor->begin = std::chrono::steady_clock::now();
+      OUTCOME_TRY(auto &&srcroot, directory_handle::directory(srcdir, srcleaf));
+      OUTCOME_TRY(auto &&destroot, directory_handle::directory(destdir, destleaf.empty() ? srcleaf : destleaf, directory_handle::mode::write,
+                                                               directory_handle::creation::if_needed));
+      detail::clone_state state;
+      state.visitor = visitor;
+      OUTCOME_TRY(auto &&srcrootpath, srcroot.current_path());
+      state.srcrootpath = std::move(srcrootpath);
+      state.destroot = std::move(destroot);
+
+      auto traversed = [&]() -> result<size_t> {
+        std::vector<std::thread> workers;
+        auto unworkers = make_scope_exit([&]() noexcept {
+          {
+            std::lock_guard<std::mutex> g(state.lock);
+            state.finished = true;
+          }
+          state.jobs_available.notify_all();
+          for(auto &i : workers)
+          {
+            i.join();
+          }
+        });
+        const size_t nworkers = std::max<size_t>(1, visitor->max_in_flight);
+        workers.reserve(nworkers);
+        for(size_t n = 0; n < nworkers; n++)
+        {
+          workers.emplace_back([&state] { state.worker(); });
+        }
+        return traverse(srcroot, visitor, threads, &state, force_slow_path);
+      }();
+      OUTCOME_TRY(std::move(state.first_failure));
+      OUTCOME_TRY(std::move(traversed));
+
+      // Now the contents are complete, restamp the destination directories from the source.
+      // Subdirectories are restamped by leafname in a batch per parent directory, and only
+      // the metadata which differs is set.
+      std::map<filesystem::path, std::vector<filesystem::path>> byparent;
+      for(auto &relpath : state.directories)
+      {
+        byparent[relpath.parent_path()].push_back(relpath.filename());
+      }
+      static constexpr stat_t::want restamped = stat_t::want::type | stat_t::want::perms | stat_t::want::uid | stat_t::want::gid | stat_t::want::atim |
+                                                stat_t::want::mtim | stat_t::want::birthtim;
+      for(auto &parent : byparent)
+      {
+        OUTCOME_TRY(auto &&src, directory_handle::directory(srcroot, parent.first));
+        OUTCOME_TRY(auto &&dest, directory_handle::directory(state.destroot, parent.first));
+        std::vector<directory_handle::buffer_type> srcentries(parent.second.size()), destentries(parent.second.size());
+        for(size_t n = 0; n < parent.second.size(); n++)
+        {
+          srcentries[n].leafname = parent.second[n];
+          destentries[n].leafname = parent.second[n];
+        }
+        OUTCOME_TRY(auto &&srcfilled, src.stat_entries(srcentries, restamped));
+        OUTCOME_TRY(auto &&destfilled, dest.stat_entries(destentries, restamped));
+        std::vector<stat_t> current(parent.second.size(), stat_t(nullptr));
+        for(size_t n = 0; n < parent.second.size(); n++)
+        {
+          OUTCOME_TRY(std::move(srcfilled[n]));
+          OUTCOME_TRY(std::move(destfilled[n]));
+          current[n] = destentries[n].stat;
+        }
+        OUTCOME_TRY(auto &&stamped, dest.stamp_entries(srcentries, restamped, current));
+        for(auto &r : stamped)
+        {
+          OUTCOME_TRY(std::move(r));
+        }
+      }
+      {
+        OUTCOME_TRY(auto &&src, directory_handle::directory(srcroot, filesystem::path()));
+        OUTCOME_TRY(auto &&dest, directory_handle::directory(state.destroot, filesystem::path(), directory_handle::mode::attr_write));
+        stat_t stat(nullptr);
+        OUTCOME_TRY(stat.fill(src));
+        OUTCOME_TRY(stat.stamp(dest));
+      }
+      const auto items = state.items_done.load(std::memory_order_relaxed);
+      OUTCOME_TRY(visitor->progress(&state, items, state.bytes_done.load(std::memory_order_relaxed), 0));
+      return items;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  struct async_clone_extents::_state_type
+  {
+    enum class slot_status
+    {
+      idle,
+      reading,
+      writing
+    };
+    struct slot_type
+    {
+      slot_status status{slot_status::idle};
+      byte *buffer{nullptr};
+      file_handle::buffer_type rb;
+      file_handle::const_buffer_type wb;
+      extent_type offset{0};   // in the source
+      size_t length{0};        // valid bytes in the buffer
+      size_t written{0};       // bytes of the buffer written so far
+      io_multiplexer::pooled_io_operation_state_ptr op;
+    };
+
+    file_handle *src{nullptr}, *dest{nullptr};
+    io_multiplexer *multiplexer{nullptr};
+    extent_pair extent;
+    extent_type destoffset{0};
+    size_t blocksize{0};
+    std::vector<extent_pair> todo;  // valid extents of the source yet to be read
+    size_t todo_idx{0};
+    std::vector<slot_type> slots;
+    std::atomic<bool> cancelled{false};
+    progress_type progress;
+    bool finished{false};
+
+    _state_type() = default;
+    _state_type(const _state_type &) = delete;
+    _state_type(_state_type &&) = delete;
+    _state_type &operator=(const _state_type &) = delete;
+    _state_type &operator=(_state_type &&) = delete;
+    ~_state_type()
+    {
+      (void) abort();
+      for(auto &slot : slots)
+      {
+        if(slot.buffer != nullptr)
+        {
+          utils::page_allocator<byte>().deallocate(slot.buffer, blocksize);
+        }
+      }
+    }
+
+    // Takes the next chunk to be read from the todo list
+    bool next_chunk(slot_type &slot) noexcept
+    {
+      if(todo_idx == todo.size())
+      {
+        return false;
+      }
+      auto &item = todo[todo_idx];
+      slot.offset = item.offset;
+      slot.length = (size_t) std::min(item.length, (extent_type) blocksize);
+      slot.written = 0;
+      item.offset += slot.length;
+      item.length -= slot.length;
+      if(item.length == 0)
+      {
+        todo_idx++;
+      }
+      return true;
+    }
+    extent_type dest_offset(const slot_type &slot) const noexcept { return slot.offset - extent.offset + destoffset + slot.written; }
+
+    result<void> issue_read(slot_type &slot) noexcept
+    {
+      slot.rb = {slot.buffer, slot.length};
+      file_handle::io_request<file_handle::buffers_type> req({&slot.rb, 1}, slot.offset);
+      OUTCOME_TRY(auto &&op, multiplexer->construct_and_init_pooled(src, nullptr, {}, {}, req));
+      slot.op = std::move(op);
+      slot.status = slot_status::reading;
+      progress.reads_in_flight++;
+      return success();
+    }
+    result<void> issue_write(slot_type &slot) noexcept
+    {
+      slot.wb = {slot.buffer + slot.written, slot.length - slot.written};
+      file_handle::io_request<file_handle::const_buffers_type> req({&slot.wb, 1}, dest_offset(slot));
+      OUTCOME_TRY(auto &&op, multiplexer->construct_and_init_pooled(dest, nullptr, {}, {}, req));
+      slot.op = std::move(op);
+      slot.status = slot_status::writing;
+      progress.writes_in_flight++;
+      return success();
+    }
+    // Reaps a finished i/o, issuing the next i/o for that slot if there is one
+    result<void> reap(slot_type &slot) noexcept
+    {
+      if(slot.status == slot_status::reading)
+      {
+        progress.reads_in_flight--;
+        auto r = std::move(*slot.op).get_completed_read();
+        slot.op.reset();
+        slot.status = slot_status::idle;
+        OUTCOME_TRY(auto &&readed, std::move(r));
+        const size_t bytes = readed.empty() ? 0 : readed.front().size();
+        if(bytes == 0)
+        {
+          // The source has shrunk since the copy began
+          progress.bytes_total -= slot.length;
+          return success();
+        }
+        progress.bytes_total -= slot.length - bytes;
+        slot.length = bytes;
+        return issue_write(slot);
+      }
+      progress.writes_in_flight--;
+      auto r = std::move(*slot.op).get_completed_write_or_barrier();
+      slot.op.reset();
+      slot.status = slot_status::idle;
+      OUTCOME_TRY(auto &&written, std::move(r));
+      const size_t bytes = written.empty() ? 0 : written.front().size();
+      if(bytes == 0)
+      {
+        return errc::resource_unavailable_try_again;  // something is wrong
+      }
+      slot.written += bytes;
+      progress.bytes_done += bytes;
+      if(slot.written < slot.length)
+      {
+        return issue_write(slot);
+      }
+      return success();
+    }
+    // Cancels all i/o in flight, and waits for the cancellation to complete
+    result<void> abort() noexcept
+    {
+      if(multiplexer == nullptr)
+      {
+        return success();
+      }
+      for(auto &slot : slots)
+      {
+        if(slot.op && !is_finished(multiplexer->check_io_operation(slot.op.get())))
+        {
+          (void) multiplexer->cancel_io_operation(slot.op.get());
+        }
+      }
+      result<void> ret = success();
+      for(auto &slot : slots)
+      {
+        if(slot.op)
+        {
+          while(!is_finished(multiplexer->check_io_operation(slot.op.get())))
+          {
+            auto r = multiplexer->check_for_any_completed_io({});
+            if(!r)
+            {
+              ret = std::move(r).error();
+            }
+          }
+          slot.op.reset();
+          slot.status = slot_status::idle;
+        }
+      }
+      progress.reads_in_flight = progress.writes_in_flight = 0;
+      return ret;
+    }
+  };
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC async_clone_extents::async_clone_extents() noexcept = default;
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC async_clone_extents::async_clone_extents(async_clone_extents &&o) noexcept = default;
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC async_clone_extents &async_clone_extents::operator=(async_clone_extents &&o) noexcept
+  {
+    _state = std::move(o._state);
+    return *this;
+  }
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC async_clone_extents::~async_clone_extents() = default;
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<async_clone_extents> async_clone_extents::start(file_handle &src, extent_pair extent, file_handle &dest,
+                                                                                         extent_type destoffset, size_t blocks_in_flight, size_t blocksize) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&src);
+    try
+    {
+      if(!dest.is_writable())
+      {
+        return errc::bad_file_descriptor;
+      }
+      if(src.multiplexer() != dest.multiplexer() || blocks_in_flight == 0)
+      {
+        return errc::invalid_argument;
+      }
+      OUTCOME_TRY(auto &&srclength, src.maximum_extent());
+      if(extent.offset == (extent_type) -1 && extent.length == (extent_type) -1)
+      {
+        extent.offset = 0;
+        extent.length = srclength;
+      }
+      if(extent.offset + extent.length < extent.offset || destoffset + extent.length < destoffset)
+      {
+        return errc::value_too_large;
+      }
+      if(extent.offset >= srclength)
+      {
+        extent.length = 0;
+      }
+      else if(extent.offset + extent.length > srclength)
+      {
+        extent.length = srclength - extent.offset;
+      }
+      if(extent.length > 0 && dest.unique_id() == src.unique_id() && destoffset < extent.offset + extent.length && extent.offset < destoffset + extent.length)
+      {
+        // Overlapping copies within the same inode are not possible in parallel
+        return errc::invalid_argument;
+      }
+      auto state = std::make_unique<_state_type>();
+      state->src = &src;
+      state->dest = &dest;
+      state->multiplexer = src.multiplexer();
+      state->extent = extent;
+      state->destoffset = destoffset;
+      state->blocksize = (blocksize != 0) ? blocksize : utils::file_buffer_default_size();
+      if(extent.length == 0)
+      {
+        state->finished = true;
+        return async_clone_extents(std::move(state));
+      }
+      // Only the valid extents of the source need reading, holes in the source become holes in the destination
+      OUTCOME_TRY(auto &&extents, src.extents());
+      OUTCOME_TRY(auto &&destlength, dest.maximum_extent());
+      const extent_type finish = extent.offset + extent.length;
+      extent_type cursor = extent.offset;
+      auto hole = [&](extent_type offset, extent_type length) -> result<void> {
+        // Holes beyond the current end of the destination will be holes after it is extended
+        const extent_type destbegin = offset - extent.offset + destoffset;
+        if(destbegin < destlength)
+        {
+          OUTCOME_TRY(dest.zero({destbegin, std::min(length, destlength - destbegin)}));
+        }
+        return success();
+      };
+      for(const auto &e : extents)
+      {
+        if(e.offset + e.length <= cursor)
+        {
+          continue;
+        }
+        if(e.offset >= finish)
+        {
+          break;
+        }
+        if(e.offset > cursor)
+        {
+          OUTCOME_TRY(hole(cursor, e.offset - cursor));
+          cursor = e.offset;
+        }
+        const auto clampedend = std::min(e.offset + e.length, finish);
+        state->todo.emplace_back(cursor, clampedend - cursor);
+        state->progress.bytes_total += clampedend - cursor;
+        cursor = clampedend;
+      }
+      if(cursor < finish)
+      {
+        OUTCOME_TRY(hole(cursor, finish - cursor));
+      }
+      if(destlength < destoffset + extent.length)
+      {
+        OUTCOME_TRY(dest.truncate(destoffset + extent.length));
+      }
+      state->slots.resize((state->multiplexer != nullptr) ? blocks_in_flight : 1);
+      for(auto &slot : state->slots)
+      {
+        slot.buffer = utils::page_allocator<byte>().allocate(state->blocksize);
+      }
+      return async_clone_extents(std::move(state));
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<bool> async_clone_extents::step(deadline d) noexcept
+  {
+    if(!_state || _state->finished)
+    {
+      return true;
+    }
+    auto &s = *_state;
+    LLFIO_LOG_FUNCTION_CALL(s.src);
+    if(s.cancelled.load(std::memory_order_acquire))
+    {
+      OUTCOME_TRY(s.abort());
+      s.finished = true;
+      return errc::operation_canceled;
+    }
+    if(s.multiplexer == nullptr)
+    {
+      // Synchronously copy one chunk
+      auto &slot = s.slots.front();
+      if(s.next_chunk(slot))
+      {
+        file_handle::buffer_type b(slot.buffer, slot.length);
+        OUTCOME_TRY(auto &&readed, s.src->read({{&b, 1}, slot.offset}, d));
+        const size_t bytes = readed.empty() ? 0 : readed.front().size();
+        s.progress.bytes_total -= slot.length - bytes;
+        slot.length = bytes;
+        while(slot.written < slot.length)
+        {
+          file_handle::const_buffer_type cb(slot.buffer + slot.written, slot.length - slot.written);
+          OUTCOME_TRY(auto &&written, s.dest->write({{&cb, 1}, s.dest_offset(slot)}, d));
+          const size_t wbytes = written.empty() ? 0 : written.front().size();
+          if(wbytes == 0)
+          {
+            return errc::resource_unavailable_try_again;  // something is wrong
+          }
+          slot.written += wbytes;
+          s.progress.bytes_done += wbytes;
+        }
+      }
+      s.finished = (s.todo_idx == s.todo.size());
+      return s.finished;
+    }
+    // Read ahead into every free buffer
+    bool initiated = false;
+    for(auto &slot : s.slots)
+    {
+      if(slot.status == _state_type::slot_status::idle && s.next_chunk(slot))
+      {
+        OUTCOME_TRY(s.issue_read(slot));
+        initiated = true;
+      }
+    }
+    if(initiated)
+    {
+      OUTCOME_TRY(s.multiplexer->flush_inited_io_operations());
+    }
+    auto reap_finished = [&]() -> result<size_t> {
+      size_t count = 0;
+      for(auto &slot : s.slots)
+      {
+        if(slot.status != _state_type::slot_status::idle && is_finished(s.multiplexer->check_io_operation(slot.op.get())))
+        {
+          OUTCOME_TRY(s.reap(slot));
+          count++;
+        }
+      }
+      return count;
+    };
+    OUTCOME_TRY(auto &&reaped, reap_finished());
+    if(reaped == 0)
+    {
+      bool any_in_flight = false;
+      for(auto &slot : s.slots)
+      {
+        any_in_flight |= (slot.status != _state_type::slot_status::idle);
+      }
+      if(any_in_flight)
+      {
+        OUTCOME_TRY(s.multiplexer->check_for_any_completed_io(d));
+        OUTCOME_TRY(reap_finished());
+      }
+    }
+    // Refill any buffers just freed, and flush the writes just issued
+    for(auto &slot : s.slots)
+    {
+      if(slot.status == _state_type::slot_status::idle && s.next_chunk(slot))
+      {
+        OUTCOME_TRY(s.issue_read(slot));
+      }
+    }
+    OUTCOME_TRY(s.multiplexer->flush_inited_io_operations());
+    s.finished = (s.todo_idx == s.todo.size());
+    for(auto &slot : s.slots)
+    {
+      s.finished = s.finished && (slot.status == _state_type::slot_status::idle);
+    }
+    return s.finished;
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<async_clone_extents::extent_pair> async_clone_extents::run(deadline d) noexcept
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    for(;;)
+    {
+      deadline nd;
+      LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+      OUTCOME_TRY(auto &&isdone, step(nd));
+      if(isdone)
+      {
+        break;
+      }
+      LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+    }
+    if(!_state)
+    {
+      return extent_pair(0, 0);
+    }
+    return _state->extent;
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void async_clone_extents::cancel() noexcept
+  {
+    if(_state)
+    {
+      _state->cancelled.store(true, std::memory_order_release);
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC async_clone_extents::progress_type async_clone_extents::progress() const noexcept
+  {
+    return _state ? _state->progress : progress_type{};
   }
 
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC bool async_clone_extents::done() const noexcept { return !_state || _state->finished; }
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,353 @@
+/* A filesystem algorithm which generates the difference between two directory trees
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (12 commits)
+File Created: July 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../algorithm/difference.hpp"
+
+#include <set>
+
+#ifdef _WIN32
+#include "windows/import.hpp"
+#else
+#include "posix/import.hpp"
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    // True if `path` is within `dir`, where an empty `dir` is the root of the tree
+    inline bool is_within(const filesystem::path &path, const filesystem::path &dir) noexcept
+    {
+      auto p = path.begin();
+      for(auto d = dir.begin(); d != dir.end(); ++d, ++p)
+      {
+        if(p == path.end() || *p != *d)
+        {
+          return false;
+        }
+      }
+      return p != path.end();
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> difference_tracker::_watch(const filesystem::path &relpath) noexcept
+  {
+#ifdef __linux__
+    if(_journal == -1)
+    {
+      return success();
+    }
+    try
+    {
+      const filesystem::path path = relpath.empty() ? _root_path : (_root_path / relpath);
+      const int wd = ::inotify_add_watch(_journal, path.c_str(),
+                                         IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM |
+                                         IN_MOVED_TO | IN_DONT_FOLLOW | IN_ONLYDIR);
+      if(wd == -1)
+      {
+        if(errno == ENOSPC || errno == ENOMEM)
+        {
+          // Out of inotify watches, so fall back to full traversals from now on
+          return _close_journal();
+        }
+        if(errno == ENOENT || errno == ENOTDIR)
+        {
+          // Raced with removal, which the watch on the parent directory will report
+          return success();
+        }
+        return posix_error();
+      }
+      _watches[wd] = relpath;
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+#else
+    (void) relpath;
+    return success();
+#endif
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> difference_tracker::_close_journal() noexcept
+  {
+    if(_journal != -1)
+    {
+#ifndef _WIN32
+      if(-1 == ::close(_journal))
+      {
+        _journal = -1;
+        _watches.clear();
+        return posix_error();
+      }
+#endif
+      _journal = -1;
+    }
+    _watches.clear();
+    return success();
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<difference_item>> difference_tracker::_full_traversal() noexcept
+  {
+    ++_full_traversals;
+    OUTCOME_TRY(auto &&after, algorithm::snapshot(_root, _threads));
+    OUTCOME_TRY(auto &&ret, difference(_snapshot, after));
+    _snapshot = std::move(after);
+    // Watching an already watched directory updates the path of its existing watch
+    for(auto &i : _snapshot)
+    {
+      if(i.second.st_type == filesystem::file_type::directory)
+      {
+        OUTCOME_TRY(_watch(i.first));
+      }
+    }
+    return {std::move(ret)};
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<difference_tracker> difference_tracker::track(const path_handle &dirh, size_t threads) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&dirh);
+    difference_tracker ret;
+    ret._threads = threads;
+    OUTCOME_TRY(auto &&root, dirh.clone_to_path_handle());
+    ret._root = std::move(root);
+    OUTCOME_TRY(auto &&rootpath, ret._root.current_path());
+    ret._root_path = std::move(rootpath);
+#ifdef __linux__
+    // If inotify is unavailable, we fall back to full traversals
+    ret._journal = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    OUTCOME_TRY(ret._watch({}));
+#endif
+    OUTCOME_TRY(auto &&snap, algorithm::snapshot(ret._root, threads));
+    ret._snapshot = std::move(snap);
+    for(auto &i : ret._snapshot)
+    {
+      if(i.second.st_type == filesystem::file_type::directory)
+      {
+        OUTCOME_TRY(ret._watch(i.first));
+      }
+    }
+    return {std::move(ret)};
+  }
+
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<difference_item>> difference_tracker::changes() noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+    if(_journal == -1)
+    {
+      return _full_traversal();
+    }
+    try
+    {
+      // Drain the journal of the directories with changes, parents sorting before their children
+      std::set<filesystem::path> dirty;
+      bool overflowed = false;
+      alignas(struct inotify_event) char buffer[65536];
+      for(;;)
+      {
+        const auto bytes = ::read(_journal, buffer, sizeof(buffer));
+        if(bytes == -1)
+        {
+          if(errno == EINTR)
+          {
+            continue;
+          }
+          if(errno == EAGAIN || errno == EWOULDBLOCK)
+          {
+            break;
+          }
+          return posix_error();
+        }
+        for(const char *p = buffer; p < buffer + bytes;)
+        {
+          const auto *ev = reinterpret_cast<const struct inotify_event *>(p);
+          p += sizeof(struct inotify_event) + ev->len;
+          if(ev->mask & IN_Q_OVERFLOW)
+          {
+            overflowed = true;
+            continue;
+          }
+          auto it = _watches.find(ev->wd);
+          if(it == _watches.end())
+          {
+            continue;
+          }
+          if(ev->mask & IN_IGNORED)
+          {
+            _watches.erase(it);
+          }
+          else if(ev->len > 0)
+          {
+            // An entry within the directory changed
+            dirty.insert(it->second);
+          }
+          else if(!it->second.empty())
+          {
+            // The directory itself changed, and it is an entry of its parent
+            dirty.insert(it->second.parent_path());
+          }
+          else if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+          {
+            overflowed = true;
+          }
+        }
+      }
+      if(overflowed)
+      {
+        return _full_traversal();
+      }
+      std::vector<difference_item> ret;
+      if(dirty.empty())
+      {
+        return {std::move(ret)};
+      }
+      tree_snapshot after(_snapshot);
+      bool removed_directories = false;
+      std::vector<directory_entry> entries(256);
+      directory_handle::buffers_type buffers;
+      auto erase_subtree = [&](const filesystem::path &dirpath, bool direct_children_only) {
+        for(auto it = dirpath.empty() ? after.begin() : after.upper_bound(dirpath); it != after.end() && detail::is_within(it->first, dirpath);)
+        {
+          if(direct_children_only && it->first.parent_path() != dirpath)
+          {
+            ++it;
+            continue;
+          }
+          if(it->second.st_type == filesystem::file_type::directory)
+          {
+            removed_directories = true;
+          }
+          it = after.erase(it);
+        }
+      };
+      for(auto &dirpath : dirty)
+      {
+        erase_subtree(dirpath, true);
+        auto dirh = directory_handle::directory(_root, dirpath);
+        if(!dirh)
+        {
+          if(dirh.error() == errc::no_such_file_or_directory || dirh.error() == errc::not_a_directory)
+          {
+            // Removed since, which its parent will also report
+            continue;
+          }
+          return std::move(dirh).error();
+        }
+        for(;;)
+        {
+          buffers = {entries, std::move(buffers)};
+          OUTCOME_TRY(auto &&filled_buffers, dirh.value().read({std::move(buffers), {}, directory_handle::filter::none}));
+          buffers = std::move(filled_buffers);
+          if(buffers.done())
+          {
+            break;
+          }
+          entries.resize(entries.size() << 1);
+        }
+        const auto need = tree_snapshot::metadata() & ~buffers.metadata();
+        std::vector<result<size_t>> filled;
+        if(need)
+        {
+          OUTCOME_TRY(auto &&_filled, dirh.value().stat_entries(buffers, need));
+          filled = std::move(_filled);
+        }
+        for(size_t n = 0; n < buffers.size(); n++)
+        {
+          if(need && !filled[n])
+          {
+            continue;  // vanished since enumeration
+          }
+          const auto &entry = buffers[n];
+          filesystem::path relpath = dirpath / entry.leafname;
+          if(entry.stat.st_type == filesystem::file_type::directory)
+          {
+            auto old = _snapshot.find(relpath);
+            if(old == _snapshot.end() || old->second.st_type != filesystem::file_type::directory || old->second.st_dev != entry.stat.st_dev ||
+               old->second.st_ino != entry.stat.st_ino)
+            {
+              // A directory new to this path, so everything within it is new too
+              erase_subtree(relpath, false);
+              OUTCOME_TRY(_watch(relpath));
+              auto subdirh = directory_handle::directory(dirh.value(), entry.leafname);
+              if(subdirh)
+              {
+                OUTCOME_TRY(auto &&sub, algorithm::snapshot(subdirh.value(), _threads));
+                for(auto &i : sub)
+                {
+                  filesystem::path subpath = relpath / i.first;
+                  if(i.second.st_type == filesystem::file_type::directory)
+                  {
+                    OUTCOME_TRY(_watch(subpath));
+                  }
+                  after.emplace(std::move(subpath), i.second);
+                }
+              }
+            }
+          }
+          after[std::move(relpath)] = entry.stat;
+        }
+      }
+      if(removed_directories)
+      {
+        // Discard everything within directories which no longer exist
+        for(auto it = after.begin(); it != after.end();)
+        {
+          const auto parent = it->first.parent_path();
+          if(!parent.empty())
+          {
+            auto p = after.find(parent);
+            if(p == after.end() || p->second.st_type != filesystem::file_type::directory)
+            {
+              it = after.erase(it);
+              continue;
+            }
+          }
+          ++it;
+        }
+      }
+      OUTCOME_TRY(auto &&diffs, difference(_snapshot, after));
+      _snapshot = std::move(after);
+      return {std::move(diffs)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+#else
+    // No change journal implementation yet for this platform
+    return _full_traversal();
+#endif
+  }
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,105 @@
+/* Adapts a file handle to perform unaligned i/o on a direct i/o handle
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../algorithm/handle_adapter/direct_io.hpp"
+
+#ifdef _WIN32
+#include "windows/import.hpp"
+#else
+#include "posix/import.hpp"
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    LLFIO_HEADERS_ONLY_FUNC_SPEC result<std::pair<size_t, size_t>> direct_io_alignment(const file_handle &h) noexcept
+    {
+      LLFIO_LOG_FUNCTION_CALL(&h);
+      // Page alignment of both memory and offset satisfies every storage device I know of, so it is the fallback
+      std::pair<size_t, size_t> ret(utils::page_size(), utils::page_size());
+#ifdef _WIN32
+      windows_nt_kernel::init();
+      using namespace windows_nt_kernel;
+      IO_STATUS_BLOCK isb = make_iostatus();
+      FILE_ALIGNMENT_INFORMATION fai{};
+      NTSTATUS ntstat = NtQueryInformationFile(h.native_handle().h, &isb, &fai, sizeof(fai), FileAlignmentInformation);
+      if(STATUS_PENDING == ntstat)
+      {
+        ntstat = ntwait(h.native_handle().h, isb, deadline());
+      }
+      if(ntstat < 0)
+      {
+        return ntkernel_error(ntstat);
+      }
+      FILE_FS_SECTOR_SIZE_INFORMATION ffssi{};
+      isb.Status = -1;
+      ntstat = NtQueryVolumeInformationFile(h.native_handle().h, &isb, &ffssi, sizeof(ffssi), FileFsSectorSizeInformation);
+      if(STATUS_PENDING == ntstat)
+      {
+        ntstat = ntwait(h.native_handle().h, isb, deadline());
+      }
+      if(ntstat < 0)
+      {
+        return ntkernel_error(ntstat);
+      }
+      // AlignmentRequirement is a mask e.g. 511 for 512 byte alignment
+      ret.first = static_cast<size_t>(fai.AlignmentRequirement) + 1;
+      if(ffssi.LogicalBytesPerSector > 0)
+      {
+        ret.second = ffssi.LogicalBytesPerSector;
+      }
+#elif defined(__linux__)
+      // Linux 6.1 onwards can tell us exactly what alignment this inode requires
+      LLFIO_V2_NAMESPACE::detail::statx_t s;
+      memset(&s, 0, sizeof(s));
+      static constexpr unsigned statx_dioalign = 0x00002000U /*STATX_DIOALIGN*/;
+      if(LLFIO_V2_NAMESPACE::detail::statx(h.native_handle().fd, "", AT_EMPTY_PATH, statx_dioalign, &s) >= 0 && (s.stx_mask & statx_dioalign) != 0 &&
+         s.stx_dio_mem_align > 0 && s.stx_dio_offset_align > 0)
+      {
+        ret.first = s.stx_dio_mem_align;
+        ret.second = s.stx_dio_offset_align;
+      }
+#else
+      (void) h;
+#endif
+      // Never report less than natural pointer alignment, and always report powers of two
+      auto ceil_pow2 = [](size_t v) {
+        size_t r = sizeof(void *);
+        while(r < v)
+        {
+          r <<= 1;
+        }
+        return r;
+      };
+      ret.first = ceil_pow2(ret.first);
+      ret.second = ceil_pow2(ret.second);
+      return ret;
+    }
+  }  // namespace detail
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
@@ -24,8 +24,101 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../../fast_random_file_handle.hpp"
 
+#include <thread>
+#include <vector>
+
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
 
+namespace detail
+{
+  // Generates `words` consecutive 4 byte blocks starting at block `wordoffset`. As every iteration depends only
+  // on the seed state and its own offset, compilers vectorise this loop to whatever SIMD the target has.
+  template <class Prng> inline void fast_random_file_handle_generate(const Prng &p, uint64_t wordoffset, uint32_t *out, size_t words) noexcept
+  {
+    for(size_t n = 0; n < words; n++)
+    {
+      Prng q(p);
+      out[n] = q(wordoffset + n);
+    }
+  }
+  // Fills `bytes` of `dest` with the randomness at byte `offset` using the calling thread
+  template <class Prng> inline void fast_random_file_handle_fill(const Prng &p, uint64_t offset, byte *dest, size_t bytes) noexcept
+  {
+    alignas(64) uint32_t blk[1024];
+    if((offset & 3) != 0)
+    {
+      // Partial block at the front
+      const size_t skip = static_cast<size_t>(offset & 3);
+      const size_t todo = std::min(4 - skip, bytes);
+      fast_random_file_handle_generate(p, offset >> 2, blk, 1);
+      memcpy(dest, reinterpret_cast<const byte *>(blk) + skip, todo);
+      offset += todo;
+      dest += todo;
+      bytes -= todo;
+    }
+    if((((uintptr_t) dest) & 3) == 0)
+    {
+      // Destination is on 4 byte multiple, so we can write direct
+      const size_t words = bytes >> 2;
+      fast_random_file_handle_generate(p, offset >> 2, reinterpret_cast<uint32_t *>(dest), words);
+      offset += words << 2;
+      dest += words << 2;
+      bytes -= words << 2;
+    }
+    else
+    {
+      while(bytes >= 4)
+      {
+        const size_t words = std::min(bytes >> 2, sizeof(blk) / sizeof(blk[0]));
+        fast_random_file_handle_generate(p, offset >> 2, blk, words);
+        memcpy(dest, blk, words << 2);
+        offset += words << 2;
+        dest += words << 2;
+        bytes -= words << 2;
+      }
+    }
+    if(bytes > 0)
+    {
+      // Partial block at the end
+      fast_random_file_handle_generate(p, offset >> 2, blk, 1);
+      memcpy(dest, blk, bytes);
+    }
+  }
+}  // namespace detail
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void fast_random_file_handle::_fill(const prng &p, extent_type offset, byte *dest, size_type bytes) noexcept
+{
+  const size_t threads = (bytes >= parallel_fill_threshold) ? std::thread::hardware_concurrency() : 1;
+  if(threads <= 1)
+  {
+    detail::fast_random_file_handle_fill(p, offset, dest, bytes);
+    return;
+  }
+  // Hand out cache line multiple pieces to workers, with this thread doing the last piece
+  const size_type piece = ((bytes / threads) + 63) & ~static_cast<size_type>(63);
+  std::vector<std::thread> workers;
+  try
+  {
+    workers.reserve(threads - 1);
+    while(bytes > piece && workers.size() < threads - 1)
+    {
+      workers.emplace_back([&p, offset, dest, piece] { detail::fast_random_file_handle_fill(p, offset, dest, piece); });
+      offset += piece;
+      dest += piece;
+      bytes -= piece;
+    }
+  }
+  catch(...)
+  {
+    // Anything not handed to a worker is done by this thread
+  }
+  detail::fast_random_file_handle_fill(p, offset, dest, bytes);
+  for(auto &worker : workers)
+  {
+    worker.join();
+  }
+}
+
 fast_random_file_handle::io_result<fast_random_file_handle::buffers_type> fast_random_file_handle::_do_read(io_request<buffers_type> reqs, deadline /* unused */) noexcept
 {
   if(reqs.offset >= _length)
@@ -41,102 +134,78 @@ fast_random_file_handle::io_result<fast_random_file_handle::buffers_type> fast_r
   // Fill the scatter buffers
   for(auto &buffer : reqs.buffers)
   {
-    if(togo == 0)
+    const size_type thisbufferlen = (buffer.size() < togo) ? buffer.size() : static_cast<size_type>(togo);
+    _fill(_prng, reqs.offset, buffer.data(), thisbufferlen);
+    buffer = {buffer.data(), thisbufferlen};
+    reqs.offset += thisbufferlen;
+    togo -= thisbufferlen;
+  }
+  return std::move(reqs.buffers);
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC fast_random_file_handle::extent_type fast_random_file_handle::find_mismatch(extent_type offset, const_buffer_type data) const noexcept
+{
+  alignas(64) byte expected[16384];
+  const byte *p = data.data();
+  size_type togo = data.size();
+  while(togo > 0)
+  {
+    if(offset >= _length)
     {
-      buffer = {buffer.data(), 0};
+      return offset;
     }
-    else
+    size_type thisblocklen = std::min(togo, sizeof(expected));
+    if(thisblocklen > _length - offset)
+    {
+      thisblocklen = static_cast<size_type>(_length - offset);
+    }
+    detail::fast_random_file_handle_fill(_prng, offset, expected, thisblocklen);
+    if(0 != memcmp(expected, p, thisblocklen))
     {
-      for(size_type i = 0; i < buffer.size();)
+      size_type n = 0;
+      while(expected[n] == p[n])
       {
-        // How much can we do at once?
-        auto hashoffset = reqs.offset >> 2;                      // place this offset into the state
-        auto thisblockoffset = reqs.offset - (hashoffset << 2);  // offset into our buffer due to request offset misalignment
-        extent_type thisblocklen = 64;                           // maximum possible block this iteration
-        if(thisblocklen > buffer.size() - i)
-        {
-          thisblocklen = buffer.size() - i;
-        }
-        if(thisblocklen > togo)
-        {
-          thisblocklen = togo;
-        }
-
-        struct _p
-        {
-          uint32_t hash[16];
-        } blk, *p = &blk;
-        // If not copying partial buffers
-        if(thisblockoffset == 0)
-        {
-          // If destination is on 4 byte multiple, we can write direct
-          if((((uintptr_t) buffer.data() + i) & 3) == 0)
-            p = (_p *) (buffer.data() + i);
-        }
-        if(thisblocklen == 64)
-        {
-          auto &hash = p->hash;
-          prng __prngs[16] = {_prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng, _prng};
-          hash[0] = __prngs[0](hashoffset + 0);
-          hash[1] = __prngs[1](hashoffset + 1);
-          hash[2] = __prngs[2](hashoffset + 2);
-          hash[3] = __prngs[3](hashoffset + 3);
-          hash[4] = __prngs[4](hashoffset + 4);
-          hash[5] = __prngs[5](hashoffset + 5);
-          hash[6] = __prngs[6](hashoffset + 6);
-          hash[7] = __prngs[7](hashoffset + 7);
-          hash[8] = __prngs[8](hashoffset + 8);
-          hash[9] = __prngs[9](hashoffset + 9);
-          hash[10] = __prngs[10](hashoffset + 10);
-          hash[11] = __prngs[11](hashoffset + 11);
-          hash[12] = __prngs[12](hashoffset + 12);
-          hash[13] = __prngs[13](hashoffset + 13);
-          hash[14] = __prngs[14](hashoffset + 14);
-          hash[15] = __prngs[15](hashoffset + 15);
-          if(thisblocklen > 64 - thisblockoffset)
-          {
-            thisblocklen = 64 - thisblockoffset;
-          }
-        }
-        else if(thisblocklen == 16)
-        {
-          auto &hash = p->hash;
-          prng __prngs[4] = {_prng, _prng, _prng, _prng};
-          hash[0] = __prngs[0](hashoffset + 0);
-          hash[1] = __prngs[1](hashoffset + 1);
-          hash[2] = __prngs[2](hashoffset + 2);
-          hash[3] = __prngs[3](hashoffset + 3);
-          if(thisblocklen > 16 - thisblockoffset)
-          {
-            thisblocklen = 16 - thisblockoffset;
-          }
-        }
-        else
-        {
-          auto &hash = p->hash;
-          auto __prng(_prng);
-          hash[0] = __prng(hashoffset);
-          if(thisblocklen > 4 - thisblockoffset)
-          {
-            thisblocklen = 4 - thisblockoffset;
-          }
-        }
-        if(p == &blk)
-        {
-          memcpy(buffer.data() + i, ((const char *) p) + thisblockoffset, (size_type) thisblocklen);
-        }
-        reqs.offset += thisblocklen;
-        i += (size_type) thisblocklen;
-        togo -= thisblocklen;
-        if(togo == 0)
-        {
-          buffer = {buffer.data(), i};
-          break;
-        }
+        ++n;
       }
+      return offset + n;
     }
+    offset += thisblocklen;
+    p += thisblocklen;
+    togo -= thisblocklen;
   }
-  return std::move(reqs.buffers);
+  return offset;
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<fast_random_file_handle::extent_type> fast_random_file_handle::verify(io_handle &h, extent_pair extent, size_type blocksize, deadline d) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  if(blocksize == 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(auto &&buffer, h.allocate_registered_buffer(blocksize));
+  extent_type offset = extent.offset;
+  const extent_type end = extent.offset + extent.length;
+  while(offset < end)
+  {
+    const size_type toread = static_cast<size_type>(std::min<extent_type>(end - offset, buffer->size()));
+    deadline nd;
+    LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+    OUTCOME_TRY(auto &&bytesread, h.read(offset, {{buffer->data(), toread}}, nd));
+    if(bytesread == 0)
+    {
+      // h ended early
+      return offset;
+    }
+    const extent_type mismatch = find_mismatch(offset, {buffer->data(), bytesread});
+    if(mismatch != offset + bytesread)
+    {
+      return mismatch;
+    }
+    offset += bytesread;
+  }
+  return offset;
 }
 
 LLFIO_V2_NAMESPACE_END
@@ -1,5 +1,5 @@
 /* Multiplex file i/o
-(C) 2019 Niall Douglas <http://www.nedproductions.biz/> (9 commits)
+(C) 2019 Niall Douglas <http://www.nedproductions.biz/> (10 commits)
 File Created: Nov 2019
 
 
@@ -23,8 +23,26 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../../io_multiplexer.hpp"
+#ifndef _WIN32
+#include "posix/import.hpp"
+#endif
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 
 LLFIO_V2_NAMESPACE_BEGIN
 
@@ -35,6 +53,572 @@ namespace this_thread
   LLFIO_HEADERS_ONLY_FUNC_SPEC void set_multiplexer(io_multiplexer *ctx) noexcept { _thread_multiplexer = ctx; }
 }  // namespace this_thread
 
+/* Pooled i/o states are carved out of cache line aligned slabs. Freed storage goes onto
+a free list local to the freeing kernel thread, and only when that list is full does it
+go onto the pool's shared free list, which requires taking the pool's lock. Allocation
+pops from the thread local free list, refilling it from the shared free list or a new slab
+as needed.
+
+Thread local free lists are identified by the unique id of their pool, not by address, so
+a thread local free list for a pool which has since been destroyed is simply discarded.
+If a thread uses more pools concurrently than it has thread local free lists, storage
+in the evicted list is returned to the pool's shared free list if the pool still exists.
+*/
+struct io_multiplexer::_io_operation_state_pool
+{
+  static constexpr size_t cache_line = 64;
+  static constexpr size_t states_per_slab = 64;
+  static constexpr size_t thread_local_max = 64;  // the maximum free storage retained per thread
+  static constexpr size_t thread_local_lists = 4;
+
+  struct free_node
+  {
+    free_node *next;
+  };
+  struct thread_local_list  // must be trivial to be thread local on all compilers
+  {
+    uint64_t id;
+    _io_operation_state_pool *pool;
+    free_node *head;
+    size_t count;
+  };
+  static thread_local_list *thread_lists() noexcept
+  {
+    static LLFIO_THREAD_LOCAL thread_local_list lists[thread_local_lists];
+    return lists;
+  }
+  // Pools which currently exist, so evicted thread local lists can be returned to their pool
+  static std::mutex &live_lock() noexcept
+  {
+    static std::mutex v;
+    return v;
+  }
+  static std::vector<_io_operation_state_pool *> &live_pools() noexcept
+  {
+    static std::vector<_io_operation_state_pool *> v;
+    return v;
+  }
+  static uint64_t next_id() noexcept
+  {
+    static std::atomic<uint64_t> v{1};
+    return v.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::mutex lock;
+  const uint64_t id{next_id()};
+  const size_t stride;
+  std::vector<std::unique_ptr<byte[]>> slabs;
+  free_node *free{nullptr};
+#ifndef NDEBUG
+  std::atomic<size_t> allocated{0};
+#endif
+
+  explicit _io_operation_state_pool(size_t _stride) noexcept
+      : stride(_stride)
+  {
+  }
+
+  // Returns a thread local free list to its pool, if that pool still exists
+  static void release(thread_local_list &l) noexcept
+  {
+    if(l.head != nullptr)
+    {
+      std::lock_guard<std::mutex> g(live_lock());
+      auto &live = live_pools();
+      if(std::find(live.begin(), live.end(), l.pool) != live.end() && l.pool->id == l.id)
+      {
+        std::lock_guard<std::mutex> g2(l.pool->lock);
+        free_node *tail = l.head;
+        while(tail->next != nullptr)
+        {
+          tail = tail->next;
+        }
+        tail->next = l.pool->free;
+        l.pool->free = l.head;
+      }
+    }
+    l = thread_local_list{};
+  }
+
+  thread_local_list &my_list() noexcept
+  {
+    auto *lists = thread_lists();
+    for(size_t n = 0; n < thread_local_lists; n++)
+    {
+      if(lists[n].id == id)
+      {
+        return lists[n];
+      }
+    }
+    // Evict the fullest list, as it is the least likely to be needed
+    size_t victim = 0;
+    for(size_t n = 0; n < thread_local_lists; n++)
+    {
+      if(lists[n].id == 0)
+      {
+        victim = n;
+        break;
+      }
+      if(lists[n].count > lists[victim].count)
+      {
+        victim = n;
+      }
+    }
+    release(lists[victim]);
+    lists[victim].id = id;
+    lists[victim].pool = this;
+    return lists[victim];
+  }
+
+  result<span<byte>> allocate() noexcept
+  {
+    auto &l = my_list();
+    if(l.head == nullptr)
+    {
+      std::lock_guard<std::mutex> g(lock);
+      if(free == nullptr)
+      {
+        try
+        {
+          slabs.push_back(std::make_unique<byte[]>(stride * states_per_slab + cache_line));
+        }
+        catch(...)
+        {
+          return error_from_exception();
+        }
+        byte *p = slabs.back().get();
+        p += (cache_line - ((uintptr_t) p & (cache_line - 1))) & (cache_line - 1);
+        for(size_t n = 0; n < states_per_slab; n++)
+        {
+          auto *node = reinterpret_cast<free_node *>(p + n * stride);
+          node->next = free;
+          free = node;
+        }
+      }
+      // Move a batch to the thread local free list
+      for(size_t n = 0; n < thread_local_max / 2 && free != nullptr; n++)
+      {
+        free_node *node = free;
+        free = node->next;
+        node->next = l.head;
+        l.head = node;
+        ++l.count;
+      }
+    }
+    free_node *node = l.head;
+    l.head = node->next;
+    --l.count;
+#ifndef NDEBUG
+    allocated.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return span<byte>(reinterpret_cast<byte *>(node), stride);
+  }
+
+  void deallocate(byte *p) noexcept
+  {
+#ifndef NDEBUG
+    allocated.fetch_sub(1, std::memory_order_relaxed);
+#endif
+    auto *node = reinterpret_cast<free_node *>(p);
+    auto &l = my_list();
+    if(l.count < thread_local_max)
+    {
+      node->next = l.head;
+      l.head = node;
+      ++l.count;
+      return;
+    }
+    std::lock_guard<std::mutex> g(lock);
+    node->next = free;
+    free = node;
+  }
+};
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_multiplexer::_io_operation_state_pool_ptr::reset() noexcept
+{
+  auto *pool = p.exchange(nullptr, std::memory_order_acq_rel);
+  if(pool != nullptr)
+  {
+    assert(pool->allocated == 0);
+    {
+      std::lock_guard<std::mutex> g(_io_operation_state_pool::live_lock());
+      auto &live = _io_operation_state_pool::live_pools();
+      live.erase(std::remove(live.begin(), live.end(), pool), live.end());
+    }
+    // Forget this thread's list, other threads' lists are discarded when next used
+    auto *lists = _io_operation_state_pool::thread_lists();
+    for(size_t n = 0; n < _io_operation_state_pool::thread_local_lists; n++)
+    {
+      if(lists[n].id == pool->id)
+      {
+        lists[n] = _io_operation_state_pool::thread_local_list{};
+      }
+    }
+    delete pool;
+  }
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<byte>> io_multiplexer::_allocate_pooled_io_operation_state() noexcept
+{
+  auto *pool = _state_pool.p.load(std::memory_order_acquire);
+  if(pool == nullptr)
+  {
+    const auto reqs = io_state_requirements();
+    if(reqs.second > _io_operation_state_pool::cache_line)
+    {
+      return errc::not_supported;
+    }
+    const size_t stride = (reqs.first + _io_operation_state_pool::cache_line - 1) & ~(_io_operation_state_pool::cache_line - 1);
+    auto *newpool = new(std::nothrow) _io_operation_state_pool(stride);
+    if(newpool == nullptr)
+    {
+      return errc::not_enough_memory;
+    }
+    try
+    {
+      std::lock_guard<std::mutex> g(_io_operation_state_pool::live_lock());
+      _io_operation_state_pool::live_pools().push_back(newpool);
+    }
+    catch(...)
+    {
+      delete newpool;
+      return error_from_exception();
+    }
+    if(_state_pool.p.compare_exchange_strong(pool, newpool, std::memory_order_acq_rel))
+    {
+      pool = newpool;
+    }
+    else
+    {
+      // Another thread created the pool first
+      std::lock_guard<std::mutex> g(_io_operation_state_pool::live_lock());
+      auto &live = _io_operation_state_pool::live_pools();
+      live.erase(std::remove(live.begin(), live.end(), newpool), live.end());
+      delete newpool;
+    }
+  }
+  return pool->allocate();
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_multiplexer::_deallocate_pooled_io_operation_state(byte *storage) noexcept
+{
+  _state_pool.p.load(std::memory_order_acquire)->deallocate(storage);
+}
+
+#ifndef _WIN32
+/* The waiter thread retries every contended lock and checks every process given to it, backing off
+exponentially when none can be granted and none have exited. Blocking in F_OFD_SETLKW or waitid()
+instead would need a thread per lock or process, and could not be interrupted when the multiplexer
+is closed.
+*/
+struct io_multiplexer::_posix_lock_waiter
+{
+  io_multiplexer *parent;
+  std::mutex lock;
+  std::condition_variable changed;
+  std::vector<posix_fs_syscall *> pending;
+  bool stopping{false};
+  std::thread thread;
+
+  explicit _posix_lock_waiter(io_multiplexer *_parent)
+      : parent(_parent)
+      , thread([this] { run(); })
+  {
+  }
+  _posix_lock_waiter(const _posix_lock_waiter &) = delete;
+  _posix_lock_waiter(_posix_lock_waiter &&) = delete;
+  _posix_lock_waiter &operator=(const _posix_lock_waiter &) = delete;
+  _posix_lock_waiter &operator=(_posix_lock_waiter &&) = delete;
+  ~_posix_lock_waiter()
+  {
+    {
+      std::lock_guard<std::mutex> g(lock);
+      stopping = true;
+      for(auto *op : pending)
+      {
+        complete(*op, -ECANCELED);
+      }
+      pending.clear();
+    }
+    changed.notify_all();
+    thread.join();
+  }
+
+  // Locks the range described by op, blocking if told to, returning -1 with errno set on failure
+  static int try_lock(const posix_fs_syscall &op, bool blocking) noexcept
+  {
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = (op.flags != 0) ? F_WRLCK : F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = (off_t)(op.offset & ~(1ULL << 63U));
+    fl.l_len = (off_t)(op.bytes & ~(size_t(1) << (8 * sizeof(size_t) - 1)));
+#ifdef F_OFD_SETLK
+    const int ret = ::fcntl(op.fd, blocking ? F_OFD_SETLKW : F_OFD_SETLK, &fl);
+    if(-1 != ret || EINVAL != errno)
+    {
+      return ret;
+    }
+    // OFD locks not supported on this kernel
+#endif
+    return ::fcntl(op.fd, blocking ? F_SETLKW : F_SETLK, &fl);
+  }
+
+  // Checks if the child process `op.offset` has exited without reaping it, returning 0 if it has, 1 if it has not, and -1 with errno set on failure
+  static int try_wait(const posix_fs_syscall &op, bool blocking) noexcept
+  {
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if(-1 == ::waitid(P_PID, (id_t) op.offset, &info, WEXITED | WNOWAIT | (blocking ? 0 : WNOHANG)))
+    {
+      return -1;
+    }
+    return (info.si_pid != 0) ? 0 : 1;
+  }
+
+  // Writes all modified data of the filing system containing `op.fd` to storage, returning -1 with errno set on failure
+  static int sync_filesystem(const posix_fs_syscall &op) noexcept
+  {
+#ifdef __linux__
+    return ::syncfs(op.fd);
+#else
+    if(-1 == ::fsync(op.fd))
+    {
+      return -1;
+    }
+    ::sync();
+    return 0;
+#endif
+  }
+
+  // The waiting thread reads results without our lock held
+  static void complete(posix_fs_syscall &op, int result) noexcept { __atomic_store_n(&op.result, result, __ATOMIC_RELEASE); }
+
+  result<void> add(posix_fs_syscall &op) noexcept
+  {
+    try
+    {
+      {
+        std::lock_guard<std::mutex> g(lock);
+        op.result = posix_fs_syscall::pending;
+        pending.push_back(&op);
+      }
+      changed.notify_all();
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  void run() noexcept
+  {
+    static constexpr std::chrono::microseconds initial_backoff{10};
+    auto backoff = std::chrono::duration_cast<std::chrono::microseconds>(initial_backoff);
+    std::unique_lock<std::mutex> g(lock);
+    while(!stopping)
+    {
+      if(pending.empty())
+      {
+        changed.wait(g);
+        backoff = initial_backoff;
+        continue;
+      }
+      // A syncfs can take seconds, so execute it without our lock held
+      auto syncit = std::find_if(pending.begin(), pending.end(), [](const posix_fs_syscall *op) { return op->op == posix_fs_syscall::kind::syncfs; });
+      if(syncit != pending.end())
+      {
+        posix_fs_syscall *op = *syncit;
+        pending.erase(syncit);
+        g.unlock();
+        const int ret = sync_filesystem(*op);
+        const int result = (ret < 0) ? -errno : ret;
+        g.lock();
+        complete(*op, result);
+        if(!stopping)
+        {
+          (void) parent->wake_check_for_any_completed_io();
+        }
+        backoff = initial_backoff;
+        continue;
+      }
+      bool granted = false;
+      for(auto it = pending.begin(); it != pending.end();)
+      {
+        if((*it)->op == posix_fs_syscall::kind::wait_process)
+        {
+          const int exited = try_wait(**it, false);
+          if(exited > 0)
+          {
+            ++it;
+            continue;
+          }
+          complete(**it, (exited == 0) ? 0 : -errno);
+        }
+        else if(-1 != try_lock(**it, false))
+        {
+          complete(**it, 0);
+        }
+        else if(EAGAIN != errno && EACCES != errno)
+        {
+          complete(**it, -errno);
+        }
+        else
+        {
+          ++it;
+          continue;
+        }
+        it = pending.erase(it);
+        granted = true;
+      }
+      if(granted)
+      {
+        // Keep holding our lock so the multiplexer cannot be closed whilst we wake it
+        (void) parent->wake_check_for_any_completed_io();
+        backoff = initial_backoff;
+        continue;
+      }
+      changed.wait_for(g, backoff);
+      backoff = std::min(backoff * 2, std::chrono::duration_cast<std::chrono::microseconds>(lock_range_poll_interval));
+    }
+  }
+};
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> io_multiplexer::do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept
+{
+  for(auto &op : ops)
+  {
+    int ret = -1;
+    switch(op.op)
+    {
+    case posix_fs_syscall::kind::openat:
+      ret = ::openat(op.fd, op.path, op.flags, (mode_t) op.mode);
+      break;
+    case posix_fs_syscall::kind::statx:
+#if defined(__linux__) && defined(__NR_statx)
+      ret = (int) ::syscall(__NR_statx, op.fd, op.path, op.flags, op.mode, op.buffer);
+#else
+      errno = ENOSYS;
+#endif
+      break;
+    case posix_fs_syscall::kind::close:
+      ret = ::close(op.fd);
+      break;
+    case posix_fs_syscall::kind::madvise:
+      ret = ::madvise(op.buffer, op.bytes, op.flags);
+      break;
+    case posix_fs_syscall::kind::unlinkat:
+      ret = ::unlinkat(op.fd, op.path, op.flags);
+      break;
+    case posix_fs_syscall::kind::symlinkat:
+      ret = ::symlinkat((const char *) op.buffer, op.fd, op.path);
+      break;
+    case posix_fs_syscall::kind::renameat:
+      ret = detail::renameat2(op.fd, op.path, op.fd_out, (const char *) op.buffer, (unsigned) op.flags);
+      break;
+    case posix_fs_syscall::kind::pwrite:
+      ret = (int) ::pwrite(op.fd, op.buffer, std::min(op.bytes, (size_t) INT_MAX), (off_t) op.offset);
+      break;
+    case posix_fs_syscall::kind::lock_range:
+      ret = _posix_lock_waiter::try_lock(op, true);
+      break;
+    case posix_fs_syscall::kind::wait_process:
+      ret = _posix_lock_waiter::try_wait(op, true);
+      break;
+    case posix_fs_syscall::kind::syncfs:
+      ret = _posix_lock_waiter::sync_filesystem(op);
+      break;
+    case posix_fs_syscall::kind::splice:
+#ifdef __linux__
+    {
+      loff_t off_in = (loff_t) op.offset, off_out = (loff_t) op.offset_out;
+      ret = (int) ::splice(op.fd, (op.offset == posix_fs_syscall::no_offset) ? nullptr : &off_in, op.fd_out,
+                           (op.offset_out == posix_fs_syscall::no_offset) ? nullptr : &off_out, std::min(op.bytes, (size_t) INT_MAX), (unsigned) op.flags);
+      break;
+    }
+#else
+      errno = ENOSYS;
+      break;
+#endif
+    case posix_fs_syscall::kind::tee:
+#ifdef __linux__
+      ret = (int) ::tee(op.fd, op.fd_out, std::min(op.bytes, (size_t) INT_MAX), (unsigned) op.flags);
+#else
+      errno = ENOSYS;
+#endif
+      break;
+    }
+    op.result = (ret < 0) ? -errno : ret;
+  }
+  return success();
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> io_multiplexer::initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept
+{
+  for(auto &op : ops)
+  {
+    if(op.op == posix_fs_syscall::kind::wait_process)
+    {
+      const int exited = _posix_lock_waiter::try_wait(op, false);
+      if(exited <= 0)
+      {
+        op.result = (exited == 0) ? 0 : -errno;
+        continue;
+      }
+    }
+    else if(op.op == posix_fs_syscall::kind::syncfs)
+    {
+      // Always executed by the waiter thread
+    }
+    else if(op.op != posix_fs_syscall::kind::lock_range)
+    {
+      OUTCOME_TRY(io_multiplexer::do_posix_fs_syscalls({&op, 1}));
+      continue;
+    }
+    else if(-1 != _posix_lock_waiter::try_lock(op, false))
+    {
+      op.result = 0;
+      continue;
+    }
+    else if(EAGAIN != errno && EACCES != errno)
+    {
+      op.result = -errno;
+      continue;
+    }
+    // Contended, still running or a syncfs, so hand it to the waiter thread
+    auto *waiter = _lock_waiter.p.load(std::memory_order_acquire);
+    if(waiter == nullptr)
+    {
+      try
+      {
+        auto *newwaiter = new _posix_lock_waiter(this);
+        if(_lock_waiter.p.compare_exchange_strong(waiter, newwaiter, std::memory_order_acq_rel))
+        {
+          waiter = newwaiter;
+        }
+        else
+        {
+          // Another thread created the waiter first
+          delete newwaiter;
+        }
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    OUTCOME_TRY(waiter->add(op));
+  }
+  return success();
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_multiplexer::_posix_lock_waiter_ptr::reset() noexcept
+{
+  delete p.exchange(nullptr, std::memory_order_acq_rel);
+}
+#endif
+
 template <bool is_threadsafe> struct io_multiplexer_impl : io_multiplexer
 {
   struct _lock_impl_type
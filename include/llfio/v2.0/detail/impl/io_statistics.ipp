@@ -0,0 +1,104 @@
+/* Counters and latency histograms of i/o
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../io_statistics.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  /* Each thread's statistics are registered here on first use, and on thread exit are folded
+  into the statistics of exited threads.
+  */
+  struct io_statistics_registry
+  {
+    std::mutex lock;
+    std::vector<const io_statistics *> threads;
+    io_statistics::snapshot exited;
+
+    static io_statistics_registry &get() noexcept
+    {
+      static io_statistics_registry v;
+      return v;
+    }
+  };
+  struct io_statistics_thread
+  {
+    io_statistics stats;
+    bool registered{false};
+
+    io_statistics_thread() noexcept
+    {
+      auto &r = io_statistics_registry::get();
+      try
+      {
+        std::lock_guard<std::mutex> g(r.lock);
+        r.threads.push_back(&stats);
+        registered = true;
+      }
+      catch(...)
+      {
+        // This thread's statistics will not be included in io_statistics::all_threads()
+      }
+    }
+    io_statistics_thread(const io_statistics_thread &) = delete;
+    io_statistics_thread(io_statistics_thread &&) = delete;
+    io_statistics_thread &operator=(const io_statistics_thread &) = delete;
+    io_statistics_thread &operator=(io_statistics_thread &&) = delete;
+    ~io_statistics_thread()
+    {
+      if(registered)
+      {
+        auto &r = io_statistics_registry::get();
+        std::lock_guard<std::mutex> g(r.lock);
+        r.exited += stats.value();
+        r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &stats));
+      }
+    }
+  };
+}  // namespace detail
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC io_statistics &io_statistics::this_thread() noexcept
+{
+  static thread_local detail::io_statistics_thread v;
+  return v.stats;
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC io_statistics::snapshot io_statistics::all_threads() noexcept
+{
+  auto &r = detail::io_statistics_registry::get();
+  std::lock_guard<std::mutex> g(r.lock);
+  snapshot ret = r.exited;
+  for(const auto *i : r.threads)
+  {
+    ret += i->value();
+  }
+  return ret;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,200 @@
+/* Binary tracing of i/o
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../io_trace.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <ostream>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  static_assert((LLFIO_IO_TRACE_EVENTS & (LLFIO_IO_TRACE_EVENTS - 1)) == 0, "LLFIO_IO_TRACE_EVENTS must be a power of two");
+  struct io_trace_buffer
+  {
+    std::atomic<uint64_t> head{0};  // events ever recorded, only ever written by the owning thread
+    uint32_t thread{0};
+    bool in_use{true};  // protected by the registry lock
+    io_trace::event events[LLFIO_IO_TRACE_EVENTS];
+  };
+  /* Each thread's ring buffer is registered here on first use. On thread exit it is marked
+  unused, keeping its events, and is reused by the next new thread.
+  */
+  struct io_trace_registry
+  {
+    std::mutex lock;
+    std::vector<io_trace_buffer *> buffers;
+    const uint64_t ticks0{io_trace::ticks()};
+    const std::chrono::steady_clock::time_point time0{std::chrono::steady_clock::now()};
+
+    io_trace_registry() = default;
+    io_trace_registry(const io_trace_registry &) = delete;
+    io_trace_registry(io_trace_registry &&) = delete;
+    io_trace_registry &operator=(const io_trace_registry &) = delete;
+    io_trace_registry &operator=(io_trace_registry &&) = delete;
+    ~io_trace_registry()
+    {
+      for(auto *b : buffers)
+      {
+        delete b;
+      }
+    }
+    static io_trace_registry &get() noexcept
+    {
+      static io_trace_registry v;
+      return v;
+    }
+  };
+  struct io_trace_thread
+  {
+    io_trace_buffer *buffer{nullptr};
+
+    io_trace_thread() noexcept
+    {
+      auto &r = io_trace_registry::get();
+      try
+      {
+        std::lock_guard<std::mutex> g(r.lock);
+        for(auto *b : r.buffers)
+        {
+          if(!b->in_use)
+          {
+            b->in_use = true;
+            buffer = b;
+            break;
+          }
+        }
+        if(buffer == nullptr)
+        {
+          r.buffers.reserve(r.buffers.size() + 1);
+          buffer = new io_trace_buffer;
+          r.buffers.push_back(buffer);
+        }
+        buffer->thread = QUICKCPPLIB_NAMESPACE::utils::thread::this_thread_id();
+      }
+      catch(...)
+      {
+        // This thread's events will not be recorded
+        buffer = nullptr;
+      }
+    }
+    io_trace_thread(const io_trace_thread &) = delete;
+    io_trace_thread(io_trace_thread &&) = delete;
+    io_trace_thread &operator=(const io_trace_thread &) = delete;
+    io_trace_thread &operator=(io_trace_thread &&) = delete;
+    ~io_trace_thread()
+    {
+      if(buffer != nullptr)
+      {
+        auto &r = io_trace_registry::get();
+        std::lock_guard<std::mutex> g(r.lock);
+        buffer->in_use = false;
+      }
+    }
+  };
+}  // namespace detail
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_trace::record(event e) noexcept
+{
+  static thread_local detail::io_trace_thread v;
+  auto *b = v.buffer;
+  if(b == nullptr)
+  {
+    return;
+  }
+  e.thread = b->thread;
+  const uint64_t idx = b->head.load(std::memory_order_relaxed);
+  b->events[idx & (LLFIO_IO_TRACE_EVENTS - 1)] = e;
+  b->head.store(idx + 1, std::memory_order_release);
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<io_trace::event> io_trace::events()
+{
+  auto &r = detail::io_trace_registry::get();
+  std::vector<event> ret;
+  {
+    std::lock_guard<std::mutex> g(r.lock);
+    for(const auto *b : r.buffers)
+    {
+      const uint64_t head = b->head.load(std::memory_order_acquire), count = (std::min)(head, (uint64_t) LLFIO_IO_TRACE_EVENTS);
+      for(uint64_t idx = head - count; idx < head; idx++)
+      {
+        ret.push_back(b->events[idx & (LLFIO_IO_TRACE_EVENTS - 1)]);
+      }
+    }
+  }
+  std::sort(ret.begin(), ret.end(), [](const event &a, const event &b) { return a.begin < b.begin; });
+  return ret;
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_trace::clear() noexcept
+{
+  auto &r = detail::io_trace_registry::get();
+  std::lock_guard<std::mutex> g(r.lock);
+  for(auto *b : r.buffers)
+  {
+    b->head.store(0, std::memory_order_relaxed);
+  }
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC double io_trace::nanoseconds(uint64_t ticks) noexcept
+{
+  auto &r = detail::io_trace_registry::get();
+  const uint64_t elapsedticks = io_trace::ticks() - r.ticks0;
+  const auto elapsedns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - r.time0).count();
+  if(elapsedticks == 0 || elapsedns <= 0)
+  {
+    return (double) ticks;
+  }
+  return (double) ticks * (double) elapsedns / (double) elapsedticks;
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void io_trace::write_chrome_trace(std::ostream &s)
+{
+  static const char *const names[] = {"read", "write", "barrier"};
+  const auto evs = events();
+  const uint64_t base = evs.empty() ? 0 : evs.front().begin;
+  const double scale = nanoseconds(1ULL << 30U) / (double) (1ULL << 30U) / 1000.0;  // ticks to microseconds
+  const auto flags = s.flags();
+  const auto precision = s.precision();
+  s << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  bool first = true;
+  for(const auto &e : evs)
+  {
+    s << (first ? "\n" : ",\n") << "{\"name\":\"" << names[(size_t) e.op] << "\",\"cat\":\"llfio\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+      << ",\"ts\":" << (double) (e.begin - base) * scale << ",\"dur\":" << (double) (e.end - e.begin) * scale << ",\"args\":{\"handle\":" << e.handle
+      << ",\"native\":" << e.native << ",\"offset\":" << e.offset << ",\"length\":" << e.length << ",\"transferred\":" << e.transferred
+      << ",\"failed\":" << ((e.failed != 0) ? "true" : "false") << "}}";
+    first = false;
+  }
+  s << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  s.flags(flags);
+  s.precision(precision);
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,248 @@
+/* A process wide pool of large page memory
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../utils.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace utils
+{
+  namespace detail
+  {
+    /* A binary buddy allocator over one large page allocation. The bookkeeping lives
+    outside the pool, one entry per page_size() block, so free blocks are never touched.
+    */
+    struct large_page_pool_state
+    {
+      static constexpr uint32_t nil = (uint32_t) -1;
+      static constexpr uint8_t free_bit = 0x80, not_head = 0xff;
+
+      std::mutex lock;
+      byte *base{nullptr};
+      size_t bytes{0}, in_use{0}, page_size_used{0};
+      unsigned min_shift{0}, max_order{0};
+      // Doubly linked free lists of block indices, one per order
+      uint32_t heads[64];
+      std::vector<uint32_t> next, prev;
+      // For the first block of each free or allocated run, its order, with free_bit set if free
+      std::vector<uint8_t> state;
+
+      void push(unsigned order, uint32_t idx) noexcept
+      {
+        state[idx] = (uint8_t)(order | free_bit);
+        prev[idx] = nil;
+        next[idx] = heads[order];
+        if(heads[order] != nil)
+        {
+          prev[heads[order]] = idx;
+        }
+        heads[order] = idx;
+      }
+      void unlink(unsigned order, uint32_t idx) noexcept
+      {
+        if(prev[idx] != nil)
+        {
+          next[prev[idx]] = next[idx];
+        }
+        else
+        {
+          heads[order] = next[idx];
+        }
+        if(next[idx] != nil)
+        {
+          prev[next[idx]] = prev[idx];
+        }
+        state[idx] = not_head;
+      }
+      void *allocate(unsigned order) noexcept
+      {
+        unsigned o = order;
+        while(o <= max_order && heads[o] == nil)
+        {
+          o++;
+        }
+        if(o > max_order)
+        {
+          return nullptr;
+        }
+        const uint32_t idx = heads[o];
+        unlink(o, idx);
+        // Split, freeing the upper halves
+        while(o > order)
+        {
+          o--;
+          push(o, idx + (uint32_t(1) << o));
+        }
+        state[idx] = (uint8_t) order;
+        in_use += size_t(1) << (order + min_shift);
+        return base + ((size_t) idx << min_shift);
+      }
+      void deallocate(uint32_t idx) noexcept
+      {
+        unsigned order = state[idx];
+        assert(order <= max_order);
+        in_use -= size_t(1) << (order + min_shift);
+        // Merge with free buddies
+        while(order < max_order)
+        {
+          const uint32_t buddy = idx ^ (uint32_t(1) << order);
+          if(state[buddy] != (uint8_t)(order | free_bit))
+          {
+            break;
+          }
+          unlink(order, buddy);
+          idx = std::min(idx, buddy);
+          order++;
+        }
+        push(order, idx);
+      }
+    };
+    inline large_page_pool_state &large_page_pool() noexcept
+    {
+      static large_page_pool_state v;
+      return v;
+    }
+
+    LLFIO_HEADERS_ONLY_FUNC_SPEC void *large_page_pool_allocate(size_t bytes) noexcept
+    {
+      auto &pool = large_page_pool();
+      std::lock_guard<std::mutex> g(pool.lock);
+      if(pool.base == nullptr || bytes > pool.bytes)
+      {
+        return nullptr;
+      }
+      unsigned order = 0;
+      while((size_t(1) << (order + pool.min_shift)) < bytes)
+      {
+        order++;
+      }
+      return pool.allocate(order);
+    }
+
+    LLFIO_HEADERS_ONLY_FUNC_SPEC bool large_page_pool_deallocate(void *p) noexcept
+    {
+      auto &pool = large_page_pool();
+      std::lock_guard<std::mutex> g(pool.lock);
+      if(pool.base == nullptr || (byte *) p < pool.base || (byte *) p >= pool.base + pool.bytes)
+      {
+        return false;
+      }
+      pool.deallocate((uint32_t)(((byte *) p - pool.base) >> pool.min_shift));
+      return true;
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reserve_large_page_pool(size_t bytes) noexcept
+  {
+    try
+    {
+      auto &pool = detail::large_page_pool();
+      std::lock_guard<std::mutex> g(pool.lock);
+      if(pool.base != nullptr)
+      {
+        return errc::device_or_resource_busy;
+      }
+      unsigned min_shift = 0;
+      while((size_t(1) << min_shift) < page_size())
+      {
+        min_shift++;
+      }
+      unsigned max_order = 0;
+      while((size_t(1) << (max_order + min_shift)) < bytes)
+      {
+        max_order++;
+      }
+      if(max_order >= 32)
+      {
+        return errc::value_too_large;
+      }
+      const size_t blocks = size_t(1) << max_order;
+      pool.next.assign(blocks, detail::large_page_pool_state::nil);
+      pool.prev.assign(blocks, detail::large_page_pool_state::nil);
+      pool.state.assign(blocks, detail::large_page_pool_state::not_head);
+      auto mem = detail::allocate_large_pages(blocks << min_shift);
+      if(mem.p == nullptr)
+      {
+        pool.next.clear();
+        pool.prev.clear();
+        pool.state.clear();
+        return errc::not_enough_memory;
+      }
+      pool.base = reinterpret_cast<byte *>(mem.p);
+      pool.bytes = blocks << min_shift;
+      pool.in_use = 0;
+      pool.page_size_used = mem.page_size_used;
+      pool.min_shift = min_shift;
+      pool.max_order = max_order;
+      for(auto &head : pool.heads)
+      {
+        head = detail::large_page_pool_state::nil;
+      }
+      pool.push(max_order, 0);
+      return pool.bytes;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> release_large_page_pool() noexcept
+  {
+    auto &pool = detail::large_page_pool();
+    std::lock_guard<std::mutex> g(pool.lock);
+    if(pool.base == nullptr)
+    {
+      return success();
+    }
+    if(pool.in_use > 0)
+    {
+      return errc::device_or_resource_busy;
+    }
+    detail::deallocate_large_pages(pool.base, pool.bytes);
+    pool.base = nullptr;
+    pool.bytes = pool.page_size_used = 0;
+    pool.next.clear();
+    pool.prev.clear();
+    pool.state.clear();
+    return success();
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC large_page_pool_statistics large_page_pool_stats() noexcept
+  {
+    auto &pool = detail::large_page_pool();
+    std::lock_guard<std::mutex> g(pool.lock);
+    large_page_pool_statistics ret;
+    ret.bytes_reserved = pool.bytes;
+    ret.bytes_in_use = pool.in_use;
+    ret.page_size_used = pool.page_size_used;
+    return ret;
+  }
+}  // namespace utils
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,178 @@
+/* A background thread reclaiming registered cold regions under memory pressure
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../../utils.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace utils
+{
+  namespace detail
+  {
+    struct memory_pressure_reclaimer_state
+    {
+      // Held whilst reclaiming, so a region is never reclaimed after its unregistration returns
+      std::mutex regions_lock;
+      std::vector<std::pair<uint64_t, span<byte>>> regions;
+      uint64_t next_id{1};
+
+      std::mutex lock;
+      std::condition_variable changed;
+      std::thread thread;
+      std::chrono::milliseconds interval{0};
+      float threshold{10};
+      // Incremented to tell the thread to exit, so a thread being stopped never picks up a later start's interval
+      unsigned generation{0};
+
+      memory_pressure_reclaimer_state() = default;
+      memory_pressure_reclaimer_state(const memory_pressure_reclaimer_state &) = delete;
+      memory_pressure_reclaimer_state &operator=(const memory_pressure_reclaimer_state &) = delete;
+      // The thread must be joined before static destruction completes
+      ~memory_pressure_reclaimer_state() { stop(); }
+
+      result<size_t> reclaim(bool pageout) noexcept
+      {
+        std::lock_guard<std::mutex> g(regions_lock);
+        size_t ret = 0;
+        for(auto &region : regions)
+        {
+          OUTCOME_TRY(auto &&bytes, reclaim_memory(region.second, pageout));
+          ret += bytes;
+        }
+        return ret;
+      }
+      void stop() noexcept
+      {
+        std::unique_lock<std::mutex> g(lock);
+        if(!thread.joinable())
+        {
+          return;
+        }
+        ++generation;
+        changed.notify_all();
+        std::thread t(std::move(thread));
+        g.unlock();
+        t.join();
+      }
+      void run(unsigned mygeneration) noexcept
+      {
+        std::unique_lock<std::mutex> g(lock);
+        while(mygeneration == generation)
+        {
+          changed.wait_for(g, interval);
+          if(mygeneration != generation)
+          {
+            break;
+          }
+          const auto t = threshold;
+          g.unlock();
+          auto r = current_memory_pressure();
+          // Pages touched since the last reclaim are warm again, so each interval reclaims afresh
+          if(r && (r.value().full >= t || r.value().some >= t))
+          {
+            (void) reclaim(r.value().full >= t);
+          }
+          g.lock();
+        }
+      }
+    };
+    inline memory_pressure_reclaimer_state &memory_pressure_reclaimer() noexcept
+    {
+      static memory_pressure_reclaimer_state v;
+      return v;
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<uint64_t> register_cold_region(span<byte> region) noexcept
+  {
+    auto &state = detail::memory_pressure_reclaimer();
+    try
+    {
+      std::lock_guard<std::mutex> g(state.regions_lock);
+      const uint64_t id = state.next_id++;
+      state.regions.emplace_back(id, region);
+      return id;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void unregister_cold_region(uint64_t id) noexcept
+  {
+    auto &state = detail::memory_pressure_reclaimer();
+    std::lock_guard<std::mutex> g(state.regions_lock);
+    for(auto it = state.regions.begin(); it != state.regions.end(); ++it)
+    {
+      if(it->first == id)
+      {
+        state.regions.erase(it);
+        return;
+      }
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reclaim_cold_regions(bool pageout) noexcept { return detail::memory_pressure_reclaimer().reclaim(pageout); }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> start_memory_pressure_reclaimer(std::chrono::milliseconds interval, float threshold) noexcept
+  {
+    auto &state = detail::memory_pressure_reclaimer();
+    if(interval.count() <= 0)
+    {
+      state.stop();
+      return success();
+    }
+    // Fail now if the platform cannot report memory pressure, rather than never reclaiming
+    OUTCOME_TRY(current_memory_pressure());
+    try
+    {
+      std::lock_guard<std::mutex> g(state.lock);
+      state.interval = interval;
+      state.threshold = threshold;
+      if(state.thread.joinable())
+      {
+        state.changed.notify_all();
+        return success();
+      }
+      const unsigned generation = state.generation;
+      state.thread = std::thread([&state, generation] { state.run(generation); });
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void stop_memory_pressure_reclaimer() noexcept { detail::memory_pressure_reclaimer().stop(); }
+}  // namespace utils
+
+LLFIO_V2_NAMESPACE_END
@@ -28,6 +28,7 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../../statfs.hpp"
 
 #include <algorithm>
+#include <climits>
 #include <mutex>
 #include <new>
 #include <regex>
@@ -63,6 +64,86 @@ namespace path_discovery
   }
 
   inline std::vector<std::pair<discovered_path::source_type, _store::_discovered_path>> _all_temporary_directories();
+  // Implemented per platform, these are no-ops where there is no cache of verification
+  inline bool _load_verified_cache(std::vector<discovered_path> &all, std::vector<_store::_discovered_path> &_all, bool &stale) noexcept;
+  inline void _save_verified_cache(const std::vector<discovered_path> &all, const std::vector<_store::_discovered_path> &_all) noexcept;
+  inline void _refresh_verified_cache_in_background(const std::vector<discovered_path> &all) noexcept;
+  inline int _memory_backed_rank(const stat_t &st) noexcept;
+
+  // Opens and stats every item, and tries creating a small file in each, which is slow
+  inline void _probe_temporary_directories(std::vector<discovered_path> &all, std::vector<_store::_discovered_path> &_all)
+  {
+    // Firstly go try to open and stat all items
+    for(size_t n = 0; n < all.size(); n++)
+    {
+      {
+        log_level_guard logg(log_level::fatal);  // suppress log printing of failure
+        (void) logg;
+        auto _h = directory_handle::directory({}, all[n].path);
+        if(!_h)
+        {
+          // Error during opening
+#if 0
+          fprintf(stderr, "path_discovery::verified_temporary_directories() failed to open %s due to %s\n", all[n].path.path().c_str(),
+                  _h.error().message().c_str());
+          path_view::c_str<> zpath(all[n].path, path_view::zero_terminated);
+          fprintf(stderr, "path_view::c_str says buffer = %p (%s) length = %u\n", zpath.buffer, zpath.buffer, (unsigned) zpath.length);
+          visit(all[n].path, [](auto _sv) {
+            char buffer[1024];
+            memcpy(buffer, (const char *) _sv.data(), _sv.size());
+            buffer[_sv.size()] = 0;
+            fprintf(stderr, "path_view has pointer %p content %s length = %u\n", _sv.data(), buffer, (unsigned) _sv.size());
+          });
+#endif
+          continue;
+        }
+        _all[n].h = std::move(_h).value();
+      }
+      // Try to create a small file in that directory
+      auto _fh =
+      file_handle::uniquely_named_file(_all[n].h, file_handle::mode::write, file_handle::caching::temporary, file_handle::flag::unlink_on_first_close);
+      if(!_fh)
+      {
+#if LLFIO_LOGGING_LEVEL >= 3
+        std::string msg("path_discovery::verified_temporary_directories() failed to create a file in ");
+        msg.append(_all[n].path.string());
+        msg.append(" due to ");
+        msg.append(_fh.error().message().c_str());
+        LLFIO_LOG_WARN(nullptr, msg.c_str());
+#endif
+        _all[n].h = {};
+        continue;
+      }
+      all[n].stat = stat_t(nullptr);
+      auto r = all[n].stat->fill(_all[n].h);
+      if(!r)
+      {
+        LLFIO_LOG_WARN(nullptr, "path_discovery::verified_temporary_directories() failed to stat an open handle to a temp directory");
+        all[n].stat = {};
+        _all[n].h = {};
+        continue;
+      }
+      statfs_t statfs;
+      auto statfsres = statfs.fill(_fh.value(), statfs_t::want::fstypename);
+      if(statfsres)
+      {
+        _all[n].fstypename = std::move(statfs.f_fstypename);
+      }
+      else
+      {
+#if LLFIO_LOGGING_LEVEL >= 3
+        std::string msg("path_discovery::verified_temporary_directories() failed to statfs the temp directory ");
+        msg.append(_all[n].path.string());
+        msg.append(" due to ");
+        msg.append(statfsres.error().message().c_str());
+        LLFIO_LOG_WARN(nullptr, msg.c_str());
+#endif
+        all[n].stat = {};
+        _all[n].h = {};
+        continue;
+      }
+    }
+  }
 
   span<discovered_path> all_temporary_directories(bool refresh) noexcept
   {
@@ -143,75 +224,17 @@ namespace path_discovery
     }
     try
     {
-      // Firstly go try to open and stat all items
-      for(size_t n = 0; n < ps.all.size(); n++)
+      // Reuse the verification by an earlier process if it is still valid, as probing is slow
+      bool stale = false;
+      const bool cached = _load_verified_cache(ps.all, ps._all, stale);
+      if(!cached)
       {
-        {
-          log_level_guard logg(log_level::fatal);  // suppress log printing of failure
-          (void) logg;
-          auto _h = directory_handle::directory({}, ps.all[n].path);
-          if(!_h)
-          {
-            // Error during opening
-#if 0
-            fprintf(stderr, "path_discovery::verified_temporary_directories() failed to open %s due to %s\n", ps.all[n].path.path().c_str(),
-                    _h.error().message().c_str());
-            path_view::c_str<> zpath(ps.all[n].path, path_view::zero_terminated);
-            fprintf(stderr, "path_view::c_str says buffer = %p (%s) length = %u\n", zpath.buffer, zpath.buffer, (unsigned) zpath.length);
-            visit(ps.all[n].path, [](auto _sv) {
-              char buffer[1024];
-              memcpy(buffer, (const char *) _sv.data(), _sv.size());
-              buffer[_sv.size()] = 0;
-              fprintf(stderr, "path_view has pointer %p content %s length = %u\n", _sv.data(), buffer, (unsigned) _sv.size());
-            });
-#endif
-            continue;
-          }
-          ps._all[n].h = std::move(_h).value();
-        }
-        // Try to create a small file in that directory
-        auto _fh =
-        file_handle::uniquely_named_file(ps._all[n].h, file_handle::mode::write, file_handle::caching::temporary, file_handle::flag::unlink_on_first_close);
-        if(!_fh)
-        {
-#if LLFIO_LOGGING_LEVEL >= 3
-          std::string msg("path_discovery::verified_temporary_directories() failed to create a file in ");
-          msg.append(ps._all[n].path.string());
-          msg.append(" due to ");
-          msg.append(_fh.error().message().c_str());
-          LLFIO_LOG_WARN(nullptr, msg.c_str());
-#endif
-          ps._all[n].h = {};
-          continue;
-        }
-        ps.all[n].stat = stat_t(nullptr);
-        auto r = ps.all[n].stat->fill(ps._all[n].h);
-        if(!r)
-        {
-          LLFIO_LOG_WARN(nullptr, "path_discovery::verified_temporary_directories() failed to stat an open handle to a temp directory");
-          ps.all[n].stat = {};
-          ps._all[n].h = {};
-          continue;
-        }
-        statfs_t statfs;
-        auto statfsres = statfs.fill(_fh.value(), statfs_t::want::fstypename);
-        if(statfsres)
-        {
-          ps._all[n].fstypename = std::move(statfs.f_fstypename);
-        }
-        else
-        {
-#if LLFIO_LOGGING_LEVEL >= 3
-          std::string msg("path_discovery::verified_temporary_directories() failed to statfs the temp directory ");
-          msg.append(ps._all[n].path.string());
-          msg.append(" due to ");
-          msg.append(statfsres.error().message().c_str());
-          LLFIO_LOG_WARN(nullptr, msg.c_str());
-#endif
-          ps.all[n].stat = {};
-          ps._all[n].h = {};
-          continue;
-        }
+        _probe_temporary_directories(ps.all, ps._all);
+        _save_verified_cache(ps.all, ps._all);
+      }
+      else if(stale)
+      {
+        _refresh_verified_cache_in_background(ps.all);
       }
       // Now partition into those with valid stat directories and those without
       std::stable_partition(ps._all.begin(), ps._all.end(), [](const _store::_discovered_path &a) { return a.h.is_valid(); });
@@ -234,15 +257,22 @@ namespace path_discovery
       std::regex storage_backed_regex("btrfs|cifs|exfat|ext[2-4]|f2fs|hfs|apfs|jfs|lxfs|nfs|nilf2|ufs|vfat|xfs|zfs|msdosfs|newnfs|ntfs|smbfs|unionfs|fat|fat32",
                                       std::regex::icase);
       std::regex memory_backed_regex("tmpfs|ramfs", std::regex::icase);
+      // Of the memory backed directories, prefer those whose memory is local to this NUMA node
+      int memory_backed_rank = INT_MAX;
       for(size_t n = 0; n < ps.verified.size(); n++)
       {
         if(!ps.storage_backed.is_valid() && std::regex_match(ps._all[n].fstypename, storage_backed_regex))
         {
           ps.storage_backed = std::move(ps._all[n].h);
         }
-        if(!ps.memory_backed.is_valid() && std::regex_match(ps._all[n].fstypename, memory_backed_regex))
+        else if(std::regex_match(ps._all[n].fstypename, memory_backed_regex))
         {
-          ps.memory_backed = std::move(ps._all[n].h);
+          const int rank = _memory_backed_rank(*ps.all[n].stat);
+          if(rank < memory_backed_rank)
+          {
+            memory_backed_rank = rank;
+            ps.memory_backed = std::move(ps._all[n].h);
+          }
         }
         ps.all[n].path = ps._all[n].path;
         (void) ps._all[n].h.close();
@@ -30,6 +30,12 @@ Distributed under the Boost Software License, Version 1.0.
 #include "windows/import.hpp"
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>  // for SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 LLFIO_V2_NAMESPACE_BEGIN
 
 namespace detail
@@ -69,6 +75,317 @@ namespace detail
     return ret;
   }
 
+  /* UTF reencoding, used in preference to codecvt when no locale is given. The exact length of
+  the output is calculated first, which also validates the input, so the output never needs to
+  be over allocated. Both passes process runs of ASCII, which is almost all of most paths,
+  sixteen code units at a time where SIMD is available.
+  */
+  // How many of the leading code units are ASCII
+  inline size_t _utf_ascii_run(const unsigned char *s, size_t length) noexcept
+  {
+    size_t n = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    for(; n + 16 <= length; n += 16)
+    {
+      if(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n))) != 0)
+      {
+        break;
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; n + 16 <= length; n += 16)
+    {
+      if(vmaxvq_u8(vld1q_u8(s + n)) >= 0x80)
+      {
+        break;
+      }
+    }
+#else
+    for(; n + 8 <= length; n += 8)
+    {
+      uint64_t v;
+      memcpy(&v, s + n, 8);
+      if((v & 0x8080808080808080ULL) != 0)
+      {
+        break;
+      }
+    }
+#endif
+    while(n < length && s[n] < 0x80)
+    {
+      n++;
+    }
+    return n;
+  }
+  inline size_t _utf_ascii_run(const uint16_t *s, size_t length) noexcept
+  {
+    size_t n = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    const __m128i nonascii = _mm_set1_epi16((short) 0xff80);
+    for(; n + 16 <= length; n += 16)
+    {
+      const __m128i v = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n + 8)));
+      if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, nonascii), _mm_setzero_si128())) != 0xffff)
+      {
+        break;
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; n + 16 <= length; n += 16)
+    {
+      if(vmaxvq_u16(vorrq_u16(vld1q_u16(s + n), vld1q_u16(s + n + 8))) >= 0x80)
+      {
+        break;
+      }
+    }
+#else
+    for(; n + 4 <= length; n += 4)
+    {
+      uint64_t v;
+      memcpy(&v, s + n, 8);
+      if((v & 0xff80ff80ff80ff80ULL) != 0)
+      {
+        break;
+      }
+    }
+#endif
+    while(n < length && s[n] < 0x80)
+    {
+      n++;
+    }
+    return n;
+  }
+  // Copies a run of ASCII, widening or narrowing each code unit
+  template <class DestT, class SrcT> inline DestT *_utf_copy_ascii(DestT *d, const SrcT *s, size_t length) noexcept
+  {
+    for(size_t n = 0; n < length; n++)
+    {
+      d[n] = static_cast<DestT>(s[n]);
+    }
+    return d + length;
+  }
+  inline uint16_t *_utf_copy_ascii(uint16_t *d, const unsigned char *s, size_t length) noexcept
+  {
+    size_t n = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    for(; n + 16 <= length; n += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d + n), _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d + n + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; n + 16 <= length; n += 16)
+    {
+      const uint8x16_t v = vld1q_u8(s + n);
+      vst1q_u16(d + n, vmovl_u8(vget_low_u8(v)));
+      vst1q_u16(d + n + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    return _utf_copy_ascii<uint16_t, unsigned char>(d + n, s + n, length - n);
+  }
+  inline unsigned char *_utf_copy_ascii(unsigned char *d, const uint16_t *s, size_t length) noexcept
+  {
+    size_t n = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    for(; n + 16 <= length; n += 16)
+    {
+      const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n));
+      const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n + 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(d + n), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; n + 16 <= length; n += 16)
+    {
+      vst1q_u8(d + n, vcombine_u8(vmovn_u16(vld1q_u16(s + n)), vmovn_u16(vld1q_u16(s + n + 8))));
+    }
+#endif
+    return _utf_copy_ascii<unsigned char, uint16_t>(d + n, s + n, length - n);
+  }
+  // Decodes one code point, returning -1 if the input is not valid
+  inline int32_t _utf_decode(const unsigned char *&s, const unsigned char *end) noexcept
+  {
+    const uint32_t c = *s++;
+    if(c < 0x80)
+    {
+      return (int32_t) c;
+    }
+    size_t extra;
+    uint32_t cp, least;
+    if((c & 0xe0) == 0xc0)
+    {
+      extra = 1;
+      cp = c & 0x1f;
+      least = 0x80;
+    }
+    else if((c & 0xf0) == 0xe0)
+    {
+      extra = 2;
+      cp = c & 0x0f;
+      least = 0x800;
+    }
+    else if((c & 0xf8) == 0xf0)
+    {
+      extra = 3;
+      cp = c & 0x07;
+      least = 0x10000;
+    }
+    else
+    {
+      return -1;
+    }
+    if((size_t)(end - s) < extra)
+    {
+      return -1;
+    }
+    for(size_t n = 0; n < extra; n++)
+    {
+      const uint32_t cc = *s++;
+      if((cc & 0xc0) != 0x80)
+      {
+        return -1;
+      }
+      cp = (cp << 6) | (cc & 0x3f);
+    }
+    // Overlong encodings, surrogates and beyond Unicode are all invalid
+    if(cp < least || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+    {
+      return -1;
+    }
+    return (int32_t) cp;
+  }
+  inline int32_t _utf_decode(const uint16_t *&s, const uint16_t *end) noexcept
+  {
+    const uint32_t c = *s++;
+    if(c < 0xd800 || c > 0xdfff)
+    {
+      return (int32_t) c;
+    }
+    // Must be a high surrogate followed by a low surrogate
+    if(c >= 0xdc00 || s == end || *s < 0xdc00 || *s > 0xdfff)
+    {
+      return -1;
+    }
+    return (int32_t)(0x10000 + ((c - 0xd800) << 10) + (*s++ - 0xdc00));
+  }
+  inline size_t _utf_encoded_length(const unsigned char * /*unused*/, uint32_t cp) noexcept { return (cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4; }
+  inline size_t _utf_encoded_length(const uint16_t * /*unused*/, uint32_t cp) noexcept { return (cp < 0x10000) ? 1 : 2; }
+  inline size_t _utf_encoded_length(const uint32_t * /*unused*/, uint32_t /*unused*/) noexcept { return 1; }
+  inline unsigned char *_utf_encode(unsigned char *d, uint32_t cp) noexcept
+  {
+    if(cp < 0x80)
+    {
+      *d++ = (unsigned char) cp;
+    }
+    else if(cp < 0x800)
+    {
+      *d++ = (unsigned char) (0xc0 | (cp >> 6));
+      *d++ = (unsigned char) (0x80 | (cp & 0x3f));
+    }
+    else if(cp < 0x10000)
+    {
+      *d++ = (unsigned char) (0xe0 | (cp >> 12));
+      *d++ = (unsigned char) (0x80 | ((cp >> 6) & 0x3f));
+      *d++ = (unsigned char) (0x80 | (cp & 0x3f));
+    }
+    else
+    {
+      *d++ = (unsigned char) (0xf0 | (cp >> 18));
+      *d++ = (unsigned char) (0x80 | ((cp >> 12) & 0x3f));
+      *d++ = (unsigned char) (0x80 | ((cp >> 6) & 0x3f));
+      *d++ = (unsigned char) (0x80 | (cp & 0x3f));
+    }
+    return d;
+  }
+  inline uint16_t *_utf_encode(uint16_t *d, uint32_t cp) noexcept
+  {
+    if(cp < 0x10000)
+    {
+      *d++ = (uint16_t) cp;
+    }
+    else
+    {
+      *d++ = (uint16_t) (0xd800 + ((cp - 0x10000) >> 10));
+      *d++ = (uint16_t) (0xdc00 + ((cp - 0x10000) & 0x3ff));
+    }
+    return d;
+  }
+  inline uint32_t *_utf_encode(uint32_t *d, uint32_t cp) noexcept
+  {
+    *d++ = cp;
+    return d;
+  }
+  // The code units needed to reencode the input, or -1 if the input is not valid
+  template <class DestT, class SrcT> inline size_t _utf_reencoded_length(const SrcT *s, size_t length) noexcept
+  {
+    const SrcT *const end = s + length;
+    size_t ret = 0;
+    while(s != end)
+    {
+      const size_t ascii = _utf_ascii_run(s, (size_t)(end - s));
+      s += ascii;
+      ret += ascii;
+      while(s != end && *s >= 0x80)
+      {
+        const int32_t cp = _utf_decode(s, end);
+        if(cp < 0)
+        {
+          return (size_t) -1;
+        }
+        ret += _utf_encoded_length(static_cast<const DestT *>(nullptr), (uint32_t) cp);
+      }
+    }
+    return ret;
+  }
+  // Reencodes input already validated by _utf_reencoded_length(), returning where the last character was written to
+  template <class DestT, class SrcT> inline DestT *_utf_reencode(DestT *d, const SrcT *s, size_t length) noexcept
+  {
+    const SrcT *const end = s + length;
+    while(s != end)
+    {
+      const size_t ascii = _utf_ascii_run(s, (size_t)(end - s));
+      d = _utf_copy_ascii(d, s, ascii);
+      s += ascii;
+      while(s != end && *s >= 0x80)
+      {
+        d = _utf_encode(d, (uint32_t) _utf_decode(s, end));
+      }
+    }
+    return d;
+  }
+  /* Returns where the last character was written to. toallocate is written with exactly how
+  much must be written, including the zero terminator, if there wasn't enough space.
+  */
+  template <class DestT, class SrcT, class OutT, class InT>
+  inline OutT *_utf_reencode_path_to(size_t &toallocate, OutT *dest_buffer, size_t dest_buffer_length, const InT *src_buffer, size_t src_buffer_length)
+  {
+    static_assert(sizeof(DestT) == sizeof(OutT) && sizeof(SrcT) == sizeof(InT), "code unit sizes must match");
+    const auto *src = reinterpret_cast<const SrcT *>(src_buffer);
+    const size_t required = _utf_reencoded_length<DestT>(src, src_buffer_length);
+    if(required == (size_t) -1)
+    {
+      throw std::system_error(make_error_code(std::errc::illegal_byte_sequence));
+    }
+    if(required >= dest_buffer_length)
+    {
+      toallocate = required + 1;
+#ifdef _WIN32
+      if(toallocate * sizeof(OutT) > 65535)
+      {
+        LLFIO_LOG_FATAL(nullptr, "Paths exceeding 64Kb are impossible on Microsoft Windows");
+        abort();
+      }
+#endif
+      return dest_buffer;
+    }
+    auto *end = reinterpret_cast<OutT *>(_utf_reencode(reinterpret_cast<DestT *>(dest_buffer), src, src_buffer_length));
+    *end = 0;
+    toallocate = 0;
+    return end;
+  }
+  // wchar_t is UTF-16 on Windows, and UTF-32 almost everywhere else
+  using _utf_wchar_unit = std::conditional<sizeof(wchar_t) == 2, uint16_t, uint32_t>::type;
+
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable : 4127)  // conditional expression is constant
@@ -301,6 +618,10 @@ namespace detail
   char *reencode_path_to(size_t &toallocate, char *dest_buffer, size_t dest_buffer_length, const char16_t *src_buffer, size_t src_buffer_length,
                          const std::locale *loc)
   {
+    if(loc == nullptr)
+    {
+      return _utf_reencode_path_to<unsigned char, uint16_t>(toallocate, dest_buffer, dest_buffer_length, src_buffer, src_buffer_length);
+    }
 #if(__cplusplus >= 202000 || (_HAS_CXX20 && _MSC_VER >= 1921)) && !defined(_LIBCPP_VERSION)
     return (char *) _reencode_path_to(toallocate, (char8_t *) dest_buffer, dest_buffer_length, src_buffer, src_buffer_length, loc);
 #elif defined(_MSC_VER) && _MSC_VER < 1920
@@ -436,6 +757,10 @@ namespace detail
   wchar_t *reencode_path_to(size_t &toallocate, wchar_t *dest_buffer, size_t dest_buffer_length, const char8_t *src_buffer, size_t src_buffer_length,
                             const std::locale *loc)
   {
+    if(loc == nullptr)
+    {
+      return _utf_reencode_path_to<_utf_wchar_unit, unsigned char>(toallocate, dest_buffer, dest_buffer_length, src_buffer, src_buffer_length);
+    }
 #if LLFIO_PATH_VIEW_CHAR8_TYPE_EMULATED
 #if defined(_LIBCPP_VERSION)
     (void) toallocate;
@@ -486,6 +811,12 @@ namespace detail
   wchar_t *reencode_path_to(size_t &toallocate, wchar_t *dest_buffer, size_t dest_buffer_length, const char16_t *src_buffer, size_t src_buffer_length,
                             const std::locale *loc)
   {
+#ifndef _WIN32
+    if(loc == nullptr)
+    {
+      return _utf_reencode_path_to<_utf_wchar_unit, uint16_t>(toallocate, dest_buffer, dest_buffer_length, src_buffer, src_buffer_length);
+    }
+#endif
 #ifdef _WIN32
     (void) toallocate;
     (void) dest_buffer;
@@ -518,6 +849,118 @@ namespace detail
 #endif
   }
 
+  /* Separator finding for path_view::split(). Sixteen bytes are compared at a time where SIMD
+  is available, with the matches then read out of the comparison bitmask.
+  */
+  inline unsigned _sep_lowest_bit(uint64_t v) noexcept
+  {
+#ifdef _MSC_VER
+    unsigned long ret;
+    _BitScanForward64(&ret, v);
+    return (unsigned) ret;
+#else
+    return (unsigned) __builtin_ctzll(v);
+#endif
+  }
+  template <class CharT>
+  inline size_t _find_path_separators(size_t *offsets, size_t offsets_length, const CharT *s, size_t idx, size_t length, CharT sep1, CharT sep2) noexcept
+  {
+    size_t count = 0;
+    for(; idx < length && count < offsets_length; idx++)
+    {
+      if(s[idx] == sep1 || s[idx] == sep2)
+      {
+        offsets[count++] = idx;
+      }
+    }
+    return count;
+  }
+  inline size_t _find_path_separators(size_t *offsets, size_t offsets_length, const unsigned char *s, size_t idx, size_t length, unsigned char sep1,
+                                      unsigned char sep2) noexcept
+  {
+    size_t count = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    const __m128i a = _mm_set1_epi8((char) sep1), b = _mm_set1_epi8((char) sep2);
+    for(; idx + 16 <= length; idx += 16)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + idx));
+      for(uint64_t mask = (unsigned) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, b))); mask != 0; mask &= mask - 1)
+      {
+        if(count == offsets_length)
+        {
+          return count;
+        }
+        offsets[count++] = idx + _sep_lowest_bit(mask);
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t a = vdupq_n_u8(sep1), b = vdupq_n_u8(sep2);
+    for(; idx + 16 <= length; idx += 16)
+    {
+      const uint8x16_t v = vld1q_u8(s + idx);
+      const uint8x16_t eq = vorrq_u8(vceqq_u8(v, a), vceqq_u8(v, b));
+      // Four bits per byte
+      for(uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0); mask != 0;
+          mask &= ~(uint64_t(15) << (_sep_lowest_bit(mask) & ~3U)))
+      {
+        if(count == offsets_length)
+        {
+          return count;
+        }
+        offsets[count++] = idx + _sep_lowest_bit(mask) / 4;
+      }
+    }
+#endif
+    return count + _find_path_separators<unsigned char>(offsets + count, offsets_length - count, s, idx, length, sep1, sep2);
+  }
+  inline size_t _find_path_separators(size_t *offsets, size_t offsets_length, const uint16_t *s, size_t idx, size_t length, uint16_t sep1,
+                                      uint16_t sep2) noexcept
+  {
+    size_t count = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    const __m128i a = _mm_set1_epi16((short) sep1), b = _mm_set1_epi16((short) sep2);
+    for(; idx + 8 <= length; idx += 8)
+    {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + idx));
+      // Two bits per code unit
+      for(uint64_t mask = (unsigned) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, a), _mm_cmpeq_epi16(v, b))) & 0x5555U; mask != 0;
+          mask &= mask - 1)
+      {
+        if(count == offsets_length)
+        {
+          return count;
+        }
+        offsets[count++] = idx + _sep_lowest_bit(mask) / 2;
+      }
+    }
+#endif
+    return count + _find_path_separators<uint16_t>(offsets + count, offsets_length - count, s, idx, length, sep1, sep2);
+  }
+  LLFIO_HEADERS_ONLY_FUNC_SPEC size_t find_path_separators(size_t *offsets, size_t offsets_length, const char *src_buffer, size_t startidx,
+                                                           size_t src_buffer_length, char sep1, char sep2) noexcept
+  {
+    return _find_path_separators(offsets, offsets_length, reinterpret_cast<const unsigned char *>(src_buffer), startidx, src_buffer_length,
+                                 (unsigned char) sep1, (unsigned char) sep2);
+  }
+  LLFIO_HEADERS_ONLY_FUNC_SPEC size_t find_path_separators(size_t *offsets, size_t offsets_length, const wchar_t *src_buffer, size_t startidx,
+                                                           size_t src_buffer_length, char sep1, char sep2) noexcept
+  {
+    return _find_path_separators(offsets, offsets_length, reinterpret_cast<const _utf_wchar_unit *>(src_buffer), startidx, src_buffer_length,
+                                 (_utf_wchar_unit) sep1, (_utf_wchar_unit) sep2);
+  }
+  LLFIO_HEADERS_ONLY_FUNC_SPEC size_t find_path_separators(size_t *offsets, size_t offsets_length, const char8_t *src_buffer, size_t startidx,
+                                                           size_t src_buffer_length, char sep1, char sep2) noexcept
+  {
+    return _find_path_separators(offsets, offsets_length, reinterpret_cast<const unsigned char *>(src_buffer), startidx, src_buffer_length,
+                                 (unsigned char) sep1, (unsigned char) sep2);
+  }
+  LLFIO_HEADERS_ONLY_FUNC_SPEC size_t find_path_separators(size_t *offsets, size_t offsets_length, const char16_t *src_buffer, size_t startidx,
+                                                           size_t src_buffer_length, char sep1, char sep2) noexcept
+  {
+    return _find_path_separators(offsets, offsets_length, reinterpret_cast<const uint16_t *>(src_buffer), startidx, src_buffer_length,
+                                 (uint16_t) sep1, (uint16_t) sep2);
+  }
+
 }  // namespace detail
 
 LLFIO_V2_NAMESPACE_END
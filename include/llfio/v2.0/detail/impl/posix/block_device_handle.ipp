@@ -0,0 +1,317 @@
+/* A handle to a block device
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../../../block_device_handle.hpp"
+#include "import.hpp"
+
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/sysmacros.h>
+#else
+#include <sys/disk.h>
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+#ifdef __linux__
+  // The ABI of <linux/blkzoned.h>, which older kernel headers lack or lack parts of
+  struct blk_zone
+  {
+    uint64_t start;  // all in 512 byte sectors
+    uint64_t len;
+    uint64_t wp;
+    uint8_t type;
+    uint8_t cond;
+    uint8_t non_seq;
+    uint8_t reset;
+    uint8_t resv[4];
+    uint64_t capacity;  // if BLK_ZONE_REP_CAPACITY, Linux 5.9 onwards
+    uint8_t reserved[24];
+  };
+  struct blk_zone_report
+  {
+    uint64_t sector;
+    uint32_t nr_zones;
+    uint32_t flags;
+  };
+  struct blk_zone_range
+  {
+    uint64_t sector;
+    uint64_t nr_sectors;
+  };
+  static constexpr uint32_t BLK_ZONE_REP_CAPACITY = 1;
+
+  // Reads a value from the sysfs queue directory of a block device, which for partitions is that of the parent device
+  inline unsigned long long block_device_queue_attribute(dev_t dev, const char *name, char *buffer, size_t bufferlen) noexcept
+  {
+    buffer[0] = 0;
+    char path[128];
+    for(const char *parent : {"", "../"})
+    {
+      snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%squeue/%s", major(dev), minor(dev), parent, name);
+      int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if(fd != -1)
+      {
+        const auto bytesread = ::read(fd, buffer, bufferlen - 1);
+        ::close(fd);
+        if(bytesread > 0)
+        {
+          buffer[bytesread] = 0;
+          return strtoull(buffer, nullptr, 10);
+        }
+        buffer[0] = 0;
+        return 0;
+      }
+    }
+    return 0;
+  }
+#endif
+}  // namespace detail
+
+result<void> block_device_handle::_fetch_geometry() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  struct stat s
+  {
+  };
+  memset(&s, 0, sizeof(s));
+  if(-1 == ::fstat(_v.fd, &s))
+  {
+    return posix_error();
+  }
+  if(!S_ISBLK(s.st_mode))
+  {
+    return errc::no_such_device;
+  }
+  _geometry = geometry_type();
+#ifdef __linux__
+  int logical = 0;
+  unsigned int physical = 0;
+  uint64_t size = 0;
+  if(-1 == ::ioctl(_v.fd, BLKSSZGET, &logical) || -1 == ::ioctl(_v.fd, BLKPBSZGET, &physical) || -1 == ::ioctl(_v.fd, BLKGETSIZE64, &size))
+  {
+    return posix_error();
+  }
+  _geometry.logical_block_size = (uint32_t) logical;
+  _geometry.physical_block_size = physical;
+  _geometry.size = size;
+  char buffer[64];
+  _geometry.max_transfer = detail::block_device_queue_attribute(s.st_rdev, "max_sectors_kb", buffer, sizeof(buffer)) * 1024;
+  (void) detail::block_device_queue_attribute(s.st_rdev, "zoned", buffer, sizeof(buffer));
+  if(0 == strncmp(buffer, "host-managed", 12))
+  {
+    _geometry.zoned = zone_model::host_managed;
+  }
+  else if(0 == strncmp(buffer, "host-aware", 10))
+  {
+    _geometry.zoned = zone_model::host_aware;
+  }
+  if(_geometry.zoned != zone_model::none)
+  {
+    uint32_t zonesectors = 0, zonecount = 0;
+    if(-1 == ::ioctl(_v.fd, _IOR(0x12, 132, uint32_t) /*BLKGETZONESZ*/, &zonesectors) || -1 == ::ioctl(_v.fd, _IOR(0x12, 133, uint32_t) /*BLKGETNRZONES*/, &zonecount))
+    {
+      return posix_error();
+    }
+    _geometry.zone_size = (extent_type) zonesectors * 512;
+    _geometry.zone_count = zonecount;
+    // Linux 5.9 onwards
+    _geometry.max_open_zones = (uint32_t) detail::block_device_queue_attribute(s.st_rdev, "max_open_zones", buffer, sizeof(buffer));
+    _geometry.max_active_zones = (uint32_t) detail::block_device_queue_attribute(s.st_rdev, "max_active_zones", buffer, sizeof(buffer));
+    try
+    {
+      _append_lock.reset(new std::mutex);
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+#elif defined(DIOCGMEDIASIZE)
+  // BSDs
+  u_int sectorsize = 0;
+  off_t mediasize = 0;
+  if(-1 == ::ioctl(_v.fd, DIOCGSECTORSIZE, &sectorsize) || -1 == ::ioctl(_v.fd, DIOCGMEDIASIZE, &mediasize))
+  {
+    return posix_error();
+  }
+  _geometry.logical_block_size = _geometry.physical_block_size = sectorsize;
+  _geometry.size = (extent_type) mediasize;
+#ifdef DIOCGSTRIPESIZE
+  off_t stripesize = 0;
+  if(-1 != ::ioctl(_v.fd, DIOCGSTRIPESIZE, &stripesize) && stripesize > 0)
+  {
+    _geometry.physical_block_size = (uint32_t) stripesize;
+  }
+#endif
+#elif defined(DKIOCGETBLOCKSIZE)
+  // Mac OS
+  uint32_t blocksize = 0, physicalblocksize = 0;
+  uint64_t blockcount = 0, maxtransfer = 0;
+  if(-1 == ::ioctl(_v.fd, DKIOCGETBLOCKSIZE, &blocksize) || -1 == ::ioctl(_v.fd, DKIOCGETBLOCKCOUNT, &blockcount))
+  {
+    return posix_error();
+  }
+  _geometry.logical_block_size = _geometry.physical_block_size = blocksize;
+  if(-1 != ::ioctl(_v.fd, DKIOCGETPHYSICALBLOCKSIZE, &physicalblocksize))
+  {
+    _geometry.physical_block_size = physicalblocksize;
+  }
+  if(-1 != ::ioctl(_v.fd, DKIOCGETMAXBYTECOUNTWRITE, &maxtransfer))
+  {
+    _geometry.max_transfer = maxtransfer;
+  }
+  _geometry.size = (extent_type) blocksize * blockcount;
+#endif
+  return success();
+}
+
+result<span<block_device_handle::zone>> block_device_handle::zones(span<zone> out, extent_type offset) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!is_zoned())
+  {
+    return errc::operation_not_supported;
+  }
+#ifdef __linux__
+  if(out.empty())
+  {
+    return out;
+  }
+  try
+  {
+    std::vector<byte> buffer(sizeof(detail::blk_zone_report) + out.size() * sizeof(detail::blk_zone));
+    auto *report = reinterpret_cast<detail::blk_zone_report *>(buffer.data());
+    auto *descs = reinterpret_cast<detail::blk_zone *>(report + 1);
+    report->sector = offset / 512;
+    report->nr_zones = (uint32_t) out.size();
+    if(-1 == ::ioctl(_v.fd, _IOWR(0x12, 130, detail::blk_zone_report) /*BLKREPORTZONE*/, report))
+    {
+      return posix_error();
+    }
+    for(uint32_t n = 0; n < report->nr_zones; n++)
+    {
+      auto &z = out[n];
+      z.start = descs[n].start * 512;
+      z.length = descs[n].len * 512;
+      z.capacity = (report->flags & detail::BLK_ZONE_REP_CAPACITY) ? descs[n].capacity * 512 : z.length;
+      z.write_pointer = descs[n].wp * 512;
+      z.type = static_cast<zone_type>(descs[n].type);
+      z.condition = static_cast<zone_condition>(descs[n].cond);
+    }
+    return out.subspan(0, report->nr_zones);
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+#else
+  (void) out;
+  (void) offset;
+  return errc::operation_not_supported;
+#endif
+}
+
+result<void> block_device_handle::manage_zones(zone_operation op, extent_pair extent) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!is_zoned())
+  {
+    return errc::operation_not_supported;
+  }
+#ifdef __linux__
+  if(extent.offset + extent.length < extent.offset)
+  {
+    return errc::value_too_large;
+  }
+  detail::blk_zone_range range{extent.offset / 512, extent.length / 512};
+  unsigned long request = 0;
+  switch(op)
+  {
+  case zone_operation::open:
+    request = _IOW(0x12, 134, detail::blk_zone_range);  // BLKOPENZONE
+    break;
+  case zone_operation::close:
+    request = _IOW(0x12, 135, detail::blk_zone_range);  // BLKCLOSEZONE
+    break;
+  case zone_operation::finish:
+    request = _IOW(0x12, 136, detail::blk_zone_range);  // BLKFINISHZONE
+    break;
+  case zone_operation::reset:
+    request = _IOW(0x12, 131, detail::blk_zone_range);  // BLKRESETZONE
+    break;
+  }
+  if(-1 == ::ioctl(_v.fd, request, &range))
+  {
+    // Kernels before 5.5 know only resetting
+    if(ENOTTY == errno)
+    {
+      return errc::operation_not_supported;
+    }
+    return posix_error();
+  }
+  if(op == zone_operation::reset)
+  {
+    _invalidate_extent_map();
+  }
+  return success();
+#else
+  (void) op;
+  (void) extent;
+  return errc::operation_not_supported;
+#endif
+}
+
+result<block_device_handle::extent_type> block_device_handle::zone_append(extent_type zone_offset, const_buffers_type buffers, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!is_zoned() || !_append_lock)
+  {
+    return errc::operation_not_supported;
+  }
+  extent_type bytes = 0;
+  for(auto &b : buffers)
+  {
+    bytes += b.size();
+  }
+  std::lock_guard<std::mutex> g(*_append_lock);
+  OUTCOME_TRY(auto &&z, zone_at(zone_offset));
+  if(z.type == zone_type::conventional)
+  {
+    return errc::invalid_argument;
+  }
+  if(z.write_pointer + bytes > z.start + z.capacity || z.condition == zone_condition::full)
+  {
+    return errc::no_space_on_device;
+  }
+  OUTCOME_TRY(auto &&written, write({buffers, z.write_pointer}, d));
+  (void) written;
+  return z.write_pointer;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,518 @@
+/* A handle to a byte-orientated socket
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../byte_socket_handle.hpp"
+#include "import.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+static_assert(sizeof(sockaddr_storage) <= 128, "sockaddr_storage does not fit into socket_address");
+
+namespace detail
+{
+  inline int socket_family_to_af(socket_address::family_type family) noexcept
+  {
+    switch(family)
+    {
+    case socket_address::family_type::v4:
+      return AF_INET;
+    case socket_address::family_type::v6:
+      return AF_INET6;
+    case socket_address::family_type::local:
+      return AF_UNIX;
+    case socket_address::family_type::unknown:
+      break;
+    }
+    return -1;
+  }
+  // Sets the disposition of a socket from its mode and flags
+  inline result<void> socket_behaviour_from_mode_and_flags(native_handle_type &nativeh, handle::mode _mode, handle::flag flags) noexcept
+  {
+    nativeh.behaviour |= native_handle_type::disposition::socket;
+    switch(_mode)
+    {
+    case handle::mode::read:
+      nativeh.behaviour |= native_handle_type::disposition::readable;
+      break;
+    case handle::mode::write:
+      nativeh.behaviour |= native_handle_type::disposition::readable | native_handle_type::disposition::writable;
+      break;
+    case handle::mode::append:
+      nativeh.behaviour |= native_handle_type::disposition::writable;
+      break;
+    default:
+      return errc::invalid_argument;
+    }
+    if(!!(flags & handle::flag::multiplexable))
+    {
+      nativeh.behaviour |= native_handle_type::disposition::nonblocking;
+    }
+    return success();
+  }
+  // Creates a close-on-exec stream socket, nonblocking if so disposed
+  inline result<int> create_stream_socket(int af, const native_handle_type &nativeh) noexcept
+  {
+#if defined(__linux__) || defined(__FreeBSD__)
+    const int fd = ::socket(af, SOCK_STREAM | SOCK_CLOEXEC | (nativeh.is_nonblocking() ? SOCK_NONBLOCK : 0), 0);
+    if(-1 == fd)
+    {
+      return posix_error();
+    }
+#else
+    const int fd = ::socket(af, SOCK_STREAM, 0);
+    if(-1 == fd)
+    {
+      return posix_error();
+    }
+    if(-1 == ::fcntl(fd, F_SETFD, FD_CLOEXEC) || (nativeh.is_nonblocking() && -1 == ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK)))
+    {
+      const int e = errno;
+      ::close(fd);
+      return posix_error(e);
+    }
+#endif
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    (void) ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return fd;
+  }
+  // Disables Nagle's algorithm on TCP sockets
+  inline void socket_set_nodelay(int fd, int af) noexcept
+  {
+    if(af == AF_INET || af == AF_INET6)
+    {
+      int one = 1;
+      (void) ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+  }
+  // Waits until the socket is ready for `events`, or `d` expires, returning whether it is ready
+  inline result<bool> socket_poll(int fd, short events, deadline d, std::chrono::steady_clock::time_point began_steady) noexcept
+  {
+    int mstimeout = -1;
+    if(d)
+    {
+      std::chrono::milliseconds ms;
+      LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(ms, d);
+      mstimeout = (int) ms.count();
+    }
+    pollfd p;
+    memset(&p, 0, sizeof(p));
+    p.fd = fd;
+    p.events = events | POLLERR;
+    const int ret = ::poll(&p, 1, mstimeout);
+    if(-1 == ret && EINTR != errno)
+    {
+      return posix_error();
+    }
+    return ret > 0;
+  }
+}  // namespace detail
+
+/******************************************* socket_address *********************************************/
+
+socket_address::family_type socket_address::family() const noexcept
+{
+  if(_len == 0)
+  {
+    return family_type::unknown;
+  }
+  switch(reinterpret_cast<const sockaddr *>(_storage)->sa_family)
+  {
+  case AF_INET:
+    return family_type::v4;
+  case AF_INET6:
+    return family_type::v6;
+  case AF_UNIX:
+    return family_type::local;
+  default:
+    return family_type::unknown;
+  }
+}
+
+uint16_t socket_address::port() const noexcept
+{
+  switch(family())
+  {
+  case family_type::v4:
+    return ntohs(reinterpret_cast<const sockaddr_in *>(_storage)->sin_port);
+  case family_type::v6:
+    return ntohs(reinterpret_cast<const sockaddr_in6 *>(_storage)->sin6_port);
+  default:
+    return 0;
+  }
+}
+
+bool socket_address::is_loopback() const noexcept
+{
+  switch(family())
+  {
+  case family_type::v4:
+    return (ntohl(reinterpret_cast<const sockaddr_in *>(_storage)->sin_addr.s_addr) >> 24) == 127;
+  case family_type::v6:
+    return IN6_IS_ADDR_LOOPBACK(&reinterpret_cast<const sockaddr_in6 *>(_storage)->sin6_addr) != 0;
+  default:
+    return false;
+  }
+}
+
+result<socket_address> socket_address::ip(string_view address, uint16_t port) noexcept
+{
+  char buffer[INET6_ADDRSTRLEN + 1];
+  if(address.size() >= sizeof(buffer))
+  {
+    return errc::invalid_argument;
+  }
+  memcpy(buffer, address.data(), address.size());
+  buffer[address.size()] = 0;
+  socket_address ret;
+  memset(ret._storage, 0, sizeof(ret._storage));
+  auto *v4 = reinterpret_cast<sockaddr_in *>(ret._storage);
+  auto *v6 = reinterpret_cast<sockaddr_in6 *>(ret._storage);
+  if(1 == ::inet_pton(AF_INET, buffer, &v4->sin_addr))
+  {
+    v4->sin_family = AF_INET;
+    v4->sin_port = htons(port);
+    ret._len = sizeof(sockaddr_in);
+    return ret;
+  }
+  if(1 == ::inet_pton(AF_INET6, buffer, &v6->sin6_addr))
+  {
+    v6->sin6_family = AF_INET6;
+    v6->sin6_port = htons(port);
+    ret._len = sizeof(sockaddr_in6);
+    return ret;
+  }
+  return errc::invalid_argument;
+}
+
+result<socket_address> socket_address::loopback(family_type family, uint16_t port) noexcept
+{
+  switch(family)
+  {
+  case family_type::v4:
+    return ip("127.0.0.1", port);
+  case family_type::v6:
+    return ip("::1", port);
+  default:
+    return errc::invalid_argument;
+  }
+}
+
+result<socket_address> socket_address::any(family_type family, uint16_t port) noexcept
+{
+  switch(family)
+  {
+  case family_type::v4:
+    return ip("0.0.0.0", port);
+  case family_type::v6:
+    return ip("::", port);
+  default:
+    return errc::invalid_argument;
+  }
+}
+
+result<socket_address> socket_address::local(path_view path) noexcept
+{
+  try
+  {
+    path_view::c_str<char> zpath(path, path_view::zero_terminated);
+    socket_address ret;
+    memset(ret._storage, 0, sizeof(ret._storage));
+    auto *un = reinterpret_cast<sockaddr_un *>(ret._storage);
+    if(zpath.length >= sizeof(un->sun_path))
+    {
+      return errc::filename_too_long;
+    }
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, zpath.buffer, zpath.length);
+    ret._len = (uint32_t) (offsetof(sockaddr_un, sun_path) + zpath.length + 1);
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+/******************************************* byte_socket_handle *********************************************/
+
+result<byte_socket_handle> byte_socket_handle::byte_socket(family_type family, mode _mode, caching _caching, flag flags) noexcept
+{
+  result<byte_socket_handle> ret(byte_socket_handle(native_handle_type(), _caching, flags, nullptr));
+  native_handle_type &nativeh = ret.value()._v;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  const int af = detail::socket_family_to_af(family);
+  if(af < 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(nativeh, _mode, flags));
+  OUTCOME_TRY(auto &&fd, detail::create_stream_socket(af, nativeh));
+  nativeh.fd = fd;
+  detail::socket_set_nodelay(nativeh.fd, af);
+  return ret;
+}
+
+result<std::pair<byte_socket_handle, byte_socket_handle>> byte_socket_handle::anonymous_socket_pair(caching _caching, flag flags) noexcept
+{
+  result<std::pair<byte_socket_handle, byte_socket_handle>> ret(byte_socket_handle(native_handle_type(), _caching, flags, nullptr), byte_socket_handle(native_handle_type(), _caching, flags, nullptr));
+  native_handle_type &anativeh = ret.value().first._v, &bnativeh = ret.value().second._v;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(anativeh, mode::write, flags));
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(bnativeh, mode::write, flags));
+  int fds[2];
+#if defined(__linux__) || defined(__FreeBSD__)
+  if(-1 == ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | (anativeh.is_nonblocking() ? SOCK_NONBLOCK : 0), 0, fds))
+  {
+    return posix_error();
+  }
+  anativeh.fd = fds[0];
+  bnativeh.fd = fds[1];
+#else
+  if(-1 == ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+  {
+    return posix_error();
+  }
+  anativeh.fd = fds[0];
+  bnativeh.fd = fds[1];
+  for(int fd : fds)
+  {
+    if(-1 == ::fcntl(fd, F_SETFD, FD_CLOEXEC) || (anativeh.is_nonblocking() && -1 == ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK)))
+    {
+      return posix_error();
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    (void) ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  }
+#endif
+  return ret;
+}
+
+result<void> byte_socket_handle::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifndef NDEBUG
+  if(_v)
+  {
+    // Tell handle::close() that we have correctly executed
+    _v.behaviour |= native_handle_type::disposition::_child_close_executed;
+  }
+#endif
+  return io_handle::close();
+}
+
+result<void> byte_socket_handle::connect(const socket_address &addr, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  if(-1 != ::connect(_v.fd, reinterpret_cast<const sockaddr *>(addr._storage), (socklen_t) addr._len))
+  {
+    return success();
+  }
+  if(EINPROGRESS != errno && EINTR != errno)
+  {
+    return posix_error();
+  }
+  // The connection completes asynchronously, whereupon the socket becomes writable
+  for(;;)
+  {
+    OUTCOME_TRY(auto &&ready, detail::socket_poll(_v.fd, POLLOUT, d, began_steady));
+    if(ready)
+    {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      if(-1 == ::getsockopt(_v.fd, SOL_SOCKET, SO_ERROR, &error, &len))
+      {
+        return posix_error();
+      }
+      if(error != 0)
+      {
+        return posix_error(error);
+      }
+      return success();
+    }
+    LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+  }
+}
+
+result<socket_address> byte_socket_handle::local_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  socklen_t len = sizeof(ret._storage);
+  if(-1 == ::getsockname(_v.fd, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return posix_error();
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<socket_address> byte_socket_handle::remote_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  socklen_t len = sizeof(ret._storage);
+  if(-1 == ::getpeername(_v.fd, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return posix_error();
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<void> byte_socket_handle::shutdown(shutdown_kind kind) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  const int how = (kind == shutdown_kind::read) ? SHUT_RD : (kind == shutdown_kind::write) ? SHUT_WR : SHUT_RDWR;
+  if(-1 == ::shutdown(_v.fd, how))
+  {
+    return posix_error();
+  }
+  return success();
+}
+
+/******************************************* listening_byte_socket_handle *********************************************/
+
+result<listening_byte_socket_handle> listening_byte_socket_handle::listening_byte_socket(const socket_address &addr, mode _mode, caching _caching, flag flags, int backlog) noexcept
+{
+  result<listening_byte_socket_handle> ret(listening_byte_socket_handle(native_handle_type(), _caching, flags));
+  native_handle_type &nativeh = ret.value()._v;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  const int af = detail::socket_family_to_af(addr.family());
+  if(af < 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(nativeh, _mode, flags));
+  OUTCOME_TRY(auto &&fd, detail::create_stream_socket(af, nativeh));
+  nativeh.fd = fd;
+  if(af != AF_UNIX)
+  {
+    // Permit immediate rebinding of the port after a previous listener closes
+    int one = 1;
+    (void) ::setsockopt(nativeh.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+  if(-1 == ::bind(nativeh.fd, reinterpret_cast<const sockaddr *>(addr.data()), (socklen_t) addr.size()))
+  {
+    return posix_error();
+  }
+  if(-1 == ::listen(nativeh.fd, (backlog < 0) ? SOMAXCONN : backlog))
+  {
+    return posix_error();
+  }
+  return ret;
+}
+
+result<void> listening_byte_socket_handle::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifndef NDEBUG
+  if(_v)
+  {
+    // Tell handle::close() that we have correctly executed
+    _v.behaviour |= native_handle_type::disposition::_child_close_executed;
+  }
+#endif
+  return handle::close();
+}
+
+result<socket_address> listening_byte_socket_handle::local_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  socklen_t len = sizeof(ret._storage);
+  if(-1 == ::getsockname(_v.fd, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return posix_error();
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<byte_socket_handle> listening_byte_socket_handle::accept(deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+  result<byte_socket_handle> ret(byte_socket_handle(native_handle_type(), kernel_caching(), _flags, nullptr));
+  native_handle_type &nativeh = ret.value()._v;
+  nativeh.behaviour |= native_handle_type::disposition::socket;
+  nativeh.behaviour |= _v.behaviour & (native_handle_type::disposition::readable | native_handle_type::disposition::writable | native_handle_type::disposition::nonblocking);
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  for(;;)
+  {
+#if defined(__linux__) || defined(__FreeBSD__)
+    nativeh.fd = ::accept4(_v.fd, nullptr, nullptr, SOCK_CLOEXEC | (nativeh.is_nonblocking() ? SOCK_NONBLOCK : 0));
+#else
+    nativeh.fd = ::accept(_v.fd, nullptr, nullptr);
+#endif
+    if(-1 != nativeh.fd)
+    {
+      break;
+    }
+    if(EWOULDBLOCK != errno && EAGAIN != errno && EINTR != errno)
+    {
+      return posix_error();
+    }
+    LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+    OUTCOME_TRY(detail::socket_poll(_v.fd, POLLIN, d, began_steady));
+  }
+#if !defined(__linux__) && !defined(__FreeBSD__)
+  // BSD sockets inherit O_NONBLOCK from the listening socket, but not close-on-exec
+  if(-1 == ::fcntl(nativeh.fd, F_SETFD, FD_CLOEXEC))
+  {
+    return posix_error();
+  }
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  (void) ::setsockopt(nativeh.fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+#endif
+  sockaddr_storage ss;
+  socklen_t len = sizeof(ss);
+  if(-1 != ::getsockname(nativeh.fd, reinterpret_cast<sockaddr *>(&ss), &len))
+  {
+    detail::socket_set_nodelay(nativeh.fd, ss.ss_family);
+  }
+  return ret;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,263 @@
+/* Memory whose pages are materialised on first touch by a user callback
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../demand_paged_map.hpp"
+#include "import.hpp"
+
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+#ifdef __linux__
+namespace detail
+{
+  inline void demand_paged_map_handler(demand_paged_map::fill_function &fill, byte *addr, size_t pagesize, int uffd, int wakefd, std::atomic<size_t> &materialised,
+                                       std::atomic<size_t> &failures) noexcept
+  {
+    void *bounce = ::mmap(nullptr, pagesize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    for(;;)
+    {
+      struct pollfd fds[2];
+      fds[0].fd = uffd;
+      fds[0].events = POLLIN;
+      fds[0].revents = 0;
+      fds[1].fd = wakefd;
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+      if(-1 == ::poll(fds, 2, -1))
+      {
+        if(EINTR == errno)
+        {
+          continue;
+        }
+        break;
+      }
+      if(fds[1].revents != 0)
+      {
+        break;  // close() was called
+      }
+      struct uffd_msg msg;
+      const auto bytesread = ::read(uffd, &msg, sizeof(msg));
+      if(bytesread != sizeof(msg))
+      {
+        if(-1 == bytesread && (EAGAIN == errno || EINTR == errno))
+        {
+          continue;
+        }
+        break;
+      }
+      if(msg.event != UFFD_EVENT_PAGEFAULT)
+      {
+        continue;
+      }
+      const uintptr_t pageaddr = (uintptr_t) msg.arg.pagefault.address & ~(uintptr_t)(pagesize - 1);
+      bool ok = false;
+      if(bounce != MAP_FAILED)
+      {
+        auto r = fill((demand_paged_map::extent_type)(pageaddr - (uintptr_t) addr), {(byte *) bounce, pagesize});
+        ok = r.has_value();
+      }
+      if(ok)
+      {
+        struct uffdio_copy copy;
+        memset(&copy, 0, sizeof(copy));
+        copy.dst = pageaddr;
+        copy.src = (uintptr_t) bounce;
+        copy.len = pagesize;
+        if(-1 == ::ioctl(uffd, UFFDIO_COPY, &copy) && EEXIST != errno)
+        {
+          ok = false;
+        }
+        else
+        {
+          materialised.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      if(!ok)
+      {
+        failures.fetch_add(1, std::memory_order_relaxed);
+        // The faulting thread must be resumed regardless
+        struct uffdio_zeropage zero;
+        memset(&zero, 0, sizeof(zero));
+        zero.range.start = pageaddr;
+        zero.range.len = pagesize;
+        (void) ::ioctl(uffd, UFFDIO_ZEROPAGE, &zero);
+      }
+    }
+    if(bounce != MAP_FAILED)
+    {
+      ::munmap(bounce, pagesize);
+    }
+  }
+}  // namespace detail
+#endif
+
+result<demand_paged_map> demand_paged_map::map(size_type bytes, fill_function fill) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+#ifdef __linux__
+  if(bytes == 0)
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    result<demand_paged_map> ret(demand_paged_map{});
+    ret.value()._state = std::make_unique<_state_t>();
+    _state_t &state = *ret.value()._state;
+    state.pagesize = utils::page_size();
+    state.length = utils::round_up_to_page_size(bytes, state.pagesize);
+    state.fill = std::move(fill);
+    // Only user mode faults are needed, which newer kernels permit to the unprivileged
+    state.uffd = (int) ::syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    if(-1 == state.uffd && EINVAL == errno)
+    {
+      state.uffd = (int) ::syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    }
+    if(-1 == state.uffd)
+    {
+      if(ENOSYS == errno)
+      {
+        return errc::operation_not_supported;
+      }
+      if(EPERM == errno)
+      {
+        return errc::operation_not_permitted;
+      }
+      return posix_error();
+    }
+    struct uffdio_api api;
+    memset(&api, 0, sizeof(api));
+    api.api = UFFD_API;
+    if(-1 == ::ioctl(state.uffd, UFFDIO_API, &api))
+    {
+      return posix_error();
+    }
+    state.wakefd = ::eventfd(0, EFD_CLOEXEC);
+    if(-1 == state.wakefd)
+    {
+      return posix_error();
+    }
+    void *addr = ::mmap(nullptr, state.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(MAP_FAILED == addr)
+    {
+      return posix_error();
+    }
+    state.addr = (byte *) addr;
+    struct uffdio_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.range.start = (uintptr_t) addr;
+    reg.range.len = state.length;
+    reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+    if(-1 == ::ioctl(state.uffd, UFFDIO_REGISTER, &reg))
+    {
+      return posix_error();
+    }
+    state.handler = std::thread(detail::demand_paged_map_handler, std::ref(state.fill), state.addr, (size_t) state.pagesize, state.uffd, state.wakefd,
+                                std::ref(state.materialised), std::ref(state.failures));
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+#else
+  (void) bytes;
+  (void) fill;
+  return errc::operation_not_supported;
+#endif
+}
+
+result<void> demand_paged_map::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!_state)
+  {
+    return success();
+  }
+  std::unique_ptr<_state_t> state(std::move(_state));
+#ifdef __linux__
+  if(state->handler.joinable())
+  {
+    const uint64_t one = 1;
+    if((ssize_t) sizeof(one) != ::write(state->wakefd, &one, sizeof(one)))
+    {
+      return posix_error();
+    }
+    state->handler.join();
+  }
+  if(state->addr != nullptr && -1 == ::munmap(state->addr, state->length))
+  {
+    return posix_error();
+  }
+  if(state->uffd != -1 && -1 == ::close(state->uffd))
+  {
+    return posix_error();
+  }
+  if(state->wakefd != -1 && -1 == ::close(state->wakefd))
+  {
+    return posix_error();
+  }
+#endif
+  return success();
+}
+
+result<demand_paged_map::buffer_type> demand_paged_map::discard(buffer_type region) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!_state)
+  {
+    return errc::invalid_argument;
+  }
+  region = utils::round_to_page_size_larger(region, _state->pagesize);
+  if(region.data() < _state->addr || region.data() + region.size() > _state->addr + _state->length)
+  {
+    return errc::invalid_argument;
+  }
+  if(region.size() > 0)
+  {
+    // A private anonymous page thrown away is missing once more, so will be refilled on next touch
+    if(-1 == ::madvise(region.data(), region.size(), MADV_DONTNEED))
+    {
+      return posix_error();
+    }
+  }
+  return region;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -23,6 +23,7 @@ http://www.boost.org/LICENSE_1_0.txt)
 */
 
 #include "../../../directory_handle.hpp"
+#include "../../../io_multiplexer.hpp"
 #include "import.hpp"
 
 #ifdef QUICKCPPLIB_ENABLE_VALGRIND
@@ -39,6 +40,144 @@ http://www.boost.org/LICENSE_1_0.txt)
 
 LLFIO_V2_NAMESPACE_BEGIN
 
+namespace detail
+{
+#ifdef __linux__
+  // Unlike FreeBSD, Linux doesn't define a getdents() function, so we'll do that here.
+  using dirent_t = dirent64;
+  inline int getdents(int fd, char *buf, unsigned count) noexcept { return static_cast<int>(syscall(SYS_getdents64, fd, buf, count)); }
+#elif defined(__APPLE__)
+  // OS X defines a getdirentries64() kernel syscall which can emulate getdents
+  using dirent_t = dirent;
+  inline int getdents(int fd, char *buf, unsigned count) noexcept
+  {
+    off_t foo;
+    return static_cast<int>(syscall(SYS_getdirentries64, fd, buf, count, &foo));
+  }
+#else
+  using dirent_t = dirent;
+  inline int getdents(int fd, char *buf, unsigned count) noexcept { return ::getdents(fd, buf, count); }
+#endif
+  // Returns false if the kernel did not say what the type of the entry is
+  inline bool d_type_to_st_type(filesystem::file_type &out, unsigned char d_type) noexcept
+  {
+    switch(d_type)
+    {
+    case DT_BLK:
+      out = filesystem::file_type::block;
+      break;
+    case DT_CHR:
+      out = filesystem::file_type::character;
+      break;
+    case DT_DIR:
+      out = filesystem::file_type::directory;
+      break;
+    case DT_FIFO:
+      out = filesystem::file_type::fifo;
+      break;
+    case DT_LNK:
+      out = filesystem::file_type::symlink;
+      break;
+    case DT_REG:
+      out = filesystem::file_type::regular;
+      break;
+    case DT_SOCK:
+      out = filesystem::file_type::socket;
+      break;
+    case DT_UNKNOWN:
+      return false;
+    }
+    return true;
+  }
+
+  /* A shell glob compiled once per enumeration. Globs of literals and at most one run of `*`,
+  which covers the common `*.ext` and `prefix*`, are matched using memcmp() against the
+  literal prefix and suffix (the suffix first, as it is usually the most discriminating).
+  Anything else is handed to fnmatch().
+  */
+  class compiled_glob
+  {
+    enum class kind_t
+    {
+      all,
+      literal,
+      prefix,
+      suffix,
+      prefix_suffix,
+      complex
+    } _kind{kind_t::all};
+    const char *_pattern{nullptr};
+    const char *_prefix{nullptr}, *_suffix{nullptr};
+    size_t _prefixlen{0}, _suffixlen{0};
+
+  public:
+    //! Matches everything if `pattern` is null or empty
+    explicit compiled_glob(const char *pattern) noexcept
+        : _pattern(pattern)
+    {
+      if(pattern == nullptr || 0 == *pattern)
+      {
+        return;
+      }
+      if(strpbrk(pattern, "?[\\") != nullptr)
+      {
+        _kind = kind_t::complex;
+        return;
+      }
+      const size_t length = strlen(pattern);
+      const char *firststar = strchr(pattern, '*');
+      if(firststar == nullptr)
+      {
+        _kind = kind_t::literal;
+        _prefix = pattern;
+        _prefixlen = length;
+        return;
+      }
+      const char *laststar = strrchr(pattern, '*');
+      for(const char *i = firststar; i < laststar; i++)
+      {
+        if(*i != '*')
+        {
+          _kind = kind_t::complex;
+          return;
+        }
+      }
+      _prefix = pattern;
+      _prefixlen = firststar - pattern;
+      _suffix = laststar + 1;
+      _suffixlen = pattern + length - _suffix;
+      if(_prefixlen == 0)
+      {
+        _kind = (_suffixlen == 0) ? kind_t::all : kind_t::suffix;
+      }
+      else
+      {
+        _kind = (_suffixlen == 0) ? kind_t::prefix : kind_t::prefix_suffix;
+      }
+    }
+    //! True if the zero terminated `name` of `length` characters matches the glob
+    bool operator()(const char *name, size_t length) const noexcept
+    {
+      switch(_kind)
+      {
+      case kind_t::all:
+        return true;
+      case kind_t::literal:
+        return length == _prefixlen && 0 == memcmp(name, _prefix, length);
+      case kind_t::prefix:
+        return length >= _prefixlen && 0 == memcmp(name, _prefix, _prefixlen);
+      case kind_t::suffix:
+        return length >= _suffixlen && 0 == memcmp(name + length - _suffixlen, _suffix, _suffixlen);
+      case kind_t::prefix_suffix:
+        return length >= _prefixlen + _suffixlen && 0 == memcmp(name + length - _suffixlen, _suffix, _suffixlen) && 0 == memcmp(name, _prefix, _prefixlen);
+      case kind_t::complex:
+        break;
+      }
+      return fnmatch(_pattern, name, 0) == 0;
+    }
+  };
+}  // namespace detail
+
 result<directory_handle> directory_handle::directory(const path_handle &base, path_view_type path, mode _mode, creation _creation, caching _caching, flag flags) noexcept
 {
   if(flags & flag::unlink_on_first_close)
@@ -175,6 +314,127 @@ opened:
   return ret;
 }
 
+result<std::vector<result<directory_handle>>> directory_handle::directories(const path_handle &base, span<const path_view_type> paths, mode _mode,
+                                                                            creation _creation, caching _caching, flag flags, io_multiplexer *multiplexer) noexcept
+{
+  try
+  {
+    std::vector<result<directory_handle>> ret;
+    ret.reserve(paths.size());
+    // Only plain opens can be batched, creation needs the mkdir() dance of directory()
+    if(multiplexer == nullptr || _creation != creation::open_existing || (flags & flag::unlink_on_first_close))
+    {
+      for(const auto &path : paths)
+      {
+        ret.push_back(directory(base, path, _mode, _creation, _caching, flags));
+      }
+      return ret;
+    }
+    if(_mode == mode::attr_write)
+    {
+      _mode = mode::attr_read;
+    }
+    else if(_mode == mode::write || _mode == mode::append)
+    {
+      _mode = mode::read;
+    }
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    using zpath_type = path_view::c_str<>;
+    std::vector<posix_fs_syscall> ops(paths.size());
+    std::vector<std::unique_ptr<zpath_type>> zpaths(paths.size());
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      ret.push_back(directory_handle(native_handle_type(), 0, 0, _caching, flags));
+      native_handle_type &nativeh = ret.back().value()._v;
+      nativeh.behaviour |= native_handle_type::disposition::directory;
+      auto attribs = attribs_from_handle_mode_caching_and_flags(nativeh, _mode, _creation, _caching, flags);
+      if(!attribs)
+      {
+        ret.back() = result<directory_handle>(std::move(attribs).error());
+        continue;
+      }
+      nativeh.behaviour &= ~native_handle_type::disposition::nonblocking;
+      nativeh.behaviour &= ~native_handle_type::disposition::seekable;  // not seekable
+      int oflags = attribs.value() & ~O_NONBLOCK;
+#ifdef O_DIRECTORY
+      oflags |= O_DIRECTORY;
+#endif
+#ifdef O_SEARCH
+      oflags |= O_SEARCH;
+#endif
+      zpaths[n] = std::make_unique<zpath_type>((base.is_valid() && paths[n].empty()) ? path_view_type(".") : paths[n], path_view::zero_terminated);
+      ops[n].op = posix_fs_syscall::kind::openat;
+      ops[n].fd = base.is_valid() ? base.native_handle().fd : AT_FDCWD;
+      ops[n].path = zpaths[n]->buffer;
+      ops[n].flags = oflags;
+    }
+    // Open all the paths whose attributes could be calculated
+    size_t valid = 0;
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      if(ret[n])
+      {
+        std::swap(ops[valid++], ops[n]);
+      }
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls({ops.data(), valid}));
+    std::vector<stat_t> stats;
+    std::vector<const handle *> tofetch;
+    std::vector<size_t> idxs;
+    for(size_t n = 0, idx = 0; n < paths.size(); n++)
+    {
+      if(!ret[n])
+      {
+        continue;
+      }
+      const auto &op = ops[idx++];
+      if(op.result < 0)
+      {
+        ret[n] = result<directory_handle>(posix_error(-op.result));
+        continue;
+      }
+      ret[n].value()._v.fd = op.result;
+      if(!(flags & flag::disable_safety_unlinks))
+      {
+        tofetch.push_back(&ret[n].value());
+        idxs.push_back(n);
+      }
+    }
+    // Fetch the inodes of the opened directories as a second batch, as directory() would
+    if(!tofetch.empty())
+    {
+      stats.resize(tofetch.size(), stat_t(nullptr));
+      OUTCOME_TRY(auto &&filled, stat_t::fill(stats, tofetch, stat_t::want::dev | stat_t::want::ino, multiplexer));
+      for(size_t n = 0; n < idxs.size(); n++)
+      {
+        auto &dirh = ret[idxs[n]].value();
+        if(filled[n])
+        {
+          dirh._devid = stats[n].st_dev;
+          dirh._inode = stats[n].st_ino;
+        }
+        else
+        {
+          // If fetching inode failed e.g. were opening device, disable safety unlinks
+          dirh._flags &= ~flag::disable_safety_unlinks;
+        }
+      }
+    }
+    for(auto &r : ret)
+    {
+      if(r && r.value().are_safety_barriers_issued())
+      {
+        fsync(r.value()._v.fd);
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 result<directory_handle> directory_handle::reopen(mode mode_, caching caching_, deadline d) const noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -197,7 +457,7 @@ result<directory_handle> directory_handle::reopen(mode mode_, caching caching_,
   {
     if(d.steady)
     {
-      began_steady = std::chrono::steady_clock::now();
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
     }
     else
     {
@@ -229,7 +489,7 @@ result<directory_handle> directory_handle::reopen(mode mode_, caching caching_,
     {
       if(d.steady)
       {
-        if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
+        if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
         {
           return errc::timed_out;
         }
@@ -332,24 +592,17 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     req.buffers._done = true;
     return std::move(req.buffers);
   }
-#ifdef __linux__
-  // Unlike FreeBSD, Linux doesn't define a getdents() function, so we'll do that here.
-  using getdents64_t = int (*)(int, char *, unsigned int);
-  static auto getdents = static_cast<getdents64_t>([](int fd, char *buf, unsigned count) -> int { return syscall(SYS_getdents64, fd, buf, count); });
-  using dirent = dirent64;
-#endif
-#ifdef __APPLE__
-  // OS X defines a getdirentries64() kernel syscall which can emulate getdents
-  typedef int (*getdents_emulation_t)(int, char *, unsigned);
-  static getdents_emulation_t getdents = static_cast<getdents_emulation_t>([](int fd, char *buf, unsigned count) -> int {
-    off_t foo;
-    return syscall(SYS_getdirentries64, fd, buf, count, &foo);
-  });
-#endif
+  using detail::getdents;
+  using dirent = detail::dirent_t;
   if(!req.buffers._kernel_buffer && req.kernelbuffer.empty())
   {
-    // Let's assume the average leafname will be 64 characters long.
-    size_t toallocate = (sizeof(dirent) + 64) * req.buffers.size();
+    // Let's assume the average leafname will be 64 characters long. The buffer grows below if
+    // the directory has more entries than fit.
+    size_t toallocate = (offsetof(dirent, d_name) + 64) * req.buffers.size();
+    if(toallocate < 4 * sizeof(dirent))
+    {
+      toallocate = 4 * sizeof(dirent);
+    }
     auto *mem = (char *) operator new[](toallocate, std::nothrow);  // don't initialise
     if(mem == nullptr)
     {
@@ -359,6 +612,7 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     req.buffers._kernel_buffer_size = toallocate;
   }
   stat_t::want default_stat_contents = stat_t::want::ino | stat_t::want::type;
+  const detail::compiled_glob matches(req.glob.empty() ? nullptr : zglob.buffer);
   dirent *buffer;
   size_t bytesavailable;
   int bytes;
@@ -400,8 +654,59 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     {
       if(bytes == -1)
       {
+        if(!req.kernelbuffer.empty() && EINVAL == errno)
+        {
+          return errc::no_buffer_space;  // user needs to supply a bigger buffer
+        }
         return posix_error();
       }
+      if(!req.kernelbuffer.empty() && bytesavailable - static_cast<size_t>(bytes) < sizeof(dirent))
+      {
+        /* The leafnames returned are views into the supplied buffer, so if it was too small
+        to hold the whole directory, the remainder cannot go anywhere else. Like on Windows,
+        have the user supply a bigger buffer rather than return a partial enumeration.
+        */
+        alignas(dirent) char probe[sizeof(dirent)];
+        int more = getdents(_v.fd, probe, sizeof(probe));
+        if(more == -1)
+        {
+          return posix_error();
+        }
+        if(more > 0)
+        {
+          return errc::no_buffer_space;  // user needs to supply a bigger buffer
+        }
+      }
+      /* The kernel only stops filling our buffer early if the next entry would not fit, so
+      if there is not room for the largest possible entry there may be more to come. If
+      the buffer is ours, grow it keeping what we have and read the remainder into the
+      new space, so large directories need neither a reread nor a later regrow.
+      */
+      while(req.kernelbuffer.empty() && bytesavailable - static_cast<size_t>(bytes) < sizeof(dirent))
+      {
+        size_t toallocate = req.buffers._kernel_buffer_size * 2;
+        auto *mem = (char *) operator new[](toallocate, std::nothrow);  // don't initialise
+        if(mem == nullptr)
+        {
+          return errc::not_enough_memory;
+        }
+        memcpy(mem, buffer, bytes);
+        req.buffers._kernel_buffer.reset();
+        req.buffers._kernel_buffer = std::unique_ptr<char[]>(mem);
+        req.buffers._kernel_buffer_size = toallocate;
+        buffer = reinterpret_cast<dirent *>(mem);
+        bytesavailable = toallocate;
+        int more = getdents(_v.fd, mem + bytes, bytesavailable - bytes);
+        if(more == -1)
+        {
+          return posix_error();
+        }
+        if(more == 0)
+        {
+          break;
+        }
+        bytes += more;
+      }
       done = true;
     }
   } while(!done);
@@ -426,7 +731,7 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
           goto cont;
         }
       }
-      if(!req.glob.empty() && fnmatch(zglob.buffer, dent->d_name, 0) != 0)
+      if(!matches(dent->d_name, length))
       {
         goto cont;
       }
@@ -434,34 +739,10 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
       item.leafname = path_view(dent->d_name, length, path_view::zero_terminated);
       item.stat = stat_t(nullptr);
       item.stat.st_ino = dent->d_ino;
-      char d_type = dent->d_type;
-      switch(d_type)
+      if(!detail::d_type_to_st_type(item.stat.st_type, dent->d_type))
       {
-      case DT_BLK:
-        item.stat.st_type = filesystem::file_type::block;
-        break;
-      case DT_CHR:
-        item.stat.st_type = filesystem::file_type::character;
-        break;
-      case DT_DIR:
-        item.stat.st_type = filesystem::file_type::directory;
-        break;
-      case DT_FIFO:
-        item.stat.st_type = filesystem::file_type::fifo;
-        break;
-      case DT_LNK:
-        item.stat.st_type = filesystem::file_type::symlink;
-        break;
-      case DT_REG:
-        item.stat.st_type = filesystem::file_type::regular;
-        break;
-      case DT_SOCK:
-        item.stat.st_type = filesystem::file_type::socket;
-        break;
-      case DT_UNKNOWN:
         // Don't say we return type
         default_stat_contents = default_stat_contents & ~stat_t::want::type;
-        break;
       }
       n++;
     }
@@ -484,4 +765,595 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
   }
 }
 
+result<std::vector<result<size_t>>> directory_handle::stat_entries(span<buffer_type> entries, stat_t::want wanted, bool cached, io_multiplexer *multiplexer) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    std::vector<result<size_t>> ret;
+    ret.reserve(entries.size());
+    using zpath_type = path_view::c_str<>;
+    auto fill_using_fstatat = [&](buffer_type &entry) -> result<size_t> {
+      struct stat s
+      {
+      };
+      memset(&s, 0, sizeof(s));
+      zpath_type zpath(entry.leafname, path_view::zero_terminated);
+      if(-1 == ::fstatat(_v.fd, zpath.buffer, &s, AT_SYMLINK_NOFOLLOW))
+      {
+        return posix_error();
+      }
+      return detail::stat_from_stat(entry.stat, s, wanted);
+    };
+#ifdef __linux__
+    const unsigned mask = detail::statx_mask_from_want(wanted);
+    const int flags = AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW | (cached ? 0x4000 /*AT_STATX_DONT_SYNC*/ : 0x0000 /*AT_STATX_SYNC_AS_STAT*/);
+    if(multiplexer != nullptr && !entries.empty())
+    {
+      using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+      std::vector<detail::statx_t> bufs(entries.size());
+      std::vector<posix_fs_syscall> ops(entries.size());
+      std::vector<std::unique_ptr<zpath_type>> zpaths(entries.size());
+      for(size_t n = 0; n < entries.size(); n++)
+      {
+        zpaths[n] = std::make_unique<zpath_type>(entries[n].leafname, path_view::zero_terminated);
+        auto &op = ops[n];
+        op.op = posix_fs_syscall::kind::statx;
+        op.fd = _v.fd;
+        op.path = zpaths[n]->buffer;
+        op.flags = flags;
+        op.mode = mask;
+        op.buffer = &bufs[n];
+      }
+      OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+      for(size_t n = 0; n < entries.size(); n++)
+      {
+        if(ops[n].result >= 0)
+        {
+          ret.emplace_back(detail::stat_from_statx(entries[n].stat, bufs[n], wanted));
+        }
+        else if(-ENOSYS == ops[n].result || -EINVAL == ops[n].result)
+        {
+          // statx() may be unsupported by the kernel or the filing system
+          ret.push_back(fill_using_fstatat(entries[n]));
+        }
+        else
+        {
+          ret.push_back(result<size_t>(posix_error(-ops[n].result)));
+        }
+      }
+      return ret;
+    }
+    for(auto &entry : entries)
+    {
+      detail::statx_t s;
+      memset(&s, 0, sizeof(s));
+      zpath_type zpath(entry.leafname, path_view::zero_terminated);
+      if(detail::statx(_v.fd, zpath.buffer, flags, mask, &s) >= 0)
+      {
+        ret.emplace_back(detail::stat_from_statx(entry.stat, s, wanted));
+      }
+      else if(ENOSYS == errno || EINVAL == errno)
+      {
+        ret.push_back(fill_using_fstatat(entry));
+      }
+      else
+      {
+        ret.push_back(result<size_t>(posix_error()));
+      }
+    }
+#else
+    (void) cached;
+    (void) multiplexer;
+    for(auto &entry : entries)
+    {
+      ret.push_back(fill_using_fstatat(entry));
+    }
+#endif
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<stat_t::want>>> directory_handle::stamp_entries(span<const buffer_type> entries, stat_t::want wanted, span<const stat_t> current) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!current.empty() && current.size() != entries.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    std::vector<result<stat_t::want>> ret;
+    ret.reserve(entries.size());
+    using zpath_type = path_view::c_str<>;
+    // Filter out the flags we don't support, as stat_t::stamp() does
+    wanted &= (stat_t::want::perms | stat_t::want::uid | stat_t::want::gid | stat_t::want::atim | stat_t::want::mtim
+#ifdef HAVE_BIRTHTIMESPEC
+               | stat_t::want::birthtim
+#endif
+    );
+    for(size_t n = 0; n < entries.size(); n++)
+    {
+      const stat_t &stat = entries[n].stat;
+      stat_t::want thiswanted = wanted;
+      if(stat.st_type == filesystem::file_type::symlink)
+      {
+        thiswanted &= ~stat_t::want::perms;
+      }
+      if(!current.empty())
+      {
+        const stat_t &was = current[n];
+        if(was.st_perms == stat.st_perms)
+        {
+          thiswanted &= ~stat_t::want::perms;
+        }
+        if(was.st_uid == stat.st_uid)
+        {
+          thiswanted &= ~stat_t::want::uid;
+        }
+        if(was.st_gid == stat.st_gid)
+        {
+          thiswanted &= ~stat_t::want::gid;
+        }
+        if(was.st_atim == stat.st_atim)
+        {
+          thiswanted &= ~stat_t::want::atim;
+        }
+        if(was.st_mtim == stat.st_mtim)
+        {
+          thiswanted &= ~stat_t::want::mtim;
+        }
+        if(was.st_birthtim == stat.st_birthtim)
+        {
+          thiswanted &= ~stat_t::want::birthtim;
+        }
+      }
+      if(!thiswanted)
+      {
+        ret.emplace_back(thiswanted);
+        continue;
+      }
+      zpath_type zpath(entries[n].leafname, path_view::zero_terminated);
+      auto stamp = [&]() -> result<stat_t::want> {
+        if(thiswanted & stat_t::want::perms)
+        {
+          if(-1 == ::fchmodat(_v.fd, zpath.buffer, stat.st_perms, 0))
+          {
+            return posix_error();
+          }
+        }
+        if(thiswanted & (stat_t::want::uid | stat_t::want::gid))
+        {
+          if(-1 == ::fchownat(_v.fd, zpath.buffer, (thiswanted & stat_t::want::uid) ? stat.st_uid : -1, (thiswanted & stat_t::want::gid) ? stat.st_gid : -1,
+                              AT_SYMLINK_NOFOLLOW))
+          {
+            return posix_error();
+          }
+        }
+        if(thiswanted & (stat_t::want::atim | stat_t::want::mtim | stat_t::want::birthtim))
+        {
+          struct timespec times[2] = {{0, UTIME_OMIT}, {0, UTIME_OMIT}};
+          if(thiswanted & stat_t::want::atim)
+          {
+            times[0] = from_timepoint(stat.st_atim);
+          }
+          if(thiswanted & stat_t::want::mtim)
+          {
+            times[1] = from_timepoint(stat.st_mtim);
+          }
+          if(thiswanted & stat_t::want::birthtim)
+          {
+            // As stat_t::stamp(), setting the modified time earlier than the birth time moves the birth time
+            if(!(thiswanted & stat_t::want::mtim))
+            {
+              struct stat s;
+              if(-1 == ::fstatat(_v.fd, zpath.buffer, &s, AT_SYMLINK_NOFOLLOW))
+              {
+                return posix_error();
+              }
+#ifdef __ANDROID__
+              times[1] = *((struct timespec *) &s.st_mtime);
+#elif defined(__APPLE__)
+              times[1] = s.st_mtimespec;
+#else  // Linux and BSD
+              times[1] = s.st_mtim;
+#endif
+            }
+            struct timespec btimes[2] = {{0, UTIME_OMIT}, from_timepoint(stat.st_birthtim)};
+            if(-1 == ::utimensat(_v.fd, zpath.buffer, btimes, AT_SYMLINK_NOFOLLOW))
+            {
+              return posix_error();
+            }
+          }
+          if(-1 == ::utimensat(_v.fd, zpath.buffer, times, AT_SYMLINK_NOFOLLOW))
+          {
+            return posix_error();
+          }
+        }
+        return thiswanted;
+      };
+      ret.push_back(stamp());
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::relink_entries(span<const relink_request> entries, io_multiplexer *multiplexer) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(entries.size());
+    using zpath_type = path_view::c_str<>;
+    auto rename_flags = [](relink_kind kind) -> int {
+      switch(kind)
+      {
+      case relink_kind::replace:
+        break;
+      case relink_kind::no_replace:
+        return 1 /*RENAME_NOREPLACE*/;
+      case relink_kind::exchange:
+        return 2 /*RENAME_EXCHANGE*/;
+      }
+      return 0;
+    };
+    auto base_fd = [](const relink_request &entry) { return (entry.base != nullptr && entry.base->is_valid()) ? entry.base->native_handle().fd : AT_FDCWD; };
+    if(multiplexer == nullptr)
+    {
+      for(const auto &entry : entries)
+      {
+        zpath_type zleafname(entry.leafname, path_view::zero_terminated);
+        zpath_type zpath(entry.path, path_view::zero_terminated);
+        if(-1 == detail::renameat2(_v.fd, zleafname.buffer, base_fd(entry), zpath.buffer, (unsigned) rename_flags(entry.kind)))
+        {
+          ret.push_back(result<void>(posix_error()));
+        }
+        else
+        {
+          ret.push_back(success());
+        }
+      }
+      return ret;
+    }
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    std::vector<posix_fs_syscall> ops(entries.size());
+    std::vector<std::unique_ptr<zpath_type>> zpaths(entries.size() * 2);
+    for(size_t n = 0; n < entries.size(); n++)
+    {
+      zpaths[n * 2] = std::make_unique<zpath_type>(entries[n].leafname, path_view::zero_terminated);
+      zpaths[n * 2 + 1] = std::make_unique<zpath_type>(entries[n].path, path_view::zero_terminated);
+      auto &op = ops[n];
+      op.op = posix_fs_syscall::kind::renameat;
+      op.fd = _v.fd;
+      op.path = zpaths[n * 2]->buffer;
+      op.fd_out = base_fd(entries[n]);
+      op.buffer = (void *) zpaths[n * 2 + 1]->buffer;
+      op.flags = rename_flags(entries[n].kind);
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+    for(auto &op : ops)
+    {
+      if(op.result < 0)
+      {
+        ret.push_back(result<void>(posix_error(-op.result)));
+      }
+      else
+      {
+        ret.push_back(success());
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::unlink_entries(span<const path_view_type> leafnames, bool directories, io_multiplexer *multiplexer) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(leafnames.size());
+    using zpath_type = path_view::c_str<>;
+    const int flags = directories ? AT_REMOVEDIR : 0;
+    if(multiplexer == nullptr)
+    {
+      for(const auto &leafname : leafnames)
+      {
+        zpath_type zpath(leafname, path_view::zero_terminated);
+        if(-1 == ::unlinkat(_v.fd, zpath.buffer, flags))
+        {
+          ret.push_back(result<void>(posix_error()));
+        }
+        else
+        {
+          ret.push_back(success());
+        }
+      }
+      return ret;
+    }
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    std::vector<posix_fs_syscall> ops(leafnames.size());
+    std::vector<std::unique_ptr<zpath_type>> zpaths(leafnames.size());
+    for(size_t n = 0; n < leafnames.size(); n++)
+    {
+      zpaths[n] = std::make_unique<zpath_type>(leafnames[n], path_view::zero_terminated);
+      auto &op = ops[n];
+      op.op = posix_fs_syscall::kind::unlinkat;
+      op.fd = _v.fd;
+      op.path = zpaths[n]->buffer;
+      op.flags = flags;
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+    for(auto &op : ops)
+    {
+      if(op.result < 0)
+      {
+        ret.push_back(result<void>(posix_error(-op.result)));
+      }
+      else
+      {
+        ret.push_back(success());
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::create_entries(span<const create_request> entries, creation _creation, caching _caching,
+                                                                   io_multiplexer *multiplexer) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_caching == caching::none || _caching == caching::only_metadata)
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    native_handle_type nativeh;
+    OUTCOME_TRY(auto &&attribs, attribs_from_handle_mode_caching_and_flags(nativeh, mode::write, _creation, _caching, flag::none));
+    attribs &= ~O_NONBLOCK;
+    if(_creation == creation::always_new)
+    {
+      attribs = (attribs & ~O_EXCL) | O_TRUNC;
+    }
+    std::vector<result<void>> ret;
+    ret.reserve(entries.size());
+    using zpath_type = path_view::c_str<>;
+    // Writes whatever of the contents a short write did not, returning any errno
+    auto write_remaining = [](int fd, span<const byte> contents, size_t written) -> int {
+      while(written < contents.size())
+      {
+        auto bytes = ::pwrite(fd, contents.data() + written, contents.size() - written, (off_t) written);
+        if(bytes < 0)
+        {
+          return errno;
+        }
+        written += (size_t) bytes;
+      }
+      return 0;
+    };
+    if(multiplexer == nullptr)
+    {
+      for(const auto &entry : entries)
+      {
+        zpath_type zpath(entry.leafname, path_view::zero_terminated);
+        const int fd = ::openat(_v.fd, zpath.buffer, attribs, 0x1b0 /*660*/);
+        if(-1 == fd)
+        {
+          ret.push_back(result<void>(posix_error()));
+          continue;
+        }
+        int errcode = write_remaining(fd, entry.contents, 0);
+        if(-1 == ::close(fd) && errcode == 0)
+        {
+          errcode = errno;
+        }
+        ret.push_back((errcode != 0) ? result<void>(posix_error(errcode)) : result<void>(success()));
+      }
+      return ret;
+    }
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    std::vector<posix_fs_syscall> opens, writes, closes;
+    std::vector<std::unique_ptr<zpath_type>> zpaths;
+    std::vector<size_t> write_of;  // The index into writes for each file with contents opened, otherwise -1
+    for(size_t base = 0; base < entries.size(); base += create_entries_batch)
+    {
+      const auto batch = entries.subspan(base, std::min(create_entries_batch, entries.size() - base));
+      opens.assign(batch.size(), posix_fs_syscall());
+      zpaths.resize(batch.size());
+      for(size_t n = 0; n < batch.size(); n++)
+      {
+        zpaths[n] = std::make_unique<zpath_type>(batch[n].leafname, path_view::zero_terminated);
+        auto &op = opens[n];
+        op.op = posix_fs_syscall::kind::openat;
+        op.fd = _v.fd;
+        op.path = zpaths[n]->buffer;
+        op.flags = attribs;
+        op.mode = 0x1b0 /*660*/;
+      }
+      OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(opens));
+      // Opening and writing can't be in the same batch as the writes need the fds opened
+      writes.clear();
+      write_of.assign(batch.size(), (size_t) -1);
+      for(size_t n = 0; n < batch.size(); n++)
+      {
+        if(opens[n].result >= 0 && !batch[n].contents.empty())
+        {
+          write_of[n] = writes.size();
+          writes.emplace_back();
+          auto &op = writes.back();
+          op.op = posix_fs_syscall::kind::pwrite;
+          op.fd = opens[n].result;
+          op.buffer = (void *) batch[n].contents.data();
+          op.bytes = batch[n].contents.size();
+          op.offset = 0;
+        }
+      }
+      if(!writes.empty())
+      {
+        auto r = multiplexer->do_posix_fs_syscalls(writes);
+        if(!r)
+        {
+          // Don't leak the fds opened
+          for(auto &op : opens)
+          {
+            if(op.result >= 0)
+            {
+              ::close(op.result);
+            }
+          }
+          return std::move(r).error();
+        }
+      }
+      closes.clear();
+      for(size_t n = 0; n < batch.size(); n++)
+      {
+        if(opens[n].result >= 0)
+        {
+          if(write_of[n] != (size_t) -1 && writes[write_of[n]].result >= 0 && (size_t) writes[write_of[n]].result < batch[n].contents.size())
+          {
+            // Short writes are rare enough for the remainder to be written synchronously
+            const int errcode = write_remaining(opens[n].result, batch[n].contents, (size_t) writes[write_of[n]].result);
+            if(errcode != 0)
+            {
+              writes[write_of[n]].result = -errcode;
+            }
+          }
+          closes.emplace_back();
+          auto &op = closes.back();
+          op.op = posix_fs_syscall::kind::close;
+          op.fd = opens[n].result;
+        }
+      }
+      OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(closes));
+      for(size_t n = 0, m = 0; n < batch.size(); n++)
+      {
+        if(opens[n].result < 0)
+        {
+          ret.push_back(result<void>(posix_error(-opens[n].result)));
+          continue;
+        }
+        const int closed = closes[m++].result;
+        if(write_of[n] != (size_t) -1 && writes[write_of[n]].result < 0)
+        {
+          ret.push_back(result<void>(posix_error(-writes[write_of[n]].result)));
+        }
+        else if(closed < 0)
+        {
+          ret.push_back(result<void>(posix_error(-closed)));
+        }
+        else
+        {
+          ret.push_back(success());
+        }
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<span<directory_stream::buffer_type>> directory_stream::next(span<buffer_type> out) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(&_h);
+  stat_t::want metadata = stat_t::want::ino | stat_t::want::type;
+  const detail::compiled_glob matches(_glob.empty() ? nullptr : _glob.c_str());
+  size_t n = 0;
+  while(n < out.size())
+  {
+    if(_offset >= _bytes)
+    {
+      // Leafnames already yielded are views of the kernel buffer, so only refill it if none were
+      if(n > 0 || _done)
+      {
+        break;
+      }
+      int bytes = detail::getdents(_h.native_handle().fd, _buffer.get(), static_cast<unsigned>(_buffer_size));
+      if(bytes == -1)
+      {
+        return posix_error();
+      }
+      if(bytes == 0)
+      {
+        _done = true;
+        break;
+      }
+      LLFIO_VALGRIND_MAKE_MEM_DEFINED_IF_ADDRESSABLE(_buffer.get(), bytes);  // NOLINT
+      _first = false;
+      _offset = 0;
+      _bytes = static_cast<size_t>(bytes);
+    }
+    auto *dent = reinterpret_cast<detail::dirent_t *>(_buffer.get() + _offset);
+    _offset += dent->d_reclen;
+    if(dent->d_ino == 0u)
+    {
+      continue;
+    }
+    size_t length = strchr(dent->d_name, 0) - dent->d_name;
+    if(length <= 2 && '.' == dent->d_name[0])
+    {
+      if(1 == length || '.' == dent->d_name[1])
+      {
+        continue;
+      }
+    }
+    if(!matches(dent->d_name, length))
+    {
+      continue;
+    }
+    buffer_type &item = out[n];
+    item.leafname = path_view(dent->d_name, length, path_view::zero_terminated);
+    item.stat = stat_t(nullptr);
+    item.stat.st_ino = dent->d_ino;
+    if(!detail::d_type_to_st_type(item.stat.st_type, dent->d_type))
+    {
+      // Don't say we return type
+      metadata = metadata & ~stat_t::want::type;
+    }
+    n++;
+  }
+  _metadata = metadata;
+  return out.subspan(0, n);
+}
+
+result<void> directory_stream::restart() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(&_h);
+#ifdef __linux__
+  if(-1 == ::lseek64(_h.native_handle().fd, 0, SEEK_SET))
+  {
+    return posix_error();
+  }
+#else
+  if(-1 == ::lseek(_h.native_handle().fd, 0, SEEK_SET))
+  {
+    return posix_error();
+  }
+#endif
+  _offset = _bytes = 0;
+  _first = true;
+  _done = false;
+  return success();
+}
+
 LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,893 @@
+/* Multiplex pipe and socket i/o using epoll
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../io_handle.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#ifndef __linux__
+#error This implementation file is for Linux only
+#endif
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "import.hpp"
+
+#include "quickcpplib/signal_guard.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* epoll is a readiness based API, so unlike io_uring, i/o is always performed
+by this process using ordinary nonblocking syscalls. This makes it a reactor
+rather than a proactor, and it is only useful for handles which support readiness
+notification i.e. pipes, sockets and character devices. Regular files always report
+ready, and epoll refuses to register them.
+
+What we've thus done for this i/o multiplexer is this:
+
+- Each registered fd is added to the epoll set once, edge triggered, for both
+input and output. There is thus never any epoll_ctl() per i/o. As edge triggering
+only reports transitions, i/o is attempted until it returns EAGAIN, and only then
+does it wait for the next edge.
+
+- Initiated i/o is attempted immediately if there is no i/o of the same direction
+queued for the handle, so i/o upon a ready handle completes immediately without
+any syscalls other than the i/o itself. Otherwise it enters a queue per handle
+and direction, which is drained in order as the handle becomes ready.
+
+- Handles which epoll refuses to register (regular files) perform their i/o
+synchronously upon initiation, so such i/o always completes immediately.
+
+- Per-i/o deadlines are implemented by capping the epoll_wait() timeout to the nearest
+deadline of any queued i/o, and completing with `errc::timed_out` any queued i/o
+whose deadline has passed. Queued i/o with a deadline is kept in a list sorted by
+expiry, so neither costs anything in proportion to the i/o queued.
+
+- If check_for_any_completed_io() reaches max_completions with i/o remaining
+upon a ready handle, that handle is remembered as ready, as its edge has already
+been consumed.
+
+- `wake_check_for_any_completed_io()` writes to an eventfd, which is registered level
+triggered in the epoll set.
+*/
+template <bool is_threadsafe> class linux_epoll_multiplexer final : public io_multiplexer_impl<is_threadsafe>
+{
+  friend LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_epoll(size_t threads) noexcept;
+
+  using _base = io_multiplexer_impl<is_threadsafe>;
+  using _multiplexer_lock_guard = typename _base::_lock_guard;
+
+  using path_type = typename _base::path_type;
+  using extent_type = typename _base::extent_type;
+  using size_type = typename _base::size_type;
+  using mode = typename _base::mode;
+  using creation = typename _base::creation;
+  using caching = typename _base::caching;
+  using flag = typename _base::flag;
+  using barrier_kind = typename _base::barrier_kind;
+  using const_buffers_type = typename _base::const_buffers_type;
+  using buffers_type = typename _base::buffers_type;
+  using registered_buffer_type = typename _base::registered_buffer_type;
+  template <class T> using io_request = typename _base::template io_request<T>;
+  template <class T> using io_result = typename _base::template io_result<T>;
+  using io_operation_state = typename _base::io_operation_state;
+  using io_operation_state_visitor = typename _base::io_operation_state_visitor;
+  using check_for_any_completed_io_statistics = typename _base::check_for_any_completed_io_statistics;
+
+  // The maximum number of epoll events fetched per epoll_wait()
+  static constexpr int _max_events = 64;
+
+  struct _epoll_operation_state final : public std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>
+  {
+    using _impl = std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>;
+
+    _epoll_operation_state *prev{nullptr}, *next{nullptr};
+    // If queued with a deadline, its neighbours in the list of deadlines
+    _epoll_operation_state *deadline_prev{nullptr}, *deadline_next{nullptr};
+    // These are cached here from the handle for performance
+    int fd{-1};
+    bool is_seekable{false};
+    // If the i/o has a deadline, in which case expiry is when
+    bool has_deadline{false};
+    std::chrono::steady_clock::time_point expiry;
+
+    _epoll_operation_state() = default;
+    // Construct implicitly from the base implementation, see relocate_to()
+    explicit _epoll_operation_state(_impl &&o) noexcept
+        : _impl(std::move(o))
+    {
+    }
+    using _impl::_impl;
+
+    // You will need to reimplement this to relocate any custom state defined
+    // here, and to restamp to vptr with this finalised dynamic type. It is
+    // important to do this, as final-based optimisations compare the vptr
+    // to the finalised vptr and do non-indirect dispatch if they match.
+    virtual io_operation_state *relocate_to(byte *to_) noexcept override
+    {
+      auto *to = _impl::relocate_to(to_);
+      // restamp the vptr with my own
+      auto _to = new(to) _epoll_operation_state(std::move(*static_cast<_impl *>(to)));
+      _to->fd = fd;
+      _to->is_seekable = is_seekable;
+      _to->has_deadline = has_deadline;
+      _to->expiry = expiry;
+      return _to;
+    }
+  };
+
+  // Coroutine awaitables store the i/o state inline, falling back to blocking i/o if it does not fit
+  static_assert(sizeof(_epoll_operation_state) <= io_multiplexer::awaitable<io_result<buffers_type>>::_state_storage_bytes, "i/o state does not fit into an awaitable!");
+
+  struct _registered_fd
+  {
+    int fd{-1};  // -1 if this slot is not registered
+    bool is_seekable{false};
+    bool is_epolled{false};  // false if epoll refused the fd, in which case i/o is performed synchronously
+    bool is_ready{false};    // if in the ready list
+    struct queue_t
+    {
+      _epoll_operation_state *first{nullptr}, *last{nullptr};
+    };
+    // contains initiated i/o waiting for the handle to become ready, by direction. Barriers are writes.
+    queue_t reads, writes;
+  };
+
+  int _eventfd{-1};
+  std::vector<_registered_fd> _registered_fds;  // indexed by fd
+  std::vector<int> _ready;                      // fds which may have i/o remaining which can complete, capacity reserved at registration
+  size_t _registered{0};                        // the number of fds registered
+  size_t _queued{0};                            // the number of i/o in queues
+  detail::deadline_list<_epoll_operation_state> _deadlines;  // i/o in queues with a deadline, soonest first
+
+  static void _enqueue_to(typename _registered_fd::queue_t &queue, _epoll_operation_state *state) noexcept
+  {
+    assert(state->prev == nullptr);
+    assert(state->next == nullptr);
+    if(queue.first == nullptr)
+    {
+      queue.first = queue.last = state;
+    }
+    else
+    {
+      assert(queue.last->next == nullptr);
+      state->prev = queue.last;
+      queue.last->next = state;
+      queue.last = state;
+    }
+  }
+  static void _dequeue_from(typename _registered_fd::queue_t &queue, _epoll_operation_state *state) noexcept
+  {
+    if(state->prev == nullptr)
+    {
+      assert(queue.first == state);
+      queue.first = state->next;
+    }
+    else
+    {
+      state->prev->next = state->next;
+    }
+    if(state->next == nullptr)
+    {
+      assert(queue.last == state);
+      queue.last = state->prev;
+    }
+    else
+    {
+      state->next->prev = state->prev;
+    }
+    state->next = state->prev = nullptr;
+  }
+  typename _registered_fd::queue_t &_queue_for(_registered_fd &rfd, const _epoll_operation_state *state) noexcept
+  {
+    return (state->state == io_operation_state_type::read_initiated) ? rfd.reads : rfd.writes;
+  }
+
+  // Performs the i/o using nonblocking syscalls, returning the bytes transferred or a negative errno
+  static ssize_t _attempt(_epoll_operation_state *state) noexcept
+  {
+    ssize_t ret = -1;
+    switch(state->state)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      auto *iov = reinterpret_cast<struct iovec *>(reqs.buffers.data());
+      // We always attempt i/o without blocking first, so nowait is meaningless here
+      const int rwf = state->is_seekable ? (detail::rwf_from_io_request_flags(reqs.flags, false) & ~0x00000008 /*RWF_NOWAIT*/) : 0;
+      do
+      {
+        ret = -1;
+        if(rwf != 0)
+        {
+          ret = detail::preadv2(state->fd, iov, (int) reqs.buffers.size(), reqs.offset, rwf);
+        }
+        if(rwf == 0 || (ret < 0 && (ENOSYS == errno || EOPNOTSUPP == errno)))
+        {
+          ret = state->is_seekable ? ::preadv(state->fd, iov, (int) reqs.buffers.size(), reqs.offset) : ::readv(state->fd, iov, (int) reqs.buffers.size());
+        }
+      } while(ret < 0 && EINTR == errno);
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      auto *iov = reinterpret_cast<struct iovec *>(const_cast<typename const_buffers_type::value_type *>(reqs.buffers.data()));
+      do
+      {
+        if(state->is_seekable)
+        {
+          const int rwf = detail::rwf_from_io_request_flags(reqs.flags, true) & ~0x00000008 /*RWF_NOWAIT*/;
+          ret = -1;
+          if(rwf != 0)
+          {
+            ret = detail::pwritev2(state->fd, iov, (int) reqs.buffers.size(), reqs.offset, rwf);
+          }
+          if(rwf == 0 || (ret < 0 && (ENOSYS == errno || EOPNOTSUPP == errno)))
+          {
+            ret = ::pwritev(state->fd, iov, (int) reqs.buffers.size(), reqs.offset);
+            if(ret >= 0 && (reqs.flags & io_multiplexer::io_request_flag::data_sync) && -1 == ::fdatasync(state->fd))
+            {
+              ret = -1;
+            }
+          }
+        }
+        else
+        {
+          // Can't guarantee that user code hasn't enabled SIGPIPE
+          ret = QUICKCPPLIB_NAMESPACE::signal_guard::signal_guard(
+          QUICKCPPLIB_NAMESPACE::signal_guard::signalc_set::broken_pipe, [&] { return ::writev(state->fd, iov, (int) reqs.buffers.size()); },
+          [&](const QUICKCPPLIB_NAMESPACE::signal_guard::raised_signal_info * /*unused*/) {
+            errno = EPIPE;
+            return (ssize_t) -1;
+          });
+        }
+      } while(ret < 0 && EINTR == errno);
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.barrier.reqs;
+      const auto kind = state->payload.noncompleted.params.barrier.kind;
+      if(kind <= barrier_kind::wait_data_only)
+      {
+        // Linux has a lovely dedicated syscall giving us exactly what we need here
+        extent_type bytes = 0;
+        // empty buffers means bytes = 0 which means sync entire file
+        for(const auto &req : reqs.buffers)
+        {
+          bytes += req.size();
+        }
+        unsigned flags = SYNC_FILE_RANGE_WRITE;  // start writing all dirty pages in range now
+        if(kind == barrier_kind::wait_data_only)
+        {
+          flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;  // block until they're on storage
+        }
+        if(-1 != ::sync_file_range(state->fd, reqs.offset, bytes, flags))
+        {
+          return 0;
+        }
+      }
+      ret = (kind <= barrier_kind::wait_data_only) ? ::fdatasync(state->fd) : ::fsync(state->fd);
+      break;
+    }
+    }
+    if(ret < 0)
+    {
+      return (EWOULDBLOCK == errno) ? -EAGAIN : -errno;
+    }
+    return ret;
+  }
+
+  // Completes and finishes an i/o. Must be called WITHOUT the lock held, and the state must not be touched afterwards.
+  static void _complete(_epoll_operation_state *state, io_operation_state_type s, ssize_t res) noexcept
+  {
+    auto set_error = [&](auto &ret) { ret = posix_error((int) -res); };
+    auto trim = [res](auto &buffers) {
+      size_t bytes = (size_t) res;
+      for(size_t i = 0; i < buffers.size(); i++)
+      {
+        auto &buffer = buffers[i];
+        if(buffer.size() <= bytes)
+        {
+          bytes -= buffer.size();
+        }
+        else
+        {
+          buffer = {buffer.data(), (size_type) bytes};
+          buffers = {buffers.data(), i + 1};
+          break;
+        }
+      }
+    };
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      io_result<buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->read_completed(std::move(ret));
+      state->read_finished();
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->write_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.barrier.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      state->barrier_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    }
+  }
+
+  // Removes a queued i/o, and completes it. Must be called with the lock held, which is released during completion.
+  void _dequeue_and_complete(_multiplexer_lock_guard &g, typename _registered_fd::queue_t &queue, _epoll_operation_state *state, ssize_t res) noexcept
+  {
+    _dequeue_from(queue, state);
+    --_queued;
+    if(state->has_deadline)
+    {
+      _deadlines.remove(state);
+    }
+    const auto s = state->state;
+    g.unlock();
+    _complete(state, s, res);
+    g.lock();
+  }
+
+  /* Performs queued i/o upon a fd until it would block, for up to max_completions.
+  Returns the number completed. Must be called with the lock held, which is released
+  during completions.
+  */
+  size_t _process(_multiplexer_lock_guard &g, int fd, size_t max_completions) noexcept
+  {
+    size_t count = 0;
+    bool remaining = false;
+    for(bool reads : {true, false})
+    {
+      for(;;)
+      {
+        // Refetch each time, as the table may be resized while unlocked
+        auto &rfd = _registered_fds[fd];
+        auto &queue = reads ? rfd.reads : rfd.writes;
+        if(queue.first == nullptr)
+        {
+          break;
+        }
+        if(count >= max_completions)
+        {
+          remaining = true;
+          break;
+        }
+        auto *state = queue.first;
+        const ssize_t res = _attempt(state);
+        if(-EAGAIN == res)
+        {
+          break;
+        }
+        _dequeue_and_complete(g, queue, state, res);
+        ++count;
+      }
+    }
+    auto &rfd = _registered_fds[fd];
+    if(remaining && !rfd.is_ready)
+    {
+      // Capacity was reserved during registration, so this never allocates
+      _ready.push_back(fd);
+      rfd.is_ready = true;
+    }
+    return count;
+  }
+
+  // Completes any queued i/o whose deadline has passed, and returns the nearest deadline remaining
+  size_t _expire(_multiplexer_lock_guard &g, size_t max_completions, std::chrono::steady_clock::time_point &nearest) noexcept
+  {
+    size_t count = 0;
+    nearest = std::chrono::steady_clock::time_point::max();
+    if(_deadlines.empty())
+    {
+      return count;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    // The list may have changed whilst unlocked, so refetch its front each time
+    while(_deadlines.first != nullptr && _deadlines.first->expiry <= now && count < max_completions)
+    {
+      auto *state = _deadlines.first;
+      _dequeue_and_complete(g, _queue_for(_registered_fds[state->fd], state), state, -ETIMEDOUT);
+      ++count;
+    }
+    if(_deadlines.first != nullptr)
+    {
+      nearest = _deadlines.first->expiry;
+    }
+    return count;
+  }
+
+public:
+  linux_epoll_multiplexer() = default;
+  linux_epoll_multiplexer(const linux_epoll_multiplexer &) = delete;
+  linux_epoll_multiplexer(linux_epoll_multiplexer &&) = delete;
+  linux_epoll_multiplexer &operator=(const linux_epoll_multiplexer &) = delete;
+  linux_epoll_multiplexer &operator=(linux_epoll_multiplexer &&) = delete;
+  virtual ~linux_epoll_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) linux_epoll_multiplexer::close();
+    }
+  }
+  result<void> init()
+  {
+    this->_v.fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if(-1 == this->_v.fd)
+    {
+      return posix_error();
+    }
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    _eventfd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(-1 == _eventfd)
+    {
+      return posix_error();
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;  // level triggered
+    ev.data.fd = _eventfd;
+    if(-1 == ::epoll_ctl(this->_v.fd, EPOLL_CTL_ADD, _eventfd, &ev))
+    {
+      return posix_error();
+    }
+    _registered_fds.reserve(64);
+    return success();
+  }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    this->_stop_posix_lock_waiter();
+    _multiplexer_lock_guard g(this->_lock);
+    if(_queued > 0)
+    {
+      // Can't close a multiplexer with i/o in progress
+      return errc::operation_in_progress;
+    }
+    if(_eventfd != -1)
+    {
+      ::close(_eventfd);
+      _eventfd = -1;
+    }
+    OUTCOME_TRY(_base::close());
+    _registered_fds.clear();
+    _ready.clear();
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0)
+    {
+      return errc::bad_file_descriptor;
+    }
+    try
+    {
+      if((size_t) fd >= _registered_fds.size())
+      {
+        _registered_fds.resize(fd + 1);
+      }
+      _ready.reserve(_registered + 1);
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    auto &rfd = _registered_fds[fd];
+    if(rfd.fd != -1)
+    {
+      return errc::device_or_resource_busy;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    bool is_epolled = true;
+    if(-1 == ::epoll_ctl(this->_v.fd, EPOLL_CTL_ADD, fd, &ev))
+    {
+      if(EPERM != errno)
+      {
+        return posix_error();
+      }
+      // This fd does not support readiness notification, it is always ready
+      is_epolled = false;
+    }
+    rfd = _registered_fd();
+    rfd.fd = fd;
+    rfd.is_seekable = h->is_seekable();
+    rfd.is_epolled = is_epolled;
+    ++_registered;
+    return (uint8_t) 0;
+  }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0 || (size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd != fd)
+    {
+      return errc::invalid_argument;
+    }
+    auto &rfd = _registered_fds[fd];
+    assert(rfd.reads.first == nullptr && rfd.writes.first == nullptr);
+    if(rfd.reads.first != nullptr || rfd.writes.first != nullptr)
+    {
+      // Can't deregister a handle with i/o in progress
+      return errc::operation_in_progress;
+    }
+    if(rfd.is_epolled)
+    {
+      struct epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      if(-1 == ::epoll_ctl(this->_v.fd, EPOLL_CTL_DEL, fd, &ev))
+      {
+        return posix_error();
+      }
+    }
+    if(rfd.is_ready)
+    {
+      _ready.erase(std::find(_ready.begin(), _ready.end(), fd));
+    }
+    --_registered;
+    rfd = _registered_fd();
+    return success();
+  }
+
+  virtual size_t do_io_handle_max_buffers(const io_handle * /*unused*/) const noexcept override { return IOV_MAX; }
+  // virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return {sizeof(_epoll_operation_state), alignof(_epoll_operation_state)}; }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_epoll_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_epoll_operation_state)) == 0);
+    if(storage.size() < sizeof(_epoll_operation_state) || ((uintptr_t) storage.data() % alignof(_epoll_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _epoll_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_epoll_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_epoll_operation_state)) == 0);
+    if(storage.size() < sizeof(_epoll_operation_state) || ((uintptr_t) storage.data() % alignof(_epoll_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _epoll_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    assert(storage.size() >= sizeof(_epoll_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_epoll_operation_state)) == 0);
+    if(storage.size() < sizeof(_epoll_operation_state) || ((uintptr_t) storage.data() % alignof(_epoll_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _epoll_operation_state(_h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+
+  virtual io_operation_state_type init_io_operation(io_operation_state *_op) noexcept override
+  {
+    auto *state = static_cast<_epoll_operation_state *>(_op);
+    auto s = state->current_state();  // read the current state, holding the state's lock
+    if(!is_initialised(s))
+    {
+      assert(false);
+      return s;
+    }
+    state->fd = state->h->native_handle().fd;
+    state->is_seekable = state->h->is_seekable();
+    const deadline d = state->payload.noncompleted.d;
+    if(d)
+    {
+      state->has_deadline = true;
+      if(d.steady)
+      {
+        state->expiry = std::chrono::steady_clock::now() + std::chrono::nanoseconds(d.nsecs);
+      }
+      else
+      {
+        state->expiry = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d.to_time_point() - std::chrono::system_clock::now());
+      }
+    }
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initialised:
+      state->read_initiated();
+      break;
+    case io_operation_state_type::write_initialised:
+      state->write_initiated();
+      break;
+    case io_operation_state_type::barrier_initialised:
+      if(state->h->is_pipe() || state->h->is_socket())
+      {
+        // Nothing to flush, so complete immediately
+        state->barrier_completed(io_result<const_buffers_type>(const_buffers_type()));
+        state->write_or_barrier_finished();
+        return io_operation_state_type::write_or_barrier_finished;
+      }
+      state->barrier_initiated();
+      break;
+    }
+    _multiplexer_lock_guard g(this->_lock);
+    if(state->fd < 0 || (size_t) state->fd >= _registered_fds.size() || _registered_fds[state->fd].fd != state->fd)
+    {
+      // Handle has not been registered with this multiplexer
+      assert(false);
+      g.unlock();
+      _complete(state, state->current_state(), -EBADF);
+      return state->current_state();
+    }
+    auto &rfd = _registered_fds[state->fd];
+    auto &queue = _queue_for(rfd, state);
+    if(queue.first == nullptr)
+    {
+      // Nothing ahead of us, so try the i/o immediately
+      const ssize_t res = _attempt(state);
+      if(-EAGAIN != res || !rfd.is_epolled || (state->has_deadline && state->expiry <= std::chrono::steady_clock::now()))
+      {
+        const auto ns = state->state;
+        g.unlock();
+        _complete(state, ns, (-EAGAIN == res && state->has_deadline) ? -ETIMEDOUT : res);
+        return state->current_state();
+      }
+    }
+    _enqueue_to(queue, state);
+    ++_queued;
+    if(state->has_deadline)
+    {
+      _deadlines.insert(state);
+    }
+    return state->state;
+  }
+
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+
+  // i/o is always attempted upon initiation, so there is nothing to flush
+  virtual result<void> flush_inited_io_operations() noexcept override { return success(); }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *_op) noexcept override
+  {
+    auto *state = static_cast<_epoll_operation_state *>(_op);
+    const auto s = state->current_state();
+    if(is_initiated(s) && !is_completed(s) && !is_finished(s))
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      _process(g, state->fd, (size_t) -1);
+    }
+    return _op->current_state();
+  }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *_op, deadline /*unused*/ = {}) noexcept override
+  {
+    auto *state = static_cast<_epoll_operation_state *>(_op);
+    _multiplexer_lock_guard g(this->_lock);
+    const auto s = state->current_state();
+    if(!is_initiated(s) || is_completed(s) || is_finished(s))
+    {
+      return s;
+    }
+    // i/o is only ever queued, never in progress, so it can always be cancelled immediately
+    auto &queue = _queue_for(_registered_fds[state->fd], state);
+    _dequeue_and_complete(g, queue, state, -ECANCELED);
+    return state->current_state();
+  }
+
+  // This must check all i/o initiated or completed on this i/o multiplexer
+  // and invoke state transition from initiated to completed/finished, or from
+  // completed to finished, for no more than max_completions i/o states.
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0), size_t max_completions = (size_t) -1) noexcept override
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    check_for_any_completed_io_statistics ret;
+    for(;;)
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      size_t count = 0;
+      // Handles which had i/o remaining when last we hit max_completions
+      while(!_ready.empty() && count < max_completions)
+      {
+        const int fd = _ready.back();
+        _ready.pop_back();
+        _registered_fds[fd].is_ready = false;
+        count += _process(g, fd, max_completions - count);
+      }
+      std::chrono::steady_clock::time_point nearest;
+      count += _expire(g, max_completions - count, nearest);
+      if(count > 0)
+      {
+        ret.initiated_ios_finished += count;
+        return ret;
+      }
+      // Nothing completed, so wait for the handles to become ready
+      std::chrono::milliseconds timeout(-1);
+      if(d)
+      {
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(timeout, d);
+      }
+      if(nearest != std::chrono::steady_clock::time_point::max())
+      {
+        // Round up to the next millisecond, so we don't spin
+        auto untilnearest = std::chrono::duration_cast<std::chrono::milliseconds>(nearest - std::chrono::steady_clock::now() + std::chrono::microseconds(999));
+        if(untilnearest.count() < 0)
+        {
+          untilnearest = std::chrono::milliseconds(0);
+        }
+        if(timeout.count() < 0 || untilnearest < timeout)
+        {
+          timeout = untilnearest;
+        }
+      }
+      g.unlock();
+      struct epoll_event events[_max_events];
+      int nevents = ::epoll_wait(this->_v.fd, events, _max_events, (int) timeout.count());
+      if(nevents < 0)
+      {
+        if(EINTR == errno)
+        {
+          continue;
+        }
+        return posix_error();
+      }
+      g.lock();
+      bool woken = false;
+      for(int n = 0; n < nevents; n++)
+      {
+        const int fd = events[n].data.fd;
+        if(fd == _eventfd)
+        {
+          uint64_t v;
+          (void) ::read(_eventfd, &v, sizeof(v));
+          woken = true;
+          continue;
+        }
+        if((size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd != fd)
+        {
+          // Deregistered since the event was raised
+          continue;
+        }
+        if(count >= max_completions)
+        {
+          // The edge has been consumed, so remember this handle is ready
+          auto &rfd = _registered_fds[fd];
+          if(!rfd.is_ready && (rfd.reads.first != nullptr || rfd.writes.first != nullptr))
+          {
+            _ready.push_back(fd);
+            rfd.is_ready = true;
+          }
+          continue;
+        }
+        count += _process(g, fd, max_completions - count);
+      }
+      if(count > 0 || woken)
+      {
+        ret.initiated_ios_finished += count;
+        return ret;
+      }
+      if(d)
+      {
+        // i/o deadlines are handled at the top of the loop, but we must also honour our own
+        std::chrono::milliseconds remaining;
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(remaining, d);
+        if(remaining.count() == 0)
+        {
+          // Timed out
+          return ret;
+        }
+      }
+    }
+  }
+
+  // This can be used from any kernel thread to cause a check_for_any_completed_io()
+  // running in another kernel thread to return early
+  virtual result<void> wake_check_for_any_completed_io() noexcept override
+  {
+    const uint64_t v = 1;
+    if(-1 == ::write(_eventfd, &v, sizeof(v)))
+    {
+      return posix_error();
+    }
+    return success();
+  }
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_epoll(size_t threads) noexcept
+{
+  try
+  {
+    if(1 == threads)
+    {
+      // Make non locking edition
+      auto ret = std::make_unique<linux_epoll_multiplexer<false>>();
+      OUTCOME_TRY(ret->init());
+      return io_multiplexer_ptr(ret.release());
+    }
+    auto ret = std::make_unique<linux_epoll_multiplexer<true>>();
+    OUTCOME_TRY(ret->init());
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -33,6 +33,7 @@ Distributed under the Boost Software License, Version 1.0.
 #endif
 
 #ifdef __linux__
+#include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <sys/sysmacros.h>
 #endif
@@ -41,6 +42,219 @@ Distributed under the Boost Software License, Version 1.0.
 
 LLFIO_V2_NAMESPACE_BEGIN
 
+namespace detail
+{
+  // What file_handle::file() does after the file has been opened
+  inline result<void> file_handle_after_open(const file_handle &fh, file_handle::creation _creation, file_handle::flag flags) noexcept
+  {
+    if((flags & file_handle::flag::disable_prefetching) || (flags & file_handle::flag::maximum_prefetching))
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+      int advice = (flags & file_handle::flag::disable_prefetching) ? POSIX_FADV_RANDOM : (POSIX_FADV_SEQUENTIAL | POSIX_FADV_WILLNEED);
+      if(-1 == ::posix_fadvise(fh.native_handle().fd, 0, 0, advice))
+      {
+        return posix_error();
+      }
+#elif __APPLE__
+      int advice = (flags & file_handle::flag::disable_prefetching) ? 0 : 1;
+      if(-1 == ::fcntl(fh.native_handle().fd, F_RDAHEAD, advice))
+      {
+        return posix_error();
+      }
+#endif
+    }
+    if(_creation == file_handle::creation::truncate_existing && fh.are_safety_barriers_issued())
+    {
+      fsync(fh.native_handle().fd);
+    }
+    return success();
+  }
+
+  // Enumerates valid extents using SEEK_DATA and SEEK_HOLE, two syscalls per extent
+  inline result<std::vector<file_handle::extent_pair>> file_handle_seek_extents(const file_handle &fh)
+  {
+    std::vector<file_handle::extent_pair> out;
+    out.reserve(64);
+    file_handle::extent_type start = 0, end = 0;
+    for(;;)
+    {
+#ifdef __linux__
+#ifndef SEEK_DATA
+      errno = EINVAL;
+      break;
+#else
+      start = lseek64(fh.native_handle().fd, end, SEEK_DATA);
+      if(static_cast<file_handle::extent_type>(-1) == start)
+      {
+        break;
+      }
+      end = lseek64(fh.native_handle().fd, start, SEEK_HOLE);
+      if(static_cast<file_handle::extent_type>(-1) == end)
+      {
+        break;
+      }
+#endif
+#elif defined(__APPLE__)
+      // Can't find any support for extent enumeration in OS X
+      errno = EINVAL;
+      break;
+#elif defined(__FreeBSD__)
+      start = lseek(fh.native_handle().fd, end, SEEK_DATA);
+      if((file_handle::extent_type) -1 == start)
+        break;
+      end = lseek(fh.native_handle().fd, start, SEEK_HOLE);
+      if((file_handle::extent_type) -1 == end)
+        break;
+#else
+#error Unknown system
+#endif
+      // Data region may have been concurrently deleted
+      if(end > start)
+      {
+        out.emplace_back(start, end - start);
+      }
+    }
+    if(ENXIO != errno)
+    {
+      if(EINVAL == errno)
+      {
+        // If it failed with no output, probably this filing system doesn't support extents
+        if(out.empty())
+        {
+          OUTCOME_TRY(auto &&size, fh.file_handle::maximum_extent());
+          out.emplace_back(0, size);
+          return out;
+        }
+      }
+      else
+      {
+        return posix_error();
+      }
+    }
+    return out;
+  }
+
+#ifdef __linux__
+  // Fetches the extent map using FIEMAP, returning false if the filing system does not support it
+  inline result<bool> file_handle_fiemap(const file_handle &fh, std::vector<file_handle::extent_info> &out)
+  {
+    // If this were Linux 2.6.28 or later only, could include <linux/fiemap.h> for these
+    struct fiemap_extent
+    {
+      uint64_t fe_logical;
+      uint64_t fe_physical;
+      uint64_t fe_length;
+      uint64_t fe_reserved64[2];
+      uint32_t fe_flags;
+      uint32_t fe_reserved[3];
+    };
+    struct fiemap
+    {
+      uint64_t fm_start;
+      uint64_t fm_length;
+      uint32_t fm_flags;
+      uint32_t fm_mapped_extents;
+      uint32_t fm_extent_count;
+      uint32_t fm_reserved;
+    };
+    static_assert(sizeof(fiemap_extent) == 56, "fiemap_extent is not the size the kernel expects!");
+    static_assert(sizeof(fiemap) == 32, "fiemap is not the size the kernel expects!");
+    static constexpr uint32_t batch = 256;
+    std::vector<uint64_t> buffer((sizeof(fiemap) + batch * sizeof(fiemap_extent)) / sizeof(uint64_t));
+    auto *fm = reinterpret_cast<fiemap *>(buffer.data());
+    auto *fe = reinterpret_cast<fiemap_extent *>(fm + 1);
+    OUTCOME_TRY(auto &&length, fh.file_handle::maximum_extent());
+    out.clear();
+    file_handle::extent_type start = 0;
+    bool last = false;
+    while(!last && start < length)
+    {
+      memset(fm, 0, sizeof(fiemap));
+      fm->fm_start = start;
+      fm->fm_length = length - start;
+      fm->fm_extent_count = batch;
+      if(-1 == ::ioctl(fh.native_handle().fd, 0xc020660b /*FS_IOC_FIEMAP*/, fm))
+      {
+        if(out.empty() && (EOPNOTSUPP == errno || ENOTTY == errno || EBADR == errno || EINVAL == errno))
+        {
+          return false;
+        }
+        return posix_error();
+      }
+      if(fm->fm_mapped_extents == 0)
+      {
+        break;
+      }
+      for(uint32_t n = 0; n < fm->fm_mapped_extents; n++)
+      {
+        const fiemap_extent &e = fe[n];
+        start = e.fe_logical + e.fe_length;
+        if((e.fe_flags & 0x1 /*FIEMAP_EXTENT_LAST*/) != 0 || start >= length)
+        {
+          last = true;
+        }
+        if(e.fe_logical >= length)
+        {
+          // Preallocated beyond the end of the file
+          continue;
+        }
+        file_handle::extent_flag flags = file_handle::extent_flag::none;
+        if((e.fe_flags & 0x2 /*FIEMAP_EXTENT_UNKNOWN*/) != 0)
+        {
+          flags |= file_handle::extent_flag::unknown_location;
+        }
+        if((e.fe_flags & 0x4 /*FIEMAP_EXTENT_DELALLOC*/) != 0)
+        {
+          flags |= file_handle::extent_flag::delayed_allocation | file_handle::extent_flag::unknown_location;
+        }
+        if((e.fe_flags & (0x8 /*FIEMAP_EXTENT_ENCODED*/ | 0x80 /*FIEMAP_EXTENT_DATA_ENCRYPTED*/)) != 0)
+        {
+          flags |= file_handle::extent_flag::encoded;
+        }
+        if((e.fe_flags & 0x200 /*FIEMAP_EXTENT_DATA_INLINE*/) != 0)
+        {
+          flags |= file_handle::extent_flag::inline_data;
+        }
+        if((e.fe_flags & 0x800 /*FIEMAP_EXTENT_UNWRITTEN*/) != 0)
+        {
+          flags |= file_handle::extent_flag::unwritten;
+        }
+        if((e.fe_flags & 0x2000 /*FIEMAP_EXTENT_SHARED*/) != 0)
+        {
+          flags |= file_handle::extent_flag::shared;
+        }
+        const auto extentlength = std::min<file_handle::extent_type>(e.fe_length, length - e.fe_logical);
+        out.emplace_back(e.fe_logical, extentlength, (flags & file_handle::extent_flag::unknown_location) ? (file_handle::extent_type) -1 : e.fe_physical, flags);
+      }
+    }
+    if(!out.empty())
+    {
+      out.back().flags |= file_handle::extent_flag::last;
+    }
+    return true;
+  }
+#endif
+
+  // Coalesces an extent map into a list of contiguous valid extents
+  inline std::vector<file_handle::extent_pair> file_handle_coalesce_extents(const std::vector<file_handle::extent_info> &map)
+  {
+    std::vector<file_handle::extent_pair> out;
+    out.reserve(map.size());
+    for(const auto &e : map)
+    {
+      if(!out.empty() && out.back().offset + out.back().length == e.offset)
+      {
+        out.back().length += e.length;
+      }
+      else
+      {
+        out.emplace_back(e.offset, e.length);
+      }
+    }
+    return out;
+  }
+}  // namespace detail
+
 result<file_handle> file_handle::file(const path_handle &base, file_handle::path_view_type path, file_handle::mode _mode, file_handle::creation _creation,
                                       file_handle::caching _caching, file_handle::flag flags) noexcept
 {
@@ -90,30 +304,144 @@ result<file_handle> file_handle::file(const path_handle &base, file_handle::path
     }
     return posix_error();
   }
-  if((flags & flag::disable_prefetching) || (flags & flag::maximum_prefetching))
+  OUTCOME_TRY(detail::file_handle_after_open(ret.value(), _creation, flags));
+  return ret;
+}
+
+result<std::vector<result<file_handle>>> file_handle::files(const path_handle &base, span<const path_view_type> paths, mode _mode, creation _creation,
+                                                            caching _caching, flag flags, io_multiplexer *multiplexer) noexcept
+{
+  try
   {
-#ifdef POSIX_FADV_SEQUENTIAL
-    int advice = (flags & flag::disable_prefetching) ? POSIX_FADV_RANDOM : (POSIX_FADV_SEQUENTIAL | POSIX_FADV_WILLNEED);
-    if(-1 == ::posix_fadvise(nativeh.fd, 0, 0, advice))
+    std::vector<result<file_handle>> ret;
+    ret.reserve(paths.size());
+    if(multiplexer == nullptr)
     {
-      return posix_error();
+      for(const auto &path : paths)
+      {
+        ret.push_back(file(base, path, _mode, _creation, _caching, flags));
+      }
+      return ret;
     }
-#elif __APPLE__
-    int advice = (flags & flag::disable_prefetching) ? 0 : 1;
-    if(-1 == ::fcntl(nativeh.fd, F_RDAHEAD, advice))
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    using zpath_type = path_view::c_str<>;
+    std::vector<posix_fs_syscall> ops(paths.size());
+    std::vector<std::unique_ptr<zpath_type>> zpaths(paths.size());
+    for(size_t n = 0; n < paths.size(); n++)
     {
-      return posix_error();
+      ret.push_back(file_handle(native_handle_type(), 0, 0, _caching, flags, nullptr));
+      native_handle_type &nativeh = ret.back().value()._v;
+      nativeh.behaviour |= native_handle_type::disposition::file;
+      auto attribs = attribs_from_handle_mode_caching_and_flags(nativeh, _mode, _creation, _caching, flags);
+      if(!attribs)
+      {
+        ret.back() = result<file_handle>(std::move(attribs).error());
+        ops[n].op = posix_fs_syscall::kind::openat;
+        ops[n].fd = -1;
+        continue;
+      }
+      nativeh.behaviour &= ~native_handle_type::disposition::nonblocking;
+      zpaths[n] = std::make_unique<zpath_type>(paths[n], path_view::zero_terminated);
+      ops[n].op = posix_fs_syscall::kind::openat;
+      ops[n].fd = base.is_valid() ? base.native_handle().fd : AT_FDCWD;
+      ops[n].path = zpaths[n]->buffer;
+      ops[n].flags = attribs.value() & ~O_NONBLOCK;
+      ops[n].mode = 0x1b0 /*660*/;
     }
-#endif
+    // Open all the paths whose attributes could be calculated
+    size_t valid = 0;
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      if(ret[n])
+      {
+        std::swap(ops[valid++], ops[n]);
+      }
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls({ops.data(), valid}));
+    for(size_t n = 0, idx = 0; n < paths.size(); n++)
+    {
+      if(!ret[n])
+      {
+        continue;
+      }
+      const auto &op = ops[idx++];
+      if(op.result < 0)
+      {
+        if(-EEXIST == op.result && (mode::write == _mode || mode::append == _mode) && creation::always_new == _creation)
+        {
+          // file() knows how to atomically replace an existing file
+          ret[n] = file(base, paths[n], _mode, _creation, _caching, flags);
+        }
+        else
+        {
+          ret[n] = result<file_handle>(posix_error(-op.result));
+        }
+        continue;
+      }
+      ret[n].value()._v.fd = op.result;
+      auto r = detail::file_handle_after_open(ret[n].value(), _creation, flags);
+      if(!r)
+      {
+        ret[n] = result<file_handle>(std::move(r).error());
+      }
+    }
+    return ret;
   }
-  if(_creation == creation::truncate_existing && ret.value().are_safety_barriers_issued())
+  catch(...)
   {
-    fsync(nativeh.fd);
+    return error_from_exception();
   }
-  return ret;
 }
 
-result<file_handle> file_handle::temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept
+result<std::vector<result<void>>> file_handle::close_files(span<file_handle> fhs, io_multiplexer *multiplexer) noexcept
+{
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(fhs.size());
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    std::vector<posix_fs_syscall> ops;
+    std::vector<size_t> idxs;
+    for(auto &fh : fhs)
+    {
+      ret.push_back(success());
+      const bool simple = fh.is_valid() && !(fh.flags() & flag::unlink_on_first_close) && fh.multiplexer() == nullptr &&
+                          !(fh.are_safety_barriers_issued() && fh.is_writable());
+      if(multiplexer == nullptr || !simple)
+      {
+        ret.back() = fh.close();
+        continue;
+      }
+      posix_fs_syscall op;
+      op.op = posix_fs_syscall::kind::close;
+      op.fd = fh.native_handle().fd;
+      ops.push_back(op);
+      idxs.push_back(ret.size() - 1);
+    }
+    if(ops.empty())
+    {
+      return ret;
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+    for(size_t n = 0; n < ops.size(); n++)
+    {
+      auto &fh = fhs[idxs[n]];
+      // Like close(), the fd is gone whether or not it succeeded
+      (void) fh.release();
+      if(ops[n].result < 0)
+      {
+        ret[idxs[n]] = result<void>(posix_error(-ops[n].result));
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<file_handle> file_handle::_temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept
 {
   caching _caching = caching::temporary;
   // No need to check inode before unlink
@@ -267,7 +595,7 @@ result<file_handle> file_handle::reopen(mode mode_, caching caching_, deadline d
   {
     if(d.steady)
     {
-      began_steady = std::chrono::steady_clock::now();
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
     }
     else
     {
@@ -304,7 +632,7 @@ result<file_handle> file_handle::reopen(mode mode_, caching caching_, deadline d
     {
       if(d.steady)
       {
-        if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
+        if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
         {
           return errc::timed_out;
         }
@@ -337,6 +665,7 @@ result<file_handle::extent_type> file_handle::maximum_extent() const noexcept
 result<file_handle::extent_type> file_handle::truncate(file_handle::extent_type newsize) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  _invalidate_extent_map();
   if(ftruncate(_v.fd, newsize) < 0)
   {
     return posix_error();
@@ -353,78 +682,76 @@ result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexc
   LLFIO_LOG_FUNCTION_CALL(this);
   try
   {
-    std::vector<file_handle::extent_pair> out;
-    out.reserve(64);
-    extent_type start = 0, end = 0;
-    for(;;)
+    if(_extent_cache != nullptr)
     {
+      OUTCOME_TRY(auto &&map, extent_map());
+      return detail::file_handle_coalesce_extents(map);
+    }
 #ifdef __linux__
-#ifndef SEEK_DATA
-      errno = EINVAL;
-      break;
-#else
-      start = lseek64(_v.fd, end, SEEK_DATA);
-      if(static_cast<extent_type>(-1) == start)
-      {
-        break;
-      }
-      end = lseek64(_v.fd, start, SEEK_HOLE);
-      if(static_cast<extent_type>(-1) == end)
+    {
+      std::vector<extent_info> map;
+      OUTCOME_TRY(auto &&supported, detail::file_handle_fiemap(*this, map));
+      if(supported)
       {
-        break;
+        return detail::file_handle_coalesce_extents(map);
       }
+    }
 #endif
-#elif defined(__APPLE__)
-      // Can't find any support for extent enumeration in OS X
-      errno = EINVAL;
-      break;
-#elif defined(__FreeBSD__)
-      start = lseek(_v.fd, end, SEEK_DATA);
-      if((extent_type) -1 == start)
-        break;
-      end = lseek(_v.fd, start, SEEK_HOLE);
-      if((extent_type) -1 == end)
-        break;
-#else
-#error Unknown system
-#endif
-      // Data region may have been concurrently deleted
-      if(end > start)
+    return detail::file_handle_seek_extents(*this);
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<file_handle::extent_info>> file_handle::extent_map() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    uint64_t generation = 0;
+    if(_extent_cache != nullptr)
+    {
+      lock_guard<spinlock> g(_extent_cache->lock);
+      if(_extent_cache->valid)
       {
-        out.emplace_back(start, end - start);
+        return _extent_cache->map;
       }
+      generation = _extent_cache->generation;
     }
-    if(ENXIO != errno)
+    std::vector<extent_info> out;
+    bool supported = false;
+#ifdef __linux__
     {
-      if(EINVAL == errno)
+      OUTCOME_TRY(auto &&_supported, detail::file_handle_fiemap(*this, out));
+      supported = _supported;
+    }
+#endif
+    if(!supported)
+    {
+      OUTCOME_TRY(auto &&extents, detail::file_handle_seek_extents(*this));
+      out.clear();
+      out.reserve(extents.size());
+      for(const auto &e : extents)
       {
-        // If it failed with no output, probably this filing system doesn't support extents
-        if(out.empty())
-        {
-          OUTCOME_TRY(auto &&size, file_handle::maximum_extent());
-          out.emplace_back(0, size);
-          return out;
-        }
+        out.emplace_back(e.offset, e.length);
       }
-      else
+      if(!out.empty())
       {
-        return posix_error();
+        out.back().flags |= extent_flag::last;
+      }
+    }
+    if(_extent_cache != nullptr)
+    {
+      lock_guard<spinlock> g(_extent_cache->lock);
+      // Only cache if nothing invalidated the map while we were fetching it
+      if(_extent_cache->generation == generation)
+      {
+        _extent_cache->map = out;
+        _extent_cache->valid = true;
       }
     }
-#if 0
-  // A problem with SEEK_DATA and SEEK_HOLE is that they are racy under concurrent extents changing
-  // Coalesce sequences of contiguous data e.g. 0, 64; 64, 64; 128, 64 ...
-  std::vector<std::pair<extent_type, extent_type>> outfixed; outfixed.reserve(out.size());
-  outfixed.push_back(out.front());
-  for (size_t n = 1; n<out.size(); n++)
-  {
-    if (outfixed.back().first + outfixed.back().second == out[n].first)
-      outfixed.back().second += out[n].second;
-    else
-      outfixed.push_back(out[n]);
-  }
-  return outfixed;
-#endif
     return out;
   }
   catch(...)
@@ -433,6 +760,28 @@ result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexc
   }
 }
 
+result<void> file_handle::set_extent_map_caching(bool enable) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    if(enable && _extent_cache == nullptr)
+    {
+      _extent_cache = new _extent_map_cache;
+    }
+    else if(!enable)
+    {
+      delete _extent_cache;
+      _extent_cache = nullptr;
+    }
+    return success();
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::extent_pair extent, io_handle &dest_, io_handle::extent_type destoffset, deadline d,
                                                                bool force_copy_now, bool emulate_if_unsupported) noexcept
 {
@@ -474,7 +823,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
     byte *buffer = nullptr;
     auto unbufferh = make_scope_exit([&]() noexcept {
       if(buffer != nullptr)
-        utils::page_allocator<byte>().deallocate(buffer, blocksize);
+        utils::pooled_page_allocator<byte>().deallocate(buffer, blocksize);
     });
     (void) unbufferh;
     extent_pair ret(extent.offset, 0);
@@ -532,7 +881,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
         return ret;
       }
 #endif
-      buffer = utils::page_allocator<byte>().allocate(blocksize);
+      buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
       while(extent.length > 0)
       {
         deadline nd;
@@ -571,6 +920,37 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
     std::vector<workitem> todo;  // if destination length is 0, punch hole
     todo.reserve(8);
     // Firstly fill todo with the list of allocated and non-allocated extents
+    if(_extent_cache != nullptr)
+    {
+      // Use the cached extent map rather than rescanning
+      OUTCOME_TRY(auto &&map, extent_map());
+      extent_type cursor = extent.offset;
+      const extent_type finish = extent.offset + extent.length;
+      for(const auto &e : detail::file_handle_coalesce_extents(map))
+      {
+        if(e.offset + e.length <= cursor)
+        {
+          continue;
+        }
+        if(e.offset >= finish)
+        {
+          break;
+        }
+        if(e.offset > cursor)
+        {
+          todo.push_back(workitem{extent_pair(cursor, e.offset - cursor), workitem::delete_extents});
+          cursor = e.offset;
+        }
+        const auto clampedend = std::min(e.offset + e.length, finish);
+        todo.push_back(workitem{extent_pair(cursor, clampedend - cursor), workitem::clone_extents});
+        cursor = clampedend;
+      }
+      if(!todo.empty() && cursor < finish)
+      {
+        todo.push_back(workitem{extent_pair(cursor, finish - cursor), workitem::delete_extents});
+      }
+    }
+    else
     {
 #if defined(SEEK_DATA) && !defined(__APPLE__)
       /* Apple's SEEK_HOLE implementation is basically unusable. I discovered this the
@@ -668,6 +1048,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
 #endif
     // If cloning within the same file, use the appropriate direction
     auto &dest = static_cast<file_handle &>(dest_);
+    dest._invalidate_extent_map();
     OUTCOME_TRY(auto &&dest_length, dest.maximum_extent());
     if(dest.unique_id() == unique_id())
     {
@@ -763,7 +1144,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
 #endif
 #elif defined(__FreeBSD__)
       // This gets implemented in FreeBSD 13. See https://reviews.freebsd.org/D20584
-      return syscall(569 /*copy_file_range*/, intfd, inoffp, outfd, outoffp, len, flags);
+      return syscall(569 /*copy_file_range*/, infd, inoffp, outfd, outoffp, len, flags);
 #else
       (void) infd;
       (void) inoffp;
@@ -786,9 +1167,84 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
       return -1;
 #endif
     };
+    auto _clone_file_range = [&](int infd, off_t inoff, int outfd, off_t outoff, extent_type len) -> int {
+#if defined(__linux__)
+      // If this were Linux 4.5 or later only, could include <linux/fs.h> for this
+      struct file_clone_range
+      {
+        int64_t src_fd;
+        uint64_t src_offset;
+        uint64_t src_length;
+        uint64_t dest_offset;
+      } fcr;
+      fcr.src_fd = infd;
+      fcr.src_offset = inoff;
+      fcr.src_length = len;
+      fcr.dest_offset = outoff;
+      return ::ioctl(outfd, 0x4020940d /*FICLONERANGE*/, &fcr);
+#else
+      (void) infd;
+      (void) inoff;
+      (void) outfd;
+      (void) outoff;
+      (void) len;
+      errno = EOPNOTSUPP;
+      return -1;
+#endif
+    };
+    bool reflink_extents = true, copy_file_range_unbounded = true;
     for(const workitem &item : todo)
     {
-      for(extent_type thisoffset = 0; thisoffset < item.src.length; thisoffset += blocksize)
+      extent_type thisoffset = 0;
+      if(duplicate_extents && item.op == workitem::clone_extents)
+      {
+        /* Try to duplicate the whole work item in as few syscalls as possible first. A reflink
+        shares the extents copy-on-write, and costs the same no matter the length. If that
+        is not available, copy_file_range() lets the kernel or a NFS v4.2/CIFS server do the
+        copy with no round trips through user space, but only if it is given enough to
+        do per call, so we don't break it up into page_allocator sized chunks.
+        */
+        if(reflink_extents)
+        {
+          if(_clone_file_range(_v.fd, item.src.offset, dest.native_handle().fd, item.src.offset + destoffsetdiff, item.src.length) >= 0)
+          {
+            thisoffset = item.src.length;
+          }
+          else
+          {
+            // Not supported by this filing system, or these extents are not clone aligned
+            reflink_extents = false;
+          }
+        }
+        while(copy_file_range_unbounded && thisoffset < item.src.length)
+        {
+          // Linux won't do more than MAX_RW_COUNT per call, so don't ask for more
+          const auto thischunk = (size_t) std::min(item.src.length - thisoffset, (extent_type) 0x7ffff000);
+          off_t off_in = item.src.offset + thisoffset, off_out = item.src.offset + thisoffset + destoffsetdiff;
+          const auto copied = _copy_file_range(_v.fd, &off_in, dest.native_handle().fd, &off_out, thischunk, 0);
+          if(copied <= 0)
+          {
+            if(copied < 0 && EXDEV != errno && EOPNOTSUPP != errno && ENOSYS != errno && EINVAL != errno)
+            {
+              return posix_error();
+            }
+            // Let the chunked loop below decide whether to emulate
+            copy_file_range_unbounded = false;
+            break;
+          }
+          thisoffset += copied;
+          dest_length = destoffset + extent.length;
+          truncate_back_on_failure = false;
+          LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+        }
+        if(thisoffset > 0)
+        {
+          dest_length = destoffset + extent.length;
+          truncate_back_on_failure = false;
+          ret.length += thisoffset;
+        }
+      }
+      for(; thisoffset < item.src.length; thisoffset += blocksize)
       {
         bool done = false;
         const auto thisblock = std::min(blocksize, item.src.length - thisoffset);
@@ -812,7 +1268,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
         {
           if(buffer == nullptr)
           {
-            buffer = utils::page_allocator<byte>().allocate(blocksize);
+            buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
           }
           deadline nd;
           buffer_type b(buffer, thisblock);
@@ -891,7 +1347,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
         {
           if(buffer == nullptr)
           {
-            buffer = utils::page_allocator<byte>().allocate(blocksize);
+            buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
           }
           deadline nd;
           const_buffer_type cb(buffer, thisblock);
@@ -922,6 +1378,65 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
   }
 }
 
+result<file_handle::extent_type> file_handle::deduplicate_extents_to(file_handle::extent_pair extent, file_handle &dest, file_handle::extent_type destoffset) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset || destoffset + extent.length < destoffset)
+  {
+    return errc::value_too_large;
+  }
+#if defined(__linux__)
+  // If this were Linux 4.5 or later only, could include <linux/fs.h> for this
+  struct file_dedupe_range
+  {
+    uint64_t src_offset;
+    uint64_t src_length;
+    uint16_t dest_count;
+    uint16_t reserved1;
+    uint32_t reserved2;
+    // One struct file_dedupe_range_info
+    int64_t dest_fd;
+    uint64_t dest_offset;
+    uint64_t bytes_deduped;
+    int32_t status;
+    uint32_t reserved;
+  } fdr;
+  dest._invalidate_extent_map();
+  extent_type ret = 0;
+  while(ret < extent.length)
+  {
+    memset(&fdr, 0, sizeof(fdr));
+    fdr.src_offset = extent.offset + ret;
+    // btrfs compares no more than 16Mb per call
+    fdr.src_length = std::min(extent.length - ret, (extent_type) 16 * 1024 * 1024);
+    fdr.dest_count = 1;
+    fdr.dest_fd = dest.native_handle().fd;
+    fdr.dest_offset = destoffset + ret;
+    if(-1 == ::ioctl(_v.fd, 0xc0189436 /*FIDEDUPERANGE*/, &fdr))
+    {
+      if(ENOTTY == errno)
+      {
+        return errc::operation_not_supported;
+      }
+      return posix_error();
+    }
+    if(fdr.status < 0)
+    {
+      return posix_error(-fdr.status);
+    }
+    ret += fdr.bytes_deduped;
+    if(fdr.status == 1 /*FILE_DEDUPE_RANGE_DIFFERS*/ || fdr.bytes_deduped == 0)
+    {
+      break;
+    }
+  }
+  return ret;
+#else
+  (void) dest;
+  return errc::operation_not_supported;
+#endif
+}
+
 result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair extent, deadline d) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -929,6 +1444,7 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
   {
     return errc::value_too_large;
   }
+  _invalidate_extent_map();
 #if defined(__linux__)
   if(-1 == fallocate(_v.fd, 0x02 /*FALLOC_FL_PUNCH_HOLE*/ | 0x01 /*FALLOC_FL_KEEP_SIZE*/, extent.offset, extent.length))
   {
@@ -938,6 +1454,11 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
       return posix_error();
     }
   }
+  else
+  {
+    // Writing zeros on top would reallocate the hole just punched
+    return extent.length;
+  }
 #endif
   // Fall back onto a write of zeros
   if(extent.length < utils::page_size())
@@ -951,8 +1472,8 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
   {
     extent_type ret = 0;
     auto blocksize = utils::file_buffer_default_size();
-    byte *buffer = utils::page_allocator<byte>().allocate(blocksize);
-    auto unbufferh = make_scope_exit([buffer, blocksize]() noexcept { utils::page_allocator<byte>().deallocate(buffer, blocksize); });
+    byte *buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
+    auto unbufferh = make_scope_exit([buffer, blocksize]() noexcept { utils::pooled_page_allocator<byte>().deallocate(buffer, blocksize); });
     (void) unbufferh;
     while(extent.length > 0)
     {
@@ -970,4 +1491,250 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
   }
 }
 
+result<file_handle::extent_type> file_handle::zero_extents(span<const extent_pair> extents, bool discard, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  for(auto &extent : extents)
+  {
+    if(extent.offset + extent.length < extent.offset)
+    {
+      return errc::value_too_large;
+    }
+  }
+  extent_type ret = 0;
+  if(!discard)
+  {
+    for(auto &extent : extents)
+    {
+      OUTCOME_TRY(auto &&zeroed, zero(extent, d));
+      ret += zeroed;
+    }
+    return ret;
+  }
+  _invalidate_extent_map();
+#if defined(__linux__)
+  struct stat s
+  {
+  };
+  memset(&s, 0, sizeof(s));
+  if(-1 == ::fstat(_v.fd, &s))
+  {
+    return posix_error();
+  }
+  const bool blockdevice = S_ISBLK(s.st_mode);
+  for(auto &extent : extents)
+  {
+    if(extent.length == 0)
+    {
+      continue;
+    }
+    if(blockdevice)
+    {
+      uint64_t range[2] = {extent.offset, extent.length};
+      if(-1 == ::ioctl(_v.fd, 0x1277 /*BLKDISCARD*/, range))
+      {
+        // The device may not support discard
+        if(EOPNOTSUPP == errno)
+        {
+          return ret;
+        }
+        return posix_error();
+      }
+    }
+    else if(-1 == fallocate(_v.fd, 0x02 /*FALLOC_FL_PUNCH_HOLE*/ | 0x01 /*FALLOC_FL_KEEP_SIZE*/, extent.offset, extent.length))
+    {
+      // The filing system may not support trim
+      if(EOPNOTSUPP == errno)
+      {
+        return ret;
+      }
+      return posix_error();
+    }
+    ret += extent.length;
+  }
+#endif
+  return ret;
+}
+
+result<file_handle::extent_pair> file_handle::preallocate(file_handle::extent_pair extent, bool keep_size) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset)
+  {
+    return errc::value_too_large;
+  }
+  if(extent.length == 0)
+  {
+    return extent;
+  }
+  _invalidate_extent_map();
+#if defined(__linux__)
+  if(-1 == fallocate(_v.fd, keep_size ? 0x01 /*FALLOC_FL_KEEP_SIZE*/ : 0, extent.offset, extent.length))
+  {
+    return posix_error();
+  }
+#elif defined(__APPLE__)
+  struct stat s
+  {
+  };
+  memset(&s, 0, sizeof(s));
+  if(-1 == ::fstat(_v.fd, &s))
+  {
+    return posix_error();
+  }
+  // F_PREALLOCATE allocates from the physical end of the file
+  const extent_type allocated = (extent_type) s.st_blocks * 512;
+  if(extent.offset + extent.length > allocated)
+  {
+    fstore_t fst;
+    memset(&fst, 0, sizeof(fst));
+    fst.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+    fst.fst_posmode = F_PEOFPOSMODE;
+    fst.fst_offset = 0;
+    fst.fst_length = (off_t)(extent.offset + extent.length - allocated);
+    if(-1 == ::fcntl(_v.fd, F_PREALLOCATE, &fst))
+    {
+      // Try again without requiring the storage to be contiguous
+      fst.fst_flags = F_ALLOCATEALL;
+      if(-1 == ::fcntl(_v.fd, F_PREALLOCATE, &fst))
+      {
+        return posix_error();
+      }
+    }
+  }
+  if(!keep_size && extent.offset + extent.length > (extent_type) s.st_size)
+  {
+    if(-1 == ::ftruncate(_v.fd, extent.offset + extent.length))
+    {
+      return posix_error();
+    }
+  }
+#else
+  if(keep_size)
+  {
+    OUTCOME_TRY(auto &&length, file_handle::maximum_extent());
+    if(extent.offset >= length)
+    {
+      return extent_pair(extent.offset, 0);
+    }
+    extent.length = std::min(extent.length, length - extent.offset);
+  }
+  // posix_fallocate() returns the error rather than setting errno
+  int errcode = ::posix_fallocate(_v.fd, extent.offset, extent.length);
+  if(errcode != 0)
+  {
+    return posix_error(errcode);
+  }
+#endif
+  return extent;
+}
+
+result<file_handle::extent_type> file_handle::collapse(file_handle::extent_pair extent) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset)
+  {
+    return errc::value_too_large;
+  }
+#if defined(__linux__)
+  _invalidate_extent_map();
+  if(-1 == fallocate(_v.fd, 0x08 /*FALLOC_FL_COLLAPSE_RANGE*/, extent.offset, extent.length))
+  {
+    return posix_error();
+  }
+  return file_handle::maximum_extent();
+#else
+  return errc::operation_not_supported;
+#endif
+}
+
+result<file_handle::extent_type> file_handle::insert(file_handle::extent_pair extent) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset)
+  {
+    return errc::value_too_large;
+  }
+#if defined(__linux__)
+  _invalidate_extent_map();
+  if(-1 == fallocate(_v.fd, 0x20 /*FALLOC_FL_INSERT_RANGE*/, extent.offset, extent.length))
+  {
+    return posix_error();
+  }
+  return file_handle::maximum_extent();
+#else
+  return errc::operation_not_supported;
+#endif
+}
+
+result<void> file_handle::advise(file_handle::extent_pair region, file_handle::access_hint hint) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.offset + region.length < region.offset)
+  {
+    return errc::value_too_large;
+  }
+#if defined(__linux__) || defined(__FreeBSD__)
+  int advice = POSIX_FADV_NORMAL;
+  switch(hint)
+  {
+  case access_hint::normal:
+    break;
+  case access_hint::sequential:
+    advice = POSIX_FADV_SEQUENTIAL;
+    break;
+  case access_hint::random:
+    advice = POSIX_FADV_RANDOM;
+    break;
+  case access_hint::willneed:
+    advice = POSIX_FADV_WILLNEED;
+    break;
+  case access_hint::dontneed:
+    advice = POSIX_FADV_DONTNEED;
+    break;
+  case access_hint::noreuse:
+    advice = POSIX_FADV_NOREUSE;
+    break;
+  }
+  // posix_fadvise() returns the error rather than setting errno
+  int errcode = ::posix_fadvise(_v.fd, region.offset, region.length, advice);
+  if(errcode != 0)
+  {
+    return posix_error(errcode);
+  }
+#elif defined(__APPLE__)
+  switch(hint)
+  {
+  case access_hint::normal:
+  case access_hint::sequential:
+  case access_hint::random:
+    // Mac OS can only toggle readahead for the whole file
+    if(-1 == ::fcntl(_v.fd, F_RDAHEAD, (hint == access_hint::random) ? 0 : 1))
+    {
+      return posix_error();
+    }
+    break;
+  case access_hint::willneed:
+  {
+    struct radvisory ra;
+    ra.ra_offset = static_cast<off_t>(region.offset);
+    static constexpr int maxcount = (std::numeric_limits<int>::max)();
+    ra.ra_count = (region.length == 0 || region.length > (extent_type) maxcount) ? maxcount : static_cast<int>(region.length);
+    if(-1 == ::fcntl(_v.fd, F_RDADVISE, &ra))
+    {
+      return posix_error();
+    }
+    break;
+  }
+  case access_hint::dontneed:
+  case access_hint::noreuse:
+    // Mac OS has no means of evicting a region from the unified buffer cache
+    break;
+  }
+#else
+  (void) hint;
+#endif
+  return success();
+}
+
 LLFIO_V2_NAMESPACE_END
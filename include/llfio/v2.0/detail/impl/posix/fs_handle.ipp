@@ -45,6 +45,59 @@ result<void> fs_handle::_fetch_inode() const noexcept
   return success();
 }
 
+result<filesystem::path> fs_handle::_cached_current_path() const noexcept
+{
+  const handle &h = _get_handle();
+  auto *cache = __atomic_load_n(&_current_path, __ATOMIC_ACQUIRE);
+  try
+  {
+    if(cache != nullptr && h.is_valid())
+    {
+      filesystem::path cached;
+      {
+        lock_guard<spinlock> g(cache->lock);
+        cached = cache->path;
+      }
+      // If the path still leads to this inode, it is still a current path
+      struct stat s
+      {
+      };
+      if(-1 != ::lstat(cached.c_str(), &s) && (dev_t) s.st_dev == st_dev() && (ino_t) s.st_ino == st_ino())
+      {
+        return {std::move(cached)};
+      }
+    }
+    OUTCOME_TRY(auto &&ret, h.handle::current_path());
+    if(ret.empty())
+    {
+      // Deleted, so nothing to cache
+      return {std::move(ret)};
+    }
+    if(cache == nullptr)
+    {
+      auto *newcache = new _current_path_cache;
+      if(__atomic_compare_exchange_n(&_current_path, &cache, newcache, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+        cache = newcache;
+      }
+      else
+      {
+        // Another thread allocated it first
+        delete newcache;
+      }
+    }
+    {
+      lock_guard<spinlock> g(cache->lock);
+      cache->path = ret;
+    }
+    return {std::move(ret)};
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 namespace detail
 {
   result<path_handle> containing_directory(optional<std::reference_wrapper<filesystem::path>> out_filename, const handle &h, const fs_handle &fsh,
@@ -56,7 +109,7 @@ namespace detail
     {
       if(d.steady)
       {
-        began_steady = std::chrono::steady_clock::now();
+        began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
       }
       else
       {
@@ -154,7 +207,7 @@ namespace detail
         {
           if(d.steady)
           {
-            if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
+            if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
             {
               return errc::timed_out;
             }
@@ -31,11 +31,182 @@ Distributed under the Boost Software License, Version 1.0.
 #error You should not include posix/import.hpp on Windows platforms
 #endif
 
+#include <cstdio>  // for renameat() and renameatx_np()
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
 LLFIO_V2_NAMESPACE_BEGIN
 
+namespace detail
+{
+  // Converts io_request_flag into the RWF_* flags taken by preadv2()/pwritev2()
+  template <class Flags> inline int rwf_from_io_request_flags(Flags flags, bool is_write) noexcept
+  {
+    int ret = 0;
+    if(flags & Flags::high_priority)
+    {
+      ret |= 0x00000001 /*RWF_HIPRI*/;
+    }
+    if(is_write && (flags & Flags::data_sync))
+    {
+      ret |= 0x00000002 /*RWF_DSYNC*/;
+    }
+    if(flags & Flags::nowait)
+    {
+      ret |= 0x00000008 /*RWF_NOWAIT*/;
+    }
+    return ret;
+  }
+  // Converts io_priority into the Linux ioprio of an individual i/o, zero meaning that of the thread.
+  // The realtime class requires privileges, so high priority is the highest best effort level.
+  template <class Priority> inline uint16_t ioprio_from_priority(Priority p) noexcept
+  {
+    switch(p)
+    {
+    case Priority::high:
+      return (2 /*IOPRIO_CLASS_BE*/ << 13) | 0;
+    case Priority::low:
+      return (2 /*IOPRIO_CLASS_BE*/ << 13) | 7;
+    default:
+      return 0;
+    }
+  }
+#ifdef __linux__
+  // Calls preadv2() and pwritev2(), which glibc did not wrap until recently
+  inline ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags) noexcept
+  {
+#ifdef SYS_preadv2
+    // The kernel takes the offset as two longs, of which the high one is shifted out on 64 bit
+    const auto pos = static_cast<unsigned long long>(offset);
+    return (ssize_t) syscall(SYS_preadv2, fd, iov, iovcnt, (unsigned long) pos, (unsigned long) ((pos >> (sizeof(long) * 4)) >> (sizeof(long) * 4)), flags);
+#else
+    (void) fd;
+    (void) iov;
+    (void) iovcnt;
+    (void) offset;
+    (void) flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+  inline ssize_t pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags) noexcept
+  {
+#ifdef SYS_pwritev2
+    const auto pos = static_cast<unsigned long long>(offset);
+    return (ssize_t) syscall(SYS_pwritev2, fd, iov, iovcnt, (unsigned long) pos, (unsigned long) ((pos >> (sizeof(long) * 4)) >> (sizeof(long) * 4)), flags);
+#else
+    (void) fd;
+    (void) iov;
+    (void) iovcnt;
+    (void) offset;
+    (void) flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+#endif
+  /* Calls renameat2() with the Linux RENAME_NOREPLACE (1) and RENAME_EXCHANGE (2) flags, which glibc
+  did not wrap until recently. Mac OS has renameatx_np() instead. Elsewhere, and for filing systems
+  which can't do RENAME_NOREPLACE, linkat() refuses to replace, so followed by unlinkat() it emulates it
+  for anything but a directory.
+  */
+  inline int renameat2(int olddirfd, const char *oldpath, int newdirfd, const char *newpath, unsigned flags) noexcept
+  {
+    if(flags == 0)
+    {
+      return ::renameat(olddirfd, oldpath, newdirfd, newpath);
+    }
+#ifdef __APPLE__
+    return renameatx_np(olddirfd, oldpath, newdirfd, newpath, (flags == 1) ? 0x4 /*RENAME_EXCL*/ : 0x2 /*RENAME_SWAP*/);
+#else
+#if defined(__linux__) && defined(SYS_renameat2)
+    const int ret = (int) syscall(SYS_renameat2, olddirfd, oldpath, newdirfd, newpath, flags);
+    if(ret != -1 || flags != 1 /*RENAME_NOREPLACE*/ || (ENOSYS != errno && EINVAL != errno))
+    {
+      return ret;
+    }
+#endif
+    if(flags != 1 /*RENAME_NOREPLACE*/)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+    if(-1 == ::linkat(olddirfd, oldpath, newdirfd, newpath, 0))
+    {
+      return -1;
+    }
+    return ::unlinkat(olddirfd, oldpath, 0);
+#endif
+  }
+
+  /* An intrusive list of queued i/o sorted by expiry, soonest first, for the multiplexers which
+  implement deadlines themselves. I/o initiated later usually expires later, so insertion searches
+  from the back, and expiring i/o costs only in proportion to the i/o expired. `State` needs the
+  members `deadline_prev`, `deadline_next` and `expiry`.
+  */
+  template <class State> struct deadline_list
+  {
+    State *first{nullptr}, *last{nullptr};
+
+    bool empty() const noexcept { return first == nullptr; }
+    void insert(State *state) noexcept
+    {
+      assert(state->deadline_prev == nullptr);
+      assert(state->deadline_next == nullptr);
+      State *after = last;
+      while(after != nullptr && after->expiry > state->expiry)
+      {
+        after = after->deadline_prev;
+      }
+      state->deadline_prev = after;
+      state->deadline_next = (after != nullptr) ? after->deadline_next : first;
+      if(state->deadline_next != nullptr)
+      {
+        state->deadline_next->deadline_prev = state;
+      }
+      else
+      {
+        last = state;
+      }
+      if(after != nullptr)
+      {
+        after->deadline_next = state;
+      }
+      else
+      {
+        first = state;
+      }
+    }
+    void remove(State *state) noexcept
+    {
+      if(state->deadline_prev != nullptr)
+      {
+        state->deadline_prev->deadline_next = state->deadline_next;
+      }
+      else
+      {
+        assert(first == state);
+        first = state->deadline_next;
+      }
+      if(state->deadline_next != nullptr)
+      {
+        state->deadline_next->deadline_prev = state->deadline_prev;
+      }
+      else
+      {
+        assert(last == state);
+        last = state->deadline_prev;
+      }
+      state->deadline_prev = state->deadline_next = nullptr;
+    }
+  };
+}  // namespace detail
+
 inline result<int> attribs_from_handle_mode_caching_and_flags(native_handle_type &nativeh, handle::mode _mode, handle::creation _creation, handle::caching _caching, handle::flag flags) noexcept
 {
   int attribs = O_CLOEXEC;
@@ -136,7 +307,7 @@ inline result<int> attribs_from_handle_mode_caching_and_flags(native_handle_type
   {                                                                                                                                                                                                                                                                                                                            \
     if((d).steady)                                                                                                                                                                                                                                                                                                             \
     {                                                                                                                                                                                                                                                                                                                          \
-      began_steady = std::chrono::steady_clock::now();                                                                                                                                                                                                                                                                         \
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs);                                                                                                                                                                                                                                                                         \
       timeout = &_timeout;                                                                                                                                                                                                                                                                                                     \
     }                                                                                                                                                                                                                                                                                                                          \
     else                                                                                                                                                                                                                                                                                                                       \
@@ -147,7 +318,7 @@ inline result<int> attribs_from_handle_mode_caching_and_flags(native_handle_type
   if((d) && (d).steady)                                                                                                                                                                                                                                                                                                        \
   {                                                                                                                                                                                                                                                                                                                            \
     std::chrono::nanoseconds ns;                                                                                                                                                                                                                                                                                               \
-    ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());                                                                                                                                                                        \
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs));                                                                                                                                                                        \
     if(ns.count() < 0)                                                                                                                                                                                                                                                                                                         \
     {                                                                                                                                                                                                                                                                                                                          \
       _timeout.tv_sec = 0;                                                                                                                                                                                                                                                                                                     \
@@ -165,7 +336,7 @@ inline result<int> attribs_from_handle_mode_caching_and_flags(native_handle_type
   {                                                                                                                                                                                                                                                                                                                            \
     if((d).steady)                                                                                                                                                                                                                                                                                                             \
     {                                                                                                                                                                                                                                                                                                                          \
-      if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))                                                                                                                                                                                                                             \
+      if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now((d).nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))                                                                                                                                                                                                                             \
         return LLFIO_V2_NAMESPACE::failure(LLFIO_V2_NAMESPACE::errc::timed_out);                                                                               \
     }                                                                                                                                                                                                                                                                                                                          \
     else                                                                                                                                                                                                                                                                                                                       \
@@ -66,28 +66,198 @@ size_t io_handle::_do_max_buffers() const noexcept
   return v;
 }
 
-io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_request<io_handle::buffers_type> reqs, deadline d) noexcept
+result<void> io_handle::set_priority(io_priority p) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
-  if(d && !_v.is_nonblocking())
+  // POSIX kernels prioritise per thread or per i/o, never per file descriptor
+  _priority = p;
+  return success();
+}
+
+namespace detail
+{
+  // Linux transfers at most this many bytes per syscall, and other POSIX transfer at most INT_MAX
+  static constexpr size_t max_bytes_per_io_syscall = 0x7ffff000;
+
+  // Performs a single positioned scatter read, honouring any request flags
+  inline result<size_t> do_preadv(int fd, struct iovec *iov, int iovcnt, off_t offset, io_handle::io_request_flag flags) noexcept
   {
-    return errc::not_supported;
+#if LLFIO_MISSING_PIOV
+    if(flags & io_handle::io_request_flag::nowait)
+    {
+      return errc::operation_not_supported;
+    }
+    size_t ret = 0;
+    for(int n = 0; n < iovcnt; n++)
+    {
+      ssize_t bytes = ::pread(fd, iov[n].iov_base, iov[n].iov_len, offset);
+      if(bytes < 0)
+      {
+        if(ret > 0)
+        {
+          break;
+        }
+        return posix_error();
+      }
+      ret += bytes;
+      offset += bytes;
+      if(static_cast<size_t>(bytes) < iov[n].iov_len)
+      {
+        break;
+      }
+    }
+    return ret;
+#else
+    ssize_t bytes = -1;
+    bool done = false;
+#ifdef __linux__
+    if(const int rwf = rwf_from_io_request_flags(flags, false))
+    {
+      bytes = preadv2(fd, iov, iovcnt, offset, rwf);
+      // Kernels before 4.6 lack preadv2, and kernels before 4.14 lack RWF_NOWAIT
+      done = (bytes >= 0 || (ENOSYS != errno && EOPNOTSUPP != errno));
+    }
+#endif
+    if(!done)
+    {
+      if(flags & io_handle::io_request_flag::nowait)
+      {
+        return errc::operation_not_supported;
+      }
+      bytes = ::preadv(fd, iov, iovcnt, offset);
+    }
+    if(bytes < 0)
+    {
+      return posix_error();
+    }
+    return static_cast<size_t>(bytes);
+#endif
   }
-  if(reqs.buffers.size() > IOV_MAX)
+
+  // Performs a single positioned gather write, honouring any request flags. `synced` is set if the write was made durable.
+  inline result<size_t> do_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset, io_handle::io_request_flag flags, bool &synced) noexcept
   {
-    return errc::argument_list_too_long;
+    synced = false;
+#if LLFIO_MISSING_PIOV
+    if(flags & io_handle::io_request_flag::nowait)
+    {
+      return errc::operation_not_supported;
+    }
+    size_t ret = 0;
+    for(int n = 0; n < iovcnt; n++)
+    {
+      ssize_t bytes = ::pwrite(fd, iov[n].iov_base, iov[n].iov_len, offset);
+      if(bytes < 0)
+      {
+        if(ret > 0)
+        {
+          break;
+        }
+        return posix_error();
+      }
+      ret += bytes;
+      offset += bytes;
+      if(static_cast<size_t>(bytes) < iov[n].iov_len)
+      {
+        break;
+      }
+    }
+    return ret;
+#else
+    ssize_t bytes = -1;
+    bool done = false;
+#ifdef __linux__
+    if(const int rwf = rwf_from_io_request_flags(flags, true))
+    {
+      bytes = pwritev2(fd, iov, iovcnt, offset, rwf);
+      // Kernels before 4.7 lack pwritev2 and RWF_DSYNC, and kernels before 4.14 lack RWF_NOWAIT
+      done = (bytes >= 0 || (ENOSYS != errno && EOPNOTSUPP != errno));
+      synced = done && !!(flags & io_handle::io_request_flag::data_sync);
+    }
+#endif
+    if(!done)
+    {
+      if(flags & io_handle::io_request_flag::nowait)
+      {
+        return errc::operation_not_supported;
+      }
+      bytes = ::pwritev(fd, iov, iovcnt, offset);
+    }
+    if(bytes < 0)
+    {
+      return posix_error();
+    }
+    return static_cast<size_t>(bytes);
+#endif
   }
-  LLFIO_POSIX_DEADLINE_TO_SLEEP_INIT(d);
-#if 0
-  struct iovec *iov = (struct iovec *) alloca(reqs.buffers.size() * sizeof(struct iovec));
-  for(size_t n = 0; n < reqs.buffers.size(); n++)
+
+  /* Performs as many syscalls as needed to transfer a request with more buffers than IOV_MAX, or more bytes
+  than a single syscall will transfer. Stops at the first short transfer which isn't due to the syscall limit.
+  `op(iov, iovcnt, offset)` performs one syscall. Returns the total bytes transferred.
+  */
+  template <class Op> inline result<size_t> do_split_positioned_io(struct iovec *iov, size_t iovcnt, io_handle::extent_type offset, size_t maxiov, Op &&op) noexcept
+  {
+    size_t ret = 0, idx = 0, bufoffset = 0;
+    while(idx < iovcnt)
+    {
+      const size_t count = std::min(iovcnt - idx, maxiov);
+      // Temporarily adjust the first buffer if this continues part way through it
+      const struct iovec first = iov[idx];
+      iov[idx].iov_base = static_cast<char *>(first.iov_base) + bufoffset;
+      iov[idx].iov_len = first.iov_len - bufoffset;
+      size_t requested = 0;
+      for(size_t n = 0; n < count; n++)
+      {
+        requested += iov[idx + n].iov_len;
+      }
+      auto r = op(iov + idx, (int) count, offset);
+      iov[idx] = first;
+      if(!r)
+      {
+        if(ret > 0)
+        {
+          // Report what was transferred, the failure will recur on the next call
+          return ret;
+        }
+        return std::move(r).error();
+      }
+      const size_t bytes = r.value();
+      ret += bytes;
+      offset += bytes;
+      if(bytes < requested)
+      {
+        if(bytes < max_bytes_per_io_syscall)
+        {
+          // A genuine short transfer e.g. end of file
+          return ret;
+        }
+        // Otherwise the syscall transfer limit was hit, so continue from where it stopped
+        size_t advance = bufoffset + bytes;
+        while(idx < iovcnt && advance >= iov[idx].iov_len)
+        {
+          advance -= iov[idx].iov_len;
+          ++idx;
+        }
+        bufoffset = advance;
+        continue;
+      }
+      idx += count;
+      bufoffset = 0;
+    }
+    return ret;
+  }
+}  // namespace detail
+
+io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_request<io_handle::buffers_type> reqs, deadline d) noexcept
+{
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
   {
-    iov[n].iov_base = reqs.buffers[n].data;
-    iov[n].iov_len = reqs.buffers[n].len;
+    return errc::not_supported;
   }
-#else
+  const size_t maxiov = IOV_MAX;
+  LLFIO_POSIX_DEADLINE_TO_SLEEP_INIT(d);
   auto *iov = reinterpret_cast<struct iovec *>(reqs.buffers.data());
-#endif
 #ifndef NDEBUG
   if(_v.requires_aligned_io())
   {
@@ -102,26 +272,18 @@ io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_
   ssize_t bytesread = 0;
   if(is_seekable())
   {
-#if LLFIO_MISSING_PIOV
-    off_t offset = reqs.offset;
-    for(size_t n = 0; n < reqs.buffers.size(); n++)
-    {
-      bytesread += ::pread(_v.fd, iov[n].iov_base, iov[n].iov_len, offset);
-      offset += iov[n].iov_len;
-    }
-#else
-    bytesread = ::preadv(_v.fd, iov, reqs.buffers.size(), reqs.offset);
-#endif
-    if(bytesread < 0)
-    {
-      return posix_error();
-    }
+    OUTCOME_TRY(auto &&bytes, detail::do_split_positioned_io(iov, reqs.buffers.size(), reqs.offset, maxiov, [&](struct iovec *v, int cnt, extent_type offset) {
+                  return detail::do_preadv(_v.fd, v, cnt, offset, reqs.flags);
+                }));
+    bytesread = (ssize_t) bytes;
   }
   else
   {
+    // Short reads are normal for non-seekable handles, so only the first IOV_MAX buffers are filled
+    const int iovcnt = (int) std::min(reqs.buffers.size(), maxiov);
     do
     {
-      bytesread = ::readv(_v.fd, iov, reqs.buffers.size());
+      bytesread = ::readv(_v.fd, iov, iovcnt);
       if(bytesread <= 0)
       {
         if(bytesread < 0 && EWOULDBLOCK != errno && EAGAIN != errno)
@@ -144,6 +306,38 @@ io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_
         LLFIO_POSIX_DEADLINE_TO_TIMEOUT_LOOP(d);
       }
     } while(bytesread <= 0);
+    if(reqs.flags & io_request_flag::drain)
+    {
+      // Keep reading whatever is immediately available until the buffers are full
+      size_t idx = 0, bufoffset = (size_t) bytesread;
+      for(;;)
+      {
+        while(idx < (size_t) iovcnt && bufoffset >= iov[idx].iov_len)
+        {
+          bufoffset -= iov[idx].iov_len;
+          ++idx;
+        }
+        if(idx == (size_t) iovcnt)
+        {
+          break;
+        }
+        pollfd p;
+        memset(&p, 0, sizeof(p));
+        p.fd = _v.fd;
+        p.events = POLLIN;
+        if(::poll(&p, 1, 0) <= 0 || (p.revents & POLLIN) == 0)
+        {
+          break;
+        }
+        const ssize_t more = ::read(_v.fd, (char *) iov[idx].iov_base + bufoffset, iov[idx].iov_len - bufoffset);
+        if(more <= 0)
+        {
+          break;
+        }
+        bytesread += more;
+        bufoffset += (size_t) more;
+      }
+    }
   }
   for(size_t i = 0; i < reqs.buffers.size(); i++)
   {
@@ -164,26 +358,14 @@ io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_
 
 io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_write(io_handle::io_request<io_handle::const_buffers_type> reqs, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   if(d && !_v.is_nonblocking())
   {
     return errc::not_supported;
   }
-  if(reqs.buffers.size() > IOV_MAX)
-  {
-    return errc::argument_list_too_long;
-  }
+  const size_t maxiov = IOV_MAX;
   LLFIO_POSIX_DEADLINE_TO_SLEEP_INIT(d);
-#if 0
-  struct iovec *iov = (struct iovec *) alloca(reqs.buffers.size() * sizeof(struct iovec));
-  for(size_t n = 0; n < reqs.buffers.size(); n++)
-  {
-    iov[n].iov_base = const_cast<char *>(reqs.buffers[n].data);
-    iov[n].iov_len = reqs.buffers[n].len;
-  }
-#else
   auto *iov = reinterpret_cast<struct iovec *>(reqs.buffers.data());
-#endif
 #ifndef NDEBUG
   if(_v.requires_aligned_io())
   {
@@ -196,30 +378,28 @@ io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_write(io_hand
   }
 #endif
   ssize_t byteswritten = 0;
+  bool needs_barrier = false;
   if(is_seekable())
   {
-#if LLFIO_MISSING_PIOV
-    off_t offset = reqs.offset;
-    for(size_t n = 0; n < reqs.buffers.size(); n++)
-    {
-      byteswritten += ::pwrite(_v.fd, iov[n].iov_base, iov[n].iov_len, offset);
-      offset += iov[n].iov_len;
-    }
-#else
-    byteswritten = ::pwritev(_v.fd, iov, reqs.buffers.size(), reqs.offset);
-#endif
-    if(byteswritten < 0)
-    {
-      return posix_error();
-    }
+    bool all_synced = true;
+    OUTCOME_TRY(auto &&bytes, detail::do_split_positioned_io(iov, reqs.buffers.size(), reqs.offset, maxiov, [&](struct iovec *v, int cnt, extent_type offset) {
+                  bool synced = false;
+                  auto ret = detail::do_pwritev(_v.fd, v, cnt, offset, reqs.flags, synced);
+                  all_synced = all_synced && synced;
+                  return ret;
+                }));
+    byteswritten = (ssize_t) bytes;
+    needs_barrier = !all_synced && !!(reqs.flags & io_request_flag::data_sync);
   }
   else
   {
+    // Short writes are normal for non-seekable handles, so only the first IOV_MAX buffers are written
+    const int iovcnt = (int) std::min(reqs.buffers.size(), maxiov);
     do
     {
       // Can't guarantee that user code hasn't enabled SIGPIPE
       byteswritten = QUICKCPPLIB_NAMESPACE::signal_guard::signal_guard(
-      QUICKCPPLIB_NAMESPACE::signal_guard::signalc_set::broken_pipe, [&] { return ::writev(_v.fd, iov, reqs.buffers.size()); },
+      QUICKCPPLIB_NAMESPACE::signal_guard::signalc_set::broken_pipe, [&] { return ::writev(_v.fd, iov, iovcnt); },
       [&](const QUICKCPPLIB_NAMESPACE::signal_guard::raised_signal_info * /*unused*/) {
         errno = EPIPE;
         return -1;
@@ -261,13 +441,18 @@ io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_write(io_hand
       break;
     }
   }
+  if(needs_barrier)
+  {
+    // Emulate data_sync with a barrier of what was written
+    OUTCOME_TRY(_do_barrier({reqs.buffers, reqs.offset}, barrier_kind::wait_data_only, d));
+  }
   return {reqs.buffers};
 }
 
 io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_barrier(io_handle::io_request<io_handle::const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept
 {
   (void) kind;
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   if(is_pipe() || is_socket())
   {
     return success();  // nothing was flushed
@@ -0,0 +1,3325 @@
+/* Multiplex file i/o
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (9 commits)
+File Created: May 2019
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../io_handle.hpp"
+#include "../../../utils.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#ifndef __linux__
+#error This implementation file is for Linux only
+#endif
+
+#include <bitset>
+#include <climits>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/types.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "import.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* io_uring is a bit of an interesting design, so we've ended up with a rather
+unusual i/o multiplexer design, which wasn't anticipated when we began this.
+
+POSIX provides strong read/write concurrency guarantees which are valuable, and
+more importantly, lots of file i/o code hard-assumes (often unintentionally) that
+there is an implicit sequencing of all i/o issued against each inode. This arose,
+historically speaking, because each inode has a read-write mutex, and i/o upon
+that inode therefore was serialised by that mutex in the kernel.
+
+Just to be clear, POSIX's guarantees are weaker than this - i/o upon non-overlapping
+regions can parallelise embarrassingly. However, if concurrent i/o upon the same
+inode overlaps a region, each i/o must complete as an atomic operation with
+respect to other i/o operations. And given how fast i/o can be, spending CPU on
+figuring out if regions overlap is usually more expensive than just using a per-inode
+read-write mutex.
+
+Conformance to POSIX read/write concurrency guarantees is excellent on Windows and
+all POSIX, except for Linux ext4 without O_DIRECT. However, io_uring doesn't
+expose any of this for file i/o - i/o submitted is immediately initiated, and no
+ordering is implemented at all. i.e. it's on you, the io_uring user, to not submit
+i/o the concurrency of which would be problematic. This even extends to IORING_OP_FSYNC,
+which will complete without reordering constraints to any i/o initiated beforehand
+or afterwards.
+
+io_uring *does* provide completion ordering *per-queue* via the IOSQE_IO_DRAIN and
+the IOSQE_IO_LINK flags. The former allows reordering of all i/o before the drain,
+but all that i/o must complete before the IOSQE_IO_DRAIN flagged submission can
+begin (this equals fence semantics). The latter imposes sequentially consistent
+ordering in that each item in the chain must complete before the next item,
+however individual chains can be reordered against one another.
+
+If one wishes to implement POSIX read/write concurrency guarantees,
+then one needs to enforce an ordering per-inode, which because io_uring only offers
+ordering at a per-queue level, implies that there must be either a queue per inode,
+or all file i/o must be sequentially orderered to all other file i/o i.e. you use
+a fully sequentially ordered queue for file i/o, and a separate freely reordered
+queue for non-file i/o.
+
+What we've thus done for this i/o multiplexer is this:
+
+- If the handle type is seekable, all initiated i/o enters a queue per handle, and
+the byte range of each i/o in flight per handle is tracked. An i/o is only submitted
+if its range does not overlap that of any i/o in flight, nor that of any i/o queued
+before it, where at least one of the two is a write. Barriers are treated as a write
+of the whole file. Each handle thus gets POSIX read/write concurrency guarantees
+without serialising the whole ring with IOSQE_IO_DRAIN, so i/o to unrelated files,
+and to unrelated regions of the same file, proceeds at full queue depth. Handles
+opened with `handle::flag::disable_posix_concurrency_guarantees` skip the overlap
+checking for reads and writes, as the application has promised they never overlap.
+
+- If the handle type is not seekable, all initiated i/o enters a queue per handle.
+Only one read and one write may be in flight per handle at a time, as each i/o
+completes, the next i/o of that direction from the queue is submitted.
+
+- Two io_uring instances are used, one for seekable i/o, the other for non-seekable
+i/o. This prevents writes to seekable handles blocking until non-seekable i/o completes.
+
+- A third io_uring instance created with IORING_SETUP_IOPOLL is used for reads and
+writes to regular files opened with `caching::none` or `caching::only_metadata`
+(i.e. `O_DIRECT`), whose completions are reaped by polling the device rather than
+by interrupt. IOPOLL instances can only execute reads and writes, so barriers,
+and i/o with a deadline (which needs an IORING_OP_LINK_TIMEOUT), go to the seekable
+ring instead, with ordering between them enforced as usual. i/o in flight upon the
+IOPOLL ring cannot be cancelled, it is waited upon instead. If the kernel or the
+device does not support IOPOLL, these handles use the seekable ring, the latter
+being discovered by the first i/o completing with EOPNOTSUPP, which is resubmitted.
+
+Some other implementation notes:
+
+- Registered file descriptors live in a table indexed by fd, so lookup is constant
+time. Where the kernel supports sparse registered file tables (Linux 5.5 onwards),
+fds are also registered with the ring to avoid the fget/fput per i/o. Each ring's
+table has up to 16384 slots allocated up front, without passing an array of them on
+Linux 5.19 onwards, fewer being tried if RLIMIT_NOFILE is lower. Slots are handed out
+from a free list, so any fd, however large, can occupy one.
+
+- The completion ring is sized to the registered file table, as we never have more i/o
+outstanding than completion ring entries. Thousands of handles may thus each have i/o
+outstanding at once, whilst the submission ring remains small.
+
+- Which operations the kernel supports is probed at ring creation (Linux 5.6 onwards),
+or inferred from the ring features for older kernels. Everything here works
+on Linux 5.1 onwards, albeit with reduced efficiency on the older kernels.
+
+- i/o completing with EAGAIN (older kernels do this for non-blocking pipes) is
+requeued behind an IORING_OP_POLL_ADD for its handle, and resubmitted when the
+handle becomes ready.
+
+- `check_for_any_completed_io()` waits using `poll()` upon both ring fds if both have
+i/o outstanding, so either ring completing anything wakes the waiter.
+`wake_check_for_any_completed_io()` posts a IORING_OP_NOP to each ring to achieve the same.
+
+- We never submit more i/o than there are completion ring entries, so completions
+cannot be dropped on kernels without IORING_FEAT_NODROP.
+
+- Registered i/o buffers are registered with every ring, and i/o of a single buffer
+lying within a registered buffer uses IORING_OP_READ_FIXED/IORING_OP_WRITE_FIXED, which
+avoids pinning the pages per i/o. Registration is one-shot in older kernels, so adding
+a buffer reregisters all of them, which can only be done when no fixed buffer i/o is
+in flight. If registration is not possible, an ordinary unregistered buffer is returned.
+
+- Reads of non-seekable handles on Linux 5.19 onwards select a buffer from a provided
+buffer ring registered with the non-seekable ring, rather than reading into the caller's
+buffers. The kernel only takes a buffer when data arrives, so thousands of reads pending
+upon mostly idle pipes pin no memory, and all of them share one pool. The length is clamped
+to the caller's buffers, and the data is copied into them upon completion before the buffer
+is returned to the ring. If the ring runs dry, the read is resubmitted as an ordinary read.
+
+- i/o with a deadline has an IORING_OP_LINK_TIMEOUT linked to it (or to its
+POLL_ADD), using an absolute CLOCK_MONOTONIC expiry calculated at initiation so
+resubmissions do not extend the deadline. Both the i/o and its linked timeout
+always post a completion, so the state is not completed until both have been
+reaped, whichever order they arrive in. i/o cancelled by its linked timeout
+completes with `errc::timed_out`.
+
+- A barrier initiated after a write to a seekable handle, before that write's sqe
+has been told to the kernel, is linked after the write using IOSQE_IO_LINK rather than
+waiting for the write to complete. Both are thus submitted together, and the kernel
+executes the barrier once the write completes. If the write fails or is short, the
+link is broken and the barrier completes with ECANCELED, in which case it is
+resubmitted normally after the write.
+
+- A write without a deadline initiated immediately after a write to the adjacent
+preceding offset of the same seekable handle, before that write's sqe has been told
+to the kernel, has its buffers appended to that sqe's gather list, up to `IOV_MAX`
+buffers and 256Kb. Many small appends thus become a single large write. When it
+completes, each write coalesced completes individually with its share of the bytes
+written. Writes not reached by a short write are resubmitted.
+
+- check_for_any_completed_io() waits using io_uring_enter() with an IORING_OP_TIMEOUT
+for its deadline where only one ring has i/o outstanding, falling back to poll()
+on both ring fds otherwise. If the IOPOLL ring has i/o outstanding, it instead
+spins polling for completions within io_uring_enter(), which returns after a
+completion or when the scheduler wants the CPU back.
+*/
+template <bool is_threadsafe> class linux_io_uring_multiplexer final : public io_multiplexer_impl<is_threadsafe>
+{
+  friend LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, bool is_polling) noexcept;
+  friend LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, const linux_io_uring_sqpoll_config &sqpoll) noexcept;
+
+  using _base = io_multiplexer_impl<is_threadsafe>;
+  using _multiplexer_lock_guard = typename _base::_lock_guard;
+
+  using path_type = typename _base::path_type;
+  using extent_type = typename _base::extent_type;
+  using size_type = typename _base::size_type;
+  using mode = typename _base::mode;
+  using creation = typename _base::creation;
+  using caching = typename _base::caching;
+  using flag = typename _base::flag;
+  using barrier_kind = typename _base::barrier_kind;
+  using const_buffers_type = typename _base::const_buffers_type;
+  using buffers_type = typename _base::buffers_type;
+  using registered_buffer_type = typename _base::registered_buffer_type;
+  template <class T> using io_request = typename _base::template io_request<T>;
+  template <class T> using io_result = typename _base::template io_result<T>;
+  template <class T> using batched_io_request = typename _base::template batched_io_request<T>;
+  using io_operation_state = typename _base::io_operation_state;
+  using io_operation_state_visitor = typename _base::io_operation_state_visitor;
+  using check_for_any_completed_io_statistics = typename _base::check_for_any_completed_io_statistics;
+  using posix_fs_syscall = typename _base::posix_fs_syscall;
+
+  // The io_uring kernel submission structure
+  struct _io_uring_sqe
+  {
+    uint8_t opcode;  /* type of operation for this sqe */
+    uint8_t flags;   /* IOSQE_ flags */
+    uint16_t ioprio; /* ioprio for the request */
+    int32_t fd;      /* file descriptor to do IO on */
+    union {
+      uint64_t off; /* offset into file */
+      uint64_t addr2;
+    };
+    union {
+      uint64_t addr; /* pointer to buffer or iovecs */
+      uint64_t splice_off_in;
+    };
+    uint32_t len; /* buffer size or number of iovecs */
+    union {
+      __kernel_rwf_t rw_flags;
+      uint32_t fsync_flags;
+      uint16_t poll_events;
+      uint32_t sync_range_flags;
+      uint32_t msg_flags;
+      uint32_t timeout_flags;
+      uint32_t accept_flags;
+      uint32_t cancel_flags;
+      uint32_t open_flags;
+      uint32_t statx_flags;
+      uint32_t fadvise_advice;
+      uint32_t splice_flags;
+      uint32_t rename_flags;
+      uint32_t unlink_flags;
+    };
+    uint64_t user_data; /* data to be passed back at completion time */
+    union {
+      struct
+      {
+        /* pack this to avoid bogus arm OABI complaints */
+        union {
+          /* index into fixed buffers, if used */
+          uint16_t buf_index;
+          /* for grouped buffer selection */
+          uint16_t buf_group;
+        } __attribute__((packed));
+        /* personality to use, if used */
+        uint16_t personality;
+        int32_t splice_fd_in;
+      };
+      uint64_t __pad2[3];
+    };
+  };
+  static_assert(sizeof(_io_uring_sqe) == 64, "_io_uring_sqe is not 64 bytes in size!");
+
+  // sqe->flags
+  /* use fixed fileset */
+  static constexpr uint32_t _IOSQE_FIXED_FILE = (1U << 0);
+  /* issue after inflight IO */
+  static constexpr uint32_t _IOSQE_IO_DRAIN = (1U << 1);
+  /* links next sqe */
+  static constexpr uint32_t _IOSQE_IO_LINK = (1U << 2);
+  /* like LINK, but stronger */
+  static constexpr uint32_t _IOSQE_IO_HARDLINK = (1U << 3);
+  /* always go async */
+  static constexpr uint32_t _IOSQE_ASYNC = (1U << 4);
+  /* select buffer from sqe->buf_group */
+  static constexpr uint32_t _IOSQE_BUFFER_SELECT = (1U << 5);
+
+  // io_uring_setup() flags
+  static constexpr uint32_t _IORING_SETUP_IOPOLL = (1U << 0);    /* io_context is polled */
+  static constexpr uint32_t _IORING_SETUP_SQPOLL = (1U << 1);    /* SQ poll thread */
+  static constexpr uint32_t _IORING_SETUP_SQ_AFF = (1U << 2);    /* sq_thread_cpu is valid */
+  static constexpr uint32_t _IORING_SETUP_CQSIZE = (1U << 3);    /* app defines CQ size */
+  static constexpr uint32_t _IORING_SETUP_CLAMP = (1U << 4);     /* clamp SQ/CQ ring sizes */
+  static constexpr uint32_t _IORING_SETUP_ATTACH_WQ = (1U << 5); /* attach to existing wq */
+
+  // sqe->opcode
+  enum
+  {
+    _IORING_OP_NOP,
+    _IORING_OP_READV,
+    _IORING_OP_WRITEV,
+    _IORING_OP_FSYNC,
+    _IORING_OP_READ_FIXED,
+    _IORING_OP_WRITE_FIXED,
+    _IORING_OP_POLL_ADD,
+    _IORING_OP_POLL_REMOVE,
+    _IORING_OP_SYNC_FILE_RANGE,
+    _IORING_OP_SENDMSG,
+    _IORING_OP_RECVMSG,
+    _IORING_OP_TIMEOUT,
+    _IORING_OP_TIMEOUT_REMOVE,
+    _IORING_OP_ACCEPT,
+    _IORING_OP_ASYNC_CANCEL,
+    _IORING_OP_LINK_TIMEOUT,
+    _IORING_OP_CONNECT,
+    _IORING_OP_FALLOCATE,
+    _IORING_OP_OPENAT,
+    _IORING_OP_CLOSE,
+    _IORING_OP_FILES_UPDATE,
+    _IORING_OP_STATX,
+    _IORING_OP_READ,
+    _IORING_OP_WRITE,
+    _IORING_OP_FADVISE,
+    _IORING_OP_MADVISE,
+    _IORING_OP_SEND,
+    _IORING_OP_RECV,
+    _IORING_OP_OPENAT2,
+    _IORING_OP_EPOLL_CTL,
+    _IORING_OP_SPLICE,
+    _IORING_OP_PROVIDE_BUFFERS,
+    _IORING_OP_REMOVE_BUFFERS,
+    _IORING_OP_TEE,
+    _IORING_OP_SHUTDOWN,
+    _IORING_OP_RENAMEAT,
+    _IORING_OP_UNLINKAT,
+    _IORING_OP_MKDIRAT,
+    _IORING_OP_SYMLINKAT,
+    _IORING_OP_LINKAT,
+    _IORING_OP_MSG_RING,
+    _IORING_OP_FSETXATTR,
+    _IORING_OP_SETXATTR,
+    _IORING_OP_FGETXATTR,
+    _IORING_OP_GETXATTR,
+    _IORING_OP_SOCKET,
+    _IORING_OP_URING_CMD,
+    _IORING_OP_SEND_ZC,
+
+    /* this goes last, obviously */
+    _IORING_OP_LAST,
+  };
+
+  // sqe->fsync_flags
+  static constexpr uint32_t _IORING_FSYNC_DATASYNC = (1U << 0);
+
+  // sqe->timeout_flags
+  static constexpr uint32_t _IORING_TIMEOUT_ABS = (1U << 0);
+
+  // sqe->cancel_flags, both Linux 5.19, which also added IORING_OP_SOCKET
+  static constexpr uint32_t _IORING_ASYNC_CANCEL_ALL = (1U << 0);
+  static constexpr uint32_t _IORING_ASYNC_CANCEL_FD = (1U << 1);
+
+  // sqe->ioprio for SEND, RECV and SEND_ZC
+  static constexpr uint16_t _IORING_RECVSEND_FIXED_BUF = (1U << 2);
+
+  // Zero copy sends are only worth it above this size, below which copying is cheaper than pinning pages
+  static constexpr size_t _zerocopy_send_threshold = 16384;
+
+  // The kernel timespec used by timeouts, which is always 64 bit
+  struct _kernel_timespec
+  {
+    int64_t tv_sec;
+    long long tv_nsec;
+  };
+
+  /*
+   * sqe->splice_flags
+   * extends splice(2) flags
+   */
+  static constexpr uint32_t _SPLICE_F_FD_IN_FIXED = (1U << 31); /* the last bit of uint32_t */
+
+
+  // The io_uring kernel completion structure
+  struct _io_uring_cqe
+  {
+    uint64_t user_data; /* sqe->data submission passed back */
+    int32_t res;        /* result code for this event */
+    uint32_t flags;
+  };
+
+  // cqe->flags
+  // IORING_CQE_F_BUFFER	If set, the upper 16 bits are the buffer ID
+  static constexpr uint32_t _IORING_CQE_F_BUFFER = (1U << 0);
+  // IORING_CQE_F_MORE	If set, another CQE for this request will follow
+  static constexpr uint32_t _IORING_CQE_F_MORE = (1U << 1);
+  // IORING_CQE_F_NOTIF	If set, this is the notification that a zero copy send no longer uses its buffers
+  static constexpr uint32_t _IORING_CQE_F_NOTIF = (1U << 3);
+
+  static constexpr uint32_t _IORING_CQE_BUFFER_SHIFT = 16;
+
+  // Magic offsets for the application to mmap the data it needs
+  static constexpr off_t _IORING_OFF_SQ_RING = (off_t) 0;
+  static constexpr off_t _IORING_OFF_CQ_RING = (off_t) 0x8000000;
+  static constexpr off_t _IORING_OFF_SQES = (off_t) 0x10000000;
+
+  // Filled with the offset for mmap(2)
+  struct _io_sqring_offsets
+  {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t resv1;
+    uint64_t resv2;
+  };
+
+  // sq_ring->flags
+  static constexpr uint32_t _IORING_SQ_NEED_WAKEUP = (1U << 0); /* needs io_uring_enter wakeup */
+
+  struct _io_cqring_offsets
+  {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t overflow;
+    uint32_t cqes;
+    uint64_t resv[2];
+  };
+
+  // io_uring_enter(2) flags
+  static constexpr uint32_t _IORING_ENTER_GETEVENTS = (1U << 0);
+  static constexpr uint32_t _IORING_ENTER_SQ_WAKEUP = (1U << 1);
+
+  // Passed in for io_uring_setup(2). Copied back with updated info on success
+  struct _io_uring_params
+  {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;
+    uint32_t features;
+    uint32_t wq_fd;
+    uint32_t resv[3];
+    struct _io_sqring_offsets sq_off;
+    struct _io_cqring_offsets cq_off;
+  };
+
+  // io_uring_params->features flags
+  static constexpr uint32_t _IORING_FEAT_SINGLE_MMAP = (1U << 0);      // Linux 5.4
+  static constexpr uint32_t _IORING_FEAT_NODROP = (1U << 1);           // Linux 5.5
+  static constexpr uint32_t _IORING_FEAT_SUBMIT_STABLE = (1U << 2);    // Linux 5.5
+  static constexpr uint32_t _IORING_FEAT_RW_CUR_POS = (1U << 3);       // Linux 5.6
+  static constexpr uint32_t _IORING_FEAT_CUR_PERSONALITY = (1U << 4);  // Linux 5.6
+  static constexpr uint32_t _IORING_FEAT_FAST_POLL = (1U << 5);        // Linux 5.7
+  static constexpr uint32_t _IORING_FEAT_POLL_32BITS = (1U << 6);      // Linux 5.9
+  static constexpr uint32_t _IORING_FEAT_SQPOLL_NONFIXED = (1U << 7);  // Linux 5.11
+
+  // io_uring_register(2) opcodes and arguments
+  enum
+  {
+    _IORING_REGISTER_BUFFERS,
+    _IORING_UNREGISTER_BUFFERS,
+    _IORING_REGISTER_FILES,
+    _IORING_UNREGISTER_FILES,
+    _IORING_REGISTER_EVENTFD,
+    _IORING_UNREGISTER_EVENTFD,
+    _IORING_REGISTER_FILES_UPDATE,
+    _IORING_REGISTER_EVENTFD_ASYNC,
+    _IORING_REGISTER_PROBE,
+    _IORING_REGISTER_PERSONALITY,
+    _IORING_UNREGISTER_PERSONALITY
+  };
+  // Linux 5.13 onwards
+  static constexpr unsigned _IORING_REGISTER_FILES2 = 13;
+  // Linux 5.19 onwards
+  static constexpr unsigned _IORING_REGISTER_PBUF_RING = 22;
+  static constexpr unsigned _IORING_UNREGISTER_PBUF_RING = 23;
+
+  struct _io_uring_rsrc_register
+  {
+    uint32_t nr;
+    uint32_t flags;
+    uint64_t resv2;
+    __aligned_u64 data;
+    __aligned_u64 tags;
+  };
+  // _io_uring_rsrc_register->flags, Linux 5.19 onwards
+  static constexpr uint32_t _IORING_RSRC_REGISTER_SPARSE = (1U << 0);
+
+  struct _io_uring_buf_reg
+  {
+    uint64_t ring_addr;
+    uint32_t ring_entries;
+    uint16_t bgid;
+    uint16_t flags;
+    uint64_t resv[3];
+  };
+
+  // An entry in a provided buffer ring. The resv of the first entry is the tail of the ring.
+  struct _io_uring_buf
+  {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t bid;
+    uint16_t resv;
+  };
+
+  struct _io_uring_files_update
+  {
+    uint32_t offset;
+    uint32_t resv;
+    __aligned_u64 /* int32_t * */ fds;
+  };
+
+  static constexpr uint32_t _IO_URING_OP_SUPPORTED = (1U << 0);
+
+  struct _io_uring_probe_op
+  {
+    uint8_t op;
+    uint8_t resv;
+    uint16_t flags; /* IO_URING_OP_* flags */
+    uint32_t resv2;
+  };
+
+  // The kernel's structure ends with a flexible array of _io_uring_probe_op
+  struct _io_uring_probe
+  {
+    uint8_t last_op; /* last opcode supported */
+    uint8_t ops_len; /* length of ops[] array below */
+    uint16_t resv;
+    uint32_t resv2[3];
+  };
+
+  static int _io_uring_setup(unsigned entries, struct _io_uring_params *p)
+  {
+#ifdef __alpha__
+    return (int) syscall(535 /*__NR_io_uring_setup*/, entries, p);
+#else
+    return (int) syscall(425 /*__NR_io_uring_setup*/, entries, p);
+#endif
+  }
+  static int _io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+  {
+#ifdef __alpha__
+    return (int) syscall(537 /*__NR_io_uring_register*/, fd, opcode, arg, nr_args);
+#else
+    return (int) syscall(427 /*__NR_io_uring_register*/, fd, opcode, arg, nr_args);
+#endif
+  }
+  static int _io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+  {
+#ifdef __alpha__
+    return (int) syscall(536 /*__NR_io_uring_enter*/, fd, to_submit, min_complete, flags, nullptr, 0);
+#else
+    return (int) syscall(426 /*__NR_io_uring_enter*/, fd, to_submit, min_complete, flags, nullptr, 0);
+#endif
+  }
+
+  /* The number of submission entries per ring, unless `utils::tuning().io_queue_depth`
+  says otherwise. The completion ring is the larger of twice this and the maximum
+  registered file table. 256 entries is 16Kb of sqe entries per ring.
+  */
+  static constexpr uint32_t _ring_entries = 256;
+  /* The largest and smallest sparse registered file table per ring tried. 1024 is the
+  maximum which all kernels supporting sparse tables will accept. 16384 completion
+  ring entries is 256Kb per ring.
+  */
+  static constexpr uint32_t _max_fixed_files = 16384;
+  static constexpr uint32_t _min_fixed_files = 1024;
+  /* The maximum number of registered i/o buffers, which is the limit
+  in older kernels.
+  */
+  static constexpr size_t _max_registered_buffers = 1024;
+  /* The maximum number of bytes which adjacent writes to the same handle
+  are coalesced into.
+  */
+  static constexpr size_t _max_coalesced_write_bytes = 256 * 1024;
+  /* The number and size of the buffers in the provided buffer ring used by
+  reads of non-seekable handles. 16Kb is a quarter of the default pipe capacity,
+  and the pages of the 4Mb total are only committed when first read into.
+  */
+  static constexpr uint32_t _provided_buffer_count = 256;
+  static constexpr uint32_t _provided_buffer_size = 16384;
+
+  /* Special values for user_data. i/o operation states are always at
+  least eight byte aligned, so we can use the bottom bits as tags.
+  */
+  static constexpr uint64_t _user_data_wakeup = 0;       // the NOP posted by wake_check_for_any_completed_io()
+  static constexpr uint64_t _user_data_internal = 1;     // cancellations and wait timeouts, whose results we don't care about
+  static constexpr uint64_t _user_data_poll_tag = 1;     // bottom bit set on a state pointer means the POLL_ADD for that state
+  static constexpr uint64_t _user_data_timeout_tag = 2;  // second bit set on a state pointer means the LINK_TIMEOUT for that state
+  static constexpr uint64_t _user_data_fs_syscall_tag = 3;  // both bits set means a pointer to a posix_fs_syscall
+  static_assert(alignof(typename _base::posix_fs_syscall) >= 4, "posix_fs_syscall is insufficiently aligned for tagging");
+
+  struct _io_uring_operation_state;
+  /* The gather list of a write sqe into which adjacent writes were coalesced. These are
+  recycled through a free list, and are only freed when the multiplexer is closed.
+  */
+  struct _coalesced_write_t
+  {
+    _coalesced_write_t *next_free{nullptr};
+    _io_uring_operation_state *last{nullptr};  // the last write coalesced
+    extent_type end{0};                        // the offset after the last byte written
+    size_t bytes{0};
+    uint32_t count{0};
+    typename _base::const_buffer_type buffers[IOV_MAX];
+  };
+
+  struct _io_uring_operation_state final : public std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>
+  {
+    using _impl = std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>;
+
+    _io_uring_operation_state *prev{nullptr}, *next{nullptr};
+    // These are cached here from the handle for performance
+    int fd{-1};
+    bool is_seekable{false};
+    // If the i/o has been handed to io_uring (either itself, or its POLL_ADD)
+    bool submitted_to_iouring{false};
+    // If on next submission, a POLL_ADD should be submitted instead
+    bool poll_first{false};
+    // If this is currently a POLL_ADD submitted to io_uring
+    bool polling{false};
+    // If on next submission, IOSQE_ASYNC should be set
+    bool force_async{false};
+    // If cancellation has been requested
+    bool cancel_requested{false};
+    // If the i/o was submitted using a registered i/o buffer
+    bool uses_fixed_buffer{false};
+    // If the read selects a buffer from the provided buffer ring, or must not because the ring ran dry
+    bool uses_provided_buffer{false}, no_provided_buffer{false};
+    // If the write was submitted as SEND_ZC, and if its result awaits the kernel releasing its buffers
+    bool uses_zerocopy_send{false}, awaiting_zerocopy_notification{false};
+    // The cancel_epoch of its fd when submitted to io_uring
+    uint8_t cancel_epoch{0};
+    // The provided buffer selected by the completed read, or -1
+    int provided_buffer{-1};
+    // If the i/o has a deadline, in which case timeout is its absolute CLOCK_MONOTONIC expiry
+    bool has_deadline{false};
+    // If a LINK_TIMEOUT is currently submitted to io_uring
+    bool timeout_linked{false};
+    // If the LINK_TIMEOUT fired
+    bool timed_out{false};
+    // If this write has a barrier linked after it using IOSQE_IO_LINK, or this barrier is linked after a write
+    bool linked_barrier{false}, linked_after_write{false};
+    // If writes following this one were coalesced into its sqe, their combined gather list
+    _coalesced_write_t *coalesced{nullptr};
+    // The next write coalesced into the same sqe as this one
+    _io_uring_operation_state *coalesced_next{nullptr};
+    // If the i/o completed before its LINK_TIMEOUT, and so its completion is deferred
+    bool have_deferred_cqe{false}, deferred_cqe_was_poll{false};
+    int deferred_cqe_res{0};
+    _kernel_timespec timeout{0, 0};
+    // The byte range of the i/o, used to order i/o to seekable handles
+    extent_type range_begin{0}, range_end{0};
+
+    _io_uring_operation_state() = default;
+    // Construct implicitly from the base implementation, see relocate_to()
+    explicit _io_uring_operation_state(_impl &&o) noexcept
+        : _impl(std::move(o))
+    {
+    }
+    using _impl::_impl;
+
+    // You will need to reimplement this to relocate any custom state defined
+    // here, and to restamp to vptr with this finalised dynamic type. It is
+    // important to do this, as final-based optimisations compare the vptr
+    // to the finalised vptr and do non-indirect dispatch if they match.
+    virtual io_operation_state *relocate_to(byte *to_) noexcept override
+    {
+      auto *to = _impl::relocate_to(to_);
+      // restamp the vptr with my own
+      auto _to = new(to) _io_uring_operation_state(std::move(*static_cast<_impl *>(to)));
+      _to->fd = fd;
+      _to->is_seekable = is_seekable;
+      _to->submitted_to_iouring = submitted_to_iouring;
+      _to->poll_first = poll_first;
+      _to->polling = polling;
+      _to->force_async = force_async;
+      _to->cancel_requested = cancel_requested;
+      _to->uses_fixed_buffer = uses_fixed_buffer;
+      _to->uses_provided_buffer = uses_provided_buffer;
+      _to->no_provided_buffer = no_provided_buffer;
+      _to->uses_zerocopy_send = uses_zerocopy_send;
+      _to->awaiting_zerocopy_notification = awaiting_zerocopy_notification;
+      _to->cancel_epoch = cancel_epoch;
+      _to->provided_buffer = provided_buffer;
+      _to->has_deadline = has_deadline;
+      _to->timeout_linked = timeout_linked;
+      _to->timed_out = timed_out;
+      _to->linked_barrier = linked_barrier;
+      _to->linked_after_write = linked_after_write;
+      _to->coalesced = coalesced;
+      _to->coalesced_next = coalesced_next;
+      _to->have_deferred_cqe = have_deferred_cqe;
+      _to->deferred_cqe_was_poll = deferred_cqe_was_poll;
+      _to->deferred_cqe_res = deferred_cqe_res;
+      _to->timeout = timeout;
+      _to->range_begin = range_begin;
+      _to->range_end = range_end;
+      return _to;
+    }
+  };
+
+  // Coroutine awaitables store the i/o state inline, falling back to blocking i/o if it does not fit
+  static_assert(sizeof(_io_uring_operation_state) <= io_multiplexer::awaitable<io_result<buffers_type>>::_state_storage_bytes, "i/o state does not fit into an awaitable!");
+
+  struct _registered_fd
+  {
+    int fd{-1};     // -1 if this slot is not registered
+    int fixed{-1};  // index into the ring's registered file table, or -1
+    bool is_seekable{false};
+    bool is_iopolled{false};                // if registered with the IOPOLL ring
+    bool iopoll_unsupported{false};         // if the device turned out to not support polled i/o
+    bool is_pending{false};                 // if in its ring's pending list
+    bool ignore_overlapping_ranges{false};  // if handle::flag::disable_posix_concurrency_guarantees was set
+    uint8_t cancel_epoch{0};                // incremented by each cancellation of all the i/o to the fd
+    struct queue_t
+    {
+      _io_uring_operation_state *first{nullptr}, *last{nullptr};
+    };
+    // contains initiated i/o not yet submitted to io_uring. state->submitted_to_iouring will be false.
+    queue_t enqueued;
+    // For seekable devices, contains i/o submitted to io_uring, whose ranges block overlapping i/o.
+    queue_t inflight;
+    // For seekable devices, there can be multiple, concurrent, reads and writes.
+    // For non-seekable devices, there is only one read and one write submitted per file descriptor at a time.
+    uint32_t inprogress_reads{0}, inprogress_writes{0};
+  };
+  struct _submission_completion_t
+  {
+    int fd{-1};
+    bool have_fixed_files{false};
+    bool have_registered_buffers{false};
+    struct submission_t
+    {
+      std::atomic<uint32_t> *head{nullptr}, *tail{nullptr}, *flags{nullptr}, *dropped{nullptr};
+      uint32_t ring_mask{0}, ring_entries{0};
+      span<byte> region;  // refers to the mmapped region, used to munmap on close
+      span<_io_uring_sqe> entries;
+      uint32_t *array{nullptr};
+      uint32_t local_tail{0};   // sqes filled but not yet published to the kernel lie between *tail and this
+      uint32_t unsubmitted{0};  // sqes published but not yet consumed by io_uring_enter()
+    } submission;
+    struct completion_t
+    {
+      std::atomic<uint32_t> *head{nullptr}, *tail{nullptr}, *overflow{nullptr};
+      uint32_t ring_mask{0}, ring_entries{0};
+      span<byte> region;  // empty if the completion ring shares the submission ring mmap
+      _io_uring_cqe *entries{nullptr};
+    } completion;
+    // sqes filled whose cqe has not been reaped yet. Never exceeds completion.ring_entries.
+    uint32_t outstanding{0};
+    // The number of fds registered to use this ring
+    size_t registered{0};
+    // The slots in the registered file table, those never used lying at and after next_fixed_file
+    uint32_t fixed_files{0}, next_fixed_file{0};
+    std::vector<int32_t> free_fixed_files;
+    // fds with enqueued i/o which could not be submitted due to lack of ring space
+    std::vector<int> pending;
+    // The timeout used by check_for_any_completed_io(), which must outlive submission
+    _kernel_timespec wait_timeout{0, 0};
+    // The most recently filled sqe if it was for a write and has not been published yet, so a barrier can be linked after it
+    _io_uring_sqe *last_write_sqe{nullptr};
+    _io_uring_operation_state *last_write_state{nullptr};
+  };
+
+  const bool _is_polling{false};
+  const linux_io_uring_sqpoll_config _sqpoll;
+  // Statistics, which may be read without the lock
+  std::atomic<uint64_t> _flushes_without_syscall{0}, _flushes_with_syscall{0}, _sqpoll_wakeups{0}, _linked_barriers{0}, _coalesced_writes{0};
+  uint32_t _features{0};
+  bool _have_probe{false};  // Linux 5.6 onwards, which also implies IOSQE_ASYNC
+  std::bitset<256> _supported_ops;
+  _submission_completion_t _nonseekable, _seekable, _iopoll;
+  std::vector<_registered_fd> _registered_fds;  // indexed by fd
+  std::vector<registered_buffer_type> _registered_buffers;  // index is the registered buffer index
+  struct _registered_buffer_index_t
+  {
+    const byte *data;
+    uint16_t idx;
+  };
+  std::vector<_registered_buffer_index_t> _registered_buffers_index;  // ordered by data so can be binary searched
+  size_t _fixed_buffers_inflight{0};
+  _coalesced_write_t *_coalesced_write_free{nullptr};  // free list of gather lists for coalesced writes
+  struct _provided_buffers_t
+  {
+    span<byte> region;  // the mmapped ring followed by the buffers, empty if not registered
+    _io_uring_buf *ring{nullptr};
+    byte *buffers{nullptr};
+    uint16_t tail{0};
+  } _provided;  // registered with the non-seekable ring as buffer group zero
+  bool _woken{false};  // set when the wakeup NOP is reaped
+
+  // Returns the registered buffer index if the single buffer lies within the registered buffer, else -1
+  int _fixed_buffer_index(const _submission_completion_t &ring, const registered_buffer_type &base, const byte *data, size_t len) const noexcept
+  {
+    if(!base || !ring.have_registered_buffers)
+    {
+      return -1;
+    }
+    auto it = std::lower_bound(_registered_buffers_index.begin(), _registered_buffers_index.end(), base->data(),
+                               [](const _registered_buffer_index_t &a, const byte *b) { return a.data < b; });
+    if(it == _registered_buffers_index.end() || it->data != base->data())
+    {
+      return -1;
+    }
+    if(data < base->data() || data + len > base->data() + base->size())
+    {
+      return -1;
+    }
+    return it->idx;
+  }
+
+  // The ring the fd is registered with, whose registered file table and pending list it uses
+  _submission_completion_t &_ring_for(const _registered_fd &rfd) noexcept { return rfd.is_iopolled ? _iopoll : (rfd.is_seekable ? _seekable : _nonseekable); }
+  // The ring a particular i/o is submitted to. IOPOLL rings can only execute reads and writes, and cannot execute LINK_TIMEOUT.
+  _submission_completion_t &_ring_for(const _registered_fd &rfd, const _io_uring_operation_state *state) noexcept
+  {
+    if(rfd.is_iopolled && !rfd.iopoll_unsupported)
+    {
+      const bool is_read_or_write = (state->state == io_operation_state_type::read_initiated || state->state == io_operation_state_type::write_initiated);
+      return (is_read_or_write && !state->has_deadline) ? _iopoll : _seekable;
+    }
+    return rfd.is_seekable ? _seekable : _nonseekable;
+  }
+
+  static void _enqueue_to(typename _registered_fd::queue_t &queue, _io_uring_operation_state *state) noexcept
+  {
+    assert(state->prev == nullptr);
+    assert(state->next == nullptr);
+    assert(queue.first != state);
+    assert(queue.last != state);
+    if(queue.first == nullptr)
+    {
+      queue.first = queue.last = state;
+    }
+    else
+    {
+      assert(queue.last->next == nullptr);
+      state->prev = queue.last;
+      queue.last->next = state;
+      queue.last = state;
+    }
+  }
+  static void _enqueue_front_to(typename _registered_fd::queue_t &queue, _io_uring_operation_state *state) noexcept
+  {
+    assert(state->prev == nullptr);
+    assert(state->next == nullptr);
+    if(queue.first == nullptr)
+    {
+      queue.first = queue.last = state;
+    }
+    else
+    {
+      assert(queue.first->prev == nullptr);
+      state->next = queue.first;
+      queue.first->prev = state;
+      queue.first = state;
+    }
+  }
+  static void _enqueue_after(typename _registered_fd::queue_t &queue, _io_uring_operation_state *after, _io_uring_operation_state *state) noexcept
+  {
+    assert(state->prev == nullptr);
+    assert(state->next == nullptr);
+    state->prev = after;
+    state->next = after->next;
+    if(after->next == nullptr)
+    {
+      assert(queue.last == after);
+      queue.last = state;
+    }
+    else
+    {
+      after->next->prev = state;
+    }
+    after->next = state;
+  }
+  static void _dequeue_from(typename _registered_fd::queue_t &queue, _io_uring_operation_state *state) noexcept
+  {
+    if(state->prev == nullptr)
+    {
+      assert(queue.first == state);
+      queue.first = state->next;
+    }
+    else
+    {
+      state->prev->next = state->next;
+    }
+    if(state->next == nullptr)
+    {
+      assert(queue.last == state);
+      queue.last = state->prev;
+    }
+    else
+    {
+      state->next->prev = state->prev;
+    }
+    state->next = state->prev = nullptr;
+  }
+
+  /* Returns a zeroed sqe to fill, or null if the ring is out of space. If reserve is
+  more than one, the sqe is only returned if that many could be obtained, and the
+  caller is guaranteed to be able to obtain the remainder. Must be called with the
+  lock held.
+  */
+  _io_uring_sqe *_get_sqe(_submission_completion_t &ring, uint32_t reserve = 1) noexcept
+  {
+    if(ring.outstanding + reserve > ring.completion.ring_entries)
+    {
+      // Submitting any more could overflow the completion ring
+      return nullptr;
+    }
+    if(ring.submission.local_tail - ring.submission.head->load(std::memory_order_acquire) + reserve > ring.submission.ring_entries)
+    {
+      // Ask the kernel to consume what we have submitted so far
+      (void) _flush_ring(ring);
+      if(ring.submission.local_tail - ring.submission.head->load(std::memory_order_acquire) + reserve > ring.submission.ring_entries)
+      {
+        return nullptr;
+      }
+    }
+    _io_uring_sqe *sqe = &ring.submission.entries[ring.submission.local_tail & ring.submission.ring_mask];
+    memset(sqe, 0, sizeof(_io_uring_sqe));
+    ++ring.submission.local_tail;
+    ++ring.outstanding;
+    ring.last_write_sqe = nullptr;
+    ring.last_write_state = nullptr;
+    return sqe;
+  }
+
+  // Publishes all filled sqes to the kernel, and tells the kernel about them. Must be called with the lock held.
+  result<void> _flush_ring(_submission_completion_t &ring) noexcept
+  {
+    if(ring.fd == -1)
+    {
+      return success();
+    }
+    const uint32_t tail = ring.submission.tail->load(std::memory_order_relaxed);
+    const bool published = (tail != ring.submission.local_tail);
+    if(published)
+    {
+      // Published sqes may be consumed by the kernel at any time, so can no longer be modified
+      ring.last_write_sqe = nullptr;
+      ring.last_write_state = nullptr;
+      ring.submission.unsubmitted += ring.submission.local_tail - tail;
+      ring.submission.tail->store(ring.submission.local_tail, std::memory_order_release);
+    }
+    if(_is_polling)
+    {
+      // The kernel thread consumes sqes for us, but it may have gone to sleep
+      ring.submission.unsubmitted = 0;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if((ring.submission.flags->load(std::memory_order_relaxed) & _IORING_SQ_NEED_WAKEUP) != 0)
+      {
+        _sqpoll_wakeups.fetch_add(1, std::memory_order_relaxed);
+        _flushes_with_syscall.fetch_add(1, std::memory_order_relaxed);
+        if(_io_uring_enter(ring.fd, 0, 0, _IORING_ENTER_SQ_WAKEUP) < 0)
+        {
+          return posix_error();
+        }
+        return success();
+      }
+      if(published)
+      {
+        _flushes_without_syscall.fetch_add(1, std::memory_order_relaxed);
+      }
+      return success();
+    }
+    if(ring.submission.unsubmitted > 0)
+    {
+      _flushes_with_syscall.fetch_add(1, std::memory_order_relaxed);
+    }
+    while(ring.submission.unsubmitted > 0)
+    {
+      int ret = _io_uring_enter(ring.fd, ring.submission.unsubmitted, 0, 0);
+      if(ret < 0)
+      {
+        if(EINTR == errno)
+        {
+          continue;
+        }
+        if(EAGAIN == errno || EBUSY == errno)
+        {
+          // The kernel is temporarily out of resources, try again later
+          return success();
+        }
+        return posix_error();
+      }
+      if(ret == 0)
+      {
+        break;
+      }
+      ring.submission.unsubmitted -= (uint32_t) ret;
+    }
+    return success();
+  }
+
+  // Links a LINK_TIMEOUT for the state's deadline to the sqe just filled. Space for it must have been reserved.
+  void _link_timeout_to(_submission_completion_t &ring, _io_uring_sqe *sqe, _io_uring_operation_state *state) noexcept
+  {
+    sqe->flags |= _IOSQE_IO_LINK;
+    _io_uring_sqe *tsqe = _get_sqe(ring);
+    assert(tsqe != nullptr);
+    tsqe->opcode = _IORING_OP_LINK_TIMEOUT;
+    tsqe->fd = -1;
+    tsqe->addr = (uint64_t)(uintptr_t) &state->timeout;
+    tsqe->len = 1;
+    tsqe->timeout_flags = _IORING_TIMEOUT_ABS;
+    tsqe->user_data = (uint64_t)(uintptr_t) state | _user_data_timeout_tag;
+    state->timeout_linked = true;
+  }
+
+  // True if the write is to a socket, single buffer, and large enough to be worth sending with SEND_ZC
+  bool _is_zerocopy_send_candidate(_io_uring_operation_state *state) const noexcept
+  {
+    if(state->state != io_operation_state_type::write_initiated || !_supported_ops[_IORING_OP_SEND_ZC] || !state->h->is_socket())
+    {
+      return false;
+    }
+    auto &reqs = state->payload.noncompleted.params.write.reqs;
+    return reqs.buffers.size() == 1 && reqs.buffers[0].size() >= _zerocopy_send_threshold;
+  }
+
+  // Fills a sqe for the i/o. Returns false if the ring is out of space. Must be called with the lock held.
+  bool _submit_state(_submission_completion_t &ring, _registered_fd &rfd, _io_uring_operation_state *state) noexcept
+  {
+    const bool link_timeout = state->has_deadline && _supported_ops[_IORING_OP_LINK_TIMEOUT];
+    // A zero copy send completes twice, so it needs an extra completion ring entry
+    const bool zerocopy_send = !state->poll_first && !state->has_deadline && _is_zerocopy_send_candidate(state);
+    _io_uring_sqe *sqe = _get_sqe(ring, (link_timeout ? 2 : 1) + (zerocopy_send ? 1 : 0));
+    if(sqe == nullptr)
+    {
+      return false;
+    }
+    if(rfd.fixed >= 0 && &ring == &_ring_for(rfd))
+    {
+      // The fd is only in the registered file table of the ring it is registered with
+      sqe->fd = rfd.fixed;
+      sqe->flags |= _IOSQE_FIXED_FILE;
+    }
+    else
+    {
+      sqe->fd = state->fd;
+    }
+    state->submitted_to_iouring = true;
+    state->cancel_epoch = rfd.cancel_epoch;
+    if(state->poll_first)
+    {
+      // Wait until the handle becomes ready, then we'll resubmit the i/o
+      state->poll_first = false;
+      state->polling = true;
+      sqe->opcode = _IORING_OP_POLL_ADD;
+      sqe->poll_events = (uint16_t)((state->state == io_operation_state_type::read_initiated) ? (POLLIN | POLLERR) : (POLLOUT | POLLERR));
+      sqe->user_data = (uint64_t)(uintptr_t) state | _user_data_poll_tag;
+      if(link_timeout)
+      {
+        _link_timeout_to(ring, sqe, state);
+      }
+      return true;
+    }
+    sqe->user_data = (uint64_t)(uintptr_t) state;
+    if(state->force_async)
+    {
+      state->force_async = false;
+      sqe->flags |= _IOSQE_ASYNC;
+    }
+    switch(state->state)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      // Offsets other than zero are rejected for non-seekable handles by older kernels
+      sqe->off = state->is_seekable ? reqs.offset : 0;
+      // io_uring always first attempts i/o without blocking, so RWF_NOWAIT would only turn misses into failures
+      sqe->rw_flags = detail::rwf_from_io_request_flags(reqs.flags, false) & ~0x00000008 /*RWF_NOWAIT*/;
+      sqe->ioprio = detail::ioprio_from_priority(state->h->effective_priority(reqs.flags));
+      const int idx = (reqs.buffers.size() == 1) ? _fixed_buffer_index(ring, state->payload.noncompleted.base, reqs.buffers[0].data(), reqs.buffers[0].size()) : -1;
+      size_t bytes = 0;
+      for(auto &b : reqs.buffers)
+      {
+        bytes += b.size();
+      }
+      if(idx < 0 && bytes > 0 && !state->is_seekable && !state->no_provided_buffer && &ring == &_nonseekable && _provided.ring != nullptr)
+      {
+        // The kernel takes a buffer from the provided buffer ring when data arrives
+        sqe->opcode = _IORING_OP_READ;
+        sqe->flags |= _IOSQE_BUFFER_SELECT;
+        sqe->addr = 0;
+        sqe->len = (uint32_t) std::min<size_t>(bytes, _provided_buffer_size);
+        sqe->buf_group = 0;
+        state->uses_provided_buffer = true;
+      }
+      else if(idx >= 0)
+      {
+        sqe->opcode = _IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers[0].data();
+        sqe->len = (uint32_t) reqs.buffers[0].size();
+        sqe->buf_index = (uint16_t) idx;
+        state->uses_fixed_buffer = true;
+        ++_fixed_buffers_inflight;
+      }
+      else if(reqs.buffers.size() == 1 && state->h->is_socket() && _supported_ops[_IORING_OP_RECV])
+      {
+        sqe->opcode = _IORING_OP_RECV;
+        sqe->ioprio = 0;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers[0].data();
+        sqe->len = (uint32_t) reqs.buffers[0].size();
+        sqe->msg_flags = 0;
+      }
+      else
+      {
+        sqe->opcode = _IORING_OP_READV;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers.data();
+        sqe->len = (uint32_t) reqs.buffers.size();
+      }
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      sqe->off = state->is_seekable ? reqs.offset : 0;
+      sqe->rw_flags = detail::rwf_from_io_request_flags(reqs.flags, true) & ~0x00000008 /*RWF_NOWAIT*/;
+      sqe->ioprio = detail::ioprio_from_priority(state->h->effective_priority(reqs.flags));
+      const int idx = (reqs.buffers.size() == 1) ? _fixed_buffer_index(ring, state->payload.noncompleted.base, reqs.buffers[0].data(), reqs.buffers[0].size()) : -1;
+      if(zerocopy_send)
+      {
+        // The kernel sends straight from our buffers, and tells us when it is done with them
+        sqe->opcode = _IORING_OP_SEND_ZC;
+        sqe->ioprio = 0;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers[0].data();
+        sqe->len = (uint32_t) reqs.buffers[0].size();
+        sqe->msg_flags = MSG_NOSIGNAL;
+        if(idx >= 0)
+        {
+          sqe->ioprio = _IORING_RECVSEND_FIXED_BUF;
+          sqe->buf_index = (uint16_t) idx;
+          state->uses_fixed_buffer = true;
+          ++_fixed_buffers_inflight;
+        }
+        state->uses_zerocopy_send = true;
+        ++ring.outstanding;
+      }
+      else if(idx >= 0)
+      {
+        sqe->opcode = _IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers[0].data();
+        sqe->len = (uint32_t) reqs.buffers[0].size();
+        sqe->buf_index = (uint16_t) idx;
+        state->uses_fixed_buffer = true;
+        ++_fixed_buffers_inflight;
+      }
+      else if(reqs.buffers.size() == 1 && state->h->is_socket() && _supported_ops[_IORING_OP_SEND])
+      {
+        // Unlike WRITEV, this can suppress SIGPIPE
+        sqe->opcode = _IORING_OP_SEND;
+        sqe->ioprio = 0;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers[0].data();
+        sqe->len = (uint32_t) reqs.buffers[0].size();
+        sqe->msg_flags = MSG_NOSIGNAL;
+      }
+      else
+      {
+        sqe->opcode = _IORING_OP_WRITEV;
+        sqe->addr = (uint64_t)(uintptr_t) reqs.buffers.data();
+        sqe->len = (uint32_t) reqs.buffers.size();
+      }
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.barrier.reqs;
+      const auto kind = state->payload.noncompleted.params.barrier.kind;
+      // Ordering against preceding and subsequent writes is enforced by _submit_enqueued()
+      if(kind <= barrier_kind::wait_data_only && _supported_ops[_IORING_OP_SYNC_FILE_RANGE])
+      {
+        // Linux has a lovely dedicated syscall giving us exactly what we need here
+        sqe->opcode = _IORING_OP_SYNC_FILE_RANGE;
+        sqe->off = reqs.offset;
+        // empty buffers means bytes = 0 which means sync entire file
+        uint64_t bytes = 0;
+        for(const auto &req : reqs.buffers)
+        {
+          bytes += req.size();
+        }
+        // The length is only 32 bits, so sync to the end of the file if it overflows
+        sqe->len = (bytes > (uint32_t) -1) ? 0 : (uint32_t) bytes;
+        sqe->sync_range_flags = SYNC_FILE_RANGE_WRITE;  // start writing all dirty pages in range now
+        if(kind == barrier_kind::wait_data_only)
+        {
+          sqe->sync_range_flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;  // block until they're on storage
+        }
+      }
+      else
+      {
+        sqe->opcode = _IORING_OP_FSYNC;
+        if(kind <= barrier_kind::wait_data_only)
+        {
+          sqe->fsync_flags = _IORING_FSYNC_DATASYNC;
+        }
+      }
+      break;
+    }
+    }
+    if(link_timeout)
+    {
+      _link_timeout_to(ring, sqe, state);
+    }
+    else if(state->state == io_operation_state_type::write_initiated)
+    {
+      state->linked_barrier = false;
+      ring.last_write_sqe = sqe;
+      ring.last_write_state = state;
+    }
+    return true;
+  }
+
+  // True if the two i/o must not execute concurrently, because they overlap and one is not a read
+  static bool _conflicts(const _registered_fd &rfd, const _io_uring_operation_state *a, const _io_uring_operation_state *b) noexcept
+  {
+    const bool a_is_read = (a->state == io_operation_state_type::read_initiated);
+    const bool b_is_read = (b->state == io_operation_state_type::read_initiated);
+    if(a_is_read && b_is_read)
+    {
+      return false;
+    }
+    const bool a_is_barrier = (a->state == io_operation_state_type::barrier_initiated);
+    const bool b_is_barrier = (b->state == io_operation_state_type::barrier_initiated);
+    if(rfd.ignore_overlapping_ranges && !a_is_barrier && !b_is_barrier)
+    {
+      return false;
+    }
+    return a->range_begin < b->range_end && b->range_begin < a->range_end;
+  }
+
+  // True if the i/o to a seekable handle conflicts with i/o in flight, or with i/o enqueued before it
+  static bool _is_blocked_seekable(const _registered_fd &rfd, const _io_uring_operation_state *state) noexcept
+  {
+    for(const _io_uring_operation_state *i = rfd.inflight.first; i != nullptr; i = i->next)
+    {
+      if(_conflicts(rfd, i, state))
+      {
+        return true;
+      }
+    }
+    for(const _io_uring_operation_state *i = rfd.enqueued.first; i != state; i = i->next)
+    {
+      if(_conflicts(rfd, i, state))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /* If the write is adjacent to the write whose sqe was the last filled, and that sqe has
+  not been published yet, appends the write's buffers to that sqe's gather list so both
+  are submitted as a single write. Returns false if the write could not be coalesced.
+  Must be called with the lock held.
+  */
+  bool _coalesce_write(_submission_completion_t &ring, _io_uring_operation_state *state) noexcept
+  {
+    if(state->state != io_operation_state_type::write_initiated || state->has_deadline || state->force_async || ring.last_write_sqe == nullptr)
+    {
+      return false;
+    }
+    _io_uring_operation_state *leader = ring.last_write_state;
+    _io_uring_sqe *sqe = ring.last_write_sqe;
+    if(leader->fd != state->fd || sqe->opcode != _IORING_OP_WRITEV || (sqe->flags & _IOSQE_ASYNC) != 0)
+    {
+      return false;
+    }
+    const auto &reqs = state->payload.noncompleted.params.write.reqs;
+    const size_t bytes = (size_t)(state->range_end - state->range_begin);
+    _coalesced_write_t *c = leader->coalesced;
+    if(c == nullptr)
+    {
+      const auto &leader_reqs = leader->payload.noncompleted.params.write.reqs;
+      if(leader->range_end != state->range_begin || leader_reqs.buffers.size() + reqs.buffers.size() > IOV_MAX ||
+         (size_t)(leader->range_end - leader->range_begin) + bytes > _max_coalesced_write_bytes)
+      {
+        return false;
+      }
+      if(_coalesced_write_free != nullptr)
+      {
+        c = _coalesced_write_free;
+        _coalesced_write_free = c->next_free;
+        c->next_free = nullptr;
+      }
+      else
+      {
+        c = new(std::nothrow) _coalesced_write_t;
+        if(c == nullptr)
+        {
+          return false;
+        }
+      }
+      c->last = leader;
+      c->end = leader->range_end;
+      c->bytes = (size_t)(leader->range_end - leader->range_begin);
+      c->count = (uint32_t) leader_reqs.buffers.size();
+      memcpy(c->buffers, leader_reqs.buffers.data(), leader_reqs.buffers.size() * sizeof(c->buffers[0]));
+      leader->coalesced = c;
+      sqe->addr = (uint64_t)(uintptr_t) c->buffers;
+    }
+    else if(c->end != state->range_begin || c->count + reqs.buffers.size() > IOV_MAX || c->bytes + bytes > _max_coalesced_write_bytes)
+    {
+      return false;
+    }
+    memcpy(c->buffers + c->count, reqs.buffers.data(), reqs.buffers.size() * sizeof(c->buffers[0]));
+    c->count += (uint32_t) reqs.buffers.size();
+    c->bytes += bytes;
+    c->end = state->range_end;
+    c->last->coalesced_next = state;
+    c->last = state;
+    sqe->len = c->count;
+    state->submitted_to_iouring = true;
+    state->cancel_epoch = leader->cancel_epoch;
+    _coalesced_writes.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /* If a barrier is blocked only by the write whose sqe was the last filled, and that sqe
+  has not been published yet, returns that write so the barrier can be linked after it using
+  IOSQE_IO_LINK, which submits both together with the kernel executing the barrier after
+  the write. Else returns null. Must be called with the lock held.
+  */
+  _io_uring_operation_state *_linkable_write_before(_submission_completion_t &ring, const _registered_fd &rfd, const _io_uring_operation_state *state) noexcept
+  {
+    if(state->state != io_operation_state_type::barrier_initiated || state->has_deadline || ring.last_write_sqe == nullptr)
+    {
+      return nullptr;
+    }
+    _io_uring_operation_state *write = ring.last_write_state;
+    if(write->fd != state->fd)
+    {
+      return nullptr;
+    }
+    // Filling the barrier's sqe must not cause the write's sqe to be published
+    if(ring.outstanding + 1 > ring.completion.ring_entries ||
+       ring.submission.local_tail - ring.submission.head->load(std::memory_order_acquire) + 1 > ring.submission.ring_entries)
+    {
+      return nullptr;
+    }
+    auto is_part_of_write = [write](const _io_uring_operation_state *i) {
+      for(const _io_uring_operation_state *x = write; x != nullptr; x = x->coalesced_next)
+      {
+        if(x == i)
+        {
+          return true;
+        }
+      }
+      return false;
+    };
+    for(const _io_uring_operation_state *i = rfd.inflight.first; i != nullptr; i = i->next)
+    {
+      if(_conflicts(rfd, i, state) && !is_part_of_write(i))
+      {
+        return nullptr;
+      }
+    }
+    for(const _io_uring_operation_state *i = rfd.enqueued.first; i != state; i = i->next)
+    {
+      if(_conflicts(rfd, i, state))
+      {
+        return nullptr;
+      }
+    }
+    return write;
+  }
+
+  // Submits as much enqueued i/o for a fd as ordering permits. Returns false if the ring ran out of space.
+  bool _submit_enqueued(_registered_fd &rfd) noexcept
+  {
+    auto &ring = _ring_for(rfd);
+    if(rfd.is_seekable)
+    {
+      for(_io_uring_operation_state *state = rfd.enqueued.first, *next = nullptr; state != nullptr; state = next)
+      {
+        next = state->next;
+        auto &state_ring = _ring_for(rfd, state);
+        _io_uring_operation_state *link_after = nullptr;
+        if(_is_blocked_seekable(rfd, state) && nullptr == (link_after = _linkable_write_before(state_ring, rfd, state)))
+        {
+          continue;
+        }
+        if(link_after == nullptr && _coalesce_write(state_ring, state))
+        {
+          _dequeue_from(rfd.enqueued, state);
+          _enqueue_to(rfd.inflight, state);
+          ++rfd.inprogress_writes;
+          continue;
+        }
+        if(link_after != nullptr)
+        {
+          // Space was checked above, so the barrier's sqe is guaranteed to immediately follow the write's
+          state_ring.last_write_sqe->flags |= _IOSQE_IO_LINK;
+          link_after->linked_barrier = true;
+          state->linked_after_write = true;
+          _linked_barriers.fetch_add(1, std::memory_order_relaxed);
+        }
+        if(!_submit_state(state_ring, rfd, state))
+        {
+          assert(link_after == nullptr);
+          return false;
+        }
+        _dequeue_from(rfd.enqueued, state);
+        _enqueue_to(rfd.inflight, state);
+        (state->state == io_operation_state_type::read_initiated) ? ++rfd.inprogress_reads : ++rfd.inprogress_writes;
+      }
+      return true;
+    }
+    bool reads_blocked = !rfd.is_seekable && rfd.inprogress_reads > 0;
+    bool writes_blocked = !rfd.is_seekable && rfd.inprogress_writes > 0;
+    for(_io_uring_operation_state *state = rfd.enqueued.first, *next = nullptr; state != nullptr; state = next)
+    {
+      next = state->next;
+      const bool is_read = (state->state == io_operation_state_type::read_initiated);
+      if(is_read ? reads_blocked : writes_blocked)
+      {
+        if(reads_blocked && writes_blocked)
+        {
+          break;
+        }
+        continue;
+      }
+      if(!_submit_state(ring, rfd, state))
+      {
+        return false;
+      }
+      _dequeue_from(rfd.enqueued, state);
+      if(is_read)
+      {
+        ++rfd.inprogress_reads;
+        reads_blocked = !rfd.is_seekable;
+      }
+      else
+      {
+        ++rfd.inprogress_writes;
+        writes_blocked = !rfd.is_seekable;
+      }
+    }
+    return true;
+  }
+
+  // As above, but adds the fd to the ring's pending list if the ring ran out of space
+  void _submit_enqueued_or_pend(_registered_fd &rfd) noexcept
+  {
+    if(!_submit_enqueued(rfd) && !rfd.is_pending)
+    {
+      // Capacity was reserved during registration, so this never allocates
+      _ring_for(rfd).pending.push_back(rfd.fd);
+      rfd.is_pending = true;
+    }
+  }
+
+  // Submits i/o from the fds waiting on ring space, and flushes the ring
+  result<void> _submit_pending(_submission_completion_t &ring) noexcept
+  {
+    size_t n = 0, i = 0;
+    for(; i < ring.pending.size(); i++)
+    {
+      auto &rfd = _registered_fds[ring.pending[i]];
+      if(!_submit_enqueued(rfd))
+      {
+        break;
+      }
+      rfd.is_pending = false;
+    }
+    for(; i < ring.pending.size(); i++)
+    {
+      ring.pending[n++] = ring.pending[i];
+    }
+    ring.pending.resize(n);
+    return _flush_ring(ring);
+  }
+
+  result<void> _submit_all() noexcept
+  {
+    OUTCOME_TRY(_submit_pending(_nonseekable));
+    OUTCOME_TRY(_submit_pending(_seekable));
+    OUTCOME_TRY(_submit_pending(_iopoll));
+    return success();
+  }
+
+  // i/o submitted before a cancellation of all the i/o to its fd, and cancelled by it, is treated as if individually cancelled
+  static void _note_cancelled_by_fd(const _registered_fd &rfd, _io_uring_operation_state *state, int res) noexcept
+  {
+    if(state->cancel_epoch != rfd.cancel_epoch && (-ECANCELED == res || -EINTR == res))
+    {
+      state->cancel_requested = true;
+    }
+  }
+
+  // Completes and finishes an i/o. Must be called WITHOUT the lock held, and the state must not be touched afterwards.
+  void _complete(_io_uring_operation_state *state, io_operation_state_type s, int res) noexcept
+  {
+    const bool was_cancelled = state->cancel_requested && (-ECANCELED == res || -EINTR == res);
+    const bool was_timed_out = state->timed_out && (-ECANCELED == res || -EINTR == res);
+    auto set_error = [&](auto &ret) {
+      if(was_cancelled)
+      {
+        ret = errc::operation_canceled;
+      }
+      else if(was_timed_out)
+      {
+        ret = errc::timed_out;
+      }
+      else
+      {
+        ret = posix_error(-res);
+      }
+    };
+    auto trim = [res](auto &buffers) {
+      size_t bytes = (size_t) res;
+      for(size_t i = 0; i < buffers.size(); i++)
+      {
+        auto &buffer = buffers[i];
+        if(buffer.size() <= bytes)
+        {
+          bytes -= buffer.size();
+        }
+        else
+        {
+          buffer = {buffer.data(), (size_type) bytes};
+          buffers = {buffers.data(), i + 1};
+          break;
+        }
+      }
+    };
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      io_result<buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->read_completed(std::move(ret));
+      state->read_finished();
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->write_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.barrier.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      state->barrier_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    }
+  }
+
+  /* Splits the completion of a write into which adjacent writes were coalesced back into the
+  writes, completing each individually with its share of the bytes written. Writes which were
+  not reached by a short write, or which need resubmitting, are requeued in their original order.
+  Must be called with the lock held. Returns the number of writes completed.
+  */
+  size_t _reap_coalesced(_multiplexer_lock_guard &g, _submission_completion_t &ring, _registered_fd &rfd, _io_uring_operation_state *leader, int res) noexcept
+  {
+    _coalesced_write_t *c = leader->coalesced;
+    leader->coalesced = nullptr;
+    c->next_free = _coalesced_write_free;
+    _coalesced_write_free = c;
+    const bool had_linked_barrier = leader->linked_barrier;
+    leader->linked_barrier = false;
+    const bool requeue_all = (-EAGAIN == res) || (-EOPNOTSUPP == res && &ring == &_iopoll && !rfd.iopoll_unsupported);
+    if(-EOPNOTSUPP == res && &ring == &_iopoll)
+    {
+      rfd.iopoll_unsupported = true;
+    }
+    // Both lists are built in reverse order
+    _io_uring_operation_state *tocomplete = nullptr, *torequeue = nullptr;
+    size_t remaining = (res > 0) ? (size_t) res : 0, count = 0;
+    bool reached_end = false;
+    for(_io_uring_operation_state *state = leader, *next = nullptr; state != nullptr; state = next)
+    {
+      next = state->coalesced_next;
+      state->coalesced_next = nullptr;
+      state->submitted_to_iouring = false;
+      _dequeue_from(rfd.inflight, state);
+      --rfd.inprogress_writes;
+      _note_cancelled_by_fd(rfd, state, res);
+      bool requeue = requeue_all || (-ECANCELED == res && !state->cancel_requested);
+      if(!requeue && res >= 0)
+      {
+        // The first write always completes, subsequent writes not reached by a short write are resubmitted
+        const size_t bytes = (size_t)(state->range_end - state->range_begin);
+        requeue = reached_end || (state != leader && remaining == 0);
+        if(!requeue)
+        {
+          state->deferred_cqe_res = (int) std::min(remaining, bytes);
+          remaining -= (size_t) state->deferred_cqe_res;
+          reached_end = ((size_t) state->deferred_cqe_res < bytes);
+        }
+      }
+      else
+      {
+        state->deferred_cqe_res = res;
+      }
+      if(requeue)
+      {
+        if(-EAGAIN == res)
+        {
+          (_have_probe) ? (state->force_async = true) : (state->poll_first = true);
+        }
+        state->coalesced_next = torequeue;
+        torequeue = state;
+      }
+      else
+      {
+        state->coalesced_next = tocomplete;
+        tocomplete = state;
+      }
+    }
+    if(torequeue != nullptr)
+    {
+      // If a barrier was linked after the coalesced write, it must be resubmitted after the last write requeued
+      torequeue->linked_barrier = had_linked_barrier;
+      for(_io_uring_operation_state *state = torequeue, *next = nullptr; state != nullptr; state = next)
+      {
+        next = state->coalesced_next;
+        state->coalesced_next = nullptr;
+        _enqueue_front_to(rfd.enqueued, state);
+      }
+    }
+    if(rfd.enqueued.first != nullptr)
+    {
+      _submit_enqueued_or_pend(rfd);
+    }
+    // Reverse the list of writes to complete, so they complete in the order initiated
+    _io_uring_operation_state *ordered = nullptr;
+    while(tocomplete != nullptr)
+    {
+      _io_uring_operation_state *next = tocomplete->coalesced_next;
+      tocomplete->coalesced_next = ordered;
+      ordered = tocomplete;
+      tocomplete = next;
+    }
+    g.unlock();
+    for(_io_uring_operation_state *state = ordered, *next = nullptr; state != nullptr; state = next)
+    {
+      next = state->coalesced_next;
+      state->coalesced_next = nullptr;
+      ++count;
+      _complete(state, io_operation_state_type::write_initiated, state->deferred_cqe_res);
+    }
+    g.lock();
+    return count;
+  }
+
+  void _free_coalesced_writes() noexcept
+  {
+    while(_coalesced_write_free != nullptr)
+    {
+      _coalesced_write_t *next = _coalesced_write_free->next_free;
+      delete _coalesced_write_free;
+      _coalesced_write_free = next;
+    }
+  }
+
+  // Reaps completions from a ring, invoking completion for up to max_completions. Must be called with the lock held.
+  size_t _reap(_multiplexer_lock_guard &g, _submission_completion_t &ring, size_t max_completions) noexcept
+  {
+    size_t count = 0;
+    while(ring.fd != -1 && count < max_completions)
+    {
+      const uint32_t head = ring.completion.head->load(std::memory_order_relaxed);
+      if(head == ring.completion.tail->load(std::memory_order_acquire))
+      {
+        break;
+      }
+      const _io_uring_cqe cqe = ring.completion.entries[head & ring.completion.ring_mask];
+      ring.completion.head->store(head + 1, std::memory_order_release);
+      assert(ring.outstanding > 0);
+      --ring.outstanding;
+      if(cqe.user_data == _user_data_wakeup)
+      {
+        _woken = true;
+        continue;
+      }
+      if(cqe.user_data == _user_data_internal)
+      {
+        // The result of a cancellation, or of a wait timeout
+        continue;
+      }
+      if((cqe.user_data & _user_data_fs_syscall_tag) == _user_data_fs_syscall_tag)
+      {
+        // The result of a syscall submitted by initiate_posix_fs_syscalls(), which wakes any waiter
+        auto *op = (posix_fs_syscall *) (uintptr_t)(cqe.user_data & ~_user_data_fs_syscall_tag);
+        op->result = cqe.res;
+        _woken = true;
+        continue;
+      }
+      auto *state = (_io_uring_operation_state *) (uintptr_t)(cqe.user_data & ~(_user_data_poll_tag | _user_data_timeout_tag));
+      assert(state->submitted_to_iouring);
+      assert(is_initiated(state->state));
+      bool is_poll = (cqe.user_data & _user_data_poll_tag) != 0;
+      int res = cqe.res;
+      if((cqe.flags & _IORING_CQE_F_BUFFER) != 0 && (cqe.user_data & _user_data_timeout_tag) == 0)
+      {
+        state->provided_buffer = (int) (cqe.flags >> _IORING_CQE_BUFFER_SHIFT);
+      }
+      if(state->uses_zerocopy_send)
+      {
+        // Zero copy sends never have a LINK_TIMEOUT, so deferred_cqe_res is free for our use
+        if((cqe.flags & _IORING_CQE_F_NOTIF) != 0)
+        {
+          // The kernel has finished with the buffers, so the send can now complete
+          assert(state->awaiting_zerocopy_notification);
+          state->awaiting_zerocopy_notification = false;
+          res = state->deferred_cqe_res;
+        }
+        else if((cqe.flags & _IORING_CQE_F_MORE) != 0)
+        {
+          // The buffers remain in use until the notification arrives
+          state->awaiting_zerocopy_notification = true;
+          state->deferred_cqe_res = res;
+          continue;
+        }
+        else
+        {
+          // No notification will follow, so release the completion ring entry reserved for it
+          assert(ring.outstanding > 0);
+          --ring.outstanding;
+        }
+        state->uses_zerocopy_send = false;
+      }
+      if((cqe.user_data & _user_data_timeout_tag) != 0)
+      {
+        // The LINK_TIMEOUT completed, either by firing or by being cancelled by the completion of the i/o
+        assert(state->timeout_linked);
+        state->timeout_linked = false;
+        if(-ETIME == cqe.res)
+        {
+          state->timed_out = true;
+        }
+        if(!state->have_deferred_cqe)
+        {
+          // The i/o has yet to complete
+          continue;
+        }
+        state->have_deferred_cqe = false;
+        is_poll = state->deferred_cqe_was_poll;
+        res = state->deferred_cqe_res;
+      }
+      else if(state->timeout_linked)
+      {
+        // The state cannot be released until its LINK_TIMEOUT has also completed
+        state->have_deferred_cqe = true;
+        state->deferred_cqe_was_poll = is_poll;
+        state->deferred_cqe_res = res;
+        continue;
+      }
+      auto &rfd = _registered_fds[state->fd];
+      if(state->coalesced != nullptr)
+      {
+        count += _reap_coalesced(g, ring, rfd, state, res);
+        continue;
+      }
+      _note_cancelled_by_fd(rfd, state, res);
+      const bool is_read = (state->state == io_operation_state_type::read_initiated);
+      const bool was_linked_barrier = state->linked_barrier;
+      const bool was_linked_after_write = state->linked_after_write;
+      state->submitted_to_iouring = false;
+      state->linked_barrier = state->linked_after_write = false;
+      if(rfd.is_seekable)
+      {
+        // No longer blocks overlapping i/o
+        _dequeue_from(rfd.inflight, state);
+      }
+      if(state->uses_fixed_buffer)
+      {
+        state->uses_fixed_buffer = false;
+        --_fixed_buffers_inflight;
+      }
+      const bool used_provided_buffer = state->uses_provided_buffer;
+      state->uses_provided_buffer = false;
+      if(is_poll)
+      {
+        // The POLL_ADD completed
+        assert(state->polling);
+        state->polling = false;
+        if(state->cancel_requested || (state->timed_out && res < 0))
+        {
+          res = -ECANCELED;
+        }
+        else
+        {
+          // Resubmit the i/o at the front of the queue so ordering is retained
+          is_read ? --rfd.inprogress_reads : --rfd.inprogress_writes;
+          _enqueue_front_to(rfd.enqueued, state);
+          _submit_enqueued_or_pend(rfd);
+          continue;
+        }
+      }
+      else if(-EAGAIN == res && !state->cancel_requested && !state->timed_out)
+      {
+        // Resubmit the i/o after the handle becomes ready, or using a kernel thread if seekable
+        is_read ? --rfd.inprogress_reads : --rfd.inprogress_writes;
+        if(state->is_seekable && _have_probe)
+        {
+          state->force_async = true;
+        }
+        else
+        {
+          state->poll_first = true;
+        }
+        // If a barrier was linked after this write, its link is now broken and it will be resubmitted after this
+        state->linked_barrier = was_linked_barrier;
+        _enqueue_front_to(rfd.enqueued, state);
+        _submit_enqueued_or_pend(rfd);
+        continue;
+      }
+      else if(-ECANCELED == res && was_linked_after_write && !state->cancel_requested)
+      {
+        // The write this barrier was linked after failed or was short, which breaks the link.
+        // Resubmit the barrier normally, after the write if that is being resubmitted.
+        --rfd.inprogress_writes;
+        _io_uring_operation_state *write = rfd.enqueued.first;
+        while(write != nullptr && !write->linked_barrier)
+        {
+          write = write->next;
+        }
+        if(write != nullptr)
+        {
+          write->linked_barrier = false;
+          _enqueue_after(rfd.enqueued, write, state);
+        }
+        else
+        {
+          _enqueue_front_to(rfd.enqueued, state);
+        }
+        _submit_enqueued_or_pend(rfd);
+        continue;
+      }
+      else if(-ENOBUFS == res && used_provided_buffer && !state->cancel_requested && !state->timed_out)
+      {
+        // The provided buffer ring ran dry, so resubmit as an ordinary read into the caller's buffers
+        state->no_provided_buffer = true;
+        --rfd.inprogress_reads;
+        _enqueue_front_to(rfd.enqueued, state);
+        _submit_enqueued_or_pend(rfd);
+        continue;
+      }
+      else if(-EOPNOTSUPP == res && &ring == &_iopoll && !rfd.iopoll_unsupported)
+      {
+        // The device does not support polled i/o, so resubmit this and all future i/o to the seekable ring
+        rfd.iopoll_unsupported = true;
+        is_read ? --rfd.inprogress_reads : --rfd.inprogress_writes;
+        _enqueue_front_to(rfd.enqueued, state);
+        _submit_enqueued_or_pend(rfd);
+        continue;
+      }
+      is_read ? --rfd.inprogress_reads : --rfd.inprogress_writes;
+      if(state->provided_buffer >= 0)
+      {
+        _copy_from_provided_buffer(state, res);
+      }
+      // The handle may now be able to submit more i/o
+      if(rfd.enqueued.first != nullptr)
+      {
+        _submit_enqueued_or_pend(rfd);
+      }
+      const auto s = state->state;
+      ++count;
+      g.unlock();
+      _complete(state, s, res);
+      g.lock();
+    }
+    return count;
+  }
+
+  // Reaps both rings. Must be called with the lock held.
+  size_t _reap_all(_multiplexer_lock_guard &g, size_t max_completions) noexcept
+  {
+    size_t count = _reap(g, _nonseekable, max_completions);
+    if(count < max_completions)
+    {
+      count += _reap(g, _seekable, max_completions - count);
+    }
+    if(count < max_completions && _iopoll.outstanding > 0)
+    {
+      if(!_is_polling)
+      {
+        // Completions to an IOPOLL ring are only posted when someone polls for them. This polls once without spinning.
+        (void) _io_uring_enter(_iopoll.fd, 0, 0, _IORING_ENTER_GETEVENTS);
+      }
+      count += _reap(g, _iopoll, max_completions - count);
+    }
+    if(count > 0)
+    {
+      // Reaping may have freed space for pending i/o
+      (void) _submit_all();
+    }
+    return count;
+  }
+
+  result<void> _init_ring(_submission_completion_t &out) noexcept
+  {
+    _io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if(&out == &_iopoll)
+    {
+      // Completions are reaped by polling the device, which works for O_DIRECT files only
+      params.flags |= _IORING_SETUP_IOPOLL;
+    }
+    if(_is_polling)
+    {
+      params.flags |= _IORING_SETUP_SQPOLL;
+      params.sq_thread_idle = (uint32_t) _sqpoll.idle.count();
+      if(_sqpoll.cpu >= 0)
+      {
+        params.flags |= _IORING_SETUP_SQ_AFF;
+        params.sq_thread_cpu = (uint32_t) _sqpoll.cpu;
+      }
+      else if(!is_threadsafe)
+      {
+        // Pin kernel submission polling thread to same CPU as I am pinned to, if I am pinned
+        cpu_set_t affinity;
+        CPU_ZERO(&affinity);
+        if(-1 != ::sched_getaffinity(0, sizeof(affinity), &affinity) && CPU_COUNT(&affinity) == 1)
+        {
+          for(size_t n = 0; n < CPU_SETSIZE; n++)
+          {
+            if(CPU_ISSET(n, &affinity))
+            {
+              params.flags |= _IORING_SETUP_SQ_AFF;
+              params.sq_thread_cpu = (uint32_t) n;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if(_is_polling && _sqpoll.share_between_rings && &out != &_nonseekable && _nonseekable.fd != -1)
+    {
+      // Share the kernel threads of the first ring
+      params.flags |= _IORING_SETUP_ATTACH_WQ;
+      params.wq_fd = (uint32_t) _nonseekable.fd;
+    }
+    // The kernel rounds entries up to a power of two, and fails if more than it allows
+    const auto hint = utils::tuning().io_queue_depth;
+    const unsigned entries = (hint != 0) ? static_cast<unsigned>(std::min(hint, size_t(4096))) : _ring_entries;
+    // Clamp the completion ring to what the kernel allows rather than fail, Linux 5.6 onwards
+    params.flags |= _IORING_SETUP_CQSIZE | _IORING_SETUP_CLAMP;
+    params.cq_entries = std::max(entries * 2, _max_fixed_files);
+    const _io_uring_params original_params = params;
+    int fd = _io_uring_setup(entries, &params);
+    if(fd < 0 && EINVAL == errno)
+    {
+      // Kernels before 5.6 don't support IORING_SETUP_ATTACH_WQ nor IORING_SETUP_CLAMP
+      params = original_params;
+      params.flags &= ~(_IORING_SETUP_ATTACH_WQ | _IORING_SETUP_CQSIZE | _IORING_SETUP_CLAMP);
+      params.wq_fd = 0;
+      params.cq_entries = 0;
+      fd = _io_uring_setup(entries, &params);
+    }
+    if(fd < 0)
+    {
+      return posix_error();
+    }
+    out.fd = fd;
+    auto unmake = make_scope_exit([&]() noexcept { _close_ring(out); });
+    _features = params.features;
+    size_t sqsize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cqsize = params.cq_off.cqes + params.cq_entries * sizeof(_io_uring_cqe);
+    const bool single_mmap = (params.features & _IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single_mmap)
+    {
+      sqsize = cqsize = std::max(sqsize, cqsize);
+    }
+    {
+      auto *p = ::mmap(nullptr, sqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, _IORING_OFF_SQ_RING);
+      if(MAP_FAILED == p)
+      {
+        return posix_error();
+      }
+      out.submission.region = {(byte *) p, sqsize};
+    }
+    {
+      auto *p = ::mmap(nullptr, params.sq_entries * sizeof(_io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, _IORING_OFF_SQES);
+      if(MAP_FAILED == p)
+      {
+        return posix_error();
+      }
+      out.submission.entries = {(_io_uring_sqe *) p, params.sq_entries};
+    }
+    byte *cq = out.submission.region.data();
+    if(!single_mmap)
+    {
+      auto *p = ::mmap(nullptr, cqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, _IORING_OFF_CQ_RING);
+      if(MAP_FAILED == p)
+      {
+        return posix_error();
+      }
+      out.completion.region = {(byte *) p, cqsize};
+      cq = out.completion.region.data();
+    }
+    byte *sq = out.submission.region.data();
+    out.submission.head = (std::atomic<uint32_t> *) (sq + params.sq_off.head);
+    out.submission.tail = (std::atomic<uint32_t> *) (sq + params.sq_off.tail);
+    out.submission.ring_mask = *(const uint32_t *) (sq + params.sq_off.ring_mask);
+    out.submission.ring_entries = *(const uint32_t *) (sq + params.sq_off.ring_entries);
+    out.submission.flags = (std::atomic<uint32_t> *) (sq + params.sq_off.flags);
+    out.submission.dropped = (std::atomic<uint32_t> *) (sq + params.sq_off.dropped);
+    out.submission.array = (uint32_t *) (sq + params.sq_off.array);
+    out.submission.local_tail = out.submission.tail->load(std::memory_order_relaxed);
+    // We always fill sqes in ring order, so the indirection array never changes
+    for(uint32_t n = 0; n < out.submission.ring_entries; n++)
+    {
+      out.submission.array[n] = n;
+    }
+    out.completion.head = (std::atomic<uint32_t> *) (cq + params.cq_off.head);
+    out.completion.tail = (std::atomic<uint32_t> *) (cq + params.cq_off.tail);
+    out.completion.ring_mask = *(const uint32_t *) (cq + params.cq_off.ring_mask);
+    out.completion.ring_entries = *(const uint32_t *) (cq + params.cq_off.ring_entries);
+    out.completion.overflow = (std::atomic<uint32_t> *) (cq + params.cq_off.overflow);
+    out.completion.entries = (_io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    // Register a sparse file table, Linux 5.5 onwards. Linux 5.19 onwards does not need an array
+    // of empty slots. Tables larger than RLIMIT_NOFILE are refused, so try smaller ones.
+    for(uint32_t count = _max_fixed_files; count >= _min_fixed_files && !out.have_fixed_files; count /= 4)
+    {
+      _io_uring_rsrc_register reg;
+      memset(&reg, 0, sizeof(reg));
+      reg.nr = count;
+      reg.flags = _IORING_RSRC_REGISTER_SPARSE;
+      if(_io_uring_register(fd, _IORING_REGISTER_FILES2, &reg, sizeof(reg)) >= 0)
+      {
+        out.have_fixed_files = true;
+        out.fixed_files = count;
+        break;
+      }
+      std::vector<int32_t> fds;
+      try
+      {
+        fds.assign(count, -1);
+      }
+      catch(...)
+      {
+        break;
+      }
+      if(_io_uring_register(fd, _IORING_REGISTER_FILES, fds.data(), count) >= 0)
+      {
+        out.have_fixed_files = true;
+        out.fixed_files = count;
+      }
+    }
+    unmake.release();
+    return success();
+  }
+  void _close_ring(_submission_completion_t &s) noexcept
+  {
+    if(!s.submission.region.empty())
+    {
+      (void) ::munmap(s.submission.region.data(), s.submission.region.size());
+      s.submission.region = {};
+    }
+    if(!s.submission.entries.empty())
+    {
+      (void) ::munmap(s.submission.entries.data(), s.submission.entries.size_bytes());
+      s.submission.entries = {};
+    }
+    if(!s.completion.region.empty())
+    {
+      (void) ::munmap(s.completion.region.data(), s.completion.region.size());
+      s.completion.region = {};
+    }
+    // The fd of the non-seekable ring is our native handle, which handle::close() closes
+    if(-1 != s.fd && s.fd != this->_v.fd)
+    {
+      (void) ::close(s.fd);
+    }
+    s.fd = -1;
+    s.have_fixed_files = false;
+    s.fixed_files = s.next_fixed_file = 0;
+    s.free_fixed_files.clear();
+  }
+  // (Re)registers all registered i/o buffers with a ring. Must be called with the lock held.
+  bool _register_buffers(_submission_completion_t &ring) noexcept
+  {
+    if(ring.fd == -1)
+    {
+      return true;
+    }
+    assert(_fixed_buffers_inflight == 0);
+    if(ring.have_registered_buffers)
+    {
+      (void) _io_uring_register(ring.fd, _IORING_UNREGISTER_BUFFERS, nullptr, 0);
+      ring.have_registered_buffers = false;
+    }
+    if(_registered_buffers.empty())
+    {
+      return true;
+    }
+    auto *iov = (struct iovec *) alloca(_registered_buffers.size() * sizeof(struct iovec));
+    for(size_t n = 0; n < _registered_buffers.size(); n++)
+    {
+      iov[n].iov_base = _registered_buffers[n]->data();
+      iov[n].iov_len = _registered_buffers[n]->size();
+    }
+    if(_io_uring_register(ring.fd, _IORING_REGISTER_BUFFERS, iov, (unsigned) _registered_buffers.size()) < 0)
+    {
+      return false;
+    }
+    ring.have_registered_buffers = true;
+    return true;
+  }
+  // Registers the provided buffer ring with the non-seekable ring, if the kernel supports them
+  void _init_provided_buffers() noexcept
+  {
+    if(!_supported_ops[_IORING_OP_READ])
+    {
+      return;
+    }
+    const size_t ringbytes = (_provided_buffer_count * sizeof(_io_uring_buf) + 4095) & ~(size_t) 4095;
+    const size_t bytes = ringbytes + (size_t) _provided_buffer_count * _provided_buffer_size;
+    void *addr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == addr)
+    {
+      return;
+    }
+    _io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t) addr;
+    reg.ring_entries = _provided_buffer_count;
+    reg.bgid = 0;
+    if(_io_uring_register(_nonseekable.fd, _IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+      ::munmap(addr, bytes);
+      return;
+    }
+    _provided.region = {(byte *) addr, bytes};
+    _provided.ring = (_io_uring_buf *) addr;
+    _provided.buffers = (byte *) addr + ringbytes;
+    _provided.tail = 0;
+    for(uint16_t bid = 0; bid < _provided_buffer_count; bid++)
+    {
+      _recycle_provided_buffer(bid);
+    }
+  }
+  void _close_provided_buffers() noexcept
+  {
+    if(_provided.ring == nullptr)
+    {
+      return;
+    }
+    _io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = 0;
+    (void) _io_uring_register(_nonseekable.fd, _IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    ::munmap(_provided.region.data(), _provided.region.size());
+    _provided = {};
+  }
+  // Returns a buffer to the provided buffer ring. Must be called with the lock held.
+  void _recycle_provided_buffer(uint16_t bid) noexcept
+  {
+    // Only the first three fields are written, as the fourth of the first entry is the tail
+    _io_uring_buf &e = _provided.ring[_provided.tail & (_provided_buffer_count - 1)];
+    e.addr = (uint64_t)(uintptr_t)(_provided.buffers + (size_t) bid * _provided_buffer_size);
+    e.len = _provided_buffer_size;
+    e.bid = bid;
+    ++_provided.tail;
+    reinterpret_cast<std::atomic<uint16_t> *>(&_provided.ring[0].resv)->store(_provided.tail, std::memory_order_release);
+  }
+  // Copies a completed read from its provided buffer into its buffers, and recycles the provided buffer. Must be called with the lock held.
+  void _copy_from_provided_buffer(_io_uring_operation_state *state, int res) noexcept
+  {
+    const auto bid = (uint16_t) state->provided_buffer;
+    state->provided_buffer = -1;
+    if(res > 0)
+    {
+      const byte *src = _provided.buffers + (size_t) bid * _provided_buffer_size;
+      size_t bytes = (size_t) res;
+      for(auto &b : state->payload.noncompleted.params.read.reqs.buffers)
+      {
+        const size_t tocopy = std::min(bytes, (size_t) b.size());
+        memcpy(b.data(), src, tocopy);
+        src += tocopy;
+        bytes -= tocopy;
+        if(bytes == 0)
+        {
+          break;
+        }
+      }
+    }
+    _recycle_provided_buffer(bid);
+  }
+
+  void _probe_ops() noexcept
+  {
+    static constexpr size_t probe_ops = 256;
+    alignas(_io_uring_probe) byte buffer[sizeof(_io_uring_probe) + probe_ops * sizeof(_io_uring_probe_op)];
+    memset(buffer, 0, sizeof(buffer));
+    auto *probe = (_io_uring_probe *) buffer;
+    auto *ops = (_io_uring_probe_op *) (probe + 1);
+    if(_io_uring_register(_nonseekable.fd, _IORING_REGISTER_PROBE, probe, probe_ops) >= 0)  // Linux 5.6 onwards
+    {
+      for(size_t n = 0; n < probe->ops_len && n < probe_ops; n++)
+      {
+        if((ops[n].flags & _IO_URING_OP_SUPPORTED) != 0)
+        {
+          _supported_ops[ops[n].op] = true;
+        }
+      }
+      _have_probe = true;
+      return;
+    }
+    // Infer from the ring features what an older kernel must support
+    _supported_ops[_IORING_OP_NOP] = true;
+    _supported_ops[_IORING_OP_READV] = true;
+    _supported_ops[_IORING_OP_WRITEV] = true;
+    _supported_ops[_IORING_OP_FSYNC] = true;
+    _supported_ops[_IORING_OP_READ_FIXED] = true;
+    _supported_ops[_IORING_OP_WRITE_FIXED] = true;
+    _supported_ops[_IORING_OP_POLL_ADD] = true;
+    _supported_ops[_IORING_OP_POLL_REMOVE] = true;
+    if((_features & _IORING_FEAT_NODROP) != 0)
+    {
+      // Linux 5.5
+      _supported_ops[_IORING_OP_SYNC_FILE_RANGE] = true;
+      _supported_ops[_IORING_OP_SENDMSG] = true;
+      _supported_ops[_IORING_OP_RECVMSG] = true;
+      _supported_ops[_IORING_OP_TIMEOUT] = true;
+      _supported_ops[_IORING_OP_TIMEOUT_REMOVE] = true;
+      _supported_ops[_IORING_OP_ACCEPT] = true;
+      _supported_ops[_IORING_OP_ASYNC_CANCEL] = true;
+      _supported_ops[_IORING_OP_LINK_TIMEOUT] = true;
+      _supported_ops[_IORING_OP_CONNECT] = true;
+    }
+  }
+
+public:
+  explicit linux_io_uring_multiplexer(bool is_polling, const linux_io_uring_sqpoll_config &sqpoll = {})
+      : _is_polling(is_polling)
+      , _sqpoll(sqpoll)
+  {
+  }
+
+  linux_io_uring_statistics statistics() const noexcept
+  {
+    linux_io_uring_statistics ret;
+    ret.flushes_without_syscall = _flushes_without_syscall.load(std::memory_order_relaxed);
+    ret.flushes_with_syscall = _flushes_with_syscall.load(std::memory_order_relaxed);
+    ret.sqpoll_wakeups = _sqpoll_wakeups.load(std::memory_order_relaxed);
+    ret.linked_barriers = _linked_barriers.load(std::memory_order_relaxed);
+    ret.coalesced_writes = _coalesced_writes.load(std::memory_order_relaxed);
+    return ret;
+  }
+  linux_io_uring_multiplexer(const linux_io_uring_multiplexer &) = delete;
+  linux_io_uring_multiplexer(linux_io_uring_multiplexer &&) = delete;
+  linux_io_uring_multiplexer &operator=(const linux_io_uring_multiplexer &) = delete;
+  linux_io_uring_multiplexer &operator=(linux_io_uring_multiplexer &&) = delete;
+  virtual ~linux_io_uring_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) linux_io_uring_multiplexer::close();
+    }
+    _free_coalesced_writes();
+  }
+  result<void> init()
+  {
+    OUTCOME_TRY(_init_ring(_nonseekable));
+    this->_v.fd = _nonseekable.fd;
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    _probe_ops();
+    _init_provided_buffers();
+    _nonseekable.pending.reserve(4);
+    _registered_fds.reserve(64);
+    return success();
+  }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    this->_stop_posix_lock_waiter();
+    _multiplexer_lock_guard g(this->_lock);
+    if(_nonseekable.outstanding > 0 || _seekable.outstanding > 0 || _iopoll.outstanding > 0)
+    {
+      // Can't close a multiplexer with i/o in progress
+      return errc::operation_in_progress;
+    }
+    _close_ring(_iopoll);
+    _close_ring(_seekable);
+    _free_coalesced_writes();
+    _close_provided_buffers();
+    _close_ring(_nonseekable);
+    OUTCOME_TRY(_base::close());
+    _registered_fds.clear();
+    _registered_buffers.clear();
+    _registered_buffers_index.clear();
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0)
+    {
+      return errc::bad_file_descriptor;
+    }
+    if(h->is_seekable() && -1 == _seekable.fd)
+    {
+      // Create the seekable io_uring ring
+      OUTCOME_TRY(_init_ring(_seekable));
+      if(_fixed_buffers_inflight == 0)
+      {
+        (void) _register_buffers(_seekable);
+      }
+    }
+    // Uncached regular files can have their completions polled for. Before Linux 5.11, kernel submission
+    // polling works only with registered files, and barriers to the seekable ring would use the unregistered fd.
+    bool use_iopoll = h->is_regular() && (h->kernel_caching() == caching::none || h->kernel_caching() == caching::only_metadata) &&
+                      (!_is_polling || (_features & _IORING_FEAT_SQPOLL_NONFIXED) != 0);
+    if(use_iopoll && -1 == _iopoll.fd)
+    {
+      // Create the IOPOLL io_uring ring. If the kernel refuses, use the seekable ring.
+      if(_init_ring(_iopoll))
+      {
+        if(_fixed_buffers_inflight == 0)
+        {
+          (void) _register_buffers(_iopoll);
+        }
+      }
+      else
+      {
+        use_iopoll = false;
+      }
+    }
+    try
+    {
+      if((size_t) fd >= _registered_fds.size())
+      {
+        _registered_fds.resize(fd + 1);
+      }
+      auto &ring = use_iopoll ? _iopoll : (h->is_seekable() ? _seekable : _nonseekable);
+      ring.pending.reserve(ring.registered + 1);
+      ring.free_fixed_files.reserve(ring.registered + 1);
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    auto &rfd = _registered_fds[fd];
+    if(rfd.fd != -1)
+    {
+      return errc::device_or_resource_busy;
+    }
+    rfd = _registered_fd();
+    rfd.fd = fd;
+    rfd.is_seekable = h->is_seekable();
+    rfd.is_iopolled = use_iopoll;
+    rfd.ignore_overlapping_ranges = !!(h->flags() & handle::flag::disable_posix_concurrency_guarantees);
+    auto &ring = _ring_for(rfd);
+    if(ring.have_fixed_files && (!ring.free_fixed_files.empty() || ring.next_fixed_file < ring.fixed_files))
+    {
+      int32_t slot;
+      if(!ring.free_fixed_files.empty())
+      {
+        slot = ring.free_fixed_files.back();
+        ring.free_fixed_files.pop_back();
+      }
+      else
+      {
+        slot = (int32_t) ring.next_fixed_file++;
+      }
+      int32_t newvalue = fd;
+      _io_uring_files_update upd;
+      memset(&upd, 0, sizeof(upd));
+      upd.offset = (uint32_t) slot;
+      upd.fds = (__aligned_u64)(uintptr_t) &newvalue;
+      if(_io_uring_register(ring.fd, _IORING_REGISTER_FILES_UPDATE, &upd, 1) >= 0)
+      {
+        rfd.fixed = slot;
+      }
+      else
+      {
+        // Capacity was reserved above
+        ring.free_fixed_files.push_back(slot);
+      }
+    }
+    if(_is_polling && rfd.fixed < 0 && (_features & _IORING_FEAT_SQPOLL_NONFIXED) == 0)
+    {
+      // Before Linux 5.11, kernel submission polling works only with registered files
+      rfd = _registered_fd();
+      return errc::not_supported;
+    }
+    ++ring.registered;
+    return (uint8_t) 0;
+  }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0 || (size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd != fd)
+    {
+      return errc::invalid_argument;
+    }
+    auto &rfd = _registered_fds[fd];
+    assert(rfd.inprogress_reads == 0 && rfd.inprogress_writes == 0 && rfd.enqueued.first == nullptr);
+    if(rfd.inprogress_reads != 0 || rfd.inprogress_writes != 0 || rfd.enqueued.first != nullptr)
+    {
+      // Can't deregister a handle with i/o in progress
+      return errc::operation_in_progress;
+    }
+    auto &ring = _ring_for(rfd);
+    if(rfd.fixed >= 0)
+    {
+      int32_t newvalue = -1;
+      _io_uring_files_update upd;
+      memset(&upd, 0, sizeof(upd));
+      upd.offset = (uint32_t) rfd.fixed;
+      upd.fds = (__aligned_u64)(uintptr_t) &newvalue;
+      if(_io_uring_register(ring.fd, _IORING_REGISTER_FILES_UPDATE, &upd, 1) < 0)
+      {
+        return posix_error();
+      }
+      // Capacity was reserved during registration
+      ring.free_fixed_files.push_back(rfd.fixed);
+    }
+    --ring.registered;
+    rfd = _registered_fd();
+    return success();
+  }
+
+  virtual size_t do_io_handle_max_buffers(const io_handle * /*unused*/) const noexcept override { return IOV_MAX; }
+
+  virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    // Try to reuse any previously registered buffers no longer in use, as
+    // registered buffer registration is expensive
+    for(auto &b : _registered_buffers)
+    {
+      if(b.use_count() == 1 && b->size() >= bytes)
+      {
+        bytes = b->size();
+        return b;
+      }
+    }
+    // The default implementation uses mmap, so this is done for us
+    OUTCOME_TRY(auto &&ret, _base::do_io_handle_allocate_registered_buffer(h, bytes));
+    if(_registered_buffers.size() >= _max_registered_buffers || _fixed_buffers_inflight > 0)
+    {
+      // Can't register this buffer right now, so return it unregistered
+      return result<registered_buffer_type>(std::move(ret));
+    }
+    try
+    {
+      _registered_buffers.push_back(ret);
+      _registered_buffers_index.reserve(_registered_buffers.size());
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    auto reregister = [&] {
+      for(auto *ring : {&_nonseekable, &_seekable, &_iopoll})
+      {
+        if(!_register_buffers(*ring))
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+    if(!reregister())
+    {
+      // Probably RLIMIT_MEMLOCK exceeded, so restore previous registrations and return the buffer unregistered
+      _registered_buffers.pop_back();
+      (void) reregister();
+      return result<registered_buffer_type>(std::move(ret));
+    }
+    _registered_buffers_index.clear();
+    for(size_t n = 0; n < _registered_buffers.size(); n++)
+    {
+      _registered_buffers_index.push_back({_registered_buffers[n]->data(), (uint16_t) n});
+    }
+    std::sort(_registered_buffers_index.begin(), _registered_buffers_index.end(),
+              [](const _registered_buffer_index_t &a, const _registered_buffer_index_t &b) { return a.data < b.data; });
+    return result<registered_buffer_type>(std::move(ret));
+  }
+
+  // io_uring has very minimal i/o state requirements
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return {sizeof(_io_uring_operation_state), alignof(_io_uring_operation_state)}; }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_io_uring_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) == 0);
+    if(storage.size() < sizeof(_io_uring_operation_state) || ((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _io_uring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_io_uring_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) == 0);
+    if(storage.size() < sizeof(_io_uring_operation_state) || ((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _io_uring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    assert(storage.size() >= sizeof(_io_uring_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) == 0);
+    if(storage.size() < sizeof(_io_uring_operation_state) || ((uintptr_t) storage.data() % alignof(_io_uring_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _io_uring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+
+  /* Moves a state from initialised to initiated, and computes everything which does not need
+  the lock. Returns false if the state should not be enqueued, in which case `s` is its state.
+  */
+  static bool _prepare_init(_io_uring_operation_state *state, io_operation_state_type &s) noexcept
+  {
+    s = state->current_state();  // read the current state, holding the state's lock
+    if(!is_initialised(s))
+    {
+      assert(false);
+      return false;
+    }
+    state->fd = state->h->native_handle().fd;
+    state->is_seekable = state->h->is_seekable();
+    assert(state->submitted_to_iouring == false);
+    const deadline d = state->payload.noncompleted.d;
+    if(d)
+    {
+      // Convert the deadline into an absolute CLOCK_MONOTONIC expiry, which is what io_uring uses
+      struct timespec now;
+      ::clock_gettime(CLOCK_MONOTONIC, &now);
+      uint64_t nsecs = 0;
+      if(d.steady)
+      {
+        nsecs = d.nsecs;
+      }
+      else
+      {
+        const auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(d.to_time_point() - std::chrono::system_clock::now()).count();
+        nsecs = (diff > 0) ? (uint64_t) diff : 0;
+      }
+      state->has_deadline = true;
+      state->timeout.tv_sec = now.tv_sec + (int64_t)(nsecs / 1000000000ULL);
+      state->timeout.tv_nsec = now.tv_nsec + (long long) (nsecs % 1000000000ULL);
+      if(state->timeout.tv_nsec >= 1000000000LL)
+      {
+        state->timeout.tv_sec++;
+        state->timeout.tv_nsec -= 1000000000LL;
+      }
+    }
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initialised:
+      state->read_initiated();
+      break;
+    case io_operation_state_type::write_initialised:
+      state->write_initiated();
+      break;
+    case io_operation_state_type::barrier_initialised:
+      if(state->h->is_pipe() || state->h->is_socket())
+      {
+        // Nothing to flush, so complete immediately
+        state->barrier_completed(io_result<const_buffers_type>(const_buffers_type()));
+        state->write_or_barrier_finished();
+        s = io_operation_state_type::write_or_barrier_finished;
+        return false;
+      }
+      state->barrier_initiated();
+      break;
+    }
+    if(state->is_seekable)
+    {
+      auto range_of = [&](const auto &reqs) {
+        extent_type bytes = 0;
+        for(const auto &b : reqs.buffers)
+        {
+          bytes += b.size();
+        }
+        state->range_begin = reqs.offset;
+        state->range_end = ((extent_type) -1 - reqs.offset < bytes) ? (extent_type) -1 : reqs.offset + bytes;
+      };
+      switch(state->state)
+      {
+      default:
+        break;
+      case io_operation_state_type::read_initiated:
+        range_of(state->payload.noncompleted.params.read.reqs);
+        break;
+      case io_operation_state_type::write_initiated:
+        range_of(state->payload.noncompleted.params.write.reqs);
+        break;
+      case io_operation_state_type::barrier_initiated:
+        // Barriers are ordered against all writes
+        state->range_begin = 0;
+        state->range_end = (extent_type) -1;
+        break;
+      }
+    }
+    return true;
+  }
+
+  // Enqueues a prepared state. Must be called with the lock held, which is released if the state is completed.
+  void _init_prepared(_multiplexer_lock_guard &g, _io_uring_operation_state *state) noexcept
+  {
+    if(state->fd < 0 || (size_t) state->fd >= _registered_fds.size() || _registered_fds[state->fd].fd != state->fd)
+    {
+      // Handle has not been registered with this multiplexer
+      assert(false);
+      g.unlock();
+      _complete(state, state->current_state(), -EBADF);
+      g.lock();
+      return;
+    }
+    auto &rfd = _registered_fds[state->fd];
+    _enqueue_to(rfd.enqueued, state);
+    _submit_enqueued_or_pend(rfd);
+  }
+
+  virtual io_operation_state_type init_io_operation(io_operation_state *_op) noexcept override
+  {
+    auto *state = static_cast<_io_uring_operation_state *>(_op);
+    io_operation_state_type s;
+    if(!_prepare_init(state, s))
+    {
+      return s;
+    }
+    _multiplexer_lock_guard g(this->_lock);
+    _init_prepared(g, state);
+    return state->state;
+  }
+
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+
+  // Fills the sqes for the whole batch holding the lock once, and tells the kernel about them once
+  template <class BuffersType>
+  result<span<io_operation_state *>> _construct_and_init_batch(span<byte> storage, span<batched_io_request<BuffersType>> reqs, span<io_operation_state *> states) noexcept
+  {
+    OUTCOME_TRY(auto &&stride, this->_batched_io_state_stride(storage, reqs.size(), states.size()));
+    for(size_t n = 0; n < reqs.size(); n++)
+    {
+      auto &req = reqs[n];
+      states[n] = construct({storage.data() + n * stride, stride}, req.h, req.visitor, std::move(req.base), req.d, std::move(req.reqs));
+    }
+    _multiplexer_lock_guard g(this->_lock);
+    for(size_t n = 0; n < reqs.size(); n++)
+    {
+      auto *state = static_cast<_io_uring_operation_state *>(states[n]);
+      io_operation_state_type s;
+      if(_prepare_init(state, s))
+      {
+        _init_prepared(g, state);
+      }
+    }
+    OUTCOME_TRY(_submit_all());
+    return states.subspan(0, reqs.size());
+  }
+  virtual result<span<io_operation_state *>> construct_and_init_io_operations(span<byte> storage, span<batched_io_request<buffers_type>> reqs,
+                                                                              span<io_operation_state *> states) noexcept override
+  {
+    return _construct_and_init_batch(storage, reqs, states);
+  }
+  virtual result<span<io_operation_state *>> construct_and_init_io_operations(span<byte> storage, span<batched_io_request<const_buffers_type>> reqs,
+                                                                              span<io_operation_state *> states) noexcept override
+  {
+    return _construct_and_init_batch(storage, reqs, states);
+  }
+
+  // init_io_operation() only fills sqes, this tells the kernel about them
+  virtual result<void> flush_inited_io_operations() noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    return _submit_all();
+  }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *_op) noexcept override
+  {
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      (void) _submit_all();
+      _reap_all(g, (size_t) -1);
+    }
+    return _op->current_state();
+  }
+
+  /* Requests the cancellation of an i/o, filling a sqe to cancel it if already submitted, which
+  the caller must flush. Returns true if the i/o was not yet submitted, in which case it has been
+  removed from its queue and the caller must complete it with -ECANCELED after releasing the lock.
+  Must be called with the lock held.
+  */
+  result<bool> _request_cancel(_io_uring_operation_state *state) noexcept
+  {
+    const auto s = state->current_state();
+    if(!is_initiated(s) || is_completed(s) || is_finished(s))
+    {
+      return false;
+    }
+    if(!state->submitted_to_iouring)
+    {
+      // Not submitted yet, so simply remove it from its queue
+      auto &rfd = _registered_fds[state->fd];
+      _dequeue_from(rfd.enqueued, state);
+      state->cancel_requested = true;
+      return true;
+    }
+    if(!state->cancel_requested)
+    {
+      state->cancel_requested = true;
+      auto &ring = _ring_for(_registered_fds[state->fd], state);
+      const int opcode = state->polling ? _IORING_OP_POLL_REMOVE : _IORING_OP_ASYNC_CANCEL;
+      // IOPOLL rings cannot execute cancellations, but their i/o completes quickly
+      if(_supported_ops[opcode] && &ring != &_iopoll)
+      {
+        _io_uring_sqe *sqe = _get_sqe(ring);
+        if(sqe == nullptr)
+        {
+          state->cancel_requested = false;
+          return errc::resource_unavailable_try_again;
+        }
+        sqe->opcode = (uint8_t) opcode;
+        sqe->fd = -1;
+        sqe->addr = state->polling ? ((uint64_t)(uintptr_t) state | _user_data_poll_tag) : (uint64_t)(uintptr_t) state;
+        sqe->user_data = _user_data_internal;
+      }
+      // else this kernel cannot cancel i/o, so we must wait for it to complete
+    }
+    return false;
+  }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *_op, deadline d = {}) noexcept override
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    auto *state = static_cast<_io_uring_operation_state *>(_op);
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      const auto s = state->current_state();
+      if(!is_initiated(s) || is_completed(s) || is_finished(s))
+      {
+        return s;
+      }
+      OUTCOME_TRY(auto &&unsubmitted, _request_cancel(state));
+      if(unsubmitted)
+      {
+        g.unlock();
+        _complete(state, s, -ECANCELED);
+        return state->current_state();
+      }
+      OUTCOME_TRY(_flush_ring(_nonseekable));
+      OUTCOME_TRY(_flush_ring(_seekable));
+    }
+    if(d)
+    {
+      for(;;)
+      {
+        const auto s = state->current_state();
+        if(is_finished(s))
+        {
+          return s;
+        }
+        deadline nd;
+        LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+        OUTCOME_TRY(check_for_any_completed_io(nd));
+        if(!([&]() -> result<void> {
+             LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+             return success();
+           })())
+        {
+          break;
+        }
+      }
+    }
+    return state->current_state();
+  }
+
+  // Completes i/o removed from its queue by _request_cancel(). Must be called WITHOUT the lock held.
+  void _complete_cancelled(typename _registered_fd::queue_t &tocomplete) noexcept
+  {
+    for(_io_uring_operation_state *state = tocomplete.first, *next = nullptr; state != nullptr; state = next)
+    {
+      next = state->next;
+      _dequeue_from(tocomplete, state);
+      _complete(state, state->current_state(), -ECANCELED);
+    }
+  }
+
+  // The cancellations for the whole batch are filled holding the lock once, and submitted with a single syscall per ring
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept override
+  {
+    typename _registered_fd::queue_t tocomplete;
+    result<void> ret = success();
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      for(auto *op : ops)
+      {
+        auto *state = static_cast<_io_uring_operation_state *>(op);
+        auto unsubmitted = _request_cancel(state);
+        if(!unsubmitted)
+        {
+          // Cancellations already filled are still submitted, and i/o already dequeued must still be completed
+          ret = std::move(unsubmitted).error();
+          break;
+        }
+        if(unsubmitted.value())
+        {
+          _enqueue_to(tocomplete, state);
+        }
+      }
+      auto flushed = _flush_ring(_nonseekable);
+      if(flushed)
+      {
+        flushed = _flush_ring(_seekable);
+      }
+      if(ret && !flushed)
+      {
+        ret = std::move(flushed);
+      }
+    }
+    _complete_cancelled(tocomplete);
+    OUTCOME_TRY(std::move(ret));
+    return this->_wait_for_finished_io_operations(ops, d);
+  }
+
+  /* Since Linux 5.19, a single IORING_ASYNC_CANCEL_FD|IORING_ASYNC_CANCEL_ALL sqe cancels all i/o in
+  flight to the fd. Before then, i/o in flight to seekable handles is cancelled individually, and that
+  to non-seekable handles cannot be found without its state.
+  */
+  virtual result<void> cancel_io_operations(io_handle *h) noexcept override
+  {
+    const int fd = h->native_handle().fd;
+    typename _registered_fd::queue_t tocomplete;
+    result<void> ret = success();
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      if(fd < 0 || (size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd == -1)
+      {
+        return errc::invalid_argument;
+      }
+      auto &rfd = _registered_fds[fd];
+      // Not submitted yet, so simply remove them from the queue
+      while(rfd.enqueued.first != nullptr)
+      {
+        auto *state = rfd.enqueued.first;
+        _dequeue_from(rfd.enqueued, state);
+        state->cancel_requested = true;
+        _enqueue_to(tocomplete, state);
+      }
+      if(rfd.inprogress_reads > 0 || rfd.inprogress_writes > 0)
+      {
+        if(_supported_ops[_IORING_OP_SOCKET] && _supported_ops[_IORING_OP_ASYNC_CANCEL])
+        {
+          // IOPOLL rings cannot execute cancellations, but their i/o completes quickly
+          auto &ring = rfd.is_iopolled ? _seekable : _ring_for(rfd);
+          _io_uring_sqe *sqe = _get_sqe(ring);
+          if(sqe == nullptr)
+          {
+            ret = errc::resource_unavailable_try_again;
+          }
+          else
+          {
+            // i/o submitted before now which completes with -ECANCELED was cancelled by this
+            ++rfd.cancel_epoch;
+            sqe->opcode = _IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = _IORING_ASYNC_CANCEL_FD | _IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = _user_data_internal;
+            ret = _flush_ring(ring);
+          }
+        }
+        else if(rfd.is_seekable)
+        {
+          for(_io_uring_operation_state *state = rfd.inflight.first; state != nullptr && ret; state = state->next)
+          {
+            auto r = _request_cancel(state);
+            if(!r)
+            {
+              ret = std::move(r).error();
+            }
+          }
+          auto flushed = _flush_ring(_seekable);
+          if(ret && !flushed)
+          {
+            ret = std::move(flushed);
+          }
+        }
+        else
+        {
+          ret = errc::operation_not_supported;
+        }
+      }
+    }
+    _complete_cancelled(tocomplete);
+    return ret;
+  }
+
+  // This must check all i/o initiated or completed on this i/o multiplexer
+  // and invoke state transition from initiated to completed/finished, or from
+  // completed to finished, for no more than max_completions i/o states.
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0), size_t max_completions = (size_t) -1) noexcept override
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    check_for_any_completed_io_statistics ret;
+    for(;;)
+    {
+      {
+        _multiplexer_lock_guard g(this->_lock);
+        OUTCOME_TRY(_submit_all());
+        size_t count = _reap_all(g, max_completions);
+        if(count == 0 && !_is_polling && (_nonseekable.outstanding > 0 || _seekable.outstanding > 0))
+        {
+          // Completions may be waiting on task work to be run by this thread
+          for(auto *ring : {&_nonseekable, &_seekable})
+          {
+            if(ring->fd != -1 && ring->outstanding > 0 && _io_uring_enter(ring->fd, 0, 0, _IORING_ENTER_GETEVENTS) < 0 && EINTR != errno)
+            {
+              return posix_error();
+            }
+          }
+          count = _reap_all(g, max_completions);
+        }
+        if(count > 0 || _woken)
+        {
+          _woken = false;
+          ret.initiated_ios_finished += count;
+          return ret;
+        }
+      }
+      std::chrono::nanoseconds timeout(-1);
+      if(d)
+      {
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(timeout, d);
+        if(timeout.count() == 0)
+        {
+          return ret;
+        }
+      }
+      // Nothing completed. If only one ring has i/o outstanding, wait within the kernel on that ring.
+      _submission_completion_t *wait_ring = nullptr;
+      bool spin_iopoll = false;
+      {
+        _multiplexer_lock_guard g(this->_lock);
+        if(_iopoll.outstanding > 0)
+        {
+          // Nothing will ever wake a wait upon the IOPOLL ring unless the kernel submission thread polls it for us
+          spin_iopoll = !_is_polling;
+        }
+        else if(!d || _supported_ops[_IORING_OP_TIMEOUT])
+        {
+          wait_ring = (_seekable.fd == -1 || _seekable.outstanding == 0) ? &_nonseekable : ((_nonseekable.outstanding == 0) ? &_seekable : nullptr);
+        }
+        if(wait_ring != nullptr && d)
+        {
+          // Completes after the timeout, or after one other completion, whichever is first
+          _io_uring_sqe *sqe = _get_sqe(*wait_ring);
+          if(sqe == nullptr)
+          {
+            wait_ring = nullptr;
+          }
+          else
+          {
+            wait_ring->wait_timeout.tv_sec = (int64_t)(timeout.count() / 1000000000LL);
+            wait_ring->wait_timeout.tv_nsec = (long long) (timeout.count() % 1000000000LL);
+            sqe->opcode = _IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = (uint64_t)(uintptr_t) &wait_ring->wait_timeout;
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = _user_data_internal;
+            OUTCOME_TRY(_flush_ring(*wait_ring));
+          }
+        }
+      }
+      if(spin_iopoll)
+      {
+        // Spins polling the device until something completes, or the scheduler wants the CPU back
+        if(_io_uring_enter(_iopoll.fd, 0, 1, _IORING_ENTER_GETEVENTS) < 0 && EINTR != errno && EAGAIN != errno)
+        {
+          return posix_error();
+        }
+        continue;
+      }
+      if(wait_ring != nullptr)
+      {
+        if(_io_uring_enter(wait_ring->fd, 0, 1, _IORING_ENTER_GETEVENTS) < 0 && EINTR != errno)
+        {
+          return posix_error();
+        }
+        // The loop reaps any completions, and returns if the deadline has expired
+        continue;
+      }
+      // Otherwise wait for either ring to become readable
+      pollfd fds[3];
+      memset(fds, 0, sizeof(fds));
+      fds[0].fd = _nonseekable.fd;
+      fds[0].events = POLLIN;
+      fds[1].fd = _seekable.fd;  // poll() ignores negative fds
+      fds[1].events = POLLIN;
+      fds[2].fd = _is_polling ? _iopoll.fd : -1;  // only becomes readable if the kernel thread polls it
+      fds[2].events = POLLIN;
+      // Round up to the next millisecond, so we don't spin
+      int pollret = ::poll(fds, 3, (timeout.count() < 0) ? -1 : (int) ((timeout.count() + 999999) / 1000000));
+      if(pollret < 0)
+      {
+        if(EINTR == errno)
+        {
+          continue;
+        }
+        return posix_error();
+      }
+      if(pollret == 0)
+      {
+        // Timed out
+        return ret;
+      }
+    }
+  }
+
+  // This can be used from any kernel thread to cause a check_for_any_completed_io()
+  // running in another kernel thread to return early
+  virtual result<void> wake_check_for_any_completed_io() noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    // Post a null SQE to each ring, as a wait may be upon either. Its completion will break out any waits.
+    // The IOPOLL ring cannot execute NOPs, but waits upon it spin and so soon reap the wakeup from the other rings.
+    for(auto *ring : {&_nonseekable, &_seekable})
+    {
+      if(ring->fd == -1)
+      {
+        continue;
+      }
+      _io_uring_sqe *sqe = _get_sqe(*ring);
+      if(sqe == nullptr)
+      {
+        return errc::resource_unavailable_try_again;  // ring is full
+      }
+      sqe->opcode = _IORING_OP_NOP;
+      sqe->fd = -1;
+      sqe->user_data = _user_data_wakeup;
+      OUTCOME_TRY(_flush_ring(*ring));
+    }
+    return success();
+  }
+
+  // Submits the syscalls to the non-seekable ring, waiting for space in the ring if necessary
+  virtual result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override
+  {
+    using kind = typename posix_fs_syscall::kind;
+    auto opcode_for = [](const posix_fs_syscall &op) -> int {
+      switch(op.op)
+      {
+      case kind::openat:
+        return _IORING_OP_OPENAT;
+      case kind::statx:
+        return _IORING_OP_STATX;
+      case kind::close:
+        return _IORING_OP_CLOSE;
+      case kind::madvise:
+        // The length is only 32 bits
+        return (op.bytes <= UINT32_MAX) ? _IORING_OP_MADVISE : _IORING_OP_NOP;
+      case kind::unlinkat:
+        return _IORING_OP_UNLINKAT;
+      case kind::symlinkat:
+        return _IORING_OP_SYMLINKAT;
+      case kind::renameat:
+        return _IORING_OP_RENAMEAT;
+      case kind::pwrite:
+        return _IORING_OP_WRITE;
+      case kind::splice:
+        return _IORING_OP_SPLICE;
+      case kind::tee:
+        return _IORING_OP_TEE;
+      case kind::wait_process:
+        // A pidfd becomes readable when its process exits
+        return (op.fd != -1) ? _IORING_OP_POLL_ADD : _IORING_OP_NOP;
+      case kind::lock_range:
+      case kind::syncfs:
+        break;
+      }
+      return _IORING_OP_NOP;
+    };
+    // io_uring has no byte range lock nor syncfs opcode, and processes without a pidfd can't be polled, so these go to the waiter thread
+    auto by_waiter = [&](const posix_fs_syscall &op) -> bool {
+      if(op.op == kind::lock_range || op.op == kind::syncfs)
+      {
+        return true;
+      }
+      const int opcode = opcode_for(op);
+      return op.op == kind::wait_process && (opcode == _IORING_OP_NOP || !_supported_ops[opcode]);
+    };
+    // Kernels before Linux 5.6 (5.7 for splice, 5.8 for tee, 5.11 for unlinkat and renameat, 5.15 for symlinkat) can't do these, so execute them synchronously without the lock held
+    for(auto &op : ops)
+    {
+      op.result = posix_fs_syscall::pending;
+      if(by_waiter(op))
+      {
+        OUTCOME_TRY(_base::initiate_posix_fs_syscalls({&op, 1}));
+        continue;
+      }
+      const int opcode = opcode_for(op);
+      if(opcode == _IORING_OP_NOP || !_supported_ops[opcode])
+      {
+        OUTCOME_TRY(_base::do_posix_fs_syscalls({&op, 1}));
+      }
+    }
+    size_t submitted = 0;
+    for(;;)
+    {
+      {
+        _multiplexer_lock_guard g(this->_lock);
+        for(; submitted < ops.size(); submitted++)
+        {
+          auto &op = ops[submitted];
+          if(op.result != posix_fs_syscall::pending || by_waiter(op))
+          {
+            continue;
+          }
+          _io_uring_sqe *sqe = _get_sqe(_nonseekable);
+          if(sqe == nullptr)
+          {
+            // Ring is full, so wait for some of these to complete
+            break;
+          }
+          sqe->opcode = (uint8_t) opcode_for(op);
+          sqe->fd = op.fd;
+          sqe->user_data = (uint64_t)(uintptr_t) &op | _user_data_fs_syscall_tag;
+          switch(op.op)
+          {
+          case kind::openat:
+            sqe->addr = (uint64_t)(uintptr_t) op.path;
+            sqe->len = op.mode;
+            sqe->open_flags = (uint32_t) op.flags;
+            break;
+          case kind::statx:
+            sqe->addr = (uint64_t)(uintptr_t) op.path;
+            sqe->len = op.mode;
+            sqe->statx_flags = (uint32_t) op.flags;
+            sqe->addr2 = (uint64_t)(uintptr_t) op.buffer;
+            break;
+          case kind::close:
+            break;
+          case kind::madvise:
+            sqe->fd = -1;
+            sqe->addr = (uint64_t)(uintptr_t) op.buffer;
+            sqe->len = (uint32_t) op.bytes;
+            sqe->fadvise_advice = (uint32_t) op.flags;
+            break;
+          case kind::unlinkat:
+            sqe->addr = (uint64_t)(uintptr_t) op.path;
+            sqe->unlink_flags = (uint32_t) op.flags;
+            break;
+          case kind::symlinkat:
+            sqe->addr = (uint64_t)(uintptr_t) op.buffer;
+            sqe->addr2 = (uint64_t)(uintptr_t) op.path;
+            break;
+          case kind::renameat:
+            sqe->addr = (uint64_t)(uintptr_t) op.path;
+            sqe->len = (uint32_t) op.fd_out;
+            sqe->addr2 = (uint64_t)(uintptr_t) op.buffer;
+            sqe->rename_flags = (uint32_t) op.flags;
+            break;
+          case kind::pwrite:
+            sqe->addr = (uint64_t)(uintptr_t) op.buffer;
+            sqe->len = (uint32_t) std::min(op.bytes, (size_t) INT_MAX);
+            sqe->off = op.offset;
+            break;
+          case kind::splice:
+            // An offset of -1 means none to io_uring, the same as no_offset
+            sqe->fd = op.fd_out;
+            sqe->splice_fd_in = op.fd;
+            sqe->splice_off_in = op.offset;
+            sqe->off = op.offset_out;
+            sqe->len = (uint32_t) std::min(op.bytes, (size_t) INT_MAX);
+            sqe->splice_flags = (uint32_t) op.flags;
+            break;
+          case kind::tee:
+            sqe->fd = op.fd_out;
+            sqe->splice_fd_in = op.fd;
+            sqe->len = (uint32_t) std::min(op.bytes, (size_t) INT_MAX);
+            sqe->splice_flags = (uint32_t) op.flags;
+            break;
+          case kind::wait_process:
+            sqe->poll_events = POLLIN;
+            break;
+          case kind::lock_range:
+          case kind::syncfs:
+            break;
+          }
+        }
+        OUTCOME_TRY(_flush_ring(_nonseekable));
+        if(submitted == ops.size())
+        {
+          return success();
+        }
+        (void) _reap_all(g, (size_t) -1);
+      }
+      OUTCOME_TRY(check_for_any_completed_io(std::chrono::milliseconds(10)));
+    }
+  }
+
+  // Submits the syscalls, and waits for them all to complete
+  virtual result<void> do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override
+  {
+    OUTCOME_TRY(initiate_posix_fs_syscalls(ops));
+    size_t done = 0;
+    for(;;)
+    {
+      {
+        _multiplexer_lock_guard g(this->_lock);
+        (void) _reap_all(g, (size_t) -1);
+        while(done < ops.size() && ops[done].result != posix_fs_syscall::pending)
+        {
+          done++;
+        }
+        if(done == ops.size())
+        {
+          return success();
+        }
+      }
+      // Another thread may reap our completions and consume the wake, so don't wait forever
+      OUTCOME_TRY(check_for_any_completed_io(std::chrono::milliseconds(10)));
+    }
+  }
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, bool is_polling) noexcept
+{
+  try
+  {
+    if(1 == threads)
+    {
+      // Make non locking edition
+      auto ret = std::make_unique<linux_io_uring_multiplexer<false>>(is_polling);
+      OUTCOME_TRY(ret->init());
+      return io_multiplexer_ptr(ret.release());
+    }
+    auto ret = std::make_unique<linux_io_uring_multiplexer<true>>(is_polling);
+    OUTCOME_TRY(ret->init());
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, const linux_io_uring_sqpoll_config &sqpoll) noexcept
+{
+  if(sqpoll.idle.count() < 0 || sqpoll.idle.count() > (int64_t) UINT32_MAX || sqpoll.cpu >= CPU_SETSIZE)
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    if(1 == threads)
+    {
+      // Make non locking edition
+      auto ret = std::make_unique<linux_io_uring_multiplexer<false>>(true, sqpoll);
+      OUTCOME_TRY(ret->init());
+      return io_multiplexer_ptr(ret.release());
+    }
+    auto ret = std::make_unique<linux_io_uring_multiplexer<true>>(true, sqpoll);
+    OUTCOME_TRY(ret->init());
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<linux_io_uring_statistics> multiplexer_linux_io_uring_statistics(const io_multiplexer *multiplexer) noexcept
+{
+  if(auto *m = dynamic_cast<const linux_io_uring_multiplexer<false> *>(multiplexer))
+  {
+    return m->statistics();
+  }
+  if(auto *m = dynamic_cast<const linux_io_uring_multiplexer<true> *>(multiplexer))
+  {
+    return m->statistics();
+  }
+  return errc::invalid_argument;
+}
+
+LLFIO_V2_NAMESPACE_END
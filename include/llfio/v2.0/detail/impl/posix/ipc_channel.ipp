@@ -0,0 +1,98 @@
+/* A shared memory message channel between processes
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../ipc_channel.hpp"
+#include "import.hpp"
+
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  result<void> ipc_channel_wait(std::atomic<uint32_t> *addr, uint32_t expected, deadline d) noexcept
+  {
+    std::chrono::steady_clock::time_point began_steady;
+    if(d && d.steady)
+    {
+      began_steady = std::chrono::steady_clock::now();
+    }
+#ifndef __linux__
+    std::chrono::microseconds backoff(1);
+#endif
+    while(addr->load(std::memory_order_acquire) == expected)
+    {
+      LLFIO_POSIX_DEADLINE_TO_TIMEOUT_LOOP(d);
+#ifdef __linux__
+      struct timespec ts
+      {
+      };
+      struct timespec *timeout = nullptr;
+      if(d)
+      {
+        auto ns = d.steady ? std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds(d.nsecs)) - std::chrono::steady_clock::now()) :
+                             std::chrono::duration_cast<std::chrono::nanoseconds>(d.to_time_point() - std::chrono::system_clock::now());
+        if(ns.count() < 0)
+        {
+          ns = std::chrono::nanoseconds(0);
+        }
+        ts.tv_sec = ns.count() / 1000000000LL;
+        ts.tv_nsec = ns.count() % 1000000000LL;
+        timeout = &ts;
+      }
+      // Not FUTEX_PRIVATE_FLAG, as the waker may be in another process
+      if(-1 == ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, expected, timeout, nullptr, 0))  // NOLINT
+      {
+        if(errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+        {
+          return posix_error();
+        }
+      }
+#else
+      std::this_thread::sleep_for(backoff);
+      if(backoff < std::chrono::milliseconds(1))
+      {
+        backoff *= 2;
+      }
+#endif
+    }
+    return success();
+  }
+
+  void ipc_channel_wake(std::atomic<uint32_t> *addr) noexcept
+  {
+#ifdef __linux__
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);  // NOLINT
+#else
+    (void) addr;  // waiters poll
+#endif
+  }
+}  // namespace detail
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,1144 @@
+/* Multiplex pipe and file i/o using kqueue
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../io_handle.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#if !defined(__FreeBSD__) && !defined(__APPLE__)
+#error This implementation file is for FreeBSD and Mac OS only
+#endif
+
+#include <fcntl.h>
+#include <sys/event.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __FreeBSD__
+#include <aio.h>
+#include <sys/param.h>  // for __FreeBSD_version
+#endif
+
+#include "quickcpplib/signal_guard.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* kqueue can report both readiness and completion, so this i/o multiplexer is
+a reactor for pipes and sockets, and a proactor for files on FreeBSD.
+
+What we've thus done for this i/o multiplexer is this:
+
+- Non-seekable handles have EVFILT_READ and EVFILT_WRITE added once at registration,
+with EV_CLEAR i.e. edge triggered. There is thus never any kevent() change per i/o.
+Initiated i/o is attempted immediately if there is no i/o of the same direction
+queued for the handle, otherwise it enters a queue per handle and direction which is
+drained in order as the handle becomes ready, until EAGAIN.
+
+- On FreeBSD, i/o upon seekable handles is submitted using POSIX AIO, with SIGEV_KEVENT
+notification, so completions arrive as EVFILT_AIO events in the same kqueue. Scatter-gather
+i/o requires aio_readv()/aio_writev() (FreeBSD 13 onwards), otherwise only single buffer
+i/o is submitted to AIO. Barriers use aio_fsync(). If AIO refuses the i/o (e.g. the AIO
+queue limits have been reached), the i/o is performed synchronously instead.
+
+- On Mac OS, whose AIO cannot notify a kqueue, and for anything not handled above,
+i/o upon seekable handles is performed synchronously upon initiation.
+
+- Per-i/o deadlines are implemented by capping the kevent() timeout to the nearest
+deadline of any queued or in flight i/o. Queued i/o whose deadline has passed completes
+with `errc::timed_out`, AIO whose deadline has passed is cancelled with aio_cancel(),
+and completes with `errc::timed_out` if the cancellation succeeds. I/o with a deadline
+is kept in a list sorted by expiry, so neither costs anything in proportion to the i/o queued.
+
+- `wake_check_for_any_completed_io()` triggers an EVFILT_USER event.
+*/
+template <bool is_threadsafe> class bsd_kqueue_multiplexer final : public io_multiplexer_impl<is_threadsafe>
+{
+  friend LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_bsd_kqueue(size_t threads) noexcept;
+
+  using _base = io_multiplexer_impl<is_threadsafe>;
+  using _multiplexer_lock_guard = typename _base::_lock_guard;
+
+  using path_type = typename _base::path_type;
+  using extent_type = typename _base::extent_type;
+  using size_type = typename _base::size_type;
+  using mode = typename _base::mode;
+  using creation = typename _base::creation;
+  using caching = typename _base::caching;
+  using flag = typename _base::flag;
+  using barrier_kind = typename _base::barrier_kind;
+  using const_buffers_type = typename _base::const_buffers_type;
+  using buffers_type = typename _base::buffers_type;
+  using registered_buffer_type = typename _base::registered_buffer_type;
+  template <class T> using io_request = typename _base::template io_request<T>;
+  template <class T> using io_result = typename _base::template io_result<T>;
+  using io_operation_state = typename _base::io_operation_state;
+  using io_operation_state_visitor = typename _base::io_operation_state_visitor;
+  using check_for_any_completed_io_statistics = typename _base::check_for_any_completed_io_statistics;
+  using posix_fs_syscall = typename _base::posix_fs_syscall;
+
+  // The maximum number of kevents fetched per kevent()
+  static constexpr int _max_events = 64;
+  // The ident of the EVFILT_USER event used to wake waiters
+  static constexpr uintptr_t _wakeup_ident = 1;
+
+#if defined(__FreeBSD__)
+  static constexpr bool _have_aio = true;
+#if __FreeBSD_version >= 1300000
+  static constexpr bool _have_aio_vectored = true;
+#else
+  static constexpr bool _have_aio_vectored = false;
+#endif
+#else
+  static constexpr bool _have_aio = false;
+  static constexpr bool _have_aio_vectored = false;
+#endif
+
+  struct _kqueue_operation_state final : public std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>
+  {
+    using _impl = std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>;
+
+    _kqueue_operation_state *prev{nullptr}, *next{nullptr};
+    // If queued or in flight with a deadline which has not yet expired, its neighbours in the list of deadlines
+    _kqueue_operation_state *deadline_prev{nullptr}, *deadline_next{nullptr};
+    // These are cached here from the handle for performance
+    int fd{-1};
+    bool is_seekable{false};
+    // If the i/o has been submitted to AIO
+    bool in_aio{false};
+    // If cancellation has been requested, or the deadline expired, for in flight AIO
+    bool cancel_requested{false}, timed_out{false};
+    // If the i/o has a deadline, in which case expiry is when
+    bool has_deadline{false};
+    std::chrono::steady_clock::time_point expiry;
+#ifdef __FreeBSD__
+    // The kernel refers to this until the AIO completes, so the state must not be relocated whilst in_aio
+    struct aiocb aio;
+#endif
+
+    _kqueue_operation_state() = default;
+    // Construct implicitly from the base implementation, see relocate_to()
+    explicit _kqueue_operation_state(_impl &&o) noexcept
+        : _impl(std::move(o))
+    {
+    }
+    using _impl::_impl;
+
+    // You will need to reimplement this to relocate any custom state defined
+    // here, and to restamp to vptr with this finalised dynamic type. It is
+    // important to do this, as final-based optimisations compare the vptr
+    // to the finalised vptr and do non-indirect dispatch if they match.
+    virtual io_operation_state *relocate_to(byte *to_) noexcept override
+    {
+      assert(!in_aio);
+      auto *to = _impl::relocate_to(to_);
+      // restamp the vptr with my own
+      auto _to = new(to) _kqueue_operation_state(std::move(*static_cast<_impl *>(to)));
+      _to->fd = fd;
+      _to->is_seekable = is_seekable;
+      _to->in_aio = in_aio;
+      _to->cancel_requested = cancel_requested;
+      _to->timed_out = timed_out;
+      _to->has_deadline = has_deadline;
+      _to->expiry = expiry;
+      return _to;
+    }
+  };
+
+  // Coroutine awaitables store the i/o state inline, falling back to blocking i/o if it does not fit
+  static_assert(sizeof(_kqueue_operation_state) <= io_multiplexer::awaitable<io_result<buffers_type>>::_state_storage_bytes, "i/o state does not fit into an awaitable!");
+
+  struct _registered_fd
+  {
+    int fd{-1};  // -1 if this slot is not registered
+    bool is_seekable{false};
+    bool is_kqueued{false};  // true if readiness is reported by kqueue, otherwise i/o is performed using AIO or synchronously
+    struct queue_t
+    {
+      _kqueue_operation_state *first{nullptr}, *last{nullptr};
+    };
+    // contains initiated i/o waiting for the handle to become ready, by direction. Barriers are writes.
+    queue_t reads, writes;
+    // contains i/o submitted to AIO
+    queue_t inflight;
+  };
+
+  std::vector<_registered_fd> _registered_fds;  // indexed by fd
+  size_t _queued{0};                            // the number of i/o in queues, or in flight
+  detail::deadline_list<_kqueue_operation_state> _deadlines;  // i/o in queues, or in flight, with an unexpired deadline, soonest first
+
+  static void _enqueue_to(typename _registered_fd::queue_t &queue, _kqueue_operation_state *state) noexcept
+  {
+    assert(state->prev == nullptr);
+    assert(state->next == nullptr);
+    if(queue.first == nullptr)
+    {
+      queue.first = queue.last = state;
+    }
+    else
+    {
+      assert(queue.last->next == nullptr);
+      state->prev = queue.last;
+      queue.last->next = state;
+      queue.last = state;
+    }
+  }
+  static void _dequeue_from(typename _registered_fd::queue_t &queue, _kqueue_operation_state *state) noexcept
+  {
+    if(state->prev == nullptr)
+    {
+      assert(queue.first == state);
+      queue.first = state->next;
+    }
+    else
+    {
+      state->prev->next = state->next;
+    }
+    if(state->next == nullptr)
+    {
+      assert(queue.last == state);
+      queue.last = state->prev;
+    }
+    else
+    {
+      state->next->prev = state->prev;
+    }
+    state->next = state->prev = nullptr;
+  }
+  static typename _registered_fd::queue_t &_queue_for(_registered_fd &rfd, const _kqueue_operation_state *state) noexcept
+  {
+    if(state->in_aio)
+    {
+      return rfd.inflight;
+    }
+    return (state->state == io_operation_state_type::read_initiated) ? rfd.reads : rfd.writes;
+  }
+
+  // Performs the i/o using nonblocking syscalls, returning the bytes transferred or a negative errno
+  static ssize_t _attempt(_kqueue_operation_state *state) noexcept
+  {
+    ssize_t ret = -1;
+    switch(state->state)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      auto *iov = reinterpret_cast<struct iovec *>(reqs.buffers.data());
+      do
+      {
+        if(state->is_seekable)
+        {
+#if LLFIO_MISSING_PIOV
+          off_t offset = reqs.offset;
+          ret = 0;
+          for(size_t n = 0; n < reqs.buffers.size(); n++)
+          {
+            ssize_t r = ::pread(state->fd, iov[n].iov_base, iov[n].iov_len, offset);
+            if(r < 0)
+            {
+              ret = r;
+              break;
+            }
+            ret += r;
+            offset += r;
+            if((size_t) r < iov[n].iov_len)
+            {
+              break;
+            }
+          }
+#else
+          ret = ::preadv(state->fd, iov, (int) reqs.buffers.size(), reqs.offset);
+#endif
+        }
+        else
+        {
+          ret = ::readv(state->fd, iov, (int) reqs.buffers.size());
+        }
+      } while(ret < 0 && EINTR == errno);
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      auto *iov = reinterpret_cast<struct iovec *>(const_cast<typename const_buffers_type::value_type *>(reqs.buffers.data()));
+      do
+      {
+        if(state->is_seekable)
+        {
+#if LLFIO_MISSING_PIOV
+          off_t offset = reqs.offset;
+          ret = 0;
+          for(size_t n = 0; n < reqs.buffers.size(); n++)
+          {
+            ssize_t r = ::pwrite(state->fd, iov[n].iov_base, iov[n].iov_len, offset);
+            if(r < 0)
+            {
+              ret = r;
+              break;
+            }
+            ret += r;
+            offset += r;
+            if((size_t) r < iov[n].iov_len)
+            {
+              break;
+            }
+          }
+#else
+          ret = ::pwritev(state->fd, iov, (int) reqs.buffers.size(), reqs.offset);
+#endif
+        }
+        else
+        {
+          // Can't guarantee that user code hasn't enabled SIGPIPE
+          ret = QUICKCPPLIB_NAMESPACE::signal_guard::signal_guard(
+          QUICKCPPLIB_NAMESPACE::signal_guard::signalc_set::broken_pipe, [&] { return ::writev(state->fd, iov, (int) reqs.buffers.size()); },
+          [&](const QUICKCPPLIB_NAMESPACE::signal_guard::raised_signal_info * /*unused*/) {
+            errno = EPIPE;
+            return (ssize_t) -1;
+          });
+        }
+      } while(ret < 0 && EINTR == errno);
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+#ifdef __APPLE__
+      const auto kind = state->payload.noncompleted.params.barrier.kind;
+      if(((uint8_t) kind & 1) == 0)
+      {
+        // OS X fsync doesn't wait for the device to flush its buffers
+        ret = ::fsync(state->fd);
+      }
+      else
+      {
+        // This is the fsync as on every other OS
+        ret = ::fcntl(state->fd, F_FULLFSYNC);
+      }
+#else
+      ret = ::fsync(state->fd);
+#endif
+      break;
+    }
+    }
+    if(ret < 0)
+    {
+      return (EWOULDBLOCK == errno) ? -EAGAIN : -errno;
+    }
+    return ret;
+  }
+
+  /* Submits the i/o to AIO. Returns true if submitted, false if the i/o should be performed
+  synchronously instead. Must be called with the lock held.
+  */
+  bool _submit_aio(_kqueue_operation_state *state) noexcept
+  {
+#ifdef __FreeBSD__
+    memset(&state->aio, 0, sizeof(state->aio));
+    state->aio.aio_fildes = state->fd;
+    state->aio.aio_sigevent.sigev_notify = SIGEV_KEVENT;
+    state->aio.aio_sigevent.sigev_notify_kqueue = this->_v.fd;
+    state->aio.aio_sigevent.sigev_value.sival_ptr = state;
+    int ret = -1;
+    switch(state->state)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      state->aio.aio_offset = reqs.offset;
+      if(reqs.buffers.size() == 1)
+      {
+        state->aio.aio_buf = reqs.buffers[0].data();
+        state->aio.aio_nbytes = reqs.buffers[0].size();
+        ret = ::aio_read(&state->aio);
+      }
+#if __FreeBSD_version >= 1300000
+      else
+      {
+        state->aio.aio_iov = reinterpret_cast<struct iovec *>(reqs.buffers.data());
+        state->aio.aio_iovcnt = (int) reqs.buffers.size();
+        ret = ::aio_readv(&state->aio);
+      }
+#endif
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      state->aio.aio_offset = reqs.offset;
+      if(reqs.buffers.size() == 1)
+      {
+        state->aio.aio_buf = const_cast<byte *>(reqs.buffers[0].data());
+        state->aio.aio_nbytes = reqs.buffers[0].size();
+        ret = ::aio_write(&state->aio);
+      }
+#if __FreeBSD_version >= 1300000
+      else
+      {
+        state->aio.aio_iov = reinterpret_cast<struct iovec *>(const_cast<typename const_buffers_type::value_type *>(reqs.buffers.data()));
+        state->aio.aio_iovcnt = (int) reqs.buffers.size();
+        ret = ::aio_writev(&state->aio);
+      }
+#endif
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+#if defined(O_DSYNC) && __FreeBSD_version >= 1300000
+      const auto kind = state->payload.noncompleted.params.barrier.kind;
+      ret = ::aio_fsync((kind <= barrier_kind::wait_data_only) ? O_DSYNC : O_SYNC, &state->aio);
+#else
+      ret = ::aio_fsync(O_SYNC, &state->aio);
+#endif
+      break;
+    }
+    }
+    if(ret < 0)
+    {
+      // Usually because AIO queue limits have been reached, or AIO is not loaded
+      return false;
+    }
+    state->in_aio = true;
+    return true;
+#else
+    (void) state;
+    return false;
+#endif
+  }
+
+  // Completes and finishes an i/o. Must be called WITHOUT the lock held, and the state must not be touched afterwards.
+  static void _complete(_kqueue_operation_state *state, io_operation_state_type s, ssize_t res) noexcept
+  {
+    const bool was_cancelled = state->cancel_requested && -ECANCELED == res;
+    const bool was_timed_out = state->timed_out && -ECANCELED == res;
+    auto set_error = [&](auto &ret) {
+      if(was_cancelled)
+      {
+        ret = errc::operation_canceled;
+      }
+      else if(was_timed_out)
+      {
+        ret = errc::timed_out;
+      }
+      else
+      {
+        ret = posix_error((int) -res);
+      }
+    };
+    auto trim = [res](auto &buffers) {
+      size_t bytes = (size_t) res;
+      for(size_t i = 0; i < buffers.size(); i++)
+      {
+        auto &buffer = buffers[i];
+        if(buffer.size() <= bytes)
+        {
+          bytes -= buffer.size();
+        }
+        else
+        {
+          buffer = {buffer.data(), (size_type) bytes};
+          buffers = {buffers.data(), i + 1};
+          break;
+        }
+      }
+    };
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      io_result<buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->read_completed(std::move(ret));
+      state->read_finished();
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      else
+      {
+        trim(reqs.buffers);
+        ret = reqs.buffers;
+      }
+      state->write_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      auto &reqs = state->payload.noncompleted.params.barrier.reqs;
+      io_result<const_buffers_type> ret(reqs.buffers);
+      if(res < 0)
+      {
+        set_error(ret);
+      }
+      state->barrier_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      break;
+    }
+    }
+  }
+
+  // Removes a queued or in flight i/o, and completes it. Must be called with the lock held, which is released during completion.
+  void _dequeue_and_complete(_multiplexer_lock_guard &g, typename _registered_fd::queue_t &queue, _kqueue_operation_state *state, ssize_t res) noexcept
+  {
+    _dequeue_from(queue, state);
+    state->in_aio = false;
+    --_queued;
+    if(state->has_deadline && !state->timed_out)
+    {
+      _deadlines.remove(state);
+    }
+    const auto s = state->state;
+    g.unlock();
+    _complete(state, s, res);
+    g.lock();
+  }
+
+  /* Performs queued i/o upon a fd until it would block. Returns the number completed.
+  Must be called with the lock held, which is released during completions.
+  */
+  size_t _process(_multiplexer_lock_guard &g, int fd, bool reads, size_t max_completions) noexcept
+  {
+    size_t count = 0;
+    while(count < max_completions)
+    {
+      // Refetch each time, as the table may be resized while unlocked
+      auto &rfd = _registered_fds[fd];
+      auto &queue = reads ? rfd.reads : rfd.writes;
+      if(queue.first == nullptr)
+      {
+        break;
+      }
+      auto *state = queue.first;
+      const ssize_t res = _attempt(state);
+      if(-EAGAIN == res)
+      {
+        break;
+      }
+      _dequeue_and_complete(g, queue, state, res);
+      ++count;
+    }
+    return count;
+  }
+
+  // Reaps a completed AIO. Must be called with the lock held, which is released during completion.
+  void _reap_aio(_multiplexer_lock_guard &g, _kqueue_operation_state *state) noexcept
+  {
+#ifdef __FreeBSD__
+    assert(state->in_aio);
+    ssize_t res = ::aio_return(&state->aio);
+    if(res < 0)
+    {
+      res = -errno;
+    }
+    _dequeue_and_complete(g, _registered_fds[state->fd].inflight, state, res);
+#else
+    (void) g;
+    (void) state;
+    abort();
+#endif
+  }
+
+  // Cancels an in flight AIO. The AIO completion still arrives as normal. Must be called with the lock held.
+  static void _cancel_aio(_kqueue_operation_state *state) noexcept
+  {
+#ifdef __FreeBSD__
+    (void) ::aio_cancel(state->fd, &state->aio);
+#else
+    (void) state;
+#endif
+  }
+
+  // Completes any queued i/o whose deadline has passed, cancels any such AIO, and returns the nearest deadline remaining
+  size_t _expire(_multiplexer_lock_guard &g, size_t max_completions, std::chrono::steady_clock::time_point &nearest) noexcept
+  {
+    size_t count = 0;
+    nearest = std::chrono::steady_clock::time_point::max();
+    if(_deadlines.empty())
+    {
+      return count;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    // The list may have changed whilst unlocked, so refetch its front each time
+    while(_deadlines.first != nullptr && _deadlines.first->expiry <= now && count < max_completions)
+    {
+      auto *state = _deadlines.first;
+      if(state->in_aio)
+      {
+        // The AIO completion reaps it later
+        _deadlines.remove(state);
+        state->timed_out = true;
+        _cancel_aio(state);
+        continue;
+      }
+      _dequeue_and_complete(g, _queue_for(_registered_fds[state->fd], state), state, -ETIMEDOUT);
+      ++count;
+    }
+    if(_deadlines.first != nullptr)
+    {
+      nearest = _deadlines.first->expiry;
+    }
+    return count;
+  }
+
+public:
+  bsd_kqueue_multiplexer() = default;
+  bsd_kqueue_multiplexer(const bsd_kqueue_multiplexer &) = delete;
+  bsd_kqueue_multiplexer(bsd_kqueue_multiplexer &&) = delete;
+  bsd_kqueue_multiplexer &operator=(const bsd_kqueue_multiplexer &) = delete;
+  bsd_kqueue_multiplexer &operator=(bsd_kqueue_multiplexer &&) = delete;
+  virtual ~bsd_kqueue_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) bsd_kqueue_multiplexer::close();
+    }
+  }
+  result<void> init()
+  {
+    this->_v.fd = ::kqueue();
+    if(-1 == this->_v.fd)
+    {
+      return posix_error();
+    }
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    if(-1 == ::fcntl(this->_v.fd, F_SETFD, FD_CLOEXEC))
+    {
+      return posix_error();
+    }
+    struct kevent ev;
+    EV_SET(&ev, _wakeup_ident, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if(-1 == ::kevent(this->_v.fd, &ev, 1, nullptr, 0, nullptr))
+    {
+      return posix_error();
+    }
+    _registered_fds.reserve(64);
+    return success();
+  }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    this->_stop_posix_lock_waiter();
+    _multiplexer_lock_guard g(this->_lock);
+    if(_queued > 0)
+    {
+      // Can't close a multiplexer with i/o in progress
+      return errc::operation_in_progress;
+    }
+    OUTCOME_TRY(_base::close());
+    _registered_fds.clear();
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0)
+    {
+      return errc::bad_file_descriptor;
+    }
+    try
+    {
+      if((size_t) fd >= _registered_fds.size())
+      {
+        _registered_fds.resize(fd + 1);
+      }
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    auto &rfd = _registered_fds[fd];
+    if(rfd.fd != -1)
+    {
+      return errc::device_or_resource_busy;
+    }
+    bool is_kqueued = false;
+    if(!h->is_seekable())
+    {
+      // Either direction may be refused e.g. writes upon the read end of a pipe, but not both
+      for(auto filter : {EVFILT_READ, EVFILT_WRITE})
+      {
+        struct kevent ev;
+        EV_SET(&ev, fd, filter, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        if(-1 != ::kevent(this->_v.fd, &ev, 1, nullptr, 0, nullptr))
+        {
+          is_kqueued = true;
+        }
+      }
+    }
+    rfd = _registered_fd();
+    rfd.fd = fd;
+    rfd.is_seekable = h->is_seekable();
+    rfd.is_kqueued = is_kqueued;
+    return (uint8_t) 0;
+  }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    const int fd = h->native_handle().fd;
+    if(fd < 0 || (size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd != fd)
+    {
+      return errc::invalid_argument;
+    }
+    auto &rfd = _registered_fds[fd];
+    assert(rfd.reads.first == nullptr && rfd.writes.first == nullptr && rfd.inflight.first == nullptr);
+    if(rfd.reads.first != nullptr || rfd.writes.first != nullptr || rfd.inflight.first != nullptr)
+    {
+      // Can't deregister a handle with i/o in progress
+      return errc::operation_in_progress;
+    }
+    if(rfd.is_kqueued)
+    {
+      for(auto filter : {EVFILT_READ, EVFILT_WRITE})
+      {
+        struct kevent ev;
+        EV_SET(&ev, fd, filter, EV_DELETE, 0, 0, nullptr);
+        (void) ::kevent(this->_v.fd, &ev, 1, nullptr, 0, nullptr);  // may not have been added
+      }
+    }
+    rfd = _registered_fd();
+    return success();
+  }
+
+  virtual size_t do_io_handle_max_buffers(const io_handle * /*unused*/) const noexcept override
+  {
+#ifdef __APPLE__
+    return 1;
+#else
+    return IOV_MAX;
+#endif
+  }
+  // virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return {sizeof(_kqueue_operation_state), alignof(_kqueue_operation_state)}; }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_kqueue_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) == 0);
+    if(storage.size() < sizeof(_kqueue_operation_state) || ((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _kqueue_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_kqueue_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) == 0);
+    if(storage.size() < sizeof(_kqueue_operation_state) || ((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _kqueue_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    assert(storage.size() >= sizeof(_kqueue_operation_state));
+    assert(((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) == 0);
+    if(storage.size() < sizeof(_kqueue_operation_state) || ((uintptr_t) storage.data() % alignof(_kqueue_operation_state)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _kqueue_operation_state(_h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+
+  virtual io_operation_state_type init_io_operation(io_operation_state *_op) noexcept override
+  {
+    auto *state = static_cast<_kqueue_operation_state *>(_op);
+    auto s = state->current_state();  // read the current state, holding the state's lock
+    if(!is_initialised(s))
+    {
+      assert(false);
+      return s;
+    }
+    state->fd = state->h->native_handle().fd;
+    state->is_seekable = state->h->is_seekable();
+    const deadline d = state->payload.noncompleted.d;
+    if(d)
+    {
+      state->has_deadline = true;
+      if(d.steady)
+      {
+        state->expiry = std::chrono::steady_clock::now() + std::chrono::nanoseconds(d.nsecs);
+      }
+      else
+      {
+        state->expiry = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d.to_time_point() - std::chrono::system_clock::now());
+      }
+    }
+    switch(s)
+    {
+    default:
+      abort();
+    case io_operation_state_type::read_initialised:
+      state->read_initiated();
+      break;
+    case io_operation_state_type::write_initialised:
+      state->write_initiated();
+      break;
+    case io_operation_state_type::barrier_initialised:
+      if(state->h->is_pipe() || state->h->is_socket())
+      {
+        // Nothing to flush, so complete immediately
+        state->barrier_completed(io_result<const_buffers_type>(const_buffers_type()));
+        state->write_or_barrier_finished();
+        return io_operation_state_type::write_or_barrier_finished;
+      }
+      state->barrier_initiated();
+      break;
+    }
+    _multiplexer_lock_guard g(this->_lock);
+    if(state->fd < 0 || (size_t) state->fd >= _registered_fds.size() || _registered_fds[state->fd].fd != state->fd)
+    {
+      // Handle has not been registered with this multiplexer
+      assert(false);
+      g.unlock();
+      _complete(state, state->current_state(), -EBADF);
+      return state->current_state();
+    }
+    auto &rfd = _registered_fds[state->fd];
+    if(rfd.is_seekable && _have_aio && (_have_aio_vectored || state->state == io_operation_state_type::barrier_initiated ||
+                                        ((state->state == io_operation_state_type::read_initiated) ? state->payload.noncompleted.params.read.reqs.buffers.size() :
+                                                                                                      state->payload.noncompleted.params.write.reqs.buffers.size()) == 1))
+    {
+      if(_submit_aio(state))
+      {
+        _enqueue_to(rfd.inflight, state);
+        ++_queued;
+        if(state->has_deadline)
+        {
+          _deadlines.insert(state);
+        }
+        return state->state;
+      }
+    }
+    auto &queue = _queue_for(rfd, state);
+    if(queue.first == nullptr)
+    {
+      // Nothing ahead of us, so try the i/o immediately
+      const ssize_t res = _attempt(state);
+      if(-EAGAIN != res || !rfd.is_kqueued || (state->has_deadline && state->expiry <= std::chrono::steady_clock::now()))
+      {
+        const auto ns = state->state;
+        g.unlock();
+        _complete(state, ns, (-EAGAIN == res && state->has_deadline) ? -ETIMEDOUT : res);
+        return state->current_state();
+      }
+    }
+    _enqueue_to(queue, state);
+    ++_queued;
+    if(state->has_deadline)
+    {
+      _deadlines.insert(state);
+    }
+    return state->state;
+  }
+
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  // virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+
+  // i/o is always attempted or submitted upon initiation, so there is nothing to flush
+  virtual result<void> flush_inited_io_operations() noexcept override { return success(); }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *_op) noexcept override
+  {
+    auto *state = static_cast<_kqueue_operation_state *>(_op);
+    const auto s = state->current_state();
+    if(is_initiated(s) && !is_completed(s) && !is_finished(s))
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      if(!state->in_aio)
+      {
+        _process(g, state->fd, state->state == io_operation_state_type::read_initiated, (size_t) -1);
+      }
+#ifdef __FreeBSD__
+      else if(EINPROGRESS != ::aio_error(&state->aio))
+      {
+        // Its kevent will arrive later, but we may as well complete it now. Consume the kevent so it doesn't refer to a dead state.
+        struct kevent ev;
+        struct timespec ts = {0, 0};
+        while(::kevent(this->_v.fd, nullptr, 0, &ev, 1, &ts) > 0)
+        {
+          if(ev.filter == EVFILT_AIO)
+          {
+            _reap_aio(g, (_kqueue_operation_state *) ev.udata);
+            if(ev.udata == state)
+            {
+              break;
+            }
+          }
+          else if(ev.filter == EVFILT_PROC)
+          {
+            ((posix_fs_syscall *) ev.udata)->result = 0;
+          }
+          else if(ev.filter != EVFILT_USER)
+          {
+            _process(g, (int) ev.ident, ev.filter == EVFILT_READ, (size_t) -1);
+          }
+        }
+      }
+#endif
+    }
+    return _op->current_state();
+  }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *_op, deadline d = {}) noexcept override
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    auto *state = static_cast<_kqueue_operation_state *>(_op);
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      const auto s = state->current_state();
+      if(!is_initiated(s) || is_completed(s) || is_finished(s))
+      {
+        return s;
+      }
+      if(!state->in_aio)
+      {
+        // i/o which is only queued can always be cancelled immediately
+        state->cancel_requested = true;
+        auto &queue = _queue_for(_registered_fds[state->fd], state);
+        _dequeue_and_complete(g, queue, state, -ECANCELED);
+        return state->current_state();
+      }
+      if(!state->cancel_requested)
+      {
+        state->cancel_requested = true;
+        _cancel_aio(state);
+      }
+    }
+    if(d)
+    {
+      for(;;)
+      {
+        const auto s = state->current_state();
+        if(is_finished(s))
+        {
+          return s;
+        }
+        deadline nd;
+        LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+        OUTCOME_TRY(check_for_any_completed_io(nd));
+        if(!([&]() -> result<void> {
+             LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+             return success();
+           })())
+        {
+          break;
+        }
+      }
+    }
+    return state->current_state();
+  }
+
+  // This must check all i/o initiated or completed on this i/o multiplexer
+  // and invoke state transition from initiated to completed/finished, or from
+  // completed to finished, for no more than max_completions i/o states.
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0), size_t max_completions = (size_t) -1) noexcept override
+  {
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    check_for_any_completed_io_statistics ret;
+    for(;;)
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      std::chrono::steady_clock::time_point nearest;
+      size_t count = _expire(g, max_completions, nearest);
+      if(count > 0)
+      {
+        ret.initiated_ios_finished += count;
+        return ret;
+      }
+      // Nothing completed, so wait for the handles to become ready, or AIO to complete
+      std::chrono::nanoseconds timeout(-1);
+      if(d)
+      {
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(timeout, d);
+      }
+      if(nearest != std::chrono::steady_clock::time_point::max())
+      {
+        auto untilnearest = std::chrono::duration_cast<std::chrono::nanoseconds>(nearest - std::chrono::steady_clock::now());
+        if(untilnearest.count() < 0)
+        {
+          untilnearest = std::chrono::nanoseconds(0);
+        }
+        if(timeout.count() < 0 || untilnearest < timeout)
+        {
+          timeout = untilnearest;
+        }
+      }
+      struct timespec ts;
+      ts.tv_sec = (time_t)(timeout.count() / 1000000000LL);
+      ts.tv_nsec = (long) (timeout.count() % 1000000000LL);
+      // If max_completions is less than _max_events, fetch no more events than that so none need to be remembered
+      const int maxevents = (max_completions < (size_t) _max_events) ? (int) max_completions : _max_events;
+      g.unlock();
+      struct kevent events[_max_events];
+      int nevents = ::kevent(this->_v.fd, nullptr, 0, events, maxevents, (timeout.count() < 0) ? nullptr : &ts);
+      if(nevents < 0)
+      {
+        if(EINTR == errno)
+        {
+          continue;
+        }
+        return posix_error();
+      }
+      g.lock();
+      bool woken = false;
+      for(int n = 0; n < nevents; n++)
+      {
+        const auto &ev = events[n];
+        if(ev.filter == EVFILT_USER)
+        {
+          woken = true;
+          continue;
+        }
+        if(ev.filter == EVFILT_PROC)
+        {
+          // The process of a wait_process has exited
+          ((posix_fs_syscall *) ev.udata)->result = 0;
+          woken = true;
+          continue;
+        }
+#ifdef __FreeBSD__
+        if(ev.filter == EVFILT_AIO)
+        {
+          // AIO completions must always be reaped, as the kernel no longer refers to the state
+          _reap_aio(g, (_kqueue_operation_state *) ev.udata);
+          ++count;
+          continue;
+        }
+#endif
+        const int fd = (int) ev.ident;
+        if((size_t) fd >= _registered_fds.size() || _registered_fds[fd].fd != fd)
+        {
+          // Deregistered since the event was raised
+          continue;
+        }
+        // As the readiness is edge triggered, all i/o which can complete must be completed now
+        count += _process(g, fd, ev.filter == EVFILT_READ, (size_t) -1);
+      }
+      if(count > 0 || woken)
+      {
+        ret.initiated_ios_finished += count;
+        return ret;
+      }
+      if(d)
+      {
+        // i/o deadlines are handled at the top of the loop, but we must also honour our own
+        std::chrono::nanoseconds remaining;
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(remaining, d);
+        if(remaining.count() == 0)
+        {
+          // Timed out
+          return ret;
+        }
+      }
+    }
+  }
+
+  // Process exits are delivered as EVFILT_PROC events, everything else is done by the base implementation
+  virtual result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override
+  {
+    for(auto &op : ops)
+    {
+      if(op.op != posix_fs_syscall::kind::wait_process)
+      {
+        OUTCOME_TRY(_base::initiate_posix_fs_syscalls({&op, 1}));
+        continue;
+      }
+      op.result = posix_fs_syscall::pending;
+      struct kevent ev;
+      EV_SET(&ev, (uintptr_t) op.offset, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, &op);
+      if(-1 == ::kevent(this->_v.fd, &ev, 1, nullptr, 0, nullptr))
+      {
+        // ESRCH means it has already exited
+        op.result = (ESRCH == errno) ? 0 : -errno;
+      }
+    }
+    return success();
+  }
+
+  // This can be used from any kernel thread to cause a check_for_any_completed_io()
+  // running in another kernel thread to return early
+  virtual result<void> wake_check_for_any_completed_io() noexcept override
+  {
+    struct kevent ev;
+    EV_SET(&ev, _wakeup_ident, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    if(-1 == ::kevent(this->_v.fd, &ev, 1, nullptr, 0, nullptr))
+    {
+      return posix_error();
+    }
+    return success();
+  }
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_bsd_kqueue(size_t threads) noexcept
+{
+  try
+  {
+    if(1 == threads)
+    {
+      // Make non locking edition
+      auto ret = std::make_unique<bsd_kqueue_multiplexer<false>>();
+      OUTCOME_TRY(ret->init());
+      return io_multiplexer_ptr(ret.release());
+    }
+    auto ret = std::make_unique<bsd_kqueue_multiplexer<true>>();
+    OUTCOME_TRY(ret->init());
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -27,7 +27,16 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "quickcpplib/signal_guard.hpp"
 
+#include <thread>
+
 #include <sys/mman.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 //#define LLFIO_DEBUG_LINUX_MUNMAP
 
@@ -78,8 +87,43 @@ result<void> section_handle::close() noexcept
   return success();
 }
 
+#ifdef __linux__
+namespace detail
+{
+  // True if the file is on a DAX mount i.e. its pages are persistent memory, not page cache. Needs Linux 5.8 or later.
+  inline bool is_dax_file(int fd) noexcept
+  {
+#ifdef __NR_statx
+    struct
+    {
+      uint32_t stx_mask;
+      uint32_t stx_blksize;
+      uint64_t stx_attributes;
+      char __remainder[240];
+    } buffer{};
+    static constexpr uint64_t STATX_ATTR_DAX_ = 0x00200000U;
+    if(-1 == ::syscall(__NR_statx, fd, "", 0x1000 /*AT_EMPTY_PATH*/, 0, &buffer))
+    {
+      return false;
+    }
+    return (buffer.stx_attributes & STATX_ATTR_DAX_) != 0;
+#else
+    (void) fd;
+    return false;
+#endif
+  }
+}  // namespace detail
+#endif
+
 result<section_handle> section_handle::section(file_handle &backing, extent_type /* unused */, flag _flag) noexcept
 {
+#ifdef __linux__
+  // Shared maps of files on DAX mounts are of persistent memory, so mark them as such to get MAP_SYNC maps and userspace barriers
+  if(!(_flag & flag::cow) && !(_flag & flag::nvram) && detail::is_dax_file(backing.native_handle().fd))
+  {
+    _flag |= flag::nvram;
+  }
+#endif
   result<section_handle> ret(section_handle(native_handle_type(), &backing, file_handle(), _flag));
   native_handle_type &nativeh = ret.value()._v;
   nativeh.fd = backing.native_handle().fd;
@@ -100,6 +144,33 @@ result<section_handle> section_handle::section(extent_type bytes, const path_han
 {
   OUTCOME_TRY(auto &&_anonh, file_handle::temp_inode(dirh));
   OUTCOME_TRYV(_anonh.truncate(bytes));
+  return _anonymous_section(bytes, std::move(_anonh), _flag);
+}
+
+result<section_handle> section_handle::anonymous_section(extent_type bytes, flag _flag) noexcept
+{
+#ifdef __linux__
+  native_handle_type nativeh(native_handle_type::disposition::file | native_handle_type::disposition::readable | native_handle_type::disposition::writable |
+                             native_handle_type::disposition::seekable,
+                             (int) ::syscall(SYS_memfd_create, "llfio_section", 1U /*MFD_CLOEXEC*/ | 2U /*MFD_ALLOW_SEALING*/));
+  if(-1 == nativeh.fd)
+  {
+    if(ENOSYS != errno)
+    {
+      return posix_error();
+    }
+    return section(bytes, path_discovery::memory_backed_temporary_files_directory(), _flag);
+  }
+  file_handle _anonh(nativeh, 0, 0, file_handle::caching::temporary, file_handle::flag::anonymous_inode, nullptr);
+  OUTCOME_TRYV(_anonh.truncate(bytes));
+  return _anonymous_section(bytes, std::move(_anonh), _flag);
+#else
+  return section(bytes, path_discovery::memory_backed_temporary_files_directory(), _flag);
+#endif
+}
+
+result<section_handle> section_handle::_anonymous_section(extent_type /*unused*/, file_handle &&_anonh, flag _flag) noexcept
+{
   result<section_handle> ret(section_handle(native_handle_type(), nullptr, std::move(_anonh), _flag));
   native_handle_type &nativeh = ret.value()._v;
   file_handle &anonh = ret.value()._anonymous;
@@ -117,6 +188,59 @@ result<section_handle> section_handle::section(extent_type bytes, const path_han
   return ret;
 }
 
+#ifdef __linux__
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#define F_SEAL_WRITE 0x0008
+#endif
+#endif
+
+result<void> section_handle::seal() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+  if(_backing != nullptr || !_anonymous.is_valid())
+  {
+    return errc::operation_not_supported;
+  }
+  if(-1 == ::fcntl(_v.fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL))
+  {
+    // Inodes not from memfd_create(MFD_ALLOW_SEALING) refuse with EPERM or EINVAL
+    if(EPERM == errno || EINVAL == errno)
+    {
+      return errc::operation_not_supported;
+    }
+    return posix_error();
+  }
+  return success();
+#else
+  return errc::operation_not_supported;
+#endif
+}
+
+result<bool> section_handle::is_sealed() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+  int seals = ::fcntl(_v.fd, F_GET_SEALS);
+  if(-1 == seals)
+  {
+    if(EINVAL == errno)
+    {
+      return false;
+    }
+    return posix_error();
+  }
+  return (seals & F_SEAL_WRITE) != 0;
+#else
+  return false;
+#endif
+}
+
 result<section_handle::extent_type> section_handle::length() const noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -163,6 +287,314 @@ map_handle::~map_handle()
   }
 }
 
+namespace detail
+{
+  /* A per-thread cache of closed allocations which are MADV_FREE'd rather than unmapped,
+  so recycling them costs neither a munmap() TLB shootdown across every CPU the process
+  has run upon, nor the faulting in of freshly zeroed pages. Items are size classed by
+  their most significant bit, with the most recently closed in each class reused first.
+  */
+  struct map_handle_cache_t
+  {
+    static constexpr size_t classes = 25;  // up to cache_max_item_bytes
+    static constexpr size_t items_per_class = 16;
+    static_assert(((size_t) 1 << (classes - 1)) == map_handle::cache_max_item_bytes, "classes does not match cache_max_item_bytes");
+
+    struct item_t
+    {
+      byte *addr;
+      size_t bytes;
+    };
+    item_t items[classes][items_per_class]{};
+    size_t counts[classes]{};
+    map_handle::cache_statistics_t stats{};
+    bool dead{false};
+
+    static size_t class_for(size_t bytes) noexcept { return (__CHAR_BIT__ * sizeof(unsigned long long) - 1) - __builtin_clzll((unsigned long long) bytes); }
+
+    bool take(size_t bytes, item_t &out) noexcept
+    {
+      for(size_t c = class_for(bytes), e = c + 2; c < e && c < classes; c++)
+      {
+        for(size_t n = counts[c]; n-- > 0;)
+        {
+          if(items[c][n].bytes >= bytes)
+          {
+            out = items[c][n];
+            memmove(&items[c][n], &items[c][n + 1], (counts[c] - n - 1) * sizeof(item_t));
+            --counts[c];
+            stats.items_in_cache--;
+            stats.bytes_in_cache -= out.bytes;
+            stats.hits++;
+            return true;
+          }
+        }
+      }
+      stats.misses++;
+      return false;
+    }
+    bool add(byte *addr, size_t bytes) noexcept
+    {
+#ifdef MADV_FREE
+      if(dead || bytes > map_handle::cache_max_item_bytes || stats.bytes_in_cache + bytes > map_handle::cache_max_bytes)
+      {
+        return false;
+      }
+      const size_t c = class_for(bytes);
+      if(counts[c] == items_per_class || -1 == ::madvise(addr, bytes, MADV_FREE))
+      {
+        return false;
+      }
+      items[c][counts[c]++] = {addr, bytes};
+      stats.items_in_cache++;
+      stats.bytes_in_cache += bytes;
+      return true;
+#else
+      (void) addr;
+      (void) bytes;
+      return false;
+#endif
+    }
+    void trim() noexcept
+    {
+      for(size_t c = 0; c < classes; c++)
+      {
+        for(size_t n = 0; n < counts[c]; n++)
+        {
+          (void) ::munmap(items[c][n].addr, items[c][n].bytes);
+        }
+        counts[c] = 0;
+      }
+      stats.items_in_cache = 0;
+      stats.bytes_in_cache = 0;
+    }
+    ~map_handle_cache_t()
+    {
+      trim();
+      // Allocations closed by later thread local or static destructors get unmapped
+      dead = true;
+    }
+  };
+  inline map_handle_cache_t &map_handle_cache() noexcept
+  {
+    static thread_local map_handle_cache_t v;
+    return v;
+  }
+
+  /* Applies madvise() advice to many regions, using as few syscalls as possible. Linux 5.10
+  onwards has process_madvise() which takes an iovec of regions, though until 6.13 it would only
+  accept a few advices which we remember per advice upon first refusal. Returns false with errno set
+  if any region could not be advised.
+  */
+  inline bool madvise_regions(span<map_handle::buffer_type> regions, int advice) noexcept
+  {
+    size_t idx = 0;
+#ifdef __linux__
+    static std::atomic<unsigned> process_madvise_refused{0};
+    const unsigned advicebit = (advice >= 0 && advice < 32) ? (1U << advice) : 0;
+    if(regions.size() > 2 && advicebit != 0 && !(process_madvise_refused.load(std::memory_order_relaxed) & advicebit))
+    {
+      // Opened per call rather than cached, so a fork() never advises the parent's pages
+      int pidfd = (int) ::syscall(434 /*__NR_pidfd_open*/, ::getpid(), 0);
+      if(pidfd != -1)
+      {
+        auto unpidfd = make_scope_exit([pidfd]() noexcept { ::close(pidfd); });
+        while(idx < regions.size())
+        {
+          struct iovec vec[1024];
+          size_t count = 0;
+          for(; count < 1024 && idx + count < regions.size(); count++)
+          {
+            vec[count].iov_base = regions[idx + count].data();
+            vec[count].iov_len = regions[idx + count].size();
+          }
+          auto ret = ::syscall(440 /*__NR_process_madvise*/, pidfd, vec, count, advice, 0);
+          if(ret <= 0)
+          {
+            if(ret == -1 && (errno == EINVAL || errno == ENOSYS))
+            {
+              process_madvise_refused.fetch_or(advicebit, std::memory_order_relaxed);
+            }
+            break;
+          }
+          // The kernel may stop early, so skip past whatever it completed
+          size_t done = (size_t) ret;
+          while(idx < regions.size() && done >= regions[idx].size())
+          {
+            done -= regions[idx++].size();
+          }
+          if(done > 0)
+          {
+            if(-1 == ::madvise(regions[idx].data() + done, regions[idx].size() - done, advice))
+            {
+              return false;
+            }
+            idx++;
+          }
+        }
+      }
+    }
+#endif
+    for(; idx < regions.size(); idx++)
+    {
+      if(-1 == ::madvise(regions[idx].data(), regions[idx].size(), advice))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+#ifdef __linux__
+  static constexpr uint64_t pagemap_soft_dirty = 1ULL << 55U;
+
+  /* Kernels without CONFIG_MEM_SOFT_DIRTY accept writes to /proc/self/clear_refs, but never
+  set the soft-dirty bit, so look at the bit for a page we have just written to.
+  */
+  inline bool soft_dirty_supported() noexcept
+  {
+    static std::atomic<int> state{0};
+    int v = state.load(std::memory_order_relaxed);
+    if(v == 0)
+    {
+      volatile uint64_t probe = 78;
+      v = -1;
+      int fd = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+      if(fd != -1)
+      {
+        uint64_t entry = 0;
+        if(sizeof(entry) == ::pread(fd, &entry, sizeof(entry), (off_t)(((uintptr_t) &probe / utils::page_size()) * sizeof(entry))) &&
+           (entry & pagemap_soft_dirty) != 0 && probe == 78)
+        {
+          v = 1;
+        }
+        ::close(fd);
+      }
+      state.store(v, std::memory_order_relaxed);
+    }
+    return v > 0;
+  }
+
+  // Appends page to out, merging with the last, returning false if out is full
+  inline bool append_dirty_region(span<map_handle::buffer_type> out, size_t &count, byte *addr, size_t bytes) noexcept
+  {
+    if(count > 0 && out[count - 1].data() + out[count - 1].size() == addr)
+    {
+      out[count - 1] = {out[count - 1].data(), out[count - 1].size() + bytes};
+      return true;
+    }
+    if(count == out.size())
+    {
+      return false;
+    }
+    out[count++] = {addr, bytes};
+    return true;
+  }
+
+  inline result<span<map_handle::buffer_type>> soft_dirty_regions(span<map_handle::buffer_type> out, map_handle::buffer_type region) noexcept
+  {
+    int fd = ::open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if(-1 == fd)
+    {
+      return posix_error();
+    }
+    auto unfd = make_scope_exit([fd]() noexcept { ::close(fd); });
+    size_t count = 0;
+    const uintptr_t end = (uintptr_t)(region.data() + region.size());
+    // Linux 6.7 onwards can return the dirty extents directly, rather than us reading an entry per page
+    static std::atomic<bool> no_pagemap_scan{false};
+    if(!no_pagemap_scan.load(std::memory_order_relaxed))
+    {
+      struct page_region_t
+      {
+        uint64_t start, end, categories;
+      };
+      struct pm_scan_arg_t
+      {
+        uint64_t size, flags, start, end, walk_end, vec, vec_len, max_pages, category_inverted, category_mask, category_anyof_mask, return_mask;
+      };
+      static_assert(sizeof(pm_scan_arg_t) == 96, "pm_scan_arg_t does not match the kernel's struct pm_scan_arg");
+      page_region_t vec[64];
+      uint64_t start = (uintptr_t) region.data();
+      while(start < end)
+      {
+        pm_scan_arg_t arg{};
+        arg.size = sizeof(arg);
+        arg.start = start;
+        arg.end = end;
+        arg.vec = (uintptr_t) vec;
+        arg.vec_len = (std::min)(sizeof(vec) / sizeof(vec[0]), (out.size() - count) + 1);
+        arg.category_mask = arg.return_mask = 1U << 7U /*PAGE_IS_SOFT_DIRTY*/;
+        int ret = ::ioctl(fd, 0xc0606610 /*PAGEMAP_SCAN*/, &arg);
+        if(ret < 0)
+        {
+          if(errno != ENOTTY && errno != EINVAL)
+          {
+            return posix_error();
+          }
+          no_pagemap_scan.store(true, std::memory_order_relaxed);
+          break;
+        }
+        for(int n = 0; n < ret; n++)
+        {
+          if(!append_dirty_region(out, count, (byte *) (uintptr_t) vec[n].start, (size_t)(vec[n].end - vec[n].start)))
+          {
+            return span<map_handle::buffer_type>(out.data(), count);
+          }
+        }
+        if(arg.walk_end <= start)
+        {
+          break;
+        }
+        start = arg.walk_end;
+      }
+      if(!no_pagemap_scan.load(std::memory_order_relaxed))
+      {
+        return span<map_handle::buffer_type>(out.data(), count);
+      }
+    }
+    const size_t pagesize = utils::page_size();
+    uint64_t entries[512];
+    for(uintptr_t addr = (uintptr_t) region.data(); addr < end;)
+    {
+      const size_t toread = (std::min)(sizeof(entries) / sizeof(entries[0]), (size_t)((end - addr) / pagesize));
+      auto bytesread = ::pread(fd, entries, toread * sizeof(entries[0]), (off_t)((addr / pagesize) * sizeof(entries[0])));
+      if(bytesread <= 0)
+      {
+        if(bytesread < 0)
+        {
+          return posix_error();
+        }
+        break;
+      }
+      const size_t read = (size_t) bytesread / sizeof(entries[0]);
+      for(size_t n = 0; n < read; n++)
+      {
+        if((entries[n] & pagemap_soft_dirty) != 0 && !append_dirty_region(out, count, (byte *) (addr + n * pagesize), pagesize))
+        {
+          return span<map_handle::buffer_type>(out.data(), count);
+        }
+      }
+      addr += read * pagesize;
+    }
+    return span<map_handle::buffer_type>(out.data(), count);
+  }
+#endif
+}  // namespace detail
+
+map_handle::cache_statistics_t map_handle::cache_statistics() noexcept
+{
+  return detail::map_handle_cache().stats;
+}
+
+map_handle::cache_statistics_t map_handle::trim_cache() noexcept
+{
+  auto &cache = detail::map_handle_cache();
+  auto ret = cache.stats;
+  cache.trim();
+  return ret;
+}
+
 result<void> map_handle::close() noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -173,7 +605,11 @@ result<void> map_handle::close() noexcept
       OUTCOME_TRYV(map_handle::barrier(barrier_kind::wait_all));
     }
     // printf("%d munmap %p-%p\n", getpid(), _addr, _addr+_reservation);
-    if(-1 == ::munmap(_addr, _reservation))
+    if(_recyclable && detail::map_handle_cache().add(_addr, _reservation))
+    {
+      // Recycled instead of unmapped
+    }
+    else if(-1 == ::munmap(_addr, _reservation))
     {
 #ifdef LLFIO_DEBUG_LINUX_MUNMAP
       int olderrno = errno;
@@ -195,27 +631,34 @@ result<void> map_handle::close() noexcept
 #endif
       return posix_error();
     }
+    _account_page_size(-(ptrdiff_t) _reservation);
   }
   // We don't want ~handle() to close our borrowed handle
   _v = native_handle_type();
   _addr = nullptr;
   _length = 0;
+  _recyclable = false;
   return success();
 }
 
 native_handle_type map_handle::release() noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  if(_addr != nullptr)
+  {
+    _account_page_size(-(ptrdiff_t) _reservation);
+  }
   // We don't want ~handle() to close our borrowed handle
   _v = native_handle_type();
   _addr = nullptr;
   _length = 0;
+  _recyclable = false;
   return {};
 }
 
 map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_barrier(map_handle::io_request<map_handle::const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   byte *addr = _addr + reqs.offset;
   size_type bytes = 0;
   // Check for overflow
@@ -298,14 +741,16 @@ static inline result<void *> do_mmap(native_handle_type &nativeh, void *ataddr,
     flags |= MAP_NORESERVE;
   }
 #endif
+  // Write and asynchronous prefaulting are done after the map is created
+  const bool prefault_later = (prot != PROT_NONE) && ((_flag & section_handle::flag::prefault_write) || (_flag & section_handle::flag::prefault_async));
 #ifdef MAP_POPULATE
-  if(_flag & section_handle::flag::prefault)
+  if((_flag & section_handle::flag::prefault) && !prefault_later)
   {
     flags |= MAP_POPULATE;
   }
 #endif
 #ifdef MAP_PREFAULT_READ
-  if(_flag & section_handle::flag::prefault)
+  if((_flag & section_handle::flag::prefault) && !prefault_later)
     flags |= MAP_PREFAULT_READ;
 #endif
 #ifdef MAP_NOSYNC
@@ -352,6 +797,15 @@ static inline result<void *> do_mmap(native_handle_type &nativeh, void *ataddr,
     int flagscopy = flags & ~MAP_SHARED;
     flagscopy |= MAP_SHARED_VALIDATE | MAP_SYNC;
     addr = ::mmap(ataddr, bytes, prot, flagscopy, fd_to_use, offset);
+    if(MAP_FAILED == addr)  // NOLINT
+    {
+      // Kernels before 4.15 don't know MAP_SHARED_VALIDATE, and filing systems which aren't DAX refuse MAP_SYNC
+      if(EOPNOTSUPP == errno || EINVAL == errno)
+      {
+        return errc::operation_not_supported;
+      }
+      return posix_error();
+    }
   }
 #endif
   if(addr == nullptr)
@@ -376,6 +830,12 @@ static inline result<void *> do_mmap(native_handle_type &nativeh, void *ataddr,
     }
   }
 #endif
+  if(prefault_later)
+  {
+    // Failure to prefault is not a failure to map
+    (void) map_handle::populate({static_cast<byte *>(addr), bytes}, (_flag & section_handle::flag::prefault_write) && (prot & PROT_WRITE) != 0,
+                                !!(_flag & section_handle::flag::prefault_async));
+  }
 #if 0  // not implemented yet, not seen any benefit over setting this at the fd level
   if(have_backing && ((flags & map_handle::flag::disable_prefetching) || (flags & map_handle::flag::maximum_prefetching)))
   {
@@ -387,9 +847,68 @@ static inline result<void *> do_mmap(native_handle_type &nativeh, void *ataddr,
   return addr;
 }
 
-result<map_handle> map_handle::map(size_type bytes, bool /*unused*/, section_handle::flag _flag) noexcept
+// Tries successively smaller page sizes for an allocation, updating the flags to the page size obtained
+static inline result<void *> do_mmap_with_page_size_fallback(native_handle_type &nativeh, map_handle::size_type &pagesize, map_handle::size_type &bytes,
+                                                             section_handle::flag &_flag) noexcept
+{
+  try
+  {
+    const auto &pagesizes = utils::page_sizes();
+    size_t idx = detail::pagesize_index_from_flags(_flag);
+    if(idx == 0 || idx >= pagesizes.size())
+    {
+      idx = pagesizes.size() - 1;
+    }
+    _flag &= ~(section_handle::flag::page_sizes_3 | section_handle::flag::transparent_huge_pages);
+    bool fellback = false;
+    for(; idx > 0; idx--)
+    {
+      // Don't round small allocations up to a huge page
+      if(bytes < pagesizes[idx])
+      {
+        continue;
+      }
+      map_handle::size_type hugebytes = utils::round_up_to_page_size(bytes, pagesizes[idx]);
+      auto addr = do_mmap(nativeh, nullptr, 0, nullptr, pagesizes[idx], hugebytes, 0, _flag | detail::pagesize_flags_from_index(idx));
+      if(addr)
+      {
+        _flag |= detail::pagesize_flags_from_index(idx);
+        pagesize = pagesizes[idx];
+        bytes = hugebytes;
+        if(fellback)
+        {
+          detail::map_handle_page_size_counters_instance().fallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+        return addr;
+      }
+      fellback = true;
+    }
+    pagesize = pagesizes[0];
+    OUTCOME_TRY(auto &&addr, do_mmap(nativeh, nullptr, 0, nullptr, pagesize, bytes, 0, _flag));
+#ifdef MADV_HUGEPAGE
+    if(pagesizes.size() > 1 && bytes >= pagesizes[1] && !(_flag & section_handle::flag::nocommit))
+    {
+      // Not fatal if transparent huge pages are disabled
+      if(-1 != ::madvise(addr, bytes, MADV_HUGEPAGE))
+      {
+        _flag |= section_handle::flag::transparent_huge_pages;
+      }
+    }
+#endif
+    if(fellback)
+    {
+      detail::map_handle_page_size_counters_instance().fallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+    return addr;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<map_handle> map_handle::map(size_type bytes, bool zeroed, section_handle::flag _flag) noexcept
 {
-  // TODO: Keep a cache of MADV_FREE pages deallocated
   if(bytes == 0u)
   {
     return errc::argument_out_of_domain;
@@ -397,18 +916,56 @@ result<map_handle> map_handle::map(size_type bytes, bool /*unused*/, section_han
   bytes = utils::round_up_to_page_size(bytes, /*FIXME*/ utils::page_size());
   result<map_handle> ret(map_handle(nullptr, _flag));
   native_handle_type &nativeh = ret.value()._v;
-  OUTCOME_TRY(auto &&pagesize, detail::pagesize_from_flags(ret.value()._flag));
-  OUTCOME_TRY(auto &&addr, do_mmap(nativeh, nullptr, 0, nullptr, pagesize, bytes, 0, ret.value()._flag));
+  // Recycled allocations may contain non-zero bits
+  const bool cacheable = (_flag == section_handle::flag::readwrite && bytes <= cache_max_item_bytes);
+  if(cacheable && !zeroed)
+  {
+    detail::map_handle_cache_t::item_t item;
+    if(detail::map_handle_cache().take(bytes, item))
+    {
+      ret.value()._addr = item.addr;
+      ret.value()._reservation = item.bytes;
+      ret.value()._length = bytes;
+      ret.value()._pagesize = utils::page_size();
+      ret.value()._recyclable = true;
+      nativeh._init = -2;  // otherwise appears closed
+      nativeh.behaviour |= native_handle_type::disposition::seekable | native_handle_type::disposition::readable | native_handle_type::disposition::writable |
+                           native_handle_type::disposition::allocation;
+      LLFIO_LOG_FUNCTION_CALL(&ret);
+      return ret;
+    }
+  }
+  size_type pagesize;
+  void *addr;
+  if(ret.value()._flag & section_handle::flag::page_sizes_fallback)
+  {
+    OUTCOME_TRY(addr, do_mmap_with_page_size_fallback(nativeh, pagesize, bytes, ret.value()._flag));
+  }
+  else
+  {
+    OUTCOME_TRY(pagesize, detail::pagesize_from_flags(ret.value()._flag));
+    OUTCOME_TRY(addr, do_mmap(nativeh, nullptr, 0, nullptr, pagesize, bytes, 0, ret.value()._flag));
+  }
   ret.value()._addr = static_cast<byte *>(addr);
   ret.value()._reservation = bytes;
   ret.value()._length = bytes;
   ret.value()._pagesize = pagesize;
+  ret.value()._recyclable = cacheable;
   nativeh._init = -2;  // otherwise appears closed
   nativeh.behaviour |= native_handle_type::disposition::allocation;
+  ret.value()._account_page_size((ptrdiff_t) bytes);
   LLFIO_LOG_FUNCTION_CALL(&ret);
   return ret;
 }
 
+result<map_handle> map_handle::map(size_type bytes, numa_policy policy, bool zeroed, section_handle::flag _flag) noexcept
+{
+  OUTCOME_TRY(auto &&ret, map(bytes, zeroed, _flag));
+  // Recycled allocations may already be resident elsewhere
+  OUTCOME_TRY(ret.set_numa_policy(policy, {}, true));
+  return {std::move(ret)};
+}
+
 result<map_handle> map_handle::map(section_handle &section, size_type bytes, extent_type offset, section_handle::flag _flag) noexcept
 {
   OUTCOME_TRY(auto &&length, section.length());  // length of the backing file
@@ -418,9 +975,36 @@ result<map_handle> map_handle::map(section_handle &section, size_type bytes, ext
   }
   result<map_handle> ret{map_handle(&section, _flag)};
   native_handle_type &nativeh = ret.value()._v;
-  OUTCOME_TRY(auto &&pagesize, detail::pagesize_from_flags(ret.value()._flag));
-  OUTCOME_TRY(auto &&addr, do_mmap(nativeh, nullptr, 0, &section, pagesize, bytes, offset, ret.value()._flag));
-  ret.value()._addr = static_cast<byte *>(addr);
+  const bool fallback = (ret.value()._flag & section_handle::flag::page_sizes_fallback) && detail::pagesize_index_from_flags(ret.value()._flag) != 0;
+  auto requested = detail::pagesize_from_flags(ret.value()._flag);
+  if(!requested && !fallback)
+  {
+    return std::move(requested).error();
+  }
+  size_type pagesize = requested ? requested.value() : utils::page_size();
+  result<void *> addr = requested ? do_mmap(nativeh, nullptr, 0, &section, pagesize, bytes, offset, ret.value()._flag) : result<void *>(errc::invalid_argument);
+  if(!addr && addr.error() == errc::operation_not_supported && (ret.value()._flag & section_handle::flag::nvram))
+  {
+    // MAP_SYNC was refused, so this map is in page cache and barriers need msync()
+    ret.value()._flag &= ~section_handle::flag::nvram;
+    addr = do_mmap(nativeh, nullptr, 0, &section, pagesize, bytes, offset, ret.value()._flag);
+  }
+  if(!addr && fallback)
+  {
+    // Explicit large pages of files need hugetlbfs, so map normal pages and ask for transparent huge pages instead
+    ret.value()._flag &= ~(section_handle::flag::page_sizes_3 | section_handle::flag::transparent_huge_pages);
+    pagesize = utils::page_size();
+    addr = do_mmap(nativeh, nullptr, 0, &section, pagesize, bytes, offset, ret.value()._flag);
+#ifdef MADV_HUGEPAGE
+    // Not fatal if transparent huge pages are disabled
+    if(addr && -1 != ::madvise(addr.value(), bytes, MADV_HUGEPAGE))
+    {
+      ret.value()._flag |= section_handle::flag::transparent_huge_pages;
+    }
+#endif
+  }
+  OUTCOME_TRY(addr);
+  ret.value()._addr = static_cast<byte *>(addr.value());
   ret.value()._offset = offset;
   ret.value()._reservation = utils::round_up_to_page_size(bytes, pagesize);
   ret.value()._length = (length - offset < bytes) ? (length - offset) : bytes;  // length of backing, not reservation
@@ -436,6 +1020,7 @@ result<map_handle> map_handle::map(section_handle &section, size_type bytes, ext
 result<map_handle::size_type> map_handle::truncate(size_type newsize, bool permit_relocation) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  auto reaccount = make_scope_exit([this, oldreservation = _reservation]() noexcept { _account_page_size((ptrdiff_t) _reservation - (ptrdiff_t) oldreservation); });
   extent_type length = _length;
   if(_section != nullptr)
   {
@@ -525,7 +1110,8 @@ result<map_handle::buffer_type> map_handle::commit(buffer_type region, section_h
   {
     return errc::invalid_argument;
   }
-  // Set permissions on the pages
+  // Set permissions on the pages, which can no longer be recycled as uniformly read-write
+  _recyclable = false;
   region = utils::round_to_page_size_larger(region, _pagesize);
   extent_type offset = _offset + (region.data() - _addr);
   size_type bytes = region.size();
@@ -545,6 +1131,7 @@ result<map_handle::buffer_type> map_handle::decommit(buffer_type region) noexcep
   {
     return errc::invalid_argument;
   }
+  _recyclable = false;
   region = utils::round_to_page_size_larger(region, _pagesize);
   // If decommitting a mapped file, tell the kernel to kick these pages back to storage
   if(_section != nullptr && -1 == ::madvise(region.data(), region.size(), MADV_DONTNEED))
@@ -558,6 +1145,224 @@ result<map_handle::buffer_type> map_handle::decommit(buffer_type region) noexcep
   return region;
 }
 
+result<span<map_handle::buffer_type>> map_handle::commit(span<buffer_type> regions, section_handle::flag flag) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+  if(merged.empty())
+  {
+    return merged;
+  }
+  _recyclable = false;
+  for(auto &region : merged)
+  {
+    extent_type offset = _offset + (region.data() - _addr);
+    size_type bytes = region.size();
+    OUTCOME_TRYV(do_mmap(_v, region.data(), MAP_FIXED, _section, _pagesize, bytes, offset, flag));
+  }
+  if(!detail::madvise_regions(merged, MADV_WILLNEED))
+  {
+    return posix_error();
+  }
+  return merged;
+}
+
+result<span<map_handle::buffer_type>> map_handle::decommit(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+  if(merged.empty())
+  {
+    return merged;
+  }
+  _recyclable = false;
+  if(_section != nullptr && !detail::madvise_regions(merged, MADV_DONTNEED))
+  {
+    return posix_error();
+  }
+  for(auto &region : merged)
+  {
+    extent_type offset = _offset + (region.data() - _addr);
+    size_type bytes = region.size();
+    OUTCOME_TRYV(do_mmap(_v, region.data(), MAP_FIXED, _section, _pagesize, bytes, offset, section_handle::flag::none | section_handle::flag::nocommit));
+  }
+  return merged;
+}
+
+result<void> map_handle::clear_dirty() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+  if(!detail::soft_dirty_supported())
+  {
+    return success();
+  }
+  int fd = ::open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+  if(-1 == fd)
+  {
+    return posix_error();
+  }
+  auto unfd = make_scope_exit([fd]() noexcept { ::close(fd); });
+  // 4 clears the soft-dirty bits of every page in the process
+  if(1 != ::write(fd, "4", 1))
+  {
+    return posix_error();
+  }
+#endif
+  return success();
+}
+
+result<span<map_handle::buffer_type>> map_handle::dirty_regions(span<buffer_type> out, buffer_type region) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    region = {_addr, _length};
+  }
+  region = utils::round_to_page_size_larger(region, _pagesize);
+  if(out.empty() || region.empty())
+  {
+    return span<buffer_type>(out.data(), 0);
+  }
+#ifdef __linux__
+  if(detail::soft_dirty_supported())
+  {
+    return detail::soft_dirty_regions(out, region);
+  }
+#endif
+  out[0] = region;
+  return span<buffer_type>(out.data(), 1);
+}
+
+result<map_handle::size_type> map_handle::barrier_dirty(span<buffer_type> scratch, barrier_kind kind, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(scratch.empty())
+  {
+    return errc::invalid_argument;
+  }
+  // Metadata is barriered once for the whole file afterwards, not per extent
+  const barrier_kind extentkind = (kind >= barrier_kind::nowait_all) ? static_cast<barrier_kind>((uint8_t) kind - 2) : kind;
+  size_type bytes = 0;
+  byte *const mapend = _addr + _length;
+  buffer_type region{_addr, _length};
+  while(!region.empty())
+  {
+    OUTCOME_TRY(auto &&dirty, dirty_regions(scratch, region));
+    for(auto &i : dirty)
+    {
+      const_buffer_type b{i.data(), (size_type)((std::min)(i.data() + i.size(), mapend) - i.data())};
+      OUTCOME_TRYV(barrier(io_request<const_buffers_type>(const_buffers_type(&b, 1), (extent_type)(i.data() - _addr)), extentkind, d));
+      bytes += b.size();
+    }
+    if(dirty.size() < scratch.size())
+    {
+      break;
+    }
+    byte *next = (std::min)(dirty.back().data() + dirty.back().size(), mapend);
+    region = {next, (size_type)(mapend - next)};
+  }
+  if(bytes > 0 && _section != nullptr && _section->backing() != nullptr && kind >= barrier_kind::nowait_all)
+  {
+    OUTCOME_TRYV(_section->backing()->barrier(kind, d));
+  }
+  OUTCOME_TRYV(clear_dirty());
+  return bytes;
+}
+
+result<void> map_handle::set_numa_policy(numa_policy policy, buffer_type region, bool move_existing) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    region = {_addr, _reservation};
+  }
+  region = utils::round_to_page_size_larger(region, _pagesize);
+  if(region.empty())
+  {
+    return success();
+  }
+#ifdef __linux__
+  int mode = 4 /*MPOL_LOCAL*/;
+  switch(policy.policy)
+  {
+  case numa_policy::kind::local:
+    break;
+  case numa_policy::kind::bind:
+    mode = 2 /*MPOL_BIND*/;
+    break;
+  case numa_policy::kind::interleave:
+    mode = 3 /*MPOL_INTERLEAVE*/;
+    break;
+  case numa_policy::kind::preferred:
+    mode = 1 /*MPOL_PREFERRED*/;
+    // The kernel takes the lowest node in the mask
+    break;
+  }
+  if(mode != 4 && policy.nodes == 0)
+  {
+    return errc::invalid_argument;
+  }
+  unsigned long nodemask[sizeof(policy.nodes) / sizeof(unsigned long)];
+  for(size_t n = 0; n < sizeof(nodemask) / sizeof(nodemask[0]); n++)
+  {
+    nodemask[n] = (unsigned long) (policy.nodes >> (n * __CHAR_BIT__ * sizeof(unsigned long)));
+  }
+  const unsigned flags = move_existing ? (1U << 1U) /*MPOL_MF_MOVE*/ : 0;
+  // The kernel reads one fewer bits than maxnode
+  if(-1 == ::syscall(SYS_mbind, region.data(), region.size(), mode, (mode == 4) ? nullptr : nodemask, (mode == 4) ? 0 : (__CHAR_BIT__ * sizeof(nodemask) + 1), flags))
+  {
+    return posix_error();
+  }
+  // Recycling would carry the policy over to unrelated allocations
+  _recyclable = false;
+  return success();
+#else
+  (void) move_existing;
+  if(policy.policy != numa_policy::kind::local)
+  {
+    return errc::operation_not_supported;
+  }
+  return success();
+#endif
+}
+
+result<span<int>> map_handle::numa_nodes(span<int> nodes, buffer_type region) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    region = {_addr, _reservation};
+  }
+  region = utils::round_to_page_size_larger(region, _pagesize);
+  size_t pages = region.size() / _pagesize;
+  if(pages < nodes.size())
+  {
+    nodes = nodes.subspan(0, pages);
+  }
+#ifdef __linux__
+  // move_pages() without target nodes reports where each page is
+  void *addrs[64];
+  for(size_t n = 0; n < nodes.size();)
+  {
+    const size_t count = std::min(nodes.size() - n, sizeof(addrs) / sizeof(addrs[0]));
+    for(size_t i = 0; i < count; i++)
+    {
+      addrs[i] = region.data() + (n + i) * _pagesize;
+    }
+    if(-1 == ::syscall(SYS_move_pages, 0, count, addrs, nullptr, nodes.data() + n, 0))
+    {
+      return posix_error();
+    }
+    n += count;
+  }
+  return nodes;
+#else
+  (void) nodes;
+  return errc::operation_not_supported;
+#endif
+}
+
 result<void> map_handle::zero_memory(buffer_type region) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -593,6 +1398,106 @@ result<void> map_handle::zero_memory(buffer_type region) noexcept
   return success();
 }
 
+result<void> map_handle::zero_memory(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, 1));
+#if defined(MADV_REMOVE) && !defined(MADV_FREE_REUSABLE)
+  // Zero the partial pages at either end, leaving the whole pages in each region to punch out
+  for(auto &region : merged)
+  {
+    byte *begin = utils::round_up_to_page_size(region.data(), _pagesize);
+    byte *end = utils::round_down_to_page_size(region.data() + region.size(), _pagesize);
+    if(begin >= end)
+    {
+      memset(region.data(), 0, region.size());
+      region = {region.data(), 0};
+      continue;
+    }
+    memset(region.data(), 0, begin - region.data());
+    memset(end, 0, (region.data() + region.size()) - end);
+    region = {begin, (size_t)(end - begin)};
+  }
+  if(!detail::madvise_regions(merged, MADV_REMOVE))
+  {
+    for(auto &region : merged)
+    {
+      memset(region.data(), 0, region.size());
+    }
+  }
+  return success();
+#else
+  for(auto &region : merged)
+  {
+    OUTCOME_TRYV(zero_memory(region));
+  }
+  return success();
+#endif
+}
+
+result<map_handle::buffer_type> map_handle::populate(buffer_type region, bool for_write, bool asynchronous) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  region = utils::round_to_page_size_larger(region, utils::page_size());
+  if(region.data() == nullptr)
+  {
+    return errc::invalid_argument;
+  }
+#ifdef __linux__
+  // 0 = unknown, 1 = MADV_POPULATE_READ/WRITE are supported, 2 = they are not
+  static std::atomic<int> populate_supported{0};
+  const int advice = for_write ? 23 /*MADV_POPULATE_WRITE*/ : 22 /*MADV_POPULATE_READ*/;
+  if(populate_supported.load(std::memory_order_relaxed) == 0)
+  {
+    const int ret = ::madvise(region.data(), (size_t) utils::page_size(), 22 /*MADV_POPULATE_READ*/);
+    populate_supported.store((ret == -1 && errno == EINVAL) ? 2 : 1, std::memory_order_relaxed);
+  }
+  if(populate_supported.load(std::memory_order_relaxed) == 1)
+  {
+    if(asynchronous)
+    {
+      try
+      {
+        // If the region is unmapped before this runs, madvise() merely fails
+        std::thread([region, advice] { (void) ::madvise(region.data(), region.size(), advice); }).detach();
+        return region;
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+    if(-1 == ::madvise(region.data(), region.size(), advice))
+    {
+      return posix_error();
+    }
+    return region;
+  }
+#endif
+  if(asynchronous)
+  {
+    // Touching pages from another thread would crash if the region were unmapped meanwhile
+    if(-1 == ::madvise(region.data(), region.size(), MADV_WILLNEED))
+    {
+      return posix_error();
+    }
+    return region;
+  }
+  for(size_t n = 0; n < region.size(); n += utils::page_size())
+  {
+    if(for_write)
+    {
+      // Take the write fault without changing the contents, even if other threads are writing
+      reinterpret_cast<std::atomic<char> *>(region.data() + n)->fetch_add(0, std::memory_order_relaxed);  // NOLINT
+    }
+    else
+    {
+      (void) *reinterpret_cast<volatile char *>(region.data() + n);  // NOLINT
+    }
+  }
+  return region;
+}
+
 result<span<map_handle::buffer_type>> map_handle::prefetch(span<buffer_type> regions) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(0);
@@ -606,6 +1511,54 @@ result<span<map_handle::buffer_type>> map_handle::prefetch(span<buffer_type> reg
   return regions;
 }
 
+result<void> map_handle::prefetch(span<buffer_type> regions, span<io_multiplexer::posix_fs_syscall> ops, io_multiplexer *multiplexer) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+  if(ops.size() < regions.size())
+  {
+    return errc::invalid_argument;
+  }
+  ops = ops.subspan(0, regions.size());
+  for(size_t n = 0; n < regions.size(); n++)
+  {
+    auto region = utils::round_to_page_size_larger(regions[n], utils::page_size());
+    ops[n] = posix_fs_syscall();
+    ops[n].op = posix_fs_syscall::kind::madvise;
+    ops[n].buffer = region.data();
+    ops[n].bytes = region.size();
+    ops[n].flags = MADV_WILLNEED;
+  }
+#ifdef __linux__
+  // Which advice to use is determined by the first prefetch, 0 = unknown, 1 = MADV_POPULATE_READ, 2 = MADV_WILLNEED
+  static std::atomic<int> populate_read{0};
+  if(!ops.empty() && populate_read.load(std::memory_order_relaxed) != 2)
+  {
+    if(populate_read.load(std::memory_order_relaxed) == 0)
+    {
+      const int ret = ::madvise(ops[0].buffer, std::min(ops[0].bytes, (size_t) utils::page_size()), 22 /*MADV_POPULATE_READ*/);
+      populate_read.store((ret == -1 && errno == EINVAL) ? 2 : 1, std::memory_order_relaxed);
+    }
+    if(populate_read.load(std::memory_order_relaxed) == 1)
+    {
+      for(auto &op : ops)
+      {
+        op.flags = 22 /*MADV_POPULATE_READ*/;
+      }
+    }
+  }
+#endif
+  if(multiplexer == nullptr)
+  {
+    for(auto &op : ops)
+    {
+      op.result = (-1 == ::madvise(op.buffer, op.bytes, op.flags)) ? -errno : 0;
+    }
+    return success();
+  }
+  return multiplexer->initiate_posix_fs_syscalls(ops);
+}
+
 result<map_handle::buffer_type> map_handle::do_not_store(buffer_type region) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(0);
@@ -632,9 +1585,64 @@ result<map_handle::buffer_type> map_handle::do_not_store(buffer_type region) noe
   return region;
 }
 
-map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<buffers_type> reqs, deadline /*d*/) noexcept
+result<span<map_handle::buffer_type>> map_handle::do_not_store(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+#ifdef MADV_FREE
+  if(detail::madvise_regions(merged, MADV_FREE))
+  {
+    return merged;
+  }
+#endif
+  // Let the single region form find whatever this platform supports
+  for(auto &region : merged)
+  {
+    OUTCOME_TRY(auto &&done, do_not_store(region));
+    region = done;
+  }
+  return merged;
+}
+
+result<map_handle::buffer_type> map_handle::evict(buffer_type region) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    return errc::invalid_argument;
+  }
+  // Only whole pages, as the pages either side may be in use
+  auto *end = reinterpret_cast<byte *>((reinterpret_cast<uintptr_t>(region.data()) + region.size()) & ~(uintptr_t)(_pagesize - 1));
+  region = {utils::round_up_to_page_size(region.data(), _pagesize), 0};
+  if(region.data() >= end)
+  {
+    return region;
+  }
+  region = {region.data(), (size_type)(end - region.data())};
+  // Shared maps of files lose nothing when unmapped, as the kernel repopulates them from the page cache
+  if(_section != nullptr && !(_flag & section_handle::flag::cow))
+  {
+    if(-1 == ::madvise(region.data(), region.size(), MADV_DONTNEED))
+    {
+      return posix_error();
+    }
+    return region;
+  }
+#ifdef __linux__
+  // Anonymous and copy on write pages can only be deactivated, so they are reclaimed first. Needs Linux 5.4 or later.
+  if(-1 != ::madvise(region.data(), region.size(), 20 /*MADV_COLD*/))
+  {
+    return region;
+  }
+#endif
+  // No support on this platform
+  region = {region.data(), 0};
+  return region;
+}
+
+map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<buffers_type> reqs, deadline /*d*/) noexcept
+{
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   byte *addr = _addr + reqs.offset;
   size_type togo = reqs.offset < _length ? static_cast<size_type>(_length - reqs.offset) : 0;
   for(size_t i = 0; i < reqs.buffers.size(); i++)
@@ -655,7 +1663,7 @@ map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<
 
 map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_request<const_buffers_type> reqs, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   if(!!(_flag & section_handle::flag::write_via_syscall) && _section != nullptr && _section->backing() != nullptr)
   {
     auto r = _section->backing()->write(reqs, d);
@@ -680,7 +1688,7 @@ map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_r
          if(req.size() > togo)
          {
            assert(req.data() != nullptr);
-           memcpy(addr, req.data(), togo);
+           detail::copy_into_map(addr, req.data(), togo, _nontemporal_write_threshold);
            req = {addr, togo};
            reqs.buffers = {reqs.buffers.data(), i + 1};
            return false;
@@ -688,7 +1696,7 @@ map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_r
          else
          {
            assert(req.data() != nullptr);
-           memcpy(addr, req.data(), req.size());
+           detail::copy_into_map(addr, req.data(), req.size(), _nontemporal_write_threshold);
            req = {addr, req.size()};
            addr += req.size();
            togo -= req.size();
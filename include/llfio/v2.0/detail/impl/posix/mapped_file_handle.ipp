@@ -52,19 +52,84 @@ result<mapped_file_handle::size_type> mapped_file_handle::reserve(size_type rese
     _reservation = reservation;
     return _reservation;
   }
-  // Reserve the full reservation in address space
-  section_handle::flag mapflags = section_handle::flag::nocommit | section_handle::flag::read;
-  if(this->is_writable())
+  // Resizing the existing map keeps its pages mapped, so nothing already faulted in is faulted in again.
+  // On Linux this is mremap(), elsewhere the reservation is only extended if it can be in place.
+  bool resized = false;
+  if(_mh.is_valid())
+  {
+    // Remapping would relocate the map from beneath any pinned views
+    if(_pins.load(std::memory_order_acquire) > 0)
+    {
+      return errc::device_or_resource_busy;
+    }
+    resized = _mh.truncate(reservation, true).has_value();
+  }
+  if(!resized)
   {
-    mapflags |= section_handle::flag::write;
+    // Reserve the full reservation in address space
+    section_handle::flag mapflags = section_handle::flag::nocommit | section_handle::flag::read;
+    if(this->is_writable())
+    {
+      mapflags |= section_handle::flag::write;
+    }
+    const auto nontemporal_write_threshold = _mh.nontemporal_write_threshold();
+    OUTCOME_TRYV(_mh.close());
+    OUTCOME_TRY(auto &&mh, map_handle::map(_sh, reservation, 0, mapflags));
+    mh.set_nontemporal_write_threshold(nontemporal_write_threshold);
+    _mh = std::move(mh);
   }
-  OUTCOME_TRYV(_mh.close());
-  OUTCOME_TRY(auto &&mh, map_handle::map(_sh, reservation, 0, mapflags));
-  _mh = std::move(mh);
   _reservation = reservation;
+  // Prefault only the extent of the file, not the reservation beyond it
+  const auto sflags = _sh.section_flags();
+  if(length > 0 && ((sflags & section_handle::flag::prefault) || (sflags & section_handle::flag::prefault_write) || (sflags & section_handle::flag::prefault_async)))
+  {
+    (void) map_handle::populate({_mh.address(), (size_type) length}, (sflags & section_handle::flag::prefault_write) && this->is_writable(),
+                                !!(sflags & section_handle::flag::prefault_async));
+  }
   return _reservation;
 }
 
+result<void> mapped_file_handle::begin_concurrent_append(extent_type step) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(step == 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(auto &&length, underlying_file_maximum_extent());
+  if(_reservation < length + step)
+  {
+    OUTCOME_TRYV(reserve(utils::round_up_to_page_size(length + step, page_size())));
+  }
+  try
+  {
+    _append = std::make_unique<_append_state_t>();
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+  _append->tail.store(length, std::memory_order_relaxed);
+  _append->length.store(length, std::memory_order_relaxed);
+  _append->step = step;
+  auto unappend = make_scope_exit([this]() noexcept { _append.reset(); });
+  OUTCOME_TRYV(_grow_for_append(length));
+  unappend.release();
+  return success();
+}
+
+result<mapped_file_handle::extent_type> mapped_file_handle::end_concurrent_append() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!_append)
+  {
+    return errc::invalid_argument;
+  }
+  const extent_type tail = _append->tail.load(std::memory_order_acquire);
+  _append.reset();
+  return mapped_file_handle::truncate(tail);
+}
+
 result<void> mapped_file_handle::close() noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -95,6 +160,11 @@ native_handle_type mapped_file_handle::release() noexcept
 result<mapped_file_handle::extent_type> mapped_file_handle::truncate(extent_type newsize) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  // Views pin the map against shrinking, and against the relocation of exceeding the reservation
+  if(_pins.load(std::memory_order_acquire) > 0 && _mh.is_valid() && (newsize < _mh.length() || newsize > _reservation))
+  {
+    return errc::device_or_resource_busy;
+  }
   // Release all maps and sections and truncate the backing file to zero
   if(newsize == 0)
   {
@@ -0,0 +1,91 @@
+/* A ring buffer of memory section mapped twice back to back
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../mapped_ring_buffer.hpp"
+#include "import.hpp"
+
+#include <sys/mman.h>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+result<mapped_ring_buffer> mapped_ring_buffer::ring_buffer(size_type bytes, const path_handle &dirh) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  if(bytes == 0)
+  {
+    return errc::invalid_argument;
+  }
+  bytes = utils::round_up_to_page_size(bytes, utils::page_size());
+  OUTCOME_TRY(auto &&sh, section_handle::section(bytes, dirh.is_valid() ? dirh : path_discovery::storage_backed_temporary_files_directory(), section_handle::flag::readwrite));
+  result<mapped_ring_buffer> ret(mapped_ring_buffer{});
+  ret.value()._sh = std::move(sh);
+  ret.value()._capacity = bytes;
+  OUTCOME_TRYV(ret.value()._map_twice());
+  return ret;
+}
+
+result<void> mapped_ring_buffer::_map_twice() noexcept
+{
+  // Reserve address space for both maps, then replace each half with a map of the section
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+  void *addr = ::mmap(nullptr, _capacity * 2, PROT_NONE, flags, -1, 0);
+  if(MAP_FAILED == addr)
+  {
+    return posix_error();
+  }
+  auto unmap = make_scope_exit([&]() noexcept { ::munmap(addr, _capacity * 2); });
+  for(size_t n = 0; n < 2; n++)
+  {
+    if(MAP_FAILED == ::mmap(static_cast<byte *>(addr) + n * _capacity, _capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, _sh.native_handle().fd, 0))
+    {
+      return posix_error();
+    }
+  }
+  unmap.release();
+  _addr = static_cast<byte *>(addr);
+  return success();
+}
+
+result<void> mapped_ring_buffer::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_addr != nullptr)
+  {
+    if(-1 == ::munmap(_addr, _capacity * 2))
+    {
+      return posix_error();
+    }
+    _addr = nullptr;
+  }
+  if(_sh.is_valid())
+  {
+    OUTCOME_TRYV(_sh.close());
+  }
+  return success();
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -28,7 +28,17 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../../../mapped_file_handle.hpp"
 
+#include <ctime>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
 #include <pwd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
 
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
 
@@ -143,6 +153,276 @@ namespace path_discovery
     return ret;
   }
 
+  /* The verification of the temporary directories is cached across processes in the runtime
+  directory of the effective user, as probing them costs tens of milliseconds. The cache is only
+  used if the candidate directories are exactly those of the cache, and the device and inode of
+  every directory verified are still the same, so a remounted filesystem invalidates it. If it is
+  older than ten minutes, it is refreshed by a background thread.
+  */
+  static constexpr const char _verified_cache_magic[] = "LLFIOPD1";
+  static constexpr time_t _verified_cache_max_age = 600;  // seconds
+
+  inline std::string _verified_cache_path()
+  {
+    // Not XDG_RUNTIME_DIR, as the environment cannot be trusted under SUID or SGID
+    std::string ret("/run/user/" + std::to_string(geteuid()));
+    struct ::stat st;
+    if(-1 == ::stat(ret.c_str(), &st) || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0)
+    {
+      return {};
+    }
+    ret.append("/llfio_path_discovery.cache");
+    return ret;
+  }
+
+  inline bool _load_verified_cache(std::vector<discovered_path> &all, std::vector<_store::_discovered_path> &_all, bool &stale) noexcept
+  {
+    auto reset = [&] {
+      for(size_t n = 0; n < all.size(); n++)
+      {
+        all[n].stat = {};
+        _all[n].h = {};
+        _all[n].fstypename.clear();
+      }
+      return false;
+    };
+    try
+    {
+      const auto path = _verified_cache_path();
+      if(path.empty())
+      {
+        return false;
+      }
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if(-1 == fd)
+      {
+        return false;
+      }
+      std::string contents;
+      struct ::stat st;
+      if(-1 != ::fstat(fd, &st) && st.st_uid == geteuid() && st.st_size < 65536)
+      {
+        contents.resize(static_cast<size_t>(st.st_size));
+        size_t offset = 0;
+        for(ssize_t bytes; offset < contents.size() && (bytes = ::read(fd, &contents[offset], contents.size() - offset)) > 0;)
+        {
+          offset += static_cast<size_t>(bytes);
+        }
+        contents.resize(offset);
+      }
+      ::close(fd);
+      stale = (::time(nullptr) - st.st_mtime) > _verified_cache_max_age;
+      std::istringstream is(contents);
+      std::string line;
+      size_t count = 0;
+      if(!std::getline(is, line) || line != _verified_cache_magic || !(is >> count) || count != all.size())
+      {
+        return false;
+      }
+      for(size_t n = 0; n < all.size(); n++)
+      {
+        int verified = 0;
+        uint64_t dev = 0, ino = 0;
+        std::string fstypename;
+        if(!(is >> verified >> dev >> ino >> fstypename) || is.get() != ' ' || !std::getline(is, line) || line != _all[n].path.native())
+        {
+          return reset();
+        }
+        if(verified == 0)
+        {
+          continue;
+        }
+        log_level_guard logg(log_level::fatal);  // suppress log printing of failure
+        (void) logg;
+        auto _h = directory_handle::directory({}, all[n].path);
+        if(!_h)
+        {
+          return reset();
+        }
+        all[n].stat = stat_t(nullptr);
+        if(!all[n].stat->fill(_h.value()) || all[n].stat->st_dev != dev || all[n].stat->st_ino != ino)
+        {
+          return reset();
+        }
+        _all[n].h = std::move(_h).value();
+        _all[n].fstypename = std::move(fstypename);
+      }
+      return true;
+    }
+    catch(...)
+    {
+      return reset();
+    }
+  }
+
+  inline void _save_verified_cache(const std::vector<discovered_path> &all, const std::vector<_store::_discovered_path> &_all) noexcept
+  {
+    try
+    {
+      const auto path = _verified_cache_path();
+      if(path.empty())
+      {
+        return;
+      }
+      std::string out(_verified_cache_magic);
+      out.append("\n" + std::to_string(all.size()) + "\n");
+      for(size_t n = 0; n < all.size(); n++)
+      {
+        const auto &p = _all[n].path.native();
+        if(p.find('\n') != p.npos || _all[n].fstypename.find_first_of(" \n") != std::string::npos)
+        {
+          return;
+        }
+        if(all[n].stat)
+        {
+          out.append("1 " + std::to_string(all[n].stat->st_dev) + " " + std::to_string(all[n].stat->st_ino) + " " + _all[n].fstypename + " ");
+        }
+        else
+        {
+          out.append("0 0 0 - ");
+        }
+        out.append(p);
+        out.push_back('\n');
+      }
+      // Write a new file and rename it over the old, so readers never see a partial cache
+      const auto temppath = path + "." + std::to_string(::getpid());
+      int fd = ::open(temppath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+      if(-1 == fd)
+      {
+        return;
+      }
+      bool ok = (::write(fd, out.data(), out.size()) == static_cast<ssize_t>(out.size()));
+      ::close(fd);
+      if(!ok || -1 == ::rename(temppath.c_str(), path.c_str()))
+      {
+        ::unlink(temppath.c_str());
+      }
+    }
+    catch(...)
+    {
+    }
+  }
+
+  inline void _refresh_verified_cache_in_background(const std::vector<discovered_path> &all) noexcept
+  {
+    try
+    {
+      // The probing is done on copies, so this process' verification is left alone
+      std::vector<filesystem::path> paths;
+      paths.reserve(all.size());
+      for(auto &i : all)
+      {
+        paths.push_back(i.path.path());
+      }
+      std::thread([paths = std::move(paths)]() mutable {
+        try
+        {
+          std::vector<_store::_discovered_path> _all;
+          std::vector<discovered_path> all;
+          _all.reserve(paths.size());
+          all.reserve(paths.size());
+          for(auto &i : paths)
+          {
+            _all.emplace_back(std::move(i));
+            discovered_path dp;
+            dp.path = _all.back().path;
+            all.push_back(std::move(dp));
+          }
+          _probe_temporary_directories(all, _all);
+          _save_verified_cache(all, _all);
+        }
+        catch(...)
+        {
+        }
+      }).detach();
+    }
+    catch(...)
+    {
+    }
+  }
+
+  inline int _memory_backed_rank(const stat_t &st) noexcept
+  {
+    // Lower is better. Memory bound to, or preferring, the NUMA node of this thread is best,
+    // memory bound to other nodes is worst.
+#ifdef __linux__
+    try
+    {
+      unsigned cpu = 0, node = 0;
+      if(-1 == ::syscall(SYS_getcpu, &cpu, &node, nullptr))
+      {
+        return 1;
+      }
+      int fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+      if(-1 == fd)
+      {
+        return 1;
+      }
+      std::string mountinfo;
+      char buffer[4096];
+      for(ssize_t bytes; (bytes = ::read(fd, buffer, sizeof(buffer))) > 0;)
+      {
+        mountinfo.append(buffer, static_cast<size_t>(bytes));
+      }
+      ::close(fd);
+      /* Lines are of the form:
+
+      36 35 0:33 / /run/user/1000 rw,nosuid,nodev relatime shared:5 - tmpfs tmpfs rw,size=1638400k,mode=700,mpol=bind:0
+
+      */
+      const std::string devid = " " + std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev)) + " ";
+      std::istringstream is(mountinfo);
+      for(std::string line; std::getline(is, line);)
+      {
+        const auto idx = line.find(devid);
+        if(idx == line.npos || idx > line.find(' ', line.find(' ') + 1))
+        {
+          continue;
+        }
+        const auto mpol = line.find("mpol=", line.find(" - "));
+        if(mpol == line.npos)
+        {
+          return 1;
+        }
+        const auto policy = line.substr(mpol + 5, line.find_first_of(", ", mpol) - mpol - 5);
+        const auto colon = policy.find(':');
+        const auto mode = policy.substr(0, colon);
+        if(colon == policy.npos || (mode != "bind" && mode != "prefer"))
+        {
+          return 1;
+        }
+        // The node list is of the form 0-1:3
+        for(size_t i = colon + 1; i < policy.size();)
+        {
+          char *end = nullptr;
+          const unsigned long first = strtoul(policy.c_str() + i, &end, 10);
+          unsigned long last = first;
+          if(*end == '-')
+          {
+            last = strtoul(end + 1, &end, 10);
+          }
+          if(node >= first && node <= last)
+          {
+            return 0;
+          }
+          i = static_cast<size_t>(end - policy.c_str()) + 1;
+          if(end == policy.c_str() + colon + 1)
+          {
+            break;
+          }
+        }
+        return 2;
+      }
+    }
+    catch(...)
+    {
+    }
+#else
+    (void) st;
+#endif
+    return 1;
+  }
+
   const path_handle &temporary_named_pipes_directory() noexcept { return storage_backed_temporary_files_directory(); }
 }  // namespace path_discovery
 
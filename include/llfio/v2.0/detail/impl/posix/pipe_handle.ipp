@@ -25,9 +25,13 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../../../pipe_handle.hpp"
 #include "import.hpp"
 
+#include <climits>  // for IOV_MAX
+
+#include <poll.h>
+
 LLFIO_V2_NAMESPACE_BEGIN
 
-result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_handle::mode _mode, pipe_handle::creation _creation, pipe_handle::caching _caching, pipe_handle::flag flags, const path_handle &base) noexcept
+result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_handle::mode _mode, pipe_handle::creation _creation, pipe_handle::caching _caching, pipe_handle::flag flags, const path_handle &base, size_t capacity) noexcept
 {
   result<pipe_handle> ret(pipe_handle(native_handle_type(), 0, 0, _caching, flags, nullptr));
   native_handle_type &nativeh = ret.value()._v;
@@ -124,10 +128,18 @@ result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_han
   {
     return posix_error();
   }
+#ifdef __linux__
+  if(capacity != 0)
+  {
+    OUTCOME_TRY(ret.value().set_capacity(capacity));
+  }
+#else
+  (void) capacity;
+#endif
   return ret;
 }
 
-result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching _caching, flag flags) noexcept
+result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching _caching, flag flags, size_t capacity) noexcept
 {
   result<std::pair<pipe_handle, pipe_handle>> ret(pipe_handle(native_handle_type(), 0, 0, _caching, flags, nullptr), pipe_handle(native_handle_type(), 0, 0, _caching, flags, nullptr));
   native_handle_type &readnativeh = ret.value().first._v, &writenativeh = ret.value().second._v;
@@ -174,7 +186,179 @@ result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching
 #endif
   readnativeh.fd = pipefds[0];
   writenativeh.fd = pipefds[1];
+#ifdef __linux__
+  if(capacity != 0)
+  {
+    OUTCOME_TRY(ret.value().first.set_capacity(capacity));
+  }
+#else
+  (void) capacity;
+#endif
   return ret;
 }
 
+result<size_t> pipe_handle::capacity() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+  const int ret = ::fcntl(_v.fd, F_GETPIPE_SZ);
+  if(-1 == ret)
+  {
+    return posix_error();
+  }
+  return (size_t) ret;
+#else
+  return errc::operation_not_supported;
+#endif
+}
+
+result<size_t> pipe_handle::set_capacity(size_t bytes) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+#ifdef __linux__
+  if(bytes > (size_t) INT_MAX)
+  {
+    return errc::invalid_argument;
+  }
+  const int ret = ::fcntl(_v.fd, F_SETPIPE_SZ, (int) bytes);
+  if(-1 == ret)
+  {
+    return posix_error();
+  }
+  return (size_t) ret;
+#else
+  (void) bytes;
+  return errc::operation_not_supported;
+#endif
+}
+
+#ifdef __linux__
+namespace detail
+{
+  // Calls `f` until it does not fail with EAGAIN, polling the nonblocking handles `a` and `b` whilst it does
+  template <class F> inline result<size_t> splice_with_deadline(const native_handle_type &a, short aevents, const native_handle_type &b, short bevents, deadline d, F &&f) noexcept
+  {
+    LLFIO_POSIX_DEADLINE_TO_SLEEP_INIT(d);
+    for(;;)
+    {
+      const ssize_t ret = f();
+      if(ret >= 0)
+      {
+        return (size_t) ret;
+      }
+      if(EWOULDBLOCK != errno && EAGAIN != errno)
+      {
+        return posix_error();
+      }
+      if(!d || !d.steady || d.nsecs != 0)
+      {
+        LLFIO_POSIX_DEADLINE_TO_SLEEP_LOOP(d);
+        int mstimeout = (timeout == nullptr) ? -1 : (timeout->tv_sec * 1000 + timeout->tv_nsec / 1000000LL);
+        pollfd p[2];
+        memset(p, 0, sizeof(p));
+        nfds_t count = 0;
+        for(auto *h : {&a, &b})
+        {
+          if(h->is_nonblocking())
+          {
+            p[count].fd = h->fd;
+            p[count].events = ((h == &a) ? aevents : bevents) | POLLERR;
+            count++;
+          }
+        }
+        if(-1 == ::poll(p, count, mstimeout))
+        {
+          return posix_error();
+        }
+      }
+      LLFIO_POSIX_DEADLINE_TO_TIMEOUT_LOOP(d);
+    }
+  }
+}  // namespace detail
+#endif
+
+result<size_t> pipe_handle::splice_to(io_handle &dest, extent_type offset, size_t bytes, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+#ifdef __linux__
+  loff_t off_out = (loff_t) offset;
+  const unsigned flags = SPLICE_F_MOVE | (_v.is_nonblocking() ? SPLICE_F_NONBLOCK : 0);
+  auto ret = detail::splice_with_deadline(_v, POLLIN, dest.native_handle(), POLLOUT, d, [&] {
+    return ::splice(_v.fd, nullptr, dest.native_handle().fd, dest.is_seekable() ? &off_out : nullptr, bytes, flags);
+  });
+  if(ret || ret.error() != errc::invalid_argument)
+  {
+    return ret;
+  }
+  // Some filing systems cannot be spliced into
+#endif
+  return _splice_by_copy(*this, 0, dest, offset, bytes, d);
+}
+
+result<size_t> pipe_handle::splice_from(io_handle &src, extent_type offset, size_t bytes, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+#ifdef __linux__
+  loff_t off_in = (loff_t) offset;
+  const unsigned flags = SPLICE_F_MOVE | (_v.is_nonblocking() ? SPLICE_F_NONBLOCK : 0);
+  auto ret = detail::splice_with_deadline(_v, POLLOUT, src.native_handle(), POLLIN, d, [&] {
+    return ::splice(src.native_handle().fd, src.is_seekable() ? &off_in : nullptr, _v.fd, nullptr, bytes, flags);
+  });
+  if(ret || ret.error() != errc::invalid_argument)
+  {
+    return ret;
+  }
+  // Some filing systems cannot be spliced from
+#endif
+  return _splice_by_copy(src, offset, *this, 0, bytes, d);
+}
+
+result<size_t> pipe_handle::splice_from(const_buffers_type buffers, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+#ifdef __linux__
+  const auto *iov = reinterpret_cast<const struct iovec *>(buffers.data());
+  const size_t iovcnt = std::min(buffers.size(), (size_t) IOV_MAX);
+  const unsigned flags = _v.is_nonblocking() ? SPLICE_F_NONBLOCK : 0;
+  return detail::splice_with_deadline(_v, POLLOUT, native_handle_type(), 0, d, [&] { return ::vmsplice(_v.fd, iov, iovcnt, flags); });
+#else
+  OUTCOME_TRY(auto &&written, write(io_request<const_buffers_type>(buffers, 0), d));
+  size_t ret = 0;
+  for(auto &b : written)
+  {
+    ret += b.size();
+  }
+  return ret;
+#endif
+}
+
+result<size_t> pipe_handle::tee_to(pipe_handle &dest, size_t bytes, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+#ifdef __linux__
+  const unsigned flags = _v.is_nonblocking() ? SPLICE_F_NONBLOCK : 0;
+  return detail::splice_with_deadline(_v, POLLIN, dest._v, POLLOUT, d, [&] { return ::tee(_v.fd, dest._v.fd, bytes, flags); });
+#else
+  (void) dest;
+  (void) bytes;
+  return errc::operation_not_supported;
+#endif
+}
+
 LLFIO_V2_NAMESPACE_END
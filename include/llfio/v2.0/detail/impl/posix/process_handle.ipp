@@ -29,6 +29,9 @@ Distributed under the Boost Software License, Version 1.0.
 #include <signal.h>  // for siginfo_t
 #include <spawn.h>
 #include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #ifdef __FreeBSD__
 #include <sys/sysctl.h>
@@ -105,6 +108,13 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> process_handle::close() noexcept
     log_level_guard g(log_level::fatal);
     OUTCOME_TRY(wait());
   }
+#ifdef __linux__
+  if(_pidfd != -1)
+  {
+    (void) ::close(_pidfd);
+    _pidfd = -1;
+  }
+#endif
   _v = {};
   return success();
 }
@@ -184,6 +194,32 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<intptr_t> process_handle::wait(deadline d
   }
 }
 
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> process_handle::initiate_wait(io_multiplexer::posix_fs_syscall &op, io_multiplexer *multiplexer) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!_v || multiplexer == nullptr)
+  {
+    return errc::invalid_argument;
+  }
+  op = {};
+  op.op = io_multiplexer::posix_fs_syscall::kind::wait_process;
+  op.offset = (uint64_t) _v.pid;
+#ifdef __linux__
+  if(_pidfd == -1)
+  {
+    // pidfd_open() is Linux 5.3 onwards, before which we fall back to the waiter thread
+    _pidfd = (int) ::syscall(434 /*__NR_pidfd_open*/, _v.pid, 0);
+    if(_pidfd == -1 && ENOSYS != errno)
+    {
+      return posix_error();
+    }
+  }
+  op.fd = _pidfd;
+#endif
+  op.result = io_multiplexer::posix_fs_syscall::pending;
+  return multiplexer->initiate_posix_fs_syscalls({&op, 1});
+}
+
 LLFIO_HEADERS_ONLY_MEMFUNC_SPEC const process_handle &process_handle::current() noexcept
 {
   static process_handle self = []() -> process_handle {
@@ -264,83 +300,67 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<process_handle> process_handle::launch_pr
       envptrs.push_back(_envs.back().buffer);
     }
     envptrs.push_back(nullptr);
-#if 0
-    ret._processh.fd = ::fork();
-    if(0 == ret._processh.fd)
+    /* Unlike fork(), posix_spawn() does not copy the page tables of the parent, which for parents
+    with large address spaces takes tens of milliseconds. glibc 2.24 onwards and musl always spawn
+    using clone(CLONE_VM | CLONE_VFORK), and the BSDs and Mac OS use vfork() or a native spawn
+    syscall. Older glibc only uses vfork() if asked with POSIX_SPAWN_USEVFORK.
+    */
+    struct spawn_state_t
     {
-      // I am the child
-      if(-1 == ::dup2(childinpipe.native_handle().fd, STDIN_FILENO))
-      {
-        ::perror("dup2 readh");
-        ::exit(1);
-      }
-      ::close(childreadh.fd);
-      if(-1 == ::dup2(childwriteh.fd, STDOUT_FILENO))
+      posix_spawn_file_actions_t actions;
+      posix_spawnattr_t attr;
+      bool have_actions{false}, have_attr{false};
+      spawn_state_t() = default;
+      spawn_state_t(const spawn_state_t &) = delete;
+      spawn_state_t &operator=(const spawn_state_t &) = delete;
+      ~spawn_state_t()
       {
-        ::perror("dup2 writeh");
-        ::exit(1);
-      }
-      ::close(childwriteh.fd);
-      if(!use_parent_errh)
-      {
-        if(-1 == ::dup2(childerrh.fd, STDERR_FILENO))
+        if(have_actions)
         {
-          ::perror("dup2 errh");
-          ::exit(1);
+          ::posix_spawn_file_actions_destroy(&actions);
+        }
+        if(have_attr)
+        {
+          ::posix_spawnattr_destroy(&attr);
         }
-        ::close(childerrh.fd);
-      }
-      if(-1 == ::execve(ret._path.c_str(), (char **) argptrs.data(), (char **) envptrs.data()))
-      {
-        ::perror("execve");
-        ::exit(1);
-      }
-    }
-    if(-1 == ret._processh.fd)
-      return posix_error();
-#else
-    posix_spawn_file_actions_t child_fd_actions;
-    if(childinpipe.is_valid() || childoutpipe.is_valid() || childerrorpipe.is_valid())
-    {
-      int err = ::posix_spawn_file_actions_init(&child_fd_actions);
-      if(err)
-        return posix_error(err);
-      if(childinpipe.is_valid())
-      {
-        err = ::posix_spawn_file_actions_adddup2(&child_fd_actions, childinpipe.native_handle().fd, STDIN_FILENO);
-        if(err)
-          return posix_error(err);
-        err = ::posix_spawn_file_actions_addclose(&child_fd_actions, childinpipe.native_handle().fd);
-        if(err)
-          return posix_error(err);
       }
-      if(childoutpipe.is_valid())
+    } spawn_state;
+    int err = ::posix_spawnattr_init(&spawn_state.attr);
+    if(err)
+      return posix_error(err);
+    spawn_state.have_attr = true;
+#ifdef POSIX_SPAWN_USEVFORK
+    err = ::posix_spawnattr_setflags(&spawn_state.attr, POSIX_SPAWN_USEVFORK);
+    if(err)
+      return posix_error(err);
+#endif
+    auto redirect = [&](const pipe_handle &h, int fd) -> result<void> {
+      if(!h.is_valid())
       {
-        err = ::posix_spawn_file_actions_adddup2(&child_fd_actions, childoutpipe.native_handle().fd, STDOUT_FILENO);
-        if(err)
-          return posix_error(err);
-        err = ::posix_spawn_file_actions_addclose(&child_fd_actions, childoutpipe.native_handle().fd);
-        if(err)
-          return posix_error(err);
+        return success();
       }
-      if(childerrorpipe.is_valid())
+      if(!spawn_state.have_actions)
       {
-        err = ::posix_spawn_file_actions_adddup2(&child_fd_actions, childerrorpipe.native_handle().fd, STDERR_FILENO);
-        if(err)
-          return posix_error(err);
-        err = ::posix_spawn_file_actions_addclose(&child_fd_actions, childerrorpipe.native_handle().fd);
-        if(err)
-          return posix_error(err);
+        int e = ::posix_spawn_file_actions_init(&spawn_state.actions);
+        if(e)
+          return posix_error(e);
+        spawn_state.have_actions = true;
       }
-    }
-    int err = ::posix_spawn(&nativeh.pid, argptrs[0], (childinpipe.is_valid() || childoutpipe.is_valid() || childerrorpipe.is_valid()) ? &child_fd_actions : nullptr, nullptr, (char **) argptrs.data(), (char **) envptrs.data());
+      int e = ::posix_spawn_file_actions_adddup2(&spawn_state.actions, h.native_handle().fd, fd);
+      if(e)
+        return posix_error(e);
+      e = ::posix_spawn_file_actions_addclose(&spawn_state.actions, h.native_handle().fd);
+      if(e)
+        return posix_error(e);
+      return success();
+    };
+    OUTCOME_TRY(redirect(childinpipe, STDIN_FILENO));
+    OUTCOME_TRY(redirect(childoutpipe, STDOUT_FILENO));
+    OUTCOME_TRY(redirect(childerrorpipe, STDERR_FILENO));
+    err = ::posix_spawn(&nativeh.pid, argptrs[0], spawn_state.have_actions ? &spawn_state.actions : nullptr, &spawn_state.attr, (char **) argptrs.data(),
+                        (char **) envptrs.data());
     if(err)
       return posix_error(err);
-    if(childinpipe.is_valid() || childoutpipe.is_valid() || childerrorpipe.is_valid())
-    {
-      ::posix_spawn_file_actions_destroy(&child_fd_actions);
-    }
-#endif
     return ret;
   }
   catch(...)
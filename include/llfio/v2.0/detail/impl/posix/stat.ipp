@@ -23,6 +23,7 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../../../handle.hpp"
+#include "../../../io_multiplexer.hpp"
 #include "../../../stat.hpp"
 
 #include <sys/stat.h>
@@ -86,60 +87,64 @@ inline struct timespec from_timepoint(std::chrono::system_clock::time_point time
   return {static_cast<time_t>(duration.count() / STL_TICKS_PER_SEC), static_cast<long int>((duration.count() % STL_TICKS_PER_SEC) * divider / multiplier)};
 }
 
-LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, stat_t::want wanted) noexcept
-{
-  LLFIO_LOG_FUNCTION_CALL(&h);
-  size_t ret = 0;
 #ifdef __linux__
+namespace detail
+{
+  struct statx_timestamp
   {
-    struct statx_timestamp
-    {
-      int64_t tv_sec;   /* Seconds since the Epoch (UNIX time) */
-      uint32_t tv_nsec; /* Nanoseconds since tv_sec */
-      uint32_t __reserved;
-    };
-    struct statx
-    {
-      uint32_t stx_mask;       /* Mask of bits indicating
-                               filled fields */
-      uint32_t stx_blksize;    /* Block size for filesystem I/O */
-      uint64_t stx_attributes; /* Extra file attribute indicators */
-      uint32_t stx_nlink;      /* Number of hard links */
-      uint32_t stx_uid;        /* User ID of owner */
-      uint32_t stx_gid;        /* Group ID of owner */
-      uint16_t stx_mode;       /* File type and mode */
-      uint16_t __spare0[1];
-      uint64_t stx_ino;    /* Inode number */
-      uint64_t stx_size;   /* Total size in bytes */
-      uint64_t stx_blocks; /* Number of 512B blocks allocated */
-      uint64_t stx_attributes_mask;
-      /* Mask to show what's supported
-         in stx_attributes */
+    int64_t tv_sec;   /* Seconds since the Epoch (UNIX time) */
+    uint32_t tv_nsec; /* Nanoseconds since tv_sec */
+    uint32_t __reserved;
+  };
+  struct statx_t
+  {
+    uint32_t stx_mask;       /* Mask of bits indicating
+                             filled fields */
+    uint32_t stx_blksize;    /* Block size for filesystem I/O */
+    uint64_t stx_attributes; /* Extra file attribute indicators */
+    uint32_t stx_nlink;      /* Number of hard links */
+    uint32_t stx_uid;        /* User ID of owner */
+    uint32_t stx_gid;        /* Group ID of owner */
+    uint16_t stx_mode;       /* File type and mode */
+    uint16_t __spare0[1];
+    uint64_t stx_ino;    /* Inode number */
+    uint64_t stx_size;   /* Total size in bytes */
+    uint64_t stx_blocks; /* Number of 512B blocks allocated */
+    uint64_t stx_attributes_mask;
+    /* Mask to show what's supported
+       in stx_attributes */
 
-      /* The following fields are file timestamps */
-      struct statx_timestamp stx_atime; /* Last access */
-      struct statx_timestamp stx_btime; /* Creation */
-      struct statx_timestamp stx_ctime; /* Last status change */
-      struct statx_timestamp stx_mtime; /* Last modification */
+    /* The following fields are file timestamps */
+    struct statx_timestamp stx_atime; /* Last access */
+    struct statx_timestamp stx_btime; /* Creation */
+    struct statx_timestamp stx_ctime; /* Last status change */
+    struct statx_timestamp stx_mtime; /* Last modification */
 
-      /* If this file represents a device, then the next two
-         fields contain the ID of the device */
-      uint32_t stx_rdev_major; /* Major ID */
-      uint32_t stx_rdev_minor; /* Minor ID */
+    /* If this file represents a device, then the next two
+       fields contain the ID of the device */
+    uint32_t stx_rdev_major; /* Major ID */
+    uint32_t stx_rdev_minor; /* Minor ID */
 
-      /* The next two fields contain the ID of the device
-         containing the filesystem where the file resides */
-      uint32_t stx_dev_major; /* Major ID */
-      uint32_t stx_dev_minor; /* Minor ID */
+    /* The next two fields contain the ID of the device
+       containing the filesystem where the file resides */
+    uint32_t stx_dev_major; /* Major ID */
+    uint32_t stx_dev_minor; /* Minor ID */
 
-      uint64_t __spare2[14];
-    } s;
-    memset(&s, 0, sizeof(s));
+    uint64_t stx_mnt_id;           /* Mount ID (Linux 5.8) */
+    uint32_t stx_dio_mem_align;    /* Memory buffer alignment for direct I/O (Linux 6.1) */
+    uint32_t stx_dio_offset_align; /* File offset alignment for direct I/O (Linux 6.1) */
+
+    uint64_t __spare3[12];
+  };
+
+  /* The statx() mask bits for the metadata wanted. Device ids, block size and attributes are
+  always returned by statx() and cost nothing extra, so they need no bits. Asking only for what
+  is wanted lets network filing systems skip revalidating attributes with the server.
+  */
+  inline unsigned statx_mask_from_want(stat_t::want wanted) noexcept
+  {
+    using want = stat_t::want;
     unsigned mask = 0;
-    if(wanted & want::dev)
-    {
-      mask |= 0x0100U /*STATX_INO*/;
-    }
     if(wanted & want::ino)
     {
       mask |= 0x0100U /*STATX_INO*/;
@@ -164,10 +169,6 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, sta
     {
       mask |= 0x0010U /*STATX_GID*/;
     }
-    if(wanted & want::rdev)
-    {
-      mask |= 0x0100U /*STATX_INO*/;
-    }
     if(wanted & want::atim)
     {
       mask |= 0x0020U /*STATX_ATIME*/;
@@ -180,19 +181,11 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, sta
     {
       mask |= 0x0080U /*STATX_CTIME*/;
     }
-    if(wanted & want::size)
-    {
-      mask |= 0x0200U /*STATX_SIZE*/;
-    }
-    if(wanted & want::allocated)
+    if(wanted & (want::size | want::sparse))
     {
       mask |= 0x0200U /*STATX_SIZE*/;
     }
-    if(wanted & want::blocks)
-    {
-      mask |= 0x0400U /*STATX_BLOCKS*/;
-    }
-    if(wanted & want::blksize)
+    if(wanted & (want::allocated | want::blocks | want::sparse))
     {
       mask |= 0x0400U /*STATX_BLOCKS*/;
     }
@@ -200,256 +193,255 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, sta
     {
       mask |= 0x0800U /*STATX_BTIME*/;
     }
-    int flags = AT_EMPTY_PATH | AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW | 0x0000 /*AT_STATX_SYNC_AS_STAT*/;
-    int fd = h.native_handle().fd;
-    if(
+    return mask;
+  }
+
+  // Calls statx(), which glibc did not wrap until recently
+  inline int statx(int dirfd, const char *path, int flags, unsigned mask, statx_t *buffer) noexcept
+  {
 #if defined __aarch64__
-    syscall(291 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(291 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #elif defined __arm__
-    syscall(397 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(397 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #elif defined __alpha__
-    syscall(522 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(522 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #elif defined __i386__ || defined __powerpc64__
-    syscall(383 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(383 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #elif defined __sparc__
-    syscall(360 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(360 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #elif defined __x86_64__
-    syscall(332 /*__NR_statx*/, fd, "", flags, mask, &s)
+    return (int) syscall(332 /*__NR_statx*/, dirfd, path, flags, mask, buffer);
 #else
 #error Unknown Linux platform
 #endif
-    >= 0)
-    {
-      if(wanted & want::dev)
-      {
-        st_dev = makedev(s.stx_dev_major, s.stx_dev_minor);
-        ++ret;
-      }
-      if(wanted & want::ino)
-      {
-        st_ino = s.stx_ino;
-        ++ret;
-      }
-      if(wanted & want::type)
-      {
-        st_type = to_st_type(s.stx_mode);
-        ++ret;
-      }
-      if(wanted & want::perms)
-      {
-        st_perms = s.stx_mode & 0xfff;
-        ++ret;
-      }
-      if(wanted & want::nlink)
-      {
-        st_nlink = s.stx_nlink;
-        ++ret;
-      }
-      if(wanted & want::uid)
-      {
-        st_uid = s.stx_uid;
-        ++ret;
-      }
-      if(wanted & want::gid)
-      {
-        st_gid = s.stx_gid;
-        ++ret;
-      }
-      if(wanted & want::rdev)
-      {
-        st_rdev = makedev(s.stx_rdev_major, s.stx_rdev_minor);
-        ++ret;
-      }
-      if(wanted & want::atim)
-      {
-        st_atim = to_timepoint(timespec{(time_t) s.stx_atime.tv_sec, (long) s.stx_atime.tv_nsec});
-        ++ret;
-      }
-      if(wanted & want::mtim)
-      {
-        st_mtim = to_timepoint(timespec{(time_t) s.stx_mtime.tv_sec, (long) s.stx_mtime.tv_nsec});
-        ++ret;
-      }
-      if(wanted & want::ctim)
-      {
-        st_ctim = to_timepoint(timespec{(time_t) s.stx_ctime.tv_sec, (long) s.stx_ctime.tv_nsec});
-        ++ret;
-      }
-      if(wanted & want::size)
-      {
-        st_size = s.stx_size;
-        ++ret;
-      }
-      if(wanted & want::allocated)
-      {
-        st_allocated = static_cast<handle::extent_type>(s.stx_blocks) * 512;
-        ++ret;
-      }
-      if(wanted & want::blocks)
-      {
-        st_blocks = s.stx_blocks;
-        ++ret;
-      }
-      if(wanted & want::blksize)
-      {
-        st_blksize = s.stx_blksize;
-        ++ret;
-      }
-      if(wanted & want::birthtim)
-      {
-        st_birthtim = to_timepoint(timespec{(time_t) s.stx_btime.tv_sec, (long) s.stx_btime.tv_nsec});
-        ++ret;
-      }
-      if(wanted & want::sparse)
-      {
-        st_sparse = static_cast<unsigned int>((static_cast<handle::extent_type>(s.stx_blocks) * 512) < static_cast<handle::extent_type>(s.stx_size));
-        ++ret;
-      }
-      if(wanted & want::compressed)
-      {
-        st_compressed = static_cast<unsigned int>(s.stx_attributes & 0x0004 /*STATX_ATTR_COMPRESSED*/);
-        ++ret;
-      }
-      return ret;
-    }
-    // std::cerr << "statx failed with " << strerror(errno) << std::endl;
   }
-#endif
+
+  // Only the metadata which statx() says it returned is filled in, e.g. not all filing systems keep birth times
+  inline size_t stat_from_statx(stat_t &out, const statx_t &s, stat_t::want wanted) noexcept
   {
-    struct stat s
+    using want = stat_t::want;
+    size_t ret = 0;
+    if(wanted & want::dev)
     {
-    };
-    memset(&s, 0, sizeof(s));
-
-    if(-1 == ::fstat(h.native_handle().fd, &s))
+      out.st_dev = makedev(s.stx_dev_major, s.stx_dev_minor);
+      ++ret;
+    }
+    if((wanted & want::ino) && (s.stx_mask & 0x0100U /*STATX_INO*/))
     {
-      if(!h.is_symlink() || EBADF != errno)
-      {
-        return posix_error();
-      }
-      // This is a hack, but symlink_handle includes this first so there is a chicken and egg dependency problem
-      OUTCOME_TRY(detail::stat_from_symlink(s, h));
+      out.st_ino = s.stx_ino;
+      ++ret;
+    }
+    if((wanted & want::type) && (s.stx_mask & 0x0001U /*STATX_TYPE*/))
+    {
+      out.st_type = to_st_type(s.stx_mode);
+      ++ret;
+    }
+    if((wanted & want::perms) && (s.stx_mask & 0x0002U /*STATX_MODE*/))
+    {
+      out.st_perms = s.stx_mode & 0xfff;
+      ++ret;
+    }
+    if((wanted & want::nlink) && (s.stx_mask & 0x0004U /*STATX_NLINK*/))
+    {
+      out.st_nlink = s.stx_nlink;
+      ++ret;
     }
+    if((wanted & want::uid) && (s.stx_mask & 0x0008U /*STATX_UID*/))
+    {
+      out.st_uid = s.stx_uid;
+      ++ret;
+    }
+    if((wanted & want::gid) && (s.stx_mask & 0x0010U /*STATX_GID*/))
+    {
+      out.st_gid = s.stx_gid;
+      ++ret;
+    }
+    if(wanted & want::rdev)
+    {
+      out.st_rdev = makedev(s.stx_rdev_major, s.stx_rdev_minor);
+      ++ret;
+    }
+    if((wanted & want::atim) && (s.stx_mask & 0x0020U /*STATX_ATIME*/))
+    {
+      out.st_atim = to_timepoint(timespec{(time_t) s.stx_atime.tv_sec, (long) s.stx_atime.tv_nsec});
+      ++ret;
+    }
+    if((wanted & want::mtim) && (s.stx_mask & 0x0040U /*STATX_MTIME*/))
+    {
+      out.st_mtim = to_timepoint(timespec{(time_t) s.stx_mtime.tv_sec, (long) s.stx_mtime.tv_nsec});
+      ++ret;
+    }
+    if((wanted & want::ctim) && (s.stx_mask & 0x0080U /*STATX_CTIME*/))
+    {
+      out.st_ctim = to_timepoint(timespec{(time_t) s.stx_ctime.tv_sec, (long) s.stx_ctime.tv_nsec});
+      ++ret;
+    }
+    if((wanted & want::size) && (s.stx_mask & 0x0200U /*STATX_SIZE*/))
+    {
+      out.st_size = s.stx_size;
+      ++ret;
+    }
+    if((wanted & want::allocated) && (s.stx_mask & 0x0400U /*STATX_BLOCKS*/))
+    {
+      out.st_allocated = static_cast<handle::extent_type>(s.stx_blocks) * 512;
+      ++ret;
+    }
+    if((wanted & want::blocks) && (s.stx_mask & 0x0400U /*STATX_BLOCKS*/))
+    {
+      out.st_blocks = s.stx_blocks;
+      ++ret;
+    }
+    if(wanted & want::blksize)
+    {
+      out.st_blksize = s.stx_blksize;
+      ++ret;
+    }
+    if((wanted & want::birthtim) && (s.stx_mask & 0x0800U /*STATX_BTIME*/))
+    {
+      out.st_birthtim = to_timepoint(timespec{(time_t) s.stx_btime.tv_sec, (long) s.stx_btime.tv_nsec});
+      ++ret;
+    }
+    if((wanted & want::sparse) && (s.stx_mask & 0x0600U /*STATX_SIZE|STATX_BLOCKS*/) == 0x0600U)
+    {
+      out.st_sparse = static_cast<unsigned int>((static_cast<handle::extent_type>(s.stx_blocks) * 512) < static_cast<handle::extent_type>(s.stx_size));
+      ++ret;
+    }
+    if(wanted & want::compressed)
+    {
+      out.st_compressed = static_cast<unsigned int>(s.stx_attributes & 0x0004 /*STATX_ATTR_COMPRESSED*/);
+      ++ret;
+    }
+    return ret;
+  }
+}  // namespace detail
+#endif
+
+namespace detail
+{
+  inline size_t stat_from_stat(stat_t &out, const struct stat &s, stat_t::want wanted) noexcept
+  {
+    using want = stat_t::want;
+    size_t ret = 0;
     if(wanted & want::dev)
     {
-      st_dev = s.st_dev;
+      out.st_dev = s.st_dev;
       ++ret;
     }
     if(wanted & want::ino)
     {
-      st_ino = s.st_ino;
+      out.st_ino = s.st_ino;
       ++ret;
     }
     if(wanted & want::type)
     {
-      st_type = to_st_type(s.st_mode);
+      out.st_type = to_st_type(s.st_mode);
       ++ret;
     }
     if(wanted & want::perms)
     {
-      st_perms = s.st_mode & 0xfff;
+      out.st_perms = s.st_mode & 0xfff;
       ++ret;
     }
     if(wanted & want::nlink)
     {
-      st_nlink = s.st_nlink;
+      out.st_nlink = s.st_nlink;
       ++ret;
     }
     if(wanted & want::uid)
     {
-      st_uid = s.st_uid;
+      out.st_uid = s.st_uid;
       ++ret;
     }
     if(wanted & want::gid)
     {
-      st_gid = s.st_gid;
+      out.st_gid = s.st_gid;
       ++ret;
     }
     if(wanted & want::rdev)
     {
-      st_rdev = s.st_rdev;
+      out.st_rdev = s.st_rdev;
       ++ret;
     }
 #ifdef __ANDROID__
     if(wanted & want::atim)
     {
-      st_atim = to_timepoint(*((struct timespec *) &s.st_atime));
+      out.st_atim = to_timepoint(*((struct timespec *) &s.st_atime));
       ++ret;
     }
     if(wanted & want::mtim)
     {
-      st_mtim = to_timepoint(*((struct timespec *) &s.st_mtime));
+      out.st_mtim = to_timepoint(*((struct timespec *) &s.st_mtime));
       ++ret;
     }
     if(wanted & want::ctim)
     {
-      st_ctim = to_timepoint(*((struct timespec *) &s.st_ctime));
+      out.st_ctim = to_timepoint(*((struct timespec *) &s.st_ctime));
       ++ret;
     }
 #elif defined(__APPLE__)
     if(wanted & want::atim)
     {
-      st_atim = to_timepoint(s.st_atimespec);
+      out.st_atim = to_timepoint(s.st_atimespec);
       ++ret;
     }
     if(wanted & want::mtim)
     {
-      st_mtim = to_timepoint(s.st_mtimespec);
+      out.st_mtim = to_timepoint(s.st_mtimespec);
       ++ret;
     }
     if(wanted & want::ctim)
     {
-      st_ctim = to_timepoint(s.st_ctimespec);
+      out.st_ctim = to_timepoint(s.st_ctimespec);
       ++ret;
     }
 #else  // Linux and BSD
     if(wanted & want::atim)
     {
-      st_atim = to_timepoint(s.st_atim);
+      out.st_atim = to_timepoint(s.st_atim);
       ++ret;
     }
     if(wanted & want::mtim)
     {
-      st_mtim = to_timepoint(s.st_mtim);
+      out.st_mtim = to_timepoint(s.st_mtim);
       ++ret;
     }
     if(wanted & want::ctim)
     {
-      st_ctim = to_timepoint(s.st_ctim);
+      out.st_ctim = to_timepoint(s.st_ctim);
       ++ret;
     }
 #endif
     if(wanted & want::size)
     {
-      st_size = s.st_size;
+      out.st_size = s.st_size;
       ++ret;
     }
     if(wanted & want::allocated)
     {
-      st_allocated = static_cast<handle::extent_type>(s.st_blocks) * 512;
+      out.st_allocated = static_cast<handle::extent_type>(s.st_blocks) * 512;
       ++ret;
     }
     if(wanted & want::blocks)
     {
-      st_blocks = s.st_blocks;
+      out.st_blocks = s.st_blocks;
       ++ret;
     }
     if(wanted & want::blksize)
     {
-      st_blksize = s.st_blksize;
+      out.st_blksize = s.st_blksize;
       ++ret;
     }
 #ifdef HAVE_STAT_FLAGS
     if(wanted & want::flags)
     {
-      st_flags = s.st_flags;
+      out.st_flags = s.st_flags;
       ++ret;
     }
 #endif
 #ifdef HAVE_STAT_GEN
     if(wanted & want::gen)
     {
-      st_gen = s.st_gen;
+      out.st_gen = s.st_gen;
       ++ret;
     }
 #endif
@@ -457,24 +449,120 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, sta
 #if defined(__APPLE__)
     if(wanted & want::birthtim)
     {
-      st_birthtim = to_timepoint(s.st_birthtimespec);
+      out.st_birthtim = to_timepoint(s.st_birthtimespec);
       ++ret;
     }
 #else
     if(wanted & want::birthtim)
     {
-      st_birthtim = to_timepoint(s.st_birthtim);
+      out.st_birthtim = to_timepoint(s.st_birthtim);
       ++ret;
     }
 #endif
 #endif
     if(wanted & want::sparse)
     {
-      st_sparse = static_cast<unsigned int>((static_cast<handle::extent_type>(s.st_blocks) * 512) < static_cast<handle::extent_type>(s.st_size));
+      out.st_sparse = static_cast<unsigned int>((static_cast<handle::extent_type>(s.st_blocks) * 512) < static_cast<handle::extent_type>(s.st_size));
       ++ret;
     }
     return ret;
   }
+}  // namespace detail
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, stat_t::want wanted, bool cached) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(&h);
+#ifdef __linux__
+  {
+    detail::statx_t s;
+    memset(&s, 0, sizeof(s));
+    unsigned mask = detail::statx_mask_from_want(wanted);
+    int flags = AT_EMPTY_PATH | AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW | (cached ? 0x4000 /*AT_STATX_DONT_SYNC*/ : 0x0000 /*AT_STATX_SYNC_AS_STAT*/);
+    int fd = h.native_handle().fd;
+    if(detail::statx(fd, "", flags, mask, &s) >= 0)
+    {
+      return detail::stat_from_statx(*this, s, wanted);
+    }
+    // std::cerr << "statx failed with " << strerror(errno) << std::endl;
+  }
+#else
+  (void) cached;
+#endif
+  {
+    struct stat s
+    {
+    };
+    memset(&s, 0, sizeof(s));
+
+    if(-1 == ::fstat(h.native_handle().fd, &s))
+    {
+      if(!h.is_symlink() || EBADF != errno)
+      {
+        return posix_error();
+      }
+      // This is a hack, but symlink_handle includes this first so there is a chicken and egg dependency problem
+      OUTCOME_TRY(detail::stat_from_symlink(s, h));
+    }
+    return detail::stat_from_stat(*this, s, wanted);
+  }
+}
+
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<size_t>>> stat_t::fill(span<stat_t> out, span<const handle *const> hs, stat_t::want wanted,
+                                                                                 io_multiplexer *multiplexer, bool cached) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  if(out.size() != hs.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    std::vector<result<size_t>> ret;
+    ret.reserve(hs.size());
+#ifdef __linux__
+    if(multiplexer != nullptr && !hs.empty())
+    {
+      std::vector<detail::statx_t> bufs(hs.size());
+      std::vector<io_multiplexer::posix_fs_syscall> ops(hs.size());
+      const unsigned mask = detail::statx_mask_from_want(wanted);
+      for(size_t n = 0; n < hs.size(); n++)
+      {
+        auto &op = ops[n];
+        op.op = io_multiplexer::posix_fs_syscall::kind::statx;
+        op.fd = hs[n]->native_handle().fd;
+        op.path = "";
+        op.flags = AT_EMPTY_PATH | AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW | (cached ? 0x4000 /*AT_STATX_DONT_SYNC*/ : 0x0000 /*AT_STATX_SYNC_AS_STAT*/);
+        op.mode = mask;
+        op.buffer = &bufs[n];
+      }
+      OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+      for(size_t n = 0; n < hs.size(); n++)
+      {
+        if(ops[n].result >= 0)
+        {
+          ret.emplace_back(detail::stat_from_statx(out[n], bufs[n], wanted));
+        }
+        else
+        {
+          // statx() may be unsupported by the kernel or the filing system, let fill() fall back to fstat()
+          ret.push_back(out[n].fill(*hs[n], wanted, cached));
+        }
+      }
+      return ret;
+    }
+#else
+    (void) multiplexer;
+#endif
+    for(size_t n = 0; n < hs.size(); n++)
+    {
+      ret.push_back(out[n].fill(*hs[n], wanted, cached));
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
 }
 
 LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<stat_t::want> stat_t::stamp(handle &h, stat_t::want wanted) noexcept
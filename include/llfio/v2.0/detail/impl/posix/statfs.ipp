@@ -27,12 +27,114 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include <sys/mount.h>
 #ifdef __linux__
+#include <memory>
+#include <mutex>
+
+#include <fcntl.h>
 #include <mntent.h>
+#include <poll.h>
 #include <sys/statfs.h>
 #endif
 
 LLFIO_V2_NAMESPACE_BEGIN
 
+#ifdef __linux__
+namespace detail
+{
+  struct statfs_mountentry
+  {
+    std::string mnt_fsname, mnt_dir, mnt_type, mnt_opts;
+    statfs_mountentry(const char *a, const char *b, const char *c, const char *d)
+        : mnt_fsname(a)
+        , mnt_dir(b)
+        , mnt_type(c)
+        , mnt_opts(d)
+    {
+    }
+  };
+  using statfs_mounttable = std::vector<std::pair<statfs_mountentry, struct statfs64>>;
+
+  /* Reading the mount table and statfs()ing every mount is far more expensive than the fstatfs()
+  of the handle, so the table is cached process wide. The kernel signals POLLPRI on an open
+  `/proc/self/mountinfo` whenever the mount table of the process' namespace changes, so the cache
+  is reread only then. Without procfs, the table is reread on every call as before.
+  */
+  inline result<std::shared_ptr<const statfs_mounttable>> statfs_current_mounttable() noexcept
+  {
+    struct cache_t
+    {
+      std::mutex lock;
+      int fd{-2};
+      std::shared_ptr<const statfs_mounttable> table;
+      ~cache_t()
+      {
+        if(fd >= 0)
+        {
+          ::close(fd);
+        }
+      }
+    };
+    static cache_t cache;
+    try
+    {
+      std::lock_guard<std::mutex> g(cache.lock);
+      if(cache.fd == -2)
+      {
+        // Opened before the table is first read, so no change can be missed
+        cache.fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+      }
+      if(cache.fd >= 0 && cache.table)
+      {
+        struct pollfd pfd
+        {
+        };
+        pfd.fd = cache.fd;
+        pfd.events = POLLPRI;
+        // A poll which reports the change also consumes it
+        if(0 == ::poll(&pfd, 1, 0))
+        {
+          return cache.table;
+        }
+      }
+      auto table = std::make_shared<statfs_mounttable>();
+      // Need to parse mount options on Linux
+      FILE *mtab = setmntent("/etc/mtab", "r");
+      if(mtab == nullptr)
+      {
+        mtab = setmntent("/proc/mounts", "r");
+      }
+      if(mtab == nullptr)
+      {
+        return posix_error();
+      }
+      auto unmtab = make_scope_exit([mtab]() noexcept { endmntent(mtab); });
+      struct mntent m
+      {
+      };
+      char buffer[32768];
+      while(getmntent_r(mtab, &m, buffer, sizeof(buffer)) != nullptr)
+      {
+        struct statfs64 temp
+        {
+        };
+        memset(&temp, 0, sizeof(temp));
+        // std::cout << m.mnt_fsname << "," << m.mnt_dir << "," << m.mnt_type << "," << m.mnt_opts << std::endl;
+        if(0 == statfs64(m.mnt_dir, &temp))
+        {
+          table->emplace_back(statfs_mountentry(m.mnt_fsname, m.mnt_dir, m.mnt_type, m.mnt_opts), temp);
+        }
+      }
+      cache.table = std::move(table);
+      return cache.table;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+}  // namespace detail
+#endif
+
 LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> statfs_t::fill(const handle &h, statfs_t::want wanted) noexcept
 {
   size_t ret = 0;
@@ -96,49 +198,14 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> statfs_t::fill(const handle &h, s
   {
     try
     {
-      struct mountentry
-      {
-        std::string mnt_fsname, mnt_dir, mnt_type, mnt_opts;
-        mountentry(const char *a, const char *b, const char *c, const char *d)
-            : mnt_fsname(a)
-            , mnt_dir(b)
-            , mnt_type(c)
-            , mnt_opts(d)
-        {
-        }
-      };
-      std::vector<std::pair<mountentry, struct statfs64>> mountentries;
+      OUTCOME_TRY(auto &&mounttable, detail::statfs_current_mounttable());
+      detail::statfs_mounttable mountentries;
+      for(auto &i : *mounttable)
       {
-        // Need to parse mount options on Linux
-        FILE *mtab = setmntent("/etc/mtab", "r");
-        if(mtab == nullptr)
-        {
-          mtab = setmntent("/proc/mounts", "r");
-        }
-        if(mtab == nullptr)
-        {
-          return posix_error();
-        }
-        auto unmtab = make_scope_exit([mtab]() noexcept { endmntent(mtab); });
-        struct mntent m
-        {
-        };
-        char buffer[32768];
-        while(getmntent_r(mtab, &m, buffer, sizeof(buffer)) != nullptr)
+        // std::cout << "   " << i.second.f_fsid.__val[0] << i.second.f_fsid.__val[1] << " =? " << s.f_fsid.__val[0] << s.f_fsid.__val[1] << std::endl;
+        if(i.second.f_type == s.f_type && (memcmp(&i.second.f_fsid, &s.f_fsid, sizeof(s.f_fsid)) == 0))
         {
-          struct statfs64 temp
-          {
-          };
-          memset(&temp, 0, sizeof(temp));
-          // std::cout << m.mnt_fsname << "," << m.mnt_dir << "," << m.mnt_type << "," << m.mnt_opts << std::endl;
-          if(0 == statfs64(m.mnt_dir, &temp))
-          {
-            // std::cout << "   " << temp.f_fsid.__val[0] << temp.f_fsid.__val[1] << " =? " << s.f_fsid.__val[0] << s.f_fsid.__val[1] << std::endl;
-            if(temp.f_type == s.f_type && (memcmp(&temp.f_fsid, &s.f_fsid, sizeof(s.f_fsid)) == 0))
-            {
-              mountentries.emplace_back(mountentry(m.mnt_fsname, m.mnt_dir, m.mnt_type, m.mnt_opts), temp);
-            }
-          }
+          mountentries.push_back(i);
         }
       }
 #ifndef LLFIO_COMPILING_FOR_GCOV
@@ -22,6 +22,7 @@ Distributed under the Boost Software License, Version 1.0.
           http://www.boost.org/LICENSE_1_0.txt)
 */
 
+#include "../../../io_multiplexer.hpp"
 #include "../../../symlink_handle.hpp"
 #include "import.hpp"
 
@@ -56,7 +57,7 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> symlink_handle::_create_symlink(con
   {
     if(d.steady)
     {
-      began_steady = std::chrono::steady_clock::now();
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
     }
     else
     {
@@ -84,7 +85,7 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> symlink_handle::_create_symlink(con
             {
               if(d.steady)
               {
-                if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
+                if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
                 {
                   return errc::timed_out;
                 }
@@ -167,7 +168,7 @@ result<symlink_handle> symlink_handle::reopen(mode mode_, deadline d) const noex
   {
     if(d.steady)
     {
-      began_steady = std::chrono::steady_clock::now();
+      began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
     }
     else
     {
@@ -199,7 +200,7 @@ result<symlink_handle> symlink_handle::reopen(mode mode_, deadline d) const noex
     {
       if(d.steady)
       {
-        if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
+        if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds(d.nsecs)))
         {
           return errc::timed_out;
         }
@@ -476,4 +477,104 @@ result<symlink_handle::const_buffers_type> symlink_handle::write(symlink_handle:
   return success(std::move(req.buffers));
 }
 
+result<std::vector<result<symlink_handle::path_type>>> symlink_handle::read_links(const path_handle &base, span<const symlink_handle::path_view_type> paths) noexcept
+{
+  try
+  {
+    std::vector<result<path_type>> ret;
+    ret.reserve(paths.size());
+    const int dirfd = base.is_valid() ? base.native_handle().fd : AT_FDCWD;
+    // One buffer for the whole batch, grown when a link's contents don't fit
+    std::vector<char> buffer(256);
+    for(const auto &path : paths)
+    {
+      path_view::c_str<> zpath(path, path_view::zero_terminated);
+      for(;;)
+      {
+        ssize_t read = ::readlinkat(dirfd, zpath.buffer, buffer.data(), buffer.size());
+        if(read == -1)
+        {
+          ret.push_back(result<path_type>(posix_error()));
+          break;
+        }
+        if((size_t) read == buffer.size())
+        {
+          buffer.resize(buffer.size() * 2);
+          continue;
+        }
+        ret.push_back(path_type(buffer.data(), buffer.data() + read));
+        break;
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> symlink_handle::create_links(const path_handle &base, span<const symlink_handle::path_view_type> paths,
+                                                               span<const path_view> targets, io_multiplexer *multiplexer) noexcept
+{
+  if(paths.size() != targets.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(paths.size());
+    const int dirfd = base.is_valid() ? base.native_handle().fd : AT_FDCWD;
+    using zpath_type = path_view::c_str<>;
+    if(multiplexer == nullptr)
+    {
+      for(size_t n = 0; n < paths.size(); n++)
+      {
+        zpath_type zpath(paths[n], path_view::zero_terminated);
+        zpath_type ztarget(targets[n], path_view::zero_terminated);
+        if(-1 == ::symlinkat(ztarget.buffer, dirfd, zpath.buffer))
+        {
+          ret.push_back(result<void>(posix_error()));
+        }
+        else
+        {
+          ret.push_back(success());
+        }
+      }
+      return ret;
+    }
+    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+    std::vector<posix_fs_syscall> ops(paths.size());
+    std::vector<std::unique_ptr<zpath_type>> zpaths(paths.size() * 2);
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      zpaths[n * 2] = std::make_unique<zpath_type>(paths[n], path_view::zero_terminated);
+      zpaths[n * 2 + 1] = std::make_unique<zpath_type>(targets[n], path_view::zero_terminated);
+      auto &op = ops[n];
+      op.op = posix_fs_syscall::kind::symlinkat;
+      op.fd = dirfd;
+      op.path = zpaths[n * 2]->buffer;
+      op.buffer = (void *) zpaths[n * 2 + 1]->buffer;
+    }
+    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+    for(auto &op : ops)
+    {
+      if(op.result < 0)
+      {
+        ret.push_back(result<void>(posix_error(-op.result)));
+      }
+      else
+      {
+        ret.push_back(success());
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 LLFIO_V2_NAMESPACE_END
@@ -24,12 +24,15 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../../../utils.hpp"
 
+#include <algorithm>
 #include <mutex>  // for lock_guard
 
+#include <fcntl.h>  // for posix_fadvise
 #include <sys/mman.h>
 
 #ifdef __linux__
-#include <unistd.h>  // for preadv
+#include <sys/syscall.h>  // for SYS_getrandom
+#include <unistd.h>       // for preadv
 #endif
 #ifdef __APPLE__
 #include <mach/task.h>
@@ -132,22 +135,64 @@ namespace utils
 #pragma warning(pop)
 #endif
 
-  void random_fill(char *buffer, size_t bytes) noexcept
+  inline std::pair<spinlock, tuning_hints> &_tuning_hints() noexcept
   {
-    static spinlock lock;
-    static std::atomic<int> randomfd(-1);
-    int fd = randomfd;
-    if(-1 == fd)
-    {
-      std::lock_guard<decltype(lock)> g(lock);
-      randomfd = fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
-    }
-    if(-1 == fd || ::read(fd, buffer, bytes) < static_cast<ssize_t>(bytes))
+    static std::pair<spinlock, tuning_hints> v;
+    return v;
+  }
+  tuning_hints tuning() noexcept
+  {
+    auto &v = _tuning_hints();
+    std::lock_guard<decltype(v.first)> g(v.first);
+    return v.second;
+  }
+  void set_tuning(const tuning_hints &hints) noexcept
+  {
+    auto &v = _tuning_hints();
+    std::lock_guard<decltype(v.first)> g(v.first);
+    v.second = hints;
+  }
+
+  namespace detail
+  {
+    void kernel_random_fill(char *buffer, size_t bytes) noexcept
     {
-      LLFIO_LOG_FATAL(0, "llfio: Kernel crypto function failed");
-      std::terminate();
+#if defined(__linux__) && defined(SYS_getrandom)
+      // getrandom() needs no fd, and blocks only until the kernel entropy pool is first initialised
+      while(bytes > 0)
+      {
+        const long ret = ::syscall(SYS_getrandom, buffer, bytes, 0);
+        if(ret < 0)
+        {
+          if(EINTR == errno)
+          {
+            continue;
+          }
+          break;
+        }
+        buffer += ret;
+        bytes -= (size_t) ret;
+      }
+      if(bytes == 0)
+      {
+        return;
+      }
+#endif
+      static spinlock lock;
+      static std::atomic<int> randomfd(-1);
+      int fd = randomfd;
+      if(-1 == fd)
+      {
+        std::lock_guard<decltype(lock)> g(lock);
+        randomfd = fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+      }
+      if(-1 == fd || ::read(fd, buffer, bytes) < static_cast<ssize_t>(bytes))
+      {
+        LLFIO_LOG_FATAL(0, "llfio: Kernel crypto function failed");
+        std::terminate();
+      }
     }
-  }
+  }  // namespace detail
 
   result<void> flush_modified_data() noexcept
   {
@@ -175,6 +220,52 @@ namespace utils
     return errc::not_supported;
   }
 
+  result<void> flush_modified_data(const native_handle_type &h) noexcept
+  {
+#ifdef __linux__
+    if(-1 == ::syncfs(h.fd))
+    {
+      return posix_error();
+    }
+#else
+    if(-1 == ::fsync(h.fd))
+    {
+      return posix_error();
+    }
+    ::sync();
+#endif
+    return success();
+  }
+
+  result<void> flush_directory(const native_handle_type &h) noexcept
+  {
+    if(-1 == ::fsync(h.fd))
+    {
+      return posix_error();
+    }
+    return success();
+  }
+
+  result<void> drop_filesystem_cache(const native_handle_type &h) noexcept
+  {
+    // Modified pages cannot be dropped
+    if(-1 == ::fsync(h.fd))
+    {
+      return posix_error();
+    }
+#ifdef POSIX_FADV_DONTNEED
+    // posix_fadvise() returns the error rather than setting errno
+    int errcode = ::posix_fadvise(h.fd, 0, 0, POSIX_FADV_DONTNEED);
+    if(errcode != 0)
+    {
+      return posix_error(errcode);
+    }
+    return success();
+#else
+    return errc::not_supported;
+#endif
+  }
+
   bool running_under_wsl() noexcept
   {
 #ifdef __linux__
@@ -208,9 +299,45 @@ namespace utils
     return false;
   }
 
-  result<process_memory_usage> current_process_memory_usage() noexcept
+  result<process_memory_usage> current_process_memory_usage(process_memory_usage::accuracy acc) noexcept
   {
 #ifdef __linux__
+    if(acc == process_memory_usage::accuracy::fast)
+    {
+      /* /proc/[pid]/statm reports counters the kernel keeps for the address space, so
+      unlike smaps it costs the same however many mappings there are:
+
+      total_address_space_in_use = size
+      total_address_space_paged_in = resident
+      private_committed = data (private writable mappings and stack, i.e. VmData + VmStk)
+      private_paged_in = resident - shared (i.e. RssAnon)
+      */
+      int ih = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+      if(ih == -1)
+      {
+        return posix_error();
+      }
+      char buffer[256];
+      const auto bytesread = ::read(ih, buffer, sizeof(buffer) - 1);
+      ::close(ih);
+      if(bytesread < 0)
+      {
+        return posix_error();
+      }
+      buffer[bytesread] = 0;
+      unsigned long long size = 0, resident = 0, shared = 0, text = 0, lib = 0, data = 0;
+      if(6 != sscanf(buffer, "%llu %llu %llu %llu %llu %llu", &size, &resident, &shared, &text, &lib, &data))
+      {
+        return errc::illegal_byte_sequence;
+      }
+      const size_t pagesize = page_size();
+      process_memory_usage ret;
+      ret.total_address_space_in_use = (size_t) size * pagesize;
+      ret.total_address_space_paged_in = (size_t) resident * pagesize;
+      ret.private_committed = (size_t) data * pagesize;
+      ret.private_paged_in = (size_t)(resident - std::min(resident, shared)) * pagesize;
+      return ret;
+    }
     try
     {
       /* /proc/[pid]/status:
@@ -404,6 +531,8 @@ namespace utils
       return error_from_exception();
     }
 #elif defined(__APPLE__)
+  // This is always cheap
+  (void) acc;
   kern_return_t error;
   mach_msg_type_number_t outCount;
   task_vm_info_data_t vmInfo;
@@ -432,6 +561,71 @@ namespace utils
 #endif
   }
 
+  result<memory_pressure> current_memory_pressure() noexcept
+  {
+#ifdef __linux__
+    int ih = ::open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+    if(ih == -1)
+    {
+      return posix_error();
+    }
+    char buffer[256];
+    const auto bytesread = ::read(ih, buffer, sizeof(buffer) - 1);
+    ::close(ih);
+    if(bytesread < 0)
+    {
+      return posix_error();
+    }
+    buffer[bytesread] = 0;
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    // full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    memory_pressure ret;
+    const char *some = strstr(buffer, "some avg10="), *full = strstr(buffer, "full avg10=");
+    if(some == nullptr || 1 != sscanf(some, "some avg10=%f", &ret.some))
+    {
+      return errc::illegal_byte_sequence;
+    }
+    // Kernels before 5.13 have no full line for the root cgroup
+    if(full != nullptr)
+    {
+      (void) sscanf(full, "full avg10=%f", &ret.full);
+    }
+    return ret;
+#else
+    return errc::operation_not_supported;
+#endif
+  }
+
+  namespace detail
+  {
+    result<size_t> reclaim_memory(span<byte> region, bool pageout) noexcept
+    {
+      // Round inwards to whole pages, as reclaiming a partial page would reclaim memory outside the region
+      const auto pagesize = page_size();
+      byte *begin = (byte *) (((uintptr_t) region.data() + pagesize - 1) & ~(uintptr_t)(pagesize - 1));
+      byte *end = (byte *) (((uintptr_t) region.data() + region.size()) & ~(uintptr_t)(pagesize - 1));
+      if(end <= begin)
+      {
+        return 0;
+      }
+#ifdef __linux__
+      // Needs Linux 5.4 or later
+      if(-1 == ::madvise(begin, end - begin, pageout ? 21 /*MADV_PAGEOUT*/ : 20 /*MADV_COLD*/))
+      {
+        if(errno == EINVAL)
+        {
+          return 0;
+        }
+        return posix_error();
+      }
+      return end - begin;
+#else
+      (void) pageout;
+      return 0;
+#endif
+    }
+  }  // namespace detail
+
   namespace detail
   {
     large_page_allocation allocate_large_pages(size_t bytes)
@@ -450,15 +644,20 @@ namespace utils
         flags |= VM_FLAGS_SUPERPAGE_SIZE_ANY;
 #endif
       }
-      if((ret.p = mmap(nullptr, ret.actual_size, PROT_WRITE, flags, -1, 0)) == nullptr)
+      if((ret.p = mmap(nullptr, ret.actual_size, PROT_WRITE, flags, -1, 0)) == MAP_FAILED)
       {
-        if(ENOMEM == errno)
+        ret.p = nullptr;
+        if(ENOMEM == errno || EINVAL == errno)
         {
-          if((ret.p = mmap(nullptr, ret.actual_size, PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0)) != nullptr)
+          // No large pages are available, so fall back to the base page size
+          ret.page_size_used = page_size();
+          ret.actual_size = (bytes + ret.page_size_used - 1) & ~(ret.page_size_used - 1);
+          if((ret.p = mmap(nullptr, ret.actual_size, PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0)) == MAP_FAILED)
           {
-            return ret;
+            ret.p = nullptr;
           }
         }
+        return ret;
       }
 #ifndef NDEBUG
       else if(ret.page_size_used > 65536)
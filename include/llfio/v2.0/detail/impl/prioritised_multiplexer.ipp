@@ -0,0 +1,705 @@
+/* Schedule i/o by priority class
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../io_handle.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* This i/o multiplexer wraps another, which executes all the i/o. i/o states are constructed
+by the inner multiplexer, and only their initiation is deferred.
+
+- Initiated i/o within the limits of its class is passed straight to the inner multiplexer.
+Otherwise it is queued in its class, and remains initialised.
+
+- Whilst in flight, the visitor of each i/o state is replaced with our own, which forwards
+to the original and learns when the i/o finishes. We must never call the inner multiplexer
+with our lock held, as visitors may be invoked from within any call into it.
+
+- Queued i/o is dispatched after any call which may have finished i/o, choosing the class
+with the lowest virtual time, which advances by the reciprocal of the class' weight per
+dispatch. A class whose queue was empty has its virtual time brought up to the current
+virtual time, so idling banks no credit.
+
+- Rate limits are token buckets refilled whenever we dispatch, and which may go into debt by
+one i/o. As no i/o finishing need precede tokens becoming available, whilst rate limited we
+dispatch upon every call which may, and bound waits upon the inner multiplexer accordingly.
+Queued i/o whose deadline passes is completed by us, as the inner multiplexer never saw it.
+*/
+class prioritised_multiplexer final : public io_multiplexer
+{
+  struct _visitor_t final : public io_operation_state_visitor
+  {
+    prioritised_multiplexer *parent{nullptr};
+
+    virtual void read_initiated(lock_guard &g, io_operation_state_type former) override
+    {
+      if(auto *v = parent->_original_visitor(g.state))
+      {
+        v->read_initiated(g, former);
+      }
+    }
+    virtual bool read_completed(lock_guard &g, io_operation_state_type former, io_result<buffers_type> &&res) override
+    {
+      auto *v = parent->_original_visitor(g.state);
+      return (v != nullptr) ? v->read_completed(g, former, std::move(res)) : false;
+    }
+    virtual void read_finished(lock_guard &g, io_operation_state_type former) override
+    {
+      if(auto *v = parent->_finished(g.state))
+      {
+        v->read_finished(g, former);
+      }
+    }
+    virtual void write_initiated(lock_guard &g, io_operation_state_type former) override
+    {
+      if(auto *v = parent->_original_visitor(g.state))
+      {
+        v->write_initiated(g, former);
+      }
+    }
+    virtual bool write_completed(lock_guard &g, io_operation_state_type former, io_result<const_buffers_type> &&res) override
+    {
+      auto *v = parent->_original_visitor(g.state);
+      return (v != nullptr) ? v->write_completed(g, former, std::move(res)) : false;
+    }
+    virtual void barrier_initiated(lock_guard &g, io_operation_state_type former) override
+    {
+      if(auto *v = parent->_original_visitor(g.state))
+      {
+        v->barrier_initiated(g, former);
+      }
+    }
+    virtual bool barrier_completed(lock_guard &g, io_operation_state_type former, io_result<const_buffers_type> &&res) override
+    {
+      auto *v = parent->_original_visitor(g.state);
+      return (v != nullptr) ? v->barrier_completed(g, former, std::move(res)) : false;
+    }
+    virtual void write_or_barrier_finished(lock_guard &g, io_operation_state_type former) override
+    {
+      if(auto *v = parent->_finished(g.state))
+      {
+        v->write_or_barrier_finished(g, former);
+      }
+    }
+  } _visitor;
+
+  struct _entry
+  {
+    io_operation_state_visitor *visitor{nullptr};  // the original visitor
+    size_t cls{0};
+    bool queued{false};
+    uint64_t bytes{0};
+    std::chrono::steady_clock::time_point expiry{std::chrono::steady_clock::time_point::max()};  // if queued
+  };
+
+  io_multiplexer_ptr _inner;
+  io_priority_limits _limits;
+  std::mutex _lock;
+  std::unordered_map<io_operation_state *, _entry> _ops;  // all i/o initiated through us and not yet finished
+  std::deque<io_operation_state *> _queued[io_priorities];
+  size_t _inflight_total{0}, _inflight[io_priorities]{};
+  double _vtime[io_priorities]{}, _vnow{0};
+  std::atomic<bool> _dispatch_pending{false};
+  bool _rate_limited{false};
+  double _bytes_tokens{0}, _ops_tokens{0}, _bytes_burst{0}, _ops_burst{0};
+  std::chrono::steady_clock::time_point _refilled;
+
+  io_operation_state_visitor *_original_visitor(io_operation_state *op) noexcept
+  {
+    std::lock_guard<std::mutex> g(_lock);
+    auto it = _ops.find(op);
+    return (it != _ops.end()) ? it->second.visitor : nullptr;
+  }
+  // Called by the visitor when i/o finishes, returns the original visitor
+  io_operation_state_visitor *_finished(io_operation_state *op) noexcept
+  {
+    std::lock_guard<std::mutex> g(_lock);
+    auto it = _ops.find(op);
+    if(it == _ops.end())
+    {
+      return nullptr;
+    }
+    auto *v = it->second.visitor;
+    if(!it->second.queued)
+    {
+      --_inflight_total;
+      --_inflight[it->second.cls];
+      _dispatch_pending.store(true, std::memory_order_relaxed);
+    }
+    _ops.erase(it);
+    op->visitor = v;
+    return v;
+  }
+
+  // The priority class of an initialised i/o. All multiplexers in this library use states derived from _unsynchronised_io_operation_state.
+  static size_t _class_of(io_operation_state *op) noexcept
+  {
+    auto *state = static_cast<_unsynchronised_io_operation_state *>(op);
+    io_request_flag flags = io_request_flag::none;
+    switch(op->current_state())
+    {
+    case io_operation_state_type::read_initialised:
+      flags = state->payload.noncompleted.params.read.reqs.flags;
+      break;
+    case io_operation_state_type::write_initialised:
+      flags = state->payload.noncompleted.params.write.reqs.flags;
+      break;
+    case io_operation_state_type::barrier_initialised:
+      flags = state->payload.noncompleted.params.barrier.reqs.flags;
+      break;
+    default:
+      break;
+    }
+    return (size_t) op->h->effective_priority(flags);
+  }
+  // The bytes of the buffers of an initialised i/o, zero for barriers
+  static uint64_t _bytes_of(io_operation_state *op) noexcept
+  {
+    auto *state = static_cast<_unsynchronised_io_operation_state *>(op);
+    uint64_t ret = 0;
+    switch(op->current_state())
+    {
+    case io_operation_state_type::read_initialised:
+      for(auto &b : state->payload.noncompleted.params.read.reqs.buffers)
+      {
+        ret += b.size();
+      }
+      break;
+    case io_operation_state_type::write_initialised:
+      for(auto &b : state->payload.noncompleted.params.write.reqs.buffers)
+      {
+        ret += b.size();
+      }
+      break;
+    default:
+      break;
+    }
+    return ret;
+  }
+  // When an initialised i/o would time out if queued now
+  static std::chrono::steady_clock::time_point _expiry_of(io_operation_state *op) noexcept
+  {
+    auto *state = static_cast<_unsynchronised_io_operation_state *>(op);
+    const deadline d = state->payload.noncompleted.d;
+    if(!d)
+    {
+      return std::chrono::steady_clock::time_point::max();
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if(d.steady)
+    {
+      return now + std::chrono::nanoseconds(d.nsecs);
+    }
+    return now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d.to_time_point() - std::chrono::system_clock::now());
+  }
+  // Must be called with the lock held
+  void _refill(std::chrono::steady_clock::time_point now) noexcept
+  {
+    const double secs = std::chrono::duration<double>(now - _refilled).count();
+    _refilled = now;
+    if(_limits.bytes_per_second > 0)
+    {
+      _bytes_tokens = std::min(_bytes_burst, _bytes_tokens + secs * (double) _limits.bytes_per_second);
+    }
+    if(_limits.ops_per_second > 0)
+    {
+      _ops_tokens = std::min(_ops_burst, _ops_tokens + secs * (double) _limits.ops_per_second);
+    }
+  }
+  // Must be called with the lock held. How long until the token buckets are no longer empty.
+  std::chrono::nanoseconds _until_tokens() const noexcept
+  {
+    double secs = 0;
+    if(_bytes_tokens < 0)
+    {
+      secs = -_bytes_tokens / (double) _limits.bytes_per_second;
+    }
+    if(_ops_tokens < 0)
+    {
+      secs = std::max(secs, -_ops_tokens / (double) _limits.ops_per_second);
+    }
+    return std::chrono::nanoseconds((long long) (secs * 1000000000.0) + 1);
+  }
+  // Must be called with the lock held
+  bool _has_capacity(size_t cls) const noexcept
+  {
+    if(_bytes_tokens < 0 || _ops_tokens < 0)
+    {
+      return false;
+    }
+    if(_limits.max_inflight > 0 && _inflight_total >= _limits.max_inflight)
+    {
+      return false;
+    }
+    return _limits.class_max_inflight[cls] == 0 || _inflight[cls] < _limits.class_max_inflight[cls];
+  }
+  // Must be called with the lock held
+  void _account_dispatch(size_t cls, uint64_t bytes) noexcept
+  {
+    ++_inflight_total;
+    ++_inflight[cls];
+    _vnow = _vtime[cls];
+    _vtime[cls] += 1.0 / (double) ((_limits.weight[cls] > 0) ? _limits.weight[cls] : 1);
+    if(_limits.bytes_per_second > 0)
+    {
+      _bytes_tokens -= (double) bytes;
+    }
+    if(_limits.ops_per_second > 0)
+    {
+      _ops_tokens -= 1.0;
+    }
+  }
+  // Completes queued i/o whose deadline has passed
+  void _expire(std::chrono::steady_clock::time_point now) noexcept
+  {
+    for(;;)
+    {
+      io_operation_state *op = nullptr;
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        for(size_t cls = 0; cls < io_priorities && op == nullptr; cls++)
+        {
+          for(auto qit = _queued[cls].begin(); qit != _queued[cls].end(); ++qit)
+          {
+            auto it = _ops.find(*qit);
+            if(it->second.expiry <= now)
+            {
+              op = *qit;
+              op->visitor = it->second.visitor;
+              _ops.erase(it);
+              _queued[cls].erase(qit);
+              break;
+            }
+          }
+        }
+      }
+      if(op == nullptr)
+      {
+        return;
+      }
+      auto *state = static_cast<_unsynchronised_io_operation_state *>(op);
+      switch(op->current_state())
+      {
+      case io_operation_state_type::read_initialised:
+        state->read_completed(io_result<buffers_type>(errc::timed_out));
+        state->read_finished();
+        break;
+      case io_operation_state_type::write_initialised:
+        state->write_completed(io_result<const_buffers_type>(errc::timed_out));
+        state->write_or_barrier_finished();
+        break;
+      case io_operation_state_type::barrier_initialised:
+        state->barrier_completed(io_result<const_buffers_type>(errc::timed_out));
+        state->write_or_barrier_finished();
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  // Initiates queued i/o for as long as the limits permit
+  void _dispatch() noexcept
+  {
+    if(!_dispatch_pending.exchange(false, std::memory_order_relaxed) && !_rate_limited)
+    {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if(_rate_limited)
+    {
+      _expire(now);
+    }
+    bool dispatched = false;
+    for(;;)
+    {
+      io_operation_state *op = nullptr;
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        if(_rate_limited)
+        {
+          _refill(now);
+        }
+        size_t best = io_priorities;
+        for(size_t cls = 0; cls < io_priorities; cls++)
+        {
+          if(!_queued[cls].empty() && _has_capacity(cls) && (best == io_priorities || _vtime[cls] < _vtime[best]))
+          {
+            best = cls;
+          }
+        }
+        if(best == io_priorities)
+        {
+          break;
+        }
+        op = _queued[best].front();
+        _queued[best].pop_front();
+        auto &e = _ops[op];
+        e.queued = false;
+        _account_dispatch(best, e.bytes);
+      }
+      (void) _inner->init_io_operation(op);
+      dispatched = true;
+    }
+    if(dispatched)
+    {
+      (void) _inner->flush_inited_io_operations();
+    }
+  }
+
+public:
+  prioritised_multiplexer() { _visitor.parent = this; }
+  prioritised_multiplexer(const prioritised_multiplexer &) = delete;
+  prioritised_multiplexer(prioritised_multiplexer &&) = delete;
+  prioritised_multiplexer &operator=(const prioritised_multiplexer &) = delete;
+  prioritised_multiplexer &operator=(prioritised_multiplexer &&) = delete;
+  virtual ~prioritised_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) prioritised_multiplexer::close();
+    }
+  }
+  result<void> init(io_multiplexer_ptr inner, const io_priority_limits &limits)
+  {
+    if(!inner)
+    {
+      return errc::invalid_argument;
+    }
+    _inner = std::move(inner);
+    _limits = limits;
+    _rate_limited = (limits.bytes_per_second > 0 || limits.ops_per_second > 0);
+    _bytes_burst = (double) ((limits.burst_bytes > 0) ? limits.burst_bytes : std::max<uint64_t>(limits.bytes_per_second / 10, 1));
+    _ops_burst = (double) ((limits.burst_ops > 0) ? limits.burst_ops : std::max<uint64_t>(limits.ops_per_second / 10, 1));
+    _bytes_tokens = _bytes_burst;
+    _ops_tokens = _ops_burst;
+    _refilled = std::chrono::steady_clock::now();
+    // We have no kernel handle of our own, so store something other than -1
+    this->_v._init = -2;  // otherwise appears closed
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    return success();
+  }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    if(_inner)
+    {
+      OUTCOME_TRY(_inner->close());
+    }
+    this->_v._init = -1;  // make it appear closed
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override { return _inner->do_io_handle_register(h); }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override { return _inner->do_io_handle_deregister(h); }
+  virtual size_t do_io_handle_max_buffers(const io_handle *h) const noexcept override { return _inner->do_io_handle_max_buffers(h); }
+  virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+  {
+    return _inner->do_io_handle_allocate_registered_buffer(h, bytes);
+  }
+
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return _inner->io_state_requirements(); }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<buffers_type> reqs) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+  virtual io_operation_state_type init_io_operation(io_operation_state *op) noexcept override
+  {
+    // The state is not locked by us here, unlike when our lock is held
+    const size_t cls = _class_of(op);
+    const uint64_t bytes = _rate_limited ? _bytes_of(op) : 0;
+    const auto expiry = _rate_limited ? _expiry_of(op) : std::chrono::steady_clock::time_point::max();
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      _entry *e = nullptr;
+      try
+      {
+        e = &_ops.emplace(op, _entry{op->visitor, cls, false, bytes, expiry}).first->second;
+      }
+      catch(...)
+      {
+        // Without tracking we cannot know when the i/o finishes, so it is neither limited nor queued
+        return _inner->init_io_operation(op);
+      }
+      op->visitor = &_visitor;
+      if(_rate_limited)
+      {
+        _refill(std::chrono::steady_clock::now());
+      }
+      if(_queued[cls].empty() && _has_capacity(cls))
+      {
+        _account_dispatch(cls, bytes);
+      }
+      else
+      {
+        if(_queued[cls].empty() && _vtime[cls] < _vnow)
+        {
+          _vtime[cls] = _vnow;
+        }
+        try
+        {
+          _queued[cls].push_back(op);
+          e->queued = true;
+          queued = true;
+        }
+        catch(...)
+        {
+          _account_dispatch(cls, bytes);
+        }
+      }
+    }
+    if(queued)
+    {
+      // i/o may have finished since we last looked
+      _dispatch_pending.store(true, std::memory_order_relaxed);
+      _dispatch();
+      return op->current_state();
+    }
+    return _inner->init_io_operation(op);
+  }
+
+  virtual result<void> flush_inited_io_operations() noexcept override
+  {
+    OUTCOME_TRY(_inner->flush_inited_io_operations());
+    _dispatch();
+    return success();
+  }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *op) noexcept override
+  {
+    bool queued = false;
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      auto it = _ops.find(op);
+      queued = (it != _ops.end()) && it->second.queued;
+    }
+    if(queued)
+    {
+      // Poll the inner multiplexer for finished i/o, which may make room for this i/o
+      (void) _inner->check_for_any_completed_io(std::chrono::seconds(0));
+      _dispatch();
+      return op->current_state();
+    }
+    auto ret = _inner->check_io_operation(op);
+    _dispatch();
+    return ret;
+  }
+
+  // Removes i/o from its queue, returning true if it was queued. Must be called with the lock held.
+  bool _unqueue(io_operation_state *op) noexcept
+  {
+    auto it = _ops.find(op);
+    if(it == _ops.end() || !it->second.queued)
+    {
+      return false;
+    }
+    auto &q = _queued[it->second.cls];
+    for(auto qit = q.begin(); qit != q.end(); ++qit)
+    {
+      if(*qit == op)
+      {
+        q.erase(qit);
+        break;
+      }
+    }
+    it->second.queued = false;
+    _account_dispatch(it->second.cls, it->second.bytes);
+    return true;
+  }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *op, deadline d = {}) noexcept override
+  {
+    // Queued i/o is initiated so the inner multiplexer can cancel it, which is the only means of completing it
+    bool was_queued = false;
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      was_queued = _unqueue(op);
+    }
+    if(was_queued)
+    {
+      (void) _inner->init_io_operation(op);
+    }
+    auto ret = _inner->cancel_io_operation(op, d);
+    _dispatch();
+    return ret;
+  }
+
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept override
+  {
+    for(auto *op : ops)
+    {
+      bool was_queued = false;
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        was_queued = _unqueue(op);
+      }
+      if(was_queued)
+      {
+        (void) _inner->init_io_operation(op);
+      }
+    }
+    auto ret = _inner->cancel_io_operations(ops, d);
+    _dispatch();
+    return ret;
+  }
+
+  virtual result<void> cancel_io_operations(io_handle *h) noexcept override
+  {
+    std::vector<io_operation_state *> ops;
+    try
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      for(auto &i : _ops)
+      {
+        if(i.first->h == h)
+        {
+          ops.push_back(i.first);
+        }
+      }
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    for(auto *op : ops)
+    {
+      bool was_queued = false;
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        was_queued = _unqueue(op);
+      }
+      if(was_queued)
+      {
+        (void) _inner->init_io_operation(op);
+      }
+    }
+    // If the inner multiplexer cannot cancel by handle, cancel each of the i/o we know about
+    auto ret = _inner->cancel_io_operations(h);
+    if(!ret && ret.error() == errc::operation_not_supported)
+    {
+      ret = _inner->cancel_io_operations(ops);
+    }
+    _dispatch();
+    return ret;
+  }
+
+  // Whilst rate limited i/o is queued, waits upon the inner multiplexer are bounded by when it can next be dispatched or time out
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0),
+                                                                                   size_t max_completions = (size_t) -1) noexcept override
+  {
+    if(!_rate_limited)
+    {
+      OUTCOME_TRY(auto &&ret, _inner->check_for_any_completed_io(d, max_completions));
+      _dispatch();
+      return ret;
+    }
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    for(;;)
+    {
+      bool bounded = false;
+      std::chrono::nanoseconds wait(0);
+      {
+        std::lock_guard<std::mutex> g(_lock);
+        const auto now = std::chrono::steady_clock::now();
+        for(size_t cls = 0; cls < io_priorities; cls++)
+        {
+          for(auto *op : _queued[cls])
+          {
+            const auto expiry = _ops.find(op)->second.expiry;
+            const auto until = (expiry <= now) ? std::chrono::nanoseconds(0) : std::chrono::duration_cast<std::chrono::nanoseconds>(expiry - now);
+            if(expiry != std::chrono::steady_clock::time_point::max() && (!bounded || until < wait))
+            {
+              wait = until;
+              bounded = true;
+            }
+          }
+          if(!_queued[cls].empty() && (!bounded || _until_tokens() < wait))
+          {
+            wait = _until_tokens();
+            bounded = true;
+          }
+        }
+      }
+      if(bounded && d)
+      {
+        std::chrono::nanoseconds timeout;
+        LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(timeout, d);
+        bounded = (timeout > wait);
+      }
+      OUTCOME_TRY(auto &&ret, _inner->check_for_any_completed_io(bounded ? deadline(wait) : d, max_completions));
+      _dispatch();
+      if(!bounded || ret.initiated_ios_completed > 0 || ret.initiated_ios_finished > 0)
+      {
+        return ret;
+      }
+    }
+  }
+
+  virtual result<void> wake_check_for_any_completed_io() noexcept override { return _inner->wake_check_for_any_completed_io(); }
+
+#ifndef _WIN32
+  virtual result<void> do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _inner->do_posix_fs_syscalls(ops); }
+  virtual result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _inner->initiate_posix_fs_syscalls(ops); }
+#endif
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_prioritised(io_multiplexer_ptr inner, const io_multiplexer::io_priority_limits &limits) noexcept
+{
+  try
+  {
+    auto ret = std::make_unique<prioritised_multiplexer>();
+    OUTCOME_TRY(ret->init(std::move(inner), limits));
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
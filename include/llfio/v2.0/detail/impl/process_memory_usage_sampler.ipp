@@ -0,0 +1,142 @@
+/* Background sampling of process memory usage
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../utils.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace utils
+{
+  namespace detail
+  {
+    struct process_memory_usage_sampler_state
+    {
+      std::mutex lock;
+      std::condition_variable changed;
+      std::thread thread;
+      std::chrono::milliseconds interval{0};
+      process_memory_usage::accuracy acc{process_memory_usage::accuracy::fast};
+      process_memory_usage sample;
+      // Incremented to tell the thread to exit, so a thread being stopped never picks up a later start's interval
+      unsigned generation{0};
+
+      process_memory_usage_sampler_state() = default;
+      process_memory_usage_sampler_state(const process_memory_usage_sampler_state &) = delete;
+      process_memory_usage_sampler_state &operator=(const process_memory_usage_sampler_state &) = delete;
+      // The thread must be joined before static destruction completes
+      ~process_memory_usage_sampler_state() { stop(); }
+
+      void stop() noexcept
+      {
+        std::unique_lock<std::mutex> g(lock);
+        if(!thread.joinable())
+        {
+          return;
+        }
+        ++generation;
+        changed.notify_all();
+        std::thread t(std::move(thread));
+        g.unlock();
+        t.join();
+      }
+      void run(unsigned mygeneration) noexcept
+      {
+        std::unique_lock<std::mutex> g(lock);
+        while(mygeneration == generation)
+        {
+          // Reconfiguration wakes us early, which just means an extra sample
+          changed.wait_for(g, interval);
+          if(mygeneration != generation)
+          {
+            break;
+          }
+          const auto a = acc;
+          g.unlock();
+          auto r = current_process_memory_usage(a);
+          g.lock();
+          if(r)
+          {
+            sample = r.value();
+          }
+        }
+      }
+    };
+    inline process_memory_usage_sampler_state &process_memory_usage_sampler() noexcept
+    {
+      static process_memory_usage_sampler_state v;
+      return v;
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> start_process_memory_usage_sampler(std::chrono::milliseconds interval, process_memory_usage::accuracy acc) noexcept
+  {
+    auto &state = detail::process_memory_usage_sampler();
+    if(interval.count() <= 0)
+    {
+      state.stop();
+      return success();
+    }
+    OUTCOME_TRY(auto &&first, current_process_memory_usage(acc));
+    try
+    {
+      std::lock_guard<std::mutex> g(state.lock);
+      state.interval = interval;
+      state.acc = acc;
+      state.sample = first;
+      if(state.thread.joinable())
+      {
+        state.changed.notify_all();
+        return success();
+      }
+      const unsigned generation = state.generation;
+      state.thread = std::thread([&state, generation] { state.run(generation); });
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void stop_process_memory_usage_sampler() noexcept { detail::process_memory_usage_sampler().stop(); }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<process_memory_usage> sampled_process_memory_usage() noexcept
+  {
+    auto &state = detail::process_memory_usage_sampler();
+    {
+      std::lock_guard<std::mutex> g(state.lock);
+      if(state.thread.joinable())
+      {
+        return state.sample;
+      }
+    }
+    return current_process_memory_usage(process_memory_usage::accuracy::fast);
+  }
+}  // namespace utils
+
+LLFIO_V2_NAMESPACE_END
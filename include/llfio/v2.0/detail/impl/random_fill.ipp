@@ -0,0 +1,283 @@
+/* Fast cryptographically strong randomness
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifndef _WIN32
+#include <pthread.h>  // for pthread_atfork
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>  // for SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace utils
+{
+  namespace detail
+  {
+    /* ChaCha20 is computed four blocks at a time, with each SIMD lane holding
+    the same state word of a different block.
+    */
+#if defined(__x86_64__) || defined(_M_X64)
+    using _chacha_lanes = __m128i;
+    inline _chacha_lanes _chacha_set1(uint32_t v) noexcept { return _mm_set1_epi32((int) v); }
+    inline _chacha_lanes _chacha_lane_index() noexcept { return _mm_set_epi32(3, 2, 1, 0); }
+    inline _chacha_lanes _chacha_add(_chacha_lanes a, _chacha_lanes b) noexcept { return _mm_add_epi32(a, b); }
+    inline _chacha_lanes _chacha_xor(_chacha_lanes a, _chacha_lanes b) noexcept { return _mm_xor_si128(a, b); }
+    template <int N> inline _chacha_lanes _chacha_rotl(_chacha_lanes a) noexcept { return _mm_or_si128(_mm_slli_epi32(a, N), _mm_srli_epi32(a, 32 - N)); }
+    inline void _chacha_store(uint32_t *out, _chacha_lanes a) noexcept { _mm_storeu_si128(reinterpret_cast<__m128i *>(out), a); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    using _chacha_lanes = uint32x4_t;
+    inline _chacha_lanes _chacha_set1(uint32_t v) noexcept { return vdupq_n_u32(v); }
+    inline _chacha_lanes _chacha_lane_index() noexcept
+    {
+      static const uint32_t idx[4] = {0, 1, 2, 3};
+      return vld1q_u32(idx);
+    }
+    inline _chacha_lanes _chacha_add(_chacha_lanes a, _chacha_lanes b) noexcept { return vaddq_u32(a, b); }
+    inline _chacha_lanes _chacha_xor(_chacha_lanes a, _chacha_lanes b) noexcept { return veorq_u32(a, b); }
+    template <int N> inline _chacha_lanes _chacha_rotl(_chacha_lanes a) noexcept { return vsriq_n_u32(vshlq_n_u32(a, N), a, 32 - N); }
+    inline void _chacha_store(uint32_t *out, _chacha_lanes a) noexcept { vst1q_u32(out, a); }
+#else
+    struct _chacha_lanes
+    {
+      uint32_t v[4];
+    };
+    inline _chacha_lanes _chacha_set1(uint32_t v) noexcept { return {{v, v, v, v}}; }
+    inline _chacha_lanes _chacha_lane_index() noexcept { return {{0, 1, 2, 3}}; }
+    inline _chacha_lanes _chacha_add(_chacha_lanes a, _chacha_lanes b) noexcept
+    {
+      for(int n = 0; n < 4; n++)
+      {
+        a.v[n] += b.v[n];
+      }
+      return a;
+    }
+    inline _chacha_lanes _chacha_xor(_chacha_lanes a, _chacha_lanes b) noexcept
+    {
+      for(int n = 0; n < 4; n++)
+      {
+        a.v[n] ^= b.v[n];
+      }
+      return a;
+    }
+    template <int N> inline _chacha_lanes _chacha_rotl(_chacha_lanes a) noexcept
+    {
+      for(int n = 0; n < 4; n++)
+      {
+        a.v[n] = (a.v[n] << N) | (a.v[n] >> (32 - N));
+      }
+      return a;
+    }
+    inline void _chacha_store(uint32_t *out, _chacha_lanes a) noexcept { memcpy(out, a.v, sizeof(a.v)); }
+#endif
+    inline void _chacha_quarter_round(_chacha_lanes &a, _chacha_lanes &b, _chacha_lanes &c, _chacha_lanes &d) noexcept
+    {
+      a = _chacha_add(a, b);
+      d = _chacha_rotl<16>(_chacha_xor(d, a));
+      c = _chacha_add(c, d);
+      b = _chacha_rotl<12>(_chacha_xor(b, c));
+      a = _chacha_add(a, b);
+      d = _chacha_rotl<8>(_chacha_xor(d, a));
+      c = _chacha_add(c, d);
+      b = _chacha_rotl<7>(_chacha_xor(b, c));
+    }
+    // Writes the four ChaCha20 blocks of the key with block counters 0 to 3, and a zero nonce
+    inline void _chacha20_four_blocks(byte *out, const uint32_t *key) noexcept
+    {
+      static constexpr uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+      _chacha_lanes in[16], x[16];
+      for(int n = 0; n < 4; n++)
+      {
+        in[n] = _chacha_set1(sigma[n]);
+      }
+      for(int n = 0; n < 8; n++)
+      {
+        in[4 + n] = _chacha_set1(key[n]);
+      }
+      in[12] = _chacha_lane_index();
+      in[13] = in[14] = in[15] = _chacha_set1(0);
+      for(int n = 0; n < 16; n++)
+      {
+        x[n] = in[n];
+      }
+      for(int round = 0; round < 10; round++)
+      {
+        _chacha_quarter_round(x[0], x[4], x[8], x[12]);
+        _chacha_quarter_round(x[1], x[5], x[9], x[13]);
+        _chacha_quarter_round(x[2], x[6], x[10], x[14]);
+        _chacha_quarter_round(x[3], x[7], x[11], x[15]);
+        _chacha_quarter_round(x[0], x[5], x[10], x[15]);
+        _chacha_quarter_round(x[1], x[6], x[11], x[12]);
+        _chacha_quarter_round(x[2], x[7], x[8], x[13]);
+        _chacha_quarter_round(x[3], x[4], x[9], x[14]);
+      }
+      uint32_t words[16][4];
+      for(int n = 0; n < 16; n++)
+      {
+        _chacha_store(words[n], _chacha_add(x[n], in[n]));
+      }
+      for(int block = 0; block < 4; block++)
+      {
+        for(int n = 0; n < 16; n++)
+        {
+          const uint32_t v = words[n][block];
+          byte *o = out + block * 64 + n * 4;
+          o[0] = to_byte((unsigned char) v);
+          o[1] = to_byte((unsigned char) (v >> 8));
+          o[2] = to_byte((unsigned char) (v >> 16));
+          o[3] = to_byte((unsigned char) (v >> 24));
+        }
+      }
+    }
+
+    // Each thread's keystream. The first 32 bytes of each 256 generated become the next key.
+    struct random_fill_state
+    {
+      uint32_t key[8];
+      byte buffer[256];
+      size_t offset{sizeof(buffer)};
+      unsigned fork_generation{(unsigned) -1};
+
+      random_fill_state() = default;
+      random_fill_state(const random_fill_state &) = delete;
+      random_fill_state &operator=(const random_fill_state &) = delete;
+      ~random_fill_state()
+      {
+        volatile byte *p = buffer;
+        for(size_t n = 0; n < sizeof(buffer); n++)
+        {
+          p[n] = to_byte(0);
+        }
+        volatile uint32_t *k = key;
+        for(size_t n = 0; n < 8; n++)
+        {
+          k[n] = 0;
+        }
+      }
+
+      void refill() noexcept
+      {
+        _chacha20_four_blocks(buffer, key);
+        memcpy(key, buffer, sizeof(key));
+        memset(buffer, 0, sizeof(key));
+        offset = sizeof(key);
+      }
+    };
+    // Incremented in the child by every fork, so the child's generators rekey rather than repeat the parent's output
+    inline std::atomic<unsigned> &random_fill_fork_generation() noexcept
+    {
+      static std::atomic<unsigned> v(0);
+      return v;
+    }
+    inline random_fill_state &this_thread_random_fill_state() noexcept
+    {
+      static thread_local random_fill_state v;
+      return v;
+    }
+
+    LLFIO_HEADERS_ONLY_FUNC_SPEC void to_hex_string(char *out, const char *in, size_t inlen) noexcept
+    {
+      static constexpr char table[] = "0123456789abcdef";
+      const auto *s = reinterpret_cast<const unsigned char *>(in);
+      // Working backwards permits in place conversion
+      size_t n = inlen;
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__ARM_NEON) && defined(__aarch64__))
+      const size_t simd = inlen & ~(size_t) 15;
+#else
+      const size_t simd = 0;
+#endif
+      while(n > simd)
+      {
+        n--;
+        const unsigned char c = s[n];
+        out[n * 2 + 1] = table[c & 0xf];
+        out[n * 2] = table[c >> 4];
+      }
+#if defined(__x86_64__) || defined(_M_X64)
+      const __m128i mask = _mm_set1_epi8(0x0f), nine = _mm_set1_epi8(9), zero = _mm_set1_epi8('0'), gap = _mm_set1_epi8('a' - '0' - 10);
+      auto tohex = [&](__m128i x) { return _mm_add_epi8(_mm_add_epi8(x, zero), _mm_and_si128(_mm_cmpgt_epi8(x, nine), gap)); };
+      while(n > 0)
+      {
+        n -= 16;
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + n));
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask), lo = _mm_and_si128(v, mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n * 2), tohex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n * 2 + 16), tohex(_mm_unpackhi_epi8(hi, lo)));
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      const uint8x16_t lut = vld1q_u8(reinterpret_cast<const uint8_t *>(table));
+      while(n > 0)
+      {
+        n -= 16;
+        const uint8x16_t v = vld1q_u8(s + n);
+        uint8x16x2_t z;
+        z.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(v, 4));
+        z.val[1] = vqtbl1q_u8(lut, vandq_u8(v, vdupq_n_u8(15)));
+        vst2q_u8(reinterpret_cast<uint8_t *>(out + n * 2), z);
+      }
+#endif
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void random_fill(char *buffer, size_t bytes) noexcept
+  {
+    auto &state = detail::this_thread_random_fill_state();
+    const unsigned generation = detail::random_fill_fork_generation().load(std::memory_order_relaxed);
+    if(state.fork_generation != generation)
+    {
+#ifndef _WIN32
+      static const int registered = ::pthread_atfork(nullptr, nullptr, [] { detail::random_fill_fork_generation().fetch_add(1, std::memory_order_relaxed); });
+      (void) registered;
+#endif
+      detail::kernel_random_fill(reinterpret_cast<char *>(state.key), sizeof(state.key));
+      state.offset = sizeof(state.buffer);
+      state.fork_generation = generation;
+    }
+    while(bytes > 0)
+    {
+      if(state.offset == sizeof(state.buffer))
+      {
+        state.refill();
+      }
+      const size_t tocopy = std::min(bytes, sizeof(state.buffer) - state.offset);
+      memcpy(buffer, state.buffer + state.offset, tocopy);
+      // Never hand out the same keystream twice
+      memset(state.buffer + state.offset, 0, tocopy);
+      state.offset += tocopy;
+      buffer += tocopy;
+      bytes -= tocopy;
+    }
+  }
+}  // namespace utils
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,280 @@
+/* An adaptive reader of the whole contents of a file
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../../algorithm/read_whole_file.hpp"
+#include "../../statfs.hpp"
+
+#include <cctype>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace algorithm
+{
+  namespace detail
+  {
+    inline bool is_network_filesystem(const file_handle &fh) noexcept
+    {
+      statfs_t sfs;
+#ifdef _WIN32
+      if(!sfs.fill(fh, statfs_t::want::mntfromname))
+      {
+        return false;
+      }
+      // UNC paths are upon the multiple UNC provider
+      return sfs.f_mntfromname.find("\\Device\\Mup") != std::string::npos;
+#else
+      if(!sfs.fill(fh, statfs_t::want::fstypename))
+      {
+        return false;
+      }
+      std::string name(sfs.f_fstypename);
+      for(auto &c : name)
+      {
+        c = (char) tolower((unsigned char) c);
+      }
+      static constexpr const char *network_filesystems[] = {"9p",    "afs",        "ceph",   "cifs",  "davfs",          "fuse.sshfs", "glusterfs",
+                                                            "gpfs",  "lustre",     "ncpfs",  "nfs",   "nfs4",           "smb",        "smb2",
+                                                            "smb3",  "smbfs",      "webdav", "fuse.glusterfs"};
+      for(const char *i : network_filesystems)
+      {
+        if(name == i)
+        {
+          return true;
+        }
+      }
+      return false;
+#endif
+    }
+
+    // Keeps many reads of chunks of the file in flight into the buffer
+    inline result<size_t> read_whole_file_chunked(file_handle &fh, byte *buffer, size_t length, size_t chunk_size, size_t chunks_in_flight, deadline d) noexcept
+    {
+      using extent_type = file_handle::extent_type;
+      io_multiplexer *multiplexer = fh.multiplexer();
+      struct slot_type
+      {
+        file_handle::buffer_type rb;
+        extent_type offset{0};
+        io_multiplexer::pooled_io_operation_state_ptr op;
+      };
+      std::vector<slot_type> slots;
+      try
+      {
+        slots.resize(chunks_in_flight);
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+      // Any i/o still in flight upon failure must be cancelled, and complete, before the buffer is freed
+      auto abort = make_scope_exit([&]() noexcept {
+        for(auto &slot : slots)
+        {
+          if(slot.op && !is_finished(multiplexer->check_io_operation(slot.op.get())))
+          {
+            (void) multiplexer->cancel_io_operation(slot.op.get());
+          }
+        }
+        for(auto &slot : slots)
+        {
+          if(slot.op)
+          {
+            while(!is_finished(multiplexer->check_io_operation(slot.op.get())))
+            {
+              (void) multiplexer->check_for_any_completed_io({});
+            }
+            slot.op.reset();
+          }
+        }
+      });
+      size_t next = 0, eof = length;
+      size_t in_flight = 0;
+      LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+      for(;;)
+      {
+        bool initiated = false;
+        for(auto &slot : slots)
+        {
+          if(!slot.op && next < eof)
+          {
+            slot.offset = next;
+            slot.rb = {buffer + next, (std::min)(chunk_size, eof - next)};
+            next += slot.rb.size();
+            file_handle::io_request<file_handle::buffers_type> req({&slot.rb, 1}, slot.offset);
+            OUTCOME_TRY(auto &&op, multiplexer->construct_and_init_pooled(&fh, nullptr, {}, {}, req));
+            slot.op = std::move(op);
+            in_flight++;
+            initiated = true;
+          }
+        }
+        if(initiated)
+        {
+          OUTCOME_TRY(multiplexer->flush_inited_io_operations());
+        }
+        if(in_flight == 0)
+        {
+          break;
+        }
+        auto reap_finished = [&]() -> result<size_t> {
+          size_t count = 0;
+          for(auto &slot : slots)
+          {
+            if(slot.op && is_finished(multiplexer->check_io_operation(slot.op.get())))
+            {
+              auto r = std::move(*slot.op).get_completed_read();
+              const size_t requested = slot.rb.size();
+              slot.op.reset();
+              in_flight--;
+              count++;
+              OUTCOME_TRY(auto &&readed, std::move(r));
+              size_t bytes = 0;
+              for(auto &b : readed)
+              {
+                bytes += b.size();
+              }
+              if(bytes < requested)
+              {
+                // The file has shrunk since it was opened
+                eof = (std::min)(eof, (size_t) slot.offset + bytes);
+              }
+            }
+          }
+          return count;
+        };
+        OUTCOME_TRY(auto &&reaped, reap_finished());
+        if(reaped == 0)
+        {
+          deadline nd;
+          LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+          OUTCOME_TRY(multiplexer->check_for_any_completed_io(nd));
+          OUTCOME_TRY(reap_finished());
+        }
+        LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+      }
+      return eof;
+    }
+  }  // namespace detail
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<whole_file_contents> read_whole_file(const path_handle &base, path_view path, const read_whole_file_options &options,
+                                                                           deadline d) noexcept
+  {
+    try
+    {
+      OUTCOME_TRY(auto &&fh, file_handle::file(base, path, file_handle::mode::read, file_handle::creation::open_existing, file_handle::caching::all,
+                                               (options.multiplexer != nullptr) ? file_handle::flag::multiplexable : file_handle::flag::none));
+      LLFIO_LOG_FUNCTION_CALL(&fh);
+      OUTCOME_TRY(auto &&maximum_extent, fh.maximum_extent());
+      if(maximum_extent > (file_handle::extent_type) (size_t) -1)
+      {
+        return errc::value_too_large;
+      }
+      const auto length = (size_t) maximum_extent;
+      const size_t chunk_size = (options.chunk_size != 0) ? options.chunk_size : utils::file_buffer_default_size();
+      const file_handle::extent_type map_threshold = (options.map_threshold != 0) ? options.map_threshold : 4 * utils::file_buffer_default_size();
+
+      auto method = options.method;
+      if(method == read_whole_file_method::automatic)
+      {
+        method = read_whole_file_method::read;
+        if(length > chunk_size)
+        {
+          const bool high_latency = (options.read_latency >= 250000) || detail::is_network_filesystem(fh);
+          if(high_latency)
+          {
+            if(options.multiplexer != nullptr)
+            {
+              method = read_whole_file_method::chunked;
+            }
+          }
+          else if(length >= map_threshold)
+          {
+            method = read_whole_file_method::map;
+          }
+        }
+      }
+      if(method == read_whole_file_method::chunked && (options.multiplexer == nullptr || options.chunks_in_flight == 0))
+      {
+        return errc::invalid_argument;
+      }
+
+      whole_file_contents ret;
+      if(length == 0)
+      {
+        ret._method = method;
+        return {std::move(ret)};
+      }
+      if(method == read_whole_file_method::map)
+      {
+        mapped_file_handle mh(std::move(fh), 0, section_handle::flag::none);
+        if(mh.address() != nullptr)
+        {
+          ret._method = method;
+          ret._bytes = {mh.address(), (std::min)(length, (size_t) mh.map().length())};
+          ret._mh = std::move(mh);
+          return {std::move(ret)};
+        }
+        // Probably address space exhaustion, so read it instead
+        OUTCOME_TRY(auto &&reopened, mh.file_handle::reopen());
+        fh = std::move(reopened);
+        method = read_whole_file_method::read;
+      }
+      ret._buffer = utils::pooled_page_allocator<byte>().allocate(length);
+      ret._buffer_size = length;
+      ret._method = method;
+      if(method == read_whole_file_method::chunked)
+      {
+        OUTCOME_TRY(fh.set_multiplexer(options.multiplexer));
+        OUTCOME_TRY(auto &&bytes, detail::read_whole_file_chunked(fh, ret._buffer, length, chunk_size, options.chunks_in_flight, d));
+        ret._bytes = {ret._buffer, bytes};
+        return {std::move(ret)};
+      }
+      size_t bytes = 0;
+      while(bytes < length)
+      {
+        file_handle::buffer_type b(ret._buffer + bytes, length - bytes);
+        OUTCOME_TRY(auto &&readed, fh.read({{&b, 1}, bytes}, d));
+        size_t thisread = 0;
+        for(auto &i : readed)
+        {
+          thisread += i.size();
+        }
+        if(thisread == 0)
+        {
+          break;  // the file has shrunk since it was opened
+        }
+        bytes += thisread;
+      }
+      ret._bytes = {ret._buffer, bytes};
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+}  // namespace algorithm
+
+LLFIO_V2_NAMESPACE_END
@@ -23,6 +23,7 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../../algorithm/reduce.hpp"
+#include "../../io_multiplexer.hpp"
 
 #ifdef _WIN32
 #include "windows/import.hpp"
@@ -265,15 +266,38 @@ namespace algorithm
       return success();
 #endif
     }
+    // Renames the directory to a uniquely named directory, so concurrent users no longer see it
+    inline void hide(directory_handle &topdirh) noexcept
+    {
+      auto dirhparent = topdirh.parent_path_handle();
+      if(dirhparent)
+      {
+        for(;;)
+        {
+          auto randomname = utils::random_string(32);
+          auto ret = topdirh.relink(dirhparent.value(), randomname);
+          if(ret)
+          {
+            break;
+          }
+          if(!ret && ret.error() != errc::file_exists)
+          {
+            break;
+          }
+        }
+      }
+    }
     struct reduction_state
     {
       const directory_handle &topdirh;
       reduce_visitor *visitor{nullptr};
+      io_multiplexer *multiplexer{nullptr};
       std::atomic<size_t> items_removed{0}, directory_open_failed{0}, failed_to_remove{0}, failed_to_rename{0};
 
-      reduction_state(const directory_handle &_topdirh, reduce_visitor *_visitor)
+      reduction_state(const directory_handle &_topdirh, reduce_visitor *_visitor, io_multiplexer *_multiplexer)
           : topdirh(_topdirh)
           , visitor(_visitor)
+          , multiplexer(_multiplexer)
       {
       }
     };
@@ -299,46 +323,104 @@ namespace algorithm
   {
     auto *state = (detail::reduction_state *) data;
     bool removed_everything = true;
-    for(auto &entry : contents)
-    {
-      switch(entry.stat.st_type)
+    auto directory_removed = [&](directory_entry &entry, bool removed) {
+      if(removed)
       {
-      case filesystem::file_type::directory:
+        state->items_removed.fetch_add(1, std::memory_order_relaxed);
+        entry.stat = stat_t(nullptr);  // prevent traversal
+      }
+      else
       {
-        log_level_guard g(log_level::fatal);
-        auto r = detail::remove(dirh, entry.leafname, true);
-        if(r)
+        state->failed_to_remove.fetch_add(1, std::memory_order_relaxed);
+        removed_everything = false;
+      }
+    };
+    auto file_removed = [&](directory_entry &entry, result<void> &&r) -> result<void> {
+      if(!r)
+      {
+        OUTCOME_TRY(auto &&success, state->visitor->unlink_failed(data, std::move(r).error(), dirh, entry, depth));
+        if(success)
         {
           state->items_removed.fetch_add(1, std::memory_order_relaxed);
-          entry.stat = stat_t(nullptr);  // prevent traversal
         }
         else
         {
           state->failed_to_remove.fetch_add(1, std::memory_order_relaxed);
           removed_everything = false;
         }
-        break;
       }
-      default:
+      else
       {
-        auto r = detail::remove(dirh, entry.leafname, false);
-        if(!r)
+        state->items_removed.fetch_add(1, std::memory_order_relaxed);
+      }
+      return success();
+    };
+#ifndef _WIN32
+    if(state->multiplexer != nullptr && contents.size() > 1)
+    {
+      try
+      {
+        // Unlink everything in this directory as a single batch
+        using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+        std::vector<posix_fs_syscall> ops(contents.size());
+        // Any zero terminated copies of leafnames come from this thread's arena, not the heap
+        path_view_arena::scope arenascope(path_view_arena::this_thread());
+        std::vector<path_view::c_str<char, std::default_delete<char[]>, 0>> zpaths;
+        zpaths.reserve(contents.size());
+        for(size_t n = 0; n < contents.size(); n++)
+        {
+          zpaths.emplace_back(contents[n].leafname, path_view::zero_terminated, arenascope.arena());
+          ops[n].op = posix_fs_syscall::kind::unlinkat;
+          ops[n].fd = dirh.native_handle().fd;
+          ops[n].path = zpaths[n].buffer;
+          ops[n].flags = (contents[n].stat.st_type == filesystem::file_type::directory) ? AT_REMOVEDIR : 0;
+        }
+        OUTCOME_TRY(state->multiplexer->do_posix_fs_syscalls(ops));
+        for(size_t n = 0; n < contents.size(); n++)
         {
-          OUTCOME_TRY(auto &&success, state->visitor->unlink_failed(data, std::move(r).error(), dirh, entry, depth));
-          if(success)
+          auto &entry = contents[n];
+          const int res = ops[n].result;
+          // Somebody else removing it is success
+          const bool removed = (res >= 0 || res == -ENOENT);
+          if(entry.stat.st_type == filesystem::file_type::directory)
+          {
+            directory_removed(entry, removed);
+          }
+          else if(removed)
           {
-            state->items_removed.fetch_add(1, std::memory_order_relaxed);
+            OUTCOME_TRY(file_removed(entry, success()));
+          }
+          else if(res == -EISDIR || res == -EPERM)
+          {
+            // Not actually a file, so take the slow path
+            OUTCOME_TRY(file_removed(entry, detail::remove(dirh, entry.leafname, false)));
           }
           else
           {
-            state->failed_to_remove.fetch_add(1, std::memory_order_relaxed);
-            removed_everything = false;
+            OUTCOME_TRY(file_removed(entry, posix_error(-res)));
           }
         }
-        else
-        {
-          state->items_removed.fetch_add(1, std::memory_order_relaxed);
-        }
+        return success();
+      }
+      catch(...)
+      {
+        return error_from_exception();
+      }
+    }
+#endif
+    for(auto &entry : contents)
+    {
+      switch(entry.stat.st_type)
+      {
+      case filesystem::file_type::directory:
+      {
+        log_level_guard g(log_level::fatal);
+        directory_removed(entry, !!detail::remove(dirh, entry.leafname, true));
+        break;
+      }
+      default:
+      {
+        OUTCOME_TRY(file_removed(entry, detail::remove(dirh, entry.leafname, false)));
         break;
       }
       }
@@ -369,7 +451,8 @@ namespace algorithm
     return false;
   }
 
-  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> reduce(directory_handle &&topdirh, reduce_visitor *visitor, size_t threads, bool force_slow_path) noexcept
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> reduce(directory_handle &&topdirh, reduce_visitor *visitor, size_t threads, bool force_slow_path,
+                                                         io_multiplexer *multiplexer) noexcept
   {
     LLFIO_LOG_FUNCTION_CALL(&topdirh);
     reduce_visitor default_visitor;
@@ -377,28 +460,10 @@ namespace algorithm
     {
       visitor = &default_visitor;
     }
-    {
-      auto dirhparent = topdirh.parent_path_handle();
-      if(dirhparent)
-      {
-        for(;;)
-        {
-          auto randomname = utils::random_string(32);
-          auto ret = topdirh.relink(dirhparent.value(), randomname);
-          if(ret)
-          {
-            break;
-          }
-          if(!ret && ret.error() != errc::file_exists)
-          {
-            break;
-          }
-        }
-      }
-    }
+    detail::hide(topdirh);
     size_t round = 0;
-    detail::reduction_state state(topdirh, visitor);
-    OUTCOME_TRY(traverse(topdirh, visitor, threads, &state, force_slow_path));
+    detail::reduction_state state(topdirh, visitor, multiplexer);
+    OUTCOME_TRY(traverse(topdirh, visitor, threads, &state, force_slow_path, false, multiplexer));
     auto not_removed = state.directory_open_failed.load(std::memory_order_relaxed) + state.failed_to_remove.load(std::memory_order_relaxed) +
                        state.failed_to_rename.load(std::memory_order_relaxed);
     OUTCOME_TRY(visitor->reduction_round(&state, round++, state.items_removed.load(std::memory_order_relaxed), not_removed));
@@ -407,7 +472,7 @@ namespace algorithm
       state.directory_open_failed.store(0, std::memory_order_relaxed);
       state.failed_to_remove.store(0, std::memory_order_relaxed);
       state.failed_to_rename.store(0, std::memory_order_relaxed);
-      OUTCOME_TRY(traverse(topdirh, visitor, (round > 16) ? 1 : threads, &state, force_slow_path));
+      OUTCOME_TRY(traverse(topdirh, visitor, (round > 16) ? 1 : threads, &state, force_slow_path, false, multiplexer));
       not_removed = state.directory_open_failed.load(std::memory_order_relaxed) + state.failed_to_remove.load(std::memory_order_relaxed) +
                     state.failed_to_rename.load(std::memory_order_relaxed);
       OUTCOME_TRY(visitor->reduction_round(&state, round++, state.items_removed.load(std::memory_order_relaxed), not_removed));
@@ -420,6 +485,23 @@ namespace algorithm
     return state.items_removed;
   }
 
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::future<result<size_t>>> reduce_deferred(directory_handle &&topdirh, reduce_visitor *visitor, size_t threads,
+                                                                                      bool force_slow_path, io_multiplexer *multiplexer) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&topdirh);
+    try
+    {
+      detail::hide(topdirh);
+      return std::async(std::launch::async, [dirh = std::move(topdirh), visitor, threads, force_slow_path, multiplexer]() mutable -> result<size_t> {
+        return reduce(std::move(dirh), visitor, threads, force_slow_path, multiplexer);
+      });
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
@@ -34,6 +34,9 @@ Distributed under the Boost Software License, Version 1.0.
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <unordered_map>
@@ -72,6 +75,8 @@ namespace algorithm
           std::vector<unsigned> reader_tids;  // thread ids of all shared lock holders
           unsigned writer_tid;                // thread id of exclusive lock holder
           file_handle::extent_guard filelock;   // exclusive if writer_tid, else shared
+          bool draining{false};               // reader bias revoked, so freed once the visible readers leave
+          unsigned pending_writer_tid{0};     // thread id of a thread waiting for the readers to leave
           _entity_info(bool exclusive, unsigned tid, file_handle::extent_guard _filelock)
               : writer_tid(exclusive ? tid : 0)
               , filelock(std::move(_filelock))
@@ -84,9 +89,120 @@ namespace algorithm
           }
         };
         std::unordered_map<entity_type::value_type, _entity_info> _thread_locks;  // entity to thread lock
+
+        /* BRAVO style reader bias. Whilst an entity held shared is biased, further shared lockers
+        publish themselves in a visible readers slot chosen by hashing their thread id with the entity,
+        without taking _m, and check the bias still holds afterwards. Exclusive lockers and the final
+        slow path unlocker revoke the bias, after which the entity cannot be freed until its visible
+        readers have left.
+        */
+        static constexpr size_t _visible_readers_count = 1024, _biased_count = 64;
+        // How long after a revocation for an exclusive lock an entity may not be biased again
+        static constexpr std::chrono::milliseconds _bias_inhibit{1};
+        struct _visible_reader
+        {
+          std::atomic<uint64_t> entity{0};  // entity value plus one, zero if free
+          std::atomic<unsigned> tid{0};
+        };
+        struct _bias_slot
+        {
+          std::atomic<uint64_t> entity{0};  // entity value plus one, zero if none biased
+        };
+        std::array<_visible_reader, _visible_readers_count> _visible_readers;
+        std::array<_bias_slot, _biased_count> _biased;
+        std::chrono::steady_clock::time_point _inhibit_until;  // _m must be held
+
+        _visible_reader &_reader_slot(unsigned tid, entity_type::value_type entity) noexcept
+        {
+          uint64_t h = (static_cast<uint64_t>(tid) * 0x9E3779B97F4A7C15ULL) ^ (static_cast<uint64_t>(entity) * 0xC2B2AE3D27D4EB4FULL);
+          h ^= h >> 29U;
+          return _visible_readers[static_cast<size_t>(h % _visible_readers_count)];
+        }
+        _bias_slot &_bias_slot_for(entity_type::value_type entity) noexcept { return _biased[static_cast<size_t>((static_cast<uint64_t>(entity) * 0x9E3779B97F4A7C15ULL) >> 58U)]; }
+        bool _is_biased(entity_type::value_type entity) noexcept { return _bias_slot_for(entity).entity.load(std::memory_order_seq_cst) == static_cast<uint64_t>(entity) + 1; }
+        bool _owns_visible_reader(unsigned tid, entity_type::value_type entity) noexcept
+        {
+          auto &r = _reader_slot(tid, entity);
+          return r.tid.load(std::memory_order_acquire) == tid && r.entity.load(std::memory_order_acquire) == static_cast<uint64_t>(entity) + 1;
+        }
+        static void _release_visible_reader(_visible_reader &r) noexcept
+        {
+          r.tid.store(0, std::memory_order_release);
+          r.entity.store(0, std::memory_order_seq_cst);
+        }
+        // Shared locks an entity without taking _m if it is biased
+        bool _try_visible_reader_lock(unsigned tid, entity_type::value_type entity) noexcept
+        {
+          if(!_is_biased(entity))
+          {
+            return false;
+          }
+          auto &r = _reader_slot(tid, entity);
+          uint64_t expected = 0;
+          if(!r.entity.compare_exchange_strong(expected, static_cast<uint64_t>(entity) + 1, std::memory_order_seq_cst))
+          {
+            return false;
+          }
+          r.tid.store(tid, std::memory_order_release);
+          if(_is_biased(entity))
+          {
+            return true;
+          }
+          // Lost a race with revocation
+          _release_visible_reader(r);
+          return false;
+        }
+        bool _has_visible_readers(entity_type::value_type entity) noexcept
+        {
+          for(auto &r : _visible_readers)
+          {
+            if(r.entity.load(std::memory_order_seq_cst) == static_cast<uint64_t>(entity) + 1)
+            {
+              return true;
+            }
+          }
+          return false;
+        }
+        // _m mutex must be held on entry!
+        void _try_bias(entity_type::value_type entity, const _entity_info &info) noexcept
+        {
+          if(info.writer_tid == 0 && info.pending_writer_tid == 0 && !info.draining && std::chrono::steady_clock::now() >= _inhibit_until)
+          {
+            uint64_t expected = 0;
+            _bias_slot_for(entity).entity.compare_exchange_strong(expected, static_cast<uint64_t>(entity) + 1, std::memory_order_seq_cst);
+          }
+        }
+        // _m mutex must be held on entry!
+        void _revoke_bias(entity_type::value_type entity, _entity_info &info) noexcept
+        {
+          uint64_t expected = static_cast<uint64_t>(entity) + 1;
+          _bias_slot_for(entity).entity.compare_exchange_strong(expected, 0, std::memory_order_seq_cst);
+          info.draining = true;
+        }
+        // _m mutex must be held on entry! Frees a draining entity once its last visible reader has left
+        void _reap(entity_type::value_type entity)
+        {
+          auto it = _thread_locks.find(entity);
+          if(it == _thread_locks.end() || !it->second.draining)
+          {
+            return;
+          }
+          if(it->second.writer_tid == 0 && it->second.reader_tids.empty() && !_has_visible_readers(entity))
+          {
+            _h.unlock_file_range(entity, 1);
+            _thread_locks.erase(it);
+          }
+          _changed.notify_all();
+        }
         // _m mutex must be held on entry!
         void _unlock(unsigned mythreadid, entity_type entity)
         {
+          if(entity.exclusive == 0u && _owns_visible_reader(mythreadid, entity.value))
+          {
+            _release_visible_reader(_reader_slot(mythreadid, entity.value));
+            _reap(entity.value);
+            return;
+          }
           auto it = _thread_locks.find(entity.value);  // NOLINT
           assert(it != _thread_locks.end());
           assert(it->second.writer_tid == mythreadid || it->second.writer_tid == 0);
@@ -119,6 +235,12 @@ namespace algorithm
           }
           if(it->second.reader_tids.empty())
           {
+            _revoke_bias(entity.value, it->second);
+            if(_has_visible_readers(entity.value))
+            {
+              // The last visible reader to leave frees it
+              return;
+            }
             // Release the lock and delete this entity from the map
             _h.unlock_file_range(entity.value, 1);
             _thread_locks.erase(it);
@@ -141,7 +263,7 @@ namespace algorithm
           {
             if((d).steady)
             {
-              began_steady = std::chrono::steady_clock::now();
+              began_steady = LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs);
             }
             else
             {
@@ -151,6 +273,30 @@ namespace algorithm
           // Fire this if an error occurs
           auto disableunlock = make_scope_exit([&]() noexcept { out.release(); });
           size_t n;
+          if(std::all_of(out.entities.begin(), out.entities.end(), [](const entity_type &e) { return e.exclusive == 0u; }))
+          {
+            // Shared locks of biased entities need not take _m
+            for(n = 0; n < out.entities.size() && _try_visible_reader_lock(mythreadid, out.entities[n].value); n++)
+            {
+            }
+            if(n == out.entities.size())
+            {
+              disableunlock.release();
+              return success();
+            }
+            if(n > 0)
+            {
+              for(size_t m = 0; m < n; m++)
+              {
+                _release_visible_reader(_reader_slot(mythreadid, out.entities[m].value));
+              }
+              std::lock_guard<decltype(_m)> guard(_m);
+              for(size_t m = 0; m < n; m++)
+              {
+                _reap(out.entities[m].value);
+              }
+            }
+          }
           for(;;)
           {
             auto was_contended = static_cast<size_t>(-1);
@@ -189,7 +335,7 @@ namespace algorithm
                     {
                       if((d).steady)
                       {
-                        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());
+                        std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs));
                         if(ns.count() < 0)
                         {
                           (nd).nsecs = 0;
@@ -220,6 +366,7 @@ namespace algorithm
                   if(it == _thread_locks.end())
                   {
                     it = _thread_locks.insert(std::make_pair(static_cast<entity_type::value_type>(out.entities[n].value), _entity_info(out.entities[n].exclusive != 0u, mythreadid, std::move(outcome).value()))).first;
+                    _try_bias(out.entities[n].value, it->second);
                     continue;
                   }
                   // Otherwise throw away the presumably shared superfluous byte range lock
@@ -228,7 +375,7 @@ namespace algorithm
 
                 // If we are here, then this entity has been locked by someone before
                 auto reader_tid_it = std::find(it->second.reader_tids.begin(), it->second.reader_tids.end(), mythreadid);
-                bool already_have_shared_lock = (reader_tid_it != it->second.reader_tids.end());
+                bool already_have_shared_lock = (reader_tid_it != it->second.reader_tids.end()) || _owns_visible_reader(mythreadid, out.entities[n].value);
                 // Is somebody already locking this entity exclusively?
                 if(it->second.writer_tid != 0)
                 {
@@ -257,12 +404,43 @@ namespace algorithm
                   {
                     return errc::resource_deadlock_would_occur;
                   }
+                  if(it->second.pending_writer_tid != 0 && it->second.pending_writer_tid != mythreadid)
+                  {
+                    // Don't starve a thread waiting for the readers to leave
+                    was_contended = n;
+                    pls_sleep = true;
+                    goto failed;
+                  }
                   // Otherwise just add myself to the reader list
                   it->second.reader_tids.push_back(mythreadid);
+                  _try_bias(out.entities[n].value, it->second);
                   continue;
                 }
                 // We are thus now upgrading shared to exclusive
                 assert(out.entities[n].exclusive);
+                if(it->second.pending_writer_tid != 0 && it->second.pending_writer_tid != mythreadid && already_have_shared_lock &&
+                   std::find(it->second.reader_tids.begin(), it->second.reader_tids.end(), it->second.pending_writer_tid) != it->second.reader_tids.end())
+                {
+                  // Another reader is already waiting for me to leave so it can upgrade
+                  return errc::resource_deadlock_would_occur;
+                }
+                it->second.pending_writer_tid = mythreadid;
+                if(_owns_visible_reader(mythreadid, out.entities[n].value))
+                {
+                  // Turn my own visible reader into an ordinary one, as it does not exclude me
+                  _release_visible_reader(_reader_slot(mythreadid, out.entities[n].value));
+                  it->second.reader_tids.push_back(mythreadid);
+                }
+                _revoke_bias(out.entities[n].value, it->second);
+                _inhibit_until = std::chrono::steady_clock::now() + _bias_inhibit;
+                if(_has_visible_readers(out.entities[n].value) ||
+                   std::any_of(it->second.reader_tids.begin(), it->second.reader_tids.end(), [&](unsigned tid) { return tid != mythreadid; }))
+                {
+                  // Wait for the other readers to leave
+                  was_contended = n;
+                  pls_sleep = true;
+                  goto failed;
+                }
                 deadline nd;
                 // Only for very first entity will we sleep until its lock becomes available
                 if(n != 0u)
@@ -276,7 +454,7 @@ namespace algorithm
                   {
                     if((d).steady)
                     {
-                      std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());
+                      std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs));
                       if(ns.count() < 0)
                       {
                         (nd).nsecs = 0;
@@ -308,6 +486,8 @@ namespace algorithm
 #endif
                 it->second.filelock = std::move(outcome).value();
                 it->second.writer_tid = mythreadid;
+                it->second.draining = false;
+                it->second.pending_writer_tid = 0;
               }
               // Dismiss unwind of thread locking and return success
               undo.release();
@@ -319,7 +499,7 @@ namespace algorithm
             {
               if((d).steady)
               {
-                if(std::chrono::steady_clock::now() >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
+                if(LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs) >= (began_steady + std::chrono::nanoseconds((d).nsecs)))
                 {
                   return errc::timed_out;
                 }
@@ -332,6 +512,8 @@ namespace algorithm
                 }
               }
             }
+            _record_retry(out);
+            _record_randomisation(out);
             // Move was_contended to front and randomise rest of out.entities
             std::swap(out.entities[was_contended], out.entities[0]);
             auto front = out.entities.begin();
@@ -339,10 +521,11 @@ namespace algorithm
             QUICKCPPLIB_NAMESPACE::algorithm::small_prng::random_shuffle(front, out.entities.end());
             if(pls_sleep && !spin_not_sleep)
             {
+              _record_sleep(out);
               // Sleep until the thread locks next change
               if((d).steady)
               {
-                std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - std::chrono::steady_clock::now());
+                std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>((began_steady + std::chrono::nanoseconds((d).nsecs)) - LLFIO_V2_NAMESPACE::detail::deadline_steady_now(d.nsecs));
                 _changed.wait_for(guard, ns);
               }
               else
@@ -357,11 +540,35 @@ namespace algorithm
         {
           LLFIO_LOG_FUNCTION_CALL(this);
           unsigned mythreadid = QUICKCPPLIB_NAMESPACE::utils::thread::this_thread_id();
+          if(std::all_of(entities.begin(), entities.end(), [&](const entity_type &e) { return e.exclusive == 0u && _owns_visible_reader(mythreadid, e.value); }))
+          {
+            // Visible readers need not take _m, unless their bias was revoked whilst they held it
+            bool revoked = false;
+            for(auto &entity : entities)
+            {
+              _release_visible_reader(_reader_slot(mythreadid, entity.value));
+              if(!_is_biased(entity.value))
+              {
+                revoked = true;
+              }
+            }
+            if(revoked)
+            {
+              std::unique_lock<decltype(_m)> guard(_m);
+              for(auto &entity : entities)
+              {
+                _reap(entity.value);
+              }
+            }
+            return;
+          }
           std::unique_lock<decltype(_m)> guard(_m);
           for(auto &entity : entities)
           {
             _unlock(mythreadid, entity);
           }
+          // Wake any thread waiting for readers to leave
+          _changed.notify_all();
         }
       };
       struct threaded_byte_ranges_list
@@ -30,7 +30,10 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "quickcpplib/algorithm/small_prng.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <future>
+#include <sstream>
 #include <vector>
 #ifndef NDEBUG
 #include <fstream>
@@ -76,6 +79,65 @@ namespace storage_profile
   min_atomic_write: 1
   max_atomic_write: 1
   */
+  namespace detail
+  {
+    inline void parse_item_value(std::string &out, const std::string &in) { out = in; }
+    inline void parse_item_value(unsigned &out, const std::string &in) { out = static_cast<unsigned>(std::stoul(in)); }
+    inline void parse_item_value(unsigned long long &out, const std::string &in) { out = std::stoull(in); }
+    inline void parse_item_value(float &out, const std::string &in) { out = std::stof(in); }
+  }  // namespace detail
+
+  void storage_profile::read(std::istream &in, std::regex which)
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    // The inverse of write(), sections are indented four spaces more than their parent
+    std::vector<std::string> sections;
+    for(std::string line; std::getline(in, line);)
+    {
+      const size_t indent = line.find_first_not_of(' ');
+      if(indent == std::string::npos || line[indent] == '#' || line.compare(indent, 3, "---") == 0)
+      {
+        continue;
+      }
+      const size_t colon = line.find(':', indent);
+      if(colon == std::string::npos || indent / 4 > sections.size())
+      {
+        continue;
+      }
+      sections.resize(indent / 4);
+      std::string key(line, indent, colon - indent);
+      if(colon + 1 == line.size())
+      {
+        sections.push_back(std::move(key));
+        continue;
+      }
+      if(line[colon + 1] != ' ')
+      {
+        continue;
+      }
+      std::string name;
+      for(auto &section : sections)
+      {
+        name.append(section);
+        name.push_back(':');
+      }
+      name.append(key);
+      if(!std::regex_match(name, which))
+      {
+        continue;
+      }
+      const std::string value(line, colon + 2);
+      for(item_erased &i : *this)
+      {
+        if(name == i.name)
+        {
+          i.invoke([&value](auto &item) { detail::parse_item_value(item.value, value); });
+          break;
+        }
+      }
+    }
+  }
+
   void storage_profile::write(std::ostream &out, const std::regex &which, size_t _indent, bool invert_match) const
   {
     LLFIO_LOG_FUNCTION_CALL(this);
@@ -154,6 +216,130 @@ namespace storage_profile
     }
   }
 
+  namespace detail
+  {
+    // The identity of the storage and caching profiled, and the leafname of its saved profile
+    inline std::pair<std::string, std::string> saved_profile_identity(const storage_profile &sp, const file_handle &h)
+    {
+      std::string identity(sp.device_name.value);
+      identity.append("|" + sp.controller_type.value + "|" + std::to_string(sp.device_size.value) + "|" + sp.fs_name.value + "|" +
+                      std::to_string(sp.fs_size.value) + "|" + std::to_string(static_cast<unsigned>(h.kernel_caching())));
+      uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+      for(char c : identity)
+      {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+      }
+      char leafname[64];
+      snprintf(leafname, sizeof(leafname), "llfio_storage_profile_%016llx.yaml", static_cast<unsigned long long>(hash));
+      return {std::move(identity), leafname};
+    }
+  }  // namespace detail
+
+  outcome<bool> storage_profile::load(const path_handle &dirh, handle_type &h) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    try
+    {
+      OUTCOME_TRYV(system::os(*this, h));
+      OUTCOME_TRYV(system::cpu(*this, h));
+      OUTCOME_TRYV(storage::device(*this, h));
+      OUTCOME_TRYV(storage::fs(*this, h));
+      const auto identity = detail::saved_profile_identity(*this, h);
+      auto fh = file_handle::file(dirh, identity.second);
+      if(!fh)
+      {
+        if(fh.error() == errc::no_such_file_or_directory)
+        {
+          return false;
+        }
+        return std::move(fh).error();
+      }
+      OUTCOME_TRY(auto &&length, fh.value().maximum_extent());
+      std::string contents(static_cast<size_t>(length), 0);
+      OUTCOME_TRY(auto &&bytesread, fh.value().read(0, {{reinterpret_cast<byte *>(&contents[0]), contents.size()}}));
+      contents.resize(bytesread);
+      // The first line records the identity in full, so a collision of hashes is not loaded
+      const std::string firstline("# " + identity.first + "\n");
+      if(contents.compare(0, firstline.size(), firstline) != 0)
+      {
+        return false;
+      }
+      // Only the items measured, not those identifying the storage
+      std::istringstream in(contents);
+      read(in, std::regex("(concurrency|latency|response_time):.*"));
+      return true;
+    }
+    catch(...)
+    {
+      return std::current_exception();
+    }
+  }
+
+  outcome<void> storage_profile::save(const path_handle &dirh, const handle_type &h) const noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    try
+    {
+      const auto identity = detail::saved_profile_identity(*this, h);
+      std::ostringstream out;
+      out << "# " << identity.first << "\n";
+      write(out);
+      const auto contents = out.str();
+      // Write a new file and rename it over any old, so concurrent load()s never see a partial profile
+      OUTCOME_TRY(auto &&fh, file_handle::uniquely_named_file(dirh));
+      OUTCOME_TRYV(fh.write(0, {{reinterpret_cast<const byte *>(contents.data()), contents.size()}}));
+      auto relinked = fh.relink(dirh, identity.second);
+      if(!relinked)
+      {
+        (void) fh.unlink();
+        return std::move(relinked).error();
+      }
+      return success();
+    }
+    catch(...)
+    {
+      return std::current_exception();
+    }
+  }
+
+  utils::tuning_hints storage_profile::tuning() const noexcept
+  {
+    utils::tuning_hints ret;
+    // Direct i/o needs the device's minimum i/o size
+    const unsigned min_io = device_min_io_size.value;
+    if(min_io != default_value<unsigned>() && min_io != 0 && (min_io & (min_io - 1)) == 0)
+    {
+      ret.direct_io_alignment = min_io;
+    }
+    // How many of sixteen concurrent reads the storage actually serves in parallel
+    unsigned long long parallelism = 0;
+    if(read_qd1_mean.value != default_value<unsigned long long>() && read_qd16_mean.value != default_value<unsigned long long>() && read_qd16_mean.value != 0)
+    {
+      parallelism = (16 * read_qd1_mean.value + read_qd16_mean.value / 2) / read_qd16_mean.value;
+      parallelism = std::max(1ULL, std::min(16ULL, parallelism));
+      ret.io_queue_depth = 64;
+      while(ret.io_queue_depth < 64 * parallelism)
+      {
+        ret.io_queue_depth <<= 1;
+      }
+    }
+    // A measured saturation point beats the estimate, four times it keeping the device busy across several handles
+    if(read_qd_saturation.value != default_value<unsigned>() && read_qd_saturation.value != 0)
+    {
+      ret.io_queue_depth = 64;
+      while(ret.io_queue_depth < 4ULL * read_qd_saturation.value)
+      {
+        ret.io_queue_depth <<= 1;
+      }
+    }
+    // Traversal is limited by the real CPU count, and by little parallelism of the storage
+    if(cpu_physical_cores.value != default_value<unsigned>() && cpu_physical_cores.value != 0)
+    {
+      ret.traverse_threads = (parallelism != 0 && parallelism <= 2) ? 4 : std::max(4U, cpu_physical_cores.value);
+    }
+    return ret;
+  }
+
   namespace system
   {
     // System memory quantity, in use, max and min bandwidth
@@ -850,13 +1036,102 @@ namespace storage_profile
 #endif
   namespace latency
   {
+    /* A log-linear histogram of latencies in the style of HdrHistogram. Values are bucketed by
+    their highest set bit, and each power of two is divided into 64 linear sub-buckets, so every
+    value is recorded to within 1.6% whilst the whole histogram is 30Kb, no matter how many
+    samples it holds. Unlike keeping every sample and sorting, recording costs nothing noticeable
+    and the tail is as exact as the head.
+    */
+    struct histogram
+    {
+      static constexpr unsigned sub_bucket_bits = 6;
+      static constexpr unsigned long long sub_buckets = 1ULL << sub_bucket_bits;
+      std::vector<unsigned long long> counts = std::vector<unsigned long long>((65 - sub_bucket_bits) * sub_buckets);
+      unsigned long long total{0}, sum{0}, min{static_cast<unsigned long long>(-1)}, max{0};
+
+      static size_t index(unsigned long long v) noexcept
+      {
+        if(v < sub_buckets)
+        {
+          return static_cast<size_t>(v);
+        }
+        unsigned topbit = sub_bucket_bits;
+        while(topbit < 63 && (v >> (topbit + 1)) != 0)
+        {
+          ++topbit;
+        }
+        const unsigned shift = topbit - sub_bucket_bits;
+        return static_cast<size_t>(((shift + 1) << sub_bucket_bits) + ((v >> shift) - sub_buckets));
+      }
+      //! The lowest value recorded into the bucket at `idx`
+      static unsigned long long value(size_t idx) noexcept
+      {
+        const size_t bucket = idx >> sub_bucket_bits;
+        if(bucket == 0)
+        {
+          return idx;
+        }
+        return ((idx & (sub_buckets - 1)) + sub_buckets) << (bucket - 1);
+      }
+      void record(unsigned long long v) noexcept
+      {
+        ++counts[index(v)];
+        ++total;
+        sum += v;
+        min = std::min(min, v);
+        max = std::max(max, v);
+      }
+      void merge(const histogram &o) noexcept
+      {
+        for(size_t n = 0; n < counts.size(); n++)
+        {
+          counts[n] += o.counts[n];
+        }
+        total += o.total;
+        sum += o.sum;
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+      }
+      //! The value which `fraction` of all those recorded do not exceed
+      unsigned long long percentile(double fraction) const noexcept
+      {
+        const auto target = static_cast<unsigned long long>(std::ceil(fraction * total));
+        unsigned long long seen = 0;
+        for(size_t n = 0; n < counts.size(); n++)
+        {
+          seen += counts[n];
+          if(seen >= target && seen > 0)
+          {
+            return std::min(value(n), max);
+          }
+        }
+        return max;
+      }
+      //! Space separated `value:count` of the buckets not empty
+      std::string to_string() const
+      {
+        std::string ret;
+        for(size_t n = 0; n < counts.size(); n++)
+        {
+          if(counts[n] != 0)
+          {
+            if(!ret.empty())
+            {
+              ret.push_back(' ');
+            }
+            ret.append(std::to_string(value(n)) + ":" + std::to_string(counts[n]));
+          }
+        }
+        return ret;
+      }
+    };
     struct stats
     {
-      unsigned long long min{0}, mean{0}, max{0}, _50{0}, _95{0}, _99{0}, _99999{0};
+      unsigned long long min{0}, mean{0}, max{0}, _50{0}, _95{0}, _99{0}, _999{0}, _99999{0};
+      std::string histogram;
     };
     inline outcome<stats> _latency_test(file_handle &srch, size_t noreaders, size_t nowriters, bool ownfiles)
     {
-      static constexpr size_t memory_to_use = 128 * 1024 * 1024;  // 1Gb
       // static const unsigned clock_overhead = system::_clock_granularity_and_overhead().overhead;
       static const unsigned clock_granularity = system::_clock_granularity_and_overhead().granularity;
       try
@@ -882,16 +1157,10 @@ namespace storage_profile
         }
         (void) utils::drop_filesystem_cache();
 
-        std::vector<std::vector<unsigned long long>> results(noreaders + nowriters);
+        std::vector<histogram> results(noreaders + nowriters);
         // The excessive unique_ptr works around a bug in libc++'s thread implementation
         std::vector<std::pair<std::unique_ptr<std::thread>, std::future<void>>> writers, readers;
         std::atomic<size_t> done(noreaders + nowriters);
-        for(auto &i : results)
-        {
-          i.resize(memory_to_use / results.size());
-          memset(i.data(), 0, i.size() * sizeof(unsigned long long));  // prefault
-          i.resize(0);
-        }
         for(size_t no = 0; no < nowriters; no++)
         {
           std::packaged_task<void()> task([no, &done, &workfiles, &results] {
@@ -921,11 +1190,7 @@ namespace storage_profile
               {
                 ns = clock_granularity / 2;
               }
-              results[no].push_back(ns);
-              if(results[no].size() == results[no].capacity())
-              {
-                return;
-              }
+              results[no].record(static_cast<unsigned long long>(ns));
             }
           });
           auto f(task.get_future());
@@ -960,11 +1225,7 @@ namespace storage_profile
               {
                 ns = clock_granularity / 2;
               }
-              results[no].push_back(ns);
-              if(results[no].size() == results[no].capacity())
-              {
-                return;
-              }
+              results[no].record(static_cast<unsigned long long>(ns));
             }
           });
           auto f(task.get_future());
@@ -998,52 +1259,28 @@ namespace storage_profile
           reader.second.get();
         }
 
-#if 0  // ndef NDEBUG
-        {
-          std::ofstream out("latencies.csv");
-          for(const auto &r : results)
-          {
-            for(const auto &i : r)
-            {
-              out << i << "\n";
-            }
-          }
-        }
-#endif
-        std::vector<unsigned long long> totalresults;
-        unsigned long long sum = 0;
-        stats s;
-        s.min = static_cast<unsigned long long>(-1);
+        histogram total;
         for(auto &result : results)
         {
-          for(const auto &i : result)
-          {
-            if(i < s.min)
-            {
-              s.min = i;
-            }
-            if(i > s.max)
-            {
-              s.max = i;
-            }
-            sum += i;
-            totalresults.push_back(i);
-          }
-          result.clear();
-          result.shrink_to_fit();
+          total.merge(result);
         }
 #ifndef NDEBUG
-        std::cout << "Total results = " << totalresults.size() << std::endl;
+        std::cout << "Total results = " << total.total << std::endl;
 #endif
-        s.mean = static_cast<unsigned long long>(static_cast<double>(sum) / totalresults.size());
-        // Latency distributions are definitely not normally distributed, but here we have the
-        // advantage of tons of sample points. So simply sort into order, and pluck out the values
-        // at 99.999%, 99% and 95%. It'll be accurate enough.
-        std::sort(totalresults.begin(), totalresults.end());
-        s._50 = totalresults[static_cast<size_t>(0.5 * totalresults.size())];
-        s._95 = totalresults[static_cast<size_t>(0.95 * totalresults.size())];
-        s._99 = totalresults[static_cast<size_t>(0.99 * totalresults.size())];
-        s._99999 = totalresults[static_cast<size_t>(0.99999 * totalresults.size())];
+        if(total.total == 0)
+        {
+          return errc::timed_out;
+        }
+        stats s;
+        s.min = total.min;
+        s.mean = total.sum / total.total;
+        s.max = total.max;
+        s._50 = total.percentile(0.5);
+        s._95 = total.percentile(0.95);
+        s._99 = total.percentile(0.99);
+        s._999 = total.percentile(0.999);
+        s._99999 = total.percentile(0.99999);
+        s.histogram = total.to_string();
         return s;
       }
       catch(...)
@@ -1064,7 +1301,9 @@ namespace storage_profile
       sp.read_qd1_50.value = s._50;
       sp.read_qd1_95.value = s._95;
       sp.read_qd1_99.value = s._99;
+      sp.read_qd1_999.value = s._999;
       sp.read_qd1_99999.value = s._99999;
+      sp.read_qd1_histogram.value = std::move(s.histogram);
       return success();
     }
     outcome<void> write_qd1(storage_profile &sp, file_handle &srch) noexcept
@@ -1080,7 +1319,9 @@ namespace storage_profile
       sp.write_qd1_50.value = s._50;
       sp.write_qd1_95.value = s._95;
       sp.write_qd1_99.value = s._99;
+      sp.write_qd1_999.value = s._999;
       sp.write_qd1_99999.value = s._99999;
+      sp.write_qd1_histogram.value = std::move(s.histogram);
       return success();
     }
     outcome<void> read_qd16(storage_profile &sp, file_handle &srch) noexcept
@@ -1096,7 +1337,9 @@ namespace storage_profile
       sp.read_qd16_50.value = s._50;
       sp.read_qd16_95.value = s._95;
       sp.read_qd16_99.value = s._99;
+      sp.read_qd16_999.value = s._999;
       sp.read_qd16_99999.value = s._99999;
+      sp.read_qd16_histogram.value = std::move(s.histogram);
       return success();
     }
     outcome<void> write_qd16(storage_profile &sp, file_handle &srch) noexcept
@@ -1112,7 +1355,9 @@ namespace storage_profile
       sp.write_qd16_50.value = s._50;
       sp.write_qd16_95.value = s._95;
       sp.write_qd16_99.value = s._99;
+      sp.write_qd16_999.value = s._999;
       sp.write_qd16_99999.value = s._99999;
+      sp.write_qd16_histogram.value = std::move(s.histogram);
       return success();
     }
     outcome<void> readwrite_qd4(storage_profile &sp, file_handle &srch) noexcept
@@ -1128,7 +1373,252 @@ namespace storage_profile
       sp.readwrite_qd4_50.value = s._50;
       sp.readwrite_qd4_95.value = s._95;
       sp.readwrite_qd4_99.value = s._99;
+      sp.readwrite_qd4_999.value = s._999;
       sp.readwrite_qd4_99999.value = s._99999;
+      sp.readwrite_qd4_histogram.value = std::move(s.histogram);
+      return success();
+    }
+    inline result<io_multiplexer_ptr> _qd_sweep_multiplexer() noexcept
+    {
+#if defined(__linux__)
+      return multiplexer_linux_io_uring(1, false);
+#elif defined(_WIN32)
+      return multiplexer_win_iocp(1, true);
+#else
+      return errc::operation_not_supported;
+#endif
+    }
+    struct qd_sweep
+    {
+      struct point
+      {
+        unsigned queue_depth{0};
+        unsigned long long iops{0}, mean{0}, _99{0};
+      };
+      std::vector<point> points;
+      unsigned saturation_qd{0};
+
+      //! Space separated `queue_depth:IOPS:mean:99%` of each queue depth tested
+      std::string to_string() const
+      {
+        std::string ret;
+        for(auto &p : points)
+        {
+          if(!ret.empty())
+          {
+            ret.push_back(' ');
+          }
+          ret.append(std::to_string(p.queue_depth) + ":" + std::to_string(p.iops) + ":" + std::to_string(p.mean) + ":" + std::to_string(p._99));
+        }
+        return ret;
+      }
+    };
+    /* Rather than a thread per outstanding i/o, this keeps a queue depth of 4Kb i/o in flight from a
+    single thread via an i/o multiplexer into registered buffers, which is how the kernel would
+    see the QD the device is being asked to serve. Queue depths from 1 to 256 are each run for a
+    couple of seconds, and the saturation point is the lowest queue depth after which doubling it
+    no longer raises IOPS by 10%.
+    */
+    inline outcome<qd_sweep> _qd_sweep_test(file_handle &srch, bool writes)
+    {
+      static const unsigned clock_granularity = system::_clock_granularity_and_overhead().granularity;
+      static constexpr unsigned max_queue_depth = 256;
+      try
+      {
+        OUTCOME_TRY(auto &&multiplexer, _qd_sweep_multiplexer());
+        const auto state_reqs = multiplexer->io_state_requirements();
+        const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+        // Destroyed after the handle and multiplexer, so any i/o somehow still in flight never writes into freed memory
+        std::vector<byte, utils::page_allocator<byte>> storage(state_size * max_queue_depth);
+        OUTCOME_TRY(auto &&path, srch.current_path());
+        OUTCOME_TRY(auto &&fh, file_handle::file({}, path, file_handle::mode::write, file_handle::creation::open_existing, srch.kernel_caching(),
+                                                 (srch.flags() & ~file_handle::flag::unlink_on_first_close) | file_handle::flag::multiplexable));
+        OUTCOME_TRY(fh.set_multiplexer(multiplexer.get()));
+        std::vector<file_handle::registered_buffer_type> buffers(max_queue_depth);
+        for(auto &b : buffers)
+        {
+          size_t bytes = 4096;
+          b = fh.allocate_registered_buffer(bytes).value();
+          memset(b->data(), 0x5a, 4096);
+        }
+        std::vector<file_handle::buffer_type> rbs(max_queue_depth);
+        std::vector<file_handle::const_buffer_type> wbs(max_queue_depth);
+        std::vector<std::chrono::high_resolution_clock::time_point> began(max_queue_depth);
+        std::vector<io_multiplexer::io_operation_state *> states(max_queue_depth, nullptr);
+        QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand(writes ? 1 : 0);
+        OUTCOME_TRY(auto &&maxsize, fh.maximum_extent());
+        if(maxsize < 4096)
+        {
+          return errc::invalid_argument;
+        }
+        auto issue = [&](size_t n) {
+          const auto offset = (rand() % maxsize) & ~4095ULL;
+          span<byte> mem(storage.data() + n * state_size, state_size);
+          began[n] = std::chrono::high_resolution_clock::now();
+          if(writes)
+          {
+            wbs[n] = {buffers[n]->data(), 4096};
+            states[n] = multiplexer->construct_and_init_io_operation(mem, &fh, nullptr, file_handle::registered_buffer_type(buffers[n]), {},
+                                                                     file_handle::io_request<file_handle::const_buffers_type>({&wbs[n], 1}, offset));
+          }
+          else
+          {
+            rbs[n] = {buffers[n]->data(), 4096};
+            states[n] = multiplexer->construct_and_init_io_operation(mem, &fh, nullptr, file_handle::registered_buffer_type(buffers[n]), {},
+                                                                     file_handle::io_request<file_handle::buffers_type>({&rbs[n], 1}, offset));
+          }
+          return states[n] != nullptr;
+        };
+        (void) utils::drop_filesystem_cache();
+
+        qd_sweep ret;
+        result<void> failed(success());
+        for(unsigned qd = 1; qd <= max_queue_depth && failed; qd <<= 1)
+        {
+          histogram h;
+          size_t inflight = 0;
+          for(size_t n = 0; n < qd && failed; n++)
+          {
+            if(issue(n))
+            {
+              ++inflight;
+            }
+            else
+            {
+              failed = errc::invalid_argument;
+            }
+          }
+          auto flushed = multiplexer->flush_inited_io_operations();
+          if(!flushed && failed)
+          {
+            failed = std::move(flushed).error();
+          }
+          const auto begin = std::chrono::high_resolution_clock::now();
+          auto end = begin;
+          bool stopping = !failed;
+          while(inflight > 0)
+          {
+            auto checked = multiplexer->check_for_any_completed_io(std::chrono::milliseconds(100));
+            const auto now = std::chrono::high_resolution_clock::now();
+            if(!stopping && (!checked || !failed || std::chrono::duration_cast<std::chrono::seconds>(now - begin).count() >= 2))
+            {
+              stopping = true;
+              end = now;
+              if(!checked && failed)
+              {
+                failed = std::move(checked).error();
+              }
+            }
+            bool reissued = false;
+            for(size_t n = 0; n < qd; n++)
+            {
+              if(states[n] != nullptr && is_finished(states[n]->current_state()))
+              {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - began[n]).count();
+                if(ns == 0)
+                {
+                  ns = clock_granularity / 2;
+                }
+                if(writes)
+                {
+                  auto r = std::move(*states[n]).get_completed_write_or_barrier();
+                  if(!r && failed)
+                  {
+                    failed = std::move(r).error();
+                  }
+                }
+                else
+                {
+                  auto r = std::move(*states[n]).get_completed_read();
+                  if(!r && failed)
+                  {
+                    failed = std::move(r).error();
+                  }
+                }
+                states[n]->~io_operation_state();
+                states[n] = nullptr;
+                if(!stopping)
+                {
+                  h.record(static_cast<unsigned long long>(ns));
+                }
+                if(!stopping && issue(n))
+                {
+                  reissued = true;
+                }
+                else
+                {
+                  --inflight;
+                  if(!stopping && failed)
+                  {
+                    failed = errc::invalid_argument;
+                  }
+                }
+              }
+            }
+            if(reissued)
+            {
+              flushed = multiplexer->flush_inited_io_operations();
+              if(!flushed && failed)
+              {
+                failed = std::move(flushed).error();
+              }
+            }
+          }
+          if(!failed)
+          {
+            break;
+          }
+          if(h.total == 0)
+          {
+            return errc::timed_out;
+          }
+          qd_sweep::point p;
+          p.queue_depth = qd;
+          p.iops = h.total * 1000000000ULL / std::max(1ULL, static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+          p.mean = h.sum / h.total;
+          p._99 = h.percentile(0.99);
+#ifndef NDEBUG
+          std::cout << "QD " << qd << " IOPS = " << p.iops << " mean = " << p.mean << " 99% = " << p._99 << std::endl;
+#endif
+          ret.points.push_back(p);
+        }
+        OUTCOME_TRY(failed);
+        ret.saturation_qd = ret.points.back().queue_depth;
+        for(size_t n = 1; n < ret.points.size(); n++)
+        {
+          if(ret.points[n].iops * 10 < ret.points[n - 1].iops * 11)
+          {
+            ret.saturation_qd = ret.points[n - 1].queue_depth;
+            break;
+          }
+        }
+        return ret;
+      }
+      catch(...)
+      {
+        return std::current_exception();
+      }
+    }
+    outcome<void> read_qd_sweep(storage_profile &sp, file_handle &srch) noexcept
+    {
+      if(sp.read_qd_saturation.value != static_cast<unsigned>(-1))
+      {
+        return success();
+      }
+      OUTCOME_TRY(auto &&s, _qd_sweep_test(srch, false));
+      sp.read_qd_sweep.value = s.to_string();
+      sp.read_qd_saturation.value = s.saturation_qd;
+      return success();
+    }
+    outcome<void> write_qd_sweep(storage_profile &sp, file_handle &srch) noexcept
+    {
+      if(sp.write_qd_saturation.value != static_cast<unsigned>(-1))
+      {
+        return success();
+      }
+      OUTCOME_TRY(auto &&s, _qd_sweep_test(srch, true));
+      sp.write_qd_sweep.value = s.to_string();
+      sp.write_qd_saturation.value = s.saturation_qd;
       return success();
     }
     outcome<void> read_nothing(storage_profile &sp, file_handle &srch) noexcept
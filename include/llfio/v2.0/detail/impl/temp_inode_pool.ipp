@@ -0,0 +1,317 @@
+/* Pools of pre-created temporary inodes
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../file_handle.hpp"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>  // for pthread_atfork
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  inline intptr_t temp_inode_pool_key(const path_handle &dirh) noexcept
+  {
+#ifdef _WIN32
+    return (intptr_t) dirh.native_handle().h;
+#else
+    return dirh.native_handle().fd;
+#endif
+  }
+
+  /* A bounded lock free queue of pre-created inodes. Pushes are serialised by the lock
+  of the registry of pools, pops may come from any thread. A slot may be pushed into when
+  its sequence equals the position, and popped from when it equals the position plus one.
+  */
+  struct temp_inode_pool
+  {
+    struct slot
+    {
+      std::atomic<size_t> sequence{0};
+      file_handle fh;
+    };
+    intptr_t key{-1};
+    path_handle dirh;
+    size_t count{0};
+    std::unique_ptr<slot[]> slots;
+    size_t mask{0};
+    std::atomic<size_t> push_pos{0}, pop_pos{0};
+
+    explicit temp_inode_pool(size_t _count)
+        : count(_count)
+    {
+      size_t capacity = 1;
+      while(capacity < count)
+      {
+        capacity <<= 1U;
+      }
+      slots.reset(new slot[capacity]);
+      mask = capacity - 1;
+      for(size_t n = 0; n < capacity; n++)
+      {
+        slots[n].sequence.store(n, std::memory_order_relaxed);
+      }
+    }
+
+    size_t size() const noexcept
+    {
+      // Reading the pop position first means this never underflows
+      const size_t popped = pop_pos.load(std::memory_order_acquire);
+      return push_pos.load(std::memory_order_acquire) - popped;
+    }
+    bool try_push(file_handle &fh) noexcept
+    {
+      const size_t pos = push_pos.load(std::memory_order_relaxed);
+      slot &s = slots[pos & mask];
+      if(s.sequence.load(std::memory_order_acquire) != pos)
+      {
+        return false;  // full
+      }
+      s.fh = std::move(fh);
+      s.sequence.store(pos + 1, std::memory_order_release);
+      push_pos.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+    bool try_pop(file_handle &out) noexcept
+    {
+      size_t pos = pop_pos.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        slot &s = slots[pos & mask];
+        const auto dif = (intptr_t) s.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+        if(dif == 0)
+        {
+          if(pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            out = std::move(s.fh);
+            s.sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if(dif < 0)
+        {
+          return false;  // empty
+        }
+        else
+        {
+          pos = pop_pos.load(std::memory_order_relaxed);
+        }
+      }
+    }
+    result<void> fill() noexcept
+    {
+      while(size() < count)
+      {
+        OUTCOME_TRY(auto &&fh, file_handle::_temp_inode(dirh, file_handle::mode::write, file_handle::flag::none));
+        if(!try_push(fh))
+        {
+          break;
+        }
+      }
+      return success();
+    }
+  };
+
+  /* The registry of pools, and the thread refilling them. Pools are looked up without
+  locking, so a pool being released is only deleted once no thread is looking.
+  */
+  struct temp_inode_pools_state
+  {
+    static constexpr size_t max_pools = 16;
+
+    std::mutex lock;  // serialises reserving, releasing and refilling
+    std::condition_variable changed;
+    std::atomic<temp_inode_pool *> pools[max_pools]{};
+    std::atomic<size_t> active{0}, users{0};
+    std::atomic<bool> refill_wanted{false};
+    // A forked child shares the inodes of its parent, so it must never take them
+    std::atomic<bool> forked{false};
+    bool stopping{false};
+    std::thread thread;
+
+    temp_inode_pools_state() = default;
+    temp_inode_pools_state(const temp_inode_pools_state &) = delete;
+    temp_inode_pools_state &operator=(const temp_inode_pools_state &) = delete;
+    ~temp_inode_pools_state()
+    {
+      {
+        std::lock_guard<std::mutex> g(lock);
+        stopping = true;
+      }
+      changed.notify_all();
+      if(forked.load(std::memory_order_relaxed))
+      {
+        // The thread does not exist in a forked child, and joining it would fail
+        (void) new std::thread(std::move(thread));
+      }
+      else if(thread.joinable())
+      {
+        thread.join();
+      }
+      for(auto &pool : pools)
+      {
+        delete pool.exchange(nullptr);
+      }
+    }
+
+    void release(intptr_t key) noexcept
+    {
+      std::lock_guard<std::mutex> g(lock);
+      for(auto &p : pools)
+      {
+        temp_inode_pool *pool = p.load(std::memory_order_relaxed);
+        if(pool != nullptr && pool->key == key)
+        {
+          p.store(nullptr);
+          active.fetch_sub(1, std::memory_order_relaxed);
+          while(users.load() != 0)
+          {
+            std::this_thread::yield();
+          }
+          delete pool;
+        }
+      }
+    }
+    bool try_pop(file_handle &out, intptr_t key) noexcept
+    {
+      if(active.load(std::memory_order_relaxed) == 0 || forked.load(std::memory_order_relaxed))
+      {
+        return false;
+      }
+      bool ret = false;
+      users.fetch_add(1);
+      for(auto &p : pools)
+      {
+        temp_inode_pool *pool = p.load();
+        if(pool != nullptr && pool->key == key)
+        {
+          ret = pool->try_pop(out);
+          if(pool->size() * 2 <= pool->count && !refill_wanted.exchange(true, std::memory_order_relaxed))
+          {
+            // The refill thread polls as well, so a wakeup lost by not holding the lock is harmless
+            changed.notify_one();
+          }
+          break;
+        }
+      }
+      users.fetch_sub(1);
+      return ret;
+    }
+    void run() noexcept
+    {
+      std::unique_lock<std::mutex> g(lock);
+      while(!stopping)
+      {
+        changed.wait_for(g, std::chrono::milliseconds(100), [this] { return stopping || refill_wanted.load(std::memory_order_relaxed); });
+        if(stopping)
+        {
+          break;
+        }
+        refill_wanted.store(false, std::memory_order_relaxed);
+        for(auto &p : pools)
+        {
+          temp_inode_pool *pool = p.load(std::memory_order_relaxed);
+          if(pool != nullptr)
+          {
+            // On failure, try again next time
+            (void) pool->fill();
+          }
+        }
+      }
+    }
+  };
+  inline temp_inode_pools_state &temp_inode_pools() noexcept
+  {
+    static temp_inode_pools_state v;
+    return v;
+  }
+}  // namespace detail
+
+result<file_handle> file_handle::temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept
+{
+  if(_mode == mode::write && flags == flag::none)
+  {
+    file_handle ret;
+    if(detail::temp_inode_pools().try_pop(ret, detail::temp_inode_pool_key(dirh)))
+    {
+      return {std::move(ret)};
+    }
+  }
+  return _temp_inode(dirh, _mode, flags);
+}
+
+result<void> file_handle::reserve_temp_inodes(const path_handle &dirh, size_t count) noexcept
+{
+  auto &state = detail::temp_inode_pools();
+  const intptr_t key = detail::temp_inode_pool_key(dirh);
+  state.release(key);
+  if(count == 0)
+  {
+    return success();
+  }
+  try
+  {
+    std::unique_ptr<detail::temp_inode_pool> pool(new detail::temp_inode_pool(count));
+    pool->key = key;
+    OUTCOME_TRY(auto &&clonedh, dirh.clone_to_path_handle());
+    pool->dirh = std::move(clonedh);
+    std::lock_guard<std::mutex> g(state.lock);
+    OUTCOME_TRY(pool->fill());
+    for(auto &p : state.pools)
+    {
+      if(p.load(std::memory_order_relaxed) == nullptr)
+      {
+        p.store(pool.release());
+        state.active.fetch_add(1, std::memory_order_relaxed);
+        if(!state.thread.joinable())
+        {
+#ifndef _WIN32
+          static const int registered = ::pthread_atfork(nullptr, nullptr, [] { detail::temp_inode_pools().forked.store(true, std::memory_order_relaxed); });
+          (void) registered;
+#endif
+          state.thread = std::thread([&state] { state.run(); });
+        }
+        return success();
+      }
+    }
+    return errc::no_buffer_space;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+void file_handle::release_temp_inodes(const path_handle &dirh) noexcept
+{
+  detail::temp_inode_pools().release(detail::temp_inode_pool_key(dirh));
+}
+
+LLFIO_V2_NAMESPACE_END
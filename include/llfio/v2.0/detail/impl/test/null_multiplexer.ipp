@@ -28,6 +28,8 @@ Distributed under the Boost Software License, Version 1.0.
 #error This file should never be included directly
 #endif
 
+#include <cmath>
+
 LLFIO_V2_NAMESPACE_BEGIN
 
 namespace test
@@ -72,6 +74,12 @@ namespace test
 
       size_t count{2};  // when reaches 1, completes. When reaches 0, finishes.
       _null_operation_state *prev{nullptr}, *next{nullptr};
+      // Simulated device state, protected by the multiplexer's lock
+      bool in_service{false};
+      size_t bytes{0};
+      const null_device::latency_distribution *latency{nullptr};
+      std::chrono::steady_clock::time_point due;
+      _null_operation_state *queued_next{nullptr};
 
       _null_operation_state() = default;
       // Construct implicitly from the base implementation, see relocate_to()
@@ -91,6 +99,11 @@ namespace test
         // restamp the vptr with my own
         auto _to = new(to) _null_operation_state(std::move(*static_cast<_impl *>(to)));
         _to->count = count;
+        _to->in_service = in_service;
+        _to->bytes = bytes;
+        _to->latency = latency;
+        _to->due = due;
+        _to->queued_next = queued_next;
         return _to;
       }
 
@@ -147,6 +160,129 @@ namespace test
     // Whether to simulate finishing immediately after completion
     bool _disable_immediate_completions{false};
 
+    // The simulated device, if any
+    bool _simulating{false};
+    null_device _device;
+    uint64_t _random{0};
+    size_t _in_service{0};
+    std::chrono::steady_clock::time_point _bandwidth_free;
+    _null_operation_state *_queued_first{nullptr}, *_queued_last{nullptr};
+
+    // splitmix64, so the latency sequence is identical on every platform
+    uint64_t _next_random() noexcept
+    {
+      uint64_t z = (_random += 0x9e3779b97f4a7c15);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      return z ^ (z >> 31);
+    }
+    std::chrono::nanoseconds _latency(const null_device::latency_distribution &l) noexcept
+    {
+      const double u = (double) (_next_random() >> 11) * (1.0 / 9007199254740992.0);  // [0, 1)
+      const double mean = (double) l.mean.count(), spread = (double) l.spread.count();
+      double ns = mean;
+      switch(l.kind)
+      {
+      case null_device::distribution::fixed:
+        break;
+      case null_device::distribution::uniform:
+        ns = mean - spread + 2.0 * spread * u;
+        break;
+      case null_device::distribution::exponential:
+        ns = spread - mean * std::log(1.0 - u);
+        break;
+      }
+      return std::chrono::nanoseconds((int64_t) std::max(ns, 0.0));
+    }
+    // Must be called with the multiplexer's lock held
+    void _begin_service(_null_operation_state *state, std::chrono::steady_clock::time_point now) noexcept
+    {
+      ++_in_service;
+      state->in_service = true;
+      auto transferred = now;
+      if(_device.bytes_per_second > 0)
+      {
+        if(_bandwidth_free > transferred)
+        {
+          transferred = _bandwidth_free;
+        }
+        transferred += std::chrono::nanoseconds((int64_t) ((double) state->bytes * 1000000000.0 / (double) _device.bytes_per_second));
+        _bandwidth_free = transferred;
+      }
+      state->due = transferred + _latency(*state->latency);
+    }
+    // Must be called with the multiplexer's lock held
+    void _simulate(_null_operation_state *state, size_t bytes, const null_device::latency_distribution &latency) noexcept
+    {
+      if(!_simulating)
+      {
+        return;
+      }
+      state->bytes = bytes;
+      state->latency = &latency;
+      if(_device.queue_depth == 0 || _in_service < _device.queue_depth)
+      {
+        _begin_service(state, std::chrono::steady_clock::now());
+        return;
+      }
+      if(_queued_last == nullptr)
+      {
+        _queued_first = _queued_last = state;
+      }
+      else
+      {
+        _queued_last->queued_next = state;
+        _queued_last = state;
+      }
+    }
+    // Must be called with the multiplexer's lock held. Starts the service of queued i/o.
+    void _end_service(_null_operation_state *state) noexcept
+    {
+      if(state->in_service)
+      {
+        state->in_service = false;
+        --_in_service;
+      }
+      else
+      {
+        // Cancelled whilst queued
+        for(_null_operation_state **p = &_queued_first, *prev = nullptr; *p != nullptr; prev = *p, p = &(*p)->queued_next)
+        {
+          if(*p == state)
+          {
+            *p = state->queued_next;
+            if(_queued_last == state)
+            {
+              _queued_last = prev;
+            }
+            state->queued_next = nullptr;
+            break;
+          }
+        }
+      }
+      const auto now = std::chrono::steady_clock::now();
+      while(_queued_first != nullptr && (_device.queue_depth == 0 || _in_service < _device.queue_depth))
+      {
+        auto *q = _queued_first;
+        _queued_first = q->queued_next;
+        if(_queued_first == nullptr)
+        {
+          _queued_last = nullptr;
+        }
+        q->queued_next = nullptr;
+        _begin_service(q, now);
+      }
+    }
+    template <class BuffersType> static size_t _bytes(const BuffersType &buffers) noexcept
+    {
+      size_t ret = 0;
+      for(auto &b : buffers)
+      {
+        ret += b.size();
+      }
+      return ret;
+    }
+
   public:
     constexpr null_multiplexer() {}
     null_multiplexer(const null_multiplexer &) = delete;
@@ -160,10 +296,16 @@ namespace test
         (void) null_multiplexer::close();
       }
     }
-    result<void> init(size_t threads, bool disable_immediate_completions)
+    result<void> init(size_t threads, bool disable_immediate_completions, const null_device *device = nullptr)
     {
       _thread_statistics.resize(threads);
       _disable_immediate_completions = disable_immediate_completions;
+      if(device != nullptr)
+      {
+        _simulating = true;
+        _device = *device;
+        _random = device->seed;
+      }
       // In a real multiplexer, you need to create the system's i/o multiplexer
       // and store it into this->_v. We shall store something other than -1
       // to make this handle appear open.
@@ -285,6 +427,7 @@ namespace test
         state->read_initiated();
         _multiplexer_lock_guard g(this->_lock);
         _insert(state);
+        _simulate(state, _bytes(state->payload.noncompleted.params.read.reqs.buffers), _device.read);
         return io_operation_state_type::read_initiated;
       }
       case io_operation_state_type::write_initialised:
@@ -303,6 +446,7 @@ namespace test
         state->write_initiated();
         _multiplexer_lock_guard g(this->_lock);
         _insert(state);
+        _simulate(state, _bytes(state->payload.noncompleted.params.write.reqs.buffers), _device.write);
         return io_operation_state_type::write_initiated;
       }
       case io_operation_state_type::barrier_initialised:
@@ -321,6 +465,7 @@ namespace test
         state->barrier_initiated();
         _multiplexer_lock_guard g(this->_lock);
         _insert(state);
+        _simulate(state, 0, _device.barrier);
         return io_operation_state_type::barrier_initiated;
       }
       case io_operation_state_type::read_initiated:
@@ -352,6 +497,17 @@ namespace test
     {
       auto *state = static_cast<_null_operation_state *>(_op);
       typename io_operation_state::lock_guard g(state);
+      if(_simulating && (state->state == io_operation_state_type::read_initiated || state->state == io_operation_state_type::write_initiated ||
+                         state->state == io_operation_state_type::barrier_initiated))
+      {
+        // Initiated i/o completes only once the simulated device has serviced it
+        _multiplexer_lock_guard g2(this->_lock);
+        if(!state->in_service || std::chrono::steady_clock::now() < state->due)
+        {
+          return state->state;
+        }
+        _end_service(state);
+      }
       if(state->count > 0)
       {
         --state->count;
@@ -451,6 +607,11 @@ namespace test
         break;
       case io_operation_state_type::read_initiated:
       {
+        if(_simulating)
+        {
+          _multiplexer_lock_guard g2(this->_lock);
+          _end_service(state);
+        }
         io_handle::io_result<io_handle::buffers_type> ret(errc::operation_canceled);
         state->_read_completed(g, std::move(ret).value());
         state->count = 1;
@@ -458,6 +619,11 @@ namespace test
       }
       case io_operation_state_type::write_initiated:
       {
+        if(_simulating)
+        {
+          _multiplexer_lock_guard g2(this->_lock);
+          _end_service(state);
+        }
         io_handle::io_result<io_handle::const_buffers_type> ret(errc::operation_canceled);
         state->_write_completed(g, std::move(ret).value());
         state->count = 1;
@@ -465,6 +631,11 @@ namespace test
       }
       case io_operation_state_type::barrier_initiated:
       {
+        if(_simulating)
+        {
+          _multiplexer_lock_guard g2(this->_lock);
+          _end_service(state);
+        }
         io_handle::io_result<io_handle::const_buffers_type> ret(errc::operation_canceled);
         state->_barrier_completed(g, std::move(ret).value());
         state->count = 1;
@@ -578,6 +749,26 @@ namespace test
       return error_from_exception();
     }
   }
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_null(size_t threads, bool disable_immediate_completions, const null_device &device) noexcept
+  {
+    try
+    {
+      if(1 == threads)
+      {
+        auto ret = std::make_unique<null_multiplexer<false>>();
+        OUTCOME_TRY(ret->init(1, disable_immediate_completions, &device));
+        return io_multiplexer_ptr(ret.release());
+      }
+      auto ret = std::make_unique<null_multiplexer<true>>();
+      OUTCOME_TRY(ret->init(threads, disable_immediate_completions, &device));
+      return io_multiplexer_ptr(ret.release());
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
 }  // namespace test
 
 LLFIO_V2_NAMESPACE_END
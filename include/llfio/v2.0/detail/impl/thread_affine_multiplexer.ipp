@@ -0,0 +1,458 @@
+/* Hand completions back to the initiating thread
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../io_handle.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* This i/o multiplexer wraps another, which executes all the i/o.
+
+- Each thread initiating i/o through us has a home queue, found through a thread local
+cache so the common case takes no lock. i/o with a visitor has that visitor replaced by
+a handoff node allocated from the free list of its home queue, which only its home thread
+ever touches.
+
+- If the i/o completes upon its home thread, the node forwards to the original visitor
+as normal. Otherwise the node leaves the result in the state, and when the i/o finishes,
+pushes itself onto the lock free intrusive stack of its home queue. The home thread drains
+its stack upon its next call into us, invoking the original visitor's completion and
+finish with the state lock held, as the inner multiplexer would have.
+
+- i/o without a visitor has nothing to hand off, so is passed through untouched.
+*/
+class thread_affine_multiplexer final : public io_multiplexer
+{
+  struct _queue_t;
+  struct _handoff_t final : public io_operation_state_visitor
+  {
+    thread_affine_multiplexer *parent{nullptr};
+    _queue_t *home{nullptr};
+    io_operation_state_visitor *visitor{nullptr};  // the original visitor
+    io_operation_state *op{nullptr};
+    io_operation_state_type former{io_operation_state_type::unknown};  // the state before completion elsewhere
+    bool completed_elsewhere{false};
+    _handoff_t *next{nullptr};  // in the home's free list, or its stack of handoffs
+
+    bool _is_home() const noexcept { return parent->_this_thread_queue_if_any() == home; }
+
+    virtual void read_initiated(lock_guard &g, io_operation_state_type former_) override { visitor->read_initiated(g, former_); }
+    virtual bool read_completed(lock_guard &g, io_operation_state_type former_, io_result<buffers_type> &&res) override
+    {
+      if(_is_home())
+      {
+        return visitor->read_completed(g, former_, std::move(res));
+      }
+      former = former_;
+      completed_elsewhere = true;
+      return false;
+    }
+    virtual void read_finished(lock_guard &g, io_operation_state_type former_) override
+    {
+      if(!completed_elsewhere)
+      {
+        auto *v = visitor;
+        op->visitor = v;
+        home->recycle(this);
+        v->read_finished(g, former_);
+        return;
+      }
+      parent->_hand_off(this);
+    }
+    virtual void write_initiated(lock_guard &g, io_operation_state_type former_) override { visitor->write_initiated(g, former_); }
+    virtual bool write_completed(lock_guard &g, io_operation_state_type former_, io_result<const_buffers_type> &&res) override
+    {
+      if(_is_home())
+      {
+        return visitor->write_completed(g, former_, std::move(res));
+      }
+      former = former_;
+      completed_elsewhere = true;
+      return false;
+    }
+    virtual void barrier_initiated(lock_guard &g, io_operation_state_type former_) override { visitor->barrier_initiated(g, former_); }
+    virtual bool barrier_completed(lock_guard &g, io_operation_state_type former_, io_result<const_buffers_type> &&res) override
+    {
+      if(_is_home())
+      {
+        return visitor->barrier_completed(g, former_, std::move(res));
+      }
+      former = former_;
+      completed_elsewhere = true;
+      return false;
+    }
+    virtual void write_or_barrier_finished(lock_guard &g, io_operation_state_type former_) override
+    {
+      if(!completed_elsewhere)
+      {
+        auto *v = visitor;
+        op->visitor = v;
+        home->recycle(this);
+        v->write_or_barrier_finished(g, former_);
+        return;
+      }
+      parent->_hand_off(this);
+    }
+  };
+  struct _queue_t
+  {
+    std::atomic<_handoff_t *> handoffs{nullptr};  // pushed to by any thread, popped by the home thread
+    std::atomic<bool> waiting{false};             // if the home thread may be waiting within the inner multiplexer
+    _handoff_t *free{nullptr};                    // only touched by the home thread
+    std::vector<std::unique_ptr<_handoff_t>> allocated;
+
+    // Only called by the home thread
+    _handoff_t *allocate()
+    {
+      if(free != nullptr)
+      {
+        auto *ret = free;
+        free = ret->next;
+        ret->next = nullptr;
+        return ret;
+      }
+      allocated.push_back(std::make_unique<_handoff_t>());
+      return allocated.back().get();
+    }
+    // Only called by the home thread
+    void recycle(_handoff_t *h) noexcept
+    {
+      h->completed_elsewhere = false;
+      h->next = free;
+      free = h;
+    }
+  };
+
+  io_multiplexer_ptr _inner;
+  const uint64_t _id{_next_id()};  // unlike our address, never reused by a later instance
+  std::mutex _lock;
+  std::unordered_map<std::thread::id, std::unique_ptr<_queue_t>> _queues;
+  std::atomic<uint64_t> _handed_off{0};
+
+  static uint64_t _next_id() noexcept
+  {
+    static std::atomic<uint64_t> v{1};
+    return v.fetch_add(1, std::memory_order_relaxed);
+  }
+  struct _this_thread_t
+  {
+    uint64_t owner{0};
+    _queue_t *queue{nullptr};
+  };
+  static _this_thread_t &_this_thread() noexcept
+  {
+    static LLFIO_THREAD_LOCAL _this_thread_t v;
+    return v;
+  }
+  _queue_t *_this_thread_queue_if_any() noexcept
+  {
+    auto &tt = _this_thread();
+    if(tt.owner == _id)
+    {
+      return tt.queue;
+    }
+    // This thread may have a queue, but it was not the most recent multiplexer of ours it used
+    std::lock_guard<std::mutex> g(_lock);
+    auto it = _queues.find(std::this_thread::get_id());
+    return (it != _queues.end()) ? it->second.get() : nullptr;
+  }
+  _queue_t *_this_thread_queue()
+  {
+    auto &tt = _this_thread();
+    if(tt.owner != _id)
+    {
+      std::lock_guard<std::mutex> g(_lock);
+      auto &q = _queues[std::this_thread::get_id()];
+      if(!q)
+      {
+        q = std::make_unique<_queue_t>();
+      }
+      tt.owner = _id;
+      tt.queue = q.get();
+    }
+    return tt.queue;
+  }
+
+  // Pushes a handoff onto its home's stack, waking the home thread if it may be waiting
+  void _hand_off(_handoff_t *h) noexcept
+  {
+    _handed_off.fetch_add(1, std::memory_order_relaxed);
+    auto *head = h->home->handoffs.load(std::memory_order_relaxed);
+    do
+    {
+      h->next = head;
+    } while(!h->home->handoffs.compare_exchange_weak(head, h, std::memory_order_release, std::memory_order_relaxed));
+    if(head == nullptr && h->home->waiting.load(std::memory_order_acquire))
+    {
+      (void) _inner->wake_check_for_any_completed_io();
+    }
+  }
+  // Invokes the visitors of i/o handed back to this thread, returning how many
+  size_t _drain() noexcept
+  {
+    auto &tt = _this_thread();
+    if(tt.owner != _id || tt.queue->handoffs.load(std::memory_order_relaxed) == nullptr)
+    {
+      return 0;
+    }
+    auto *q = tt.queue;
+    auto *h = q->handoffs.exchange(nullptr, std::memory_order_acquire);
+    // The stack is in reverse order of finishing
+    _handoff_t *ordered = nullptr;
+    while(h != nullptr)
+    {
+      auto *next = h->next;
+      h->next = ordered;
+      ordered = h;
+      h = next;
+    }
+    size_t count = 0;
+    for(h = ordered; h != nullptr;)
+    {
+      auto *next = h->next;
+      auto *op = h->op;
+      auto *v = h->visitor;
+      const auto former = h->former;
+      q->recycle(h);
+      {
+        io_operation_state::lock_guard g(op);
+        op->visitor = v;
+        auto *state = static_cast<_unsynchronised_io_operation_state *>(op);
+        switch(former)
+        {
+        case io_operation_state_type::read_initialised:
+        case io_operation_state_type::read_initiated:
+          v->read_completed(g, former, std::move(state->payload.completed_read));
+          v->read_finished(g, io_operation_state_type::read_completed);
+          break;
+        case io_operation_state_type::write_initialised:
+        case io_operation_state_type::write_initiated:
+          v->write_completed(g, former, std::move(state->payload.completed_write_or_barrier));
+          v->write_or_barrier_finished(g, io_operation_state_type::write_or_barrier_completed);
+          break;
+        case io_operation_state_type::barrier_initialised:
+        case io_operation_state_type::barrier_initiated:
+          v->barrier_completed(g, former, std::move(state->payload.completed_write_or_barrier));
+          v->write_or_barrier_finished(g, io_operation_state_type::write_or_barrier_completed);
+          break;
+        default:
+          break;
+        }
+      }
+      ++count;
+      h = next;
+    }
+    return count;
+  }
+
+public:
+  thread_affine_multiplexer() = default;
+  thread_affine_multiplexer(const thread_affine_multiplexer &) = delete;
+  thread_affine_multiplexer(thread_affine_multiplexer &&) = delete;
+  thread_affine_multiplexer &operator=(const thread_affine_multiplexer &) = delete;
+  thread_affine_multiplexer &operator=(thread_affine_multiplexer &&) = delete;
+  virtual ~thread_affine_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) thread_affine_multiplexer::close();
+    }
+  }
+  result<void> init(io_multiplexer_ptr inner)
+  {
+    if(!inner)
+    {
+      return errc::invalid_argument;
+    }
+    _inner = std::move(inner);
+    // We have no kernel handle of our own, so store something other than -1
+    this->_v._init = -2;  // otherwise appears closed
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    return success();
+  }
+
+  //! The number of completions handed back to the thread which initiated them
+  uint64_t handed_off() const noexcept { return _handed_off.load(std::memory_order_relaxed); }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    if(_inner)
+    {
+      OUTCOME_TRY(_inner->close());
+    }
+    this->_v._init = -1;  // make it appear closed
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override { return _inner->do_io_handle_register(h); }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override { return _inner->do_io_handle_deregister(h); }
+  virtual size_t do_io_handle_max_buffers(const io_handle *h) const noexcept override { return _inner->do_io_handle_max_buffers(h); }
+  virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+  {
+    return _inner->do_io_handle_allocate_registered_buffer(h, bytes);
+  }
+
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return _inner->io_state_requirements(); }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<buffers_type> reqs) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    return _inner->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+  virtual io_operation_state_type init_io_operation(io_operation_state *op) noexcept override
+  {
+    if(op->visitor != nullptr)
+    {
+      try
+      {
+        auto *q = _this_thread_queue();
+        auto *h = q->allocate();
+        h->parent = this;
+        h->home = q;
+        h->visitor = op->visitor;
+        h->op = op;
+        op->visitor = h;
+      }
+      catch(...)
+      {
+        // Without a handoff node the i/o completes wherever it is reaped, as it would without us
+      }
+    }
+    return _inner->init_io_operation(op);
+  }
+
+  virtual result<void> flush_inited_io_operations() noexcept override
+  {
+    _drain();
+    return _inner->flush_inited_io_operations();
+  }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *op) noexcept override
+  {
+    _drain();
+    auto ret = _inner->check_io_operation(op);
+    _drain();
+    return ret;
+  }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *op, deadline d = {}) noexcept override
+  {
+    auto ret = _inner->cancel_io_operation(op, d);
+    _drain();
+    return ret;
+  }
+
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept override
+  {
+    auto ret = _inner->cancel_io_operations(ops, d);
+    _drain();
+    return ret;
+  }
+
+  virtual result<void> cancel_io_operations(io_handle *h) noexcept override
+  {
+    auto ret = _inner->cancel_io_operations(h);
+    _drain();
+    return ret;
+  }
+
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0),
+                                                                                   size_t max_completions = (size_t) -1) noexcept override
+  {
+    check_for_any_completed_io_statistics ret;
+    // Completions handed back whilst we were elsewhere satisfy this call without waiting
+    const size_t drained = _drain();
+    if(drained > 0)
+    {
+      ret.initiated_ios_completed = ret.initiated_ios_finished = drained;
+      return ret;
+    }
+    auto &tt = _this_thread();
+    _queue_t *q = (tt.owner == _id) ? tt.queue : nullptr;
+    if(q != nullptr)
+    {
+      q->waiting.store(true, std::memory_order_release);
+      if(q->handoffs.load(std::memory_order_acquire) != nullptr)
+      {
+        // Handed back between draining and announcing we would wait
+        d = std::chrono::seconds(0);
+      }
+    }
+    auto r = _inner->check_for_any_completed_io(d, max_completions);
+    if(q != nullptr)
+    {
+      q->waiting.store(false, std::memory_order_relaxed);
+    }
+    OUTCOME_TRY(auto &&stats, std::move(r));
+    ret = stats;
+    const size_t drained2 = _drain();
+    ret.initiated_ios_completed += drained2;
+    ret.initiated_ios_finished += drained2;
+    return ret;
+  }
+
+  virtual result<void> wake_check_for_any_completed_io() noexcept override { return _inner->wake_check_for_any_completed_io(); }
+
+#ifndef _WIN32
+  virtual result<void> do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _inner->do_posix_fs_syscalls(ops); }
+  virtual result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _inner->initiate_posix_fs_syscalls(ops); }
+#endif
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_thread_affine(io_multiplexer_ptr inner) noexcept
+{
+  try
+  {
+    auto ret = std::make_unique<thread_affine_multiplexer>();
+    OUTCOME_TRY(ret->init(std::move(inner)));
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,435 @@
+/* Multiplex i/o across a pool of kernel threads
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../io_handle.hpp"
+
+#if !LLFIO_INCLUDED_BY_HEADER || !defined(LLFIO_IO_HANDLE_H)
+#error This file should never be included directly
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+/* This i/o multiplexer owns one child i/o multiplexer per kernel thread in its pool, each of
+which we call a shard. Each shard has its own kernel resources (io_uring rings, epoll fd etc),
+so there is no lock shared between the shards.
+
+- Handles are assigned to a shard by their native handle value at registration, so the shard
+owning any i/o can be found without a lock or a lookup table. All operations upon an i/o
+state are forwarded to the shard owning its handle.
+
+- Each pool thread reaps completions from its own shard in batches of `_batch` completions.
+If a thread has to stop reaping because it completed a full batch (i.e. its shard is busy, most
+likely because i/o visitors or coroutines resumed by the completions are doing work), it wakes
+an idle pool thread, which then steals completions from the busy shard until none remain.
+
+- `check_for_any_completed_io()` called by threads outside the pool never reaps completions, as
+these would race with the pool. Instead it waits until the pool has finished any more i/o since
+the calling thread last initiated or waited for i/o on this multiplexer.
+*/
+class thread_pool_multiplexer final : public io_multiplexer
+{
+  friend LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_thread_pool(size_t threads, result<io_multiplexer_ptr> (*make_shard)(size_t threads),
+                                                                                         bool pin_threads) noexcept;
+
+  // The maximum number of completions reaped before a pool thread checks its peers
+  static constexpr size_t _batch = 64;
+
+  struct _shard
+  {
+    io_multiplexer_ptr multiplexer;
+    std::thread thread;
+    std::atomic<bool> busy{false};  // true if this shard's thread completed a full batch, and is not waiting
+    std::atomic<bool> idle{false};  // true if this shard's thread is waiting for completions in its shard
+  };
+  std::unique_ptr<_shard[]> _shards;
+  size_t _nshards{0};
+  std::atomic<bool> _done{false};
+
+  // Used to wake threads outside the pool waiting for finished i/o
+  std::mutex _lock;
+  std::condition_variable _cond;
+  std::atomic<uint64_t> _finished{0};  // the total count of i/o finished by the pool
+
+  // The last value of _finished seen by a thread outside the pool
+  struct _last_seen_t
+  {
+    const thread_pool_multiplexer *owner{nullptr};
+    uint64_t finished{0};
+  };
+  static _last_seen_t &_last_seen() noexcept
+  {
+    static LLFIO_THREAD_LOCAL _last_seen_t v;
+    return v;
+  }
+  void _note_seen() noexcept
+  {
+    auto &ls = _last_seen();
+    ls.owner = this;
+    ls.finished = _finished.load(std::memory_order_acquire);
+  }
+
+  io_multiplexer *_shard_for(const io_handle *h) const noexcept
+  {
+    const auto &v = h->native_handle();
+#ifdef _WIN32
+    const size_t idx = (size_t)(((uintptr_t) v.h) >> 2) % _nshards;  // HANDLEs are multiples of four
+#else
+    const size_t idx = (size_t) v.fd % _nshards;
+#endif
+    return _shards[idx].multiplexer.get();
+  }
+
+  void _notify_finished(size_t count) noexcept
+  {
+    _finished.fetch_add(count, std::memory_order_acq_rel);
+    std::lock_guard<std::mutex> g(_lock);
+    _cond.notify_all();
+  }
+
+  // Steals completions from any busy shard. Returns the number of i/o finished.
+  size_t _steal(size_t myidx) noexcept
+  {
+    size_t ret = 0;
+    for(size_t n = 1; n < _nshards; n++)
+    {
+      auto &victim = _shards[(myidx + n) % _nshards];
+      while(victim.busy.load(std::memory_order_acquire) && !_done.load(std::memory_order_relaxed))
+      {
+        auto r = victim.multiplexer->check_for_any_completed_io(std::chrono::seconds(0), _batch);
+        if(!r || (r.value().initiated_ios_completed + r.value().initiated_ios_finished) == 0)
+        {
+          break;
+        }
+        ret += r.value().initiated_ios_finished;
+      }
+    }
+    return ret;
+  }
+
+  void _worker(size_t myidx) noexcept
+  {
+    auto &me = _shards[myidx];
+    while(!_done.load(std::memory_order_relaxed))
+    {
+      me.idle.store(true, std::memory_order_release);
+      auto r = me.multiplexer->check_for_any_completed_io(std::chrono::milliseconds(100), _batch);
+      me.idle.store(false, std::memory_order_release);
+      size_t finished = 0;
+      if(r)
+      {
+        finished = r.value().initiated_ios_finished;
+        const bool full_batch = (r.value().initiated_ios_completed + r.value().initiated_ios_finished) >= _batch;
+        me.busy.store(full_batch, std::memory_order_release);
+        if(full_batch)
+        {
+          // Ask a peer which is waiting for completions to help out
+          for(size_t n = 1; n < _nshards; n++)
+          {
+            auto &peer = _shards[(myidx + n) % _nshards];
+            if(peer.idle.load(std::memory_order_acquire))
+            {
+              (void) peer.multiplexer->wake_check_for_any_completed_io();
+              break;
+            }
+          }
+        }
+      }
+      finished += _steal(myidx);
+      if(finished > 0)
+      {
+        _notify_finished(finished);
+      }
+    }
+    me.busy.store(false, std::memory_order_release);
+  }
+
+  static void _pin_to_cpu(std::thread &t, size_t idx) noexcept
+  {
+#ifdef __linux__
+    const unsigned cpus = std::thread::hardware_concurrency();
+    if(cpus > 0)
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(idx % cpus, &set);
+      (void) pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);  // may be refused by policy
+    }
+#else
+    (void) t;
+    (void) idx;
+#endif
+  }
+
+  void _stop() noexcept
+  {
+    _done.store(true, std::memory_order_release);
+    for(size_t n = 0; n < _nshards; n++)
+    {
+      if(_shards[n].thread.joinable())
+      {
+        (void) _shards[n].multiplexer->wake_check_for_any_completed_io();
+        _shards[n].thread.join();
+      }
+    }
+  }
+
+public:
+  thread_pool_multiplexer() = default;
+  thread_pool_multiplexer(const thread_pool_multiplexer &) = delete;
+  thread_pool_multiplexer(thread_pool_multiplexer &&) = delete;
+  thread_pool_multiplexer &operator=(const thread_pool_multiplexer &) = delete;
+  thread_pool_multiplexer &operator=(thread_pool_multiplexer &&) = delete;
+  virtual ~thread_pool_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) thread_pool_multiplexer::close();
+    }
+    else
+    {
+      _stop();
+    }
+  }
+  result<void> init(size_t threads, result<io_multiplexer_ptr> (*make_shard)(size_t threads), bool pin_threads)
+  {
+    _shards.reset(new _shard[threads]);
+    _nshards = threads;
+    for(size_t n = 0; n < threads; n++)
+    {
+      // Each shard is used by its pool thread, a stealing pool thread, and the threads initiating i/o
+      OUTCOME_TRY(auto &&shard, make_shard(3));
+      _shards[n].multiplexer = std::move(shard);
+    }
+    for(size_t n = 0; n < threads; n++)
+    {
+      _shards[n].thread = std::thread([this, n] { _worker(n); });
+      if(pin_threads)
+      {
+        _pin_to_cpu(_shards[n].thread, n);
+      }
+    }
+    // We have no kernel handle of our own, so store something other than -1
+    this->_v._init = -2;  // otherwise appears closed
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    return success();
+  }
+
+  // These functions are inherited from handle
+  // virtual result<path_type> current_path() const noexcept override
+  virtual result<void> close() noexcept override
+  {
+    _stop();
+    for(size_t n = 0; n < _nshards; n++)
+    {
+      if(_shards[n].multiplexer)
+      {
+        OUTCOME_TRY(_shards[n].multiplexer->close());
+      }
+    }
+    this->_v._init = -1;  // make it appear closed
+    return success();
+  }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override { return _shard_for(h)->do_io_handle_register(h); }
+  virtual result<void> do_io_handle_deregister(io_handle *h) noexcept override { return _shard_for(h)->do_io_handle_deregister(h); }
+  virtual size_t do_io_handle_max_buffers(const io_handle *h) const noexcept override { return _shard_for(h)->do_io_handle_max_buffers(h); }
+  virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+  {
+    return _shard_for(h)->do_io_handle_allocate_registered_buffer(h, bytes);
+  }
+
+  // All shards are made by the same factory, so have identical requirements
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return _shards[0].multiplexer->io_state_requirements(); }
+
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<buffers_type> reqs) noexcept override
+  {
+    return _shard_for(_h)->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs) noexcept override
+  {
+    return _shard_for(_h)->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                        io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    return _shard_for(_h)->construct(storage, _h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+  virtual io_operation_state_type init_io_operation(io_operation_state *op) noexcept override
+  {
+    _note_seen();
+    return _shard_for(op->h)->init_io_operation(op);
+  }
+  virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor,
+                                                              registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  {
+    _note_seen();
+    return _shard_for(_h)->construct_and_init_io_operation(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor,
+                                                              registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  {
+    _note_seen();
+    return _shard_for(_h)->construct_and_init_io_operation(storage, _h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct_and_init_io_operation(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor,
+                                                              registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs,
+                                                              barrier_kind kind) noexcept override
+  {
+    _note_seen();
+    return _shard_for(_h)->construct_and_init_io_operation(storage, _h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+
+  virtual result<void> flush_inited_io_operations() noexcept override
+  {
+    for(size_t n = 0; n < _nshards; n++)
+    {
+      OUTCOME_TRY(_shards[n].multiplexer->flush_inited_io_operations());
+    }
+    return success();
+  }
+
+  virtual io_operation_state_type check_io_operation(io_operation_state *op) noexcept override { return _shard_for(op->h)->check_io_operation(op); }
+
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *op, deadline d = {}) noexcept override
+  {
+    return _shard_for(op->h)->cancel_io_operation(op, d);
+  }
+
+  // i/o in a batch may be spread across shards, so each is cancelled individually
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept override
+  {
+    return io_multiplexer::cancel_io_operations(ops, d);
+  }
+
+  virtual result<void> cancel_io_operations(io_handle *h) noexcept override { return _shard_for(h)->cancel_io_operations(h); }
+
+  // Completions are reaped by the pool, so this waits for the pool to finish some i/o
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0),
+                                                                                   size_t max_completions = (size_t) -1) noexcept override
+  {
+    (void) max_completions;
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    check_for_any_completed_io_statistics ret;
+    auto &ls = _last_seen();
+    // If this thread has never initiated i/o on this multiplexer, any i/o it is waiting for has already finished
+    const uint64_t seen = (ls.owner == this) ? ls.finished : 0;
+    std::unique_lock<std::mutex> g(_lock);
+    for(;;)
+    {
+      const uint64_t now = _finished.load(std::memory_order_acquire);
+      if(now != seen)
+      {
+        ls.owner = this;
+        ls.finished = now;
+        ret.initiated_ios_finished = (size_t)(now - seen);
+        return ret;
+      }
+      if(!d)
+      {
+        _cond.wait(g);
+        continue;
+      }
+      std::chrono::nanoseconds timeout;
+      LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(timeout, d);
+      if(timeout.count() <= 0)
+      {
+        // Timed out
+        return ret;
+      }
+      _cond.wait_for(g, timeout);
+    }
+  }
+
+  virtual result<void> wake_check_for_any_completed_io() noexcept override
+  {
+    std::lock_guard<std::mutex> g(_lock);
+    _cond.notify_all();
+    return success();
+  }
+
+#ifndef _WIN32
+  // The first shard executes these, its completions being reaped by whichever thread gets to them first
+  virtual result<void> do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _shards[0].multiplexer->do_posix_fs_syscalls(ops); }
+  virtual result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept override { return _shards[0].multiplexer->initiate_posix_fs_syscalls(ops); }
+#endif
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_thread_pool(size_t threads, result<io_multiplexer_ptr> (*make_shard)(size_t threads),
+                                                                                bool pin_threads) noexcept
+{
+  try
+  {
+    if(threads == 0)
+    {
+      threads = std::thread::hardware_concurrency();
+      if(threads == 0)
+      {
+        threads = 1;
+      }
+    }
+    if(make_shard == nullptr)
+    {
+#if defined(__linux__)
+      make_shard = [](size_t shardthreads) -> result<io_multiplexer_ptr> {
+        auto r = multiplexer_linux_io_uring(shardthreads, false);
+        if(!r)
+        {
+          // io_uring is unavailable or disabled by policy
+          return multiplexer_linux_epoll(shardthreads);
+        }
+        return r;
+      };
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+      make_shard = [](size_t shardthreads) -> result<io_multiplexer_ptr> { return multiplexer_bsd_kqueue(shardthreads); };
+#elif defined(_WIN32)
+      make_shard = [](size_t shardthreads) -> result<io_multiplexer_ptr> { return multiplexer_win_iocp(shardthreads, false); };
+#else
+      return errc::operation_not_supported;
+#endif
+    }
+    auto ret = std::make_unique<thread_pool_multiplexer>();
+    OUTCOME_TRY(ret->init(threads, make_shard, pin_threads));
+    return io_multiplexer_ptr(ret.release());
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
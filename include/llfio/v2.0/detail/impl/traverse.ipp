@@ -23,15 +23,25 @@ Distributed under the Boost Software License, Version 1.0.
 */
 
 #include "../../algorithm/traverse.hpp"
+#include "../../io_multiplexer.hpp"
+#include "../../statfs.hpp"
+#include "../../symlink_handle.hpp"
+#include "../../utils.hpp"
 
 #include <condition_variable>
+#include <deque>
 #include <iostream>
-#include <list>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
-#ifndef _WIN32
+#ifdef _WIN32
+#include "windows/import.hpp"
+
+#include <winioctl.h>
+#else
 #include <sys/resource.h>
 #include <sys/stat.h>
 #endif
@@ -41,7 +51,7 @@ LLFIO_V2_NAMESPACE_BEGIN
 namespace algorithm
 {
   LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> traverse(const path_handle &_topdirh, traverse_visitor *visitor, size_t threads, void *data,
-                                                       bool force_slow_path) noexcept
+                                                       bool force_slow_path, bool depth_first, io_multiplexer *multiplexer, size_t max_queued) noexcept
   {
     return visitor->finished(data, [&]() -> result<size_t> {
       try
@@ -73,25 +83,28 @@ namespace algorithm
 #endif
         struct state_t
         {
-          std::mutex lock;
           traverse_visitor *visitor{nullptr};
+          bool want_symlinks{false};
 #if 0
-        struct workitem
-        {
-          std::shared_ptr<directory_handle> dirh;
-          filesystem::path _leaf;
-          workitem() {}
-          workitem(std::shared_ptr<directory_handle> _dirh, path_view leaf)
-              : dirh(std::move(_dirh))
-              , _leaf(leaf.path())
+          struct workitem
           {
-          }
-          path_view leaf() const noexcept { return _leaf; } 
-        };
+            std::shared_ptr<directory_handle> dirh;
+            filesystem::path _leaf;
+            size_t level{0};
+            workitem() {}
+            workitem(std::shared_ptr<directory_handle> _dirh, path_view leaf, size_t _level)
+                : dirh(std::move(_dirh))
+                , _leaf(leaf.path())
+                , level(_level)
+            {
+            }
+            path_view leaf() const noexcept { return _leaf; }
+          };
 #else
           struct workitem
           {
             std::shared_ptr<directory_handle> dirh;
+            size_t level{0};
             bool using_sso{true};
             uint8_t _sso_length{0};
             union {
@@ -99,8 +112,9 @@ namespace algorithm
               filesystem::path _alloc;
             };
             workitem() {}
-            workitem(std::shared_ptr<directory_handle> _dirh, path_view leaf)
+            workitem(std::shared_ptr<directory_handle> _dirh, path_view leaf, size_t _level)
                 : dirh(std::move(_dirh))
+                , level(_level)
             {
               if(!leaf.empty())
               {
@@ -128,18 +142,11 @@ namespace algorithm
                 using_sso = true;
               }
             }
-#ifdef _MSC_VER
-            // MSVC's list::splice() always copies :(
-            workitem(const workitem &o) noexcept
-                : workitem(const_cast<workitem &&>(std::move(o)))
-            {
-            }
-#else
             workitem(const workitem &) = delete;
-#endif
             workitem &operator=(const workitem &) = delete;
             workitem(workitem &&o) noexcept
                 : dirh(std::move(o.dirh))
+                , level(o.level)
                 , using_sso(o.using_sso)
                 , _sso_length(o._sso_length)
             {
@@ -168,56 +175,278 @@ namespace algorithm
             path_view leaf() const noexcept { return using_sso ? path_view(_sso, _sso_length, path_view::zero_terminated) : path_view(_alloc); }
           };
 #endif
-          std::vector<std::list<workitem>> workqueue;
-          size_t workqueue_base{0};
-          size_t dirs_processed{0}, known_dirs_remaining{0}, depth_processed{0}, threads_sleeping{0};
+          // Directories enqueued or being enumerated. Only reaches zero when the traversal is complete.
+          std::atomic<size_t> known_dirs_remaining{0};
+          // Directories in the queues of all the workers, which if bounded, no more are queued beyond
+          std::atomic<size_t> queued{0};
+          size_t max_queued{0};
+          std::atomic<size_t> dirs_processed{0}, depth_processed{0}, known_depth_remaining{1};
+          // The most entries any directory has needed so far, so workers size their buffers once
+          std::atomic<size_t> entries_high_water{4096};
+          std::atomic<bool> done{false};
+
+          // Only for idle workers to sleep upon, and to record the first failure
+          std::mutex lock;
+          std::condition_variable cond;
+          std::atomic<size_t> threads_sleeping{0};
+          optional<result<void>::error_type> run_error;
 
           explicit state_t(traverse_visitor *_visitor)
               : visitor(_visitor)
           {
           }
+
+          static void update_max(std::atomic<size_t> &v, size_t n) noexcept
+          {
+            size_t old = v.load(std::memory_order_relaxed);
+            while(old < n && !v.compare_exchange_weak(old, n, std::memory_order_relaxed))
+            {
+            }
+          }
         } state(visitor);
+        state.want_symlinks = visitor->want_symlinks(data);
+        /* Each worker owns a deque of work, its own enumerations being pushed onto its back.
+        The owner pops from the front for breadth first order, or from the back for depth
+        first order. Idle workers steal from the front of other workers' deques, which is
+        the shallowest and therefore usually largest subtree.
+
+        If the queues would hold more than `max_queued` directories, a worker instead keeps the
+        directories it discovers to itself and enumerates them depth first, handing the shallowest
+        back to its queue whenever the queues fall below half the bound, so other workers can
+        steal them.
+        */
         struct worker
         {
           state_t *state{nullptr};
+          bool depth_first{false};
+          io_multiplexer *multiplexer{nullptr};
+          std::mutex lock;
+          std::deque<state_t::workitem> queue;
+          std::vector<state_t::workitem> newwork;
+          // Directories kept back from the queue due to it exceeding the bound, deepest at the back
+          std::deque<state_t::workitem> kept;
           std::vector<directory_handle::buffer_type> entries{4096};
           directory_handle::buffers_type buffers;
+          // Only used with a multiplexer, to open directories and stat entries in batches
+          std::vector<path_view> leafs;
+          std::vector<result<directory_handle>> opened;
+#ifdef __linux__
+          std::vector<io_multiplexer::posix_fs_syscall> ops;
+          std::vector<path_view::c_str<char, std::default_delete<char[]>, 0>> zpaths;
+          std::vector<LLFIO_V2_NAMESPACE::detail::statx_t> statxs;
+#endif
+          // Only used if the visitor wants the contents of symbolic links
+          struct link_key_hash
+          {
+            size_t operator()(const std::pair<uint64_t, uint64_t> &k) const noexcept { return (size_t)(k.first * 0x9E3779B97F4A7C15ULL) ^ (size_t) k.second; }
+          };
+          std::unordered_map<std::pair<uint64_t, uint64_t>, result<filesystem::path>, link_key_hash> linkcache;
+          std::vector<directory_handle::buffer_type> links;
+          std::vector<path_view> linkleafs;
+          std::vector<size_t> linkuncached;
+          std::vector<const result<filesystem::path> *> linkfound;
+          std::vector<result<path_view>> linktargets;
+
+          // With a multiplexer, this many directories are opened in each batch
+          static constexpr size_t batch_size = 64;
 
-          explicit worker(state_t *_state)
+          explicit worker(state_t *_state, bool _depth_first, io_multiplexer *_multiplexer)
               : state(_state)
+              , depth_first(_depth_first)
+              , multiplexer(_multiplexer)
+          {
+          }
+
+          void push(state_t::workitem &&item)
+          {
+            std::lock_guard<std::mutex> g(lock);
+            queue.push_back(std::move(item));
+            state->queued.fetch_add(1, std::memory_order_relaxed);
+          }
+          // Pops one item of work, or a batch of them if there is a multiplexer
+          bool pop(std::vector<state_t::workitem> &out)
+          {
+            std::lock_guard<std::mutex> g(lock);
+            if(queue.empty())
+            {
+              return false;
+            }
+            const size_t max = (multiplexer != nullptr) ? batch_size : 1;
+            while(!queue.empty() && out.size() < max)
+            {
+              if(depth_first)
+              {
+                out.push_back(std::move(queue.back()));
+                queue.pop_back();
+              }
+              else
+              {
+                out.push_back(std::move(queue.front()));
+                queue.pop_front();
+              }
+            }
+            state->queued.fetch_sub(out.size(), std::memory_order_relaxed);
+            return true;
+          }
+          bool steal(std::vector<state_t::workitem> &out)
           {
+            std::unique_lock<std::mutex> g(lock, std::try_to_lock);
+            if(!g.owns_lock() || queue.empty())
+            {
+              return false;
+            }
+            out.push_back(std::move(queue.front()));
+            queue.pop_front();
+            state->queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
           }
 
-          result<void> run(std::unique_lock<std::mutex> &g, bool use_slow_path, std::shared_ptr<directory_handle> &topdirh, void *data)
+          // Enumerates the directories in mywork, enqueuing any directories within them
+          result<void> run(std::vector<state_t::workitem> &mywork, bool use_slow_path, std::shared_ptr<directory_handle> &topdirh, void *data)
           {
-            typename state_t::workitem mywork;
-            size_t mylevel = 0;
-            assert(g.owns_lock());
-            for(size_t n = state->workqueue_base; n < state->workqueue.size(); n++)
+            auto r = _open(mywork);
+            for(size_t n = 0; r && n < mywork.size(); n++)
+            {
+              r = _run(mywork[n], opened.empty() ? nullptr : &opened[n], use_slow_path, topdirh, data);
+            }
+            opened.clear();
+            size_t count = mywork.size();
+            mywork.clear();
+            while(r && !kept.empty())
             {
-              if(!state->workqueue[n].empty())
+              if(kept.size() > 1 && state->queued.load(std::memory_order_relaxed) * 2 < state->max_queued)
               {
-                mywork = std::move(state->workqueue[n].front());
-                state->workqueue[n].pop_front();
-                mylevel = n;
-                if(mylevel != state->depth_processed)
+                // The queues are running low, so let other workers steal our shallowest directory
+                push(std::move(kept.front()));
+                kept.pop_front();
+                _wake();
+                continue;
+              }
+              auto item = std::move(kept.back());
+              kept.pop_back();
+              r = _run(item, nullptr, use_slow_path, topdirh, data);
+              count++;
+            }
+            count += kept.size();  // abandoned due to failure
+            kept.clear();
+            // Children were counted before this, so zero means there is nothing left anywhere
+            if(count == state->known_dirs_remaining.fetch_sub(count, std::memory_order_acq_rel))
+            {
+              _wake();
+            }
+            return r;
+          }
+          void _wake()
+          {
+            if(state->threads_sleeping.load(std::memory_order_acquire) > 0)
+            {
+              std::lock_guard<std::mutex> g(state->lock);
+              state->cond.notify_all();
+            }
+          }
+          // Opens the directories in mywork sharing a parent as a batch using the multiplexer
+          result<void> _open(std::vector<state_t::workitem> &mywork)
+          {
+            if(multiplexer == nullptr || mywork.size() < 2)
+            {
+              return success();
+            }
+            log_level_guard gg(log_level::fatal);
+            opened.reserve(mywork.size());
+            for(size_t n = 0; n < mywork.size();)
+            {
+              if(mywork[n].leaf().empty())
+              {
+                opened.emplace_back(directory_handle());
+                n++;
+                continue;
+              }
+              size_t m = n;
+              leafs.clear();
+              for(; m < mywork.size() && mywork[m].dirh == mywork[n].dirh && !mywork[m].leaf().empty(); m++)
+              {
+                leafs.push_back(mywork[m].leaf());
+              }
+              OUTCOME_TRY(auto &&r, directory_handle::directories(*mywork[n].dirh, leafs, directory_handle::mode::read, directory_handle::creation::open_existing,
+                                                                  directory_handle::caching::all, directory_handle::flag::none, multiplexer));
+              for(auto &i : r)
+              {
+                opened.push_back(std::move(i));
+              }
+              n = m;
+            }
+            return success();
+          }
+          // Reads the contents of the symbolic links just enumerated as a batch, reusing any already read
+          result<void> _symlinks(const directory_handle &dirh, void *data, size_t mylevel)
+          {
+            links.clear();
+            for(auto &entry : buffers)
+            {
+              if(entry.stat.st_type == filesystem::file_type::symlink)
+              {
+                links.push_back(entry);
+              }
+            }
+            if(links.empty())
+            {
+              return success();
+            }
+            // Entries without inodes can't be cached, so they are read every time
+            const bool cacheable = !!(buffers.metadata() & stat_t::want::ino);
+            const auto devid = (uint64_t) dirh.st_dev();
+            linkleafs.clear();
+            linkuncached.clear();
+            linkfound.assign(links.size(), nullptr);
+            for(size_t n = 0; n < links.size(); n++)
+            {
+              if(cacheable)
+              {
+                auto it = linkcache.find({devid, (uint64_t) links[n].stat.st_ino});
+                if(it != linkcache.end())
                 {
-                  state->depth_processed = mylevel;
+                  linkfound[n] = &it->second;
+                  continue;
                 }
-                break;
               }
+              linkleafs.push_back(links[n].leafname);
+              linkuncached.push_back(n);
             }
-            if(!mywork.dirh)
+            std::vector<result<filesystem::path>> fresh;
+            if(!linkleafs.empty())
             {
-              return success();
+              OUTCOME_TRY(auto &&read, symlink_handle::read_links(dirh, linkleafs));
+              fresh = std::move(read);
+              for(size_t n = 0; cacheable && n < linkuncached.size(); n++)
+              {
+                const size_t idx = linkuncached[n];
+                auto it = linkcache.emplace(std::pair<uint64_t, uint64_t>(devid, (uint64_t) links[idx].stat.st_ino), std::move(fresh[n])).first;
+                linkfound[idx] = &it->second;
+              }
+              for(size_t n = 0; !cacheable && n < linkuncached.size(); n++)
+              {
+                linkfound[linkuncached[n]] = &fresh[n];
+              }
             }
-            if(mylevel > state->workqueue_base)
+            linktargets.clear();
+            for(auto *found : linkfound)
             {
-              state->workqueue_base = mylevel;
+              if(found->has_value())
+              {
+                linktargets.push_back(path_view(found->value()));
+              }
+              else
+              {
+                linktargets.push_back(result<path_view>(found->error()));
+              }
             }
-            state->dirs_processed++;
-            state->known_dirs_remaining--;
-            g.unlock();
+            return state->visitor->symlinks_enumerated(data, dirh, links, linktargets, mylevel);
+          }
+          result<void> _run(state_t::workitem &mywork, result<directory_handle> *preopened, bool use_slow_path, std::shared_ptr<directory_handle> &topdirh, void *data)
+          {
+            const size_t mylevel = mywork.level;
+            state_t::update_max(state->depth_processed, mylevel);
+            state->dirs_processed.fetch_add(1, std::memory_order_relaxed);
             std::shared_ptr<directory_handle> mydirh;
             if(mywork.leaf().empty())
             {
@@ -226,7 +455,7 @@ namespace algorithm
             else
             {
               log_level_guard gg(log_level::fatal);
-              auto r = directory_handle::directory(*mywork.dirh, mywork.leaf());
+              auto r = (preopened != nullptr) ? std::move(*preopened) : directory_handle::directory(*mywork.dirh, mywork.leaf());
               if(!r)
               {
                 OUTCOME_TRY(auto &&replacementh, state->visitor->directory_open_failed(data, std::move(r).error(), *mywork.dirh, mywork.leaf(), mylevel));
@@ -242,6 +471,11 @@ namespace algorithm
               OUTCOME_TRY(auto &&do_enumerate, state->visitor->pre_enumeration(data, *mydirh, mylevel));
               if(do_enumerate)
               {
+                const size_t high_water = state->entries_high_water.load(std::memory_order_relaxed);
+                if(entries.size() < high_water)
+                {
+                  entries.resize(high_water);
+                }
                 for(;;)
                 {
                   buffers = {entries, std::move(buffers)};
@@ -251,40 +485,78 @@ namespace algorithm
                     break;
                   }
                   entries.resize(entries.size() << 1);
+                  state_t::update_max(state->entries_high_water, entries.size());
                 }
                 if(!(buffers.metadata() & stat_t::want::type))
                 {
 #ifdef _WIN32
                   abort();  // this should never occur on Windows
 #else
-                  for(auto &entry : buffers)
+                  auto to_type = [](uint16_t mode) {
+                    switch(mode & S_IFMT)
+                    {
+                    case S_IFBLK:
+                      return filesystem::file_type::block;
+                    case S_IFCHR:
+                      return filesystem::file_type::character;
+                    case S_IFDIR:
+                      return filesystem::file_type::directory;
+                    case S_IFIFO:
+                      return filesystem::file_type::fifo;
+                    case S_IFLNK:
+                      return filesystem::file_type::symlink;
+                    case S_IFREG:
+                      return filesystem::file_type::regular;
+                    case S_IFSOCK:
+                      return filesystem::file_type::socket;
+                    default:
+                      return filesystem::file_type::unknown;
+                    }
+                  };
+#ifdef __linux__
+                  ops.clear();
+                  if(multiplexer != nullptr)
                   {
+                    // Fetch the type of every entry as one batch of statx
+                    using posix_fs_syscall = io_multiplexer::posix_fs_syscall;
+                    // Any zero terminated copies of leafnames come from this thread's arena, not the heap
+                    path_view_arena::scope arenascope(path_view_arena::this_thread());
+                    ops.resize(buffers.size());
+                    zpaths.clear();
+                    zpaths.reserve(buffers.size());
+                    statxs.resize(buffers.size());
+                    for(size_t n = 0; n < buffers.size(); n++)
+                    {
+                      zpaths.emplace_back(buffers[n].leafname, path_view::zero_terminated, arenascope.arena());
+                      auto &op = ops[n];
+                      op.op = posix_fs_syscall::kind::statx;
+                      op.fd = mydirh->native_handle().fd;
+                      op.path = zpaths[n].buffer;
+                      op.flags = AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW;
+                      op.mode = 0x00000001U /*STATX_TYPE*/;
+                      op.buffer = &statxs[n];
+                    }
+                    OUTCOME_TRY(multiplexer->do_posix_fs_syscalls(ops));
+                    zpaths.clear();
+                  }
+#endif
+                  for(size_t n = 0; n < buffers.size(); n++)
+                  {
+                    auto &entry = buffers[n];
+#ifdef __linux__
+                    if(n < ops.size() && ops[n].result >= 0)
+                    {
+                      entry.stat.st_type = to_type(statxs[n].stx_mode);
+                      continue;
+                    }
+                    // statx() may be unsupported by the kernel or the filing system, so fall back to fstatat()
+#endif
                     struct ::stat stat;
                     memset(&stat, 0, sizeof(stat));
                     path_view::c_str<> zpath(entry.leafname, path_view::zero_terminated);
                     if(::fstatat(mydirh->native_handle().fd, zpath.buffer, &stat, AT_SYMLINK_NOFOLLOW) >= 0)
                     {
-                      entry.stat.st_type = [](uint16_t mode) {
-                        switch(mode & S_IFMT)
-                        {
-                        case S_IFBLK:
-                          return filesystem::file_type::block;
-                        case S_IFCHR:
-                          return filesystem::file_type::character;
-                        case S_IFDIR:
-                          return filesystem::file_type::directory;
-                        case S_IFIFO:
-                          return filesystem::file_type::fifo;
-                        case S_IFLNK:
-                          return filesystem::file_type::symlink;
-                        case S_IFREG:
-                          return filesystem::file_type::regular;
-                        case S_IFSOCK:
-                          return filesystem::file_type::socket;
-                        default:
-                          return filesystem::file_type::unknown;
-                        }
-                      }(stat.st_mode);
+                      entry.stat.st_type = to_type(stat.st_mode);
                     }
                     else
                     {
@@ -294,166 +566,159 @@ namespace algorithm
 #endif
                 }
                 OUTCOME_TRY(state->visitor->post_enumeration(data, *mydirh, buffers, mylevel));
-                std::list<state_t::workitem> newwork;
+                if(state->want_symlinks)
+                {
+                  OUTCOME_TRY(_symlinks(*mydirh, data, mylevel));
+                }
+                newwork.clear();
                 for(auto &entry : buffers)
                 {
-                  int entry_type = 0;  // 0 = unknown, 1 = file, 2 = directory
-                  switch(entry.stat.st_type)
-                  {
-                  case filesystem::file_type::directory:
-                    entry_type = 2;
-                    break;
-                  case filesystem::file_type::regular:
-                  case filesystem::file_type::symlink:
-                  case filesystem::file_type::block:
-                  case filesystem::file_type::character:
-                  case filesystem::file_type::fifo:
-                  case filesystem::file_type::socket:
-                    entry_type = 1;
-                    break;
-                  default:
-                    break;
-                  }
-                  if(2 == entry_type)
+                  if(entry.stat.st_type == filesystem::file_type::directory)
                   {
                     if(use_slow_path)
                     {
-                      newwork.push_back(state_t::workitem(topdirh, mywork.leaf() / entry.leafname));
+                      newwork.push_back(state_t::workitem(topdirh, mywork.leaf() / entry.leafname, mylevel + 1));
                     }
                     else
                     {
-                      newwork.push_back(state_t::workitem(mydirh, entry.leafname));
+                      newwork.push_back(state_t::workitem(mydirh, entry.leafname, mylevel + 1));
                     }
                   }
                 }
-                g.lock();
-                state->known_dirs_remaining += newwork.size();
-                if(state->workqueue.size() < mylevel + 2)
+                if(!newwork.empty())
                 {
-                  state->workqueue.emplace_back();
-                }
-                state->workqueue[mylevel + 1].splice(state->workqueue[mylevel + 1].end(), std::move(newwork));
-                if(mylevel + 1 < state->workqueue_base)
-                {
-                  state->workqueue_base = mylevel + 1;
+                  state->known_dirs_remaining.fetch_add(newwork.size(), std::memory_order_acq_rel);
+                  state_t::update_max(state->known_depth_remaining, mylevel + 2);
+                  if(state->max_queued != 0 && state->queued.load(std::memory_order_relaxed) + newwork.size() > state->max_queued)
+                  {
+                    // Enumerate these ourselves after this directory, deepest first
+                    for(auto &i : newwork)
+                    {
+                      kept.push_back(std::move(i));
+                    }
+                    newwork.clear();
+                  }
+                  else
+                  {
+                    {
+                      std::lock_guard<std::mutex> g(lock);
+                      for(auto &i : newwork)
+                      {
+                        queue.push_back(std::move(i));
+                      }
+                    }
+                    state->queued.fetch_add(newwork.size(), std::memory_order_relaxed);
+                    newwork.clear();
+                    _wake();
+                  }
                 }
-                size_t dirs_processed = state->dirs_processed, known_dirs_remaining = state->known_dirs_remaining, depth_processed = state->depth_processed,
-                       known_depth_remaining = state->workqueue.size();
-                g.unlock();
-                OUTCOME_TRY(state->visitor->stack_updated(data, dirs_processed, known_dirs_remaining, depth_processed, known_depth_remaining));
+                OUTCOME_TRY(state->visitor->stack_updated(data, state->dirs_processed.load(std::memory_order_relaxed),
+                                                          state->known_dirs_remaining.load(std::memory_order_relaxed) - 1,
+                                                          state->depth_processed.load(std::memory_order_relaxed),
+                                                          state->known_depth_remaining.load(std::memory_order_relaxed)));
               }
             }
             return success();
           }
         };
-        state.workqueue.emplace_back();
-        state.workqueue.front().push_back(state_t::workitem(topdirh, {}));
+        if(0 == threads)
+        {
+          threads = utils::tuning().traverse_threads;
+        }
+        if(0 == threads)
+        {
+          // Filesystems are generally only concurrent to the real CPU count
+          threads = std::thread::hardware_concurrency() / 2;
+          if(threads < 4)
+          {
+            threads = 4;
+          }
+        }
+        state.max_queued = max_queued;
+        std::vector<std::unique_ptr<worker>> workers;
+        workers.reserve(threads);
+        workers.push_back(std::make_unique<worker>(&state, depth_first, multiplexer));
         state.known_dirs_remaining = 1;
-        worker firstworker(&state);
+        workers.front()->push(state_t::workitem(topdirh, {}, 0));
         {
-          std::unique_lock<std::mutex> g(state.lock);
+          std::vector<state_t::workitem> mywork;
           for(size_t n = 0; state.known_dirs_remaining > 0 && (threads == 1 || n < 4); n++)
           {
-            if(!g.owns_lock())
+            if(!workers.front()->pop(mywork))
             {
-              g.lock();
+              break;
             }
-            OUTCOME_TRY(firstworker.run(g, use_slow_path, topdirh, data));
+            OUTCOME_TRY(workers.front()->run(mywork, use_slow_path, topdirh, data));
           }
         }
         if(state.known_dirs_remaining > 0)
         {
-          // Fire up the threadpool
-          if(0 == threads)
-          {
-            // Filesystems are generally only concurrent to the real CPU count
-            threads = std::thread::hardware_concurrency() / 2;
-            if(threads < 4)
-            {
-              threads = 4;
-            }
-          }
-          std::vector<worker> workers;
-          workers.reserve(threads);
-          workers.push_back(std::move(firstworker));
+          // Fire up the threadpool, which steals work from the first worker to begin with
           for(size_t n = 1; n < threads; n++)
           {
-            workers.push_back(worker(&state));
+            workers.push_back(std::make_unique<worker>(&state, depth_first, multiplexer));
           }
           std::vector<std::thread> workerthreads;
           workerthreads.reserve(threads);
-          std::condition_variable cond, maincond;
-          bool done = false;
-          optional<result<void>::error_type> run_error;
           for(size_t n = 0; n < threads; n++)
           {
             workerthreads.push_back(std::thread(
-            [&](worker *w) {
-              std::unique_lock<std::mutex> g(state.lock);
-              while(!done)
+            [&](size_t idx) {
+              worker *w = workers[idx].get();
+              std::vector<state_t::workitem> mywork;
+              while(!state.done.load(std::memory_order_acquire))
               {
-                if(state.known_dirs_remaining == 0)
+                bool found = w->pop(mywork);
+                for(size_t i = 1; !found && i < threads; i++)
                 {
-                  // sleep
-                  state.threads_sleeping++;
-                  maincond.notify_all();
-                  cond.wait(g);
-                  if(done)
+                  found = workers[(idx + i) % threads]->steal(mywork);
+                }
+                if(found)
+                {
+                  auto r = w->run(mywork, use_slow_path, topdirh, data);
+                  if(!r)
                   {
+                    std::lock_guard<std::mutex> g(state.lock);
+                    if(!state.run_error)
+                    {
+                      state.run_error = std::move(r).error();
+                    }
+                    state.done.store(true, std::memory_order_release);
+                    state.cond.notify_all();
                     break;
                   }
-                  state.threads_sleeping--;
-                }
-                else
-                {
-                  // wake everybody
-                  cond.notify_all();
-                }
-                auto r = w->run(g, use_slow_path, topdirh, data);
-                if(!g.owns_lock())
-                {
-                  g.lock();
+                  continue;
                 }
-                if(!r)
+                if(state.known_dirs_remaining.load(std::memory_order_acquire) == 0)
                 {
-                  done = true;
-                  if(!run_error)
-                  {
-                    run_error = std::move(r).error();
-                  }
                   break;
                 }
+                // Other workers are still enumerating, so sleep until they enqueue more. The
+                // timeout covers the window between failing to steal and beginning to sleep.
+                std::unique_lock<std::mutex> g(state.lock);
+                state.threads_sleeping.fetch_add(1, std::memory_order_acq_rel);
+                state.cond.wait_for(g, std::chrono::milliseconds(1));
+                state.threads_sleeping.fetch_sub(1, std::memory_order_acq_rel);
               }
-              state.threads_sleeping++;
-              maincond.notify_all();
             },
-            &workers[n]));
-          }
-          {
-            std::unique_lock<std::mutex> g(state.lock);
-            while(state.threads_sleeping < threads)
-            {
-              maincond.wait(g);
-            }
-            done = true;
-            cond.notify_all();
+            n));
           }
           for(auto &i : workerthreads)
           {
             i.join();
           }
-          if(run_error)
+          if(state.run_error)
           {
-            return std::move(*run_error);
+            return std::move(*state.run_error);
           }
         }
 #ifndef NDEBUG
-        for(auto &i : state.workqueue)
+        for(auto &i : workers)
         {
-          assert(i.empty());
+          assert(i->queue.empty());
         }
 #endif
-        return state.dirs_processed;
+        return state.dirs_processed.load(std::memory_order_relaxed);
       }
       catch(...)
       {
@@ -461,6 +726,176 @@ namespace algorithm
       }
     }());
   }
+
+#ifdef _WIN32
+  namespace detail
+  {
+    // The Windows 8 additions to winioctl.h, which we can't rely on when targeting Windows 7
+    struct mft_enum_data_v1
+    {
+      DWORDLONG StartFileReferenceNumber;
+      USN LowUsn;
+      USN HighUsn;
+      WORD MinMajorVersion;
+      WORD MaxMajorVersion;
+    };
+    struct usn_record_common_header
+    {
+      DWORD RecordLength;
+      WORD MajorVersion;
+      WORD MinorVersion;
+    };
+    struct usn_record_v3
+    {
+      DWORD RecordLength;
+      WORD MajorVersion;
+      WORD MinorVersion;
+      BYTE FileReferenceNumber[16];
+      BYTE ParentFileReferenceNumber[16];
+      USN Usn;
+      LARGE_INTEGER TimeStamp;
+      DWORD Reason;
+      DWORD SourceInfo;
+      DWORD SecurityId;
+      DWORD FileAttributes;
+      WORD FileNameLength;
+      WORD FileNameOffset;
+      WCHAR FileName[1];
+    };
+  }  // namespace detail
+#endif
+
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> enumerate_volume(const path_handle &onvolume, enumerate_volume_callback callback, size_t kernel_buffer_size) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(&onvolume);
+#ifdef _WIN32
+    windows_nt_kernel::init();
+    using namespace windows_nt_kernel;
+    try
+    {
+      statfs_t sfs;
+      OUTCOME_TRY(sfs.fill(onvolume, statfs_t::want::fstypename | statfs_t::want::mntfromname));
+      if(sfs.f_fstypename != "NTFS" && sfs.f_fstypename != "ReFS")
+      {
+        return errc::operation_not_supported;
+      }
+      // f_mntfromname is the NT kernel path of the volume device
+      OUTCOME_TRY(auto &&volumeh, file_handle::file({}, sfs.f_mntfromname, file_handle::mode::read));
+      if(kernel_buffer_size < 65536)
+      {
+        kernel_buffer_size = 65536;
+      }
+      std::unique_ptr<char[]> buffer(new char[kernel_buffer_size]);  // don't initialise
+      std::vector<volume_entry> entries;
+      entries.reserve(kernel_buffer_size / (sizeof(USN_RECORD_V2) + 16));
+      // Ask for version 3 records, which ReFS requires for its 128 bit file ids
+      detail::mft_enum_data_v1 med{};
+      memset(&med, 0, sizeof(med));
+      med.StartFileReferenceNumber = 0;
+      med.LowUsn = 0;
+      med.HighUsn = MAXLONGLONG;
+      med.MinMajorVersion = 2;
+      med.MaxMajorVersion = 3;
+      auto to_type = [](DWORD attributes) {
+        if(attributes & FILE_ATTRIBUTE_REPARSE_POINT)
+        {
+          return filesystem::file_type::symlink;
+        }
+        return (attributes & FILE_ATTRIBUTE_DIRECTORY) ? filesystem::file_type::directory : filesystem::file_type::regular;
+      };
+      size_t ret = 0;
+      for(;;)
+      {
+        DWORD bytesout = 0;
+        OVERLAPPED ol{};
+        memset(&ol, 0, sizeof(ol));
+        ol.Internal = static_cast<ULONG_PTR>(-1);
+        if(DeviceIoControl(volumeh.native_handle().h, FSCTL_ENUM_USN_DATA, &med, sizeof(med), buffer.get(), static_cast<DWORD>(kernel_buffer_size), &bytesout,
+                           &ol) == 0)
+        {
+          const DWORD errcode = GetLastError();
+          if(ERROR_HANDLE_EOF == errcode)
+          {
+            break;
+          }
+          if(ERROR_IO_PENDING != errcode)
+          {
+            if(ERROR_INVALID_FUNCTION == errcode)
+            {
+              return errc::operation_not_supported;
+            }
+            return win32_error(errcode);
+          }
+          NTSTATUS ntstat = ntwait(volumeh.native_handle().h, ol, deadline());
+          if(0xC0000011 /*STATUS_END_OF_FILE*/ == ntstat)
+          {
+            break;
+          }
+          if(ntstat != 0)
+          {
+            return ntkernel_error(ntstat);
+          }
+          bytesout = static_cast<DWORD>(ol.InternalHigh);
+        }
+        if(bytesout <= sizeof(USN))
+        {
+          break;
+        }
+        // The output begins with the file reference to continue from, followed by the records
+        memcpy(&med.StartFileReferenceNumber, buffer.get(), sizeof(USN));
+        entries.clear();
+        for(DWORD offset = sizeof(USN); offset < bytesout;)
+        {
+          auto *record = reinterpret_cast<detail::usn_record_common_header *>(buffer.get() + offset);
+          if(record->RecordLength == 0)
+          {
+            break;
+          }
+          volume_entry entry;
+          if(record->MajorVersion == 2)
+          {
+            auto *r = reinterpret_cast<USN_RECORD_V2 *>(record);
+            entry.id[0] = r->FileReferenceNumber;
+            entry.id[1] = 0;
+            entry.parent_id[0] = r->ParentFileReferenceNumber;
+            entry.parent_id[1] = 0;
+            entry.type = to_type(r->FileAttributes);
+            entry.leafname = path_view(reinterpret_cast<const wchar_t *>(reinterpret_cast<const char *>(r) + r->FileNameOffset), r->FileNameLength / sizeof(wchar_t),
+                                       path_view::not_zero_terminated);
+            entries.push_back(entry);
+          }
+          else if(record->MajorVersion == 3)
+          {
+            auto *r = reinterpret_cast<detail::usn_record_v3 *>(record);
+            memcpy(entry.id, r->FileReferenceNumber, sizeof(entry.id));
+            memcpy(entry.parent_id, r->ParentFileReferenceNumber, sizeof(entry.parent_id));
+            entry.type = to_type(r->FileAttributes);
+            entry.leafname = path_view(reinterpret_cast<const wchar_t *>(reinterpret_cast<const char *>(r) + r->FileNameOffset), r->FileNameLength / sizeof(wchar_t),
+                                       path_view::not_zero_terminated);
+            entries.push_back(entry);
+          }
+          offset += record->RecordLength;
+        }
+        ret += entries.size();
+        OUTCOME_TRY(auto &&keepgoing, callback(entries));
+        if(!keepgoing)
+        {
+          break;
+        }
+      }
+      return ret;
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+#else
+    (void) onvolume;
+    (void) callback;
+    (void) kernel_buffer_size;
+    return errc::operation_not_supported;
+#endif
+  }
 }  // namespace algorithm
 
 LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,123 @@
+/* A handle to a block device
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../../../block_device_handle.hpp"
+#include "import.hpp"
+
+#include <winioctl.h>
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  inline result<void> block_device_ioctl(HANDLE h, DWORD code, const void *in, DWORD inlen, void *out, DWORD outlen) noexcept
+  {
+    windows_nt_kernel::init();
+    using namespace windows_nt_kernel;
+    OVERLAPPED ol{};
+    memset(&ol, 0, sizeof(ol));
+    ol.Internal = static_cast<ULONG_PTR>(-1);
+    if(DeviceIoControl(h, code, const_cast<void *>(in), inlen, out, outlen, nullptr, &ol) == 0)
+    {
+      const DWORD errcode = GetLastError();
+      if(ERROR_IO_PENDING != errcode)
+      {
+        return win32_error(errcode);
+      }
+      NTSTATUS ntstat = ntwait(h, ol, deadline());
+      if(ntstat != 0)
+      {
+        return ntkernel_error(ntstat);
+      }
+    }
+    return success();
+  }
+}  // namespace detail
+
+result<void> block_device_handle::_fetch_geometry() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  _geometry = geometry_type();
+  // Regular files do not have a length in the sense of a disk
+  GET_LENGTH_INFORMATION gli{};
+  auto r = detail::block_device_ioctl(_v.h, IOCTL_DISK_GET_LENGTH_INFO, nullptr, 0, &gli, sizeof(gli));
+  if(!r)
+  {
+    if(r.error() == errc::function_not_supported || r.error() == errc::invalid_argument)
+    {
+      return errc::no_such_device;
+    }
+    return std::move(r).error();
+  }
+  _geometry.size = (extent_type) gli.Length.QuadPart;
+  STORAGE_PROPERTY_QUERY spq{};
+  memset(&spq, 0, sizeof(spq));
+  spq.PropertyId = StorageAccessAlignmentProperty;
+  spq.QueryType = PropertyStandardQuery;
+  STORAGE_ACCESS_ALIGNMENT_DESCRIPTOR saad{};
+  if(detail::block_device_ioctl(_v.h, IOCTL_STORAGE_QUERY_PROPERTY, &spq, sizeof(spq), &saad, sizeof(saad)))
+  {
+    _geometry.logical_block_size = saad.BytesPerLogicalSector;
+    _geometry.physical_block_size = saad.BytesPerPhysicalSector;
+  }
+  else
+  {
+    // Not all drivers implement the alignment property, but all implement the drive geometry
+    DISK_GEOMETRY dg{};
+    OUTCOME_TRY(detail::block_device_ioctl(_v.h, IOCTL_DISK_GET_DRIVE_GEOMETRY, nullptr, 0, &dg, sizeof(dg)));
+    _geometry.logical_block_size = _geometry.physical_block_size = dg.BytesPerSector;
+  }
+  spq.PropertyId = StorageAdapterProperty;
+  STORAGE_ADAPTER_DESCRIPTOR sad{};
+  if(detail::block_device_ioctl(_v.h, IOCTL_STORAGE_QUERY_PROPERTY, &spq, sizeof(spq), &sad, sizeof(sad)))
+  {
+    _geometry.max_transfer = sad.MaximumTransferLength;
+  }
+  return success();
+}
+
+result<span<block_device_handle::zone>> block_device_handle::zones(span<zone> out, extent_type offset) const noexcept
+{
+  (void) out;
+  (void) offset;
+  return errc::operation_not_supported;
+}
+
+result<void> block_device_handle::manage_zones(zone_operation op, extent_pair extent) noexcept
+{
+  (void) op;
+  (void) extent;
+  return errc::operation_not_supported;
+}
+
+result<block_device_handle::extent_type> block_device_handle::zone_append(extent_type zone_offset, const_buffers_type buffers, deadline d) noexcept
+{
+  (void) zone_offset;
+  (void) buffers;
+  (void) d;
+  return errc::operation_not_supported;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,531 @@
+/* A handle to a byte-orientated socket
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../byte_socket_handle.hpp"
+#include "import.hpp"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+static_assert(sizeof(SOCKADDR_STORAGE) <= 128, "SOCKADDR_STORAGE does not fit into socket_address");
+
+namespace detail
+{
+  // afunix.h is not in older Windows SDKs
+  struct sockaddr_un
+  {
+    ADDRESS_FAMILY sun_family;
+    char sun_path[108];
+  };
+
+  // Winsock must be initialised before first use, and is never deinitialised
+  inline result<void> winsock_init() noexcept
+  {
+    static const int ret = [] {
+      WSADATA wd;
+      return WSAStartup(MAKEWORD(2, 2), &wd);
+    }();
+    if(ret != 0)
+    {
+      return win32_error((DWORD) ret);
+    }
+    return success();
+  }
+  inline int socket_family_to_af(socket_address::family_type family) noexcept
+  {
+    switch(family)
+    {
+    case socket_address::family_type::v4:
+      return AF_INET;
+    case socket_address::family_type::v6:
+      return AF_INET6;
+    case socket_address::family_type::local:
+      return AF_UNIX;
+    case socket_address::family_type::unknown:
+      break;
+    }
+    return -1;
+  }
+  // Sets the disposition of a socket from its mode and flags
+  inline result<void> socket_behaviour_from_mode_and_flags(native_handle_type &nativeh, handle::mode _mode, handle::flag flags) noexcept
+  {
+    nativeh.behaviour |= native_handle_type::disposition::socket;
+    switch(_mode)
+    {
+    case handle::mode::read:
+      nativeh.behaviour |= native_handle_type::disposition::readable;
+      break;
+    case handle::mode::write:
+      nativeh.behaviour |= native_handle_type::disposition::readable | native_handle_type::disposition::writable;
+      break;
+    case handle::mode::append:
+      nativeh.behaviour |= native_handle_type::disposition::writable;
+      break;
+    default:
+      return errc::invalid_argument;
+    }
+    if(!!(flags & handle::flag::multiplexable))
+    {
+      nativeh.behaviour |= native_handle_type::disposition::nonblocking;
+    }
+    return success();
+  }
+  // Creates a non-inheritable stream socket, OVERLAPPED if so disposed
+  inline result<SOCKET> create_stream_socket(int af, const native_handle_type &nativeh) noexcept
+  {
+    OUTCOME_TRY(winsock_init());
+    const SOCKET s = WSASocketW(af, SOCK_STREAM, 0, nullptr, 0, WSA_FLAG_NO_HANDLE_INHERIT | (nativeh.is_nonblocking() ? WSA_FLAG_OVERLAPPED : 0));
+    if(INVALID_SOCKET == s)
+    {
+      return win32_error(WSAGetLastError());
+    }
+    return s;
+  }
+  // Disables Nagle's algorithm on TCP sockets
+  inline void socket_set_nodelay(SOCKET s, int af) noexcept
+  {
+    if(af == AF_INET || af == AF_INET6)
+    {
+      BOOL one = 1;
+      (void) setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *) &one, sizeof(one));
+    }
+  }
+  // Sets or clears Winsock's non-blocking mode, which is independent of OVERLAPPED i/o
+  inline result<void> socket_set_nonblocking(SOCKET s, bool enable) noexcept
+  {
+    u_long v = enable ? 1 : 0;
+    if(SOCKET_ERROR == ioctlsocket(s, FIONBIO, &v))
+    {
+      return win32_error(WSAGetLastError());
+    }
+    return success();
+  }
+  // Waits until the socket is ready for `events`, or `d` expires, returning whether it is ready
+  inline result<bool> socket_poll(SOCKET s, short events, deadline d, std::chrono::steady_clock::time_point began_steady) noexcept
+  {
+    INT mstimeout = -1;
+    if(d)
+    {
+      std::chrono::milliseconds ms;
+      LLFIO_DEADLINE_TO_PARTIAL_TIMEOUT(ms, d);
+      mstimeout = (INT) ms.count();
+    }
+    WSAPOLLFD p;
+    memset(&p, 0, sizeof(p));
+    p.fd = s;
+    p.events = events;
+    const int ret = WSAPoll(&p, 1, mstimeout);
+    if(SOCKET_ERROR == ret)
+    {
+      return win32_error(WSAGetLastError());
+    }
+    return ret > 0;
+  }
+}  // namespace detail
+
+/******************************************* socket_address *********************************************/
+
+socket_address::family_type socket_address::family() const noexcept
+{
+  if(_len == 0)
+  {
+    return family_type::unknown;
+  }
+  switch(reinterpret_cast<const sockaddr *>(_storage)->sa_family)
+  {
+  case AF_INET:
+    return family_type::v4;
+  case AF_INET6:
+    return family_type::v6;
+  case AF_UNIX:
+    return family_type::local;
+  default:
+    return family_type::unknown;
+  }
+}
+
+uint16_t socket_address::port() const noexcept
+{
+  switch(family())
+  {
+  case family_type::v4:
+    return ntohs(reinterpret_cast<const sockaddr_in *>(_storage)->sin_port);
+  case family_type::v6:
+    return ntohs(reinterpret_cast<const sockaddr_in6 *>(_storage)->sin6_port);
+  default:
+    return 0;
+  }
+}
+
+bool socket_address::is_loopback() const noexcept
+{
+  switch(family())
+  {
+  case family_type::v4:
+    return (ntohl(reinterpret_cast<const sockaddr_in *>(_storage)->sin_addr.s_addr) >> 24) == 127;
+  case family_type::v6:
+    return IN6_IS_ADDR_LOOPBACK(&reinterpret_cast<const sockaddr_in6 *>(_storage)->sin6_addr) != 0;
+  default:
+    return false;
+  }
+}
+
+result<socket_address> socket_address::ip(string_view address, uint16_t port) noexcept
+{
+  OUTCOME_TRY(detail::winsock_init());
+  char buffer[INET6_ADDRSTRLEN + 1];
+  if(address.size() >= sizeof(buffer))
+  {
+    return errc::invalid_argument;
+  }
+  memcpy(buffer, address.data(), address.size());
+  buffer[address.size()] = 0;
+  socket_address ret;
+  memset(ret._storage, 0, sizeof(ret._storage));
+  auto *v4 = reinterpret_cast<sockaddr_in *>(ret._storage);
+  auto *v6 = reinterpret_cast<sockaddr_in6 *>(ret._storage);
+  if(1 == inet_pton(AF_INET, buffer, &v4->sin_addr))
+  {
+    v4->sin_family = AF_INET;
+    v4->sin_port = htons(port);
+    ret._len = sizeof(sockaddr_in);
+    return ret;
+  }
+  if(1 == inet_pton(AF_INET6, buffer, &v6->sin6_addr))
+  {
+    v6->sin6_family = AF_INET6;
+    v6->sin6_port = htons(port);
+    ret._len = sizeof(sockaddr_in6);
+    return ret;
+  }
+  return errc::invalid_argument;
+}
+
+result<socket_address> socket_address::loopback(family_type family, uint16_t port) noexcept
+{
+  switch(family)
+  {
+  case family_type::v4:
+    return ip("127.0.0.1", port);
+  case family_type::v6:
+    return ip("::1", port);
+  default:
+    return errc::invalid_argument;
+  }
+}
+
+result<socket_address> socket_address::any(family_type family, uint16_t port) noexcept
+{
+  switch(family)
+  {
+  case family_type::v4:
+    return ip("0.0.0.0", port);
+  case family_type::v6:
+    return ip("::", port);
+  default:
+    return errc::invalid_argument;
+  }
+}
+
+result<socket_address> socket_address::local(path_view path) noexcept
+{
+  try
+  {
+    path_view::c_str<char> zpath(path, path_view::zero_terminated);
+    socket_address ret;
+    memset(ret._storage, 0, sizeof(ret._storage));
+    auto *un = reinterpret_cast<detail::sockaddr_un *>(ret._storage);
+    if(zpath.length >= sizeof(un->sun_path))
+    {
+      return errc::filename_too_long;
+    }
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, zpath.buffer, zpath.length);
+    ret._len = (uint32_t) (offsetof(detail::sockaddr_un, sun_path) + zpath.length + 1);
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+/******************************************* byte_socket_handle *********************************************/
+
+result<byte_socket_handle> byte_socket_handle::byte_socket(family_type family, mode _mode, caching _caching, flag flags) noexcept
+{
+  result<byte_socket_handle> ret(byte_socket_handle(native_handle_type(), _caching, flags, nullptr));
+  native_handle_type &nativeh = ret.value()._v;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  const int af = detail::socket_family_to_af(family);
+  if(af < 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(nativeh, _mode, flags));
+  OUTCOME_TRY(auto &&s, detail::create_stream_socket(af, nativeh));
+  nativeh.h = (HANDLE) s;
+  detail::socket_set_nodelay(s, af);
+  return ret;
+}
+
+result<std::pair<byte_socket_handle, byte_socket_handle>> byte_socket_handle::anonymous_socket_pair(caching _caching, flag flags) noexcept
+{
+  // Windows has no socketpair(), so connect to a listener on an ephemeral loopback port
+  LLFIO_LOG_FUNCTION_CALL(nullptr);
+  OUTCOME_TRY(auto &&addr, socket_address::loopback(family_type::v4, 0));
+  OUTCOME_TRY(auto &&listener, listening_byte_socket_handle::listening_byte_socket(addr, mode::write, _caching, flags, 1));
+  OUTCOME_TRY(auto &&listenaddr, listener.local_endpoint());
+  OUTCOME_TRY(auto &&a, byte_socket(family_type::v4, mode::write, _caching, flags));
+  const deadline d = !!(flags & flag::multiplexable) ? deadline(std::chrono::seconds(30)) : deadline();
+  OUTCOME_TRY(a.connect(listenaddr, d));
+  OUTCOME_TRY(auto &&b, listener.accept(d));
+  // Check that nobody else connected to our listener in the meantime
+  OUTCOME_TRY(auto &&aaddr, a.local_endpoint());
+  OUTCOME_TRY(auto &&baddr, b.remote_endpoint());
+  if(aaddr.size() != baddr.size() || 0 != memcmp(aaddr.data(), baddr.data(), aaddr.size()))
+  {
+    return errc::connection_aborted;
+  }
+  return {std::pair<byte_socket_handle, byte_socket_handle>(std::move(a), std::move(b))};
+}
+
+result<void> byte_socket_handle::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_v)
+  {
+    if(_ctx != nullptr)
+    {
+      OUTCOME_TRY(set_multiplexer(nullptr));
+    }
+    // Sockets must be closed using closesocket(), not CloseHandle()
+    if(SOCKET_ERROR == closesocket((SOCKET) _v.h))
+    {
+      return win32_error(WSAGetLastError());
+    }
+    _v = native_handle_type();
+  }
+  return success();
+}
+
+result<void> byte_socket_handle::connect(const socket_address &addr, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+  const SOCKET s = (SOCKET) _v.h;
+  if(!d)
+  {
+    if(SOCKET_ERROR == ::connect(s, reinterpret_cast<const sockaddr *>(addr._storage), (int) addr._len))
+    {
+      return win32_error(WSAGetLastError());
+    }
+    return success();
+  }
+  // Winsock's non-blocking mode is only enabled for the duration of the connect
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  OUTCOME_TRY(detail::socket_set_nonblocking(s, true));
+  auto unset = make_scope_exit([s]() noexcept { (void) detail::socket_set_nonblocking(s, false); });
+  if(SOCKET_ERROR != ::connect(s, reinterpret_cast<const sockaddr *>(addr._storage), (int) addr._len))
+  {
+    return success();
+  }
+  if(WSAEWOULDBLOCK != WSAGetLastError())
+  {
+    return win32_error(WSAGetLastError());
+  }
+  for(;;)
+  {
+    OUTCOME_TRY(auto &&ready, detail::socket_poll(s, POLLWRNORM, d, began_steady));
+    if(ready)
+    {
+      int error = 0;
+      int len = sizeof(error);
+      if(SOCKET_ERROR == getsockopt(s, SOL_SOCKET, SO_ERROR, (char *) &error, &len))
+      {
+        return win32_error(WSAGetLastError());
+      }
+      if(error != 0)
+      {
+        return win32_error((DWORD) error);
+      }
+      return success();
+    }
+    LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+  }
+}
+
+result<socket_address> byte_socket_handle::local_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  int len = (int) sizeof(ret._storage);
+  if(SOCKET_ERROR == getsockname((SOCKET) _v.h, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<socket_address> byte_socket_handle::remote_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  int len = (int) sizeof(ret._storage);
+  if(SOCKET_ERROR == getpeername((SOCKET) _v.h, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<void> byte_socket_handle::shutdown(shutdown_kind kind) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  const int how = (kind == shutdown_kind::read) ? SD_RECEIVE : (kind == shutdown_kind::write) ? SD_SEND : SD_BOTH;
+  if(SOCKET_ERROR == ::shutdown((SOCKET) _v.h, how))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  return success();
+}
+
+/******************************************* listening_byte_socket_handle *********************************************/
+
+result<listening_byte_socket_handle> listening_byte_socket_handle::listening_byte_socket(const socket_address &addr, mode _mode, caching _caching, flag flags, int backlog) noexcept
+{
+  result<listening_byte_socket_handle> ret(listening_byte_socket_handle(native_handle_type(), _caching, flags));
+  native_handle_type &nativeh = ret.value()._v;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  const int af = detail::socket_family_to_af(addr.family());
+  if(af < 0)
+  {
+    return errc::invalid_argument;
+  }
+  OUTCOME_TRY(detail::socket_behaviour_from_mode_and_flags(nativeh, _mode, flags));
+  OUTCOME_TRY(auto &&s, detail::create_stream_socket(af, nativeh));
+  nativeh.h = (HANDLE) s;
+  if(af != AF_UNIX)
+  {
+    // Unlike SO_REUSEADDR on Windows, this prevents other processes from stealing our port
+    BOOL one = 1;
+    (void) setsockopt(s, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, (const char *) &one, sizeof(one));
+  }
+  if(SOCKET_ERROR == bind(s, reinterpret_cast<const sockaddr *>(addr.data()), (int) addr.size()))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  if(SOCKET_ERROR == listen(s, (backlog < 0) ? SOMAXCONN : backlog))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  if(nativeh.is_nonblocking())
+  {
+    // So accept() can take a deadline. Accepted sockets inherit this, so it is cleared on them.
+    OUTCOME_TRY(detail::socket_set_nonblocking(s, true));
+  }
+  return ret;
+}
+
+result<void> listening_byte_socket_handle::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_v)
+  {
+    // Sockets must be closed using closesocket(), not CloseHandle()
+    if(SOCKET_ERROR == closesocket((SOCKET) _v.h))
+    {
+      return win32_error(WSAGetLastError());
+    }
+    _v = native_handle_type();
+  }
+  return success();
+}
+
+result<socket_address> listening_byte_socket_handle::local_endpoint() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  socket_address ret;
+  int len = (int) sizeof(ret._storage);
+  if(SOCKET_ERROR == getsockname((SOCKET) _v.h, reinterpret_cast<sockaddr *>(ret._storage), &len))
+  {
+    return win32_error(WSAGetLastError());
+  }
+  ret._len = (uint32_t) len;
+  return ret;
+}
+
+result<byte_socket_handle> listening_byte_socket_handle::accept(deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(d && !_v.is_nonblocking())
+  {
+    return errc::not_supported;
+  }
+  result<byte_socket_handle> ret(byte_socket_handle(native_handle_type(), kernel_caching(), _flags, nullptr));
+  native_handle_type &nativeh = ret.value()._v;
+  nativeh.behaviour |= native_handle_type::disposition::socket;
+  nativeh.behaviour |= _v.behaviour & (native_handle_type::disposition::readable | native_handle_type::disposition::writable | native_handle_type::disposition::nonblocking);
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  SOCKET s;
+  for(;;)
+  {
+    s = ::accept((SOCKET) _v.h, nullptr, nullptr);
+    if(INVALID_SOCKET != s)
+    {
+      break;
+    }
+    if(WSAEWOULDBLOCK != WSAGetLastError())
+    {
+      return win32_error(WSAGetLastError());
+    }
+    LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+    OUTCOME_TRY(detail::socket_poll((SOCKET) _v.h, POLLRDNORM, d, began_steady));
+  }
+  nativeh.h = (HANDLE) s;
+  if(nativeh.is_nonblocking())
+  {
+    OUTCOME_TRY(detail::socket_set_nonblocking(s, false));
+  }
+  SOCKADDR_STORAGE ss;
+  int len = (int) sizeof(ss);
+  if(SOCKET_ERROR != getsockname(s, reinterpret_cast<sockaddr *>(&ss), &len))
+  {
+    detail::socket_set_nodelay(s, ss.ss_family);
+  }
+  return ret;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -0,0 +1,54 @@
+/* Memory whose pages are materialised on first touch by a user callback
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../demand_paged_map.hpp"
+#include "import.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+result<demand_paged_map> demand_paged_map::map(size_type bytes, fill_function fill) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  // Windows has no means of servicing page faults in user space short of vectored
+  // exception handlers, which cannot resume faults raised within the kernel.
+  (void) bytes;
+  (void) fill;
+  return errc::operation_not_supported;
+}
+
+result<void> demand_paged_map::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  _state.reset();
+  return success();
+}
+
+result<demand_paged_map::buffer_type> demand_paged_map::discard(buffer_type region) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  (void) region;
+  return errc::operation_not_supported;
+}
+
+LLFIO_V2_NAMESPACE_END
@@ -23,6 +23,7 @@ http://www.boost.org/LICENSE_1_0.txt)
 */
 
 #include "../../../directory_handle.hpp"
+#include "../../../file_handle.hpp"
 #include "import.hpp"
 
 LLFIO_V2_NAMESPACE_BEGIN
@@ -203,6 +204,26 @@ result<directory_handle> directory_handle::directory(const path_handle &base, pa
   return ret;
 }
 
+result<std::vector<result<directory_handle>>> directory_handle::directories(const path_handle &base, span<const path_view_type> paths, mode _mode,
+                                                                            creation _creation, caching _caching, flag flags, io_multiplexer * /*unused*/) noexcept
+{
+  try
+  {
+    // There is no batched open on Windows
+    std::vector<result<directory_handle>> ret;
+    ret.reserve(paths.size());
+    for(const auto &path : paths)
+    {
+      ret.push_back(directory(base, path, _mode, _creation, _caching, flags));
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 result<directory_handle> directory_handle::reopen(mode mode_, caching caching_, deadline /* unused */) const noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -252,6 +273,36 @@ namespace detail
     // Return as a file handle so the direct relink and unlink are used
     return file_handle(nativeh, 0, 0, file_handle::caching::all, file_handle::flag::none, nullptr);
   }
+  // Opens the entry `leafname` of `dirh` with only DELETE privs, without following reparse points
+  inline result<file_handle> open_entry_with_delete_privs(const directory_handle &dirh, path_view leafname, bool is_directory) noexcept
+  {
+    windows_nt_kernel::init();
+    using namespace windows_nt_kernel;
+    native_handle_type nativeh;
+    nativeh.behaviour |= is_directory ? native_handle_type::disposition::directory : native_handle_type::disposition::file;
+    DWORD fileshare = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+    path_view::c_str<> zpath(leafname, path_view::not_zero_terminated);
+    UNICODE_STRING _path{};
+    _path.Buffer = const_cast<wchar_t *>(zpath.buffer);
+    _path.MaximumLength = (_path.Length = static_cast<USHORT>(zpath.length * sizeof(wchar_t))) + sizeof(wchar_t);
+    OBJECT_ATTRIBUTES oa{};
+    memset(&oa, 0, sizeof(oa));
+    oa.Length = sizeof(OBJECT_ATTRIBUTES);
+    oa.ObjectName = &_path;
+    oa.RootDirectory = dirh.native_handle().h;
+    IO_STATUS_BLOCK isb = make_iostatus();
+    const DWORD ntflags = (is_directory ? 0x01 /*FILE_DIRECTORY_FILE*/ : 0x40 /*FILE_NON_DIRECTORY_FILE*/) | 0x20 /*FILE_SYNCHRONOUS_IO_NONALERT*/ | 0x00200000 /*FILE_OPEN_REPARSE_POINT*/;
+    NTSTATUS ntstat = NtOpenFile(&nativeh.h, SYNCHRONIZE | DELETE, &oa, &isb, fileshare, ntflags);
+    if(STATUS_PENDING == ntstat)
+    {
+      ntstat = ntwait(nativeh.h, isb, deadline());
+    }
+    if(ntstat < 0)
+    {
+      return ntkernel_error(ntstat);
+    }
+    return file_handle(nativeh, 0, 0, file_handle::caching::all, file_handle::flag::disable_safety_unlinks, nullptr);
+  }
 }  // namespace detail
 
 result<void> directory_handle::relink(const path_handle &base, directory_handle::path_view_type newpath, bool atomic_replace, deadline d) noexcept
@@ -276,6 +327,73 @@ result<void> directory_handle::unlink(deadline d) noexcept
   return h.unlink(d);
 }
 
+namespace detail
+{
+  // The 128 bit file ids of ReFS don't fit stat_t::st_ino, so fold them. NTFS ids have a zero top half, so they match stat_t::fill().
+  inline uint64_t directory_information_ino(const windows_nt_kernel::FILE_ID_EXTD_DIR_INFORMATION *ffdi) noexcept
+  {
+    uint64_t id[2];
+    memcpy(id, ffdi->FileId.Identifier, sizeof(id));
+    return id[0] ^ id[1];
+  }
+  inline uint64_t directory_information_ino(const windows_nt_kernel::FILE_ID_FULL_DIR_INFORMATION *ffdi) noexcept { return ffdi->FileId.QuadPart; }
+
+  // Filing systems without 128 bit file ids e.g. FAT, and older SMB servers, refuse FileIdExtdDirectoryInformation
+  inline bool directory_information_class_refused(NTSTATUS ntstat) noexcept
+  {
+    return ntstat == (NTSTATUS) 0xC0000003 /*STATUS_INVALID_INFO_CLASS*/ || ntstat == (NTSTATUS) 0xC000000D /*STATUS_INVALID_PARAMETER*/ ||
+           ntstat == (NTSTATUS) 0xC00000BB /*STATUS_NOT_SUPPORTED*/;
+  }
+
+  // Fills item from a directory information record, returning false if the entry is to be skipped
+  template <class T> inline bool fill_from_directory_information(directory_entry &item, T *ffdi, directory_handle::filter filtering) noexcept
+  {
+    using namespace windows_nt_kernel;
+    size_t length = ffdi->FileNameLength / sizeof(wchar_t);
+    if(length <= 2 && '.' == ffdi->FileName[0])
+    {
+      if(1 == length || '.' == ffdi->FileName[1])
+      {
+        return false;
+      }
+    }
+    // Try to zero terminate leafnames where possible for later efficiency
+    if(reinterpret_cast<uintptr_t>(ffdi->FileName + length) + sizeof(wchar_t) <= reinterpret_cast<uintptr_t>(ffdi) + ffdi->NextEntryOffset)
+    {
+      ffdi->FileName[length] = 0;
+      item.leafname = path_view(ffdi->FileName, length, path_view::zero_terminated);
+    }
+    else
+    {
+      item.leafname = path_view(ffdi->FileName, length, path_view::not_zero_terminated);
+    }
+    if(filtering == directory_handle::filter::fastdeleted && item.leafname.is_llfio_deleted())
+    {
+      return false;
+    }
+    item.stat = stat_t(nullptr);
+    if constexpr(std::is_same<T, FILE_DIRECTORY_INFORMATION>::value)
+    {
+      item.stat.st_type = to_st_type(ffdi->FileAttributes, IO_REPARSE_TAG_SYMLINK /* not accurate, but best we can do */);
+    }
+    else
+    {
+      item.stat.st_ino = directory_information_ino(ffdi);
+      item.stat.st_type = to_st_type(ffdi->FileAttributes, ffdi->ReparsePointTag);
+    }
+    item.stat.st_atim = to_timepoint(ffdi->LastAccessTime);
+    item.stat.st_mtim = to_timepoint(ffdi->LastWriteTime);
+    item.stat.st_ctim = to_timepoint(ffdi->ChangeTime);
+    item.stat.st_size = ffdi->EndOfFile.QuadPart;
+    item.stat.st_allocated = ffdi->AllocationSize.QuadPart;
+    item.stat.st_birthtim = to_timepoint(ffdi->CreationTime);
+    item.stat.st_sparse = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0u);
+    item.stat.st_compressed = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_COMPRESSED) != 0u);
+    item.stat.st_reparse_point = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0u);
+    return true;
+  }
+}  // namespace detail
+
 result<directory_handle::buffers_type> directory_handle::read(io_request<buffers_type> req, deadline d) const noexcept
 {
   windows_nt_kernel::init();
@@ -283,11 +401,16 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
 //#define LLFIO_DIRECTORY_HANDLE_ENUMERATE_LESS_INFO 1
 #ifdef LLFIO_DIRECTORY_HANDLE_ENUMERATE_LESS_INFO
   using what_to_enumerate_type = FILE_DIRECTORY_INFORMATION;  // 68 bytes + filename
-  const auto what_to_enumerate = FileDirectoryInformation;
+  using fallback_enumerate_type = FILE_DIRECTORY_INFORMATION;
+  FILE_INFORMATION_CLASS what_to_enumerate = FileDirectoryInformation;
+  const FILE_INFORMATION_CLASS fallback_enumerate = FileDirectoryInformation;
   static constexpr stat_t::want default_stat_contents = /*stat_t::want::ino |*/ stat_t::want::type | stat_t::want::atim | stat_t::want::mtim | stat_t::want::ctim | stat_t::want::size | stat_t::want::allocated | stat_t::want::birthtim | stat_t::want::sparse | stat_t::want::compressed | stat_t::want::reparse_point;
 #else
-  using what_to_enumerate_type = FILE_ID_FULL_DIR_INFORMATION;  // 80 bytes + filename
-  const auto what_to_enumerate = FileIdFullDirectoryInformation;
+  // Prefer 128 bit file ids, falling back to 64 bit file ids on filing systems which refuse them
+  using what_to_enumerate_type = FILE_ID_EXTD_DIR_INFORMATION;     // 88 bytes + filename
+  using fallback_enumerate_type = FILE_ID_FULL_DIR_INFORMATION;  // 80 bytes + filename
+  FILE_INFORMATION_CLASS what_to_enumerate = FileIdExtdDirectoryInformation;
+  const FILE_INFORMATION_CLASS fallback_enumerate = FileIdFullDirectoryInformation;
   static constexpr stat_t::want default_stat_contents = stat_t::want::ino | stat_t::want::type | stat_t::want::atim | stat_t::want::mtim | stat_t::want::ctim | stat_t::want::size | stat_t::want::allocated | stat_t::want::birthtim | stat_t::want::sparse | stat_t::want::compressed | stat_t::want::reparse_point;
 #endif
   LLFIO_LOG_FUNCTION_CALL(this);
@@ -305,7 +428,7 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     _glob.Length = (USHORT)(zglob.length * sizeof(wchar_t));
     _glob.MaximumLength = _glob.Length + sizeof(wchar_t);
   }
-  what_to_enumerate_type *buffer = nullptr;
+  char *buffer = nullptr;
   {
     /* Recent editions of Windows call ProbeForWrite() on the buffer passed.
     This is a very slow call, in fact it is worth calling the syscall multiple
@@ -323,13 +446,26 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     auto unlock = make_scope_exit([this]() noexcept { _lock.store(0, std::memory_order_release); });
     (void) unlock;
     {
-      char _buffer[65536];
+      /* Big directories take many syscalls to list the names of with a small buffer, so reuse
+      the kernel buffer if a previous read grew it, up to 1Mb, as its pages are already probed.
+      */
+      alignas(8) char _buffer[65536];
       auto *buffer_ = (FILE_NAMES_INFORMATION *) _buffer;
+      ULONG buffer_size = sizeof(_buffer);
+      {
+        char *kernelbuffer = req.kernelbuffer.empty() ? req.buffers._kernel_buffer.get() : reinterpret_cast<char *>(req.kernelbuffer.data());
+        const size_t kernelbuffersize = req.kernelbuffer.empty() ? req.buffers._kernel_buffer_size : req.kernelbuffer.size();
+        if(kernelbuffer != nullptr && kernelbuffersize > buffer_size)
+        {
+          buffer_ = (FILE_NAMES_INFORMATION *) kernelbuffer;
+          buffer_size = static_cast<ULONG>(std::min(kernelbuffersize, (size_t) 1024 * 1024) & ~(size_t) 7);
+        }
+      }
       bool first = true, done = false;
       for(;;)
       {
         IO_STATUS_BLOCK isb = make_iostatus();
-        NTSTATUS ntstat = NtQueryDirectoryFile(_v.h, nullptr, nullptr, nullptr, &isb, buffer_, sizeof(_buffer), FileNamesInformation, FALSE, req.glob.empty() ? nullptr : &_glob, first);
+        NTSTATUS ntstat = NtQueryDirectoryFile(_v.h, nullptr, nullptr, nullptr, &isb, buffer_, buffer_size, FileNamesInformation, FALSE, req.glob.empty() ? nullptr : &_glob, first);
         if(STATUS_PENDING == ntstat)
         {
           ntstat = ntwait(_v.h, isb, deadline());
@@ -353,14 +489,20 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     {
       if(!req.buffers._kernel_buffer || req.buffers._kernel_buffer_size < kernelbuffertoallocate)
       {
-        auto *mem = (char *) operator new[](kernelbuffertoallocate, std::nothrow);  // don't initialise
+        // Grow geometrically so reuse across many directories rarely reallocates. Only the bytes needed are passed to the kernel.
+        size_t toallocate = 65536;
+        while(toallocate < kernelbuffertoallocate)
+        {
+          toallocate <<= 1;
+        }
+        auto *mem = (char *) operator new[](toallocate, std::nothrow);  // don't initialise
         if(mem == nullptr)
         {
           return errc::not_enough_memory;
         }
         req.buffers._kernel_buffer.reset();
         req.buffers._kernel_buffer = std::unique_ptr<char[]>(mem);
-        req.buffers._kernel_buffer_size = kernelbuffertoallocate;
+        req.buffers._kernel_buffer_size = toallocate;
       }
     }
     else if(req.kernelbuffer.size() < kernelbuffertoallocate)
@@ -368,14 +510,25 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
       return errc::no_buffer_space;  // user needs to supply a bigger buffer
     }
     ULONG max_bytes, bytes;
-    buffer = req.kernelbuffer.empty() ? reinterpret_cast<what_to_enumerate_type *>(req.buffers._kernel_buffer.get()) : reinterpret_cast<what_to_enumerate_type *>(req.kernelbuffer.data());
+    buffer = req.kernelbuffer.empty() ? req.buffers._kernel_buffer.get() : reinterpret_cast<char *>(req.kernelbuffer.data());
     max_bytes = req.kernelbuffer.empty() ? static_cast<ULONG>(req.buffers._kernel_buffer_size) : static_cast<ULONG>(req.kernelbuffer.size());
     bytes = std::min(max_bytes, (ULONG) kernelbuffertoallocate);
     IO_STATUS_BLOCK isb = make_iostatus();
-    NTSTATUS ntstat = NtQueryDirectoryFile(_v.h, nullptr, nullptr, nullptr, &isb, buffer, bytes, what_to_enumerate, FALSE, req.glob.empty() ? nullptr : &_glob, TRUE);
-    if(STATUS_PENDING == ntstat)
+    NTSTATUS ntstat;
+    for(;;)
     {
-      ntstat = ntwait(_v.h, isb, deadline());
+      ntstat = NtQueryDirectoryFile(_v.h, nullptr, nullptr, nullptr, &isb, buffer, bytes, what_to_enumerate, FALSE, req.glob.empty() ? nullptr : &_glob, TRUE);
+      if(STATUS_PENDING == ntstat)
+      {
+        ntstat = ntwait(_v.h, isb, deadline());
+      }
+      if(what_to_enumerate != fallback_enumerate && detail::directory_information_class_refused(ntstat))
+      {
+        what_to_enumerate = fallback_enumerate;
+        isb = make_iostatus();
+        continue;
+      }
+      break;
     }
     if(ntstat < 0)
     {
@@ -395,64 +548,293 @@ result<directory_handle::buffers_type> directory_handle::read(io_request<buffers
     }
   }
 
-  size_t n = 0;
-  bool done = false;
-  for(what_to_enumerate_type *ffdi = buffer; !done; ffdi = reinterpret_cast<what_to_enumerate_type *>(reinterpret_cast<uintptr_t>(ffdi) + ffdi->NextEntryOffset))
+  auto fill = [&](auto *ffdi) -> result<buffers_type> {
+    using type = std::remove_pointer_t<decltype(ffdi)>;
+    size_t n = 0;
+    bool done = false;
+    for(; !done; ffdi = reinterpret_cast<type *>(reinterpret_cast<uintptr_t>(ffdi) + ffdi->NextEntryOffset))
+    {
+      done = (ffdi->NextEntryOffset == 0);
+      if(!detail::fill_from_directory_information(req.buffers[n], ffdi, req.filtering))
+      {
+        continue;
+      }
+      n++;
+      if(!done && n >= req.buffers.size())
+      {
+        // Fill is incomplete
+        req.buffers._metadata = default_stat_contents;
+        req.buffers._done = false;
+        return std::move(req.buffers);
+      }
+    }
+    // Fill is complete
+    req.buffers._resize(n);
+    req.buffers._metadata = default_stat_contents;
+    req.buffers._done = true;
+    return std::move(req.buffers);
+  };
+  if(what_to_enumerate == fallback_enumerate)
   {
-    size_t length = ffdi->FileNameLength / sizeof(wchar_t);
-    done = (ffdi->NextEntryOffset == 0);
-    if(length <= 2 && '.' == ffdi->FileName[0])
+    return fill(reinterpret_cast<fallback_enumerate_type *>(buffer));
+  }
+  return fill(reinterpret_cast<what_to_enumerate_type *>(buffer));
+}
+
+result<std::vector<result<size_t>>> directory_handle::stat_entries(span<buffer_type> entries, stat_t::want wanted, bool /*unused*/, io_multiplexer * /*unused*/) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    // There is no stat by leafname on Windows, so open each entry
+    std::vector<result<size_t>> ret;
+    ret.reserve(entries.size());
+    for(auto &entry : entries)
     {
-      if(1 == length || '.' == ffdi->FileName[1])
+      if(entry.stat.st_type == filesystem::file_type::directory)
       {
+        auto h = directory(*this, entry.leafname, mode::attr_read);
+        ret.push_back(h ? entry.stat.fill(h.value(), wanted) : result<size_t>(std::move(h).error()));
+      }
+      else
+      {
+        auto h = file_handle::file(*this, entry.leafname, file_handle::mode::attr_read);
+        ret.push_back(h ? entry.stat.fill(h.value(), wanted) : result<size_t>(std::move(h).error()));
+      }
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<stat_t::want>>> directory_handle::stamp_entries(span<const buffer_type> entries, stat_t::want wanted, span<const stat_t> current) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(!current.empty() && current.size() != entries.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    // There is no setting of metadata by leafname on Windows, so open each entry
+    std::vector<result<stat_t::want>> ret;
+    ret.reserve(entries.size());
+    wanted &= (stat_t::want::atim | stat_t::want::mtim | stat_t::want::birthtim);
+    for(size_t n = 0; n < entries.size(); n++)
+    {
+      stat_t stat = entries[n].stat;
+      stat_t::want thiswanted = wanted;
+      if(!current.empty())
+      {
+        if(current[n].st_atim == stat.st_atim)
+        {
+          thiswanted &= ~stat_t::want::atim;
+        }
+        if(current[n].st_mtim == stat.st_mtim)
+        {
+          thiswanted &= ~stat_t::want::mtim;
+        }
+        if(current[n].st_birthtim == stat.st_birthtim)
+        {
+          thiswanted &= ~stat_t::want::birthtim;
+        }
+      }
+      if(!thiswanted)
+      {
+        ret.emplace_back(thiswanted);
         continue;
       }
+      if(stat.st_type == filesystem::file_type::directory)
+      {
+        auto h = directory(*this, entries[n].leafname, mode::attr_write);
+        ret.push_back(h ? stat.stamp(h.value(), thiswanted) : result<stat_t::want>(std::move(h).error()));
+      }
+      else
+      {
+        auto h = file_handle::file(*this, entries[n].leafname, file_handle::mode::attr_write);
+        ret.push_back(h ? stat.stamp(h.value(), thiswanted) : result<stat_t::want>(std::move(h).error()));
+      }
     }
-    directory_entry &item = req.buffers[n];
-    // Try to zero terminate leafnames where possible for later efficiency
-    if(reinterpret_cast<uintptr_t>(ffdi->FileName + length) + sizeof(wchar_t) <= reinterpret_cast<uintptr_t>(ffdi) + ffdi->NextEntryOffset)
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::relink_entries(span<const relink_request> entries, io_multiplexer * /*unused*/) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    // There is no rename by leafname on Windows, so open each entry and rename that
+    std::vector<result<void>> ret;
+    ret.reserve(entries.size());
+    const path_handle nobase;
+    for(const auto &entry : entries)
     {
-      ffdi->FileName[length] = 0;
-      item.leafname = path_view_type(ffdi->FileName, length, path_view::zero_terminated);
+      if(entry.kind == relink_kind::exchange)
+      {
+        ret.push_back(result<void>(errc::operation_not_supported));
+        continue;
+      }
+      // Which of a file or a directory it is is not known, so try both
+      auto h = detail::open_entry_with_delete_privs(*this, entry.leafname, false);
+      if(!h && h.error() == errc::is_a_directory)
+      {
+        h = detail::open_entry_with_delete_privs(*this, entry.leafname, true);
+      }
+      ret.push_back(h ? h.value().relink((entry.base != nullptr) ? *entry.base : nobase, entry.path, entry.kind == relink_kind::replace)
+                      : result<void>(std::move(h).error()));
     }
-    else
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::unlink_entries(span<const path_view_type> leafnames, bool directories, io_multiplexer * /*unused*/) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    // There is no unlink by leafname on Windows, so open each entry and unlink that
+    std::vector<result<void>> ret;
+    ret.reserve(leafnames.size());
+    for(const auto &leafname : leafnames)
+    {
+      auto h = detail::open_entry_with_delete_privs(*this, leafname, directories);
+      ret.push_back(h ? h.value().unlink() : result<void>(std::move(h).error()));
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> directory_handle::create_entries(span<const create_request> entries, creation _creation, caching _caching,
+                                                                   io_multiplexer * /*unused*/) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_caching == caching::none || _caching == caching::only_metadata)
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    // Creating each file costs far more than writing it on Windows, so there is nothing to batch
+    std::vector<result<void>> ret;
+    ret.reserve(entries.size());
+    for(const auto &entry : entries)
     {
-      item.leafname = path_view_type(ffdi->FileName, length, path_view::not_zero_terminated);
+      auto h = file_handle::file(*this, entry.leafname, file_handle::mode::write, _creation, _caching);
+      if(!h)
+      {
+        ret.push_back(result<void>(std::move(h).error()));
+        continue;
+      }
+      if(entry.contents.empty())
+      {
+        ret.push_back(h.value().close());
+        continue;
+      }
+      auto written = h.value().write(0, {{entry.contents.data(), entry.contents.size()}});
+      if(!written)
+      {
+        ret.push_back(result<void>(std::move(written).error()));
+        continue;
+      }
+      ret.push_back(h.value().close());
     }
-    if(req.filtering == filter::fastdeleted && item.leafname.is_llfio_deleted())
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<span<directory_stream::buffer_type>> directory_stream::next(span<buffer_type> out) noexcept
+{
+  windows_nt_kernel::init();
+  using namespace windows_nt_kernel;
+  static constexpr stat_t::want default_stat_contents = stat_t::want::ino | stat_t::want::type | stat_t::want::atim | stat_t::want::mtim | stat_t::want::ctim | stat_t::want::size | stat_t::want::allocated | stat_t::want::birthtim | stat_t::want::sparse | stat_t::want::compressed | stat_t::want::reparse_point;
+  LLFIO_LOG_FUNCTION_CALL(&_h);
+  UNICODE_STRING _glob_{};
+  memset(&_glob_, 0, sizeof(_glob_));
+  if(!_glob.empty())
+  {
+    _glob_.Buffer = const_cast<wchar_t *>(_glob.c_str());
+    _glob_.Length = (USHORT)(_glob.native().size() * sizeof(wchar_t));
+    _glob_.MaximumLength = _glob_.Length + sizeof(wchar_t);
+  }
+  size_t n = 0;
+  while(n < out.size())
+  {
+    if(_offset >= _bytes)
     {
-      continue;
+      // Leafnames already yielded are views of the kernel buffer, so only refill it if none were
+      if(n > 0 || _done)
+      {
+        break;
+      }
+      // The glob is only used by the first query, later ones continue from where the last finished
+      IO_STATUS_BLOCK isb = make_iostatus();
+      NTSTATUS ntstat = NtQueryDirectoryFile(_h.native_handle().h, nullptr, nullptr, nullptr, &isb, _buffer.get(), static_cast<ULONG>(_buffer_size),
+                                             _no_128bit_ids ? FileIdFullDirectoryInformation : FileIdExtdDirectoryInformation, FALSE,
+                                             _glob.empty() ? nullptr : &_glob_, _first);
+      if(STATUS_PENDING == ntstat)
+      {
+        ntstat = ntwait(_h.native_handle().h, isb, deadline());
+      }
+      if(!_no_128bit_ids && _first && detail::directory_information_class_refused(ntstat))
+      {
+        _no_128bit_ids = true;
+        continue;
+      }
+      if(0x80000006 /*STATUS_NO_MORE_FILES*/ == ntstat)
+      {
+        _done = true;
+        break;
+      }
+      if(ntstat < 0)
+      {
+        return ntkernel_error(ntstat);
+      }
+      _first = false;
+      _offset = 0;
+      _bytes = static_cast<size_t>(isb.Information);
     }
-    item.stat = stat_t(nullptr);
-#ifndef LLFIO_DIRECTORY_HANDLE_ENUMERATE_LESS_INFO
-    item.stat.st_ino = ffdi->FileId.QuadPart;
-    item.stat.st_type = to_st_type(ffdi->FileAttributes, ffdi->ReparsePointTag);
-#else
-    item.stat.st_type = to_st_type(ffdi->FileAttributes, IO_REPARSE_TAG_SYMLINK /* not accurate, but best we can do */);
-#endif
-    item.stat.st_atim = to_timepoint(ffdi->LastAccessTime);
-    item.stat.st_mtim = to_timepoint(ffdi->LastWriteTime);
-    item.stat.st_ctim = to_timepoint(ffdi->ChangeTime);
-    item.stat.st_size = ffdi->EndOfFile.QuadPart;
-    item.stat.st_allocated = ffdi->AllocationSize.QuadPart;
-    item.stat.st_birthtim = to_timepoint(ffdi->CreationTime);
-    item.stat.st_sparse = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0u);
-    item.stat.st_compressed = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_COMPRESSED) != 0u);
-    item.stat.st_reparse_point = static_cast<unsigned int>((ffdi->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0u);
-    n++;
-    if(!done && n >= req.buffers.size())
+    char *record = _buffer.get() + _offset;
+    const ULONG nextentryoffset = reinterpret_cast<const ULONG *>(record)[0];  // NextEntryOffset is first in both records
+    _offset = (nextentryoffset == 0) ? _bytes : (_offset + nextentryoffset);
+    if(!(_no_128bit_ids ? detail::fill_from_directory_information(out[n], reinterpret_cast<FILE_ID_FULL_DIR_INFORMATION *>(record), _filtering) :
+                          detail::fill_from_directory_information(out[n], reinterpret_cast<FILE_ID_EXTD_DIR_INFORMATION *>(record), _filtering)))
     {
-      // Fill is incomplete
-      req.buffers._metadata = default_stat_contents;
-      req.buffers._done = false;
-      return std::move(req.buffers);
+      continue;
     }
+    n++;
   }
-  // Fill is complete
-  req.buffers._resize(n);
-  req.buffers._metadata = default_stat_contents;
-  req.buffers._done = true;
-  return std::move(req.buffers);
+  _metadata = default_stat_contents;
+  return out.subspan(0, n);
+}
+
+result<void> directory_stream::restart() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(&_h);
+  // The next query restarts the scan
+  _offset = _bytes = 0;
+  _first = true;
+  _done = false;
+  return success();
 }
 
 LLFIO_V2_NAMESPACE_END
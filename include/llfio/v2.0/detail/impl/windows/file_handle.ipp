@@ -181,7 +181,45 @@ result<file_handle> file_handle::file(const path_handle &base, file_handle::path
   return ret;
 }
 
-result<file_handle> file_handle::temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept
+result<std::vector<result<file_handle>>> file_handle::files(const path_handle &base, span<const path_view_type> paths, mode _mode, creation _creation,
+                                                            caching _caching, flag flags, io_multiplexer * /*unused*/) noexcept
+{
+  try
+  {
+    // There is no batched open on Windows
+    std::vector<result<file_handle>> ret;
+    ret.reserve(paths.size());
+    for(const auto &path : paths)
+    {
+      ret.push_back(file(base, path, _mode, _creation, _caching, flags));
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> file_handle::close_files(span<file_handle> fhs, io_multiplexer * /*unused*/) noexcept
+{
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(fhs.size());
+    for(auto &fh : fhs)
+    {
+      ret.push_back(fh.close());
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<file_handle> file_handle::_temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
@@ -345,6 +383,7 @@ result<file_handle::extent_type> file_handle::maximum_extent() const noexcept
 result<file_handle::extent_type> file_handle::truncate(file_handle::extent_type newsize) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  _invalidate_extent_map();
   FILE_END_OF_FILE_INFO feofi{};
   feofi.EndOfFile.QuadPart = newsize;
   if(SetFileInformationByHandle(_v.h, FileEndOfFileInfo, &feofi, sizeof(feofi)) == 0)
@@ -358,13 +397,12 @@ result<file_handle::extent_type> file_handle::truncate(file_handle::extent_type
   return newsize;
 }
 
-result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexcept
+namespace detail
 {
-  windows_nt_kernel::init();
-  using namespace windows_nt_kernel;
-  LLFIO_LOG_FUNCTION_CALL(this);
-  try
+  // Enumerates valid extents using FSCTL_QUERY_ALLOCATED_RANGES
+  inline result<std::vector<file_handle::extent_pair>> file_handle_allocated_ranges(const file_handle &fh)
   {
+    using namespace windows_nt_kernel;
     static_assert(sizeof(file_handle::extent_pair) == sizeof(FILE_ALLOCATED_RANGE_BUFFER),
                   "FILE_ALLOCATED_RANGE_BUFFER is not equivalent to pair<extent_type, extent_type>!");
     std::vector<file_handle::extent_pair> ret;
@@ -376,12 +414,12 @@ result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexc
     FILE_ALLOCATED_RANGE_BUFFER farb{};
     farb.FileOffset.QuadPart = 0;
     farb.Length.QuadPart =
-    (static_cast<extent_type>(1) << 63) - 1;  // Microsoft claims this is 1<<64-1024 for NTFS, but I get bad parameter error with anything higher than 1<<63-1.
+    (static_cast<file_handle::extent_type>(1) << 63) - 1;  // Microsoft claims this is 1<<64-1024 for NTFS, but I get bad parameter error with anything higher than 1<<63-1.
     DWORD bytesout = 0;
     OVERLAPPED ol{};
     memset(&ol, 0, sizeof(ol));
     ol.Internal = static_cast<ULONG_PTR>(-1);
-    while(DeviceIoControl(_v.h, FSCTL_QUERY_ALLOCATED_RANGES, &farb, sizeof(farb), ret.data(),
+    while(DeviceIoControl(fh.native_handle().h, FSCTL_QUERY_ALLOCATED_RANGES, &farb, sizeof(farb), ret.data(),
                           static_cast<DWORD>(ret.size() * sizeof(FILE_ALLOCATED_RANGE_BUFFER)), &bytesout, &ol) == 0)
     {
       if(ERROR_INSUFFICIENT_BUFFER == GetLastError() || ERROR_MORE_DATA == GetLastError())
@@ -394,8 +432,97 @@ result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexc
         return win32_error();
       }
     }
+    ret.resize(bytesout / sizeof(FILE_ALLOCATED_RANGE_BUFFER));
     return ret;
   }
+}  // namespace detail
+
+result<std::vector<file_handle::extent_pair>> file_handle::extents() const noexcept
+{
+  windows_nt_kernel::init();
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    if(_extent_cache != nullptr)
+    {
+      OUTCOME_TRY(auto &&map, extent_map());
+      std::vector<file_handle::extent_pair> ret;
+      ret.reserve(map.size());
+      for(const auto &e : map)
+      {
+        ret.emplace_back(e.offset, e.length);
+      }
+      return ret;
+    }
+    return detail::file_handle_allocated_ranges(*this);
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<file_handle::extent_info>> file_handle::extent_map() const noexcept
+{
+  windows_nt_kernel::init();
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    uint64_t generation = 0;
+    if(_extent_cache != nullptr)
+    {
+      lock_guard<spinlock> g(_extent_cache->lock);
+      if(_extent_cache->valid)
+      {
+        return _extent_cache->map;
+      }
+      generation = _extent_cache->generation;
+    }
+    OUTCOME_TRY(auto &&extents, detail::file_handle_allocated_ranges(*this));
+    std::vector<extent_info> out;
+    out.reserve(extents.size());
+    for(const auto &e : extents)
+    {
+      out.emplace_back(e.offset, e.length);
+    }
+    if(!out.empty())
+    {
+      out.back().flags |= extent_flag::last;
+    }
+    if(_extent_cache != nullptr)
+    {
+      lock_guard<spinlock> g(_extent_cache->lock);
+      // Only cache if nothing invalidated the map while we were fetching it
+      if(_extent_cache->generation == generation)
+      {
+        _extent_cache->map = out;
+        _extent_cache->valid = true;
+      }
+    }
+    return out;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<void> file_handle::set_extent_map_caching(bool enable) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  try
+  {
+    if(enable && _extent_cache == nullptr)
+    {
+      _extent_cache = new _extent_map_cache;
+    }
+    else if(!enable)
+    {
+      delete _extent_cache;
+      _extent_cache = nullptr;
+    }
+    return success();
+  }
   catch(...)
   {
     return error_from_exception();
@@ -445,14 +572,14 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
     byte *buffer = nullptr;
     auto unbufferh = make_scope_exit([&]() noexcept {
       if(buffer != nullptr)
-        utils::page_allocator<byte>().deallocate(buffer, blocksize);
+        utils::pooled_page_allocator<byte>().deallocate(buffer, blocksize);
     });
     (void) unbufferh;
     extent_pair ret(extent.offset, 0);
     if(!dest_.is_regular())
     {
       // TODO: Use TransmitFile() here when we implement socket_handle.
-      buffer = utils::page_allocator<byte>().allocate(blocksize);
+      buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
       while(extent.length > 0)
       {
         deadline nd;
@@ -582,6 +709,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
 #endif
     // If cloning within the same file, use the appropriate direction
     auto &dest = static_cast<file_handle &>(dest_);
+    dest._invalidate_extent_map();
     OUTCOME_TRY(auto &&dest_length, dest.maximum_extent());
     if(dest.unique_id() == unique_id())
     {
@@ -710,7 +838,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
         {
           if(buffer == nullptr)
           {
-            buffer = utils::page_allocator<byte>().allocate(blocksize);
+            buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
           }
           deadline nd;
           buffer_type b(buffer, (size_type) thisblock);
@@ -804,7 +932,7 @@ result<file_handle::extent_pair> file_handle::clone_extents_to(file_handle::exte
         {
           if(buffer == nullptr)
           {
-            buffer = utils::page_allocator<byte>().allocate(blocksize);
+            buffer = utils::pooled_page_allocator<byte>().allocate(blocksize);
           }
           deadline nd;
           const_buffer_type cb(buffer, (size_type) thisblock);
@@ -841,6 +969,7 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
   LLFIO_LOG_FUNCTION_CALL(this);
+  _invalidate_extent_map();
   if(extent.offset + extent.length < extent.offset)
   {
     return errc::value_too_large;
@@ -867,6 +996,210 @@ result<file_handle::extent_type> file_handle::zero(file_handle::extent_pair exte
       return win32_error();
     }
   }
+  return extent.length;
+}
+
+result<file_handle::extent_type> file_handle::zero_extents(span<const extent_pair> extents, bool discard, deadline d) noexcept
+{
+  windows_nt_kernel::init();
+  using namespace windows_nt_kernel;
+  LLFIO_LOG_FUNCTION_CALL(this);
+  for(auto &extent : extents)
+  {
+    if(extent.offset + extent.length < extent.offset)
+    {
+      return errc::value_too_large;
+    }
+  }
+  extent_type ret = 0;
+  if(!discard)
+  {
+    for(auto &extent : extents)
+    {
+      OUTCOME_TRY(auto &&zeroed, zero(extent, d));
+      ret += zeroed;
+    }
+    return ret;
+  }
+  if(extents.empty())
+  {
+    return ret;
+  }
+  _invalidate_extent_map();
+  // FSCTL_FILE_LEVEL_TRIM, which needs Windows 8 or later
+  struct file_level_trim_range
+  {
+    DWORDLONG Offset;
+    DWORDLONG Length;
+  };
+  struct file_level_trim
+  {
+    DWORD Key;
+    DWORD NumRanges;
+    file_level_trim_range Ranges[1];
+  };
+  try
+  {
+    std::vector<byte> buffer(sizeof(file_level_trim) + (extents.size() - 1) * sizeof(file_level_trim_range));
+    auto *flt = reinterpret_cast<file_level_trim *>(buffer.data());
+    flt->Key = 0;
+    flt->NumRanges = 0;
+    for(auto &extent : extents)
+    {
+      if(extent.length > 0)
+      {
+        flt->Ranges[flt->NumRanges].Offset = extent.offset;
+        flt->Ranges[flt->NumRanges].Length = extent.length;
+        flt->NumRanges++;
+      }
+    }
+    DWORD numrangesprocessed = 0, bytesout = 0;
+    OVERLAPPED ol{};
+    memset(&ol, 0, sizeof(ol));
+    ol.Internal = static_cast<ULONG_PTR>(-1);
+    if(DeviceIoControl(_v.h, 0x00098208 /*FSCTL_FILE_LEVEL_TRIM*/, flt, (DWORD) buffer.size(), &numrangesprocessed, sizeof(numrangesprocessed), &bytesout, &ol) == 0)
+    {
+      const DWORD errcode = GetLastError();
+      if(ERROR_IO_PENDING == errcode)
+      {
+        NTSTATUS ntstat = ntwait(_v.h, ol, deadline());
+        if(ntstat != 0)
+        {
+          return ntkernel_error(ntstat);
+        }
+      }
+      // The filing system may not support trim
+      else if(ERROR_INVALID_FUNCTION == errcode || ERROR_NOT_SUPPORTED == errcode)
+      {
+        return ret;
+      }
+      else
+      {
+        return win32_error(errcode);
+      }
+    }
+    for(DWORD n = 0; n < numrangesprocessed && n < flt->NumRanges; n++)
+    {
+      ret += flt->Ranges[n].Length;
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<file_handle::extent_pair> file_handle::preallocate(file_handle::extent_pair extent, bool keep_size) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset)
+  {
+    return errc::value_too_large;
+  }
+  if(extent.length == 0)
+  {
+    return extent;
+  }
+  _invalidate_extent_map();
+  FILE_STANDARD_INFO fsi{};
+  if(GetFileInformationByHandleEx(_v.h, FileStandardInfo, &fsi, sizeof(fsi)) == 0)
+  {
+    return win32_error();
+  }
+  // Windows allocates from the start of the file, and setting an allocation less than
+  // the current one would deallocate storage
+  if((extent_type) fsi.AllocationSize.QuadPart < extent.offset + extent.length)
+  {
+    FILE_ALLOCATION_INFO fai{};
+    fai.AllocationSize.QuadPart = extent.offset + extent.length;
+    if(SetFileInformationByHandle(_v.h, FileAllocationInfo, &fai, sizeof(fai)) == 0)
+    {
+      return win32_error();
+    }
+  }
+  if(!keep_size && (extent_type) fsi.EndOfFile.QuadPart < extent.offset + extent.length)
+  {
+    FILE_END_OF_FILE_INFO feofi{};
+    feofi.EndOfFile.QuadPart = extent.offset + extent.length;
+    if(SetFileInformationByHandle(_v.h, FileEndOfFileInfo, &feofi, sizeof(feofi)) == 0)
+    {
+      return win32_error();
+    }
+  }
+  return extent;
+}
+
+result<file_handle::extent_type> file_handle::deduplicate_extents_to(file_handle::extent_pair extent, file_handle &dest, file_handle::extent_type destoffset) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(extent.offset + extent.length < extent.offset || destoffset + extent.length < destoffset)
+  {
+    return errc::value_too_large;
+  }
+  try
+  {
+    // FSCTL_DUPLICATE_EXTENTS_TO_FILE does not compare contents, so compare each block before sharing it
+    const size_type blocksize = utils::file_buffer_default_size();
+    byte *buffers[2] = {nullptr, nullptr};
+    auto unbufferh = make_scope_exit([&]() noexcept {
+      for(auto *buffer : buffers)
+      {
+        if(buffer != nullptr)
+          utils::pooled_page_allocator<byte>().deallocate(buffer, blocksize);
+      }
+    });
+    (void) unbufferh;
+    buffers[0] = utils::pooled_page_allocator<byte>().allocate(blocksize);
+    buffers[1] = utils::pooled_page_allocator<byte>().allocate(blocksize);
+    extent_type ret = 0;
+    while(ret < extent.length)
+    {
+      const auto thisblock = (size_type) std::min((extent_type) blocksize, extent.length - ret);
+      buffer_type a(buffers[0], thisblock), b(buffers[1], thisblock);
+      OUTCOME_TRY(auto &&readeda, read({{&a, 1}, extent.offset + ret}));
+      OUTCOME_TRY(auto &&readedb, dest.read({{&b, 1}, destoffset + ret}));
+      if(readeda.front().size() != thisblock || readedb.front().size() != thisblock || memcmp(buffers[0], buffers[1], thisblock) != 0)
+      {
+        break;
+      }
+      OUTCOME_TRY(auto &&cloned, clone_extents_to({extent.offset + ret, thisblock}, dest, destoffset + ret, {}, false, false));
+      if(cloned.length == 0)
+      {
+        break;
+      }
+      ret += cloned.length;
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<file_handle::extent_type> file_handle::collapse(file_handle::extent_pair /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // NTFS and ReFS have no means of renumbering extents
+  return errc::operation_not_supported;
+}
+
+result<file_handle::extent_type> file_handle::insert(file_handle::extent_pair /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // NTFS and ReFS have no means of renumbering extents
+  return errc::operation_not_supported;
+}
+
+result<void> file_handle::advise(file_handle::extent_pair region, file_handle::access_hint /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.offset + region.length < region.offset)
+  {
+    return errc::value_too_large;
+  }
+  // Windows only takes access pattern hints at open time, via FILE_FLAG_SEQUENTIAL_SCAN and FILE_FLAG_RANDOM_ACCESS
   return success();
 }
 
@@ -38,6 +38,12 @@ result<void> fs_handle::_fetch_inode() const noexcept
   return success();
 }
 
+result<filesystem::path> fs_handle::_cached_current_path() const noexcept
+{
+  // Validating a path would cost as much as NtQueryObject(), so no caching is done
+  return _get_handle().handle::current_path();
+}
+
 result<path_handle> fs_handle::parent_path_handle(deadline d) const noexcept
 {
   windows_nt_kernel::init();
@@ -750,6 +750,28 @@ namespace windows_nt_kernel
     WCHAR FileName[1];
   } FILE_ID_FULL_DIR_INFORMATION, *PFILE_ID_FULL_DIR_INFORMATION;
 
+  // From https://learn.microsoft.com/en-us/windows-hardware/drivers/ddi/ntifs/ns-ntifs-_file_id_extd_dir_information
+  typedef struct _FILE_ID_EXTD_DIR_INFORMATION  // NOLINT
+  {
+    ULONG NextEntryOffset;
+    ULONG FileIndex;
+    LARGE_INTEGER CreationTime;
+    LARGE_INTEGER LastAccessTime;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER ChangeTime;
+    LARGE_INTEGER EndOfFile;
+    LARGE_INTEGER AllocationSize;
+    ULONG FileAttributes;
+    ULONG FileNameLength;
+    ULONG EaSize;
+    ULONG ReparsePointTag;
+    struct
+    {
+      BYTE Identifier[16];
+    } FileId;  // FILE_ID_128, which the Windows 7 SDK lacks
+    WCHAR FileName[1];
+  } FILE_ID_EXTD_DIR_INFORMATION, *PFILE_ID_EXTD_DIR_INFORMATION;
+
   // From https://msdn.microsoft.com/en-us/library/windows/hardware/ff540354(v=vs.85).aspx
   typedef struct _FILE_REPARSE_POINT_INFORMATION  // NOLINT
   {
@@ -1934,6 +1956,24 @@ inline void do_unlock_file_range(native_handle_type &_v, handle::extent_type off
   }
 }
 
+// Marks a file as sparse, so extending it allocates no storage until written. Failure only loses efficiency, so is not reported.
+inline void do_set_sparse(const native_handle_type &_v) noexcept
+{
+  DWORD bytesout = 0;
+  FILE_SET_SPARSE_BUFFER fssb;
+  memset(&fssb, 0, sizeof(fssb));
+  fssb.SetSparse = 1u;
+  if(DeviceIoControl(_v.h, FSCTL_SET_SPARSE, &fssb, sizeof(fssb), nullptr, 0, &bytesout, nullptr) == 0)
+  {
+#if LLFIO_LOGGING_LEVEL >= 3
+    DWORD errcode = GetLastError();
+    LLFIO_LOG_WARN(_v.h, "Failed to set file to sparse");
+    result<void> r = win32_error(errcode);
+    (void) r;  // throw away
+#endif
+  }
+}
+
 /* Our own custom CreateFileW() implementation.
 
 The Win32 CreateFileW() implementation is unfortunately slow. It also, very annoyingly,
@@ -32,6 +32,20 @@ size_t io_handle::_do_max_buffers() const noexcept
   return 1;  // TODO FIXME support ReadFileScatter/WriteFileGather
 }
 
+result<void> io_handle::set_priority(io_priority p) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // Hints above normal are reserved to the system
+  FILE_IO_PRIORITY_HINT_INFO info{};
+  info.PriorityHint = (p == io_priority::low) ? IoPriorityHintLow : IoPriorityHintNormal;
+  if(!SetFileInformationByHandle(_v.h, FileIoPriorityHintInfo, &info, sizeof(info)))
+  {
+    return win32_error();
+  }
+  _priority = p;
+  return success();
+}
+
 template <class BuffersType> inline bool do_cancel(const native_handle_type &nativeh, span<windows_nt_kernel::IO_STATUS_BLOCK> ols, io_handle::io_request<BuffersType> reqs) noexcept
 {
   using namespace windows_nt_kernel;
@@ -177,35 +191,84 @@ inline bool do_read_write(io_handle::io_result<BuffersType> &ret, Syscall &&sysc
   return true;
 }
 
+// Performs as many batches of do_read_write() as needed for requests with more buffers than there are status blocks
+template <class Syscall, class BuffersType>
+inline io_handle::io_result<BuffersType> do_split_read_write(Syscall &&syscall, const native_handle_type &nativeh, span<windows_nt_kernel::IO_STATUS_BLOCK> ols, io_handle::io_request<BuffersType> reqs, deadline d) noexcept
+{
+  io_handle::io_result<BuffersType> ret(reqs.buffers);
+  if(reqs.buffers.size() <= ols.size())
+  {
+    do_read_write<true>(ret, syscall, nativeh, nullptr, ols, reqs, d);
+    return ret;
+  }
+  size_t idx = 0;
+  while(idx < reqs.buffers.size())
+  {
+    const size_t count = std::min(reqs.buffers.size() - idx, ols.size());
+    io_handle::io_request<BuffersType> batch({reqs.buffers.data() + idx, count}, reqs.offset, reqs.flags);
+    size_t requested = 0;
+    for(auto &b : batch.buffers)
+    {
+      requested += b.size();
+    }
+    io_handle::io_result<BuffersType> r(batch.buffers);
+    do_read_write<true>(r, syscall, nativeh, nullptr, ols, batch, d);
+    if(!r)
+    {
+      if(idx == 0)
+      {
+        return r;
+      }
+      // Report what was transferred, the failure will recur on the next call
+      return BuffersType{reqs.buffers.data(), idx};
+    }
+    size_t transferred = 0;
+    for(auto &b : r.value())
+    {
+      transferred += b.size();
+    }
+    if(transferred < requested)
+    {
+      // A short transfer e.g. end of file
+      return BuffersType{reqs.buffers.data(), idx + r.value().size()};
+    }
+    idx += count;
+    reqs.offset += transferred;
+  }
+  return ret;
+}
+
 io_handle::io_result<io_handle::buffers_type> io_handle::_do_read(io_handle::io_request<io_handle::buffers_type> reqs, deadline d) noexcept
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   using EIOSB = windows_nt_kernel::IO_STATUS_BLOCK;
   std::array<EIOSB, 64> _ols{};
-  if(reqs.buffers.size() > 64)
+  if(reqs.flags & io_request_flag::nowait)
   {
-    return errc::argument_list_too_long;
+    return errc::operation_not_supported;
   }
-  io_handle::io_result<io_handle::buffers_type> ret(reqs.buffers);
-  do_read_write<true>(ret, NtReadFile, _v, nullptr, {_ols.data(), _ols.size()}, reqs, d);
-  return ret;
+  return do_split_read_write(NtReadFile, _v, {_ols.data(), _ols.size()}, reqs, d);
 }
 
 io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_write(io_handle::io_request<io_handle::const_buffers_type> reqs, deadline d) noexcept
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   using EIOSB = windows_nt_kernel::IO_STATUS_BLOCK;
   std::array<EIOSB, 64> _ols{};
-  if(reqs.buffers.size() > 64)
+  if(reqs.flags & io_request_flag::nowait)
   {
-    return errc::argument_list_too_long;
+    return errc::operation_not_supported;
+  }
+  auto ret = do_split_read_write(NtWriteFile, _v, {_ols.data(), _ols.size()}, reqs, d);
+  if(ret && is_seekable() && (reqs.flags & io_request_flag::data_sync))
+  {
+    // Emulate data_sync with a barrier of what was written
+    OUTCOME_TRY(_do_barrier({ret.value(), reqs.offset}, barrier_kind::wait_data_only, d));
   }
-  io_handle::io_result<io_handle::const_buffers_type> ret(reqs.buffers);
-  do_read_write<true>(ret, NtWriteFile, _v, nullptr, {_ols.data(), _ols.size()}, reqs, d);
   return ret;
 }
 
@@ -213,7 +276,7 @@ io_handle::io_result<io_handle::const_buffers_type> io_handle::_do_barrier(io_ha
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   if(d && !_v.is_nonblocking())
   {
     return errc::not_supported;
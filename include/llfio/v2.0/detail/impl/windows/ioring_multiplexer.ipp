@@ -0,0 +1,933 @@
+/* Multiplex file i/o
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "io_handle.ipp"
+
+#ifndef _WIN32
+#error This implementation file is for Microsoft Windows only
+#endif
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+// The IoRing API is only in newer SDKs, and only in KernelBase.dll from Windows 11, so it is loaded dynamically
+namespace windows_ioring
+{
+  struct HIORING__;
+  using HIORING = HIORING__ *;
+
+  enum IORING_VERSION : int
+  {
+    IORING_VERSION_INVALID = 0,
+    IORING_VERSION_1 = 1,
+    IORING_VERSION_2 = 2,
+    IORING_VERSION_3 = 300  // Windows 11 22H2, adds write and flush
+  };
+  struct IORING_CREATE_FLAGS
+  {
+    int Required;
+    int Advisory;
+  };
+  enum IORING_REF_KIND : int
+  {
+    IORING_REF_RAW = 0,
+    IORING_REF_REGISTERED = 1
+  };
+  struct IORING_HANDLE_REF
+  {
+    IORING_REF_KIND Kind;
+    union
+    {
+      HANDLE Handle;
+      UINT32 Index;
+    } HandleUnion;
+  };
+  struct IORING_REGISTERED_BUFFER
+  {
+    UINT32 BufferIndex;
+    UINT32 Offset;
+  };
+  struct IORING_BUFFER_REF
+  {
+    IORING_REF_KIND Kind;
+    union
+    {
+      void *Address;
+      IORING_REGISTERED_BUFFER IndexAndOffset;
+    } BufferUnion;
+  };
+  struct IORING_BUFFER_INFO
+  {
+    void *Address;
+    UINT32 Length;
+  };
+  struct IORING_CQE
+  {
+    UINT_PTR UserData;
+    HRESULT ResultCode;
+    ULONG_PTR Information;
+  };
+  enum FILE_FLUSH_MODE : int
+  {
+    FILE_FLUSH_DEFAULT = 0,
+    FILE_FLUSH_DATA = 1,
+    FILE_FLUSH_MIN_METADATA = 2,
+    FILE_FLUSH_NO_SYNC = 3
+  };
+  static constexpr HRESULT IORING_E_SUBMISSION_QUEUE_FULL = (HRESULT) 0x80460002L;
+  static constexpr HRESULT IORING_E_VERSION_NOT_SUPPORTED = (HRESULT) 0x80460003L;
+
+  using CreateIoRing_t = HRESULT(WINAPI *)(IORING_VERSION ioringVersion, IORING_CREATE_FLAGS flags, UINT32 submissionQueueSize, UINT32 completionQueueSize,
+                                           HIORING *h);
+  using CloseIoRing_t = HRESULT(WINAPI *)(HIORING ioRing);
+  using SubmitIoRing_t = HRESULT(WINAPI *)(HIORING ioRing, UINT32 waitOperations, UINT32 milliseconds, UINT32 *submittedEntries);
+  using PopIoRingCompletion_t = HRESULT(WINAPI *)(HIORING ioRing, IORING_CQE *cqe);
+  using SetIoRingCompletionEvent_t = HRESULT(WINAPI *)(HIORING ioRing, HANDLE hEvent);
+  using BuildIoRingReadFile_t = HRESULT(WINAPI *)(HIORING ioRing, IORING_HANDLE_REF fileRef, IORING_BUFFER_REF dataRef, UINT32 numberOfBytesToRead,
+                                                  UINT64 fileOffset, UINT_PTR userData, int sqeFlags);
+  using BuildIoRingWriteFile_t = HRESULT(WINAPI *)(HIORING ioRing, IORING_HANDLE_REF fileRef, IORING_BUFFER_REF bufferRef, UINT32 numberOfBytesToWrite,
+                                                   UINT64 fileOffset, int writeFlags, UINT_PTR userData, int sqeFlags);
+  using BuildIoRingFlushFile_t = HRESULT(WINAPI *)(HIORING ioRing, IORING_HANDLE_REF fileRef, FILE_FLUSH_MODE flushMode, UINT_PTR userData, int sqeFlags);
+  using BuildIoRingCancelRequest_t = HRESULT(WINAPI *)(HIORING ioRing, IORING_HANDLE_REF file, UINT_PTR opToCancel, UINT_PTR userData);
+  using BuildIoRingRegisterBuffers_t = HRESULT(WINAPI *)(HIORING ioRing, UINT32 count, IORING_BUFFER_INFO const buffers[], UINT_PTR userData);
+
+  struct functions
+  {
+    CreateIoRing_t CreateIoRing{nullptr};
+    CloseIoRing_t CloseIoRing{nullptr};
+    SubmitIoRing_t SubmitIoRing{nullptr};
+    PopIoRingCompletion_t PopIoRingCompletion{nullptr};
+    SetIoRingCompletionEvent_t SetIoRingCompletionEvent{nullptr};
+    BuildIoRingReadFile_t BuildIoRingReadFile{nullptr};
+    BuildIoRingWriteFile_t BuildIoRingWriteFile{nullptr};  // null before Windows 11 22H2
+    BuildIoRingFlushFile_t BuildIoRingFlushFile{nullptr};  // null before Windows 11 22H2
+    BuildIoRingCancelRequest_t BuildIoRingCancelRequest{nullptr};
+    BuildIoRingRegisterBuffers_t BuildIoRingRegisterBuffers{nullptr};
+
+    bool available() const noexcept
+    {
+      return CreateIoRing != nullptr && CloseIoRing != nullptr && SubmitIoRing != nullptr && PopIoRingCompletion != nullptr &&
+             SetIoRingCompletionEvent != nullptr && BuildIoRingReadFile != nullptr && BuildIoRingCancelRequest != nullptr && BuildIoRingRegisterBuffers != nullptr;
+    }
+  };
+  inline const functions &get() noexcept
+  {
+    static const functions fns = [] {
+      functions ret;
+      HMODULE kernelbase = GetModuleHandleA("KERNELBASE.DLL");
+      if(kernelbase != nullptr)
+      {
+        ret.CreateIoRing = reinterpret_cast<CreateIoRing_t>(GetProcAddress(kernelbase, "CreateIoRing"));
+        ret.CloseIoRing = reinterpret_cast<CloseIoRing_t>(GetProcAddress(kernelbase, "CloseIoRing"));
+        ret.SubmitIoRing = reinterpret_cast<SubmitIoRing_t>(GetProcAddress(kernelbase, "SubmitIoRing"));
+        ret.PopIoRingCompletion = reinterpret_cast<PopIoRingCompletion_t>(GetProcAddress(kernelbase, "PopIoRingCompletion"));
+        ret.SetIoRingCompletionEvent = reinterpret_cast<SetIoRingCompletionEvent_t>(GetProcAddress(kernelbase, "SetIoRingCompletionEvent"));
+        ret.BuildIoRingReadFile = reinterpret_cast<BuildIoRingReadFile_t>(GetProcAddress(kernelbase, "BuildIoRingReadFile"));
+        ret.BuildIoRingWriteFile = reinterpret_cast<BuildIoRingWriteFile_t>(GetProcAddress(kernelbase, "BuildIoRingWriteFile"));
+        ret.BuildIoRingFlushFile = reinterpret_cast<BuildIoRingFlushFile_t>(GetProcAddress(kernelbase, "BuildIoRingFlushFile"));
+        ret.BuildIoRingCancelRequest = reinterpret_cast<BuildIoRingCancelRequest_t>(GetProcAddress(kernelbase, "BuildIoRingCancelRequest"));
+        ret.BuildIoRingRegisterBuffers = reinterpret_cast<BuildIoRingRegisterBuffers_t>(GetProcAddress(kernelbase, "BuildIoRingRegisterBuffers"));
+      }
+      return ret;
+    }();
+    return fns;
+  }
+
+  inline error_info hresult_error(HRESULT hr)
+  {
+    if((hr & 0x1fff0000) == (FACILITY_WIN32 << 16))
+    {
+      return win32_error((DWORD) (hr & 0xffff));
+    }
+    if((hr & 0x10000000 /*FACILITY_NT_BIT*/) != 0)
+    {
+      return ntkernel_error((NTSTATUS) (hr & ~0x10000000));
+    }
+    return win32_error((DWORD) hr);
+  }
+}  // namespace windows_ioring
+
+template <bool is_threadsafe> class win_ioring_multiplexer final : public io_multiplexer_impl<is_threadsafe>
+{
+  using _base = io_multiplexer_impl<is_threadsafe>;
+  using _multiplexer_lock_guard = typename _base::_lock_guard;
+
+  using barrier_kind = typename _base::barrier_kind;
+  using const_buffers_type = typename _base::const_buffers_type;
+  using buffers_type = typename _base::buffers_type;
+  using registered_buffer_type = typename _base::registered_buffer_type;
+  template <class T> using io_request = typename _base::template io_request<T>;
+  template <class T> using io_result = typename _base::template io_result<T>;
+  using io_operation_state = typename _base::io_operation_state;
+  using io_operation_state_visitor = typename _base::io_operation_state_visitor;
+  using check_for_any_completed_io_statistics = typename _base::check_for_any_completed_io_statistics;
+
+  static constexpr size_t _max_buffers = 64;
+  static constexpr size_t _max_registered_buffers = 1024;
+  // Completion user data is the i/o state address plus the buffer index, so states must be aligned to _max_buffers
+  static constexpr UINT_PTR _cancel_userdata = 0;
+  static constexpr UINT_PTR _register_buffers_userdata = 1;
+
+  struct alignas(_max_buffers) _ioring_operation_state final
+      : public std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>
+  {
+    using _impl = std::conditional_t<is_threadsafe, typename _base::_synchronised_io_operation_state, typename _base::_unsynchronised_io_operation_state>;
+
+    // Status is STATUS_PENDING until the completion arrives, whereupon it is the HRESULT of the i/o
+    windows_nt_kernel::IO_STATUS_BLOCK _ols[_max_buffers];
+    bool _uses_registered_buffer{false};
+
+    _ioring_operation_state() = default;
+    _ioring_operation_state(_impl &&o) noexcept
+        : _impl(std::move(o))
+    {
+    }
+    using _impl::_impl;
+
+    virtual io_operation_state *relocate_to(byte *to_) noexcept override
+    {
+      auto *to = _impl::relocate_to(to_);
+      // restamp the vptr with my own
+      new(to) _ioring_operation_state(std::move(*static_cast<_impl *>(to)));
+      return to;
+    }
+  };
+
+  const windows_ioring::functions &_fns{windows_ioring::get()};
+  windows_ioring::HIORING _ring{nullptr};
+  bool _have_write_and_flush{false};
+  bool _submissions_pending{false};
+
+  std::vector<registered_buffer_type> _registered_buffers;  // index is the registered buffer index
+  struct _registered_buffer_index_t
+  {
+    const byte *data;
+    uint16_t idx;
+  };
+  std::vector<_registered_buffer_index_t> _registered_buffers_index;  // ordered by data so can be binary searched
+  size_t _registered_buffers_inflight{0};
+  bool _register_buffers_done{false};
+  HRESULT _register_buffers_result{S_OK};
+
+  // Returns the registered buffer index if the buffer lies within the registered buffer, else -1
+  int _registered_buffer_index(const registered_buffer_type &base, const byte *data, size_t len) const noexcept
+  {
+    if(!base)
+    {
+      return -1;
+    }
+    auto it = std::lower_bound(_registered_buffers_index.begin(), _registered_buffers_index.end(), base->data(),
+                               [](const _registered_buffer_index_t &a, const byte *b) { return a.data < b; });
+    if(it == _registered_buffers_index.end() || it->data != base->data())
+    {
+      return -1;
+    }
+    if(data < base->data() || data + len > base->data() + base->size())
+    {
+      return -1;
+    }
+    return it->idx;
+  }
+
+  static windows_ioring::IORING_HANDLE_REF _handle_ref(HANDLE h) noexcept
+  {
+    windows_ioring::IORING_HANDLE_REF ret;
+    memset(&ret, 0, sizeof(ret));
+    ret.Kind = windows_ioring::IORING_REF_RAW;
+    ret.HandleUnion.Handle = h;
+    return ret;
+  }
+
+  // Builds a submission, submitting everything built so far if the submission queue is full
+  template <class F> HRESULT _build(F &&f) noexcept
+  {
+    HRESULT hr = f();
+    if(hr == windows_ioring::IORING_E_SUBMISSION_QUEUE_FULL)
+    {
+      hr = _fns.SubmitIoRing(_ring, 0, 0, nullptr);
+      if(SUCCEEDED(hr))
+      {
+        hr = f();
+      }
+    }
+    if(SUCCEEDED(hr))
+    {
+      _submissions_pending = true;
+    }
+    return hr;
+  }
+  result<void> _submit() noexcept
+  {
+    if(_submissions_pending)
+    {
+      HRESULT hr = _fns.SubmitIoRing(_ring, 0, 0, nullptr);
+      if(FAILED(hr))
+      {
+        return windows_ioring::hresult_error(hr);
+      }
+      _submissions_pending = false;
+    }
+    return success();
+  }
+
+  // Builds one read or write per buffer. Buffers which could not be built are failed with the
+  // reason, and the number built is returned.
+  template <class BuffersType> size_t _build_read_write(_ioring_operation_state *state, io_request<BuffersType> &reqs, bool is_write) noexcept
+  {
+    const auto &nativeh = state->h->native_handle();
+    const auto fileref = _handle_ref(nativeh.h);
+    UINT64 offset = nativeh.is_append_only() ? (UINT64) -1 : reqs.offset;
+    size_t n = 0;
+    for(; n < reqs.buffers.size(); n++)
+    {
+      auto &req = reqs.buffers[n];
+#ifndef NDEBUG
+      if(nativeh.requires_aligned_io())
+      {
+        assert((offset & 511) == 0);
+        assert(((uintptr_t) req.data() & 511) == 0);
+        assert((req.size() & 511) == 0);
+      }
+#endif
+      // IoRing i/o is limited to 32 bit lengths, so a larger buffer becomes a short transfer
+      const UINT32 bytes = (UINT32) std::min(req.size(), (size_t) 0x80000000);
+      windows_ioring::IORING_BUFFER_REF bufref;
+      memset(&bufref, 0, sizeof(bufref));
+      const int idx = _registered_buffer_index(state->payload.noncompleted.base, req.data(), req.size());
+      if(idx >= 0)
+      {
+        bufref.Kind = windows_ioring::IORING_REF_REGISTERED;
+        bufref.BufferUnion.IndexAndOffset.BufferIndex = (UINT32) idx;
+        bufref.BufferUnion.IndexAndOffset.Offset = (UINT32) (req.data() - state->payload.noncompleted.base->data());
+      }
+      else
+      {
+        bufref.Kind = windows_ioring::IORING_REF_RAW;
+        bufref.BufferUnion.Address = (void *) req.data();
+      }
+      const UINT_PTR userdata = (UINT_PTR) state + n;
+      state->_ols[n].Status = STATUS_PENDING;
+      state->_ols[n].Information = 0;
+      HRESULT hr = _build([&] {
+        return is_write ? _fns.BuildIoRingWriteFile(_ring, fileref, bufref, bytes, offset, 0 /*FILE_WRITE_FLAGS_NONE*/, userdata, 0) :
+                          _fns.BuildIoRingReadFile(_ring, fileref, bufref, bytes, offset, userdata, 0);
+      });
+      if(FAILED(hr))
+      {
+        for(size_t m = n; m < reqs.buffers.size(); m++)
+        {
+          state->_ols[m].Status = (NTSTATUS) hr;
+          state->_ols[m].Information = 0;
+        }
+        break;
+      }
+      if(idx >= 0)
+      {
+        state->_uses_registered_buffer = true;
+        ++_registered_buffers_inflight;
+      }
+      if(!nativeh.is_append_only())
+      {
+        offset += req.size();
+      }
+    }
+    return n;
+  }
+
+  // Returns false if any buffer is still pending, else fills in the result
+  template <class Ret, class Params> static bool _fill_io_result(_ioring_operation_state *state, Ret &ret, Params &params) noexcept
+  {
+    for(size_t n = 0; n < params.reqs.buffers.size(); n++)
+    {
+      if(state->_ols[n].Status == STATUS_PENDING)
+      {
+        return false;
+      }
+    }
+    for(size_t n = 0; n < params.reqs.buffers.size(); n++)
+    {
+      if(state->_ols[n].Status < 0)
+      {
+        ret = windows_ioring::hresult_error((HRESULT) state->_ols[n].Status);
+        break;
+      }
+      params.reqs.buffers[n] = {params.reqs.buffers[n].data(), state->_ols[n].Information};
+      if(params.reqs.buffers[n].size() != 0)
+      {
+        ret = {params.reqs.buffers.data(), n + 1};
+      }
+    }
+    return true;
+  }
+  io_operation_state_type _check_io_operation(_ioring_operation_state *state) noexcept
+  {
+    auto v = state->current_state();
+    switch(v)
+    {
+    case io_operation_state_type::read_initiated:
+    {
+      io_result<buffers_type> ret = {state->payload.noncompleted.params.read.reqs.buffers.data(), 0};
+      if(_fill_io_result(state, ret, state->payload.noncompleted.params.read))
+      {
+        state->read_completed(std::move(ret));
+        state->read_finished();
+        return io_operation_state_type::read_finished;
+      }
+      break;
+    }
+    case io_operation_state_type::write_initiated:
+    {
+      io_result<const_buffers_type> ret = {state->payload.noncompleted.params.write.reqs.buffers.data(), 0};
+      if(_fill_io_result(state, ret, state->payload.noncompleted.params.write))
+      {
+        state->write_completed(std::move(ret));
+        state->write_or_barrier_finished();
+        return io_operation_state_type::write_or_barrier_finished;
+      }
+      break;
+    }
+    case io_operation_state_type::barrier_initiated:
+    {
+      if(state->_ols[0].Status == STATUS_PENDING)
+      {
+        break;
+      }
+      io_result<const_buffers_type> ret(state->payload.noncompleted.params.barrier.reqs.buffers);
+      if(state->_ols[0].Status < 0)
+      {
+        ret = windows_ioring::hresult_error((HRESULT) state->_ols[0].Status);
+      }
+      state->barrier_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      return io_operation_state_type::write_or_barrier_finished;
+    }
+    default:
+      break;
+    }
+    return v;
+  }
+  void _complete(const windows_ioring::IORING_CQE &cqe, check_for_any_completed_io_statistics &stats) noexcept
+  {
+    if(cqe.UserData == _register_buffers_userdata)
+    {
+      _register_buffers_result = cqe.ResultCode;
+      _register_buffers_done = true;
+      return;
+    }
+    if(cqe.UserData == _cancel_userdata)
+    {
+      // The completion of a cancellation request, the cancelled i/o completes separately
+      return;
+    }
+    auto *state = (_ioring_operation_state *) (cqe.UserData & ~(UINT_PTR)(_max_buffers - 1));
+    const size_t n = (size_t) (cqe.UserData & (_max_buffers - 1));
+    if(state->_uses_registered_buffer)
+    {
+      --_registered_buffers_inflight;
+    }
+    state->_ols[n].Information = cqe.Information;
+    state->_ols[n].Status = (NTSTATUS) cqe.ResultCode;
+    if(is_finished(_check_io_operation(state)))
+    {
+      ++stats.initiated_ios_finished;
+    }
+  }
+  size_t _reap(check_for_any_completed_io_statistics &stats, size_t max_completions) noexcept
+  {
+    size_t count = 0;
+    windows_ioring::IORING_CQE cqe;
+    while(count < max_completions && _fns.PopIoRingCompletion(_ring, &cqe) == S_OK)
+    {
+      _complete(cqe, stats);
+      ++count;
+    }
+    return count;
+  }
+
+  // Registers all of _registered_buffers, replacing any previous registration, and waits for it to complete
+  HRESULT _register_buffers() noexcept
+  {
+    auto *infos = (windows_ioring::IORING_BUFFER_INFO *) alloca(_registered_buffers.size() * sizeof(windows_ioring::IORING_BUFFER_INFO));
+    for(size_t n = 0; n < _registered_buffers.size(); n++)
+    {
+      infos[n].Address = _registered_buffers[n]->data();
+      infos[n].Length = (UINT32) _registered_buffers[n]->size();
+    }
+    HRESULT hr = _build([&] { return _fns.BuildIoRingRegisterBuffers(_ring, (UINT32) _registered_buffers.size(), infos, _register_buffers_userdata); });
+    if(FAILED(hr))
+    {
+      return hr;
+    }
+    _register_buffers_done = false;
+    check_for_any_completed_io_statistics stats;
+    while(!_register_buffers_done)
+    {
+      hr = _fns.SubmitIoRing(_ring, 1, INFINITE, nullptr);
+      if(FAILED(hr))
+      {
+        return hr;
+      }
+      _submissions_pending = false;
+      _reap(stats, (size_t) -1);
+    }
+    return _register_buffers_result;
+  }
+
+public:
+  win_ioring_multiplexer() = default;
+  win_ioring_multiplexer(const win_ioring_multiplexer &) = delete;
+  win_ioring_multiplexer(win_ioring_multiplexer &&) = delete;
+  win_ioring_multiplexer &operator=(const win_ioring_multiplexer &) = delete;
+  win_ioring_multiplexer &operator=(win_ioring_multiplexer &&) = delete;
+  virtual ~win_ioring_multiplexer()
+  {
+    if(this->_v)
+    {
+      (void) win_ioring_multiplexer::close();
+    }
+  }
+  result<void> init(size_t threads)
+  {
+    (void) threads;
+    if(!_fns.available())
+    {
+      return errc::function_not_supported;
+    }
+    // The handle of the multiplexer is the event signalled when completions are posted
+    this->_v.h = CreateEventW(nullptr, false, false, nullptr);
+    if(nullptr == this->_v.h)
+    {
+      return win32_error();
+    }
+    this->_v.behaviour |= native_handle_type::disposition::multiplexer;
+    HRESULT hr = windows_ioring::IORING_E_VERSION_NOT_SUPPORTED;
+    for(auto version : {windows_ioring::IORING_VERSION_3, windows_ioring::IORING_VERSION_2, windows_ioring::IORING_VERSION_1})
+    {
+      windows_ioring::IORING_CREATE_FLAGS flags{0, 0};
+      hr = _fns.CreateIoRing(version, flags, 4096, 8192, &_ring);
+      if(hr != windows_ioring::IORING_E_VERSION_NOT_SUPPORTED)
+      {
+        _have_write_and_flush =
+        (version == windows_ioring::IORING_VERSION_3 && _fns.BuildIoRingWriteFile != nullptr && _fns.BuildIoRingFlushFile != nullptr);
+        break;
+      }
+    }
+    if(FAILED(hr))
+    {
+      _ring = nullptr;
+      return windows_ioring::hresult_error(hr);
+    }
+    hr = _fns.SetIoRingCompletionEvent(_ring, this->_v.h);
+    if(FAILED(hr))
+    {
+      return windows_ioring::hresult_error(hr);
+    }
+    return success();
+  }
+
+  // virtual result<path_type> current_path() const noexcept override;
+  virtual result<void> close() noexcept override
+  {
+    if(_ring != nullptr)
+    {
+      _fns.CloseIoRing(_ring);
+      _ring = nullptr;
+    }
+    _registered_buffers.clear();
+    _registered_buffers_index.clear();
+#ifndef NDEBUG
+    if(this->_v)
+    {
+      // Tell handle::close() that we have correctly executed
+      this->_v.behaviour |= native_handle_type::disposition::_child_close_executed;
+    }
+#endif
+    return _base::close();
+  }
+  // virtual native_handle_type release() noexcept override { return _base::release(); }
+
+  virtual result<uint8_t> do_io_handle_register(io_handle *h) noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    // IoRing can only do i/o on files
+    if(h->is_pipe() || h->is_socket())
+    {
+      return errc::operation_not_supported;
+    }
+    return (uint8_t) 0;
+  }
+  virtual result<void> do_io_handle_deregister(io_handle * /*unused*/) noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    return success();
+  }
+  virtual size_t do_io_handle_max_buffers(const io_handle * /*unused*/) const noexcept override { return _max_buffers; }
+  virtual result<registered_buffer_type> do_io_handle_allocate_registered_buffer(io_handle *h, size_t &bytes) noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    // Try to reuse any previously registered buffers no longer in use, as
+    // registered buffer registration is expensive
+    for(auto &b : _registered_buffers)
+    {
+      if(b.use_count() == 1 && b->size() >= bytes)
+      {
+        bytes = b->size();
+        return b;
+      }
+    }
+    OUTCOME_TRY(auto &&ret, _base::do_io_handle_allocate_registered_buffer(h, bytes));
+    if(_registered_buffers.size() >= _max_registered_buffers || _registered_buffers_inflight > 0 || ret->size() > 0xffffffff)
+    {
+      // Can't register this buffer right now, so return it unregistered
+      return result<registered_buffer_type>(std::move(ret));
+    }
+    try
+    {
+      _registered_buffers.push_back(ret);
+      _registered_buffers_index.reserve(_registered_buffers.size());
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+    if(FAILED(_register_buffers()))
+    {
+      // Restore previous registrations and return the buffer unregistered
+      _registered_buffers.pop_back();
+      if(!_registered_buffers.empty())
+      {
+        (void) _register_buffers();
+      }
+      return result<registered_buffer_type>(std::move(ret));
+    }
+    _registered_buffers_index.clear();
+    for(size_t n = 0; n < _registered_buffers.size(); n++)
+    {
+      _registered_buffers_index.push_back({_registered_buffers[n]->data(), (uint16_t) n});
+    }
+    std::sort(_registered_buffers_index.begin(), _registered_buffers_index.end(),
+              [](const _registered_buffer_index_t &a, const _registered_buffer_index_t &b) { return a.data < b.data; });
+    return result<registered_buffer_type>(std::move(ret));
+  }
+  virtual std::pair<size_t, size_t> io_state_requirements() noexcept override { return {sizeof(_ioring_operation_state), alignof(_ioring_operation_state)}; }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_ioring_operation_state));
+    assert(((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) == 0);
+    if(storage.size() < sizeof(_ioring_operation_state) || ((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _ioring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs) noexcept override
+  {
+    assert(storage.size() >= sizeof(_ioring_operation_state));
+    assert(((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) == 0);
+    if(storage.size() < sizeof(_ioring_operation_state) || ((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _ioring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs));
+  }
+  virtual io_operation_state *construct(span<byte> storage, io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d, io_request<const_buffers_type> reqs, barrier_kind kind) noexcept override
+  {
+    assert(storage.size() >= sizeof(_ioring_operation_state));
+    assert(((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) == 0);
+    if(storage.size() < sizeof(_ioring_operation_state) || ((uintptr_t) storage.data() & (alignof(_ioring_operation_state) - 1)) != 0)
+    {
+      return nullptr;
+    }
+    return new(storage.data()) _ioring_operation_state(_h, _visitor, std::move(b), d, std::move(reqs), kind);
+  }
+  virtual io_operation_state_type init_io_operation(io_operation_state *_op) noexcept override
+  {
+    windows_nt_kernel::init();
+    using namespace windows_nt_kernel;
+    LLFIO_LOG_FUNCTION_CALL(this);
+    auto *state = static_cast<_ioring_operation_state *>(_op);
+    switch(state->state)
+    {
+    case io_operation_state_type::unknown:
+      abort();
+    case io_operation_state_type::read_initialised:
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      auto &reqs = state->payload.noncompleted.params.read.reqs;
+      if(reqs.buffers.size() > _max_buffers)
+      {
+        state->read_completed(io_result<buffers_type>(errc::argument_list_too_long));
+        state->read_finished();
+        return io_operation_state_type::read_finished;
+      }
+      if(reqs.buffers.empty() || _build_read_write(state, reqs, false) == 0)
+      {
+        // Nothing was built, so the i/o is done
+        state->read_initiated();
+        return _check_io_operation(state);
+      }
+      state->read_initiated();
+      return io_operation_state_type::read_initiated;
+    }
+    case io_operation_state_type::write_initialised:
+    {
+      auto &reqs = state->payload.noncompleted.params.write.reqs;
+      if(reqs.buffers.size() > _max_buffers)
+      {
+        state->write_completed(io_result<const_buffers_type>(errc::argument_list_too_long));
+        state->write_or_barrier_finished();
+        return io_operation_state_type::write_or_barrier_finished;
+      }
+      if(!_have_write_and_flush)
+      {
+        // IoRing before Windows 11 22H2 can only read, so the write is executed synchronously
+        io_result<const_buffers_type> ret(reqs.buffers);
+        do_read_write<true>(ret, NtWriteFile, state->h->native_handle(), nullptr, state->_ols, reqs, deadline());
+        state->write_completed(std::move(ret));
+        state->write_or_barrier_finished();
+        return io_operation_state_type::write_or_barrier_finished;
+      }
+      _multiplexer_lock_guard g(this->_lock);
+      if(reqs.buffers.empty() || _build_read_write(state, reqs, true) == 0)
+      {
+        state->write_initiated();
+        return _check_io_operation(state);
+      }
+      state->write_initiated();
+      return io_operation_state_type::write_initiated;
+    }
+    case io_operation_state_type::barrier_initialised:
+    {
+      const auto kind = state->payload.noncompleted.params.barrier.kind;
+      if(_have_write_and_flush)
+      {
+        _multiplexer_lock_guard g(this->_lock);
+        windows_ioring::FILE_FLUSH_MODE mode = (kind <= barrier_kind::wait_data_only) ? windows_ioring::FILE_FLUSH_DATA : windows_ioring::FILE_FLUSH_DEFAULT;
+        if(((uint8_t) kind & 1) == 0)
+        {
+          mode = windows_ioring::FILE_FLUSH_NO_SYNC;
+        }
+        state->_ols[0].Status = STATUS_PENDING;
+        state->_ols[0].Information = 0;
+        HRESULT hr = _build([&] { return _fns.BuildIoRingFlushFile(_ring, _handle_ref(state->h->native_handle().h), mode, (UINT_PTR) state, 0); });
+        if(FAILED(hr))
+        {
+          state->_ols[0].Status = (NTSTATUS) hr;
+          state->barrier_initiated();
+          return _check_io_operation(state);
+        }
+        state->barrier_initiated();
+        return io_operation_state_type::barrier_initiated;
+      }
+      // IoRing before Windows 11 22H2 cannot flush, so the barrier is executed synchronously
+      io_result<const_buffers_type> ret(state->payload.noncompleted.params.barrier.reqs.buffers);
+      IO_STATUS_BLOCK isb = make_iostatus();
+      NTSTATUS ntstat;
+      if(NtFlushBuffersFileEx != nullptr)
+      {
+        ULONG flags = (kind <= barrier_kind::wait_data_only) ? 1 /*FLUSH_FLAGS_FILE_DATA_ONLY*/ : 0;
+        if(((uint8_t) kind & 1) == 0)
+        {
+          flags |= 2 /*FLUSH_FLAGS_NO_SYNC*/;
+        }
+        ntstat = NtFlushBuffersFileEx(state->h->native_handle().h, flags, nullptr, 0, &isb);
+      }
+      else
+      {
+        ntstat = NtFlushBuffersFile(state->h->native_handle().h, &isb);
+      }
+      if(STATUS_PENDING == ntstat)
+      {
+        ntstat = ntwait(state->h->native_handle().h, isb, deadline());
+      }
+      if(ntstat < 0)
+      {
+        ret = ntkernel_error(ntstat);
+      }
+      state->barrier_completed(std::move(ret));
+      state->write_or_barrier_finished();
+      return io_operation_state_type::write_or_barrier_finished;
+    }
+    case io_operation_state_type::read_initiated:
+    case io_operation_state_type::read_completed:
+    case io_operation_state_type::read_finished:
+    case io_operation_state_type::write_initiated:
+    case io_operation_state_type::barrier_initiated:
+    case io_operation_state_type::write_or_barrier_completed:
+    case io_operation_state_type::write_or_barrier_finished:
+      assert(false);
+      break;
+    }
+    return state->state;
+  }
+  // init_io_operation() only builds submissions, this tells the kernel about them
+  virtual result<void> flush_inited_io_operations() noexcept override
+  {
+    _multiplexer_lock_guard g(this->_lock);
+    return _submit();
+  }
+  virtual io_operation_state_type check_io_operation(io_operation_state *_op) noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      (void) _submit();
+      check_for_any_completed_io_statistics stats;
+      _reap(stats, (size_t) -1);
+    }
+    return _op->current_state();
+  }
+  // Builds cancellation requests for the i/o still pending of a state. Must be called with the lock held.
+  result<io_operation_state_type> _build_cancel(_ioring_operation_state *state) noexcept
+  {
+    size_t count = 0;
+    switch(state->current_state())
+    {
+    case io_operation_state_type::unknown:
+      return errc::invalid_argument;
+    case io_operation_state_type::read_initiated:
+      count = state->payload.noncompleted.params.read.reqs.buffers.size();
+      break;
+    case io_operation_state_type::write_initiated:
+      count = state->payload.noncompleted.params.write.reqs.buffers.size();
+      break;
+    case io_operation_state_type::barrier_initiated:
+      count = 1;
+      break;
+    default:
+      return state->current_state();
+    }
+    // The cancelled i/o completes through the ring as usual, with ERROR_OPERATION_ABORTED
+    const auto fileref = _handle_ref(state->h->native_handle().h);
+    for(size_t n = 0; n < count; n++)
+    {
+      if(state->_ols[n].Status == STATUS_PENDING)
+      {
+        HRESULT hr = _build([&] { return _fns.BuildIoRingCancelRequest(_ring, fileref, (UINT_PTR) state + n, _cancel_userdata); });
+        if(FAILED(hr))
+        {
+          return windows_ioring::hresult_error(hr);
+        }
+      }
+    }
+    return state->current_state();
+  }
+  virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *_op, deadline /*unused*/ = {}) noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    auto *state = static_cast<_ioring_operation_state *>(_op);
+    _multiplexer_lock_guard g(this->_lock);
+    OUTCOME_TRY(auto &&s, _build_cancel(state));
+    if(!is_initiated(s))
+    {
+      return s;
+    }
+    OUTCOME_TRY(_submit());
+    check_for_any_completed_io_statistics stats;
+    _reap(stats, (size_t) -1);
+    return state->current_state();
+  }
+  // The cancellations for the whole batch are submitted with a single syscall
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      for(auto *op : ops)
+      {
+        OUTCOME_TRY(_build_cancel(static_cast<_ioring_operation_state *>(op)));
+      }
+      OUTCOME_TRY(_submit());
+      check_for_any_completed_io_statistics stats;
+      _reap(stats, (size_t) -1);
+    }
+    return this->_wait_for_finished_io_operations(ops, d);
+  }
+  virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0), size_t max_completions = (size_t) -1) noexcept override
+  {
+    windows_nt_kernel::init();
+    using namespace windows_nt_kernel;
+    LLFIO_LOG_FUNCTION_CALL(this);
+    LLFIO_WIN_DEADLINE_TO_SLEEP_INIT(d);
+    check_for_any_completed_io_statistics stats;
+    if(max_completions == 0)
+    {
+      return stats;
+    }
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      OUTCOME_TRY(_submit());
+      if(_reap(stats, max_completions) > 0)
+      {
+        return stats;
+      }
+    }
+    if(timeout != nullptr && timeout->QuadPart == 0)
+    {
+      return stats;
+    }
+    // The completion event is signalled when completions are posted, or by wake_check_for_any_completed_io()
+    NTSTATUS ntstat = NtWaitForSingleObject(this->_v.h, false, timeout);
+    if(ntstat < 0)
+    {
+      return ntkernel_error(ntstat);
+    }
+    if(ntstat != STATUS_TIMEOUT)
+    {
+      _multiplexer_lock_guard g(this->_lock);
+      _reap(stats, max_completions);
+    }
+    return stats;
+  }
+  virtual result<void> wake_check_for_any_completed_io() noexcept override
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    if(!SetEvent(this->_v.h))
+    {
+      return win32_error();
+    }
+    return success();
+  }
+};
+
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_win_ioring(size_t threads) noexcept
+{
+  try
+  {
+    if(1 == threads)
+    {
+      auto ret = std::make_unique<win_ioring_multiplexer<false>>();
+      OUTCOME_TRY(ret->init(1));
+      return ret;
+    }
+    auto ret = std::make_unique<win_ioring_multiplexer<true>>();
+    OUTCOME_TRY(ret->init(threads));
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+LLFIO_V2_NAMESPACE_END
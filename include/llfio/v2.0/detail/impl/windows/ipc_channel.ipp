@@ -0,0 +1,59 @@
+/* A shared memory message channel between processes
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../ipc_channel.hpp"
+#include "import.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+namespace detail
+{
+  result<void> ipc_channel_wait(std::atomic<uint32_t> *addr, uint32_t expected, deadline d) noexcept
+  {
+    // WaitOnAddress() only works within a process, so poll with backoff
+    LLFIO_WIN_DEADLINE_TO_SLEEP_INIT(d);
+    (void) timeout;
+    unsigned spins = 0;
+    while(addr->load(std::memory_order_acquire) == expected)
+    {
+      LLFIO_WIN_DEADLINE_TO_TIMEOUT_LOOP(d);
+      if(++spins < 64)
+      {
+        YieldProcessor();
+      }
+      else
+      {
+        Sleep((spins < 1024) ? 0 : 1);
+      }
+    }
+    return success();
+  }
+
+  void ipc_channel_wake(std::atomic<uint32_t> *addr) noexcept
+  {
+    (void) addr;  // waiters poll
+  }
+}  // namespace detail
+
+LLFIO_V2_NAMESPACE_END
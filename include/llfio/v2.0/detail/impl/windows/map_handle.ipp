@@ -31,6 +31,16 @@ Distributed under the Boost Software License, Version 1.0.
 
 LLFIO_V2_NAMESPACE_BEGIN
 
+// True if an anonymous section is backed by the swap file, and reserves rather than commits its pages
+static inline bool win32_section_is_reserved(section_handle::flag _flag, const file_handle &anonh) noexcept
+{
+  if(anonh.is_valid() || (_flag & section_handle::flag::executable) || (_flag & section_handle::flag::page_sizes_1) == section_handle::flag::page_sizes_1)
+  {
+    return false;
+  }
+  return !_flag || !!(_flag & section_handle::flag::nocommit);
+}
+
 section_handle::~section_handle()
 {
   if(_v)
@@ -157,6 +167,18 @@ result<section_handle> section_handle::section(file_handle &backing, extent_type
   if(maximum_size > 0)
   {
     _maximum_size.QuadPart = maximum_size;
+    /* A writable section larger than its backing file extends the file, which for files not
+    marked sparse allocates storage for all of the extension. Files created by LLFIO are
+    already sparse, but those we merely opened may not be.
+    */
+    if(!!(_flag & flag::write) && !(_flag & flag::cow) && !(backing.flags() & file_handle::flag::win_disable_sparse_file_creation))
+    {
+      OUTCOME_TRY(auto &&length, backing.maximum_extent());
+      if(maximum_size > length)
+      {
+        do_set_sparse(backing.native_handle());
+      }
+    }
   }
   else
   {
@@ -180,10 +202,33 @@ result<section_handle> section_handle::section(file_handle &backing, extent_type
 
 result<section_handle> section_handle::section(extent_type bytes, const path_handle &dirh, flag _flag) noexcept
 {
-  windows_nt_kernel::init();
-  using namespace windows_nt_kernel;
   OUTCOME_TRY(auto &&_anonh, file_handle::temp_inode(dirh));
   OUTCOME_TRYV(_anonh.truncate(bytes));
+  return _anonymous_section(bytes, std::move(_anonh), _flag);
+}
+
+result<section_handle> section_handle::anonymous_section(extent_type bytes, flag _flag) noexcept
+{
+  // Backed by the paging file
+  return _anonymous_section(bytes, file_handle(), _flag);
+}
+
+result<void> section_handle::seal() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  return errc::operation_not_supported;
+}
+
+result<bool> section_handle::is_sealed() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  return false;
+}
+
+result<section_handle> section_handle::_anonymous_section(extent_type bytes, file_handle &&_anonh, flag _flag) noexcept
+{
+  windows_nt_kernel::init();
+  using namespace windows_nt_kernel;
   result<section_handle> ret(section_handle(native_handle_type(), nullptr, std::move(_anonh), _flag));
   native_handle_type &nativeh = ret.value()._v;
   file_handle &anonh = ret.value()._anonymous;
@@ -228,6 +273,12 @@ result<section_handle> section_handle::section(extent_type bytes, const path_han
     attribs = SEC_RESERVE;
     prot = PAGE_READWRITE;
   }
+  // Likewise memory from the swap file asked not to be committed is only reserved, so it adds
+  // nothing to the commit charge until views of it are committed with `map_handle::commit()`
+  else if(win32_section_is_reserved(_flag, anonh))
+  {
+    attribs = SEC_RESERVE;
+  }
   if(_flag & flag::executable)
   {
     attribs = SEC_IMAGE;
@@ -257,7 +308,7 @@ result<section_handle> section_handle::section(extent_type bytes, const path_han
   _maximum_size.QuadPart = bytes;
   LLFIO_LOG_FUNCTION_CALL(&ret);
   HANDLE h;
-  NTSTATUS ntstat = NtCreateSection(&h, SECTION_ALL_ACCESS, nullptr, pmaximum_size, prot, attribs, anonh.native_handle().h);
+  NTSTATUS ntstat = NtCreateSection(&h, SECTION_ALL_ACCESS, nullptr, pmaximum_size, prot, attribs, anonh.is_valid() ? anonh.native_handle().h : nullptr);
   if(ntstat < 0)
   {
     return ntkernel_error(ntstat);
@@ -523,6 +574,17 @@ static inline result<void> win32_release_nonfile_allocations(byte *addr, size_t
   return success();
 }
 
+map_handle::cache_statistics_t map_handle::cache_statistics() noexcept
+{
+  // Not implemented on Windows yet
+  return {};
+}
+
+map_handle::cache_statistics_t map_handle::trim_cache() noexcept
+{
+  return {};
+}
+
 map_handle::~map_handle()
 {
   if(_addr != nullptr)
@@ -556,6 +618,7 @@ result<void> map_handle::close() noexcept
     {
       OUTCOME_TRYV(win32_release_nonfile_allocations(_addr, _reservation, MEM_RELEASE));
     }
+    _account_page_size(-(ptrdiff_t) _reservation);
   }
   // We don't want ~handle() to close our borrowed handle
   _v = native_handle_type();
@@ -567,6 +630,10 @@ result<void> map_handle::close() noexcept
 native_handle_type map_handle::release() noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(this);
+  if(_addr != nullptr)
+  {
+    _account_page_size(-(ptrdiff_t) _reservation);
+  }
   // We don't want ~handle() to close our borrowed handle
   _v = native_handle_type();
   _addr = nullptr;
@@ -577,7 +644,7 @@ native_handle_type map_handle::release() noexcept
 map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_barrier(map_handle::io_request<map_handle::const_buffers_type> reqs, barrier_kind kind,
                                                                               deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   byte *addr = _addr + reqs.offset;
   extent_type bytes = 0;
   // Check for overflow
@@ -626,14 +693,134 @@ result<map_handle> map_handle::map(size_type bytes, bool /*unused*/, section_han
   native_handle_type &nativeh = ret.value()._v;
   DWORD allocation = MEM_RESERVE | MEM_COMMIT, prot;
   PVOID addr = nullptr;
+  size_type pagesize;
+  LLFIO_LOG_FUNCTION_CALL(&ret);
+  if(ret.value()._flag & section_handle::flag::page_sizes_fallback)
+  {
+    // Try successively smaller page sizes, updating the flags to the page size obtained
+    try
+    {
+      const auto &pagesizes = utils::page_sizes();
+      size_t idx = detail::pagesize_index_from_flags(ret.value()._flag);
+      if(idx == 0 || idx >= pagesizes.size())
+      {
+        idx = pagesizes.size() - 1;
+      }
+      auto &flags = ret.value()._flag;
+      flags &= ~(section_handle::flag::page_sizes_3 | section_handle::flag::transparent_huge_pages);
+      bool fellback = false;
+      for(;; idx--)
+      {
+        pagesize = pagesizes[idx];
+        // Don't round small allocations up to a large page
+        if(idx > 0 && bytes < pagesize)
+        {
+          continue;
+        }
+        size_type _bytes = utils::round_up_to_page_size(bytes, pagesize);
+        size_t commitsize;
+        DWORD _allocation = allocation;
+        if(win32_map_flags(nativeh, _allocation, prot, commitsize, true, flags | detail::pagesize_flags_from_index(idx)))
+        {
+          if(flags & section_handle::flag::track_dirty)
+          {
+            _allocation |= MEM_WRITE_WATCH;
+          }
+          addr = VirtualAlloc(nullptr, _bytes, _allocation, prot);
+        }
+        if(addr != nullptr)
+        {
+          flags |= detail::pagesize_flags_from_index(idx);
+          bytes = _bytes;
+          break;
+        }
+        if(idx == 0)
+        {
+          return win32_error();
+        }
+        fellback = true;
+      }
+      if(fellback)
+      {
+        detail::map_handle_page_size_counters_instance().fallbacks.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+  else
+  {
+    OUTCOME_TRY(pagesize, detail::pagesize_from_flags(ret.value()._flag));
+    bytes = utils::round_up_to_page_size(bytes, pagesize);
+    {
+      size_t commitsize;
+      OUTCOME_TRY(win32_map_flags(nativeh, allocation, prot, commitsize, true, ret.value()._flag));
+    }
+    if(_flag & section_handle::flag::track_dirty)
+    {
+      allocation |= MEM_WRITE_WATCH;
+    }
+    addr = VirtualAlloc(nullptr, bytes, allocation, prot);
+    if(addr == nullptr)
+    {
+      return win32_error();
+    }
+  }
+  ret.value()._addr = static_cast<byte *>(addr);
+  ret.value()._reservation = bytes;
+  ret.value()._length = bytes;
+  ret.value()._pagesize = pagesize;
+  nativeh._init = -2;  // otherwise appears closed
+  nativeh.behaviour |= native_handle_type::disposition::allocation;
+  ret.value()._account_page_size((ptrdiff_t) bytes);
+
+  // Windows has no way of getting the kernel to prefault maps on creation, so ...
+  if((_flag & section_handle::flag::prefault) || (_flag & section_handle::flag::prefault_write) || (_flag & section_handle::flag::prefault_async))
+  {
+    (void) populate({static_cast<byte *>(addr), bytes}, (_flag & section_handle::flag::prefault_write) && (_flag & section_handle::flag::write),
+                    !!(_flag & section_handle::flag::prefault_async));
+  }
+  return ret;
+}
+
+result<map_handle> map_handle::map(size_type bytes, numa_policy policy, bool zeroed, section_handle::flag _flag) noexcept
+{
+  switch(policy.policy)
+  {
+  case numa_policy::kind::local:
+    return map(bytes, zeroed, _flag);
+  case numa_policy::kind::interleave:
+    return errc::operation_not_supported;
+  case numa_policy::kind::bind:
+  case numa_policy::kind::preferred:
+    break;
+  }
+  if(policy.nodes == 0)
+  {
+    return errc::invalid_argument;
+  }
+  DWORD node = 0;
+  while(!(policy.nodes & (1ULL << node)))
+  {
+    node++;
+  }
+  result<map_handle> ret(map_handle(nullptr, _flag));
+  native_handle_type &nativeh = ret.value()._v;
+  DWORD allocation = MEM_RESERVE | MEM_COMMIT, prot;
   OUTCOME_TRY(auto &&pagesize, detail::pagesize_from_flags(ret.value()._flag));
   bytes = utils::round_up_to_page_size(bytes, pagesize);
   {
     size_t commitsize;
     OUTCOME_TRY(win32_map_flags(nativeh, allocation, prot, commitsize, true, ret.value()._flag));
   }
+  if(_flag & section_handle::flag::track_dirty)
+  {
+    allocation |= MEM_WRITE_WATCH;
+  }
   LLFIO_LOG_FUNCTION_CALL(&ret);
-  addr = VirtualAlloc(nullptr, bytes, allocation, prot);
+  PVOID addr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, allocation, prot, node);
   if(addr == nullptr)
   {
     return win32_error();
@@ -644,20 +831,6 @@ result<map_handle> map_handle::map(size_type bytes, bool /*unused*/, section_han
   ret.value()._pagesize = pagesize;
   nativeh._init = -2;  // otherwise appears closed
   nativeh.behaviour |= native_handle_type::disposition::allocation;
-
-  // Windows has no way of getting the kernel to prefault maps on creation, so ...
-  if(_flag & section_handle::flag::prefault)
-  {
-    using namespace windows_nt_kernel;
-    // Start an asynchronous prefetch, so it might fault the whole lot in at once
-    buffer_type b{static_cast<byte *>(addr), bytes};
-    (void) prefetch(span<buffer_type>(&b, 1));
-    volatile auto *a = static_cast<volatile char *>(addr);
-    for(size_t n = 0; n < bytes; n += pagesize)
-    {
-      a[n];
-    }
-  }
   return ret;
 }
 
@@ -675,6 +848,11 @@ result<map_handle> map_handle::map(section_handle &section, size_type bytes, ext
   OUTCOME_TRY(auto &&pagesize, detail::pagesize_from_flags(ret.value()._flag));
   SIZE_T _bytes = bytes;
   OUTCOME_TRY(win32_map_flags(nativeh, allocation, prot, commitsize, section.backing() != nullptr, ret.value()._flag));
+  if(section.backing() == nullptr && (ret.value()._flag & section_handle::flag::nocommit) && win32_section_is_reserved(section.section_flags(), section._anonymous))
+  {
+    // Views of reserved swap file backed sections commit only what is asked for, here nothing
+    commitsize = 0;
+  }
   LLFIO_LOG_FUNCTION_CALL(&ret);
   NTSTATUS ntstat = NtMapViewOfSection(section.native_handle().h, GetCurrentProcess(), &addr, 0, commitsize, &_offset, &_bytes, ViewUnmap, allocation, prot);
   if(ntstat < 0)
@@ -691,16 +869,11 @@ result<map_handle> map_handle::map(section_handle &section, size_type bytes, ext
   nativeh.behaviour |= native_handle_type::disposition::allocation;
 
   // Windows has no way of getting the kernel to prefault maps on creation, so ...
-  if(ret.value()._flag & section_handle::flag::prefault)
+  const auto mapflags = ret.value()._flag;
+  if((mapflags & section_handle::flag::prefault) || (mapflags & section_handle::flag::prefault_write) || (mapflags & section_handle::flag::prefault_async))
   {
-    // Start an asynchronous prefetch, so it might fault the whole lot in at once
-    buffer_type b{static_cast<byte *>(addr), _bytes};
-    (void) prefetch(span<buffer_type>(&b, 1));
-    volatile auto *a = static_cast<volatile char *>(addr);
-    for(size_t n = 0; n < _bytes; n += pagesize)
-    {
-      a[n];
-    }
+    (void) populate({static_cast<byte *>(addr), _bytes}, (mapflags & section_handle::flag::prefault_write) && (mapflags & section_handle::flag::write),
+                    !!(mapflags & section_handle::flag::prefault_async));
   }
   return ret;
 }
@@ -710,6 +883,7 @@ result<map_handle::size_type> map_handle::truncate(size_type newsize, bool /* un
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
   LLFIO_LOG_FUNCTION_CALL(this);
+  auto reaccount = make_scope_exit([this, oldreservation = _reservation]() noexcept { _account_page_size((ptrdiff_t) _reservation - (ptrdiff_t) oldreservation); });
   newsize = utils::round_up_to_page_size(newsize, _pagesize);
   if(newsize == _reservation)
   {
@@ -739,6 +913,10 @@ result<map_handle::size_type> map_handle::truncate(size_type newsize, bool /* un
     DWORD allocation = MEM_RESERVE | MEM_COMMIT, prot;
     size_t commitsize;
     OUTCOME_TRY(win32_map_flags(nativeh, allocation, prot, commitsize, true, _flag));
+    if(_flag & section_handle::flag::track_dirty)
+    {
+      allocation |= MEM_WRITE_WATCH;
+    }
     if(!VirtualAlloc(_addr + _reservation, newsize - _reservation, allocation, prot))
     {
       return win32_error();
@@ -832,6 +1010,181 @@ result<map_handle::buffer_type> map_handle::decommit(buffer_type region) noexcep
   return region;
 }
 
+result<span<map_handle::buffer_type>> map_handle::commit(span<buffer_type> regions, section_handle::flag flag) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+  // Windows has no vectored form of VirtualAlloc(), so merging is all we can do
+  for(auto &region : merged)
+  {
+    OUTCOME_TRY(auto &&done, commit(region, flag));
+    region = done;
+  }
+  return merged;
+}
+
+result<span<map_handle::buffer_type>> map_handle::decommit(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+  for(auto &region : merged)
+  {
+    OUTCOME_TRY(auto &&done, decommit(region));
+    region = done;
+  }
+  return merged;
+}
+
+result<void> map_handle::clear_dirty() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_section == nullptr && (_flag & section_handle::flag::track_dirty) && _addr != nullptr)
+  {
+    if(ResetWriteWatch(_addr, _reservation) != 0)
+    {
+      return win32_error();
+    }
+  }
+  return success();
+}
+
+result<span<map_handle::buffer_type>> map_handle::dirty_regions(span<buffer_type> out, buffer_type region) const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    region = {_addr, _length};
+  }
+  region = utils::round_to_page_size_larger(region, _pagesize);
+  if(out.empty() || region.empty())
+  {
+    return span<buffer_type>(out.data(), 0);
+  }
+  // Maps of sections cannot be write watched
+  if(_section != nullptr || !(_flag & section_handle::flag::track_dirty))
+  {
+    out[0] = region;
+    return span<buffer_type>(out.data(), 1);
+  }
+  size_t count = 0;
+  PVOID addresses[256];
+  byte *const end = region.data() + region.size();
+  for(byte *addr = region.data(); addr < end;)
+  {
+    ULONG_PTR written = sizeof(addresses) / sizeof(addresses[0]);
+    ULONG granularity = 0;
+    if(GetWriteWatch(0, addr, end - addr, addresses, &written, &granularity) != 0)
+    {
+      return win32_error();
+    }
+    for(ULONG_PTR n = 0; n < written; n++)
+    {
+      auto *page = static_cast<byte *>(addresses[n]);
+      if(count > 0 && out[count - 1].data() + out[count - 1].size() == page)
+      {
+        out[count - 1] = {out[count - 1].data(), out[count - 1].size() + granularity};
+        continue;
+      }
+      if(count == out.size())
+      {
+        return span<buffer_type>(out.data(), count);
+      }
+      out[count++] = {page, granularity};
+    }
+    if(written < sizeof(addresses) / sizeof(addresses[0]))
+    {
+      break;
+    }
+    addr = static_cast<byte *>(addresses[written - 1]) + granularity;
+  }
+  return span<buffer_type>(out.data(), count);
+}
+
+result<map_handle::size_type> map_handle::barrier_dirty(span<buffer_type> scratch, barrier_kind kind, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(scratch.empty())
+  {
+    return errc::invalid_argument;
+  }
+  // Metadata is barriered once for the whole file afterwards, not per extent
+  const barrier_kind extentkind = (kind >= barrier_kind::nowait_all) ? static_cast<barrier_kind>((uint8_t) kind - 2) : kind;
+  size_type bytes = 0;
+  byte *const mapend = _addr + _length;
+  buffer_type region{_addr, _length};
+  while(!region.empty())
+  {
+    OUTCOME_TRY(auto &&dirty, dirty_regions(scratch, region));
+    for(auto &i : dirty)
+    {
+      const_buffer_type b{i.data(), (size_type)((std::min)(i.data() + i.size(), mapend) - i.data())};
+      OUTCOME_TRYV(barrier(io_request<const_buffers_type>(const_buffers_type(&b, 1), (extent_type)(i.data() - _addr)), extentkind, d));
+      bytes += b.size();
+    }
+    if(dirty.size() < scratch.size())
+    {
+      break;
+    }
+    byte *next = (std::min)(dirty.back().data() + dirty.back().size(), mapend);
+    region = {next, (size_type)(mapend - next)};
+  }
+  if(bytes > 0 && _section != nullptr && _section->backing() != nullptr && kind >= barrier_kind::nowait_all)
+  {
+    OUTCOME_TRYV(_section->backing()->barrier(kind, d));
+  }
+  OUTCOME_TRYV(clear_dirty());
+  return bytes;
+}
+
+result<void> map_handle::set_numa_policy(numa_policy policy, buffer_type /*unused*/, bool /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // Windows can only place memory upon a node when allocating it
+  if(policy.policy != numa_policy::kind::local)
+  {
+    return errc::operation_not_supported;
+  }
+  return success();
+}
+
+result<span<int>> map_handle::numa_nodes(span<int> nodes, buffer_type region) const noexcept
+{
+  windows_nt_kernel::init();
+  using namespace windows_nt_kernel;
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    region = {_addr, _reservation};
+  }
+  region = utils::round_to_page_size_larger(region, _pagesize);
+  size_t pages = region.size() / _pagesize;
+  if(pages < nodes.size())
+  {
+    nodes = nodes.subspan(0, pages);
+  }
+  MEMORY_WORKING_SET_EX_INFORMATION infos[64];
+  for(size_t n = 0; n < nodes.size();)
+  {
+    const size_t count = std::min(nodes.size() - n, sizeof(infos) / sizeof(infos[0]));
+    for(size_t i = 0; i < count; i++)
+    {
+      infos[i].VirtualAddress = region.data() + (n + i) * _pagesize;
+    }
+    SIZE_T written = 0;
+    NTSTATUS ntstat = NtQueryVirtualMemory(GetCurrentProcess(), nullptr, MemoryWorkingSetExInformation, infos, count * sizeof(infos[0]), &written);
+    if(ntstat < 0)
+    {
+      return ntkernel_error(ntstat);
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+      nodes[n + i] = infos[i].VirtualAttributes.IfValid.Valid ? (int) infos[i].VirtualAttributes.IfValid.Node : -1;
+    }
+    n += count;
+  }
+  return nodes;
+}
+
 result<void> map_handle::zero_memory(buffer_type region) noexcept
 {
   windows_nt_kernel::init();
@@ -878,6 +1231,47 @@ result<void> map_handle::zero_memory(buffer_type region) noexcept
   return success();
 }
 
+result<void> map_handle::zero_memory(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, 1));
+  for(auto &region : merged)
+  {
+    OUTCOME_TRYV(zero_memory(region));
+  }
+  return success();
+}
+
+result<map_handle::buffer_type> map_handle::populate(buffer_type region, bool for_write, bool asynchronous) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  region = utils::round_to_page_size_larger(region, utils::page_size());
+  if(region.data() == nullptr)
+  {
+    return errc::invalid_argument;
+  }
+  // Start an asynchronous prefetch, so it might fault the whole lot in at once
+  (void) prefetch(span<buffer_type>(&region, 1));
+  if(asynchronous)
+  {
+    // Touching pages from another thread would fault if the region were unmapped meanwhile
+    return region;
+  }
+  for(size_t n = 0; n < region.size(); n += utils::page_size())
+  {
+    if(for_write)
+    {
+      // Take the write fault without changing the contents, even if other threads are writing
+      reinterpret_cast<std::atomic<char> *>(region.data() + n)->fetch_add(0, std::memory_order_relaxed);  // NOLINT
+    }
+    else
+    {
+      (void) *reinterpret_cast<volatile char *>(region.data() + n);  // NOLINT
+    }
+  }
+  return region;
+}
+
 result<span<map_handle::buffer_type>> map_handle::prefetch(span<buffer_type> regions) noexcept
 {
   windows_nt_kernel::init();
@@ -943,9 +1337,52 @@ result<map_handle::buffer_type> map_handle::do_not_store(buffer_type region) noe
   return region;
 }
 
-map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<buffers_type> reqs, deadline /*d*/) noexcept
+result<span<map_handle::buffer_type>> map_handle::do_not_store(span<buffer_type> regions) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  OUTCOME_TRY(auto &&merged, detail::coalesce_map_regions(regions, _pagesize));
+  for(auto &region : merged)
+  {
+    OUTCOME_TRY(auto &&done, do_not_store(region));
+    region = done;
+  }
+  return merged;
+}
+
+result<map_handle::buffer_type> map_handle::evict(buffer_type region) noexcept
 {
+  windows_nt_kernel::init();
+  using namespace windows_nt_kernel;
   LLFIO_LOG_FUNCTION_CALL(this);
+  if(region.data() == nullptr)
+  {
+    return errc::invalid_argument;
+  }
+  // Only whole pages, as the pages either side may be in use
+  auto *end = reinterpret_cast<byte *>((reinterpret_cast<uintptr_t>(region.data()) + region.size()) & ~(uintptr_t)(_pagesize - 1));
+  region = {utils::round_up_to_page_size(region.data(), _pagesize), 0};
+  if(region.data() >= end)
+  {
+    return region;
+  }
+  region = {region.data(), (size_type)(end - region.data())};
+  OUTCOME_TRYV(win32_maps_apply(region.data(), region.size(), win32_map_sought::committed, [](byte *addr, size_t bytes) -> result<void> {
+    // Unlocking pages not locked fails, but removes them from the working set without losing their contents
+    if(VirtualUnlock(addr, bytes) == 0)
+    {
+      if(ERROR_NOT_LOCKED != GetLastError())
+      {
+        return win32_error();
+      }
+    }
+    return success();
+  }));
+  return region;
+}
+
+map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<buffers_type> reqs, deadline /*d*/) noexcept
+{
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   byte *addr = _addr + reqs.offset;
   size_type togo = reqs.offset < _length ? static_cast<size_type>(_length - reqs.offset) : 0;
   for(size_t i = 0; i < reqs.buffers.size(); i++)
@@ -966,7 +1403,7 @@ map_handle::io_result<map_handle::buffers_type> map_handle::_do_read(io_request<
 
 map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_request<const_buffers_type> reqs, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   if(!!(_flag & section_handle::flag::write_via_syscall) && _section != nullptr && _section->backing() != nullptr)
   {
     auto r = _section->backing()->write(reqs, d);
@@ -991,7 +1428,7 @@ map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_r
          if(req.size() > togo)
          {
            assert(req.data() != nullptr);
-           memcpy(addr, req.data(), togo);
+           detail::copy_into_map(addr, req.data(), togo, _nontemporal_write_threshold);
            req = {addr, togo};
            reqs.buffers = {reqs.buffers.data(), i + 1};
            return false;
@@ -999,7 +1436,7 @@ map_handle::io_result<map_handle::const_buffers_type> map_handle::_do_write(io_r
          else
          {
            assert(req.data() != nullptr);
-           memcpy(addr, req.data(), req.size());
+           detail::copy_into_map(addr, req.data(), req.size(), _nontemporal_write_threshold);
            req = {addr, req.size()};
            addr += req.size();
            togo -= req.size();
@@ -0,0 +1,99 @@
+/* A ring buffer of memory section mapped twice back to back
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../../mapped_ring_buffer.hpp"
+#include "import.hpp"
+
+LLFIO_V2_NAMESPACE_BEGIN
+
+result<mapped_ring_buffer> mapped_ring_buffer::ring_buffer(size_type bytes, const path_handle &dirh) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  if(bytes == 0)
+  {
+    return errc::invalid_argument;
+  }
+  // Views must begin on the allocation granularity
+  bytes = utils::round_up_to_page_size(bytes, 65536);
+  OUTCOME_TRY(auto &&sh, section_handle::section(bytes, dirh.is_valid() ? dirh : path_discovery::storage_backed_temporary_files_directory(), section_handle::flag::readwrite));
+  result<mapped_ring_buffer> ret(mapped_ring_buffer{});
+  ret.value()._sh = std::move(sh);
+  ret.value()._capacity = bytes;
+  OUTCOME_TRYV(ret.value()._map_twice());
+  return ret;
+}
+
+result<void> mapped_ring_buffer::_map_twice() noexcept
+{
+  /* Find some free address space for both maps, release it, and map the section into it
+  twice. Another thread may grab the address space after we release it, in which case
+  retry. Windows 10 placeholders would close the race, but they need Windows 10 1803 or later.
+  */
+  for(size_t attempt = 0; attempt < 16; attempt++)
+  {
+    void *addr = VirtualAlloc(nullptr, _capacity * 2, MEM_RESERVE, PAGE_NOACCESS);
+    if(addr == nullptr)
+    {
+      return win32_error();
+    }
+    if(VirtualFree(addr, 0, MEM_RELEASE) == 0)
+    {
+      return win32_error();
+    }
+    void *first = MapViewOfFileEx(_sh.native_handle().h, FILE_MAP_WRITE, 0, 0, _capacity, addr);
+    if(first == nullptr)
+    {
+      continue;
+    }
+    void *second = MapViewOfFileEx(_sh.native_handle().h, FILE_MAP_WRITE, 0, 0, _capacity, static_cast<byte *>(addr) + _capacity);
+    if(second == nullptr)
+    {
+      UnmapViewOfFile(first);
+      continue;
+    }
+    _addr = static_cast<byte *>(addr);
+    return success();
+  }
+  return errc::not_enough_memory;
+}
+
+result<void> mapped_ring_buffer::close() noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  if(_addr != nullptr)
+  {
+    if(UnmapViewOfFile(_addr + _capacity) == 0 || UnmapViewOfFile(_addr) == 0)
+    {
+      return win32_error();
+    }
+    _addr = nullptr;
+  }
+  if(_sh.is_valid())
+  {
+    OUTCOME_TRYV(_sh.close());
+  }
+  return success();
+}
+
+LLFIO_V2_NAMESPACE_END
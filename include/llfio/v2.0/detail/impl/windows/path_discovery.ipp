@@ -122,6 +122,15 @@ namespace path_discovery
     return ret;
   }
 
+  // There is no per user runtime directory with the guarantees needed to cache verification on Windows
+  inline bool _load_verified_cache(std::vector<discovered_path> & /*unused*/, std::vector<_store::_discovered_path> & /*unused*/, bool & /*unused*/) noexcept
+  {
+    return false;
+  }
+  inline void _save_verified_cache(const std::vector<discovered_path> & /*unused*/, const std::vector<_store::_discovered_path> & /*unused*/) noexcept {}
+  inline void _refresh_verified_cache_in_background(const std::vector<discovered_path> & /*unused*/) noexcept {}
+  inline int _memory_backed_rank(const stat_t & /*unused*/) noexcept { return 0; }
+
   const path_handle &temporary_named_pipes_directory() noexcept
   {
     static path_handle pipesdir;
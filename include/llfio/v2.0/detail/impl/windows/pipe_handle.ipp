@@ -27,7 +27,7 @@ Distributed under the Boost Software License, Version 1.0.
 
 LLFIO_V2_NAMESPACE_BEGIN
 
-result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_handle::mode _mode, pipe_handle::creation _creation, pipe_handle::caching _caching, pipe_handle::flag flags, const path_handle &base) noexcept
+result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_handle::mode _mode, pipe_handle::creation _creation, pipe_handle::caching _caching, pipe_handle::flag flags, const path_handle &base, size_t capacity) noexcept
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
@@ -138,7 +138,8 @@ result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_han
     LARGE_INTEGER default_timeout{};
     memset(&default_timeout, 0, sizeof(default_timeout));
     default_timeout.QuadPart = -500000;
-    NTSTATUS ntstat = NtCreateNamedPipeFile(&nativeh.h, access, &oa, &isb, fileshare, creatdisp, ntflags, 0 /*FILE_PIPE_BYTE_STREAM_TYPE*/, 0 /*FILE_PIPE_BYTE_STREAM_MODE*/, 0 /*FILE_PIPE_QUEUE_OPERATION*/, (unsigned long) -1 /*FILE_PIPE_UNLIMITED_INSTANCES*/, 65536, 65536, &default_timeout);
+    const unsigned long quota = (capacity != 0) ? (unsigned long) std::min(capacity, (size_t) ULONG_MAX) : 65536;
+    NTSTATUS ntstat = NtCreateNamedPipeFile(&nativeh.h, access, &oa, &isb, fileshare, creatdisp, ntflags, 0 /*FILE_PIPE_BYTE_STREAM_TYPE*/, 0 /*FILE_PIPE_BYTE_STREAM_MODE*/, 0 /*FILE_PIPE_QUEUE_OPERATION*/, (unsigned long) -1 /*FILE_PIPE_UNLIMITED_INSTANCES*/, quota, quota, &default_timeout);
     if(STATUS_PENDING == ntstat)
     {
       ntstat = ntwait(nativeh.h, isb, deadline());
@@ -162,14 +163,14 @@ result<pipe_handle> pipe_handle::pipe(pipe_handle::path_view_type path, pipe_han
   return ret;
 }
 
-result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching _caching, flag flags) noexcept
+result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching _caching, flag flags, size_t capacity) noexcept
 {
   // Uses true anonymous pipe creation technique from https://stackoverflow.com/questions/40844884/windows-named-pipe-access-control
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
   // Create an unnamed new pipe
   flags &= ~flag::unlink_on_first_close;
-  OUTCOME_TRY(auto &&anonpipe, pipe({}, mode::read, creation::only_if_not_exist, _caching, flags));
+  OUTCOME_TRY(auto &&anonpipe, pipe({}, mode::read, creation::only_if_not_exist, _caching, flags, path_discovery::temporary_named_pipes_directory(), capacity));
   std::pair<pipe_handle, pipe_handle> ret(std::move(anonpipe), pipe_handle(native_handle_type(), 0, 0, _caching, flags, nullptr));
   native_handle_type &readnativeh = ret.first._v, &writenativeh = ret.second._v;
   DWORD fileshare = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
@@ -208,7 +209,7 @@ result<std::pair<pipe_handle, pipe_handle>> pipe_handle::anonymous_pipe(caching
 
 pipe_handle::io_result<pipe_handle::buffers_type> pipe_handle::_do_read(pipe_handle::io_request<pipe_handle::buffers_type> reqs, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   // If not connected, it'll be non-blocking, so connect now.
   if(!(_v.behaviour & native_handle_type::disposition::_is_connected))
   {
@@ -250,8 +251,57 @@ pipe_handle::io_result<pipe_handle::buffers_type> pipe_handle::_do_read(pipe_han
 
 pipe_handle::io_result<pipe_handle::const_buffers_type> pipe_handle::_do_write(pipe_handle::io_request<pipe_handle::const_buffers_type> reqs, deadline d) noexcept
 {
-  LLFIO_LOG_FUNCTION_CALL(this);
+  LLFIO_LOG_HOT_FUNCTION_CALL(this);
   return io_handle::_do_write(reqs, d);
 }
 
+result<size_t> pipe_handle::capacity() const noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  DWORD outbytes = 0, inbytes = 0;
+  if(!GetNamedPipeInfo(_v.h, nullptr, &outbytes, &inbytes, nullptr))
+  {
+    return win32_error();
+  }
+  return (size_t) std::max(outbytes, inbytes);
+}
+
+result<size_t> pipe_handle::set_capacity(size_t /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // The buffer quotas of named pipes are fixed when created
+  return errc::operation_not_supported;
+}
+
+result<size_t> pipe_handle::splice_to(io_handle &dest, extent_type offset, size_t bytes, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  // Windows has no means of moving pipe buffers into files, so this is a copy through a bounce buffer
+  return _splice_by_copy(*this, 0, dest, offset, bytes, d);
+}
+
+result<size_t> pipe_handle::splice_from(io_handle &src, extent_type offset, size_t bytes, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  return _splice_by_copy(src, offset, *this, 0, bytes, d);
+}
+
+result<size_t> pipe_handle::splice_from(const_buffers_type buffers, deadline d) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  OUTCOME_TRY(auto &&written, write(io_request<const_buffers_type>(buffers, 0), d));
+  size_t ret = 0;
+  for(auto &b : written)
+  {
+    ret += b.size();
+  }
+  return ret;
+}
+
+result<size_t> pipe_handle::tee_to(pipe_handle & /*unused*/, size_t /*unused*/, deadline /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(this);
+  return errc::operation_not_supported;
+}
+
 LLFIO_V2_NAMESPACE_END
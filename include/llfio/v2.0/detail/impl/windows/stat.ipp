@@ -30,7 +30,7 @@ Distributed under the Boost Software License, Version 1.0.
 
 LLFIO_V2_NAMESPACE_BEGIN
 
-LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, stat_t::want wanted) noexcept
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, stat_t::want wanted, bool /*unused*/) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(&h);
   windows_nt_kernel::init();
@@ -226,6 +226,30 @@ LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> stat_t::fill(const handle &h, sta
   return ret;
 }
 
+LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<size_t>>> stat_t::fill(span<stat_t> out, span<const handle *const> hs, stat_t::want wanted,
+                                                                                 io_multiplexer * /*unused*/, bool /*unused*/) noexcept
+{
+  LLFIO_LOG_FUNCTION_CALL(0);
+  if(out.size() != hs.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    std::vector<result<size_t>> ret;
+    ret.reserve(hs.size());
+    for(size_t n = 0; n < hs.size(); n++)
+    {
+      ret.push_back(out[n].fill(*hs[n], wanted));
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<stat_t::want> stat_t::stamp(handle &h, stat_t::want wanted) noexcept
 {
   LLFIO_LOG_FUNCTION_CALL(&h);
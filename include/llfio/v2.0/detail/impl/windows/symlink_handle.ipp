@@ -319,4 +319,69 @@ result<symlink_handle::const_buffers_type> symlink_handle::write(symlink_handle:
   return success(std::move(req.buffers));
 }
 
+result<std::vector<result<symlink_handle::path_type>>> symlink_handle::read_links(const path_handle &base, span<const symlink_handle::path_view_type> paths) noexcept
+{
+  try
+  {
+    std::vector<result<path_type>> ret;
+    ret.reserve(paths.size());
+    for(const auto &path : paths)
+    {
+      auto h = symlink(base, path);
+      if(!h)
+      {
+        ret.push_back(result<path_type>(std::move(h).error()));
+        continue;
+      }
+      auto contents = h.value().read();
+      if(!contents)
+      {
+        ret.push_back(result<path_type>(std::move(contents).error()));
+        continue;
+      }
+      ret.push_back(contents.value().path().path());
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
+result<std::vector<result<void>>> symlink_handle::create_links(const path_handle &base, span<const symlink_handle::path_view_type> paths,
+                                                               span<const path_view> targets, io_multiplexer * /*unused*/) noexcept
+{
+  if(paths.size() != targets.size())
+  {
+    return errc::invalid_argument;
+  }
+  try
+  {
+    std::vector<result<void>> ret;
+    ret.reserve(paths.size());
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      auto h = symlink(base, paths[n], mode::write, creation::only_if_not_exist);
+      if(!h)
+      {
+        ret.push_back(result<void>(std::move(h).error()));
+        continue;
+      }
+      auto written = h.value().write(targets[n]);
+      if(!written)
+      {
+        ret.push_back(result<void>(std::move(written).error()));
+        continue;
+      }
+      ret.push_back(success());
+    }
+    return ret;
+  }
+  catch(...)
+  {
+    return error_from_exception();
+  }
+}
+
 LLFIO_V2_NAMESPACE_END
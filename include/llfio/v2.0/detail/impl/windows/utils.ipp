@@ -95,16 +95,37 @@ namespace utils
 #pragma warning(pop)
 #endif
 
-  void random_fill(char *buffer, size_t bytes) noexcept
+  inline std::pair<spinlock, tuning_hints> &_tuning_hints() noexcept
   {
-    windows_nt_kernel::init();
-    using namespace windows_nt_kernel;
-    if(RtlGenRandom(buffer, static_cast<ULONG>(bytes)) == 0u)
+    static std::pair<spinlock, tuning_hints> v;
+    return v;
+  }
+  tuning_hints tuning() noexcept
+  {
+    auto &v = _tuning_hints();
+    std::lock_guard<decltype(v.first)> g(v.first);
+    return v.second;
+  }
+  void set_tuning(const tuning_hints &hints) noexcept
+  {
+    auto &v = _tuning_hints();
+    std::lock_guard<decltype(v.first)> g(v.first);
+    v.second = hints;
+  }
+
+  namespace detail
+  {
+    void kernel_random_fill(char *buffer, size_t bytes) noexcept
     {
-      LLFIO_LOG_FATAL(0, "llfio: Kernel crypto function failed");
-      std::terminate();
+      windows_nt_kernel::init();
+      using namespace windows_nt_kernel;
+      if(RtlGenRandom(buffer, static_cast<ULONG>(bytes)) == 0u)
+      {
+        LLFIO_LOG_FATAL(0, "llfio: Kernel crypto function failed");
+        std::terminate();
+      }
     }
-  }
+  }  // namespace detail
 
   result<void> flush_modified_data() noexcept
   {
@@ -205,7 +226,71 @@ namespace utils
     return success();
   }
 
-  result<process_memory_usage> current_process_memory_usage() noexcept {
+  result<void> flush_modified_data(const native_handle_type &h) noexcept
+  {
+    // The path is \\?\Volume{GUID}\path, and flushing a handle to the volume flushes everything on it
+    wchar_t buffer[32769];
+    DWORD len = GetFinalPathNameByHandleW(h.h, buffer, sizeof(buffer) / sizeof(*buffer), FILE_NAME_OPENED | VOLUME_NAME_GUID);
+    if((len == 0u) || len >= sizeof(buffer) / sizeof(*buffer))
+    {
+      return win32_error();
+    }
+    buffer[len] = 0;
+    wchar_t *volumeend = (len > 4) ? wcschr(buffer + 4, L'\\') : nullptr;
+    if(volumeend == nullptr)
+    {
+      return errc::no_such_device;
+    }
+    *volumeend = 0;
+    HANDLE volh = CreateFileW(buffer, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(volh == INVALID_HANDLE_VALUE)
+    {
+      return win32_error();
+    }
+    auto unvolh = make_scope_exit([&volh]() noexcept { CloseHandle(volh); });
+    if(FlushFileBuffers(volh) == 0)
+    {
+      return win32_error();
+    }
+    return success();
+  }
+
+  result<void> flush_directory(const native_handle_type &h) noexcept
+  {
+    // Directories are opened without write privileges, which flushing needs
+    HANDLE nh = ReOpenFile(h.h, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_FLAG_BACKUP_SEMANTICS);
+    if(nh == INVALID_HANDLE_VALUE)
+    {
+      return win32_error();
+    }
+    auto unnh = make_scope_exit([&nh]() noexcept { CloseHandle(nh); });
+    if(FlushFileBuffers(nh) == 0)
+    {
+      return win32_error();
+    }
+    return success();
+  }
+
+  result<void> drop_filesystem_cache(const native_handle_type &h) noexcept
+  {
+    // Flushing only the file is enough, and needs no privileges
+    if(FlushFileBuffers(h.h) == 0)
+    {
+      return win32_error();
+    }
+    // Opening a file without buffering purges its cached pages
+    HANDLE nh = ReOpenFile(h.h, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_FLAG_NO_BUFFERING);
+    if(nh == INVALID_HANDLE_VALUE)
+    {
+      return win32_error();
+    }
+    CloseHandle(nh);
+    return success();
+  }
+
+  result<process_memory_usage> current_process_memory_usage(process_memory_usage::accuracy acc) noexcept {
+    // This is always cheap
+    (void) acc;
     // Amazingly Win32 doesn't expose private working set, so to avoid having
     // to iterate all the pages in the process and calculate, use a hidden
     // NT kernel call
@@ -239,6 +324,52 @@ namespace utils
     return ret;
   }
 
+  result<memory_pressure> current_memory_pressure() noexcept
+  {
+    // The notification object lives for the process, as creating it each time costs a syscall
+    static HANDLE h = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+    if(h == nullptr)
+    {
+      return win32_error();
+    }
+    BOOL low = FALSE;
+    if(!QueryMemoryResourceNotification(h, &low))
+    {
+      return win32_error();
+    }
+    memory_pressure ret;
+    if(low)
+    {
+      ret.some = ret.full = 100;
+    }
+    return ret;
+  }
+
+  namespace detail
+  {
+    result<size_t> reclaim_memory(span<byte> region, bool pageout) noexcept
+    {
+      // Windows has no equivalent of deactivating pages
+      if(!pageout)
+      {
+        return 0;
+      }
+      const auto pagesize = page_size();
+      byte *begin = (byte *) (((uintptr_t) region.data() + pagesize - 1) & ~(uintptr_t)(pagesize - 1));
+      byte *end = (byte *) (((uintptr_t) region.data() + region.size()) & ~(uintptr_t)(pagesize - 1));
+      if(end <= begin)
+      {
+        return 0;
+      }
+      // Unlocking pages which are not locked removes them from the working set, keeping their contents
+      if(!VirtualUnlock(begin, end - begin) && GetLastError() != ERROR_NOT_LOCKED)
+      {
+        return win32_error();
+      }
+      return end - begin;
+    }
+  }  // namespace detail
+
   namespace detail
   {
     large_page_allocation allocate_large_pages(size_t bytes)
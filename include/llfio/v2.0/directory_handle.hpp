@@ -179,11 +179,15 @@ public:
     /*! Construct a request to enumerate a directory with optionally specified kernel buffer.
 
     \param _buffers The buffers to fill with enumerated directory entries.
-    \param _glob An optional shell glob by which to filter the items filled. Done kernel side on Windows, user side on POSIX.
+    \param _glob An optional shell glob by which to filter the items filled. Done kernel side on Windows, user side on POSIX
+    where globs of literals and at most one run of `*` (e.g. `*.ext`, `prefix*`) are matched without calling `fnmatch()`.
     \param _filtering Whether to filter out fake-deleted files on Windows or not.
     \param _kernelbuffer A buffer to use for the kernel to fill. If left defaulted, a kernel buffer
     is allocated internally and returned in the buffers returned which needs to not be destructed until one
-    is no longer using any items within (leafnames are views onto the original kernel data).
+    is no longer using any items within (leafnames are views onto the original kernel data). If supplied,
+    the leafnames filled are views into it, so no leafname is ever copied, and they remain valid until it
+    is next filled. It must be large enough to hold the whole directory, else `errc::no_buffer_space`
+    is returned.
     */
     /*constexpr*/ io_request(buffers_type _buffers, path_view_type _glob = {}, filter _filtering = filter::fastdeleted, span<char> _kernelbuffer = {})
         : buffers(std::move(_buffers))
@@ -243,6 +247,20 @@ public:
   */
   LLFIO_MAKE_FREE_FUNCTION
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<directory_handle> directory(const path_handle &base, path_view_type path, mode _mode = mode::read, creation _creation = creation::open_existing, caching _caching = caching::all, flag flags = flag::none) noexcept;
+  /*! Create many directory handles at once, opening each of `paths` relative to `base` as `directory()` would.
+  If `multiplexer` is not null and `_creation` is `creation::open_existing`, the opens and the fetches of
+  their inodes are executed as batches using `io_multiplexer::do_posix_fs_syscalls()`, which the Linux
+  io_uring multiplexer executes at high queue depth instead of serially. Otherwise, and on Windows, each
+  path is opened serially.
+
+  \return The result of opening each path, in the same order as `paths`.
+  \errors Any of the values POSIX open() or CreateFile() can return, per path. Any of the values
+  `std::vector` can throw, or the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<directory_handle>>> directories(const path_handle &base, span<const path_view_type> paths,
+                                                                                                  mode _mode = mode::read, creation _creation = creation::open_existing,
+                                                                                                  caching _caching = caching::all, flag flags = flag::none,
+                                                                                                  io_multiplexer *multiplexer = nullptr) noexcept;
   /*! Create a directory handle creating a uniquely named file on a path.
   The file is opened exclusively with `creation::only_if_not_exist` so it
   will never collide with nor overwrite any existing entry.
@@ -291,6 +309,10 @@ public:
       (void) directory_handle::close();
     }
   }
+  /*! \brief Reuses the path last returned if it still leads to this inode, which on POSIX is
+  far cheaper than asking the kernel. See `handle::current_path()` for the semantics.
+  */
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<path_type> current_path() const noexcept override { return _cached_current_path(); }
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
   {
     LLFIO_LOG_FUNCTION_CALL(this);
@@ -346,14 +368,150 @@ public:
   was read or not. You should *always* examine `.metadata()` for the metadata you are about to use,
   fetching it with `stat_t::fill()` if not yet present.
   \param req A buffer fill (directory enumeration) request.
-  \errors todo
+  \errors `errc::no_buffer_space` if the `kernelbuffer` set in the request is too small to hold the
+  directory.
   \mallocs If the `kernelbuffer` parameter is set in the request, no memory allocations.
   If unset, at least one memory allocation, possibly more is performed. MAKE SURE you reuse the
   `buffers_type` across calls once you are no longer using the buffers filled (simply restamp
   its span range, the internal kernel buffer will then get reused).
+
+  On Windows, the internal kernel buffer grows in powers of two, and once grown beyond 64Kb
+  by a large directory, up to 1Mb of it is also used to count the entries of later reads,
+  which reduces the syscalls to enumerate big directories. Entries are fetched with
+  `FileIdExtdDirectoryInformation` where the filing system supports it, so the `st_ino` of
+  ReFS files is their 128 bit file id folded by xor of its halves, which for NTFS is the
+  same as its traditional 64 bit file id. To enumerate a whole volume, see
+  `algorithm::enumerate_volume()`.
   */
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<buffers_type> read(io_request<buffers_type> req, deadline d = std::chrono::seconds(30)) const noexcept;
+
+  /*! \brief Fills the `stat` of each of `entries` with the `wanted` metadata of the entry named by
+  its `leafname` within this directory, without following symbolic links. Metadata not wanted is
+  left as it was, so this is typically used to add what `read()` did not return.
+
+  On Linux, each entry costs one `statx()` masked to the metadata wanted, and if `multiplexer` is
+  not null, they are all executed as one batch using `io_multiplexer::do_posix_fs_syscalls()`,
+  which the Linux io_uring multiplexer executes at high queue depth. If `cached` is true,
+  `AT_STATX_DONT_SYNC` lets network filing systems return cached metadata rather than ask the
+  server. On other POSIX, each entry costs one `fstatat()`. On Windows, each entry is opened
+  and `stat_t::fill()` called upon it.
+
+  \return The result of filling each entry, in the same order as `entries`.
+  \errors Any of the values `stat_t::fill()` can return, per entry. Any of the values
+  `std::vector` can throw, or the multiplexer can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<size_t>>> stat_entries(span<buffer_type> entries, stat_t::want wanted = stat_t::want::all,
+                                                                                   bool cached = false, io_multiplexer *multiplexer = nullptr) const noexcept;
+
+  /*! \brief Sets the `wanted` metadata of each of `entries` named by its `leafname` within this
+  directory from its `stat`, without following symbolic links, as `stat_t::stamp()` would, but
+  without opening a handle to each entry.
+
+  If `current` is not empty, it must be the same length as `entries`, and is the metadata which
+  each entry currently has, typically as filled by `stat_entries()`. Metadata already equal to
+  that wanted is then not set, so for example copies made by the owner of the originals never
+  set their owner.
+
+  On POSIX, each entry costs up to one each of `fchmodat()`, `fchownat()` and `utimensat()`, and
+  the permissions of symbolic links are never set. There are no io_uring operations for these, so
+  unlike `stat_entries()` there is no batching via a multiplexer. On Windows, each entry is opened
+  and `stat_t::stamp()` called upon it.
+
+  \return The metadata set for each entry, in the same order as `entries`.
+  \errors Any of the values `stat_t::stamp()` can return, per entry. Any of the values
+  `std::vector` can throw.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<stat_t::want>>> stamp_entries(span<const buffer_type> entries, stat_t::want wanted = stat_t::want::all,
+                                                                                          span<const stat_t> current = {}) const noexcept;
+
+  //! What `relink_entries()` does if there is already an entry at the new path
+  enum class relink_kind : uint8_t
+  {
+    replace,     //!< Atomically replace it
+    no_replace,  //!< Fail with `errc::file_exists`
+    exchange     //!< Atomically exchange the two entries, failing with `errc::no_such_file_or_directory` if there is none
+  };
+  //! An entry of this directory for `relink_entries()` to relink to a new path
+  struct relink_request
+  {
+    path_view_type leafname;                 //!< The leafname of the entry within this directory
+    const path_handle *base{nullptr};        //!< The base of the new path, or null if the new path is absolute
+    path_view_type path;                     //!< The new path
+    relink_kind kind{relink_kind::replace};  //!< What to do if there is already an entry at the new path
+  };
+
+  /*! \brief Relinks many entries of this directory at once, each named by its `leafname`.
+
+  Unlike `fs_handle::relink()`, no handle is opened to each entry and it is not checked to be the
+  inode which was opened, so there is no loop to retry races with other processes renaming the same
+  entries. On POSIX each entry costs one `renameat2()`, and if `multiplexer` is not null they are
+  executed as one batch using `io_multiplexer::do_posix_fs_syscalls()`, which the Linux io_uring
+  multiplexer executes at high queue depth on Linux 5.11 onwards. Elsewhere than Linux and Mac OS,
+  `relink_kind::exchange` is not supported, and `relink_kind::no_replace` is emulated with `linkat()`
+  followed by `unlinkat()`, so it fails for directories. On Windows, each entry is opened with only
+  `DELETE` privilege and renamed as `fs_handle::relink()` would, and `relink_kind::exchange` is not
+  supported.
+
+  \return The result of relinking each entry, in the same order as `entries`.
+  \errors Any of the values `renameat2()` or `fs_handle::relink()` can return, per entry. Any of the
+  values `std::vector` can throw, or the multiplexer can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<void>>> relink_entries(span<const relink_request> entries,
+                                                                                   io_multiplexer *multiplexer = nullptr) const noexcept;
+
+  /*! \brief Unlinks many entries of this directory at once, each named by its leafname. If `directories`
+  is true, the entries must all be empty directories, otherwise none may be directories.
+
+  Unlike `fs_handle::unlink()`, no handle is opened to each entry and it is not checked to be the
+  inode which was opened. On POSIX each entry costs one `unlinkat()`, and if `multiplexer` is not null
+  they are executed as one batch using `io_multiplexer::do_posix_fs_syscalls()`, which the Linux io_uring
+  multiplexer executes at high queue depth on Linux 5.11 onwards. On Windows, each entry is opened with
+  only `DELETE` privilege and unlinked as `fs_handle::unlink()` would.
+
+  \return The result of unlinking each entry, in the same order as `leafnames`.
+  \errors Any of the values `unlinkat()` or `fs_handle::unlink()` can return, per entry. Any of the
+  values `std::vector` can throw, or the multiplexer can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<void>>> unlink_entries(span<const path_view_type> leafnames, bool directories = false,
+                                                                                   io_multiplexer *multiplexer = nullptr) const noexcept;
+
+  //! A file for `create_entries()` to create within this directory
+  struct create_request
+  {
+    path_view_type leafname;    //!< The leafname of the file within this directory
+    span<const byte> contents;  //!< The contents to write into the file, which must remain valid until `create_entries()` returns
+  };
+
+  /*! \brief Creates many small files within this directory at once, each named by its `leafname`
+  and written with its `contents`, without returning a handle to any of them. This is intended for
+  unpacking datasets of very many small files, where calling `file_handle::file()` then writing and
+  closing each costs three syscalls per file.
+
+  On POSIX each file costs one each of `openat()`, `pwrite()` and `close()`, and if `multiplexer`
+  is not null, up to `create_entries_batch` of the files at a time are opened as one batch using
+  `io_multiplexer::do_posix_fs_syscalls()`, then written as a second batch, then closed as a third,
+  which the Linux io_uring multiplexer executes at high queue depth. Bounding the files open at once
+  keeps unpacking huge directories within the process' file descriptor limit. On Windows, each file
+  is created using `file_handle::file()` and written, whose cost dominates anyway.
+
+  `_caching` is as for `file_handle::file()`, except that `caching::none` and `caching::only_metadata`
+  are not supported as the contents would need to be aligned for direct i/o. `caching::temporary`
+  is recommended for scratch unpacks, as no file will ever be flushed to storage on its behalf, and
+  on Windows the files are created with `FILE_ATTRIBUTE_TEMPORARY`. On POSIX, `creation::always_new`
+  truncates and rewrites any file already existing rather than atomically replacing it.
+
+  \return The result of creating each file, in the same order as `entries`. A file whose contents
+  could not be written is left as it was created.
+  \errors Any of the values `openat()`, `pwrite()` or `file_handle::file()` can return, per entry.
+  `errc::invalid_argument` if `_caching` is not supported. Any of the values `std::vector` can
+  throw, or the multiplexer can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<void>>> create_entries(span<const create_request> entries, creation _creation = creation::if_needed,
+                                                                                   caching _caching = caching::all,
+                                                                                   io_multiplexer *multiplexer = nullptr) const noexcept;
+  //! The most files `create_entries()` has open at once when it has a multiplexer
+  static constexpr size_t create_entries_batch = 256;
 };
 inline std::ostream &operator<<(std::ostream &s, const directory_handle::filter &v)
 {
@@ -369,6 +527,119 @@ inline std::ostream &operator<<(std::ostream &s, const directory_handle::buffers
   return s << "llfio::directory_handle::buffers_type";
 }
 
+/*! \class directory_stream
+\brief A streaming cursor over the entries of a directory, yielding them batch by batch
+from a fixed size kernel buffer.
+
+Unlike `directory_handle::read()`, which must be given enough buffers for every entry
+in the directory, this continues each kernel enumeration (`getdents64()` on Linux,
+`NtQueryDirectoryFile()` on Windows) from where the last one left off, so enumerating
+a directory of any size uses memory bounded by the kernel buffer size and the span of
+entries supplied to `next()`, and each entry is enumerated exactly once.
+
+The stream opens its own handle to the directory, so its position is independent of
+any other handle and enumeration of the same directory. As with most directory
+enumeration, entries added or removed during the stream may or may not be seen.
+*/
+class LLFIO_DECL directory_stream
+{
+  directory_handle _h;
+  std::unique_ptr<char[]> _buffer;
+  size_t _buffer_size{0}, _offset{0}, _bytes{0};
+  filesystem::path _glob;
+  directory_handle::filter _filtering{directory_handle::filter::fastdeleted};
+  stat_t::want _metadata{stat_t::want::none};
+  bool _first{true}, _done{false};
+  bool _no_128bit_ids{false};  // Windows only, set if the filing system refuses FileIdExtdDirectoryInformation
+
+public:
+  //! The type of an entry yielded
+  using buffer_type = directory_handle::buffer_type;
+  //! The path view type used by this stream
+  using path_view_type = directory_handle::path_view_type;
+
+  //! Default constructor
+  directory_stream() = default;
+  //! Move constructor
+  directory_stream(directory_stream &&) = default;
+  //! No copy construction
+  directory_stream(const directory_stream &) = delete;
+  //! Move assignment
+  directory_stream &operator=(directory_stream &&) = default;
+  //! No copy assignment
+  directory_stream &operator=(const directory_stream &) = delete;
+  ~directory_stream() = default;
+
+  /*! \brief Opens a stream enumerating the directory `path` relative to `base`, or `base`
+  itself if `path` is empty.
+
+  \param base The base to which `path` is relative.
+  \param path The directory to enumerate.
+  \param kernel_buffer_size The size of the fixed kernel buffer, which is rounded up to
+  at least 4Kb. Each fill of the buffer is one syscall.
+  \param glob An optional shell glob by which to filter the entries yielded. Done kernel
+  side on Windows, user side on POSIX as for `directory_handle::read()`.
+  \param filtering Whether to filter out fake-deleted files on Windows or not.
+  \errors Any of the values `directory_handle::directory()` can return, or `errc::not_enough_memory`.
+  \mallocs The kernel buffer, and a copy of `glob` if it is not empty.
+  */
+  static result<directory_stream> open(const path_handle &base, path_view_type path = {}, size_t kernel_buffer_size = 65536, path_view_type glob = {},
+                                       directory_handle::filter filtering = directory_handle::filter::fastdeleted) noexcept
+  {
+    try
+    {
+      directory_stream ret;
+      OUTCOME_TRY(auto &&h, directory_handle::directory(base, path));
+      ret._h = std::move(h);
+      if(kernel_buffer_size < 4096)
+      {
+        kernel_buffer_size = 4096;
+      }
+      auto *mem = (char *) operator new[](kernel_buffer_size, std::nothrow);  // don't initialise
+      if(mem == nullptr)
+      {
+        return errc::not_enough_memory;
+      }
+      ret._buffer = std::unique_ptr<char[]>(mem);
+      ret._buffer_size = kernel_buffer_size;
+      if(!glob.empty())
+      {
+        ret._glob = glob.path();
+      }
+      ret._filtering = filtering;
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  //! The handle to the directory being enumerated.
+  const directory_handle &directory() const noexcept { return _h; }
+  //! The stat metadata filled into the entries most recently yielded by `next()`.
+  stat_t::want metadata() const noexcept { return _metadata; }
+  //! True if the enumeration has reached the end of the directory.
+  bool done() const noexcept { return _done; }
+
+  /*! \brief Fills up to `out.size()` entries with the next entries in the directory, returning
+  the span of those filled, which is empty once every entry has been yielded.
+
+  The leafnames of the entries yielded are views of the kernel buffer, and are only valid until
+  the next call to `next()` or `restart()`. The kernel is only asked for more entries once every
+  entry in the kernel buffer has been yielded, so a span returned may be shorter than `out` before
+  the end of the directory. As with `directory_handle::read()`, you should examine `metadata()`
+  for the metadata you are about to use.
+
+  \errors Any of the values POSIX getdents() or NtQueryDirectoryFile() can return.
+  \mallocs None.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> next(span<buffer_type> out) noexcept;
+
+  //! Restarts the enumeration from the beginning of the directory.
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> restart() noexcept;
+};
+
 //! \brief Constructor for `directory_handle`
 template <> struct construct<directory_handle>
 {
@@ -69,15 +69,14 @@ On a 3.1Ghz Intel Skylake CPU where `memcpy()` can do ~12Gb/sec:
 - GCC7: 4659 Mb/sec
 - VS2017: 3653 Mb/sec
 
-The current implementation spots when it can do 16x simultaneous PRNG rounds, and thus
-can fill a cache line at a time. The Skylake CPU used to benchmark the code dispatches
-around four times the throughput with this, however there is likely still performance
-left on the table.
-
-If someone were bothered to rewrite the JSF PRNG into SIMD, it is possible one could
-approach `memcpy()` in performance. One would probably need to use AVX-512 however,
-as the JSF PRNG makes heavy use of bit rotation, which is slow before AVX-512 as it
-must be emulated with copious bit shifting and masking.
+The current implementation generates whole runs of 4 byte blocks in a loop where each
+block's PRNG round depends on nothing but the shared seed state and its own offset.
+Compilers vectorise this loop to the widest SIMD the target was compiled for (SSE2,
+AVX2, AVX-512, NEON), so building with e.g. `-march=native` makes a large difference.
+Reads larger than `parallel_fill_threshold` are additionally split across all CPUs.
+AVX-512 is the especial beneficiary, as the JSF PRNG makes heavy use of bit rotation,
+which must be emulated with shifting and masking before AVX-512. The output for a
+given seed is identical whichever path generates it.
 */
 class LLFIO_DECL fast_random_file_handle : public file_handle
 {
@@ -99,6 +98,9 @@ public:
   template <class T> using io_request = io_handle::io_request<T>;
   template <class T> using io_result = io_handle::io_result<T>;
 
+  //! Reads of at least this many bytes are generated by all CPUs in parallel
+  static constexpr size_type parallel_fill_threshold = 16 * 1024 * 1024;
+
 protected:
   struct prng : public QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng
   {
@@ -123,6 +125,9 @@ protected:
   } _prng;
   extent_type _length{0};
 
+  // Fills `bytes` of `dest` with the randomness at `offset`, spreading the work over all CPUs if large
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void _fill(const prng &p, extent_type offset, byte *dest, size_type bytes) noexcept;
+
   result<void> _perms_check() const noexcept
   {
     if(!this->is_writable())
@@ -252,6 +257,61 @@ public:
     return extent.length;
   }
 
+  //! \brief Zero or discard portions of the random file (does nothing).
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero_extents(span<const extent_pair> extents, bool /*unused*/ = false, deadline /*unused*/ = deadline()) noexcept override
+  {
+    OUTCOME_TRY(_perms_check());
+    extent_type ret = 0;
+    for(auto &extent : extents)
+    {
+      ret += extent.length;
+    }
+    return ret;
+  }
+
+  //! \brief Preallocate a portion of the random file (extends the maximum extent if not `keep_size`).
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_pair> preallocate(extent_pair extent, bool keep_size = true) noexcept override
+  {
+    OUTCOME_TRY(_perms_check());
+    if(!keep_size && extent.offset + extent.length > _length)
+    {
+      _length = extent.offset + extent.length;
+    }
+    return extent;
+  }
+
+  //! \brief Collapse a portion of the random file (shortens the maximum extent).
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(extent_pair extent) noexcept override
+  {
+    OUTCOME_TRY(_perms_check());
+    if(extent.offset + extent.length >= _length)
+    {
+      return errc::invalid_argument;
+    }
+    _length -= extent.length;
+    return _length;
+  }
+
+  //! \brief Insert a portion into the random file (lengthens the maximum extent).
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(extent_pair extent) noexcept override
+  {
+    OUTCOME_TRY(_perms_check());
+    if(extent.offset >= _length)
+    {
+      return errc::invalid_argument;
+    }
+    _length += extent.length;
+    return _length;
+  }
+
+  //! \brief Access pattern hints do nothing, as there is no kernel cache.
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> advise(extent_pair /*unused*/, access_hint /*unused*/) noexcept override { return success(); }
+
   //! \brief Return a single extent of the maximum extent
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<file_handle::extent_pair>> extents() const noexcept override { return std::vector<file_handle::extent_pair>{{0, _length}}; }
 
@@ -286,6 +346,38 @@ public:
 #endif
   using file_handle::write;
 
+  /*! \brief Compares some data with what this random file contains at some offset.
+
+  The expected data is generated in blocks using the same vectorised generator used by `read()`,
+  and compared using `memcmp()`, so this runs at a similar speed to reading the random file.
+  Bytes at or after `maximum_extent()` never match.
+
+  \return The offset of the first byte which does not match, or `offset + data.size()` if all match.
+  \param offset The offset into this random file which `data` ought to equal.
+  \param data The data to compare.
+  \errors None possible.
+  \mallocs None possible.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC extent_type find_mismatch(extent_type offset, const_buffer_type data) const noexcept;
+
+  /*! \brief Verifies that a region of another handle contains what this random file contains.
+
+  This is intended for burn-in and soak testing of storage, whereby one writes the contents of a
+  random file into some other file or device (e.g. using `clone_extents_to()`), and then later
+  verifies those contents without needing to have stored any reference data. Only the seed of
+  the random file needs to be the same.
+
+  \return The offset of the first byte in `h` which does not match, or `extent.offset + extent.length`
+  if all match. If `h` ends before the end of the region, the offset of its end is returned.
+  \param h The handle to verify. Reads are performed using registered buffers allocated from it,
+  so handles opened for direct i/o work correctly.
+  \param extent The region of `h` to verify, which is compared with the same region of this random file.
+  \param blocksize The size of each read from `h`.
+  \param d An optional deadline by which the verification must complete.
+  \errors Any of the values which `h.read()` or `h.allocate_registered_buffer()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> verify(io_handle &h, extent_pair extent, size_type blocksize = 1024 * 1024, deadline d = deadline()) const noexcept;
+
 private:
   struct _extent_guard : public extent_guard
   {
@@ -38,6 +38,11 @@ Distributed under the Boost Software License, Version 1.0.
 
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
 
+namespace detail
+{
+  struct temp_inode_pool;
+}
+
 /*! \class file_handle
 \brief A handle to a regular file or device, kept data layout compatible with
 async_file_handle.
@@ -95,7 +100,11 @@ public:
   constexpr file_handle(file_handle &&o) noexcept
       : lockable_io_handle(std::move(o))
       , fs_handle(std::move(o))
+      , _extent_cache(o._extent_cache)
+      , _drop_behind(o._drop_behind)
   {
+    o._extent_cache = nullptr;
+    o._drop_behind = nullptr;
   }
   //! Explicit conversion from handle permitted
   explicit constexpr file_handle(handle &&o, dev_t devid, ino_t inode, io_multiplexer *ctx) noexcept
@@ -153,6 +162,32 @@ public:
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<file_handle> file(const path_handle &base, path_view_type path, mode _mode = mode::read,
                                                                   creation _creation = creation::open_existing, caching _caching = caching::all,
                                                                   flag flags = flag::none) noexcept;
+  /*! Create many file handles at once, opening each of `paths` relative to `base` as `file()` would.
+  If `multiplexer` is not null, the opens are executed as a batch using `io_multiplexer::do_posix_fs_syscalls()`,
+  which the Linux io_uring multiplexer executes at high queue depth instead of serially. Otherwise,
+  and on Windows, each path is opened serially.
+
+  The handles returned do not use `multiplexer` for i/o unless you set it with `set_multiplexer()`.
+
+  \return The result of opening each path, in the same order as `paths`.
+  \errors Any of the values POSIX open() or CreateFile() can return, per path. Any of the values
+  `std::vector` can throw, or the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<file_handle>>> files(const path_handle &base, span<const path_view_type> paths,
+                                                                                        mode _mode = mode::read, creation _creation = creation::open_existing,
+                                                                                        caching _caching = caching::all, flag flags = flag::none,
+                                                                                        io_multiplexer *multiplexer = this_thread::multiplexer()) noexcept;
+  /*! Close many file handles at once, as `close()` would. If `multiplexer` is not null, handles whose
+  close is just closing the fd are closed as a batch using `io_multiplexer::do_posix_fs_syscalls()`.
+  Handles with `flag::unlink_on_first_close`, needing safety barriers on close, or registered with
+  an i/o multiplexer are closed serially, as are all handles on Windows.
+
+  \return The result of closing each handle, in the same order as `fhs`.
+  \errors Any of the values POSIX close() or CloseHandle() can return, per handle. Any of the values
+  `std::vector` can throw, or the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<void>>> close_files(span<file_handle> fhs,
+                                                                                       io_multiplexer *multiplexer = this_thread::multiplexer()) noexcept;
   /*! Create a file handle creating a uniquely named file on a path.
   The file is opened exclusively with `creation::only_if_not_exist` so it
   will never collide with nor overwrite any existing file. Note also
@@ -213,11 +248,31 @@ public:
   to its contents via some path on the filing system (a classic use case
   is for backing shared memory maps).
 
+  If `reserve_temp_inodes()` has been called for `dirh`, and `_mode` and `flags`
+  are their defaults, the inode is taken from that pool of pre-created inodes
+  without any syscall.
+
   \errors Any of the values POSIX open() or CreateFile() can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<file_handle> temp_inode(const path_handle &dirh = path_discovery::storage_backed_temporary_files_directory(),
                                                                         mode _mode = mode::write, flag flags = flag::none) noexcept;
+  /*! \brief Keeps a pool of `count` anonymous inodes pre-created in `dirh`, from which
+  `temp_inode(dirh)` takes without making any syscall.
+
+  The pool is filled before returning, and thereafter refilled by a background thread
+  shared by all pools, woken when a pool falls to half full. If the pool is empty,
+  `temp_inode()` creates an inode as normal. Taking from the pool is lock free.
+
+  Pools are identified by the native handle of `dirh`, so `release_temp_inodes()`
+  must be called before `dirh` is closed. Calling this again for the same `dirh`
+  changes the count.
+
+  \errors Any of the values which `temp_inode()` or `clone()` can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> reserve_temp_inodes(const path_handle &dirh, size_t count) noexcept;
+  //! \brief Closes all the inodes pooled for `dirh` by `reserve_temp_inodes()`. Does nothing if there are none.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void release_temp_inodes(const path_handle &dirh) noexcept;
 
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~file_handle() override
   {
@@ -225,7 +280,13 @@ public:
     {
       (void) file_handle::close();
     }
+    delete _extent_cache;
+    delete _drop_behind;
   }
+  /*! \brief Reuses the path last returned if it still leads to this inode, which on POSIX is
+  far cheaper than asking the kernel. See `handle::current_path()` for the semantics.
+  */
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<path_type> current_path() const noexcept override { return _cached_current_path(); }
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override
   {
     LLFIO_LOG_FUNCTION_CALL(this);
@@ -248,6 +309,18 @@ public:
       _v.behaviour |= native_handle_type::disposition::_child_close_executed;
     }
 #endif
+    delete _extent_cache;
+    _extent_cache = nullptr;
+    if(_drop_behind != nullptr)
+    {
+      // Drop whatever was read since the last drop
+      if(_drop_behind->end > _drop_behind->begin)
+      {
+        (void) advise({_drop_behind->begin, _drop_behind->end - _drop_behind->begin}, access_hint::dontneed);
+      }
+      delete _drop_behind;
+      _drop_behind = nullptr;
+    }
     return io_handle::close();
   }
 
@@ -310,6 +383,74 @@ public:
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<std::vector<extent_pair>> extents() const noexcept;
 
+  //! The properties of an extent returned by `extent_map()`
+  QUICKCPPLIB_BITFIELD_BEGIN(extent_flag){none = 0U,                      //!< No flags
+                                          unknown_location = 1U << 0U,    //!< The physical location of this extent is not known
+                                          delayed_allocation = 1U << 1U,  //!< Storage for this extent has not been allocated yet
+                                          encoded = 1U << 2U,             //!< This extent is compressed or encrypted
+                                          unwritten = 1U << 3U,           //!< This extent is allocated but not yet written, so reads as all bits zero
+                                          shared = 1U << 4U,              //!< This extent is shared copy-on-write with other files or snapshots
+                                          inline_data = 1U << 5U,         //!< This extent is stored within filing system metadata
+                                          last = 1U << 6U                 //!< This is the last extent in the file
+  } QUICKCPPLIB_BITFIELD_END(extent_flag)
+
+  //! A valid extent, with its location upon the storage device if known
+  struct extent_info
+  {
+    extent_type offset{(extent_type) -1};
+    extent_type length{(extent_type) -1};
+    extent_type physical{(extent_type) -1};  //!< The byte offset upon the storage device, or -1 if not known
+    extent_flag flags{extent_flag::none};
+
+    constexpr extent_info() {}
+    constexpr extent_info(extent_type _offset, extent_type _length, extent_type _physical = (extent_type) -1, extent_flag _flags = extent_flag::unknown_location)
+        : offset(_offset)
+        , length(_length)
+        , physical(_physical)
+        , flags(_flags)
+    {
+    }
+    //! Implicitly converts to the logical extent
+    constexpr operator extent_pair() const noexcept { return {offset, length}; }
+    bool operator==(const extent_info &o) const noexcept { return offset == o.offset && length == o.length && physical == o.physical && flags == o.flags; }
+    bool operator!=(const extent_info &o) const noexcept { return !(*this == o); }
+  };
+
+  /*! \brief Returns a map of currently valid extents for this open file, with their physical
+  locations and properties where the platform can supply them. WARNING: racy unless cached!
+
+  On Linux this is implemented using the `FIEMAP` ioctl, which returns hundreds of extents
+  per syscall instead of the two syscalls per extent of `SEEK_DATA` and `SEEK_HOLE`, and it
+  also reports which extents are unwritten and which are shared copy-on-write. Elsewhere,
+  or on filing systems without `FIEMAP` support, this returns `extents()` with every extent
+  marked `extent_flag::unknown_location`. Unlike `extents()`, extents are not coalesced, so
+  adjacent logical extents stored in different physical locations are returned separately.
+
+  If extent map caching has been enabled for this handle using `set_extent_map_caching()`,
+  the map is only fetched from the filing system on first use after invalidation.
+
+  \errors Any of the values POSIX ioctl() or DeviceIoControl() can return.
+  \mallocs Allocates the returned vector, and one temporary buffer on Linux.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<extent_info>> extent_map() const noexcept;
+
+  /*! \brief Enables or disables caching of this handle's extent map.
+
+  When enabled, `extent_map()`, `extents()` and `clone_extents_to()` reuse a cached copy
+  of the extent map for this file, which is invalidated by `write()`, `zero()`, `truncate()`
+  and by being the destination of `clone_extents_to()` on this handle. This saves
+  rescanning the extents of heavily sparse files on every call.
+
+  \warning Modifications to the file not made through this handle, including writes through
+  memory maps, writes issued via an i/o multiplexer, or writes from other handles and
+  processes, are not seen. Only enable caching if this handle is the only writer to the file.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> set_extent_map_caching(bool enable) noexcept;
+  //! True if this handle is caching its extent map.
+  bool is_extent_map_cached() const noexcept { return _extent_cache != nullptr; }
+
   /*! \brief Clones the extents referred to by `extent` to `dest` at `destoffset`. This
   is how you ought to copy file content, including within the same file. This is
   fundamentally a racy call with respect to concurrent modification of the files.
@@ -328,8 +469,11 @@ public:
   copy going over the network. This is usually far more efficient.
 
   This implementation first enumerates the valid extents for the region requested, and
-  only clones extents which are reported as valid. It
-  then iterates the platform specific syscall to cause the extents to be cloned in
+  only clones extents which are reported as valid. On Linux, it then attempts to reflink
+  each valid extent in a single `FICLONERANGE`, and if that is not possible, it hands
+  as much of each valid extent as possible to `copy_file_range()` (Linux and FreeBSD),
+  which lets the kernel or a networked filing system server perform the copy. If those
+  fail, it iterates the platform specific syscall to cause the extents to be cloned in
   `utils::page_allocator<T>` sized chunks (i.e. the next large page greater or equal
   to 1Mb). Generally speaking, if the dedicated syscalls fail, the implementation falls
   back to a user space emulation, unless `emulate_if_unsupported` is false.
@@ -362,6 +506,32 @@ public:
     return clone_extents_to({(extent_type)-1, (extent_type)-1}, dest, 0, d, force_copy_now, emulate_if_unsupported);
   }
 
+  /*! \brief Shares the storage of a region of this file with the identical region of `dest` at
+  `destoffset`, freeing the storage of that region of `dest`, but only where their contents are
+  identical.
+
+  On Linux this is implemented using the `FIDEDUPERANGE` ioctl, which is supported by btrfs, XFS
+  and OCFS2, and in which the kernel compares the two regions with both files locked, so it is race
+  free to concurrent writers. On Windows, the two regions are compared in user space and then shared
+  using `FSCTL_DUPLICATE_EXTENTS_TO_FILE`, which is supported by ReFS, so a concurrent write to
+  `dest` between the comparison and the sharing is lost. Elsewhere, `errc::operation_not_supported`
+  is returned.
+
+  The offsets and the length must be multiples of the filing system's block size, except that the
+  region of this file may end at its maximum extent. If the contents differ, only some leading part
+  of the region, possibly none of it, is shared.
+
+  \return The number of bytes from `extent.offset` now shared with `dest`.
+  \param extent The offset and length of the region of this file.
+  \param dest The file whose identical region is to share the storage of this file.
+  \param destoffset The offset of the region of `dest`.
+  \errors Any of the values POSIX ioctl() or DeviceIoControl() can return, `errc::invalid_argument`
+  if the region is not suitably aligned.
+  \mallocs None on Linux, two `utils::page_allocator<T>` buffers on Windows.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> deduplicate_extents_to(extent_pair extent, file_handle &dest, extent_type destoffset) noexcept;
+
   /*! \brief Efficiently zero, and possibly deallocate, data on storage.
 
   On most major operating systems and with recent filing systems which are "extents based", one can
@@ -388,6 +558,252 @@ public:
   result<extent_type> zero(extent_type offset, extent_type bytes, deadline d = deadline()) noexcept { return zero({offset, bytes}, d); }
 
   LLFIO_DEADLINE_TRY_FOR_UNTIL(zero)
+
+  /*! \brief Zeroes, or discards, many regions of the file with a single call.
+
+  If `discard` is false, this is equivalent to calling `zero()` for each region in turn, but the
+  extent map is invalidated only once.
+
+  If `discard` is true, the storage of each region is released without regard to its contents
+  afterwards, which may read as all bits zero or as garbage. No zeros are ever written, which keeps
+  write amplification on SSDs low. On Linux, block devices are discarded using `BLKDISCARD`, and
+  regular files have holes punched with `FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE`. On Windows, all
+  the regions are passed to `FSCTL_FILE_LEVEL_TRIM` in one syscall. Where the filing system or device
+  cannot release storage, or on other platforms, nothing more is released and the bytes released so
+  far are returned.
+
+  \return The bytes zeroed or released.
+  \param extents The regions to zero or discard.
+  \param discard Whether to release the storage without zeroing it.
+  \param d An optional deadline by which each zeroing i/o must complete, else it is cancelled.
+  \errors Any of the values `zero()` can return, or that POSIX fallocate() or ioctl() or
+  DeviceIoControl() can return.
+  \mallocs None on POSIX, one when discarding on Windows.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero_extents(span<const extent_pair> extents, bool discard = false, deadline d = deadline()) noexcept;
+
+  /*! \brief Preallocates physical storage for a region of the file, without writing to it.
+
+  Large sequential writers which extend a file using `truncate()` or appending writes tend to
+  end up with heavily fragmented files, as the filing system allocates storage piecemeal.
+  Preallocating the region to be written ahead of time lets the filing system choose contiguous
+  extents, and guarantees that later writes into the region will not fail due to lack of
+  storage. Preallocated extents are usually marked as unwritten, and read as all bits zero.
+
+  If `keep_size` is true, the maximum extent of the file is not changed even if the region
+  lies beyond it, so the preallocated storage is consumed as the file is extended by writes.
+  Otherwise the file is extended to cover the region if needed.
+
+  This is implemented using `fallocate()` on Linux, `F_PREALLOCATE` on Mac OS, `posix_fallocate()`
+  on FreeBSD and `SetFileInformationByHandle(FileAllocationInfo)` on Windows. On FreeBSD,
+  `keep_size` preallocates only up to the current maximum extent. On Mac OS and Windows, storage
+  is allocated from the current physical end of the file rather than for exactly the region
+  given, which is equivalent for the sequential writer use case.
+
+  \return The region preallocated.
+  \param extent The offset to start preallocating from and the number of bytes to preallocate.
+  \param keep_size Whether to leave the maximum extent of the file unchanged.
+  \errors Any of the values POSIX fallocate() or SetFileInformationByHandle() can return.
+  \mallocs None.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_pair> preallocate(extent_pair extent, bool keep_size = true) noexcept;
+
+  /*! \brief Removes a region from the file, shifting all the content after it down.
+
+  This is the cheap way of trimming the head of a log file, as no data is copied, the extents
+  after the region are simply renumbered by the filing system. The maximum extent of the file
+  is reduced by the length of the region.
+
+  This is implemented using `fallocate(FALLOC_FL_COLLAPSE_RANGE)` on Linux, which is supported
+  by ext4 and XFS. Both the offset and the length of the region must be multiples of the filing
+  system's block size, and the region must not reach the end of the file, else an error comparing
+  equal to `errc::invalid_argument` is returned. On platforms without an equivalent syscall,
+  `errc::operation_not_supported` is returned.
+
+  \note Memory maps of the file will see the content moving underneath them, and a
+  `mapped_file_handle` needs `update_map()` calling afterwards to see the new length.
+
+  \return The new maximum extent of the file.
+  \param extent The offset and length of the region to remove.
+  \errors Any of the values POSIX fallocate() can return.
+  \mallocs None.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> collapse(extent_pair extent) noexcept;
+
+  /*! \brief Inserts a deallocated region into the file, shifting all the content after it up.
+
+  The inverse of `collapse()`, the content from `extent.offset` onwards is moved up by
+  `extent.length` bytes, leaving a hole which reads as all bits zero. The maximum extent of the
+  file is increased by the length of the region.
+
+  This is implemented using `fallocate(FALLOC_FL_INSERT_RANGE)` on Linux, which is supported
+  by ext4 and XFS. Both the offset and the length of the region must be multiples of the filing
+  system's block size, and the offset must be within the file, else an error comparing equal
+  to `errc::invalid_argument` is returned. On platforms without an equivalent syscall,
+  `errc::operation_not_supported` is returned.
+
+  \note Memory maps of the file will see the content moving underneath them, and a
+  `mapped_file_handle` needs `update_map()` calling afterwards to see the new length.
+
+  \return The new maximum extent of the file.
+  \param extent The offset at which to insert, and the length of the region to insert.
+  \errors Any of the values POSIX fallocate() can return.
+  \mallocs None.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> insert(extent_pair extent) noexcept;
+
+  //! The kinds of access pattern hint which can be given to `advise()`
+  enum class access_hint : unsigned char
+  {
+    normal,      //!< No particular access pattern, the default
+    sequential,  //!< The region will be read sequentially, so read ahead aggressively
+    random,      //!< The region will be read randomly, so do not read ahead
+    willneed,    //!< The region will be needed soon, so begin reading it into the kernel cache now
+    dontneed,    //!< The region will not be needed again soon, so evict it from the kernel cache
+    noreuse      //!< The region will be accessed only once
+  };
+
+  /*! \brief Tells the kernel how a region of this file is about to be accessed.
+
+  This is the plain read counterpart to `map_handle::prefetch()`. It is implemented using
+  `posix_fadvise()` on Linux and FreeBSD, which for `access_hint::willneed` initiates
+  readahead of the region immediately. On Mac OS, `access_hint::willneed` issues
+  `fcntl(F_RDADVISE)` and `access_hint::sequential`, `access_hint::random` and
+  `access_hint::normal` toggle readahead for the whole file using `fcntl(F_RDAHEAD)`.
+  All other combinations, including everything on Microsoft Windows, do nothing and
+  return success as hints are purely advisory.
+
+  \param region The offset and length of the region to hint. A length of zero means
+  to the end of the file.
+  \param hint The hint to give.
+  \errors Any of the values POSIX posix_fadvise() or fcntl() can return.
+  \mallocs None.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> advise(extent_pair region, access_hint hint) noexcept;
+
+  //! The number of contiguously read bytes after which drop behind mode evicts them from the kernel cache
+  static constexpr extent_type drop_behind_threshold = 4 * 1024 * 1024;
+
+  /*! \brief Enables or disables drop behind mode for this handle.
+
+  In drop behind mode, every `drop_behind_threshold` bytes read contiguously through this
+  handle are evicted from the kernel cache using `advise(access_hint::dontneed)`, as is
+  whatever remains when a read is not contiguous with the previous one, or when the handle
+  is closed. This lets a streaming scan of a large file using `caching::all` avoid evicting
+  everybody else's working set from the kernel cache, without the alignment restrictions
+  of `caching::none`.
+
+  Drop behind mode only makes sense for sequential readers, as each random read would evict
+  the previous one. Reads issued via an i/o multiplexer or through memory maps are not seen.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  result<void> set_drop_behind(bool enable) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    try
+    {
+      if(enable && _drop_behind == nullptr)
+      {
+        _drop_behind = new _drop_behind_state;
+      }
+      else if(!enable && _drop_behind != nullptr)
+      {
+        if(_drop_behind->end > _drop_behind->begin)
+        {
+          (void) advise({_drop_behind->begin, _drop_behind->end - _drop_behind->begin}, access_hint::dontneed);
+        }
+        delete _drop_behind;
+        _drop_behind = nullptr;
+      }
+      return success();
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+  //! True if this handle is in drop behind mode.
+  bool is_drop_behind() const noexcept { return _drop_behind != nullptr; }
+
+protected:
+  //! Implements drop behind mode if enabled
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<buffers_type> _do_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept override
+  {
+    const extent_type offset = reqs.offset;
+    auto ret = lockable_io_handle::_do_read(std::move(reqs), d);
+    if(_drop_behind != nullptr && ret)
+    {
+      _drop_behind_after_read(offset, ret.bytes_transferred());
+    }
+    return ret;
+  }
+  using lockable_io_handle::_do_read;
+  //! Invalidates any cached extent map before writing
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
+  {
+    _invalidate_extent_map();
+    return lockable_io_handle::_do_write(reqs, d);
+  }
+  using lockable_io_handle::_do_write;
+  void _invalidate_extent_map() noexcept
+  {
+    if(_extent_cache != nullptr)
+    {
+      lock_guard<spinlock> g(_extent_cache->lock);
+      _extent_cache->valid = false;
+      ++_extent_cache->generation;
+    }
+  }
+  void _drop_behind_after_read(extent_type offset, size_type bytes) noexcept
+  {
+    extent_pair todrop(0, 0);
+    {
+      lock_guard<spinlock> g(_drop_behind->lock);
+      if(offset != _drop_behind->end)
+      {
+        // Not a continuation of the previous read, so drop what went before and start afresh
+        todrop = {_drop_behind->begin, _drop_behind->end - _drop_behind->begin};
+        _drop_behind->begin = offset;
+      }
+      _drop_behind->end = offset + bytes;
+      if(todrop.length == 0 && _drop_behind->end - _drop_behind->begin >= drop_behind_threshold)
+      {
+        // Retain the page currently being read into, the kernel only drops whole pages
+        const extent_type end = _drop_behind->end & ~static_cast<extent_type>(utils::page_size() - 1);
+        todrop = {_drop_behind->begin, end - _drop_behind->begin};
+        _drop_behind->begin = end;
+      }
+    }
+    if(todrop.length > 0)
+    {
+      (void) advise(todrop, access_hint::dontneed);
+    }
+  }
+
+private:
+  friend struct detail::temp_inode_pool;
+  // Creates a temporary inode without consulting any pool
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<file_handle> _temp_inode(const path_handle &dirh, mode _mode, flag flags) noexcept;
+
+  struct _extent_map_cache
+  {
+    spinlock lock;
+    bool valid{false};
+    uint64_t generation{0};
+    std::vector<extent_info> map;
+  };
+  mutable _extent_map_cache *_extent_cache{nullptr};
+  struct _drop_behind_state
+  {
+    spinlock lock;
+    extent_type begin{0}, end{0};
+  };
+  _drop_behind_state *_drop_behind{nullptr};
 };
 
 //! \brief Constructor for `file_handle`
@@ -547,6 +963,7 @@ LLFIO_V2_NAMESPACE_END
 #else
 #include "detail/impl/posix/file_handle.ipp"
 #endif
+#include "detail/impl/temp_inode_pool.ipp"
 #undef LLFIO_INCLUDED_BY_HEADER
 #endif
 
@@ -148,16 +148,29 @@ public:
 protected:
   mutable dev_t _devid{0};
   mutable ino_t _inode{0};
+  // The path last returned by _cached_current_path(), allocated on first use, and only accessed atomically
+  struct _current_path_cache
+  {
+    spinlock lock;
+    filesystem::path path;
+  };
+  mutable _current_path_cache *_current_path{nullptr};
 
   //! Fill in _devid and _inode from the handle via fstat()
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> _fetch_inode() const noexcept;
+  /*! Returns `handle::current_path()`, except that if the path it last returned still leads to
+  this inode, that is returned instead, which on POSIX costs one `lstat()` rather than asking the
+  kernel for the path. Where the inode has more than one hard link, this can return the path of a
+  link from which this handle was since renamed away.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<filesystem::path> _cached_current_path() const noexcept;
 
   virtual const handle &_get_handle() const noexcept = 0;
 
 protected:
   //! Default constructor
   constexpr fs_handle() {}  // NOLINT
-  ~fs_handle() = default;
+  ~fs_handle() { delete _current_path; }
   //! Construct a handle
   constexpr fs_handle(dev_t devid, ino_t inode)
       : _devid(devid)
@@ -168,9 +181,11 @@ protected:
   constexpr fs_handle(fs_handle &&o) noexcept
       : _devid(o._devid)
       , _inode(o._inode)
+      , _current_path(o._current_path)
   {
     o._devid = 0;
     o._inode = 0;
+    o._current_path = nullptr;
   }
   //! Move assignment of fs_handle permitted
   fs_handle &operator=(fs_handle &&o) noexcept
@@ -181,8 +196,11 @@ protected:
     }
     _devid = o._devid;
     _inode = o._inode;
+    delete _current_path;
+    _current_path = o._current_path;
     o._devid = 0;
     o._inode = 0;
+    o._current_path = nullptr;
     return *this;
   }
 
@@ -146,6 +146,13 @@ public:
   into kernel cache. This can improve sequential i/o performance.
   */
   maximum_prefetching = 1U << 5U,
+  /*! i/o multiplexers which must reorder i/o, such as io_uring's, by default emulate the
+  POSIX read/write concurrency guarantees, by not executing concurrently any i/o upon the
+  same handle whose byte ranges overlap where one is a write. If the application already
+  guarantees that concurrent reads and writes never overlap, this flag disables that
+  emulation, avoiding its overhead. Barriers remain ordered against writes.
+  */
+  disable_posix_concurrency_guarantees = 1U << 6U,
 
   win_disable_unlink_emulation = 1U << 24U,  //!< See the documentation for `unlink_on_first_close`
   /*! Microsoft Windows NTFS, having been created in the late 1980s, did not originally
@@ -484,6 +491,10 @@ inline std::ostream &operator<<(std::ostream &s, const handle::flag &v)
   {
     temp.append("maximum_prefetching|");
   }
+  if(!!(v & handle::flag::disable_posix_concurrency_guarantees))
+  {
+    temp.append("disable_posix_concurrency_guarantees|");
+  }
   if(!!(v & handle::flag::win_disable_unlink_emulation))
   {
     temp.append("win_disable_unlink_emulation|");
@@ -26,6 +26,7 @@ Distributed under the Boost Software License, Version 1.0.
 #define LLFIO_IO_HANDLE_H
 
 #include "io_multiplexer.hpp"
+#include "io_trace.hpp"
 
 //! \file io_handle.hpp Provides a byte-orientated i/o handle
 
@@ -58,11 +59,17 @@ public:
   using const_buffers_type = io_multiplexer::const_buffers_type;
   using registered_buffer_type = io_multiplexer::registered_buffer_type;
   template <class T> using io_request = io_multiplexer::io_request<T>;
+  using io_request_flag = io_multiplexer::io_request_flag;
+  using io_priority = io_multiplexer::io_priority;
   template <class T> using io_result = io_multiplexer::io_result<T>;
   template <class T> using awaitable = io_multiplexer::awaitable<T>;
 
 protected:
   io_multiplexer *_ctx{nullptr};  // +4 or +8 bytes
+  io_priority _priority{io_priority::normal};
+#if LLFIO_ENABLE_IO_STATISTICS
+  io_statistics *_statistics{nullptr};
+#endif
 
 public:
   //! Default constructor
@@ -118,6 +125,100 @@ public:
   */
   virtual result<void> set_multiplexer(io_multiplexer *c = this_thread::multiplexer()) noexcept;  // implementation is below
 
+  /*! \brief The statistics into which this handle's i/o is recorded, if any. Always null if
+  `LLFIO_ENABLE_IO_STATISTICS` is off.
+  */
+  io_statistics *statistics() const noexcept
+  {
+#if LLFIO_ENABLE_IO_STATISTICS
+    return _statistics;
+#else
+    return nullptr;
+#endif
+  }
+  /*! \brief Sets the statistics into which this handle's i/o is recorded, which must outlive
+  that i/o, in addition to those of the calling thread and of any multiplexer. Does nothing if
+  `LLFIO_ENABLE_IO_STATISTICS` is off.
+  */
+  void set_statistics(io_statistics *s) noexcept
+  {
+#if LLFIO_ENABLE_IO_STATISTICS
+    _statistics = s;
+#else
+    (void) s;
+#endif
+  }
+
+  //! \brief The priority class of this handle's i/o.
+  io_priority priority() const noexcept { return _priority; }
+  /*! \brief Sets the priority class of this handle's i/o.
+
+  On Windows this sets the i/o priority hint of the handle, `io_priority::low` being
+  `IoPriorityHintLow` and the others `IoPriorityHintNormal`, as higher hints are reserved to the
+  system. On POSIX, the priority class is used by multiplexers which can set the kernel priority
+  of individual i/o, such as io_uring, and by `multiplexer_prioritised()`.
+
+  \errors Any of the values returned by `SetFileInformationByHandle()`.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> set_priority(io_priority p) noexcept;
+  //! \brief The priority class of an i/o with request flags `flags` upon this handle.
+  io_priority effective_priority(io_request_flag flags) const noexcept
+  {
+    if(flags & io_request_flag::high_priority)
+    {
+      return io_priority::high;
+    }
+    if(flags & io_request_flag::low_priority)
+    {
+      return io_priority::low;
+    }
+    return _priority;
+  }
+
+private:
+  // Times, counts and traces the i/o done by f() if LLFIO_ENABLE_IO_STATISTICS or LLFIO_ENABLE_IO_TRACING is on
+  template <class BuffersType, class F> auto _instrument(io_statistics::operation op, const io_request<BuffersType> &reqs, F &&f) noexcept -> decltype(f())
+  {
+#if LLFIO_ENABLE_IO_STATISTICS || LLFIO_ENABLE_IO_TRACING
+    // The buffers may be updated in place, so count the bytes requested first
+    size_t requested = 0;
+    for(const auto &b : reqs.buffers)
+    {
+      requested += b.size();
+    }
+#if LLFIO_ENABLE_IO_TRACING
+    const uint64_t beginticks = io_trace::ticks();
+#endif
+#if LLFIO_ENABLE_IO_STATISTICS
+    const auto begin = std::chrono::steady_clock::now();
+#endif
+    auto ret = f();
+    const size_t transferred = ret ? ret.bytes_transferred() : 0;
+#if LLFIO_ENABLE_IO_TRACING
+    // io_trace::operation has the same values as io_statistics::operation
+    io_trace::record({(uint64_t)(uintptr_t) this, (int64_t) _v._init, (uint64_t) reqs.offset, requested, transferred, beginticks, io_trace::ticks(), 0,
+                      (io_trace::operation) op, (uint16_t) !ret});
+#endif
+#if LLFIO_ENABLE_IO_STATISTICS
+    const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+    io_statistics::this_thread().record(op, requested, transferred, !ret, latency);
+    if(_statistics != nullptr)
+    {
+      _statistics->record(op, requested, transferred, !ret, latency);
+    }
+    if(_ctx != nullptr && _ctx->statistics() != nullptr)
+    {
+      _ctx->statistics()->record(op, requested, transferred, !ret, latency);
+    }
+#endif
+    return ret;
+#else
+    (void) op;
+    (void) reqs;
+    return f();
+#endif
+  }
+
 protected:
   //! The virtualised implementation of `max_buffers()` used if no multiplexer has been set.
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept;
@@ -142,7 +243,54 @@ protected:
   //! The virtualised implementation of `barrier()` used if no multiplexer has been set.
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs, barrier_kind kind, deadline d) noexcept;
 
+  // Performs requests with more buffers than `maxbuffers` as a sequence of requests, stopping at the first short transfer
+  template <class BuffersType, class F> static io_result<BuffersType> _split_io_request(io_request<BuffersType> reqs, size_t maxbuffers, F &&op) noexcept
+  {
+    size_t idx = 0;
+    while(idx < reqs.buffers.size())
+    {
+      const size_t count = std::min(reqs.buffers.size() - idx, maxbuffers);
+      io_request<BuffersType> batch({reqs.buffers.data() + idx, count}, reqs.offset, reqs.flags);
+      size_t requested = 0;
+      for(auto &b : batch.buffers)
+      {
+        requested += b.size();
+      }
+      io_result<BuffersType> r = op(batch);
+      if(!r)
+      {
+        if(idx == 0)
+        {
+          return r;
+        }
+        // Report what was transferred, the failure will recur on the next call
+        return BuffersType{reqs.buffers.data(), idx};
+      }
+      size_t transferred = 0;
+      for(auto &b : r.value())
+      {
+        transferred += b.size();
+      }
+      if(transferred < requested)
+      {
+        return BuffersType{reqs.buffers.data(), idx + r.value().size()};
+      }
+      idx += count;
+      reqs.offset += transferred;
+    }
+    return reqs.buffers;
+  }
+
   io_result<buffers_type> _do_multiplexer_read(registered_buffer_type &&base, io_request<buffers_type> reqs, deadline d) noexcept
+  {
+    const size_t maxbuffers = _ctx->do_io_handle_max_buffers(this);
+    if(maxbuffers > 0 && reqs.buffers.size() > maxbuffers)
+    {
+      return _split_io_request(reqs, maxbuffers, [&](io_request<buffers_type> batch) { return _do_multiplexer_read_batch(registered_buffer_type(base), batch, d); });
+    }
+    return _do_multiplexer_read_batch(std::move(base), reqs, d);
+  }
+  io_result<buffers_type> _do_multiplexer_read_batch(registered_buffer_type &&base, io_request<buffers_type> reqs, deadline d) noexcept
   {
     LLFIO_DEADLINE_TO_SLEEP_INIT(d);
     const auto state_reqs = _ctx->io_state_requirements();
@@ -162,6 +310,15 @@ protected:
     return ret;
   }
   io_result<const_buffers_type> _do_multiplexer_write(registered_buffer_type &&base, io_request<const_buffers_type> reqs, deadline d) noexcept
+  {
+    const size_t maxbuffers = _ctx->do_io_handle_max_buffers(this);
+    if(maxbuffers > 0 && reqs.buffers.size() > maxbuffers)
+    {
+      return _split_io_request(reqs, maxbuffers, [&](io_request<const_buffers_type> batch) { return _do_multiplexer_write_batch(registered_buffer_type(base), batch, d); });
+    }
+    return _do_multiplexer_write_batch(std::move(base), reqs, d);
+  }
+  io_result<const_buffers_type> _do_multiplexer_write_batch(registered_buffer_type &&base, io_request<const_buffers_type> reqs, deadline d) noexcept
   {
     LLFIO_DEADLINE_TO_SLEEP_INIT(d);
     const auto state_reqs = _ctx->io_state_requirements();
@@ -209,9 +366,11 @@ public:
   lower than this system-defined limit, depending on available resources. The `read()` or `write()`
   call will return the buffers accepted at the time of invoking the syscall.
 
-  Note also that some OSs will error out if you supply more than this limit to `read()` or `write()`,
-  but other OSs do not. Some OSs guarantee that each i/o syscall has effects atomically visible or not
-  to other i/o, other OSs do not.
+  You may supply more buffers than this limit to `read()` or `write()`, in which case the request is
+  transparently performed as a sequence of syscalls, each of at most this many buffers, stopping at the
+  first short transfer. Requests with more bytes than a single syscall can transfer are similarly
+  continued. Some OSs guarantee that each i/o syscall has effects atomically visible or not to other i/o,
+  other OSs do not, but no OS makes such a guarantee for requests which had to be split.
 
   OS X does not implement scatter-gather file i/o syscalls. Thus this function will always return
   `1` in that situation.
@@ -281,10 +440,16 @@ public:
   The asynchronous implementation in async_file_handle performs one calloc and one free.
   */
   LLFIO_MAKE_FREE_FUNCTION
-  io_result<buffers_type> read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept { return (_ctx == nullptr) ? _do_read(reqs, d) : _do_multiplexer_read({}, reqs, d); }
+  io_result<buffers_type> read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept
+  {
+    return _instrument(io_statistics::operation::read, reqs, [&] { return (_ctx == nullptr) ? _do_read(reqs, d) : _do_multiplexer_read({}, reqs, d); });
+  }
   //! \overload Registered buffer overload, scatter list **must** be wholly within the registered buffer
   LLFIO_MAKE_FREE_FUNCTION
-  io_result<buffers_type> read(registered_buffer_type base, io_request<buffers_type> reqs, deadline d = deadline()) noexcept { return (_ctx == nullptr) ? _do_read(std::move(base), reqs, d) : _do_multiplexer_read(std::move(base), reqs, d); }
+  io_result<buffers_type> read(registered_buffer_type base, io_request<buffers_type> reqs, deadline d = deadline()) noexcept
+  {
+    return _instrument(io_statistics::operation::read, reqs, [&] { return (_ctx == nullptr) ? _do_read(std::move(base), reqs, d) : _do_multiplexer_read(std::move(base), reqs, d); });
+  }
   //! \overload Convenience initialiser list based overload for `read()`
   LLFIO_MAKE_FREE_FUNCTION
   io_result<size_type> read(extent_type offset, std::initializer_list<buffer_type> lst, deadline d = deadline()) noexcept
@@ -324,10 +489,17 @@ public:
   The asynchronous implementation in async_file_handle performs one calloc and one free.
   */
   LLFIO_MAKE_FREE_FUNCTION
-  io_result<const_buffers_type> write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept { return (_ctx == nullptr) ? _do_write(reqs, d) : _do_multiplexer_write({}, std::move(reqs), d); }
+  io_result<const_buffers_type> write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept
+  {
+    return _instrument(io_statistics::operation::write, reqs, [&] { return (_ctx == nullptr) ? _do_write(reqs, d) : _do_multiplexer_write({}, std::move(reqs), d); });
+  }
   //! \overload Registered buffer overload, gather list **must** be wholly within the registered buffer
   LLFIO_MAKE_FREE_FUNCTION
-  io_result<const_buffers_type> write(registered_buffer_type base, io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept { return (_ctx == nullptr) ? _do_write(std::move(base), reqs, d) : _do_multiplexer_write(std::move(base), std::move(reqs), d); }
+  io_result<const_buffers_type> write(registered_buffer_type base, io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept
+  {
+    return _instrument(io_statistics::operation::write, reqs,
+                       [&] { return (_ctx == nullptr) ? _do_write(std::move(base), reqs, d) : _do_multiplexer_write(std::move(base), std::move(reqs), d); });
+  }
   //! \overload Convenience initialiser list based overload for `write()`
   LLFIO_MAKE_FREE_FUNCTION
   io_result<size_type> write(extent_type offset, std::initializer_list<const_buffer_type> lst, deadline d = deadline()) noexcept
@@ -377,7 +549,7 @@ public:
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> barrier(io_request<const_buffers_type> reqs = io_request<const_buffers_type>(), barrier_kind kind = barrier_kind::nowait_data_only, deadline d = deadline()) noexcept
   {
-    return (_ctx == nullptr) ? _do_barrier(reqs, kind, d) : _do_multiplexer_barrier({}, std::move(reqs), kind, d);
+    return _instrument(io_statistics::operation::barrier, reqs, [&] { return (_ctx == nullptr) ? _do_barrier(reqs, kind, d) : _do_multiplexer_barrier({}, std::move(reqs), kind, d); });
   }
   //! \overload Convenience overload
   LLFIO_MAKE_FREE_FUNCTION
@@ -391,7 +563,8 @@ public:
   has been set on this handle!
 
   The awaitable returned is **eager** i.e. it immediately begins the i/o. If the i/o completes
-  and finishes immediately, no coroutine suspension occurs.
+  and finishes immediately, no coroutine suspension occurs. The i/o state is stored within
+  the awaitable, and thus within the coroutine frame, so no dynamic memory allocation occurs.
   */
   LLFIO_MAKE_FREE_FUNCTION
   awaitable<io_result<buffers_type>> co_read(io_request<buffers_type> reqs, deadline d = deadline()) noexcept
@@ -401,7 +574,13 @@ public:
       return awaitable<io_result<buffers_type>>(read(std::move(reqs), d));
     }
     awaitable<io_result<buffers_type>> ret;
-    ret.set_state(_ctx->construct(ret._state_storage, this, nullptr, {}, d, std::move(reqs)));
+    auto *state = _ctx->construct(ret._state_storage, this, nullptr, {}, d, reqs);
+    if(state == nullptr)
+    {
+      // This multiplexer's i/o state does not fit into an awaitable
+      return awaitable<io_result<buffers_type>>(read(std::move(reqs), d));
+    }
+    ret.set_state(state);
     return ret;
   }
   //! \overload Registered buffer overload, scatter list **must** be wholly within the registered buffer
@@ -413,7 +592,13 @@ public:
       return awaitable<io_result<buffers_type>>(read(std::move(base), std::move(reqs), d));
     }
     awaitable<io_result<buffers_type>> ret;
-    ret.set_state(_ctx->construct(ret._state_storage, this, nullptr, std::move(base), d, std::move(reqs)));
+    auto *state = _ctx->construct(ret._state_storage, this, nullptr, registered_buffer_type(base), d, reqs);
+    if(state == nullptr)
+    {
+      // This multiplexer's i/o state does not fit into an awaitable
+      return awaitable<io_result<buffers_type>>(read(std::move(base), std::move(reqs), d));
+    }
+    ret.set_state(state);
     return ret;
   }
 
@@ -422,7 +607,8 @@ public:
   has been set on this handle!
 
   The awaitable returned is **eager** i.e. it immediately begins the i/o. If the i/o completes
-  and finishes immediately, no coroutine suspension occurs.
+  and finishes immediately, no coroutine suspension occurs. The i/o state is stored within
+  the awaitable, and thus within the coroutine frame, so no dynamic memory allocation occurs.
   */
   LLFIO_MAKE_FREE_FUNCTION
   awaitable<io_result<const_buffers_type>> co_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept
@@ -432,7 +618,13 @@ public:
       return awaitable<io_result<const_buffers_type>>(write(std::move(reqs), d));
     }
     awaitable<io_result<const_buffers_type>> ret;
-    ret.set_state(_ctx->construct(ret._state_storage, this, nullptr, {}, d, std::move(reqs)));
+    auto *state = _ctx->construct(ret._state_storage, this, nullptr, {}, d, reqs);
+    if(state == nullptr)
+    {
+      // This multiplexer's i/o state does not fit into an awaitable
+      return awaitable<io_result<const_buffers_type>>(write(std::move(reqs), d));
+    }
+    ret.set_state(state);
     return ret;
   }
   //! \overload Registered buffer overload, gather list **must** be wholly within the registered buffer
@@ -444,7 +636,13 @@ public:
       return awaitable<io_result<const_buffers_type>>(write(std::move(base), std::move(reqs), d));
     }
     awaitable<io_result<const_buffers_type>> ret;
-    ret.set_state(_ctx->construct(ret._state_storage, this, nullptr, std::move(base), d, std::move(reqs)));
+    auto *state = _ctx->construct(ret._state_storage, this, nullptr, registered_buffer_type(base), d, reqs);
+    if(state == nullptr)
+    {
+      // This multiplexer's i/o state does not fit into an awaitable
+      return awaitable<io_result<const_buffers_type>>(write(std::move(base), std::move(reqs), d));
+    }
+    ret.set_state(state);
     return ret;
   }
 
@@ -453,7 +651,8 @@ public:
   has been set on this handle!
 
   The awaitable returned is **eager** i.e. it immediately begins the i/o. If the i/o completes
-  and finishes immediately, no coroutine suspension occurs.
+  and finishes immediately, no coroutine suspension occurs. The i/o state is stored within
+  the awaitable, and thus within the coroutine frame, so no dynamic memory allocation occurs.
   */
   LLFIO_MAKE_FREE_FUNCTION
   awaitable<io_result<const_buffers_type>> co_barrier(io_request<const_buffers_type> reqs = io_request<const_buffers_type>(), barrier_kind kind = barrier_kind::nowait_data_only, deadline d = deadline()) noexcept
@@ -463,7 +662,13 @@ public:
       return awaitable<io_result<const_buffers_type>>(barrier(std::move(reqs), kind, d));
     }
     awaitable<io_result<const_buffers_type>> ret;
-    ret.set_state(_ctx->construct(ret._state_storage, this, nullptr, {}, d, std::move(reqs), kind));
+    auto *state = _ctx->construct(ret._state_storage, this, nullptr, {}, d, reqs, kind);
+    if(state == nullptr)
+    {
+      // This multiplexer's i/o state does not fit into an awaitable
+      return awaitable<io_result<const_buffers_type>>(barrier(std::move(reqs), kind, d));
+    }
+    ret.set_state(state);
     return ret;
   }
 };
@@ -617,18 +822,21 @@ LLFIO_V2_NAMESPACE_END
 #endif
 
 #ifdef _WIN32
-#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
-#include "detail/impl/windows/test/iocp_multiplexer.ipp"
+#include "detail/impl/windows/iocp_multiplexer.ipp"
+#include "detail/impl/windows/ioring_multiplexer.ipp"
 #else
-#include "detail/impl/windows/io_handle.ipp"
+#include "detail/impl/posix/io_handle.ipp"
+#ifdef __linux__
+#include "detail/impl/posix/epoll_multiplexer.ipp"
+#include "detail/impl/posix/io_uring_multiplexer.ipp"
 #endif
-#else
-#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
-//#include "detail/impl/posix/test/io_uring_multiplexer.ipp"
-#else
+#if defined(__FreeBSD__) || defined(__APPLE__)
+#include "detail/impl/posix/kqueue_multiplexer.ipp"
 #endif
-#include "detail/impl/posix/io_handle.ipp"
 #endif
+#include "detail/impl/prioritised_multiplexer.ipp"
+#include "detail/impl/thread_affine_multiplexer.ipp"
+#include "detail/impl/thread_pool_multiplexer.ipp"
 #undef LLFIO_INCLUDED_BY_HEADER
 #endif
 
@@ -29,8 +29,11 @@ Distributed under the Boost Software License, Version 1.0.
 //#define LLFIO_ENABLE_TEST_IO_MULTIPLEXERS 1
 
 #include "handle.hpp"
+#include "io_statistics.hpp"
 
-#include <memory>  // for unique_ptr and shared_ptr
+#include <atomic>
+#include <climits>  // for INT_MIN
+#include <memory>   // for unique_ptr and shared_ptr
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -179,6 +182,64 @@ class LLFIO_DECL io_multiplexer : public handle
   {
   };
 
+  // The pool from which pooled i/o states are allocated, created on first use
+  struct _io_operation_state_pool;
+  struct _io_operation_state_pool_ptr
+  {
+    std::atomic<_io_operation_state_pool *> p{nullptr};
+
+    constexpr _io_operation_state_pool_ptr() {}  // NOLINT
+    _io_operation_state_pool_ptr(const _io_operation_state_pool_ptr &) = delete;
+    _io_operation_state_pool_ptr(_io_operation_state_pool_ptr &&o) noexcept
+        : p(o.p.exchange(nullptr, std::memory_order_acq_rel))
+    {
+    }
+    _io_operation_state_pool_ptr &operator=(const _io_operation_state_pool_ptr &) = delete;
+    _io_operation_state_pool_ptr &operator=(_io_operation_state_pool_ptr &&o) noexcept
+    {
+      if(this != &o)
+      {
+        reset();
+        p.store(o.p.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_release);
+      }
+      return *this;
+    }
+    ~_io_operation_state_pool_ptr() { reset(); }
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void reset() noexcept;
+  } _state_pool;
+
+#ifndef _WIN32
+  // The thread waiting for contended byte range locks initiated by initiate_posix_fs_syscalls(), created on first use
+  struct _posix_lock_waiter;
+  struct _posix_lock_waiter_ptr
+  {
+    std::atomic<_posix_lock_waiter *> p{nullptr};
+
+    constexpr _posix_lock_waiter_ptr() {}  // NOLINT
+    _posix_lock_waiter_ptr(const _posix_lock_waiter_ptr &) = delete;
+    _posix_lock_waiter_ptr(_posix_lock_waiter_ptr &&o) noexcept
+        : p(o.p.exchange(nullptr, std::memory_order_acq_rel))
+    {
+    }
+    _posix_lock_waiter_ptr &operator=(const _posix_lock_waiter_ptr &) = delete;
+    _posix_lock_waiter_ptr &operator=(_posix_lock_waiter_ptr &&o) noexcept
+    {
+      if(this != &o)
+      {
+        reset();
+        p.store(o.p.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_release);
+      }
+      return *this;
+    }
+    ~_posix_lock_waiter_ptr() { reset(); }
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void reset() noexcept;
+  } _lock_waiter;
+#endif
+
+#if LLFIO_ENABLE_IO_STATISTICS
+  io_statistics *_statistics{nullptr};
+#endif
+
 public:
   using path_type = handle::path_type;
   using extent_type = handle::extent_type;
@@ -199,6 +260,40 @@ public:
     wait_all     //!< Barrier data and the metadata to retrieve it, block until it is done.
   };
 
+  /*! \brief The priority class of i/o. Handles have a priority class, see `io_handle::set_priority()`,
+  which individual i/o requests may override using `io_request_flag::high_priority` and
+  `io_request_flag::low_priority`.
+  */
+  enum class io_priority : uint8_t
+  {
+    high,    //!< Latency critical i/o, e.g. reads serving a request.
+    normal,  //!< Ordinary i/o, the default.
+    low      //!< Background i/o, e.g. compaction, which ought to not delay other i/o.
+  };
+  //! The number of priority classes
+  static constexpr size_t io_priorities = 3;
+
+  /*! \brief The limits upon the i/o initiated by `multiplexer_prioritised()`.
+
+  When more i/o is initiated than the limits permit, it is queued per priority class, and
+  dispatched as i/o finishes by a weighted fair queue, so each class with queued i/o receives
+  a share of dispatches proportional to its weight.
+
+  The rate limits are token buckets, refilled at the rate and holding at most the burst. i/o
+  is dispatched whilst both buckets are not empty, each dispatch taking the bytes of its buffers
+  and one operation, so a single i/o larger than the burst is permitted but delays the next.
+  */
+  struct io_priority_limits
+  {
+    size_t max_inflight{0};  //!< The maximum i/o in flight in all classes, zero is unlimited.
+    size_t class_max_inflight[io_priorities]{0, 0, 0};  //!< The maximum i/o in flight per class, zero is unlimited.
+    unsigned weight[io_priorities]{16, 4, 1};  //!< The share of dispatches per class when contended.
+    uint64_t bytes_per_second{0};  //!< The bytes read and written per second, zero is unlimited.
+    uint64_t ops_per_second{0};  //!< The i/o dispatched per second, zero is unlimited.
+    uint64_t burst_bytes{0};  //!< The bytes which may be dispatched at once after idling, zero is a tenth of a second's worth.
+    uint64_t burst_ops{0};  //!< The i/o which may be dispatched at once after idling, zero is a tenth of a second's worth.
+  };
+
   //! The scatter buffer type used by this handle. Guaranteed to be `TrivialType` and `StandardLayoutType`.
   //! Try to make address and length 64 byte, or ideally, `page_size()` aligned where possible.
   struct buffer_type
@@ -377,17 +472,53 @@ public:
 #endif
 #endif
 
+  //! Bitwise flags which may be specified per i/o request
+  QUICKCPPLIB_BITFIELD_BEGIN(io_request_flag){
+  none = 0,  //!< No flags
+  /*! Fail with `errc::resource_unavailable_try_again` rather than block, for example if a read cannot be
+  satisfied from the kernel page cache. This lets cache hot reads complete inline, with only the misses
+  being handed to something which can block. Where the platform cannot do this, the i/o fails with
+  `errc::operation_not_supported`. Multiplexers which always first attempt i/o without blocking ignore
+  this flag.
+  */
+  nowait = 1U << 0U,
+  /*! Request high priority i/o, which on Linux also means polled completion if the device supports
+  it. This overrides the priority class of the handle with `io_priority::high`.
+  */
+  high_priority = 1U << 1U,
+  /*! The writes are to be durable before completion, as if followed by a `barrier_kind::wait_data_only`
+  barrier of the region written, but for the cost of one syscall instead of two where the platform
+  has support for this. Ignored for reads.
+  */
+  data_sync = 1U << 2U,
+  /*! Reads of non-seekable handles such as pipes keep reading whatever is immediately available
+  until the buffers are full, rather than returning after the first read which transferred anything.
+  This drains high volume pipes in one call. Ignored for seekable handles, for writes, by
+  multiplexers, and on Windows.
+  */
+  drain = 1U << 3U,
+  //! Request low priority i/o, overriding the priority class of the handle with `io_priority::low`.
+  low_priority = 1U << 4U
+  } QUICKCPPLIB_BITFIELD_END(io_request_flag);
+
   //! The i/o request type used by this handle. Guaranteed to be `TrivialType` apart from construction, and `StandardLayoutType`.
   template <class T> struct io_request
   {
     T buffers{};
     extent_type offset{0};
+    io_request_flag flags{io_request_flag::none};
     constexpr io_request() {}  // NOLINT (defaulting this breaks clang and GCC, so don't do it!)
     constexpr io_request(T _buffers, extent_type _offset)
         : buffers(std::move(_buffers))
         , offset(_offset)
     {
     }
+    constexpr io_request(T _buffers, extent_type _offset, io_request_flag _flags)
+        : buffers(std::move(_buffers))
+        , offset(_offset)
+        , flags(_flags)
+    {
+    }
   };
 #ifndef NDEBUG
   // Is trivial in all ways, except default constructibility
@@ -469,6 +600,29 @@ public:
   ~io_multiplexer() = default;
 
 public:
+  /*! \brief The statistics into which the i/o of handles using this multiplexer is recorded, if
+  any. Always null if `LLFIO_ENABLE_IO_STATISTICS` is off.
+  */
+  io_statistics *statistics() const noexcept
+  {
+#if LLFIO_ENABLE_IO_STATISTICS
+    return _statistics;
+#else
+    return nullptr;
+#endif
+  }
+  /*! \brief Sets the statistics into which the i/o of handles using this multiplexer is
+  recorded, which must outlive that i/o. Does nothing if `LLFIO_ENABLE_IO_STATISTICS` is off.
+  */
+  void set_statistics(io_statistics *s) noexcept
+  {
+#if LLFIO_ENABLE_IO_STATISTICS
+    _statistics = s;
+#else
+    (void) s;
+#endif
+  }
+
   //! Implements `io_handle` registration. The bottom two bits of the returned value are set into `_v.behaviour`'s `_multiplexer_state_bit0` and
   //! `_multiplexer_state_bit`
   virtual result<uint8_t> do_io_handle_register(io_handle * /*unused*/) noexcept { return (uint8_t) 0; }
@@ -1096,8 +1250,10 @@ protected:
 // Size of an awaitable
 #ifdef _WIN32
   static constexpr size_t _awaitable_size = 2048;  // IOCP implementation is unavoidably large
+#elif defined(__FreeBSD__)
+  static constexpr size_t _awaitable_size = 512;  // kqueue implementation embeds a struct aiocb
 #else
-  static constexpr size_t _awaitable_size = 128;
+  static constexpr size_t _awaitable_size = 256;  // io_uring implementation needs a bit more than the bare minimum
 #endif
   static io_result<buffers_type> _result_type_from_io_operation_state(io_operation_state *state, buffers_type * /*unused*/) noexcept
   {
@@ -1198,19 +1354,26 @@ public:
     }
 
 #if LLFIO_ENABLE_COROUTINES
-    //! Suspends the coroutine for resumption after the i/o finishes
-    void await_suspend(coroutine_handle<> coro)
+    /*! \brief Suspends the coroutine for resumption after the i/o finishes, unless it
+    finished since `await_ready()`, in which case the coroutine continues without suspension.
+
+    The coroutine is resumed directly by whichever thread finishes the i/o, which is usually
+    the thread running `io_multiplexer::check_for_any_completed_io()`, with no intermediate
+    executor. Returning `false` rather than resuming the coroutine from within here means
+    that back to back immediate completions cannot recurse and exhaust the stack.
+    */
+    bool await_suspend(coroutine_handle<> coro) noexcept
     {
-      _state->invoke(make_function_ptr<void *(io_operation_state_type)>([&](io_operation_state_type s) -> void * {
+      void *suspended = _state->invoke(make_function_ptr<void *(io_operation_state_type)>([&](io_operation_state_type s) -> void * {
         if(is_finished(s))
         {
-          coro.resume();
           return nullptr;
         }
         // std::cout << "Coroutine " << _state << " suspends" << std::endl;
         _coro = coro;
-        return nullptr;
+        return this;
       }));
+      return suspended != nullptr;
     }
 #endif
 
@@ -1297,6 +1460,64 @@ public:
   //! Returns the number of bytes, and alignment required, for an `io_operation_state` for this multiplexer
   virtual std::pair<size_t, size_t> io_state_requirements() noexcept = 0;
 
+private:
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<byte>> _allocate_pooled_io_operation_state() noexcept;
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void _deallocate_pooled_io_operation_state(byte *storage) noexcept;
+
+public:
+  //! \brief The deleter for `pooled_io_operation_state_ptr`, which destructs the state and returns its storage to the pool.
+  struct pooled_io_operation_state_deleter
+  {
+    io_multiplexer *parent{nullptr};
+    void operator()(io_operation_state *state) const noexcept
+    {
+      assert(is_finished(state->current_state()));
+      state->~io_operation_state();
+      parent->_deallocate_pooled_io_operation_state(reinterpret_cast<byte *>(state));
+    }
+  };
+  //! \brief A unique pointer to an i/o state allocated from the multiplexer's pool.
+  using pooled_io_operation_state_ptr = std::unique_ptr<io_operation_state, pooled_io_operation_state_deleter>;
+
+  /*! \brief Constructs a state for a read, write or barrier using storage allocated from this
+  multiplexer's pool of i/o states. The i/o is not initiated.
+
+  The pool allocates cache line aligned storage for states in slabs, and recycles freed storage
+  via a free list per kernel thread, so after warm up no dynamic memory allocation occurs.
+  The state must be finished before the returned pointer is reset, and the pointer must not
+  outlive this multiplexer.
+
+  \mallocs Occasionally, when the pool needs more slabs.
+  */
+  template <class... Args>
+  result<pooled_io_operation_state_ptr> construct_pooled(io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                                         Args &&... args) noexcept
+  {
+    OUTCOME_TRY(auto &&storage, _allocate_pooled_io_operation_state());
+    io_operation_state *state = construct(storage, _h, _visitor, std::move(b), d, std::forward<Args>(args)...);
+    if(state == nullptr)
+    {
+      _deallocate_pooled_io_operation_state(storage.data());
+      return errc::invalid_argument;
+    }
+    return pooled_io_operation_state_ptr(state, pooled_io_operation_state_deleter{this});
+  }
+  /*! \brief Combines `.construct_pooled()` with `.init_io_operation()` in a single call.
+   */
+  template <class... Args>
+  result<pooled_io_operation_state_ptr> construct_and_init_pooled(io_handle *_h, io_operation_state_visitor *_visitor, registered_buffer_type &&b, deadline d,
+                                                                  Args &&... args) noexcept
+  {
+    OUTCOME_TRY(auto &&storage, _allocate_pooled_io_operation_state());
+    io_operation_state *state = construct_and_init_io_operation(storage, _h, _visitor, std::move(b), d, std::forward<Args>(args)...);
+    if(state == nullptr)
+    {
+      _deallocate_pooled_io_operation_state(storage.data());
+      return errc::invalid_argument;
+    }
+    return pooled_io_operation_state_ptr(state, pooled_io_operation_state_deleter{this});
+  }
+
   /*! \brief Constructs either a `unsynchronised_io_operation_state` or a `synchronised_io_operation_state`
   for a read operation into the storage provided. The i/o is not initiated. The storage must
   meet the requirements from `state_requirements()`.
@@ -1355,6 +1576,101 @@ public:
     return state;
   }
 
+  //! \brief A request to initiate an i/o as part of a batch, see `construct_and_init_io_operations()`.
+  template <class BuffersType> struct batched_io_request
+  {
+    io_handle *h{nullptr};                         //!< The handle upon which to do the i/o
+    io_operation_state_visitor *visitor{nullptr};  //!< The visitor for the i/o, if any
+    registered_buffer_type base;                   //!< The registered buffer containing the buffers in `reqs`, if any
+    deadline d;                                    //!< The deadline for the i/o
+    io_request<BuffersType> reqs;                  //!< The i/o to do
+  };
+
+protected:
+  /* The stride between states constructed into `storage` for a batch of `count` i/o. Fails if `storage`
+  is too small, or there are fewer `states` than requests.
+  */
+  result<size_t> _batched_io_state_stride(span<byte> storage, size_t count, size_t states) noexcept
+  {
+    const auto reqs = io_state_requirements();
+    const size_t stride = (reqs.first + reqs.second - 1) & ~(reqs.second - 1);
+    if(states < count || storage.size() < stride * count || ((uintptr_t) storage.data() % reqs.second) != 0)
+    {
+      return errc::invalid_argument;
+    }
+    return stride;
+  }
+  template <class BuffersType>
+  result<span<io_operation_state *>> _construct_and_init_io_operations(span<byte> storage, span<batched_io_request<BuffersType>> reqs, span<io_operation_state *> states) noexcept
+  {
+    OUTCOME_TRY(auto &&stride, _batched_io_state_stride(storage, reqs.size(), states.size()));
+    for(size_t n = 0; n < reqs.size(); n++)
+    {
+      auto &req = reqs[n];
+      states[n] = construct_and_init_io_operation({storage.data() + n * stride, stride}, req.h, req.visitor, std::move(req.base), req.d, std::move(req.reqs));
+    }
+    OUTCOME_TRY(flush_inited_io_operations());
+    return states.subspan(0, reqs.size());
+  }
+  // Pumps check_for_any_completed_io() until all of ops are finished, or d expires
+  result<void> _wait_for_finished_io_operations(span<io_operation_state *> ops, deadline d) noexcept
+  {
+    if(!d)
+    {
+      return success();
+    }
+    LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+    for(;;)
+    {
+      size_t unfinished = 0;
+      for(auto *op : ops)
+      {
+        if(!is_finished(op->current_state()))
+        {
+          ++unfinished;
+        }
+      }
+      if(unfinished == 0)
+      {
+        return success();
+      }
+      deadline nd;
+      LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+      OUTCOME_TRY(check_for_any_completed_io(nd));
+      if(!([&]() -> result<void> {
+           LLFIO_DEADLINE_TO_TIMEOUT_LOOP(d);
+           return success();
+         })())
+      {
+        return success();
+      }
+    }
+  }
+
+public:
+  /*! \brief Constructs and initiates a batch of reads, then flushes them, in a single call.
+
+  `storage` must be aligned to, and be at least `reqs.size()` times, the size returned by `io_state_requirements()`
+  rounded up to its alignment, and the states are constructed contiguously at that stride. The states are
+  written into `states`, which must have at least `reqs.size()` elements, and the span of the states written
+  is returned. Each of the returned states must be destructed by the caller as usual.
+
+  Some i/o multiplexers can initiate a batch more efficiently than initiating each i/o individually,
+  for example io_uring fills the submission queue entries for the whole batch holding its lock once,
+  and submits them with a single syscall.
+  */
+  virtual result<span<io_operation_state *>> construct_and_init_io_operations(span<byte> storage, span<batched_io_request<buffers_type>> reqs,
+                                                                              span<io_operation_state *> states) noexcept
+  {
+    return _construct_and_init_io_operations(storage, reqs, states);
+  }
+  //! \brief Constructs and initiates a batch of writes, then flushes them, in a single call. See the overload for reads.
+  virtual result<span<io_operation_state *>> construct_and_init_io_operations(span<byte> storage, span<batched_io_request<const_buffers_type>> reqs,
+                                                                              span<io_operation_state *> states) noexcept
+  {
+    return _construct_and_init_io_operations(storage, reqs, states);
+  }
+
   //! Flushes any previously initiated i/o, if necessary for this i/o multiplexer
   virtual result<void> flush_inited_io_operations() noexcept { return success(); }
 
@@ -1364,6 +1680,36 @@ public:
   //! Cancel an initiated i/o, returning its current state if successful.
   virtual result<io_operation_state_type> cancel_io_operation(io_operation_state *op, deadline d = {}) noexcept = 0;
 
+  /*! \brief Cancel a batch of initiated i/o, requesting the cancellation of all of them before waiting
+  upon any. If `d` is set, returns once all of `ops` have finished, or `d` expires (this function never
+  fails with timed out).
+
+  The default implementation calls `cancel_io_operation()` without deadline for each of `ops`. Some
+  i/o multiplexers can do better, for example io_uring fills the cancellation sqes for the whole batch
+  holding its lock once, and submits them with a single syscall.
+  */
+  virtual result<void> cancel_io_operations(span<io_operation_state *> ops, deadline d = {}) noexcept
+  {
+    for(auto *op : ops)
+    {
+      OUTCOME_TRY(cancel_io_operation(op));
+    }
+    return _wait_for_finished_io_operations(ops, d);
+  }
+
+  /*! \brief Cancel all i/o currently initiated on handle `h`, returning once their cancellation has been
+  requested. The cancelled i/o completes with `errc::operation_canceled` in the usual way, and can
+  be waited upon using `check_for_any_completed_io()`.
+
+  This is implemented using `IORING_ASYNC_CANCEL_FD` on io_uring, and `CancelIoEx(h, nullptr)` on Windows,
+  so the states of the i/o are not needed. The default implementation fails with `errc::operation_not_supported`.
+  */
+  virtual result<void> cancel_io_operations(io_handle *h) noexcept
+  {
+    (void) h;
+    return errc::operation_not_supported;
+  }
+
   //! Statistics about the just returned `wait_for_completed_io()` operation
   struct check_for_any_completed_io_statistics
   {
@@ -1379,11 +1725,140 @@ public:
   virtual result<check_for_any_completed_io_statistics> check_for_any_completed_io(deadline d = std::chrono::seconds(0),
                                                                                    size_t max_completions = (size_t) -1) noexcept = 0;
 
+  /*! \brief Writes into `finished` those of `states` which are finished, returning the span written. If
+  none are finished, first checks for completed i/o using `check_for_any_completed_io()` with deadline `d`.
+  This is the batched counterpart to `construct_and_init_io_operations()`.
+
+  `finished` can be the same span as `states`, in which case the finished states are moved to the front.
+  */
+  result<span<io_operation_state *>> check_for_finished_io_operations(span<io_operation_state *> states, span<io_operation_state *> finished,
+                                                                      deadline d = std::chrono::seconds(0)) noexcept
+  {
+    auto gather = [&]() -> size_t {
+      size_t count = 0;
+      for(size_t n = 0; n < states.size() && count < finished.size(); n++)
+      {
+        if(is_finished(states[n]->current_state()))
+        {
+          if(finished.data() == states.data())
+          {
+            std::swap(finished[count++], states[n]);
+          }
+          else
+          {
+            finished[count++] = states[n];
+          }
+        }
+      }
+      return count;
+    };
+    size_t count = gather();
+    if(count == 0)
+    {
+      OUTCOME_TRY(check_for_any_completed_io(d, finished.size()));
+      count = gather();
+    }
+    return finished.subspan(0, count);
+  }
+
   /*! \brief Can be called from any thread to wake any other single thread
   currently blocked within `check_for_any_completed_io()`. Which thread is
   woken is not specified.
   */
   virtual result<void> wake_check_for_any_completed_io() noexcept = 0;
+
+#if !defined(_WIN32) || DOXYGEN_IS_IN_THE_HOUSE
+  /*! \brief A POSIX filing system syscall to execute as part of a batch, see `do_posix_fs_syscalls()`.
+  Everything pointed to must remain valid until the batch has completed.
+  */
+  struct posix_fs_syscall
+  {
+    enum class kind : uint8_t
+    {
+      openat,  //!< `openat(fd, path, flags, mode)`, with `result` being the fd opened
+      statx,   //!< `statx(fd, path, flags, mode, buffer)` where `mode` is the mask of fields wanted (Linux only)
+      close,    //!< `close(fd)`
+      madvise,   //!< `madvise(buffer, bytes, flags)`
+      unlinkat,  //!< `unlinkat(fd, path, flags)`
+      lock_range,  //!< `fcntl(fd, F_OFD_SETLKW)` locking `bytes` from `offset`, exclusively if `flags` is non-zero
+      splice,      //!< `splice(fd, offset, fd_out, offset_out, bytes, flags)`, with `result` being the bytes moved (Linux only)
+      tee,         //!< `tee(fd, fd_out, bytes, flags)`, with `result` being the bytes duplicated (Linux only)
+      wait_process,  //!< Waits for the child process whose pid is `offset` to exit without reaping it, with `fd` a pidfd for it on Linux or -1. See `process_handle::initiate_wait()`.
+      symlinkat,     //!< `symlinkat(buffer, fd, path)`, creating at `path` a symbolic link to the zero terminated target `buffer`
+      syncfs,        //!< `syncfs(fd)`, writing all modified data of the filing system containing `fd` to storage. Elsewhere than Linux, `fsync(fd)` then `sync()`.
+      renameat,      //!< `renameat2(fd, path, fd_out, buffer, flags)`, renaming `path` to the zero terminated `buffer`. `flags` may be `RENAME_NOREPLACE` (1) or `RENAME_EXCHANGE` (2), which Mac OS implements with `renameatx_np()`, and other POSIX only for a `RENAME_NOREPLACE` of anything but a directory, using `linkat()` then `unlinkat()`.
+      pwrite         //!< `pwrite(fd, buffer, bytes, offset)`, with `result` being the bytes written
+    } op{kind::close};
+    int fd{-1};                //!< The directory fd for `openat`, `statx`, `unlinkat`, `symlinkat` and the source of `renameat` (which may be `AT_FDCWD`), the fd to close for `close`, the fd to write for `pwrite`, the input fd for `splice` and `tee`, any fd on the filing system for `syncfs`
+    const char *path{nullptr};  //!< The zero terminated path for `openat`, `statx`, `unlinkat` and `symlinkat`, the source path for `renameat`
+    int flags{0};              //!< The flags for `openat`, `statx`, `unlinkat`, `splice`, `tee` and `renameat`, the advice for `madvise`
+    unsigned mode{0};          //!< The creation mode for `openat`, the mask for `statx`
+    void *buffer{nullptr};     //!< The `struct statx` to fill for `statx`, the memory to advise for `madvise`, the zero terminated target for `symlinkat`, the zero terminated destination path for `renameat`, the bytes to write for `pwrite`
+    size_t bytes{0};           //!< The length of the memory to advise for `madvise`, the number of bytes to lock for `lock_range`, at most `INT_MAX` bytes to move for `splice` and `tee` or to write for `pwrite`
+    uint64_t offset{0};        //!< The offset to lock for `lock_range`, the input offset for `splice` or `no_offset`, the offset to write at for `pwrite`
+    int fd_out{-1};            //!< The output fd for `splice` and `tee`, the destination directory fd for `renameat` (which may be `AT_FDCWD`)
+    uint64_t offset_out{0};    //!< The output offset for `splice` or `no_offset`
+    int result{0};             //!< Set to the result of the syscall, which is the negated `errno` if it failed
+
+    //! The value of `result` whilst the syscall has not yet completed
+    static constexpr int pending = INT_MIN;
+    //! The `offset` and `offset_out` for `splice` of a pipe, which has no offset
+    static constexpr uint64_t no_offset = (uint64_t) -1;
+  };
+
+  /*! \brief Executes a batch of POSIX filing system syscalls, returning when all of them have completed.
+
+  The syscalls execute concurrently in no particular order, so ones depending on one another must be
+  in separate batches. The result of each syscall is written into its `result`. The default implementation
+  executes them serially, the Linux io_uring multiplexer submits them all at once using `IORING_OP_OPENAT`,
+  `IORING_OP_STATX`, `IORING_OP_CLOSE`, `IORING_OP_WRITE`, `IORING_OP_UNLINKAT`, `IORING_OP_RENAMEAT`, `IORING_OP_SPLICE` and `IORING_OP_TEE` so they are
+  executed at high queue depth. Other i/o on this
+  multiplexer may be completed whilst waiting.
+
+  \errors Only failures of the multiplexer itself, failures of individual syscalls are in their `result`.
+  */
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> do_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept;
+
+  /*! \brief Begins executing a batch of POSIX filing system syscalls, returning without waiting for them to complete.
+
+  The `result` of each syscall is `posix_fs_syscall::pending` until it completes. The results of
+  syscalls executed by the kernel are written by `check_for_any_completed_io()`, so inspect them
+  from the thread calling it, which will return when any completes. The default implementation
+  executes them serially before returning, as does the Linux io_uring multiplexer for those its
+  kernel cannot execute.
+
+  No kernel can wait for a byte range lock asynchronously, so a `lock_range` which cannot be
+  granted immediately is handed to a thread owned by this multiplexer, created on first use, which
+  retries all the locks it has been given with exponential backoff up to `lock_range_poll_interval`.
+  When it grants some it writes their `result` and calls `wake_check_for_any_completed_io()`. One
+  thread thus waits on any number of contended locks, instead of a thread per lock. Locks still
+  pending when the multiplexer is closed complete with `-ECANCELED`.
+
+  A `wait_process` of a process which has not yet exited is submitted as an `IORING_OP_POLL_ADD` of
+  its pidfd by the Linux io_uring multiplexer, and as an `EVFILT_PROC` event by the BSD kqueue
+  multiplexer, so any number of child processes can be waited upon by the kernel. Otherwise it is
+  handed to the same thread as contended locks, which checks it with `waitid(WNOHANG)` on each retry.
+
+  No kernel can sync a whole filing system asynchronously either, so a `syncfs` is always handed to
+  the same thread, which executes it without blocking the addition of further work. Retries of
+  contended locks and checks of processes pause until it completes.
+
+  \errors Only failures of the multiplexer itself, failures of individual syscalls are in their `result`.
+  */
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> initiate_posix_fs_syscalls(span<posix_fs_syscall> ops) noexcept;
+
+  //! The longest the thread waiting for contended `lock_range` syscalls sleeps between retries
+  static constexpr std::chrono::milliseconds lock_range_poll_interval{1};
+
+protected:
+  /*! Cancels any `lock_range` syscalls still waiting, and joins the thread waiting for them.
+  Implementations must call this at the start of `close()`, as that thread calls
+  `wake_check_for_any_completed_io()`.
+  */
+  void _stop_posix_lock_waiter() noexcept { _lock_waiter.reset(); }
+
+public:
+#endif
 };
 //! A unique ptr to an i/o multiplexer implementation.
 using io_multiplexer_ptr = std::unique_ptr<io_multiplexer>;
@@ -1393,6 +1868,247 @@ static_assert(OUTCOME_V2_NAMESPACE::concepts::basic_result<io_multiplexer::io_re
               "io_multiplexer::io_result<int> does not match the Outcome basic_result concept!");
 #endif
 
+#if defined(__linux__) || DOXYGEN_IS_IN_THE_HOUSE
+/*! \brief Return an i/o multiplexer implemented using Linux io_uring.
+
+\param threads The number of kernel threads which will use the multiplexer. If one, a
+non-locking implementation is returned which must only ever be used from one kernel thread.
+\param is_polling If true, a kernel thread polls the submission ring and i/o initiation
+never needs a syscall. This reduces latency at the cost of a CPU core spinning whilst
+i/o is being initiated (the kernel thread goes to sleep after 100 milliseconds of idle).
+
+Two io_uring instances are created, one for seekable handles and the other for non-seekable
+handles. i/o upon seekable handles retains POSIX read/write concurrency guarantees, i/o upon
+non-seekable handles is submitted in the order initiated per handle, with one read and one
+write in flight at a time.
+
+Each ring has 256 submission entries, unless `utils::tuning().io_queue_depth` says otherwise.
+
+Regular files opened with `caching::none` or `caching::only_metadata` (i.e. `O_DIRECT`)
+have their reads and writes submitted to a third io_uring instance created with
+`IORING_SETUP_IOPOLL`, whose completions are reaped by polling the device rather than
+by interrupt. This substantially reduces latency on fast storage, at the cost of
+`check_for_any_completed_io()` spinning whilst such i/o is in flight.
+
+Writes to adjacent offsets of the same seekable handle initiated before the kernel is told
+about them (e.g. before `flush_inited_io_operations()`) are coalesced into a single gather
+write of up to `IOV_MAX` buffers and 256Kb, with each write completing individually.
+
+Handles flagged `flag::multiplexable` get this multiplexer by default if it is set as the
+calling thread's multiplexer using `this_thread::set_multiplexer()`, as `io_handle::set_multiplexer()`
+defaults to `this_thread::multiplexer()`.
+
+All kernels from Linux 5.1 onwards are supported, newer kernels are used more efficiently.
+
+\errors Any of the values returned by `io_uring_setup()` and `mmap()`. On kernels without
+io_uring, or where it has been disabled, this will be `errc::function_not_supported`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads = 1, bool is_polling = false) noexcept;
+
+//! \brief Configuration of the kernel submission polling thread for `multiplexer_linux_io_uring()`.
+struct linux_io_uring_sqpoll_config
+{
+  /*! The CPU to pin the kernel submission polling thread to, or -1 for no explicit pinning. If -1 and
+  the multiplexer is for a single thread which is pinned to a single CPU, the kernel thread is pinned
+  to that CPU.
+  */
+  int cpu{-1};
+  //! How long the kernel submission polling thread spins without work before going to sleep.
+  std::chrono::milliseconds idle{100};
+  /*! If true, the io_uring instance for seekable handles is attached to the io_uring instance for
+  non-seekable handles using `IORING_SETUP_ATTACH_WQ`, so both share the same kernel threads. On kernels
+  before Linux 5.11, only the async work queue is shared, not the submission polling thread.
+  */
+  bool share_between_rings{true};
+};
+/*! \brief Return an i/o multiplexer implemented using Linux io_uring, with a kernel thread polling
+the submission ring configured as per `sqpoll`. See the other overload for more detail.
+
+This lets i/o initiation never need a syscall whilst the kernel polling thread is awake, with the
+kernel polling threads run on dedicated CPUs.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, const linux_io_uring_sqpoll_config &sqpoll) noexcept;
+
+//! \brief Statistics about an i/o multiplexer returned by `multiplexer_linux_io_uring()`.
+struct linux_io_uring_statistics
+{
+  uint64_t flushes_without_syscall{0};  //!< The number of flushes of initiated i/o which did not need a syscall
+  uint64_t flushes_with_syscall{0};     //!< The number of flushes of initiated i/o which needed a syscall to submit the i/o
+  uint64_t sqpoll_wakeups{0};           //!< The number of flushes which needed to wake a sleeping kernel submission polling thread
+  uint64_t linked_barriers{0};          //!< The number of barriers linked after the write preceding them, and so submitted together with it
+  uint64_t coalesced_writes{0};         //!< The number of writes coalesced into the write to the adjacent preceding offset
+};
+/*! \brief Return statistics about an i/o multiplexer returned by `multiplexer_linux_io_uring()`.
+
+\errors `errc::invalid_argument` if the multiplexer was not returned by `multiplexer_linux_io_uring()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<linux_io_uring_statistics> multiplexer_linux_io_uring_statistics(const io_multiplexer *multiplexer) noexcept;
+
+/*! \brief Return an i/o multiplexer implemented using Linux epoll.
+
+\param threads The number of kernel threads which will use the multiplexer. If one, a
+non-locking implementation is returned which must only ever be used from one kernel thread.
+
+This is a reactor, not a proactor: i/o is performed using nonblocking syscalls by
+the thread initiating it, or by whichever thread calls `check_for_any_completed_io()`
+after the handle becomes ready. It is intended for pipes and sockets on kernels where
+io_uring is unavailable or disabled by policy. i/o upon handles which epoll cannot
+monitor, such as regular files, is performed synchronously upon initiation.
+
+i/o is completed in the order initiated per handle and direction. Per-i/o deadlines
+are supported.
+
+\errors Any of the values returned by `epoll_create1()` and `eventfd()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_epoll(size_t threads = 1) noexcept;
+#endif
+#if(defined(__FreeBSD__) || defined(__APPLE__)) || DOXYGEN_IS_IN_THE_HOUSE
+/*! \brief Return an i/o multiplexer implemented using BSD kqueue.
+
+\param threads The number of threads which will be using this multiplexer
+concurrently. If `1`, all locking is disabled.
+
+i/o upon pipes and sockets is performed using nonblocking syscalls when kqueue
+reports the handle as ready (`EVFILT_READ` and `EVFILT_WRITE`). On FreeBSD,
+i/o upon seekable handles is submitted using POSIX AIO with completion reported
+via `EVFILT_AIO`, falling back to synchronous i/o if AIO refuses the i/o. On Mac OS,
+whose POSIX AIO cannot report completion to a kqueue, i/o upon seekable handles
+is performed synchronously upon initiation.
+
+i/o is completed in the order initiated per handle and direction, except for
+i/o submitted to AIO which may complete in any order. Per-i/o deadlines are supported.
+
+\errors Any of the values returned by `kqueue()` and `kevent()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_bsd_kqueue(size_t threads = 1) noexcept;
+#endif
+
+#if defined(_WIN32) || DOXYGEN_IS_IN_THE_HOUSE
+/*! \brief Return an i/o multiplexer implemented using Microsoft Windows IOCP.
+
+\param threads The number of kernel threads which will use the multiplexer, which is also the
+concurrency of the completion port. If one, a non-locking implementation is returned which must
+only ever be used from one kernel thread.
+\param disable_immediate_completions If false, handles are registered with
+`FILE_SKIP_COMPLETION_PORT_ON_SUCCESS`, so i/o which completes immediately upon initiation is
+finished without a round trip through the completion port.
+
+Completions are dequeued in batches of up to 64 using `NtRemoveIoCompletionEx()`, the syscall
+behind `GetQueuedCompletionStatusEx()`, or singly using the cheaper `NtRemoveIoCompletion()` if
+only one completion is wanted. IOCP wakes the most recently waiting thread first, which keeps
+completions on threads whose caches are warm. For completions to stay with the thread which
+initiated the i/o, use `multiplexer_thread_pool()`, which gives each of its threads its own
+completion port. Barriers are executed synchronously upon initiation. Per-i/o deadlines are not
+implemented, use `cancel_io_operation()` instead.
+
+\errors Any of the values returned by `CreateIoCompletionPort()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_win_iocp(size_t threads = 1, bool disable_immediate_completions = false) noexcept;
+
+/*! \brief Return an i/o multiplexer implemented using Microsoft Windows IoRing.
+
+\param threads The number of kernel threads which will use the multiplexer. If one, a
+non-locking implementation is returned which must only ever be used from one kernel thread.
+
+IoRing is the Windows 11 analogue of Linux io_uring, where i/o is built into a submission
+queue by `init_io_operation()` and submitted to the kernel in a single syscall by
+`flush_inited_io_operations()`, with completions then reaped from a completion queue shared
+with the kernel. Buffers returned by `allocate_registered_buffer()` are registered with the
+ring, so i/o into them avoids the kernel probing and locking their pages on each transfer.
+Up to 1024 buffers are registered, after which buffers are returned unregistered.
+
+Only files can be registered with this multiplexer. Before Windows 11 22H2, IoRing could only
+read, so writes and barriers are executed synchronously upon initiation. Per-i/o deadlines are
+not implemented, use `cancel_io_operation()` instead.
+
+\errors `errc::function_not_supported` if IoRing is not available, or any of the values returned
+by `CreateIoRing()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_win_ioring(size_t threads = 1) noexcept;
+#endif
+
+/*! \brief Return an i/o multiplexer which reaps completions using a pool of kernel threads.
+
+\param threads The number of kernel threads in the pool. If zero, one per CPU.
+\param make_shard A factory for the i/o multiplexer used by each pool thread, which must
+return a thread safe multiplexer given a thread count. If null, the best multiplexer for
+this platform is used.
+\param pin_threads If true, each pool thread is pinned to its own CPU where supported.
+
+Each thread in the pool owns its own i/o multiplexer, called a shard, with its own kernel
+resources, so no lock is shared between the threads. Handles are assigned to a shard when
+registered. If a pool thread finds its shard has more completions than it can process
+in a batch, an idle pool thread steals completions from that shard.
+
+Completions are always reaped by the pool, so i/o visitors and coroutines are resumed from
+within the pool threads. `check_for_any_completed_io()` called from outside the pool waits
+until the pool has finished any i/o since the calling thread last initiated or waited for i/o.
+
+\errors Any of the values returned by `make_shard`, or by `std::thread`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_thread_pool(size_t threads = 0, result<io_multiplexer_ptr> (*make_shard)(size_t threads) = nullptr,
+                                                                                bool pin_threads = true) noexcept;
+
+/*! \brief Return an i/o multiplexer which schedules the i/o of `inner` by priority class.
+
+\param inner The i/o multiplexer which executes the i/o, which is owned by the returned multiplexer.
+\param limits The limits upon i/o in flight in `inner`.
+
+The priority class of each i/o is that of its request flags if any, else that of its handle,
+see `io_handle::effective_priority()`. Initiated i/o is passed to `inner` if within `limits`,
+otherwise it stays initialised until i/o in flight finishes, whereupon queued i/o is dispatched
+by a weighted fair queue across the classes. This bounds the queue depth which background
+i/o can occupy in the device and kernel, so it cannot inflate the tail latencies of foreground i/o.
+
+If `limits` sets rates, queued i/o is also held until the token buckets permit. No thread is
+ever put to sleep for this: `check_for_any_completed_io()` waits on `inner` no longer than until
+tokens are next available. Queued i/o whose deadline passes completes with `errc::timed_out`.
+The handles using one instance form a group sharing its limits, so several instances wrapping
+one `inner` throttle several groups independently, e.g. giving backups a set share of a device.
+
+Each i/o operation state has its visitor replaced whilst in flight, which costs a lookup per
+visitor invocation. Kernel i/o priorities are set by `inner` where it can: `ioprio` by the
+io_uring multiplexer, and the per-handle i/o priority hint on Windows by `io_handle::set_priority()`.
+
+\errors Any of the values returned by `inner` or by `std::make_unique()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_prioritised(io_multiplexer_ptr inner, const io_multiplexer::io_priority_limits &limits = {}) noexcept;
+/*! \brief Return an i/o multiplexer limiting the bytes and i/o per second of the handles using
+it, executing the i/o using `inner`.
+
+This is `multiplexer_prioritised()` with rate limits only.
+*/
+inline result<io_multiplexer_ptr> multiplexer_rate_limited(io_multiplexer_ptr inner, uint64_t bytes_per_second, uint64_t ops_per_second = 0) noexcept
+{
+  io_multiplexer::io_priority_limits limits;
+  limits.bytes_per_second = bytes_per_second;
+  limits.ops_per_second = ops_per_second;
+  return multiplexer_prioritised(std::move(inner), limits);
+}
+
+/*! \brief Return an i/o multiplexer which hands the completion of i/o back to the thread
+which initiated it, executing the i/o using `inner`.
+
+\param inner The thread safe i/o multiplexer which executes the i/o, which is owned by the
+returned multiplexer.
+
+Each thread initiating i/o gets a queue. i/o with a visitor which is reaped by a thread
+other than its initiator has its completion pushed onto its initiator's queue without a
+lock, and its visitor's `*_completed()` and `*_finished()` are invoked by the initiator upon
+its next call into the multiplexer. Request state thus stays in the caches of the core running
+its thread, for shared-nothing designs where each thread owns its i/o. The initiator is woken
+using `inner`'s `wake_check_for_any_completed_io()` if it is waiting, which may wake another
+waiter instead where `inner` cannot wake a particular thread.
+
+Until its visitor has been invoked, i/o completed elsewhere already appears finished to
+`current_state()`, so its state must not be destroyed unless its visitor says so, or
+`check_io_operation()` upon the initiating thread says so. i/o without a visitor is passed
+through untouched. Threads are recorded rather than CPUs, as threads can migrate between CPUs.
+
+\errors Any of the values returned by `std::make_unique()`.
+*/
+LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_thread_affine(io_multiplexer_ptr inner) noexcept;
+
 #if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
 //! Namespace containing functions useful for test code
 namespace test
@@ -1404,21 +2120,45 @@ namespace test
   */
   LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_null(size_t threads, bool disable_immediate_completions) noexcept;
 
-#if defined(__linux__) || DOXYGEN_IS_IN_THE_HOUSE
-// LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_epoll(size_t threads) noexcept;
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_linux_io_uring(size_t threads, bool is_polling) noexcept;
-#endif
-#if(defined(__FreeBSD__) || defined(__APPLE__)) || DOXYGEN_IS_IN_THE_HOUSE
-// LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_bsd_kqueue(size_t threads) noexcept;
-#endif
-#if defined(_WIN32) || DOXYGEN_IS_IN_THE_HOUSE
-  /*! \brief Return a test i/o multiplexer implemented using Microsoft Windows IOCP.
+  /*! \brief The simulated storage device of a null i/o multiplexer.
+
+  No i/o is actually performed, but each i/o completes only once the simulated device would
+  have completed it. Up to `queue_depth` i/o are in service at once, with further i/o queued
+  in order of initiation. An i/o in service first transfers its bytes at `bytes_per_second`,
+  the transfers of all i/o in service sharing that bandwidth in order of service, and then
+  waits its latency, drawn from the distribution for its kind of operation.
 
-  The multiplexer returned by this function is only a partial implementation, used
-  only by the test suite. In particular it does not fully implement deadlined i/o.
+  Latencies are drawn from a pseudo random sequence seeded by `seed`, in order of i/o
+  service, so the same sequence of i/o sees the same latencies on every machine.
   */
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_win_iocp(size_t threads, bool disable_immediate_completions) noexcept;
-#endif
+  struct null_device
+  {
+    //! The kinds of latency distribution
+    enum class distribution
+    {
+      fixed,       //!< Always `mean`
+      uniform,     //!< Uniformly between `mean - spread` and `mean + spread`
+      exponential  //!< `spread` plus an exponentially distributed latency with mean `mean`
+    };
+    //! A latency distribution
+    struct latency_distribution
+    {
+      distribution kind{distribution::fixed};
+      std::chrono::nanoseconds mean{0};
+      std::chrono::nanoseconds spread{0};
+    };
+    latency_distribution read;     //!< The latency of reads
+    latency_distribution write;    //!< The latency of writes
+    latency_distribution barrier;  //!< The latency of barriers
+    size_t queue_depth{0};         //!< The maximum i/o in service at once, zero is unlimited
+    uint64_t bytes_per_second{0};  //!< The bandwidth of transfers, zero is unlimited
+    uint64_t seed{0x9e3779b97f4a7c15};  //!< The seed of the latency sequence
+  };
+
+  /*! \brief Return a test null i/o multiplexer simulating storage device `device`, for
+  benchmarking and tuning of i/o pipelines reproducibly without real storage.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<io_multiplexer_ptr> multiplexer_null(size_t threads, bool disable_immediate_completions, const null_device &device) noexcept;
 }  // namespace test
 #endif
 
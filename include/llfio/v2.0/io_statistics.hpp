@@ -0,0 +1,233 @@
+/* Counters and latency histograms of i/o
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_IO_STATISTICS_H
+#define LLFIO_IO_STATISTICS_H
+
+#include "config.hpp"
+
+#include <atomic>
+#include <chrono>
+
+//! \file io_statistics.hpp Provides `io_statistics`
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4251)  // dll interface
+#endif
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+/*! \class io_statistics
+\brief Lock free counters and latency histograms of the reads, writes and barriers done by
+`io_handle`.
+
+If `LLFIO_ENABLE_IO_STATISTICS` is on, every `read()`, `write()` and `barrier()` of every
+`io_handle` is timed, and recorded into the calling thread's statistics, into the
+statistics set on the handle with `io_handle::set_statistics()`, and into the statistics set on
+the handle's multiplexer with `io_multiplexer::set_statistics()`. Recording is a handful of
+relaxed atomic increments, so statistics can be shared by many handles and threads.
+Overrides of `barrier()` are not instrumented.
+
+Latencies are recorded into a histogram of `latency_buckets` power of two buckets, bucket
+`n` counting latencies of at least `2^n` and less than `2^(n+1)` nanoseconds. A short transfer is
+a read or write which transferred fewer bytes than requested without failing.
+
+If `LLFIO_ENABLE_IO_STATISTICS` is off, nothing is recorded and there is no overhead.
+*/
+class LLFIO_DECL io_statistics
+{
+public:
+  //! The kinds of operation recorded
+  enum class operation
+  {
+    read,
+    write,
+    barrier
+  };
+  //! The number of latency histogram buckets, the last also counting all longer latencies
+  static constexpr size_t latency_buckets = 48;
+
+  //! A copy of the counters of one kind of operation
+  struct counters
+  {
+    uint64_t ops{0};              //!< The operations done
+    uint64_t bytes{0};            //!< The bytes transferred
+    uint64_t short_transfers{0};  //!< The operations transferring fewer bytes than requested
+    uint64_t errors{0};           //!< The operations which failed
+    uint64_t latency[latency_buckets]{};  //!< The latency histogram
+
+    counters &operator+=(const counters &o) noexcept
+    {
+      ops += o.ops;
+      bytes += o.bytes;
+      short_transfers += o.short_transfers;
+      errors += o.errors;
+      for(size_t n = 0; n < latency_buckets; n++)
+      {
+        latency[n] += o.latency[n];
+      }
+      return *this;
+    }
+    //! \brief Returns an upper bound of the latency below which fraction `p` of the operations completed.
+    std::chrono::nanoseconds latency_percentile(double p) const noexcept
+    {
+      uint64_t total = 0;
+      for(size_t n = 0; n < latency_buckets; n++)
+      {
+        total += latency[n];
+      }
+      const auto target = (uint64_t)(p * (double) total);
+      uint64_t seen = 0;
+      for(size_t n = 0; n < latency_buckets; n++)
+      {
+        seen += latency[n];
+        if(seen > target || seen == total)
+        {
+          return std::chrono::nanoseconds((1LL << (n + 1)) - 1);
+        }
+      }
+      return std::chrono::nanoseconds(0);
+    }
+  };
+  //! A copy of the counters of all kinds of operation
+  struct snapshot
+  {
+    counters read, write, barrier;
+
+    snapshot &operator+=(const snapshot &o) noexcept
+    {
+      read += o.read;
+      write += o.write;
+      barrier += o.barrier;
+      return *this;
+    }
+    const counters &operator[](operation op) const noexcept { return (op == operation::read) ? read : (op == operation::write) ? write : barrier; }
+  };
+
+private:
+  struct _counters
+  {
+    std::atomic<uint64_t> ops, bytes, short_transfers, errors, latency[latency_buckets];
+  } _c[3];
+
+  static size_t _bucket(uint64_t ns) noexcept
+  {
+    size_t n = 0;
+    while(ns > 1 && n < latency_buckets - 1)
+    {
+      ns >>= 1;
+      n++;
+    }
+    return n;
+  }
+
+public:
+  //! Constructs zeroed statistics
+  io_statistics() noexcept { reset(); }
+  io_statistics(const io_statistics &) = delete;
+  io_statistics(io_statistics &&) = delete;
+  io_statistics &operator=(const io_statistics &) = delete;
+  io_statistics &operator=(io_statistics &&) = delete;
+  ~io_statistics() = default;
+
+  //! \brief Records an operation which requested `requested` bytes and transferred `transferred` bytes.
+  void record(operation op, size_t requested, size_t transferred, bool failed, std::chrono::nanoseconds latency) noexcept
+  {
+    auto &c = _c[(size_t) op];
+    c.ops.fetch_add(1, std::memory_order_relaxed);
+    if(failed)
+    {
+      c.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      c.bytes.fetch_add(transferred, std::memory_order_relaxed);
+      if(op != operation::barrier && transferred < requested)
+      {
+        c.short_transfers.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    c.latency[_bucket((latency.count() > 0) ? (uint64_t) latency.count() : 0)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //! \brief Returns a copy of the counters. Counters being concurrently updated may be slightly inconsistent with one another.
+  snapshot value() const noexcept
+  {
+    snapshot ret;
+    counters *out[3] = {&ret.read, &ret.write, &ret.barrier};
+    for(size_t i = 0; i < 3; i++)
+    {
+      out[i]->ops = _c[i].ops.load(std::memory_order_relaxed);
+      out[i]->bytes = _c[i].bytes.load(std::memory_order_relaxed);
+      out[i]->short_transfers = _c[i].short_transfers.load(std::memory_order_relaxed);
+      out[i]->errors = _c[i].errors.load(std::memory_order_relaxed);
+      for(size_t n = 0; n < latency_buckets; n++)
+      {
+        out[i]->latency[n] = _c[i].latency[n].load(std::memory_order_relaxed);
+      }
+    }
+    return ret;
+  }
+
+  //! \brief Zeroes the counters.
+  void reset() noexcept
+  {
+    for(auto &c : _c)
+    {
+      c.ops.store(0, std::memory_order_relaxed);
+      c.bytes.store(0, std::memory_order_relaxed);
+      c.short_transfers.store(0, std::memory_order_relaxed);
+      c.errors.store(0, std::memory_order_relaxed);
+      for(auto &l : c.latency)
+      {
+        l.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  //! \brief Returns the calling thread's statistics, into which all i/o by the calling thread is recorded.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC io_statistics &this_thread() noexcept;
+  /*! \brief Returns the sum of the statistics of all threads, including those which have exited.
+  \mallocs None, but takes a lock also taken when threads first record i/o and when they exit.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC snapshot all_threads() noexcept;
+};
+
+// BEGIN make_free_functions.py
+// END make_free_functions.py
+
+LLFIO_V2_NAMESPACE_END
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "detail/impl/io_statistics.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
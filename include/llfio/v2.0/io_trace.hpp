@@ -0,0 +1,148 @@
+/* Binary tracing of i/o
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_IO_TRACE_H
+#define LLFIO_IO_TRACE_H
+
+#include "config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+//! \file io_trace.hpp Provides `io_trace`
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4251)  // dll interface
+#endif
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+/*! \class io_trace
+\brief Binary trace points of i/o, recorded into per thread lock free ring buffers, and
+writable as a Chrome trace which Perfetto and `chrome://tracing` can display.
+
+If `LLFIO_ENABLE_IO_TRACING` is on, every `read()`, `write()` and `barrier()` of every
+`io_handle` records an `event` of the handle, operation, offset, length, bytes transferred,
+and the ticks at which it began and ended. Each thread records into its own ring buffer of
+`LLFIO_IO_TRACE_EVENTS` events, overwriting its oldest events when full, so recording an event
+is two reads of the tick counter and a few plain stores. Ring buffers of exited threads are
+retained until reused by new threads.
+
+Ticks are the CPU timestamp counter on x64 and AArch64, and `std::chrono::steady_clock`
+nanoseconds elsewhere. They are converted to time when written out, using a calibration taken
+over the lifetime of the process.
+
+Events being recorded while `events()` or `write_chrome_trace()` is copying them may be
+torn, which is considered acceptable for a diagnostic facility.
+
+If `LLFIO_ENABLE_IO_TRACING` is off, nothing is recorded and there is no overhead, but
+events may still be recorded manually with `record()`.
+*/
+class LLFIO_DECL io_trace
+{
+public:
+  //! The kinds of operation traced
+  enum class operation : uint16_t
+  {
+    read,
+    write,
+    barrier
+  };
+  //! One traced operation
+  struct event
+  {
+    uint64_t handle;       //!< The address of the handle
+    int64_t native;        //!< The native handle value, or -1 if none
+    uint64_t offset;       //!< The offset of the request
+    uint64_t length;       //!< The bytes requested
+    uint64_t transferred;  //!< The bytes transferred
+    uint64_t begin;        //!< The ticks when the operation began
+    uint64_t end;          //!< The ticks when the operation ended
+    uint32_t thread;       //!< The id of the thread doing the operation
+    operation op;          //!< The kind of operation
+    uint16_t failed;       //!< Whether the operation failed
+  };
+
+  //! \brief Returns the current tick count.
+  static uint64_t ticks() noexcept
+  {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    return __rdtsc();
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+    uint64_t ret;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ret));
+    return ret;
+#else
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  //! \brief Records an event into the calling thread's ring buffer. The thread id is filled in.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void record(event e) noexcept;
+
+  /*! \brief Returns a copy of the events of all threads in the order of their beginning.
+  \mallocs Allocates the vector returned, and takes a lock also taken when threads first record
+  an event and when they exit.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<event> events();
+
+  //! \brief Discards the events of all threads.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void clear() noexcept;
+
+  //! \brief Returns the nanoseconds elapsed for `ticks` ticks, using a calibration over the lifetime of the process.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC double nanoseconds(uint64_t ticks) noexcept;
+
+  /*! \brief Writes the events of all threads to `s` as Chrome trace JSON, with each operation a
+  complete event named after its kind on the track of its thread.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void write_chrome_trace(std::ostream &s);
+};
+
+// BEGIN make_free_functions.py
+// END make_free_functions.py
+
+LLFIO_V2_NAMESPACE_END
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#include "detail/impl/io_trace.ipp"
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
@@ -0,0 +1,387 @@
+/* A shared memory message channel between processes
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_IPC_CHANNEL_H
+#define LLFIO_IPC_CHANNEL_H
+
+#include "mapped_file_handle.hpp"
+
+//! \file ipc_channel.hpp Provides `ipc_channel`
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+namespace detail
+{
+  /* Waits until `*addr` no longer equals `expected`, or the deadline passes. Must work
+  across processes.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> ipc_channel_wait(std::atomic<uint32_t> *addr, uint32_t expected, deadline d) noexcept;
+  // Wakes all waiters on `addr` in any process.
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void ipc_channel_wake(std::atomic<uint32_t> *addr) noexcept;
+}  // namespace detail
+
+/*! \class ipc_channel
+\brief A single producer, single consumer message channel between processes on the same
+host, held in a named shared memory file.
+
+Messages are written directly into, and read directly out of, a ring in memory shared between
+the two processes, so there are no kernel copies of message contents, unlike for `pipe_handle`.
+Each side only enters the kernel if it must sleep because the ring is full or empty, as the
+other side only issues a wake if it sees a sleeper:
+
+- On Linux, waits and wakes use shared futexes.
+- Elsewhere, waits poll with exponential backoff, as no portable cross process wait-on-address
+exists. Notably, Microsoft Windows' `WaitOnAddress()` only works within a process.
+
+Like `pipe_handle`, the channel is named by a path relative to a base directory, which defaults
+to `path_discovery::memory_backed_temporary_files_directory()` so the ring never touches storage.
+`channel_create()` creates the channel, and `channel_open()` opens an existing one from
+another process.
+
+For zero copy operation, use `acquire_send()` to obtain space in the ring, construct your message
+directly into it, and then `commit_send()` it. Similarly `acquire_receive()` returns a view of the
+next message within the ring, which remains valid until `commit_receive()`. `send()` and `receive()`
+are convenience wrappers which copy.
+
+Messages are aligned to eight bytes in the ring. The maximum size of a message is half the
+capacity of the ring less eight bytes.
+
+\warning Only one thread in one process may send, and only one thread in one process may receive,
+at a time. If you need many producers or consumers, serialise them with a lock of your own.
+*/
+class LLFIO_DECL ipc_channel
+{
+public:
+  using path_view_type = file_handle::path_view_type;
+  using extent_type = file_handle::extent_type;
+  using size_type = file_handle::size_type;
+  using buffer_type = map_handle::buffer_type;
+  using const_buffer_type = map_handle::const_buffer_type;
+
+protected:
+  static constexpr uint32_t _magic = 0x4c4c4943;  // LLIC
+  static constexpr uint64_t _wrap_marker = (uint64_t) -1;
+  struct _header_t
+  {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> head;           // bytes ever sent
+    std::atomic<uint32_t> head_seq;                   // bumped on every send, waited upon by the consumer
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(64) std::atomic<uint64_t> tail;           // bytes ever received
+    std::atomic<uint32_t> tail_seq;                   // bumped on every receive, waited upon by the producer
+    std::atomic<uint32_t> producer_waiting;
+  };
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "std::atomic<uint32_t> cannot be waited upon by the kernel");
+
+  mapped_file_handle _mfh;
+  _header_t *_header{nullptr};
+  byte *_ring{nullptr};
+  size_type _capacity{0};
+  uint64_t _send_pad{0};         // bytes of wrap padding preceding the acquired send
+  size_type _send_bytes{0};      // bytes acquired for the acquired send
+  bool _sending{false};
+  uint64_t _pending_receive{0};  // bytes of ring consumed by the acquired receive, including any wrap padding
+
+  explicit ipc_channel(mapped_file_handle &&mfh) noexcept
+      : _mfh(std::move(mfh))
+  {
+    _header = reinterpret_cast<_header_t *>(_mfh.address());  // NOLINT
+    _ring = _mfh.address() + utils::page_size();
+    _capacity = (size_type) _header->capacity;
+  }
+
+  static constexpr uint64_t _round(uint64_t bytes) noexcept { return (bytes + 7) & ~uint64_t(7); }
+
+  // Sleeps on `seq` until it changes from `expected`, having announced the wait in `waiting`
+  result<void> _wait(std::atomic<uint32_t> &seq, uint32_t expected, std::atomic<uint32_t> &waiting, deadline d) noexcept
+  {
+    waiting.fetch_add(1, std::memory_order_seq_cst);
+    auto r = detail::ipc_channel_wait(&seq, expected, d);
+    waiting.fetch_sub(1, std::memory_order_relaxed);
+    return r;
+  }
+  // Bumps `seq`, waking any sleeper announced in `waiting`
+  static void _wake(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting) noexcept
+  {
+    seq.fetch_add(1, std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_seq_cst) != 0)
+    {
+      detail::ipc_channel_wake(&seq);
+    }
+  }
+
+public:
+  //! Default constructor
+  ipc_channel() {}  // NOLINT
+  //! Implicit move construction permitted
+  ipc_channel(ipc_channel &&o) noexcept
+      : _mfh(std::move(o._mfh))
+      , _header(o._header)
+      , _ring(o._ring)
+      , _capacity(o._capacity)
+      , _send_pad(o._send_pad)
+      , _send_bytes(o._send_bytes)
+      , _sending(o._sending)
+      , _pending_receive(o._pending_receive)
+  {
+    o._header = nullptr;
+    o._ring = nullptr;
+    o._capacity = 0;
+    o._sending = false;
+    o._pending_receive = 0;
+  }
+  //! No copy construction (use `clone()`)
+  ipc_channel(const ipc_channel &) = delete;
+  //! Move assignment permitted
+  ipc_channel &operator=(ipc_channel &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~ipc_channel();
+    new(this) ipc_channel(std::move(o));
+    return *this;
+  }
+  //! No copy assignment
+  ipc_channel &operator=(const ipc_channel &) = delete;
+  ~ipc_channel() = default;
+
+  /*! Create a new channel named `path` relative to `base` with a ring of at least `capacity` bytes,
+  failing if it already exists. By default it is unlinked when the creator closes it.
+  */
+  static result<ipc_channel> channel_create(path_view_type path, size_type capacity = 1024 * 1024, file_handle::flag flags = file_handle::flag::unlink_on_first_close,
+                                            const path_handle &base = path_discovery::memory_backed_temporary_files_directory()) noexcept
+  {
+    try
+    {
+      capacity = utils::round_up_to_page_size(capacity, utils::page_size());
+      const size_type length = utils::page_size() + capacity;
+      OUTCOME_TRY(auto &&mfh, mapped_file_handle::mapped_file(length, base, path, file_handle::mode::write, file_handle::creation::only_if_not_exist, file_handle::caching::temporary, flags));
+      OUTCOME_TRY(mfh.truncate(length));
+      auto *header = new(mfh.address()) _header_t;
+      header->version = 1;
+      header->capacity = capacity;
+      header->head.store(0, std::memory_order_relaxed);
+      header->head_seq.store(0, std::memory_order_relaxed);
+      header->consumer_waiting.store(0, std::memory_order_relaxed);
+      header->tail.store(0, std::memory_order_relaxed);
+      header->tail_seq.store(0, std::memory_order_relaxed);
+      header->producer_waiting.store(0, std::memory_order_relaxed);
+      header->magic.store(_magic, std::memory_order_release);
+      return ipc_channel(std::move(mfh));
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+  /*! Open an existing channel named `path` relative to `base`.
+  \errors `errc::resource_unavailable_try_again` if the channel's creator has not finished
+  initialising it yet.
+  */
+  static result<ipc_channel> channel_open(path_view_type path, const path_handle &base = path_discovery::memory_backed_temporary_files_directory()) noexcept
+  {
+    OUTCOME_TRY(auto &&mfh, mapped_file_handle::mapped_file(base, path, file_handle::mode::write, file_handle::creation::open_existing, file_handle::caching::temporary));
+    if(mfh.maximum_extent().value_or(0) < utils::page_size())
+    {
+      return errc::resource_unavailable_try_again;
+    }
+    auto *header = reinterpret_cast<_header_t *>(mfh.address());  // NOLINT
+    if(header->magic.load(std::memory_order_acquire) != _magic)
+    {
+      return errc::resource_unavailable_try_again;
+    }
+    if(header->version != 1 || mfh.maximum_extent().value() < utils::page_size() + header->capacity)
+    {
+      return errc::invalid_argument;
+    }
+    return ipc_channel(std::move(mfh));
+  }
+
+  //! True if this channel is open
+  bool is_valid() const noexcept { return _header != nullptr; }
+  //! Closes the channel
+  result<void> close() noexcept
+  {
+    _header = nullptr;
+    _ring = nullptr;
+    _capacity = 0;
+    _sending = false;
+    _pending_receive = 0;
+    return _mfh.close();
+  }
+  //! The mapped file underlying the channel
+  const mapped_file_handle &file() const noexcept { return _mfh; }
+  //! The capacity of the ring in bytes
+  size_type capacity() const noexcept { return _capacity; }
+  //! The maximum size of a single message
+  size_type max_message_size() const noexcept { return _capacity / 2 - 8; }
+  //! The bytes of ring currently occupied, which is only a snapshot.
+  size_type size() const noexcept { return (size_type)(_header->head.load(std::memory_order_acquire) - _header->tail.load(std::memory_order_acquire)); }
+
+  /*! \brief Waits until there is space in the ring for a message of `bytes`, returning that space.
+  The message is not visible to the receiver until `commit_send()`.
+  \errors `errc::message_size` if `bytes` exceeds `max_message_size()`, `errc::timed_out` if the
+  deadline passes before the receiver makes space.
+  */
+  result<buffer_type> acquire_send(size_type bytes, deadline d = {}) noexcept
+  {
+    if(bytes > max_message_size())
+    {
+      return errc::message_size;
+    }
+    const uint64_t head = _header->head.load(std::memory_order_relaxed);
+    const uint64_t pos = head % _capacity;
+    uint64_t need = 8 + _round(bytes);
+    uint64_t msgpos = pos;
+    if(_capacity - pos < need)
+    {
+      // Pad to the end of the ring, and start the message at its front
+      need += _capacity - pos;
+      msgpos = 0;
+    }
+    for(;;)
+    {
+      const uint32_t seq = _header->tail_seq.load(std::memory_order_acquire);
+      if(_capacity - (head - _header->tail.load(std::memory_order_acquire)) >= need)
+      {
+        break;
+      }
+      OUTCOME_TRY(_wait(_header->tail_seq, seq, _header->producer_waiting, d));
+    }
+    if(msgpos != pos)
+    {
+      const uint64_t marker = _wrap_marker;
+      memcpy(_ring + pos, &marker, 8);
+    }
+    _send_pad = (msgpos != pos) ? (_capacity - pos) : 0;
+    _send_bytes = bytes;
+    _sending = true;
+    return buffer_type{_ring + msgpos + 8, bytes};
+  }
+  //! Makes the `bytes` written into the space returned by `acquire_send()` visible to the receiver.
+  result<void> commit_send(size_type bytes) noexcept
+  {
+    if(!_sending)
+    {
+      return errc::operation_not_permitted;
+    }
+    if(bytes > _send_bytes)
+    {
+      return errc::message_size;
+    }
+    const uint64_t head = _header->head.load(std::memory_order_relaxed);
+    const uint64_t pos = (_send_pad != 0) ? 0 : (head % _capacity);
+    const uint64_t consumed = _send_pad + 8 + _round(bytes);
+    const uint64_t len = bytes;
+    memcpy(_ring + pos, &len, 8);
+    _sending = false;
+    _header->head.store(head + consumed, std::memory_order_release);
+    _wake(_header->head_seq, _header->consumer_waiting);
+    return success();
+  }
+  //! Copies `msg` into the ring, waiting for space as needed.
+  result<void> send(const_buffer_type msg, deadline d = {}) noexcept
+  {
+    OUTCOME_TRY(auto &&space, acquire_send(msg.size(), d));
+    memcpy(space.data(), msg.data(), msg.size());
+    return commit_send(msg.size());
+  }
+
+  /*! \brief Waits until a message is available, returning a view of it within the ring which
+  remains valid until `commit_receive()`.
+  \errors `errc::timed_out` if the deadline passes before a message is sent.
+  */
+  result<const_buffer_type> acquire_receive(deadline d = {}) noexcept
+  {
+    const uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      const uint32_t seq = _header->head_seq.load(std::memory_order_acquire);
+      if(_header->head.load(std::memory_order_acquire) != tail)
+      {
+        break;
+      }
+      OUTCOME_TRY(_wait(_header->head_seq, seq, _header->consumer_waiting, d));
+    }
+    uint64_t pos = tail % _capacity;
+    uint64_t len;
+    memcpy(&len, _ring + pos, 8);
+    uint64_t consumed = 0;
+    if(len == _wrap_marker)
+    {
+      consumed = _capacity - pos;
+      pos = 0;
+      memcpy(&len, _ring, 8);
+    }
+    consumed += 8 + _round(len);
+    _pending_receive = consumed;
+    return const_buffer_type{_ring + pos + 8, (size_type) len};
+  }
+  //! Releases the space of the message returned by `acquire_receive()` back to the sender.
+  result<void> commit_receive() noexcept
+  {
+    if(_pending_receive == 0)
+    {
+      return errc::operation_not_permitted;
+    }
+    const uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+    _header->tail.store(tail + _pending_receive, std::memory_order_release);
+    _pending_receive = 0;
+    _wake(_header->tail_seq, _header->producer_waiting);
+    return success();
+  }
+  /*! Copies the next message into `buffer`, waiting for one as needed, returning the bytes copied.
+  \errors `errc::message_size` if `buffer` is too small, in which case the message is not consumed.
+  */
+  result<size_type> receive(buffer_type buffer, deadline d = {}) noexcept
+  {
+    OUTCOME_TRY(auto &&msg, acquire_receive(d));
+    if(msg.size() > buffer.size())
+    {
+      _pending_receive = 0;
+      return errc::message_size;
+    }
+    memcpy(buffer.data(), msg.data(), msg.size());
+    OUTCOME_TRY(commit_receive());
+    return msg.size();
+  }
+};
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#ifdef _WIN32
+#include "detail/impl/windows/ipc_channel.ipp"
+#else
+#include "detail/impl/posix/ipc_channel.ipp"
+#endif
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
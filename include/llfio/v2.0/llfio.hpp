@@ -64,28 +64,53 @@ import LLFIO_MODULE_NAME;
 
 #include "file_handle.hpp"
 #include "process_handle.hpp"
+#include "byte_socket_handle.hpp"
 #include "directory_handle.hpp"
 #include "statfs.hpp"
 #ifdef LLFIO_INCLUDE_STORAGE_PROFILE
 #include "storage_profile.hpp"
 #endif
+#include "block_device_handle.hpp"
 #include "fast_random_file_handle.hpp"
 #include "symlink_handle.hpp"
 
+#include "algorithm/atomic_replace.hpp"
 #include "algorithm/clone.hpp"
 #include "algorithm/contents.hpp"
+#include "algorithm/deduplicate.hpp"
+#include "algorithm/difference.hpp"
+#include "algorithm/file_handle_cache.hpp"
 #include "algorithm/handle_adapter/cached_parent.hpp"
+#include "algorithm/handle_adapter/direct_io.hpp"
+#include "algorithm/handle_adapter/striped.hpp"
+#include "algorithm/handle_adapter/tiered.hpp"
+#include "algorithm/path_table.hpp"
 #include "algorithm/reduce.hpp"
 #include "algorithm/shared_fs_mutex/atomic_append.hpp"
 #include "algorithm/shared_fs_mutex/byte_ranges.hpp"
 #include "algorithm/shared_fs_mutex/lock_files.hpp"
 #include "algorithm/shared_fs_mutex/safe_byte_ranges.hpp"
 #include "algorithm/summarize.hpp"
+#include "algorithm/transactional_directory.hpp"
+#include "algorithm/write_ahead_log.hpp"
 
 #ifndef LLFIO_EXCLUDE_MAPPED_FILE_HANDLE
+#include "demand_paged_map.hpp"
+#include "ipc_channel.hpp"
 #include "mapped.hpp"
+#include "mapped_ring_buffer.hpp"
+#include "windowed_map_view.hpp"
+#include "algorithm/handle_adapter/compressed.hpp"
+#include "algorithm/handle_adapter/erasure_coded.hpp"
+#include "algorithm/handle_adapter/transform.hpp"
+#include "algorithm/handle_adapter/write_back.hpp"
 #include "algorithm/handle_adapter/xor.hpp"
 #include "algorithm/shared_fs_mutex/memory_map.hpp"
+#include "algorithm/append_only_vector.hpp"
+#include "algorithm/find_in_files.hpp"
+#include "algorithm/manifest.hpp"
+#include "algorithm/mapped_arena.hpp"
+#include "algorithm/read_whole_file.hpp"
 #include "algorithm/trivial_vector.hpp"
 #endif
 
@@ -27,7 +27,9 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "io_handle.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 //! \file lockable_io_handle.hpp Provides a lockable i/o handle
 
@@ -302,6 +304,69 @@ public:
 
   LLFIO_DEADLINE_TRY_FOR_UNTIL(lock_file_range)
 
+#if !defined(_WIN32) || DOXYGEN_IS_IN_THE_HOUSE
+  /*! \brief EXTENSION: Begins locking a range of bytes for shared or exclusive access without
+  blocking the calling thread, with completion delivered through an i/o multiplexer.
+
+  If the lock can be granted immediately, `op.result` is zero upon return. Otherwise `op.result`
+  is `posix_fs_syscall::pending` until the multiplexer's lock waiter has granted it, after which
+  `check_for_any_completed_io()` returns. See `io_multiplexer::initiate_posix_fs_syscalls()`. Once
+  `op` has completed, call `completed_lock_file_range()` to obtain the extent guard. `op` must
+  remain valid until then.
+
+  The same caveats as for `lock_file_range()` apply.
+
+  \param op The state of the lock, which is overwritten.
+  \param offset The offset to lock.
+  \param bytes The number of bytes to lock.
+  \param kind Whether the lock is to be shared or exclusive.
+  \param multiplexer The multiplexer through which to complete the lock, or null for this handle's.
+  \errors `errc::invalid_argument` if there is no multiplexer, or `kind` is `lock_kind::unlocked`.
+  \mallocs The first contention of a multiplexer creates its lock waiter thread.
+  */
+  result<void> initiate_lock_file_range(io_multiplexer::posix_fs_syscall &op, extent_type offset, extent_type bytes, lock_kind kind, io_multiplexer *multiplexer = nullptr) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    if(multiplexer == nullptr)
+    {
+      multiplexer = this->multiplexer();
+    }
+    if(multiplexer == nullptr || kind == lock_kind::unlocked)
+    {
+      return errc::invalid_argument;
+    }
+    if(bytes > static_cast<extent_type>(static_cast<size_t>(-1)))
+    {
+      return errc::value_too_large;
+    }
+    op = io_multiplexer::posix_fs_syscall();
+    op.op = io_multiplexer::posix_fs_syscall::kind::lock_range;
+    op.fd = _v.fd;
+    op.offset = offset;
+    op.bytes = static_cast<size_t>(bytes);
+    op.flags = (kind == lock_kind::exclusive) ? 1 : 0;
+    return multiplexer->initiate_posix_fs_syscalls({&op, 1});
+  }
+
+  /*! \brief EXTENSION: Returns the extent guard for a lock begun by `initiate_lock_file_range()`.
+
+  \errors `errc::operation_in_progress` if the lock has not completed yet, else the failure of the lock.
+  */
+  result<extent_guard> completed_lock_file_range(const io_multiplexer::posix_fs_syscall &op) noexcept
+  {
+    const int res = __atomic_load_n(&op.result, __ATOMIC_ACQUIRE);
+    if(res == io_multiplexer::posix_fs_syscall::pending)
+    {
+      return errc::operation_in_progress;
+    }
+    if(res < 0)
+    {
+      return posix_error(-res);
+    }
+    return extent_guard(this, op.offset, op.bytes, (op.flags != 0) ? lock_kind::exclusive : lock_kind::shared);
+  }
+#endif
+
   /*! \brief EXTENSION: Unlocks a byte range previously locked.
 
   \param offset The offset to unlock. This should be an offset previously locked.
@@ -310,6 +375,196 @@ public:
   \mallocs None.
   */
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC void unlock_file_range(extent_type offset, extent_type bytes) noexcept;
+
+  //! \brief EXTENSION: A byte range to be locked by `lock_file_ranges()`.
+  struct extent_lock_request
+  {
+    extent_type offset{0};             //!< The offset to lock.
+    extent_type bytes{0};              //!< The number of bytes to lock. Must not be zero.
+    lock_kind kind{lock_kind::shared};  //!< Whether the lock is to be shared or exclusive.
+  };
+
+  /*! \class extent_guards
+  \brief EXTENSION: RAII holder of many locked extents of bytes in a file.
+  */
+  class extent_guards
+  {
+    friend class lockable_io_handle;
+    lockable_io_handle *_h{nullptr};
+    std::vector<extent_lock_request> _extents;
+
+  public:
+    extent_guards(const extent_guards &) = delete;
+    extent_guards &operator=(const extent_guards &) = delete;
+
+    //! Default constructor
+    extent_guards() = default;
+    //! Move constructor
+    extent_guards(extent_guards &&o) noexcept
+        : _h(o._h)
+        , _extents(std::move(o._extents))
+    {
+      o.release();
+    }
+    //! Move assign
+    extent_guards &operator=(extent_guards &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      unlock();
+      _h = o._h;
+      _extents = std::move(o._extents);
+      o.release();
+      return *this;
+    }
+    ~extent_guards() { unlock(); }
+    //! True if extent guards are valid
+    explicit operator bool() const noexcept { return _h != nullptr; }
+
+    //! The `lockable_io_handle` to be unlocked
+    lockable_io_handle *handle() const noexcept { return _h; }
+    //! The sorted and coalesced extents actually locked, and to be unlocked
+    span<const extent_lock_request> extents() const noexcept { return {_extents.data(), _extents.size()}; }
+
+    //! Unlocks the locked extents immediately
+    void unlock() noexcept
+    {
+      if(_h != nullptr)
+      {
+        for(auto it = _extents.rbegin(); it != _extents.rend(); ++it)
+        {
+          _h->unlock_file_range(it->offset, it->bytes);
+        }
+        release();
+      }
+    }
+
+    //! Detach this RAII unlocker from the locked state
+    void release() noexcept
+    {
+      _h = nullptr;
+      _extents.clear();
+    }
+  };
+
+  /*! \brief EXTENSION: Sorts and coalesces a sequence of byte range lock requests, as used by
+  `lock_file_ranges()` and `unlock_file_ranges()`.
+
+  Requests are sorted by offset. Adjacent requests of the same kind are merged, as are any overlapping
+  requests, the merged request being exclusive if either of them were.
+
+  \errors `errc::invalid_argument` if any request has zero bytes. May throw `std::bad_alloc`.
+  */
+  static result<std::vector<extent_lock_request>> coalesce_extent_lock_requests(span<const extent_lock_request> reqs)
+  {
+    std::vector<extent_lock_request> ret(reqs.begin(), reqs.end());
+    for(const auto &i : ret)
+    {
+      if(i.bytes == 0)
+      {
+        return errc::invalid_argument;
+      }
+    }
+    std::sort(ret.begin(), ret.end(), [](const extent_lock_request &a, const extent_lock_request &b) { return a.offset < b.offset; });
+    auto out = ret.begin();
+    for(auto it = ret.begin(); it != ret.end(); ++it)
+    {
+      if(it == out)
+      {
+        continue;
+      }
+      const extent_type end = out->offset + out->bytes;
+      if(it->offset < end || (it->offset == end && it->kind == out->kind))
+      {
+        out->bytes = std::max(end, it->offset + it->bytes) - out->offset;
+        if(it->kind == lock_kind::exclusive)
+        {
+          out->kind = lock_kind::exclusive;
+        }
+        continue;
+      }
+      *++out = *it;
+    }
+    if(!ret.empty())
+    {
+      ret.erase(++out, ret.end());
+    }
+    return {std::move(ret)};
+  }
+
+  /*! \brief EXTENSION: Locks many ranges of bytes at once, returning a single guard.
+
+  The requests are sorted and coalesced by `coalesce_extent_lock_requests()`, so adjacent entities
+  cost a single lock syscall, and are then locked in ascending offset order. Because every caller of
+  this function acquires in the same order, callers blocking on one another cannot deadlock, so there
+  is no need to back off and randomise the lock order after contention as `lock_file_range()` loops
+  must. If any range cannot be locked within the deadline, all ranges locked so far are unlocked.
+
+  The same caveats as for `lock_file_range()` apply, in particular on POSIX ranges locked by one
+  call are replaced, not overlaid, by ranges locked by another call.
+
+  \return An extent guards, the destruction of which will unlock all the ranges.
+  \param reqs The ranges to lock, in any order.
+  \param d An optional deadline by which all the locks must complete, else they are cancelled.
+  \errors As for `lock_file_range()` and `coalesce_extent_lock_requests()`.
+  \mallocs One, to store the coalesced ranges.
+  */
+  result<extent_guards> lock_file_ranges(span<const extent_lock_request> reqs, deadline d = deadline()) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    try
+    {
+      LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+      OUTCOME_TRY(auto &&extents, coalesce_extent_lock_requests(reqs));
+      extent_guards ret;
+      ret._h = this;
+      ret._extents.reserve(extents.size());
+      for(const auto &i : extents)
+      {
+        deadline nd;
+        LLFIO_DEADLINE_TO_PARTIAL_DEADLINE(nd, d);
+        OUTCOME_TRY(auto &&g, lock_file_range(i.offset, i.bytes, i.kind, nd));
+        g.release();
+        ret._extents.push_back(i);
+      }
+      return {std::move(ret)};
+    }
+    catch(...)
+    {
+      return error_from_exception();
+    }
+  }
+
+  /*! \brief EXTENSION: Unlocks many ranges of bytes previously locked, coalescing them first so
+  adjacent ranges cost a single unlock syscall.
+
+  \mallocs One, to store the coalesced ranges. If that fails, each range is unlocked individually.
+  */
+  void unlock_file_ranges(span<const extent_lock_request> reqs) noexcept
+  {
+    LLFIO_LOG_FUNCTION_CALL(this);
+    try
+    {
+      auto extents = coalesce_extent_lock_requests(reqs);
+      if(extents)
+      {
+        for(const auto &i : extents.value())
+        {
+          unlock_file_range(i.offset, i.bytes);
+        }
+        return;
+      }
+    }
+    catch(...)
+    {
+    }
+    for(const auto &i : reqs)
+    {
+      unlock_file_range(i.offset, i.bytes);
+    }
+  }
 };
 
 /*! \brief RAII locker matching `std::unique_lock` for `lockable_io_handle`, but untemplated.
@@ -302,6 +302,12 @@ LLFIO_V2_NAMESPACE_END
 #define LLFIO_LOG_INFO(inst, message)
 #define LLFIO_LOG_FUNCTION_CALL(inst) LLFIO_LOG_INST_TO_TLS(inst)
 #endif
+// Used instead of LLFIO_LOG_FUNCTION_CALL by the i/o functions called most often
+#ifdef LLFIO_DISABLE_HOT_PATH_LOGGING
+#define LLFIO_LOG_HOT_FUNCTION_CALL(inst)
+#else
+#define LLFIO_LOG_HOT_FUNCTION_CALL(inst) LLFIO_LOG_FUNCTION_CALL(inst)
+#endif
 #if LLFIO_LOGGING_LEVEL >= 5
 #define LLFIO_LOG_DEBUG(inst, message)                                                                                                                         \
   ::LLFIO_V2_NAMESPACE::log().emplace_back(                                                                                                                    \
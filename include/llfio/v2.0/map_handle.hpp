@@ -27,6 +27,14 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "file_handle.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>  // for _mm_stream_si128
+#endif
+
 //! \file map_handle.hpp Provides `map_handle`
 
 #ifdef _MSC_VER
@@ -61,18 +69,23 @@ public:
                                    cow = 1U << 2U,      //!< Memory views can be copy on written
                                    execute = 1U << 3U,  //!< Memory views can execute code
 
-                                   nocommit = 1U << 8U,     //!< Don't allocate space for this memory in the system immediately
-                                   prefault = 1U << 9U,     //!< Prefault, as if by reading every page, any views of memory upon creation.
-                                   executable = 1U << 10U,  //!< The backing storage is in fact an executable program binary.
-                                   singleton = 1U << 11U,   //!< A single instance of this section is to be shared by all processes using the same backing file.
+                                   nocommit = 1U << 8U,         //!< Don't allocate space for this memory in the system immediately
+                                   prefault = 1U << 9U,         //!< Prefault, as if by reading every page, any views of memory upon creation.
+                                   executable = 1U << 10U,      //!< The backing storage is in fact an executable program binary.
+                                   singleton = 1U << 11U,       //!< A single instance of this section is to be shared by all processes using the same backing file.
+                                   prefault_write = 1U << 12U,  //!< Prefault, as if by writing every page, any writable views of memory upon creation, so the first write to each page takes no fault.
+                                   prefault_async = 1U << 13U,  //!< Prefault views on a background thread, so creation of the view does not wait. Implies `prefault` if neither `prefault` nor `prefault_write` are set.
 
                                    barrier_on_close = 1U << 16U,   //!< Maps of this section, if writable, issue a `barrier()` when destructed blocking until data (not metadata) reaches physical storage.
-                                   nvram = 1U << 17U,              //!< This section is of non-volatile RAM.
+                                   nvram = 1U << 17U,              //!< This section is of non-volatile RAM. Set automatically on Linux for sections of files on a DAX mount.
                                    write_via_syscall = 1U << 18U,  //!< For file backed maps, `map_handle::write()` is implemented as a `write()` syscall to the file descriptor. This causes the map to be mapped read-only.
 
                                    page_sizes_1 = 1U << 24U,  //!< Use `utils::page_sizes()[1]` sized pages, or fail.
                                    page_sizes_2 = 2U << 24U,  //!< Use `utils::page_sizes()[2]` sized pages, or fail.
                                    page_sizes_3 = 3U << 24U,  //!< Use `utils::page_sizes()[3]` sized pages, or fail.
+                                   page_sizes_fallback = 1U << 26U,     //!< For `map_handle::map()` allocations, if the page size requested cannot be obtained, try successively smaller ones instead of failing. Without a `page_sizes_N`, the largest page size is tried first. For maps of sections on POSIX, if the page size requested cannot be obtained, map normal pages instead of failing, on Linux with transparent huge pages requested.
+                                   transparent_huge_pages = 1U << 27U,  //!< Set in the flags of `page_sizes_fallback` allocations which fell back to normal pages for which transparent huge pages were requested.
+                                   track_dirty = 1U << 28U,             //!< For `map_handle::map()` allocations on Windows, allocate with `MEM_WRITE_WATCH` so `map_handle::dirty_regions()` can be precise. Ignored elsewhere, as other platforms track dirty pages for all maps.
 
                                    // NOTE: IF UPDATING THIS UPDATE THE std::ostream PRINTER BELOW!!!
 
@@ -80,10 +93,14 @@ public:
   QUICKCPPLIB_BITFIELD_END(flag);
 
 protected:
+  friend class map_handle;
   file_handle *_backing{nullptr};
   file_handle _anonymous;
   flag _flag{flag::none};
 
+  // Creates a section over the anonymous inode `anonh`, or over the paging file if `anonh` is invalid
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<section_handle> _anonymous_section(extent_type bytes, file_handle &&anonh, flag _flag) noexcept;
+
 public:
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~section_handle() override;
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> close() noexcept override;
@@ -141,6 +158,11 @@ public:
   \param maximum_size The initial size of this section, which cannot be larger than any backing file. Zero means to use `backing.maximum_extent()`.
   \param _flag How to create the section.
 
+  On Microsoft Windows, a writable section larger than its backing file extends the file. The file
+  is first marked sparse, unless opened with `file_handle::flag::win_disable_sparse_file_creation`,
+  so that as on POSIX the extension allocates no storage until written. Use `allocated()` to
+  find how much storage has been.
+
   \errors Any of the values POSIX dup(), open() or NtCreateSection() can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
@@ -164,6 +186,24 @@ public:
   */
   LLFIO_MAKE_FREE_FUNCTION
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<section_handle> section(extent_type bytes, const path_handle &dirh = path_discovery::storage_backed_temporary_files_directory(), flag _flag = flag::read | flag::write) noexcept;
+  /*! \brief Create a memory section backed by anonymous memory, which can be handed to other
+  processes by passing its native handle, and optionally sealed against modification.
+  \param bytes The initial size of this section. Cannot be zero.
+  \param _flag How to create the section.
+
+  On Linux, this is a `memfd_create()` inode which permits sealing. On Microsoft Windows, this
+  is a section backed by the paging file, which cannot be extended. With `flag::nocommit` its pages
+  are only reserved, adding nothing to the commit charge until views mapped with
+  `flag::nocommit` commit them using `map_handle::commit()`. Elsewhere, this is
+  `section(bytes, path_discovery::memory_backed_temporary_files_directory(), _flag)`.
+
+  Receivers of the native handle in another process can wrap it into a `file_handle`, and
+  create a section over that.
+
+  \errors Any of the values POSIX memfd_create(), ftruncate() or NtCreateSection() can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<section_handle> anonymous_section(extent_type bytes, flag _flag = flag::read | flag::write) noexcept;
 
   //! Returns the memory section's flags
   flag section_flags() const noexcept { return _flag; }
@@ -178,6 +218,24 @@ public:
   //! Return the current length of the memory section.
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> length() const noexcept;
+  /*! \brief Return the bytes of storage actually allocated to the memory section, which for a
+  sparse backing file can be far less than its length.
+
+  \errors `errc::operation_not_supported` for sections backed by the paging file on Microsoft Windows,
+  otherwise any of the values `stat_t::fill()` can return.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  result<extent_type> allocated() const noexcept
+  {
+    const file_handle *fh = (_backing != nullptr) ? _backing : (_anonymous.is_valid() ? &_anonymous : nullptr);
+    if(fh == nullptr)
+    {
+      return errc::operation_not_supported;
+    }
+    stat_t s(nullptr);
+    OUTCOME_TRYV(s.fill(*fh, stat_t::want::allocated));
+    return s.st_allocated;
+  }
 
   /*! Resize the current maximum permitted extent of the memory section to the given extent.
   \param newsize The new size of the memory section, which cannot be zero. Specify zero to use `backing.maximum_extent()`.
@@ -187,6 +245,22 @@ public:
   */
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> truncate(extent_type newsize = 0) noexcept;
+
+  /*! \brief Seals the contents and length of a section from `anonymous_section()` against
+  any further modification by anyone, so receivers of it need not copy it defensively.
+
+  Sealing fails with `errc::device_or_resource_busy` if any writable maps of the section
+  exist, so unmap those first. Once sealed, a section can never be unsealed.
+
+  \errors `errc::operation_not_supported` if the section was not created by `anonymous_section()`,
+  or on platforms other than Linux. On Microsoft Windows, the nearest equivalent is to pass
+  receivers a duplicate of the section handle with only `SECTION_MAP_READ` access.
+  */
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> seal() noexcept;
+  //! True if the section has been sealed by `seal()`, possibly in another process.
+  LLFIO_MAKE_FREE_FUNCTION
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<bool> is_sealed() const noexcept;
 };
 inline std::ostream &operator<<(std::ostream &s, const section_handle::flag &v)
 {
@@ -223,6 +297,14 @@ inline std::ostream &operator<<(std::ostream &s, const section_handle::flag &v)
   {
     temp.append("singleton|");
   }
+  if(!!(v & section_handle::flag::prefault_write))
+  {
+    temp.append("prefault_write|");
+  }
+  if(!!(v & section_handle::flag::prefault_async))
+  {
+    temp.append("prefault_async|");
+  }
   if(!!(v & section_handle::flag::barrier_on_close))
   {
     temp.append("barrier_on_close|");
@@ -247,6 +329,18 @@ inline std::ostream &operator<<(std::ostream &s, const section_handle::flag &v)
   {
     temp.append("page_sizes_1|");
   }
+  if(!!(v & section_handle::flag::page_sizes_fallback))
+  {
+    temp.append("page_sizes_fallback|");
+  }
+  if(!!(v & section_handle::flag::transparent_huge_pages))
+  {
+    temp.append("transparent_huge_pages|");
+  }
+  if(!!(v & section_handle::flag::track_dirty))
+  {
+    temp.append("track_dirty|");
+  }
   if(!temp.empty())
   {
     temp.resize(temp.size() - 1);
@@ -365,6 +459,14 @@ produce optimal code. If your CPU does not support the requisite instructions (o
 and empty buffer will be returned to indicate that nothing was barriered, same as the normal `barrier()`
 function.
 
+`map_handle::barrier()` itself uses `nvram_barrier()` in place of `msync()` for maps where `is_nvram()` is true,
+unless metadata is also to be synchronised. On Linux, sections of files on a DAX mount (detected via `statx()`
+on Linux 5.8 or later) are marked `section_handle::flag::nvram` automatically, unless copy on write.
+Maps of nvram sections are created with `MAP_SHARED_VALIDATE | MAP_SYNC`, so the kernel keeps the filing
+system metadata for the mapped extents durable, and flushing the CPU caches is sufficient for the
+written data to persist. If the kernel or filing system refuses `MAP_SYNC`, the map is created without,
+`is_nvram()` on the map returns false, and `barrier()` calls `msync()` as usual.
+
 ## Large page support:
 
 Large, huge, massive and super page support is available via the `section_handle::flag::page_sizes_N` flags.
@@ -405,8 +507,18 @@ able to map files using large pages soon, and in theory LLFIO based should "just
 Note that some distributions enable transparent huge pages, whereby if you request allocations of large page multiples
 at large page offsets, the kernel uses large pages, without you needing to specify any `section_handle::flag::page_sizes_N`.
 Almost all distributions enable opt-in transparent huge pages, where you can explicitly request that pages
-within a region of memory transparently use huge pages as much as possible. LLFIO does not expose such
-facilities, you will need to manually invoke `madvise(MADV_HUGEPAGE)` on the region desired.
+within a region of memory transparently use huge pages as much as possible. For file maps, passing
+`section_handle::flag::page_sizes_fallback` with a `page_sizes_N` to `map()` invokes `madvise(MADV_HUGEPAGE)`
+on the map if the explicit large pages could not be obtained, setting `section_handle::flag::transparent_huge_pages`
+in the map's flags if that succeeded. Whether files actually get huge pages then depends upon the filing
+system, for `tmpfs` upon its `huge=` mount option.
+
+For memory allocations, `section_handle::flag::page_sizes_fallback` tries each explicit huge page size
+from the largest requested downwards, skipping those larger than the allocation, and if none can be
+obtained, maps normal pages and invokes `madvise(MADV_HUGEPAGE)` on them, setting
+`section_handle::flag::transparent_huge_pages` in the map's flags if that succeeded. `page_size()`
+reports which explicit page size was obtained, and `page_size_statistics()` how many bytes of
+such allocations are in use process-wide per page size.
 
 ### FreeBSD:
 
@@ -440,12 +552,20 @@ public:
   template <class T> using io_request = io_handle::io_request<T>;
   template <class T> using io_result = io_handle::io_result<T>;
 
+  //! The default for `nontemporal_write_threshold()`.
+  static constexpr size_type default_nontemporal_write_threshold = 4 * 1024 * 1024;
+
 protected:
   section_handle *_section{nullptr};
   byte *_addr{nullptr};
   extent_type _offset{0};
   size_type _reservation{0}, _length{0}, _pagesize{0};
   section_handle::flag _flag{section_handle::flag::none};
+  bool _recyclable{false};  // whether close() may recycle this allocation through the thread's cache
+  size_type _nontemporal_write_threshold{default_nontemporal_write_threshold};
+
+  // Adjusts the process-wide page size statistics by `bytes` for `page_sizes_fallback` allocations
+  void _account_page_size(ptrdiff_t bytes) const noexcept;
 
   explicit map_handle(section_handle *section, section_handle::flag flags)
       : _section(section)
@@ -485,6 +605,8 @@ public:
       , _length(o._length)
       , _pagesize(o._pagesize)
       , _flag(o._flag)
+      , _recyclable(o._recyclable)
+      , _nontemporal_write_threshold(o._nontemporal_write_threshold)
   {
     o._section = nullptr;
     o._addr = nullptr;
@@ -493,6 +615,7 @@ public:
     o._length = 0;
     o._pagesize = 0;
     o._flag = section_handle::flag::none;
+    o._recyclable = false;
   }
   //! No copy construction (use `clone()`)
   map_handle(const map_handle &) = delete;
@@ -547,11 +670,59 @@ public:
   the other constructor. This makes available all those very useful VM tricks Windows can do with
   section mapped memory which `VirtualAlloc()` memory cannot do.
 
+  \note On POSIX, allocations of up to `cache_max_item_bytes` with only `flag::readwrite`
+  are not unmapped when closed, they are instead `MADV_FREE`d into a per-thread cache from
+  which subsequent non-`zeroed` allocations by that thread are satisfied. This avoids the
+  `munmap()` TLB shootdowns across all CPUs on which the process is running. A recycled
+  allocation may have a `capacity()` larger than asked for. See `trim_cache()`.
+
   \errors Any of the values POSIX `mmap()` or `VirtualAlloc()` can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<map_handle> map(size_type bytes, bool zeroed = false, section_handle::flag _flag = section_handle::flag::readwrite) noexcept;
 
+  //! \brief A NUMA memory placement policy, see `set_numa_policy()`.
+  struct numa_policy
+  {
+    enum class kind : uint8_t
+    {
+      local,       //!< Allocate pages on the node of the CPU first touching them
+      bind,        //!< Allocate pages only on the nodes in `nodes`
+      interleave,  //!< Allocate pages round robin across the nodes in `nodes`
+      preferred    //!< Allocate pages on the lowest node in `nodes` if possible, otherwise anywhere
+    } policy{kind::local};
+    uint64_t nodes{0};  //!< A bitmask of NUMA nodes, bit N being node N
+  };
+  /*! \brief Map unused memory into view with the NUMA placement policy `policy`, otherwise
+  as the overload above.
+
+  On Linux this is the same as calling `set_numa_policy()` on the map returned by the overload
+  above, except that the map will never be recycled through the per-thread cache. On Windows,
+  `VirtualAllocExNuma()` is used to allocate on the lowest node in the policy, and
+  `numa_policy::kind::interleave` is not supported.
+
+  \errors Any of the values POSIX `mmap()`, `mbind()` or `VirtualAllocExNuma()` can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<map_handle> map(size_type bytes, numa_policy policy, bool zeroed = false,
+                                                                section_handle::flag _flag = section_handle::flag::readwrite) noexcept;
+
+  //! The largest allocation recycled through the per-thread cache.
+  static constexpr size_type cache_max_item_bytes = 16 * 1024 * 1024;
+  //! The most bytes retained by each thread's cache.
+  static constexpr size_type cache_max_bytes = 256 * 1024 * 1024;
+  //! \brief Statistics about the calling thread's cache of closed allocations.
+  struct cache_statistics_t
+  {
+    size_t items_in_cache;  //!< The number of allocations in the cache.
+    size_t bytes_in_cache;  //!< The bytes of allocations in the cache.
+    size_t hits;            //!< How many `map()` calls were satisfied from the cache.
+    size_t misses;          //!< How many cacheable `map()` calls were not satisfied from the cache.
+  };
+  //! Returns statistics about the calling thread's cache of closed allocations. Always zero on Windows.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC cache_statistics_t cache_statistics() noexcept;
+  //! Unmaps all the allocations in the calling thread's cache, returning the statistics from before.
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC cache_statistics_t trim_cache() noexcept;
+
   /*! Reserve address space within which individual pages can later be committed. Reserved address
   space is NOT added to the process' commit charge.
 
@@ -616,6 +787,30 @@ public:
   //! True if the map is of non-volatile RAM
   bool is_nvram() const noexcept { return !!(_flag & section_handle::flag::nvram); }
 
+  //! True if the map fell back to normal pages for which transparent huge pages were requested
+  bool is_transparent_huge_pages() const noexcept { return !!(_flag & section_handle::flag::transparent_huge_pages); }
+
+  //! The size of buffer at and above which `write()` copies into the map using non-temporal stores. Zero means never.
+  size_type nontemporal_write_threshold() const noexcept { return _nontemporal_write_threshold; }
+  /*! \brief Sets the size of buffer at and above which `write()` copies into the map using non-temporal stores,
+  which bypass the CPU caches, so bulk writes through the map do not evict the working set of the
+  process. Data so written is not in the CPU caches afterwards, so reading it back soon is slower.
+  Zero means never. The default is `default_nontemporal_write_threshold`.
+
+  Non-temporal stores are used on x86 with SSE2, and on AArch64. Elsewhere `memcpy()` is always used.
+  */
+  void set_nontemporal_write_threshold(size_type bytes) noexcept { _nontemporal_write_threshold = bytes; }
+
+  //! \brief Process-wide statistics about the page sizes obtained by `section_handle::flag::page_sizes_fallback` allocations.
+  struct page_size_statistics_t
+  {
+    size_t bytes_in_use[4];              //!< Bytes currently allocated using `utils::page_sizes()[n]` sized pages.
+    size_t transparent_huge_page_bytes;  //!< Of `bytes_in_use[0]`, the bytes for which transparent huge pages were requested.
+    size_t fallbacks;                    //!< How many allocations obtained a smaller page size than the first one tried.
+  };
+  //! Returns the current process-wide statistics about the page sizes obtained by `section_handle::flag::page_sizes_fallback` allocations.
+  static inline page_size_statistics_t page_size_statistics() noexcept;
+
   //! Update the size of the memory map to that of any backing section, up to the reservation limit.
   result<size_type> update_map() noexcept
   {
@@ -666,6 +861,13 @@ public:
   aligned (see `page_size()`), if not the returned buffer is the region actually committed.
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> commit(buffer_type region, section_handle::flag flag = section_handle::flag::readwrite) noexcept;
+  /*! \brief Commits many regions at once. `regions` is sorted by address in place, and regions
+  which overlap or are adjacent once rounded to page size are merged, so each contiguous run
+  costs one remap. On Linux the `MADV_WILLNEED` hints are issued by vectored `process_madvise()`.
+
+  \return The merged regions actually committed, which occupy the front of `regions`.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> commit(span<buffer_type> regions, section_handle::flag flag = section_handle::flag::readwrite) noexcept;
 
   /*! Ask the system to make the memory represented by the buffer unavailable and
   to decommit the system resources representing them. addr and length should be
@@ -673,6 +875,12 @@ public:
   decommitted.
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> decommit(buffer_type region) noexcept;
+  /*! \brief Decommits many regions at once, with the same sorting and merging of `regions`
+  as the multi-region `commit()`.
+
+  \return The merged regions actually decommitted, which occupy the front of `regions`.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> decommit(span<buffer_type> regions) noexcept;
 
   /*! Zero the memory represented by the buffer. Differs from zero() because it acts on
   mapped memory, not on allocated file extents.
@@ -689,6 +897,10 @@ public:
   \errors Any of the errors returnable by madvise() or DiscardVirtualMemory or the zero() function.
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> zero_memory(buffer_type region) noexcept;
+  /*! \brief Zeros many regions at once. `regions` is sorted by address in place and
+  overlapping or adjacent regions are merged, after which its contents are unspecified.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> zero_memory(span<buffer_type> regions) noexcept;
 
   /*! Ask the system to unset the dirty flag for the memory represented by the
   buffer. This will prevent any changes not yet sent to the backing storage from
@@ -717,7 +929,97 @@ public:
   so on Windows this call does nothing.
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> do_not_store(buffer_type region) noexcept;
+  /*! \brief Unsets the dirty flag for many regions at once, with the same sorting and merging
+  of `regions` as the multi-region `commit()`. On Linux kernels whose `process_madvise()` accepts
+  `MADV_FREE` for the calling process, up to a thousand merged regions cost one syscall.
+
+  \return The merged regions actually undirtied, which occupy the front of `regions`.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> do_not_store(span<buffer_type> regions) noexcept;
+
+  /*! \brief Asks the system to remove the whole pages of `region` from the resident set of this process,
+  without losing their contents, returning the page aligned region evicted.
+
+  Unlike `do_not_store()`, this never loses data, so it suits releasing the pages of a region already
+  processed. For shared maps of files, the pages are unmapped, and reading them again repopulates
+  them from the page cache. For anonymous memory and copy on write maps, Linux 5.4 or later is asked to
+  reclaim the pages before others, which does not reduce the resident set until there is memory
+  pressure. On Windows the pages are removed from the working set. Elsewhere an empty region is returned.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> evict(buffer_type region) noexcept;
+
+  /*! \brief Resets tracking of which pages of this map have been written to, such that
+  `dirty_regions()` reports only pages written to after this call.
+
+  On Linux this uses the kernel's soft-dirty page tracking, which is process wide: clearing
+  it for this map clears it for every map in the process, including those of other code.
+  On Windows, only allocations made with `section_handle::flag::track_dirty` are tracked.
+  Where there is no tracking, this call does nothing.
+
+  \errors Any of the values which writing to `/proc/self/clear_refs` or `ResetWriteWatch()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> clear_dirty() noexcept;
+  /*! \brief Fills `out` with the page aligned extents of `region`, or of the whole map if empty,
+  which have been written to since the last `clear_dirty()`, merging those adjacent.
+
+  Where tracking is not available, the whole of `region` is reported as dirty. Before the first
+  `clear_dirty()`, Linux reports every page as dirty. If `out` fills, call again with `region`
+  beginning after the last extent returned.
+
+  \return The extents filled, in ascending address order.
+  \errors Any of the values which `ioctl(PAGEMAP_SCAN)`, reading `/proc/self/pagemap` or
+  `GetWriteWatch()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> dirty_regions(span<buffer_type> out, buffer_type region = {}) const noexcept;
+  /*! \brief Issues a `barrier()` of only those extents reported by `dirty_regions()`, then
+  `clear_dirty()`.
+
+  For a large map with few pages written since the last call, this is far cheaper than
+  `barrier()` of the whole map, which must walk every page of the map. `scratch` receives
+  the dirty extents, and is reused if there are more than it can hold. Pages written to
+  during this call may not be barriered until the next call.
+
+  \return The bytes barriered.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_type> barrier_dirty(span<buffer_type> scratch, barrier_kind kind = barrier_kind::nowait_data_only, deadline d = deadline()) noexcept;
+
+  /*! \brief Sets the NUMA placement policy for the pages of `region`, or of the whole map if empty.
+
+  The policy affects pages faulted in after this call, so call this before first touching the
+  pages, or set `move_existing` to have the kernel migrate already resident pages to conform.
+  For maps of memory sections backed by `tmpfs`, the policy applies to the section's pages
+  whichever process faults them in.
+
+  \errors Any of the values `mbind()` can return. `errc::operation_not_supported` for policies
+  other than `local` on platforms other than Linux, on which see the `map()` overload taking a policy.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> set_numa_policy(numa_policy policy, buffer_type region = {}, bool move_existing = false) noexcept;
+  /*! \brief Fills `nodes` with the NUMA node backing each page of `region`, or of the whole map if empty.
 
+  Pages not yet faulted in are reported as a negative value.
+
+  \return The nodes filled, one per page from the first page of `region`, which will be fewer than
+  `nodes` if `region` has fewer pages.
+  \errors Any of the values `move_pages()` or `NtQueryVirtualMemory()` can return.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<int>> numa_nodes(span<int> nodes, buffer_type region = {}) const noexcept;
+
+  /*! \brief Faults in every page of `region` now, returning the page aligned region populated.
+  \param region The region to populate.
+  \param for_write Populate as if by writing every page, so the first write to each page takes
+  no fault. The region must be writable.
+  \param asynchronous Populate on a background thread, returning immediately.
+
+  This is what the `section_handle::flag::prefault`, `prefault_write` and `prefault_async` flags
+  do when creating a map. Passed as the `sflags` of a `mapped_file_handle`, those flags prefault
+  the extent of the file upon every `reserve()`. Use this to fault in everything during startup
+  of a latency critical service, rather than taking page faults upon the first requests.
+
+  On Linux 5.14 or later, `MADV_POPULATE_READ` or `MADV_POPULATE_WRITE` is used. Elsewhere, each
+  page is touched, or for asynchronous population, which must remain safe if the region is unmapped
+  before it completes, the system is asked to prefetch the region instead.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<buffer_type> populate(buffer_type region, bool for_write = false, bool asynchronous = false) noexcept;
   //! Ask the system to begin to asynchronously prefetch the span of memory regions given, returning the regions actually prefetched. Note that on Windows 7 or earlier the system call to implement this was not available, and so you will see an empty span returned.
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<span<buffer_type>> prefetch(span<buffer_type> regions) noexcept;
   //! \overload
@@ -726,6 +1028,25 @@ public:
     OUTCOME_TRY(auto &&ret, prefetch(span<buffer_type>(&region, 1)));
     return *ret.data();
   }
+#if !defined(_WIN32) || DOXYGEN_IS_IN_THE_HOUSE
+  /*! \brief Begin to fault in the span of memory regions given through `multiplexer`, without waiting,
+  with `ops[n].result` reporting when `regions[n]` has been paged in.
+
+  Each op is `io_multiplexer::posix_fs_syscall::pending` until its region has been paged in, then zero,
+  or the negated `errno` if paging in failed. Completions are reaped by `check_for_any_completed_io()`
+  as with `io_multiplexer::initiate_posix_fs_syscalls()`, so a query planner can overlap the page in of the
+  next segment with the processing of the current one. `ops` must remain valid until all have completed.
+
+  On Linux 5.14 and later, each region is advised with `MADV_POPULATE_READ`, so completion means its
+  pages are resident and mapped, which the io_uring multiplexer executes without blocking the caller.
+  Otherwise `MADV_WILLNEED` is used, whose completion only means the page in has begun. If `multiplexer`
+  is null, or does not execute syscalls asynchronously, the regions are advised before returning.
+
+  \errors `errc::invalid_argument` if `ops` is smaller than `regions`. Any of the values the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> prefetch(span<buffer_type> regions, span<io_multiplexer::posix_fs_syscall> ops,
+                                                               io_multiplexer *multiplexer = this_thread::multiplexer()) noexcept;
+#endif
 
 #if 0
   /*! \brief Read data from the mapped view.
@@ -1046,6 +1367,135 @@ inline map_handle::io_result<map_handle::const_buffers_type> write(map_handle &s
 
 namespace detail
 {
+  struct map_handle_page_size_counters
+  {
+    std::atomic<size_t> bytes_in_use[4]{};
+    std::atomic<size_t> transparent_huge_page_bytes{0};
+    std::atomic<size_t> fallbacks{0};
+  };
+  inline map_handle_page_size_counters &map_handle_page_size_counters_instance() noexcept
+  {
+    static map_handle_page_size_counters v;
+    return v;
+  }
+  // Copies using stores which bypass the CPU caches where the architecture has them, else memcpy()
+  inline void nontemporal_copy(void *dest, const void *src, size_t bytes) noexcept
+  {
+    auto *d = static_cast<byte *>(dest);
+    const auto *s = static_cast<const byte *>(src);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    // Streaming stores need aligned destinations
+    const size_t head = (size_t)(-(intptr_t) d) & 15;
+    if(bytes < head + 64)
+    {
+      memcpy(d, s, bytes);
+      return;
+    }
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    bytes -= head;
+    for(; bytes >= 64; d += 64, s += 64, bytes -= 64)
+    {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+      const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+      const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d), a);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(d + 48), e);
+    }
+    // Streaming stores are weakly ordered, so order them before any later stores
+    _mm_sfence();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    for(; bytes >= 64; d += 64, s += 64, bytes -= 64)
+    {
+      __asm__ __volatile__("ldp q0, q1, [%1]\n\t"
+                           "ldp q2, q3, [%1, #32]\n\t"
+                           "stnp q0, q1, [%0]\n\t"
+                           "stnp q2, q3, [%0, #32]\n\t"
+                           :
+                           : "r"(d), "r"(s)
+                           : "v0", "v1", "v2", "v3", "memory");
+    }
+    // STNP is not ordered with respect to later stores, so order them
+    __asm__ __volatile__("dmb ishst" ::: "memory");
+#endif
+    memcpy(d, s, bytes);
+  }
+  // Copies into a map, using non-temporal stores if the copy is large enough
+  inline void copy_into_map(void *dest, const void *src, size_t bytes, size_t nontemporal_threshold) noexcept
+  {
+    if(nontemporal_threshold != 0 && bytes >= nontemporal_threshold)
+    {
+      nontemporal_copy(dest, src, bytes);
+    }
+    else
+    {
+      memcpy(dest, src, bytes);
+    }
+  }
+  inline size_t pagesize_index_from_flags(section_handle::flag _flag) noexcept
+  {
+    if((_flag & section_handle::flag::page_sizes_3) == section_handle::flag::page_sizes_3)
+    {
+      return 3;
+    }
+    if((_flag & section_handle::flag::page_sizes_2) == section_handle::flag::page_sizes_2)
+    {
+      return 2;
+    }
+    if((_flag & section_handle::flag::page_sizes_1) == section_handle::flag::page_sizes_1)
+    {
+      return 1;
+    }
+    return 0;
+  }
+  inline section_handle::flag pagesize_flags_from_index(size_t idx) noexcept
+  {
+    switch(idx)
+    {
+    case 1:
+      return section_handle::flag::page_sizes_1;
+    case 2:
+      return section_handle::flag::page_sizes_2;
+    case 3:
+      return section_handle::flag::page_sizes_3;
+    default:
+      return section_handle::flag::none;
+    }
+  }
+  /* Sorts regions by address, rounds each to pagesize and merges those which overlap or
+  touch, returning the merged regions at the front of the input.
+  */
+  inline result<span<map_handle::buffer_type>> coalesce_map_regions(span<map_handle::buffer_type> regions, size_t pagesize) noexcept
+  {
+    for(auto &region : regions)
+    {
+      if(region.data() == nullptr)
+      {
+        return errc::invalid_argument;
+      }
+      if(pagesize > 1)
+      {
+        region = utils::round_to_page_size_larger(region, pagesize);
+      }
+    }
+    std::sort(regions.begin(), regions.end(), [](const map_handle::buffer_type &a, const map_handle::buffer_type &b) { return a.data() < b.data(); });
+    size_t out = 0;
+    for(size_t n = 0; n < regions.size(); n++)
+    {
+      if(out > 0 && regions[n].data() <= regions[out - 1].data() + regions[out - 1].size())
+      {
+        byte *end = (std::max)(regions[n].data() + regions[n].size(), regions[out - 1].data() + regions[out - 1].size());
+        regions[out - 1] = {regions[out - 1].data(), (size_t)(end - regions[out - 1].data())};
+        continue;
+      }
+      regions[out++] = regions[n];
+    }
+    return span<map_handle::buffer_type>(regions.data(), out);
+  }
   inline result<size_t> pagesize_from_flags(section_handle::flag _flag) noexcept
   {
     try
@@ -1084,6 +1534,33 @@ namespace detail
   }
 }  // namespace detail
 
+inline void map_handle::_account_page_size(ptrdiff_t bytes) const noexcept
+{
+  if(bytes == 0 || !(_flag & section_handle::flag::page_sizes_fallback))
+  {
+    return;
+  }
+  auto &counters = detail::map_handle_page_size_counters_instance();
+  counters.bytes_in_use[detail::pagesize_index_from_flags(_flag)].fetch_add((size_t) bytes, std::memory_order_relaxed);
+  if(_flag & section_handle::flag::transparent_huge_pages)
+  {
+    counters.transparent_huge_page_bytes.fetch_add((size_t) bytes, std::memory_order_relaxed);
+  }
+}
+
+inline map_handle::page_size_statistics_t map_handle::page_size_statistics() noexcept
+{
+  auto &counters = detail::map_handle_page_size_counters_instance();
+  page_size_statistics_t ret{};
+  for(size_t n = 0; n < 4; n++)
+  {
+    ret.bytes_in_use[n] = counters.bytes_in_use[n].load(std::memory_order_relaxed);
+  }
+  ret.transparent_huge_page_bytes = counters.transparent_huge_page_bytes.load(std::memory_order_relaxed);
+  ret.fallbacks = counters.fallbacks.load(std::memory_order_relaxed);
+  return ret;
+}
+
 LLFIO_V2_NAMESPACE_END
 
 #if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
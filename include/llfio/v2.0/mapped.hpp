@@ -28,6 +28,8 @@ Distributed under the Boost Software License, Version 1.0.
 #include "mapped_file_handle.hpp"
 #include "utils.hpp"
 
+#include <iterator>
+
 //! \file mapped.hpp Provides typed view of mapped section.
 
 LLFIO_V2_NAMESPACE_BEGIN
@@ -69,6 +71,137 @@ namespace detail
 #endif
 }  // namespace detail
 
+/*! \brief A forward iterator over a mapped array of `T` which asks the system to page in the array a
+distance ahead of the iterator, and to evict it from the resident set a distance behind.
+
+A sequential scan of an array much larger than memory through an ordinary iterator runs at the latency
+of page faults, and fills memory with pages never to be used again, which evicts the working set of the
+process. Iterating with this instead issues `map_handle::prefetch()` for `prefetch_distance` bytes ahead,
+so scans run at the bandwidth of the storage, and `map_handle::evict()` for the pages more than
+`evict_distance` bytes behind, so the resident set stays flat. Both are done once per step of a quarter
+of `prefetch_distance`, so incrementing the iterator usually costs one comparison more than a pointer
+increment. Failures of either are ignored, as they are only advice.
+
+Copies of the iterator share nothing, so only iterate one copy. Iterating backwards is not supported.
+Obtain instances from `mapped<T>::scan()`, or construct one over any region of a `map_handle`.
+*/
+template <class T> class mapped_cursor
+{
+public:
+  //! The size type.
+  using size_type = typename map_handle::size_type;
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename std::remove_cv<T>::type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T *;
+  using reference = T &;
+
+  //! The default for `prefetch_distance`.
+  static constexpr size_type default_prefetch_distance = 64 * 1024 * 1024;
+
+private:
+  map_handle *_mh{nullptr};
+  T *_pos{nullptr}, *_end{nullptr};
+  size_type _prefetch_distance{0}, _evict_distance{0}, _step{0};
+  byte *_next_step{nullptr};                            // when _pos reaches this, advance the windows
+  byte *_prefetched_to{nullptr}, *_evicted_to{nullptr};  // the ends of the regions prefetched and evicted so far
+
+  void _advance() noexcept
+  {
+    auto *pos = reinterpret_cast<byte *>(_pos);
+    auto *end = reinterpret_cast<byte *>(_end);
+    _next_step = (size_type)(end - pos) > _step ? pos + _step : end;
+    if(_prefetch_distance != 0)
+    {
+      byte *prefetch_to = (size_type)(end - pos) > _prefetch_distance ? pos + _prefetch_distance : end;
+      if(prefetch_to > _prefetched_to)
+      {
+        (void) map_handle::prefetch(utils::round_to_page_size_larger(map_handle::buffer_type{_prefetched_to, (size_type)(prefetch_to - _prefetched_to)}, _mh->page_size()));
+        _prefetched_to = prefetch_to;
+      }
+    }
+    if(_evict_distance != (size_type) -1 && (size_type)(pos - _evicted_to) > _evict_distance)
+    {
+      byte *evict_to = pos - _evict_distance;
+      // Evicts whole pages only, so the remnant is evicted with the next step
+      auto evicted = _mh->evict({_evicted_to, (size_type)(evict_to - _evicted_to)});
+      if(evicted && !evicted.value().empty())
+      {
+        _evicted_to = evicted.value().data() + evicted.value().size();
+      }
+    }
+  }
+
+public:
+  //! Default constructs an iterator equal to any other at the end of its region
+  constexpr mapped_cursor() {}  // NOLINT
+  /*! \brief Constructs an iterator positioned at the front of `region`, which must lie within `mh`, or
+  one positioned at its end if `at_end` is true, which does not prefetch nor evict.
+
+  \param mh The map within which `region` lies.
+  \param region The array of `T` to iterate.
+  \param prefetch_distance The bytes ahead of the iterator to page in. Zero means none.
+  \param evict_distance The bytes behind the iterator beyond which to evict pages. `(size_type) -1`
+  means never evict.
+  \param at_end Construct an iterator positioned at the end of `region`.
+  */
+  mapped_cursor(map_handle &mh, span<T> region, size_type prefetch_distance = default_prefetch_distance, size_type evict_distance = 0, bool at_end = false) noexcept
+      : _mh(&mh)
+      , _pos(region.data() + (at_end ? region.size() : 0))
+      , _end(region.data() + region.size())
+      , _prefetch_distance(prefetch_distance)
+      , _evict_distance(evict_distance)
+  {
+    if(at_end)
+    {
+      _next_step = reinterpret_cast<byte *>(_end);
+      return;
+    }
+    _step = utils::round_up_to_page_size((std::max)(prefetch_distance / 4, (size_type) 1), mh.page_size());
+    _prefetched_to = _evicted_to = reinterpret_cast<byte *>(_pos);
+    _advance();
+  }
+
+  //! The element at the position of the iterator
+  reference operator*() const noexcept { return *_pos; }
+  //! \overload
+  pointer operator->() const noexcept { return _pos; }
+  //! The position of the iterator
+  pointer position() const noexcept { return _pos; }
+
+  //! Advances the iterator by one element
+  mapped_cursor &operator++() noexcept
+  {
+    if(reinterpret_cast<byte *>(++_pos) >= _next_step && _pos < _end)
+    {
+      _advance();
+    }
+    return *this;
+  }
+  //! \overload
+  mapped_cursor operator++(int) noexcept
+  {
+    mapped_cursor ret(*this);
+    ++*this;
+    return ret;
+  }
+  //! Advances the iterator by `n` elements, which must not pass the end
+  mapped_cursor &operator+=(size_type n) noexcept
+  {
+    _pos += n;
+    if(reinterpret_cast<byte *>(_pos) >= _next_step && _pos < _end)
+    {
+      _advance();
+    }
+    return *this;
+  }
+
+  //! True if both iterators are at the same position
+  bool operator==(const mapped_cursor &o) const noexcept { return _pos == o._pos; }
+  //! True if the iterators are at different positions
+  bool operator!=(const mapped_cursor &o) const noexcept { return _pos != o._pos; }
+};
+
 /*! \brief Provides an owning, typed view of memory mapped from a `section_handle` or a `file_handle` suitable
 for feeding to STL algorithms or the Ranges TS.
 
@@ -190,6 +323,21 @@ public:
   //! Returns a span referring to this mapped region
   span<T> as_span() const noexcept { return *this; }
 
+  //! A range of `mapped_cursor<T>` over a mapped region
+  struct scan_range
+  {
+    mapped_cursor<T> first, last;
+    mapped_cursor<T> begin() const noexcept { return first; }
+    mapped_cursor<T> end() const noexcept { return last; }
+  };
+  /*! \brief Returns a range for sequentially scanning this mapped region which pages in the region
+  `prefetch_distance` bytes ahead, and evicts it from memory `evict_distance` bytes behind. See `mapped_cursor<T>`.
+  */
+  scan_range scan(size_type prefetch_distance = mapped_cursor<T>::default_prefetch_distance, size_type evict_distance = 0) noexcept
+  {
+    return {mapped_cursor<T>(_maph, *this, prefetch_distance, evict_distance), mapped_cursor<T>(_maph, *this, 0, 0, true)};
+  }
+
   using span<T>::first;
   using span<T>::last;
   using span<T>::subspan;
@@ -24,6 +24,9 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "map_handle.hpp"
 
+#include <memory>  // for unique_ptr
+#include <thread>  // for yield
+
 //! \file mapped_file_handle.hpp Provides mapped_file_handle
 
 #ifndef LLFIO_MAPPED_FILE_HANDLE_H
@@ -130,6 +133,23 @@ permanently for all processes** using that file.
 
 So long as you ensure that any shared mapped file is always opened first with writable
 privileges, which is usually the case, all works like POSIX on Microsoft Windows.
+
+## Concurrent appending
+
+`reserve()` and `truncate()` need external serialisation, which is unhelpful for many threads
+appending records to one mapped log. After `begin_concurrent_append()`, any number of threads
+may call `claim_append()` concurrently, which atomically claims a byte range at the tail for the
+caller to write into directly. The file and map are grown in steps ahead of the tail, by whichever
+claim first crosses halfway into the final step, while the other threads carry on claiming within the
+already grown extent. As the address of the map must not change, the reservation is the ceiling
+for appends, so reserve generously. `end_concurrent_append()` truncates the file to the tail.
+
+## Zero copy reads
+
+`read()` never copies memory, it returns buffers pointing into the map, however nothing stops
+those buffers dangling after a `truncate()` or `reserve()`. `view()` returns a `pinned_view`
+instead, and whilst any are alive, shrinking the map and relocating its address fail with
+`errc::device_or_resource_busy`.
 */
 class LLFIO_DECL mapped_file_handle : public file_handle
 {
@@ -152,9 +172,21 @@ public:
   template <class T> using io_result = io_handle::io_result<T>;
 
 protected:
+  struct _append_state_t
+  {
+    std::atomic<extent_type> tail{0};    // The next byte to be claimed
+    std::atomic<extent_type> length{0};  // The length of the file, grown ahead of the tail
+    std::atomic<bool> growing{false};
+    extent_type step{0};
+  };
+
   size_type _reservation{0};
   section_handle _sh;  // Tracks the file (i.e. *this) somewhat lazily
   map_handle _mh;      // The current map with valid extent
+  std::unique_ptr<_append_state_t> _append;
+  mutable std::atomic<size_t> _pins{0};  // count of pinned_view instances alive
+
+  inline result<void> _grow_for_append(extent_type end) noexcept;
 
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC size_t _do_max_buffers() const noexcept override { return _mh.max_buffers(); }
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_barrier(io_request<const_buffers_type> reqs = io_request<const_buffers_type>(),
@@ -209,6 +241,7 @@ protected:
   }
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC io_result<const_buffers_type> _do_write(io_request<const_buffers_type> reqs, deadline d = deadline()) noexcept override
   {
+    _invalidate_extent_map();
     if(!!(_sh.section_flags() & section_handle::flag::write_via_syscall))
     {
       const auto batch = max_buffers();
@@ -258,7 +291,9 @@ public:
       , _reservation(o._reservation)
       , _sh(std::move(o._sh))
       , _mh(std::move(o._mh))
+      , _append(std::move(o._append))
   {
+    assert(o._pins.load(std::memory_order_relaxed) == 0);  // views would refer to the moved from handle
     _sh.set_backing(this);
     _mh.set_section(&_sh);
   }
@@ -453,6 +488,11 @@ public:
   //! True if the map is of non-volatile RAM
   bool is_nvram() const noexcept { return _mh.is_nvram(); }
 
+  //! The size of buffer at and above which `write()` copies into the map using non-temporal stores. Zero means never.
+  size_type nontemporal_write_threshold() const noexcept { return _mh.nontemporal_write_threshold(); }
+  //! Sets the size of buffer at and above which `write()` copies into the map using non-temporal stores. See `map_handle::set_nontemporal_write_threshold()`.
+  void set_nontemporal_write_threshold(size_type bytes) noexcept { _mh.set_nontemporal_write_threshold(bytes); }
+
   //! The maximum extent of the underlying file
   result<extent_type> underlying_file_maximum_extent() const noexcept { return file_handle::maximum_extent(); }
 
@@ -463,8 +503,14 @@ public:
   \param reservation The number of bytes of virtual address space to reserve. Zero means reserve
   the current length of the underlying file.
 
-  Note that this is an expensive call, and `address()` may return a different value afterwards.
+  Note that this can be an expensive call, and `address()` may return a different value afterwards.
   This call will fail if the underlying file has zero length.
+
+  On POSIX the existing map is resized if possible, which keeps the pages already faulted in mapped,
+  so growing a large map does not fault it all in again. On Linux this uses `mremap()`, which
+  relocates the page tables if the map must move. Elsewhere the map is extended only if the address
+  space after it is free, otherwise it is replaced. Whilst views are pinned,
+  `errc::device_or_resource_busy` is returned.
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_type> reserve(size_type reservation = 0) noexcept;
 
@@ -484,6 +530,41 @@ public:
     return mapped_file_handle(std::move(fh), reservation, _sh.section_flags());
   }
   LLFIO_DEADLINE_TRY_FOR_UNTIL(reopen)
+  /*! \brief Returns a mapped point-in-time copy of this file's contents, which this handle may
+  then continue to mutate without affecting the copy.
+
+  A `MAP_PRIVATE` or `FILE_MAP_COPY` map of this file is not a snapshot, as pages not yet
+  copied-on-write by the private map continue to show later changes made through the shared map.
+  Instead, this creates an anonymous temporary inode next to this file, and clones this file's
+  extents into it using `clone_extents_to()`. On filing systems which can share extents
+  copy-on-write (e.g. btrfs, XFS, ZFS, ReFS, APFS), this is a metadata only operation regardless
+  of file size, and the extents only diverge as this handle subsequently writes to them.
+
+  Writers should be quiescent for the duration of this call, which is brief if extents can be cloned.
+
+  \param reservation The number of bytes to reserve for the snapshot's map. Zero means its length.
+  \param emulate_if_unsupported If false, fail rather than copy the contents if the filing system
+  cannot clone extents.
+  \param d The deadline passed to `clone_extents_to()`.
+  */
+  result<mapped_file_handle> snapshot(size_type reservation = 0, bool emulate_if_unsupported = true, deadline d = {}) noexcept
+  {
+    OUTCOME_TRY(auto &&length, underlying_file_maximum_extent());
+    // Extents can only be cloned within the same filing system, so prefer this file's directory
+    auto dirh = parent_path_handle();
+    auto tempfh = dirh ? file_handle::temp_inode(dirh.value()) : file_handle::temp_inode();
+    if(!tempfh && dirh)
+    {
+      tempfh = file_handle::temp_inode();
+    }
+    OUTCOME_TRY(auto &&fh, std::move(tempfh));
+    OUTCOME_TRYV(file_handle::clone_extents_to(fh, d, false, emulate_if_unsupported));
+    // Any trailing hole was not cloned
+    OUTCOME_TRYV(fh.truncate(length));
+    mapped_file_handle ret(std::move(fh), section_handle::flag::none);
+    OUTCOME_TRYV(ret.reserve(reservation));
+    return {std::move(ret)};
+  }
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<void> set_multiplexer(io_multiplexer *c = this_thread::multiplexer()) noexcept override
   {
     OUTCOME_TRY(file_handle::set_multiplexer(c));
@@ -535,6 +616,36 @@ public:
   */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> update_map() noexcept;
 
+  /*! \brief Enters concurrent append mode, with appends beginning at the current maximum extent
+  of the file.
+
+  The file is immediately grown by `step`, and thereafter by `step` whenever a claim comes
+  within half a step of the end of the file. Until `end_concurrent_append()`, the file will
+  appear to others to have up to a step of zeros after the tail. If the reservation cannot
+  hold the first step, `reserve()` is called to enlarge it, which may change `address()`.
+  Only `claim_append()` and `append_tail()` may be called concurrently in this mode.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> begin_concurrent_append(extent_type step = 64 * 1024 * 1024) noexcept;
+  /*! \brief Atomically claims `bytes` at the tail of the file, returning where within the map
+  to write them. Lock free.
+
+  This only blocks if the file needs to grow, either for the one caller whose claim first comes
+  within half a step of the end of the file, or for callers whose claims lie beyond the end of
+  the file while it is being grown.
+
+  \errors `errc::invalid_argument` if not in concurrent append mode, `errc::file_too_large` if
+  the claim would exceed the reservation. If growing the file fails, the error is returned and the
+  claimed range is never written.
+  */
+  inline result<buffer_type> claim_append(size_type bytes) noexcept;
+  //! The next byte which `claim_append()` will claim, or zero if not in concurrent append mode.
+  extent_type append_tail() const noexcept { return _append ? _append->tail.load(std::memory_order_relaxed) : 0; }
+  /*! \brief Leaves concurrent append mode, truncating the file to the tail. No claims
+  may be in progress.
+  \return The new maximum extent of the file.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<extent_type> end_concurrent_append() noexcept;
+
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_type> zero(extent_pair extent, deadline /*unused*/ = deadline()) noexcept override
   {
     OUTCOME_TRYV(_mh.zero_memory({_mh.address() + extent.offset, (size_type) extent.length}));
@@ -558,6 +669,122 @@ public:
   */
 #endif
   using file_handle::read;
+
+  /*! \class pinned_view
+  \brief A read only view into the map of a `mapped_file_handle`, which prevents the map
+  from being shrunk or relocated for its lifetime. The handle must not be moved nor closed
+  whilst views are alive.
+  */
+  class pinned_view
+  {
+    friend class mapped_file_handle;
+    const mapped_file_handle *_parent{nullptr};
+    const_buffer_type _view;
+
+    pinned_view(const mapped_file_handle *parent, const_buffer_type view) noexcept
+        : _parent(parent)
+        , _view(view)
+    {
+      _parent->_pins.fetch_add(1, std::memory_order_acquire);
+    }
+
+  public:
+    //! Default constructor
+    pinned_view() {}  // NOLINT
+    //! Move construction permitted
+    pinned_view(pinned_view &&o) noexcept
+        : _parent(o._parent)
+        , _view(o._view)
+    {
+      o._parent = nullptr;
+      o._view = {};
+    }
+    //! No copy construction
+    pinned_view(const pinned_view &) = delete;
+    //! Move assignment permitted
+    pinned_view &operator=(pinned_view &&o) noexcept
+    {
+      if(this == &o)
+      {
+        return *this;
+      }
+      reset();
+      _parent = o._parent;
+      _view = o._view;
+      o._parent = nullptr;
+      o._view = {};
+      return *this;
+    }
+    //! No copy assignment
+    pinned_view &operator=(const pinned_view &) = delete;
+    ~pinned_view() { reset(); }
+
+    //! Unpins the map, and empties the view
+    void reset() noexcept
+    {
+      if(_parent != nullptr)
+      {
+        _parent->_pins.fetch_sub(1, std::memory_order_release);
+        _parent = nullptr;
+      }
+      _view = {};
+    }
+    //! The bytes viewed
+    const_buffer_type buffer() const noexcept { return _view; }
+    //! The bytes viewed
+    operator const_buffer_type() const noexcept { return _view; }
+    //! The address of the bytes viewed
+    const byte *data() const noexcept { return _view.data(); }
+    //! The number of bytes viewed
+    size_type size() const noexcept { return _view.size(); }
+    //! True if no bytes are viewed
+    bool empty() const noexcept { return _view.empty(); }
+  };
+
+  /*! \brief Returns a view of `bytes` of the map from `offset`, pinning the map against
+  shrinking and relocation until the view is destroyed.
+
+  The view is truncated to the current length of the map, so may be empty. No memory is copied.
+  \errors `errc::not_enough_memory` if the file has a length but could not be mapped.
+  */
+  result<pinned_view> view(extent_type offset, size_type bytes) const noexcept
+  {
+    const extent_type length = _mh.length();
+    if(_mh.address() == nullptr && length > 0)
+    {
+      return errc::not_enough_memory;  // reserve() failed probably due to VMA exhaustion
+    }
+    if(offset >= length)
+    {
+      return pinned_view(this, {_mh.address(), 0});
+    }
+    if(bytes > length - offset)
+    {
+      bytes = (size_type)(length - offset);
+    }
+    return pinned_view(this, {_mh.address() + offset, bytes});
+  }
+  //! The number of `pinned_view` instances currently pinning the map
+  size_t pinned_views() const noexcept { return _pins.load(std::memory_order_relaxed); }
+
+  using file_handle::clone_extents_to;
+  /*! \brief Clones extents as per `file_handle::clone_extents_to()`, with this handle's map pinned
+  against shrinking and relocation for the duration, unless cloning within this file.
+
+  Where bytes must be copied rather than cloned, they are written into `dest` directly
+  from the map, as `read()` returns views into the map, so the source is never copied twice.
+  */
+  LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<extent_pair> clone_extents_to(extent_pair extent, io_handle &dest, io_handle::extent_type destoffset, deadline d = {},
+                                                                       bool force_copy_now = false, bool emulate_if_unsupported = true) noexcept override
+  {
+    pinned_view pin;
+    if(&dest != this)
+    {
+      OUTCOME_TRY(auto &&v, view(0, (size_type) -1));
+      pin = std::move(v);
+    }
+    return file_handle::clone_extents_to(extent, dest, destoffset, d, force_copy_now, emulate_if_unsupported);
+  }
 #if 0
   /*! \brief Write data to the mapped file.
 
@@ -586,6 +813,69 @@ public:
   using file_handle::write;
 };
 
+inline result<void> mapped_file_handle::_grow_for_append(extent_type end) noexcept
+{
+  auto &state = *_append;
+  // Done once the file extends half a step beyond the claim, or as far as it can go
+  const extent_type sought = (std::min)(end + state.step / 2, (extent_type) _reservation);
+  for(;;)
+  {
+    extent_type length = state.length.load(std::memory_order_acquire);
+    if(length >= sought)
+    {
+      return success();
+    }
+    bool expected = false;
+    if(state.growing.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+      auto ungrowing = make_scope_exit([&state]() noexcept { state.growing.store(false, std::memory_order_release); });
+      length = state.length.load(std::memory_order_relaxed);
+      if(length >= sought)
+      {
+        return success();
+      }
+      extent_type newlength = length + state.step;
+      while(newlength < sought)
+      {
+        newlength += state.step;
+      }
+      newlength = (std::min)(newlength, (extent_type) _reservation);
+      // Within the reservation, this never changes the address of the map
+      OUTCOME_TRYV(mapped_file_handle::truncate(newlength));
+      state.length.store(newlength, std::memory_order_release);
+      return success();
+    }
+    // Someone else is growing the file, which we need only wait for if our claim is beyond its end
+    if(length >= end)
+    {
+      return success();
+    }
+    std::this_thread::yield();
+  }
+}
+
+inline result<mapped_file_handle::buffer_type> mapped_file_handle::claim_append(size_type bytes) noexcept
+{
+  if(!_append)
+  {
+    return errc::invalid_argument;
+  }
+  auto &state = *_append;
+  extent_type offset = state.tail.load(std::memory_order_relaxed);
+  do
+  {
+    if(offset + bytes > _reservation)
+    {
+      return errc::file_too_large;
+    }
+  } while(!state.tail.compare_exchange_weak(offset, offset + bytes, std::memory_order_relaxed, std::memory_order_relaxed));
+  if(offset + bytes + state.step / 2 > state.length.load(std::memory_order_acquire))
+  {
+    OUTCOME_TRYV(_grow_for_append(offset + bytes));
+  }
+  return buffer_type{_mh.address() + offset, bytes};
+}
+
 //! \brief Constructor for `mapped_file_handle`
 template <> struct construct<mapped_file_handle>
 {
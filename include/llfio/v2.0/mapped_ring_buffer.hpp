@@ -0,0 +1,172 @@
+/* A ring buffer of memory section mapped twice back to back
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_MAPPED_RING_BUFFER_H
+#define LLFIO_MAPPED_RING_BUFFER_H
+
+#include "map_handle.hpp"
+
+//! \file mapped_ring_buffer.hpp Provides `mapped_ring_buffer`
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+/*! \class mapped_ring_buffer
+\brief A ring buffer of memory section which is mapped twice, back to back, so that any
+span of up to `capacity()` bytes beginning anywhere within the first map is contiguous
+in memory.
+
+This lets producers and consumers write and read spans which wrap around the end of the
+ring directly, without splitting them in two or copying them at the wrap boundary. Writes
+to `address()[n]` appear at `address()[n + capacity()]`, and vice versa.
+
+The capacity is rounded up to the page size, or to the allocation granularity of 64Kb on
+Microsoft Windows. On Windows, the double mapping may fail if other threads are concurrently
+mapping memory, in which case it is retried a few times.
+
+For convenience, a lock free single producer single consumer queue discipline is provided
+by `write_span()`, `commit_write()`, `read_span()` and `commit_read()`. You can ignore these
+entirely and use `address()` directly if you prefer your own.
+*/
+class LLFIO_DECL mapped_ring_buffer
+{
+public:
+  using size_type = map_handle::size_type;
+  using buffer_type = map_handle::buffer_type;
+  using const_buffer_type = map_handle::const_buffer_type;
+
+protected:
+  section_handle _sh;
+  byte *_addr{nullptr};
+  size_type _capacity{0};
+  std::atomic<uint64_t> _head{0};  // bytes ever written
+  std::atomic<uint64_t> _tail{0};  // bytes ever read
+
+  // Maps _sh twice back to back, setting _addr
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> _map_twice() noexcept;
+
+public:
+  //! Default constructor
+  constexpr mapped_ring_buffer() {}  // NOLINT
+  //! Implicit move construction permitted. Not thread safe with respect to the queue positions.
+  mapped_ring_buffer(mapped_ring_buffer &&o) noexcept
+      : _sh(std::move(o._sh))
+      , _addr(o._addr)
+      , _capacity(o._capacity)
+      , _head(o._head.load(std::memory_order_relaxed))
+      , _tail(o._tail.load(std::memory_order_relaxed))
+  {
+    o._addr = nullptr;
+    o._capacity = 0;
+  }
+  //! No copy construction
+  mapped_ring_buffer(const mapped_ring_buffer &) = delete;
+  //! Move assignment permitted
+  mapped_ring_buffer &operator=(mapped_ring_buffer &&o) noexcept
+  {
+    if(this == &o)
+    {
+      return *this;
+    }
+    this->~mapped_ring_buffer();
+    new(this) mapped_ring_buffer(std::move(o));
+    return *this;
+  }
+  //! No copy assignment
+  mapped_ring_buffer &operator=(const mapped_ring_buffer &) = delete;
+  ~mapped_ring_buffer()
+  {
+    if(_addr != nullptr)
+    {
+      (void) mapped_ring_buffer::close();
+    }
+  }
+
+  /*! \brief Create a ring buffer of at least `bytes` capacity, backed by an anonymous section.
+  \param bytes The minimum capacity of the ring, which is rounded up to the page size (POSIX) or 64Kb (Windows).
+  \param dirh Where to create the anonymous, managed file backing the section. Memory backed temporary
+  files avoid the contents being written to storage. If invalid, because the system has no memory
+  backed temporary files directory, `path_discovery::storage_backed_temporary_files_directory()` is used.
+
+  \errors Any of the values `section_handle::section()`, `mmap()` or `MapViewOfFileEx()` can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<mapped_ring_buffer> ring_buffer(size_type bytes, const path_handle &dirh = path_discovery::memory_backed_temporary_files_directory()) noexcept;
+
+  //! Unmaps the ring and closes its section
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> close() noexcept;
+
+  //! True if the ring is mapped
+  bool is_valid() const noexcept { return _addr != nullptr; }
+  //! The address of the first of the two maps, which is `2 * capacity()` bytes long
+  byte *address() const noexcept { return _addr; }
+  //! The number of bytes in the ring
+  size_type capacity() const noexcept { return _capacity; }
+  //! The memory section mapped twice
+  const section_handle &section() const noexcept { return _sh; }
+
+  //! The number of bytes written but not yet read
+  size_type size() const noexcept { return (size_type)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire)); }
+  //! True if there is nothing to read
+  bool empty() const noexcept { return size() == 0; }
+
+  //! \brief Producer only. The contiguous span of ring which can be written into, beginning after the last byte written.
+  buffer_type write_span() noexcept
+  {
+    const auto head = _head.load(std::memory_order_relaxed);
+    const auto tail = _tail.load(std::memory_order_acquire);
+    return {_addr + (head % _capacity), (size_type)(_capacity - (head - tail))};
+  }
+  //! \brief Producer only. Publishes `bytes` written into the front of `write_span()` to the consumer.
+  void commit_write(size_type bytes) noexcept
+  {
+    assert(bytes <= _capacity - size());
+    _head.store(_head.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+  }
+  //! \brief Consumer only. The contiguous span of ring which can be read, beginning after the last byte read.
+  const_buffer_type read_span() noexcept
+  {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+    const auto head = _head.load(std::memory_order_acquire);
+    return {_addr + (tail % _capacity), (size_type)(head - tail)};
+  }
+  //! \brief Consumer only. Releases `bytes` read from the front of `read_span()` back to the producer.
+  void commit_read(size_type bytes) noexcept
+  {
+    assert(bytes <= size());
+    _tail.store(_tail.load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+  }
+};
+
+LLFIO_V2_NAMESPACE_END
+
+#if LLFIO_HEADERS_ONLY == 1 && !defined(DOXYGEN_SHOULD_SKIP_THIS)
+#define LLFIO_INCLUDED_BY_HEADER 1
+#ifdef _WIN32
+#include "detail/impl/windows/mapped_ring_buffer.ipp"
+#else
+#include "detail/impl/posix/mapped_ring_buffer.ipp"
+#endif
+#undef LLFIO_INCLUDED_BY_HEADER
+#endif
+
+#endif
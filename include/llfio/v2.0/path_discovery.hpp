@@ -87,6 +87,12 @@ namespace path_discovery
   directory to verify its validity, this is not a fast call. It is however cached statically, so the
   cost occurs exactly once per process, unless someone calls `all_temporary_directories(true)` to wipe and refresh
   the master list. An internal mutex is held for the duration of this call.
+
+  On Linux, the outcome of the probing is additionally cached in the runtime directory of the effective
+  user (`/run/user/<euid>`), so later processes only need to open and stat the directories previously
+  found to be writable, and check that their `st_dev` and `st_ino` have not changed. If the candidate
+  directories differ, or any directory was remounted or replaced, the full probe is performed again.
+  If the cache is older than ten minutes, it is refreshed by a detached background thread.
   \mallocs None.
   \errors This call never fails, though if it fails to find any writable temporary directory, it will
   terminate the process.
@@ -114,6 +120,10 @@ namespace path_discovery
 
   `tmpfs|ramfs`
 
+  If more than one memory backed directory is available, on Linux the one whose mount memory policy
+  (`mpol=`) binds or prefers the NUMA node of the calling thread is preferred, then those with no
+  policy, and those bound to other NUMA nodes last.
+
   The handle is created during `verified_temporary_directories()` and is statically cached thereafter.
 
   \note If you wish to create an anonymous memory-backed inode for mmap and paging tricks like mapping
@@ -179,11 +179,14 @@ public:
   \param flags Any additional custom behaviours.
   \param base Handle to a base location on the filing system.
   Defaults to `path_discovery::temporary_named_pipes_directory()`.
+  \param capacity If not zero, the bytes the pipe's buffer can hold, which the kernel may round up.
+  High volume producers are context switched far less with buffers larger than the default 64Kb.
+  Ignored on POSIX platforms other than Linux, and on Windows unless the pipe is created.
 
-  \errors Any of the values POSIX `open()`, `mkfifo()`, `NtCreateFile()` or `NtCreateNamedPipeFile()` can return.
+  \errors Any of the values POSIX `open()`, `mkfifo()`, `fcntl()`, `NtCreateFile()` or `NtCreateNamedPipeFile()` can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
-  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<pipe_handle> pipe(path_view_type path, mode _mode, creation _creation, caching _caching = caching::all, flag flags = flag::none, const path_handle &base = path_discovery::temporary_named_pipes_directory()) noexcept;
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<pipe_handle> pipe(path_view_type path, mode _mode, creation _creation, caching _caching = caching::all, flag flags = flag::none, const path_handle &base = path_discovery::temporary_named_pipes_directory(), size_t capacity = 0) noexcept;
   /*! Convenience overload for `pipe()` creating a new named pipe if
   needed, and with read-only privileges. Unless `flag::multiplexable`
   is specified, this will block until the other end connects.
@@ -230,10 +233,12 @@ public:
   Unlike Windows' `CreatePipe()`, this function can create non-blocking
   anonymous pipes. These are truly anonymous, not just randomly named.
 
-  \errors Any of the values POSIX `pipe()` or `NtCreateNamedPipeFile()` can return.
+  If `capacity` is not zero, it is the bytes the pipe's buffer can hold, as for `pipe()`.
+
+  \errors Any of the values POSIX `pipe()`, `fcntl()` or `NtCreateNamedPipeFile()` can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
-  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::pair<pipe_handle, pipe_handle>> anonymous_pipe(caching _caching = caching::all, flag flags = flag::none) noexcept;
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::pair<pipe_handle, pipe_handle>> anonymous_pipe(caching _caching = caching::all, flag flags = flag::none, size_t capacity = 0) noexcept;
 
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC ~pipe_handle() override
   {
@@ -267,6 +272,110 @@ public:
     return io_handle::close();
   }
 
+  /*! \brief Returns the bytes the pipe's buffer can hold.
+
+  \errors Any of the values `fcntl(F_GETPIPE_SZ)` or `GetNamedPipeInfo()` can return.
+  `errc::operation_not_supported` on POSIX platforms other than Linux.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> capacity() const noexcept;
+  /*! \brief Sets the bytes the pipe's buffer can hold, returning the capacity set, which the kernel
+  may have rounded up to a power of two number of pages.
+
+  On Linux unprivileged processes may not exceed `/proc/sys/fs/pipe-max-size`, which defaults to
+  1Mb. The buffer cannot be shrunk to less than the bytes currently in it.
+
+  \errors Any of the values `fcntl(F_SETPIPE_SZ)` can return. `errc::operation_not_supported` on
+  platforms other than Linux, and on Windows where the capacity is fixed on creation.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> set_capacity(size_t bytes) noexcept;
+
+  /*! \brief Moves up to `bytes` out of this pipe into `dest` at `offset`, without copying them
+  through user space where possible.
+
+  \return The bytes moved, which may be fewer than `bytes`. Zero means the write end of this pipe
+  has been closed.
+  \param dest The handle to write into, usually a `file_handle` or another `pipe_handle`.
+  \param offset The offset to write at, ignored if `dest` is not seekable.
+  \param bytes The maximum bytes to move.
+  \param d An optional deadline, which requires this pipe to be nonblocking.
+
+  On Linux this is `splice()`, which moves pages from the pipe into the page cache of `dest`, so
+  streaming a pipe into a file costs no copies through user space. If `dest` cannot be spliced
+  into, and on other platforms, the bytes are read into a bounce buffer and written to `dest`,
+  up to 64Kb at a time. Asynchronous splicing is available from io_uring multiplexers via
+  `io_multiplexer::posix_fs_syscall::kind::splice`.
+
+  \errors Any of the values which `splice()`, `read()` or `write()` can return.
+  \mallocs None.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> splice_to(io_handle &dest, extent_type offset, size_t bytes, deadline d = {}) noexcept;
+
+  /*! \brief Moves up to `bytes` from `src` at `offset` into this pipe, without copying them
+  through user space where possible.
+
+  \return The bytes moved, which may be fewer than `bytes`. Zero means `src` was at its end.
+  \param src The handle to read from, usually a `file_handle` or another `pipe_handle`.
+  \param offset The offset to read from, ignored if `src` is not seekable.
+  \param bytes The maximum bytes to move.
+  \param d An optional deadline, which requires this pipe to be nonblocking.
+
+  On Linux this is `splice()`, otherwise as for `splice_to()`.
+
+  \errors Any of the values which `splice()`, `read()` or `write()` can return.
+  \mallocs None.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> splice_from(io_handle &src, extent_type offset, size_t bytes, deadline d = {}) noexcept;
+
+  /*! \brief Maps the pages of `buffers` into this pipe, rather than copying them.
+
+  \return The bytes mapped, which may be fewer than requested.
+  \param buffers The memory to map, which must not be modified until the reader of this pipe
+  has consumed it.
+  \param d An optional deadline, which requires this pipe to be nonblocking.
+
+  On Linux this is `vmsplice()`, elsewhere it is `write()`. When combined with `splice_to()` on
+  the other end of the pipe, memory can be written into a file with no copies through user space.
+
+  \errors Any of the values which `vmsplice()` or `write()` can return.
+  \mallocs None.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> splice_from(const_buffers_type buffers, deadline d = {}) noexcept;
+
+  /*! \brief Duplicates up to `bytes` of this pipe into `dest` without consuming them, so they can
+  still be read from this pipe.
+
+  \return The bytes duplicated, which may be fewer than `bytes`. Zero means the write end of this
+  pipe has been closed.
+  \param dest The pipe to write into.
+  \param bytes The maximum bytes to duplicate.
+  \param d An optional deadline, which requires this pipe to be nonblocking.
+
+  On Linux this is `tee()`, which copies references to the pipe's pages rather than the bytes.
+  Asynchronous teeing is available from io_uring multiplexers via
+  `io_multiplexer::posix_fs_syscall::kind::tee`.
+
+  \errors Any of the values which `tee()` can return. `errc::operation_not_supported` on
+  platforms other than Linux.
+  \mallocs None.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> tee_to(pipe_handle &dest, size_t bytes, deadline d = {}) noexcept;
+
+protected:
+  // Moves up to `bytes` from `src` to `dest` through a bounce buffer, writing all bytes read. Blocking handles don't take deadlines.
+  static result<size_t> _splice_by_copy(io_handle &src, extent_type srcoffset, io_handle &dest, extent_type destoffset, size_t bytes, deadline d) noexcept
+  {
+    byte buffer[65536];
+    OUTCOME_TRY(auto &&read, src.read(srcoffset, {{buffer, std::min(bytes, sizeof(buffer))}}, src.is_nonblocking() ? d : deadline()));
+    size_t written = 0;
+    while(written < read)
+    {
+      OUTCOME_TRY(auto &&thiswrite, dest.write(destoffset + written, {{buffer + written, read - written}}, dest.is_nonblocking() ? d : deadline()));
+      written += thiswrite;
+    }
+    return read;
+  }
+
+public:
 #ifdef _WIN32
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<path_handle> parent_path_handle(deadline /*unused*/ = std::chrono::seconds(30)) const noexcept override
   {
@@ -291,7 +400,8 @@ template <> struct construct<pipe_handle>
   pipe_handle::caching _caching = pipe_handle::caching::all;
   pipe_handle::flag flags = pipe_handle::flag::none;
   const path_handle &base = path_discovery::temporary_named_pipes_directory();
-  result<pipe_handle> operator()() const noexcept { return pipe_handle::pipe(_path, _mode, _creation, _caching, flags, base); }
+  size_t capacity = 0;
+  result<pipe_handle> operator()() const noexcept { return pipe_handle::pipe(_path, _mode, _creation, _caching, flags, base, capacity); }
 };
 
 // BEGIN make_free_functions.py
@@ -63,6 +63,9 @@ public:
 protected:
   flag _flags{flag::none};
   pipe_handle _in_pipe, _out_pipe, _error_pipe;
+#ifdef __linux__
+  int _pidfd{-1};  // opened on first initiate_wait()
+#endif
 
   struct _byte_array_deleter
   {
@@ -104,7 +107,13 @@ public:
       , _in_pipe(std::move(o._in_pipe))
       , _out_pipe(std::move(o._out_pipe))
       , _error_pipe(std::move(o._error_pipe))
+#ifdef __linux__
+      , _pidfd(o._pidfd)
+#endif
   {
+#ifdef __linux__
+    o._pidfd = -1;
+#endif
   }
   //! Move assignment of handle
   process_handle &operator=(process_handle &&o) noexcept
@@ -206,6 +215,23 @@ public:
 
   LLFIO_DEADLINE_TRY_FOR_UNTIL(wait)
 
+#ifndef _WIN32
+  /*! \brief Initiates an asynchronous wait for the process to exit through `multiplexer`, filling
+  in `op` as a `posix_fs_syscall::kind::wait_process`.
+
+  `op.result` stops being `posix_fs_syscall::pending` once the process has exited, which
+  `multiplexer->check_for_any_completed_io()` will notice. The process is not reaped, so its exit
+  code can then be retrieved without blocking with `wait()`. `op` must remain valid until it
+  completes.
+
+  On Linux a pidfd is opened for the process on first use, and io_uring multiplexers poll it
+  within the kernel. kqueue multiplexers use `EVFILT_PROC`. Otherwise the multiplexer's waiter
+  thread checks the process with `waitid()` on a backoff.
+  \errors Any of the values `pidfd_open()` can return, and any failure of the multiplexer.
+  */
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<void> initiate_wait(io_multiplexer::posix_fs_syscall &op, io_multiplexer *multiplexer) noexcept;
+#endif
+
   /*! Return a process handle referring to the current process.
    */
   static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC const process_handle &current() noexcept;
@@ -224,6 +250,10 @@ public:
   launching child processes is always racy with respect to concurrent
   filesystem modification.
 
+  On POSIX the child is launched with `posix_spawn()`, which does not copy the
+  page tables of the parent as `fork()` does, so launch latency does not grow with
+  the size of the parent's address space.
+
   \errors Any of the values POSIX `posix_spawn()` or `CreateProcess()` can return.
   */
   LLFIO_MAKE_FREE_FUNCTION
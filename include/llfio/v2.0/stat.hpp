@@ -30,6 +30,8 @@ Distributed under the Boost Software License, Version 1.0.
 #endif
 #include "config.hpp"
 
+#include <vector>
+
 //! \file stat.hpp Provides stat
 
 #ifdef _MSC_VER
@@ -40,6 +42,7 @@ Distributed under the Boost Software License, Version 1.0.
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
 
 class handle;
+class io_multiplexer;
 
 /*! \struct stat_t
 \brief Metadata about a directory entry
@@ -311,10 +314,28 @@ struct LLFIO_DECL stat_t  // NOLINT
 
   /*! Fills the structure with metadata.
 
+  On Linux, this is a `statx()` masked to the metadata wanted, so network filing systems need not
+  revalidate with the server attributes which are not wanted. Only the metadata which the filing
+  system returns is filled in, so for example `st_birthtim` is not filled in if the filing system
+  does not keep birth times. If `cached` is true, `AT_STATX_DONT_SYNC` lets network filing systems
+  return locally cached metadata without asking the server at all. On other platforms, `cached`
+  is ignored.
+
   \return The number of items filled in. You should use a nullptr constructed structure if you wish
   to detect which items were filled in, and which not (those not may be all bits zero).
   */
-  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> fill(const handle &h, want wanted = want::all) noexcept;
+  LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> fill(const handle &h, want wanted = want::all, bool cached = false) noexcept;
+  /*! Fills many structures with metadata at once, `out[n]` from `*hs[n]`, as `fill()` would.
+  If `multiplexer` is not null, the fills are executed as a batch using `io_multiplexer::do_posix_fs_syscalls()`,
+  which the Linux io_uring multiplexer executes at high queue depth instead of serially. Otherwise,
+  and on Windows and the BSDs, each structure is filled serially. `cached` is as for `fill()`.
+
+  \return The result of filling each structure, in the same order as `hs`.
+  \errors `errc::invalid_argument` if `out` and `hs` differ in length. Any of the values `fill()`
+  can return, per structure. Any of the values `std::vector` can throw, or the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<size_t>>> fill(span<stat_t> out, span<const handle *const> hs, want wanted = want::all,
+                                                                                  io_multiplexer *multiplexer = nullptr, bool cached = false) noexcept;
   /*! Stamps the handle with the metadata in the structure, returning the metadata written.
 
   The following want bits are always ignored, and are cleared in the want bits returned:
@@ -92,7 +92,12 @@ struct LLFIO_DECL statfs_t
     }
   }
 #endif
-  //! Fills in the structure with metadata, returning number of items filled in
+  /*! Fills in the structure with metadata, returning number of items filled in.
+
+  On Linux, `flags`, `fstypename`, `mntfromname` and `mntonname` require the mount table, which
+  is cached process wide and only reread after the kernel signals that it changed. Filling any
+  of these thus usually costs an `fstatfs()` plus a lookup.
+  */
   LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<size_t> fill(const handle &h, want wanted = want::all) noexcept;
 };
 
@@ -25,7 +25,9 @@ Distributed under the Boost Software License, Version 1.0.
 #ifndef LLFIO_STORAGE_PROFILE_H
 #define LLFIO_STORAGE_PROFILE_H
 
+#include "file_handle.hpp"
 #include "io_handle.hpp"
+#include "utils.hpp"
 
 #if LLFIO_EXPERIMENTAL_STATUS_CODE
 #include "outcome/experimental/status_outcome.hpp"
@@ -162,6 +164,26 @@ namespace storage_profile
       }
       throw std::invalid_argument("No type set in item");  // NOLINT
     }
+    //! Call the callable with the unerased type
+    template <class U> auto invoke(U &&f)
+    {
+      switch(type)
+      {
+      case storage_types::extent_type:
+        return f(*reinterpret_cast<item<io_handle::extent_type> *>(static_cast<item_base *>(this)));
+      case storage_types::unsigned_int:
+        return f(*reinterpret_cast<item<unsigned int> *>(static_cast<item_base *>(this)));
+      case storage_types::unsigned_long_long:
+        return f(*reinterpret_cast<item<unsigned long long> *>(static_cast<item_base *>(this)));
+      case storage_types::float_:
+        return f(*reinterpret_cast<item<float> *>(static_cast<item_base *>(this)));
+      case storage_types::string:
+        return f(*reinterpret_cast<item<std::string> *>(static_cast<item_base *>(this)));
+      case storage_types::unknown:
+        break;
+      }
+      throw std::invalid_argument("No type set in item");  // NOLINT
+    }
     //! Set this item if its value is default
     outcome<void> operator()(storage_profile &sp, handle_type &h) const
     {
@@ -222,6 +244,8 @@ namespace storage_profile
     LLFIO_HEADERS_ONLY_FUNC_SPEC outcome<void> read_qd16(storage_profile &sp, file_handle &srch) noexcept;
     LLFIO_HEADERS_ONLY_FUNC_SPEC outcome<void> write_qd16(storage_profile &sp, file_handle &srch) noexcept;
     LLFIO_HEADERS_ONLY_FUNC_SPEC outcome<void> readwrite_qd4(storage_profile &sp, file_handle &srch) noexcept;
+    LLFIO_HEADERS_ONLY_FUNC_SPEC outcome<void> read_qd_sweep(storage_profile &sp, file_handle &srch) noexcept;
+    LLFIO_HEADERS_ONLY_FUNC_SPEC outcome<void> write_qd_sweep(storage_profile &sp, file_handle &srch) noexcept;
   }
   namespace response_time
   {
@@ -285,6 +309,24 @@ namespace storage_profile
     //! Write the matching items from storage profile as YAML to out with the given indentation
     LLFIO_HEADERS_ONLY_MEMFUNC_SPEC void write(std::ostream &out, const std::regex &which = std::regex(".*"), size_t _indent = 0, bool invert_match = false) const;
 
+    /*! \brief Profiles the identity of the storage upon which `h` resides, and then loads the remaining
+    items from the profile of the same storage and caching previously saved into `dirh` by `save()`, if any.
+
+    Only the cheap `system:*` and `storage:*` items are profiled, so with a saved profile this takes
+    microseconds instead of the many minutes which the full profile takes. The profile is chosen by a hash of
+    the device name, controller kind, device and filing system sizes, filing system name, and `h.kernel_caching()`.
+    \return True if a saved profile was loaded.
+    */
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC outcome<bool> load(const path_handle &dirh, handle_type &h) noexcept;
+    /*! \brief Atomically saves this profile into `dirh`, named such that `load()` with a handle upon the same
+    storage and with the same caching will find it. `h` must be a handle of the caching profiled.
+    */
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC outcome<void> save(const path_handle &dirh, const handle_type &h) const noexcept;
+    /*! \brief Returns the tuning hints for llfio implied by this profile, suitable for `utils::set_tuning()`.
+    Hints for which the items have not been profiled are left zero.
+    */
+    LLFIO_HEADERS_ONLY_MEMFUNC_SPEC utils::tuning_hints tuning() const noexcept;
+
     // System characteristics
     item<std::string> os_name = {"system:os:name", &system::os};                     // e.g. Microsoft Windows NT
     item<std::string> os_ver = {"system:os:ver", &system::os};                       // e.g. 10.0.10240
@@ -338,7 +380,9 @@ namespace storage_profile
     item<unsigned long long> read_qd1_50 = {"latency:read:qd1:50%", latency::read_qd1, "The nanoseconds to read 4Kb at a queue depth of 1 (50% of the time)"};
     item<unsigned long long> read_qd1_95 = {"latency:read:qd1:95%", latency::read_qd1, "The nanoseconds to read 4Kb at a queue depth of 1 (95% of the time)"};
     item<unsigned long long> read_qd1_99 = {"latency:read:qd1:99%", latency::read_qd1, "The nanoseconds to read 4Kb at a queue depth of 1 (99% of the time)"};
+    item<unsigned long long> read_qd1_999 = {"latency:read:qd1:99.9%", latency::read_qd1, "The nanoseconds to read 4Kb at a queue depth of 1 (99.9% of the time)"};
     item<unsigned long long> read_qd1_99999 = {"latency:read:qd1:99.999%", latency::read_qd1, "The nanoseconds to read 4Kb at a queue depth of 1 (99.999% of the time)"};
+    item<std::string> read_qd1_histogram = {"latency:read:qd1:histogram", latency::read_qd1, "The histogram of the nanoseconds to read 4Kb at a queue depth of 1, as space separated nanoseconds:count pairs accurate to 1.6%"};
 
     item<unsigned long long> read_qd16_min = {"latency:read:qd16:min", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (min)"};
     item<unsigned long long> read_qd16_mean = {"latency:read:qd16:mean", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (arithmetic mean)"};
@@ -346,7 +390,9 @@ namespace storage_profile
     item<unsigned long long> read_qd16_50 = {"latency:read:qd16:50%", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (50% of the time)"};
     item<unsigned long long> read_qd16_95 = {"latency:read:qd16:95%", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (95% of the time)"};
     item<unsigned long long> read_qd16_99 = {"latency:read:qd16:99%", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (99% of the time)"};
+    item<unsigned long long> read_qd16_999 = {"latency:read:qd16:99.9%", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (99.9% of the time)"};
     item<unsigned long long> read_qd16_99999 = {"latency:read:qd16:99.999%", latency::read_qd16, "The nanoseconds to read 4Kb at a queue depth of 16 (99.999% of the time)"};
+    item<std::string> read_qd16_histogram = {"latency:read:qd16:histogram", latency::read_qd16, "The histogram of the nanoseconds to read 4Kb at a queue depth of 16, as space separated nanoseconds:count pairs accurate to 1.6%"};
 
     item<unsigned> write_nothing = {"latency:write:nothing", latency::write_nothing, "The nanoseconds to write zero bytes"};
 
@@ -356,7 +402,9 @@ namespace storage_profile
     item<unsigned long long> write_qd1_50 = {"latency:write:qd1:50%", latency::write_qd1, "The nanoseconds to write 4Kb at a queue depth of 1 (50% of the time)"};
     item<unsigned long long> write_qd1_95 = {"latency:write:qd1:95%", latency::write_qd1, "The nanoseconds to write 4Kb at a queue depth of 1 (95% of the time)"};
     item<unsigned long long> write_qd1_99 = {"latency:write:qd1:99%", latency::write_qd1, "The nanoseconds to write 4Kb at a queue depth of 1 (99% of the time)"};
+    item<unsigned long long> write_qd1_999 = {"latency:write:qd1:99.9%", latency::write_qd1, "The nanoseconds to write 4Kb at a queue depth of 1 (99.9% of the time)"};
     item<unsigned long long> write_qd1_99999 = {"latency:write:qd1:99.999%", latency::write_qd1, "The nanoseconds to write 4Kb at a queue depth of 1 (99.999% of the time)"};
+    item<std::string> write_qd1_histogram = {"latency:write:qd1:histogram", latency::write_qd1, "The histogram of the nanoseconds to write 4Kb at a queue depth of 1, as space separated nanoseconds:count pairs accurate to 1.6%"};
 
     item<unsigned long long> write_qd16_min = {"latency:write:qd16:min", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (min)"};
     item<unsigned long long> write_qd16_mean = {"latency:write:qd16:mean", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (arithmetic mean)"};
@@ -364,7 +412,9 @@ namespace storage_profile
     item<unsigned long long> write_qd16_50 = {"latency:write:qd16:50%", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (50% of the time)"};
     item<unsigned long long> write_qd16_95 = {"latency:write:qd16:95%", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (95% of the time)"};
     item<unsigned long long> write_qd16_99 = {"latency:write:qd16:99%", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (99% of the time)"};
+    item<unsigned long long> write_qd16_999 = {"latency:write:qd16:99.9%", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (99.9% of the time)"};
     item<unsigned long long> write_qd16_99999 = {"latency:write:qd16:99.999%", latency::write_qd16, "The nanoseconds to write 4Kb at a queue depth of 16 (99.999% of the time)"};
+    item<std::string> write_qd16_histogram = {"latency:write:qd16:histogram", latency::write_qd16, "The histogram of the nanoseconds to write 4Kb at a queue depth of 16, as space separated nanoseconds:count pairs accurate to 1.6%"};
 
     item<unsigned long long> readwrite_qd4_min = {"latency:readwrite:qd4:min", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (min)"};
     item<unsigned long long> readwrite_qd4_mean = {"latency:readwrite:qd4:mean", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (arithmetic mean)"};
@@ -372,7 +422,14 @@ namespace storage_profile
     item<unsigned long long> readwrite_qd4_50 = {"latency:readwrite:qd4:50%", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (50% of the time)"};
     item<unsigned long long> readwrite_qd4_95 = {"latency:readwrite:qd4:95%", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (95% of the time)"};
     item<unsigned long long> readwrite_qd4_99 = {"latency:readwrite:qd4:99%", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (99% of the time)"};
+    item<unsigned long long> readwrite_qd4_999 = {"latency:readwrite:qd4:99.9%", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (99.9% of the time)"};
     item<unsigned long long> readwrite_qd4_99999 = {"latency:readwrite:qd4:99.999%", latency::readwrite_qd4, "The nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4 (99.999% of the time)"};
+    item<std::string> readwrite_qd4_histogram = {"latency:readwrite:qd4:histogram", latency::readwrite_qd4, "The histogram of the nanoseconds to 75% read 25% write 4Kb at a total queue depth of 4, as space separated nanoseconds:count pairs accurate to 1.6%"};
+
+    item<std::string> read_qd_sweep = {"latency:read:async:qd_sweep", latency::read_qd_sweep, "The IOPS and nanoseconds to read 4Kb at each of queue depths 1 to 256 kept in flight by an i/o multiplexer, as space separated queue_depth:IOPS:mean:99% quads"};
+    item<unsigned> read_qd_saturation = {"latency:read:async:saturation_qd", latency::read_qd_sweep, "The lowest queue depth of 4Kb reads after which doubling it raises IOPS by less than 10%"};
+    item<std::string> write_qd_sweep = {"latency:write:async:qd_sweep", latency::write_qd_sweep, "The IOPS and nanoseconds to write 4Kb at each of queue depths 1 to 256 kept in flight by an i/o multiplexer, as space separated queue_depth:IOPS:mean:99% quads"};
+    item<unsigned> write_qd_saturation = {"latency:write:async:saturation_qd", latency::write_qd_sweep, "The lowest queue depth of 4Kb writes after which doubling it raises IOPS by less than 10%"};
 
     item<unsigned long long> create_file_warm_racefree_0b = {"response_time:race_free:warm_cache:create_file:0b", response_time::traversal_warm_racefree_0b, "The average nanoseconds to create a 0 byte file (warm cache, race free)"};
     item<unsigned long long> enumerate_file_warm_racefree_0b = {"response_time:race_free:warm_cache:enumerate_file:0b", response_time::traversal_warm_racefree_0b, "The average nanoseconds to enumerate a 0 byte file (warm cache, race free)"};
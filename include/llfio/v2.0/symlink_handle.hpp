@@ -28,6 +28,8 @@ Distributed under the Boost Software License, Version 1.0.
 #include "handle.hpp"
 #include "path_view.hpp"
 
+#include <vector>
+
 //! \file symlink_handle.hpp Provides a handle to a symbolic link.
 
 #ifndef LLFIO_SYMLINK_HANDLE_IS_FAKED
@@ -50,6 +52,7 @@ extern "C"
 
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
 
+class io_multiplexer;
 class symlink_handle;
 
 namespace detail
@@ -498,6 +501,36 @@ public:
   */
   LLFIO_MAKE_FREE_FUNCTION
   LLFIO_HEADERS_ONLY_VIRTUAL_SPEC result<const_buffers_type> write(io_request<const_buffers_type> req, deadline d = deadline()) noexcept;
+
+  /*! \brief Reads the contents of many symbolic links at once, each of `paths` relative to `base`.
+
+  Unlike `symlink()` followed by `read()`, no handle is opened to each link and its inode is not
+  fetched, so on POSIX each link costs exactly one `readlinkat()` into a buffer reused for the
+  whole batch. This is much faster when scanning trees with very many links. There is no
+  io_uring opcode for reading links, so this is always serial. On Windows, each link is opened
+  and read.
+
+  \return The contents of each link, in the same order as `paths`.
+  \errors Any of the values `readlinkat()` or `symlink()` and `read()` can return, per path.
+  Any of the values `std::vector` can throw.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<path_type>>> read_links(const path_handle &base, span<const path_view_type> paths) noexcept;
+
+  /*! \brief Creates many symbolic links at once, each of `paths` relative to `base` linking to
+  the same indexed item of `targets`. Existing links are never replaced, failing with
+  `errc::file_exists`.
+
+  On POSIX each link costs one `symlinkat()`, and if `multiplexer` is not null they are executed
+  as one batch using `io_multiplexer::do_posix_fs_syscalls()`, which the Linux io_uring
+  multiplexer executes at high queue depth on Linux 5.15 onwards. On Windows, each link is
+  created with `symlink()` and `write()`.
+
+  \return The result of creating each link, in the same order as `paths`.
+  \errors Any of the values `symlinkat()` or `symlink()` and `write()` can return, per path.
+  Any of the values `std::vector` can throw, or the multiplexer can return.
+  */
+  static LLFIO_HEADERS_ONLY_MEMFUNC_SPEC result<std::vector<result<void>>> create_links(const path_handle &base, span<const path_view_type> paths,
+                                                                                        span<const path_view> targets, io_multiplexer *multiplexer = nullptr) noexcept;
 };
 
 //! \brief Constructor for `symlink_handle`
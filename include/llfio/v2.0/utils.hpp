@@ -29,9 +29,13 @@ Distributed under the Boost Software License, Version 1.0.
 #error You must include the master llfio.hpp, not individual header files directly
 #endif
 #include "config.hpp"
+#include "native_handle_type.hpp"
 
 #include "quickcpplib/algorithm/string.hpp"
 
+#include <atomic>
+#include <chrono>
+
 //! \file utils.hpp Provides namespace utils
 
 LLFIO_V2_NAMESPACE_EXPORT_BEGIN
@@ -148,13 +152,27 @@ namespace utils
     return size;
   }
 
-  /*! \brief Fills the buffer supplied with cryptographically strong randomness. Uses the OS kernel API.
+  namespace detail
+  {
+    // Fills the buffer with randomness directly from the OS kernel
+    LLFIO_HEADERS_ONLY_FUNC_SPEC void kernel_random_fill(char *buffer, size_t bytes) noexcept;
+    // Writes 2 * inlen lowercase hex characters. out may equal in.
+    LLFIO_HEADERS_ONLY_FUNC_SPEC void to_hex_string(char *out, const char *in, size_t inlen) noexcept;
+  }  // namespace detail
+
+  /*! \brief Fills the buffer supplied with cryptographically strong randomness.
+
+  Each thread has its own ChaCha20 keystream generator, keyed on first use by the OS kernel
+  and rekeyed from its own output after every 224 bytes generated, so earlier output cannot
+  be recovered from a later state. On POSIX a fork rekeys the generators in the child. 256 bytes
+  of keystream are generated at a time, four blocks in parallel using SIMD where available,
+  so calls almost never enter the kernel.
 
   \param buffer A buffer to fill
   \param bytes How many bytes to fill
   \ingroup utils
-  \complexity{Whatever the system API takes.}
-  \exceptionmodel{Any error from the operating system.}
+  \complexity{Amortised O(bytes).}
+  \exceptionmodel{Calls std::terminate() if the OS kernel cannot supply randomness.}
   */
   LLFIO_HEADERS_ONLY_FUNC_SPEC void random_fill(char *buffer, size_t bytes) noexcept;
 
@@ -163,15 +181,15 @@ namespace utils
   \param randomlen The number of bytes of randomness to use for the string.
   \return A string representing the randomness at a 2x ratio, so if 32 bytes were requested, this string would be 64 bytes long.
   \ingroup utils
-  \complexity{Whatever the system API takes.}
-  \exceptionmodel{Any error from the operating system.}
+  \complexity{Amortised O(randomlen).}
+  \exceptionmodel{Throws std::bad_alloc.}
   */
   inline std::string random_string(size_t randomlen)
   {
     size_t outlen = randomlen * 2;
     std::string ret(outlen, 0);
     random_fill(const_cast<char *>(ret.data()), randomlen);
-    QUICKCPPLIB_NAMESPACE::algorithm::string::to_hex_string(const_cast<char *>(ret.data()), outlen, ret.data(), randomlen);
+    detail::to_hex_string(const_cast<char *>(ret.data()), ret.data(), randomlen);
     return ret;
   }
 
@@ -188,6 +206,57 @@ namespace utils
   */
   LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> drop_filesystem_cache() noexcept;
 
+  /*! \brief Tries to flush all modified data of the filing system containing `h` to the physical device,
+  leaving other filing systems alone.
+
+  On Linux this is `syncfs()`. On Microsoft Windows this is `FlushFileBuffers()` on the volume
+  containing `h`, which requires elevated privileges for the calling process. Elsewhere this is
+  `fsync()` of `h` followed by `sync()`, which is no better than `flush_modified_data()`.
+
+  To flush without blocking, see `io_multiplexer::posix_fs_syscall::kind::syncfs`.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> flush_modified_data(const native_handle_type &h) noexcept;
+
+  /*! \brief Tries to flush all modified data of the file `h` to the physical device, and then
+  drop the OS filesystem cache of the file, thus making all future reads of it come from
+  the physical device. Unlike `drop_filesystem_cache()`, this does not require elevated privileges,
+  and leaves the cache of everything else alone.
+
+  On Linux and the BSDs this is `posix_fadvise(POSIX_FADV_DONTNEED)`, which cannot drop pages which are
+  mapped or locked. On Microsoft Windows this is reopening `h` without buffering, which purges
+  its cached pages. Elsewhere this returns `errc::not_supported`.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> drop_filesystem_cache(const native_handle_type &h) noexcept;
+
+  /*! \brief Flushes the entries of the directory `h` to the physical device, so the creations,
+  renames and unlinks within it persist across power loss.
+
+  On POSIX this is `fsync()` of `h`, which must not have been opened with `O_PATH`, so a
+  `directory_handle` rather than a `path_handle` on Linux. On Microsoft Windows this is
+  `FlushFileBuffers()` on `h` reopened with write privileges.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> flush_directory(const native_handle_type &h) noexcept;
+
+  /*! \brief Hints with which llfio tunes itself to the storage in use, usually calculated from a
+  profile of the storage by `storage_profile::storage_profile::tuning()`. A member which is zero
+  leaves the built in heuristic in use.
+  */
+  struct tuning_hints
+  {
+    //! The alignment assumed by `algorithm::direct_io_handle_adapter` when the platform cannot say.
+    size_t direct_io_alignment{0};
+    //! The submission queue entries for each ring created by `multiplexer_linux_io_uring()`.
+    size_t io_queue_depth{0};
+    //! The threads used by `algorithm::traverse()` when zero threads are requested.
+    size_t traverse_threads{0};
+  };
+  //! \brief Returns the tuning hints in use by this process. Thread safe.
+  LLFIO_HEADERS_ONLY_FUNC_SPEC tuning_hints tuning() noexcept;
+  /*! \brief Sets the tuning hints in use by this process. Thread safe. Only objects created after
+  this call see the new hints.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void set_tuning(const tuning_hints &v) noexcept;
+
 #ifndef _WIN32
   /*! \brief Returns true if this POSIX is running under Microsoft's Subsystem for Linux.
    */
@@ -198,6 +267,15 @@ namespace utils
    */
   struct process_memory_usage
   {
+    //! How accurately to calculate the statistics.
+    enum class accuracy
+    {
+      //! As accurately as the platform allows, which on Linux costs time proportional to the number of mappings.
+      precise,
+      //! Approximately, but in constant time. On Linux, `private_committed` counts all private writable mappings, not just those committed.
+      fast
+    };
+
     //! The total virtual address space in use.
     size_t total_address_space_in_use{0};
     //! The total memory currently paged into the process. Always `<= total_address_space_in_use`. Also known as "working set", or "resident set size including shared".
@@ -210,12 +288,80 @@ namespace utils
   };
   /*! \brief Retrieve the current memory usage statistics for this process.
 
+   \param acc How accurately to calculate the statistics. Only Linux has a cheaper approximation,
+   which uses `/proc/self/statm` rather than parsing `/proc/self/smaps`.
+
    \note Mac OS provides no way of reading how much memory a process has committed. We therefore supply as `private_committed` the same value as `private_paged_in`.
   */
-  LLFIO_HEADERS_ONLY_FUNC_SPEC result<process_memory_usage> current_process_memory_usage() noexcept;
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<process_memory_usage> current_process_memory_usage(process_memory_usage::accuracy acc = process_memory_usage::accuracy::precise) noexcept;
+
+  /*! \brief Starts a background thread which samples `current_process_memory_usage()` every `interval`,
+  or changes the interval and accuracy of the one already running.
+
+   Memory pressure driven caches can then poll `sampled_process_memory_usage()` as often as they like.
+   A first sample is taken before returning. A zero interval stops the thread.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> start_process_memory_usage_sampler(std::chrono::milliseconds interval, process_memory_usage::accuracy acc = process_memory_usage::accuracy::fast) noexcept;
+  //! \brief Stops the thread started by `start_process_memory_usage_sampler()`, if any.
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void stop_process_memory_usage_sampler() noexcept;
+  /*! \brief Returns the most recent sample taken by the thread started by `start_process_memory_usage_sampler()`.
+  If that thread is not running, returns `current_process_memory_usage(process_memory_usage::accuracy::fast)`.
+  Thread safe.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<process_memory_usage> sampled_process_memory_usage() noexcept;
+
+  /*! \brief The memory pressure the system is under, as percentages of recent wall time.
+   */
+  struct memory_pressure
+  {
+    //! The percentage of the last ten seconds in which some runnable tasks were stalled waiting for memory.
+    float some{0};
+    //! The percentage of the last ten seconds in which all runnable tasks were stalled waiting for memory.
+    float full{0};
+  };
+  /*! \brief Retrieve the current memory pressure the system is under.
+
+   On Linux this is the ten second averages of `/proc/pressure/memory`, which needs Linux 4.20 or
+   later with PSI enabled. Windows only reports whether physical memory is low, which is returned as
+   100% of both. Other platforms return `errc::operation_not_supported`.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<memory_pressure> current_memory_pressure() noexcept;
+
+  /*! \brief Registers a region of memory, typically the cold part of a cache, whose pages may be
+  reclaimed by `reclaim_cold_regions()` when memory runs low. Returns an identifier for
+  `unregister_cold_region()`, which must be called before the region is unmapped. Thread safe.
+
+   Reclaim never loses contents: the pages are either deactivated so the kernel reclaims them first,
+   or written out to their file or swap, and fault back in when next touched.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<uint64_t> register_cold_region(span<byte> region) noexcept;
+  //! \brief Unregisters a region registered by `register_cold_region()`. Thread safe.
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void unregister_cold_region(uint64_t id) noexcept;
+  /*! \brief Reclaims the whole pages of all regions registered by `register_cold_region()`, returning
+  the bytes reclaimed. Thread safe.
+
+   \param pageout If false, the pages are deactivated so they are reclaimed before any other
+   (`MADV_COLD` on Linux 5.4 or later, nothing elsewhere). If true, they are reclaimed immediately
+   (`MADV_PAGEOUT` on Linux 5.4 or later, removal from the working set on Windows).
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reclaim_cold_regions(bool pageout) noexcept;
+  /*! \brief Starts a background thread which samples `current_memory_pressure()` every `interval`,
+  or changes the interval and threshold of the one already running.
+
+   Whenever `some` memory pressure reaches `threshold` percent, the registered cold regions are
+   deactivated, and whenever `full` memory pressure does, they are paged out, so caches degrade
+   gracefully instead of the process being swapped or killed. A zero interval stops the thread.
+   Returns the failure of `current_memory_pressure()` if the platform cannot report it.
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> start_memory_pressure_reclaimer(std::chrono::milliseconds interval, float threshold = 10) noexcept;
+  //! \brief Stops the thread started by `start_memory_pressure_reclaimer()`, if any.
+  LLFIO_HEADERS_ONLY_FUNC_SPEC void stop_memory_pressure_reclaimer() noexcept;
 
   namespace detail
   {
+    // Reclaims the whole pages within the region, returning the bytes reclaimed
+    LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reclaim_memory(span<byte> region, bool pageout) noexcept;
+
     struct large_page_allocation
     {
       void *p{nullptr};
@@ -338,6 +484,315 @@ namespace utils
     };
   };
   template <class T, class U> inline bool operator==(const page_allocator<T> & /*unused*/, const page_allocator<U> & /*unused*/) noexcept { return true; }
+
+  namespace detail
+  {
+    // Freed page runs cached by the calling thread, indexed by the power of two size class of the run
+    struct pooled_page_cache
+    {
+      static constexpr size_t size_classes = sizeof(size_t) * 8;
+      static constexpr size_t runs_per_size_class = 4;
+      void *runs[size_classes][runs_per_size_class]{};
+      uint8_t count[size_classes]{};
+      size_t cached_bytes{0};
+
+      pooled_page_cache() = default;
+      pooled_page_cache(const pooled_page_cache &) = delete;
+      pooled_page_cache &operator=(const pooled_page_cache &) = delete;
+      ~pooled_page_cache() { trim(); }
+
+      void trim() noexcept
+      {
+        for(size_t cls = 0; cls < size_classes; cls++)
+        {
+          while(count[cls] > 0)
+          {
+            deallocate_large_pages(runs[cls][--count[cls]], size_t(1) << cls);
+          }
+        }
+        cached_bytes = 0;
+      }
+    };
+    inline std::atomic<size_t> &pooled_page_cache_limit() noexcept
+    {
+      static std::atomic<size_t> v(64 * 1024 * 1024);
+      return v;
+    }
+    inline pooled_page_cache &this_thread_pooled_page_cache() noexcept
+    {
+      static thread_local pooled_page_cache v;
+      return v;
+    }
+    // The smallest power of two no smaller than both bytes and the page size
+    inline size_t pooled_page_size_class(size_t bytes) noexcept
+    {
+      size_t cls = 0;
+      while((size_t(1) << cls) < bytes || (size_t(1) << cls) < page_size())
+      {
+        cls++;
+      }
+      return cls;
+    }
+  }  // namespace detail
+
+  /*! \brief Returns the maximum bytes each thread's `pooled_page_allocator` cache may retain.
+  \ingroup utils
+  */
+  inline size_t pooled_page_allocator_cache_limit() noexcept { return detail::pooled_page_cache_limit().load(std::memory_order_relaxed); }
+  /*! \brief Sets the maximum bytes each thread's `pooled_page_allocator` cache may retain. Zero disables caching.
+  Caches already over the new limit are trimmed as their threads next deallocate.
+  \ingroup utils
+  */
+  inline void set_pooled_page_allocator_cache_limit(size_t bytes) noexcept { detail::pooled_page_cache_limit().store(bytes, std::memory_order_relaxed); }
+  /*! \brief Returns all page runs cached by the calling thread's `pooled_page_allocator` to the system.
+  \ingroup utils
+  */
+  inline void trim_pooled_page_allocator_cache() noexcept { detail::this_thread_pooled_page_cache().trim(); }
+
+  /*! \class pooled_page_allocator
+  \brief An STL allocator like `page_allocator`, but which caches freed page runs per thread.
+  \ingroup utils
+
+  `page_allocator` maps and unmaps memory on every allocation and deallocation,
+  which is expensive for short lived large buffers such as the bounce buffers used
+  when copying between handles. This allocator rounds each allocation up to a power
+  of two size class, and on deallocation keeps the run in a cache local to the
+  deallocating thread, from which later allocations of the same size class on that
+  thread are served without any syscalls.
+
+  Each thread's cache retains no more than `pooled_page_allocator_cache_limit()` bytes
+  (by default 64Mb), and is returned to the system when the thread exits or upon
+  `trim_pooled_page_allocator_cache()`. Memory may be deallocated on a different thread
+  to the one which allocated it.
+  */
+  template <typename T> class pooled_page_allocator
+  {
+  public:
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using reference = T &;
+    using const_reference = const T &;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    template <class U> struct rebind
+    {
+      using other = pooled_page_allocator<U>;
+    };
+
+    constexpr pooled_page_allocator() noexcept {}  // NOLINT
+
+    template <class U> pooled_page_allocator(const pooled_page_allocator<U> & /*unused*/) noexcept {}  // NOLINT
+
+    size_type max_size() const noexcept { return (size_type(1) << (sizeof(size_type) * 8 - 2)) / sizeof(T); }
+
+    pointer address(reference x) const noexcept { return std::addressof(x); }
+
+    const_pointer address(const_reference x) const noexcept { return std::addressof(x); }
+
+    pointer allocate(size_type n, const void * /*unused*/ = nullptr)
+    {
+      if(n > max_size())
+      {
+        throw std::bad_alloc();
+      }
+      const size_t cls = detail::pooled_page_size_class(n * sizeof(T));
+      auto &cache = detail::this_thread_pooled_page_cache();
+      if(cache.count[cls] > 0)
+      {
+        cache.cached_bytes -= size_t(1) << cls;
+        return reinterpret_cast<pointer>(cache.runs[cls][--cache.count[cls]]);
+      }
+      auto mem(detail::allocate_large_pages(size_t(1) << cls));
+      if(mem.p == nullptr)
+      {
+        // Perhaps the cache is holding memory which could satisfy this
+        cache.trim();
+        mem = detail::allocate_large_pages(size_t(1) << cls);
+        if(mem.p == nullptr)
+        {
+          throw std::bad_alloc();
+        }
+      }
+      return reinterpret_cast<pointer>(mem.p);
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+      if(n > max_size())
+      {
+        throw std::bad_alloc();
+      }
+      const size_t cls = detail::pooled_page_size_class(n * sizeof(T));
+      const size_t bytes = size_t(1) << cls;
+      auto &cache = detail::this_thread_pooled_page_cache();
+      const size_t limit = pooled_page_allocator_cache_limit();
+      if(cache.cached_bytes > limit)
+      {
+        cache.trim();
+      }
+      if(cache.count[cls] < detail::pooled_page_cache::runs_per_size_class && cache.cached_bytes + bytes <= limit)
+      {
+        cache.runs[cls][cache.count[cls]++] = p;
+        cache.cached_bytes += bytes;
+        return;
+      }
+      detail::deallocate_large_pages(p, bytes);
+    }
+
+    template <class U, class... Args> void construct(U *p, Args &&... args) { ::new(reinterpret_cast<void *>(p)) U(std::forward<Args>(args)...); }
+
+    template <class U> void destroy(U *p) { p->~U(); }
+  };
+  template <> class pooled_page_allocator<void>
+  {
+  public:
+    using value_type = void;
+    using pointer = void *;
+    using const_pointer = const void *;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    template <class U> struct rebind
+    {
+      using other = pooled_page_allocator<U>;
+    };
+  };
+  template <class T, class U> inline bool operator==(const pooled_page_allocator<T> & /*unused*/, const pooled_page_allocator<U> & /*unused*/) noexcept { return true; }
+
+  /*! \brief Statistics about the process wide large page pool.
+  \ingroup utils
+  */
+  struct large_page_pool_statistics
+  {
+    size_t bytes_reserved{0};  //!< The size of the pool, zero if none is reserved.
+    size_t bytes_in_use{0};    //!< The bytes of the pool currently allocated.
+    size_t page_size_used{0};  //!< The page size backing the pool, which is the base page size if large pages were unavailable.
+  };
+
+  /*! \brief Reserves a process wide pool of large page memory, from which `large_page_pool_allocator`
+  sub-allocates.
+
+  \return The bytes actually reserved, which is `bytes` rounded up to a power of two.
+  \param bytes The size of the pool to reserve.
+
+  As large pages become fragmented over the lifetime of a system, and each allocation of them goes
+  to the kernel, it is best to call this once early in program startup. The pool is sub-allocated
+  by a buddy allocator with a granularity of `page_size()`. Fails with `errc::device_or_resource_busy`
+  if a pool is already reserved.
+  \ingroup utils
+  \complexity{Whatever the system API takes, plus O(pool size / page_size()) to initialise the pool.}
+  \exceptionmodel{Never throws.}
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<size_t> reserve_large_page_pool(size_t bytes) noexcept;
+  /*! \brief Returns the process wide large page pool to the system. Fails with `errc::device_or_resource_busy`
+  if any of it remains allocated.
+  \ingroup utils
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC result<void> release_large_page_pool() noexcept;
+  /*! \brief Returns statistics about the process wide large page pool.
+  \ingroup utils
+  */
+  LLFIO_HEADERS_ONLY_FUNC_SPEC large_page_pool_statistics large_page_pool_stats() noexcept;
+
+  namespace detail
+  {
+    // Returns null if there is no pool, or it has no free block large enough
+    LLFIO_HEADERS_ONLY_FUNC_SPEC void *large_page_pool_allocate(size_t bytes) noexcept;
+    // Returns false if p was not allocated from the pool
+    LLFIO_HEADERS_ONLY_FUNC_SPEC bool large_page_pool_deallocate(void *p) noexcept;
+  }  // namespace detail
+
+  /*! \class large_page_pool_allocator
+  \brief An STL allocator which sub-allocates from the process wide large page pool.
+  \ingroup utils
+
+  Allocations are served from the pool reserved by `reserve_large_page_pool()`, rounded up
+  to a power of two multiple of `page_size()`. If no pool is reserved, or it is exhausted,
+  allocations fall back to those of `page_allocator`, so containers using this allocator always
+  work, just with less TLB efficiency. Deallocation may occur on any thread.
+  */
+  template <typename T> class large_page_pool_allocator
+  {
+  public:
+    using value_type = T;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using reference = T &;
+    using const_reference = const T &;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    template <class U> struct rebind
+    {
+      using other = large_page_pool_allocator<U>;
+    };
+
+    constexpr large_page_pool_allocator() noexcept {}  // NOLINT
+
+    template <class U> large_page_pool_allocator(const large_page_pool_allocator<U> & /*unused*/) noexcept {}  // NOLINT
+
+    size_type max_size() const noexcept { return size_type(~0U) / sizeof(T); }
+
+    pointer address(reference x) const noexcept { return std::addressof(x); }
+
+    const_pointer address(const_reference x) const noexcept { return std::addressof(x); }
+
+    pointer allocate(size_type n, const void * /*unused*/ = nullptr)
+    {
+      if(n > max_size())
+      {
+        throw std::bad_alloc();
+      }
+      void *p = detail::large_page_pool_allocate(n * sizeof(T));
+      if(p != nullptr)
+      {
+        return reinterpret_cast<pointer>(p);
+      }
+      auto mem(detail::allocate_large_pages(n * sizeof(T)));
+      if(mem.p == nullptr)
+      {
+        throw std::bad_alloc();
+      }
+      return reinterpret_cast<pointer>(mem.p);
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+      if(n > max_size())
+      {
+        throw std::bad_alloc();
+      }
+      if(!detail::large_page_pool_deallocate(p))
+      {
+        detail::deallocate_large_pages(p, n * sizeof(T));
+      }
+    }
+
+    template <class U, class... Args> void construct(U *p, Args &&... args) { ::new(reinterpret_cast<void *>(p)) U(std::forward<Args>(args)...); }
+
+    template <class U> void destroy(U *p) { p->~U(); }
+  };
+  template <> class large_page_pool_allocator<void>
+  {
+  public:
+    using value_type = void;
+    using pointer = void *;
+    using const_pointer = const void *;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    template <class U> struct rebind
+    {
+      using other = large_page_pool_allocator<U>;
+    };
+  };
+  template <class T, class U> inline bool operator==(const large_page_pool_allocator<T> & /*unused*/, const large_page_pool_allocator<U> & /*unused*/) noexcept { return true; }
 }  // namespace utils
 
 LLFIO_V2_NAMESPACE_END
@@ -349,6 +804,10 @@ LLFIO_V2_NAMESPACE_END
 #else
 #include "detail/impl/posix/utils.ipp"
 #endif
+#include "detail/impl/large_page_pool.ipp"
+#include "detail/impl/memory_pressure_reclaimer.ipp"
+#include "detail/impl/process_memory_usage_sampler.ipp"
+#include "detail/impl/random_fill.ipp"
 #undef LLFIO_INCLUDED_BY_HEADER
 #endif
 
@@ -0,0 +1,269 @@
+/* A view of a section mapped lazily in fixed size windows
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_WINDOWED_MAP_VIEW_H
+#define LLFIO_WINDOWED_MAP_VIEW_H
+
+#include "map_handle.hpp"
+
+#include <vector>
+
+//! \file windowed_map_view.hpp Provides `windowed_map_view`
+
+LLFIO_V2_NAMESPACE_EXPORT_BEGIN
+
+/*! \class windowed_map_view
+\brief A view of a `section_handle` which maps fixed size windows of the section on demand,
+keeping no more than an address space budget of windows resident, evicting the least recently
+used window when a new one is needed.
+
+This lets you walk sections far larger than the address space, such as a 50Gb file on a 32 bit
+host, or bound the page table memory consumed by walking a large file on a 64 bit host. Windows
+are mapped using `map_handle::map()`, so the section must outlive this view.
+
+The budget is rounded down to a whole number of windows, and is always at least one window.
+The window size is rounded up to the page size, or to the allocation granularity of 64Kb on
+Microsoft Windows.
+
+\warning Any span returned by `window_at()` or `cursor::current()` is invalidated by the next
+call to either which maps a new window, as that may evict the window previously returned. If
+you need many spans alive at once, size the budget to hold that many windows, and make sure no
+span straddles windows. This class is not thread safe.
+*/
+class windowed_map_view
+{
+public:
+  using extent_type = map_handle::extent_type;
+  using size_type = map_handle::size_type;
+  using buffer_type = map_handle::buffer_type;
+
+private:
+  struct _window_t
+  {
+    extent_type offset{0};
+    size_type bytes{0};
+    map_handle mh;
+    uint64_t lastused{0};
+  };
+  section_handle *_sh{nullptr};
+  section_handle::flag _flag{section_handle::flag::none};
+  size_type _window_size{0};
+  size_t _max_windows{0};
+  extent_type _length{0};
+  uint64_t _clock{0};
+  std::vector<_window_t> _windows;
+  size_t _maps{0}, _evictions{0};
+
+public:
+  //! Default constructor
+  windowed_map_view() {}  // NOLINT
+  /*! Constructs a view onto `sh`, mapping windows of `window_size` bytes with `_flag`, keeping
+  no more than `address_space_budget` bytes of windows mapped at once.
+  */
+  windowed_map_view(section_handle &sh, size_type window_size, size_type address_space_budget, section_handle::flag _flag = section_handle::flag::read)
+      : _sh(&sh)
+      , _flag(_flag)
+  {
+#ifdef _WIN32
+    const size_type granularity = 65536;
+#else
+    const size_type granularity = utils::page_size();
+#endif
+    _window_size = (window_size == 0) ? granularity : utils::round_up_to_page_size(window_size, granularity);
+    _max_windows = address_space_budget / _window_size;
+    if(_max_windows == 0)
+    {
+      _max_windows = 1;
+    }
+    _windows.reserve(_max_windows);
+    auto length = sh.length();
+    if(length)
+    {
+      _length = length.value();
+    }
+  }
+  windowed_map_view(const windowed_map_view &) = delete;
+  //! Move construction permitted
+  windowed_map_view(windowed_map_view &&) = default;
+  windowed_map_view &operator=(const windowed_map_view &) = delete;
+  //! Move assignment permitted
+  windowed_map_view &operator=(windowed_map_view &&) = default;
+  ~windowed_map_view() = default;
+
+  //! True if this view refers to a section
+  bool is_valid() const noexcept { return _sh != nullptr; }
+  //! The section this view maps windows of
+  section_handle *section() const noexcept { return _sh; }
+  //! The size of each window in bytes
+  size_type window_size() const noexcept { return _window_size; }
+  //! The maximum number of windows which will be mapped at once
+  size_t max_windows() const noexcept { return _max_windows; }
+  //! The number of windows currently mapped
+  size_t resident_windows() const noexcept { return _windows.size(); }
+  //! The number of windows mapped, and evicted, over the lifetime of this view
+  std::pair<size_t, size_t> statistics() const noexcept { return {_maps, _evictions}; }
+  //! The length of the section when this view was constructed, or last `update_length()`.
+  extent_type length() const noexcept { return _length; }
+  /*! Refreshes the length of the section, evicting any windows which now lie partially or
+  wholly beyond it.
+  */
+  result<extent_type> update_length() noexcept
+  {
+    OUTCOME_TRY(auto &&length, _sh->length());
+    _length = length;
+    for(size_t n = 0; n < _windows.size();)
+    {
+      // Evict windows now beyond the end, and any short final window which is no longer final
+      const extent_type end = _windows[n].offset + _windows[n].bytes;
+      if(end > _length || (_windows[n].bytes < _window_size && end < _length))
+      {
+        OUTCOME_TRY(_windows[n].mh.close());
+        _windows.erase(_windows.begin() + n);
+      }
+      else
+      {
+        ++n;
+      }
+    }
+    return _length;
+  }
+  //! Unmaps all resident windows
+  result<void> evict_all() noexcept
+  {
+    for(auto &w : _windows)
+    {
+      OUTCOME_TRY(w.mh.close());
+    }
+    _windows.clear();
+    return success();
+  }
+
+  /*! \brief Returns the bytes from `offset` until the end of the window containing `offset`,
+  mapping that window if it is not resident, and evicting the least recently used window if
+  the budget is full.
+
+  The span is empty if `offset` is at or beyond `length()`.
+  */
+  result<buffer_type> window_at(extent_type offset) noexcept
+  {
+    if(_sh == nullptr)
+    {
+      return errc::invalid_argument;
+    }
+    if(offset >= _length)
+    {
+      return buffer_type{};
+    }
+    const extent_type windowoffset = offset - (offset % _window_size);
+    _window_t *w = nullptr;
+    for(auto &i : _windows)
+    {
+      if(i.offset == windowoffset)
+      {
+        w = &i;
+        break;
+      }
+    }
+    if(w == nullptr)
+    {
+      if(_windows.size() == _max_windows)
+      {
+        auto victim = _windows.begin();
+        for(auto it = _windows.begin() + 1; it != _windows.end(); ++it)
+        {
+          if(it->lastused < victim->lastused)
+          {
+            victim = it;
+          }
+        }
+        OUTCOME_TRY(victim->mh.close());
+        _windows.erase(victim);
+        ++_evictions;
+      }
+      size_type bytes = _window_size;
+      if(bytes > _length - windowoffset)
+      {
+        bytes = (size_type)(_length - windowoffset);
+      }
+      OUTCOME_TRY(auto &&mh, map_handle::map(*_sh, bytes, windowoffset, _flag));
+      _windows.push_back(_window_t{windowoffset, bytes, std::move(mh), 0});
+      w = &_windows.back();
+      ++_maps;
+    }
+    w->lastused = ++_clock;
+    const size_type skip = (size_type)(offset - windowoffset);
+    return buffer_type{w->mh.address() + skip, w->bytes - skip};
+  }
+
+  /*! \class cursor
+  \brief A span-like position within a `windowed_map_view`, which yields the contiguous bytes
+  from its position to the end of the current window.
+  */
+  class cursor
+  {
+    windowed_map_view *_parent{nullptr};
+    extent_type _offset{0};
+
+  public:
+    //! Default constructor
+    constexpr cursor() {}  // NOLINT
+    //! Constructs a cursor at `offset` into `parent`
+    constexpr cursor(windowed_map_view &parent, extent_type offset = 0) noexcept
+        : _parent(&parent)
+        , _offset(offset)
+    {
+    }
+    //! The offset of this cursor into the section
+    constexpr extent_type offset() const noexcept { return _offset; }
+    //! True if this cursor is at or beyond the end of the section
+    bool at_end() const noexcept { return _parent == nullptr || _offset >= _parent->length(); }
+    //! The bytes from this cursor until the end of its window, which are empty at the end.
+    result<buffer_type> current() const noexcept
+    {
+      if(_parent == nullptr)
+      {
+        return buffer_type{};
+      }
+      return _parent->window_at(_offset);
+    }
+    //! Advances the cursor by `bytes`
+    cursor &operator+=(extent_type bytes) noexcept
+    {
+      _offset += bytes;
+      return *this;
+    }
+    //! Moves the cursor to `offset`
+    cursor &seek(extent_type offset) noexcept
+    {
+      _offset = offset;
+      return *this;
+    }
+  };
+  //! Returns a cursor at `offset` into this view
+  cursor begin_at(extent_type offset = 0) noexcept { return cursor(*this, offset); }
+};
+
+LLFIO_V2_NAMESPACE_END
+
+#endif
@@ -368,11 +368,14 @@ completion i/o min 1300 max 1.40714e+06 mean 23037 stddev 15035.4
 
 #include "quickcpplib/algorithm/small_prng.hpp"
 
+#include <algorithm>
 #include <cfloat>
 #include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
 #include <typeinfo>
 #include <vector>
@@ -866,16 +869,14 @@ template <class HandleType = NoHandle> struct benchmark_llfio
   {
     benchmark_llfio *parent{nullptr};
     HandleType read_handle;
-    std::unique_ptr<llfio::byte[]> io_state_ptr;
     llfio::byte _buffer[sizeof(size_t)];
     buffer_type buffer;
-    llfio::io_multiplexer::io_operation_state *io_state{nullptr};
+    llfio::io_multiplexer::pooled_io_operation_state_ptr io_state;
     std::chrono::high_resolution_clock::time_point when_read_completed;
 
     explicit receiver_type(benchmark_llfio *_parent, HandleType &&h)
         : parent(_parent)
         , read_handle(std::move(h))
-        , io_state_ptr(std::make_unique<llfio::byte[]>(read_handle.multiplexer()->io_state_requirements().first))
         , buffer(_buffer, sizeof(_buffer))
     {
       memset(_buffer, 0, sizeof(_buffer));
@@ -884,7 +885,6 @@ template <class HandleType = NoHandle> struct benchmark_llfio
     receiver_type(receiver_type &&o) noexcept
         : parent(o.parent)
         , read_handle(std::move(o.read_handle))
-        , io_state_ptr(std::move(o.io_state_ptr))
     {
       if(o.io_state != nullptr)
       {
@@ -902,8 +902,7 @@ template <class HandleType = NoHandle> struct benchmark_llfio
         {
           abort();
         }
-        io_state->~io_operation_state();
-        io_state = nullptr;
+        io_state.reset();
       }
     }
 
@@ -918,7 +917,7 @@ template <class HandleType = NoHandle> struct benchmark_llfio
         }
       }
       buffer = {_buffer, sizeof(_buffer)};
-      io_state = read_handle.multiplexer()->construct_and_init_io_operation({io_state_ptr.get(), 4096 /*lies*/}, &read_handle, this, {}, {}, io_request<buffers_type>({&buffer, 1}, 0));
+      io_state = read_handle.multiplexer()->construct_and_init_pooled(&read_handle, this, {}, {}, io_request<buffers_type>({&buffer, 1}, 0)).value();
     }
 
     // Called when the read completes
@@ -942,8 +941,7 @@ template <class HandleType = NoHandle> struct benchmark_llfio
     // Called when the state for the read can be disposed
     virtual void read_finished(llfio::io_multiplexer::io_operation_state::lock_guard & /*g*/, llfio::io_operation_state_type /*former*/) override
     {
-      io_state->~io_operation_state();
-      io_state = nullptr;
+      io_state.reset();
     }
   };
 
@@ -983,7 +981,7 @@ template <class HandleType = NoHandle> struct benchmark_llfio
       done = 0;
       for(auto &i : read_states)
       {
-        if(i.io_state == nullptr || is_finished(multiplexer->check_io_operation(i.io_state)))
+        if(i.io_state == nullptr || is_finished(multiplexer->check_io_operation(i.io_state.get())))
         {
           done++;
         }
@@ -1005,7 +1003,7 @@ template <class HandleType = NoHandle> struct benchmark_llfio
     {
       if(i.io_state != nullptr)
       {
-        (void) multiplexer->cancel_io_operation(i.io_state);
+        (void) multiplexer->cancel_io_operation(i.io_state.get());
       }
     }
   }
@@ -1016,6 +1014,206 @@ template <class HandleType = NoHandle> struct benchmark_llfio
   }
 };
 
+/* Random 4Kb reads of files, each of `count` reads always in flight so `count` is the queue
+depth, spread across `files` files. Unlike pipes, there is no writer thread, the latency
+timed is from initiating each read to its completion being reaped.
+*/
+template <bool UseRegisteredBuffers> struct benchmark_llfio_file
+{
+  using mode = typename llfio::file_handle::mode;
+  using creation = typename llfio::file_handle::creation;
+  using caching = typename llfio::file_handle::caching;
+  using flag = typename llfio::file_handle::flag;
+  using buffer_type = typename llfio::file_handle::buffer_type;
+  using buffers_type = typename llfio::file_handle::buffers_type;
+  using registered_buffer_type = typename llfio::file_handle::registered_buffer_type;
+  template <class T> using io_request = typename llfio::file_handle::template io_request<T>;
+  template <class T> using io_result = typename llfio::file_handle::template io_result<T>;
+
+  static constexpr bool launch_writer_thread = false;
+  static constexpr size_t block_size = 4096;
+  static constexpr llfio::file_handle::extent_type file_size = 256 * 1024 * 1024;
+
+  struct receiver_type final : public llfio::io_multiplexer::io_operation_state_visitor
+  {
+    benchmark_llfio_file *parent{nullptr};
+    llfio::file_handle *read_handle{nullptr};
+    llfio::byte *_buffer{nullptr};
+    registered_buffer_type registered_buffer;
+    buffer_type buffer;
+    QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng rand;
+    llfio::io_multiplexer::pooled_io_operation_state_ptr io_state;
+    std::chrono::high_resolution_clock::time_point when_read_completed;
+
+    receiver_type(benchmark_llfio_file *_parent, llfio::file_handle *h, llfio::byte *b, uint32_t seed)
+        : parent(_parent)
+        , read_handle(h)
+        , _buffer(b)
+        , rand(seed)
+    {
+      if(UseRegisteredBuffers)
+      {
+        size_t bytes = block_size;
+        registered_buffer = read_handle->allocate_registered_buffer(bytes).value();
+        _buffer = registered_buffer->data();
+      }
+    }
+    receiver_type(const receiver_type &) = delete;
+    receiver_type(receiver_type &&o) = delete;
+    receiver_type &operator=(const receiver_type &) = delete;
+    receiver_type &operator=(receiver_type &&) = delete;
+    ~receiver_type()
+    {
+      if(io_state != nullptr)
+      {
+        if(!is_finished(io_state->current_state()))
+        {
+          abort();
+        }
+        io_state.reset();
+      }
+    }
+
+    // Initiate the read
+    void begin_io()
+    {
+      if(io_state != nullptr)
+      {
+        if(!is_finished(io_state->current_state()))
+        {
+          abort();
+        }
+      }
+      buffer = {_buffer, block_size};
+      const auto offset = (llfio::file_handle::extent_type)(rand() % (file_size / block_size)) * block_size;
+      io_state = read_handle->multiplexer()
+                 ->construct_and_init_pooled(read_handle, this, registered_buffer_type(registered_buffer), {}, io_request<buffers_type>({&buffer, 1}, offset))
+                 .value();
+    }
+
+    // Called when the read completes
+    virtual bool read_completed(llfio::io_multiplexer::io_operation_state::lock_guard & /*g*/, llfio::io_operation_state_type /*former*/, io_result<buffers_type> &&res) override
+    {
+      when_read_completed = std::chrono::high_resolution_clock::now();
+      if(!res)
+      {
+        abort();
+      }
+      if(res.value().size() != 1 || res.value()[0].size() != block_size)
+      {
+        abort();
+      }
+      return true;
+    }
+
+    // Called when the state for the read can be disposed
+    virtual void read_finished(llfio::io_multiplexer::io_operation_state::lock_guard & /*g*/, llfio::io_operation_state_type /*former*/) override
+    {
+      io_state.reset();
+    }
+  };
+
+  llfio::io_multiplexer_ptr multiplexer;
+  llfio::map_handle buffers;
+  std::vector<llfio::file_handle> files;
+  std::vector<std::unique_ptr<receiver_type>> read_states;
+
+  benchmark_llfio_file(size_t count, llfio::io_multiplexer_ptr (*make_multiplexer)(), caching _caching, size_t filecount)
+  {
+    multiplexer = make_multiplexer();
+    // Page aligned buffers, as caching::none requires aligned i/o
+    buffers = llfio::map_handle::map((count + 1) * block_size).value();
+    static constexpr size_t fill_size = 1024 * 1024;
+    auto fill = llfio::map_handle::map(fill_size).value();
+    memset(fill.address(), 78, fill_size);
+    for(size_t n = 0; n < filecount; n++)
+    {
+      auto fh = llfio::file_handle::uniquely_named_file(llfio::path_discovery::storage_backed_temporary_files_directory(), mode::write, _caching,
+                                                        flag::unlink_on_first_close | flag::multiplexable)
+                .value();
+      for(llfio::file_handle::extent_type offset = 0; offset < file_size; offset += fill_size)
+      {
+        fh.write(offset, {{fill.address(), fill_size}}).value();
+      }
+      fh.set_multiplexer(multiplexer.get()).value();
+      files.push_back(std::move(fh));
+    }
+    read_states.reserve(count);
+    for(size_t n = 0; n < count; n++)
+    {
+      read_states.push_back(std::make_unique<receiver_type>(this, &files[n % filecount], buffers.address() + n * block_size, (uint32_t) n + 1));
+    }
+  }
+  std::chrono::high_resolution_clock::time_point read(unsigned which)
+  {
+    auto ret = read_states[which]->when_read_completed;
+    read_states[which]->when_read_completed = {};
+    read_states[which]->begin_io();
+    return ret;
+  }
+  void check()
+  {
+    // Reads of cached file content may complete immediately, so count completions rather than reaps
+    for(;;)
+    {
+      size_t done = 0;
+      for(auto &i : read_states)
+      {
+        if(i->when_read_completed != std::chrono::high_resolution_clock::time_point())
+        {
+          done++;
+        }
+      }
+      if(done == read_states.size())
+      {
+        return;
+      }
+      multiplexer->check_for_any_completed_io().value();
+    }
+  }
+  void write(unsigned /*unused*/) {}
+  void cancel()
+  {
+    for(auto &i : read_states)
+    {
+      if(i->io_state != nullptr)
+      {
+        (void) multiplexer->cancel_io_operation(i->io_state.get());
+      }
+    }
+  }
+  void destroy()
+  {
+    while(std::any_of(read_states.begin(), read_states.end(), [](const std::unique_ptr<receiver_type> &i) { return i->io_state != nullptr; }))
+    {
+      multiplexer->check_for_any_completed_io().value();
+    }
+    read_states.clear();
+    files.clear();
+    multiplexer.reset();
+  }
+};
+
+// Sweeps queue depth for cached and uncached files, with and without registered buffers, across one and many files
+static void benchmark_files(const char *csvprefix, const char *desc, llfio::io_multiplexer_ptr (*make_multiplexer)())
+{
+  using caching = llfio::file_handle::caching;
+  std::cout << "\nWarming up ..." << std::endl;
+  do_benchmark<benchmark_llfio_file<false>>(-1, make_multiplexer, caching::all, (size_t) 1);
+  for(auto _caching : {caching::all, caching::none})
+  {
+    for(size_t filecount : {(size_t) 1, (size_t) 16})
+    {
+      const std::string suffix = std::string((_caching == caching::all) ? "-cached-" : "-uncached-") + std::to_string(filecount) + "-files";
+      const std::string description = std::string(desc) + " with " + std::to_string(filecount) + ((_caching == caching::all) ? " cached" : " uncached") + " files";
+      benchmark<benchmark_llfio_file<false>>(llfio::path_view(std::string(csvprefix) + suffix + ".csv"), 64, description.c_str(), make_multiplexer, _caching,
+                                             filecount);
+      benchmark<benchmark_llfio_file<true>>(llfio::path_view(std::string(csvprefix) + suffix + "-registered.csv"), 64, (description + " and registered buffers").c_str(),
+                                            make_multiplexer, _caching, filecount);
+    }
+  }
+}
+
 #if ENABLE_ASIO
 struct benchmark_asio_pipe
 {
@@ -1135,15 +1333,56 @@ int main(void)
 #ifdef _WIN32
   std::cout << "\nWarming up ..." << std::endl;
   do_benchmark<benchmark_llfio<llfio::pipe_handle>>(-1, //
-    []() -> llfio::io_multiplexer_ptr { return llfio::test::multiplexer_win_iocp(2, true).value(); });
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_win_iocp(2, true).value(); });
   // No locking, enable IOCP immediate completions. ASIO can't compete with this.
   benchmark<benchmark_llfio<llfio::pipe_handle>>("llfio-pipe-handle-unsynchronised.csv", 64, "llfio::pipe_handle and IOCP unsynchronised", //
-    []() -> llfio::io_multiplexer_ptr { return llfio::test::multiplexer_win_iocp(1, false).value(); });
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_win_iocp(1, false).value(); });
   // Locking enabled, disable IOCP immediate completions so it's a fair comparison with ASIO
   benchmark<benchmark_llfio<llfio::pipe_handle>>("llfio-pipe-handle-synchronised.csv", 64, "llfio::pipe_handle and IOCP synchronised", //
-    []() -> llfio::io_multiplexer_ptr { return llfio::test::multiplexer_win_iocp(2, true).value(); });
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_win_iocp(2, true).value(); });
+#endif
+
+#ifdef __linux__
+  std::cout << "\nWarming up ..." << std::endl;
+  do_benchmark<benchmark_llfio<llfio::pipe_handle>>(-1, //
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_linux_epoll(2).value(); });
+  benchmark<benchmark_llfio<llfio::pipe_handle>>("llfio-pipe-handle-epoll-unsynchronised.csv", 64, "llfio::pipe_handle and epoll unsynchronised", //
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_linux_epoll(1).value(); });
+  benchmark<benchmark_llfio<llfio::pipe_handle>>("llfio-pipe-handle-epoll-synchronised.csv", 64, "llfio::pipe_handle and epoll synchronised", //
+    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_linux_epoll(2).value(); });
 #endif
 
+#ifdef _WIN32
+  benchmark_files("llfio-file-handle-iocp", "llfio::file_handle and IOCP unsynchronised", //
+                  []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_win_iocp(1, false).value(); });
+  if(!llfio::multiplexer_win_ioring(1))
+  {
+    std::cout << "\nNOTE: IoRing is not available on this Windows, skipping IoRing file benchmarks." << std::endl;
+  }
+  else
+  {
+    benchmark_files("llfio-file-handle-ioring-unsynchronised", "llfio::file_handle and IoRing unsynchronised", //
+                    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_win_ioring(1).value(); });
+  }
+#endif
+
+#ifdef __linux__
+  if(!llfio::multiplexer_linux_io_uring(1, false))
+  {
+    std::cout << "\nNOTE: io_uring is not available on this kernel, skipping io_uring file benchmarks." << std::endl;
+  }
+  else
+  {
+    benchmark_files("llfio-file-handle-io-uring-unsynchronised", "llfio::file_handle and io_uring unsynchronised", //
+                    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_linux_io_uring(1, false).value(); });
+    benchmark_files("llfio-file-handle-io-uring-synchronised", "llfio::file_handle and io_uring synchronised", //
+                    []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_linux_io_uring(2, false).value(); });
+  }
+#endif
+
+  benchmark_files("llfio-file-handle-thread-pool", "llfio::file_handle and thread pool", //
+                  []() -> llfio::io_multiplexer_ptr { return llfio::multiplexer_thread_pool().value(); });
+
 #if ENABLE_ASIO
   std::cout << "\nWarming up ..." << std::endl;
   do_benchmark<benchmark_asio_pipe>(-1, 2);
@@ -22,16 +22,28 @@ Distributed under the Boost Software License, Version 1.0.
           http://www.boost.org/LICENSE_1_0.txt)
 */
 
-#define MINBLOCKSIZE (4096)
-#define MAXBLOCKSIZE (4096)
+#define MINBLOCKSIZE (512)
+#define MAXBLOCKSIZE (65536)
 #define REGIONSIZE (100 * 1024 * 1024)
+#define QUEUEDEPTH (32)
+
+// benchmark-iostreams-nohotlog is this program with LLFIO_DISABLE_HOT_PATH_LOGGING defined
+#ifdef LLFIO_DISABLE_HOT_PATH_LOGGING
+#define RESULTS_SUFFIX "_nohotlog"
+#else
+#define RESULTS_SUFFIX ""
+#endif
 
 #include "../../include/llfio/llfio.hpp"
 #include "quickcpplib/algorithm/small_prng.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace llfio = LLFIO_V2_NAMESPACE;
@@ -94,36 +106,95 @@ inline uint64_t nanoclock()
   return (uint64_t)((ticksclock() - offset) / ticks_per_sec);
 }
 
-template <class F> inline void run_test(const char *csv, off_t max_extent, F &&f)
+struct test_options
+{
+  size_t alignment{16};                // Offsets and the buffer are aligned to this
+  size_t minblocksize{MINBLOCKSIZE};   // Block sizes below this are skipped
+  size_t maxops{512 * 1024};           // The most operations done per block size
+};
+
+// One line of results.json
+struct test_summary
+{
+  std::string name;
+  size_t blocksize, threads, ops;
+  double mean, p50, p90, p99, p999, max, mbpersec;
+};
+static std::vector<test_summary> summaries;
+
+// Records percentiles of the latencies in nanoseconds, and throughput for elapsed nanoseconds in total
+inline void summarise(const char *name, size_t blocksize, size_t threads, std::vector<unsigned> latencies, uint64_t elapsed)
+{
+  if(latencies.empty())
+  {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return (double) latencies[(size_t)(p * (double) (latencies.size() - 1))]; };
+  test_summary r{name, blocksize, threads, latencies.size(), 0, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), (double) latencies.back(), 0};
+  for(auto i : latencies)
+  {
+    r.mean += i;
+  }
+  r.mean /= (double) latencies.size();
+  r.mbpersec = (elapsed == 0) ? 0 : ((double) blocksize * (double) latencies.size() / 1048576.0) / ((double) elapsed / 1000000000.0);
+  std::cout << "   " << name << " " << blocksize << " bytes x " << threads << " threads: mean " << r.mean << " ns, p50 " << r.p50 << " ns, p99 " << r.p99
+            << " ns, p99.9 " << r.p999 << " ns, " << r.mbpersec << " Mb/sec" << std::endl;
+  summaries.push_back(std::move(r));
+}
+
+inline void write_summaries(const char *json)
 {
-  char buffer[MAXBLOCKSIZE];
+  std::ofstream out(json);
+  out << "[";
+  for(size_t n = 0; n < summaries.size(); n++)
+  {
+    const auto &r = summaries[n];
+    out << (n ? ",\n" : "\n") << "{\"name\":\"" << r.name << "\",\"blocksize\":" << r.blocksize << ",\"threads\":" << r.threads << ",\"ops\":" << r.ops
+        << ",\"mean\":" << r.mean << ",\"p50\":" << r.p50 << ",\"p90\":" << r.p90 << ",\"p99\":" << r.p99 << ",\"p999\":" << r.p999 << ",\"max\":" << r.max
+        << ",\"mbpersec\":" << r.mbpersec << "}";
+  }
+  out << "\n]" << std::endl;
+}
+
+template <class F> inline void run_test(const char *name, off_t max_extent, F &&f, test_options opts = {})
+{
+  alignas(4096) static char buffer[MAXBLOCKSIZE];
   std::vector<std::pair<unsigned, unsigned>> offsets(512 * 1024);
   std::vector<std::vector<unsigned>> results;
   for(size_t blocksize = MINBLOCKSIZE; blocksize <= MAXBLOCKSIZE; blocksize <<= 1)
   {
+    results.emplace_back();
+    if(blocksize < opts.minblocksize)
+    {
+      continue;
+    }
     size_t scale = (512 * 1024) / (REGIONSIZE / blocksize) / 10;  // On average tap each block ten times
     if(scale < 1)
       scale = 1;
+    const size_t ops = (std::min)(offsets.size() / scale, opts.maxops);
     small_prng rand;
     for(auto &i : offsets)
     {
-      i.first = (rand() % (max_extent - MAXBLOCKSIZE)) & ~15;
+      i.first = (unsigned) ((rand() % (max_extent - MAXBLOCKSIZE)) & ~(opts.alignment - 1));
     }
     memset(buffer, 0, sizeof(buffer));
-    for(size_t n = 0; n < offsets.size() / scale; n++)
+    const auto testbegin = nanoclock();
+    for(size_t n = 0; n < ops; n++)
     {
       auto begin = nanoclock();
       f(offsets[n].first, buffer, blocksize);
       auto end = nanoclock();
       offsets[n].second = (unsigned int) (end - begin);
     }
-    results.emplace_back();
-    for(size_t n = 0; n < offsets.size() / scale; n++)
+    const auto testend = nanoclock();
+    for(size_t n = 0; n < ops; n++)
     {
       results.back().push_back(offsets[n].second);
     }
+    summarise(name, blocksize, 1, results.back(), testend - testbegin);
   }
-  std::ofstream out(csv);
+  std::ofstream out(std::string(name) + RESULTS_SUFFIX ".csv");
   for(size_t blocksize = MINBLOCKSIZE; blocksize <= MAXBLOCKSIZE; blocksize <<= 1)
   {
     out << "," << blocksize;
@@ -141,6 +212,46 @@ template <class F> inline void run_test(const char *csv, off_t max_extent, F &&f
   }
 }
 
+// Runs f(offset, buffer, len) of BLOCKSIZE concurrently from each of threads threads
+template <class F> inline void run_threaded_test(const char *name, size_t threads, F &&f)
+{
+  static constexpr size_t BLOCKSIZE = 4096, OPS = 64 * 1024;
+  std::vector<std::vector<unsigned>> latencies(threads);
+  std::vector<std::thread> workers;
+  std::atomic<bool> go{false};
+  for(size_t t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&, t] {
+      alignas(4096) char buffer[BLOCKSIZE];
+      small_prng rand((uint32_t) t + 1);
+      latencies[t].reserve(OPS);
+      while(!go.load(std::memory_order_acquire))
+        ;
+      for(size_t n = 0; n < OPS; n++)
+      {
+        const unsigned offset = (unsigned) ((rand() % (REGIONSIZE - BLOCKSIZE)) & ~(BLOCKSIZE - 1));
+        auto begin = nanoclock();
+        f(offset, buffer, BLOCKSIZE);
+        auto end = nanoclock();
+        latencies[t].push_back((unsigned) (end - begin));
+      }
+    });
+  }
+  const auto begin = nanoclock();
+  go.store(true, std::memory_order_release);
+  for(auto &i : workers)
+  {
+    i.join();
+  }
+  const auto end = nanoclock();
+  std::vector<unsigned> all;
+  for(auto &i : latencies)
+  {
+    all.insert(all.end(), i.begin(), i.end());
+  }
+  summarise(name, BLOCKSIZE, threads, std::move(all), end - begin);
+}
+
 int main()
 {
   {
@@ -164,7 +275,7 @@ int main()
     {
       i = malloc(rand() % 4096);
     }
-    run_test("file_handle_malloc_free.csv", 1024 * 1024, [&](unsigned offset, char *buffer, size_t len) {
+    run_test("file_handle_malloc_free", 1024 * 1024, [&](unsigned offset, char *buffer, size_t len) {
       th.read(offset, {{(llfio::byte *) buffer, len}}).value();
       for(size_t n = 0; n < rand() % 64; n++)
       {
@@ -185,7 +296,7 @@ int main()
     std::cout << "Testing latency of iostreams ..." << std::endl;
     std::ifstream testfile("testfile");
     testfile.exceptions(std::ios::failbit | std::ios::badbit);
-    run_test("iostreams.csv", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
+    run_test("iostreams", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
       testfile.seekg(offset, std::ios::beg);
       testfile.read(buffer, len);
     });
@@ -194,13 +305,160 @@ int main()
   {
     std::cout << "Testing latency of llfio::file_handle ..." << std::endl;
     auto th = llfio::file({}, "testfile").value();
-    run_test("file_handle.csv", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+    run_test("file_handle", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+  }
+  {
+    // Single byte reads of cached data are dominated by per call overhead, so best show any saving from LLFIO_DISABLE_HOT_PATH_LOGGING
+#ifdef LLFIO_DISABLE_HOT_PATH_LOGGING
+    std::cout << "Testing mean latency of single byte llfio::file_handle reads with hot path logging compiled out ..." << std::endl;
+#else
+    std::cout << "Testing mean latency of single byte llfio::file_handle reads ..." << std::endl;
+#endif
+    auto th = llfio::file({}, "testfile").value();
+    static constexpr size_t iterations = 1000000;
+    char c;
+    th.read(0, {{(llfio::byte *) &c, 1}}).value();
+    auto begin = nanoclock();
+    for(size_t n = 0; n < iterations; n++)
+    {
+      th.read(n * 64 % REGIONSIZE, {{(llfio::byte *) &c, 1}}).value();
+    }
+    auto end = nanoclock();
+    std::cout << "   " << (double) (end - begin) / iterations << " ns per read" << std::endl;
   }
 #if 1
   {
     std::cout << "Testing latency of llfio::mapped_file_handle ..." << std::endl;
     auto th = llfio::mapped_file({}, "testfile").value();
-    run_test("mapped_file_handle.csv", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+    run_test("mapped_file_handle", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+  }
+#endif
+#if 1
+  {
+    std::cout << "Testing latency of iostreams writes ..." << std::endl;
+    std::fstream testfile("testfile", std::ios::in | std::ios::out | std::ios::binary);
+    testfile.exceptions(std::ios::failbit | std::ios::badbit);
+    run_test("iostreams_write", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
+      testfile.seekp(offset, std::ios::beg);
+      testfile.write(buffer, len);
+    });
+  }
+#endif
+  {
+    std::cout << "Testing latency of llfio::file_handle writes ..." << std::endl;
+    auto th = llfio::file({}, "testfile", llfio::file_handle::mode::write).value();
+    run_test("file_handle_write", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.write(offset, {{(const llfio::byte *) buffer, len}}).value(); });
+    std::cout << "Testing latency of llfio::file_handle mixed 70% reads 30% writes ..." << std::endl;
+    small_prng rand;
+    run_test("file_handle_mixed", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
+      if(rand() % 10 < 7)
+      {
+        th.read(offset, {{(llfio::byte *) buffer, len}}).value();
+      }
+      else
+      {
+        th.write(offset, {{(const llfio::byte *) buffer, len}}).value();
+      }
+    });
+  }
+  {
+    // Writes with caching::reads complete only when on storage, and caching::none requires aligned i/o
+    struct
+    {
+      const char *name;
+      llfio::file_handle::caching caching;
+      test_options opts;
+    } modes[] = {{"reads", llfio::file_handle::caching::reads, {16, MINBLOCKSIZE, 4096}},  //
+                 {"none", llfio::file_handle::caching::none, {4096, 4096, 16384}}};
+    for(auto &mode : modes)
+    {
+      auto r = llfio::file({}, "testfile", llfio::file_handle::mode::write, llfio::file_handle::creation::open_existing, mode.caching);
+      if(!r)
+      {
+        std::cout << "NOTE: caching::" << mode.name << " is not available for this file, skipping those tests (" << r.error().message() << ")" << std::endl;
+        continue;
+      }
+      auto th = std::move(r).value();
+      std::cout << "Testing latency of llfio::file_handle with caching::" << mode.name << " ..." << std::endl;
+      run_test((std::string("file_handle_caching_") + mode.name).c_str(), REGIONSIZE,
+               [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); }, mode.opts);
+      std::cout << "Testing latency of llfio::file_handle writes with caching::" << mode.name << " ..." << std::endl;
+      run_test((std::string("file_handle_write_caching_") + mode.name).c_str(), REGIONSIZE,
+               [&](unsigned offset, char *buffer, size_t len) { th.write(offset, {{(const llfio::byte *) buffer, len}}).value(); }, mode.opts);
+    }
+  }
+#if 1
+  {
+    std::cout << "Testing latency of llfio::mapped_file_handle writes ..." << std::endl;
+    auto th = llfio::mapped_file({}, "testfile", llfio::mapped_file_handle::mode::write).value();
+    run_test("mapped_file_handle_write", REGIONSIZE,
+             [&](unsigned offset, char *buffer, size_t len) { th.write(offset, {{(const llfio::byte *) buffer, len}}).value(); });
+  }
+#endif
+  {
+    std::cout << "Testing latency and throughput of 4Kb llfio::file_handle reads from multiple threads ..." << std::endl;
+    auto th = llfio::file({}, "testfile").value();
+    const size_t maxthreads = (std::max)(std::thread::hardware_concurrency(), 1U);
+    for(size_t threads = 1; threads <= maxthreads; threads <<= 1)
+    {
+      run_threaded_test("file_handle_threads", threads, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+    }
+  }
+#ifdef __linux__
+  {
+    auto r = llfio::multiplexer_linux_io_uring(1, false);
+    if(!r)
+    {
+      std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping io_uring tests (" << r.error().message() << ")" << std::endl;
+    }
+    else
+    {
+      auto multiplexer = std::move(r).value();
+      auto th = llfio::file({}, "testfile", llfio::file_handle::mode::read, llfio::file_handle::creation::open_existing, llfio::file_handle::caching::all,
+                            llfio::file_handle::flag::multiplexable)
+                .value();
+      th.set_multiplexer(multiplexer.get()).value();
+      std::cout << "Testing latency of llfio::file_handle reads via io_uring ..." << std::endl;
+      run_test("io_uring_file_handle", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) { th.read(offset, {{(llfio::byte *) buffer, len}}).value(); });
+
+      std::cout << "Testing latency and throughput of batches of " << QUEUEDEPTH << " concurrent 4Kb llfio::file_handle reads via io_uring ..." << std::endl;
+      static constexpr size_t BLOCKSIZE = 4096, BATCHES = 4096;
+      const auto state_reqs = multiplexer->io_state_requirements();
+      const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+      std::vector<llfio::byte> storage(state_size * QUEUEDEPTH + state_reqs.second), buffers(BLOCKSIZE * QUEUEDEPTH);
+      auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+      llfio::file_handle::buffer_type bs[QUEUEDEPTH];
+      llfio::io_multiplexer::io_operation_state *states[QUEUEDEPTH];
+      std::vector<unsigned> latencies;
+      latencies.reserve(BATCHES);
+      small_prng rand;
+      const auto testbegin = nanoclock();
+      for(size_t batch = 0; batch < BATCHES; batch++)
+      {
+        auto begin = nanoclock();
+        for(size_t n = 0; n < QUEUEDEPTH; n++)
+        {
+          bs[n] = {buffers.data() + n * BLOCKSIZE, BLOCKSIZE};
+          const llfio::file_handle::extent_type offset = (rand() % (REGIONSIZE - BLOCKSIZE)) & ~(BLOCKSIZE - 1);
+          states[n] = multiplexer->construct_and_init_io_operation({base + n * state_size, state_size}, &th, nullptr, {}, {},
+                                                                   llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&bs[n], 1}, offset));
+        }
+        multiplexer->flush_inited_io_operations().value();
+        for(size_t n = 0; n < QUEUEDEPTH; n++)
+        {
+          while(!is_finished(states[n]->current_state()))
+          {
+            multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+          }
+          std::move(*states[n]).get_completed_read().value();
+          states[n]->~io_operation_state();
+        }
+        auto end = nanoclock();
+        latencies.push_back((unsigned) (end - begin));
+      }
+      const auto testend = nanoclock();
+      summarise((std::string("io_uring_qd") + std::to_string(QUEUEDEPTH)).c_str(), BLOCKSIZE * QUEUEDEPTH, 1, std::move(latencies), testend - testbegin);
+    }
   }
 #endif
 #if 1
@@ -217,7 +475,7 @@ int main()
       }
     }
 #endif
-    run_test("memcpy.csv", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
+    run_test("memcpy", REGIONSIZE, [&](unsigned offset, char *buffer, size_t len) {
 #if 0
       memcpy(buffer, th.address() + offset, len);
 #else
@@ -284,5 +542,6 @@ int main()
     });
   }
 #endif
+  write_summaries("results" RESULTS_SUFFIX ".json");
   llfio::filesystem::remove("testfile");
 }
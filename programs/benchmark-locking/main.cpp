@@ -28,6 +28,9 @@ Distributed under the Boost Software License, Version 1.0.
 //! Seconds to run the benchmark
 #define BENCHMARK_DURATION 10
 
+//! Seconds to run each combination of a scaling benchmark
+#define SCALING_BENCHMARK_DURATION 2
+
 #define _CRT_SECURE_NO_WARNINGS 1
 
 #include "../../include/llfio/llfio.hpp"
@@ -35,6 +38,8 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
 #ifdef _WIN32
@@ -98,23 +103,324 @@ static void child_unlocks(size_t id)
   *shared_memory = (size_t) -1;
 }
 
+enum class lock_algorithm
+{
+  unknown,
+  atomic_append,
+  byte_ranges,
+  lock_files,
+  memory_map,
+  safe_byte_ranges
+};
+//! Parses `[!]<algorithm>`, where a leading `!` means each contender locks entities unique to it
+static lock_algorithm parse_algorithm(const char *name, bool &contended)
+{
+  contended = (name[0] != '!');
+  if(!contended)
+    ++name;
+  if(!strcmp(name, "atomic_append"))
+    return lock_algorithm::atomic_append;
+  if(!strcmp(name, "byte_ranges"))
+    return lock_algorithm::byte_ranges;
+  if(!strcmp(name, "lock_files"))
+    return lock_algorithm::lock_files;
+  if(!strcmp(name, "memory_map"))
+    return lock_algorithm::memory_map;
+  if(!strcmp(name, "safe_byte_ranges"))
+    return lock_algorithm::safe_byte_ranges;
+  return lock_algorithm::unknown;
+}
+
+using shared_fs_mutex_ptr = std::unique_ptr<llfio::algorithm::shared_fs_mutex::shared_fs_mutex>;
+template <class T> static shared_fs_mutex_ptr make_algorithm_from(llfio::result<T> v)
+{
+  if(v.has_error())
+  {
+    std::cerr << "ERROR: Creation of lock algorithm returns " << v.error().message() << std::endl;
+    return nullptr;
+  }
+  return std::make_unique<T>(std::move(v).value());
+}
+//! Creates an instance of the lock algorithm whose lock file(s) live in `base`
+static shared_fs_mutex_ptr make_algorithm(lock_algorithm test, const llfio::path_handle &base)
+{
+  using namespace llfio::algorithm::shared_fs_mutex;
+  switch(test)
+  {
+  case lock_algorithm::atomic_append:
+    return make_algorithm_from(atomic_append::fs_mutex_append(base, "lockfile"));
+  case lock_algorithm::byte_ranges:
+    return make_algorithm_from(byte_ranges::fs_mutex_byte_ranges(base, "lockfile"));
+  case lock_algorithm::lock_files:
+    return make_algorithm_from(lock_files::fs_mutex_lock_files(base));
+  case lock_algorithm::memory_map:
+    return make_algorithm_from(memory_map<QUICKCPPLIB_NAMESPACE::algorithm::hash::passthru_hash>::fs_mutex_map(base, "lockfile"));
+  case lock_algorithm::safe_byte_ranges:
+    return make_algorithm_from(safe_byte_ranges::fs_mutex_safe_byte_ranges(base, "lockfile"));
+  case lock_algorithm::unknown:
+    break;
+  }
+  return nullptr;
+}
+
+//! Contended contenders all lock entities 0 to total_locks, uncontended contenders lock entities unique to them
+static std::vector<llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type> make_entities(size_t total_locks, bool contended, size_t this_contender)
+{
+  std::vector<llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type> entities(total_locks);
+  for(size_t n = 0; n < total_locks; n++)
+  {
+    if(contended)
+    {
+      entities[n].value = n;
+      entities[n].exclusive = true;
+    }
+    else
+    {
+      entities[n].value = (this_contender << 16) + n;  // guaranteed unique
+      entities[n].exclusive = true;
+    }
+  }
+  return entities;
+}
+
+//! Locks and unlocks repeatedly once `done` becomes zero, until it becomes non-zero
+static void run_locks(llfio::algorithm::shared_fs_mutex::shared_fs_mutex &algorithm, const std::vector<llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type> &entities, bool contended, size_t id,
+                      const std::atomic<int> &done, size_t &count)
+{
+  while(done == -1)
+    std::this_thread::yield();
+  while(!done)
+  {
+    auto result = algorithm.lock(entities, llfio::deadline(), false);
+    if(result.has_error())
+    {
+      std::cerr << "ERROR: Algorithm lock returns " << result.error().message() << std::endl;
+      return;
+    }
+    if(contended)
+      child_locks(id);
+    ++count;
+    auto guard = std::move(result.value());
+    if(contended)
+      child_unlocks(id);
+    guard.unlock();
+  }
+}
+
+static void print_statistics(const llfio::algorithm::shared_fs_mutex::shared_fs_mutex &algorithm)
+{
+  if(!algorithm.statistics_enabled())
+  {
+    return;
+  }
+  auto stats = algorithm.statistics();
+  size_t maxbucket = 0;
+  for(size_t n = 1; n < stats.hold_time_buckets; n++)
+  {
+    if(stats.max_hold_time[n] > stats.max_hold_time[maxbucket])
+    {
+      maxbucket = n;
+    }
+  }
+  std::cout << "STATS(acquisitions=" << stats.acquisitions << " failures=" << stats.failures << " retries=" << stats.retries << " randomisations=" << stats.randomisations
+            << " sleeps=" << stats.sleeps << " time_waiting_ms=" << std::chrono::duration_cast<std::chrono::milliseconds>(stats.time_waiting).count()
+            << " max_hold_time_us=" << std::chrono::duration_cast<std::chrono::microseconds>(stats.max_hold_time[maxbucket]).count() << " in bucket " << maxbucket << ")"
+            << std::endl;
+}
+
+/* Runs `contenders` threads within this process, each locking through its own instance
+of the lock algorithm, for `duration`. Returns the total locks per second, or -1 on failure.
+*/
+static long long benchmark_threads(lock_algorithm test, bool contended, const llfio::path_handle &base, size_t total_locks, size_t contenders, size_t first_id,
+                                   std::chrono::seconds duration)
+{
+  struct alignas(64) contender_state
+  {
+    shared_fs_mutex_ptr algorithm;
+    size_t count{0};
+  };
+  std::vector<contender_state> states(contenders);
+  for(auto &state : states)
+  {
+    state.algorithm = make_algorithm(test, base);
+    if(!state.algorithm)
+    {
+      return -1;
+    }
+  }
+  std::atomic<int> done(-1);
+  std::vector<std::thread> threads;
+  for(size_t n = 0; n < contenders; n++)
+  {
+    threads.emplace_back([&, n] {
+      const size_t id = first_id + n;
+      run_locks(*states[n].algorithm, make_entities(total_locks, contended, id), contended, id, done, states[n].count);
+    });
+  }
+  done = 0;
+  std::this_thread::sleep_for(duration);
+  done = 1;
+  long long results = 0;
+  for(size_t n = 0; n < contenders; n++)
+  {
+    threads[n].join();
+    results += states[n].count;
+  }
+  return results / duration.count();
+}
+
+static const char *usage = R"(Usage:
+  <program> [!]<algorithm> <entities> <no of waiters>
+      Launches waiter child processes on this host which lock the same entities.
+  <program> threads [!]<algorithm> <entities> <no of threads>
+      Runs threads within this process which each have their own instance of the algorithm.
+  <program> scaling [!]<algorithm> <max entities> <max threads>
+      As threads, but for powers of two of entities and threads, writing benchmark_locking_scaling.csv.
+  <program> hosts [!]<algorithm> <entities> <no of threads> <shared directory> <host index> <no of hosts>
+      As threads, but with the lock file in a directory shared between hosts e.g. via NFS. Start
+      host 0 first, it removes the rendezvous files of previous runs and reports the total.
+
+  <algorithm> is one of atomic_append, byte_ranges, lock_files, memory_map or safe_byte_ranges.
+  Prefixing it with ! makes each contender lock entities of its own.
+)";
+
 int main(int argc, char *argv[])
 {
   if(argc < 4)
   {
-    std::cerr << "Usage: " << argv[0] << " [!]<atomic_append|byte_ranges|lock_files|memory_map> <entities> <no of waiters>" << std::endl;
+    std::cerr << usage;
     return 1;
   }
   initialise_shared_memory();
 
 
+  // ******** IN PROCESS THREADS BEGIN HERE ********
+  if(!strcmp(argv[1], "threads") || !strcmp(argv[1], "scaling") || !strcmp(argv[1], "hosts"))
+  {
+    const bool hosts = !strcmp(argv[1], "hosts");
+    bool contended = true;
+    auto test = parse_algorithm(argv[2], contended);
+    size_t total_locks = (argc > 3) ? atoi(argv[3]) : 0, contenders = (argc > 4) ? atoi(argv[4]) : 0;
+    if(test == lock_algorithm::unknown || !total_locks || !contenders || (hosts && argc < 8))
+    {
+      std::cerr << usage;
+      return 1;
+    }
+    if(!strcmp(argv[1], "scaling"))
+    {
+      auto base = llfio::path_handle::path(".").value();
+      std::ofstream oh("benchmark_locking_scaling.csv");
+      oh << "algorithm,contenders,entities,ops_per_sec" << std::endl;
+      for(size_t threads = 1; threads <= contenders; threads <<= 1)
+      {
+        for(size_t entities = 1; entities <= total_locks; entities <<= 1)
+        {
+          auto result = benchmark_threads(test, contended, base, entities, threads, 0, std::chrono::seconds(SCALING_BENCHMARK_DURATION));
+          if(result < 0)
+          {
+            return 1;
+          }
+          std::cout << threads << " threads locking " << entities << " entities: " << result << " ops/sec" << std::endl;
+          oh << argv[2] << "," << threads << "," << entities << "," << result << std::endl;
+        }
+      }
+      return 0;
+    }
+    if(!hosts)
+    {
+      auto base = llfio::path_handle::path(".").value();
+      std::cout << "Benchmarking " << contenders << " threads for " << BENCHMARK_DURATION << " seconds ..." << std::endl;
+      auto result = benchmark_threads(test, contended, base, total_locks, contenders, 0, std::chrono::seconds(BENCHMARK_DURATION));
+      if(result < 0)
+      {
+        return 1;
+      }
+      std::cout << "Total result: " << result << " ops/sec" << std::endl;
+      std::ofstream oh("benchmark_locking.csv");
+      oh << "algorithm,contenders,entities,ops_per_sec\n" << argv[2] << "," << contenders << "," << total_locks << "," << result << std::endl;
+      return 0;
+    }
+    /* Hosts rendezvous through files in the shared directory. Exclusion is still checked,
+    but only between the threads of each host as the shared memory is local.
+    */
+    const llfio::filesystem::path shared(argv[5]);
+    size_t this_host = atoi(argv[6]), total_hosts = atoi(argv[7]);
+    if(!total_hosts || this_host >= total_hosts)
+    {
+      std::cerr << usage;
+      return 1;
+    }
+    auto ready_path = [&](size_t n) { return shared / ("benchmark_locking_ready" + std::to_string(n)); };
+    auto result_path = [&](size_t n) { return shared / ("benchmark_locking_host" + std::to_string(n) + ".csv"); };
+    std::error_code ec;
+    if(this_host == 0)
+    {
+      for(size_t n = 0; n < total_hosts; n++)
+      {
+        llfio::filesystem::remove(ready_path(n), ec);
+        llfio::filesystem::remove(result_path(n), ec);
+      }
+    }
+    auto base = llfio::path_handle::path(shared).value();
+    std::ofstream(ready_path(this_host).native()) << this_host << std::endl;
+    std::cout << "Waiting for all " << total_hosts << " hosts to become ready ..." << std::endl;
+    for(size_t n = 0; n < total_hosts; n++)
+    {
+      while(!llfio::filesystem::exists(ready_path(n), ec))
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+    }
+    std::cout << "Benchmarking " << contenders << " threads for " << BENCHMARK_DURATION << " seconds ..." << std::endl;
+    auto result = benchmark_threads(test, contended, base, total_locks, contenders, this_host * contenders, std::chrono::seconds(BENCHMARK_DURATION));
+    if(result < 0)
+    {
+      return 1;
+    }
+    std::cout << "Host " << this_host << " result: " << result << " ops/sec" << std::endl;
+    {
+      // Rename into place so host 0 never sees a partially written result
+      auto temp_path = result_path(this_host);
+      temp_path += ".tmp";
+      std::ofstream(temp_path.native()) << argv[2] << "," << total_hosts << "," << contenders << "," << total_locks << "," << result << std::endl;
+      llfio::filesystem::rename(temp_path, result_path(this_host));
+    }
+    if(this_host == 0)
+    {
+      std::cout << "Waiting for all hosts to report results ..." << std::endl;
+      long long results = 0;
+      std::ofstream oh("benchmark_locking.csv");
+      oh << "algorithm,hosts,contenders,entities,ops_per_sec" << std::endl;
+      for(size_t n = 0; n < total_hosts; n++)
+      {
+        while(!llfio::filesystem::exists(result_path(n), ec))
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::ifstream ih(result_path(n).native());
+        std::string line;
+        std::getline(ih, line);
+        std::cout << "Host " << n << " reports " << line << std::endl;
+        oh << line << std::endl;
+        auto comma = line.rfind(',');
+        if(comma != std::string::npos)
+        {
+          results += atoll(line.c_str() + comma + 1);
+        }
+      }
+      std::cout << "Total result: " << results << " ops/sec" << std::endl;
+    }
+    return 0;
+  }
+
+
   // ******** MASTER PROCESS BEGINS HERE ********
   if(strcmp(argv[1], "spawned") && strcmp(argv[1], "!spawned"))
   {
     size_t waiters = atoi(argv[3]);
     if(!waiters || !atoi(argv[2]))
     {
-      std::cerr << "Usage: " << argv[0] << " [!]<atomic_append|byte_ranges|lock_files|memory_map> <entities> <no of waiters>" << std::endl;
+      std::cerr << usage;
       return 1;
     }
 
@@ -210,6 +516,10 @@ int main(int argc, char *argv[])
       }
       result = atol(&buffer[8]);
       std::cout << "Child " << n << " reports result " << result << std::endl;
+      if(child.cout().getline(buffer, sizeof(buffer)) && 0 == strncmp(buffer, "STATS(", 6))
+      {
+        std::cout << "   " << buffer << std::endl;
+      }
       results += result;
       if(n)
         oh << ",";
@@ -228,43 +538,8 @@ int main(int argc, char *argv[])
     std::cerr << "ERROR: args too short" << std::endl;
     return 1;
   }
-  enum class lock_algorithm
-  {
-    unknown,
-    atomic_append,
-    byte_ranges,
-    lock_files,
-    memory_map
-  } test = lock_algorithm::unknown;
   bool contended = true;
-  if(!strcmp(argv[2], "atomic_append"))
-    test = lock_algorithm::atomic_append;
-  else if(!strcmp(argv[2], "byte_ranges"))
-    test = lock_algorithm::byte_ranges;
-  else if(!strcmp(argv[2], "lock_files"))
-    test = lock_algorithm::lock_files;
-  else if(!strcmp(argv[2], "memory_map"))
-    test = lock_algorithm::memory_map;
-  else if(!strcmp(argv[2], "!atomic_append"))
-  {
-    test = lock_algorithm::atomic_append;
-    contended = false;
-  }
-  else if(!strcmp(argv[2], "!byte_ranges"))
-  {
-    test = lock_algorithm::byte_ranges;
-    contended = false;
-  }
-  else if(!strcmp(argv[2], "!lock_files"))
-  {
-    test = lock_algorithm::lock_files;
-    contended = false;
-  }
-  else if(!strcmp(argv[2], "!memory_map"))
-  {
-    test = lock_algorithm::memory_map;
-    contended = false;
-  }
+  auto test = parse_algorithm(argv[2], contended);
   if(test == lock_algorithm::unknown)
   {
     std::cerr << "ERROR: unknown test requested" << std::endl;
@@ -281,91 +556,18 @@ int main(int argc, char *argv[])
   std::cout << "READY(" << this_child << ")" << std::endl;
   // Wait for parent to let me proceed
   std::atomic<int> done(-1);
-  std::thread worker([test, contended, total_locks, this_child, &done, &count] {
-    std::unique_ptr<llfio::algorithm::shared_fs_mutex::shared_fs_mutex> algorithm;
-    auto base = llfio::path_handle::path(".").value();
-    switch(test)
-    {
-    case lock_algorithm::atomic_append:
-    {
-      auto v = llfio::algorithm::shared_fs_mutex::atomic_append::fs_mutex_append({}, "lockfile");
-      if(v.has_error())
-      {
-        std::cerr << "ERROR: Creation of lock algorithm returns " << v.error().message() << std::endl;
-        return;
-      }
-      algorithm = std::make_unique<llfio::algorithm::shared_fs_mutex::atomic_append>(std::move(v.value()));
-      break;
-    }
-    case lock_algorithm::byte_ranges:
-    {
-      auto v = llfio::algorithm::shared_fs_mutex::byte_ranges::fs_mutex_byte_ranges({}, "lockfile");
-      if(v.has_error())
-      {
-        std::cerr << "ERROR: Creation of lock algorithm returns " << v.error().message() << std::endl;
-        return;
-      }
-      algorithm = std::make_unique<llfio::algorithm::shared_fs_mutex::byte_ranges>(std::move(v.value()));
-      break;
-    }
-    case lock_algorithm::lock_files:
+  shared_fs_mutex_ptr algorithm;
+  std::thread worker([test, contended, total_locks, this_child, &done, &count, &algorithm] {
+    algorithm = make_algorithm(test, llfio::path_handle::path(".").value());
+    if(!algorithm)
     {
-      auto v = llfio::algorithm::shared_fs_mutex::lock_files::fs_mutex_lock_files(base);
-      if(v.has_error())
-      {
-        std::cerr << "ERROR: Creation of lock algorithm returns " << v.error().message() << std::endl;
-        return;
-      }
-      algorithm = std::make_unique<llfio::algorithm::shared_fs_mutex::lock_files>(std::move(v.value()));
-      break;
-    }
-    case lock_algorithm::memory_map:
-    {
-      auto v = llfio::algorithm::shared_fs_mutex::memory_map<QUICKCPPLIB_NAMESPACE::algorithm::hash::passthru_hash>::fs_mutex_map({}, "lockfile");
-      if(v.has_error())
-      {
-        std::cerr << "ERROR: Creation of lock algorithm returns " << v.error().message() << std::endl;
-        return;
-      }
-      algorithm = std::make_unique<llfio::algorithm::shared_fs_mutex::memory_map<QUICKCPPLIB_NAMESPACE::algorithm::hash::passthru_hash>>(std::move(v.value()));
-      break;
-    }
-    case lock_algorithm::unknown:
-      break;
-    }
-    // Create entities named 0 to total_locks
-    std::vector<llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type> entities(total_locks);
-    for(size_t n = 0; n < total_locks; n++)
-    {
-      if(contended)
-      {
-        entities[n].value = n;
-        entities[n].exclusive = true;
-      }
-      else
-      {
-        entities[n].value = (this_child << 4) + n;  // guaranteed unique
-        entities[n].exclusive = true;
-      }
+      return;
     }
-    while(done == -1)
-      std::this_thread::yield();
-    while(!done)
+    if(!algorithm->set_statistics_enabled(true))
     {
-      auto result = algorithm->lock(entities, llfio::deadline(), false);
-      if(result.has_error())
-      {
-        std::cerr << "ERROR: Algorithm lock returns " << result.error().message() << std::endl;
-        return;
-      }
-      if(contended)
-        child_locks(this_child);
-      ++count;
-      auto guard = std::move(result.value());
-      if(contended)
-        child_unlocks(this_child);
-      guard.unlock();
+      std::cerr << "WARNING: Could not enable lock statistics" << std::endl;
     }
+    run_locks(*algorithm, make_entities(total_locks, contended, this_child), contended, this_child, done, count);
   });
   if(!strcmp(argv[1], "!spawned"))
   {
@@ -391,6 +593,8 @@ int main(int argc, char *argv[])
     }
     done = 1;
     worker.join();
+    if(algorithm)
+      print_statistics(*algorithm);
   }
   else
     for(;;)
@@ -411,6 +615,8 @@ int main(int argc, char *argv[])
         done = 1;
         worker.join();
         std::cout << "RESULTS(" << count << ")" << std::endl;
+        if(algorithm)
+          print_statistics(*algorithm);
 #if DEBUG_CSV
         std::ofstream s("benchmark_locking_llfio_log" + std::to_string(this_child) + ".csv");
         s << csv(llfio::log());
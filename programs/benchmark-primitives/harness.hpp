@@ -0,0 +1,293 @@
+/* A common harness for micro-benchmarking LLFIO primitives
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#ifndef LLFIO_BENCHMARK_HARNESS_HPP
+#define LLFIO_BENCHMARK_HARNESS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+/* Each benchmark is a repetition which does `items` operations, timed as a whole so very short
+operations don't measure the clock. Repetitions are run after some untimed warmup repetitions,
+and the percentiles of the repetitions reported in nanoseconds per item. The results can be
+written as JSON, and compared to a baseline JSON written by an earlier run, with any benchmark
+whose median has regressed by more than the threshold failing the run.
+*/
+namespace harness
+{
+  struct options
+  {
+    size_t warmup{3};                // Untimed repetitions before those timed
+    size_t repetitions{25};          // Timed repetitions
+    int cpu{-1};                     // The CPU to pin this thread to, or -1 for none
+    std::string filter;              // Only run benchmarks whose names contain this
+    std::string json;                // Where to write the results, if anywhere
+    std::string baseline;            // Results to compare against, if any
+    double threshold{0.1};           // The fraction the median may regress by before failing
+  };
+
+  // One benchmark's results, in nanoseconds per item
+  struct summary
+  {
+    std::string name;
+    size_t items{0}, repetitions{0};
+    double mean{0}, min{0}, p50{0}, p90{0}, p99{0}, max{0}, itemspersec{0};
+  };
+
+  inline options &config()
+  {
+    static options v;
+    return v;
+  }
+  inline std::vector<summary> &summaries()
+  {
+    static std::vector<summary> v;
+    return v;
+  }
+
+  inline void print_usage(const char *argv0)
+  {
+    std::cerr << "Usage: " << argv0 << " [--warmup N] [--repetitions N] [--cpu N] [--filter substring] [--json results.json] [--baseline results.json] [--threshold 0.1]"
+              << std::endl;
+  }
+
+  // Returns false if the command line was invalid
+  inline bool parse_options(int argc, char *argv[])
+  {
+    auto &o = config();
+    for(int n = 1; n < argc; n++)
+    {
+      if(n + 1 == argc)
+      {
+        print_usage(argv[0]);
+        return false;
+      }
+      const char *arg = argv[n], *value = argv[++n];
+      if(0 == strcmp(arg, "--warmup"))
+      {
+        o.warmup = (size_t) atol(value);
+      }
+      else if(0 == strcmp(arg, "--repetitions"))
+      {
+        o.repetitions = std::max((size_t) 1, (size_t) atol(value));
+      }
+      else if(0 == strcmp(arg, "--cpu"))
+      {
+        o.cpu = atoi(value);
+      }
+      else if(0 == strcmp(arg, "--filter"))
+      {
+        o.filter = value;
+      }
+      else if(0 == strcmp(arg, "--json"))
+      {
+        o.json = value;
+      }
+      else if(0 == strcmp(arg, "--baseline"))
+      {
+        o.baseline = value;
+      }
+      else if(0 == strcmp(arg, "--threshold"))
+      {
+        o.threshold = atof(value);
+      }
+      else
+      {
+        print_usage(argv[0]);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Pins the calling thread to a CPU, so the scheduler moving it between caches doesn't add noise
+  inline bool pin_to_cpu(int cpu)
+  {
+    if(cpu < 0)
+    {
+      return true;
+    }
+#ifdef _WIN32
+    return 0 != SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == sched_setaffinity(0, sizeof(set), &set);
+#else
+    // Mac OS and the BSDs have no hard affinity for threads
+    return false;
+#endif
+  }
+
+  inline bool wanted(const char *name) { return config().filter.empty() || std::string(name).find(config().filter) != std::string::npos; }
+
+  inline void summarise(const char *name, size_t items, std::vector<double> nsecs)
+  {
+    std::sort(nsecs.begin(), nsecs.end());
+    auto percentile = [&](double p) { return nsecs[(size_t)(p * (double) (nsecs.size() - 1))] / (double) items; };
+    summary r;
+    r.name = name;
+    r.items = items;
+    r.repetitions = nsecs.size();
+    for(auto i : nsecs)
+    {
+      r.mean += i;
+    }
+    r.mean /= (double) nsecs.size() * (double) items;
+    r.min = nsecs.front() / (double) items;
+    r.p50 = percentile(0.5);
+    r.p90 = percentile(0.9);
+    r.p99 = percentile(0.99);
+    r.max = nsecs.back() / (double) items;
+    r.itemspersec = (r.p50 == 0) ? 0 : 1000000000.0 / r.p50;
+    std::cout << "   " << name << ": " << items << " items x " << r.repetitions << " repetitions: p50 " << r.p50 << " ns, p90 " << r.p90
+              << " ns, p99 " << r.p99 << " ns, min " << r.min << " ns, " << r.itemspersec << " items/sec" << std::endl;
+    summaries().push_back(std::move(r));
+  }
+
+  /* Runs `f()`, which does `items` operations, for the warmup and timed repetitions, calling
+  `setup()` untimed before each.
+  */
+  template <class S, class F> inline void run(const char *name, size_t items, S &&setup, F &&f)
+  {
+    if(!wanted(name))
+    {
+      return;
+    }
+    const auto &o = config();
+    std::vector<double> nsecs;
+    nsecs.reserve(o.repetitions);
+    for(size_t n = 0; n < o.warmup + o.repetitions; n++)
+    {
+      setup();
+      const auto begin = std::chrono::steady_clock::now();
+      f();
+      const auto end = std::chrono::steady_clock::now();
+      if(n >= o.warmup)
+      {
+        nsecs.push_back((double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+      }
+    }
+    summarise(name, items, std::move(nsecs));
+  }
+  template <class F> inline void run(const char *name, size_t items, F &&f)
+  {
+    run(name, items, [] {}, std::forward<F>(f));
+  }
+
+  inline void write_json(const std::string &path)
+  {
+    // One benchmark per line, so read_json() needn't be a full JSON parser
+    std::ofstream out(path);
+    out << "[";
+    for(size_t n = 0; n < summaries().size(); n++)
+    {
+      const auto &r = summaries()[n];
+      out << (n ? ",\n" : "\n") << "{\"name\":\"" << r.name << "\",\"items\":" << r.items << ",\"repetitions\":" << r.repetitions << ",\"mean\":" << r.mean
+          << ",\"min\":" << r.min << ",\"p50\":" << r.p50 << ",\"p90\":" << r.p90 << ",\"p99\":" << r.p99 << ",\"max\":" << r.max
+          << ",\"itemspersec\":" << r.itemspersec << "}";
+    }
+    out << "\n]" << std::endl;
+  }
+
+  // Reads the medians of each benchmark from JSON written by write_json()
+  inline std::map<std::string, double> read_json(const std::string &path)
+  {
+    std::map<std::string, double> ret;
+    std::ifstream in(path);
+    std::string line;
+    while(std::getline(in, line))
+    {
+      const auto name = line.find("\"name\":\""), p50 = line.find("\"p50\":");
+      if(name == std::string::npos || p50 == std::string::npos)
+      {
+        continue;
+      }
+      const auto nameend = line.find('"', name + 8);
+      ret[line.substr(name + 8, nameend - name - 8)] = atof(line.c_str() + p50 + 6);
+    }
+    return ret;
+  }
+
+  // Returns the number of benchmarks whose median regressed by more than the threshold from the baseline
+  inline size_t check_baseline(const std::string &path)
+  {
+    const auto baseline = read_json(path);
+    if(baseline.empty())
+    {
+      std::cerr << "WARNING: No results could be read from baseline " << path << std::endl;
+      return 0;
+    }
+    size_t regressions = 0;
+    for(const auto &r : summaries())
+    {
+      auto it = baseline.find(r.name);
+      if(it == baseline.end() || it->second <= 0)
+      {
+        continue;
+      }
+      const double change = (r.p50 - it->second) / it->second;
+      if(change > config().threshold)
+      {
+        std::cerr << "REGRESSION: " << r.name << " p50 " << r.p50 << " ns is " << (change * 100) << "% slower than baseline " << it->second << " ns" << std::endl;
+        regressions++;
+      }
+    }
+    return regressions;
+  }
+
+  // Writes and checks the results as configured, returning the exit code for main()
+  inline int finish()
+  {
+    const auto &o = config();
+    if(!o.json.empty())
+    {
+      write_json(o.json);
+    }
+    if(!o.baseline.empty() && check_baseline(o.baseline) > 0)
+    {
+      return 1;
+    }
+    return 0;
+  }
+}  // namespace harness
+
+#endif
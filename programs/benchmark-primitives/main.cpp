@@ -0,0 +1,165 @@
+/* Micro-benchmarks of LLFIO primitives
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../../include/llfio/llfio.hpp"
+
+#include "harness.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace llfio = LLFIO_V2_NAMESPACE;
+
+static constexpr size_t MAPS = 256;                    // Maps made and unmapped per repetition
+static constexpr size_t MAPBYTES = 64 * 1024 * 1024;  // Bytes of map page faulted per repetition
+static constexpr size_t VECTORITEMS = 1024 * 1024;    // Items pushed into a trivial_vector per repetition
+static constexpr size_t RANDOMBYTES = 256 * 1024 * 1024, RANDOMBLOCK = 65536;
+static constexpr size_t TREEDIRS = 16, TREEFILES = 256;  // The directory tree traversed and reduced
+
+static void benchmark_map_handle()
+{
+  std::cout << "Benchmarking llfio::map_handle ..." << std::endl;
+  harness::run("map_handle_map_unmap_64Kb", MAPS, [] {
+    for(size_t n = 0; n < MAPS; n++)
+    {
+      auto mh = llfio::map_handle::map(65536).value();
+    }
+  });
+  harness::run("map_handle_map_unmap_1Mb_nocache", MAPS, [] {
+    for(size_t n = 0; n < MAPS; n++)
+    {
+      auto mh = llfio::map_handle::map(1024 * 1024, false, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::nocache).value();
+    }
+  });
+  const size_t pagesize = llfio::utils::page_size();
+  llfio::map_handle mh;
+  harness::run(
+  "map_handle_page_fault", MAPBYTES / pagesize, [&] { mh = llfio::map_handle::map(MAPBYTES).value(); },
+  [&] {
+    for(size_t n = 0; n < MAPBYTES; n += pagesize)
+    {
+      mh.address()[n] = llfio::to_byte(1);
+    }
+  });
+}
+
+static void benchmark_trivial_vector()
+{
+  std::cout << "Benchmarking llfio::algorithm::trivial_vector ..." << std::endl;
+  llfio::algorithm::trivial_vector<size_t> v;
+  harness::run(
+  "trivial_vector_push_back", VECTORITEMS, [&] { v = llfio::algorithm::trivial_vector<size_t>(); },
+  [&] {
+    for(size_t n = 0; n < VECTORITEMS; n++)
+    {
+      v.push_back(n);
+    }
+  });
+  harness::run(
+  "trivial_vector_resize", 1, [&] { v = llfio::algorithm::trivial_vector<size_t>(); }, [&] { v.resize(VECTORITEMS); });
+}
+
+static void benchmark_fast_random_file_handle()
+{
+  std::cout << "Benchmarking llfio::fast_random_file_handle ..." << std::endl;
+  auto fh = llfio::fast_random_file_handle::fast_random_file(RANDOMBYTES).value();
+  std::vector<llfio::byte> buffer(RANDOMBLOCK);
+  harness::run("fast_random_file_handle_read_64Kb", RANDOMBYTES / RANDOMBLOCK, [&] {
+    for(size_t n = 0; n < RANDOMBYTES; n += RANDOMBLOCK)
+    {
+      fh.read(n, {{buffer.data(), buffer.size()}}).value();
+    }
+  });
+}
+
+// Fills a directory with TREEDIRS directories each of TREEFILES empty files
+static void make_tree(const llfio::directory_handle &dh)
+{
+  std::vector<std::string> names;
+  for(size_t n = 0; n < TREEFILES; n++)
+  {
+    names.push_back(std::to_string(n));
+  }
+  std::vector<llfio::directory_handle::create_request> reqs;
+  for(auto &name : names)
+  {
+    reqs.push_back({name, {}});
+  }
+  for(size_t n = 0; n < TREEDIRS; n++)
+  {
+    auto subdir = llfio::directory_handle::directory(dh, names[n], llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+    for(auto &r : subdir.create_entries(reqs, llfio::directory_handle::creation::if_needed, llfio::directory_handle::caching::temporary).value())
+    {
+      r.value();
+    }
+  }
+}
+
+static void benchmark_traverse_and_reduce()
+{
+  std::cout << "Benchmarking llfio::algorithm::traverse() and reduce() ..." << std::endl;
+  static constexpr size_t entries = TREEDIRS * (TREEFILES + 1);
+  {
+    auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+    make_tree(dh);
+    llfio::algorithm::traverse_visitor visitor;
+    harness::run("traverse_1_thread", entries, [&] { llfio::algorithm::traverse(dh, &visitor, 1).value(); });
+    harness::run("traverse_threads", entries, [&] { llfio::algorithm::traverse(dh, &visitor).value(); });
+    llfio::algorithm::reduce(std::move(dh)).value();
+  }
+  llfio::directory_handle dh;
+  harness::run(
+  "reduce", entries,
+  [&] {
+    dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+    make_tree(dh);
+  },
+  [&] { llfio::algorithm::reduce(std::move(dh)).value(); });
+}
+
+int main(int argc, char *argv[])
+{
+  if(!harness::parse_options(argc, argv))
+  {
+    return 2;
+  }
+  if(!harness::pin_to_cpu(harness::config().cpu))
+  {
+    std::cerr << "WARNING: Could not pin this thread to CPU " << harness::config().cpu << std::endl;
+  }
+  try
+  {
+    benchmark_map_handle();
+    benchmark_trivial_vector();
+    benchmark_fast_random_file_handle();
+    benchmark_traverse_and_reduce();
+  }
+  catch(const std::exception &e)
+  {
+    std::cerr << "FATAL: " << e.what() << std::endl;
+    return 2;
+  }
+  return harness::finish();
+}
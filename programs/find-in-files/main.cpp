@@ -0,0 +1,79 @@
+/* Benchmark llfio::algorithm::find_in_files() against grep
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../../include/llfio/llfio.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace llfio = LLFIO_V2_NAMESPACE;
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " <literal> [<directory> [<threads>]]" << std::endl;
+    return 1;
+  }
+  const std::string needle(argv[1]);
+  const std::string dir((argc > 2) ? argv[2] : ".");
+  const size_t threads = (argc > 3) ? (size_t) atoi(argv[3]) : 0;
+  try
+  {
+    auto dirh = llfio::directory({}, dir).value();
+    for(int round = 0; round < 3; round++)
+    {
+      // The first round warms the kernel caches for both searches
+      auto begin = std::chrono::steady_clock::now();
+      auto summary = llfio::algorithm::find_in_files(dirh, {(const llfio::byte *) needle.data(), needle.size()}, nullptr, threads).value();
+      auto end = std::chrono::steady_clock::now();
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+      std::cout << "llfio::algorithm::find_in_files() found " << summary.matches << " matches in " << summary.files_matched << " of " << summary.files_searched
+                << " files (" << (summary.bytes_searched / 1024 / 1024) << " Mb, " << summary.files_failed << " unreadable) in " << ms << " ms";
+      if(ms > 0)
+      {
+        std::cout << " (" << (summary.bytes_searched / 1024 / 1024 * 1000 / (uint64_t) ms) << " Mb/sec)";
+      }
+      std::cout << "." << std::endl;
+
+#ifndef _WIN32
+      // grep -c counts matching lines rather than matches, so compare the times not the counts
+      const std::string command = "grep -rcF -- '" + needle + "' '" + dir + "' > /dev/null 2>&1";
+      begin = std::chrono::steady_clock::now();
+      const int ret = system(command.c_str());
+      end = std::chrono::steady_clock::now();
+      std::cout << "grep -rcF exited with " << ret << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms." << std::endl;
+#endif
+    }
+    return 0;
+  }
+  catch(const std::exception &e)
+  {
+    std::cerr << "FATAL: " << e.what() << std::endl;
+    return 1;
+  }
+}
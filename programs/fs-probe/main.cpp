@@ -28,9 +28,26 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../../include/llfio/llfio.hpp"
 #include "outcome/iostream_support.hpp"
 
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #ifdef __linux__
 #define file_handle LLFIO_V2_NAMESPACE::file_handle
@@ -38,8 +55,10 @@ Distributed under the Boost Software License, Version 1.0.
 
 constexpr unsigned permute_flags_max = 4;
 static const std::regex sp_preamble{"(system|storage).*"};
+// Quick mode skips the tests which need 16Gb of extra test files or repeatedly drop the filesystem caches
+static const char quick_tests[] = "(?!latency:(read|write):qd16|latency:readwrite|response_time:[^:]*:cold_cache).*";
 
-static LLFIO_V2_NAMESPACE::storage_profile::storage_profile profile[permute_flags_max];
+using profiles_type = std::array<LLFIO_V2_NAMESPACE::storage_profile::storage_profile, permute_flags_max>;
 
 #define RETCHECK(expr)                                                                                                                                                                                                                                                                                                         \
   {                                                                                                                                                                                                                                                                                                                            \
@@ -51,60 +70,470 @@ static LLFIO_V2_NAMESPACE::storage_profile::storage_profile profile[permute_flag
     }                                                                                                                                                                                                                                                                                                                          \
   }
 
+static const char *caching_name(unsigned flags)
+{
+  static const char *names[permute_flags_max] = {"direct=0 sync=0", "direct=1 sync=0", "direct=0 sync=1", "direct=1 sync=1"};
+  return names[flags];
+}
+
+// Serialises console output and the system:* tests, whose implementations cache process wide
+static std::mutex output_lock, system_tests_lock;
+
+// Pins the calling thread, and on Linux any threads it creates, to the Nth of count equal divisions of the CPUs
+static void pin_to_cpus(size_t n, size_t count)
+{
+  const size_t cpus = std::thread::hardware_concurrency();
+  if(count < 2 || cpus < count)
+  {
+    return;
+  }
+  const size_t per = cpus / count, first = n * per;
+#ifdef _WIN32
+  DWORD_PTR mask = 0;
+  for(size_t i = first; i < first + per && i < sizeof(mask) * 8; i++)
+  {
+    mask |= (DWORD_PTR) 1 << i;
+  }
+  (void) SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(size_t i = first; i < first + per; i++)
+  {
+    CPU_SET(i, &set);
+  }
+  (void) pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void) first;
+#endif
+}
+
+/* A minimal reader of the JSON written below, sufficient for reading a baseline.
+*/
+struct json_value
+{
+  enum class kind_type
+  {
+    null,
+    boolean,
+    number,
+    string,
+    array,
+    object
+  } kind{kind_type::null};
+  double number{0};
+  std::string string;
+  std::vector<json_value> array;
+  std::map<std::string, json_value> object;
+
+  const json_value *find(const std::string &key) const
+  {
+    auto it = object.find(key);
+    return (it == object.end()) ? nullptr : &it->second;
+  }
+};
+static bool json_parse(const char *&p, const char *e, json_value &out)
+{
+  auto skip = [&] {
+    while(p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    {
+      p++;
+    }
+  };
+  auto parse_string = [&](std::string &s) {
+    if(p == e || *p != '"')
+    {
+      return false;
+    }
+    for(p++; p < e && *p != '"'; p++)
+    {
+      if(*p == '\\' && ++p < e)
+      {
+        switch(*p)
+        {
+        case 'n':
+          s.push_back('\n');
+          break;
+        case 't':
+          s.push_back('\t');
+          break;
+        case 'r':
+          s.push_back('\r');
+          break;
+        case 'u':
+          // Only the control characters we escape are expected
+          if(e - p < 5)
+          {
+            return false;
+          }
+          s.push_back((char) strtoul(std::string(p + 1, p + 5).c_str(), nullptr, 16));
+          p += 4;
+          break;
+        default:
+          s.push_back(*p);
+        }
+      }
+      else
+      {
+        s.push_back(*p);
+      }
+    }
+    if(p == e)
+    {
+      return false;
+    }
+    p++;
+    return true;
+  };
+  skip();
+  if(p == e)
+  {
+    return false;
+  }
+  switch(*p)
+  {
+  case '{':
+    out.kind = json_value::kind_type::object;
+    for(p++;;)
+    {
+      skip();
+      if(p < e && *p == '}')
+      {
+        p++;
+        return true;
+      }
+      std::string key;
+      if(!parse_string(key))
+      {
+        return false;
+      }
+      skip();
+      if(p == e || *p++ != ':' || !json_parse(p, e, out.object[key]))
+      {
+        return false;
+      }
+      skip();
+      if(p < e && *p == ',')
+      {
+        p++;
+      }
+    }
+  case '[':
+    out.kind = json_value::kind_type::array;
+    for(p++;;)
+    {
+      skip();
+      if(p < e && *p == ']')
+      {
+        p++;
+        return true;
+      }
+      out.array.emplace_back();
+      if(!json_parse(p, e, out.array.back()))
+      {
+        return false;
+      }
+      skip();
+      if(p < e && *p == ',')
+      {
+        p++;
+      }
+    }
+  case '"':
+    out.kind = json_value::kind_type::string;
+    return parse_string(out.string);
+  case 't':
+  case 'f':
+  case 'n':
+  {
+    const bool istrue = (*p == 't');
+    out.kind = (*p == 'n') ? json_value::kind_type::null : json_value::kind_type::boolean;
+    out.number = istrue ? 1 : 0;
+    while(p < e && isalpha((unsigned char) *p))
+    {
+      p++;
+    }
+    return true;
+  }
+  default:
+  {
+    char *end = nullptr;
+    const std::string tmp(p, p + std::min<ptrdiff_t>(e - p, 64));
+    out.kind = json_value::kind_type::number;
+    out.number = strtod(tmp.c_str(), &end);
+    if(end == tmp.c_str())
+    {
+      return false;
+    }
+    p += end - tmp.c_str();
+    return true;
+  }
+  }
+}
+
+static std::string json_escape(const std::string &s)
+{
+  std::string ret;
+  ret.reserve(s.size() + 2);
+  ret.push_back('"');
+  for(char c : s)
+  {
+    if(c == '"' || c == '\\')
+    {
+      ret.push_back('\\');
+      ret.push_back(c);
+    }
+    else if(c == '\n')
+    {
+      ret.append("\\n");
+    }
+    else if((unsigned char) c < 32)
+    {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned) (unsigned char) c);
+      ret.append(buffer);
+    }
+    else
+    {
+      ret.push_back(c);
+    }
+  }
+  ret.push_back('"');
+  return ret;
+}
+
+// Writes the items of a profile as a JSON object of their values, without the histograms
+static void write_json(std::ostream &out, const LLFIO_V2_NAMESPACE::storage_profile::storage_profile &sp, size_t indent)
+{
+  using namespace LLFIO_V2_NAMESPACE::storage_profile;
+  bool first = true;
+  out << "{";
+  for(const item_erased &i : sp)
+  {
+    i.invoke([&](auto &item) {
+      using value_type = std::decay_t<decltype(item.value)>;
+      if(item.value == default_value<value_type>() || strstr(item.name, ":histogram") != nullptr)
+      {
+        return;
+      }
+      out << (first ? "\n" : ",\n") << std::string(indent + 2, ' ') << json_escape(item.name) << ": ";
+      std::stringstream ss;
+      ss << item.value;
+      out << (std::is_same<value_type, std::string>::value ? json_escape(ss.str()) : ss.str());
+      first = false;
+    });
+  }
+  out << (first ? "}" : "\n" + std::string(indent, ' ') + "}");
+}
+
+/* Lower is better for latencies and response times, higher is better for bandwidths. The
+extremes of the distributions are too noisy to compare.
+*/
+static int comparison_direction(const std::string &name)
+{
+  static const char *noisy[] = {":min", ":max", ":99.9%", ":99.999%"};
+  for(const char *suffix : noisy)
+  {
+    const size_t len = strlen(suffix);
+    if(name.size() >= len && 0 == name.compare(name.size() - len, len, suffix))
+    {
+      return 0;
+    }
+  }
+  if(0 == name.compare(0, 8, "latency:") || 0 == name.compare(0, 14, "response_time:"))
+  {
+    return -1;
+  }
+  if(name.find("bandwidth") != std::string::npos)
+  {
+    return 1;
+  }
+  return 0;
+}
+
+struct probe_type
+{
+  std::string path;
+  LLFIO_V2_NAMESPACE::path_handle dirh;
+  std::unique_ptr<profiles_type> profiles{new profiles_type};
+  unsigned ran{0};  // bit set of the caching permutations run
+};
+
 int main(int argc, char *argv[])
 {
   using namespace LLFIO_V2_NAMESPACE;
   using LLFIO_V2_NAMESPACE::byte;
   std::regex torun(".*");
-  bool regexvalid = false;
+  bool regexvalid = false, quick = false, havetorun = false;
   unsigned torunflags = (1 << permute_flags_max) - 1;
-  if(argc > 1)
+  bool havetorunflags = false;
+  std::vector<std::string> paths;
+  std::string jsonpath, baselinepath;
+  double tolerance = 25;
+  auto usage = [&] {
+    std::cerr << "Usage: " << argv[0]
+              << " [--path <dir>]... [--quick] [--json <file>] [--baseline <file> [--tolerance <percent>]] [<regex for tests to run> [<flags>]]\n\n"
+                 "  --path       Probe the filing system of this directory, concurrently with any others. Defaults to the current directory.\n"
+                 "               Directories upon the same device are probed one after another so they do not disturb one another.\n"
+                 "  --quick      Use a smaller test file, and skip the tests which take longest, for fleet wide collection.\n"
+                 "  --json       Also write the results as JSON to this file.\n"
+                 "  --baseline   Compare the results to those in this JSON file, exiting with 2 if any are degraded.\n"
+                 "  --tolerance  The percentage by which a result may be worse than its baseline before it is degraded (default 25).\n";
+    return 1;
+  };
+  for(int n = 1; n < argc; n++)
+  {
+    const std::string arg(argv[n]);
+    const bool hasvalue = (n + 1 < argc);
+    if(arg == "--quick")
+    {
+      quick = true;
+    }
+    else if(arg == "--path" && hasvalue)
+    {
+      paths.emplace_back(argv[++n]);
+    }
+    else if(arg == "--json" && hasvalue)
+    {
+      jsonpath = argv[++n];
+    }
+    else if(arg == "--baseline" && hasvalue)
+    {
+      baselinepath = argv[++n];
+    }
+    else if(arg == "--tolerance" && hasvalue)
+    {
+      tolerance = atof(argv[++n]);
+    }
+    else if(0 == arg.compare(0, 2, "--"))
+    {
+      return usage();
+    }
+    else if(!havetorun)
+    {
+      try
+      {
+        torun.assign(arg);
+        regexvalid = true;
+      }
+      catch(...)
+      {
+      }
+      if(!regexvalid)
+      {
+        return usage();
+      }
+      havetorun = true;
+    }
+    else if(!havetorunflags)
+    {
+      torunflags = atoi(arg.c_str());
+      havetorunflags = true;
+    }
+    else
+    {
+      return usage();
+    }
+  }
+  if(quick)
   {
-    try
+    if(!havetorun)
     {
-      torun.assign(argv[1]);
-      regexvalid = true;
+      torun.assign(quick_tests);
     }
-    catch(...)
+    if(!havetorunflags)
     {
+      torunflags = 3;  // without and with direct i/o
     }
-    if(argc > 2)
-      torunflags = atoi(argv[2]);
-    if(!regexvalid)
+  }
+  if(paths.empty())
+  {
+    paths.emplace_back(".");
+  }
+  const bool ownfiles = std::regex_match("latency:read:qd16", torun) || std::regex_match("latency:write:qd16", torun) || std::regex_match("latency:readwrite:qd4", torun);
+  const size_t testfilesize = quick ? 256 * 1024 * 1024 : 1024 * 1024 * 1024;
+
+  std::vector<probe_type> probes(paths.size());
+  for(size_t n = 0; n < paths.size(); n++)
+  {
+    probes[n].path = paths[n];
+    auto dirh = path_handle::path(paths[n]);
+    if(!dirh)
     {
-      std::cerr << "Usage: " << argv[0] << " <regex for tests to run> [<flags>]" << std::endl;
+      std::cerr << "FATAL: Failed to open '" << paths[n] << "' due to '" << dirh.error().message() << "'" << std::endl;
       return 1;
     }
+    probes[n].dirh = std::move(dirh).value();
   }
+  // Directories upon the same device are probed by the same worker one after another
+  std::vector<std::vector<probe_type *>> workers;
+  {
+    std::vector<uint64_t> devices;
+    for(auto &probe : probes)
+    {
+      stat_t s(nullptr);
+      RETCHECK(s.fill(probe.dirh, stat_t::want::dev));
+      size_t idx = std::find(devices.begin(), devices.end(), s.st_dev) - devices.begin();
+      if(idx == devices.size())
+      {
+        devices.push_back(s.st_dev);
+        workers.emplace_back();
+      }
+      workers[idx].push_back(&probe);
+    }
+  }
+  auto run_workers = [&](auto &&f) {
+    std::vector<std::thread> threads;
+    for(size_t n = 0; n < workers.size(); n++)
+    {
+      threads.emplace_back([&, n] {
+        pin_to_cpus(n, workers.size());
+        for(auto *probe : workers[n])
+        {
+          f(*probe);
+        }
+      });
+    }
+    for(auto &thread : threads)
+    {
+      thread.join();
+    }
+  };
+  auto say = [](const probe_type &probe, const std::string &msg, bool error = false) {
+    std::lock_guard<std::mutex> g(output_lock);
+    (error ? std::cerr : std::cout) << "[" << probe.path << "] " << msg << std::endl;
+  };
 
   // Force extent allocation before test begins
-  auto make_testfile = [](std::string name) {
+  auto make_testfile = [testfilesize](const path_handle &dirh, std::string name) {
     // Create file with O_SYNC
-    auto _testfile(file_handle::file({}, name, handle::mode::write, handle::creation::if_needed, handle::caching::reads));
+    auto _testfile(file_handle::file(dirh, name, handle::mode::write, handle::creation::if_needed, handle::caching::reads));
     if(!_testfile)
     {
       std::cerr << "WARNING: Failed to create test file due to '" << _testfile.error().message() << "', failing" << std::endl;
       abort();
     }
     file_handle testfile(std::move(_testfile.value()));
-    std::vector<byte> buffer(1024 * 1024 * 1024);
+    std::vector<byte> buffer(testfilesize);
     RETCHECK(testfile.truncate(buffer.size()));
     file_handle::const_buffer_type _reqs[1] = {{buffer.data(), buffer.size()}};
     file_handle::io_request<file_handle::const_buffers_type> reqs(_reqs, 0);
     RETCHECK(testfile.write(reqs));
   };
-  if(std::regex_match("latency:read:qd16", torun) || std::regex_match("latency:write:qd16", torun) || std::regex_match("latency:readwrite:qd4", torun))
-  {
-    std::cout << "Writing 17Gb of temporary test files, this will take a while ..." << std::endl;
-    make_testfile("test");
-    for(size_t n = 0; n < 16; n++)
-      make_testfile(std::to_string(n));
-  }
-  else
-  {
-    std::cout << "Writing 1Gb of temporary test files, this will take a while ..." << std::endl;
-    make_testfile("test");
-  }
+  run_workers([&](probe_type &probe) {
+    if(ownfiles)
+    {
+      say(probe, "Writing 17Gb of temporary test files, this will take a while ...");
+      make_testfile(probe.dirh, "test");
+      for(size_t n = 0; n < 16; n++)
+        make_testfile(probe.dirh, std::to_string(n));
+    }
+    else
+    {
+      say(probe, std::string("Writing ") + (quick ? "256Mb" : "1Gb") + " of temporary test files, this will take a while ...");
+      make_testfile(probe.dirh, "test");
+    }
+  });
   // File closes, as it was opened with O_SYNC it forces extent allocation
   // Drop filesystem caches
   {
@@ -121,8 +550,8 @@ int main(int argc, char *argv[])
   }
   // Pause as Windows still takes a while
   std::cout << "Waiting for hard drive to quieten after temp files written ..." << std::endl;
-  std::this_thread::sleep_for(std::chrono::seconds(10));
-  std::ofstream results("fs_probe_results.yaml", std::ios::app);
+  std::this_thread::sleep_for(std::chrono::seconds(quick ? 2 : 10));
+  std::string timestamp;
   {
     auto put_time = [](const std::tm *tmb, const char *fmt) {
       std::string buffer(256, 0);
@@ -130,64 +559,204 @@ int main(int argc, char *argv[])
       return buffer;
     };
     std::time_t t = std::time(nullptr);
-    results << "---\ntimestamp: " << put_time(std::gmtime(&t), "%F %T %z") << "\n";
+    timestamp = put_time(std::gmtime(&t), "%F %T %z");
   }
-  bool first = true;
-  for(unsigned flags = 0; flags < permute_flags_max; flags++)
-  {
-    if((1 << flags) & torunflags)
+  run_workers([&](probe_type &probe) {
+    for(unsigned flags = 0; flags < permute_flags_max; flags++)
     {
-      handle::caching strategy = handle::caching::all;
-      switch(flags)
+      if((1 << flags) & torunflags)
       {
-      case 1:
-        strategy = handle::caching::only_metadata;  // O_DIRECT
-        break;
-      case 2:
-        strategy = handle::caching::reads;  // O_SYNC
-        break;
-      case 3:
-        strategy = handle::caching::none;  // O_DIRECT|O_SYNC
-        break;
+        auto &profile = (*probe.profiles)[flags];
+        handle::caching strategy = handle::caching::all;
+        switch(flags)
+        {
+        case 1:
+          strategy = handle::caching::only_metadata;  // O_DIRECT
+          break;
+        case 2:
+          strategy = handle::caching::reads;  // O_SYNC
+          break;
+        case 3:
+          strategy = handle::caching::none;  // O_DIRECT|O_SYNC
+          break;
+        }
+        say(probe, caching_name(flags));
+        auto _testfile(file_handle::file(probe.dirh, "test", handle::mode::write, handle::creation::open_existing, strategy));
+        if(!_testfile)
+        {
+          say(probe, "WARNING: Failed to create test file due to '" + _testfile.error().message() + "', skipping", true);
+          continue;
+        }
+        file_handle testfile(std::move(_testfile.value()));
+        for(auto begin = std::chrono::steady_clock::now(); std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - begin).count() < 3;)
+          ;
+        for(auto &test : profile)
+        {
+          if(std::regex_match(test.name, torun))
+          {
+            say(probe, std::string("Running test ") + test.name + " ...");
+            std::unique_lock<std::mutex> g(system_tests_lock, std::defer_lock);
+            if(0 == strncmp(test.name, "system:", 7))
+            {
+              g.lock();
+            }
+            auto result = test(profile, testfile);
+            if(g.owns_lock())
+            {
+              g.unlock();
+            }
+            if(result)
+            {
+              test.invoke([&](auto &i) {
+                std::stringstream ss;
+                ss << "   " << i.name << " = " << i.value;
+                say(probe, ss.str());
+              });
+            }
+            else
+            {
+              std::stringstream ss;
+              ss << "   ERROR running test '" << test.name << "': " << print(result);
+              say(probe, ss.str(), true);
+            }
+          }
+        }
+        probe.ran |= 1U << flags;
+        // Save the profile where storage_profile::load() will find it for this storage and caching
+        auto saved = profile.save(probe.dirh, testfile);
+        if(!saved)
+        {
+          say(probe, "WARNING: Failed to save profile due to '" + saved.error().message() + "'", true);
+        }
       }
-      std::cout << "\ndirect=" << !!(flags & 1) << " sync=" << !!(flags & 2) << ":\n";
-      auto _testfile(file_handle::file({}, "test", handle::mode::write, handle::creation::open_existing, strategy));
-      if(!_testfile)
+    }
+  });
+
+  // Write out results for each path and combination of flags
+  {
+    std::ofstream results("fs_probe_results.yaml", std::ios::app);
+    for(auto &probe : probes)
+    {
+      results << "---\ntimestamp: " << timestamp << "\n";
+      if(probes.size() > 1)
       {
-        std::cerr << "WARNING: Failed to create test file due to '" << _testfile.error().message() << "', skipping" << std::endl;
-        continue;
+        results << "path: " << probe.path << "\n";
       }
-      file_handle testfile(std::move(_testfile.value()));
-      for(auto begin = std::chrono::steady_clock::now(); std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - begin).count() < 3;)
-        ;
-      for(auto &test : profile[flags])
+      bool first = true;
+      for(unsigned flags = 0; flags < permute_flags_max; flags++)
       {
-        if(std::regex_match(test.name, torun))
+        if(probe.ran & (1U << flags))
         {
-          std::cout << "Running test " << test.name << " ..." << std::endl;
-          auto result = test(profile[flags], testfile);
-          if(result)
+          auto &profile = (*probe.profiles)[flags];
+          if(first)
           {
-            test.invoke([](auto &i) { std::cout << "   " << i.name << " = " << i.value << std::endl; });
+            profile.write(results, sp_preamble);
+            first = false;
           }
-          else
-            std::cerr << "   ERROR running test '" << test.name << "': " << print(result) << std::endl;
+          results << caching_name(flags) << ":\n";
+          profile.write(results, sp_preamble, 4, true);
         }
       }
-      // Write out results for this combination of flags
-      if(first)
+    }
+  }
+  if(!jsonpath.empty())
+  {
+    std::ofstream results(jsonpath);
+    results << "{\n  \"timestamp\": " << json_escape(timestamp) << ",\n  \"quick\": " << (quick ? "true" : "false") << ",\n  \"probes\": {";
+    bool firstprobe = true;
+    for(auto &probe : probes)
+    {
+      results << (firstprobe ? "\n" : ",\n") << "    " << json_escape(probe.path) << ": {";
+      firstprobe = false;
+      bool first = true;
+      for(unsigned flags = 0; flags < permute_flags_max; flags++)
       {
-        profile[flags].write(results, sp_preamble);
-        first = false;
+        if(probe.ran & (1U << flags))
+        {
+          results << (first ? "\n" : ",\n") << "      " << json_escape(caching_name(flags)) << ": ";
+          write_json(results, (*probe.profiles)[flags], 6);
+          first = false;
+        }
+      }
+      results << (first ? "}" : "\n    }");
+    }
+    results << "\n  }\n}\n";
+  }
+
+  // Compare against the baseline
+  int ret = 0;
+  if(!baselinepath.empty())
+  {
+    std::ifstream in(baselinepath);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    const std::string text = ss.str();
+    const char *p = text.data();
+    json_value baseline;
+    const json_value *baselineprobes = nullptr;
+    if(!in || !json_parse(p, text.data() + text.size(), baseline) || (baselineprobes = baseline.find("probes")) == nullptr)
+    {
+      std::cerr << "FATAL: Failed to read baseline '" << baselinepath << "'" << std::endl;
+      return 1;
+    }
+    size_t compared = 0, degraded = 0;
+    for(auto &probe : probes)
+    {
+      const json_value *baselineprobe = baselineprobes->find(probe.path);
+      if(baselineprobe == nullptr && probes.size() == 1 && baselineprobes->object.size() == 1)
+      {
+        // A single probe compares against a single baseline whatever its path
+        baselineprobe = &baselineprobes->object.begin()->second;
+      }
+      if(baselineprobe == nullptr)
+      {
+        std::cout << "WARNING: No baseline for '" << probe.path << "'" << std::endl;
+        continue;
+      }
+      for(unsigned flags = 0; flags < permute_flags_max; flags++)
+      {
+        const json_value *baselineitems = baselineprobe->find(caching_name(flags));
+        if(!(probe.ran & (1U << flags)) || baselineitems == nullptr)
+        {
+          continue;
+        }
+        for(const storage_profile::item_erased &i : (*probe.profiles)[flags])
+        {
+          i.invoke([&](auto &item) {
+            using value_type = std::decay_t<decltype(item.value)>;
+            const int direction = comparison_direction(item.name);
+            const json_value *was = baselineitems->find(item.name);
+            if(direction == 0 || was == nullptr || was->kind != json_value::kind_type::number || was->number <= 0 ||
+               item.value == storage_profile::default_value<value_type>())
+            {
+              return;
+            }
+            std::stringstream vs;
+            vs << item.value;
+            const double now = atof(vs.str().c_str());
+            const double change = 100.0 * (now - was->number) / was->number;
+            compared++;
+            if(change * -direction > tolerance)
+            {
+              degraded++;
+              std::cout << "DEGRADED: [" << probe.path << "] " << caching_name(flags) << " " << item.name << " was " << was->number << " now " << now << " ("
+                        << std::showpos << std::fixed << std::setprecision(1) << change << "%" << std::noshowpos << std::defaultfloat << ")" << std::endl;
+            }
+          });
+        }
       }
-      results << "direct=" << !!(flags & 1) << " sync=" << !!(flags & 2) << ":\n";
-      profile[flags].write(results, sp_preamble, 4, true);
-      results.flush();
+    }
+    std::cout << "Compared " << compared << " results against the baseline, of which " << degraded << " are degraded by more than " << tolerance << "%"
+              << std::endl;
+    if(degraded > 0)
+    {
+      ret = 2;
     }
   }
-  // Delete the test file
-  auto delete_testfile = [](std::string name) {
-    auto _testfile(file_handle::file({}, name, handle::mode::write));
+
+  // Delete the test files
+  auto delete_testfile = [](const path_handle &dirh, std::string name) {
+    auto _testfile(file_handle::file(dirh, name, handle::mode::write));
     if(!_testfile)
     {
       std::cerr << "WARNING: Failed to open test file due to '" << _testfile.error().message() << std::endl;
@@ -200,11 +769,14 @@ int main(int argc, char *argv[])
       abort();
     }
   };
-  delete_testfile("test");
-  if(std::regex_match("latency:read:qd16", torun) || std::regex_match("latency:write:qd16", torun) || std::regex_match("latency:readwrite:qd4", torun))
+  for(auto &probe : probes)
   {
-    for(size_t n = 0; n < 16; n++)
-      delete_testfile(std::to_string(n));
+    delete_testfile(probe.dirh, "test");
+    if(ownfiles)
+    {
+      for(size_t n = 0; n < 16; n++)
+        delete_testfile(probe.dirh, std::to_string(n));
+    }
   }
-  return 0;
+  return ret;
 }
@@ -28,8 +28,22 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../../../include/llfio/llfio.hpp"
 #include "quickcpplib/algorithm/open_hash_index.hpp"
 
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <thread>
 #include <vector>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <nmmintrin.h>  // for _mm_crc32_u64
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>  // for __crc32cd
+#endif
+
 namespace key_value_store
 {
   namespace llfio = LLFIO_V2_NAMESPACE;
@@ -100,6 +114,216 @@ namespace key_value_store
     //! The key which caused the transaction to abort
     key_type key() const { return _key; }
   };
+  class snapshot_expired : std::runtime_error
+  {
+    key_type _key;
+
+  public:
+    snapshot_expired(key_type key)
+        : std::runtime_error("Every revision kept of a key is newer than the snapshot, use a newer snapshot!")
+        , _key(key)
+    {
+    }
+    //! The key whose history no longer reaches back to the snapshot
+    key_type key() const { return _key; }
+  };
+
+  //! The hash used to check the integrity of records
+  enum class integrity_hash : unsigned char
+  {
+    spooky,  //!< QuickCppLib's `fast_hash`, SpookyHash 128
+    crc32c   //!< Four interleaved lanes of CRC32C, hardware accelerated on x64 and AArch64
+  };
+
+  namespace detail
+  {
+    /* A 128 bit hash made of four CRC32C lanes, lane N taking the Nth eight bytes of each
+    32 bytes. As the lanes are independent, all four proceed at the full throughput of the
+    CPU's crc32 instruction. The software fallback produces identical results.
+    */
+    class crc32c_x4_hash
+    {
+      uint32_t _lanes[4]{0x9e3779b9U, 0x7f4a7c15U, 0x85ebca6bU, 0xc2b2ae35U};
+      llfio::byte _pending[32];
+      size_t _pendinglen{0};
+      uint64_t _total{0};
+
+      static const uint32_t *_table() noexcept
+      {
+        static const struct table_type
+        {
+          uint32_t v[256];
+          table_type() noexcept
+          {
+            for(uint32_t n = 0; n < 256; n++)
+            {
+              uint32_t crc = n;
+              for(int bit = 0; bit < 8; bit++)
+              {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78U : 0);
+              }
+              v[n] = crc;
+            }
+          }
+        } table;
+        return table.v;
+      }
+      static uint32_t _bytes(uint32_t crc, const llfio::byte *data, size_t bytes) noexcept
+      {
+        const uint32_t *table = _table();
+        for(size_t n = 0; n < bytes; n++)
+        {
+          crc = table[(crc ^ (uint8_t) data[n]) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+      }
+#if defined(__x86_64__) || defined(_M_X64)
+      static bool _have_crc32_instruction() noexcept
+      {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0;  // SSE 4.2
+#else
+        return __builtin_cpu_supports("sse4.2");
+#endif
+      }
+#if defined(__GNUC__) || defined(__clang__)
+      __attribute__((target("sse4.2")))
+#endif
+      static void _blocks_hardware(uint32_t *lanes, const llfio::byte *data, size_t blocks) noexcept
+      {
+        uint64_t l0 = lanes[0], l1 = lanes[1], l2 = lanes[2], l3 = lanes[3], w[4];
+        for(size_t n = 0; n < blocks; n++, data += 32)
+        {
+          memcpy(w, data, 32);
+          l0 = _mm_crc32_u64(l0, w[0]);
+          l1 = _mm_crc32_u64(l1, w[1]);
+          l2 = _mm_crc32_u64(l2, w[2]);
+          l3 = _mm_crc32_u64(l3, w[3]);
+        }
+        lanes[0] = (uint32_t) l0;
+        lanes[1] = (uint32_t) l1;
+        lanes[2] = (uint32_t) l2;
+        lanes[3] = (uint32_t) l3;
+      }
+#elif defined(__ARM_FEATURE_CRC32)
+      static bool _have_crc32_instruction() noexcept { return true; }
+      static void _blocks_hardware(uint32_t *lanes, const llfio::byte *data, size_t blocks) noexcept
+      {
+        uint32_t l0 = lanes[0], l1 = lanes[1], l2 = lanes[2], l3 = lanes[3];
+        uint64_t w[4];
+        for(size_t n = 0; n < blocks; n++, data += 32)
+        {
+          memcpy(w, data, 32);
+          l0 = __crc32cd(l0, w[0]);
+          l1 = __crc32cd(l1, w[1]);
+          l2 = __crc32cd(l2, w[2]);
+          l3 = __crc32cd(l3, w[3]);
+        }
+        lanes[0] = l0;
+        lanes[1] = l1;
+        lanes[2] = l2;
+        lanes[3] = l3;
+      }
+#else
+      static bool _have_crc32_instruction() noexcept { return false; }
+      static void _blocks_hardware(uint32_t * /*unused*/, const llfio::byte * /*unused*/, size_t /*unused*/) noexcept {}
+#endif
+      static void _blocks(uint32_t *lanes, const llfio::byte *data, size_t blocks) noexcept
+      {
+        static const bool have_crc32_instruction = _have_crc32_instruction();
+        if(have_crc32_instruction)
+        {
+          _blocks_hardware(lanes, data, blocks);
+          return;
+        }
+        for(size_t n = 0; n < blocks; n++, data += 32)
+        {
+          for(size_t lane = 0; lane < 4; lane++)
+          {
+            lanes[lane] = _bytes(lanes[lane], data + lane * 8, 8);
+          }
+        }
+      }
+
+    public:
+      void add(const char *_data, size_t bytes) noexcept
+      {
+        auto *data = reinterpret_cast<const llfio::byte *>(_data);
+        _total += bytes;
+        if(_pendinglen > 0)
+        {
+          const size_t tocopy = std::min(bytes, sizeof(_pending) - _pendinglen);
+          memcpy(_pending + _pendinglen, data, tocopy);
+          _pendinglen += tocopy;
+          data += tocopy;
+          bytes -= tocopy;
+          if(_pendinglen < sizeof(_pending))
+          {
+            return;
+          }
+          _blocks(_lanes, _pending, 1);
+          _pendinglen = 0;
+        }
+        _blocks(_lanes, data, bytes / 32);
+        data += bytes & ~(size_t) 31;
+        bytes &= 31;
+        memcpy(_pending, data, bytes);
+        _pendinglen = bytes;
+      }
+      uint128 finalise() noexcept
+      {
+        // The trailing bytes go into the lanes they would have gone into as whole words, then the length into every lane
+        for(size_t lane = 0; lane < 4 && lane * 8 < _pendinglen; lane++)
+        {
+          _lanes[lane] = _bytes(_lanes[lane], _pending + lane * 8, std::min<size_t>(8, _pendinglen - lane * 8));
+        }
+        llfio::byte length[8];
+        memcpy(length, &_total, 8);
+        for(auto &lane : _lanes)
+        {
+          lane = _bytes(lane, length, 8);
+        }
+        uint128 ret;
+        static_assert(sizeof(ret) == sizeof(_lanes), "uint128 is not sixteen bytes");
+        memcpy(&ret, _lanes, sizeof(ret));
+        return ret;
+      }
+      static uint128 hash(const char *data, size_t bytes) noexcept
+      {
+        crc32c_x4_hash h;
+        h.add(data, bytes);
+        return h.finalise();
+      }
+    };
+
+    // Hashes records with whichever hash the store was created with
+    class record_hasher
+    {
+      bool _crc32c;
+      QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash _spooky;
+      crc32c_x4_hash _crc;
+
+    public:
+      explicit record_hasher(bool crc32c)
+          : _crc32c(crc32c)
+      {
+      }
+      void add(const char *data, size_t bytes) noexcept
+      {
+        if(_crc32c)
+          _crc.add(data, bytes);
+        else
+          _spooky.add(data, bytes);
+      }
+      uint128 finalise() noexcept { return _crc32c ? _crc.finalise() : _spooky.finalise(); }
+      static uint128 hash(bool crc32c, const char *data, size_t bytes) noexcept
+      {
+        return crc32c ? crc32c_x4_hash::hash(data, bytes) : QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(data, bytes);
+      }
+    };
+  }  // namespace detail
 
   namespace index
   {
@@ -112,7 +336,7 @@ namespace key_value_store
         uint64_t transaction_counter;   // transaction counter when this was updated
         uint64_t value_offset : 58;     // Shifted left 6 as tail of blob record (value_tail) will always be on 64 byte boundary
         uint64_t value_identifier : 6;  // 0-47 is smallfile identifier, 48-63 is reserved for future usage
-        uint64_t length;                // Length in bytes
+        uint64_t length;                // Length in bytes, or for removals the transaction counter when removed
       } history[4];
     };
     static_assert(sizeof(value_history) == 96, "value_history is wrong size");
@@ -126,9 +350,66 @@ namespace key_value_store
     using open_hash_index = basic_open_hash_index<atomic_linear_memory_policy<key_type, value_history, 0>, LLFIO_V2_NAMESPACE::mapped>;
     static_assert(sizeof(open_hash_index::value_type) == 128, "open_hash_index::value_type is wrong size");
 
+    // Most recent version of this value only
+    struct compact_value_history
+    {
+      value_history::item history[1];
+      uint64_t _reserved;
+    };
+    static_assert(sizeof(compact_value_history) == 32, "compact_value_history is wrong size");
+    /* atomic_linear_memory_policy layout: Total 64 bytes, exactly one cache line
+       - atomic<uint32_t> lock    4 bytes
+       - atomic<uint32_t> inuse   4 bytes
+       - padding for uint128      8 bytes
+       - uint128 key             16 bytes
+       - compact_value_history   32 bytes
+    */
+    using compact_open_hash_index = basic_open_hash_index<atomic_linear_memory_policy<key_type, compact_value_history, 0>, LLFIO_V2_NAMESPACE::mapped>;
+    static_assert(sizeof(compact_open_hash_index::value_type) == 64, "compact_open_hash_index::value_type is wrong size");
+    // The three versions of a value before the most recent, for compact indices
+    struct overflow_value_history
+    {
+      value_history::item history[3];
+    };
+    using overflow_hash_index = basic_open_hash_index<atomic_linear_memory_policy<key_type, overflow_value_history, 0>, LLFIO_V2_NAMESPACE::mapped>;
+
+    //! The default index layout, 128 byte entries holding the four most recent revisions of each value
+    struct wide_layout
+    {
+      static constexpr bool compact = false;
+      using value_history = key_value_store::index::value_history;
+      using open_hash_index = key_value_store::index::open_hash_index;
+    };
+    /*! A compact index layout of 64 byte entries, so each probe touches a single cache line
+    and the index is half the size. Entries hold only the most recent revision of each value,
+    the three revisions before that are kept in a separate overflow index file which only
+    updates and fetches of older revisions touch.
+    */
+    struct compact_layout
+    {
+      static constexpr bool compact = true;
+      using value_history = key_value_store::index::compact_value_history;
+      using open_hash_index = key_value_store::index::compact_open_hash_index;
+    };
+
+    /* Lookups read index entries without taking their locks, which would have them write to
+    the entry's cache line and so contend with every other process reading the same key. Instead
+    each entry is covered by a seqlock, and writers already holding the entry's exclusive lock take
+    the seqlock by compare and swapping its sequence from even to odd, making their modifications,
+    then releasing the sequence to the next even number. Readers load the sequence, copy what
+    they need from the entry, then reload the sequence, retrying with the entry's lock should a
+    writer have been active in between. As the changes of many keys must appear atomically to
+    transactions, the entry locks continue to serialise writers.
+
+    Readers can only find keys without locks if they know which entry the key is in, so each
+    store remembers where it last found each key. Keys only leave their entries by being erased,
+    which increments `erasures` within the seqlock of the entry, and readers disbelieve anything
+    they remembered before the last erasure.
+    */
+    static constexpr size_t seqlock_stripes = 4096;
     struct index
     {
-      uint64_t magic;                              // versionmagic, currently "AFIOKV01" for valid, "DEADKV01" for requires repair
+      uint64_t magic;                              // versionmagic, currently "AFIOKV03" for valid, "DEADKV03" for requires repair
       std::atomic<uint64_t> transaction_counter;   // top 16 bits are number of keys changed this transaction, bottom 48 bits are monotonic counter
       uint128 hash;                                // Optional hash of index file written on last close to guard against systems which don't write mmaps properly
       std::atomic<unsigned> writes_occurring[48];  // Incremented just before an update, decremented after, per writer
@@ -136,6 +417,431 @@ namespace key_value_store
 
       uint64_t contents_hashed : 1;       // If records written are hashed and checked on fetch
       uint64_t key_is_hash_of_value : 1;  // On read, check hash of value equals key
+      uint64_t compact_layout : 1;        // If the index has the compact layout, with an overflow index
+      uint64_t hash_crc32c : 1;           // If records are hashed with integrity_hash::crc32c rather than integrity_hash::spooky
+      uint64_t bloom_filter : 1;          // If index.bloom holds a Bloom filter of the keys, consulted before the index
+      uint64_t ordered_index : 1;         // If index.ordered holds a B+tree of the keys, for range scans
+
+      std::atomic<uint64_t> committing[48];  // Per writer, the oldest transaction counter still being committed, zero if none, -1 if about to take one
+
+      std::atomic<uint32_t> erasures;                     // Incremented whenever a key is erased from the index
+      std::atomic<uint32_t> sequences[seqlock_stripes];  // Seqlock of each index entry, entry n using sequences[n % seqlock_stripes]
+    };
+
+    /* A blocked Bloom filter of the keys in the index. Each key sets one bit in each of the
+    eight words of a single 64 byte block, so a lookup touches one cache line rather than
+    probing the index. Bits are only ever set, so removed keys remain false positives until
+    the filter is rebuilt by the first user to open the store.
+    */
+    class bloom_filter
+    {
+      std::atomic<uint64_t> *_words{nullptr};
+      size_t _blocks{0};
+
+      template <class F> void _bits(key_type key, F &&f) const noexcept
+      {
+        static constexpr uint32_t salts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        // Keys may be anything, so mix them down to 64 well distributed bits
+        uint64_t h = key.as_longlongs[0] ^ (key.as_longlongs[1] * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        std::atomic<uint64_t> *block = _words + 8 * (size_t) (((h >> 32) * _blocks) >> 32);
+        for(size_t n = 0; n < 8; n++)
+        {
+          f(block[n], uint64_t(1) << ((uint32_t(h) * salts[n]) >> 26));
+        }
+      }
+
+    public:
+      //! Sixteen bits per entry keeps false positives at about one in a thousand when the index is full
+      static llfio::file_handle::extent_type bytes_for(size_t hashtableentries) noexcept { return llfio::utils::round_up_to_page_size((hashtableentries / 32 + 1) * 64, llfio::utils::page_size()); }
+
+      bloom_filter() = default;
+      bloom_filter(llfio::byte *data, size_t bytes) noexcept
+          : _words(reinterpret_cast<std::atomic<uint64_t> *>(data))
+          , _blocks(bytes / 64)
+      {
+      }
+      explicit operator bool() const noexcept { return _blocks != 0; }
+
+      void insert(key_type key) noexcept
+      {
+        _bits(key, [](std::atomic<uint64_t> &word, uint64_t bit) { word.fetch_or(bit, std::memory_order_relaxed); });
+      }
+      //! False if the key is definitely not in the index
+      bool may_contain(key_type key) const noexcept
+      {
+        bool ret = true;
+        _bits(key, [&](const std::atomic<uint64_t> &word, uint64_t bit) { ret = ret && (word.load(std::memory_order_relaxed) & bit) != 0; });
+        return ret;
+      }
+    };
+
+    /* An ordered index of the keys, a B+tree of page sized nodes, so the keys within a range can
+    be found in O(log n + k). Keys are ordered numerically, `as_longlongs[1]` being the most
+    significant half. Like the Bloom filter keys are only ever added, so removed keys remain until
+    the tree is rebuilt by the first user to open the store, and must be checked against the index.
+    Writers serialise on a spinlock in the first page, while readers take no locks and instead
+    retry should the sequence count in the first page show a writer changed the tree under them.
+    */
+    class ordered_index
+    {
+    public:
+      static constexpr size_t node_size = 4096;
+      static constexpr size_t fanout = (node_size - 24) / 24;  // keys per node
+      static constexpr uint32_t max_height = 16;
+
+    private:
+      struct header
+      {
+        std::atomic<uint32_t> lock;      // held by the writer modifying the tree
+        uint32_t height;                 // zero if the tree is empty
+        std::atomic<uint64_t> sequence;  // odd whilst the tree is being modified
+        uint64_t root;
+        uint64_t nodes_used;  // including this header
+        uint64_t nodes_total;
+      };
+      struct node
+      {
+        uint32_t count;
+        uint32_t leaf;
+        uint64_t next;  // the next leaf, zero if none
+        key_type keys[fanout];
+        uint64_t children[fanout + 1];  // inner nodes only
+      };
+      static_assert(sizeof(node) <= node_size, "ordered_index::node is wrong size");
+
+      llfio::byte *_base{nullptr};
+      uint64_t _nodes{0};
+
+      header *_header() const noexcept { return reinterpret_cast<header *>(_base); }
+      node *_node(uint64_t n) const noexcept { return reinterpret_cast<node *>(_base + n * node_size); }
+      // The first key in the node not less than key
+      static size_t _lower_bound(const node *n, size_t count, const key_type &key) noexcept
+      {
+        size_t lo = 0, hi = count;
+        while(lo < hi)
+        {
+          const size_t mid = (lo + hi) / 2;
+          if(less(n->keys[mid], key))
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+        return lo;
+      }
+      // The first key in the node greater than key, which is also the child holding key
+      static size_t _upper_bound(const node *n, size_t count, const key_type &key) noexcept
+      {
+        size_t lo = 0, hi = count;
+        while(lo < hi)
+        {
+          const size_t mid = (lo + hi) / 2;
+          if(!less(key, n->keys[mid]))
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+        return lo;
+      }
+      uint64_t _allocate(bool leaf) noexcept
+      {
+        const uint64_t ret = _header()->nodes_used++;
+        node *n = _node(ret);
+        n->count = 0;
+        n->leaf = leaf;
+        n->next = 0;
+        return ret;
+      }
+      void _begin_write() noexcept
+      {
+        auto &sequence = _header()->sequence;
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
+      void _end_write() noexcept
+      {
+        auto &sequence = _header()->sequence;
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+      }
+      // False if what was read was inconsistent, which a concurrent writer can cause
+      bool _range(std::pair<size_t, bool> &ret, span<key_type> out, const key_type &first, const key_type &last) const noexcept
+      {
+        const uint32_t height = _header()->height;
+        uint64_t current = _header()->root;
+        if(height == 0)
+        {
+          return true;
+        }
+        if(height > max_height)
+        {
+          return false;
+        }
+        for(uint32_t level = 0; level + 1 < height; level++)
+        {
+          if(current == 0 || current >= _nodes)
+          {
+            return false;
+          }
+          const node *n = _node(current);
+          const size_t count = n->count;
+          if(count > fanout)
+          {
+            return false;
+          }
+          current = n->children[_upper_bound(n, count, first)];
+        }
+        for(uint64_t visited = 0; current != 0; visited++)
+        {
+          if(current >= _nodes || visited >= _nodes)
+          {
+            return false;
+          }
+          const node *n = _node(current);
+          const size_t count = n->count;
+          if(count > fanout)
+          {
+            return false;
+          }
+          for(size_t pos = _lower_bound(n, count, first); pos < count; pos++)
+          {
+            if(less(last, n->keys[pos]))
+            {
+              return true;
+            }
+            if(ret.first == out.size())
+            {
+              ret.second = true;
+              return true;
+            }
+            out[ret.first++] = n->keys[pos];
+          }
+          current = n->next;
+        }
+        return true;
+      }
+
+    public:
+      //! The order of keys in the tree
+      static bool less(const key_type &a, const key_type &b) noexcept { return a.as_longlongs[1] < b.as_longlongs[1] || (a.as_longlongs[1] == b.as_longlongs[1] && a.as_longlongs[0] < b.as_longlongs[0]); }
+      //! Room for twice as many keys as the index holds in half full leaves, plus their inner nodes
+      static llfio::file_handle::extent_type bytes_for(size_t hashtableentries) noexcept
+      {
+        const llfio::file_handle::extent_type leaves = 2 * hashtableentries / (fanout / 2) + 1;
+        return llfio::utils::round_up_to_page_size((1 + leaves + leaves / (fanout / 2 - 1) + max_height) * node_size, llfio::utils::page_size());
+      }
+
+      ordered_index() = default;
+      ordered_index(llfio::byte *data, size_t bytes) noexcept
+          : _base(data)
+          , _nodes(bytes / node_size)
+      {
+      }
+      explicit operator bool() const noexcept { return _nodes != 0; }
+
+      //! Empties the tree. Only the first user of the store may call this.
+      void reset() noexcept
+      {
+        header *h = _header();
+        h->lock.store(0, std::memory_order_relaxed);
+        h->height = 0;
+        h->sequence.store(0, std::memory_order_relaxed);
+        h->root = 0;
+        h->nodes_used = 1;
+        h->nodes_total = _nodes;
+      }
+      //! Fills an empty tree with keys, which must be sorted and unique. Only the first user of the store may call this.
+      void build(span<const key_type> keys)
+      {
+        header *h = _header();
+        // Leave a quarter of each node free, so new keys don't immediately split every node
+        const size_t fill = fanout - fanout / 4;
+        std::vector<std::pair<uint64_t, key_type>> level;  // each node, and the least key beneath it
+        level.reserve(keys.size() / fill + 1);
+        uint64_t prev = 0;
+        for(size_t n = 0; n < keys.size(); n += fill)
+        {
+          if(h->nodes_used >= h->nodes_total)
+          {
+            throw index_full();
+          }
+          const uint64_t leaf = _allocate(true);
+          node *l = _node(leaf);
+          l->count = (uint32_t) std::min(fill, keys.size() - n);
+          memcpy(l->keys, keys.data() + n, l->count * sizeof(key_type));
+          if(prev != 0)
+          {
+            _node(prev)->next = leaf;
+          }
+          prev = leaf;
+          level.emplace_back(leaf, keys[n]);
+        }
+        uint32_t height = level.empty() ? 0 : 1;
+        while(level.size() > 1)
+        {
+          std::vector<std::pair<uint64_t, key_type>> parents;
+          parents.reserve(level.size() / (fill + 1) + 1);
+          for(size_t n = 0; n < level.size(); n += fill + 1)
+          {
+            if(h->nodes_used >= h->nodes_total)
+            {
+              throw index_full();
+            }
+            const uint64_t inner = _allocate(false);
+            node *i = _node(inner);
+            const size_t children = std::min(fill + 1, level.size() - n);
+            i->count = (uint32_t) (children - 1);
+            for(size_t m = 0; m < children; m++)
+            {
+              i->children[m] = level[n + m].first;
+              if(m > 0)
+              {
+                i->keys[m - 1] = level[n + m].second;
+              }
+            }
+            parents.emplace_back(inner, level[n].second);
+          }
+          level = std::move(parents);
+          height++;
+        }
+        h->root = level.empty() ? 0 : level.front().first;
+        h->height = height;
+      }
+      //! Adds a key to the tree if not already present, throwing `index_full` if there is no room left.
+      void insert(key_type key)
+      {
+        header *h = _header();
+        for(uint32_t expected = 0; !h->lock.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed); expected = 0)
+        {
+          std::this_thread::yield();
+        }
+        auto unlock = make_scope_exit([h]() noexcept { h->lock.store(0, std::memory_order_release); });
+        const uint32_t height = h->height;
+        // A split of every node on the path plus a new root is the most which may be needed
+        if(height >= max_height || h->nodes_used + height + 1 > h->nodes_total)
+        {
+          throw index_full();
+        }
+        if(height == 0)
+        {
+          _begin_write();
+          const uint64_t leaf = _allocate(true);
+          _node(leaf)->keys[0] = key;
+          _node(leaf)->count = 1;
+          h->root = leaf;
+          h->height = 1;
+          _end_write();
+          return;
+        }
+        uint64_t path[max_height];
+        size_t pathidx[max_height];
+        uint64_t current = h->root;
+        for(uint32_t level = 0; level + 1 < height; level++)
+        {
+          const node *n = _node(current);
+          path[level] = current;
+          pathidx[level] = _upper_bound(n, n->count, key);
+          current = n->children[pathidx[level]];
+        }
+        node *leaf = _node(current);
+        const size_t pos = _lower_bound(leaf, leaf->count, key);
+        if(pos < leaf->count && !less(key, leaf->keys[pos]))
+        {
+          return;
+        }
+        _begin_write();
+        if(leaf->count < fanout)
+        {
+          memmove(leaf->keys + pos + 1, leaf->keys + pos, (leaf->count - pos) * sizeof(key_type));
+          leaf->keys[pos] = key;
+          leaf->count++;
+          _end_write();
+          return;
+        }
+        // Split the leaf, the upper half moving into a new leaf, then insert the new leaf into
+        // its parent, splitting that too if full, and so on up to the root
+        key_type mergedkeys[fanout + 1];
+        uint64_t mergedchildren[fanout + 2];
+        memcpy(mergedkeys, leaf->keys, pos * sizeof(key_type));
+        mergedkeys[pos] = key;
+        memcpy(mergedkeys + pos + 1, leaf->keys + pos, (fanout - pos) * sizeof(key_type));
+        uint64_t right = _allocate(true);
+        {
+          node *r = _node(right);
+          leaf->count = (uint32_t) ((fanout + 1) / 2);
+          r->count = (uint32_t) (fanout + 1 - leaf->count);
+          memcpy(leaf->keys, mergedkeys, leaf->count * sizeof(key_type));
+          memcpy(r->keys, mergedkeys + leaf->count, r->count * sizeof(key_type));
+          r->next = leaf->next;
+          leaf->next = right;
+        }
+        key_type separator = _node(right)->keys[0];
+        for(size_t level = height - 1; level-- > 0;)
+        {
+          node *n = _node(path[level]);
+          const size_t idx = pathidx[level];
+          if(n->count < fanout)
+          {
+            memmove(n->keys + idx + 1, n->keys + idx, (n->count - idx) * sizeof(key_type));
+            memmove(n->children + idx + 2, n->children + idx + 1, (n->count - idx) * sizeof(uint64_t));
+            n->keys[idx] = separator;
+            n->children[idx + 1] = right;
+            n->count++;
+            _end_write();
+            return;
+          }
+          memcpy(mergedkeys, n->keys, idx * sizeof(key_type));
+          mergedkeys[idx] = separator;
+          memcpy(mergedkeys + idx + 1, n->keys + idx, (fanout - idx) * sizeof(key_type));
+          memcpy(mergedchildren, n->children, (idx + 1) * sizeof(uint64_t));
+          mergedchildren[idx + 1] = right;
+          memcpy(mergedchildren + idx + 2, n->children + idx + 1, (fanout - idx) * sizeof(uint64_t));
+          // The middle key moves up into the parent rather than being kept
+          const size_t mid = (fanout + 1) / 2;
+          right = _allocate(false);
+          node *r = _node(right);
+          n->count = (uint32_t) mid;
+          r->count = (uint32_t) (fanout - mid);
+          memcpy(n->keys, mergedkeys, mid * sizeof(key_type));
+          memcpy(n->children, mergedchildren, (mid + 1) * sizeof(uint64_t));
+          memcpy(r->keys, mergedkeys + mid + 1, r->count * sizeof(key_type));
+          memcpy(r->children, mergedchildren + mid + 1, (r->count + 1) * sizeof(uint64_t));
+          separator = mergedkeys[mid];
+        }
+        const uint64_t root = _allocate(false);
+        node *nr = _node(root);
+        nr->count = 1;
+        nr->keys[0] = separator;
+        nr->children[0] = h->root;
+        nr->children[1] = right;
+        h->root = root;
+        h->height = height + 1;
+        _end_write();
+      }
+      /*! Copies the keys from `first` to `last` inclusive into `out` in order, returning how many
+      were copied and whether more keys in the range remain beyond those. Never blocks writers.
+      */
+      std::pair<size_t, bool> range(span<key_type> out, key_type first, key_type last) const noexcept
+      {
+        for(;;)
+        {
+          const uint64_t sequence = _header()->sequence.load(std::memory_order_acquire);
+          if((sequence & 1) == 0)
+          {
+            std::pair<size_t, bool> ret(0, false);
+            const bool consistent = _range(ret, out, first, last);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(consistent && _header()->sequence.load(std::memory_order_relaxed) == sequence)
+            {
+              return ret;
+            }
+          }
+          std::this_thread::yield();
+        }
+      }
     };
 
     struct value_tail
@@ -148,14 +854,22 @@ namespace key_value_store
     static_assert(sizeof(value_tail) == 48, "value_tail is wrong size");
   }
 
-  class transaction;
+  template <class Layout = index::wide_layout> class transaction;
 
   /*! A transactional key-value store.
+
+  `Layout` chooses the layout of the index when the store is created, either `index::wide_layout`
+  or `index::compact_layout`. Opening a store with the other layout throws `unknown_store`.
   */
-  class basic_key_value_store
+  template <class Layout = index::wide_layout> class basic_key_value_store
   {
-    friend class transaction;
+    template <class> friend class transaction;
+    using open_hash_index = typename Layout::open_hash_index;
+    using value_history = typename Layout::value_history;
+    static constexpr size_t _history_slots = sizeof(value_history::history) / sizeof(value_history::history[0]);
+
     llfio::file_handle _indexfile;
+    llfio::file_handle _overflowfile;  // compact layout only
     llfio::file_handle _mysmallfile;  // append only
     llfio::file_handle::extent_guard _indexfileguard, _smallfileguard;
     size_t _mysmallfileidx{(size_t) -1};
@@ -164,20 +878,313 @@ namespace key_value_store
       std::vector<llfio::file_handle> blocking;
       std::vector<llfio::mapped_file_handle> mapped;
     } _smallfiles;
-    optional<index::open_hash_index> _index;
+    optional<open_hash_index> _index;
+    optional<index::overflow_hash_index> _overflow;  // compact layout only, the revisions before the most recent
+    llfio::mapped_file_handle _bloomfile;
+    index::bloom_filter _bloom;  // empty unless the store has a Bloom filter
+    llfio::mapped_file_handle _orderedfile;
+    index::ordered_index _ordered;  // empty unless the store has an ordered index
     index::index *_indexheader{nullptr};
+    // Where keys were last found in the index, the entry plus one in the bottom 32 bits and the erasures thus far in the top 32 bits
+    static constexpr size_t _located_entries = 16384;
+    std::vector<std::atomic<uint64_t>> _located = std::vector<std::atomic<uint64_t>>(_located_entries);
     std::mutex _commitlock;
+    // The transaction counters my transactions are committing, published to committing[] in the index header
+    struct
+    {
+      std::mutex lock;
+      size_t pending{0};  // about to take a transaction counter
+      std::vector<uint64_t> counters;
+    } _committing;
     size_t _mmap_over_extension{0};
+    std::mutex _compactlock;  // serialises compact()
+    // A transaction's value records awaiting appending to my smallfile by the group commit leader
+    struct _pending_append
+    {
+      struct record
+      {
+        size_t buffers;                             // gather buffers in reqs making up this record
+        size_t bytes;                               // length of this record, always a multiple of 64
+        index::value_history::item *history_item;  // told where the record was appended, null for removals
+      };
+      std::vector<std::array<llfio::byte, 128>> tails;
+      std::vector<llfio::file_handle::const_buffer_type> reqs;
+      std::vector<record> records;
+      size_t bytes{0};
+      bool done{false};
+      std::exception_ptr failure;
+    };
+    struct
+    {
+      std::mutex lock;
+      std::condition_variable changed;
+      std::vector<_pending_append *> queue;
+      bool leader_active{false};
+    } _group_commit;
+    struct
+    {
+      std::thread thread;
+      std::mutex lock;
+      std::condition_variable changed;
+      bool stop{false};
+    } _compactor;
 
     static constexpr llfio::file_handle::extent_type _indexinuseoffset = INT64_MAX;
-    static constexpr uint64_t _goodmagic = 0x3130564b4f494641;  // "AFIOKV01"
-    static constexpr uint64_t _badmagic = 0x3130564b44414544;   // "DEADKV01"
+    static constexpr uint64_t _goodmagic = 0x3330564b4f494641;  // "AFIOKV03"
+    static constexpr uint64_t _badmagic = 0x3330564b44414544;   // "DEADKV03"
+    static constexpr llfio::file_handle::extent_type _compaction_chunk = 1024 * 1024;
 
     static size_t _pad_length(size_t length)
     {
       // We append a value_tail record and round up to 64 byte multiple
       return (length + sizeof(index::value_tail) + 63) & ~63;
     }
+    // Seqlocks of the index entries, see index::index
+    const typename open_hash_index::value_type *_entry(uint64_t n) const noexcept { return reinterpret_cast<const typename open_hash_index::value_type *>((const char *) _index->container().data() + n * sizeof(typename open_hash_index::value_type)); }
+    uint64_t _entry_number(const key_type &entrykey) const noexcept { return (uint64_t)(((const char *) &entrykey - (const char *) _index->container().data()) / sizeof(typename open_hash_index::value_type)); }
+    std::atomic<uint32_t> &_sequence(uint64_t n) const noexcept { return _indexheader->sequences[n % index::seqlock_stripes]; }
+    static size_t _located_slot(key_type key) noexcept
+    {
+      uint64_t h = key.as_longlongs[0] ^ (key.as_longlongs[1] * 0x9e3779b97f4a7c15ULL);
+      h ^= h >> 29;
+      h *= 0xbf58476d1ce4e5b9ULL;
+      h ^= h >> 32;
+      return (size_t) h & (_located_entries - 1);
+    }
+    // Remembers the index entry whose key is `entrykey`, call holding its lock
+    void _remember_location(const key_type &entrykey) noexcept
+    {
+      const uint64_t erasures = _indexheader->erasures.load(std::memory_order_acquire);
+      _located[_located_slot(entrykey)].store((erasures << 32) | (_entry_number(entrykey) + 1), std::memory_order_relaxed);
+    }
+    // Takes the seqlock of the index entry whose key is `entrykey`, call holding its exclusive lock
+    std::atomic<uint32_t> &_begin_modify(const key_type &entrykey) noexcept
+    {
+      auto &seq = _sequence(_entry_number(entrykey));
+      for(uint32_t s = seq.load(std::memory_order_relaxed);; s = seq.load(std::memory_order_relaxed))
+      {
+        // Other writers only hold a seqlock for as long as it takes to update an entry
+        if((s & 1) == 0 && seq.compare_exchange_weak(s, s + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      // Any reader seeing my modifications will see the odd sequence on rereading it
+      std::atomic_thread_fence(std::memory_order_release);
+      return seq;
+    }
+    static void _end_modify(std::atomic<uint32_t> &seq) noexcept { seq.fetch_add(1, std::memory_order_release); }
+    // Erases an index entry whose seqlock I hold
+    void _erase(typename open_hash_index::iterator &&it) noexcept
+    {
+      // Erasing may move other entries, so readers of those must see the erasure too
+      _indexheader->erasures.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      _index->erase(std::move(it));
+    }
+    /* Copies the history item at `revision` of `key` from where it was last found in the index,
+    without taking any locks. Returns false if it must instead be looked up with locks, otherwise
+    `seq` and `s` are the seqlock and its sequence at the time of copying.
+    */
+    bool _read_unlocked(key_type key, size_t revision, index::value_history::item &item, const std::atomic<uint32_t> *&seq, uint32_t &s) const noexcept
+    {
+      const uint64_t located = _located[_located_slot(key)].load(std::memory_order_relaxed);
+      if((uint32_t) located == 0)
+      {
+        return false;
+      }
+      const uint64_t n = (uint32_t) located - 1;
+      seq = &_sequence(n);
+      s = seq->load(std::memory_order_acquire);
+      // Only after loading the sequence can erasures be trusted to include any erasure of this entry
+      const uint32_t erasures = (uint32_t)(located >> 32);
+      if((s & 1) != 0 || erasures != _indexheader->erasures.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+      const auto *entry = _entry(n);
+      const key_type entrykey = entry->first;
+      item = entry->second.history[revision];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return entrykey == key && seq->load(std::memory_order_relaxed) == s && erasures == _indexheader->erasures.load(std::memory_order_relaxed);
+    }
+    /* Group commit: committers enqueue their records, and whichever finds no leader active
+    becomes leader, appending everything enqueued thus far in one go. Everybody enqueued
+    during that append is appended by the next leader, so the cost of each append syscall
+    (and of its durability, if writes are durable) is amortised across transactions.
+    */
+    void _group_append(_pending_append &pending)
+    {
+      std::unique_lock<std::mutex> g(_group_commit.lock);
+      _group_commit.queue.push_back(&pending);
+      _group_commit.changed.wait(g, [&] { return pending.done || !_group_commit.leader_active; });
+      if(!pending.done)
+      {
+        _group_commit.leader_active = true;
+        std::vector<_pending_append *> batch;
+        batch.swap(_group_commit.queue);
+        g.unlock();
+        std::exception_ptr failure;
+        try
+        {
+          _append_batch(batch);
+        }
+        catch(...)
+        {
+          failure = std::current_exception();
+        }
+        g.lock();
+        for(auto *i : batch)
+        {
+          i->failure = failure;
+          i->done = true;
+        }
+        _group_commit.leader_active = false;
+        g.unlock();
+        _group_commit.changed.notify_all();
+      }
+      if(pending.failure)
+      {
+        std::rethrow_exception(pending.failure);
+      }
+    }
+    void _append_batch(span<_pending_append *const> batch)
+    {
+      std::lock_guard<decltype(_commitlock)> commitlockguard(_commitlock);
+      llfio::file_handle::extent_type value_offset = _mysmallfile.maximum_extent().value();
+      assert((value_offset % 64) == 0);
+      size_t totalcommitsize = 0;
+      for(const auto *i : batch)
+      {
+        totalcommitsize += i->bytes;
+      }
+      if(!_smallfiles.mapped.empty() && totalcommitsize >= 4096)
+      {
+        auto &mfh = _smallfiles.mapped[_mysmallfileidx];
+        llfio::file_handle::extent_type new_length = value_offset + totalcommitsize;
+        if(new_length > mfh.capacity())
+        {
+          mfh.reserve(new_length + _mmap_over_extension).value();
+        }
+        mfh.truncate(new_length).value();
+        llfio::byte *value = mfh.address() + value_offset;
+        for(const auto *i : batch)
+        {
+          for(const auto &req : i->reqs)
+          {
+            memcpy(value, req.data(), req.size());
+            value += req.size();
+          }
+        }
+      }
+      else
+      {
+        // Gather append write all the records, as many at a time as the platform allows.
+        // POSIX guarantees that at least 16 gather buffers can be written in a single shot.
+        const size_t maxbuffers = std::max<size_t>(_mysmallfile.max_buffers(), 16);
+        std::vector<llfio::file_handle::const_buffer_type> reqs;
+        reqs.reserve(maxbuffers);
+        for(const auto *i : batch)
+        {
+          for(const auto &req : i->reqs)
+          {
+            reqs.push_back(req);
+            if(reqs.size() == maxbuffers)
+            {
+              _mysmallfile.write({reqs, 0}).value();
+              reqs.clear();
+            }
+          }
+        }
+        if(!reqs.empty())
+        {
+          _mysmallfile.write({reqs, 0}).value();
+        }
+      }
+      // Tell each record where it was appended
+      for(const auto *i : batch)
+      {
+        for(const auto &record : i->records)
+        {
+          value_offset += record.bytes;
+          if(record.history_item != nullptr)
+          {
+            record.history_item->value_offset = value_offset / 64;
+            record.history_item->value_identifier = _mysmallfileidx;
+          }
+        }
+      }
+    }
+    // Deallocates a no longer referenced region of my smallfile
+    llfio::file_handle::extent_type _deallocate(llfio::file_handle::extent_type begin, llfio::file_handle::extent_type end)
+    {
+      std::lock_guard<decltype(_commitlock)> commitlockguard(_commitlock);
+      // Where hole punching is unsupported zero() writes zeros, which would append if append only
+      _mysmallfile.set_append_only(false).value();
+      auto restoreappendonly = make_scope_exit([this]() noexcept { (void) _mysmallfile.set_append_only(true); });
+      return _mysmallfile.zero(begin, end - begin).value();
+    }
+    // Only the first user of the store may call this, as it clears the Bloom filter before refilling it from the index
+    void _rebuild_bloom_filter(const llfio::path_handle &dir, llfio::file_handle::caching caching, llfio::file_handle::extent_type bytes, bool empty)
+    {
+      auto bloomfile = llfio::mapped_file_handle::mapped_file(dir, "index.bloom", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, caching,
+                                                              llfio::file_handle::flag::disable_prefetching)
+                       .value();
+      if(bytes == 0)
+      {
+        bytes = bloomfile.maximum_extent().value();
+      }
+      // Truncating to zero and back is the quickest way to clear all the bits
+      bloomfile.truncate(0).value();
+      bloomfile.truncate(bytes).value();
+      if(empty)
+      {
+        return;
+      }
+      index::bloom_filter bloom(bloomfile.address(), (size_t) bytes);
+      _for_each_indexed([&](const typename open_hash_index::value_type &i) { bloom.insert(i.first); });
+    }
+    // Only the first user of the store may call this, as it empties the ordered index before refilling it from the index
+    void _rebuild_ordered_index(const llfio::path_handle &dir, llfio::file_handle::caching caching, llfio::file_handle::extent_type bytes, bool empty)
+    {
+      auto orderedfile = llfio::mapped_file_handle::mapped_file(dir, "index.ordered", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, caching,
+                                                                llfio::file_handle::flag::disable_prefetching)
+                         .value();
+      if(bytes == 0)
+      {
+        bytes = orderedfile.maximum_extent().value();
+      }
+      orderedfile.truncate(0).value();
+      orderedfile.truncate(bytes).value();
+      index::ordered_index ordered(orderedfile.address(), (size_t) bytes);
+      ordered.reset();
+      if(empty)
+      {
+        return;
+      }
+      // Keys whose latest revision is a removal are left out
+      std::vector<key_type> keys;
+      _for_each_indexed([&](const typename open_hash_index::value_type &i) {
+        if(i.second.history[0].transaction_counter != 0)
+        {
+          keys.push_back(i.first);
+        }
+      });
+      std::sort(keys.begin(), keys.end(), index::ordered_index::less);
+      ordered.build(keys);
+    }
+    // Calls f with every entry in the index, read through a private mapping
+    template <class F> void _for_each_indexed(F &&f)
+    {
+      const llfio::section_handle::flag mapflags = llfio::section_handle::flag::read | llfio::section_handle::flag::cow;
+      llfio::section_handle sh = llfio::section_handle::section(_indexfile, 0, mapflags).value();
+      const auto entries = (sh.length().value() - sizeof(index::index)) / sizeof(typename open_hash_index::value_type);
+      open_hash_index idx(sh, entries, sizeof(index::index), mapflags);
+      for(const auto &i : idx)
+      {
+        f(i);
+      }
+    }
     void _openfiles(const llfio::path_handle &dir, llfio::file_handle::mode mode, llfio::file_handle::caching caching)
     {
       const llfio::file_handle::mode smallfilemode =
@@ -248,10 +1255,30 @@ namespace key_value_store
         llfio::section_handle sh = llfio::section_handle::section(_indexfile, 0, mapflags).value();
         llfio::file_handle::extent_type len = sh.length().value();
         len -= sizeof(index::index);
-        len /= sizeof(index::open_hash_index::value_type);
+        len /= sizeof(typename open_hash_index::value_type);
         size_t offset = sizeof(index::index);
         _index.emplace(sh, len, offset, mapflags);
         _indexheader = reinterpret_cast<index::index *>((char *) _index->container().data() - offset);
+        if(_indexheader->compact_layout != Layout::compact)
+        {
+          throw unknown_store();
+        }
+        if(Layout::compact)
+        {
+          _overflowfile = llfio::file_handle::file(dir, "index.history", mode, llfio::file_handle::creation::open_existing, caching, llfio::file_handle::flag::disable_prefetching).value();
+          llfio::section_handle osh = llfio::section_handle::section(_overflowfile, 0, mapflags).value();
+          _overflow.emplace(osh, osh.length().value() / sizeof(typename index::overflow_hash_index::value_type), 0, mapflags);
+        }
+        if(_indexheader->bloom_filter)
+        {
+          _bloomfile = llfio::mapped_file_handle::mapped_file(dir, "index.bloom", mode, llfio::file_handle::creation::open_existing, caching, llfio::file_handle::flag::disable_prefetching).value();
+          _bloom = index::bloom_filter(_bloomfile.address(), (size_t) _bloomfile.maximum_extent().value());
+        }
+        if(_indexheader->ordered_index)
+        {
+          _orderedfile = llfio::mapped_file_handle::mapped_file(dir, "index.ordered", mode, llfio::file_handle::creation::open_existing, caching, llfio::file_handle::flag::disable_prefetching).value();
+          _ordered = index::ordered_index(_orderedfile.address(), (size_t) _orderedfile.maximum_extent().value());
+        }
         if(_indexheader->writes_occurring[_mysmallfileidx] != 0)
         {
           _indexheader->magic = _badmagic;
@@ -266,7 +1293,13 @@ namespace key_value_store
     basic_key_value_store &operator=(const basic_key_value_store &) = delete;
     basic_key_value_store &operator=(basic_key_value_store &&) = delete;
 
-    basic_key_value_store(const llfio::path_handle &dir, size_t hashtableentries, bool enable_integrity = false, llfio::file_handle::mode mode = llfio::file_handle::mode::write, llfio::file_handle::caching caching = llfio::file_handle::caching::all)
+    /*! Opens, or creates, the store in `dir`. `enable_integrity`, and which `hash` then checks
+    the integrity of each value, take effect only when creating the store. So does `enable_bloom_filter`,
+    which keeps a Bloom filter of the keys so most lookups of absent keys never touch the index,
+    and `enable_ordered_index`, which keeps the keys in order so `keys_in_range()` can be used.
+    */
+    basic_key_value_store(const llfio::path_handle &dir, size_t hashtableentries, bool enable_integrity = false, llfio::file_handle::mode mode = llfio::file_handle::mode::write, llfio::file_handle::caching caching = llfio::file_handle::caching::all, integrity_hash hash = integrity_hash::spooky,
+                          bool enable_bloom_filter = false, bool enable_ordered_index = false)
         : _indexfile(llfio::file_handle::file(dir, "index", mode, (mode == llfio::file_handle::mode::write) ? llfio::file_handle::creation::if_needed : llfio::file_handle::creation::open_existing, caching, llfio::file_handle::flag::disable_prefetching).value())
     {
       if(mode == llfio::file_handle::mode::write)
@@ -278,14 +1311,33 @@ namespace key_value_store
           // I am the first entrant into this data store
           if(_indexfile.maximum_extent().value() == 0)
           {
-            llfio::file_handle::extent_type size = sizeof(index::index) + (hashtableentries) * sizeof(index::open_hash_index::value_type);
+            llfio::file_handle::extent_type size = sizeof(index::index) + (hashtableentries) * sizeof(typename open_hash_index::value_type);
             size = llfio::utils::round_up_to_page_size(size, llfio::utils::page_size());
             _indexfile.truncate(size).value();
+            if(Layout::compact)
+            {
+              // The overflow index has as many entries as the index, so it can never fill before the index does
+              auto overflowfile = llfio::file_handle::file(dir, "index.history", mode, llfio::file_handle::creation::always_new, caching, llfio::file_handle::flag::disable_prefetching).value();
+              llfio::file_handle::extent_type overflowsize = (hashtableentries) * sizeof(typename index::overflow_hash_index::value_type);
+              overflowfile.truncate(llfio::utils::round_up_to_page_size(overflowsize, llfio::utils::page_size())).value();
+            }
             index::index i;
             memset(&i, 0, sizeof(i));
             i.magic = _goodmagic;
             i.all_writes_synced = _indexfile.are_writes_durable();
             i.contents_hashed = enable_integrity;
+            i.hash_crc32c = (hash == integrity_hash::crc32c);
+            i.compact_layout = Layout::compact;
+            i.bloom_filter = enable_bloom_filter;
+            if(enable_bloom_filter)
+            {
+              _rebuild_bloom_filter(dir, caching, index::bloom_filter::bytes_for(hashtableentries), true);
+            }
+            i.ordered_index = enable_ordered_index;
+            if(enable_ordered_index)
+            {
+              _rebuild_ordered_index(dir, caching, index::ordered_index::bytes_for(hashtableentries), true);
+            }
             _indexfile.write(0, {{(llfio::byte *) &i, sizeof(i)}}).value();
           }
           else
@@ -304,8 +1356,19 @@ namespace key_value_store
             index::index i;
             _indexfile.read(0, {{(llfio::byte *) &i, sizeof(i)}}).value();
             memset(i.writes_occurring, 0, sizeof(i.writes_occurring));
+            memset(i.committing, 0, sizeof(i.committing));
+            // A writer which exited suddenly may have left a seqlock taken
+            memset(i.sequences, 0, sizeof(i.sequences));
             i.all_writes_synced = _indexfile.are_writes_durable();
             memset(&i.hash, 0, sizeof(i.hash));
+            if(i.bloom_filter)
+            {
+              _rebuild_bloom_filter(dir, caching, 0, false);
+            }
+            if(i.ordered_index)
+            {
+              _rebuild_ordered_index(dir, caching, 0, false);
+            }
             _indexfile.write(0, {{(llfio::byte *) &i, sizeof(i)}}).value();
           }
         }
@@ -330,8 +1393,10 @@ namespace key_value_store
       }
     }
     //! \overload
-    basic_key_value_store(const llfio::path_view &dir, size_t hashtableentries, bool enable_integrity = false, llfio::file_handle::mode mode = llfio::file_handle::mode::write, llfio::file_handle::caching caching = llfio::file_handle::caching::all)
-        : basic_key_value_store(llfio::directory_handle::directory({}, dir, llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value(), hashtableentries, enable_integrity, mode, caching)
+    basic_key_value_store(const llfio::path_view &dir, size_t hashtableentries, bool enable_integrity = false, llfio::file_handle::mode mode = llfio::file_handle::mode::write, llfio::file_handle::caching caching = llfio::file_handle::caching::all, integrity_hash hash = integrity_hash::spooky,
+                          bool enable_bloom_filter = false, bool enable_ordered_index = false)
+        : basic_key_value_store(llfio::directory_handle::directory({}, dir, llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value(), hashtableentries, enable_integrity, mode, caching, hash,
+                                enable_bloom_filter, enable_ordered_index)
     {
     }
     //! Opens the store for read only access
@@ -341,6 +1406,7 @@ namespace key_value_store
     }
     ~basic_key_value_store()
     {
+      stop_background_compaction();
       // Release my smallfile
       _smallfileguard.unlock();
       _mysmallfile.close().value();
@@ -366,17 +1432,224 @@ namespace key_value_store
     */
     void use_mmaps(size_t overextension = 1024ULL * 1024 * 1024)
     {
-      if(_mmap_over_extension != 0)
+      if(_mmap_over_extension != 0)
+        return;
+      _smallfiles.mapped.reserve(_smallfiles.blocking.size());
+      for(size_t n = 0; n < _smallfiles.blocking.size(); n++)
+      {
+        auto currentlength = _smallfiles.blocking[n].maximum_extent().value();
+        _smallfiles.mapped.push_back(llfio::mapped_file_handle(std::move(_smallfiles.blocking[n]), (unsigned)(currentlength + overextension)));
+      }
+      _smallfileguard.set_handle(&_smallfiles.mapped[_mysmallfileidx]);
+      _smallfiles.blocking.clear();
+      _mmap_over_extension = overextension;
+    }
+
+    /*! \brief Consolidates the free space in my smallfile, returning the bytes deallocated.
+
+    Values superseded beyond the value history, or deleted, are never reused by appends, so
+    update heavy workloads otherwise grow the smallfile without bound. This sweeps my smallfile
+    in 1Mb chunks, excepting the most recent chunk. If at least half of a chunk is no longer
+    referenced by any key's value history, the still referenced records are copied to the end
+    of my smallfile, the index repointed to the copies, and the chunk deallocated. Otherwise
+    only those whole pages of the chunk which nothing references are deallocated.
+
+    Readers may keep running, as each key is repointed under its exclusive lock and only
+    after that are the old copies deallocated. When using mmaps however, values previously
+    returned by `find()` which lay in a deallocated region will read as zeros, so do not
+    retain those across compaction. Does nothing if the store was opened read only.
+    */
+    llfio::file_handle::extent_type compact()
+    {
+      if(!_mysmallfile.is_valid())
+        return 0;
+      if(_indexheader->magic != _goodmagic)
+        throw corrupted_store();
+      std::lock_guard<decltype(_compactlock)> compactlockguard(_compactlock);
+      llfio::file_handle::extent_type end = 0, freed = 0;
+      {
+        std::lock_guard<decltype(_commitlock)> commitlockguard(_commitlock);
+        end = _mysmallfile.maximum_extent().value();
+      }
+      if(end < 64 + 2 * _compaction_chunk)
+        return 0;
+      end -= _compaction_chunk;
+
+      // Snapshot the records in my smallfile referenced by any key. Records unreferenced now
+      // can never become referenced again, so the snapshot can only overestimate what is live.
+      struct live_record
+      {
+        key_type key;
+        uint64_t transaction_counter;
+        llfio::file_handle::extent_type begin, end, newend;
+      };
+      std::vector<live_record> live;
+      auto snapshot = [&](const key_type &key, const index::value_history::item &h) {
+        if(h.transaction_counter != 0 && h.value_identifier == _mysmallfileidx && h.value_offset * 64 <= end + _compaction_chunk)
+        {
+          const llfio::file_handle::extent_type recend = h.value_offset * 64;
+          live.push_back({key, h.transaction_counter, recend - _pad_length(h.length), recend, 0});
+        }
+      };
+      for(const auto &i : *_index)
+      {
+        for(const auto &h : i.second.history)
+        {
+          snapshot(i.first, h);
+        }
+      }
+      if(_overflow)
+      {
+        for(const auto &i : *_overflow)
+        {
+          for(const auto &h : i.second.history)
+          {
+            snapshot(i.first, h);
+          }
+        }
+      }
+      std::sort(live.begin(), live.end(), [](const live_record &a, const live_record &b) { return a.begin < b.begin; });
+      live.erase(std::unique(live.begin(), live.end(), [](const live_record &a, const live_record &b) { return a.begin == b.begin; }), live.end());
+
+      const llfio::file_handle::extent_type pagesize = llfio::utils::page_size();
+      std::vector<llfio::byte> buffer;
+      std::vector<llfio::file_handle::const_buffer_type> reqs;
+      auto liveit = live.begin();
+      for(llfio::file_handle::extent_type from = 64; from < end;)
+      {
+        // Never split a record across chunks
+        llfio::file_handle::extent_type to = from + _compaction_chunk, livebytes = 0;
+        auto chunkbegin = liveit;
+        for(; liveit != live.end() && liveit->begin < to; ++liveit)
+        {
+          if(liveit->end > to)
+            to = liveit->end;
+          livebytes += liveit->end - liveit->begin;
+        }
+        auto chunkend = liveit;
+        if(2 * livebytes <= to - from)
+        {
+          // Copy still referenced records to the end of my smallfile
+          if(chunkbegin != chunkend)
+          {
+            buffer.resize(to - from);
+            std::lock_guard<decltype(_commitlock)> commitlockguard(_commitlock);
+            _mysmallfile.read(from, {{buffer.data(), buffer.size()}}).value();
+            llfio::file_handle::extent_type value_offset = _mysmallfile.maximum_extent().value();
+            reqs.clear();
+            for(auto it = chunkbegin; it != chunkend; ++it)
+            {
+              reqs.push_back({buffer.data() + (it->begin - from), it->end - it->begin});
+              value_offset += it->end - it->begin;
+              it->newend = value_offset;
+              // POSIX guarantees that at least 16 gather buffers can be written in a single shot
+              if(reqs.size() == 16)
+              {
+                _mysmallfile.write({reqs, 0}).value();
+                reqs.clear();
+              }
+            }
+            if(!reqs.empty())
+            {
+              _mysmallfile.write({reqs, 0}).value();
+            }
+          }
+          // Repoint the index to the copies, unless the key has been updated since
+          if(_indexheader->magic != _goodmagic)
+            throw corrupted_store();
+          _indexheader->writes_occurring[_mysmallfileidx].fetch_add(1);
+          for(auto it = chunkbegin; it != chunkend; ++it)
+          {
+            auto repoint = [&](index::value_history::item &h) {
+              if(h.transaction_counter == it->transaction_counter && h.value_identifier == _mysmallfileidx && h.value_offset * 64 == it->end)
+              {
+                h.value_offset = it->newend / 64;
+              }
+            };
+            // Lock the index entry then the overflow entry, the same order as commit
+            auto iit = _index->find_exclusive(it->key);
+            if(iit != _index->end())
+            {
+              // Readers without locks must reread the entry should its record be deallocated
+              auto &seq = _begin_modify(iit->first);
+              for(auto &h : iit->second.history)
+              {
+                repoint(h);
+              }
+              _end_modify(seq);
+              if(_overflow)
+              {
+                auto oit = _overflow->find_exclusive(it->key);
+                if(oit != _overflow->end())
+                {
+                  for(auto &h : oit->second.history)
+                  {
+                    repoint(h);
+                  }
+                }
+              }
+            }
+          }
+          _indexheader->writes_occurring[_mysmallfileidx].fetch_sub(1);
+          freed += _deallocate(from, to);
+        }
+        else
+        {
+          // Deallocate only whole pages between the still referenced records
+          llfio::file_handle::extent_type gapbegin = from;
+          for(auto it = chunkbegin;; ++it)
+          {
+            const llfio::file_handle::extent_type gapend = (it != chunkend) ? it->begin : to;
+            const llfio::file_handle::extent_type pagebegin = (gapbegin + pagesize - 1) & ~(pagesize - 1), pageend = gapend & ~(pagesize - 1);
+            if(pageend > pagebegin)
+            {
+              freed += _deallocate(pagebegin, pageend);
+            }
+            if(it == chunkend)
+              break;
+            gapbegin = it->end;
+          }
+        }
+        from = to;
+      }
+      return freed;
+    }
+
+    //! Calls `compact()` every `interval` from a background thread until destruction, or `stop_background_compaction()`.
+    void start_background_compaction(std::chrono::milliseconds interval = std::chrono::seconds(1))
+    {
+      if(_compactor.thread.joinable() || !_mysmallfile.is_valid())
+        return;
+      _compactor.stop = false;
+      _compactor.thread = std::thread([this, interval] {
+        std::unique_lock<std::mutex> g(_compactor.lock);
+        while(!_compactor.changed.wait_for(g, interval, [this] { return _compactor.stop; }))
+        {
+          g.unlock();
+          try
+          {
+            compact();
+          }
+          catch(...)
+          {
+            // The store is corrupted or the disc is full, neither of which compaction can fix
+            return;
+          }
+          g.lock();
+        }
+      });
+    }
+    //! Stops any background compaction, waiting for any compaction in progress to complete.
+    void stop_background_compaction()
+    {
+      if(!_compactor.thread.joinable())
         return;
-      _smallfiles.mapped.reserve(_smallfiles.blocking.size());
-      for(size_t n = 0; n < _smallfiles.blocking.size(); n++)
       {
-        auto currentlength = _smallfiles.blocking[n].maximum_extent().value();
-        _smallfiles.mapped.push_back(llfio::mapped_file_handle(std::move(_smallfiles.blocking[n]), (unsigned)(currentlength + overextension)));
+        std::lock_guard<std::mutex> g(_compactor.lock);
+        _compactor.stop = true;
       }
-      _smallfileguard.set_handle(&_smallfiles.mapped[_mysmallfileidx]);
-      _smallfiles.blocking.clear();
-      _mmap_over_extension = overextension;
+      _compactor.changed.notify_all();
+      _compactor.thread.join();
     }
 
     //! Retrieve when keys were last updated by setting the second to the latest transaction counter.
@@ -385,6 +1658,19 @@ namespace key_value_store
     {
       for(auto &key : keys)
       {
+        if(_bloom && !_bloom.may_contain(key.first))
+        {
+          key.second = (uint64_t) -1;
+          continue;
+        }
+        index::value_history::item item;
+        const std::atomic<uint32_t> *seq = nullptr;
+        uint32_t s = 0;
+        if(_read_unlocked(key.first, 0, item, seq, s))
+        {
+          key.second = item.transaction_counter;
+          continue;
+        }
         auto it = _index->find_shared(key.first);
         if(it == _index->end())
         {
@@ -392,15 +1678,75 @@ namespace key_value_store
         }
         else
         {
+          _remember_location(it->first);
           key.second = it->second.history[0].transaction_counter;
         }
       }
     }
+    //! True if the store keeps an ordered index of its keys, and so supports `keys_in_range()`.
+    bool has_ordered_index() const noexcept { return !!_ordered; }
+    /*! \brief Fill `keys` with the keys from `first` to `last` inclusive in ascending order, returning
+    those filled. May throw `corrupted_store`.
+
+    Keys are ordered numerically, with `as_longlongs[1]` the most significant half. Requires the store
+    to have been created with `enable_ordered_index`, and takes O(log n + k). A range with more keys
+    than fit in `keys` can be retrieved in pieces, by calling again with `first` one after the last
+    key returned.
+    */
+    span<key_type> keys_in_range(span<key_type> keys, key_type first, key_type last)
+    {
+      if(_indexheader->magic != _goodmagic)
+        throw corrupted_store();
+      if(!_ordered)
+        throw std::invalid_argument("store has no ordered index");
+      size_t done = 0;
+      bool more = true;
+      while(more && done < keys.size())
+      {
+        const auto fetched = _ordered.range(keys.subspan(done), first, last);
+        if(fetched.first == 0)
+        {
+          break;
+        }
+        more = fetched.second;
+        first = keys[done + fetched.first - 1];
+        // Keys are never removed from the ordered index, so drop any no longer in the index
+        for(size_t n = done, end = done + fetched.first; n < end; n++)
+        {
+          auto it = _index->find_shared(keys[n]);
+          if(it != _index->end() && it->second.history[0].transaction_counter != 0)
+          {
+            keys[done++] = keys[n];
+          }
+        }
+        // Resume after the last key fetched, unless that was the very last key possible
+        if(++first.as_longlongs[0] == 0 && ++first.as_longlongs[1] == 0)
+        {
+          break;
+        }
+      }
+      return keys.first(done);
+    }
+    //! Fill `keys` with the keys whose most significant `bits` match those of `prefix`, in ascending order, returning those filled.
+    span<key_type> keys_with_prefix(span<key_type> keys, key_type prefix, unsigned bits)
+    {
+      if(bits > 128)
+        throw std::invalid_argument("valid prefix bits is 0-128");
+      const uint64_t highmask = (bits >= 64) ? ~uint64_t(0) : (bits == 0) ? 0 : (~uint64_t(0) << (64 - bits));
+      const uint64_t lowmask = (bits <= 64) ? 0 : (~uint64_t(0) << (128 - bits));
+      key_type first(prefix), last(prefix);
+      first.as_longlongs[1] &= highmask;
+      first.as_longlongs[0] &= lowmask;
+      last.as_longlongs[1] |= ~highmask;
+      last.as_longlongs[0] |= ~lowmask;
+      return keys_in_range(keys, first, last);
+    }
+
     //! Information about a key value
     struct keyvalue_info
     {
       friend class basic_key_value_store;
-      friend class transaction;
+      template <class> friend class transaction;
       //! The key
       key_type key;
       //! The value
@@ -450,6 +1796,116 @@ namespace key_value_store
       }
       char *_value_buffer{nullptr};
     };
+  private:
+    // Returns where in my view of a mapped smallfile a record lies, updating the view if the smallfile has since grown
+    llfio::byte *_mapped_record(const index::value_history::item &item, size_t smallfilelength)
+    {
+      auto &mfh = _smallfiles.mapped[item.value_identifier];
+      auto mappedlength = mfh.maximum_extent().value();
+      if(item.value_offset * 64 > mappedlength)
+      {
+        // Update mapping to match the underlying file
+        mappedlength = mfh.update_map().value();
+        if(mappedlength > mfh.capacity())
+        {
+          // Need to remap into a new space
+          mappedlength = mfh.reserve(mappedlength + _mmap_over_extension).value();
+        }
+      }
+      return mfh.address() + item.value_offset * 64 - smallfilelength;
+    }
+    // True if a fetched record is what the index says it should be
+    bool _record_matches(key_type key, const index::value_history::item &item, llfio::byte *buffer, size_t smallfilelength)
+    {
+      const size_t length = item.length;
+      index::value_tail *vt = reinterpret_cast<index::value_tail *>(buffer + smallfilelength - sizeof(index::value_tail));
+      if(_indexheader->contents_hashed || _indexheader->key_is_hash_of_value)
+      {
+        uint128 tocheck = vt->hash;
+        memset(&vt->hash, 0, sizeof(vt->hash));
+        uint128 thishash = detail::record_hasher::hash(_indexheader->hash_crc32c, (char *) buffer, _indexheader->contents_hashed ? smallfilelength : length);
+        // Restore the hash so the record can be checked again if mapped
+        vt->hash = tocheck;
+        if(tocheck != thishash)
+        {
+          return false;
+        }
+      }
+      return vt->key == key && vt->length == length && vt->transaction_counter == item.transaction_counter;
+    }
+    // Throws `corrupted_store` if a fetched record is not what the index says it should be
+    void _check_record(key_type key, const index::value_history::item &item, llfio::byte *buffer, size_t smallfilelength)
+    {
+      if(!_record_matches(key, item, buffer, smallfilelength))
+      {
+        _indexheader->magic = _badmagic;
+        throw corrupted_store();
+      }
+    }
+    keyvalue_info _fetch(key_type key, const index::value_history::item &item) { return std::move(*_fetch(key, item, nullptr, 0)); }
+    /* As above, but if `item` was read from the index without locks, and the record is not what
+    it says, returns nothing if the seqlock `seq` has moved on from `s`. Compaction may have since
+    deallocated the record, so the index must be reread.
+    */
+    optional<keyvalue_info> _fetch(key_type key, const index::value_history::item &item, const std::atomic<uint32_t> *seq, uint32_t s)
+    {
+      // TODO Depending on length, make a mapped_span instead
+      size_t length = item.length, smallfilelength = _pad_length(length);
+      if(item.value_identifier >= _smallfiles.blocking.size() && item.value_identifier >= _smallfiles.mapped.size())
+      {
+        // TODO: Open newly created smallfiles
+        abort();
+      }
+      llfio::byte *buffer;
+      bool free_on_destruct = _smallfiles.mapped.empty();
+      if(!free_on_destruct)
+      {
+        buffer = _mapped_record(item, smallfilelength);
+      }
+      else
+      {
+        buffer = (llfio::byte *) malloc(smallfilelength);
+        if(!buffer)
+        {
+          throw std::bad_alloc();
+        }
+        _smallfiles.blocking[item.value_identifier].read(item.value_offset * 64 - smallfilelength, {{buffer, smallfilelength}}).value();
+      }
+      keyvalue_info ret(key, span<char>((char *) buffer, length), free_on_destruct, item.transaction_counter);
+      if(seq != nullptr && !_record_matches(key, item, buffer, smallfilelength) && seq->load(std::memory_order_acquire) != s)
+      {
+        return {};
+      }
+      _check_record(key, item, buffer, smallfilelength);
+      return optional<keyvalue_info>(std::move(ret));
+    }
+
+    // Publishes to committing[] the oldest of my transactions still committing. Call with _committing.lock held.
+    void _publish_committing() noexcept
+    {
+      uint64_t oldest = 0;
+      if(_committing.pending > 0)
+      {
+        oldest = (uint64_t) -1;
+      }
+      else
+      {
+        for(auto c : _committing.counters)
+        {
+          if(oldest == 0 || _not_newer(c, oldest))
+          {
+            oldest = c;
+          }
+        }
+      }
+      _indexheader->committing[_mysmallfileidx].store(oldest);
+    }
+    // The bottom 48 bits of transaction counters are the monotonic counter
+    static constexpr uint64_t _counter_mask = (uint64_t(1) << 48) - 1;
+    // True if transaction counter a is no later than b, allowing for the counter wrapping
+    static bool _not_newer(uint64_t a, uint64_t b) noexcept { return ((b - a) & _counter_mask) < (uint64_t(1) << 47); }
+
+  public:
     //! Retrieve the latest value for a key. May throw `corrupted_store`
     keyvalue_info find(key_type key, size_t revision = 0)
     {
@@ -457,6 +1913,30 @@ namespace key_value_store
         throw corrupted_store();
       if(revision >= 4)
         throw std::invalid_argument("valid revision is 0-3");
+      if(_bloom && !_bloom.may_contain(key))
+      {
+        // Definitely no key, so no need to probe the index
+        return keyvalue_info(key);
+      }
+      if(revision < _history_slots)
+      {
+        // Try reading the entry where the key was last found without taking its lock
+        index::value_history::item item;
+        const std::atomic<uint32_t> *seq = nullptr;
+        uint32_t s = 0;
+        if(_read_unlocked(key, revision, item, seq, s))
+        {
+          if(item.transaction_counter == 0)
+          {
+            return keyvalue_info(key);
+          }
+          auto ret = _fetch(key, item, seq, s);
+          if(ret)
+          {
+            return std::move(*ret);
+          }
+        }
+      }
       auto it = _index->find_shared(key);
       if(it == _index->end())
       {
@@ -465,90 +1945,273 @@ namespace key_value_store
       }
       else
       {
+        _remember_location(it->first);
+        // Older revisions of compact indices are in the overflow index
+        typename index::overflow_hash_index::const_iterator oit{};
+        if(revision >= _history_slots)
+        {
+          oit = _overflow->find_shared(key);
+          if(oit == _overflow->end())
+          {
+            return keyvalue_info(key);
+          }
+        }
         // TODO Depending on length, make a mapped_span instead
-        const auto &item = it->second.history[revision];
+        const auto &item = (revision < _history_slots) ? it->second.history[revision] : oit->second.history[revision - _history_slots];
         if(item.transaction_counter == 0)
         {
           // No value on the key at this revision
           return keyvalue_info(key);
         }
-        size_t length = item.length, smallfilelength = _pad_length(length);
-        if(item.value_identifier >= _smallfiles.blocking.size() && item.value_identifier >= _smallfiles.mapped.size())
+        return _fetch(key, item);
+      }
+    }
+    /*! Pins a snapshot of the store for `find_in_snapshot()`, as of the latest transaction. Waits for
+    any transactions still committing at or before then to finish, so the snapshot sees every
+    transaction it includes in full.
+    */
+    uint64_t snapshot() const noexcept
+    {
+      const uint64_t ret = _indexheader->transaction_counter.load() & _counter_mask;
+      for(auto &committing : _indexheader->committing)
+      {
+        for(uint64_t c = committing.load(); c != 0; c = committing.load())
         {
-          // TODO: Open newly created smallfiles
-          abort();
+          if(c != (uint64_t) -1 && !_not_newer(c, ret))
+          {
+            break;
+          }
+          std::this_thread::yield();
+        }
+      }
+      return ret;
+    }
+    /*! \brief Retrieve the value of a key as it was at a `snapshot()`. May throw `corrupted_store` or `snapshot_expired`.
+
+    The newest revision of the value committed no later than the snapshot is returned, so long
+    reads of a snapshot see a consistent store without taking locks for longer than each read,
+    nor blocking writers. Only the four most recent revisions of each value are kept, if all of
+    them are newer than the snapshot `snapshot_expired` is thrown, and the reader should pin a newer
+    snapshot. A key whose four most recent revisions are all removals is forgotten altogether, and
+    so reads as absent.
+    */
+    keyvalue_info find_in_snapshot(key_type key, uint64_t as_of)
+    {
+      if(_indexheader->magic != _goodmagic)
+        throw corrupted_store();
+      if(_bloom && !_bloom.may_contain(key))
+      {
+        return keyvalue_info(key);
+      }
+      auto it = _index->find_shared(key);
+      if(it == _index->end())
+      {
+        return keyvalue_info(key);
+      }
+      typename index::overflow_hash_index::const_iterator oit{};
+      for(size_t revision = 0; revision < 4; revision++)
+      {
+        if(revision == _history_slots)
+        {
+          oit = _overflow->find_shared(key);
+          if(oit == _overflow->end())
+          {
+            // Never updated, so there are no older revisions
+            return keyvalue_info(key);
+          }
+        }
+        const auto &item = (revision < _history_slots) ? it->second.history[revision] : oit->second.history[revision - _history_slots];
+        // Removals keep when they happened in length
+        const uint64_t when = (item.transaction_counter != 0) ? item.transaction_counter : item.length;
+        if(when == 0)
+        {
+          // No older revisions, so the key did not exist at the snapshot
+          return keyvalue_info(key);
+        }
+        if(_not_newer(when, as_of))
+        {
+          return (item.transaction_counter != 0) ? _fetch(key, item) : keyvalue_info(key);
         }
+      }
+      throw snapshot_expired(key);
+    }
+    /*! \brief Retrieve the latest values for many keys at once, in the same order as `keys`. May throw `corrupted_store`
+
+    Rather than probing and fetching key by key, all the keys are probed first and their
+    values then fetched in smallfile and offset order. Without mmaps, values adjacent or
+    near to one another in a smallfile are fetched with a single scatter read. With mmaps,
+    all the values are prefetched in a single batch before being checked.
+    */
+    std::vector<keyvalue_info> find(span<const key_type> keys, size_t revision = 0)
+    {
+      if(_indexheader->magic != _goodmagic)
+        throw corrupted_store();
+      if(revision >= 4)
+        throw std::invalid_argument("valid revision is 0-3");
+      std::vector<keyvalue_info> ret;
+      ret.reserve(keys.size());
+      for(const auto &key : keys)
+      {
+        ret.push_back(keyvalue_info(key));
+      }
+      // Probe in key order, the same order in which commit takes its exclusive locks, keeping the
+      // shared locks until fetched. Repeated keys are probed once, as shared locks may not recurse.
+      std::vector<size_t> order(keys.size());
+      for(size_t n = 0; n < order.size(); n++)
+      {
+        order[n] = n;
+      }
+      std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+      struct fetch_type
+      {
+        size_t idx;  // into keys
+        index::value_history::item item;
+        size_t smallfilelength;
+        llfio::file_handle::extent_type offset;  // of the start of the record
         llfio::byte *buffer;
-        bool free_on_destruct = _smallfiles.mapped.empty();
-        if(!free_on_destruct)
+      };
+      std::vector<fetch_type> fetches;
+      fetches.reserve(keys.size());
+      std::vector<typename open_hash_index::const_iterator> shared_locks;
+      std::vector<typename index::overflow_hash_index::const_iterator> overflow_shared_locks;
+      shared_locks.reserve(keys.size());
+      const index::value_history::item *item = nullptr;
+      for(size_t n = 0; n < order.size(); n++)
+      {
+        const size_t idx = order[n];
+        if(n == 0 || keys[order[n - 1]] != keys[idx])
         {
-          auto mappedlength = _smallfiles.mapped[item.value_identifier].maximum_extent().value();
-          if(item.value_offset * 64 > mappedlength)
+          item = nullptr;
+          if(_bloom && !_bloom.may_contain(keys[idx]))
           {
-            // Update mapping to match the underlying file
-            mappedlength = _smallfiles.mapped[item.value_identifier].update_map().value();
-            if(mappedlength > _smallfiles.mapped[item.value_identifier].capacity())
+            // Definitely no key, so no need to probe the index
+            continue;
+          }
+          auto it = _index->find_shared(keys[idx]);
+          if(it != _index->end())
+          {
+            if(revision < _history_slots)
+            {
+              item = &it->second.history[revision];
+            }
+            else
             {
-              // Need to remap into a new space
-              mappedlength = _smallfiles.mapped[item.value_identifier].reserve(mappedlength + _mmap_over_extension).value();
+              // Older revisions of compact indices are in the overflow index
+              auto oit = _overflow->find_shared(keys[idx]);
+              if(oit != _overflow->end())
+              {
+                item = &oit->second.history[revision - _history_slots];
+                overflow_shared_locks.push_back(std::move(oit));
+              }
             }
+            shared_locks.push_back(std::move(it));
           }
-          buffer = _smallfiles.mapped[item.value_identifier].address() + item.value_offset * 64 - smallfilelength;
         }
-        else
+        if(item == nullptr || item->transaction_counter == 0)
         {
-          buffer = (llfio::byte *) malloc(smallfilelength);
-          if(!buffer)
-          {
-            throw std::bad_alloc();
-          }
-          _smallfiles.blocking[item.value_identifier].read(item.value_offset * 64 - smallfilelength, {{buffer, smallfilelength}}).value();
+          // No value on the key at this revision
+          continue;
         }
-        index::value_tail *vt = reinterpret_cast<index::value_tail *>(buffer + smallfilelength - sizeof(index::value_tail));
-        if(_indexheader->contents_hashed || _indexheader->key_is_hash_of_value)
+        if(item->value_identifier >= _smallfiles.blocking.size() && item->value_identifier >= _smallfiles.mapped.size())
         {
-          QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash hasher;
-          uint128 tocheck = vt->hash;
-          memset(&vt->hash, 0, sizeof(vt->hash));
-          uint128 thishash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash((char *) buffer, _indexheader->contents_hashed ? smallfilelength : length);
-          if(tocheck != thishash)
-          {
-            _indexheader->magic = _badmagic;
-            throw corrupted_store();
-          }
+          // TODO: Open newly created smallfiles
+          abort();
         }
-        if(vt->key != key)
+        const size_t smallfilelength = _pad_length(item->length);
+        fetches.push_back({idx, *item, smallfilelength, item->value_offset * 64 - smallfilelength, nullptr});
+      }
+      std::sort(fetches.begin(), fetches.end(), [](const fetch_type &a, const fetch_type &b) {
+        return (a.item.value_identifier < b.item.value_identifier) || (a.item.value_identifier == b.item.value_identifier && a.offset < b.offset);
+      });
+
+      const bool free_on_destruct = _smallfiles.mapped.empty();
+      for(auto &f : fetches)
+      {
+        if(!free_on_destruct)
         {
-          _indexheader->magic = _badmagic;
-          throw corrupted_store();
+          f.buffer = _mapped_record(f.item, f.smallfilelength);
         }
-        if(vt->length != length)
+        else
         {
-          _indexheader->magic = _badmagic;
-          throw corrupted_store();
+          f.buffer = (llfio::byte *) malloc(f.smallfilelength);
+          if(!f.buffer)
+          {
+            throw std::bad_alloc();
+          }
         }
-        if(vt->transaction_counter != item.transaction_counter)
+        ret[f.idx] = keyvalue_info(keys[f.idx], span<char>((char *) f.buffer, f.item.length), free_on_destruct, f.item.transaction_counter);
+      }
+      if(!free_on_destruct)
+      {
+        std::vector<llfio::map_handle::buffer_type> regions;
+        regions.reserve(fetches.size());
+        for(const auto &f : fetches)
         {
-          _indexheader->magic = _badmagic;
-          throw corrupted_store();
+          regions.push_back({f.buffer, f.smallfilelength});
+        }
+        // Prefetching is advisory only
+        (void) llfio::map_handle::prefetch(regions);
+      }
+      else
+      {
+        // Read runs of records separated by at most max_gap bytes with a single scatter read,
+        // reading the gaps into a scratch buffer
+        static constexpr size_t max_gap = 4096;
+        std::vector<llfio::byte> gapbuffer(max_gap);
+        std::vector<llfio::file_handle::buffer_type> reqs;
+        for(size_t n = 0; n < fetches.size();)
+        {
+          const fetch_type &first = fetches[n];
+          auto &fh = _smallfiles.blocking[first.item.value_identifier];
+          // POSIX guarantees that at least 16 scatter buffers can be read in a single shot
+          const size_t maxbuffers = std::max<size_t>(fh.max_buffers(), 16);
+          llfio::file_handle::extent_type runend = first.offset + first.smallfilelength;
+          reqs.clear();
+          reqs.push_back({first.buffer, first.smallfilelength});
+          size_t m = n + 1;
+          for(; m < fetches.size() && reqs.size() + 2 <= maxbuffers; m++)
+          {
+            const fetch_type &next = fetches[m];
+            if(next.item.value_identifier != first.item.value_identifier || next.offset < runend || next.offset - runend > max_gap)
+            {
+              break;
+            }
+            if(next.offset > runend)
+            {
+              reqs.push_back({gapbuffer.data(), (size_t)(next.offset - runend)});
+            }
+            reqs.push_back({next.buffer, next.smallfilelength});
+            runend = next.offset + next.smallfilelength;
+          }
+          fh.read({reqs, first.offset}).value();
+          n = m;
         }
-        return keyvalue_info(key, span<char>((char *) buffer, length), free_on_destruct, item.transaction_counter);
       }
+      for(const auto &f : fetches)
+      {
+        _check_record(keys[f.idx], f.item, f.buffer, f.smallfilelength);
+      }
+      return ret;
     }
   };
 
   /*! A transaction object.
   */
-  class transaction
+  template <class Layout> class transaction
   {
-    friend class basic_key_value_store;
-    basic_key_value_store *_parent;
+    using store_type = basic_key_value_store<Layout>;
+    using open_hash_index = typename Layout::open_hash_index;
+    using value_history = typename Layout::value_history;
+    using keyvalue_info = typename store_type::keyvalue_info;
+    static constexpr size_t _history_slots = store_type::_history_slots;
+    friend store_type;
+    store_type *_parent;
     struct _item
     {
-      basic_key_value_store::keyvalue_info kvi;   // the item's value when fetched
+      keyvalue_info kvi;   // the item's value when fetched
       llfio::optional<span<const char>> towrite;  // the value to be written on commit
       bool remove;                                // true if to remove
-      _item(basic_key_value_store::keyvalue_info &&_kvi)
+      _item(keyvalue_info &&_kvi)
           : kvi(std::move(_kvi))
           , remove(false)
       {
@@ -558,7 +2221,7 @@ namespace key_value_store
 
   public:
     //! Start a new transaction
-    explicit transaction(basic_key_value_store &parent)
+    explicit transaction(store_type &parent)
         : _parent(&parent)
     {
     }
@@ -628,7 +2291,7 @@ namespace key_value_store
       {
         throw transaction_limit_reached();
       }
-      basic_key_value_store::keyvalue_info kvi(key);
+      keyvalue_info kvi(key);
       _items.push_back(std::move(kvi));
       _items.back().towrite = towrite;
     }
@@ -648,7 +2311,7 @@ namespace key_value_store
       {
         throw transaction_limit_reached();
       }
-      basic_key_value_store::keyvalue_info kvi(key);
+      keyvalue_info kvi(key);
       _items.push_back(std::move(kvi));
       _items.back().remove = true;
     }
@@ -671,7 +2334,9 @@ namespace key_value_store
         const uint64_t old_transaction_counter;
         const bool insertion, update, removal;
         index::value_history::item history_item{};
-        index::open_hash_index::iterator it{};
+        typename open_hash_index::iterator it{};
+        typename index::overflow_hash_index::iterator overflow_it{};  // compact layout only
+        bool has_overflow{false};
         toupdate_type(key_type _key, uint64_t _old_transaction_counter, bool _insertion, bool _update, bool _removal)
             : key(_key)
             , old_transaction_counter(_old_transaction_counter)
@@ -683,11 +2348,11 @@ namespace key_value_store
       };
       std::vector<toupdate_type> toupdate;
       toupdate.reserve(_items.size());
-      // Serialise multiple threads issuing commit using the same store
-      std::lock_guard<decltype(_parent->_commitlock)> commitlockguard(_parent->_commitlock);
+      // Only the appends to my smallfile are serialised between threads issuing commit using the
+      // same store, and those are batched together by group commit.
 
       // Take out shared locks on all the items in my commit with existing values, early checking if we will abort
-      std::vector<index::open_hash_index::const_iterator> shared_locks;
+      std::vector<typename open_hash_index::const_iterator> shared_locks;
       shared_locks.reserve(_items.size());
       for(const auto &item : _items)
       {
@@ -714,6 +2379,12 @@ namespace key_value_store
         assert(insertion + update + removal == 1);
         toupdate.emplace_back(item.kvi.key, item.kvi.transaction_counter, insertion, update, removal);
       }
+      // Until snapshots can see which transaction counter I take, they must wait for me
+      {
+        std::lock_guard<decltype(_parent->_committing.lock)> g(_parent->_committing.lock);
+        _parent->_committing.pending++;
+        _parent->_publish_committing();
+      }
       // Atomically increment the transaction counter to set this latest transaction
       uint64_t this_transaction_counter = 0;
       {
@@ -735,142 +2406,77 @@ namespace key_value_store
         } while(!_parent->_indexheader->transaction_counter.compare_exchange_weak(old_transaction_counter, _.this_transaction_counter, std::memory_order_release, std::memory_order_relaxed));
         this_transaction_counter = _.this_transaction_counter;
       }
+      {
+        std::lock_guard<decltype(_parent->_committing.lock)> g(_parent->_committing.lock);
+        _parent->_committing.pending--;
+        _parent->_committing.counters.push_back(this_transaction_counter);
+        _parent->_publish_committing();
+      }
+      // However this commit ends, snapshots no longer need wait for it
+      auto endcommitting = make_scope_exit([this, this_transaction_counter]() noexcept {
+        std::lock_guard<decltype(_parent->_committing.lock)> g(_parent->_committing.lock);
+        auto &counters = _parent->_committing.counters;
+        counters.erase(std::find(counters.begin(), counters.end(), this_transaction_counter));
+        _parent->_publish_committing();
+      });
 
-      bool items_written = false;
-      if(!_parent->_smallfiles.mapped.empty())
+      // Prepare my value records for appending to my smallfile by the group commit leader
+      typename store_type::_pending_append pending;
+      pending.tails.resize(_items.size());
+      pending.records.reserve(_items.size());
+      pending.reqs.reserve(2 * _items.size());
+      for(size_t n = 0; n < _items.size(); n++)
       {
-        llfio::file_handle::extent_type original_length = _parent->_mysmallfile.maximum_extent().value();
-        // How big does this map need to be?
-        size_t totalcommitsize = 0;
-        for(size_t n = 0; n < _items.size(); n++)
-        {
-          toupdate_type &thisupdate = toupdate[n];
-          const transaction::_item &item = _items[n];
-          totalcommitsize += thisupdate.removal ? 64 : _parent->_pad_length(item.towrite->size());
-        }
-        if(totalcommitsize >= 4096)
+        llfio::byte *tailbuffer = pending.tails[n].data();
+        memset(tailbuffer, 0, 128);
+        index::value_tail *vt = reinterpret_cast<index::value_tail *>(tailbuffer + 128 - sizeof(index::value_tail));
+        toupdate_type &thisupdate = toupdate[n];
+        const transaction::_item &item = _items[n];
+        vt->key = thisupdate.key;
+        vt->transaction_counter = this_transaction_counter;
+        size_t totalwrite = 0;
+        if(thisupdate.removal)
         {
-          auto &mfh = _parent->_smallfiles.mapped[_parent->_mysmallfileidx];
-          llfio::file_handle::extent_type new_length = original_length + totalcommitsize;
-          if(new_length > mfh.capacity())
-          {
-            mfh.reserve(new_length + _parent->_mmap_over_extension).value();
-          }
-          mfh.truncate(new_length).value();
-          llfio::byte *value = mfh.address() + original_length;
-          llfio::file_handle::extent_type value_offset = original_length;
-          for(size_t n = 0; n < _items.size(); n++)
+          vt->length = (uint64_t) -1;  // this key is being deleted
+          totalwrite = 64;
+          pending.reqs.push_back({tailbuffer + 64, 64});
+          if(_parent->_indexheader->contents_hashed)
           {
-            toupdate_type &thisupdate = toupdate[n];
-            const transaction::_item &item = _items[n];
-            size_t totalwrite = 0;
-            if(thisupdate.removal)
-            {
-              totalwrite = 64;
-            }
-            else
-            {
-              memcpy(value, item.towrite->data(), item.towrite->size());
-              totalwrite = _parent->_pad_length(item.towrite->size());
-            }
-            index::value_tail *vt = reinterpret_cast<index::value_tail *>(value + totalwrite - sizeof(index::value_tail));
-            vt->key = thisupdate.key;
-            vt->transaction_counter = this_transaction_counter;
-            if(thisupdate.removal)
-            {
-              vt->length = (uint64_t) -1;  // this key is being deleted
-              memset(&thisupdate.history_item, 0, sizeof(thisupdate.history_item));
-            }
-            else
-            {
-              vt->length = item.towrite->size();
-              index::value_history::item &history_item = thisupdate.history_item;
-              history_item.transaction_counter = this_transaction_counter;
-              history_item.value_offset = (value_offset + totalwrite) / 64;
-              history_item.value_identifier = _parent->_mysmallfileidx;
-              history_item.length = vt->length;
-            }
-            if(_parent->_indexheader->contents_hashed)
-            {
-              vt->hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash((char *) value, totalwrite);
-            }
-            value += totalwrite;
-            value_offset += totalwrite;
+            detail::record_hasher hasher(_parent->_indexheader->hash_crc32c);
+            hasher.add((const char *) pending.reqs.back().data(), pending.reqs.back().size());
+            vt->hash = hasher.finalise();
           }
-          items_written = true;
+          memset(&thisupdate.history_item, 0, sizeof(thisupdate.history_item));
+          thisupdate.history_item.length = this_transaction_counter;  // for snapshot reads
+          pending.records.push_back({1, totalwrite, nullptr});
         }
-      }
-      if(!items_written)
-      {
-        // Gather append write all my items to my smallfile
-        llfio::file_handle::extent_type value_offset = _parent->_mysmallfile.maximum_extent().value();
-        assert((value_offset % 64) == 0);
-        // POSIX guarantees that at least 16 gather buffers can be written in a single shot
-        std::vector<llfio::file_handle::const_buffer_type> reqs;
-        reqs.reserve(16);
-        // With tails, that's eight items per syscall
-        llfio::byte tailbuffers[8][128];
-        memset(tailbuffers, 0, sizeof(tailbuffers));
-        for(size_t n = 0; n < _items.size(); n++)
-        {
-          llfio::byte *tailbuffer = tailbuffers[n % 8];
-          index::value_tail *vt = reinterpret_cast<index::value_tail *>(tailbuffer + 128 - sizeof(index::value_tail));
-          toupdate_type &thisupdate = toupdate[n];
-          const transaction::_item &item = _items[n];
-          vt->key = thisupdate.key;
-          vt->transaction_counter = this_transaction_counter;
-          size_t totalwrite = 0;
-          if(thisupdate.removal)
-          {
-            vt->length = (uint64_t) -1;  // this key is being deleted
-            totalwrite = 64;
-            reqs.push_back({tailbuffer + 64, 64});
-            if(_parent->_indexheader->contents_hashed)
-            {
-              QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash hasher;
-              memset(&vt->hash, 0, sizeof(vt->hash));
-              hasher.add((const char *) reqs.back().data(), reqs.back().size());
-              vt->hash = hasher.finalise();
-            }
-            memset(&thisupdate.history_item, 0, sizeof(thisupdate.history_item));
-          }
-          else
-          {
-            vt->length = item.towrite->size();
-            totalwrite = _parent->_pad_length(item.towrite->size());
-            size_t tailbytes = totalwrite - item.towrite->size();
-            assert(tailbytes < 128);
-            reqs.push_back({(llfio::byte *) item.towrite->data(), item.towrite->size()});
-            reqs.push_back({tailbuffer + 128 - tailbytes, tailbytes});
-            if(_parent->_indexheader->contents_hashed)
-            {
-              QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash hasher;
-              memset(&vt->hash, 0, sizeof(vt->hash));
-              auto rit = reqs.end();
-              rit -= 2;
-              hasher.add((char *) rit->data(), rit->size());
-              ++rit;
-              hasher.add((char *) rit->data(), rit->size());
-              vt->hash = hasher.finalise();
-            }
-            index::value_history::item &history_item = thisupdate.history_item;
-            history_item.transaction_counter = this_transaction_counter;
-            history_item.value_offset = (value_offset + totalwrite) / 64;
-            history_item.value_identifier = _parent->_mysmallfileidx;
-            history_item.length = vt->length;
-          }
-          value_offset += totalwrite;
-          if((n % 8) == 7)
+        else
+        {
+          vt->length = item.towrite->size();
+          totalwrite = _parent->_pad_length(item.towrite->size());
+          size_t tailbytes = totalwrite - item.towrite->size();
+          assert(tailbytes < 128);
+          pending.reqs.push_back({(const llfio::byte *) item.towrite->data(), item.towrite->size()});
+          pending.reqs.push_back({tailbuffer + 128 - tailbytes, tailbytes});
+          if(_parent->_indexheader->contents_hashed)
           {
-            _parent->_mysmallfile.write({reqs, 0}).value();
-            reqs.clear();
+            detail::record_hasher hasher(_parent->_indexheader->hash_crc32c);
+            auto rit = pending.reqs.end();
+            rit -= 2;
+            hasher.add((const char *) rit->data(), rit->size());
+            ++rit;
+            hasher.add((const char *) rit->data(), rit->size());
+            vt->hash = hasher.finalise();
           }
+          index::value_history::item &history_item = thisupdate.history_item;
+          history_item.transaction_counter = this_transaction_counter;
+          history_item.length = vt->length;
+          pending.records.push_back({2, totalwrite, &history_item});
         }
-        if(!reqs.empty())
-        {
-          _parent->_mysmallfile.write({reqs, 0}).value();
-        }
+        pending.bytes += totalwrite;
       }
+      // Blocks until some leader, possibly me, has appended my records along with any others pending
+      _parent->_group_append(pending);
 
       // Release all the shared locks on the existing items we are about to update
       shared_locks.clear();
@@ -883,7 +2489,9 @@ namespace key_value_store
         {
           if(updit->insertion && updit->it != _parent->_index->end())
           {
-            _parent->_index->erase(std::move(updit->it));
+            auto &seq = _parent->_begin_modify(updit->it->first);
+            _parent->_erase(std::move(updit->it));
+            store_type::_end_modify(seq);
           }
         }
       });
@@ -907,8 +2515,18 @@ namespace key_value_store
             throw transaction_aborted(item.key);
           }
           // Insert a new key with empty history
-          index::value_history vh;
+          value_history vh;
           memset(&vh, 0, sizeof(vh));
+          // Set the key's bits before it can be found, an abort leaves only a harmless false positive
+          if(_parent->_bloom)
+          {
+            _parent->_bloom.insert(item.key);
+          }
+          // Likewise the ordered index, as range scans check every key they find against the index
+          if(_parent->_ordered)
+          {
+            _parent->_ordered.insert(item.key);
+          }
           it = _parent->_index->insert({item.key, std::move(vh)}).first;
           if(it == _parent->_index->end())
           {
@@ -917,6 +2535,25 @@ namespace key_value_store
         }
         // Store the exclusive lock away for later
         item.it = std::move(it);
+        // Compact indices keep the older revisions in the overflow index, whose entry is always
+        // locked straight after the index entry. Should we abort, an empty overflow entry for an
+        // existing key is harmless.
+        if(Layout::compact && !item.insertion)
+        {
+          auto oit = _parent->_overflow->find_exclusive(item.key);
+          if(oit == _parent->_overflow->end())
+          {
+            index::overflow_value_history ovh;
+            memset(&ovh, 0, sizeof(ovh));
+            oit = _parent->_overflow->insert({item.key, std::move(ovh)}).first;
+            if(oit == _parent->_overflow->end())
+            {
+              throw index_full();
+            }
+          }
+          item.overflow_it = std::move(oit);
+          item.has_overflow = true;
+        }
       }
 
       if(_parent->_indexheader->magic != _parent->_goodmagic)
@@ -928,8 +2565,16 @@ namespace key_value_store
       _parent->_indexheader->writes_occurring[_parent->_mysmallfileidx].fetch_add(1);
       for(auto &item : toupdate)
       {
-        // Update existing value's latest revision
-        index::value_history &value = item.it->second;
+        // Update existing value's latest revision, within its seqlock so readers without locks see all or none of it
+        auto &seq = _parent->_begin_modify(item.it->first);
+        value_history &value = item.it->second;
+        if(item.has_overflow)
+        {
+          // The oldest revision in the index moves into the overflow index
+          index::overflow_value_history &older = item.overflow_it->second;
+          memmove(older.history + 1, older.history, sizeof(older.history) - sizeof(older.history[0]));
+          older.history[0] = value.history[_history_slots - 1];
+        }
         memmove(value.history + 1, value.history, sizeof(value.history) - sizeof(value.history[0]));
         value.history[0] = item.history_item;
         if(item.removal)
@@ -943,11 +2588,27 @@ namespace key_value_store
               break;
             }
           }
+          if(alldeleted && item.has_overflow)
+          {
+            for(const auto &h : item.overflow_it->second.history)
+            {
+              if(h.transaction_counter != 0)
+              {
+                alldeleted = false;
+                break;
+              }
+            }
+          }
           if(alldeleted)
           {
-            _parent->_index->erase(std::move(item.it));
+            if(item.has_overflow)
+            {
+              _parent->_overflow->erase(std::move(item.overflow_it));
+            }
+            _parent->_erase(std::move(item.it));
           }
         }
+        store_type::_end_modify(seq);
       }
       _parent->_indexheader->writes_occurring[_parent->_mysmallfileidx].fetch_sub(1);
     }
@@ -24,7 +24,11 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "include/key_value_store.hpp"
 
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
 
 namespace stackoverflow
 {
@@ -89,7 +93,7 @@ namespace stackoverflow
   }
 }  // namespace stackoverflow
 
-void benchmark(key_value_store::basic_key_value_store &store, const char *desc)
+template <class Layout> void benchmark(key_value_store::basic_key_value_store<Layout> &store, const char *desc)
 {
   std::cout << "\n" << desc << ":" << std::endl;
   // Write 1M values and see how long it takes
@@ -108,7 +112,7 @@ void benchmark(key_value_store::basic_key_value_store &store, const char *desc)
     auto begin = std::chrono::high_resolution_clock::now();
     for(size_t n = 0; n < values.size(); n += 1024)
     {
-      key_value_store::transaction tr(store);
+      key_value_store::transaction<Layout> tr(store);
       for(size_t m = 0; m < 1024; m++)
       {
         if(n + m >= values.size())
@@ -141,23 +145,596 @@ void benchmark(key_value_store::basic_key_value_store &store, const char *desc)
     auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
     std::cout << "  Fetched at " << (1000000000ULL / diff) << " items per sec" << std::endl;
   }
+  std::cout << "  Retrieving 1M key-value pairs in batches of 1000 ..." << std::endl;
+  {
+    std::vector<key_value_store::key_type> keys;
+    keys.reserve(1000);
+    auto begin = std::chrono::high_resolution_clock::now();
+    for(size_t n = 0; n < values.size(); n += 1000)
+    {
+      keys.clear();
+      for(size_t m = n; m < n + 1000 && m < values.size(); m++)
+      {
+        keys.push_back(values[m].first);
+      }
+      for(auto &kvi : store.find(keys))
+      {
+        if(!kvi)
+          abort();
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+    std::cout << "  Fetched at " << (1000000000ULL / diff) << " items per sec" << std::endl;
+  }
+  std::cout << "  Looking up 1M absent keys ..." << std::endl;
+  {
+    auto begin = std::chrono::high_resolution_clock::now();
+    for(auto &i : values)
+    {
+      if(store.find(i.first + 100000000))
+        abort();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+    std::cout << "  Looked up at " << (1000000000ULL / diff) << " items per sec" << std::endl;
+  }
 }
 
-int main()
+/* YCSB style workloads, run as `key-value-store ycsb <A|B|C|F> <mmaps|blocking> <integrity|nointegrity> <processes>`.
+
+The store is loaded with YCSB_RECORDS keys of between 100 and 4000 bytes, then that many processes
+each run the workload for YCSB_DURATION seconds, choosing keys with a scrambled Zipfian distribution.
+Each process writes a latency histogram for each kind of operation, which are merged and reported.
+*/
+namespace ycsb
+{
+  static constexpr uint64_t YCSB_RECORDS = 100000;
+  static constexpr int YCSB_DURATION = 10;
+  static constexpr size_t YCSB_MIN_VALUE = 100, YCSB_MAX_VALUE = 4000;
+  static const char *const storepath = "ycsbstore";
+
+  struct workload
+  {
+    char name;
+    unsigned read_percent, update_percent, rmw_percent;
+  };
+  static constexpr workload workloads[] = {
+  {'A', 50, 50, 0},   // update heavy
+  {'B', 95, 5, 0},    // read mostly
+  {'C', 100, 0, 0},   // read only
+  {'F', 50, 0, 50}};  // read-modify-write
+  enum op_kind
+  {
+    op_read,
+    op_update,
+    op_rmw,
+    op_kinds
+  };
+  static const char *const op_names[op_kinds] = {"read", "update", "read-modify-write"};
+
+  // From Gray et al, "Quickly generating billion-record synthetic databases", as used by YCSB
+  class zipfian
+  {
+    uint64_t _items;
+    double _theta, _zetan, _alpha, _eta;
+    static double _zeta(uint64_t n, double theta)
+    {
+      double sum = 0;
+      for(uint64_t i = 1; i <= n; i++)
+      {
+        sum += 1.0 / pow((double) i, theta);
+      }
+      return sum;
+    }
+
+  public:
+    explicit zipfian(uint64_t items, double theta = 0.99)
+        : _items(items)
+        , _theta(theta)
+        , _zetan(_zeta(items, theta))
+        , _alpha(1.0 / (1.0 - theta))
+        , _eta((1.0 - pow(2.0 / (double) items, 1.0 - theta)) / (1.0 - _zeta(2, theta) / _zetan))
+    {
+    }
+    //! Returns a rank, zero being the most popular
+    uint64_t operator()(std::mt19937_64 &rand) const
+    {
+      const double u = (double) (rand() >> 11) * (1.0 / 9007199254740992.0);
+      const double uz = u * _zetan;
+      if(uz < 1.0)
+      {
+        return 0;
+      }
+      if(uz < 1.0 + pow(0.5, _theta))
+      {
+        return 1;
+      }
+      return std::min(_items - 1, (uint64_t) ((double) _items * pow(_eta * u - _eta + 1.0, _alpha)));
+    }
+  };
+  // Scatters the popular ranks across the key space, as YCSB does
+  inline uint64_t key_for_rank(uint64_t rank)
+  {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(int n = 0; n < 8; n++)
+    {
+      h = (h ^ ((rank >> (n * 8)) & 0xff)) * 0x100000001b3ULL;
+    }
+    return 1 + (h % YCSB_RECORDS);
+  }
+
+  // Sixteen linear buckets per power of two nanoseconds, so percentiles are within about 6%
+  struct latency_histogram
+  {
+    static constexpr size_t buckets = 61 * 16;
+    std::vector<uint64_t> counts = std::vector<uint64_t>(buckets);
+
+    static size_t bucket(uint64_t ns)
+    {
+      if(ns < 16)
+      {
+        return (size_t) ns;
+      }
+      unsigned msb = 0;
+      for(uint64_t v = ns; v >>= 1;)
+      {
+        msb++;
+      }
+      return (msb - 3) * 16 + (size_t) ((ns >> (msb - 4)) & 15);
+    }
+    static uint64_t lower_bound(size_t b)
+    {
+      if(b < 16)
+      {
+        return b;
+      }
+      const unsigned msb = (unsigned) (b / 16) + 3;
+      return (16 + (b % 16)) << (msb - 4);
+    }
+    void add(uint64_t ns) { counts[bucket(ns)]++; }
+    uint64_t total() const
+    {
+      uint64_t ret = 0;
+      for(auto c : counts)
+      {
+        ret += c;
+      }
+      return ret;
+    }
+    uint64_t percentile(double p) const
+    {
+      const uint64_t target = (uint64_t) ceil(p * (double) total());
+      uint64_t sofar = 0;
+      for(size_t b = 0; b < buckets; b++)
+      {
+        sofar += counts[b];
+        if(sofar >= target && sofar > 0)
+        {
+          return lower_bound(b);
+        }
+      }
+      return 0;
+    }
+  };
+
+  inline std::string value_of(std::mt19937_64 &rand)
+  {
+    return std::string(YCSB_MIN_VALUE + rand() % (YCSB_MAX_VALUE - YCSB_MIN_VALUE + 1), (char) ('a' + rand() % 26));
+  }
+
+  inline std::string worker_histogram_path(unsigned idx) { return "ycsb_worker" + std::to_string(idx) + ".txt"; }
+
+  inline int worker(int argc, char *argv[])
+  {
+    if(argc < 4)
+    {
+      std::cerr << "ycsb-worker <workload> <mmaps|blocking> <integrity|nointegrity> <index>" << std::endl;
+      return 1;
+    }
+    const workload *w = nullptr;
+    for(auto &i : workloads)
+    {
+      if(argv[0][0] == i.name)
+      {
+        w = &i;
+      }
+    }
+    if(w == nullptr)
+    {
+      std::cerr << "Unknown workload " << argv[0] << std::endl;
+      return 1;
+    }
+    const unsigned idx = (unsigned) atoi(argv[3]);
+    key_value_store::basic_key_value_store<> store(storepath, 2 * YCSB_RECORDS, 0 == strcmp(argv[2], "integrity"));
+    if(0 == strcmp(argv[1], "mmaps"))
+    {
+      store.use_mmaps();
+    }
+    std::mt19937_64 rand(idx + 1);
+    const zipfian keys(YCSB_RECORDS);
+    latency_histogram histograms[op_kinds];
+    uint64_t aborts = 0;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(YCSB_DURATION);
+    for(auto now = std::chrono::steady_clock::now(); now < end;)
+    {
+      const key_value_store::key_type key = key_for_rank(keys(rand));
+      const unsigned dice = (unsigned) (rand() % 100);
+      const op_kind kind = (dice < w->read_percent) ? op_read : (dice < w->read_percent + w->update_percent) ? op_update : op_rmw;
+      const std::string value = (kind == op_read) ? std::string() : value_of(rand);
+      const auto begin = std::chrono::steady_clock::now();
+      switch(kind)
+      {
+      case op_read:
+        if(!store.find(key))
+          abort();
+        break;
+      case op_update:
+      {
+        key_value_store::transaction<> tr(store);
+        tr.update_unsafe(key, value);
+        tr.commit();
+        break;
+      }
+      default:
+        for(;;)
+        {
+          try
+          {
+            key_value_store::transaction<> tr(store);
+            tr.fetch(key);
+            tr.update(key, value);
+            tr.commit();
+            break;
+          }
+          catch(const key_value_store::transaction_aborted &)
+          {
+            aborts++;
+          }
+        }
+        break;
+      }
+      now = std::chrono::steady_clock::now();
+      histograms[kind].add((uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(now - begin).count());
+    }
+    std::ofstream out(worker_histogram_path(idx));
+    out << aborts << "\n";
+    for(auto &h : histograms)
+    {
+      for(auto c : h.counts)
+      {
+        out << c << " ";
+      }
+      out << "\n";
+    }
+    return 0;
+  }
+
+  inline int run(int argc, char *argv[])
+  {
+    namespace llfio = LLFIO_V2_NAMESPACE;
+    const char *name = (argc > 0) ? argv[0] : "A";
+    const char *mode = (argc > 1) ? argv[1] : "mmaps";
+    const char *integrity = (argc > 2) ? argv[2] : "nointegrity";
+    const unsigned processes = (argc > 3) ? (unsigned) atoi(argv[3]) : 1;
+    if(strlen(name) != 1 || strchr("ABCF", name[0]) == nullptr || (0 != strcmp(mode, "mmaps") && 0 != strcmp(mode, "blocking")) ||
+       (0 != strcmp(integrity, "integrity") && 0 != strcmp(integrity, "nointegrity")) || processes < 1 || processes > 47)
+    {
+      std::cerr << "Usage: key-value-store ycsb <A|B|C|F> <mmaps|blocking> <integrity|nointegrity> <processes 1-47>" << std::endl;
+      return 1;
+    }
+    std::cout << "YCSB workload " << name << ", " << mode << ", " << integrity << ", " << processes << " processes:" << std::endl;
+    {
+      std::error_code ec;
+      llfio::filesystem::remove_all(storepath, ec);
+    }
+    std::cout << "  Loading " << YCSB_RECORDS << " keys ..." << std::endl;
+    {
+      key_value_store::basic_key_value_store<> store(storepath, 2 * YCSB_RECORDS, 0 == strcmp(integrity, "integrity"));
+      std::mt19937_64 rand(0);
+      for(uint64_t n = 1; n <= YCSB_RECORDS; n += 1024)
+      {
+        key_value_store::transaction<> tr(store);
+        for(uint64_t key = n; key < n + 1024 && key <= YCSB_RECORDS; key++)
+        {
+          tr.update_unsafe(key, value_of(rand));
+        }
+        tr.commit();
+      }
+    }
+    std::cout << "  Running " << processes << " processes for " << YCSB_DURATION << " seconds ..." << std::endl;
+    const auto myexepath = llfio::process_handle::current().current_path().value();
+    std::vector<llfio::process_handle> children;
+    for(unsigned n = 0; n < processes; n++)
+    {
+      const std::string idx = std::to_string(n);
+      llfio::path_view_component args[] = {"ycsb-worker", name, mode, integrity, idx.c_str()};
+      children.push_back(llfio::process_handle::launch_process(myexepath, args, llfio::process_handle::flag::wait_on_close | llfio::process_handle::flag::no_redirect).value());
+    }
+    latency_histogram histograms[op_kinds];
+    uint64_t aborts = 0;
+    for(unsigned n = 0; n < processes; n++)
+    {
+      if(children[n].wait().value() != 0)
+      {
+        std::cerr << "FAILURE: Worker " << n << " failed" << std::endl;
+        return 1;
+      }
+      std::ifstream in(worker_histogram_path(n));
+      uint64_t v;
+      in >> v;
+      aborts += v;
+      for(auto &h : histograms)
+      {
+        for(auto &c : h.counts)
+        {
+          in >> v;
+          c += v;
+        }
+      }
+      in.close();
+      std::remove(worker_histogram_path(n).c_str());
+    }
+    for(size_t n = 0; n < op_kinds; n++)
+    {
+      const auto &h = histograms[n];
+      const uint64_t total = h.total();
+      if(total == 0)
+      {
+        continue;
+      }
+      std::cout << "  " << op_names[n] << ": " << (total / YCSB_DURATION) << " ops/sec, p50 " << (h.percentile(0.5) / 1000.0) << " us, p99 " << (h.percentile(0.99) / 1000.0)
+                << " us, p999 " << (h.percentile(0.999) / 1000.0) << " us" << std::endl;
+    }
+    if(aborts > 0)
+    {
+      std::cout << "  " << aborts << " read-modify-write transactions were aborted and retried" << std::endl;
+    }
+    return 0;
+  }
+}  // namespace ycsb
+
+/* Multi-process stress of concurrent writers, run as `key-value-store stress <mmaps|blocking> <processes>`.
+
+The store is loaded with STRESS_KEYS small values, then for each power of two number of processes up
+to that given, and that given, each process updates a random key in one of every ten operations and
+looks up a random key in the rest, for STRESS_DURATION seconds. Every value looked up is checked to be
+that of its key, and the total operations per second are reported, so how well the store scales
+with concurrent writers can be seen.
+*/
+namespace stress
+{
+  static constexpr uint64_t STRESS_KEYS = 10000;
+  static constexpr int STRESS_DURATION = 5;
+  static const char *const storepath = "stressstore";
+
+  inline std::string value_of(uint64_t key, unsigned idx)
+  {
+    std::string ret = std::to_string(key) + ":" + std::to_string(idx) + ":";
+    ret.resize(64, 'x');
+    return ret;
+  }
+  inline std::string worker_result_path(unsigned idx) { return "stress_worker" + std::to_string(idx) + ".txt"; }
+
+  inline int worker(int argc, char *argv[])
+  {
+    if(argc < 2)
+    {
+      std::cerr << "stress-worker <mmaps|blocking> <index>" << std::endl;
+      return 1;
+    }
+    const unsigned idx = (unsigned) atoi(argv[1]);
+    key_value_store::basic_key_value_store<> store(storepath, 2 * STRESS_KEYS);
+    if(0 == strcmp(argv[0], "mmaps"))
+    {
+      store.use_mmaps();
+    }
+    std::mt19937_64 rand(idx + 1);
+    uint64_t ops = 0;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(STRESS_DURATION);
+    while(std::chrono::steady_clock::now() < end)
+    {
+      for(int n = 0; n < 100; n++, ops++)
+      {
+        const uint64_t key = 1 + rand() % STRESS_KEYS;
+        if(rand() % 10 == 0)
+        {
+          key_value_store::transaction<> tr(store);
+          tr.update_unsafe(key, value_of(key, idx));
+          tr.commit();
+        }
+        else
+        {
+          auto kvi = store.find(key);
+          const std::string prefix = std::to_string(key) + ":";
+          if(!kvi || kvi.value.size() != 64 || 0 != memcmp(kvi.value.data(), prefix.data(), prefix.size()))
+          {
+            std::cerr << "FAILURE: Key " << key << " has the wrong value" << std::endl;
+            return 1;
+          }
+        }
+      }
+    }
+    std::ofstream out(worker_result_path(idx));
+    out << ops << "\n";
+    return 0;
+  }
+
+  inline int run(int argc, char *argv[])
+  {
+    namespace llfio = LLFIO_V2_NAMESPACE;
+    const char *mode = (argc > 0) ? argv[0] : "mmaps";
+    const unsigned processes = (argc > 1) ? (unsigned) atoi(argv[1]) : 48;
+    if((0 != strcmp(mode, "mmaps") && 0 != strcmp(mode, "blocking")) || processes < 1 || processes > 48)
+    {
+      std::cerr << "Usage: key-value-store stress <mmaps|blocking> <processes 1-48>" << std::endl;
+      return 1;
+    }
+    std::cout << "Stressing " << mode << " with up to " << processes << " writer processes:" << std::endl;
+    {
+      std::error_code ec;
+      llfio::filesystem::remove_all(storepath, ec);
+    }
+    {
+      key_value_store::basic_key_value_store<> store(storepath, 2 * STRESS_KEYS);
+      key_value_store::transaction<> tr(store);
+      for(uint64_t key = 1; key <= STRESS_KEYS; key++)
+      {
+        tr.update_unsafe(key, value_of(key, 0));
+      }
+      tr.commit();
+    }
+    const auto myexepath = llfio::process_handle::current().current_path().value();
+    for(unsigned count = 1;; count = std::min(count * 2, processes))
+    {
+      std::vector<llfio::process_handle> children;
+      for(unsigned n = 0; n < count; n++)
+      {
+        const std::string idx = std::to_string(n);
+        llfio::path_view_component args[] = {"stress-worker", mode, idx.c_str()};
+        children.push_back(llfio::process_handle::launch_process(myexepath, args, llfio::process_handle::flag::wait_on_close | llfio::process_handle::flag::no_redirect).value());
+      }
+      uint64_t ops = 0;
+      for(unsigned n = 0; n < count; n++)
+      {
+        if(children[n].wait().value() != 0)
+        {
+          std::cerr << "FAILURE: Worker " << n << " failed" << std::endl;
+          return 1;
+        }
+        std::ifstream in(worker_result_path(n));
+        uint64_t v = 0;
+        in >> v;
+        ops += v;
+        in.close();
+        std::remove(worker_result_path(n).c_str());
+      }
+      std::cout << "  " << count << " processes: " << (ops / STRESS_DURATION) << " ops/sec, " << (ops / STRESS_DURATION / count) << " ops/sec per process" << std::endl;
+      if(count == processes)
+      {
+        break;
+      }
+    }
+    return 0;
+  }
+}  // namespace stress
+
+/* Compares the durable transactions of many values of the key-value store with those of
+`algorithm::transactional_directory`, which stores each value in its own file, run as
+`key-value-store transactional [<transactions> [<keys per transaction>]]`.
+*/
+namespace transactional
+{
+  static const char *const storepath = "txnstore";
+
+  inline int run(int argc, char *argv[])
+  {
+    namespace llfio = LLFIO_V2_NAMESPACE;
+    const size_t transactions = (argc > 0) ? (size_t) atoi(argv[0]) : 1000, keys = (argc > 1) ? (size_t) atoi(argv[1]) : 4;
+    if(transactions == 0 || keys == 0)
+    {
+      std::cerr << "Usage: key-value-store transactional [<transactions> [<keys per transaction>]]" << std::endl;
+      return 1;
+    }
+    std::vector<std::string> values;
+    for(size_t n = 0; n < keys * 16; n++)
+    {
+      values.push_back(llfio::utils::random_string(1024 / 2));
+    }
+    auto report = [&](const char *desc, std::chrono::high_resolution_clock::time_point begin) {
+      auto end = std::chrono::high_resolution_clock::now();
+      auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+      std::cout << "  " << desc << ": " << (transactions * 1000000ULL / (uint64_t)((diff > 0) ? diff : 1)) << " transactions per sec, "
+                << (diff / (double) transactions) << " us per transaction" << std::endl;
+    };
+    std::cout << "\nCommitting " << transactions << " durable transactions of " << keys << " 1Kb values each:" << std::endl;
+    {
+      std::error_code ec;
+      llfio::filesystem::remove_all(storepath, ec);
+    }
+    {
+      key_value_store::basic_key_value_store<> store(storepath, 2 * keys * 16, true, llfio::file_handle::mode::write, llfio::file_handle::caching::reads);
+      auto begin = std::chrono::high_resolution_clock::now();
+      for(size_t n = 0; n < transactions; n++)
+      {
+        key_value_store::transaction<> tr(store);
+        for(size_t m = 0; m < keys; m++)
+        {
+          const size_t idx = (n * keys + m) % values.size();
+          tr.update_unsafe(100 + idx, values[idx]);
+        }
+        tr.commit();
+      }
+      report("key_value_store", begin);
+    }
+    {
+      std::error_code ec;
+      llfio::filesystem::remove_all(storepath, ec);
+    }
+    {
+      auto dir = llfio::algorithm::transactional_directory::open({}, storepath).value();
+      std::vector<std::string> names;
+      for(size_t n = 0; n < values.size(); n++)
+      {
+        names.push_back(std::to_string(100 + n));
+      }
+      auto begin = std::chrono::high_resolution_clock::now();
+      for(size_t n = 0; n < transactions; n++)
+      {
+        auto tx = dir->begin();
+        for(size_t m = 0; m < keys; m++)
+        {
+          const size_t idx = (n * keys + m) % values.size();
+          llfio::file_handle::const_buffer_type buffer{(const llfio::byte *) values[idx].data(), values[idx].size()};
+          tx.write(names[idx], {&buffer, 1}).value();
+        }
+        dir->commit(tx).value();
+      }
+      report("transactional_directory", begin);
+    }
+    {
+      std::error_code ec;
+      llfio::filesystem::remove_all(storepath, ec);
+    }
+    return 0;
+  }
+}  // namespace transactional
+
+int main(int argc, char *argv[])
 {
 #ifdef _WIN32
   SetThreadAffinityMask(GetCurrentThread(), 1);
 #endif
   try
   {
+    if(argc > 1 && 0 == strcmp(argv[1], "ycsb"))
+    {
+      return ycsb::run(argc - 2, argv + 2);
+    }
+    if(argc > 1 && 0 == strcmp(argv[1], "ycsb-worker"))
+    {
+      return ycsb::worker(argc - 2, argv + 2);
+    }
+    if(argc > 1 && 0 == strcmp(argv[1], "stress"))
+    {
+      return stress::run(argc - 2, argv + 2);
+    }
+    if(argc > 1 && 0 == strcmp(argv[1], "stress-worker"))
+    {
+      return stress::worker(argc - 2, argv + 2);
+    }
+    if(argc > 1 && 0 == strcmp(argv[1], "transactional"))
+    {
+      return transactional::run(argc - 2, argv + 2);
+    }
     {
       std::error_code ec;
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 10);
+      key_value_store::basic_key_value_store<> store("teststore", 10);
       {
-        key_value_store::transaction tr(store);
+        key_value_store::transaction<> tr(store);
         tr.fetch(78);
         tr.update(78, "niall");
         tr.commit();
@@ -173,7 +750,7 @@ int main()
         }
       }
       {
-        key_value_store::transaction tr(store);
+        key_value_store::transaction<> tr(store);
         tr.fetch(79);
         tr.update(79, "douglas");
         tr.commit();
@@ -189,7 +766,7 @@ int main()
         }
       }
       {
-        key_value_store::transaction tr(store);
+        key_value_store::transaction<> tr(store);
         tr.fetch(78);
         tr.remove(78);
         tr.commit();
@@ -215,9 +792,78 @@ int main()
         }
       }
     }
+    // test free space consolidation
+    {
+      key_value_store::basic_key_value_store<> store("teststore", 10);
+      std::string value(4000, 'a');
+      for(size_t n = 0; n < 4096; n++)
+      {
+        value[0] = (char) ('a' + (n % 26));
+        key_value_store::transaction<> tr(store);
+        tr.update_unsafe(80 + (n % 4), value);
+        tr.commit();
+      }
+      auto freed = store.compact();
+      std::cout << "Compaction deallocated " << freed << " bytes" << std::endl;
+      for(size_t n = 0; n < 4; n++)
+      {
+        auto kvi = store.find(80 + n);
+        if(!kvi || kvi.value.size() != value.size() || kvi.value[0] != (char) ('a' + ((4092 + n) % 26)))
+        {
+          std::cerr << "FAILURE: Key " << (80 + n) << " was not found after compaction!" << std::endl;
+        }
+      }
+      if(freed == 0)
+      {
+        std::cerr << "FAILURE: Compaction did not deallocate anything!" << std::endl;
+      }
+    }
+    // test snapshot reads
+    {
+      key_value_store::basic_key_value_store<> store("teststore", 10);
+      auto update = [&](key_value_store::key_type key, const char *value) {
+        key_value_store::transaction<> tr(store);
+        if(value != nullptr)
+        {
+          tr.update_unsafe(key, value);
+        }
+        else
+        {
+          tr.remove_unsafe(key);
+        }
+        tr.commit();
+      };
+      auto value_in = [&](key_value_store::key_type key, uint64_t snapshot) -> std::string {
+        auto kvi = store.find_in_snapshot(key, snapshot);
+        return kvi ? std::string(kvi.value.data(), kvi.value.size()) : std::string("<none>");
+      };
+      update(90, "first");
+      const auto before = store.snapshot();
+      update(90, "second");
+      update(91, "new");
+      const auto after = store.snapshot();
+      update(90, nullptr);
+      if(value_in(90, before) != "first" || value_in(91, before) != "<none>" || value_in(90, after) != "second" || value_in(91, after) != "new" ||
+         value_in(90, store.snapshot()) != "<none>" || store.find(90))
+      {
+        std::cerr << "FAILURE: Snapshot reads did not see the store as it was!" << std::endl;
+      }
+      // Once four newer revisions of a value have been written, the snapshot has expired
+      update(90, "third");
+      update(90, "fourth");
+      try
+      {
+        value_in(90, before);
+        std::cerr << "FAILURE: Snapshot read of exhausted history did not throw!" << std::endl;
+      }
+      catch(const key_value_store::snapshot_expired &)
+      {
+        std::cout << "Snapshot reads saw the store as it was, until the history was exhausted" << std::endl;
+      }
+    }
     // test read only
     {
-      key_value_store::basic_key_value_store store("teststore");
+      key_value_store::basic_key_value_store<> store("teststore");
       auto kvi = store.find(79);
       if(kvi)
       {
@@ -229,12 +875,86 @@ int main()
         std::cerr << "FAILURE: Key 79 was not found!" << std::endl;
       }
     }
+    // test range scans
+    {
+      std::error_code ec;
+      LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
+    }
+    {
+      auto check = [](key_value_store::basic_key_value_store<> &store, const char *desc) {
+        // The even keys not divisible by ten remain, so 1000-2000 inclusive holds 400 of them
+        std::vector<key_value_store::key_type> keys(64);
+        size_t found = 0;
+        key_value_store::key_type first(1000), last(2000);
+        for(;;)
+        {
+          auto got = store.keys_in_range(keys, first, last);
+          for(auto &key : got)
+          {
+            const uint64_t v = key.as_longlongs[0];
+            if(v != 1002 + 2 * (found + found / 4))
+            {
+              std::cerr << "FAILURE: " << desc << " range scan returned key " << v << std::endl;
+            }
+            found++;
+          }
+          if(got.size() < keys.size())
+          {
+            break;
+          }
+          first = got[got.size() - 1];
+          first.as_longlongs[0]++;
+        }
+        if(found != 400)
+        {
+          std::cerr << "FAILURE: " << desc << " range scan found " << found << " keys" << std::endl;
+        }
+        keys.resize(1024);
+        // 1024-2047 holds 410 of them
+        auto got = store.keys_with_prefix(keys, 1024, 118);
+        if(got.size() != 410)
+        {
+          std::cerr << "FAILURE: " << desc << " prefix scan found " << got.size() << " keys" << std::endl;
+        }
+        else
+        {
+          std::cout << desc << " range and prefix scans found the expected keys" << std::endl;
+        }
+      };
+      {
+        key_value_store::basic_key_value_store<> store("teststore", 100000, false, LLFIO_V2_NAMESPACE::file_handle::mode::write, LLFIO_V2_NAMESPACE::file_handle::caching::all,
+                                                       key_value_store::integrity_hash::spooky, false, true);
+        // Insert in a scattered order, enough keys to split the ordered index's nodes many times
+        for(uint64_t n = 0; n < 50000; n += 1000)
+        {
+          key_value_store::transaction<> tr(store);
+          for(uint64_t m = n; m < n + 1000; m++)
+          {
+            tr.update_unsafe(((m * 7919) % 50000) * 2, "x");
+          }
+          tr.commit();
+        }
+        for(uint64_t n = 0; n < 100000; n += 10000)
+        {
+          key_value_store::transaction<> tr(store);
+          for(uint64_t m = n; m < n + 10000; m += 10)
+          {
+            tr.remove_unsafe(m);
+          }
+          tr.commit();
+        }
+        check(store, "Live");
+      }
+      // Reopening the store rebuilds the ordered index without the removed keys
+      key_value_store::basic_key_value_store<> store("teststore", 100000);
+      check(store, "Rebuilt");
+    }
     {
       std::error_code ec;
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 2000000);
+      key_value_store::basic_key_value_store<> store("teststore", 2000000);
       benchmark(store, "no integrity, no durability, read + append");
     }
     {
@@ -242,7 +962,7 @@ int main()
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 2000000, true);
+      key_value_store::basic_key_value_store<> store("teststore", 2000000, true);
       benchmark(store, "integrity, no durability, read + append");
     }
     {
@@ -250,7 +970,7 @@ int main()
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 2000000);
+      key_value_store::basic_key_value_store<> store("teststore", 2000000);
       store.use_mmaps();
       benchmark(store, "no integrity, no durability, mmaps");
     }
@@ -259,7 +979,7 @@ int main()
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 2000000, true);
+      key_value_store::basic_key_value_store<> store("teststore", 2000000, true);
       store.use_mmaps();
       benchmark(store, "integrity, no durability, mmaps");
     }
@@ -268,7 +988,36 @@ int main()
       LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
     }
     {
-      key_value_store::basic_key_value_store store("teststore", 2000000, true, LLFIO_V2_NAMESPACE::file_handle::mode::write,
+      key_value_store::basic_key_value_store<> store("teststore", 2000000, true, LLFIO_V2_NAMESPACE::file_handle::mode::write, LLFIO_V2_NAMESPACE::file_handle::caching::all,
+                                                     key_value_store::integrity_hash::crc32c);
+      store.use_mmaps();
+      benchmark(store, "crc32c integrity, no durability, mmaps");
+    }
+    {
+      std::error_code ec;
+      LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
+    }
+    {
+      key_value_store::basic_key_value_store<> store("teststore", 2000000, false, LLFIO_V2_NAMESPACE::file_handle::mode::write, LLFIO_V2_NAMESPACE::file_handle::caching::all,
+                                                     key_value_store::integrity_hash::spooky, true);
+      store.use_mmaps();
+      benchmark(store, "no integrity, no durability, mmaps, bloom filter");
+    }
+    {
+      std::error_code ec;
+      LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
+    }
+    {
+      key_value_store::basic_key_value_store<key_value_store::index::compact_layout> store("teststore", 2000000);
+      store.use_mmaps();
+      benchmark(store, "no integrity, no durability, mmaps, compact index");
+    }
+    {
+      std::error_code ec;
+      LLFIO_V2_NAMESPACE::filesystem::remove_all("teststore", ec);
+    }
+    {
+      key_value_store::basic_key_value_store<> store("teststore", 2000000, true, LLFIO_V2_NAMESPACE::file_handle::mode::write,
                                                    LLFIO_V2_NAMESPACE::file_handle::caching::reads);
       store.use_mmaps();
       benchmark(store, "integrity, durability, mmaps");
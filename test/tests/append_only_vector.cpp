@@ -0,0 +1,99 @@
+/* Integration test kernel for the concurrent append only vector
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <thread>
+
+static inline void TestAppendOnlyVector()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  struct udt
+  {
+    uint32_t thread, n;
+  };
+  static constexpr size_t threads = 8, items = 200000;
+  // Small commit chunks so the chunk boundaries are crossed often and concurrently
+  llfio::algorithm::append_only_vector<udt> v(threads * items + 1000, 65536);
+  BOOST_CHECK(v.empty());
+  BOOST_CHECK(v.committed_bytes() == 0);
+  BOOST_CHECK(v.commit_granularity() >= 65536);
+  v.push_back(udt{99, 0});
+  const udt *first = v.data();
+  BOOST_CHECK(v.committed_bytes() == v.commit_granularity());
+
+  std::vector<std::thread> producers;
+  for(uint32_t t = 0; t < threads; t++)
+  {
+    producers.emplace_back([&v, t] {
+      for(uint32_t n = 0; n < items; n++)
+      {
+        if(n % 1000 == 999)
+        {
+          // Bulk claims interleave with individual ones
+          udt *p = v.grow_by(1);
+          *p = udt{t, n};
+        }
+        else
+        {
+          v.emplace_back(udt{t, n});
+        }
+      }
+    });
+  }
+  for(auto &producer : producers)
+  {
+    producer.join();
+  }
+  // Nothing ever moved, and each thread's items appear exactly once and in order
+  BOOST_CHECK(v.data() == first);
+  BOOST_REQUIRE(v.size() == threads * items + 1);
+  BOOST_CHECK(v[0].thread == 99);
+  std::vector<uint32_t> next(threads, 0);
+  for(size_t i = 1; i < v.size(); i++)
+  {
+    BOOST_REQUIRE(v[i].thread < threads);
+    BOOST_REQUIRE(v[i].n == next[v[i].thread]);
+    next[v[i].thread]++;
+  }
+  for(auto &n : next)
+  {
+    BOOST_CHECK(n == items);
+  }
+  BOOST_CHECK(v.committed_bytes() >= v.size() * sizeof(udt));
+
+  // Appending beyond the reservation throws rather than moving anything
+  auto *p = v.grow_by(999);
+  BOOST_CHECK(p + 999 == v.data() + v.max_size());
+  try
+  {
+    v.push_back(udt{0, 0});
+    BOOST_CHECK(false);
+  }
+  catch(const std::length_error & /*unused*/)
+  {
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, append_only_vector, "Tests that llfio::algorithm::append_only_vector works as expected", TestAppendOnlyVector())
@@ -0,0 +1,100 @@
+/* Integration test kernel for algorithm::atomic_replacer
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <thread>
+
+static inline void TestAtomicReplace()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t THREADS = 8, REPLACES = 32;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  llfio::algorithm::atomic_replacer replacer(dh.reopen().value());
+  auto read_all = [&](llfio::path_view leafname) {
+    auto fh = llfio::file_handle::file(dh, leafname).value();
+    std::string ret((size_t) fh.maximum_extent().value(), 0);
+    fh.read(0, {{(llfio::byte *) ret.data(), ret.size()}}).value();
+    return ret;
+  };
+  auto replace = [&](llfio::path_view leafname, const std::string &contents) {
+    llfio::file_handle::const_buffer_type buffer((const llfio::byte *) contents.data(), contents.size());
+    return replacer.replace(leafname, {&buffer, 1});
+  };
+  // Replacing a file which does not exist creates it
+  replace("a", "hello").value();
+  BOOST_CHECK(read_all("a") == "hello");
+  // Replacing a file leaves handles open on the old contents seeing them
+  auto old = llfio::file_handle::file(dh, "a").value();
+  replace("a", "world!").value();
+  BOOST_CHECK(read_all("a") == "world!");
+  BOOST_CHECK(old.maximum_extent().value() == 5);
+  old.close().value();
+  // Writing into the inode from begin() is also possible
+  {
+    auto fh = replacer.begin().value();
+    fh.write(0, {{(const llfio::byte *) "abc", 3}}).value();
+    replacer.commit(fh, "b").value();
+    BOOST_CHECK(read_all("b") == "abc");
+  }
+  BOOST_CHECK(replacer.stats().replaces == 3);
+  BOOST_CHECK(replacer.stats().directory_syncs == 3);
+
+  // Concurrent replaces all complete, sharing directory syncs
+  std::vector<std::thread> threads;
+  for(size_t t = 0; t < THREADS; t++)
+  {
+    threads.emplace_back([&, t] {
+      for(size_t n = 0; n < REPLACES; n++)
+      {
+        replace(std::to_string(t), std::to_string(t) + ":" + std::to_string(n)).value();
+      }
+    });
+  }
+  for(auto &t : threads)
+  {
+    t.join();
+  }
+  for(size_t t = 0; t < THREADS; t++)
+  {
+    BOOST_CHECK(read_all(std::to_string(t)) == std::to_string(t) + ":" + std::to_string(REPLACES - 1));
+  }
+  const auto stats = replacer.stats();
+  BOOST_CHECK(stats.replaces == 3 + THREADS * REPLACES);
+  BOOST_CHECK(stats.directory_syncs <= stats.replaces);
+  std::cout << "Concurrent replaces needed " << (stats.directory_syncs - 3) << " directory syncs for " << (THREADS * REPLACES) << " replaces." << std::endl;
+
+  // Nothing but the replaced files are left in the directory
+  std::vector<llfio::directory_handle::buffer_type> buffer(THREADS * 4);
+  auto entries = dh.read({buffer}).value();
+  BOOST_CHECK(entries.size() == THREADS + 2);
+  for(auto &entry : entries)
+  {
+    llfio::file_handle::file(dh, entry.leafname).value().unlink().value();
+  }
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, atomic_replace, "Tests that algorithm::atomic_replacer replaces files atomically and durably",
+                       TestAtomicReplace())
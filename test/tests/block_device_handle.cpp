@@ -0,0 +1,85 @@
+/* Integration test kernel for whether block_device_handle works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestBlockDeviceHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  {
+    // Regular files are not block devices
+    auto tempfh = llfio::file_handle::temp_file("block_device_handle_test", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed,
+                                                llfio::file_handle::caching::all, llfio::file_handle::flag::unlink_on_first_close)
+                  .value();
+    auto r = llfio::block_device_handle::block_device(llfio::path_discovery::storage_backed_temporary_files_directory(), "block_device_handle_test");
+    BOOST_REQUIRE(!r);
+    BOOST_CHECK(r.error() == llfio::errc::no_such_device);
+  }
+#ifdef _WIN32
+  auto r = llfio::block_device_handle::block_device({}, "\\\\.\\PhysicalDrive0", llfio::block_device_handle::mode::none);
+#elif defined(__linux__)
+  auto r = llfio::block_device_handle::block_device({}, "/dev/sda");
+  if(!r)
+  {
+    r = llfio::block_device_handle::block_device({}, "/dev/nvme0n1");
+  }
+#else
+  auto r = llfio::block_device_handle::block_device({}, "/dev/disk0");
+#endif
+  if(!r)
+  {
+    std::cout << "NOTE: No block device could be opened (" << r.error().message() << "), skipping remainder of test." << std::endl;
+    return;
+  }
+  auto &bdh = r.value();
+  const auto &geometry = bdh.geometry();
+  std::cout << "Block device has logical block size " << geometry.logical_block_size << ", physical block size " << geometry.physical_block_size
+            << ", max transfer " << geometry.max_transfer << ", size " << geometry.size << ", zoned " << (int) geometry.zoned << std::endl;
+  BOOST_CHECK(geometry.logical_block_size >= 512);
+  BOOST_CHECK(geometry.physical_block_size >= geometry.logical_block_size);
+  BOOST_CHECK(geometry.size > 0);
+  if(!bdh.is_zoned())
+  {
+    BOOST_CHECK(bdh.zone_at(0).error() == llfio::errc::operation_not_supported);
+    BOOST_CHECK(bdh.manage_zones(llfio::block_device_handle::zone_operation::reset, {0, 0}).error() == llfio::errc::operation_not_supported);
+    return;
+  }
+  // Never write to a device which may hold data, only report upon it
+  std::cout << "Zone size " << geometry.zone_size << ", zone count " << geometry.zone_count << ", max open zones " << geometry.max_open_zones << std::endl;
+  BOOST_CHECK(geometry.zone_size > 0);
+  BOOST_CHECK(geometry.zone_count > 0);
+  llfio::block_device_handle::zone zones[4];
+  auto filled = bdh.zones(zones).value();
+  BOOST_REQUIRE(!filled.empty());
+  BOOST_CHECK(filled[0].start == 0);
+  for(size_t n = 0; n < filled.size(); n++)
+  {
+    BOOST_CHECK(filled[n].length == geometry.zone_size);
+    BOOST_CHECK(filled[n].capacity <= filled[n].length);
+    BOOST_CHECK(n == 0 || filled[n].start == filled[n - 1].start + filled[n - 1].length);
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, block_device_handle, geometry, "Tests that block_device_handle works as expected", TestBlockDeviceHandle())
@@ -0,0 +1,162 @@
+/* Integration test kernel for whether byte socket handles work
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <future>
+
+static inline void TestSocketAddress()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto v4 = llfio::socket_address::ip("127.0.0.1", 1234).value();
+  BOOST_CHECK(v4.family() == llfio::socket_address::family_type::v4);
+  BOOST_CHECK(v4.port() == 1234);
+  BOOST_CHECK(v4.is_loopback());
+  auto v6 = llfio::socket_address::ip("::1", 80).value();
+  BOOST_CHECK(v6.family() == llfio::socket_address::family_type::v6);
+  BOOST_CHECK(v6.port() == 80);
+  BOOST_CHECK(v6.is_loopback());
+  BOOST_CHECK(!llfio::socket_address::any(llfio::socket_address::family_type::v4, 0).value().is_loopback());
+  BOOST_CHECK(llfio::socket_address::ip("not an address", 0).has_error());
+}
+
+static inline void TestBlockingByteSocketHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto listener = llfio::listening_byte_socket_handle::listening_byte_socket(llfio::socket_address::loopback(llfio::socket_address::family_type::v4, 0).value()).value();
+  auto addr = listener.local_endpoint().value();
+  BOOST_REQUIRE(addr.port() != 0);
+  auto serverthread = std::async([&] {
+    auto server = listener.accept().value();
+    llfio::byte buffer[64];
+    auto read = server.read(0, {{buffer, 64}}).value();
+    BOOST_REQUIRE(read == 5);
+    BOOST_CHECK(0 == memcmp(buffer, "hello", 5));
+    BOOST_REQUIRE(server.write(0, {{(const llfio::byte *) "world", 5}}).value() == 5);
+    server.close().value();
+  });
+  auto client = llfio::byte_socket_handle::connect_to(addr).value();
+  BOOST_CHECK(client.is_socket());
+  BOOST_CHECK(client.remote_endpoint().value().port() == addr.port());
+  BOOST_REQUIRE(client.write(0, {{(const llfio::byte *) "hello", 5}}).value() == 5);
+  llfio::byte buffer[64];
+  auto read = client.read(0, {{buffer, 64}}).value();
+  BOOST_REQUIRE(read == 5);
+  BOOST_CHECK(0 == memcmp(buffer, "world", 5));
+  serverthread.get();
+  // The server has closed, so the next read returns end of stream
+  BOOST_CHECK(client.read(0, {{buffer, 64}}).value() == 0);
+  client.close().value();
+}
+
+static inline void TestNonBlockingByteSocketHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto listener =
+  llfio::listening_byte_socket_handle::listening_byte_socket(llfio::socket_address::loopback(llfio::socket_address::family_type::v4, 0).value(), llfio::byte_socket_handle::mode::write, llfio::byte_socket_handle::caching::all, llfio::byte_socket_handle::flag::multiplexable)
+  .value();
+  {  // nobody connecting, so accept should time out
+    auto accepted = listener.accept(std::chrono::milliseconds(100));
+    BOOST_REQUIRE(accepted.has_error());
+    BOOST_REQUIRE(accepted.error() == llfio::errc::timed_out);
+  }
+  auto pair = llfio::byte_socket_handle::anonymous_socket_pair(llfio::byte_socket_handle::caching::all, llfio::byte_socket_handle::flag::multiplexable).value();
+  llfio::byte buffer[64];
+  {  // nothing written, so non-blocking read should time out
+    auto read = pair.first.read(0, {{buffer, 64}}, std::chrono::milliseconds(0));
+    BOOST_REQUIRE(read.has_error());
+    BOOST_REQUIRE(read.error() == llfio::errc::timed_out);
+  }
+  BOOST_REQUIRE(pair.second.write(0, {{(const llfio::byte *) "hello", 5}}).value() == 5);
+  auto read = pair.first.read(0, {{buffer, 64}}, std::chrono::seconds(5));
+  BOOST_REQUIRE(read.value() == 5);
+  BOOST_CHECK(0 == memcmp(buffer, "hello", 5));
+  // Half close is seen by the other side as end of stream
+  pair.second.shutdown().value();
+  BOOST_CHECK(pair.first.read(0, {{buffer, 64}}, std::chrono::seconds(5)).value() == 0);
+}
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+static inline void TestMultiplexedByteSocketHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto test_multiplexer = [](llfio::io_multiplexer_ptr multiplexer) {
+    auto pair = llfio::byte_socket_handle::anonymous_socket_pair(llfio::byte_socket_handle::caching::all, llfio::byte_socket_handle::flag::multiplexable).value();
+    pair.first.set_multiplexer(multiplexer.get()).value();
+    pair.second.set_multiplexer(multiplexer.get()).value();
+    // Large enough to be sent zero copy where supported
+    std::vector<llfio::byte> out(64 * 1024), in(64 * 1024);
+    for(size_t n = 0; n < out.size(); n++)
+    {
+      out[n] = llfio::to_byte((unsigned char) n);
+    }
+    llfio::byte_socket_handle::const_buffer_type ob(out.data(), out.size());
+    auto write = multiplexer->construct_and_init_pooled(&pair.second, nullptr, {}, {}, llfio::byte_socket_handle::io_request<llfio::byte_socket_handle::const_buffers_type>({&ob, 1}, 0)).value();
+    size_t received = 0;
+    while(received < in.size())
+    {
+      llfio::byte_socket_handle::buffer_type b(in.data() + received, in.size() - received);
+      auto read = multiplexer->construct_and_init_pooled(&pair.first, nullptr, {}, {}, llfio::byte_socket_handle::io_request<llfio::byte_socket_handle::buffers_type>({&b, 1}, 0)).value();
+      while(!is_finished(multiplexer->check_io_operation(read.get())))
+      {
+        multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+      }
+      auto r = std::move(*read).get_completed_read().value();
+      BOOST_REQUIRE(r.size() == 1);
+      BOOST_REQUIRE(r[0].size() > 0);
+      received += r[0].size();
+    }
+    while(!is_finished(multiplexer->check_io_operation(write.get())))
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+    auto w = std::move(*write).get_completed_write_or_barrier().value();
+    BOOST_REQUIRE(w.size() == 1);
+    BOOST_CHECK(w[0].size() == out.size());
+    BOOST_CHECK(0 == memcmp(in.data(), out.data(), out.size()));
+  };
+#if defined(__linux__)
+  std::cout << "\nSingle threaded epoll:\n";
+  test_multiplexer(llfio::multiplexer_linux_epoll(1).value());
+  auto multiplexer = llfio::multiplexer_linux_io_uring(1, false);
+  if(!multiplexer)
+  {
+    std::cout << "\nio_uring is not available on this kernel (" << multiplexer.error().message().c_str() << "), skipping." << std::endl;
+    return;
+  }
+  std::cout << "\nSingle threaded io_uring:\n";
+  test_multiplexer(std::move(multiplexer).value());
+#else
+  std::cout << "\nSingle threaded kqueue:\n";
+  test_multiplexer(llfio::multiplexer_bsd_kqueue(1).value());
+#endif
+}
+#endif
+
+KERNELTEST_TEST_KERNEL(integration, llfio, byte_socket_handle, address, "Tests that llfio::socket_address works as expected", TestSocketAddress())
+KERNELTEST_TEST_KERNEL(integration, llfio, byte_socket_handle, blocking, "Tests that blocking llfio::byte_socket_handle works as expected", TestBlockingByteSocketHandle())
+KERNELTEST_TEST_KERNEL(integration, llfio, byte_socket_handle, nonblocking, "Tests that nonblocking llfio::byte_socket_handle works as expected", TestNonBlockingByteSocketHandle())
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+KERNELTEST_TEST_KERNEL(integration, llfio, byte_socket_handle, multiplexed, "Tests that multiplexed llfio::byte_socket_handle works as expected", TestMultiplexedByteSocketHandle())
+#endif
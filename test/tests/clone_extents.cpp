@@ -24,6 +24,7 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../test_kernel_decl.hpp"
 
+#include <algorithm>
 #include <chrono>
 
 #include "quickcpplib/algorithm/small_prng.hpp"
@@ -102,6 +103,20 @@ static inline void TestCloneExtents()
     llfio::mapped_file_handle::extent_pair srcregion{(rand() % (handles[0].maximum_extent / 2)), (rand() % (handles[0].maximum_extent / 2))};
     auto destoffset = rand() % (handles[1].maximum_extent / 2);
     std::cout << "\nRound " << (round + 1) << ": Cloning " << srcregion.offset << "-" << srcregion.length << " to offset " << destoffset << " ..." << std::endl;
+    if(round & 1)
+    {
+      // Have clone_extents_to() use the cached extent map of the source
+      handles[0].fh.set_extent_map_caching(true).value();
+      auto map = handles[0].fh.extent_map().value();
+      BOOST_CHECK(!map.empty());
+      BOOST_CHECK(map.empty() || (map.back().flags & llfio::file_handle::extent_flag::last));
+      for(size_t n = 0; n < map.size(); n++)
+      {
+        BOOST_CHECK(map[n].offset + map[n].length <= handles[0].maximum_extent);
+        BOOST_CHECK(n == 0 || map[n - 1].offset + map[n - 1].length <= map[n].offset);
+      }
+      BOOST_CHECK(handles[0].fh.is_extent_map_cached());
+    }
     handles[0].fh.clone_extents_to(srcregion, handles[1].fh, destoffset).value();
     // Destination will be original maximum extent, or any overlap of extents copied
     auto maxtobecopied = std::min(srcregion.length, handles[0].maximum_extent - srcregion.offset);
@@ -214,10 +229,61 @@ static inline void TestCloneOrCopyFileWhole()
   }
 }
 
-#if 0
+static inline void TestCloneOrCopyFileSparse()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t REGION = 16 * 1024 * 1024;
+  static constexpr size_t REGIONS = 8;
+  static constexpr llfio::file_handle::extent_type MAXIMUM_EXTENT = (llfio::file_handle::extent_type) 4 * 1024 * 1024 * 1024;
+  const auto &tempdirh = llfio::path_discovery::storage_backed_temporary_files_directory();
+  auto srcfh = llfio::file_handle::uniquely_named_file(tempdirh, llfio::file_handle::mode::write, llfio::file_handle::caching::all,
+                                                       llfio::file_handle::flag::unlink_on_first_close)
+               .value();
+  srcfh.truncate(MAXIMUM_EXTENT).value();
+  std::vector<llfio::byte> buffer(REGION);
+  for(size_t n = 0; n < REGIONS; n++)
+  {
+    memset(buffer.data(), (int) n + 1, buffer.size());
+    srcfh.write(n * (MAXIMUM_EXTENT / REGIONS), {{buffer.data(), buffer.size()}}).value();
+  }
+  llfio::stat_t src_stat(nullptr);
+  src_stat.fill(srcfh).value();
+  if(src_stat.st_allocated >= MAXIMUM_EXTENT / 2)
+  {
+    std::cout << "\nThis filing system does not support sparse files, skipping test." << std::endl;
+    return;
+  }
+
+  // The copy must be as sparse as the source, and is made by many threads if not extents cloned
+  auto randomname = llfio::utils::random_string(32);
+  randomname.append(".sparse");
+  auto copied = llfio::algorithm::clone_or_copy(srcfh, tempdirh, randomname, true, false, llfio::file_handle::creation::always_new, {}, 4).value();
+  auto destfh = llfio::file_handle::file(tempdirh, randomname, llfio::file_handle::mode::write, llfio::file_handle::creation::open_existing,
+                                         llfio::file_handle::caching::all, llfio::file_handle::flag::unlink_on_first_close)
+                .value();
+  llfio::stat_t dest_stat(nullptr);
+  dest_stat.fill(destfh).value();
+  std::cout << "\nCopied " << copied << " bytes. Source file has " << src_stat.st_allocated << " bytes allocated. Destination file has "
+            << dest_stat.st_allocated << " bytes allocated." << std::endl;
+  BOOST_CHECK(destfh.maximum_extent().value() == MAXIMUM_EXTENT);
+  BOOST_CHECK(copied <= MAXIMUM_EXTENT / 2);
+#ifndef __APPLE__
+  BOOST_CHECK(dest_stat.st_allocated < MAXIMUM_EXTENT / 2);
+#endif
+  std::vector<llfio::byte> readed(REGION);
+  for(size_t n = 0; n < REGIONS; n++)
+  {
+    memset(buffer.data(), (int) n + 1, buffer.size());
+    BOOST_REQUIRE(destfh.read(n * (MAXIMUM_EXTENT / REGIONS), {{readed.data(), readed.size()}}).value() == REGION);
+    BOOST_CHECK(0 == memcmp(readed.data(), buffer.data(), REGION));
+    BOOST_REQUIRE(destfh.read(n * (MAXIMUM_EXTENT / REGIONS) + REGION, {{readed.data(), 4096}}).value() == 4096);
+    BOOST_CHECK(std::all_of(readed.begin(), readed.begin() + 4096, [](llfio::byte c) { return c == llfio::to_byte(0); }));
+  }
+}
+
 static inline void TestCloneOrCopyTree()
 {
-  static constexpr size_t rounds = 10;
+  static constexpr size_t rounds = 2;
 #if defined(_WIN32) || defined(__APPLE__)
   static constexpr size_t total_entries = 100;  // create 100 directories in each random directory tree
 #else
@@ -268,7 +334,8 @@ static inline void TestCloneOrCopyTree()
         buffer[0] = 'f';
         to_hex_string(buffer + 1, 2, (const char *) &c, 1);
         buffer[3] = 0;
-        file_handle::file(h, path_view(buffer, 3, path_view::zero_terminated), file_handle::mode::write, file_handle::creation::if_needed).value();
+        auto fh = file_handle::file(h, path_view(buffer, 3, path_view::zero_terminated), file_handle::mode::write, file_handle::creation::if_needed).value();
+        fh.truncate(n * 64).value();
         entries_created++;
       }
       dirhs.emplace_back(std::move(h));
@@ -279,30 +346,132 @@ static inline void TestCloneOrCopyTree()
               << " entries/sec).\n";
 
     auto summary = algorithm::summarize(dirhs.front()).value();
-    std::cout << "Summary: " << summary.types[filesystem::file_type::regular] << " files and " << summary.types[filesystem::file_type::directory] << " directories created of " << summary.size << " bytes, " << summary.allocated << " bytes allocated in " << summary.blocks << " blocks with depth of " << summary.max_depth << "." << std::endl;
     BOOST_CHECK(summary.types[filesystem::file_type::regular] + summary.types[filesystem::file_type::directory] == entries_created);
 
-    std::cout << "\nCalling llfio::algorithm::reduce() on that randomised directory tree ..." << std::endl;
+    std::cout << "\nCalling llfio::algorithm::clone_or_copy() on that randomised directory tree ..." << std::endl;
+    struct progress_visitor : algorithm::clone_copy_link_symlink_visitor
+    {
+      std::atomic<size_t> calls{0};
+      virtual result<void> progress(void *data, size_t items_done, file_handle::extent_type bytes_done, size_t in_flight) noexcept override
+      {
+        (void) data;
+        (void) items_done;
+        (void) bytes_done;
+        (void) in_flight;
+        calls.fetch_add(1, std::memory_order_relaxed);
+        return success();
+      }
+    } visitor;
+    visitor.max_in_flight = 16;
+    auto destdirh = directory_handle::temp_directory().value();
     begin = std::chrono::high_resolution_clock::now();
-    auto entries_removed = algorithm::reduce(std::move(dirhs.front())).value();
+    auto entries_cloned = algorithm::clone_or_copy(dirhs.front(), {}, destdirh, {}, &visitor).value();
     end = std::chrono::high_resolution_clock::now();
-    // std::cout << entries_removed << " " << entries_created << std::endl;
-    BOOST_CHECK(entries_removed == entries_created);
-    if(entries_removed != entries_created)
-    {
-      std::cout << "Entries created " << entries_created << ", entries removed " << entries_removed << std::endl;
-    }
-    std::cout << "Reduced " << entries_created << " filesystem entries in " << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0) << " seconds (which is " << (entries_created / (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0))
+    BOOST_CHECK(entries_cloned == entries_created - 1);  // the root directory is not counted
+    BOOST_CHECK(visitor.calls > 0);
+    std::cout << "Cloned " << entries_cloned << " filesystem entries in " << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0)
+              << " seconds (which is " << (entries_cloned / (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0))
               << " entries/sec).\n";
+    auto clonesummary = algorithm::summarize(destdirh).value();
+    BOOST_CHECK(clonesummary.types[filesystem::file_type::regular] == summary.types[filesystem::file_type::regular]);
+    BOOST_CHECK(clonesummary.types[filesystem::file_type::directory] == summary.types[filesystem::file_type::directory]);
+    BOOST_CHECK(clonesummary.size == summary.size);
+    BOOST_CHECK(clonesummary.max_depth == summary.max_depth);
+
+    // Cloning again with identical destinations skips the content
+    entries_cloned = algorithm::clone_or_copy(dirhs.front(), {}, destdirh, {}, &visitor).value();
+    BOOST_CHECK(entries_cloned == entries_created - 1);
 
-    log_level_guard g(log_level::fatal);
-    auto r = directory_handle::directory({}, dirhpath);
-    BOOST_REQUIRE(!r && r.error() == errc::no_such_file_or_directory);
+    algorithm::reduce(std::move(destdirh)).value();
+    algorithm::reduce(std::move(dirhs.front())).value();
   }
 }
+
+static inline void TestAsyncCloneExtents()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t BLOCK = 65536, BLOCKS = 64;
+  auto src = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                            llfio::file_handle::flag::multiplexable)
+             .value();
+  std::vector<llfio::byte> buffer(BLOCK);
+  for(size_t n = 0; n < BLOCKS; n++)
+  {
+    // Leave every fourth block as a hole
+    if((n & 3) != 3)
+    {
+      memset(buffer.data(), (int) n + 1, buffer.size());
+      src.write(n * BLOCK, {{buffer.data(), buffer.size()}}).value();
+    }
+  }
+  src.truncate(BLOCK * BLOCKS).value();
+  auto check = [&](llfio::file_handle &dest, llfio::file_handle::extent_type destoffset) {
+    BOOST_CHECK(dest.maximum_extent().value() == destoffset + BLOCK * BLOCKS);
+    std::vector<llfio::byte> a(BLOCK), b(BLOCK);
+    for(size_t n = 0; n < BLOCKS; n++)
+    {
+      src.read(n * BLOCK, {{a.data(), a.size()}}).value();
+      dest.read(destoffset + n * BLOCK, {{b.data(), b.size()}}).value();
+      BOOST_CHECK(a == b);
+    }
+  };
+
+  std::vector<std::pair<const char *, llfio::io_multiplexer_ptr>> multiplexers;
+  multiplexers.emplace_back("no multiplexer", nullptr);
+#ifdef __linux__
+  {
+    auto r = llfio::multiplexer_linux_io_uring(1, false);
+    if(r)
+    {
+      multiplexers.emplace_back("io_uring", std::move(r).value());
+    }
+  }
 #endif
+  for(auto &multiplexer : multiplexers)
+  {
+    std::cout << "Testing async_clone_extents with " << multiplexer.first << std::endl;
+    auto dest = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                               llfio::file_handle::flag::multiplexable)
+                .value();
+    src.set_multiplexer(multiplexer.second.get()).value();
+    dest.set_multiplexer(multiplexer.second.get()).value();
+    auto op = llfio::algorithm::async_clone_extents::start(src, {(llfio::file_handle::extent_type) -1, (llfio::file_handle::extent_type) -1}, dest, BLOCK, 4,
+                                                          BLOCK)
+              .value();
+    BOOST_CHECK(op.progress().bytes_total == BLOCK * BLOCKS * 3 / 4);
+    size_t steps = 0;
+    while(!op.step().value())
+    {
+      steps++;
+    }
+    BOOST_CHECK(steps > 0);
+    BOOST_CHECK(op.done());
+    BOOST_CHECK(op.progress().bytes_done == op.progress().bytes_total);
+    check(dest, BLOCK);
+
+    // Cancellation leaves the destination partially copied
+    auto cancelled = llfio::algorithm::async_clone_extents::start(src, {0, BLOCK * BLOCKS}, dest, 0, 4, BLOCK).value();
+    cancelled.step().value();
+    cancelled.cancel();
+    auto r = cancelled.step();
+    BOOST_REQUIRE(!r);
+    BOOST_CHECK(r.error() == llfio::errc::operation_canceled);
+    BOOST_CHECK(cancelled.done());
+    BOOST_CHECK(cancelled.progress().bytes_done < BLOCK * BLOCKS);
+    BOOST_CHECK(cancelled.progress().reads_in_flight + cancelled.progress().writes_in_flight == 0);
+
+    src.set_multiplexer(nullptr).value();
+    dest.set_multiplexer(nullptr).value();
+  }
+}
 
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, clone_extents, "Tests that llfio::file_handle::clone_extents() of partial extents works as expected",
                        TestCloneExtents())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, clone_or_copy_file_whole,
                        "Tests that llfio::algorithm::clone_or_copy(file_handle) of whole files works as expected", TestCloneOrCopyFileWhole())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, clone_or_copy_file_sparse,
+                       "Tests that llfio::algorithm::clone_or_copy(file_handle) of sparse files preserves holes", TestCloneOrCopyFileSparse())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, clone_or_copy_tree,
+                       "Tests that llfio::algorithm::clone_or_copy() of directory trees works as expected", TestCloneOrCopyTree())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, async_clone_extents,
+                       "Tests that llfio::algorithm::async_clone_extents works as expected", TestAsyncCloneExtents())
@@ -390,6 +390,38 @@ template <class FileHandleType, class DirectoryHandleType> static inline void Te
   h2.unlink().value();
 }
 
+static inline void TestHandleCurrentPathCached()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto fh = llfio::file_handle::file(dh, "a", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+  const auto first = fh.current_path().value();
+  BOOST_REQUIRE(!first.empty());
+  auto begin = std::chrono::steady_clock::now();
+  for(size_t n = 0; n < 10000; n++)
+  {
+    BOOST_REQUIRE(fh.current_path().value() == first);
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "current_path() took " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 10000 << " ns per call." << std::endl;
+  // A rename by someone else is noticed
+  {
+    auto fh2 = llfio::file_handle::file(dh, "a").value();
+    fh2.relink(dh, "b").value();
+  }
+  BOOST_CHECK(fh.current_path().value() == first.parent_path() / "b");
+#ifndef _WIN32
+  // As is replacement by a different inode with the same name
+  {
+    auto fh2 = llfio::file_handle::file(dh, "a", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    fh2.relink(dh, "b").value();
+  }
+  BOOST_CHECK(fh.current_path().value().empty());
+#endif
+  llfio::file_handle::file(dh, "b").value().unlink().value();
+  dh.unlink().value();
+}
+
 KERNELTEST_TEST_KERNEL(integration, llfio, current_path, handle, "Tests that llfio::handle::current_path() works as expected",
                        TestHandleCurrentPath<LLFIO_V2_NAMESPACE::file_handle, LLFIO_V2_NAMESPACE::directory_handle>())
 KERNELTEST_TEST_KERNEL(integration, llfio, current_path, cached_parent_handle_adapter,
@@ -398,3 +430,5 @@ KERNELTEST_TEST_KERNEL(integration, llfio, current_path, cached_parent_handle_ad
                                              LLFIO_V2_NAMESPACE::algorithm::cached_parent_handle_adapter<LLFIO_V2_NAMESPACE::directory_handle>>())
 KERNELTEST_TEST_KERNEL(integration, llfio, to_win32_path, handle, "Tests that llfio::to_win32_path() works as expected",
                        TestToWin32Path<LLFIO_V2_NAMESPACE::file_handle, LLFIO_V2_NAMESPACE::directory_handle>())
+KERNELTEST_TEST_KERNEL(integration, llfio, current_path, cached, "Tests that repeated llfio::file_handle::current_path() reuses the last path if still valid",
+                       TestHandleCurrentPathCached())
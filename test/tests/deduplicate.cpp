@@ -0,0 +1,97 @@
+/* Integration test kernel for algorithm::deduplicate()
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDeduplicate()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = llfio::algorithm;
+  static constexpr size_t block_size = 64 * 1024;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto write_file = [](const llfio::path_handle &base, llfio::path_view path, const std::string &contents) {
+    auto fh = llfio::file_handle::file(base, path, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    fh.write(0, {{(const llfio::byte *) contents.data(), contents.size()}}).value();
+  };
+  auto read_file = [](const llfio::path_handle &base, llfio::path_view path) {
+    auto fh = llfio::file_handle::file(base, path).value();
+    std::string ret((size_t) fh.maximum_extent().value(), 0);
+    fh.read(0, {{(llfio::byte *) ret.data(), ret.size()}}).value();
+    return ret;
+  };
+  auto block = [](size_t seed) {
+    std::string ret(block_size, 0);
+    for(size_t n = 0; n < ret.size(); n++)
+    {
+      ret[n] = (char) ((n * 7919 + seed * 104729) >> 8);
+    }
+    return ret;
+  };
+  const std::string a = block(0) + block(1) + block(2) + block(3);
+  const std::string c = block(1) + block(2) + block(4) + std::string(100, 'c');
+  write_file(dh, "a", a);
+  write_file(dh, "b", a);
+  auto sub = llfio::directory_handle::directory(dh, "sub", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  write_file(sub, "c", c);
+  write_file(sub, "empty", "");
+
+  BOOST_CHECK(algorithm::deduplicate(dh, nullptr, 0, 1000).error() == llfio::errc::invalid_argument);
+
+  // A dry run finds all of b, and the first two blocks of c, duplicate
+  auto found = algorithm::deduplicate(dh, nullptr, 0, block_size, true).value();
+  BOOST_CHECK(found.files_scanned == 4);
+  BOOST_CHECK(found.files_failed == 0);
+  BOOST_CHECK(found.bytes_scanned == a.size() * 2 + c.size());
+  BOOST_CHECK(found.bytes_already_shared + found.bytes_duplicated == 6 * block_size);
+  BOOST_CHECK(found.bytes_deduplicated == 0);
+  BOOST_CHECK(found.operations == 0);
+
+  // Many filing systems cannot share extents, but deduplication must never change contents
+  auto done = algorithm::deduplicate(dh, nullptr, 0, block_size);
+  if(!done)
+  {
+    BOOST_CHECK(done.error() == llfio::errc::operation_not_supported);
+  }
+  else
+  {
+    BOOST_CHECK(done.value().bytes_deduplicated <= done.value().bytes_duplicated);
+    BOOST_CHECK(done.value().operations > 0);
+  }
+  BOOST_CHECK(read_file(dh, "a") == a);
+  BOOST_CHECK(read_file(dh, "b") == a);
+  BOOST_CHECK(read_file(sub, "c") == c);
+  auto again = algorithm::deduplicate(dh, nullptr, 0, block_size, true).value();
+  BOOST_CHECK(again.bytes_already_shared + again.bytes_duplicated == 6 * block_size);
+  if(done && done.value().operations_failed == 0 && done.value().bytes_deduplicated > 0)
+  {
+    std::cout << "Deduplicated " << done.value().bytes_deduplicated << " bytes, of which " << again.bytes_already_shared << " are reported as shared" << std::endl;
+  }
+
+  sub.close().value();
+  llfio::algorithm::reduce(std::move(dh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, deduplicate, "Tests that algorithm::deduplicate() finds duplicate blocks and never changes contents",
+                       TestDeduplicate())
@@ -0,0 +1,70 @@
+/* Integration test kernel for whether demand_paged_map works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDemandPagedMap()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  std::atomic<size_t> fills{0};
+  auto fill = llfio::make_function_ptr<llfio::result<void>(llfio::demand_paged_map::extent_type, llfio::demand_paged_map::buffer_type)>(
+  [&](llfio::demand_paged_map::extent_type offset, llfio::demand_paged_map::buffer_type page) -> llfio::result<void> {
+    ++fills;
+    if(offset == 13 * page.size())
+    {
+      return llfio::errc::io_error;
+    }
+    memset(page.data(), (int) (offset / page.size()), page.size());
+    return llfio::success();
+  });
+  auto r = llfio::demand_paged_map::map(64 * llfio::utils::page_size(), std::move(fill));
+  if(!r && (r.error() == llfio::errc::operation_not_supported || r.error() == llfio::errc::operation_not_permitted))
+  {
+    std::cout << "NOTE: demand paging is not available on this platform or to this process, skipping test." << std::endl;
+    return;
+  }
+  auto mh = std::move(r).value();
+  const size_t pagesize = mh.page_size();
+  BOOST_CHECK(mh.pages_materialised() == 0);
+
+  // Only the pages touched are filled
+  BOOST_CHECK(mh.address()[3 * pagesize] == llfio::to_byte(3));
+  BOOST_CHECK(mh.address()[3 * pagesize + 100] == llfio::to_byte(3));
+  BOOST_CHECK(mh.address()[60 * pagesize + 1] == llfio::to_byte(60));
+  BOOST_CHECK(mh.pages_materialised() == 2);
+  BOOST_CHECK(fills == 2);
+
+  // A failed fill yields a zeroed page
+  BOOST_CHECK(mh.address()[13 * pagesize] == llfio::to_byte(0));
+  BOOST_CHECK(mh.failures() == 1);
+
+  // Discarded pages are refilled on next touch, losing any modifications
+  mh.address()[3 * pagesize] = llfio::to_byte(0xff);
+  mh.discard({mh.address() + 3 * pagesize, 1}).value();
+  BOOST_CHECK(mh.address()[3 * pagesize] == llfio::to_byte(3));
+  BOOST_CHECK(mh.pages_materialised() == 3);
+  mh.close().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, demand_paged_map, fill, "Tests that demand_paged_map fills pages on first touch", TestDemandPagedMap())
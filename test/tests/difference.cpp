@@ -0,0 +1,181 @@
+/* Integration test kernel for whether difference() works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline bool HasDifference(const std::vector<LLFIO_V2_NAMESPACE::algorithm::difference_item> &changes,
+                                 LLFIO_V2_NAMESPACE::algorithm::difference_item::change_t changed, const char *path, const char *previous_path = nullptr)
+{
+  for(auto &i : changes)
+  {
+    if(i.changed == changed && i.path == path && (previous_path == nullptr || i.previous_path == previous_path))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline void TestDifference()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = LLFIO_V2_NAMESPACE::algorithm;
+  using item = algorithm::difference_item;
+  auto root = llfio::directory_handle::temp_directory().value();
+  auto a = llfio::directory_handle::directory(root, "a", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  auto b = llfio::directory_handle::directory(root, "b", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  auto f1 = llfio::file_handle::file(a, "f1", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+
+  auto tracker = algorithm::difference_tracker::track(root).value();
+  BOOST_CHECK(tracker.snapshot().size() == 3);
+  BOOST_CHECK(tracker.changes().value().empty());
+#ifdef __linux__
+  std::cout << "difference_tracker uses change journal = " << tracker.uses_change_journal() << std::endl;
+#endif
+
+  auto f2 = llfio::file_handle::file(a, "f2", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+  auto changes = tracker.changes().value();
+  BOOST_CHECK(HasDifference(changes, item::file_added, "a/f2"));
+
+  f1.relink(b, "f1").value();
+  changes = tracker.changes().value();
+  BOOST_CHECK(HasDifference(changes, item::file_renamed, "b/f1", "a/f1"));
+  BOOST_CHECK(!HasDifference(changes, item::file_removed, "a/f1"));
+
+  {
+    auto c = llfio::directory_handle::directory(root, "c", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+    llfio::file_handle::file(c, "x", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    changes = tracker.changes().value();
+    BOOST_CHECK(HasDifference(changes, item::directory_added, "c"));
+    BOOST_CHECK(HasDifference(changes, item::file_added, "c/x"));
+
+    // Renaming a directory does not report renames of its contents
+    c.relink(root, "d").value();
+    changes = tracker.changes().value();
+    BOOST_CHECK(changes.size() == 1);
+    BOOST_CHECK(HasDifference(changes, item::directory_renamed, "d", "c"));
+
+    // Changes within a renamed directory are still noticed
+    llfio::file_handle::file(c, "y", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    changes = tracker.changes().value();
+    BOOST_CHECK(HasDifference(changes, item::file_added, "d/y"));
+  }
+
+  f1.truncate(4096).value();
+  changes = tracker.changes().value();
+  BOOST_CHECK(HasDifference(changes, item::content_metadata_changed, "b/f1"));
+
+  f2.unlink().value();
+  changes = tracker.changes().value();
+  BOOST_CHECK(HasDifference(changes, item::file_removed, "a/f2"));
+
+  // The tracked snapshot is the same as a fresh one
+  auto fresh = algorithm::snapshot(root).value();
+  BOOST_CHECK(fresh.size() == tracker.snapshot().size());
+  for(auto &i : fresh)
+  {
+    auto it = tracker.snapshot().find(i.first);
+    BOOST_CHECK(it != tracker.snapshot().end());
+    if(it != tracker.snapshot().end())
+    {
+      BOOST_CHECK(it->second.st_ino == i.second.st_ino);
+      BOOST_CHECK(it->second.st_size == i.second.st_size);
+    }
+  }
+  BOOST_CHECK(algorithm::difference(tracker.snapshot(), fresh).value().empty());
+#ifdef __linux__
+  if(tracker.uses_change_journal())
+  {
+    BOOST_CHECK(tracker.full_traversals() == 0);
+  }
+#endif
+
+  f1.close().value();
+  f2.close().value();
+  a.close().value();
+  b.close().value();
+  algorithm::reduce(std::move(root)).value();
+}
+
+static inline void TestDifferenceTrees()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = LLFIO_V2_NAMESPACE::algorithm;
+  using item = algorithm::difference_item;
+  auto root = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto write_file = [](const llfio::path_handle &base, llfio::path_view path, const std::string &contents) {
+    auto fh = llfio::file_handle::file(base, path, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    fh.write(0, {{(const llfio::byte *) contents.data(), contents.size()}}).value();
+  };
+  auto mkdir = [](const llfio::path_handle &base, llfio::path_view path) {
+    return llfio::directory_handle::directory(base, path, llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  };
+  auto before = mkdir(root, "before"), after = mkdir(root, "after");
+  for(auto *dirh : {&before, &after})
+  {
+    mkdir(*dirh, "d");
+    write_file(*dirh, "d/g", "");
+  }
+  write_file(before, "f", "aaa");
+  write_file(after, "f", "bbbb");
+  write_file(before, "gone", "");
+  mkdir(before, "olddir");
+  write_file(before, "olddir/x", "");
+  write_file(after, "new", "");
+  mkdir(after, "newdir");
+  write_file(after, "newdir/y", "");
+  write_file(before, "typechanged", "");
+  mkdir(after, "typechanged");
+
+  auto changes = algorithm::difference(before, after).value();
+  for(auto &i : changes)
+  {
+    std::cout << "  " << (int) i.changed << " " << i.path << std::endl;
+  }
+  BOOST_CHECK(HasDifference(changes, item::content_metadata_changed, "f"));
+  BOOST_CHECK(HasDifference(changes, item::file_removed, "gone"));
+  BOOST_CHECK(HasDifference(changes, item::directory_removed, "olddir"));
+  BOOST_CHECK(HasDifference(changes, item::file_added, "new"));
+  BOOST_CHECK(HasDifference(changes, item::directory_added, "newdir"));
+  BOOST_CHECK(HasDifference(changes, item::file_removed, "typechanged"));
+  BOOST_CHECK(HasDifference(changes, item::directory_added, "typechanged"));
+  // Neither added nor removed directories are descended into, and unchanged content is not reported
+  for(auto &i : changes)
+  {
+    BOOST_CHECK(i.path != "olddir/x");
+    BOOST_CHECK(i.path != "newdir/y");
+    BOOST_CHECK(i.changed != item::content_metadata_changed || i.path == "f");
+  }
+  BOOST_REQUIRE(!changes.empty());
+  BOOST_CHECK(changes.back().changed == item::file_removed || changes.back().changed == item::directory_removed);
+  BOOST_CHECK(algorithm::difference(after, after, 1).value().empty());
+
+  before.close().value();
+  after.close().value();
+  algorithm::reduce(std::move(root)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, difference, "Tests that llfio::algorithm::difference() works as expected", TestDifference())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, difference_trees, "Tests that llfio::algorithm::difference() of two directory trees works as expected",
+                       TestDifferenceTrees())
@@ -0,0 +1,98 @@
+/* Integration test kernel for whether directory_handle::create_entries() works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDirectoryHandleCreateEntries()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  // More than one batch of files open at once
+  static constexpr size_t ENTRIES = llfio::directory_handle::create_entries_batch * 2 + 7;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto check = [&](llfio::io_multiplexer *multiplexer) {
+    std::vector<std::string> names, contents;
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      names.push_back(std::to_string(n));
+      // The first file is empty
+      contents.push_back(std::string(n % 100, (char) ('a' + n % 26)));
+    }
+    std::vector<llfio::directory_handle::create_request> reqs;
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      reqs.push_back({names[n], {(const llfio::byte *) contents[n].data(), contents[n].size()}});
+    }
+    auto created = dh.create_entries(reqs, llfio::directory_handle::creation::only_if_not_exist, llfio::directory_handle::caching::temporary, multiplexer).value();
+    BOOST_REQUIRE(created.size() == ENTRIES);
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      BOOST_REQUIRE(created[n].has_value());
+      auto fh = llfio::file_handle::file(dh, names[n]).value();
+      BOOST_REQUIRE(fh.maximum_extent().value() == contents[n].size());
+      std::string buffer(contents[n].size(), 0);
+      if(!buffer.empty())
+      {
+        fh.read(0, {{(llfio::byte *) buffer.data(), buffer.size()}}).value();
+      }
+      BOOST_CHECK(buffer == contents[n]);
+    }
+
+    // Creating files which already exist fails alone
+    reqs.resize(2);
+    reqs[1].leafname = "new";
+    created = dh.create_entries(reqs, llfio::directory_handle::creation::only_if_not_exist, llfio::directory_handle::caching::all, multiplexer).value();
+    BOOST_CHECK(!created[0] && created[0].error() == llfio::errc::file_exists);
+    BOOST_CHECK(created[1].has_value());
+
+    // Always new replaces the contents of those which exist
+    reqs[0].contents = reqs[1].contents;
+    created = dh.create_entries(reqs, llfio::directory_handle::creation::always_new, llfio::directory_handle::caching::temporary, multiplexer).value();
+    BOOST_CHECK(created[0].has_value());
+    BOOST_CHECK(created[1].has_value());
+    BOOST_CHECK(llfio::file_handle::file(dh, names[0]).value().maximum_extent().value() == contents[1].size());
+
+    // Direct i/o is not supported
+    BOOST_CHECK(!dh.create_entries(reqs, llfio::directory_handle::creation::always_new, llfio::directory_handle::caching::none, multiplexer));
+
+    std::vector<llfio::path_view> leafnames(names.begin(), names.end());
+    leafnames.push_back("new");
+    for(auto &r : dh.unlink_entries(leafnames).value())
+    {
+      BOOST_CHECK(r.has_value());
+    }
+  };
+  check(nullptr);
+#ifdef __linux__
+  auto multiplexer = llfio::multiplexer_linux_io_uring();
+  if(multiplexer)
+  {
+    check(multiplexer.value().get());
+  }
+#endif
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_handle, create_entries, "Tests that directory_handle::create_entries() creates many files with their contents",
+                       TestDirectoryHandleCreateEntries())
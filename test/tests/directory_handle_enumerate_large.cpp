@@ -0,0 +1,86 @@
+/* Integration test kernel for whether enumerating large directories works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDirectoryHandleEnumerateLarge()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 2000;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  // Long leafnames mean the entries need far more kernel buffer than is first estimated
+  std::string prefix(200, 'a');
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, prefix + std::to_string(n), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+  }
+  std::vector<llfio::directory_handle::buffer_type> entries(ENTRIES + 16);
+  llfio::directory_handle::buffers_type buffers(entries);
+  buffers = dh.read({std::move(buffers)}).value();
+  BOOST_CHECK(buffers.done());
+  BOOST_CHECK(buffers.size() == ENTRIES);
+  // Inode numbers from enumeration must match those from stat, however wide the filing system's file ids are
+  if(buffers.metadata() & llfio::stat_t::want::ino)
+  {
+    llfio::stat_t st(nullptr);
+    st.fill(llfio::file_handle::file(dh, buffers[0].leafname).value(), llfio::stat_t::want::ino).value();
+    BOOST_CHECK(st.st_ino == buffers[0].stat.st_ino);
+  }
+  // Reusing the now larger kernel buffer must give the same results
+  buffers = {entries, std::move(buffers)};
+  buffers = dh.read({std::move(buffers)}).value();
+  BOOST_CHECK(buffers.done());
+  BOOST_CHECK(buffers.size() == ENTRIES);
+  // Too few entries must say so, rather than claim to be done
+  std::vector<llfio::directory_handle::buffer_type> fewentries(ENTRIES / 2);
+  buffers = {fewentries, std::move(buffers)};
+  buffers = dh.read({std::move(buffers)}).value();
+  BOOST_CHECK(!buffers.done());
+  BOOST_CHECK(buffers.size() == ENTRIES / 2);
+  // A supplied kernel buffer too small for the directory must say so
+  std::vector<char> kernelbuffer(4096);
+  buffers = {entries, std::move(buffers)};
+  auto r = dh.read({std::move(buffers), {}, llfio::directory_handle::filter::fastdeleted, kernelbuffer});
+  BOOST_REQUIRE(!r);
+  BOOST_CHECK(r.error() == llfio::errc::no_buffer_space);
+  // A supplied kernel buffer large enough has leafnames viewing into it, with no internal buffer
+  kernelbuffer.resize(ENTRIES * 1024);
+  buffers = dh.read({llfio::directory_handle::buffers_type(entries), {}, llfio::directory_handle::filter::fastdeleted, kernelbuffer}).value();
+  BOOST_CHECK(buffers.done());
+  BOOST_REQUIRE(buffers.size() == ENTRIES);
+  for(auto &entry : buffers)
+  {
+    const auto *p = (const char *) entry.leafname._raw_data();
+    BOOST_CHECK(p >= kernelbuffer.data() && p < kernelbuffer.data() + kernelbuffer.size());
+  }
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, prefix + std::to_string(n)).value().unlink().value();
+  }
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_handle, enumerate_large, "Tests that enumerating directories with many long leafnames returns every entry",
+                       TestDirectoryHandleEnumerateLarge())
@@ -0,0 +1,118 @@
+/* Integration test kernel for directory_handle::relink_entries() and unlink_entries()
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDirectoryHandleRelinkEntries()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 64;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto check = [&](llfio::io_multiplexer *multiplexer) {
+    std::vector<std::string> names, newnames;
+    std::vector<llfio::directory_handle::relink_request> reqs;
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      names.push_back(std::to_string(n));
+      newnames.push_back("new" + std::to_string(n));
+      auto fh = llfio::file_handle::file(dh, names.back(), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+      fh.truncate(n).value();
+    }
+    llfio::directory_handle::directory(dh, "subdir", llfio::directory_handle::mode::write, llfio::directory_handle::creation::only_if_not_exist).value();
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      reqs.push_back({names[n], &dh, newnames[n], llfio::directory_handle::relink_kind::replace});
+    }
+    // Directories can be relinked too
+    reqs.push_back({"subdir", &dh, "newsubdir", llfio::directory_handle::relink_kind::replace});
+    auto relinked = dh.relink_entries(reqs, multiplexer).value();
+    BOOST_REQUIRE(relinked.size() == reqs.size());
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      BOOST_CHECK(relinked[n].has_value());
+      BOOST_CHECK(llfio::file_handle::file(dh, newnames[n]).value().maximum_extent().value() == n);
+      BOOST_CHECK(!llfio::file_handle::file(dh, names[n]));
+    }
+    BOOST_CHECK(relinked.back().has_value());
+    llfio::directory_handle::directory(dh, "newsubdir").value();
+
+    // Not replacing an existing entry fails alone, and leaves both entries as they were
+    reqs.clear();
+    reqs.push_back({newnames[1], &dh, newnames[2], llfio::directory_handle::relink_kind::no_replace});
+    reqs.push_back({newnames[3], &dh, names[3], llfio::directory_handle::relink_kind::no_replace});
+    relinked = dh.relink_entries(reqs, multiplexer).value();
+    BOOST_CHECK(!relinked[0] && relinked[0].error() == llfio::errc::file_exists);
+    BOOST_CHECK(relinked[1].has_value());
+    BOOST_CHECK(llfio::file_handle::file(dh, newnames[1]).value().maximum_extent().value() == 1);
+    BOOST_CHECK(llfio::file_handle::file(dh, newnames[2]).value().maximum_extent().value() == 2);
+    BOOST_CHECK(llfio::file_handle::file(dh, names[3]).value().maximum_extent().value() == 3);
+    reqs.clear();
+    reqs.push_back({names[3], &dh, newnames[3], llfio::directory_handle::relink_kind::replace});
+    BOOST_CHECK(dh.relink_entries(reqs, multiplexer).value()[0].has_value());
+
+#if defined(__linux__) || defined(__APPLE__)
+    // Exchanging swaps the two entries, if the filing system can
+    reqs.clear();
+    reqs.push_back({newnames[4], &dh, newnames[5], llfio::directory_handle::relink_kind::exchange});
+    relinked = dh.relink_entries(reqs, multiplexer).value();
+    if(relinked[0])
+    {
+      BOOST_CHECK(llfio::file_handle::file(dh, newnames[4]).value().maximum_extent().value() == 5);
+      BOOST_CHECK(llfio::file_handle::file(dh, newnames[5]).value().maximum_extent().value() == 4);
+    }
+    else
+    {
+      BOOST_CHECK(relinked[0].error() == llfio::errc::invalid_argument);
+    }
+#endif
+
+    // Unlinking an entry which does not exist fails alone
+    std::vector<llfio::path_view> leafnames(newnames.begin(), newnames.end());
+    leafnames.push_back("nonexistent");
+    auto unlinked = dh.unlink_entries(leafnames, false, multiplexer).value();
+    BOOST_REQUIRE(unlinked.size() == leafnames.size());
+    for(size_t n = 0; n < ENTRIES; n++)
+    {
+      BOOST_CHECK(unlinked[n].has_value());
+      BOOST_CHECK(!llfio::file_handle::file(dh, newnames[n]));
+    }
+    BOOST_CHECK(!unlinked.back() && unlinked.back().error() == llfio::errc::no_such_file_or_directory);
+    leafnames.clear();
+    leafnames.push_back("newsubdir");
+    BOOST_CHECK(dh.unlink_entries(leafnames, true, multiplexer).value()[0].has_value());
+    BOOST_CHECK(!llfio::directory_handle::directory(dh, "newsubdir"));
+  };
+  check(nullptr);
+#ifdef __linux__
+  auto multiplexer = llfio::multiplexer_linux_io_uring();
+  if(multiplexer)
+  {
+    check(multiplexer.value().get());
+  }
+#endif
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_handle, relink_entries,
+                       "Tests that directory_handle::relink_entries() and unlink_entries() relink and unlink many entries", TestDirectoryHandleRelinkEntries())
@@ -0,0 +1,103 @@
+/* Integration test kernel for whether directory_handle::stamp_entries() works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDirectoryHandleStampEntries()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 16;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, std::to_string(n), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+  }
+  llfio::directory_handle::directory(dh, "subdir", llfio::directory_handle::mode::write, llfio::directory_handle::creation::only_if_not_exist).value();
+  std::vector<llfio::directory_handle::buffer_type> _entries(ENTRIES * 2);
+  auto entries = dh.read({_entries}).value();
+  BOOST_REQUIRE(entries.size() == ENTRIES + 1);
+  const auto wanted = llfio::stat_t::want::type | llfio::stat_t::want::perms | llfio::stat_t::want::mtim;
+  auto filled = dh.stat_entries(entries, wanted).value();
+  std::vector<llfio::stat_t> original(entries.size(), llfio::stat_t(nullptr));
+  for(size_t n = 0; n < entries.size(); n++)
+  {
+    BOOST_REQUIRE(filled[n].has_value());
+    original[n] = entries[n].stat;
+    // Backdate every entry by a day, and make the files owner read only
+    entries[n].stat.st_mtim -= std::chrono::hours(24);
+    if(entries[n].stat.st_type == llfio::filesystem::file_type::regular)
+    {
+      entries[n].stat.st_perms = llfio::filesystem::perms::owner_read;
+    }
+  }
+  auto stamped = dh.stamp_entries(entries, wanted).value();
+  BOOST_REQUIRE(stamped.size() == entries.size());
+  for(auto &r : stamped)
+  {
+    BOOST_CHECK(r.has_value());
+  }
+  std::vector<llfio::directory_handle::buffer_type> _check(ENTRIES * 2);
+  auto check = dh.read({_check}).value();
+  filled = dh.stat_entries(check, wanted).value();
+  std::vector<llfio::stat_t> current(check.size(), llfio::stat_t(nullptr));
+  for(size_t n = 0; n < check.size(); n++)
+  {
+    BOOST_REQUIRE(filled[n].has_value());
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const llfio::directory_handle::buffer_type &i) { return i.leafname == check[n].leafname; });
+    BOOST_REQUIRE(it != entries.end());
+    BOOST_CHECK(check[n].stat.st_mtim == it->stat.st_mtim);
+#ifndef _WIN32
+    BOOST_CHECK(check[n].stat.st_perms == it->stat.st_perms);
+#endif
+    current[it - entries.begin()] = check[n].stat;
+  }
+  // Stamping again with the current metadata supplied sets nothing
+  stamped = dh.stamp_entries(entries, wanted, current).value();
+  for(auto &r : stamped)
+  {
+    BOOST_REQUIRE(r.has_value());
+    BOOST_CHECK(!(r.value() & (llfio::stat_t::want::perms | llfio::stat_t::want::mtim)));
+  }
+  // But restoring the original metadata does
+  for(size_t n = 0; n < entries.size(); n++)
+  {
+    entries[n].stat = original[n];
+  }
+  stamped = dh.stamp_entries(entries, wanted, current).value();
+  for(auto &r : stamped)
+  {
+    BOOST_REQUIRE(r.has_value());
+    BOOST_CHECK(r.value() & llfio::stat_t::want::mtim);
+  }
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, std::to_string(n)).value().unlink().value();
+  }
+  llfio::directory_handle::directory(dh, "subdir").value().unlink().value();
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_handle, stamp_entries, "Tests that directory_handle::stamp_entries() sets the metadata of many entries",
+                       TestDirectoryHandleStampEntries())
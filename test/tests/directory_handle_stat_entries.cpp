@@ -0,0 +1,101 @@
+/* Integration test kernel for whether directory_handle::stat_entries() works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestDirectoryHandleStatEntries()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 64;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    auto fh = llfio::file_handle::file(dh, std::to_string(n), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    fh.truncate(n * 100).value();
+  }
+  llfio::directory_handle::directory(dh, "subdir", llfio::directory_handle::mode::write, llfio::directory_handle::creation::only_if_not_exist).value();
+  std::vector<llfio::directory_handle::buffer_type> _entries(ENTRIES * 2);
+  auto check = [&](llfio::io_multiplexer *multiplexer) {
+    auto entries = dh.read({_entries}).value();
+    BOOST_REQUIRE(entries.size() == ENTRIES + 1);
+    auto filled = dh.stat_entries(entries, llfio::stat_t::want::type | llfio::stat_t::want::size | llfio::stat_t::want::nlink, false, multiplexer).value();
+    BOOST_REQUIRE(filled.size() == entries.size());
+    for(size_t n = 0; n < entries.size(); n++)
+    {
+      BOOST_CHECK(filled[n].has_value());
+      auto &entry = entries[n];
+      if(entry.leafname.path() == "subdir")
+      {
+        BOOST_CHECK(entry.stat.st_type == llfio::filesystem::file_type::directory);
+      }
+      else
+      {
+        BOOST_CHECK(entry.stat.st_type == llfio::filesystem::file_type::regular);
+        BOOST_CHECK(entry.stat.st_size == std::stoul(entry.leafname.path().string()) * 100);
+        BOOST_CHECK(entry.stat.st_nlink == 1);
+      }
+    }
+    // An entry which vanished since enumeration fails alone
+    llfio::file_handle::file(dh, "0").value().unlink().value();
+    filled = dh.stat_entries(entries, llfio::stat_t::want::size, true, multiplexer).value();
+    for(size_t n = 0; n < entries.size(); n++)
+    {
+      if(entries[n].leafname.path() == "0")
+      {
+        BOOST_CHECK(!filled[n] && filled[n].error() == llfio::errc::no_such_file_or_directory);
+      }
+      else
+      {
+        BOOST_CHECK(filled[n].has_value());
+      }
+    }
+    llfio::file_handle::file(dh, "0", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+  };
+  check(nullptr);
+#ifdef __linux__
+  auto multiplexer = llfio::multiplexer_linux_io_uring();
+  if(multiplexer)
+  {
+    check(multiplexer.value().get());
+  }
+#endif
+  // Filling only some metadata, and allowing cached metadata, leaves the rest alone
+  {
+    llfio::stat_t st(nullptr);
+    BOOST_CHECK(st.fill(llfio::file_handle::file(dh, "1").value(), llfio::stat_t::want::size | llfio::stat_t::want::ino, true).value() == 2);
+    BOOST_CHECK(st.st_size == 100);
+    BOOST_CHECK(st.st_ino != 0);
+    BOOST_CHECK(st.st_nlink == 0);
+  }
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, std::to_string(n)).value().unlink().value();
+  }
+  llfio::directory_handle::directory(dh, "subdir").value().unlink().value();
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_handle, stat_entries, "Tests that directory_handle::stat_entries() fills the metadata of many entries",
+                       TestDirectoryHandleStatEntries())
@@ -0,0 +1,111 @@
+/* Integration test kernel for whether directory_stream works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <set>
+
+static inline void TestDirectoryStream()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 1000;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, "file" + std::to_string(n), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+  }
+  // A small kernel buffer and few entries at a time must still yield every entry exactly once
+  auto stream = llfio::directory_stream::open(dh, {}, 4096).value();
+  std::vector<llfio::directory_stream::buffer_type> entries(7);
+  auto enumerate = [&]() {
+    std::set<std::string> seen;
+    size_t count = 0;
+    for(;;)
+    {
+      auto filled = stream.next(entries).value();
+      if(filled.empty())
+      {
+        break;
+      }
+      BOOST_CHECK(filled.size() <= entries.size());
+      for(auto &entry : filled)
+      {
+        seen.insert(entry.leafname.path().string());
+        ++count;
+      }
+    }
+    BOOST_CHECK(stream.done());
+    BOOST_CHECK(count == ENTRIES);
+    BOOST_CHECK(seen.size() == ENTRIES);
+    return seen;
+  };
+  auto first = enumerate();
+  BOOST_CHECK(first.count("file0") == 1);
+  BOOST_CHECK(first.count("file999") == 1);
+  // Once done, it stays done until restarted
+  BOOST_CHECK(stream.next(entries).value().empty());
+  stream.restart().value();
+  BOOST_CHECK(!stream.done());
+  auto second = enumerate();
+  BOOST_CHECK(first == second);
+
+  // Globs filter the entries yielded
+  auto globbed = llfio::directory_stream::open(dh, {}, 4096, "file99*").value();
+  size_t matches = 0;
+  for(auto filled = globbed.next(entries).value(); !filled.empty(); filled = globbed.next(entries).value())
+  {
+    matches += filled.size();
+  }
+  BOOST_CHECK(matches == 11);  // file99, file990 ... file999
+
+  // Each kind of glob must match as fnmatch() would
+  auto count_matching = [&](llfio::path_view glob) {
+    auto s = llfio::directory_stream::open(dh, {}, 4096, glob).value();
+    size_t count = 0;
+    for(auto filled = s.next(entries).value(); !filled.empty(); filled = s.next(entries).value())
+    {
+      count += filled.size();
+    }
+    return count;
+  };
+  BOOST_CHECK(count_matching("file123") == 1);
+  BOOST_CHECK(count_matching("file12") == 1);
+  BOOST_CHECK(count_matching("*7") == 100);
+  BOOST_CHECK(count_matching("**7") == 100);
+  BOOST_CHECK(count_matching("file5*") == 111);
+  BOOST_CHECK(count_matching("file1*0") == 11);  // file10, file100 ... file190
+  BOOST_CHECK(count_matching("file?0") == 9);
+  BOOST_CHECK(count_matching("*") == ENTRIES);
+  BOOST_CHECK(count_matching("nothing*") == 0);
+
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, "file" + std::to_string(n)).value().unlink().value();
+  }
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, directory_stream, enumerate, "Tests that directory_stream yields every entry of a directory in bounded batches",
+                       TestDirectoryStream())
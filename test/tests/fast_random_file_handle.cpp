@@ -54,6 +54,46 @@ static inline void TestFastRandomFileHandleWorks()
     }
     BOOST_CHECK(!memcmp(buffer, store.data() + offset, bytesread));
   }
+
+  // Reads large enough to be generated in parallel must match reads generated serially
+  {
+    static constexpr size_t largebytes = 2 * fast_random_file_handle::parallel_fill_threshold + 4099;
+    mapped<byte> large(largebytes);
+    fast_random_file_handle h2 = fast_random_file_handle::fast_random_file(largebytes + 3).value();
+    BOOST_CHECK(h2.read(3, {{large.data() + 1, largebytes - 1}}).value() == largebytes - 1);
+    for(size_t offset = 3; offset < largebytes + 2;)
+    {
+      byte buffer[65537];
+      const size_t length = std::min(sizeof(buffer), largebytes + 2 - offset);
+      BOOST_REQUIRE(h2.read(offset, {{buffer, length}}).value() == length);
+      BOOST_REQUIRE(!memcmp(buffer, large.data() + 1 + offset - 3, length));
+      offset += length;
+    }
+  }
+
+  // Verification of data written elsewhere must find the first corrupted byte
+  {
+    file_handle th = file_handle::temp_inode().value();
+    th.write(0, {{store.data(), store.size()}}).value();
+    BOOST_CHECK(h.find_mismatch(0, {store.data(), store.size()}) == testbytes);
+    BOOST_CHECK(h.find_mismatch(5, {store.data() + 5, 100}) == 105);
+    BOOST_CHECK(h.verify(th, {0, testbytes}, 65536).value() == testbytes);
+    BOOST_CHECK(h.verify(th, {7, testbytes - 7}, 4093).value() == testbytes);
+    const size_t corrupt = testbytes / 3 + 1;
+    byte c = store[corrupt] ^ to_byte(1);
+    th.write(corrupt, {{&c, 1}}).value();
+    BOOST_CHECK(h.verify(th, {0, testbytes}).value() == corrupt);
+    BOOST_CHECK(h.verify(th, {corrupt + 1, 1000}).value() == corrupt + 1001);
+    // A shorter handle mismatches where it ends
+    th.truncate(testbytes / 2).value();
+    BOOST_CHECK(h.verify(th, {0, testbytes}).value() == corrupt);
+    BOOST_CHECK(h.verify(th, {corrupt + 1, testbytes - corrupt - 1}).value() == testbytes / 2);
+    // Data beyond the end of the random file never matches
+    byte tail[8];
+    memcpy(tail, store.data() + testbytes - 4, 4);
+    memset(tail + 4, 0, 4);
+    BOOST_CHECK(h.find_mismatch(testbytes - 4, {tail, 8}) == testbytes);
+  }
 }
 
 static inline void TestFastRandomFileHandlePerformance()
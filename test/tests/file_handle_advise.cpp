@@ -0,0 +1,83 @@
+/* Integration test kernel for whether file_handle access pattern hints work
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestFileHandleAdvise()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using access_hint = llfio::file_handle::access_hint;
+  static constexpr size_t BLOCK = 65536, BLOCKS = 256;
+  llfio::file_handle fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(BLOCK);
+  for(size_t n = 0; n < BLOCKS; n++)
+  {
+    memset(buffer.data(), (int) (n & 0xff), buffer.size());
+    fh.write(n * BLOCK, {{buffer.data(), buffer.size()}}).value();
+  }
+
+  // Every hint must be accepted, both for a region and for the whole file
+  for(auto hint : {access_hint::normal, access_hint::sequential, access_hint::random, access_hint::willneed, access_hint::dontneed, access_hint::noreuse})
+  {
+    BOOST_CHECK(fh.advise({BLOCK, BLOCK * 4}, hint));
+    BOOST_CHECK(fh.advise({0, 0}, hint));
+  }
+  BOOST_CHECK(!fh.advise({(llfio::file_handle::extent_type) -1, 2}, access_hint::willneed));
+
+  // Drop behind mode must not affect what is read
+  BOOST_CHECK(!fh.is_drop_behind());
+  fh.set_drop_behind(true).value();
+  BOOST_CHECK(fh.is_drop_behind());
+  auto check_block = [&](size_t n) {
+    BOOST_REQUIRE(fh.read(n * BLOCK, {{buffer.data(), buffer.size()}}).value() == BLOCK);
+    for(auto b : buffer)
+    {
+      if(b != llfio::to_byte((unsigned char) (n & 0xff)))
+      {
+        BOOST_CHECK(b == llfio::to_byte((unsigned char) (n & 0xff)));
+        break;
+      }
+    }
+  };
+  // A sequential scan larger than the drop threshold
+  static_assert(BLOCK * BLOCKS > llfio::file_handle::drop_behind_threshold, "test file is too small to trigger drop behind");
+  for(size_t n = 0; n < BLOCKS; n++)
+  {
+    check_block(n);
+  }
+  // Followed by some non-contiguous reads
+  for(size_t n = 0; n < BLOCKS; n += 17)
+  {
+    check_block(n);
+  }
+  // Drop behind mode survives moves
+  llfio::file_handle fh2(std::move(fh));
+  BOOST_CHECK(fh2.is_drop_behind());
+  BOOST_CHECK(!fh.is_drop_behind());
+  fh2.set_drop_behind(false).value();
+  BOOST_CHECK(!fh2.is_drop_behind());
+  fh2.close().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, file_handle, advise, "Tests that file_handle access pattern hints and drop behind mode work", TestFileHandleAdvise())
@@ -0,0 +1,79 @@
+/* Integration test kernel for the file handle cache
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestFileHandleCache()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t ENTRIES = 64, MAX_OPEN = 8;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    auto fh = llfio::file_handle::file(dh, std::to_string(n), llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    fh.truncate(n).value();
+  }
+  llfio::algorithm::file_handle_cache cache(MAX_OPEN, ENTRIES, 1);
+  // Opening twice returns the same handle
+  auto a = cache.open(dh, "1").value();
+  BOOST_CHECK(cache.open(dh, "1").value() == a);
+  BOOST_CHECK(cache.stats().hits == 1);
+  BOOST_CHECK(cache.stats().misses == 1);
+  BOOST_CHECK(cache.open(dh, "nonexistent").error() == llfio::errc::no_such_file_or_directory);
+  // Opening more than fit evicts the least recently used
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    auto h = cache.open(dh, std::to_string(n)).value();
+    BOOST_CHECK(h->maximum_extent().value() == n);
+    BOOST_CHECK(cache.open_count() <= MAX_OPEN);
+  }
+  BOOST_CHECK(cache.stats().evictions == ENTRIES - MAX_OPEN);
+  // The evicted handle remains usable by its holder
+  BOOST_CHECK(a->maximum_extent().value() == 1);
+  // Reopening an evicted file verifies its inode
+  auto b = cache.open(dh, "2").value();
+  BOOST_CHECK(cache.stats().reopens == 1);
+  BOOST_CHECK(b->maximum_extent().value() == 2);
+  // Replacing a file whilst its handle is evicted is detected, and the next open gets the new file
+  {
+    auto fh = llfio::file_handle::file(dh, "replacement", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    fh.truncate(100).value();
+    fh.relink(dh, "1").value();
+  }
+  BOOST_CHECK(cache.open(dh, "1").error() == llfio::errc::no_such_file_or_directory);
+  BOOST_CHECK(cache.stats().replaced == 1);
+  BOOST_CHECK(cache.open(dh, "1").value()->maximum_extent().value() == 100);
+  cache.invalidate(dh, "2");
+  cache.clear();
+  BOOST_CHECK(cache.open_count() == 0);
+  a.reset();
+  b.reset();
+  for(size_t n = 0; n < ENTRIES; n++)
+  {
+    llfio::file_handle::file(dh, std::to_string(n)).value().unlink().value();
+  }
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, file_handle_cache, "Tests that algorithm::file_handle_cache works as expected", TestFileHandleCache())
@@ -60,3 +60,67 @@ static inline void TestFileHandleLockUnlock()
 }
 
 KERNELTEST_TEST_KERNEL(integration, llfio, file_handle_lock_unlock, file_handle, "Tests that llfio::file_handle's lock and unlock work as expected", TestFileHandleLockUnlock())
+
+static inline void TestFileHandleLockUnlockRanges()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using req = llfio::file_handle::extent_lock_request;
+  llfio::file_handle h1 = llfio::file_handle::file({}, "temp", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, llfio::file_handle::caching::temporary, llfio::file_handle::flag::unlink_on_first_close).value();
+  llfio::file_handle h2 = llfio::file_handle::file({}, "temp", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, llfio::file_handle::caching::temporary, llfio::file_handle::flag::unlink_on_first_close).value();
+  // Unsorted, adjacent and overlapping requests coalesce
+  {
+    const req reqs[] = {{12, 1, llfio::lock_kind::shared}, {10, 1, llfio::lock_kind::exclusive}, {11, 1, llfio::lock_kind::exclusive}, {5, 2, llfio::lock_kind::shared}, {6, 2, llfio::lock_kind::exclusive}};
+    auto extents = llfio::file_handle::coalesce_extent_lock_requests(reqs).value();
+    BOOST_REQUIRE(extents.size() == 3);
+    BOOST_CHECK(extents[0].offset == 5);
+    BOOST_CHECK(extents[0].bytes == 3);
+    BOOST_CHECK(extents[0].kind == llfio::lock_kind::exclusive);
+    BOOST_CHECK(extents[1].offset == 10);
+    BOOST_CHECK(extents[1].bytes == 2);
+    BOOST_CHECK(extents[1].kind == llfio::lock_kind::exclusive);
+    BOOST_CHECK(extents[2].offset == 12);
+    BOOST_CHECK(extents[2].bytes == 1);
+    BOOST_CHECK(extents[2].kind == llfio::lock_kind::shared);
+    const req bad[] = {{0, 0, llfio::lock_kind::shared}};
+    BOOST_CHECK(llfio::file_handle::coalesce_extent_lock_requests(bad).error() == llfio::errc::invalid_argument);
+  }
+  std::vector<req> reqs;
+  for(llfio::file_handle::extent_type n = 0; n < 50; n++)
+  {
+    reqs.push_back({(n * 7) % 50, 1, (n & 1) ? llfio::lock_kind::exclusive : llfio::lock_kind::shared});
+  }
+  {
+    auto _1 = h1.lock_file_ranges(reqs, std::chrono::seconds(0));
+    BOOST_REQUIRE(!_1.has_error());
+    if(h1.flags() & llfio::file_handle::flag::byte_lock_insanity)
+    {
+      std::cout << "This platform has byte_lock_insanity so this test won't be useful, bailing out" << std::endl;
+      return;
+    }
+    BOOST_CHECK(_1.value().extents().size() == 50);
+    // An exclusively locked entity within the set excludes others
+    auto _2 = h2.lock_file_range(1, 1, llfio::lock_kind::shared, std::chrono::seconds(0));
+    BOOST_REQUIRE(_2.has_error());
+    BOOST_CHECK(_2.error() == llfio::errc::timed_out);
+    // A shared locked entity within the set does not
+    auto _3 = h2.lock_file_range(0, 1, llfio::lock_kind::shared, std::chrono::seconds(0));
+    BOOST_REQUIRE(!_3.has_error());
+    // A failing batch leaves nothing locked behind
+    auto _4 = h1.lock_file_range(200, 1, llfio::lock_kind::exclusive, std::chrono::seconds(0));
+    BOOST_REQUIRE(!_4.has_error());
+    const req partial[] = {{200, 1, llfio::lock_kind::shared}, {100, 1, llfio::lock_kind::exclusive}};
+    auto _5 = h2.lock_file_ranges(partial, std::chrono::seconds(0));
+    BOOST_REQUIRE(_5.has_error());
+    BOOST_CHECK(_5.error() == llfio::errc::timed_out);
+    auto _6 = h1.lock_file_range(100, 1, llfio::lock_kind::exclusive, std::chrono::seconds(0));
+    BOOST_CHECK(!_6.has_error());
+  }
+  // Everything is unlocked by the guard's destruction
+  {
+    std::vector<req> all{{0, 50, llfio::lock_kind::exclusive}};
+    auto _1 = h2.lock_file_ranges(all, std::chrono::seconds(0));
+    BOOST_CHECK(!_1.has_error());
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, file_handle_lock_unlock, file_handle_ranges, "Tests that llfio::file_handle's lock_file_ranges() and unlock_file_ranges() work as expected", TestFileHandleLockUnlockRanges())
@@ -0,0 +1,87 @@
+/* Integration test kernel for whether file_handle preallocation works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestFileHandlePreallocate()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr llfio::file_handle::extent_type BLOCK = 65536, BLOCKS = 16;
+  llfio::file_handle fh = llfio::file_handle::temp_inode().value();
+
+  // Preallocating with keep_size leaves the maximum extent alone
+  auto r = fh.preallocate({0, BLOCK * BLOCKS});
+  if(!r && r.error() == llfio::errc::operation_not_supported)
+  {
+    std::cout << "NOTE: This filing system does not support preallocation, skipping test." << std::endl;
+    return;
+  }
+  BOOST_CHECK(r.value() == llfio::file_handle::extent_pair(0, BLOCK * BLOCKS));
+  BOOST_CHECK(fh.maximum_extent().value() == 0);
+  // Otherwise the file is extended, and reads as all bits zero
+  fh.preallocate({0, BLOCK * BLOCKS}, false).value();
+  BOOST_CHECK(fh.maximum_extent().value() == BLOCK * BLOCKS);
+  {
+    llfio::byte buffer[64];
+    auto readed = fh.read(BLOCK, {{buffer, sizeof(buffer)}}).value();
+    BOOST_REQUIRE(readed == sizeof(buffer));
+    for(auto b : buffer)
+    {
+      BOOST_CHECK(b == llfio::to_byte(0));
+    }
+  }
+  // Fill each block with its index
+  std::vector<llfio::byte> buffer(BLOCK);
+  for(llfio::file_handle::extent_type n = 0; n < BLOCKS; n++)
+  {
+    memset(buffer.data(), (int) n + 1, buffer.size());
+    fh.write(n * BLOCK, {{buffer.data(), buffer.size()}}).value();
+  }
+  auto block_is = [&](llfio::file_handle::extent_type block, int value) {
+    llfio::byte b[1];
+    fh.read(block * BLOCK, {{b, 1}}).value();
+    return b[0] == llfio::to_byte((unsigned char) value);
+  };
+
+  // Trim the head off like a log file would
+  auto collapsed = fh.collapse({0, BLOCK * 2});
+  if(!collapsed)
+  {
+    BOOST_CHECK(collapsed.error() == llfio::errc::operation_not_supported || collapsed.error() == llfio::errc::invalid_argument);
+    std::cout << "NOTE: This filing system does not support collapsing or inserting ranges, skipping remainder of test." << std::endl;
+    return;
+  }
+  BOOST_CHECK(collapsed.value() == BLOCK * (BLOCKS - 2));
+  BOOST_CHECK(fh.maximum_extent().value() == BLOCK * (BLOCKS - 2));
+  BOOST_CHECK(block_is(0, 3));
+  BOOST_CHECK(block_is(BLOCKS - 3, (int) BLOCKS));
+
+  // Insert a hole back in at the front
+  BOOST_CHECK(fh.insert({0, BLOCK}).value() == BLOCK * (BLOCKS - 1));
+  BOOST_CHECK(block_is(0, 0));
+  BOOST_CHECK(block_is(1, 3));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, file_handle, preallocate, "Tests that file_handle::preallocate(), collapse() and insert() work as expected",
+                       TestFileHandlePreallocate())
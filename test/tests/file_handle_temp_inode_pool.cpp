@@ -0,0 +1,73 @@
+/* Integration test kernel for whether pools of temporary inodes work
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <set>
+#include <thread>
+
+static inline void TestFileHandleTempInodePool()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t COUNT = 64;
+  auto &tempdirh = llfio::path_discovery::storage_backed_temporary_files_directory();
+  llfio::file_handle::reserve_temp_inodes(tempdirh, COUNT).value();
+  // Every inode taken is distinct, usable and empty, including those created after the pool empties
+  std::vector<llfio::file_handle> fhs;
+  std::set<decltype(llfio::stat_t::st_ino)> inodes;
+  auto begin = std::chrono::steady_clock::now();
+  for(size_t n = 0; n < COUNT * 4; n++)
+  {
+    fhs.push_back(llfio::file_handle::temp_inode(tempdirh).value());
+    BOOST_REQUIRE(fhs.back().is_valid());
+    BOOST_CHECK(fhs.back().maximum_extent().value() == 0);
+    llfio::stat_t st(nullptr);
+    st.fill(fhs.back()).value();
+    inodes.insert(st.st_ino);
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "Took " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / (COUNT * 4.0) << " us per temporary inode." << std::endl;
+  BOOST_CHECK(inodes.size() == fhs.size());
+  fhs.front().write(0, {{(const llfio::byte *) "hello", 5}}).value();
+  BOOST_CHECK(fhs.front().maximum_extent().value() == 5);
+  // Sections are backed by pooled inodes too
+  auto sh = llfio::section_handle::section(65536, tempdirh).value();
+  BOOST_CHECK(sh.length().value() == 65536);
+  // Non default modes and flags bypass the pool
+  auto rfh = llfio::file_handle::temp_inode(tempdirh, llfio::file_handle::mode::read).value();
+  BOOST_CHECK(!rfh.is_writable());
+  fhs.clear();
+  // The pool is refilled in the background
+  begin = std::chrono::steady_clock::now();
+  while(llfio::detail::temp_inode_pools().pools[0].load()->size() < COUNT)
+  {
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  llfio::file_handle::release_temp_inodes(tempdirh);
+  BOOST_CHECK(llfio::detail::temp_inode_pools().active.load() == 0);
+  BOOST_CHECK(llfio::file_handle::temp_inode(tempdirh).value().is_valid());
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, file_handle, temp_inode_pool, "Tests that pools of temporary inodes work as expected", TestFileHandleTempInodePool())
@@ -0,0 +1,77 @@
+/* Integration test kernel for whether file_handle::zero_extents() works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestFileHandleZeroExtents()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr llfio::file_handle::extent_type BLOCK = 65536, BLOCKS = 16;
+  llfio::file_handle fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(BLOCK);
+  auto fill = [&] {
+    for(llfio::file_handle::extent_type n = 0; n < BLOCKS; n++)
+    {
+      memset(buffer.data(), (int) n + 1, buffer.size());
+      fh.write(n * BLOCK, {{buffer.data(), buffer.size()}}).value();
+    }
+  };
+  auto block_is = [&](llfio::file_handle::extent_type block, int value) {
+    llfio::byte b[1];
+    fh.read(block * BLOCK + BLOCK / 2, {{b, 1}}).value();
+    return b[0] == llfio::to_byte((unsigned char) value);
+  };
+  // Every other block
+  std::vector<llfio::file_handle::extent_pair> extents;
+  for(llfio::file_handle::extent_type n = 0; n < BLOCKS; n += 2)
+  {
+    extents.emplace_back(n * BLOCK, BLOCK);
+  }
+
+  // Zeroing zeroes every region, and leaves the rest alone
+  fill();
+  BOOST_CHECK(fh.zero_extents(extents).value() == BLOCK * BLOCKS / 2);
+  for(llfio::file_handle::extent_type n = 0; n < BLOCKS; n++)
+  {
+    BOOST_CHECK(block_is(n, (n % 2) ? (int) n + 1 : 0));
+  }
+  BOOST_CHECK(fh.maximum_extent().value() == BLOCK * BLOCKS);
+
+  // Discarding never writes, and never touches the rest
+  fill();
+  auto discarded = fh.zero_extents(extents, true).value();
+  std::cout << "Discarded " << discarded << " of " << (BLOCK * BLOCKS / 2) << " bytes." << std::endl;
+  BOOST_CHECK(discarded <= BLOCK * BLOCKS / 2);
+  for(llfio::file_handle::extent_type n = 1; n < BLOCKS; n += 2)
+  {
+    BOOST_CHECK(block_is(n, (int) n + 1));
+  }
+  BOOST_CHECK(fh.maximum_extent().value() == BLOCK * BLOCKS);
+
+  // Nothing to do is not an error
+  BOOST_CHECK(fh.zero_extents({}, true).value() == 0);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, file_handle, zero_extents, "Tests that file_handle::zero_extents() works as expected", TestFileHandleZeroExtents())
@@ -0,0 +1,127 @@
+/* Integration test kernel for algorithm::find_in_files
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+
+static inline void TestFindSubstring()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  std::mt19937 rand(78);
+  for(size_t n = 0; n < 100000; n++)
+  {
+    // A small alphabet makes partial matches common
+    std::string haystack(rand() % 200, 0), needle(1 + rand() % 8, 0);
+    for(auto &c : haystack)
+    {
+      c = (char) ('a' + rand() % 3);
+    }
+    for(auto &c : needle)
+    {
+      c = (char) ('a' + rand() % 3);
+    }
+    const auto expected = haystack.find(needle);
+    const auto found = llfio::algorithm::find_substring({(const llfio::byte *) haystack.data(), haystack.size()}, {(const llfio::byte *) needle.data(), needle.size()});
+    BOOST_REQUIRE(found == ((expected == std::string::npos) ? (size_t) -1 : expected));
+  }
+}
+
+static inline void TestFindInFiles()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto write_file = [](const llfio::path_handle &base, llfio::path_view path, const std::string &contents) {
+    auto fh = llfio::file_handle::file(base, path, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    fh.write(0, {{(const llfio::byte *) contents.data(), contents.size()}}).value();
+  };
+  std::string big(100000, 'x');
+  big.replace(0, 6, "needle");
+  big.replace(15, 6, "needle");
+  big.replace(big.size() - 6, 6, "needle");
+  write_file(dh, "a", "a needle in a haystack, and another needle");
+  write_file(dh, "b", "no match here, just needl");
+  write_file(dh, "empty", "");
+  auto sub = llfio::directory_handle::directory(dh, "sub", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  write_file(sub, "big", big);
+  write_file(sub, "overlapping", "needleedleedle");
+
+  struct visitor_type : llfio::algorithm::find_in_files_visitor
+  {
+    std::mutex lock;
+    std::map<std::string, std::vector<size_t>> found;
+    bool first_only{false};
+    virtual llfio::result<bool> match_found(void *data, const llfio::directory_handle &dirh, llfio::path_view leafname, llfio::span<const llfio::byte> contents,
+                                            size_t offset) noexcept override
+    {
+      (void) data;
+      (void) dirh;
+      BOOST_CHECK(memcmp(contents.data() + offset, "needle", 6) == 0);
+      std::lock_guard<std::mutex> g(lock);
+      found[leafname.path().string()].push_back(offset);
+      return !first_only;
+    }
+  };
+  const std::string needle("needle");
+  // Both the read path, and the mapped path
+  for(llfio::handle::extent_type threshold : {(llfio::handle::extent_type) 1 << 30U, (llfio::handle::extent_type) 4096})
+  {
+    visitor_type visitor;
+    auto summary = llfio::algorithm::find_in_files(dh, {(const llfio::byte *) needle.data(), needle.size()}, &visitor, 0, threshold).value();
+    BOOST_CHECK(summary.files_searched == 5);
+    BOOST_CHECK(summary.files_matched == 3);
+    BOOST_CHECK(summary.files_failed == 0);
+    BOOST_CHECK(summary.matches == 6);
+    BOOST_CHECK(summary.bytes_searched == 42 + 25 + big.size() + 14);
+    BOOST_CHECK(visitor.found.size() == 3);
+    BOOST_CHECK(visitor.found["a"] == (std::vector<size_t>{2, 36}));
+    BOOST_CHECK(visitor.found["big"] == (std::vector<size_t>{0, 15, big.size() - 6}));
+    BOOST_CHECK(visitor.found["overlapping"] == (std::vector<size_t>{0}));
+  }
+  // Overlapping matches are all found
+  {
+    const std::string eedle("eedle");
+    auto summary = llfio::algorithm::find_in_files(dh, {(const llfio::byte *) eedle.data(), eedle.size()}).value();
+    BOOST_CHECK(summary.matches == 6 + 2);
+  }
+  // Visitors can stop the search of a file
+  {
+    visitor_type visitor;
+    visitor.first_only = true;
+    auto summary = llfio::algorithm::find_in_files(dh, {(const llfio::byte *) needle.data(), needle.size()}, &visitor).value();
+    BOOST_CHECK(summary.matches == 3);
+    BOOST_CHECK(visitor.found["big"] == (std::vector<size_t>{0}));
+  }
+  BOOST_CHECK(!llfio::algorithm::find_in_files(dh, {}));
+  llfio::algorithm::reduce(std::move(dh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, find_substring, "Tests that algorithm::find_substring() finds the same as std::string::find()",
+                       TestFindSubstring())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, find_in_files, "Tests that algorithm::find_in_files() finds every occurrence in every file",
+                       TestFindInFiles())
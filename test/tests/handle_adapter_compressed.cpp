@@ -0,0 +1,149 @@
+/* Integration test kernel for whether the compressed handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestCompressedHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  // Encodes runs of up to 255 identical bytes as a count followed by the byte
+  struct rle_codec
+  {
+    size_t compress_bound(size_t bytes) const noexcept { return bytes * 2; }
+    result<size_t> compress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      size_t o = 0;
+      for(size_t i = 0; i < inbytes;)
+      {
+        size_t run = 1;
+        while(run < 255 && i + run < inbytes && in[i + run] == in[i])
+        {
+          run++;
+        }
+        if(o + 2 > outbytes)
+        {
+          return errc::no_buffer_space;
+        }
+        out[o++] = (byte) run;
+        out[o++] = in[i];
+        i += run;
+      }
+      return o;
+    }
+    result<void> decompress(byte *out, size_t outbytes, const byte *in, size_t inbytes) const noexcept
+    {
+      size_t o = 0;
+      for(size_t i = 0; i + 1 < inbytes; i += 2)
+      {
+        const size_t run = (size_t) in[i];
+        if(o + run > outbytes)
+        {
+          return errc::illegal_byte_sequence;
+        }
+        memset(out + o, (int) in[i + 1], run);
+        o += run;
+      }
+      if(o != outbytes)
+      {
+        return errc::illegal_byte_sequence;
+      }
+      return success();
+    }
+  };
+  using adapter_type = algorithm::compressed_handle_adapter<rle_codec, file_handle>;
+  file_handle data = file_handle::temp_inode().value(), index = file_handle::temp_inode().value();
+  BOOST_CHECK(adapter_type::compressed(&data, &index, {}, 0).error() == errc::invalid_argument);
+  adapter_type h = adapter_type::compressed(&data, &index, {}, 4096).value();
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.block_size() == 4096);
+  BOOST_CHECK(h.maximum_extent().value() == 0);
+
+  // Highly compressible data, with some random blocks which will be stored uncompressed
+  std::vector<byte> plain(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(size_t n = 0; n < testbytes; n += 4096)
+  {
+    const bool random = (rand() % 8) == 0;
+    for(size_t i = 0; i < 4096; i++)
+    {
+      plain[n + i] = random ? (byte) rand() : (byte)((n + i) / 1000);
+    }
+  }
+  BOOST_CHECK(h.write(0, {{plain.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(h.maximum_extent().value() == testbytes);
+  BOOST_CHECK(data.maximum_extent().value() < testbytes / 2);
+
+  // Random reads, including those off the end, decompress only what they touch
+  for(size_t i = 0; i < 1000; i++)
+  {
+    const size_t offset = rand() % testbytes, length1 = rand() % 100000, length2 = rand() % 100;
+    memset(buffer.data(), 0, length1 + length2);
+    adapter_type::buffer_type reqs[2] = {{buffer.data(), length1}, {buffer.data() + length1, length2}};
+    auto bytesread = h.read({reqs, offset}).value();
+    const size_t expected = (std::min)(length1 + length2, testbytes - offset);
+    size_t total = 0;
+    for(auto &b : bytesread)
+    {
+      total += b.size();
+    }
+    BOOST_CHECK(total == expected);
+    BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + offset, expected));
+  }
+
+  // Unaligned gather writes rewrite the blocks they partially cover
+  {
+    const size_t offset = 12345, length1 = 70001, length2 = 99;
+    adapter_type::const_buffer_type reqs[2] = {{buffer.data(), length1}, {buffer.data() + length1, length2}};
+    for(size_t n = 0; n < length1 + length2; n++)
+    {
+      buffer[n] = plain[offset + n] = (byte) 0xee;
+    }
+    BOOST_CHECK(h.write({reqs, offset}).value().size() == 2);
+    BOOST_CHECK(h.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+    BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+  }
+
+  // Shrinking zeros the partial block past the new size, and regrowing reads zeros
+  BOOST_CHECK(h.truncate(testbytes / 2 + 3).value() == testbytes / 2 + 3);
+  BOOST_CHECK(h.truncate(testbytes).value() == testbytes);
+  std::fill(plain.begin() + testbytes / 2 + 3, plain.end(), (byte) 0);
+  BOOST_CHECK(h.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+
+  // Reopening the index restores the adapter
+  BOOST_CHECK(adapter_type::compressed(&data, &index, {}, 8192).error() == errc::invalid_argument);
+  adapter_type h2 = adapter_type::compressed(&data, &index, {}, 4096).value();
+  BOOST_CHECK(h2.maximum_extent().value() == testbytes);
+  memset(buffer.data(), 1, testbytes);
+  BOOST_CHECK(h2.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, compressed_handle_adapter, works, "Tests that the compressed handle adapter works as expected", TestCompressedHandleAdapterWorks())
@@ -0,0 +1,109 @@
+/* Integration test kernel for whether the direct i/o handle adapter works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestDirectIOHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL;
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  // Not all filing systems support direct i/o, in which case all i/o passes straight through
+  auto r = llfio::algorithm::direct_io<llfio::file_handle>({}, "direct_io_testfile", llfio::file_handle::mode::write, llfio::file_handle::creation::always_new,
+                                                           llfio::file_handle::caching::none, llfio::file_handle::flag::unlink_on_first_close);
+  if(!r)
+  {
+    std::cout << "NOTE: This filing system does not support direct i/o, testing adapter pass through instead." << std::endl;
+    r = llfio::algorithm::direct_io<llfio::file_handle>({}, "direct_io_testfile", llfio::file_handle::mode::write, llfio::file_handle::creation::always_new,
+                                                        llfio::file_handle::caching::all, llfio::file_handle::flag::unlink_on_first_close);
+  }
+  auto h = std::move(r).value();
+  std::cout << "Direct i/o required: " << h.requires_aligned_io() << " memory alignment: " << h.memory_alignment()
+            << " offset alignment: " << h.offset_alignment() << std::endl;
+  BOOST_CHECK((h.memory_alignment() & (h.memory_alignment() - 1)) == 0);
+  BOOST_CHECK((h.offset_alignment() & (h.offset_alignment() - 1)) == 0);
+
+  // Aligned buffers pass straight through
+  size_t bytes = 1000;
+  auto aligned = h.allocate_aligned_buffer(bytes).value();
+  BOOST_CHECK(bytes >= 1000);
+  BOOST_CHECK((bytes & (h.offset_alignment() - 1)) == 0);
+  BOOST_CHECK((((uintptr_t) aligned->data()) & (h.memory_alignment() - 1)) == 0);
+  memset(aligned->data(), 'a', bytes);
+  BOOST_CHECK(h.write(0, {{aligned->data(), bytes}}).value() == bytes);
+  std::vector<byte> shadow(bytes, llfio::to_byte('a'));
+  BOOST_CHECK(h.maximum_extent().value() == bytes);
+
+  // Lots of randomly sized and placed unaligned writes, with the shadow copy kept in sync
+  small_prng rand;
+  std::vector<byte> buffer(8193), readback(testbytes);
+  for(size_t i = 0; i < 1000; i++)
+  {
+    const size_t offset = rand() % (testbytes - buffer.size()), length = 1 + rand() % (buffer.size() - 1);
+    for(size_t n = 0; n < length; n++)
+    {
+      buffer[n] = llfio::to_byte(static_cast<uint8_t>(rand()));
+    }
+    // Use the unaligned pointer one into the buffer half the time
+    const size_t adjust = (i & 1) ? 1 : 0;
+    const size_t towrite = std::min(length, buffer.size() - adjust);
+    BOOST_REQUIRE(h.write(offset, {{buffer.data() + adjust, towrite}}).value() == towrite);
+    if(shadow.size() < offset + towrite)
+    {
+      shadow.resize(offset + towrite, llfio::to_byte(0));
+    }
+    memcpy(shadow.data() + offset, buffer.data() + adjust, towrite);
+    // The file must never be extended beyond what was written
+    BOOST_REQUIRE(h.maximum_extent().value() == shadow.size());
+  }
+
+  // Unaligned reads of the whole file and random pieces must match the shadow
+  BOOST_CHECK(h.read(1, {{readback.data(), readback.size()}}).value() == shadow.size() - 1);
+  BOOST_CHECK(0 == memcmp(readback.data(), shadow.data() + 1, shadow.size() - 1));
+  for(size_t i = 0; i < 1000; i++)
+  {
+    const size_t offset = rand() % shadow.size(), length = rand() % 8193;
+    const size_t expected = std::min(length, shadow.size() - offset);
+    BOOST_REQUIRE(h.read(offset, {{readback.data() + 3, length}}).value() == expected);
+    BOOST_CHECK(0 == memcmp(readback.data() + 3, shadow.data() + offset, expected));
+  }
+
+  // Scatter gather of several unaligned buffers
+  byte a[7], b[4097], c[13];
+  memset(a, 1, sizeof(a));
+  memset(b, 2, sizeof(b));
+  memset(c, 3, sizeof(c));
+  BOOST_CHECK(h.write(5, {{a, sizeof(a)}, {b, sizeof(b)}, {c, sizeof(c)}}).value() == sizeof(a) + sizeof(b) + sizeof(c));
+  byte d[sizeof(a) + sizeof(b) + sizeof(c)];
+  BOOST_CHECK(h.read(5, {{d, sizeof(d)}}).value() == sizeof(d));
+  BOOST_CHECK(0 == memcmp(d, a, sizeof(a)));
+  BOOST_CHECK(0 == memcmp(d + sizeof(a), b, sizeof(b)));
+  BOOST_CHECK(0 == memcmp(d + sizeof(a) + sizeof(b), c, sizeof(c)));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, handle_adapter_direct_io, works, "Tests that the direct i/o handle adapter performs unaligned i/o correctly",
+                       TestDirectIOHandleAdapterWorks())
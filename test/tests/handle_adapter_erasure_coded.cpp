@@ -0,0 +1,105 @@
+/* Integration test kernel for whether the erasure coded handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestErasureCodedHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  using adapter_type = algorithm::erasure_coded_handle_adapter<file_handle>;
+  file_handle fhs[6];
+  file_handle *data[4], *parity[2];
+  for(size_t n = 0; n < 6; n++)
+  {
+    fhs[n] = file_handle::temp_inode().value();
+    ((n < 4) ? data[n] : parity[n - 4]) = &fhs[n];
+  }
+  BOOST_CHECK(adapter_type::erasure_coded({}, parity).error() == errc::invalid_argument);
+  adapter_type h = adapter_type::erasure_coded(data, parity, 4096).value();
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.data_handles() == 4);
+  BOOST_CHECK(h.parity_handles() == 2);
+
+  // Write at an offset not aligned to stripes, so partial stripes are read first
+  std::vector<byte> plain(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(auto &i : plain)
+  {
+    i = (byte) rand();
+  }
+  const size_t offset = 1001;
+  BOOST_CHECK(h.write(offset, {{plain.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(h.read(offset, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+  // Never written regions read as zeros
+  memset(buffer.data(), 1, offset);
+  BOOST_CHECK(h.read(0, {{buffer.data(), offset}}).value() == offset);
+  BOOST_CHECK(std::all_of(buffer.data(), buffer.data() + offset, [](byte v) { return v == (byte) 0; }));
+
+  // The first parity handle is the XOR of the data handles
+  {
+    const size_t bytes = (size_t) fhs[0].maximum_extent().value();
+    std::vector<byte> x(bytes), y(bytes);
+    BOOST_CHECK(fhs[4].read(0, {{x.data(), bytes}}).value() == bytes);
+    for(size_t n = 0; n < 4; n++)
+    {
+      BOOST_CHECK(fhs[n].read(0, {{y.data(), bytes}}).value() == bytes);
+      for(size_t i = 0; i < bytes; i++)
+      {
+        x[i] ^= y[i];
+      }
+    }
+    BOOST_CHECK(std::all_of(x.begin(), x.end(), [](byte v) { return v == (byte) 0; }));
+  }
+
+  // Losing any two handles still reads back the data
+  auto check_random_reads = [&] {
+    for(size_t i = 0; i < 100; i++)
+    {
+      const size_t _offset = offset + rand() % (testbytes - 100000), length = rand() % 100000;
+      if(h.read(_offset, {{buffer.data(), length}}).value() != length)
+      {
+        BOOST_CHECK(false);
+      }
+      BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + _offset - offset, length));
+    }
+  };
+  fhs[1].close().value();
+  check_random_reads();
+  fhs[4].close().value();
+  check_random_reads();
+  // But not three
+  fhs[2].close().value();
+  BOOST_CHECK(h.read(offset, {{buffer.data(), 100}}).has_error());
+  // Writes fail if any handle fails
+  BOOST_CHECK(h.write(offset, {{plain.data(), 100}}).has_error());
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, erasure_coded_handle_adapter, works, "Tests that the erasure coded handle adapter works as expected", TestErasureCodedHandleAdapterWorks())
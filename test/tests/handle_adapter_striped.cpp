@@ -0,0 +1,104 @@
+/* Integration test kernel for whether the striped handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestStripedHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL, unit = 4096;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  using adapter_type = algorithm::striped_handle_adapter<file_handle>;
+  file_handle fhs[4];
+  file_handle *handles[4];
+  for(size_t n = 0; n < 4; n++)
+  {
+    fhs[n] = file_handle::temp_inode().value();
+    handles[n] = &fhs[n];
+  }
+  BOOST_CHECK(adapter_type::striped(handles, 0).error() == errc::invalid_argument);
+  adapter_type h = adapter_type::striped(handles, unit).value();
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.backing_handles() == 4);
+  BOOST_CHECK(h.maximum_extent().value() == 0);
+
+  // Gather write at an offset not aligned to stripes
+  std::vector<byte> plain(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(auto &i : plain)
+  {
+    i = (byte) rand();
+  }
+  const size_t offset = 1001, split = 77777;
+  {
+    adapter_type::const_buffer_type reqs[2] = {{plain.data(), split}, {plain.data() + split, testbytes - split}};
+    auto written = h.write({reqs, offset}).value();
+    BOOST_CHECK(written.size() == 2);
+    BOOST_CHECK(written[0].size() == split);
+    BOOST_CHECK(written[1].size() == testbytes - split);
+  }
+  BOOST_CHECK(h.maximum_extent().value() == offset + testbytes);
+
+  // Each backing handle holds every fourth stripe unit
+  for(size_t n = 0; n < 4; n++)
+  {
+    byte b[16];
+    // The first byte written to backing handle n
+    const size_t logical = (n == 0) ? offset : n * unit;
+    BOOST_CHECK(fhs[n].read((n == 0) ? offset : 0, {{b, 16}}).value() == 16);
+    BOOST_CHECK(0 == memcmp(b, plain.data() + logical - offset, 16));
+  }
+
+  // Scatter reads at random offsets, including those off the end, return the data written
+  for(size_t i = 0; i < 1000; i++)
+  {
+    const size_t _offset = rand() % (offset + testbytes), length1 = rand() % 100000, length2 = rand() % 100;
+    adapter_type::buffer_type reqs[2] = {{buffer.data(), length1}, {buffer.data() + length1, length2}};
+    auto read = h.read({reqs, _offset}).value();
+    const size_t expected = (std::min)(length1 + length2, offset + testbytes - _offset);
+    size_t total = 0;
+    for(auto &b : read)
+    {
+      total += b.size();
+    }
+    BOOST_CHECK(total == expected);
+    if(_offset >= offset)
+    {
+      BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + _offset - offset, expected));
+    }
+  }
+
+  // Truncation shortens each backing handle to its part
+  BOOST_CHECK(h.truncate(offset + 3 * unit).value() == offset + 3 * unit);
+  BOOST_CHECK(h.maximum_extent().value() == offset + 3 * unit);
+  BOOST_CHECK(fhs[0].maximum_extent().value() == unit);
+  BOOST_CHECK(fhs[3].maximum_extent().value() == offset);
+  BOOST_CHECK(h.read(0, {{buffer.data(), testbytes}}).value() == offset + 3 * unit);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, striped_handle_adapter, works, "Tests that the striped handle adapter works as expected", TestStripedHandleAdapterWorks())
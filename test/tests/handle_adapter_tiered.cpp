@@ -0,0 +1,152 @@
+/* Integration test kernel for whether the tiered handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestTieredHandleAdapterWorks()
+{
+  static constexpr size_t extentbytes = 65536, testbytes = 16 * extentbytes;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  using adapter_type = algorithm::tiered_handle_adapter<file_handle>;
+  file_handle fast = file_handle::temp_inode().value(), slow = file_handle::temp_inode().value();
+  BOOST_CHECK(adapter_type::tiered(&fast, &slow, testbytes, 1000).error() == errc::invalid_argument);
+  BOOST_CHECK(adapter_type::tiered(&fast, &slow, testbytes, extentbytes, 0).error() == errc::invalid_argument);
+  std::vector<byte> plain(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(auto &i : plain)
+  {
+    i = (byte) rand();
+  }
+  BOOST_REQUIRE(slow.write(0, {{plain.data(), testbytes}}).value() == testbytes);
+  // The fast tier holds two extents, each promoted after four accesses
+  fast.truncate(12345).value();
+  adapter_type h = adapter_type::tiered(&fast, &slow, 2 * extentbytes, extentbytes, 4).value();
+  BOOST_CHECK(fast.maximum_extent().value() == 0);
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.extent_size() == extentbytes);
+  BOOST_CHECK(h.fast_extents() == 2);
+  BOOST_CHECK(h.maximum_extent().value() == testbytes);
+
+  // Reads spanning extents are served whole, and nothing migrates until migrate() is called
+  BOOST_CHECK(h.read(100, {{buffer.data(), testbytes}}).value() == testbytes - 100);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 100, testbytes - 100));
+  for(size_t n = 0; n < 4; n++)
+  {
+    BOOST_CHECK(h.read(3 * extentbytes + 10, {{buffer.data(), 10}}).value() == 10);
+  }
+  BOOST_CHECK(h.queued_extents() == 1);
+  BOOST_CHECK(!h.is_promoted(3 * extentbytes));
+  BOOST_CHECK(h.migrate().value() == 1);
+  BOOST_CHECK(h.is_promoted(3 * extentbytes));
+  BOOST_CHECK(h.promoted_extents() == 1);
+  BOOST_CHECK(fast.maximum_extent().value() == 4 * extentbytes);
+
+  // Promoted extents are read from and written to the fast tier only, until flushed
+  BOOST_CHECK(h.read(3 * extentbytes, {{buffer.data(), extentbytes}}).value() == extentbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 3 * extentbytes, extentbytes));
+  for(size_t n = 0; n < 100; n++)
+  {
+    plain[3 * extentbytes + n] = (byte) rand();
+  }
+  BOOST_CHECK(h.write(3 * extentbytes, {{plain.data() + 3 * extentbytes, 100}}).value() == 100);
+  BOOST_CHECK(slow.read(3 * extentbytes, {{buffer.data(), 100}}).value() == 100);
+  BOOST_CHECK(0 != memcmp(buffer.data(), plain.data() + 3 * extentbytes, 100));
+  BOOST_CHECK(fast.read(3 * extentbytes, {{buffer.data(), 100}}).value() == 100);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 3 * extentbytes, 100));
+  h.flush().value();
+  BOOST_CHECK(slow.read(3 * extentbytes, {{buffer.data(), 100}}).value() == 100);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 3 * extentbytes, 100));
+
+  // Hotter extents displace the coldest when the fast tier is full, writing it back first
+  for(size_t n = 0; n < 100; n++)
+  {
+    plain[3 * extentbytes + n] = (byte) rand();
+  }
+  BOOST_CHECK(h.write(3 * extentbytes, {{plain.data() + 3 * extentbytes, 100}}).value() == 100);
+  for(size_t n = 0; n < 20; n++)
+  {
+    BOOST_CHECK(h.read(5 * extentbytes, {{buffer.data(), 10}}).value() == 10);
+    BOOST_CHECK(h.read(7 * extentbytes, {{buffer.data(), 10}}).value() == 10);
+  }
+  BOOST_CHECK(h.migrate().value() == 2);
+  BOOST_CHECK(h.promoted_extents() == 2);
+  BOOST_CHECK(h.is_promoted(5 * extentbytes));
+  BOOST_CHECK(h.is_promoted(7 * extentbytes));
+  BOOST_CHECK(!h.is_promoted(3 * extentbytes));
+  BOOST_CHECK(slow.read(3 * extentbytes, {{buffer.data(), 100}}).value() == 100);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 3 * extentbytes, 100));
+
+  // Writes extending the file extend the slow tier, and are seen whichever tier serves them
+  BOOST_CHECK(h.write(testbytes - 10, {{plain.data(), 20}}).value() == 20);
+  BOOST_CHECK(h.maximum_extent().value() == testbytes + 10);
+  BOOST_CHECK(slow.maximum_extent().value() == testbytes + 10);
+  memcpy(plain.data() + testbytes - 10, plain.data(), 10);
+  for(size_t n = 0; n < 1000; n++)
+  {
+    const size_t offset = rand() % (testbytes - 64), length = 1 + rand() % 64;
+    for(size_t i = 0; i < length; i++)
+    {
+      plain[offset + i] = (byte) rand();
+    }
+    BOOST_CHECK(h.write(offset, {{plain.data() + offset, length}}).value() == length);
+    if((n % 100) == 0)
+    {
+      h.migrate().value();
+    }
+  }
+  BOOST_CHECK(h.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+  h.barrier().value();
+  BOOST_CHECK(slow.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+
+  // Truncation demotes the extent straddling the new size, then growing exposes zeros
+  BOOST_CHECK(h.truncate(7 * extentbytes + 3).value() == 7 * extentbytes + 3);
+  BOOST_CHECK(!h.is_promoted(7 * extentbytes));
+  BOOST_CHECK(slow.maximum_extent().value() == 7 * extentbytes + 3);
+  BOOST_CHECK(h.truncate(8 * extentbytes).value() == 8 * extentbytes);
+  BOOST_CHECK(h.read(7 * extentbytes, {{buffer.data(), extentbytes}}).value() == extentbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + 7 * extentbytes, 3));
+  BOOST_CHECK(std::all_of(buffer.data() + 3, buffer.data() + extentbytes, [](byte v) { return v == (byte) 0; }));
+
+  // Destruction flushes
+  for(size_t n = 0; n < 40; n++)
+  {
+    h.read(0, {{buffer.data(), 1}}).value();
+  }
+  h.migrate().value();
+  BOOST_CHECK(h.is_promoted(0));
+  BOOST_CHECK(h.write(0, {{plain.data() + 1, 1}}).value() == 1);
+  h = {};
+  BOOST_CHECK(slow.read(0, {{buffer.data(), 1}}).value() == 1);
+  BOOST_CHECK(buffer[0] == plain[1]);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, tiered_handle_adapter, works, "Tests that the tiered handle adapter works as expected", TestTieredHandleAdapterWorks())
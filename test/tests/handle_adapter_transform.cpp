@@ -0,0 +1,126 @@
+/* Integration test kernel for whether the transform handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestTransformHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  // Scrambles each byte with a key depending on its offset, and counts calls
+  struct scrambler
+  {
+    uint8_t key{0};
+    size_t calls{0};
+    extent_type last_offset{0};
+
+    explicit scrambler(uint8_t _key)
+        : key(_key)
+    {
+    }
+    result<void> _do(byte *out, const byte *in, size_t bytes, extent_type offset) noexcept
+    {
+      calls++;
+      last_offset = offset;
+      for(size_t n = 0; n < bytes; n++)
+      {
+        out[n] = in[n] ^ (byte)(key + (uint8_t)(offset + n));
+      }
+      return success();
+    }
+    result<void> decode(byte *out, const byte *in, size_t bytes, extent_type offset) noexcept { return _do(out, in, bytes, offset); }
+    result<void> encode(byte *out, const byte *in, size_t bytes, extent_type offset) noexcept { return _do(out, in, bytes, offset); }
+  };
+  file_handle fh = file_handle::temp_inode().value();
+  fh.truncate(testbytes).value();
+  using adapter_type = algorithm::transform_handle_adapter<scrambler, file_handle>;
+  adapter_type h(&fh, nullptr, adapter_type::mode::write, adapter_type::flag::none, nullptr, (uint8_t) 78);
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.maximum_extent().value() == testbytes);
+  BOOST_CHECK(h.transform().key == 78);
+
+  // Write the whole file through the adapter, which should take many chunks
+  std::vector<byte> plain(testbytes), raw(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(auto &i : plain)
+  {
+    i = (byte) rand();
+  }
+  BOOST_CHECK(h.write(0, {{plain.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(h.transform().calls == testbytes / adapter_type::pipeline_bytes);
+  BOOST_CHECK(h.transform().last_offset == testbytes - adapter_type::pipeline_bytes);
+
+  // The file should contain the scrambled data
+  BOOST_CHECK(fh.read(0, {{raw.data(), testbytes}}).value() == testbytes);
+  for(size_t n = 0; n < testbytes; n++)
+  {
+    if(raw[n] != (plain[n] ^ (byte)(78 + (uint8_t) n)))
+    {
+      BOOST_CHECK(raw[n] == (plain[n] ^ (byte)(78 + (uint8_t) n)));
+      break;
+    }
+  }
+
+  // Scatter reads at random offsets, including those off the end, should restore the plain data
+  for(size_t i = 0; i < 1000; i++)
+  {
+    size_t offset = rand() % testbytes, length1 = rand() % 100000, length2 = rand() % 100;
+    memset(buffer.data(), 0, length1 + length2);
+    adapter_type::buffer_type reqs[2] = {{buffer.data(), length1}, {buffer.data() + length1, length2}};
+    auto bytesread = h.read({reqs, offset}).value();
+    const size_t expected = (std::min)(length1 + length2, testbytes - offset);
+    size_t total = 0;
+    for(auto &b : bytesread)
+    {
+      total += b.size();
+    }
+    BOOST_CHECK(total == expected);
+    BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + offset, expected));
+  }
+
+  // Gather writes at an unaligned offset should scramble only what they cover
+  {
+    const size_t offset = 12345, length1 = 70001, length2 = 99;
+    memset(buffer.data(), 0, length1 + length2);
+    adapter_type::const_buffer_type reqs[2] = {{buffer.data(), length1}, {buffer.data() + length1, length2}};
+    BOOST_CHECK(h.write({reqs, offset}).value().size() == 2);
+    BOOST_CHECK(fh.read(0, {{raw.data(), testbytes}}).value() == testbytes);
+    for(size_t n = 0; n < testbytes; n++)
+    {
+      const byte expected = (n >= offset && n < offset + length1 + length2) ? (byte)(78 + (uint8_t) n) : (plain[n] ^ (byte)(78 + (uint8_t) n));
+      if(raw[n] != expected)
+      {
+        BOOST_CHECK(raw[n] == expected);
+        break;
+      }
+    }
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, transform_handle_adapter, works, "Tests that the transform handle adapter works as expected", TestTransformHandleAdapterWorks())
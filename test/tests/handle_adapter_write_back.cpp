@@ -0,0 +1,105 @@
+/* Integration test kernel for whether the write back handle adapter works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "quickcpplib/algorithm/small_prng.hpp"
+
+static inline void TestWriteBackHandleAdapterWorks()
+{
+  static constexpr size_t testbytes = 1024 * 1024UL;
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using QUICKCPPLIB_NAMESPACE::algorithm::small_prng::small_prng;
+  using adapter_type = algorithm::write_back_handle_adapter<file_handle>;
+  file_handle fh = file_handle::temp_inode().value();
+  BOOST_CHECK(adapter_type::write_back(&fh, 65536, 1000).error() == errc::invalid_argument);
+  // Cache a quarter of the file, so blocks get evicted and flushed
+  adapter_type h = adapter_type::write_back(&fh, testbytes / 4).value();
+  BOOST_CHECK(h.is_readable());
+  BOOST_CHECK(h.is_writable());
+  BOOST_CHECK(h.block_size() == utils::page_size());
+  BOOST_CHECK(h.cache_bytes() == testbytes / 4);
+
+  // Small writes are not seen by the file until flushed
+  std::vector<byte> plain(testbytes), buffer(testbytes);
+  small_prng rand;
+  for(auto &i : plain)
+  {
+    i = (byte) rand();
+  }
+  BOOST_CHECK(h.write(5, {{plain.data() + 5, 10}}).value() == 10);
+  BOOST_CHECK(h.maximum_extent().value() == 15);
+  BOOST_CHECK(fh.maximum_extent().value() == 0);
+  BOOST_CHECK(h.dirty_blocks() == 1);
+  BOOST_CHECK(h.read(0, {{buffer.data(), 100}}).value() == 15);
+  BOOST_CHECK(std::all_of(buffer.data(), buffer.data() + 5, [](byte v) { return v == (byte) 0; }));
+  BOOST_CHECK(0 == memcmp(buffer.data() + 5, plain.data() + 5, 10));
+  h.flush().value();
+  BOOST_CHECK(h.dirty_blocks() == 0);
+  // The flush wrote a whole block, but the file is trimmed to the bytes written
+  BOOST_CHECK(fh.maximum_extent().value() == 15);
+
+  // Many tiny random writes, covering the whole file eventually
+  for(size_t offset = 0; offset < testbytes;)
+  {
+    const size_t length = (std::min)((size_t)(1 + rand() % 64), testbytes - offset);
+    BOOST_CHECK(h.write(offset, {{plain.data() + offset, length}}).value() == length);
+    offset += length;
+  }
+  for(size_t i = 0; i < 10000; i++)
+  {
+    const size_t offset = rand() % (testbytes - 64), length = 1 + rand() % 64;
+    for(size_t n = 0; n < length; n++)
+    {
+      plain[offset + n] = (byte) rand();
+    }
+    BOOST_CHECK(h.write(offset, {{plain.data() + offset, length}}).value() == length);
+  }
+  BOOST_CHECK(h.dirty_blocks() <= testbytes / 4 / utils::page_size());
+  BOOST_CHECK(h.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+  h.barrier().value();
+  BOOST_CHECK(h.dirty_blocks() == 0);
+  BOOST_CHECK(fh.read(0, {{buffer.data(), testbytes}}).value() == testbytes);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data(), testbytes));
+
+  // Truncation forgets cached blocks past the new size
+  BOOST_CHECK(h.write(testbytes - 10, {{plain.data(), 10}}).value() == 10);
+  BOOST_CHECK(h.truncate(testbytes / 2 + 3).value() == testbytes / 2 + 3);
+  h.flush().value();
+  BOOST_CHECK(fh.maximum_extent().value() == testbytes / 2 + 3);
+  BOOST_CHECK(h.truncate(testbytes / 2 + 4096).value() == testbytes / 2 + 4096);
+  BOOST_CHECK(h.read(testbytes / 2, {{buffer.data(), 4096}}).value() == 4096);
+  BOOST_CHECK(0 == memcmp(buffer.data(), plain.data() + testbytes / 2, 3));
+  BOOST_CHECK(std::all_of(buffer.data() + 3, buffer.data() + 4096, [](byte v) { return v == (byte) 0; }));
+
+  // Destruction flushes
+  BOOST_CHECK(h.write(0, {{plain.data() + 1, 1}}).value() == 1);
+  h = {};
+  BOOST_CHECK(fh.read(0, {{buffer.data(), 1}}).value() == 1);
+  BOOST_CHECK(buffer[0] == plain[1]);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, write_back_handle_adapter, works, "Tests that the write back handle adapter works as expected", TestWriteBackHandleAdapterWorks())
@@ -71,8 +71,8 @@ static inline void TestXorHandleAdapterWorks()
       BOOST_CHECK(bytesread == length);
     }
     size_t n = 0;
-    uint8_t *p = (uint8_t *) tempbuffer.data();
-    for(; n < bytesread; n += 8)
+    uint8_t *p = (uint8_t *) buffer;
+    for(; n + 8 <= bytesread; n += 8)
     {
       uint64_t *_p = (uint64_t *) (&p[n]);
       BOOST_CHECK(_p[0] == 0);
@@ -83,7 +83,23 @@ static inline void TestXorHandleAdapterWorks()
     }
   }
 
-  // TODO Test writing works
+  // Writing all bits one through the adapter should write the inverse of the random file into the temp
+  // inode, including for writes too large for the stack
+  for(size_t length : {(size_t) 77, (size_t) 70001})
+  {
+    const size_t offset = 1001;
+    std::vector<byte> ones(length, (byte) 0xff), random(length);
+    BOOST_CHECK(h.write(offset, {{ones.data(), length}}).value() == length);
+    h1.read(offset, {{random.data(), length}}).value();
+    for(size_t n = 0; n < length; n++)
+    {
+      if(h2.address()[offset + n] != ~random[n])
+      {
+        BOOST_CHECK(h2.address()[offset + n] == ~random[n]);
+        break;
+      }
+    }
+  }
 }
 
 #if 0
@@ -0,0 +1,81 @@
+/* Integration test kernel for per i/o request flags
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestIORequestFlags()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using llfio::io_handle;
+  llfio::file_handle fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(65536), readback(65536);
+  for(size_t n = 0; n < buffer.size(); n++)
+  {
+    buffer[n] = llfio::to_byte(static_cast<uint8_t>(n * 7));
+  }
+
+  // A data_sync write is durable on return, and otherwise behaves like any other write
+  {
+    io_handle::const_buffer_type b(buffer.data(), buffer.size());
+    io_handle::io_request<io_handle::const_buffers_type> req({&b, 1}, 0, io_handle::io_request_flag::data_sync);
+    auto written = fh.write(req).value();
+    BOOST_REQUIRE(written.size() == 1);
+    BOOST_CHECK(written[0].size() == buffer.size());
+  }
+  // A high priority read works everywhere, if only by being ignored
+  {
+    io_handle::buffer_type b(readback.data(), readback.size());
+    io_handle::io_request<io_handle::buffers_type> req({&b, 1}, 0, io_handle::io_request_flag::high_priority);
+    auto r = fh.read(req);
+    if(r)
+    {
+      BOOST_CHECK(r.value()[0].size() == buffer.size());
+      BOOST_CHECK(0 == memcmp(readback.data(), buffer.data(), buffer.size()));
+    }
+    else
+    {
+      // Some filing systems refuse polled i/o on buffered handles
+      std::cout << "NOTE: high priority read failed with " << r.error().message() << std::endl;
+    }
+  }
+  // The data just written is in the page cache, so a nowait read either succeeds or is unsupported
+  {
+    memset(readback.data(), 0, readback.size());
+    io_handle::buffer_type b(readback.data(), readback.size());
+    io_handle::io_request<io_handle::buffers_type> req({&b, 1}, 0, io_handle::io_request_flag::nowait);
+    auto r = fh.read(req);
+    if(r)
+    {
+      BOOST_CHECK(r.value()[0].size() == buffer.size());
+      BOOST_CHECK(0 == memcmp(readback.data(), buffer.data(), buffer.size()));
+    }
+    else
+    {
+      std::cout << "NOTE: nowait reads are not supported here, failed with " << r.error().message() << std::endl;
+      BOOST_CHECK(r.error() == llfio::errc::operation_not_supported || r.error() == llfio::errc::resource_unavailable_try_again);
+    }
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, io_request_flags, works, "Tests that per i/o request flags work as expected", TestIORequestFlags())
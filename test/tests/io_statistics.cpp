@@ -0,0 +1,89 @@
+/* Integration test kernel for whether i/o statistics work
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <thread>
+
+static inline void TestIoStatisticsWorks()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using op = io_statistics::operation;
+  io_statistics stats;
+  stats.record(op::read, 100, 100, false, std::chrono::nanoseconds(1000));
+  stats.record(op::read, 100, 50, false, std::chrono::nanoseconds(3000));
+  stats.record(op::write, 100, 0, true, std::chrono::nanoseconds(10));
+  stats.record(op::barrier, 0, 0, false, std::chrono::nanoseconds(1000000));
+  auto v = stats.value();
+  BOOST_CHECK(v.read.ops == 2);
+  BOOST_CHECK(v.read.bytes == 150);
+  BOOST_CHECK(v.read.short_transfers == 1);
+  BOOST_CHECK(v.read.errors == 0);
+  BOOST_CHECK(v.read.latency[9] == 1);   // 512 <= 1000 < 1024
+  BOOST_CHECK(v.read.latency[11] == 1);  // 2048 <= 3000 < 4096
+  BOOST_CHECK(v.read.latency_percentile(0.25) == std::chrono::nanoseconds(1023));
+  BOOST_CHECK(v.read.latency_percentile(0.99) == std::chrono::nanoseconds(4095));
+  BOOST_CHECK(v[op::write].ops == 1);
+  BOOST_CHECK(v[op::write].bytes == 0);
+  BOOST_CHECK(v[op::write].errors == 1);
+  BOOST_CHECK(v.barrier.ops == 1);
+  BOOST_CHECK(v.barrier.short_transfers == 0);
+  stats.reset();
+  BOOST_CHECK(stats.value().read.ops == 0);
+
+  // Statistics of exited threads are retained
+  const auto before = io_statistics::all_threads();
+  std::thread([] { io_statistics::this_thread().record(op::write, 10, 10, false, std::chrono::nanoseconds(1)); }).join();
+  const auto after = io_statistics::all_threads();
+  BOOST_CHECK(after.write.ops == before.write.ops + 1);
+  BOOST_CHECK(after.write.bytes == before.write.bytes + 10);
+
+#if LLFIO_ENABLE_IO_STATISTICS
+  // Handles record their i/o into their statistics and the calling thread's
+  file_handle fh = file_handle::temp_inode().value();
+  fh.set_statistics(&stats);
+  BOOST_CHECK(fh.statistics() == &stats);
+  const auto thread_before = io_statistics::this_thread().value();
+  byte buffer[4096]{};
+  BOOST_CHECK(fh.write(0, {{buffer, 4096}}).value() == 4096);
+  BOOST_CHECK(fh.read(0, {{buffer, 4096}}).value() == 4096);
+  BOOST_CHECK(fh.read(2048, {{buffer, 4096}}).value() == 2048);
+  fh.barrier().value();
+  v = stats.value();
+  BOOST_CHECK(v.write.ops == 1);
+  BOOST_CHECK(v.write.bytes == 4096);
+  BOOST_CHECK(v.read.ops == 2);
+  BOOST_CHECK(v.read.bytes == 6144);
+  BOOST_CHECK(v.read.short_transfers == 1);
+  BOOST_CHECK(v.barrier.ops == 1);
+  BOOST_CHECK(io_statistics::this_thread().value().read.ops == thread_before.read.ops + 2);
+#else
+  file_handle fh = file_handle::temp_inode().value();
+  fh.set_statistics(&stats);
+  BOOST_CHECK(fh.statistics() == nullptr);
+#endif
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, io_statistics, works, "Tests that i/o statistics work as expected", TestIoStatisticsWorks())
@@ -0,0 +1,87 @@
+/* Integration test kernel for whether i/o tracing works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <sstream>
+#include <thread>
+
+static inline void TestIoTraceWorks()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  using op = io_trace::operation;
+  io_trace::clear();
+  // The ring buffer retains the most recent events
+  for(uint64_t n = 0; n < LLFIO_IO_TRACE_EVENTS + 10; n++)
+  {
+    const uint64_t begin = io_trace::ticks();
+    io_trace::record({1, 3, n * 10, 10, 10, begin, io_trace::ticks(), 0, op::write, 0});
+  }
+  std::thread([] { io_trace::record({2, -1, 0, 0, 0, io_trace::ticks(), io_trace::ticks(), 0, op::barrier, 1}); }).join();
+  auto events = io_trace::events();
+  BOOST_REQUIRE(events.size() == LLFIO_IO_TRACE_EVENTS + 1);
+  BOOST_CHECK(events.front().offset == 100);
+  BOOST_CHECK(events.back().op == op::barrier);
+  BOOST_CHECK(events.back().failed == 1);
+  BOOST_CHECK(events.back().thread != events.front().thread);
+  for(size_t n = 1; n < events.size(); n++)
+  {
+    BOOST_CHECK(events[n - 1].begin <= events[n].begin);
+  }
+  std::stringstream s;
+  io_trace::write_chrome_trace(s);
+  const auto json = s.str();
+  BOOST_CHECK(json.find("{\"traceEvents\":[") == 0);
+  BOOST_CHECK(json.find("\"name\":\"barrier\"") != json.npos);
+  BOOST_CHECK(json.find("\"failed\":true") != json.npos);
+  io_trace::clear();
+  BOOST_CHECK(io_trace::events().empty());
+
+  // Ticks convert to roughly the time elapsed
+  const uint64_t begin = io_trace::ticks();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const double ns = io_trace::nanoseconds(io_trace::ticks() - begin);
+  BOOST_CHECK(ns > 50000000.0);
+  BOOST_CHECK(ns < 10000000000.0);
+
+#if LLFIO_ENABLE_IO_TRACING
+  // Handles trace their i/o
+  file_handle fh = file_handle::temp_inode().value();
+  byte buffer[4096]{};
+  BOOST_CHECK(fh.write(0, {{buffer, 4096}}).value() == 4096);
+  BOOST_CHECK(fh.read(1000, {{buffer, 4096}}).value() == 3096);
+  events = io_trace::events();
+  BOOST_REQUIRE(events.size() == 2);
+  BOOST_CHECK(events[0].op == op::write);
+  BOOST_CHECK(events[0].handle == (uint64_t)(uintptr_t) &fh);
+  BOOST_CHECK(events[1].op == op::read);
+  BOOST_CHECK(events[1].offset == 1000);
+  BOOST_CHECK(events[1].length == 4096);
+  BOOST_CHECK(events[1].transferred == 3096);
+  BOOST_CHECK(events[1].begin <= events[1].end);
+#endif
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, io_trace, works, "Tests that i/o tracing works as expected", TestIoTraceWorks())
@@ -0,0 +1,717 @@
+/* Integration test kernel for whether the io_uring multiplexer works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (10 commits)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+static inline void TestIoUringMultiplexerRegisteredBuffers()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  auto fh = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                           llfio::file_handle::flag::multiplexable)
+            .value();
+  fh.set_multiplexer(multiplexer.get()).value();
+
+  // Non-registered buffers must work, and use the ordinary vectored opcodes
+  {
+    llfio::byte buffer[16];
+    memcpy(buffer, "hello world 0123", 16);
+    auto written = fh.write(0, {{buffer, 16}}).value();
+    BOOST_REQUIRE(written == 16);
+    llfio::byte buffer2[16];
+    memset(buffer2, 0, 16);
+    auto read = fh.read(0, {{buffer2, 16}}).value();
+    BOOST_REQUIRE(read == 16);
+    BOOST_CHECK(0 == memcmp(buffer, buffer2, 16));
+  }
+
+  // Registered buffers should use the fixed buffer opcodes, but must work
+  // irrespective of whether the kernel let them be registered
+  size_t bytes = 4096;
+  auto regbuffer = fh.allocate_registered_buffer(bytes).value();
+  BOOST_REQUIRE(bytes >= 4096);
+  BOOST_REQUIRE(regbuffer->size() >= 4096);
+  for(size_t n = 0; n < 4096; n++)
+  {
+    regbuffer->data()[n] = llfio::to_byte((unsigned char) n);
+  }
+  {
+    llfio::file_handle::const_buffer_type b(regbuffer->data(), 4096);
+    auto written = fh.write(regbuffer, {{&b, 1}, 4096}).value();
+    BOOST_REQUIRE(written.size() == 1);
+    BOOST_CHECK(written[0].size() == 4096);
+  }
+  auto regbuffer2 = fh.allocate_registered_buffer(bytes).value();
+  BOOST_CHECK(regbuffer2->data() != regbuffer->data());
+  memset(regbuffer2->data(), 0, 4096);
+  {
+    // Read a subrange of a registered buffer
+    llfio::file_handle::buffer_type b(regbuffer2->data() + 16, 4080);
+    auto read = fh.read(regbuffer2, {{&b, 1}, 4096 + 16}).value();
+    BOOST_REQUIRE(read.size() == 1);
+    BOOST_CHECK(read[0].size() == 4080);
+    BOOST_CHECK(0 == memcmp(regbuffer2->data() + 16, regbuffer->data() + 16, 4080));
+  }
+
+  // Released registered buffers may be reused
+  regbuffer2.reset();
+  size_t bytes2 = 1024;
+  auto regbuffer3 = fh.allocate_registered_buffer(bytes2).value();
+  BOOST_CHECK(bytes2 >= 1024);
+  BOOST_CHECK(regbuffer3->size() == bytes2);
+  regbuffer3.reset();
+  regbuffer.reset();
+
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerDeadlines()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  auto pipes = llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::reads, llfio::pipe_handle::flag::multiplexable).value();
+  pipes.first.set_multiplexer(multiplexer.get()).value();
+
+  // Nothing has been written, so the read must time out
+  llfio::byte buffer[64];
+  auto begin = std::chrono::steady_clock::now();
+  auto read = pipes.first.read(0, {{buffer, 64}}, std::chrono::milliseconds(100));
+  auto end = std::chrono::steady_clock::now();
+  BOOST_REQUIRE(!read);
+  BOOST_CHECK(read.error() == llfio::errc::timed_out);
+  BOOST_CHECK(end - begin >= std::chrono::milliseconds(100));
+  std::cout << "Read with a 100ms deadline timed out after " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
+
+  // The multiplexer must continue to work after a timeout
+  auto written = pipes.second.write(0, {{(const llfio::byte *) "hello", 5}}).value();
+  BOOST_REQUIRE(written == 5);
+  read = pipes.first.read(0, {{buffer, 64}}, std::chrono::seconds(5));
+  BOOST_REQUIRE(read.value() == 5);
+  BOOST_CHECK(0 == memcmp(buffer, "hello", 5));
+
+  // Waiting for completions must honour its deadline
+  begin = std::chrono::steady_clock::now();
+  multiplexer->check_for_any_completed_io(std::chrono::milliseconds(100)).value();
+  end = std::chrono::steady_clock::now();
+  BOOST_CHECK(end - begin >= std::chrono::milliseconds(100));
+  BOOST_CHECK(end - begin < std::chrono::seconds(5));
+
+  pipes.first.close().value();
+  pipes.second.close().value();
+}
+
+static inline void TestIoUringMultiplexerOverlappingIo()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  static constexpr size_t FILES = 4, OPS = 64, BYTES = 4096;
+  const auto state_reqs = multiplexer->io_state_requirements();
+  const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+  for(auto flags : {llfio::file_handle::flag::multiplexable, llfio::file_handle::flag::multiplexable | llfio::file_handle::flag::disable_posix_concurrency_guarantees})
+  {
+    std::vector<llfio::file_handle> fhs;
+    for(size_t n = 0; n < FILES; n++)
+    {
+      fhs.push_back(llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write, flags).value());
+      fhs.back().set_multiplexer(multiplexer.get()).value();
+    }
+    // Initiate a write and a read of the same range for every op to every file, without waiting.
+    // The first reads and writes to each file are disjoint, the second overlap them.
+    std::vector<llfio::byte> storage(state_size * FILES * OPS * 2 + state_reqs.second);
+    auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+    std::vector<std::vector<llfio::byte>> writebuffers(FILES * OPS), readbuffers(FILES * OPS);
+    std::vector<llfio::file_handle::const_buffer_type> wbs(FILES * OPS);
+    std::vector<llfio::file_handle::buffer_type> rbs(FILES * OPS);
+    std::vector<llfio::io_multiplexer::io_operation_state *> states;
+    for(size_t op = 0; op < OPS; op++)
+    {
+      for(size_t n = 0; n < FILES; n++)
+      {
+        const size_t idx = op * FILES + n;
+        writebuffers[idx].assign(BYTES, llfio::to_byte((unsigned char) (idx + 1)));
+        readbuffers[idx].assign(BYTES, llfio::to_byte(0));
+        wbs[idx] = {writebuffers[idx].data(), BYTES};
+        rbs[idx] = {readbuffers[idx].data(), BYTES};
+        // Ops after the first half overwrite the ranges of the first half
+        const llfio::file_handle::extent_type offset = (op % (OPS / 2)) * BYTES;
+        states.push_back(multiplexer->construct_and_init_io_operation({base + states.size() * state_size, state_size}, &fhs[n], nullptr, {}, {},
+                                                                      llfio::file_handle::io_request<llfio::file_handle::const_buffers_type>({&wbs[idx], 1}, offset)));
+        states.push_back(multiplexer->construct_and_init_io_operation({base + states.size() * state_size, state_size}, &fhs[n], nullptr, {}, {},
+                                                                      llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&rbs[idx], 1}, offset)));
+      }
+    }
+    multiplexer->flush_inited_io_operations().value();
+    for(;;)
+    {
+      bool alldone = true;
+      for(auto *state : states)
+      {
+        if(!is_finished(state->current_state()))
+        {
+          alldone = false;
+          break;
+        }
+      }
+      if(alldone)
+      {
+        break;
+      }
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+    for(size_t op = 0; op < OPS; op++)
+    {
+      for(size_t n = 0; n < FILES; n++)
+      {
+        const size_t idx = op * FILES + n;
+        BOOST_CHECK(std::move(*states[idx * 2]).get_completed_write_or_barrier().has_value());
+        BOOST_CHECK(std::move(*states[idx * 2 + 1]).get_completed_read().has_value());
+        if(!(flags & llfio::file_handle::flag::disable_posix_concurrency_guarantees))
+        {
+          // Each read must see the write initiated immediately before it
+          BOOST_CHECK(readbuffers[idx] == writebuffers[idx]);
+        }
+      }
+    }
+    for(auto *state : states)
+    {
+      state->~io_operation_state();
+    }
+    for(auto &fh : fhs)
+    {
+      fh.close().value();
+    }
+  }
+}
+
+static inline void TestIoUringMultiplexerBatched()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  static constexpr size_t PAGES = 256, BYTES = 4096;
+  auto fh = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                           llfio::file_handle::flag::multiplexable)
+            .value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  const auto state_reqs = multiplexer->io_state_requirements();
+  const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+  std::vector<llfio::byte> storage(state_size * PAGES + state_reqs.second);
+  auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+  std::vector<llfio::io_multiplexer::io_operation_state *> states(PAGES), finished(PAGES);
+
+  // Write every page in a single batch
+  std::vector<std::vector<llfio::byte>> pages(PAGES);
+  std::vector<llfio::file_handle::const_buffer_type> wbs(PAGES);
+  std::vector<llfio::io_multiplexer::batched_io_request<llfio::file_handle::const_buffers_type>> writes(PAGES);
+  for(size_t n = 0; n < PAGES; n++)
+  {
+    pages[n].assign(BYTES, llfio::to_byte((unsigned char) (n + 1)));
+    wbs[n] = {pages[n].data(), BYTES};
+    writes[n].h = &fh;
+    writes[n].reqs = {{&wbs[n], 1}, n * BYTES};
+  }
+  auto inited = multiplexer->construct_and_init_io_operations({base, state_size * PAGES}, writes, states).value();
+  BOOST_REQUIRE(inited.size() == PAGES);
+  for(size_t done = 0; done < PAGES;)
+  {
+    // Reap in place, which moves the finished states to the front
+    auto reaped = multiplexer->check_for_finished_io_operations({states.data() + done, PAGES - done}, {states.data() + done, PAGES - done}, std::chrono::seconds(5)).value();
+    for(auto *state : reaped)
+    {
+      BOOST_CHECK(std::move(*state).get_completed_write_or_barrier().has_value());
+    }
+    done += reaped.size();
+  }
+  // Reaping into a separate array returns all the finished states without changing the input
+  BOOST_CHECK(multiplexer->check_for_finished_io_operations(states, finished).value().size() == PAGES);
+  for(auto *state : states)
+  {
+    state->~io_operation_state();
+  }
+
+  // Scatter read every page in a single batch, reaping in place
+  std::vector<std::vector<llfio::byte>> readpages(PAGES);
+  std::vector<llfio::file_handle::buffer_type> rbs(PAGES);
+  std::vector<llfio::io_multiplexer::batched_io_request<llfio::file_handle::buffers_type>> reads(PAGES);
+  for(size_t n = 0; n < PAGES; n++)
+  {
+    readpages[n].assign(BYTES, llfio::to_byte(0));
+    rbs[n] = {readpages[n].data(), BYTES};
+    reads[n].h = &fh;
+    reads[n].reqs = {{&rbs[n], 1}, (PAGES - 1 - n) * BYTES};
+  }
+  inited = multiplexer->construct_and_init_io_operations({base, state_size * PAGES}, reads, states).value();
+  BOOST_REQUIRE(inited.size() == PAGES);
+  for(size_t done = 0; done < PAGES;)
+  {
+    auto reaped = multiplexer->check_for_finished_io_operations({states.data() + done, PAGES - done}, {states.data() + done, PAGES - done}, std::chrono::seconds(5)).value();
+    for(auto *state : reaped)
+    {
+      BOOST_CHECK(std::move(*state).get_completed_read().has_value());
+    }
+    done += reaped.size();
+  }
+  for(size_t n = 0; n < PAGES; n++)
+  {
+    BOOST_CHECK(readpages[n] == pages[PAGES - 1 - n]);
+  }
+  for(auto *state : states)
+  {
+    state->~io_operation_state();
+  }
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerSqpoll()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  llfio::linux_io_uring_sqpoll_config config;
+  config.cpu = 0;
+  config.idle = std::chrono::milliseconds(10);
+  auto r = llfio::multiplexer_linux_io_uring(1, config);
+  if(!r)
+  {
+    // Kernels before 5.11 require privileges for SQPOLL
+    std::cout << "NOTE: io_uring multiplexer with SQPOLL is not available, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  auto fh = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                           llfio::file_handle::flag::multiplexable)
+            .value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  auto pipes = llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::reads, llfio::pipe_handle::flag::multiplexable).value();
+  pipes.first.set_multiplexer(multiplexer.get()).value();
+  pipes.second.set_multiplexer(multiplexer.get()).value();
+  for(size_t n = 0; n < 2; n++)
+  {
+    llfio::byte buffer[16], buffer2[16];
+    memcpy(buffer, "hello world 0123", 16);
+    BOOST_REQUIRE(fh.write(0, {{buffer, 16}}).value() == 16);
+    BOOST_REQUIRE(fh.read(0, {{buffer2, 16}}).value() == 16);
+    BOOST_CHECK(0 == memcmp(buffer, buffer2, 16));
+    BOOST_REQUIRE(pipes.second.write(0, {{buffer, 16}}).value() == 16);
+    BOOST_REQUIRE(pipes.first.read(0, {{buffer2, 16}}).value() == 16);
+    BOOST_CHECK(0 == memcmp(buffer, buffer2, 16));
+    // Let the kernel polling threads go to sleep, so the next flush must wake them
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  auto stats = llfio::multiplexer_linux_io_uring_statistics(multiplexer.get()).value();
+  std::cout << "Flushes without syscall " << stats.flushes_without_syscall << ", with syscall " << stats.flushes_with_syscall << ", of which wakeups "
+            << stats.sqpoll_wakeups << std::endl;
+  BOOST_CHECK(stats.flushes_without_syscall + stats.flushes_with_syscall > 0);
+  BOOST_CHECK(stats.sqpoll_wakeups <= stats.flushes_with_syscall);
+  BOOST_CHECK(!llfio::multiplexer_linux_io_uring_statistics(nullptr));
+  pipes.first.close().value();
+  pipes.second.close().value();
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerIopoll()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto multiplexer = llfio::multiplexer_linux_io_uring(1, false).value();
+  auto r = llfio::file_handle::uniquely_named_file(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                                   llfio::file_handle::caching::only_metadata,
+                                                   llfio::file_handle::flag::unlink_on_first_close | llfio::file_handle::flag::multiplexable);
+  if(!r)
+  {
+    // Some filing systems e.g. tmpfs do not support O_DIRECT
+    std::cout << "NOTE: O_DIRECT is not available on the temporary files directory, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto fh = std::move(r).value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  alignas(4096) static llfio::byte buffer[4096], buffer2[4096];
+  for(size_t n = 0; n < 4; n++)
+  {
+    memset(buffer, (int) ('a' + n), sizeof(buffer));
+    // Without a deadline i/o goes to the IOPOLL ring, with a deadline and barriers to the seekable ring
+    const llfio::deadline d = (n & 1) ? llfio::deadline(std::chrono::seconds(5)) : llfio::deadline();
+    BOOST_REQUIRE(fh.write(n * sizeof(buffer), {{buffer, sizeof(buffer)}}, d).value() == sizeof(buffer));
+    BOOST_REQUIRE(fh.barrier(llfio::file_handle::barrier_kind::wait_data_only).has_value());
+    BOOST_REQUIRE(fh.read(n * sizeof(buffer), {{buffer2, sizeof(buffer2)}}, d).value() == sizeof(buffer2));
+    BOOST_CHECK(0 == memcmp(buffer, buffer2, sizeof(buffer)));
+  }
+  fh.close().value();
+  multiplexer->close().value();
+}
+
+static inline void TestIoUringMultiplexerLinkedBarriers()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  const auto state_reqs = multiplexer->io_state_requirements();
+  const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+  std::vector<llfio::byte> storage(state_size * 3 + state_reqs.second);
+  auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+  auto fh = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                           llfio::file_handle::flag::multiplexable)
+            .value();
+  // Writes to a read only handle fail, which breaks the link to the barrier after them
+  auto rfh = fh.reopen(llfio::file_handle::mode::read).value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  rfh.set_multiplexer(multiplexer.get()).value();
+  for(auto *h : {&fh, &rfh})
+  {
+    const bool should_fail = (h == &rfh);
+    llfio::byte buffer[16], buffer2[16];
+    memcpy(buffer, "hello world 0123", 16);
+    memset(buffer2, 0, 16);
+    llfio::file_handle::const_buffer_type wb{buffer, 16};
+    llfio::file_handle::buffer_type rb{buffer2, 16};
+    // Initiate a write, a barrier and a read without telling the kernel, so the barrier gets linked after the write
+    auto *write = multiplexer->construct_and_init_io_operation({base, state_size}, h, nullptr, {}, {},
+                                                               llfio::file_handle::io_request<llfio::file_handle::const_buffers_type>({&wb, 1}, 0));
+    auto *barrier = multiplexer->construct_and_init_io_operation({base + state_size, state_size}, h, nullptr, {}, {},
+                                                                 llfio::file_handle::io_request<llfio::file_handle::const_buffers_type>(),
+                                                                 llfio::file_handle::barrier_kind::wait_data_only);
+    auto *read = multiplexer->construct_and_init_io_operation({base + 2 * state_size, state_size}, h, nullptr, {}, {},
+                                                              llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&rb, 1}, 0));
+    multiplexer->flush_inited_io_operations().value();
+    while(!is_finished(write->current_state()) || !is_finished(barrier->current_state()) || !is_finished(read->current_state()))
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+    BOOST_CHECK(std::move(*write).get_completed_write_or_barrier().has_value() == !should_fail);
+    // Even if the write failed, the barrier still gets executed
+    BOOST_CHECK(std::move(*barrier).get_completed_write_or_barrier().has_value());
+    BOOST_CHECK(std::move(*read).get_completed_read().has_value());
+    BOOST_CHECK(0 == memcmp(buffer, buffer2, 16));
+    write->~io_operation_state();
+    barrier->~io_operation_state();
+    read->~io_operation_state();
+  }
+  auto stats = llfio::multiplexer_linux_io_uring_statistics(multiplexer.get()).value();
+  BOOST_CHECK(stats.linked_barriers == 2);
+  rfh.close().value();
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerCoalescedWrites()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  // 128 appends of 4Kb should become two writes of 256Kb
+  static constexpr size_t OPS = 128, BYTES = 4096;
+  const auto state_reqs = multiplexer->io_state_requirements();
+  const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+  std::vector<llfio::byte> storage(state_size * OPS + state_reqs.second);
+  auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+  auto fh = llfio::file_handle::temp_inode(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write,
+                                           llfio::file_handle::flag::multiplexable)
+            .value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  std::vector<llfio::byte> writebuffer(OPS * BYTES);
+  for(size_t n = 0; n < writebuffer.size(); n++)
+  {
+    writebuffer[n] = llfio::to_byte((unsigned char) (n / BYTES + 1));
+  }
+  std::vector<llfio::file_handle::const_buffer_type> wbs(OPS);
+  std::vector<llfio::io_multiplexer::io_operation_state *> states;
+  for(size_t n = 0; n < OPS; n++)
+  {
+    wbs[n] = {writebuffer.data() + n * BYTES, BYTES};
+    states.push_back(multiplexer->construct_and_init_io_operation({base + n * state_size, state_size}, &fh, nullptr, {}, {},
+                                                                  llfio::file_handle::io_request<llfio::file_handle::const_buffers_type>({&wbs[n], 1}, n * BYTES)));
+  }
+  multiplexer->flush_inited_io_operations().value();
+  for(auto *state : states)
+  {
+    while(!is_finished(state->current_state()))
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+  }
+  for(auto *state : states)
+  {
+    auto written = std::move(*state).get_completed_write_or_barrier();
+    BOOST_REQUIRE(written.has_value());
+    BOOST_CHECK(written.value().size() == 1 && written.value()[0].size() == BYTES);
+    state->~io_operation_state();
+  }
+  auto stats = llfio::multiplexer_linux_io_uring_statistics(multiplexer.get()).value();
+  std::cout << "Of " << OPS << " writes, " << stats.coalesced_writes << " were coalesced" << std::endl;
+  BOOST_CHECK(stats.coalesced_writes == OPS - 2);
+  std::vector<llfio::byte> readbuffer(OPS * BYTES);
+  BOOST_REQUIRE(fh.read(0, {{readbuffer.data(), readbuffer.size()}}).value() == readbuffer.size());
+  BOOST_CHECK(readbuffer == writebuffer);
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerFsSyscalls()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  static constexpr size_t FILES = 64;
+  auto dh = llfio::directory_handle::uniquely_named_directory(llfio::path_discovery::storage_backed_temporary_files_directory()).value();
+  std::vector<std::string> names;
+  std::vector<llfio::file_handle::path_view_type> paths;
+  for(size_t n = 0; n < FILES; n++)
+  {
+    names.push_back(std::to_string(n));
+  }
+  for(auto &name : names)
+  {
+    paths.emplace_back(name);
+  }
+  // Opening a file which does not exist must fail without affecting the others
+  paths.emplace_back("missing");
+  auto opened = llfio::file_handle::files(dh, paths, llfio::file_handle::mode::read, llfio::file_handle::creation::open_existing,
+                                          llfio::file_handle::caching::all, llfio::file_handle::flag::none, multiplexer.get())
+                .value();
+  BOOST_REQUIRE(opened.size() == FILES + 1);
+  for(auto &o : opened)
+  {
+    BOOST_CHECK(!o && o.error() == llfio::errc::no_such_file_or_directory);
+  }
+  paths.pop_back();
+  opened = llfio::file_handle::files(dh, paths, llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist,
+                                     llfio::file_handle::caching::all, llfio::file_handle::flag::none, multiplexer.get())
+           .value();
+  BOOST_REQUIRE(opened.size() == FILES);
+  std::vector<llfio::file_handle> fhs;
+  std::vector<const llfio::handle *> hs;
+  for(size_t n = 0; n < FILES; n++)
+  {
+    BOOST_REQUIRE(opened[n].has_value());
+    fhs.push_back(std::move(opened[n]).value());
+    BOOST_CHECK(fhs.back().is_regular());
+    fhs.back().truncate(n).value();
+  }
+  for(auto &fh : fhs)
+  {
+    hs.push_back(&fh);
+  }
+  std::vector<llfio::stat_t> stats(FILES, llfio::stat_t(nullptr));
+  auto filled = llfio::stat_t::fill(stats, hs, llfio::stat_t::want::type | llfio::stat_t::want::size, multiplexer.get()).value();
+  BOOST_REQUIRE(filled.size() == FILES);
+  for(size_t n = 0; n < FILES; n++)
+  {
+    BOOST_CHECK(filled[n].has_value() && filled[n].value() == 2);
+    BOOST_CHECK(stats[n].st_type == llfio::filesystem::file_type::regular);
+    BOOST_CHECK(stats[n].st_size == (llfio::handle::extent_type) n);
+  }
+  for(auto &fh : fhs)
+  {
+    fh.unlink().value();
+  }
+  auto closed = llfio::file_handle::close_files(fhs, multiplexer.get()).value();
+  BOOST_REQUIRE(closed.size() == FILES);
+  for(size_t n = 0; n < FILES; n++)
+  {
+    BOOST_CHECK(closed[n].has_value());
+    BOOST_CHECK(!fhs[n].is_valid());
+  }
+  dh.unlink().value();
+  dh.close().value();
+}
+
+static inline void TestIoUringMultiplexerPrefetch()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  static constexpr size_t SEGMENTS = 8, SEGMENT_BYTES = 1024 * 1024;
+  auto fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(SEGMENT_BYTES);
+  for(size_t n = 0; n < SEGMENTS; n++)
+  {
+    std::fill(buffer.begin(), buffer.end(), llfio::to_byte((unsigned char) (n + 1)));
+    fh.write(n * SEGMENT_BYTES, {{buffer.data(), buffer.size()}}).value();
+  }
+  auto sh = llfio::section_handle::section(fh).value();
+  auto mh = llfio::map_handle::map(sh, 0, 0, llfio::section_handle::flag::read).value();
+  std::vector<llfio::map_handle::buffer_type> regions;
+  for(size_t n = 0; n < SEGMENTS; n++)
+  {
+    regions.push_back({mh.address() + n * SEGMENT_BYTES, SEGMENT_BYTES});
+  }
+  std::vector<llfio::io_multiplexer::posix_fs_syscall> ops(SEGMENTS);
+  // Too few ops is an error
+  BOOST_CHECK(!llfio::map_handle::prefetch(regions, {ops.data(), SEGMENTS - 1}, multiplexer.get()));
+  // Page in the next segment whilst processing the current one
+  llfio::map_handle::prefetch({regions.data(), 1}, {ops.data(), 1}, multiplexer.get()).value();
+  for(size_t n = 0; n < SEGMENTS; n++)
+  {
+    if(n + 1 < SEGMENTS)
+    {
+      llfio::map_handle::prefetch({regions.data() + n + 1, 1}, {ops.data() + n + 1, 1}, multiplexer.get()).value();
+    }
+    while(ops[n].result == llfio::io_multiplexer::posix_fs_syscall::pending)
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+    BOOST_CHECK(ops[n].result == 0);
+    BOOST_CHECK(regions[n][0] == llfio::to_byte((unsigned char) (n + 1)));
+    BOOST_CHECK(regions[n][SEGMENT_BYTES - 1] == llfio::to_byte((unsigned char) (n + 1)));
+  }
+  // Without a multiplexer, the regions are advised before returning
+  llfio::map_handle::prefetch(regions, ops, nullptr).value();
+  for(auto &op : ops)
+  {
+    BOOST_CHECK(op.result == 0);
+  }
+  mh.close().value();
+  sh.close().value();
+  fh.close().value();
+}
+
+static inline void TestIoUringMultiplexerLockFileRange()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+  if(!r)
+  {
+    std::cout << "NOTE: io_uring multiplexer is not available on this kernel, skipping test (" << r.error().message().c_str() << ")" << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  auto h1 = llfio::file_handle::file({}, "temp_lock", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, llfio::file_handle::caching::temporary,
+                                     llfio::file_handle::flag::unlink_on_first_close)
+            .value();
+  auto h2 = llfio::file_handle::file({}, "temp_lock", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed, llfio::file_handle::caching::temporary,
+                                     llfio::file_handle::flag::unlink_on_first_close)
+            .value();
+  llfio::io_multiplexer::posix_fs_syscall op;
+  // Without a multiplexer is an error
+  BOOST_CHECK(!h2.initiate_lock_file_range(op, 0, 10, llfio::lock_kind::exclusive));
+  // Uncontended locks complete immediately
+  h2.initiate_lock_file_range(op, 0, 10, llfio::lock_kind::exclusive, multiplexer.get()).value();
+  BOOST_REQUIRE(op.result == 0);
+  {
+    auto g = h2.completed_lock_file_range(op).value();
+    BOOST_CHECK(std::get<0>(g.extent()) == 0);
+    BOOST_CHECK(std::get<1>(g.extent()) == 10);
+    BOOST_CHECK(std::get<2>(g.extent()) == llfio::lock_kind::exclusive);
+    if(h2.flags() & llfio::file_handle::flag::byte_lock_insanity)
+    {
+      std::cout << "This platform has byte_lock_insanity so this test won't be useful, bailing out" << std::endl;
+      return;
+    }
+  }
+  // Contended locks complete through the multiplexer once the other lock is released
+  for(size_t n = 0; n < 2; n++)
+  {
+    auto g1 = h1.lock_file_range(5, 1, llfio::lock_kind::exclusive, std::chrono::seconds(0)).value();
+    h2.initiate_lock_file_range(op, 0, 10, llfio::lock_kind::shared, multiplexer.get()).value();
+    BOOST_REQUIRE(op.result == llfio::io_multiplexer::posix_fs_syscall::pending);
+    BOOST_CHECK(h2.completed_lock_file_range(op).error() == llfio::errc::operation_in_progress);
+    std::thread releaser([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      g1.unlock();
+    });
+    auto begin = std::chrono::steady_clock::now();
+    while(__atomic_load_n(&op.result, __ATOMIC_ACQUIRE) == llfio::io_multiplexer::posix_fs_syscall::pending)
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+      BOOST_REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+    }
+    releaser.join();
+    auto g2 = h2.completed_lock_file_range(op).value();
+    BOOST_CHECK(std::get<2>(g2.extent()) == llfio::lock_kind::shared);
+    // Now h1 cannot lock exclusively
+    BOOST_CHECK(!h1.lock_file_range(5, 1, llfio::lock_kind::exclusive, std::chrono::seconds(0)));
+  }
+  // Locks still waiting when the multiplexer is closed are cancelled
+  auto g1 = h1.lock_file_range(5, 1, llfio::lock_kind::exclusive, std::chrono::seconds(0)).value();
+  h2.initiate_lock_file_range(op, 0, 10, llfio::lock_kind::shared, multiplexer.get()).value();
+  BOOST_REQUIRE(op.result == llfio::io_multiplexer::posix_fs_syscall::pending);
+  multiplexer->close().value();
+  BOOST_CHECK(op.result == -ECANCELED);
+  BOOST_CHECK(!h2.completed_lock_file_range(op));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, registered_buffers, "Tests that the io_uring multiplexer works with registered i/o buffers",
+                       TestIoUringMultiplexerRegisteredBuffers())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, deadlines, "Tests that the io_uring multiplexer times out i/o and waits", TestIoUringMultiplexerDeadlines())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, overlapping_io, "Tests that the io_uring multiplexer orders overlapping i/o to the same handle",
+                       TestIoUringMultiplexerOverlappingIo())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, batched, "Tests that the io_uring multiplexer initiates and reaps batches of i/o",
+                       TestIoUringMultiplexerBatched())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, sqpoll, "Tests that the io_uring multiplexer works with configured kernel submission polling",
+                       TestIoUringMultiplexerSqpoll())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, iopoll, "Tests that the io_uring multiplexer polls for completions of uncached file i/o",
+                       TestIoUringMultiplexerIopoll())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, linked_barriers, "Tests that the io_uring multiplexer links barriers after the writes preceding them",
+                       TestIoUringMultiplexerLinkedBarriers())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, coalesced_writes, "Tests that the io_uring multiplexer coalesces adjacent writes",
+                       TestIoUringMultiplexerCoalescedWrites())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, fs_syscalls, "Tests that the io_uring multiplexer opens, stats and closes files in batches",
+                       TestIoUringMultiplexerFsSyscalls())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, prefetch, "Tests that the io_uring multiplexer pages in maps without blocking",
+                       TestIoUringMultiplexerPrefetch())
+KERNELTEST_TEST_KERNEL(integration, llfio, io_uring_multiplexer, lock_file_range, "Tests that the io_uring multiplexer completes contended byte range locks without blocking",
+                       TestIoUringMultiplexerLockFileRange())
+#endif
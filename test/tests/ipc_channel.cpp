@@ -0,0 +1,90 @@
+/* Integration test kernel for whether ipc_channel works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <future>
+
+static inline void TestIpcChannel()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t MESSAGES = 100000;
+  auto name = llfio::utils::random_string(32);
+  auto receiver = llfio::ipc_channel::channel_create(name, 64 * 1024).value();
+  auto sender = llfio::ipc_channel::channel_open(name).value();
+  BOOST_REQUIRE(sender.capacity() == receiver.capacity());
+
+  // An empty channel times out
+  BOOST_CHECK(receiver.acquire_receive(std::chrono::milliseconds(10)).error() == llfio::errc::timed_out);
+  BOOST_CHECK(sender.acquire_send(sender.max_message_size() + 1).error() == llfio::errc::message_size);
+
+  // Messages of varying size, so the ring wraps at all sorts of positions
+  auto producer = std::async(std::launch::async, [&]() -> size_t {
+    for(size_t n = 0; n < MESSAGES; n++)
+    {
+      const size_t bytes = sizeof(size_t) + (n * 7919) % 2000;
+      auto space = sender.acquire_send(bytes, std::chrono::seconds(10));
+      if(!space)
+      {
+        return n;
+      }
+      memset(space.value().data(), (int) (n & 0xff), bytes);
+      memcpy(space.value().data(), &n, sizeof(n));
+      if(!sender.commit_send(bytes))
+      {
+        return n;
+      }
+    }
+    return MESSAGES;
+  });
+  bool same = true;
+  for(size_t n = 0; n < MESSAGES; n++)
+  {
+    auto msg = receiver.acquire_receive(std::chrono::seconds(10)).value();
+    const size_t bytes = sizeof(size_t) + (n * 7919) % 2000;
+    size_t v = 0;
+    if(msg.size() == bytes)
+    {
+      memcpy(&v, msg.data(), sizeof(v));
+    }
+    if(msg.size() != bytes || v != n || (bytes > sizeof(size_t) && msg[bytes - 1] != llfio::to_byte((unsigned char) (n & 0xff))))
+    {
+      same = false;
+    }
+    receiver.commit_receive().value();
+  }
+  BOOST_CHECK(producer.get() == MESSAGES);
+  BOOST_CHECK(same);
+  BOOST_CHECK(receiver.size() == 0);
+
+  // The copying convenience functions
+  const char hello[] = "hello";
+  sender.send({(const llfio::byte *) hello, sizeof(hello)}).value();
+  llfio::byte small[2], buffer[16];
+  BOOST_CHECK(receiver.receive({small, sizeof(small)}).error() == llfio::errc::message_size);
+  BOOST_CHECK(receiver.receive({buffer, sizeof(buffer)}).value() == sizeof(hello));
+  BOOST_CHECK(0 == memcmp(buffer, hello, sizeof(hello)));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, ipc_channel, roundtrips, "Tests that ipc_channel delivers messages in order", TestIpcChannel())
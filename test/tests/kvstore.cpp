@@ -0,0 +1,143 @@
+/* Integration test kernel for the standard key-value store
+(C) 2018 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Nov 2018
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include "../../include/kvstore/kvstore.hpp"
+
+static inline void TestKVStoreMappedIndex()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace kvstore = KVSTORE_V1_NAMESPACE;
+  using kvstore::basic_key_value_store;
+  using llfio::byte;
+  {
+    std::error_code ec;
+    llfio::filesystem::remove_all("kvstore_testdir", ec);
+  }
+  auto make_key = [](uint64_t v) {
+    std::array<byte, 16> ret{};
+    memcpy(ret.data(), &v, sizeof(v));
+    return ret;
+  };
+  auto write = [](basic_key_value_store &store, const std::array<byte, 16> &key, const char *value) {
+    basic_key_value_store::const_buffer_type b(reinterpret_cast<const byte *>(value), strlen(value));
+    return store.write(key, {{&b, 1}, 0});
+  };
+  auto read = [](basic_key_value_store &store, const std::array<byte, 16> &key) -> std::string {
+    basic_key_value_store::buffer_type b(nullptr, (size_t) -1);
+    auto r = store.read({{&b, 1}, 0}, key);
+    if(!r)
+    {
+      return "<none>";
+    }
+    std::string ret;
+    for(auto &i : r.value())
+    {
+      ret.append(reinterpret_cast<const char *>(i.data()), i.size());
+    }
+    return ret;
+  };
+
+  std::array<kvstore::basic_key_value_store_info, 1> stores;
+  auto available = kvstore::enumerate_kvstores(stores).value();
+  BOOST_REQUIRE(available.size() == 1);
+  BOOST_CHECK(0 == strcmp(available[0].name, "mapped_index"));
+
+  BOOST_CHECK(kvstore::create_kvstore("notauri", 16, basic_key_value_store::features::none).error() == llfio::errc::operation_not_supported);
+  BOOST_CHECK(kvstore::open_kvstore("file://kvstore_testdir").has_error());
+  auto store = kvstore::create_kvstore("file://kvstore_testdir", 16, basic_key_value_store::features::atomic_transactions).value();
+  BOOST_CHECK(store->empty());
+  BOOST_CHECK(store->key_size() == 16);
+
+  // Values are read without copying, and replaced values stay where they were
+  BOOST_REQUIRE(write(*store, make_key(1), "hello"));
+  BOOST_CHECK(read(*store, make_key(1)) == "hello");
+  BOOST_CHECK(read(*store, make_key(2)) == "<none>");
+  auto snapshot = store->snapshot().value();
+  BOOST_REQUIRE(write(*store, make_key(1), "world"));
+  BOOST_REQUIRE(write(*store, make_key(2), "foo"));
+  BOOST_CHECK(read(*store, make_key(1)) == "world");
+  BOOST_CHECK(read(*snapshot, make_key(1)) == "hello");
+  BOOST_CHECK(read(*snapshot, make_key(2)) == "<none>");
+  BOOST_CHECK(store->size().value().as_longlongs[0] == 2);
+  BOOST_CHECK(store->bytes_stored().value().as_longlongs[0] == 8);
+  BOOST_CHECK(snapshot->write(make_key(3), {{}, 0}).error() == llfio::errc::operation_not_supported);
+
+  // Every key is matched exactly once
+  {
+    basic_key_value_store::filter_state_type state{};
+    size_t matched = 0;
+    for(auto r = store->match(state); r; r = store->match(state))
+    {
+      matched++;
+    }
+    BOOST_CHECK(matched == 2);
+    const auto mask = make_key((uint64_t) -1), bits = make_key(2);
+    state = {};
+    auto r = store->match(state, mask, bits);
+    BOOST_REQUIRE(r);
+    BOOST_CHECK(0 == memcmp(r.value().data(), bits.data(), bits.size()));
+    BOOST_CHECK(store->match(state, mask, bits).error() == llfio::errc::no_such_file_or_directory);
+  }
+
+  // A transaction aborts if what it read changed before it committed
+  {
+    auto tx = store->begin_transaction().value();
+    BOOST_CHECK(read(*tx, make_key(1)) == "world");
+    BOOST_REQUIRE(write(*tx, make_key(3), "bar"));
+    BOOST_CHECK(read(*tx, make_key(3)) == "bar");
+    BOOST_CHECK(read(*store, make_key(3)) == "<none>");
+    BOOST_REQUIRE(write(*store, make_key(1), "changed"));
+    BOOST_CHECK(tx->commit().error() == llfio::errc::resource_unavailable_try_again);
+    BOOST_CHECK(read(*store, make_key(3)) == "<none>");
+  }
+  {
+    auto tx = store->begin_transaction().value();
+    BOOST_CHECK(read(*tx, make_key(1)) == "changed");
+    BOOST_REQUIRE(write(*tx, make_key(1), "one"));
+    BOOST_REQUIRE(write(*tx, make_key(3), "three"));
+    BOOST_REQUIRE(tx->commit());
+    BOOST_CHECK(read(*store, make_key(1)) == "one");
+    BOOST_CHECK(read(*store, make_key(3)) == "three");
+  }
+
+  // A second opening of the store sees everything, and clearing empties both
+  {
+    auto store2 = kvstore::open_kvstore("file://kvstore_testdir").value();
+    BOOST_CHECK(store2->key_size() == 16);
+    BOOST_CHECK(read(*store2, make_key(3)) == "three");
+    BOOST_REQUIRE(store2->clear());
+    BOOST_CHECK(store->empty());
+    BOOST_CHECK(read(*store, make_key(3)) == "<none>");
+  }
+  snapshot.reset();
+  store.reset();
+  {
+    std::error_code ec;
+    llfio::filesystem::remove_all("kvstore_testdir", ec);
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, kvstore, mapped_index, "Tests that the mapped_index key value store works as expected", TestKVStoreMappedIndex())
@@ -0,0 +1,76 @@
+/* Integration test kernel for i/o requests with very many buffers
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestLargeIORequests()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t BUFFERS = 10000;
+  llfio::file_handle fh = llfio::file_handle::temp_inode().value();
+  std::cout << "max_buffers() = " << fh.max_buffers() << std::endl;
+  // Buffers of varying sizes, totalling a little under 10Mb
+  std::vector<llfio::byte> data(BUFFERS * 1024), readback(data.size());
+  for(size_t n = 0; n < data.size(); n++)
+  {
+    data[n] = llfio::to_byte(static_cast<uint8_t>(n % 251));
+  }
+  std::vector<llfio::file_handle::const_buffer_type> wbuffers;
+  std::vector<llfio::file_handle::buffer_type> rbuffers;
+  size_t total = 0;
+  for(size_t n = 0; n < BUFFERS; n++)
+  {
+    const size_t len = 1 + (n * 37) % 1023;
+    wbuffers.emplace_back(data.data() + total, len);
+    rbuffers.emplace_back(readback.data() + total, len);
+    total += len;
+  }
+
+  // Many more buffers than max_buffers() are written and read in full
+  auto written = fh.write({wbuffers, 0}).value();
+  BOOST_CHECK(written.size() == BUFFERS);
+  BOOST_CHECK(fh.maximum_extent().value() == total);
+  auto read = fh.read({rbuffers, 0}).value();
+  BOOST_REQUIRE(read.size() == BUFFERS);
+  size_t readtotal = 0;
+  for(auto &b : read)
+  {
+    readtotal += b.size();
+  }
+  BOOST_CHECK(readtotal == total);
+  BOOST_CHECK(0 == memcmp(readback.data(), data.data(), total));
+
+  // A read running off the end of the file stops at the end of the file
+  rbuffers.clear();
+  for(size_t n = 0, offset = 0; n < BUFFERS; n++, offset += 100)
+  {
+    rbuffers.emplace_back(readback.data() + offset, 100);
+  }
+  read = fh.read({rbuffers, total - 150050}).value();
+  BOOST_REQUIRE(read.size() == 1501);
+  BOOST_CHECK(read.back().size() == 50);
+  BOOST_CHECK(0 == memcmp(readback.data(), data.data() + total - 150050, 150050));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, io_handle, large_requests, "Tests that i/o requests with very many buffers are performed in full", TestLargeIORequests())
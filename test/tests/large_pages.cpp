@@ -1,5 +1,5 @@
 /* Integration test kernel for large page support
-(C) 2017 Niall Douglas <http://www.nedproductions.biz/> (2 commits)
+(C) 2017 Niall Douglas <http://www.nedproductions.biz/> (3 commits)
 File Created: Aug 2018
 
 
@@ -112,6 +112,45 @@ static inline void TestLargeFileMappedPages()
 #endif
 }
 
+static inline void TestLargePageFallback()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::byte;
+  auto pagesizes = utils::page_sizes();
+  const size_t bytes = (pagesizes.size() > 1) ? pagesizes.back() : 4 * 1024 * 1024;
+  const auto before = map_handle::page_size_statistics();
+  {
+    // Never fails for want of huge pages, reporting which page size it got
+    map_handle mh(map_handle::map(bytes, false, section_handle::flag::readwrite | section_handle::flag::page_sizes_fallback).value());
+    BOOST_CHECK(mh.address() != nullptr);
+    BOOST_CHECK(mh.length() >= bytes);
+    BOOST_CHECK(std::find(pagesizes.begin(), pagesizes.end(), mh.page_size()) != pagesizes.end());
+    BOOST_CHECK(mh.length() % mh.page_size() == 0);
+    std::cout << "Allocation of " << bytes << " bytes obtained page size " << mh.page_size() << (mh.is_transparent_huge_pages() ? " with transparent huge pages" : "")
+              << std::endl;
+    mh.write(0, {{(const byte *) "hello world", 11}}).value();
+    const auto during = map_handle::page_size_statistics();
+    size_t idx = std::find(pagesizes.begin(), pagesizes.end(), mh.page_size()) - pagesizes.begin();
+    BOOST_CHECK(during.bytes_in_use[idx] - before.bytes_in_use[idx] == mh.capacity());
+    // Shrinking is also accounted for
+    mh.truncate(mh.capacity() / 2).value();
+    const auto shrunk = map_handle::page_size_statistics();
+    BOOST_CHECK(shrunk.bytes_in_use[idx] - before.bytes_in_use[idx] == mh.capacity());
+  }
+  // Small allocations are not rounded up to huge pages
+  {
+    map_handle mh(map_handle::map(pagesizes[0], false, section_handle::flag::readwrite | section_handle::flag::page_sizes_fallback).value());
+    BOOST_CHECK(mh.page_size() == pagesizes[0]);
+    BOOST_CHECK(mh.length() == pagesizes[0]);
+  }
+  const auto after = map_handle::page_size_statistics();
+  for(size_t n = 0; n < 4; n++)
+  {
+    BOOST_CHECK(after.bytes_in_use[n] == before.bytes_in_use[n]);
+  }
+}
+
 KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, large_mem_mapped_pages, "Tests that large page support for allocating memory works as expected", TestLargeMemMappedPages())
 KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, large_kernel_mapped_pages, "Tests that large page support for mapping kernel memory works as expected", TestLargeKernelMappedPages())
 KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, large_file_mapped_pages, "Tests that large page support for mapping files works as expected", TestLargeFileMappedPages())
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, large_page_fallback, "Tests that large page allocations fall back to smaller page sizes", TestLargePageFallback())
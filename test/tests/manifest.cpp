@@ -0,0 +1,133 @@
+/* Integration test kernel for algorithm::build_manifest()
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <cstring>
+
+static inline void TestBuildManifest()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = llfio::algorithm;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto write_file = [](const llfio::path_handle &base, llfio::path_view path, const std::string &contents) {
+    auto fh = llfio::file_handle::file(base, path, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    fh.write(0, {{(const llfio::byte *) contents.data(), contents.size()}}).value();
+  };
+  auto hash_of = [](const std::string &contents) { return QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(contents.data(), contents.size()); };
+  std::string big(3 * 1024 * 1024 + 7, 0);
+  for(size_t n = 0; n < big.size(); n++)
+  {
+    big[n] = (char) (n * 7919 >> 8);
+  }
+  write_file(dh, "a", "alpha");
+  write_file(dh, "empty", "");
+  auto sub = llfio::directory_handle::directory(dh, "sub", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+  write_file(sub, "big", big);
+  write_file(sub, "b", "beta");
+
+  // Files are hashed whether read in many pieces, or mapped
+  auto first = algorithm::build_manifest(dh, nullptr, nullptr, 0, 64 * 1024).value();
+  auto mapped = algorithm::build_manifest(dh, nullptr, nullptr, 0, 64 * 1024, 1024 * 1024).value();
+  BOOST_REQUIRE(first.size() == 4);
+  BOOST_CHECK(first.stats.files_hashed == 4);
+  BOOST_CHECK(first.stats.bytes_hashed == big.size() + 9);
+  BOOST_CHECK(first.at("a").hash == hash_of("alpha"));
+  BOOST_CHECK(first.at("empty").hash == hash_of(""));
+  BOOST_CHECK(first.at(llfio::filesystem::path("sub") / "big").hash == hash_of(big));
+  BOOST_CHECK(first.at(llfio::filesystem::path("sub") / "b").stat.st_size == 4);
+  for(auto &i : first)
+  {
+    BOOST_CHECK(mapped.at(i.first).hash == i.second.hash);
+  }
+
+  // The manifest text is sorted by path, and round trips
+  const auto text = first.to_string();
+  BOOST_CHECK(text.find("/a\n") == std::string::npos);
+  BOOST_CHECK(text.find(" a\n") < text.find(" empty\n"));
+  BOOST_CHECK(text.find(" empty\n") < text.find(" sub/b\n"));
+  first.write(dh, "manifest").value();
+  auto reread = algorithm::manifest::read(dh, "manifest").value();
+  BOOST_REQUIRE(reread.size() == first.size());
+  for(auto &i : first)
+  {
+    auto &j = reread.at(i.first);
+    BOOST_CHECK(j.hash == i.second.hash);
+    BOOST_CHECK(algorithm::manifest::unchanged(j, i.second.stat));
+  }
+  BOOST_CHECK(!algorithm::manifest::from_string("not a manifest\n"));
+  llfio::file_handle::file(dh, "manifest", llfio::file_handle::mode::write).value().unlink().value();
+
+  // Only changed files are hashed again, and the differences report whether contents changed
+  write_file(sub, "b", "beta, but longer");
+  write_file(dh, "c", "gamma");
+  auto second = algorithm::build_manifest(dh, &first).value();
+  BOOST_CHECK(second.size() == 5);
+  BOOST_CHECK(second.stats.files_hashed == 2);
+  BOOST_CHECK(second.stats.files_reused == 3);
+  BOOST_CHECK(second.at(llfio::filesystem::path("sub") / "b").hash == hash_of("beta, but longer"));
+  auto changes = algorithm::difference(first, second).value();
+  BOOST_REQUIRE(changes.size() == 2);
+  BOOST_CHECK(changes[0].changed == algorithm::difference_item::file_added);
+  BOOST_CHECK(changes[0].path == "c");
+  BOOST_CHECK(changes[1].changed == algorithm::difference_item::content_metadata_changed);
+  BOOST_CHECK(changes[1].content_comparison != 0);
+
+  // The hash can be replaced
+  struct xor_hasher
+  {
+    algorithm::manifest_hash_type value;
+    xor_hasher() { memset(value.as_bytes, 0, sizeof(value.as_bytes)); }
+    void add(const char *data, size_t bytes) noexcept
+    {
+      for(size_t n = 0; n < bytes; n++)
+      {
+        value.as_bytes[n % 16] ^= (uint8_t) data[n];
+      }
+    }
+    algorithm::manifest_hash_type finalise() noexcept { return value; }
+  };
+  struct visitor_type : algorithm::manifest_visitor
+  {
+    virtual llfio::result<algorithm::manifest_hash_type> hash_file(void *data, const llfio::directory_handle &dirh, llfio::path_view leafname,
+                                                                   llfio::file_handle &fh, llfio::handle::extent_type length, buffer_type &buffer) noexcept override
+    {
+      (void) dirh;
+      (void) leafname;
+      return hash_contents<xor_hasher>((algorithm::manifest_state *) data, fh, length, buffer);
+    }
+  } visitor;
+  auto custom = algorithm::build_manifest(dh, nullptr, &visitor).value();
+  xor_hasher expected;
+  expected.add("alpha", 5);
+  BOOST_CHECK(custom.at("a").hash == expected.finalise());
+
+  sub.close().value();
+  llfio::algorithm::reduce(std::move(dh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, manifest, "Tests that algorithm::build_manifest() hashes, reuses hashes of unchanged files, and round trips",
+                       TestBuildManifest())
@@ -0,0 +1,105 @@
+/* Integration test kernel for map_handle operations upon many regions
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static inline void TestMapHandleBatchedRegions()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  const size_t pagesize = llfio::utils::page_size(), pages = 64;
+  auto mh = llfio::map_handle::map(pagesize * pages).value();
+  memset(mh.address(), 0xff, pagesize * pages);
+  std::mt19937 rand(78);
+  auto page_region = [&](size_t page, size_t count = 1) { return llfio::map_handle::buffer_type{mh.address() + page * pagesize, count * pagesize}; };
+
+  // Pages 0-3 given in reverse, overlapping and touching, must merge into a single region,
+  // and page 8 unaligned must round out to its page
+  std::vector<llfio::map_handle::buffer_type> regions{page_region(3), page_region(1, 2), page_region(0), page_region(2), {mh.address() + 8 * pagesize + 1, 1}};
+  std::shuffle(regions.begin(), regions.end(), rand);
+  auto merged = mh.do_not_store(regions).value();
+  BOOST_REQUIRE(merged.size() == 2);
+  BOOST_CHECK(merged[0].data() == mh.address());
+  BOOST_CHECK(merged[0].size() == 4 * pagesize || merged[0].size() == 0);
+  BOOST_CHECK(merged[1].data() == mh.address() + 8 * pagesize);
+
+  // Zero every other page, the remainder must be untouched
+  memset(mh.address(), 0xff, pagesize * pages);
+  regions.clear();
+  for(size_t n = 0; n < pages; n += 2)
+  {
+    regions.push_back(page_region(n));
+  }
+  std::shuffle(regions.begin(), regions.end(), rand);
+  mh.zero_memory(regions).value();
+  for(size_t n = 0; n < pages; n++)
+  {
+    const auto *p = mh.address() + n * pagesize;
+    BOOST_CHECK(p[0] == ((n & 1) ? llfio::to_byte(0xff) : llfio::to_byte(0)));
+    BOOST_CHECK(p[pagesize - 1] == ((n & 1) ? llfio::to_byte(0xff) : llfio::to_byte(0)));
+  }
+  // Unaligned regions zero exactly their bytes
+  memset(mh.address(), 0xff, pagesize * pages);
+  regions = {{mh.address() + 10, pagesize * 3}, {mh.address() + pagesize * 5 + 7, 9}};
+  mh.zero_memory(regions).value();
+  BOOST_CHECK(mh.address()[9] == llfio::to_byte(0xff));
+  BOOST_CHECK(mh.address()[10] == llfio::to_byte(0));
+  BOOST_CHECK(mh.address()[pagesize * 3 + 9] == llfio::to_byte(0));
+  BOOST_CHECK(mh.address()[pagesize * 3 + 10] == llfio::to_byte(0xff));
+  BOOST_CHECK(mh.address()[pagesize * 5 + 6] == llfio::to_byte(0xff));
+  BOOST_CHECK(mh.address()[pagesize * 5 + 7] == llfio::to_byte(0));
+  BOOST_CHECK(mh.address()[pagesize * 5 + 16] == llfio::to_byte(0xff));
+
+  // Decommit and recommit every run of four pages bar the first
+  regions.clear();
+  for(size_t n = 4; n < pages; n += 4)
+  {
+    regions.push_back(page_region(n, 4));
+  }
+  std::shuffle(regions.begin(), regions.end(), rand);
+  merged = mh.decommit(regions).value();
+  BOOST_REQUIRE(merged.size() == 1);
+  BOOST_CHECK(merged[0].data() == mh.address() + 4 * pagesize);
+  BOOST_CHECK(merged[0].size() == (pages - 4) * pagesize);
+  regions.clear();
+  for(size_t n = 4; n < pages; n += 2)
+  {
+    regions.push_back(page_region(n));
+  }
+  merged = mh.commit(regions).value();
+  BOOST_CHECK(merged.size() == regions.size());
+  for(size_t n = 4; n < pages; n += 2)
+  {
+    mh.address()[n * pagesize] = llfio::to_byte(78);
+  }
+  BOOST_CHECK(mh.address()[0] == llfio::to_byte(0xff));
+
+  regions = {page_region(0), {nullptr, 0}};
+  BOOST_CHECK(mh.decommit(regions).has_error());
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, batched_regions, "Tests that map_handle operations upon many regions sort and merge them", TestMapHandleBatchedRegions())
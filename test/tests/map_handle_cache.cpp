@@ -0,0 +1,84 @@
+/* Integration test kernel for the map_handle allocation cache
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestMapHandleCache()
+{
+#ifndef _WIN32
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  llfio::map_handle::trim_cache();
+  const auto before = llfio::map_handle::cache_statistics();
+  BOOST_CHECK(before.items_in_cache == 0);
+  BOOST_CHECK(before.bytes_in_cache == 0);
+  const size_t bytes = llfio::utils::page_size() * 16;
+  llfio::byte *addr;
+  {
+    auto mh = llfio::map_handle::map(bytes).value();
+    addr = mh.address();
+    mh.address()[0] = llfio::to_byte(78);
+  }
+  auto stats = llfio::map_handle::cache_statistics();
+  if(stats.items_in_cache == 0)
+  {
+    std::cout << "NOTE: MADV_FREE is not supported on this platform, skipping test" << std::endl;
+    return;
+  }
+  BOOST_CHECK(stats.items_in_cache == 1);
+  BOOST_CHECK(stats.bytes_in_cache == bytes);
+  BOOST_CHECK(stats.misses == before.misses + 1);
+  {
+    // A smaller allocation in the same size class reuses the cached allocation
+    auto mh = llfio::map_handle::map(bytes - llfio::utils::page_size()).value();
+    BOOST_CHECK(mh.address() == addr);
+    BOOST_CHECK(mh.capacity() == bytes);
+    BOOST_CHECK(mh.length() == bytes - llfio::utils::page_size());
+    mh.address()[bytes - 1] = llfio::to_byte(78);
+    stats = llfio::map_handle::cache_statistics();
+    BOOST_CHECK(stats.items_in_cache == 0);
+    BOOST_CHECK(stats.hits == before.hits + 1);
+    // Zeroed allocations never come from the cache
+    auto mh2 = llfio::map_handle::map(bytes, true).value();
+    BOOST_CHECK(mh2.address()[0] == llfio::to_byte(0));
+    BOOST_CHECK(llfio::map_handle::cache_statistics().hits == before.hits + 1);
+    // Decommitted allocations never go into the cache
+    mh2.decommit({mh2.address(), llfio::utils::page_size()}).value();
+  }
+  stats = llfio::map_handle::cache_statistics();
+  BOOST_CHECK(stats.items_in_cache == 1);
+  // Allocations with other flags or too large are not cached
+  {
+    auto mh = llfio::map_handle::map(bytes, false, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::prefault).value();
+    auto mh2 = llfio::map_handle::map(llfio::map_handle::cache_max_item_bytes * 2).value();
+  }
+  BOOST_CHECK(llfio::map_handle::cache_statistics().items_in_cache == 1);
+  stats = llfio::map_handle::trim_cache();
+  BOOST_CHECK(stats.items_in_cache == 1);
+  stats = llfio::map_handle::cache_statistics();
+  BOOST_CHECK(stats.items_in_cache == 0);
+  BOOST_CHECK(stats.bytes_in_cache == 0);
+#endif
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, cache, "Tests that closed map_handle allocations are recycled", TestMapHandleCache())
@@ -0,0 +1,76 @@
+/* Integration test kernel for map_handle dirty page tracking
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestMapHandleDirtyTracking()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  const size_t pagesize = llfio::utils::page_size(), pages = 64;
+  llfio::map_handle::buffer_type regions[8];
+  auto mh = llfio::map_handle::map(pagesize * pages, false, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::track_dirty).value();
+  mh.clear_dirty().value();
+  mh.address()[3 * pagesize] = llfio::to_byte(78);
+  mh.address()[4 * pagesize + 1] = llfio::to_byte(78);
+  mh.address()[10 * pagesize + pagesize - 1] = llfio::to_byte(78);
+  auto dirty = mh.dirty_regions(regions).value();
+  BOOST_REQUIRE(!dirty.empty());
+  if(dirty.size() == 1 && dirty[0].size() == pagesize * pages)
+  {
+    std::cout << "NOTE: Dirty page tracking is not available on this platform, so the whole map was reported as dirty." << std::endl;
+  }
+  else
+  {
+    BOOST_REQUIRE(dirty.size() == 2);
+    BOOST_CHECK(dirty[0].data() == mh.address() + 3 * pagesize);
+    BOOST_CHECK(dirty[0].size() == 2 * pagesize);
+    BOOST_CHECK(dirty[1].data() == mh.address() + 10 * pagesize);
+    BOOST_CHECK(dirty[1].size() == pagesize);
+    // A full output is resumable from after its last extent
+    dirty = mh.dirty_regions({regions, 1}).value();
+    BOOST_REQUIRE(dirty.size() == 1);
+    BOOST_CHECK(dirty[0].data() == mh.address() + 3 * pagesize);
+    dirty = mh.dirty_regions(regions, {mh.address() + 5 * pagesize, (pages - 5) * pagesize}).value();
+    BOOST_REQUIRE(dirty.size() == 1);
+    BOOST_CHECK(dirty[0].data() == mh.address() + 10 * pagesize);
+    // Barriering the dirty extents clears them
+    BOOST_CHECK(mh.barrier_dirty({regions, 1}).value() == 3 * pagesize);
+    BOOST_CHECK(mh.dirty_regions(regions).value().empty());
+  }
+
+  // Maps of files flush only what was written
+  auto fh = llfio::file_handle::temp_inode().value();
+  fh.truncate(pagesize * pages).value();
+  auto sh = llfio::section_handle::section(fh).value();
+  auto fmh = llfio::map_handle::map(sh).value();
+  fmh.clear_dirty().value();
+  fmh.address()[7 * pagesize] = llfio::to_byte(78);
+  auto flushed = fmh.barrier_dirty(regions, llfio::map_handle::barrier_kind::wait_data_only).value();
+  BOOST_CHECK(flushed == pagesize || flushed == pagesize * pages);
+  llfio::byte buffer[1];
+  BOOST_CHECK(fh.read(7 * pagesize, {{buffer, 1}}).value() == 1);
+  BOOST_CHECK(buffer[0] == llfio::to_byte(78));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, dirty_tracking, "Tests that map_handle tracks and incrementally barriers dirty pages", TestMapHandleDirtyTracking())
@@ -0,0 +1,78 @@
+/* Integration test kernel for map_handle NUMA placement
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestMapHandleNumaPlacement()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  const size_t pagesize = llfio::utils::page_size(), pages = 16;
+  llfio::map_handle::numa_policy policy;
+  policy.policy = llfio::map_handle::numa_policy::kind::bind;
+  policy.nodes = 1;  // node 0 always exists
+  auto r = llfio::map_handle::map(pagesize * pages, policy);
+  if(!r && (r.error() == llfio::errc::operation_not_supported || r.error() == llfio::errc::function_not_supported))
+  {
+    std::cout << "NOTE: NUMA placement is not supported on this platform or kernel, skipping test" << std::endl;
+    return;
+  }
+  auto mh = std::move(r).value();
+  int nodes[pages * 2];
+  // Nothing is faulted in yet
+  auto filled = mh.numa_nodes(nodes);
+  if(!filled && filled.error() == llfio::errc::function_not_supported)
+  {
+    std::cout << "NOTE: This kernel was built without NUMA support, skipping test" << std::endl;
+    return;
+  }
+  BOOST_REQUIRE(filled.has_value());
+  BOOST_CHECK(filled.value().size() == pages);
+  for(auto node : filled.value())
+  {
+    BOOST_CHECK(node < 0);
+  }
+  for(size_t n = 0; n < pages; n++)
+  {
+    mh.address()[n * pagesize] = llfio::to_byte(78);
+  }
+  filled = mh.numa_nodes(nodes);
+  BOOST_REQUIRE(filled.has_value());
+  for(auto node : filled.value())
+  {
+    BOOST_CHECK(node == 0);
+  }
+  // Policies can be changed on parts of a map
+  policy.policy = llfio::map_handle::numa_policy::kind::local;
+  mh.set_numa_policy(policy, {mh.address(), pagesize * 2}).value();
+  // Policies without nodes are invalid
+  policy.policy = llfio::map_handle::numa_policy::kind::interleave;
+  policy.nodes = 0;
+  BOOST_CHECK(!mh.set_numa_policy(policy));
+  filled = mh.numa_nodes({nodes, 4}, {mh.address() + pagesize, pagesize * 8});
+  BOOST_REQUIRE(filled.has_value());
+  BOOST_CHECK(filled.value().size() == 4);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, numa, "Tests that map_handle NUMA placement works as expected", TestMapHandleNumaPlacement())
@@ -0,0 +1,90 @@
+/* Integration test kernel for whether map_handle prefaulting works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+static inline size_t resident_pages(const LLFIO_V2_NAMESPACE::byte *addr, size_t bytes)
+{
+  const size_t pagesize = LLFIO_V2_NAMESPACE::utils::page_size();
+#ifdef _WIN32
+  (void) addr;
+  return bytes / pagesize;
+#else
+  std::vector<unsigned char> vec(bytes / pagesize);
+#ifdef __linux__
+  if(-1 == ::mincore((void *) addr, bytes, vec.data()))
+#else
+  if(-1 == ::mincore((void *) addr, bytes, (char *) vec.data()))
+#endif
+  {
+    return 0;
+  }
+  size_t ret = 0;
+  for(auto c : vec)
+  {
+    ret += c & 1;
+  }
+  return ret;
+#endif
+}
+
+static inline void TestMapHandlePopulate()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 4 * 1024 * 1024;
+  const size_t pages = bytes / llfio::utils::page_size();
+  {
+    // Prefaulted for write on creation
+    auto mh = llfio::map_handle::map(bytes, false, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::prefault_write).value();
+    BOOST_CHECK(resident_pages(mh.address(), bytes) == pages);
+    BOOST_CHECK(mh.address()[bytes - 1] == llfio::to_byte(0));
+  }
+  {
+    // Explicitly populated later
+    auto mh = llfio::map_handle::map(bytes, true).value();
+    auto populated = llfio::map_handle::populate({mh.address() + 1, bytes - 2}).value();
+    BOOST_CHECK(populated.data() == mh.address());
+    BOOST_CHECK(populated.size() == bytes);
+    llfio::map_handle::populate({mh.address(), bytes}, true).value();
+    BOOST_CHECK(resident_pages(mh.address(), bytes) == pages);
+    // Asynchronous population must be safe even if the map goes away immediately
+    llfio::map_handle::populate({mh.address(), bytes}, true, true).value();
+  }
+  {
+    // A mapped file prefaults its extent, but not the reservation beyond it
+    auto mfh = llfio::mapped_file_handle::mapped_temp_inode(bytes, llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::mapped_file_handle::mode::write,
+                                                           llfio::mapped_file_handle::flag::none, llfio::section_handle::flag::prefault_write)
+               .value();
+    mfh.truncate(bytes / 2).value();
+    mfh.reserve(bytes).value();
+    BOOST_CHECK(resident_pages(mfh.address(), bytes / 2) == pages / 2);
+    memset(mfh.address(), 'a', bytes / 2);
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, map_handle, populate, "Tests that map_handle prefaulting works", TestMapHandlePopulate())
@@ -24,6 +24,8 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../test_kernel_decl.hpp"
 
+#include <vector>
+
 static inline void TestMappedView1()
 {
   using namespace LLFIO_V2_NAMESPACE;
@@ -147,5 +149,109 @@ static inline void TestMappedView2()
   BOOST_CHECK(mfh.address() == nullptr);
 }
 
+static inline void TestMappedNonTemporalWrite()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto mfh = llfio::mapped_temp_inode().value();
+  mfh.truncate(1024 * 1024).value();
+  BOOST_CHECK(mfh.nontemporal_write_threshold() == llfio::map_handle::default_nontemporal_write_threshold);
+  mfh.set_nontemporal_write_threshold(4096);
+  std::vector<llfio::byte> buffer(256 * 1024 + 13);
+  for(size_t n = 0; n < buffer.size(); n++)
+  {
+    buffer[n] = (llfio::byte)(n * 7 + 3);
+  }
+  // Misaligned writes both above and below the threshold
+  BOOST_CHECK(mfh.write(5, {{buffer.data(), buffer.size()}}).value() == buffer.size());
+  BOOST_CHECK(mfh.write(512 * 1024 + 1, {{buffer.data(), 100}}).value() == 100);
+  BOOST_CHECK(0 == memcmp(mfh.address() + 5, buffer.data(), buffer.size()));
+  BOOST_CHECK(0 == memcmp(mfh.address() + 512 * 1024 + 1, buffer.data(), 100));
+  BOOST_CHECK(mfh.address()[4] == llfio::byte(0));
+  BOOST_CHECK(mfh.address()[5 + buffer.size()] == llfio::byte(0));
+  // The threshold survives remapping
+  mfh.reserve(2 * 1024 * 1024).value();
+  BOOST_CHECK(mfh.nontemporal_write_threshold() == 4096);
+  BOOST_CHECK(0 == memcmp(mfh.address() + 5, buffer.data(), buffer.size()));
+}
+
+static inline void TestMappedScan()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  using LLFIO_V2_NAMESPACE::file_handle;
+  static constexpr size_t ITEMS = 1024 * 1024 + 7;
+  file_handle fh = file_handle::temp_inode().value();
+  fh.truncate(ITEMS * sizeof(uint64_t)).value();
+  {
+    mapped<uint64_t> v(fh);
+    BOOST_REQUIRE(v.size() == ITEMS);
+    for(size_t n = 0; n < ITEMS; n++)
+    {
+      v[n] = n;
+    }
+    // Scan with eviction just behind, with eviction further behind, and never evicting
+    for(map_handle::size_type evict_distance : {(map_handle::size_type) 0, (map_handle::size_type) 65536, (map_handle::size_type) -1})
+    {
+      uint64_t count = 0, sum = 0;
+      for(auto &i : v.scan(256 * 1024, evict_distance))
+      {
+        sum += i;
+        ++count;
+      }
+      BOOST_CHECK(count == ITEMS);
+      BOOST_CHECK(sum == (uint64_t) ITEMS * (ITEMS - 1) / 2);
+    }
+    auto range = v.scan(4096);
+    BOOST_CHECK(range.begin().position() == v.data());
+    BOOST_CHECK(range.end().position() == v.data() + ITEMS);
+    auto it = range.begin();
+    it += 1000;
+    BOOST_CHECK(*it == 1000);
+    BOOST_CHECK(*it++ == 1000);
+    BOOST_CHECK(*it == 1001);
+  }
+  // Evicting pages of a shared file map loses nothing
+  mapped<uint64_t> v(fh);
+  auto &mh = const_cast<map_handle &>(v.map());
+  auto evicted = mh.evict({mh.address() + 100, mh.length() - 100}).value();
+  BOOST_CHECK(evicted.data() == mh.address() + mh.page_size());
+  BOOST_CHECK(mh.evict({mh.address() + 100, 10}).value().empty());
+  for(size_t n = 0; n < ITEMS; n += 997)
+  {
+    BOOST_CHECK(v[n] == n);
+  }
+}
+
+static inline void TestMappedReserveResize()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto mfh = llfio::mapped_temp_inode(1024 * 1024).value();
+  mfh.truncate(1024 * 1024).value();
+  auto *p = reinterpret_cast<uint32_t *>(mfh.address());
+  for(uint32_t n = 0; n < 1024 * 1024 / sizeof(uint32_t); n++)
+  {
+    p[n] = n;
+  }
+  // Growing and shrinking the reservation resizes the existing map, keeping its contents
+  for(llfio::mapped_file_handle::size_type reservation : {(size_t) 64 * 1024 * 1024, (size_t) 4 * 1024 * 1024, (size_t) 1024 * 1024 * 1024})
+  {
+    BOOST_CHECK(mfh.reserve(reservation).value() == reservation);
+    BOOST_CHECK(mfh.capacity() == reservation);
+    BOOST_REQUIRE(mfh.map().length() == 1024 * 1024);
+    p = reinterpret_cast<uint32_t *>(mfh.address());
+    for(uint32_t n = 0; n < 1024 * 1024 / sizeof(uint32_t); n += 1021)
+    {
+      BOOST_CHECK(p[n] == n);
+    }
+  }
+  // Growing the file within the new reservation never moves the map
+  const auto *address = mfh.address();
+  mfh.truncate(512 * 1024 * 1024).value();
+  BOOST_CHECK(mfh.address() == address);
+  BOOST_CHECK(reinterpret_cast<uint32_t *>(mfh.address())[1021] == 1021);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_reserve_resize, "Tests that reserving resizes the map of a mapped_file_handle in place", TestMappedReserveResize())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_scan, "Tests that mapped_cursor scans, prefetches and evicts as expected", TestMappedScan())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_nontemporal_write, "Tests that large writes through maps using non-temporal stores work", TestMappedNonTemporalWrite())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_span1, "Tests that llfio::mapped works as expected", TestMappedView1())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_span2, "Tests that llfio::attached works as expected", TestMappedView2())
@@ -0,0 +1,103 @@
+/* Integration test kernel for mapped_arena and its containers
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <string>
+
+static inline void TestMappedArena()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using namespace llfio::algorithm;
+  static constexpr uint64_t ITEMS = 20000;
+  struct index_t
+  {
+    offset_vector<uint64_t> numbers;
+    offset_vector<offset_string> names;
+    offset_hash_map<offset_string, uint64_t, offset_string_hash> by_name;
+  };
+  auto mfh = llfio::mapped_temp_inode().value();
+  {
+    mapped_arena arena(mfh);
+    BOOST_CHECK(arena.root<index_t>() == nullptr);
+    arena.set_root(arena.construct<index_t>());
+    // Allocating remaps the arena as it grows, so the root is looked up afresh each time
+    for(uint64_t n = 0; n < ITEMS; n++)
+    {
+      const std::string name = "item" + std::to_string(n);
+      arena.root<index_t>()->numbers.push_back(arena, n);
+      arena.root<index_t>()->names.push_back(arena, name.c_str());
+      // The key is within the arena
+      arena.root<index_t>()->by_name.insert(arena, arena.root<index_t>()->names.back(), n);
+    }
+    BOOST_CHECK(arena.used() <= arena.capacity());
+  }
+  // Remap elsewhere, and reopen without deserialising anything
+  mfh.reserve(mfh.capacity() * 4).value();
+  mapped_arena arena(mfh);
+  const auto *root = arena.root<index_t>();
+  BOOST_REQUIRE(root != nullptr);
+  BOOST_REQUIRE(root->numbers.size() == ITEMS);
+  BOOST_REQUIRE(root->names.size() == ITEMS);
+  BOOST_CHECK(root->by_name.size() == ITEMS);
+  for(uint64_t n = 0; n < ITEMS; n++)
+  {
+    const std::string name = "item" + std::to_string(n);
+    BOOST_CHECK(root->numbers[n] == n);
+    BOOST_CHECK(root->names[n] == llfio::string_view(name));
+    BOOST_CHECK(root->names[n].c_str()[name.size()] == 0);
+    auto *v = root->by_name.find(llfio::string_view(name));
+    BOOST_CHECK(v != nullptr && *v == n);
+  }
+  BOOST_CHECK(root->by_name.find(llfio::string_view("nothing")) == nullptr);
+  size_t count = 0;
+  for(auto &item : root->by_name)
+  {
+    BOOST_CHECK(root->names[item.second] == item.first);
+    ++count;
+  }
+  BOOST_CHECK(count == ITEMS);
+
+  auto &name = arena.root<index_t>()->names[3].assign(arena, "a name much longer than the one before");
+  BOOST_CHECK(name == llfio::string_view("a name much longer than the one before"));
+  BOOST_CHECK(arena.root<index_t>()->by_name.erase(llfio::string_view("item7")));
+  BOOST_CHECK(!arena.root<index_t>()->by_name.contains(llfio::string_view("item7")));
+
+  // A file not written by an arena is refused
+  auto other = llfio::mapped_temp_inode().value();
+  other.truncate(4096).value();
+  bool refused = false;
+  try
+  {
+    mapped_arena bad(other);
+  }
+  catch(const std::invalid_argument &)
+  {
+    refused = true;
+  }
+  BOOST_CHECK(refused);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, mapped_arena, "Tests that mapped_arena and its containers survive remapping", TestMappedArena())
@@ -0,0 +1,87 @@
+/* Integration test kernel for concurrent appending to a mapped_file_handle
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <future>
+#include <vector>
+
+static inline void TestMappedFileHandleConcurrentAppend()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t THREADS = 4, RECORDS = 20000;
+  struct record_t
+  {
+    uint32_t thread, index;
+  };
+  auto mfh = llfio::mapped_temp_inode(1024 * 1024 * 1024).value();
+  BOOST_CHECK(!mfh.claim_append(sizeof(record_t)));
+  mfh.begin_concurrent_append(64 * 1024).value();
+  const auto address = mfh.address();
+  std::vector<std::future<size_t>> results;
+  for(size_t n = 0; n < THREADS; n++)
+  {
+    results.push_back(std::async(std::launch::async, [&, n]() -> size_t {
+      size_t ok = 0;
+      for(size_t i = 0; i < RECORDS; i++)
+      {
+        auto claimed = mfh.claim_append(sizeof(record_t));
+        if(!claimed || claimed.value().size() != sizeof(record_t))
+        {
+          break;
+        }
+        const record_t r{(uint32_t) n + 1, (uint32_t) i};
+        memcpy(claimed.value().data(), &r, sizeof(r));
+        ++ok;
+      }
+      return ok;
+    }));
+  }
+  for(auto &result : results)
+  {
+    BOOST_CHECK(result.get() == RECORDS);
+  }
+  // Growing within the reservation never moves the map
+  BOOST_CHECK(mfh.address() == address);
+  BOOST_CHECK(mfh.append_tail() == THREADS * RECORDS * sizeof(record_t));
+  BOOST_CHECK(mfh.end_concurrent_append().value() == THREADS * RECORDS * sizeof(record_t));
+  BOOST_CHECK(mfh.maximum_extent().value() == THREADS * RECORDS * sizeof(record_t));
+
+  // Every record must appear exactly once, and in order for each thread
+  std::vector<uint32_t> next(THREADS + 1, 0);
+  const auto *records = reinterpret_cast<const record_t *>(mfh.address());
+  for(size_t n = 0; n < THREADS * RECORDS; n++)
+  {
+    BOOST_REQUIRE(records[n].thread >= 1 && records[n].thread <= THREADS);
+    BOOST_CHECK(records[n].index == next[records[n].thread]++);
+  }
+
+  // Claims beyond the reservation fail rather than move the map
+  mfh.begin_concurrent_append(mfh.capacity() - mfh.maximum_extent().value()).value();
+  BOOST_CHECK(mfh.claim_append(mfh.capacity()).error() == llfio::errc::file_too_large);
+  BOOST_CHECK(mfh.end_concurrent_append().value() == THREADS * RECORDS * sizeof(record_t));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, mapped_file_handle, concurrent_append, "Tests that many threads can append to a mapped_file_handle concurrently",
+                       TestMappedFileHandleConcurrentAppend())
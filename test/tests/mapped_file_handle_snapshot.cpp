@@ -0,0 +1,62 @@
+/* Integration test kernel for mapped_file_handle snapshots
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestMappedFileHandleSnapshot()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 4 * 1024 * 1024;
+  auto mfh = llfio::mapped_file_handle::mapped_uniquely_named_file(bytes, llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::mapped_file_handle::mode::write, llfio::mapped_file_handle::caching::temporary,
+                                                                    llfio::mapped_file_handle::flag::unlink_on_first_close)
+             .value();
+  mfh.truncate(bytes).value();
+  for(size_t n = 0; n < bytes; n++)
+  {
+    mfh.address()[n] = llfio::to_byte((unsigned char) (n % 251));
+  }
+  auto snapshot = mfh.snapshot().value();
+  BOOST_REQUIRE(snapshot.maximum_extent().value() == bytes);
+  BOOST_CHECK(snapshot.address() != mfh.address());
+
+  // The writer carries on mutating, the snapshot must not see it
+  memset(mfh.address(), 0xff, bytes);
+  mfh.truncate(bytes / 2).value();
+  BOOST_CHECK(snapshot.maximum_extent().value() == bytes);
+  bool same = true;
+  for(size_t n = 0; n < bytes && same; n++)
+  {
+    same = snapshot.address()[n] == llfio::to_byte((unsigned char) (n % 251));
+  }
+  BOOST_CHECK(same);
+
+  // Snapshotting a file with a trailing hole preserves its length
+  mfh.truncate(bytes).value();
+  auto snapshot2 = mfh.snapshot().value();
+  BOOST_CHECK(snapshot2.maximum_extent().value() == bytes);
+  BOOST_CHECK(snapshot2.address()[0] == llfio::to_byte(0xff));
+  BOOST_CHECK(snapshot2.address()[bytes - 1] == llfio::to_byte(0));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, mapped_file_handle, snapshot, "Tests that mapped_file_handle snapshots are unaffected by later writes", TestMappedFileHandleSnapshot())
@@ -0,0 +1,57 @@
+/* Integration test kernel for whether mapped_file_handle pinned views work
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestMappedFileHandleView()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 1024 * 1024;
+  auto mfh = llfio::mapped_file_handle::mapped_uniquely_named_file(4 * bytes, llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::mapped_file_handle::mode::write, llfio::mapped_file_handle::caching::temporary,
+                                                                    llfio::mapped_file_handle::flag::unlink_on_first_close)
+             .value();
+  mfh.truncate(bytes).value();
+  memset(mfh.address(), 'a', bytes);
+  {
+    // Views point into the map, and are clamped to its length
+    auto v = mfh.view(bytes - 16, 64).value();
+    BOOST_CHECK(v.data() == mfh.address() + bytes - 16);
+    BOOST_CHECK(v.size() == 16);
+    BOOST_CHECK(mfh.pinned_views() == 1);
+    BOOST_CHECK(mfh.view(2 * bytes, 64).value().empty());
+
+    // Whilst pinned, the map may not shrink nor relocate, but may grow within the reservation
+    BOOST_CHECK(mfh.truncate(bytes / 2).error() == llfio::errc::device_or_resource_busy);
+    BOOST_CHECK(mfh.truncate(8 * bytes).error() == llfio::errc::device_or_resource_busy);
+    BOOST_CHECK(mfh.reserve(8 * bytes).error() == llfio::errc::device_or_resource_busy);
+    BOOST_CHECK(mfh.truncate(2 * bytes).value() == 2 * bytes);
+    BOOST_CHECK(v.data()[0] == llfio::to_byte('a'));
+    v.reset();
+    BOOST_CHECK(v.empty());
+  }
+  BOOST_CHECK(mfh.pinned_views() == 0);
+  BOOST_CHECK(mfh.truncate(bytes / 2).value() == bytes / 2);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, mapped_file_handle, view, "Tests that mapped_file_handle pinned views prevent the map being invalidated", TestMappedFileHandleView())
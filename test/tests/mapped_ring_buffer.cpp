@@ -0,0 +1,90 @@
+/* Integration test kernel for mapped_ring_buffer
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <thread>
+
+static inline void TestMappedRingBuffer()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto rb = llfio::mapped_ring_buffer::ring_buffer(1).value();
+  const size_t capacity = rb.capacity();
+  BOOST_REQUIRE(capacity >= llfio::utils::page_size());
+  // Both maps see the same memory
+  rb.address()[0] = llfio::to_byte(78);
+  BOOST_CHECK(rb.address()[capacity] == llfio::to_byte(78));
+  rb.address()[capacity * 2 - 1] = llfio::to_byte(79);
+  BOOST_CHECK(rb.address()[capacity - 1] == llfio::to_byte(79));
+
+  // A span written across the wrap boundary reads back contiguously
+  rb.commit_write(capacity - 3);
+  rb.commit_read(capacity - 3);
+  auto w = rb.write_span();
+  BOOST_REQUIRE(w.size() == capacity);
+  BOOST_CHECK(w.data() == rb.address() + capacity - 3);
+  memcpy(w.data(), "hello", 5);
+  rb.commit_write(5);
+  auto r = rb.read_span();
+  BOOST_REQUIRE(r.size() == 5);
+  BOOST_CHECK(0 == memcmp(r.data(), "hello", 5));
+  BOOST_CHECK(0 == memcmp(rb.address(), "lo", 2));
+  rb.commit_read(5);
+  BOOST_CHECK(rb.empty());
+
+  // A producer and consumer on separate threads, with records of awkward sizes
+  static constexpr uint64_t total = 16 * 1024 * 1024;
+  std::thread producer([&] {
+    uint64_t written = 0;
+    while(written < total)
+    {
+      auto span = rb.write_span();
+      size_t todo = (std::min)((size_t) (total - written), (std::min)(span.size(), (size_t) 4093));
+      for(size_t n = 0; n < todo; n++)
+      {
+        span[n] = llfio::to_byte((unsigned char) ((written + n) % 251));
+      }
+      rb.commit_write(todo);
+      written += todo;
+    }
+  });
+  uint64_t read = 0;
+  bool ok = true;
+  while(read < total)
+  {
+    auto span = rb.read_span();
+    for(size_t n = 0; n < span.size() && ok; n++)
+    {
+      ok = span[n] == llfio::to_byte((unsigned char) ((read + n) % 251));
+    }
+    rb.commit_read(span.size());
+    read += span.size();
+  }
+  producer.join();
+  BOOST_CHECK(ok);
+  rb.close().value();
+  BOOST_CHECK(!rb.is_valid());
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, mapped_ring_buffer, wraparound, "Tests that mapped_ring_buffer spans wrap around contiguously", TestMappedRingBuffer())
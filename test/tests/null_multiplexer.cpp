@@ -0,0 +1,133 @@
+/* Integration test kernel for whether the null multiplexer simulates devices
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
+static inline void TestNullMultiplexerSimulatedDevice()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t OPS = 8, BYTES = 1024 * 1024;
+  auto fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(BYTES);
+
+  // Initiates OPS reads at once, returning how long until all of them finished
+  auto time_reads = [&](llfio::io_multiplexer *multiplexer) {
+    const auto state_reqs = multiplexer->io_state_requirements();
+    const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+    std::vector<llfio::byte> storage(state_size * OPS + state_reqs.second);
+    auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+    std::vector<llfio::file_handle::buffer_type> bs(OPS, {buffer.data(), BYTES});
+    std::vector<llfio::io_multiplexer::io_operation_state *> states;
+    const auto begin = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < OPS; n++)
+    {
+      states.push_back(multiplexer->construct_and_init_io_operation({base + n * state_size, state_size}, &fh, nullptr, {}, {},
+                                                                    llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&bs[n], 1}, 0)));
+    }
+    multiplexer->flush_inited_io_operations().value();
+    for(;;)
+    {
+      bool alldone = true;
+      for(auto *state : states)
+      {
+        if(!is_finished(multiplexer->check_io_operation(state)))
+        {
+          alldone = false;
+        }
+      }
+      if(alldone)
+      {
+        break;
+      }
+      multiplexer->check_for_any_completed_io().value();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    for(auto *state : states)
+    {
+      BOOST_CHECK(std::move(*state).get_completed_read().has_value());
+      state->~io_operation_state();
+    }
+    return elapsed;
+  };
+
+  for(size_t threads : {1, 2})
+  {
+    // A blocking read must take the latency of the device
+    {
+      llfio::test::null_device device;
+      device.read.mean = std::chrono::milliseconds(20);
+      auto multiplexer = llfio::test::multiplexer_null(threads, false, device).value();
+      fh.set_multiplexer(multiplexer.get()).value();
+      const auto begin = std::chrono::steady_clock::now();
+      BOOST_CHECK(fh.read(0, {{buffer.data(), BYTES}}).value() == BYTES);
+      BOOST_CHECK(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(20));
+      fh.set_multiplexer(nullptr).value();
+    }
+    // With unlimited queue depth the reads are serviced concurrently, with a queue depth of two in four rounds
+    {
+      llfio::test::null_device device;
+      device.read.mean = std::chrono::milliseconds(20);
+      auto multiplexer = llfio::test::multiplexer_null(threads, false, device).value();
+      fh.set_multiplexer(multiplexer.get()).value();
+      BOOST_CHECK(time_reads(multiplexer.get()) >= std::chrono::milliseconds(20));
+      fh.set_multiplexer(nullptr).value();
+      device.queue_depth = 2;
+      multiplexer = llfio::test::multiplexer_null(threads, false, device).value();
+      fh.set_multiplexer(multiplexer.get()).value();
+      BOOST_CHECK(time_reads(multiplexer.get()) >= std::chrono::milliseconds(80));
+      fh.set_multiplexer(nullptr).value();
+    }
+    // At 100Mb/sec, 8Mb of reads must take at least 80ms
+    {
+      llfio::test::null_device device;
+      device.bytes_per_second = 100 * BYTES;
+      auto multiplexer = llfio::test::multiplexer_null(threads, false, device).value();
+      fh.set_multiplexer(multiplexer.get()).value();
+      BOOST_CHECK(time_reads(multiplexer.get()) >= std::chrono::milliseconds(80));
+      fh.set_multiplexer(nullptr).value();
+    }
+    // Exponential latencies must average to their mean
+    {
+      llfio::test::null_device device;
+      device.read.kind = llfio::test::null_device::distribution::exponential;
+      device.read.mean = std::chrono::milliseconds(5);
+      auto multiplexer = llfio::test::multiplexer_null(threads, false, device).value();
+      fh.set_multiplexer(multiplexer.get()).value();
+      const auto begin = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < 40; n++)
+      {
+        fh.read(0, {{buffer.data(), BYTES}}).value();
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - begin;
+      std::cout << "40 reads of mean latency 5ms took " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms" << std::endl;
+      BOOST_CHECK(elapsed >= std::chrono::milliseconds(50));
+      fh.set_multiplexer(nullptr).value();
+    }
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, null_multiplexer, simulated_device, "Tests that the null multiplexer simulates device latency, queue depth and bandwidth",
+                       TestNullMultiplexerSimulatedDevice())
+#endif
@@ -0,0 +1,156 @@
+/* Integration test kernel for whether the interned path table works
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <algorithm>
+#include <set>
+#include <string>
+
+static inline void TestPathTable()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = LLFIO_V2_NAMESPACE::algorithm;
+  using algorithm::path_table;
+
+  // Interning the same thing twice returns the same id
+  {
+    path_table paths;
+    BOOST_CHECK(paths.size() == 1);
+    auto a = paths.intern(path_table::root, "a").value();
+    auto ab = paths.intern(a, "b").value();
+    BOOST_CHECK(paths.intern(path_table::root, "a").value() == a);
+    BOOST_CHECK(paths.intern("a/b").value() == ab);
+    BOOST_CHECK(paths.find("a/b").value() == ab);
+    BOOST_CHECK(paths.find(a, "c").error() == llfio::errc::no_such_file_or_directory);
+    BOOST_CHECK(paths.parent(ab) == a);
+    BOOST_CHECK(paths.depth(ab) == 2);
+    BOOST_CHECK(paths.leaf(ab) == llfio::path_view_component("b"));
+    BOOST_CHECK(paths.leaf(ab).has_zero_termination());
+    BOOST_CHECK(paths.path(ab).value() == llfio::filesystem::path("a") / "b");
+    BOOST_CHECK(paths.path(path_table::root).value().empty());
+    // The same leafname in a different directory is a different path, with a different hash
+    auto b = paths.intern(path_table::root, "b").value();
+    BOOST_CHECK(b != ab);
+    BOOST_CHECK(paths.hash(b) != paths.hash(ab));
+    BOOST_CHECK(paths.size() == 4);
+    BOOST_CHECK(paths.intern(100, "x").error() == llfio::errc::invalid_argument);
+
+    // Growing the hash table keeps every id findable
+    std::vector<path_table::id_type> ids;
+    for(size_t n = 0; n < 10000; n++)
+    {
+      ids.push_back(paths.intern(ab, std::to_string(n)).value());
+    }
+    for(size_t n = 0; n < 10000; n++)
+    {
+      BOOST_REQUIRE(paths.find(ab, std::to_string(n)).value() == ids[n]);
+    }
+    BOOST_CHECK(paths.path(ids[1234]).value() == llfio::filesystem::path("a") / "b" / "1234");
+    paths.clear();
+    BOOST_CHECK(paths.size() == 1);
+    BOOST_CHECK(paths.find("a").error() == llfio::errc::no_such_file_or_directory);
+  }
+
+  // interned_contents() and summarize() find the same paths as contents()
+  auto root = llfio::directory_handle::temp_directory().value();
+  {
+    auto a = llfio::directory_handle::directory(root, "a", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+    auto b = llfio::directory_handle::directory(a, "b", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value();
+    llfio::file_handle::file(a, "f1", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    llfio::file_handle::file(b, "f2", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    llfio::file_handle::file(root, "f3", llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+  }
+  std::set<llfio::filesystem::path> expected;
+  for(auto &i : algorithm::contents(root).value())
+  {
+    expected.insert(i.first);
+  }
+  BOOST_CHECK(expected.size() == 5);
+  {
+    auto interned = algorithm::interned_contents(root).value();
+    std::set<llfio::filesystem::path> found;
+    for(auto &i : interned)
+    {
+      found.insert(interned.paths.path(i.first).value());
+    }
+    BOOST_CHECK(found == expected);
+  }
+  {
+    algorithm::contents_visitor visitor(llfio::stat_t::want::size, true, false, false);
+    auto interned = algorithm::interned_contents(root, &visitor).value();
+    BOOST_CHECK(interned.size() == 3);
+    BOOST_CHECK(interned.paths.find("a/b").has_value());  // directories above an item are always interned
+  }
+  {
+    algorithm::contents_visitor visitor(llfio::stat_t::want::size | llfio::stat_t::want::mtim | llfio::stat_t::want::uid);
+    auto table = algorithm::tabulated_contents(root, &visitor, 0, true).value();
+    BOOST_REQUIRE(table.size() == expected.size());
+    BOOST_CHECK(table.metadata == (llfio::stat_t::want::type | llfio::stat_t::want::size | llfio::stat_t::want::mtim));
+    BOOST_CHECK(table.st_size.size() == table.size());
+    BOOST_CHECK(table.st_ino.empty());
+    size_t n = 0;
+    for(auto &i : expected)
+    {
+      BOOST_CHECK(table.path(n++).path() == i);  // sorted as filesystem::path sorts
+    }
+  }
+  {
+    // A table large enough to be sorted by many threads sorts identically to filesystem::path
+    algorithm::contents_visitor::contents_table table;
+    std::vector<llfio::filesystem::path> paths;
+    for(size_t n = 0; n < 200000; n++)
+    {
+      const auto v = (uint32_t) (((uint64_t) n * 2654435761ULL) % 200000);
+      const auto dir = std::to_string(v % 97) + ((v & 1) ? "-x" : "");
+      const auto leaf = std::to_string(v);
+      table.push_back(dir, leaf, llfio::stat_t(nullptr));
+      paths.push_back(llfio::filesystem::path(dir) / leaf);
+    }
+    table.sort(4);
+    std::sort(paths.begin(), paths.end());
+    BOOST_REQUIRE(table.size() == paths.size());
+    for(size_t n = 0; n < paths.size(); n++)
+    {
+      if(table.path(n).path() != paths[n])
+      {
+        BOOST_CHECK(table.path(n).path() == paths[n]);
+        break;
+      }
+    }
+  }
+  {
+    path_table paths;
+    auto summary = algorithm::summarize(root, paths).value();
+    BOOST_CHECK(summary.types[llfio::filesystem::file_type::regular] == 3);
+    BOOST_CHECK(paths.size() == expected.size() + 1);
+    for(auto &i : expected)
+    {
+      BOOST_CHECK(paths.find(i).has_value());
+    }
+  }
+  algorithm::reduce(std::move(root)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, path_table, "Tests that llfio::algorithm::path_table works as expected", TestPathTable())
@@ -101,6 +101,16 @@ static inline void CheckPathIteration(const LLFIO_V2_NAMESPACE::filesystem::path
   BOOST_CHECK(it2 == test2.begin());
   std::cout << "   " << *it1 << " == " << *it2 << "?" << std::endl;
   BOOST_CHECK(*it1 == it2->path());
+  // Splitting must yield exactly what iteration does
+  LLFIO_V2_NAMESPACE::path_view_component components[16];
+  const size_t count = test2.split(components);
+  size_t n = 0;
+  for(auto it = test2.begin(); it != test2.end(); ++it, n++)
+  {
+    BOOST_REQUIRE(n < count);
+    BOOST_CHECK(*it == components[n]);
+  }
+  BOOST_CHECK(n == count);
 }
 
 static inline void TestPathView()
@@ -230,10 +240,89 @@ static inline void TestPathView()
   CheckPathIteration("a/c");
   CheckPathIteration("a/c/");
 
+  // Splitting paths with more separators than are found in one batch
+  {
+    std::string longpath;
+    for(size_t n = 0; n < 200; n++)
+    {
+      longpath.append((n % 3) ? "/foo" : "//");
+    }
+    llfio::path_view v(longpath);
+    std::vector<llfio::path_view_component> components(100);
+    const size_t count = v.split(components);
+    size_t n = 0;
+    for(auto it = v.begin(); it != v.end(); ++it, n++)
+    {
+      if(n < components.size())
+      {
+        BOOST_CHECK(*it == components[n]);
+      }
+    }
+    BOOST_CHECK(n == count);
+    BOOST_CHECK(count > components.size());
+    llfio::path_view_component filename[1];
+    BOOST_CHECK(llfio::path_view("foo", 3, llfio::path_view::not_zero_terminated).split(filename) == 1);
+    BOOST_CHECK(filename[0] == llfio::path_view_component("foo", 3, llfio::path_view::not_zero_terminated));
+  }
+  // Equal components hash equally
+  {
+    llfio::path_view_component components[4];
+    BOOST_REQUIRE(llfio::path_view("/foo/bar/foo").split(components) == 4);
+    BOOST_CHECK(components[1].hash() == components[3].hash());
+    BOOST_CHECK(components[1].hash() != components[2].hash());
+    BOOST_CHECK(std::hash<llfio::path_view_component>()(components[1]) == std::hash<llfio::path_view_component>()(components[3]));
+  }
+
   // Does visitation work right?
   visit(llfio::path_view("hi"), [](auto sv) { BOOST_CHECK(0 == memcmp(sv.data(), "hi", 2)); });
   visit(*llfio::path_view(L"hi").begin(), [](auto sv) { BOOST_CHECK(0 == memcmp(sv.data(), L"hi", 4)); });
 
+  // UTF reencoding, within the internal buffer and of paths longer than it
+  {
+    using namespace LLFIO_V2_NAMESPACE;
+    using utf8_type = char8_t;
+    const char16_t utf16[] = u"a\u00e9\u20ac\U0001F600z";
+    const char utf8[] = "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z";
+    const wchar_t wide[] = L"a\u00e9\u20ac\U0001F600z";
+    path_view::c_str<char> a(path_view_component(utf16, 6, path_view::zero_terminated), path_view::zero_terminated);
+    BOOST_CHECK(a.length == strlen(utf8));
+    BOOST_CHECK(0 == memcmp(a.buffer, utf8, sizeof(utf8)));
+    std::u16string longutf16;
+    std::string longutf8;
+    std::wstring longwide;
+    for(size_t n = 0; n < 1000; n++)
+    {
+      longutf16.append(utf16);
+      longutf8.append(utf8);
+      longwide.append(wide);
+    }
+    path_view::c_str<char> b(path_view_component(longutf16.data(), longutf16.size(), path_view::zero_terminated), path_view::zero_terminated);
+    BOOST_CHECK(b.length == longutf8.size());
+    BOOST_CHECK(0 == memcmp(b.buffer, longutf8.c_str(), longutf8.size() + 1));
+    path_view::c_str<wchar_t> c(path_view_component(reinterpret_cast<const utf8_type *>(longutf8.data()), longutf8.size(), path_view::not_zero_terminated),
+                                path_view::zero_terminated);
+    BOOST_CHECK(c.length == longwide.size());
+    BOOST_CHECK(0 == memcmp(c.buffer, longwide.c_str(), (longwide.size() + 1) * sizeof(wchar_t)));
+    // Invalid input is refused
+    auto refused = [](auto &&f) {
+      try
+      {
+        f();
+        return false;
+      }
+      catch(const std::system_error &)
+      {
+        return true;
+      }
+    };
+    const char16_t lonesurrogate[] = {u'a', (char16_t) 0xd800, u'b', 0};
+    BOOST_CHECK(refused([&] { path_view::c_str<char>(path_view_component(lonesurrogate, 3, path_view::zero_terminated), path_view::zero_terminated); }));
+    const char overlong[] = "a\xc0\xaf" "b";
+    BOOST_CHECK(refused([&] {
+      path_view::c_str<wchar_t>(path_view_component(reinterpret_cast<const utf8_type *>(overlong), 4, path_view::zero_terminated), path_view::zero_terminated);
+    }));
+  }
+
   // Custom allocator and deleter
   {
     struct custom_allocate
@@ -281,6 +370,31 @@ static inline void TestPathView()
     BOOST_CHECK(resource.deleted == 1);
     BOOST_CHECK(zbuff.memory_resource() == &resource);
   }
+  // Arena memory_resource
+  {
+    llfio::byte storage[16];
+    llfio::path_view_arena arena(storage);
+    llfio::path_view v("foo", 3, llfio::path_view::not_zero_terminated);
+    {
+      llfio::path_view_arena::scope s(arena);
+      llfio::path_view::c_str<char, std::default_delete<char[]>, 0> a(v, llfio::path_view::zero_terminated, arena);
+      llfio::path_view::c_str<char, std::default_delete<char[]>, 0> b(v, llfio::path_view::zero_terminated, arena);
+      BOOST_CHECK((void *) a.buffer == storage);
+      BOOST_CHECK((void *) b.buffer == storage + 4);
+      BOOST_CHECK(0 == strcmp(b.buffer, "foo"));
+      BOOST_CHECK(arena.used() == 8);
+      // Exhausting the arena falls back to the heap
+      llfio::path_view w("foobarfoobar", 12, llfio::path_view::not_zero_terminated);
+      llfio::path_view::c_str<char, std::default_delete<char[]>, 0> c(w, llfio::path_view::zero_terminated, arena);
+      BOOST_CHECK(0 == strcmp(c.buffer, "foobarfoobar"));
+      BOOST_CHECK(((void *) c.buffer < storage || (void *) c.buffer >= storage + sizeof(storage)));
+      BOOST_CHECK(arena.used() == 8);
+    }
+    BOOST_CHECK(arena.used() == 0);
+    auto &threadarena = llfio::path_view_arena::this_thread();
+    BOOST_CHECK(&threadarena == &llfio::path_view_arena::this_thread());
+    BOOST_CHECK(threadarena.capacity() == llfio::path_view_arena::thread_arena_size);
+  }
   // Custom STL allocator
   {
     struct custom_allocator
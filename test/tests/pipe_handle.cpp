@@ -94,7 +94,7 @@ static inline void TestNonBlockingPipeHandle()
   reader.close().value();
 }
 
-#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
+#if defined(_WIN32) || defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
 static inline void TestMultiplexedPipeHandle()
 {
   static constexpr size_t MAX_PIPES = 64;
@@ -242,13 +242,33 @@ static inline void TestMultiplexedPipeHandle()
   };
 #ifdef _WIN32
   std::cout << "\nSingle threaded IOCP, immediate completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(1, false).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(1, false).value());
   std::cout << "\nSingle threaded IOCP, reactor completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(1, true).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(1, true).value());
   std::cout << "\nMultithreaded IOCP, immediate completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(2, false).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(2, false).value());
   std::cout << "\nMultithreaded IOCP, reactor completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(2, true).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(2, true).value());
+#elif defined(__linux__)
+  std::cout << "\nSingle threaded epoll:\n";
+  test_multiplexer(llfio::multiplexer_linux_epoll(1).value());
+  std::cout << "\nMultithreaded epoll:\n";
+  test_multiplexer(llfio::multiplexer_linux_epoll(2).value());
+  auto multiplexer = llfio::multiplexer_linux_io_uring(1, false);
+  if(!multiplexer)
+  {
+    std::cout << "\nio_uring is not available on this kernel (" << multiplexer.error().message().c_str() << "), skipping." << std::endl;
+    return;
+  }
+  std::cout << "\nSingle threaded io_uring:\n";
+  test_multiplexer(std::move(multiplexer).value());
+  std::cout << "\nMultithreaded io_uring:\n";
+  test_multiplexer(llfio::multiplexer_linux_io_uring(2, false).value());
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+  std::cout << "\nSingle threaded kqueue:\n";
+  test_multiplexer(llfio::multiplexer_bsd_kqueue(1).value());
+  std::cout << "\nMultithreaded kqueue:\n";
+  test_multiplexer(llfio::multiplexer_bsd_kqueue(2).value());
 #else
 #error Not implemented yet
 #endif
@@ -353,13 +373,33 @@ static inline void TestCoroutinedPipeHandle()
   };
 #ifdef _WIN32
   std::cout << "\nSingle threaded IOCP, immediate completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(1, false).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(1, false).value());
   std::cout << "\nSingle threaded IOCP, reactor completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(1, true).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(1, true).value());
   std::cout << "\nMultithreaded IOCP, immediate completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(2, false).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(2, false).value());
   std::cout << "\nMultithreaded IOCP, reactor completions:\n";
-  test_multiplexer(llfio::test::multiplexer_win_iocp(2, true).value());
+  test_multiplexer(llfio::multiplexer_win_iocp(2, true).value());
+#elif defined(__linux__)
+  std::cout << "\nSingle threaded epoll:\n";
+  test_multiplexer(llfio::multiplexer_linux_epoll(1).value());
+  std::cout << "\nMultithreaded epoll:\n";
+  test_multiplexer(llfio::multiplexer_linux_epoll(2).value());
+  auto multiplexer = llfio::multiplexer_linux_io_uring(1, false);
+  if(!multiplexer)
+  {
+    std::cout << "\nio_uring is not available on this kernel (" << multiplexer.error().message().c_str() << "), skipping." << std::endl;
+    return;
+  }
+  std::cout << "\nSingle threaded io_uring:\n";
+  test_multiplexer(std::move(multiplexer).value());
+  std::cout << "\nMultithreaded io_uring:\n";
+  test_multiplexer(llfio::multiplexer_linux_io_uring(2, false).value());
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+  std::cout << "\nSingle threaded kqueue:\n";
+  test_multiplexer(llfio::multiplexer_bsd_kqueue(1).value());
+  std::cout << "\nMultithreaded kqueue:\n";
+  test_multiplexer(llfio::multiplexer_bsd_kqueue(2).value());
 #else
 #error Not implemented yet
 #endif
@@ -367,11 +407,147 @@ static inline void TestCoroutinedPipeHandle()
 #endif
 #endif
 
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+static inline void TestPooledPipeHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+#ifdef __linux__
+  auto multiplexer = llfio::multiplexer_linux_epoll(1).value();
+#else
+  auto multiplexer = llfio::multiplexer_bsd_kqueue(1).value();
+#endif
+  auto pipes = llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::reads, llfio::pipe_handle::flag::multiplexable).value();
+  pipes.first.set_multiplexer(multiplexer.get()).value();
+  pipes.second.set_multiplexer(multiplexer.get()).value();
+  llfio::io_multiplexer::io_operation_state *last = nullptr;
+  for(size_t n = 0; n < 1000; n++)
+  {
+    llfio::byte buffer[sizeof(size_t)];
+    llfio::pipe_handle::buffer_type b(buffer, sizeof(buffer));
+    auto read = multiplexer->construct_and_init_pooled(&pipes.first, nullptr, {}, {}, llfio::pipe_handle::io_request<llfio::pipe_handle::buffers_type>({&b, 1}, 0)).value();
+    BOOST_REQUIRE(((uintptr_t) read.get() & 63) == 0);  // cache line aligned
+    if(last != nullptr)
+    {
+      // Freed storage is reused by the same thread
+      BOOST_CHECK(read.get() == last);
+    }
+    last = read.get();
+    auto written = pipes.second.write(0, {{(const llfio::byte *) &n, sizeof(n)}}).value();
+    BOOST_REQUIRE(written == sizeof(n));
+    while(!is_finished(multiplexer->check_io_operation(read.get())))
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    }
+    BOOST_REQUIRE(std::move(*read).get_completed_read().value().size() == 1);
+    size_t v;
+    memcpy(&v, buffer, sizeof(v));
+    BOOST_CHECK(v == n);
+  }
+}
+#endif
+
+static inline void TestSplicePipeHandle()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto pipes = llfio::pipe_handle::anonymous_pipe().value();
+  auto fh = llfio::file_handle::temp_inode().value();
+  static const char text[] = "hello world";
+  llfio::pipe_handle::const_buffer_type b((const llfio::byte *) text, 11);
+  BOOST_REQUIRE(pipes.second.splice_from({&b, 1}).value() == 11);
+#ifdef __linux__
+  {
+    // Tee does not consume the pipe's content
+    auto teed = llfio::pipe_handle::anonymous_pipe().value();
+    BOOST_REQUIRE(pipes.first.tee_to(teed.second, 64).value() == 11);
+    llfio::byte buffer[64];
+    BOOST_REQUIRE(teed.first.read(0, {{buffer, 64}}).value() == 11);
+    BOOST_CHECK(0 == memcmp(buffer, text, 11));
+  }
+#else
+  BOOST_CHECK(pipes.first.tee_to(pipes.second, 64).error() == llfio::errc::operation_not_supported);
+#endif
+  BOOST_REQUIRE(pipes.first.splice_to(fh, 5, 64).value() == 11);
+  BOOST_CHECK(fh.maximum_extent().value() == 16);
+  {
+    llfio::byte buffer[64];
+    BOOST_REQUIRE(fh.read(5, {{buffer, 64}}).value() == 11);
+    BOOST_CHECK(0 == memcmp(buffer, text, 11));
+  }
+  BOOST_REQUIRE(pipes.second.splice_from(fh, 11, 64).value() == 5);
+  {
+    llfio::byte buffer[64];
+    BOOST_REQUIRE(pipes.first.read(0, {{buffer, 64}}).value() == 5);
+    BOOST_CHECK(0 == memcmp(buffer, "world", 5));
+  }
+#ifdef __linux__
+  // Asynchronous splicing is a batch of POSIX syscalls
+  auto multiplexer = llfio::multiplexer_linux_io_uring(1, false);
+  if(!multiplexer)
+  {
+    std::cout << "\nio_uring is not available on this kernel (" << multiplexer.error().message().c_str() << "), skipping." << std::endl;
+    return;
+  }
+  using posix_fs_syscall = llfio::io_multiplexer::posix_fs_syscall;
+  BOOST_REQUIRE(pipes.second.write(0, {{(const llfio::byte *) text, 11}}).value() == 11);
+  posix_fs_syscall op;
+  op.op = posix_fs_syscall::kind::splice;
+  op.fd = pipes.first.native_handle().fd;
+  op.offset = posix_fs_syscall::no_offset;
+  op.fd_out = fh.native_handle().fd;
+  op.offset_out = 100;
+  op.bytes = 64;
+  multiplexer.value()->do_posix_fs_syscalls({&op, 1}).value();
+  BOOST_REQUIRE(op.result == 11);
+  llfio::byte buffer[64];
+  BOOST_REQUIRE(fh.read(100, {{buffer, 64}}).value() == 11);
+  BOOST_CHECK(0 == memcmp(buffer, text, 11));
+#endif
+}
+
+static inline void TestPipeHandleCapacity()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+#ifdef __linux__
+  auto pipes = llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::all, llfio::pipe_handle::flag::none, 256 * 1024).value();
+  BOOST_CHECK(pipes.first.capacity().value() >= 256 * 1024);
+  BOOST_CHECK(pipes.second.capacity().value() >= 256 * 1024);
+  BOOST_REQUIRE(pipes.first.set_capacity(128 * 1024).value() >= 128 * 1024);
+  BOOST_CHECK(pipes.first.capacity().value() < 256 * 1024);
+#else
+  auto pipes = llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::all, llfio::pipe_handle::flag::none, 256 * 1024).value();
+#endif
+  // Draining reads fill as many buffers as there are bytes available
+  std::vector<llfio::byte> out(1000), in(1024);
+  for(size_t n = 0; n < out.size(); n++)
+  {
+    out[n] = llfio::to_byte((unsigned char) n);
+  }
+  for(size_t n = 0; n < out.size(); n += 100)
+  {
+    BOOST_REQUIRE(pipes.second.write(0, {{out.data() + n, 100}}).value() == 100);
+  }
+  llfio::pipe_handle::buffer_type bs[4] = {{in.data(), 256}, {in.data() + 256, 256}, {in.data() + 512, 256}, {in.data() + 768, 256}};
+  llfio::pipe_handle::io_request<llfio::pipe_handle::buffers_type> req(bs, 0, llfio::pipe_handle::io_request_flag::drain);
+  auto read = pipes.first.read(req).value();
+  size_t bytes = 0;
+  for(auto &b : read)
+  {
+    bytes += b.size();
+  }
+  BOOST_REQUIRE(bytes == 1000);
+  BOOST_CHECK(0 == memcmp(in.data(), out.data(), 1000));
+}
+
 KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, blocking, "Tests that blocking llfio::pipe_handle works as expected", TestBlockingPipeHandle())
 KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, nonblocking, "Tests that nonblocking llfio::pipe_handle works as expected", TestNonBlockingPipeHandle())
-#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
+KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, capacity, "Tests that llfio::pipe_handle capacity and draining reads work as expected", TestPipeHandleCapacity())
+KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, splice, "Tests that llfio::pipe_handle splicing works as expected", TestSplicePipeHandle())
+#if defined(_WIN32) || defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
 KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, multiplexed, "Tests that multiplexed llfio::pipe_handle works as expected", TestMultiplexedPipeHandle())
 #if LLFIO_ENABLE_COROUTINES
 KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, coroutined, "Tests that coroutined llfio::pipe_handle works as expected", TestCoroutinedPipeHandle())
 #endif
 #endif
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+KERNELTEST_TEST_KERNEL(integration, llfio, pipe_handle, pooled, "Tests that pooled i/o states for llfio::pipe_handle work as expected", TestPooledPipeHandle())
+#endif
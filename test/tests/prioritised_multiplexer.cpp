@@ -0,0 +1,117 @@
+/* Integration test kernel for whether the prioritised multiplexer limits i/o by class
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
+static inline void TestPrioritisedMultiplexerLimits()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t OPS = 4, BYTES = 4096;
+  auto fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(BYTES);
+
+  // Initiates OPS reads at once with request flags `flags`, returning how long until all of them finished
+  auto time_reads = [&](llfio::io_multiplexer *multiplexer, llfio::io_request_flag flags) {
+    const auto state_reqs = multiplexer->io_state_requirements();
+    const size_t state_size = (state_reqs.first + state_reqs.second - 1) & ~(state_reqs.second - 1);
+    std::vector<llfio::byte> storage(state_size * OPS + state_reqs.second);
+    auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+    std::vector<llfio::file_handle::buffer_type> bs(OPS, {buffer.data(), BYTES});
+    std::vector<llfio::io_multiplexer::io_operation_state *> states;
+    const auto begin = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < OPS; n++)
+    {
+      states.push_back(multiplexer->construct_and_init_io_operation({base + n * state_size, state_size}, &fh, nullptr, {}, {},
+                                                                    llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&bs[n], 1}, 0, flags)));
+    }
+    multiplexer->flush_inited_io_operations().value();
+    for(;;)
+    {
+      bool alldone = true;
+      for(auto *state : states)
+      {
+        if(!is_finished(multiplexer->check_io_operation(state)))
+        {
+          alldone = false;
+        }
+      }
+      if(alldone)
+      {
+        break;
+      }
+      multiplexer->check_for_any_completed_io().value();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - begin;
+    for(auto *state : states)
+    {
+      BOOST_CHECK(std::move(*state).get_completed_read().has_value());
+      state->~io_operation_state();
+    }
+    return elapsed;
+  };
+
+  llfio::test::null_device device;
+  device.read.mean = std::chrono::milliseconds(20);
+  llfio::io_multiplexer::io_priority_limits limits;
+  limits.class_max_inflight[(size_t) llfio::io_multiplexer::io_priority::low] = 1;
+  auto multiplexer = llfio::multiplexer_prioritised(llfio::test::multiplexer_null(1, false, device).value(), limits).value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  // Unlimited classes are serviced concurrently, the low priority class one at a time
+  BOOST_CHECK(time_reads(multiplexer.get(), llfio::io_request_flag::none) < std::chrono::milliseconds(80));
+  BOOST_CHECK(time_reads(multiplexer.get(), llfio::io_request_flag::low_priority) >= std::chrono::milliseconds(80));
+  // The priority of the handle applies to requests not saying otherwise
+  fh.set_priority(llfio::io_multiplexer::io_priority::low).value();
+  BOOST_CHECK(time_reads(multiplexer.get(), llfio::io_request_flag::none) >= std::chrono::milliseconds(80));
+  BOOST_CHECK(time_reads(multiplexer.get(), llfio::io_request_flag::high_priority) < std::chrono::milliseconds(80));
+  fh.set_priority(llfio::io_multiplexer::io_priority::normal).value();
+  // Blocking i/o goes through the limits too
+  BOOST_CHECK(fh.read(0, {{buffer.data(), BYTES}}).value() == BYTES);
+  fh.set_multiplexer(nullptr).value();
+
+  // At 50 i/o per second with no burst four reads must take at least 60ms, and at 50 reads worth per second ten reads well over 60ms
+  {
+    device.read.mean = std::chrono::milliseconds(0);
+    limits = {};
+    limits.ops_per_second = 50;
+    limits.burst_ops = 1;
+    multiplexer = llfio::multiplexer_prioritised(llfio::test::multiplexer_null(1, false, device).value(), limits).value();
+    fh.set_multiplexer(multiplexer.get()).value();
+    BOOST_CHECK(time_reads(multiplexer.get(), llfio::io_request_flag::none) >= std::chrono::milliseconds(60));
+    fh.set_multiplexer(nullptr).value();
+    multiplexer = llfio::multiplexer_rate_limited(llfio::test::multiplexer_null(1, false, device).value(), BYTES * 50).value();
+    fh.set_multiplexer(multiplexer.get()).value();
+    const auto begin = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < 10; n++)
+    {
+      BOOST_CHECK(fh.read(0, {{buffer.data(), BYTES}}).value() == BYTES);
+    }
+    BOOST_CHECK(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(60));
+    fh.set_multiplexer(nullptr).value();
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, prioritised_multiplexer, limits, "Tests that the prioritised multiplexer limits in flight i/o per priority class, and rates",
+                       TestPrioritisedMultiplexerLimits())
+#endif
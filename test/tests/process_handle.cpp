@@ -86,10 +86,78 @@ static inline void TestProcessHandle(bool with_redirection)
   }
 }
 
+static inline void TestProcessHandleAsyncWait()
+{
+#ifndef _WIN32
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using posix_fs_syscall = llfio::io_multiplexer::posix_fs_syscall;
+#if defined(__linux__)
+  auto r = llfio::multiplexer_linux_io_uring(1, false);
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+  auto r = llfio::multiplexer_bsd_kqueue(1);
+#else
+  llfio::result<llfio::io_multiplexer_ptr> r(llfio::errc::operation_not_supported);
+#endif
+  if(!r)
+  {
+    std::cout << "\nNo multiplexer is available on this platform (" << r.error().message().c_str() << "), skipping." << std::endl;
+    return;
+  }
+  auto multiplexer = std::move(r).value();
+  auto myexepath = llfio::process_handle::current().current_path().value();
+  std::vector<llfio::process_handle> children;
+  std::vector<posix_fs_syscall> ops(4);
+  const llfio::process_handle::flag flags = llfio::process_handle::flag::wait_on_close | llfio::process_handle::flag::no_redirect;
+  for(size_t n = 0; n < 4; n++)
+  {
+    char buffer[64];
+    sprintf(buffer, "--testchild,%u", (unsigned) n);
+    llfio::path_view_component arg(buffer);
+    children.push_back(llfio::process_handle::launch_process(myexepath, {&arg, 1}, flags).value());
+    children[n].initiate_wait(ops[n], multiplexer.get()).value();
+    BOOST_CHECK(ops[n].result == posix_fs_syscall::pending);
+  }
+  // All the children exit whilst we wait on the multiplexer
+  auto begin = std::chrono::steady_clock::now();
+  for(size_t n = 0; n < 4; n++)
+  {
+    while(__atomic_load_n(&ops[n].result, __ATOMIC_ACQUIRE) == posix_fs_syscall::pending)
+    {
+      multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+      BOOST_REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(30));
+    }
+    BOOST_CHECK(ops[n].result >= 0);
+    // The child was not reaped, so its exit code is still available
+    BOOST_CHECK(!children[n].is_running());
+    auto exitcode = children[n].wait(std::chrono::seconds(0)).value();
+    BOOST_CHECK(exitcode == (intptr_t) n + 1);
+  }
+  // Waiting on an already exited process completes immediately
+  llfio::path_view_component arg("--testchild,0");
+  auto child = llfio::process_handle::launch_process(myexepath, {&arg, 1}, flags).value();
+  while(child.is_running())
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  posix_fs_syscall op;
+  child.initiate_wait(op, multiplexer.get()).value();
+  begin = std::chrono::steady_clock::now();
+  while(__atomic_load_n(&op.result, __ATOMIC_ACQUIRE) == posix_fs_syscall::pending)
+  {
+    multiplexer->check_for_any_completed_io(std::chrono::seconds(1)).value();
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+  }
+  BOOST_CHECK(op.result >= 0);
+  BOOST_CHECK(child.wait().value() == 1);
+#endif
+}
+
 KERNELTEST_TEST_KERNEL(integration, llfio, process_handle, no_redirect, "Tests that llfio::process_handle without redirection works as expected",
                        TestProcessHandle(false))
 KERNELTEST_TEST_KERNEL(integration, llfio, process_handle, redirect, "Tests that llfio::process_handle with redirection works as expected",
                        TestProcessHandle(true))
+KERNELTEST_TEST_KERNEL(integration, llfio, process_handle, async_wait, "Tests that llfio::process_handle::initiate_wait() works as expected",
+                       TestProcessHandleAsyncWait())
 
 int main(int argc, char *argv[])
 {
@@ -0,0 +1,103 @@
+/* Integration test kernel for algorithm::read_whole_file()
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestReadWholeFile()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using llfio::algorithm::read_whole_file_method;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto make = [&](const char *leaf, size_t bytes) {
+    std::vector<llfio::byte> contents(bytes);
+    for(size_t n = 0; n < bytes; n++)
+    {
+      contents[n] = (llfio::byte)(n * 7 + (n >> 12));
+    }
+    auto fh = llfio::file_handle::file(dh, leaf, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    fh.write(0, {{contents.data(), contents.size()}}).value();
+    return contents;
+  };
+  auto check = [&](const char *leaf, const std::vector<llfio::byte> &contents, const llfio::algorithm::read_whole_file_options &options,
+                   read_whole_file_method expected) {
+    auto r = llfio::algorithm::read_whole_file(dh, leaf, options).value();
+    BOOST_CHECK(r.method() == expected);
+    BOOST_REQUIRE(r.size() == contents.size());
+    BOOST_CHECK(r.empty() || 0 == memcmp(r.data(), contents.data(), contents.size()));
+  };
+  const auto empty = make("empty", 0);
+  const auto small = make("small", 1000);
+  const auto large = make("large", 8 * 1024 * 1024 + 100);
+
+  llfio::algorithm::read_whole_file_options options;
+  options.map_threshold = 1024 * 1024;
+  check("empty", empty, options, read_whole_file_method::read);
+  check("small", small, options, read_whole_file_method::read);
+  check("large", large, options, read_whole_file_method::map);
+  // Explicitly chosen methods must work irrespective of size
+  options.method = read_whole_file_method::read;
+  check("large", large, options, read_whole_file_method::read);
+  options.method = read_whole_file_method::map;
+  check("small", small, options, read_whole_file_method::map);
+  options.method = read_whole_file_method::chunked;
+  BOOST_CHECK(llfio::algorithm::read_whole_file(dh, "large", options).error() == llfio::errc::invalid_argument);
+  options.method = read_whole_file_method::automatic;
+  // High latency storage without a multiplexer is read
+  options.read_latency = 1000000;
+  check("large", large, options, read_whole_file_method::read);
+  check("small", small, options, read_whole_file_method::read);
+  BOOST_CHECK(llfio::algorithm::read_whole_file(dh, "missing", options).error() == llfio::errc::no_such_file_or_directory);
+
+  std::vector<std::pair<const char *, llfio::io_multiplexer_ptr>> multiplexers;
+#ifdef __linux__
+  {
+    auto r = llfio::multiplexer_linux_io_uring(1, false);
+    if(r)
+    {
+      multiplexers.emplace_back("io_uring", std::move(r).value());
+    }
+  }
+#endif
+  for(auto &multiplexer : multiplexers)
+  {
+    std::cout << "Testing chunked reads with " << multiplexer.first << std::endl;
+    options.multiplexer = multiplexer.second.get();
+    options.chunk_size = 65536;
+    options.chunks_in_flight = 4;
+    check("large", large, options, read_whole_file_method::chunked);
+    check("small", small, options, read_whole_file_method::read);
+    options.read_latency = 0;
+    check("large", large, options, read_whole_file_method::map);
+    options.read_latency = 1000000;
+  }
+
+  for(const char *leaf : {"empty", "small", "large"})
+  {
+    llfio::file_handle::file(dh, leaf).value().unlink().value();
+  }
+  dh.unlink().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, read_whole_file, "Tests that llfio::algorithm::read_whole_file() works as expected", TestReadWholeFile())
@@ -53,6 +53,20 @@ static inline void TestReduce()
     };
     setrlimit(RLIMIT_NOFILE, &r);
   }
+#endif
+  io_multiplexer_ptr multiplexer;
+#ifdef __linux__
+  {
+    auto r = multiplexer_linux_io_uring(4);
+    if(r)
+    {
+      multiplexer = std::move(r).value();
+    }
+    else
+    {
+      std::cout << "NOTE: Not reducing using io_uring, as an io_uring multiplexer could not be created due to " << r.error().message() << std::endl;
+    }
+  }
 #endif
   small_prng rand;
   std::vector<directory_handle> dirhs;
@@ -102,10 +116,35 @@ static inline void TestReduce()
     std::cout << "Summary: " << summary.types[filesystem::file_type::regular] << " files and " << summary.types[filesystem::file_type::directory] << " directories created of " << summary.size << " bytes, " << summary.allocated << " bytes allocated in " << (summary.directory_blocks+summary.file_blocks) << " blocks with depth of " << summary.max_depth << "." << std::endl;
     BOOST_CHECK(summary.types[filesystem::file_type::regular] + summary.types[filesystem::file_type::directory] == entries_created);
 
-    std::cout << "\nCalling llfio::algorithm::reduce() on that randomised directory tree ..." << std::endl;
-    begin = std::chrono::high_resolution_clock::now();
-    auto entries_removed = algorithm::reduce(std::move(dirhs.front())).value();
-    end = std::chrono::high_resolution_clock::now();
+    size_t entries_removed = 0;
+    if(round % 3 == 1 && multiplexer)
+    {
+      std::cout << "\nCalling llfio::algorithm::reduce() with batched unlinking using io_uring on that randomised directory tree ..." << std::endl;
+      begin = std::chrono::high_resolution_clock::now();
+      entries_removed = algorithm::reduce(std::move(dirhs.front()), nullptr, 4, false, multiplexer.get()).value();
+      end = std::chrono::high_resolution_clock::now();
+    }
+    else if(round % 3 == 2)
+    {
+      std::cout << "\nCalling llfio::algorithm::reduce_deferred() on that randomised directory tree ..." << std::endl;
+      begin = std::chrono::high_resolution_clock::now();
+      auto future = algorithm::reduce_deferred(std::move(dirhs.front())).value();
+      {
+        // The directory tree must have vanished already
+        log_level_guard g(log_level::fatal);
+        auto r = directory_handle::directory({}, dirhpath);
+        BOOST_CHECK(!r && r.error() == errc::no_such_file_or_directory);
+      }
+      entries_removed = future.get().value();
+      end = std::chrono::high_resolution_clock::now();
+    }
+    else
+    {
+      std::cout << "\nCalling llfio::algorithm::reduce() on that randomised directory tree ..." << std::endl;
+      begin = std::chrono::high_resolution_clock::now();
+      entries_removed = algorithm::reduce(std::move(dirhs.front())).value();
+      end = std::chrono::high_resolution_clock::now();
+    }
     // std::cout << entries_removed << " " << entries_created << std::endl;
     BOOST_CHECK(entries_removed == entries_created);
     if(entries_removed != entries_created)
@@ -0,0 +1,93 @@
+/* Integration test kernel for whether anonymous sealed sections work
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestAnonymousSection()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 1024 * 1024;
+  auto sh = llfio::section_handle::anonymous_section(bytes).value();
+  BOOST_CHECK(sh.length().value() >= bytes);
+  BOOST_CHECK(!sh.is_sealed().value());
+  {
+    auto mh = llfio::map_handle::map(sh, bytes).value();
+    memset(mh.address(), 'x', bytes);
+#ifdef __linux__
+    // Writable maps prevent sealing
+    BOOST_CHECK(sh.seal().error() == llfio::errc::device_or_resource_busy);
+#endif
+  }
+  auto sealed = sh.seal();
+#ifdef __linux__
+  BOOST_REQUIRE(sealed);
+  BOOST_CHECK(sh.is_sealed().value());
+  BOOST_CHECK(!sh.truncate(2 * bytes));
+  BOOST_CHECK(!llfio::map_handle::map(sh, bytes, 0, llfio::section_handle::flag::readwrite));
+#else
+  BOOST_CHECK(sealed.error() == llfio::errc::operation_not_supported);
+#endif
+  auto mh = llfio::map_handle::map(sh, bytes, 0, llfio::section_handle::flag::read).value();
+  BOOST_CHECK(mh.address()[0] == llfio::to_byte('x'));
+  BOOST_CHECK(mh.address()[bytes - 1] == llfio::to_byte('x'));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, section_handle, anonymous, "Tests that anonymous sections can be sealed", TestAnonymousSection())
+
+static inline void TestSectionAllocated()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 256 * 1024 * 1024;
+  auto fh = llfio::file_handle::temp_inode().value();
+#ifndef _WIN32
+  // Only on Windows do sections extend their backing file
+  fh.truncate(bytes).value();
+#endif
+  auto sh = llfio::section_handle::section(fh, bytes, llfio::section_handle::flag::readwrite).value();
+  BOOST_CHECK(fh.maximum_extent().value() == bytes);
+  // The backing file is sparse, so almost nothing is allocated yet
+  BOOST_CHECK(sh.allocated().value() < bytes / 2);
+  {
+    auto mh = llfio::map_handle::map(sh, 1024 * 1024).value();
+    memset(mh.address(), 'x', 1024 * 1024);
+  }
+  BOOST_CHECK(sh.allocated().value() < bytes / 2);
+
+  // Anonymous sections asked not to commit can be committed piecemeal
+  auto ash = llfio::section_handle::anonymous_section(bytes, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::nocommit).value();
+  auto mh = llfio::map_handle::map(ash, bytes, 0, llfio::section_handle::flag::readwrite | llfio::section_handle::flag::nocommit).value();
+  const size_t pagesize = llfio::utils::page_size();
+  mh.commit({mh.address() + bytes / 2, pagesize}).value();
+  mh.address()[bytes / 2] = llfio::to_byte('x');
+  BOOST_CHECK(mh.address()[bytes / 2] == llfio::to_byte('x'));
+  auto allocated = ash.allocated();
+#ifdef _WIN32
+  // Sections backed by the paging file cannot say
+  BOOST_CHECK(allocated.error() == llfio::errc::operation_not_supported);
+#else
+  BOOST_CHECK(allocated.value() < bytes / 2);
+#endif
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, section_handle, allocated, "Tests that sections over sparse files allocate only what is written", TestSectionAllocated())
@@ -485,6 +485,81 @@ KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_safe_byte_ranges_thre
 KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_safe_byte_ranges_thread, both, "Tests that llfio::algorithm::shared_fs_mutex::safe_byte_ranges implementation implements a mixture of exclusive and shared locking with threads",
                        [] { TestSharedFSMutexCorrectness(shared_memory::memory_map, shared_memory::both, true); }())
 
+static void TestSafeByteRangesReaderBias()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using entity_type = llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type;
+  auto lock = llfio::algorithm::shared_fs_mutex::safe_byte_ranges::fs_mutex_safe_byte_ranges({}, "lockfile").value();
+  std::atomic<bool> done(false);
+  std::atomic<int> readers(0), writers(0), maxreaders(0);
+  std::atomic<size_t> reads(0), writes(0), failures(0);
+  auto check = [&](bool exclusive) {
+    if(exclusive)
+    {
+      if(writers.fetch_add(1) != 0 || readers.load() != 0)
+      {
+        ++failures;
+      }
+      std::this_thread::yield();
+      writers.fetch_sub(1);
+      ++writes;
+    }
+    else
+    {
+      int r = readers.fetch_add(1) + 1;
+      if(writers.load() != 0)
+      {
+        ++failures;
+      }
+      int m = maxreaders.load();
+      while(r > m && !maxreaders.compare_exchange_weak(m, r))
+      {
+      }
+      readers.fetch_sub(1);
+      ++reads;
+    }
+  };
+  std::vector<std::thread> threads;
+  const size_t nreaders = std::max(std::thread::hardware_concurrency(), 4U) - 1;
+  for(size_t n = 0; n < nreaders; n++)
+  {
+    threads.emplace_back([&] {
+      while(!done)
+      {
+        // Both single and multiple entity shared locks, the entities of which become biased
+        entity_type entities[2] = {entity_type(78, false), entity_type(79, false)};
+        auto h = lock.lock({entities, 1 + (reads % 2)}).value();
+        check(false);
+      }
+    });
+  }
+  threads.emplace_back([&] {
+    while(!done)
+    {
+      // Exclusive locks must revoke the bias and wait for the readers to leave
+      auto h = lock.lock(entity_type(78, true)).value();
+      check(true);
+      h.unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  done = true;
+  for(auto &t : threads)
+  {
+    t.join();
+  }
+  std::cout << "Reads " << reads << " writes " << writes << " max concurrent readers " << maxreaders << std::endl;
+  BOOST_CHECK(failures == 0);
+  BOOST_CHECK(reads > 0);
+  BOOST_CHECK(writes > 0);
+  // No locks are left behind
+  BOOST_CHECK(lock.try_lock(entity_type(78, true)));
+  BOOST_CHECK(lock.try_lock(entity_type(79, true)));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_safe_byte_ranges_thread, reader_bias, "Tests that llfio::algorithm::shared_fs_mutex::safe_byte_ranges excludes exclusive lockers from biased shared lockers", TestSafeByteRangesReaderBias())
+
 /*
 
 Test 2: X child processes all try to construct the lock at once, lock something shared, unlock it and destruct. A
@@ -570,6 +645,218 @@ static auto TestSharedFSMutexConstructDestructChildWorker = KERNELTEST_V1_NAMESP
 
 KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_memory_map, construct_destruct, "Tests that llfio::algorithm::shared_fs_mutex::memory_map constructor and destructor are race free", [] { TestSharedFSMutexConstructDestruct(shared_memory::memory_map); }())
 
+static std::unique_ptr<LLFIO_V2_NAMESPACE::algorithm::shared_fs_mutex::shared_fs_mutex> MakeCrashRecoveryLock(shared_memory::mutex_kind_type mutex_kind)
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static llfio::path_handle lockdir = llfio::path_handle::path(".").value();
+  switch(mutex_kind)
+  {
+  case shared_memory::mutex_kind_type::atomic_append:
+    return std::make_unique<llfio::algorithm::shared_fs_mutex::atomic_append>(llfio::algorithm::shared_fs_mutex::atomic_append::fs_mutex_append({}, "lockfile_crash").value());
+  case shared_memory::mutex_kind_type::lock_files:
+    return std::make_unique<llfio::algorithm::shared_fs_mutex::lock_files>(llfio::algorithm::shared_fs_mutex::lock_files::fs_mutex_lock_files(lockdir).value());
+  case shared_memory::mutex_kind_type::memory_map:
+    return std::make_unique<llfio::algorithm::shared_fs_mutex::memory_map<>>(llfio::algorithm::shared_fs_mutex::memory_map<>::fs_mutex_map({}, "lockfile_crash").value());
+  default:
+    abort();
+  }
+}
+
+static void TestSharedFSMutexCrashRecovery(shared_memory::mutex_kind_type mutex_kind)
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using entity_type = llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type;
+  // Open the lock before the child does, so the child is not its only user when it dies
+  auto lock = MakeCrashRecoveryLock(mutex_kind);
+  auto child_workers = KERNELTEST_V1_NAMESPACE::launch_child_workers("TestSharedFSMutexCrashRecovery", 1, static_cast<size_t>(mutex_kind));
+  child_workers.wait_until_ready();
+  child_workers.go();
+  child_workers.join();
+  // The child exits without writing results after locking, so it vanishes
+  BOOST_REQUIRE(child_workers.results[0].retcode == 99);
+  auto begin = std::chrono::steady_clock::now();
+  auto h = lock->lock(entity_type(78, true), std::chrono::seconds(5), true);
+  BOOST_REQUIRE(h);
+  std::cout << "Recovered the lock held by the dead child in " << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count() << " microseconds." << std::endl;
+}
+
+static auto TestSharedFSMutexCrashRecoveryChildWorker = KERNELTEST_V1_NAMESPACE::register_child_worker("TestSharedFSMutexCrashRecovery", [](KERNELTEST_V1_NAMESPACE::waitable_done & /*unused*/, size_t /*unused*/, const char *params) -> std::string {  // NOLINT
+  auto lock = MakeCrashRecoveryLock(static_cast<shared_memory::mutex_kind_type>(atoi(params)));  // NOLINT
+  auto h = lock->lock(LLFIO_V2_NAMESPACE::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type(78, true), std::chrono::seconds(5), true);
+  // Exit suddenly with the lock held
+  std::_Exit(h ? 0 : 1);
+});
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_atomic_append, crash_recovery, "Tests that llfio::algorithm::shared_fs_mutex::atomic_append recovers locks held by exited processes", [] { TestSharedFSMutexCrashRecovery(shared_memory::atomic_append); }())
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_lock_files, crash_recovery, "Tests that llfio::algorithm::shared_fs_mutex::lock_files recovers locks held by exited processes", [] { TestSharedFSMutexCrashRecovery(shared_memory::lock_files); }())
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_memory_map, crash_recovery, "Tests that llfio::algorithm::shared_fs_mutex::memory_map recovers locks held by exited processes", [] { TestSharedFSMutexCrashRecovery(shared_memory::memory_map); }())
+
+static void TestAtomicAppendHolePunching()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using entity_type = llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type;
+  auto lock = llfio::algorithm::shared_fs_mutex::atomic_append::fs_mutex_append({}, "lockfile_holepunch").value();
+  // Three megabytes of lock requests
+  for(size_t n = 0; n < 3 * 8192; n++)
+  {
+    auto g = lock.lock(entity_type(n & 7, true)).value();
+  }
+  auto length = lock.handle().maximum_extent().value();
+  BOOST_CHECK(length >= 3 * 1024 * 1024);
+  llfio::file_handle::extent_type allocated = 0;
+  for(auto &i : lock.handle().extents().value())
+  {
+    allocated += i.length;
+  }
+  std::cout << "Lock file length " << length << " of which " << allocated << " is allocated" << std::endl;
+  if(allocated == length)
+  {
+    std::cout << "NOTE: This filing system does not appear to support hole punching." << std::endl;
+  }
+  else
+  {
+    BOOST_CHECK(allocated <= length - 1024 * 1024);
+  }
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_atomic_append, hole_punching, "Tests that llfio::algorithm::shared_fs_mutex::atomic_append deallocates completed lock requests", TestAtomicAppendHolePunching())
+
+static void TestAtomicAppendManyEntities()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using llfio::algorithm::shared_fs_mutex::atomic_append;
+  using entity_type = atomic_append::entity_type;
+  auto a = atomic_append::fs_mutex_append({}, "lockfile_many").value();
+  auto b = atomic_append::fs_mutex_append({}, "lockfile_many").value();
+  // Two hundred entities needs seventeen records
+  std::vector<entity_type> entities;
+  for(entity_type::value_type n = 0; n < 200; n++)
+  {
+    entities.emplace_back(n, (n & 1) != 0);
+  }
+  for(size_t cycle = 0; cycle < 3; cycle++)
+  {
+    auto g = a.lock(entities).value();
+    // Entities in the first, a middle and the last record are all locked
+    BOOST_CHECK(!b.try_lock(entity_type(1, false)));
+    BOOST_CHECK(!b.try_lock(entity_type(101, false)));
+    BOOST_CHECK(!b.try_lock(entity_type(199, true)));
+    // Shared entities may be shared, and other entities are not locked
+    BOOST_CHECK(b.try_lock(entity_type(198, false)));
+    BOOST_CHECK(b.try_lock(entity_type(1000, true)));
+  }
+  // Once unlocked, all the records of the lock request are completed
+  BOOST_CHECK(b.try_lock(entity_type(199, true)));
+  entities.resize(atomic_append::max_entities + 1, entity_type(0, true));
+  BOOST_CHECK(a.lock(entities).error() == llfio::errc::argument_list_too_long);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_atomic_append, many_entities, "Tests that llfio::algorithm::shared_fs_mutex::atomic_append can lock more entities than fit into one record", TestAtomicAppendManyEntities())
+
+static void TestMemoryMapCacheLinePadded()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using entity_type = llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type;
+  // Eight padded spinlocks, so locking 64 entities must collide
+  using padded_map = llfio::algorithm::shared_fs_mutex::memory_map<QUICKCPPLIB_NAMESPACE::algorithm::hash::fnv1a_hash, 512, QUICKCPPLIB_NAMESPACE::configurable_spinlock::shared_spinlock<>, true>;
+  auto a = padded_map::fs_mutex_map({}, "lockfile").value();
+  auto b = padded_map::fs_mutex_map({}, "lockfile").value();
+  std::vector<entity_type> entities;
+  for(entity_type::value_type n = 0; n < 64; n++)
+  {
+    entities.emplace_back(n, true);
+  }
+  // The very same entity repeated is not a collision
+  entities.emplace_back(0, true);
+  BOOST_CHECK(a.hash_collisions() == 0);
+  {
+    auto g = a.lock(entities).value();
+    BOOST_CHECK(a.hash_collisions() >= 56);
+    BOOST_CHECK(a.hash_collisions() <= 63);
+    // All eight spinlocks are now held exclusively
+    BOOST_CHECK(!b.try_lock(entity_type(1000, false)));
+  }
+  BOOST_CHECK(b.try_lock(entity_type(1000, false)));
+  BOOST_CHECK(b.hash_collisions() == 0);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_memory_map, cache_line_padded, "Tests that llfio::algorithm::shared_fs_mutex::memory_map with one spinlock per cache line works", TestMemoryMapCacheLinePadded())
+
+static void TestMemoryMapResize()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using llfio::algorithm::shared_fs_mutex::memory_map;
+  using entity_type = memory_map<>::entity_type;
+  auto a = memory_map<>::fs_mutex_map({}, "lockfile_resize", 64).value();
+  auto b = memory_map<>::fs_mutex_map({}, "lockfile_resize", 65536).value();
+  // The second user gets the hash index size of the first
+  const size_t entries = a.hash_index_entries();
+  BOOST_CHECK(entries > 0);
+  BOOST_CHECK(b.hash_index_entries() == entries);
+  BOOST_CHECK(b.resize_index(0).error() == llfio::errc::invalid_argument);
+  {
+    auto g = a.lock(entity_type(5, true)).value();
+    // The old hash index cannot drain whilst the lock is held
+    BOOST_CHECK(b.resize_index(65536, std::chrono::milliseconds(100)).error() == llfio::errc::timed_out);
+    BOOST_CHECK(b.hash_index_entries() > entries);
+    BOOST_CHECK(a.hash_index_entries() == b.hash_index_entries());
+    // Yet exclusion still holds whilst draining
+    BOOST_CHECK(!b.try_lock(entity_type(5, false)));
+  }
+  // The resize now completes, and locking works in the new hash index
+  BOOST_CHECK(b.resize_index(65536, std::chrono::seconds(5)));
+  BOOST_CHECK(b.try_lock(entity_type(5, true)));
+  {
+    auto g = a.lock(entity_type(5, true)).value();
+    BOOST_CHECK(!b.try_lock(entity_type(5, false)));
+  }
+  BOOST_CHECK(b.try_lock(entity_type(5, true)));
+  // Resizing to the same size does nothing
+  BOOST_CHECK(a.resize_index(65536));
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_memory_map, resize, "Tests that llfio::algorithm::shared_fs_mutex::memory_map can resize its hash index whilst in use", TestMemoryMapResize())
+
+static void TestSharedFSMutexStatistics()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using entity_type = llfio::algorithm::shared_fs_mutex::shared_fs_mutex::entity_type;
+  auto a = llfio::algorithm::shared_fs_mutex::byte_ranges::fs_mutex_byte_ranges({}, "lockfile_stats").value();
+  auto b = llfio::algorithm::shared_fs_mutex::byte_ranges::fs_mutex_byte_ranges({}, "lockfile_stats").value();
+  // Never enabled statistics are all zero
+  BOOST_CHECK(!a.statistics_enabled());
+  {
+    auto g = a.lock(entity_type(5, true)).value();
+  }
+  BOOST_CHECK(a.statistics().acquisitions == 0);
+  BOOST_REQUIRE(a.set_statistics_enabled(true));
+  BOOST_REQUIRE(b.set_statistics_enabled(true));
+  BOOST_CHECK(a.statistics_enabled());
+  {
+    auto g = a.lock(entity_type(5, true)).value();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // A contended try_lock counts as a failure on the instance which tried
+    BOOST_CHECK(!b.try_lock(entity_type(5, false)));
+  }
+  auto stats = a.statistics();
+  BOOST_CHECK(stats.acquisitions == 1);
+  BOOST_CHECK(stats.failures == 0);
+  BOOST_CHECK(stats.max_hold_time[5] >= std::chrono::milliseconds(10));
+  BOOST_CHECK(stats.max_hold_time[6] == std::chrono::nanoseconds(0));
+  BOOST_CHECK(b.statistics().failures == 1);
+  BOOST_CHECK(b.statistics().acquisitions == 0);
+  // Disabled statistics stop counting, and re-enabling resets them
+  BOOST_REQUIRE(a.set_statistics_enabled(false));
+  {
+    auto g = a.lock(entity_type(5, true)).value();
+  }
+  BOOST_CHECK(a.statistics().acquisitions == 1);
+  BOOST_REQUIRE(a.set_statistics_enabled(true));
+  BOOST_CHECK(a.statistics().acquisitions == 0);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, shared_fs_mutex_byte_ranges, statistics, "Tests that llfio::algorithm::shared_fs_mutex lock contention statistics are collected", TestSharedFSMutexStatistics())
+
 
 /*
 
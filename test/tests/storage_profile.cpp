@@ -0,0 +1,86 @@
+/* Integration test kernel for persisting storage profiles
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Dec 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <sstream>
+
+static inline void TestStorageProfilePersistence()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using llfio::storage_profile::storage_profile;
+  auto dirh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto fh = llfio::file_handle::uniquely_named_file(dirh).value();
+
+  // What write() writes, read() reads back
+  storage_profile sp;
+  sp.device_min_io_size.value = 4096;
+  sp.fs_name.value = "ext4";
+  sp.cpu_physical_cores.value = 8;
+  sp.read_qd1_mean.value = 100000;
+  sp.read_qd16_mean.value = 400000;
+  sp.fs_in_use.value = 0.5f;
+  {
+    std::stringstream ss;
+    sp.write(ss);
+    storage_profile sp2;
+    sp2.read(ss);
+    BOOST_CHECK(sp2.device_min_io_size.value == 4096);
+    BOOST_CHECK(sp2.fs_name.value == "ext4");
+    BOOST_CHECK(sp2.read_qd1_mean.value == 100000);
+    BOOST_CHECK(sp2.read_qd16_mean.value == 400000);
+    BOOST_CHECK(sp2.fs_in_use.value == 0.5f);
+    BOOST_CHECK(sp2.write_qd1_mean.value == static_cast<unsigned long long>(-1));
+  }
+
+  // Sixteen reads at once taking four times longer each means four are served in parallel
+  auto hints = sp.tuning();
+  BOOST_CHECK(hints.direct_io_alignment == 4096);
+  BOOST_CHECK(hints.io_queue_depth == 256);
+  BOOST_CHECK(hints.traverse_threads == 8);
+  BOOST_CHECK(storage_profile().tuning().io_queue_depth == 0);
+  // A measured saturation point is preferred to the estimate
+  {
+    storage_profile sp2(sp);
+    sp2.read_qd_saturation.value = 32;
+    BOOST_CHECK(sp2.tuning().io_queue_depth == 128);
+  }
+
+  // A profile saved is loaded for the same storage, but there is none saved at first
+  {
+    storage_profile sp2;
+    BOOST_CHECK(!sp2.load(dirh, fh).value());
+    BOOST_CHECK(!sp2.fs_name.value.empty());
+    sp2.read_qd1_mean.value = 12345;
+    sp2.save(dirh, fh).value();
+    storage_profile sp3;
+    BOOST_CHECK(sp3.load(dirh, fh).value());
+    BOOST_CHECK(sp3.read_qd1_mean.value == 12345);
+    BOOST_CHECK(sp3.fs_name.value == sp2.fs_name.value);
+  }
+
+  llfio::algorithm::reduce(std::move(dirh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, storage_profile, persistence, "Tests that storage profiles are saved, loaded and tuned from", TestStorageProfilePersistence())
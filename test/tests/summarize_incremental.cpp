@@ -0,0 +1,110 @@
+/* Integration test kernel for whether incremental summarize() works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <thread>
+
+static inline void TestIncrementalSummarize()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  namespace algorithm = LLFIO_V2_NAMESPACE::algorithm;
+  auto root = llfio::directory_handle::temp_directory().value();
+  std::vector<llfio::directory_handle> dirs;
+  dirs.push_back(llfio::directory_handle::directory(root, "a", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value());
+  dirs.push_back(llfio::directory_handle::directory(dirs[0], "b", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value());
+  dirs.push_back(llfio::directory_handle::directory(root, "c", llfio::directory_handle::mode::write, llfio::directory_handle::creation::if_needed).value());
+  auto make_file = [](const llfio::directory_handle &dirh, llfio::path_view leaf, size_t bytes) {
+    auto fh = llfio::file_handle::file(dirh, leaf, llfio::file_handle::mode::write, llfio::file_handle::creation::if_needed).value();
+    std::vector<llfio::byte> buffer(bytes, llfio::to_byte(78));
+    fh.write(0, {{buffer.data(), buffer.size()}}).value();
+  };
+  for(size_t n = 0; n < dirs.size(); n++)
+  {
+    make_file(dirs[n], "file1", 4096 * (n + 1));
+    make_file(dirs[n], "file2", 100);
+  }
+  auto check_same = [](const algorithm::traversal_summary &a, const algorithm::traversal_summary &b) {
+    BOOST_CHECK(a.size == b.size);
+    BOOST_CHECK(a.allocated == b.allocated);
+    BOOST_CHECK(a.file_blocks == b.file_blocks);
+    BOOST_CHECK(a.directory_blocks == b.directory_blocks);
+    BOOST_CHECK(a.max_depth == b.max_depth);
+    BOOST_CHECK(a.types == b.types);
+    BOOST_CHECK(a.devs == b.devs);
+    BOOST_CHECK(a.sizes == b.sizes);
+  };
+
+  algorithm::traversal_summary_cache cache;
+  {
+    auto expected = algorithm::summarize(root).value();
+    auto first = algorithm::summarize(root, cache).value();
+    check_same(first, expected);
+    // Sizes are histogrammed by their number of significant bits
+    BOOST_CHECK(expected.sizes[7] == 3);
+    BOOST_CHECK(expected.sizes[13] == 1);
+    BOOST_CHECK(expected.sizes[14] == 2);
+    BOOST_CHECK(expected.types[llfio::filesystem::file_type::regular] == 6);
+    BOOST_CHECK(cache.size() == 4);
+    BOOST_CHECK(cache.hits() == 0);
+    BOOST_CHECK(cache.misses() == 4);
+    auto second = algorithm::summarize(root, cache).value();
+    check_same(second, expected);
+    BOOST_CHECK(cache.hits() == 4);
+    BOOST_CHECK(cache.misses() == 0);
+  }
+
+  // Adding an entry changes the timestamps of one directory only. Filesystem timestamps
+  // can be coarse, so wait for them to tick over first.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  make_file(dirs[1], "file3", 65536);
+  {
+    auto expected = algorithm::summarize(root).value();
+    auto third = algorithm::summarize(root, cache).value();
+    check_same(third, expected);
+    BOOST_CHECK(cache.hits() == 3);
+    BOOST_CHECK(cache.misses() == 1);
+  }
+
+  // A persisted cache is as good as the original
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  cache.save(root, "cache").value();
+  {
+    auto loaded = algorithm::traversal_summary_cache::load(root, "cache").value();
+    BOOST_CHECK(loaded.size() == cache.size());
+    llfio::file_handle::file(root, "cache").value().unlink().value();
+    auto expected = algorithm::summarize(root).value();
+    auto fourth = algorithm::summarize(root, loaded).value();
+    check_same(fourth, expected);
+    BOOST_CHECK(loaded.misses() == 1);  // only the root directory changed
+    BOOST_CHECK(loaded.hits() == 3);
+  }
+  make_file(root, "garbage", 64);
+  BOOST_CHECK(algorithm::traversal_summary_cache::load(root, "garbage").error() == llfio::errc::illegal_byte_sequence);
+
+  algorithm::reduce(std::move(root)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, summarize_incremental, "Tests that incremental llfio::algorithm::summarize() works as expected",
+                       TestIncrementalSummarize())
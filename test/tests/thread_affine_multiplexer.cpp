@@ -0,0 +1,79 @@
+/* Integration test kernel for whether the thread affine multiplexer hands completions back
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <future>
+
+#if LLFIO_ENABLE_TEST_IO_MULTIPLEXERS
+static inline void TestThreadAffineMultiplexerHandoff()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t BYTES = 4096;
+  auto multiplexer = llfio::multiplexer_thread_affine(llfio::test::multiplexer_null(2, false).value()).value();
+  auto fh = llfio::file_handle::temp_inode().value();
+  fh.set_multiplexer(multiplexer.get()).value();
+  std::vector<llfio::byte> buffer(BYTES);
+
+  struct visitor_t final : llfio::io_multiplexer::io_operation_state_visitor
+  {
+    std::thread::id completed_on, finished_on;
+    size_t bytes{0};
+
+    virtual bool read_completed(lock_guard & /*unused*/, llfio::io_operation_state_type /*unused*/, llfio::io_result<llfio::io_handle::buffers_type> &&res) override
+    {
+      completed_on = std::this_thread::get_id();
+      bytes = res ? res.value()[0].size() : 0;
+      return false;
+    }
+    virtual void read_finished(lock_guard & /*unused*/, llfio::io_operation_state_type /*unused*/) override { finished_on = std::this_thread::get_id(); }
+  } visitor;
+
+  const auto state_reqs = multiplexer->io_state_requirements();
+  std::vector<llfio::byte> storage(state_reqs.first + state_reqs.second);
+  auto *base = storage.data() + (state_reqs.second - ((uintptr_t) storage.data() & (state_reqs.second - 1)));
+  llfio::file_handle::buffer_type b{buffer.data(), BYTES};
+  auto *state = multiplexer->construct_and_init_io_operation({base, state_reqs.first}, &fh, &visitor, {}, {},
+                                                             llfio::file_handle::io_request<llfio::file_handle::buffers_type>({&b, 1}, 0));
+  // Another thread reaps the completion, which must not invoke the visitor there
+  std::async(std::launch::async, [&] {
+    while(!is_finished(state->current_state()))
+    {
+      multiplexer->check_for_any_completed_io().value();
+    }
+  }).get();
+  BOOST_CHECK(visitor.completed_on == std::thread::id());
+  BOOST_CHECK(visitor.finished_on == std::thread::id());
+  // This thread's next call into the multiplexer invokes the visitor here
+  BOOST_CHECK(is_finished(multiplexer->check_io_operation(state)));
+  BOOST_CHECK(visitor.completed_on == std::this_thread::get_id());
+  BOOST_CHECK(visitor.finished_on == std::this_thread::get_id());
+  BOOST_CHECK(visitor.bytes == BYTES);
+  state->~io_operation_state();
+  fh.set_multiplexer(nullptr).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, thread_affine_multiplexer, handoff, "Tests that the thread affine multiplexer hands completions back to the initiating thread",
+                       TestThreadAffineMultiplexerHandoff())
+#endif
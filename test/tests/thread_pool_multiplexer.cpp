@@ -0,0 +1,88 @@
+/* Integration test kernel for whether the thread pool multiplexer works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+#include <future>
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+static inline void TestThreadPoolMultiplexer()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t THREADS = 4, ROUNDTRIPS = 1000;
+  auto multiplexer = llfio::multiplexer_thread_pool(2).value();
+  std::vector<std::pair<llfio::pipe_handle, llfio::pipe_handle>> pipes;
+  for(size_t n = 0; n < THREADS; n++)
+  {
+    pipes.push_back(llfio::pipe_handle::anonymous_pipe(llfio::pipe_handle::caching::reads, llfio::pipe_handle::flag::multiplexable).value());
+    pipes.back().first.set_multiplexer(multiplexer.get()).value();
+    pipes.back().second.set_multiplexer(multiplexer.get()).value();
+  }
+  // Many threads outside the pool do blocking i/o concurrently, with completions reaped by the pool
+  std::vector<std::future<size_t>> results;
+  for(size_t n = 0; n < THREADS; n++)
+  {
+    results.push_back(std::async(std::launch::async, [&, n]() -> size_t {
+      size_t ok = 0;
+      for(size_t i = 0; i < ROUNDTRIPS; i++)
+      {
+        const size_t v = n * ROUNDTRIPS + i;
+        auto written = pipes[n].second.write(0, {{(const llfio::byte *) &v, sizeof(v)}}, std::chrono::seconds(5));
+        if(!written || written.value() != sizeof(v))
+        {
+          break;
+        }
+        size_t r = 0;
+        auto read = pipes[n].first.read(0, {{(llfio::byte *) &r, sizeof(r)}}, std::chrono::seconds(5));
+        if(!read || read.value() != sizeof(r) || r != v)
+        {
+          break;
+        }
+        ++ok;
+      }
+      return ok;
+    }));
+  }
+  for(auto &result : results)
+  {
+    BOOST_CHECK(result.get() == ROUNDTRIPS);
+  }
+
+  // Waiting for completions must honour its deadline
+  auto begin = std::chrono::steady_clock::now();
+  multiplexer->check_for_any_completed_io(std::chrono::milliseconds(100)).value();
+  auto end = std::chrono::steady_clock::now();
+  BOOST_CHECK(end - begin < std::chrono::seconds(5));
+
+  for(auto &p : pipes)
+  {
+    p.first.close().value();
+    p.second.close().value();
+  }
+  multiplexer->close().value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, thread_pool_multiplexer, roundtrips, "Tests that the thread pool multiplexer works from many threads",
+                       TestThreadPoolMultiplexer())
+#endif
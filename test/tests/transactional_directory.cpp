@@ -0,0 +1,189 @@
+/* Integration test kernel for algorithm::transactional_directory
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+static inline void TestTransactionalDirectory()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using txdir = llfio::algorithm::transactional_directory;
+  static constexpr size_t THREADS = 4, TRANSACTIONS = 50;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  auto contents_of = [](const txdir &dir, llfio::path_view leafname) -> std::string {
+    auto fh = dir.open_file(leafname);
+    if(!fh)
+    {
+      return "<none>";
+    }
+    std::string ret((size_t) fh.value().maximum_extent().value(), 0);
+    ret.resize(fh.value().read(0, {{(llfio::byte *) &ret[0], ret.size()}}).value());
+    return ret;
+  };
+  auto write = [](txdir::transaction &tx, llfio::path_view leafname, const std::string &contents) {
+    llfio::file_handle::const_buffer_type buffer{(const llfio::byte *) contents.data(), contents.size()};
+    return tx.write(leafname, {&buffer, 1});
+  };
+  // Only the files, the lock file and the journals and new inodes of transactions in progress are in the directory
+  auto entries_of = [](const llfio::directory_handle &dirh) {
+    std::vector<llfio::directory_handle::buffer_type> entries(64);
+    llfio::directory_handle::buffers_type buffers(entries);
+    buffers = dirh.read({std::move(buffers)}).value();
+    std::vector<std::string> ret;
+    for(auto &entry : buffers)
+    {
+      ret.push_back(entry.leafname.path().string());
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  };
+
+  {
+    auto dir = txdir::open(dh, "dir").value();
+    // Files are replaced and removed together
+    {
+      auto tx = dir->begin();
+      write(tx, "a", "alpha").value();
+      write(tx, "b", "beta").value();
+      write(tx, "a", "aleph").value();
+      BOOST_CHECK(tx.size() == 2);
+      dir->commit(tx).value();
+      BOOST_CHECK(tx.empty());
+    }
+    BOOST_CHECK(contents_of(*dir, "a") == "aleph");
+    BOOST_CHECK(contents_of(*dir, "b") == "beta");
+    {
+      auto tx = dir->begin();
+      write(tx, "b", "bet").value();
+      tx.remove("a").value();
+      tx.remove("nonexistent").value();
+      dir->commit(tx).value();
+    }
+    BOOST_CHECK(contents_of(*dir, "a") == "<none>");
+    BOOST_CHECK(contents_of(*dir, "b") == "bet");
+    BOOST_CHECK((entries_of(dir->directory()) == std::vector<std::string>{".lock", "b"}));
+    // Invalid names are refused, and discarded transactions leave nothing behind
+    {
+      auto tx = dir->begin();
+      BOOST_CHECK(!tx.write(".lock"));
+      BOOST_CHECK(!tx.write("x/y"));
+      BOOST_CHECK(!tx.remove(""));
+      write(tx, "c", "gamma").value();
+    }
+    BOOST_CHECK((entries_of(dir->directory()) == std::vector<std::string>{".lock", "b"}));
+    auto stats = dir->stats();
+    BOOST_CHECK(stats.commits == 2);
+    BOOST_CHECK(stats.files_written == 3);
+    BOOST_CHECK(stats.files_removed == 2);
+
+    // Readers holding a shared lock see the files of each transaction all together
+    std::vector<std::thread> threads;
+    std::atomic<size_t> torn(0);
+    for(size_t t = 0; t < THREADS; t++)
+    {
+      threads.emplace_back([&, t] {
+        for(size_t n = 0; n < TRANSACTIONS; n++)
+        {
+          auto tx = dir->begin();
+          const auto contents = std::to_string(t) + ":" + std::to_string(n);
+          write(tx, "x", contents).value();
+          write(tx, "y", contents).value();
+          dir->commit(tx).value();
+          const llfio::path_view names[] = {"x", "y"};
+          auto lock = dir->lock_shared(names).value();
+          if(contents_of(*dir, "x") != contents_of(*dir, "y"))
+          {
+            torn++;
+          }
+        }
+      });
+    }
+    for(auto &thread : threads)
+    {
+      thread.join();
+    }
+    BOOST_CHECK(torn == 0);
+    BOOST_CHECK(dir->stats().commits == 2 + THREADS * TRANSACTIONS);
+    BOOST_CHECK((entries_of(dir->directory()) == std::vector<std::string>{".lock", "b", "x", "y"}));
+  }
+
+  auto dirh = llfio::directory_handle::directory(dh, "dir", llfio::directory_handle::mode::write).value();
+  // A new inode of a transaction which never reached its commit point, and a torn journal, are discarded
+  {
+    llfio::file_handle::file(dirh, "." + std::string(64, 'a') + ".tmp", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    auto jh = llfio::file_handle::file(dirh, "." + std::string(64, 'b') + ".txn", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    jh.write(0, {{(const llfio::byte *) "torn", 4}}).value();
+  }
+  {
+    auto dir = txdir::open(dh, "dir").value();
+    BOOST_CHECK(dir->stats().transactions_rolled_back == 1);
+    BOOST_CHECK((entries_of(dir->directory()) == std::vector<std::string>{".lock", "b", "x", "y"}));
+  }
+  // A transaction interrupted after its commit point is completed. Its journal is a header of
+  // a hash of the rest and a count of the entries, then for each entry its new inode's unique id,
+  // the bytes of its two names, and the names.
+  {
+    const std::string tempname = "." + std::string(64, 'c') + ".tmp";
+    auto fh = llfio::file_handle::file(dirh, tempname, llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    fh.write(0, {{(const llfio::byte *) "recovered", 9}}).value();
+    std::string journal(32, 0);
+    auto append_entry = [&](llfio::fs_handle::unique_id_type unique_id, const std::string &temp, const std::string &leaf) {
+      uint64_t ids[2] = {unique_id.as_longlongs[0], unique_id.as_longlongs[1]};
+      uint32_t lengths[2] = {(uint32_t) temp.size(), (uint32_t) leaf.size()};
+      journal.append((const char *) ids, sizeof(ids));
+      journal.append((const char *) lengths, sizeof(lengths));
+      journal.append(temp);
+      journal.append(leaf);
+    };
+    append_entry(fh.unique_id(), tempname, "y");
+    append_entry({}, "", "b");
+    const uint64_t count = 2;
+    memcpy(&journal[16], &count, sizeof(count));
+    const auto hash = QUICKCPPLIB_NAMESPACE::algorithm::hash::fast_hash::hash(journal.data() + 16, journal.size() - 16);
+    memcpy(&journal[0], hash.as_longlongs, 16);
+    auto jh = llfio::file_handle::file(dirh, "." + std::string(64, 'd') + ".txn", llfio::file_handle::mode::write, llfio::file_handle::creation::only_if_not_exist).value();
+    jh.write(0, {{(const llfio::byte *) journal.data(), journal.size()}}).value();
+  }
+  {
+    auto dir = txdir::open(dh, "dir").value();
+    // But not by a second opener of a directory in use
+    auto second = txdir::open(dh, "dir").value();
+    BOOST_CHECK(second->stats().transactions_recovered == 0);
+    BOOST_CHECK(dir->stats().transactions_recovered == 1);
+    BOOST_CHECK(contents_of(*dir, "y") == "recovered");
+    BOOST_CHECK(contents_of(*dir, "b") == "<none>");
+    BOOST_CHECK((entries_of(dir->directory()) == std::vector<std::string>{".lock", "x", "y"}));
+  }
+  dirh.close().value();
+  llfio::algorithm::reduce(std::move(dh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, transactional_directory,
+                       "Tests that algorithm::transactional_directory commits atomically, isolates transactions and recovers", TestTransactionalDirectory())
@@ -25,6 +25,8 @@ Distributed under the Boost Software License, Version 1.0.
 #include "../test_kernel_decl.hpp"
 
 #include <chrono>
+#include <map>
+#include <mutex>
 
 #include "quickcpplib/algorithm/small_prng.hpp"
 #include "quickcpplib/algorithm/string.hpp"
@@ -188,6 +190,158 @@ static inline void TestTraverse()
   BOOST_CHECK(visitor_st.failed_to_open == visitor_mt.failed_to_open);
   BOOST_CHECK(abs((int) visitor_st.items_enumerated - (int) visitor_mt.items_enumerated) < 5);
   BOOST_CHECK(visitor_st.max_depth == visitor_mt.max_depth);
+
+  std::cout << "Traversing " << to_traverse_path << " depth first using many threads ..." << std::endl;
+  my_traverse_visitor visitor_df;
+  begin = std::chrono::high_resolution_clock::now();
+  auto items_df = algorithm::traverse(to_traverse, &visitor_df, 0, nullptr, false, true).value();
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << "  Traversed " << items_df << " directories on " << to_traverse_path << " in " << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0) << " seconds (which is " << (items_df / (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0))
+            << " directories/sec).\n";
+  BOOST_CHECK(abs((int) items_st - (int) items_df) < 5);
+  BOOST_CHECK(visitor_st.failed_to_open == visitor_df.failed_to_open);
+  BOOST_CHECK(abs((int) visitor_st.items_enumerated - (int) visitor_df.items_enumerated) < 5);
+  BOOST_CHECK(visitor_st.max_depth == visitor_df.max_depth);
+
+  std::cout << "Traversing " << to_traverse_path << " with at most 64 directories queued using many threads ..." << std::endl;
+  my_traverse_visitor visitor_bounded;
+  begin = std::chrono::high_resolution_clock::now();
+  auto items_bounded = algorithm::traverse(to_traverse, &visitor_bounded, 0, nullptr, false, false, nullptr, 64).value();
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << "  Traversed " << items_bounded << " directories on " << to_traverse_path << " in " << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0) << " seconds (which is " << (items_bounded / (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0))
+            << " directories/sec).\n";
+  BOOST_CHECK(abs((int) items_st - (int) items_bounded) < 5);
+  BOOST_CHECK(visitor_st.failed_to_open == visitor_bounded.failed_to_open);
+  BOOST_CHECK(abs((int) visitor_st.items_enumerated - (int) visitor_bounded.items_enumerated) < 5);
+  BOOST_CHECK(visitor_st.max_depth == visitor_bounded.max_depth);
+
+#ifdef __linux__
+  auto multiplexer = multiplexer_linux_io_uring(4);
+  if(!multiplexer)
+  {
+    std::cout << "NOTE: Not traversing using io_uring, as an io_uring multiplexer could not be created due to " << multiplexer.error().message() << std::endl;
+    return;
+  }
+  std::cout << "Traversing " << to_traverse_path << " using io_uring with four threads ..." << std::endl;
+  my_traverse_visitor visitor_uring;
+  begin = std::chrono::high_resolution_clock::now();
+  auto items_uring = algorithm::traverse(to_traverse, &visitor_uring, 4, nullptr, false, false, multiplexer.value().get()).value();
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << "  Traversed " << items_uring << " directories on " << to_traverse_path << " in " << (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0) << " seconds (which is " << (items_uring / (std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0))
+            << " directories/sec).\n";
+  BOOST_CHECK(abs((int) items_st - (int) items_uring) < 5);
+  BOOST_CHECK(visitor_st.failed_to_open == visitor_uring.failed_to_open);
+  BOOST_CHECK(abs((int) visitor_st.items_enumerated - (int) visitor_uring.items_enumerated) < 5);
+  BOOST_CHECK(visitor_st.max_depth == visitor_uring.max_depth);
+#endif
+}
+
+static inline void TestTraverseSymlinks()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  auto dirh = directory_handle::temp_directory().value();
+  auto subdirh = directory_handle::directory(dirh, "sub", directory_handle::mode::write, directory_handle::creation::if_needed).value();
+  static constexpr size_t links_count = 100;
+  std::vector<std::string> names, targets;
+  for(size_t n = 0; n < links_count; n++)
+  {
+    names.push_back("link" + std::to_string(n));
+    targets.push_back("target" + std::to_string(n));
+  }
+  std::vector<path_view> namesv(names.begin(), names.end()), targetsv(targets.begin(), targets.end());
+  // Create half the links in each directory, one batch using io_uring if possible
+  io_multiplexer_ptr multiplexer;
+#ifdef __linux__
+  if(auto r = multiplexer_linux_io_uring(1, false))
+  {
+    multiplexer = std::move(r).value();
+  }
+#endif
+  for(auto &r : symlink_handle::create_links(dirh, {namesv.data(), links_count / 2}, {targetsv.data(), links_count / 2}).value())
+  {
+    BOOST_REQUIRE(r);
+  }
+  for(auto &r : symlink_handle::create_links(subdirh, {namesv.data() + links_count / 2, links_count / 2}, {targetsv.data() + links_count / 2, links_count / 2},
+                                             multiplexer.get())
+                .value())
+  {
+    BOOST_REQUIRE(r);
+  }
+  // Existing links are not replaced
+  BOOST_CHECK(symlink_handle::create_links(dirh, {namesv.data(), 1}, {targetsv.data() + 1, 1}).value().front().error() == errc::file_exists);
+  // Batch reading returns the targets in order, and the failures of non-links
+  {
+    std::vector<path_view> toread(namesv.begin(), namesv.begin() + links_count / 2);
+    toread.push_back("sub");
+    auto read = symlink_handle::read_links(dirh, toread).value();
+    BOOST_REQUIRE(read.size() == links_count / 2 + 1);
+    for(size_t n = 0; n < links_count / 2; n++)
+    {
+      BOOST_CHECK(read[n].value() == targets[n]);
+    }
+    BOOST_CHECK(!read.back());
+  }
+
+  struct my_traverse_visitor final : algorithm::traverse_visitor
+  {
+    std::mutex lock;
+    std::map<std::string, std::string> found;
+    virtual bool want_symlinks(void * /*unused*/) noexcept override { return true; }
+    virtual result<void> symlinks_enumerated(void * /*unused*/, const directory_handle & /*unused*/, span<const directory_handle::buffer_type> links,
+                                             span<const result<path_view>> targets, size_t /*unused*/) noexcept override
+    {
+      BOOST_CHECK(links.size() == targets.size());
+      std::lock_guard<std::mutex> g(lock);
+      for(size_t n = 0; n < links.size(); n++)
+      {
+        found[links[n].leafname.path().string()] = targets[n].value().path().string();
+      }
+      return success();
+    }
+  };
+  my_traverse_visitor visitor;
+  BOOST_CHECK(algorithm::traverse(dirh, &visitor, 1).value() == 2);
+  BOOST_REQUIRE(visitor.found.size() == links_count);
+  for(size_t n = 0; n < links_count; n++)
+  {
+    BOOST_CHECK(visitor.found[names[n]] == targets[n]);
+  }
+}
+
+static inline void TestEnumerateVolume()
+{
+  using namespace LLFIO_V2_NAMESPACE;
+  auto dirh = directory_handle::temp_directory().value();
+  auto fh = file_handle::uniquely_named_file(dirh).value();
+  const auto leafname = fh.current_path().value().filename();
+  stat_t st(nullptr);
+  st.fill(fh, stat_t::want::ino).value();
+  size_t found = 0;
+  auto r = algorithm::enumerate_volume(dirh, make_function_ptr<result<bool>(span<const algorithm::volume_entry>)>(
+                                             [&](span<const algorithm::volume_entry> entries) -> result<bool> {
+                                               for(auto &entry : entries)
+                                               {
+                                                 if(entry.leafname == path_view(leafname))
+                                                 {
+                                                   BOOST_CHECK((entry.id[0] ^ entry.id[1]) == st.st_ino);
+                                                   BOOST_CHECK(entry.type == filesystem::file_type::regular);
+                                                   ++found;
+                                                 }
+                                               }
+                                               return true;
+                                             }));
+  fh.unlink().value();
+  if(!r && (r.error() == errc::operation_not_supported || r.error() == errc::permission_denied))
+  {
+    std::cout << "NOTE: algorithm::enumerate_volume() is not available here, skipping test" << std::endl;
+    return;
+  }
+  BOOST_REQUIRE(r);
+  BOOST_CHECK(r.value() > 0);
+  BOOST_CHECK(found == 1);
 }
 
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, enumerate_volume, "Tests that llfio::algorithm::enumerate_volume() finds files", TestEnumerateVolume())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, traverse, "Tests that llfio::algorithm::traverse() works as expected", TestTraverse())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, traverse_symlinks, "Tests that llfio::algorithm::traverse() reads symbolic links as expected",
+                       TestTraverseSymlinks())
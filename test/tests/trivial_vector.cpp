@@ -110,6 +110,95 @@ static inline void TestTrivialVector()
     }
   }
   BOOST_CHECK(it == v.end());
+
+  // Small capacities live on the heap, large ones in a section, and contents survive migrating both ways
+  BOOST_CHECK(!v.is_section_backed());
+  constexpr size_t _512kb = 524288 / sizeof(udt);
+  std::cout << "Resizing to 512Kb ..." << std::endl;
+  v.resize(_512kb, udt(9));
+  BOOST_CHECK(v.is_section_backed());
+  BOOST_REQUIRE(v[0].v == 78);
+  BOOST_REQUIRE(v[_16kb].v == 81);
+  BOOST_REQUIRE(v[_64kb].v == 82);
+  BOOST_REQUIRE(v[_512kb - 1].v == 82);
+  v.resize(_16kb, udt(10));
+  v.shrink_to_fit();
+  BOOST_CHECK(!v.is_section_backed());
+  BOOST_CHECK(v.size() == _16kb);
+  BOOST_REQUIRE(v[0].v == 78);
+  BOOST_REQUIRE(v[_4kb].v == 80);
+  BOOST_REQUIRE(v[_16kb - 1].v == 80);
+  LLFIO_V2_NAMESPACE::algorithm::trivial_vector<udt, 0> v2;
+  v2.push_back(udt(11));
+  BOOST_CHECK(v2.is_section_backed());
+  BOOST_REQUIRE(v2[0].v == 84);
+
+  // Large pages are requested of section backed storage, falling back to normal pages if there are none
+  udt_vector v3;
+  LLFIO_V2_NAMESPACE::algorithm::trivial_vector_storage_policy policy;
+  policy.page_sizes = LLFIO_V2_NAMESPACE::section_handle::flag::page_sizes_1 | LLFIO_V2_NAMESPACE::section_handle::flag::page_sizes_fallback;
+  v3.set_storage_policy(policy);
+  BOOST_CHECK(v3.storage_page_size() == 0);
+  v3.resize(_512kb, udt(12));
+  BOOST_REQUIRE(v3.is_section_backed());
+  std::cout << "Section backed storage obtained page size " << v3.storage_page_size()
+            << (v3.is_storage_transparent_huge_pages() ? " with transparent huge pages" : "") << std::endl;
+  BOOST_CHECK(v3.storage_page_size() >= LLFIO_V2_NAMESPACE::utils::page_size());
+  BOOST_CHECK((v3.capacity() * sizeof(udt)) % v3.storage_page_size() == 0);
+  BOOST_REQUIRE(v3[0].v == 85);
+  BOOST_REQUIRE(v3[_512kb - 1].v == 85);
+  v3.resize(_512kb * 2, udt(13));
+  BOOST_REQUIRE(v3[0].v == 85);
+  BOOST_REQUIRE(v3[_512kb * 2 - 1].v == 86);
+}
+
+static inline void TestPersistentTrivialVector()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  struct udt
+  {
+    uint64_t v, _space[7];  // 64 bytes total
+  };
+  using udt_vector = llfio::algorithm::trivial_vector<udt>;
+  auto fh = llfio::file_handle::temp_inode().value();
+  {
+    udt_vector v(fh);
+    BOOST_CHECK(v.is_persistent());
+    BOOST_CHECK(v.is_section_backed());
+    BOOST_CHECK(v.empty());
+    for(uint64_t n = 0; n < 100000; n++)
+    {
+      v.push_back(udt{n, {}});
+    }
+    v.persist();
+    v.push_back(udt{100000, {}});
+  }
+  // Reopening remaps the items where they were left
+  {
+    udt_vector v(fh);
+    BOOST_REQUIRE(v.size() == 100001);
+    for(uint64_t n = 0; n < v.size(); n++)
+    {
+      BOOST_REQUIRE(v[n].v == n);
+    }
+    v.resize(10, udt{0, {}});
+    v.shrink_to_fit();
+    BOOST_CHECK(fh.maximum_extent().value() == 2 * llfio::utils::page_size());
+  }
+  {
+    udt_vector v(fh);
+    BOOST_REQUIRE(v.size() == 10);
+    BOOST_CHECK(v[9].v == 9);
+  }
+  // A file of a differently sized type is refused
+  try
+  {
+    llfio::algorithm::trivial_vector<uint32_t> v(fh);
+    BOOST_CHECK(false);
+  }
+  catch(const std::invalid_argument & /*unused*/)
+  {
+  }
 }
 
 inline std::string printKb(size_t bytes)
@@ -245,5 +334,6 @@ static inline void BenchmarkTrivialVector2()
 }
 
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, trivial_vector, "Tests that llfio::algorithm::trivial_vector works as expected", TestTrivialVector())
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, trivial_vector_persistent, "Tests that a persistent llfio::algorithm::trivial_vector reopens its contents", TestPersistentTrivialVector())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, trivial_vector2, "Benchmarks llfio::algorithm::trivial_vector against std::vector with push_back()", BenchmarkTrivialVector1())
 KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, trivial_vector3, "Benchmarks llfio::algorithm::trivial_vector against std::vector with resize()", BenchmarkTrivialVector2())
@@ -24,6 +24,10 @@ Distributed under the Boost Software License, Version 1.0.
 
 #include "../test_kernel_decl.hpp"
 
+#include <algorithm>
+#include <set>
+#include <thread>
+
 static inline void TestCurrentProcessMemoryUsage()
 {
 #if defined(__has_feature)
@@ -215,4 +219,277 @@ static inline void TestCurrentProcessMemoryUsage()
   }
 }
 
+static inline void TestSampledProcessMemoryUsage()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto precise = llfio::utils::current_process_memory_usage(llfio::utils::process_memory_usage::accuracy::precise).value();
+  auto fast = llfio::utils::current_process_memory_usage(llfio::utils::process_memory_usage::accuracy::fast).value();
+  std::cout << "Precise: " << precise.total_address_space_in_use << "," << precise.total_address_space_paged_in << "," << precise.private_committed << ","
+            << precise.private_paged_in << "\nFast: " << fast.total_address_space_in_use << "," << fast.total_address_space_paged_in << ","
+            << fast.private_committed << "," << fast.private_paged_in << std::endl;
+  BOOST_CHECK(fast.total_address_space_in_use > 0);
+  BOOST_CHECK(fast.total_address_space_paged_in > 0);
+  BOOST_CHECK(fast.total_address_space_paged_in <= fast.total_address_space_in_use);
+  BOOST_CHECK(fast.private_paged_in <= fast.total_address_space_paged_in);
+  llfio::utils::start_process_memory_usage_sampler(std::chrono::milliseconds(10)).value();
+  // A first sample is available immediately
+  BOOST_CHECK(llfio::utils::sampled_process_memory_usage().value().total_address_space_in_use > 0);
+  {
+    // Committing and faulting in a large allocation is seen by a later sample
+    auto before = llfio::utils::sampled_process_memory_usage().value();
+    auto maph = llfio::map_handle::map(64 * 1024 * 1024).value();
+    for(size_t n = 0; n < maph.length(); n += 4096)
+    {
+      maph.address()[n] = llfio::to_byte(1);
+    }
+    bool seen = false;
+    for(size_t n = 0; n < 500 && !seen; n++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      seen = llfio::utils::sampled_process_memory_usage().value().total_address_space_paged_in >= before.total_address_space_paged_in + 32 * 1024 * 1024;
+    }
+    BOOST_CHECK(seen);
+  }
+  // Restarting merely reconfigures
+  llfio::utils::start_process_memory_usage_sampler(std::chrono::milliseconds(50), llfio::utils::process_memory_usage::accuracy::precise).value();
+  llfio::utils::stop_process_memory_usage_sampler();
+  BOOST_CHECK(llfio::utils::sampled_process_memory_usage().value().total_address_space_in_use > 0);
+}
+
+static inline void TestMemoryPressureReclaim()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto pressure = llfio::utils::current_memory_pressure();
+  if(!pressure)
+  {
+    std::cout << "NOTE: This platform cannot report memory pressure: " << pressure.error().message() << std::endl;
+  }
+  else
+  {
+    std::cout << "Memory pressure: some = " << pressure.value().some << "%, full = " << pressure.value().full << "%" << std::endl;
+    BOOST_CHECK(pressure.value().some >= 0 && pressure.value().some <= 100);
+    BOOST_CHECK(pressure.value().full <= pressure.value().some);
+  }
+  auto maph = llfio::map_handle::map(4 * 1024 * 1024).value();
+  for(size_t n = 0; n < maph.length(); n++)
+  {
+    maph.address()[n] = llfio::to_byte((unsigned char) n);
+  }
+  // Only whole pages within the region are reclaimed
+  auto id = llfio::utils::register_cold_region({maph.address() + 1, maph.length() - 1}).value();
+  auto reclaimed = llfio::utils::reclaim_cold_regions(false).value();
+  BOOST_CHECK(reclaimed == 0 || reclaimed == maph.length() - llfio::utils::page_size());
+  llfio::utils::reclaim_cold_regions(true).value();
+  // Reclaim never loses contents
+  bool intact = true;
+  for(size_t n = 0; n < maph.length(); n++)
+  {
+    intact = intact && maph.address()[n] == llfio::to_byte((unsigned char) n);
+  }
+  BOOST_CHECK(intact);
+  if(pressure)
+  {
+    // A threshold of zero reclaims every interval
+    llfio::utils::start_memory_pressure_reclaimer(std::chrono::milliseconds(10), 0).value();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    llfio::utils::stop_memory_pressure_reclaimer();
+  }
+  llfio::utils::unregister_cold_region(id);
+  BOOST_CHECK(llfio::utils::reclaim_cold_regions(true).value() == 0);
+}
+
+static inline void TestCoarseSteadyClock()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  const auto resolution = llfio::coarse_steady_clock::resolution();
+  std::cout << "coarse_steady_clock has a resolution of " << resolution.count() << " nanoseconds" << std::endl;
+  auto last = llfio::coarse_steady_clock::now();
+  for(size_t n = 0; n < 100000; n++)
+  {
+    const auto precise = std::chrono::steady_clock::now();
+    const auto coarse = llfio::coarse_steady_clock::now();
+    BOOST_REQUIRE(coarse >= last);
+    // The coarse clock lags the precise clock by at most its resolution, with some slack for preemption
+    BOOST_REQUIRE(coarse - precise <= std::chrono::milliseconds(1));
+    BOOST_REQUIRE(precise - coarse <= resolution + std::chrono::milliseconds(50));
+    last = coarse;
+  }
+  // A deadline long enough to use the coarse clock still expires on time
+  const auto begin = std::chrono::steady_clock::now();
+  llfio::deadline d(std::chrono::milliseconds(200));
+  LLFIO_DEADLINE_TO_SLEEP_INIT(d);
+  (void) began_steady;
+  while(std::chrono::steady_clock::now() - begin < std::chrono::seconds(5))
+  {
+    if(std::chrono::steady_clock::now() - began_steady >= std::chrono::nanoseconds(d.nsecs))
+    {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+  BOOST_CHECK(elapsed >= std::chrono::milliseconds(200) - resolution);
+  BOOST_CHECK(elapsed < std::chrono::seconds(5));
+}
+
+static inline void TestRandomString()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  std::set<std::string> seen;
+  for(size_t n = 0; n < 10000; n++)
+  {
+    auto s = llfio::utils::random_string(16);
+    BOOST_REQUIRE(s.size() == 32);
+    for(auto c : s)
+    {
+      BOOST_REQUIRE(((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')));
+    }
+    BOOST_REQUIRE(seen.insert(std::move(s)).second);
+  }
+  // Lengths not a multiple of the SIMD width, and known hex encodings
+  const char in[] = "\x01\x23\x45\x67\x89\xab\xcd\xef\x01\x23\x45\x67\x89\xab\xcd\xef\xff\x00\x10";
+  char out[38];
+  llfio::utils::detail::to_hex_string(out, in, 19);
+  BOOST_CHECK(0 == memcmp(out, "0123456789abcdef0123456789abcdefff0010", 38));
+  // Larger fills are not all zero, and successive fills differ
+  std::vector<char> a(4096), b(4096);
+  llfio::utils::random_fill(a.data(), a.size());
+  llfio::utils::random_fill(b.data(), b.size());
+  BOOST_CHECK(a != b);
+  BOOST_CHECK(std::count(a.begin(), a.end(), 0) < 100);
+}
+
+static inline void TestPooledPageAllocator()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  llfio::utils::trim_pooled_page_allocator_cache();
+  llfio::utils::pooled_page_allocator<llfio::byte> alloc;
+  // A freed run is handed back to the next allocation of the same size class
+  auto *a = alloc.allocate(1024 * 1024);
+  a[0] = llfio::to_byte(78);
+  a[1024 * 1024 - 1] = llfio::to_byte(78);
+  alloc.deallocate(a, 1024 * 1024);
+  auto *b = alloc.allocate(1000 * 1000);
+  BOOST_CHECK(b == a);
+  // But not to allocations of a different size class
+  auto *c = alloc.allocate(4096);
+  BOOST_CHECK(c != a);
+  alloc.deallocate(c, 4096);
+  alloc.deallocate(b, 1000 * 1000);
+  // Nothing is cached above the limit
+  const auto limit = llfio::utils::pooled_page_allocator_cache_limit();
+  llfio::utils::set_pooled_page_allocator_cache_limit(0);
+  auto *d = alloc.allocate(1024 * 1024);
+  alloc.deallocate(d, 1024 * 1024);
+  BOOST_CHECK(llfio::utils::detail::this_thread_pooled_page_cache().cached_bytes == 0);
+  llfio::utils::set_pooled_page_allocator_cache_limit(limit);
+  // The vector works with it
+  std::vector<llfio::byte, llfio::utils::pooled_page_allocator<llfio::byte>> v(65536, llfio::to_byte(1));
+  BOOST_CHECK(v[65535] == llfio::to_byte(1));
+  llfio::utils::trim_pooled_page_allocator_cache();
+}
+
+static inline void TestLargePagePool()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  llfio::utils::large_page_pool_allocator<llfio::byte> alloc;
+  {
+    // With no pool, allocations fall back to page_allocator
+    auto *a = alloc.allocate(65536);
+    a[0] = llfio::to_byte(78);
+    alloc.deallocate(a, 65536);
+  }
+  const size_t pagesize = llfio::utils::page_size();
+  auto reserved = llfio::utils::reserve_large_page_pool(3 * 1024 * 1024);
+  if(!reserved)
+  {
+    std::cout << "Could not reserve a large page pool (" << reserved.error().message() << "), skipping." << std::endl;
+    return;
+  }
+  BOOST_REQUIRE(reserved.value() == 4 * 1024 * 1024);
+  BOOST_CHECK(llfio::utils::reserve_large_page_pool(1024 * 1024).error() == llfio::errc::device_or_resource_busy);
+  auto stats = llfio::utils::large_page_pool_stats();
+  BOOST_CHECK(stats.bytes_reserved == 4 * 1024 * 1024);
+  BOOST_CHECK(stats.bytes_in_use == 0);
+  std::cout << "Large page pool is backed by pages of " << stats.page_size_used << " bytes." << std::endl;
+  {
+    // Allocations are rounded up to powers of two, and buddies merge on free
+    auto *a = alloc.allocate(pagesize);
+    auto *b = alloc.allocate(pagesize + 1);
+    auto *c = alloc.allocate(1024 * 1024);
+    BOOST_CHECK(llfio::utils::large_page_pool_stats().bytes_in_use == pagesize + 2 * pagesize + 1024 * 1024);
+    BOOST_CHECK(((uintptr_t) b & (2 * pagesize - 1)) == 0);
+    BOOST_CHECK(((uintptr_t) c & (1024 * 1024 - 1)) == ((uintptr_t) a & (1024 * 1024 - 1)));
+    BOOST_CHECK(llfio::utils::release_large_page_pool().error() == llfio::errc::device_or_resource_busy);
+    alloc.deallocate(a, pagesize);
+    alloc.deallocate(b, pagesize + 1);
+    alloc.deallocate(c, 1024 * 1024);
+    BOOST_CHECK(llfio::utils::large_page_pool_stats().bytes_in_use == 0);
+    // Having merged back, the whole pool can be allocated once
+    auto *d = alloc.allocate(4 * 1024 * 1024);
+    BOOST_CHECK(d == a);
+    alloc.deallocate(d, 4 * 1024 * 1024);
+  }
+  {
+    // Containers work, and fall back when the pool is exhausted
+    std::vector<llfio::byte, llfio::utils::large_page_pool_allocator<llfio::byte>> v(3 * 1024 * 1024, llfio::to_byte(1)), w(3 * 1024 * 1024, llfio::to_byte(2));
+    BOOST_CHECK(v.back() == llfio::to_byte(1));
+    BOOST_CHECK(w.back() == llfio::to_byte(2));
+    BOOST_CHECK(llfio::utils::large_page_pool_stats().bytes_in_use == 4 * 1024 * 1024);
+  }
+  llfio::utils::release_large_page_pool().value();
+  BOOST_CHECK(llfio::utils::large_page_pool_stats().bytes_reserved == 0);
+}
+
+static inline void TestPerFilesystemFlush()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  auto fh = llfio::file_handle::temp_inode().value();
+  std::vector<llfio::byte> buffer(65536, llfio::to_byte(78));
+  fh.write(0, {{buffer.data(), buffer.size()}}).value();
+  {
+    // Flushing a volume on Windows needs elevated privileges
+    auto r = llfio::utils::flush_modified_data(fh.native_handle());
+    if(!r)
+    {
+      std::cout << "Flushing the filing system failed (" << r.error().message() << ")" << std::endl;
+    }
+  }
+  {
+    auto r = llfio::utils::drop_filesystem_cache(fh.native_handle());
+    if(!r)
+    {
+      BOOST_CHECK(r.error() == llfio::errc::not_supported);
+    }
+  }
+  // The contents are unaffected
+  std::vector<llfio::byte> readback(65536);
+  BOOST_CHECK(fh.read(0, {{readback.data(), readback.size()}}).value() == 65536);
+  BOOST_CHECK(readback == buffer);
+#ifdef __linux__
+  auto multiplexer = llfio::multiplexer_linux_epoll(1).value();
+  llfio::io_multiplexer::posix_fs_syscall op;
+  op.op = llfio::io_multiplexer::posix_fs_syscall::kind::syncfs;
+  op.fd = fh.native_handle().fd;
+  multiplexer->initiate_posix_fs_syscalls({&op, 1}).value();
+  auto begin = std::chrono::steady_clock::now();
+  while(__atomic_load_n(&op.result, __ATOMIC_ACQUIRE) == llfio::io_multiplexer::posix_fs_syscall::pending)
+  {
+    multiplexer->check_for_any_completed_io(std::chrono::seconds(5)).value();
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - begin < std::chrono::seconds(60));
+  }
+  BOOST_CHECK(op.result == 0);
+  // Executing it synchronously also works
+  multiplexer->do_posix_fs_syscalls({&op, 1}).value();
+  BOOST_CHECK(op.result == 0);
+#endif
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, coarse_steady_clock, "Tests that llfio::coarse_steady_clock works as expected", TestCoarseSteadyClock())
 KERNELTEST_TEST_KERNEL(integration, llfio, utils, current_process_memory_usage, "Tests that llfio::utils::current_process_memory_usage() works as expected", TestCurrentProcessMemoryUsage())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, pooled_page_allocator, "Tests that llfio::utils::pooled_page_allocator works as expected", TestPooledPageAllocator())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, large_page_pool, "Tests that llfio::utils::large_page_pool_allocator works as expected", TestLargePagePool())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, memory_pressure_reclaim, "Tests that llfio::utils::reclaim_cold_regions() works as expected", TestMemoryPressureReclaim())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, random_string, "Tests that llfio::utils::random_string() works as expected", TestRandomString())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, sampled_process_memory_usage, "Tests that llfio::utils::sampled_process_memory_usage() works as expected", TestSampledProcessMemoryUsage())
+KERNELTEST_TEST_KERNEL(integration, llfio, utils, per_filesystem_flush, "Tests that llfio::utils::flush_modified_data(h) works as expected", TestPerFilesystemFlush())
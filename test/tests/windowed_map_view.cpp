@@ -0,0 +1,79 @@
+/* Integration test kernel for whether windowed_map_view works
+(C) 2020 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2020
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+#include "../test_kernel_decl.hpp"
+
+static inline void TestWindowedMapView()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  static constexpr size_t bytes = 4 * 1024 * 1024 + 17;
+  auto fh = llfio::file_handle::uniquely_named_file(llfio::path_discovery::storage_backed_temporary_files_directory(), llfio::file_handle::mode::write, llfio::file_handle::caching::temporary,
+                                                    llfio::file_handle::flag::unlink_on_first_close)
+            .value();
+  {
+    std::vector<llfio::byte> buffer(bytes);
+    for(size_t n = 0; n < bytes; n++)
+    {
+      buffer[n] = llfio::to_byte((unsigned char) (n % 251));
+    }
+    fh.write(0, {{buffer.data(), buffer.size()}}).value();
+  }
+  auto sh = llfio::section_handle::section(fh).value();
+  // Windows of 256Kb, with only four resident at once
+  llfio::windowed_map_view view(sh, 256 * 1024, 1024 * 1024);
+  BOOST_REQUIRE(view.length() == bytes);
+  BOOST_CHECK(view.max_windows() == 1024 * 1024 / view.window_size());
+
+  // Walk the whole file with a cursor, which must see every byte in order
+  bool same = true;
+  size_t count = 0;
+  for(auto c = view.begin_at(); !c.at_end() && same;)
+  {
+    auto s = c.current().value();
+    BOOST_REQUIRE(!s.empty());
+    for(size_t n = 0; n < s.size() && same; n++)
+    {
+      same = s[n] == llfio::to_byte((unsigned char) ((c.offset() + n) % 251));
+    }
+    count += s.size();
+    c += s.size();
+  }
+  BOOST_CHECK(same);
+  BOOST_CHECK(count == bytes);
+  BOOST_CHECK(view.resident_windows() <= view.max_windows());
+  BOOST_CHECK(view.statistics().second > 0);
+
+  // The most recently used window stays resident, the least recently used is evicted
+  auto maps = view.statistics().first;
+  view.window_at(bytes - 1).value();
+  BOOST_CHECK(view.statistics().first == maps);
+  BOOST_CHECK(view.window_at(bytes - 1).value().size() == 1);
+  view.window_at(0).value();
+  BOOST_CHECK(view.statistics().first == maps + 1);
+  BOOST_CHECK(view.window_at(bytes).value().empty());
+  view.evict_all().value();
+  BOOST_CHECK(view.resident_windows() == 0);
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, windowed_map_view, walk, "Tests that windowed_map_view maps windows on demand within its budget", TestWindowedMapView())
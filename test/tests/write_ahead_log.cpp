@@ -0,0 +1,177 @@
+/* Integration test kernel for algorithm::write_ahead_log
+(C) 2026 Niall Douglas <http://www.nedproductions.biz/> (1 commit)
+File Created: Oct 2026
+
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License in the accompanying file
+Licence.txt or at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+
+Distributed under the Boost Software License, Version 1.0.
+    (See accompanying file Licence.txt or copy at
+          http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+
+#include "../test_kernel_decl.hpp"
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+
+static inline void TestWriteAheadLog()
+{
+  namespace llfio = LLFIO_V2_NAMESPACE;
+  using wal = llfio::algorithm::write_ahead_log;
+  static constexpr size_t THREADS = 8, APPENDS = 256;
+  auto dh = llfio::directory_handle::uniquely_named_directory({}, llfio::directory_handle::mode::write).value();
+  wal::config cfg;
+  cfg.segment_size = 64 * 1024;
+  cfg.segment_caching = llfio::file_handle::caching::all;
+  cfg.recycled_segments = 2;
+  auto contents_of = [](size_t t, size_t n) {
+    std::string ret = std::to_string(t) + ":" + std::to_string(n) + ":";
+    ret.append((t * 131 + n * 17) % 2000, (char) ('a' + n % 26));
+    return ret;
+  };
+  auto append = [](wal &log, const std::string &contents) { return log.append({(const llfio::byte *) contents.data(), contents.size()}); };
+  auto replay_all = [](wal &log) {
+    std::map<wal::lsn_type, std::string> ret;
+    log.replay(0, [&](wal::lsn_type lsn, llfio::span<const llfio::byte> contents) { ret[lsn] = std::string((const char *) contents.data(), contents.size()); }).value();
+    return ret;
+  };
+
+  std::map<wal::lsn_type, std::string> appended;
+  wal::lsn_type end;
+  {
+    auto log = wal::open(dh, "log", cfg).value();
+    BOOST_CHECK(log->segment_size() == 64 * 1024);
+    BOOST_CHECK(log->record_alignment() == 64);
+    BOOST_CHECK(log->end() == 0);
+    // Records are replayed in order, and are durable once committed
+    for(size_t n = 0; n < 4; n++)
+    {
+      auto contents = contents_of(0, n);
+      auto lsn = append(*log, contents).value();
+      appended[lsn] = contents;
+    }
+    log->commit(appended.rbegin()->first).value();
+    BOOST_CHECK(log->durable() > appended.rbegin()->first);
+    BOOST_CHECK(replay_all(*log) == appended);
+    // Committing what has not been appended fails
+    BOOST_CHECK(!log->commit(log->end()));
+
+    // Concurrent appenders and committers crossing many segments share barriers
+    std::mutex lock;
+    std::vector<std::thread> threads;
+    for(size_t t = 1; t <= THREADS; t++)
+    {
+      threads.emplace_back([&, t] {
+        for(size_t n = 0; n < APPENDS; n++)
+        {
+          auto contents = contents_of(t, n);
+          auto lsn = append(*log, contents).value();
+          log->commit(lsn).value();
+          std::lock_guard<std::mutex> g(lock);
+          appended[lsn] = contents;
+        }
+      });
+    }
+    for(auto &t : threads)
+    {
+      t.join();
+    }
+    BOOST_CHECK(replay_all(*log) == appended);
+    const auto stats = log->stats();
+    BOOST_CHECK(stats.appends == 4 + THREADS * APPENDS);
+    BOOST_CHECK(stats.barriers <= stats.commits);
+    BOOST_CHECK(stats.segments_created > 2);
+    std::cout << "Concurrent appends needed " << stats.barriers << " barriers for " << stats.commits << " commits, and filled " << stats.segments_created
+              << " segments." << std::endl;
+    end = log->end();
+  }
+
+  // Reopening finds the same records, and the same end
+  {
+    auto log = wal::open(dh, "log", cfg).value();
+    BOOST_CHECK(log->end() == end);
+    BOOST_CHECK(log->durable() == end);
+    BOOST_CHECK(replay_all(*log) == appended);
+    for(size_t n = 0; n < 2; n++)
+    {
+      auto contents = contents_of(0, 1000 + n);
+      auto lsn = append(*log, contents).value();
+      appended[lsn] = contents;
+    }
+    log->commit(appended.rbegin()->first).value();
+  }
+
+  // A torn last record becomes the end of the log, and is overwritten by the next append
+  {
+    const auto last = appended.rbegin()->first;
+    char leafname[32];
+    snprintf(leafname, sizeof(leafname), "%016llx.wal", (unsigned long long) (last / cfg.segment_size));
+    auto logdh = llfio::directory_handle::directory(dh, "log").value();
+    auto fh = llfio::file_handle::file(logdh, leafname, llfio::file_handle::mode::write).value();
+    fh.write(last % cfg.segment_size + 40, {{(const llfio::byte *) "garbage", 7}}).value();
+    fh.close().value();
+    appended.erase(last);
+
+    auto log = wal::open(dh, "log", cfg).value();
+    BOOST_CHECK(log->end() == last);
+    BOOST_CHECK(replay_all(*log) == appended);
+    auto contents = contents_of(0, 2000);
+    BOOST_CHECK(append(*log, contents).value() == last);
+    appended[last] = contents;
+    log->commit(last).value();
+    BOOST_CHECK(replay_all(*log) == appended);
+  }
+
+  // Released segments are reused, and their stale records are never replayed
+  {
+    auto log = wal::open(dh, "log", cfg).value();
+    const auto released = log->end();
+    log->release(released).value();
+    BOOST_CHECK(log->head() == released / cfg.segment_size * cfg.segment_size);
+    std::map<wal::lsn_type, std::string> retained;
+    for(auto &i : appended)
+    {
+      if(i.first >= log->head())
+      {
+        retained.insert(i);
+      }
+    }
+    BOOST_CHECK(replay_all(*log) == retained);
+    for(size_t n = 0; n < APPENDS; n++)
+    {
+      auto contents = contents_of(0, 3000 + n);
+      auto lsn = append(*log, contents).value();
+      retained[lsn] = contents;
+    }
+    log->commit(retained.rbegin()->first).value();
+    BOOST_CHECK(log->stats().segments_recycled == 2);
+    BOOST_CHECK(replay_all(*log) == retained);
+    end = log->end();
+    log.reset();
+
+    log = wal::open(dh, "log", cfg).value();
+    BOOST_CHECK(log->end() == end);
+    BOOST_CHECK(replay_all(*log) == retained);
+  }
+
+  llfio::algorithm::reduce(std::move(dh)).value();
+}
+
+KERNELTEST_TEST_KERNEL(integration, llfio, algorithm, write_ahead_log, "Tests that algorithm::write_ahead_log appends, commits, recovers and recycles segments",
+                       TestWriteAheadLog())